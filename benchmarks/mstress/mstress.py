@@ -44,6 +44,9 @@ class Globals:
   KFS_SERVER_KEYWORD = "metaserver"
   HDFS_SERVER_CMD = "java"
   HDFS_SERVER_KEYWORD = "NameNode"
+  LOAD_DURATION = 0
+  # Machine readable client results, forwarded to the master.
+  RESULT_TAG = "mstress_result:"
 
 
 def ParseCommandline():
@@ -168,6 +171,17 @@ def RunMStressMaster(opts, hostsList):
   print '\nMaster: Readdir test took %d.%d sec' % (deltaTime.seconds, deltaTime.microseconds/1000000)
   print '=========================================='
 
+  if Globals.LOAD_DURATION > 0:
+    if opts.filesystem != 'qfs':
+      print "\nMaster: load test is not supported with %s" % opts.filesystem
+    else:
+      startTime = datetime.datetime.now()
+      if RunMStressMasterTest(opts, hostsList, 'load') == False:
+        return False
+      deltaTime = datetime.datetime.now() - startTime
+      print '\nMaster: Load test took %d.%d sec' % (deltaTime.seconds, deltaTime.microseconds/1000000)
+      print '=========================================='
+
   if opts.leave_files:
     print "\nNot deleting files because of -l option"
     return False
@@ -210,7 +224,9 @@ def RunMStressMasterTest(opts, hostsList, test):
   for client in hostsList:
     slaveLogfile = opts.plan + '_' + client + '_' + test + '_' + opts.filesystem + '.slave.log'
     p = subprocess.Popen(['/usr/bin/ssh', client,
-                          '%s -c %s -k %s >& %s' % (ssh_cmd, client, clientHostMapping[client], slaveLogfile)],
+                          '%s -c %s -k %s >& %s; rc=$?; grep "%s" %s; exit $rc' % (
+                            ssh_cmd, client, clientHostMapping[client], slaveLogfile,
+                            Globals.RESULT_TAG, slaveLogfile)],
                          stdout=subprocess.PIPE,
                          stderr=subprocess.PIPE)
     running_procs[p] = client
@@ -292,7 +308,7 @@ def RunMStressSlave(opts, clientsPerHost):
   running_procs = []
   for i in range(0, clientsPerHost):
     clientLogfile = '%s_%s_proc_%02d_%s_%s.client.log' % (opts.plan, opts.client_hostname, i, opts.client_testname, opts.filesystem)
-    args = ["%s -s %s -p %s -a %s -c %s -t %s -n proc_%02d >& %s" % (
+    args = ["%s -s %s -p %s -a %s -c %s -t %s -n proc_%02d >& %s; rc=$?; grep '^%s' %s; exit $rc" % (
             Globals.CLIENT_PATH,
             opts.server,
             str(opts.port),
@@ -300,6 +316,8 @@ def RunMStressSlave(opts, clientsPerHost):
             opts.client_lookup_key,
             opts.client_testname,
             i,
+            clientLogfile,
+            Globals.RESULT_TAG,
             clientLogfile)]
     print 'Slave: args = %r' % args
     p = subprocess.Popen(args,
@@ -373,6 +391,8 @@ def ReadPlanFile(opts):
       numToStat = int(line[len('nstat='):].strip())
     elif line.startswith('inodes='):
       nodesPerLevel = int(line[len('inodes='):].strip())
+    elif line.startswith('loadduration='):
+      Globals.LOAD_DURATION = int(line[len('loadduration='):].strip())
   planfile.close()
   if None in (hostsList, clientsPerHost, leafType, numLevels, numToStat, nodesPerLevel):
     sys.exit('Failed to read plan file')
@@ -394,7 +414,9 @@ def ReadPlanFile(opts):
         '   o %d levels of %d nodes (%d leaf nodes, %d total nodes) will be created by each client process.\n' % (numLevels, nodesPerLevel, leafNodesPerProcess, nodesPerProcess) +
         '   o Overall, %d leaf %ss will be created, %d intermediate directories will be created.\n' % (overallLeafs, leafType, intermediateNodes) +
         '   o Stat will be done on a random subset of %d leaf %ss by each client process, totalling %d stats.\n' % (numToStat, leafType, totalNumToStat) +
-        '   o Readdir (non-overlapping) will be done on the full file tree by all client processes.\n')
+        '   o Readdir (non-overlapping) will be done on the full file tree by all client processes.\n' +
+        ('   o Load test will run for %d sec by each client process.\n' % Globals.LOAD_DURATION
+          if Globals.LOAD_DURATION > 0 else ''))
   return hostsList, clientsPerHost
 
 
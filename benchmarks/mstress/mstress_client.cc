@@ -24,10 +24,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <time.h>
 #include <math.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <sys/time.h>
 #include <iostream>
 #include <fstream>
@@ -49,7 +53,7 @@ FILE* logFile = stdout;
 /*
   This program is invoked with the following arguments:
     - qfs server/port
-    - test name ('create', 'stat', or 'readdir')
+    - test name ('create', 'stat', 'readdir', 'delete' or 'load')
     - a planfile
     - keys to read the planfile (hostname and process name)
 
@@ -75,6 +79,31 @@ FILE* logFile = stdout;
   /mstress/127.0.0.1_proc_00/PPP_2/PPP_0
   /mstress/127.0.0.1_proc_00/PPP_2/PPP_1
   /mstress/127.0.0.1_proc_00/PPP_2/PPP_2
+
+  The 'load' test runs a mix of meta operations against the tree created by
+  the 'create' test for a given duration, and reports per operation latency
+  percentiles. The operations are issued by the given number of threads,
+  each with its own qfs client connection. With zero target rate each thread
+  issues the next operation as soon as the previous one completes (closed
+  loop), otherwise the operations are issued on schedule at the target rate
+  (open loop), and the latency is measured from the scheduled start time, in
+  order to account for the queueing delays. The load parameters are read from
+  the plan file, and can be overridden from the command line:
+  ---------------------------------------------
+  #Load test duration in seconds
+  loadduration=60
+  #Target op rate per client process, 0 for closed loop
+  loadrate=0
+  #Number of threads (concurrency) per client process
+  loadthreads=4
+  #Op mix: comma separated op:weight pairs
+  loadmix=stat:60,readdir:10,create:10,rename:10,delete:5,getalloc:5
+  ---------------------------------------------
+  Supported ops are stat, readdir, create, rename, delete, and getalloc.
+  Create, rename, and delete operate on files in the per thread scratch
+  directory, getalloc on a per thread single chunk file. The results are
+  emitted as single "mstress_result:" line of key=value pairs per op type,
+  including the latency histogram, for mstress_run.py to aggregate.
 */
 
 
@@ -134,6 +163,23 @@ struct Client {
   int levels_;
   int inodesPerLevel_;
   int pathsToStat_;
+
+  //load test, from planfile or commandline
+  int loadDuration_;
+  double loadRate_;
+  int loadThreads_;
+  string loadMix_;
+
+  Client()
+    : dfsPort_(0),
+      prefixLen_(0),
+      levels_(0),
+      inodesPerLevel_(0),
+      pathsToStat_(0),
+      loadDuration_(-1),
+      loadRate_(-1),
+      loadThreads_(-1)
+    {}
 };
 const size_t Client::INITIAL_SIZE = 1 << 12;
 
@@ -162,9 +208,12 @@ private:
 
 void Usage(const char* argv0)
 {
-  fprintf(logFile, "Usage: %s -s dfs-server -p dfs-port [-t [create|stat|readdir|delete] -a planfile-path -c host -n process-name -P path-prefix]\n", argv0);
+  fprintf(logFile, "Usage: %s -s dfs-server -p dfs-port [-t [create|stat|readdir|delete|load] -a planfile-path -c host -n process-name -P path-prefix] [-d load-duration-sec -r load-ops-per-sec -C load-threads -m load-op-mix]\n", argv0);
   fprintf(logFile, "   -t: this option requires -a, -c, and -n options.\n");
   fprintf(logFile, "   -P: the default value is PATH_.\n");
+  fprintf(logFile, "   -d, -r, -C, -m: load test parameters, override plan file.\n");
+  fprintf(logFile, "   -r: 0 -- closed loop, otherwise open loop target rate.\n");
+  fprintf(logFile, "   -m: eg: stat:60,readdir:10,create:10,rename:10,delete:5,getalloc:5\n");
   fprintf(logFile, "eg:\n%s -s <metaserver-host> -p <metaserver-port> -t create -a <planfile> -c localhost -n Proc_00\n", argv0);
   exit(0);
 }
@@ -211,7 +260,7 @@ void parse_options(int argc, char* argv[], Client* client)
        *prefix = NULL,
        *process_name = NULL;
 
-  while ((c = getopt(argc, argv, "s:p:a:c:n:t:P:h")) != -1) {
+  while ((c = getopt(argc, argv, "s:p:a:c:n:t:P:d:r:C:m:h")) != -1) {
     switch (c) {
       case 's':
         dfs_server = optarg;
@@ -235,6 +284,18 @@ void parse_options(int argc, char* argv[], Client* client)
       case 'P':
         prefix = optarg;
         break;
+      case 'd':
+        client->loadDuration_ = atoi(optarg);
+        break;
+      case 'r':
+        client->loadRate_ = atof(optarg);
+        break;
+      case 'C':
+        client->loadThreads_ = atoi(optarg);
+        break;
+      case 'm':
+        client->loadMix_ = optarg;
+        break;
       case 'h':
       case '?':
         Usage(argv[0]);
@@ -305,8 +366,44 @@ void ParsePlanFile(Client* client)
       client->pathsToStat_ = atoi(line.substr(6).c_str());
       continue;
     }
+    if (line.substr(0, 13) == "loadduration=") {
+      if (client->loadDuration_ < 0) {
+        client->loadDuration_ = atoi(line.substr(13).c_str());
+      }
+      continue;
+    }
+    if (line.substr(0, 9) == "loadrate=") {
+      if (client->loadRate_ < 0) {
+        client->loadRate_ = atof(line.substr(9).c_str());
+      }
+      continue;
+    }
+    if (line.substr(0, 12) == "loadthreads=") {
+      if (client->loadThreads_ < 0) {
+        client->loadThreads_ = atoi(line.substr(12).c_str());
+      }
+      continue;
+    }
+    if (line.substr(0, 8) == "loadmix=") {
+      if (client->loadMix_.empty()) {
+        client->loadMix_ = line.substr(8);
+      }
+      continue;
+    }
   }
   ifs.close();
+  if (client->loadDuration_ < 0) {
+    client->loadDuration_ = 60;
+  }
+  if (client->loadRate_ < 0) {
+    client->loadRate_ = 0;
+  }
+  if (client->loadThreads_ <= 0) {
+    client->loadThreads_ = 1;
+  }
+  if (client->loadMix_.empty()) {
+    client->loadMix_ = "stat:60,readdir:10,create:10,rename:10,delete:5,getalloc:5";
+  }
   if (client->levels_ <= 0 || client->inodesPerLevel_ <= 0 || client->type_.empty()) {
     fprintf(logFile, "Error parsing plan file\n");
     exit(-1);
@@ -573,6 +670,477 @@ int RemoveDFSPaths(Client* client, AutoCleanupKfsClient* kfs) {
 }
 
 
+//Log-linear latency histogram in the spirit of HDR histogram, with 128
+//sub-buckets per power of two, i.e. two significant decimal digits, or less
+//than 1% value error. The values are in microseconds.
+class LatencyHistogram
+{
+public:
+  enum {
+    kSubBucketBits = 7,
+    kSubBucketCount = 1 << kSubBucketBits,
+    kBucketCount = (64 - kSubBucketBits + 1) * kSubBucketCount
+  };
+
+  LatencyHistogram()
+    : counts_(kBucketCount, 0),
+      count_(0),
+      max_(0)
+    {}
+
+  static int Index(uint64_t value) {
+    if (value < 2 * kSubBucketCount) {
+      return (int)value;
+    }
+    const int shift = 63 - __builtin_clzll(value) - kSubBucketBits;
+    return shift * kSubBucketCount + (int)(value >> shift);
+  }
+
+  //Highest value that maps into the same bucket.
+  static uint64_t HighestEquivalentValue(int idx) {
+    if (idx < 2 * kSubBucketCount) {
+      return (uint64_t)idx;
+    }
+    const int shift = idx / kSubBucketCount - 1;
+    const uint64_t top = (uint64_t)(idx - shift * kSubBucketCount);
+    return ((top + 1) << shift) - 1;
+  }
+
+  void Record(uint64_t value) {
+    counts_[Index(value)]++;
+    count_++;
+    if (max_ < value) {
+      max_ = value;
+    }
+  }
+
+  void Add(const LatencyHistogram& other) {
+    for (int i = 0; i < kBucketCount; i++) {
+      counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    if (max_ < other.max_) {
+      max_ = other.max_;
+    }
+  }
+
+  uint64_t Percentile(double pct) const {
+    if (count_ <= 0) {
+      return 0;
+    }
+    uint64_t target = (uint64_t)ceil(pct / 100. * (double)count_);
+    if (target <= 0) {
+      target = 1;
+    }
+    uint64_t total = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+      total += counts_[i];
+      if (target <= total) {
+        const uint64_t value = HighestEquivalentValue(i);
+        return (value < max_ ? value : max_);
+      }
+    }
+    return max_;
+  }
+
+  uint64_t Count() const { return count_; }
+  uint64_t Max() const { return max_; }
+
+  //Non empty buckets as value:count pairs, where value is the highest
+  //equivalent value of the bucket.
+  void Write(ostream& os) const {
+    const char* sep = "";
+    for (int i = 0; i < kBucketCount; i++) {
+      if (counts_[i] > 0) {
+        os << sep << HighestEquivalentValue(i) << ":" << counts_[i];
+        sep = ",";
+      }
+    }
+  }
+
+private:
+  vector<uint64_t> counts_;
+  uint64_t count_;
+  uint64_t max_;
+};
+
+enum LoadOp {
+  kLoadOpStat,
+  kLoadOpReaddir,
+  kLoadOpCreate,
+  kLoadOpRename,
+  kLoadOpDelete,
+  kLoadOpGetAlloc,
+  kLoadOpCount
+};
+
+const char* const kLoadOpNames[kLoadOpCount] = {
+  "stat",
+  "readdir",
+  "create",
+  "rename",
+  "delete",
+  "getalloc"
+};
+
+struct LoadOpStats {
+  LatencyHistogram hist_;
+  uint64_t errors_;
+
+  LoadOpStats() : hist_(), errors_(0) {}
+};
+
+struct LoadThread {
+  Client* client_;
+  int threadIdx_;
+  const vector<int>* mix_;
+  struct timespec start_;
+  double intervalUsec_;
+  uint64_t durationUsec_;
+  string baseDir_;
+  string scratchDir_;
+  string allocFile_;
+  vector<string> files_;
+  uint64_t nameSeq_;
+  unsigned int seed_;
+  int err_;
+  LoadOpStats stats_[kLoadOpCount];
+  pthread_t thread_;
+};
+
+uint64_t TimeDiffMicroSec(const struct timespec& alpha,
+    const struct timespec& zigma)
+{
+  const int64_t diff = (int64_t)(zigma.tv_sec - alpha.tv_sec) * 1000000 +
+    (zigma.tv_nsec - alpha.tv_nsec) / 1000;
+  return diff < 0 ? 0 : (uint64_t)diff;
+}
+
+void AddMicroSec(struct timespec& ts, uint64_t usec)
+{
+  const uint64_t nsec = (uint64_t)ts.tv_nsec + (usec % 1000000) * 1000;
+  ts.tv_sec += (time_t)(usec / 1000000 + nsec / 1000000000);
+  ts.tv_nsec = (long)(nsec % 1000000000);
+}
+
+//Parses op mix into a weight table with one entry per op type.
+bool ParseLoadMix(const string& mix, vector<int>& weights)
+{
+  weights.assign(kLoadOpCount, 0);
+  istringstream is(mix);
+  string token;
+  int total = 0;
+  while (getline(is, token, ',')) {
+    const size_t pos = token.find(':');
+    const string name = token.substr(0, pos);
+    const int weight = pos == string::npos ? 1 :
+      atoi(token.substr(pos + 1).c_str());
+    int op = 0;
+    while (op < kLoadOpCount && name != kLoadOpNames[op]) {
+      op++;
+    }
+    if (op >= kLoadOpCount || weight < 0) {
+      fprintf(logFile, "Error: invalid load mix entry '%s'\n", token.c_str());
+      return false;
+    }
+    weights[op] += weight;
+    total += weight;
+  }
+  if (total <= 0) {
+    fprintf(logFile, "Error: empty load mix '%s'\n", mix.c_str());
+    return false;
+  }
+  return true;
+}
+
+LoadOp PickLoadOp(LoadThread& lt)
+{
+  int total = 0;
+  for (int i = 0; i < kLoadOpCount; i++) {
+    total += (*lt.mix_)[i];
+  }
+  int val = rand_r(&lt.seed_) % total;
+  for (int i = 0; i < kLoadOpCount; i++) {
+    if (val < (*lt.mix_)[i]) {
+      return (LoadOp)i;
+    }
+    val -= (*lt.mix_)[i];
+  }
+  return kLoadOpStat;
+}
+
+//Random path in the planned tree with the given depth.
+string RandomTreePath(LoadThread& lt, int depth)
+{
+  Client* const client = lt.client_;
+  string path = lt.baseDir_;
+  char sfx[32];
+  for (int d = 0; d < depth; d++) {
+    myitoa(rand_r(&lt.seed_) % client->inodesPerLevel_, sfx);
+    path += "/";
+    path += client->prefix_;
+    path += sfx;
+  }
+  return path;
+}
+
+string NextScratchName(LoadThread& lt, const char* prefix)
+{
+  ostringstream os;
+  os << lt.scratchDir_ << "/" << prefix << lt.nameSeq_++;
+  return os.str();
+}
+
+int RunLoadOp(LoadThread& lt, KFS::KfsClient* kfsClient, LoadOp& op)
+{
+  if ((op == kLoadOpRename || op == kLoadOpDelete) && lt.files_.empty()) {
+    //Nothing to rename or delete yet.
+    op = kLoadOpCreate;
+  }
+  switch (op) {
+    case kLoadOpStat: {
+      KFS::KfsFileAttr attr;
+      return kfsClient->Stat(
+        RandomTreePath(lt, lt.client_->levels_).c_str(), attr);
+    }
+    case kLoadOpReaddir: {
+      vector<KFS::KfsFileAttr> children;
+      return kfsClient->ReaddirPlus(
+        RandomTreePath(lt, lt.client_->levels_ - 1).c_str(), children);
+    }
+    case kLoadOpCreate: {
+      const string path = NextScratchName(lt, "f_");
+      const int fd = kfsClient->Create(path.c_str());
+      if (fd < 0) {
+        return fd;
+      }
+      kfsClient->Close(fd);
+      lt.files_.push_back(path);
+      return 0;
+    }
+    case kLoadOpRename: {
+      string& path = lt.files_[rand_r(&lt.seed_) % lt.files_.size()];
+      const string newPath = NextScratchName(lt, "r_");
+      const int err = kfsClient->Rename(path.c_str(), newPath.c_str());
+      if (err == 0) {
+        path = newPath;
+      }
+      return err;
+    }
+    case kLoadOpDelete: {
+      const size_t idx = rand_r(&lt.seed_) % lt.files_.size();
+      const string path = lt.files_[idx];
+      lt.files_[idx] = lt.files_.back();
+      lt.files_.pop_back();
+      return kfsClient->Remove(path.c_str());
+    }
+    case kLoadOpGetAlloc: {
+      vector< vector<string> > locations;
+      return kfsClient->GetDataLocation(
+        lt.allocFile_.c_str(), 0, 1, locations);
+    }
+    default:
+      break;
+  }
+  return -EINVAL;
+}
+
+int SetupLoadThread(LoadThread& lt, KFS::KfsClient* kfsClient)
+{
+  ostringstream os;
+  os << lt.baseDir_ << "/load_" << lt.threadIdx_;
+  lt.scratchDir_ = os.str();
+  kfsClient->RmdirsFast(lt.scratchDir_.c_str());
+  int err = kfsClient->Mkdirs(lt.scratchDir_.c_str());
+  if (err && err != -EEXIST) {
+    fprintf(logFile, "Error [err=%d] mkdir %s\n", err, lt.scratchDir_.c_str());
+    return err;
+  }
+  if ((*lt.mix_)[kLoadOpGetAlloc] <= 0) {
+    return 0;
+  }
+  lt.allocFile_ = lt.scratchDir_ + "/alloc";
+  const int fd = kfsClient->Open(lt.allocFile_.c_str(),
+    O_CREAT | O_TRUNC | O_WRONLY);
+  if (fd < 0) {
+    fprintf(logFile, "Error [err=%d] creating %s\n", fd, lt.allocFile_.c_str());
+    return fd;
+  }
+  const char data = 0;
+  const ssize_t nwr = kfsClient->Write(fd, &data, 1);
+  err = kfsClient->Close(fd);
+  if (nwr != 1 || err) {
+    fprintf(logFile, "Error [err=%d] writing %s\n",
+      nwr != 1 ? (int)nwr : err, lt.allocFile_.c_str());
+    return nwr < 0 ? (int)nwr : (err ? err : -EIO);
+  }
+  return 0;
+}
+
+void* RunLoadThread(void* arg)
+{
+  LoadThread& lt = *reinterpret_cast<LoadThread*>(arg);
+  AutoCleanupKfsClient kfs(lt.client_);
+  if (!kfs.IsInitialized()) {
+    fprintf(logFile, "kfs client failed to initialize.\n");
+    lt.err_ = -EINVAL;
+    return 0;
+  }
+  KFS::KfsClient* const kfsClient = kfs.GetClient();
+  if ((lt.err_ = SetupLoadThread(lt, kfsClient)) != 0) {
+    return 0;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  //Start all threads at the same time, and stagger the open loop thread
+  //schedules evenly within the inter op interval.
+  struct timespec next = lt.start_;
+  if (lt.intervalUsec_ > 0) {
+    AddMicroSec(next, (uint64_t)(lt.intervalUsec_ * lt.threadIdx_ /
+      lt.client_->loadThreads_));
+  }
+  uint64_t opCount = 0;
+  for (; ;) {
+    if (TimeDiffMicroSec(now, next) > 0) {
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (lt.durationUsec_ <= TimeDiffMicroSec(lt.start_, now)) {
+      break;
+    }
+    //In the open loop mode the latency includes the time the op was
+    //waiting for the previous op to complete past its scheduled start.
+    const struct timespec opStart = lt.intervalUsec_ > 0 ? next : now;
+    LoadOp op = PickLoadOp(lt);
+    const int err = RunLoadOp(lt, kfsClient, op);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    LoadOpStats& stats = lt.stats_[op];
+    stats.hist_.Record(TimeDiffMicroSec(opStart, now));
+    if (err < 0) {
+      if (stats.errors_++ < 10) {
+        fprintf(logFile, "Error [err=%d] %s\n", err, kLoadOpNames[op]);
+      }
+    }
+    opCount++;
+    if (lt.intervalUsec_ > 0) {
+      next = lt.start_;
+      AddMicroSec(next, (uint64_t)(lt.intervalUsec_ *
+        ((double)opCount + (double)lt.threadIdx_ / lt.client_->loadThreads_)));
+    } else {
+      next = now;
+    }
+  }
+  kfsClient->RmdirsFast(lt.scratchDir_.c_str());
+  return 0;
+}
+
+void WriteLoadResult(Client* client, const char* opName,
+    const LatencyHistogram& hist, uint64_t errors, uint64_t elapsedUsec)
+{
+  ostringstream os;
+  os << "mstress_result:"
+    " test=load"
+    " host=" << client->hostName_ <<
+    " process=" << client->processName_ <<
+    " op=" << opName <<
+    " threads=" << client->loadThreads_ <<
+    " target_rate=" << client->loadRate_ <<
+    " count=" << hist.Count() <<
+    " errors=" << errors <<
+    " elapsed_usec=" << elapsedUsec <<
+    " rate=" << (elapsedUsec > 0 ?
+      (double)hist.Count() * 1e6 / (double)elapsedUsec : 0.) <<
+    " p50_usec=" << hist.Percentile(50) <<
+    " p90_usec=" << hist.Percentile(90) <<
+    " p99_usec=" << hist.Percentile(99) <<
+    " p999_usec=" << hist.Percentile(99.9) <<
+    " max_usec=" << hist.Max() <<
+    " hist=";
+  hist.Write(os);
+  fprintf(logFile, "%s\n", os.str().c_str());
+}
+
+int LoadDFSPaths(Client* client)
+{
+  vector<int> mix;
+  if (!ParseLoadMix(client->loadMix_, mix)) {
+    return -EINVAL;
+  }
+  ostringstream os;
+  os << TEST_BASE_DIR << "/" << client->hostName_ + "_" << client->processName_;
+  fprintf(logFile, "Load: duration=%d sec rate=%g threads=%d mix=%s\n",
+    client->loadDuration_, client->loadRate_, client->loadThreads_,
+    client->loadMix_.c_str());
+
+  const int nthreads = client->loadThreads_;
+  vector<LoadThread> threads(nthreads);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  //Leave time for the connection and setup.
+  AddMicroSec(start, 1000000);
+  const unsigned int seed = (unsigned int)time(NULL) ^ (unsigned int)getpid();
+  int err = 0;
+  int started = 0;
+  for (int i = 0; i < nthreads; i++) {
+    LoadThread& lt = threads[i];
+    lt.client_ = client;
+    lt.threadIdx_ = i;
+    lt.mix_ = &mix;
+    lt.start_ = start;
+    lt.intervalUsec_ = client->loadRate_ > 0 ?
+      1e6 * nthreads / client->loadRate_ : 0;
+    lt.durationUsec_ = (uint64_t)client->loadDuration_ * 1000000;
+    lt.baseDir_ = os.str();
+    lt.nameSeq_ = 0;
+    lt.seed_ = seed + i * 7919;
+    lt.err_ = 0;
+    if ((err = pthread_create(&lt.thread_, 0, &RunLoadThread, &lt)) != 0) {
+      fprintf(logFile, "Error [err=%d] pthread_create\n", err);
+      err = -err;
+      break;
+    }
+    started++;
+  }
+  LoadOpStats total[kLoadOpCount];
+  LatencyHistogram all;
+  uint64_t allErrors = 0;
+  for (int i = 0; i < started; i++) {
+    LoadThread& lt = threads[i];
+    pthread_join(lt.thread_, 0);
+    if (lt.err_) {
+      err = lt.err_;
+    }
+    for (int k = 0; k < kLoadOpCount; k++) {
+      total[k].hist_.Add(lt.stats_[k].hist_);
+      total[k].errors_ += lt.stats_[k].errors_;
+      all.Add(lt.stats_[k].hist_);
+      allErrors += lt.stats_[k].errors_;
+    }
+  }
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  const uint64_t elapsedUsec = TimeDiffMicroSec(start, end);
+  if (err) {
+    fprintf(logFile, "Error: load test failed err=%d\n", err);
+    return err;
+  }
+  for (int k = 0; k < kLoadOpCount; k++) {
+    if (total[k].hist_.Count() > 0) {
+      WriteLoadResult(client, kLoadOpNames[k], total[k].hist_,
+        total[k].errors_, elapsedUsec);
+    }
+  }
+  WriteLoadResult(client, "all", all, allErrors, elapsedUsec);
+  fprintf(logFile, "Client: Load done %llu ops in %llu msec,"
+    " p50 %llu usec, p99 %llu usec, %llu errors\n",
+    (unsigned long long)all.Count(),
+    (unsigned long long)(elapsedUsec / 1000),
+    (unsigned long long)all.Percentile(50),
+    (unsigned long long)all.Percentile(99),
+    (unsigned long long)allErrors);
+  return 0;
+}
+
 int main(int argc, char* argv[])
 {
   Client client;
@@ -596,6 +1164,8 @@ int main(int argc, char* argv[])
     result = ListDFSPaths(&client, &kfs);
   } else if (client.testName_ == "delete") {
     result = RemoveDFSPaths(&client, &kfs);
+  } else if (client.testName_ == "load") {
+    result = LoadDFSPaths(&client);
   } else {
     fprintf(logFile, "Error: unrecognized test '%s'", client.testName_.c_str());
     return -1;
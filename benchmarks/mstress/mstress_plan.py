@@ -87,6 +87,27 @@ def ParseCommandline():
                     default=100,
                     type='int',
                     help='Number of inodes to stat (<=total leaf inodes).')
+  parser.add_option('--load-duration',
+                    action='store',
+                    default=0,
+                    type='int',
+                    help='Load test duration in seconds, 0 disables load test.')
+  parser.add_option('--load-rate',
+                    action='store',
+                    default=0,
+                    type='float',
+                    help='Load test target op rate per client process,' +
+                         ' 0 for closed loop.')
+  parser.add_option('--load-threads',
+                    action='store',
+                    default=4,
+                    type='int',
+                    help='Load test concurrency per client process.')
+  parser.add_option('--load-mix',
+                    action='store',
+                    default='stat:60,readdir:10,create:10,rename:10,delete:5,getalloc:5',
+                    type='string',
+                    help='Load test op mix, comma separated op:weight list.')
   parser.add_option('-o', '--output-file',
                     action='store',
                     default=None,
@@ -123,6 +144,10 @@ def main():
   outfile.write('#Number of levels in created tree\nlevels=%d\n' % opts.levels)
   outfile.write('#Number of inodes per level\ninodes=%d\n' % opts.inodes_per_level)
   outfile.write('#Number of random paths to stat, per client\nnstat=%d\n' % statPerClient)
+  outfile.write('#Load test duration in seconds, 0 -- no load test\nloadduration=%d\n' % opts.load_duration)
+  outfile.write('#Load test target op rate per client, 0 -- closed loop\nloadrate=%g\n' % opts.load_rate)
+  outfile.write('#Load test threads per client\nloadthreads=%d\n' % opts.load_threads)
+  outfile.write('#Load test op mix\nloadmix=%s\n' % opts.load_mix)
   
   """ old code
   begin_tree_delta = 0
@@ -32,6 +32,7 @@ import commands
 import resource
 import getpass
 import re
+import math
 
 class Params:
   TARGETS           = []
@@ -40,16 +41,27 @@ class Params:
   PATH_TYPE         = "dir"
   PATH_LEVELS       = 3
   INODES_PER_LEVEL  = 16
+  LOAD_DURATION     = 0
+  LOAD_RATE         = 0
+  LOAD_THREADS      = 4
+  LOAD_MIX          = 'stat:60,readdir:10,create:10,rename:10,delete:5,getalloc:5'
+  RESULTS_FILE      = None
   def NumFiles2Stat():
     return Params.INODES_PER_LEVEL**Params.PATH_LEVELS*Params.CLIENTS_PER_HOST*len(Params.CLIENT_HOSTS.split(","))/2
   NumFiles2Stat = staticmethod(NumFiles2Stat)
 
 def Usage():
-  print 'Usage: %s [clients] [fs_type,fs_host,fs_port] [fs_type,fs_host,fs_port]..' % sys.argv[0]
+  print 'Usage: %s [load options] [clients] [fs_type,fs_host,fs_port] [fs_type,fs_host,fs_port]..' % sys.argv[0]
   print '       clients: comma separated list of client host names'
   print '       fs_type: qfs or hdfs'
   print '       fs_host: metaserver or namenode hostname'
   print '       fs_port: metaserver or namenode port'
+  print '       load options (qfs only):'
+  print '         --load-duration=<sec>     run load test, 0 -- no load test (default)'
+  print '         --load-rate=<ops/sec>     target rate per client process, 0 -- closed loop'
+  print '         --load-threads=<n>        concurrency per client process'
+  print '         --load-mix=<op:weight,..> ops: stat readdir create rename delete getalloc'
+  print '         --results-file=<file>     append aggregated load results as key=value lines'
   print 'Eg: %s 10.15.20.25,10.20.25.30 qfs,10.10.10.10,10000 hdfs,20.20.20.20,20000'
   sys.exit(0)
 
@@ -68,6 +80,10 @@ def MakePlan():
                    "--levels",           str(Params.PATH_LEVELS),
                    "--inodes-per-level", str(Params.INODES_PER_LEVEL),
                    "--num-to-stat",      str(Params.NumFiles2Stat()),
+                   "--load-duration",    str(Params.LOAD_DURATION),
+                   "--load-rate",        str(Params.LOAD_RATE),
+                   "--load-threads",     str(Params.LOAD_THREADS),
+                   "--load-mix",         Params.LOAD_MIX,
                    "-o",                 plan_file])
   return plan_file
 
@@ -111,24 +127,94 @@ def PrintResult(type, result):
   PrintMsg("\nBenchmark results for '%s':" % type)
   for m in re.findall(r"(\w+) test took (\S+) sec",result):
     PrintMsg("%-10s: %s sec"%(m[0],m[1]))
+  PrintLoadResult(type, result)
   PrintMsg("\n%s\n==========================================" %
             re.search(r"Memory usage .*$", result, re.MULTILINE).group(0))
 
 
+# hist is sorted list of (value, count) pairs, where value is the bucket
+# highest equivalent value in usec, as emitted by mstress_client.
+def Percentile(hist, count, pct):
+  target = max(1, int(math.ceil(pct / 100.0 * count)))
+  total = 0
+  for value, cnt in hist:
+    total += cnt
+    if target <= total:
+      return value
+  if hist:
+    return hist[-1][0]
+  return 0
+
+
+# Aggregates per client process load test results by op type. The histograms
+# are merged, therefore the percentiles are over all ops of all clients, and
+# the rates are summed.
+def PrintLoadResult(type, result):
+  ops = {}
+  for line in re.findall(r"mstress_result: (test=load .*)$", result, re.MULTILINE):
+    fields = dict(f.split('=', 1) for f in line.split() if '=' in f)
+    agg = ops.setdefault(fields['op'],
+      {'clients': 0, 'count': 0, 'errors': 0, 'rate': 0.0, 'max': 0, 'hist': {}})
+    agg['clients'] += 1
+    agg['count']   += int(fields['count'])
+    agg['errors']  += int(fields['errors'])
+    agg['rate']    += float(fields['rate'])
+    agg['max']      = max(agg['max'], int(fields['max_usec']))
+    if fields.get('hist'):
+      for pair in fields['hist'].split(','):
+        value, cnt = pair.split(':')
+        agg['hist'][int(value)] = agg['hist'].get(int(value), 0) + int(cnt)
+  if not ops:
+    return
+  lines = []
+  PrintMsg("\nLoad test results for '%s' (latency in usec):" % type)
+  PrintMsg("%-10s %8s %10s %8s %12s %8s %8s %8s %8s %8s" % (
+    'op', 'clients', 'count', 'errors', 'ops/sec', 'p50', 'p90', 'p99', 'p99.9', 'max'))
+  for op in sorted(ops.keys()):
+    agg = ops[op]
+    hist = sorted(agg['hist'].items())
+    pcts = [min(Percentile(hist, agg['count'], p), agg['max'])
+            for p in (50, 90, 99, 99.9)]
+    vals = [op, agg['clients'], agg['count'], agg['errors'], agg['rate']] + \
+      pcts + [agg['max']]
+    PrintMsg("%-10s %8d %10d %8d %12.1f %8d %8d %8d %8d %8d" % tuple(vals))
+    lines.append(('fs=%s op=%s clients=%d count=%d errors=%d rate=%.1f' +
+      ' p50_usec=%d p90_usec=%d p99_usec=%d p999_usec=%d max_usec=%d\n') %
+      tuple([type] + vals))
+  if Params.RESULTS_FILE:
+    f = open(Params.RESULTS_FILE, 'a')
+    f.writelines(lines)
+    f.close()
+    PrintMsg("Load test results appended to %s" % Params.RESULTS_FILE)
+
+
 def ParseArgs():
-  argc = len(sys.argv)
-  if argc <= 1 or sys.argv[1].startswith('-') or argc < 3:
+  parser = optparse.OptionParser(add_help_option=False)
+  parser.add_option('--load-duration', type='int', default=Params.LOAD_DURATION)
+  parser.add_option('--load-rate', type='float', default=Params.LOAD_RATE)
+  parser.add_option('--load-threads', type='int', default=Params.LOAD_THREADS)
+  parser.add_option('--load-mix', type='string', default=Params.LOAD_MIX)
+  parser.add_option('--results-file', type='string', default=None)
+  parser.add_option('-h', '--help', action='store_true', default=False)
+  opts, args = parser.parse_args()
+  argc = len(args)
+  if opts.help or argc < 2:
     Usage()
 
-  Params.CLIENT_HOSTS = sys.argv[1].strip()
+  Params.LOAD_DURATION = opts.load_duration
+  Params.LOAD_RATE     = opts.load_rate
+  Params.LOAD_THREADS  = opts.load_threads
+  Params.LOAD_MIX      = opts.load_mix
+  Params.RESULTS_FILE  = opts.results_file
+  Params.CLIENT_HOSTS  = args[0].strip()
 
-  triple = sys.argv[2].strip().split(',')
+  triple = args[1].strip().split(',')
   if len(triple) != 3 or triple[0] not in ('qfs', 'hdfs'):
     Usage()
   Params.TARGETS.append(triple)
 
-  if argc > 3:
-    triple = sys.argv[3].strip().split(',')
+  if argc > 2:
+    triple = args[2].strip().split(',')
     if len(triple) != 3 or triple[0] not in ('qfs', 'hdfs'):
       Usage()
     Params.TARGETS.append(triple)
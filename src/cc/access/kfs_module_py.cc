@@ -357,8 +357,11 @@ qfs_close(PyObject *pself, PyObject *args)
     qfs_File *self = (qfs_File *)pself;
     qfs_Client *cl = (qfs_Client *)self->pclient;
     if (self->fd != -1) {
-        cl->client->Close(self->fd);
+        const int fd = self->fd;
         self->fd = -1;
+        Py_BEGIN_ALLOW_THREADS
+        cl->client->Close(fd);
+        Py_END_ALLOW_THREADS
     }
     Py_RETURN_NONE;
 }
@@ -383,7 +386,10 @@ qfs_read(PyObject *pself, PyObject *args)
         return NULL;
 
     char *buf = PyString_AsString(v);
-    ssize_t nr = cl->client->Read(self->fd, buf, rsize);
+    ssize_t nr;
+    Py_BEGIN_ALLOW_THREADS
+    nr = cl->client->Read(self->fd, buf, rsize);
+    Py_END_ALLOW_THREADS
     if (nr < 0) {
         Py_DECREF(v);
         SetPyIoError(nr);
@@ -394,31 +400,68 @@ qfs_read(PyObject *pself, PyObject *args)
     return v;
 }
 
+// Read directly into writable buffer protocol object, such as bytearray,
+// memoryview, or numpy array, without intermediate string allocation and
+// copy. The interpreter lock is released during the read.
+static PyObject *
+qfs_readinto(PyObject *pself, PyObject *args)
+{
+    qfs_File *self = (qfs_File *)pself;
+    qfs_Client *cl = (qfs_Client *)self->pclient;
+    Py_buffer pbuf;
+
+    if (!PyArg_ParseTuple(args, "w*", &pbuf))
+        return NULL;
+
+    if (self->fd == -1) {
+        PyBuffer_Release(&pbuf);
+        SetPyIoError(-EBADF);
+        return NULL;
+    }
+
+    ssize_t nr;
+    Py_BEGIN_ALLOW_THREADS
+    nr = cl->client->Read(self->fd, (char *)pbuf.buf, (size_t)pbuf.len);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&pbuf);
+    if (nr < 0) {
+        SetPyIoError(nr);
+        return NULL;
+    }
+    return Py_BuildValue("n", (Py_ssize_t)nr);
+}
+
 static PyObject *
 qfs_write(PyObject *pself, PyObject *args)
 {
     qfs_File *self = (qfs_File *)pself;
     qfs_Client *cl = (qfs_Client *)self->pclient;
-    int wsize = -1;
-    char *buf = NULL;
+    Py_buffer pbuf;
 
-    if (!PyArg_ParseTuple(args, "s#", &buf, &wsize))
+    // Accept string and any buffer protocol object.
+    if (!PyArg_ParseTuple(args, "s*", &pbuf))
         return NULL;
 
     if (self->fd == -1) {
+        PyBuffer_Release(&pbuf);
         SetPyIoError(EBADF);
         return NULL;
     }
 
-    ssize_t nw = cl->client->Write(self->fd, buf, (ssize_t)wsize);
+    const Py_ssize_t wsize = pbuf.len;
+    ssize_t nw;
+    Py_BEGIN_ALLOW_THREADS
+    nw = cl->client->Write(self->fd, (const char *)pbuf.buf, (size_t)wsize);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&pbuf);
     if (nw < 0) {
         SetPyIoError(nw);
         return NULL;
     }
     if (nw != wsize) {
         PyObject *msg = PyString_FromFormat(
-            "requested write of %d bytes but %ld were written",
-            wsize, (long)nw);
+            "requested write of %ld bytes but %ld were written",
+            (long)wsize, (long)nw);
         return msg;
     }
     Py_RETURN_NONE;
@@ -509,7 +552,10 @@ qfs_sync(PyObject *pself, PyObject *args)
 {
     qfs_File *self = (qfs_File *)pself;
     qfs_Client *cl = (qfs_Client *)self->pclient;
-    int s = cl->client->Sync(self->fd);
+    int s;
+    Py_BEGIN_ALLOW_THREADS
+    s = cl->client->Sync(self->fd);
+    Py_END_ALLOW_THREADS
     if (s < 0) {
         SetPyIoError(s);
         return NULL;
@@ -564,6 +610,7 @@ static PyMethodDef File_methods[] = {
     { "open",             qfs_reopen,         METH_VARARGS, "Open a closed file." },
     { "close",            qfs_close,          METH_NOARGS,  "Close file." },
     { "read",             qfs_read,           METH_VARARGS, "Read from file." },
+    { "readinto",         qfs_readinto,       METH_VARARGS, "Read from file into buffer." },
     { "write",            qfs_write,          METH_VARARGS, "Write to file." },
     { "truncate",         qfs_truncate,       METH_VARARGS, "Truncate a file." },
     { "chunk_locations",  qfs_chunkLocations, METH_VARARGS, "Get location(s) of a chunk." },
@@ -591,7 +638,8 @@ PyDoc_STRVAR(File_doc,
 "\topen([mode]) -- reopen closed file\n"
 "\tclose()     -- close file\n"
 "\tread(len)   -- read len bytes, return as string\n"
-"\twrite(str)  -- write string to file\n"
+"\treadinto(buf) -- read into writable buffer, return number of bytes read\n"
+"\twrite(buf)  -- write string or buffer to file\n"
 "\ttruncate(off) -- truncate file at specified offset\n"
 "\tseek(off)   -- seek to specified offset\n"
 "\ttell()      -- return current offest\n"
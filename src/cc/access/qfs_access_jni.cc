@@ -42,6 +42,8 @@ using std::ostringstream;
 
 #include <fcntl.h>
 #include "libclient/KfsClient.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
 using namespace KFS;
 
 extern "C" {
@@ -78,6 +80,11 @@ extern "C" {
     jobjectArray Java_com_quantcast_qfs_access_KfsAccess_readdir(
         JNIEnv *jenv, jclass jcls, jlong jptr, jstring jpath, jboolean jpreloadattr);
 
+    jint Java_com_quantcast_qfs_access_KfsAccess_readFiles(
+        JNIEnv *jenv, jclass jcls, jlong jptr, jobjectArray jpaths,
+        jint jmaxPendingFiles, jlong jmaxFileSize, jobjectArray jresults,
+        jintArray jstatus);
+
     jint Java_com_quantcast_qfs_access_KfsAccess_remove(
         JNIEnv *jenv, jclass jcls, jlong jptr, jstring jpath);
 
@@ -231,6 +238,15 @@ extern "C" {
     jint Java_com_quantcast_qfs_access_KfsInputChannel_read(
         JNIEnv *jenv, jclass jcls, jlong jptr, jint jfd, jobject buf, jint begin, jint end);
 
+    jint Java_com_quantcast_qfs_access_KfsInputChannel_pread(
+        JNIEnv *jenv, jclass jcls, jlong jptr, jint jfd, jlong jpos,
+        jobject buf, jint begin, jint end);
+
+    jint Java_com_quantcast_qfs_access_KfsInputChannel_preadv(
+        JNIEnv *jenv, jclass jcls, jlong jptr, jint jfd,
+        jlongArray jpositions, jobjectArray jbufs, jintArray jbegins,
+        jintArray jends, jintArray jresults);
+
     jint Java_com_quantcast_qfs_access_KfsInputChannel_close(
         JNIEnv *jenv, jclass jcls, jlong jptr, jint jfd);
 
@@ -423,6 +439,78 @@ jobjectArray Java_com_quantcast_qfs_access_KfsAccess_readdir(
     return jentries;
 }
 
+namespace
+{
+    // Copies the file contents into the java byte arrays.
+    class ReadFilesCompletion : public KfsClient::ReadFilesCompletion
+    {
+    public:
+        ReadFilesCompletion(JNIEnv* jenv, jobjectArray jresults,
+            vector<jint>& status)
+            : KfsClient::ReadFilesCompletion(),
+              jenv(jenv),
+              jresults(jresults),
+              status(status)
+            {}
+        virtual void Done(size_t index, const string& /* path */,
+            const char* buf, ssize_t res)
+        {
+            status[index] = (jint)res;
+            if (res < 0 || jenv->ExceptionCheck()) {
+                return;
+            }
+            jbyteArray const jbuf = jenv->NewByteArray((jsize)res);
+            if (! jbuf) {
+                status[index] = -ENOMEM;
+                return;
+            }
+            if (0 < res) {
+                jenv->SetByteArrayRegion(jbuf, 0, (jsize)res,
+                    reinterpret_cast<const jbyte*>(buf));
+            }
+            jenv->SetObjectArrayElement(jresults, (jsize)index, jbuf);
+            jenv->DeleteLocalRef(jbuf);
+        }
+    private:
+        JNIEnv* const      jenv;
+        jobjectArray const jresults;
+        vector<jint>&      status;
+    };
+}
+
+jint Java_com_quantcast_qfs_access_KfsAccess_readFiles(
+    JNIEnv *jenv, jclass jcls, jlong jptr, jobjectArray jpaths,
+    jint jmaxPendingFiles, jlong jmaxFileSize, jobjectArray jresults,
+    jintArray jstatus)
+{
+    if (! jptr) {
+        return -EFAULT;
+    }
+    if (! jpaths || ! jresults || ! jstatus) {
+        return -EINVAL;
+    }
+    const jsize cnt = jenv->GetArrayLength(jpaths);
+    if (jenv->GetArrayLength(jresults) != cnt ||
+            jenv->GetArrayLength(jstatus) != cnt) {
+        return -EINVAL;
+    }
+    vector<string> paths(cnt);
+    for (jsize i = 0; i < cnt; i++) {
+        jstring const jpath = (jstring)jenv->GetObjectArrayElement(jpaths, i);
+        setStr(paths[i], jenv, jpath);
+        jenv->DeleteLocalRef(jpath);
+    }
+    KfsClient* const    clnt = (KfsClient*)jptr;
+    vector<jint>        status(cnt, 0);
+    ReadFilesCompletion completion(jenv, jresults, status);
+    const int ret = clnt->ReadFiles(
+        paths, completion, jmaxPendingFiles, jmaxFileSize);
+    if (0 < cnt) {
+        jenv->SetIntArrayRegion(jstatus, 0, cnt, &status[0]);
+    }
+    return ret;
+}
+
 jint Java_com_quantcast_qfs_access_KfsAccess_open(
     JNIEnv *jenv, jclass jcls, jlong jptr, jstring jpath, jstring jmode,
     jint jnumReplicas, jint jnumStripes, jint jnumRecoveryStripes,
@@ -1550,6 +1638,162 @@ jint Java_com_quantcast_qfs_access_KfsInputChannel_read(
     return (jint)sz;
 }
 
+jint Java_com_quantcast_qfs_access_KfsInputChannel_pread(
+    JNIEnv *jenv, jclass jcls, jlong jptr, jint jfd, jlong jpos,
+    jobject buf, jint begin, jint end)
+{
+    if (! jptr) {
+        return -EFAULT;
+    }
+    KfsClient* const clnt = (KfsClient*)jptr;
+
+    if (! buf || jpos < 0) {
+        return 0;
+    }
+    void * addr = jenv->GetDirectBufferAddress(buf);
+    jlong cap = jenv->GetDirectBufferCapacity(buf);
+
+    if (! addr || cap < 0) {
+        return 0;
+    }
+    if(begin < 0 || end > cap || begin > end) {
+        return 0;
+    }
+    addr = (void *)(uintptr_t(addr) + begin);
+
+    ssize_t sz = clnt->PRead((int) jfd, (chunkOff_t) jpos, (char *) addr,
+        (size_t) (end - begin));
+    return (jint)sz;
+}
+
+namespace
+{
+    // Waits for the completion of all asynchronous reads issued by preadv.
+    class PReadVCompletion : public KfsClient::IoCompletion
+    {
+    public:
+        PReadVCompletion(jint* results)
+            : KfsClient::IoCompletion(),
+              mutex(),
+              cond(),
+              results(results),
+              index(),
+              pending(0)
+            {}
+        void Add(char* buf, jsize idx)
+            { index.push_back(std::make_pair(buf, idx)); }
+        void Issued()
+        {
+            QCStMutexLocker locker(mutex);
+            pending++;
+        }
+        void Wait()
+        {
+            QCStMutexLocker locker(mutex);
+            while (0 < pending) {
+                cond.Wait(mutex);
+            }
+        }
+        virtual void Done(int /* fd */, chunkOff_t /* pos */, char* buf,
+            ssize_t status)
+        {
+            QCStMutexLocker locker(mutex);
+            for (size_t i = 0; i < index.size(); i++) {
+                if (index[i].first == buf) {
+                    results[index[i].second] = (jint)status;
+                    break;
+                }
+            }
+            if (--pending <= 0) {
+                cond.Notify();
+            }
+        }
+    private:
+        QCMutex                          mutex;
+        QCCondVar                        cond;
+        jint* const                      results;
+        vector<std::pair<char*, jsize> > index;
+        int                              pending;
+    };
+}
+
+jint Java_com_quantcast_qfs_access_KfsInputChannel_preadv(
+    JNIEnv *jenv, jclass jcls, jlong jptr, jint jfd,
+    jlongArray jpositions, jobjectArray jbufs, jintArray jbegins,
+    jintArray jends, jintArray jresults)
+{
+    if (! jptr) {
+        return -EFAULT;
+    }
+    KfsClient* const clnt = (KfsClient*)jptr;
+
+    if (! jpositions || ! jbufs || ! jbegins || ! jends || ! jresults) {
+        return -EINVAL;
+    }
+    const jsize cnt = jenv->GetArrayLength(jpositions);
+    if (jenv->GetArrayLength(jbufs) != cnt ||
+            jenv->GetArrayLength(jbegins) != cnt ||
+            jenv->GetArrayLength(jends) != cnt ||
+            jenv->GetArrayLength(jresults) != cnt) {
+        return -EINVAL;
+    }
+    if (cnt <= 0) {
+        return 0;
+    }
+    vector<jlong> positions(cnt);
+    vector<jint>  begins(cnt);
+    vector<jint>  ends(cnt);
+    vector<jint>  results(cnt, 0);
+    jenv->GetLongArrayRegion(jpositions, 0, cnt, &positions[0]);
+    jenv->GetIntArrayRegion(jbegins, 0, cnt, &begins[0]);
+    jenv->GetIntArrayRegion(jends, 0, cnt, &ends[0]);
+    vector<char*> addrs(cnt, (char*)0);
+    for (jsize i = 0; i < cnt; i++) {
+        jobject const buf = jenv->GetObjectArrayElement(jbufs, i);
+        if (! buf) {
+            return -EINVAL;
+        }
+        void* const addr = jenv->GetDirectBufferAddress(buf);
+        const jlong cap  = jenv->GetDirectBufferCapacity(buf);
+        jenv->DeleteLocalRef(buf);
+        if (! addr || cap < 0 || positions[i] < 0 ||
+                begins[i] < 0 || ends[i] > cap || begins[i] > ends[i]) {
+            return -EINVAL;
+        }
+        addrs[i] = (char*)addr + begins[i];
+    }
+    // The ranges are read concurrently with asynchronous reads, the
+    // completion finds the range by its buffer address, therefore the
+    // buffer ranges must not overlap.
+    PReadVCompletion completion(&results[0]);
+    for (jsize i = 0; i < cnt; i++) {
+        if (begins[i] < ends[i]) {
+            completion.Add(addrs[i], i);
+        }
+    }
+    jint ret = 0;
+    for (jsize i = 0; i < cnt; i++) {
+        if (ends[i] <= begins[i]) {
+            continue;
+        }
+        completion.Issued();
+        const ssize_t res = clnt->ReadAsync((int)jfd,
+            (chunkOff_t)positions[i], addrs[i],
+            (size_t)(ends[i] - begins[i]), completion);
+        if (res <= 0) {
+            // Completion is not invoked, 0 means end of file.
+            completion.Done((int)jfd, (chunkOff_t)positions[i], addrs[i],
+                res);
+            if (res < 0 && ret == 0) {
+                ret = (jint)res;
+            }
+        }
+    }
+    completion.Wait();
+    jenv->SetIntArrayRegion(jresults, 0, cnt, &results[0]);
+    return ret;
+}
+
 jint Java_com_quantcast_qfs_access_KfsOutputChannel_write(
     JNIEnv *jenv, jclass jcls, jlong jptr, jint jfd, jobject buf, jint begin, jint end)
 {
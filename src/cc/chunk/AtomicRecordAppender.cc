@@ -429,6 +429,7 @@ private:
     bool                    mMakeStableSucceededFlag:1;
     bool                    mFirstFwdOpFlag:1;
     bool                    mPendingBadChecksumFlag:1;
+    bool                    mGroupFlushPendingFlag:1;
     // Do not use bit field for mAppendInProgressFlag, as it can be read with no
     // mMutex acquired. See UpdateFlushLimit()
     bool                    mAppendInProgressFlag;
@@ -442,6 +443,12 @@ private:
     QCMutex* const          mMutex;
     RecordAppendOp*         mPendingSubmitQueue;
     int                     mFlushStartByteCount;
+    // Group flush: append byte rate in bytes per microsecond, and disk write
+    // time estimates.
+    int64_t                 mLastAppendUsec;
+    int64_t                 mWriteStartUsec;
+    double                  mAppendByteRate;
+    double                  mWriteUsecAvg;
     RecordAppendOp*         mReplicationList[1];
     AtomicRecordAppender*   mPrevPtr[1];
     AtomicRecordAppender*   mNextPtr[1];
@@ -481,6 +488,8 @@ private:
     void FlushSelf(bool flushFullChecksumBlocks);
     void FlushFullBlocks()
         { FlushSelf(true); }
+    void UpdateAppendRate(int nBytes);
+    bool DeferFlush(int flushLimit);
     void FlushAll()
         { FlushSelf(false); }
     int GetNextReplicationTimeout() const;
@@ -759,6 +768,7 @@ AtomicRecordAppender::AtomicRecordAppender(
       mMakeStableSucceededFlag(false),
       mFirstFwdOpFlag(true),
       mPendingBadChecksumFlag(false),
+      mGroupFlushPendingFlag(false),
       mAppendInProgressFlag(false),
       mInstanceNum(++sInstanceNum),
       mConsecutiveOutOfSpaceCount(0),
@@ -773,7 +783,11 @@ AtomicRecordAppender::AtomicRecordAppender(
       mPeer(peer),
       mMutex(mutex),
       mPendingSubmitQueue(0),
-      mFlushStartByteCount(-1)
+      mFlushStartByteCount(-1),
+      mLastAppendUsec(0),
+      mWriteStartUsec(0),
+      mAppendByteRate(0),
+      mWriteUsecAvg(0)
 {
     assert(
         chunkSize >= 0 &&
@@ -1672,8 +1686,13 @@ AtomicRecordAppender::RunPendingSubmitQueue()
         mFlushStartByteCount  = -1;
         mAppendInProgressFlag = false;
         // Do space accounting and flush if needed.
-        if (0 < newBytes && gAtomicRecordAppendManager.GetFlushLimit(
-                    *this, newBytes) <= mBuffer.BytesConsumable()) {
+        const int flushLimit = 0 < newBytes ?
+            gAtomicRecordAppendManager.GetFlushLimit(*this, newBytes) : -1;
+        if (0 < newBytes) {
+            UpdateAppendRate(newBytes);
+        }
+        if (0 < newBytes && flushLimit <= mBuffer.BytesConsumable() &&
+                ! DeferFlush(flushLimit)) {
             // Align the flush to checksum boundaries.
             FlushFullBlocks();
         } else {
@@ -2769,6 +2788,7 @@ AtomicRecordAppender::FlushSelf(bool flushFullChecksumBlocks)
             *this, mBuffer.BytesConsumable() - prevNumBytes);
     }
     mLastFlushTime = Now();
+    mGroupFlushPendingFlag = false;
     SetCanDoLowOnBuffersFlushFlag(false);
     if (mStaggerRMWInFlightFlag) {
         mRestartFlushFlag    = ! mBuffer.IsEmpty();
@@ -2907,6 +2927,9 @@ AtomicRecordAppender::FlushSelf(bool flushFullChecksumBlocks)
                 mBufFrontPadding = off;
             }
         }
+        if (mIoOpsInFlight <= 0) {
+            mWriteStartUsec = microseconds();
+        }
         mIoOpsInFlight++;
         int res = gChunkManager.WriteChunk(wop);
         if (res < 0) {
@@ -2920,6 +2943,47 @@ AtomicRecordAppender::FlushSelf(bool flushFullChecksumBlocks)
     }
 }
 
+void
+AtomicRecordAppender::UpdateAppendRate(int nBytes)
+{
+    if (gAtomicRecordAppendManager.GetGroupFlushMaxRatio() <= 1) {
+        return;
+    }
+    const int64_t now = microseconds();
+    if (0 < mLastAppendUsec && mLastAppendUsec < now) {
+        const double kAvgWeight = 1. / 16;
+        mAppendByteRate += kAvgWeight *
+            (double(nBytes) / double(now - mLastAppendUsec) - mAppendByteRate);
+    }
+    mLastAppendUsec = now;
+}
+
+bool
+AtomicRecordAppender::DeferFlush(int flushLimit)
+{
+    // Group flush: while the disk write is in flight, keep accumulating the
+    // appended data in order to issue one larger write when the current
+    // write completes, as long as the data expected to arrive by the write
+    // completion, estimated from the append rate and average write time,
+    // fits into the group flush limit.
+    const double ratio = gAtomicRecordAppendManager.GetGroupFlushMaxRatio();
+    if (mIoOpsInFlight <= 0 || ratio <= 1 || mState != kStateOpen ||
+            mStaggerRMWInFlightFlag) {
+        return false;
+    }
+    const double remaining = max(0.,
+        mWriteUsecAvg - double(microseconds() - mWriteStartUsec));
+    if (flushLimit * ratio <
+            mBuffer.BytesConsumable() + mAppendByteRate * remaining) {
+        return false;
+    }
+    if (! mGroupFlushPendingFlag) {
+        mGroupFlushPendingFlag = true;
+        Cntrs().mGroupFlushDeferCount++;
+    }
+    return true;
+}
+
 void
 AtomicRecordAppender::OpDone(WriteOp *op)
 {
@@ -2961,6 +3025,19 @@ AtomicRecordAppender::OpDone(WriteOp *op)
             FlushSelf(mFlushFullBlocksFlag);
         }
     }
+    if (mIoOpsInFlight <= 0 && ! failedFlag) {
+        const double kAvgWeight = 1. / 8;
+        mWriteUsecAvg += kAvgWeight *
+            (double(microseconds() - mWriteStartUsec) - mWriteUsecAvg);
+        if (mGroupFlushPendingFlag && mState == kStateOpen &&
+                ! mBeginMakeChunkStableOp && ! mMakeChunkStableOp &&
+                gAtomicRecordAppendManager.GetFlushLimit(*this) <=
+                    mBuffer.BytesConsumable()) {
+            // Flush the bytes accumulated while the previous write was in
+            // flight.
+            FlushFullBlocks();
+        }
+    }
     if (mIoOpsInFlight <= 0 && mBeginMakeChunkStableOp) {
         BeginMakeStable();
     }
@@ -3105,6 +3182,7 @@ AtomicRecordAppendManager::AtomicRecordAppendManager()
       mOpenAppendersCount(0),
       mAppendersWithWidCount(0),
       mBufferLimitRatio(0.4),
+      mGroupFlushMaxRatio(2),
       mMaxWriteIdsPerChunk(16 << 10),
       mCloseOutOfSpaceThreshold(4),
       mCloseOutOfSpaceSec(5),
@@ -3153,6 +3231,8 @@ AtomicRecordAppendManager::SetParameters(const Properties& props)
         "chunkServer.recAppender.flushLimit",          mFlushLimit),
     mBufferLimitRatio        = props.getValue(
         "chunkServer.recAppender.bufferLimitRatio",    mBufferLimitRatio),
+    mGroupFlushMaxRatio      = props.getValue(
+        "chunkServer.recAppender.groupFlushMaxRatio",  mGroupFlushMaxRatio),
     mMaxWriteIdsPerChunk     = props.getValue(
         "chunkServer.recAppender.maxWriteIdsPerChunk", mMaxWriteIdsPerChunk);
     mCloseOutOfSpaceThreshold     = props.getValue(
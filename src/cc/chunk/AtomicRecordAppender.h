@@ -79,6 +79,7 @@ public:
         Counter mLostChunkCount;
         Counter mPendingByteCount;
         Counter mLowOnBuffersFlushCount;
+        Counter mGroupFlushDeferCount;
 
         void Clear()
         {
@@ -114,6 +115,7 @@ public:
             mLostChunkCount = 0;
             mPendingByteCount = 0;
             mLowOnBuffersFlushCount = 0;
+            mGroupFlushDeferCount = 0;
         }
     };
     AtomicRecordAppendManager();
@@ -138,6 +140,8 @@ public:
     int GetFlushLimit() const { return mFlushLimit; }
     double GetBufferLimitRatio() const
         { return mBufferLimitRatio; }
+    double GetGroupFlushMaxRatio() const
+        { return mGroupFlushMaxRatio; }
     int GetMaxWriteIdsPerChunk() const
         { return mMaxWriteIdsPerChunk; }
     int GetCloseOutOfSpaceThreshold() const
@@ -227,6 +231,7 @@ private:
     int64_t               mOpenAppendersCount;
     int64_t               mAppendersWithWidCount;
     double                mBufferLimitRatio;
+    double                mGroupFlushMaxRatio;
     int                   mMaxWriteIdsPerChunk;
     int                   mCloseOutOfSpaceThreshold;
     int                   mCloseOutOfSpaceSec;
@@ -44,6 +44,7 @@ BufferManager::Client::Client()
       mByteCount(0),
       mWaitingForByteCount(0),
       mWaitStart(0),
+      mRequestClass(kRequestClassOther),
       mOverQuotaWaitingFlag(false)
 {
     WaitQueue::Init(*this);
@@ -56,6 +57,7 @@ BufferManager::Client::Reset()
     mByteCount            = 0;
     mWaitingForByteCount  = 0;
     mWaitStart            = 0;
+    mRequestClass         = kRequestClassOther;
     mOverQuotaWaitingFlag = false;
 }
 
@@ -83,9 +85,17 @@ BufferManager::BufferManager(
       mWaitingAvgBytes(0),
       mWaitingAvgCount(0),
       mWaitingAvgUsecs(0),
+      mCurClass(0),
       mCounters()
 {
-    WaitQueue::Init(mWaitQueuePtr);
+    for (int i = 0; i < kRequestClassCount; i++) {
+        WaitQueue::Init(mWaitQueuePtr[i]);
+        mClassWeight[i]          = 1;
+        mClassMinReserveRatio[i] = 0;
+        mClassMinReserve[i]      = 0;
+        mClassByteCount[i]       = 0;
+        mClassDeficit[i]         = 0;
+    }
     WaitQueue::Init(mOverQuotaWaitQueuePtr);
     mCounters.Clear();
     BufferManager::SetWaitingAvgInterval(20);
@@ -93,10 +103,10 @@ BufferManager::BufferManager(
 
 BufferManager::~BufferManager()
 {
-    QCRTASSERT(
-        WaitQueue::IsEmpty(mWaitQueuePtr) &&
-        WaitQueue::IsEmpty(mOverQuotaWaitQueuePtr)
-    );
+    for (int i = 0; i < kRequestClassCount; i++) {
+        QCRTASSERT(WaitQueue::IsEmpty(mWaitQueuePtr[i]));
+    }
+    QCRTASSERT(WaitQueue::IsEmpty(mOverQuotaWaitQueuePtr));
     globalNetManager().UnRegisterTimeoutHandler(this);
 }
 
@@ -122,9 +132,69 @@ BufferManager::Init(
     mMinBufferCount            = inMinBufferCount;
     mMaxClientQuota            = min(mTotalCount, inMaxClientQuota);
     mDiskOverloadedFlag        = false;
+    for (int i = 0; i < kRequestClassCount; i++) {
+        mClassMinReserve[i] = ByteCount(mClassMinReserveRatio[i] * mTotalCount);
+        mClassByteCount[i]  = 0;
+        mClassDeficit[i]    = 0;
+    }
     globalNetManager().RegisterTimeoutHandler(this);
 }
 
+    void
+BufferManager::SetClassParameters(
+    BufferManager::RequestClass inClass,
+    int                         inWeight,
+    double                      inMinReserveRatio)
+{
+    if (inClass < 0 || kRequestClassCount <= inClass) {
+        return;
+    }
+    mClassWeight[inClass]          = max(1, inWeight);
+    mClassMinReserveRatio[inClass] = min(1., max(0., inMinReserveRatio));
+    mClassMinReserve[inClass]      =
+        ByteCount(mClassMinReserveRatio[inClass] * mTotalCount);
+}
+
+    /* static */ const char*
+BufferManager::GetRequestClassName(
+    BufferManager::RequestClass inClass)
+{
+    switch (inClass) {
+        case kRequestClassOther:       return "other";
+        case kRequestClassRead:        return "read";
+        case kRequestClassWrite:       return "write";
+        case kRequestClassAppend:      return "append";
+        case kRequestClassReplication: return "replication";
+        default:                       break;
+    }
+    return "invalid";
+}
+
+    BufferManager::ByteCount
+BufferManager::GetReservedByteCount(
+    int inClass) const
+{
+    // Reservations are only enforced for the classes with waiting requests, in
+    // order not to leave the buffers unused.
+    ByteCount theRet = 0;
+    for (int i = 0; i < kRequestClassCount; i++) {
+        if (i != inClass && mClassByteCount[i] < mClassMinReserve[i] &&
+                ! WaitQueue::IsEmpty(mWaitQueuePtr[i])) {
+            theRet += mClassMinReserve[i] - mClassByteCount[i];
+        }
+    }
+    return theRet;
+}
+
+    BufferManager::ByteCount
+BufferManager::GetClassQuantum() const
+{
+    return max(
+        ByteCount(mBufferPoolPtr ? mBufferPoolPtr->GetBufferSize() : (4 << 10)),
+        mMaxClientQuota / 8
+    );
+}
+
 void
 BufferManager::ChangeOverQuotaWait(
     BufferManager::Client& inClient,
@@ -135,7 +205,8 @@ BufferManager::ChangeOverQuotaWait(
         return;
     }
     WaitQueue::Remove(
-        inClient.mOverQuotaWaitingFlag ? mOverQuotaWaitQueuePtr : mWaitQueuePtr,
+        inClient.mOverQuotaWaitingFlag ?
+            mOverQuotaWaitQueuePtr : mWaitQueuePtr[inClient.mRequestClass],
         inClient
     );
     if (inClient.mOverQuotaWaitingFlag) {
@@ -147,7 +218,8 @@ BufferManager::ChangeOverQuotaWait(
     }
     inClient.mOverQuotaWaitingFlag = inFlag;
     WaitQueue::PushBack(
-        inClient.mOverQuotaWaitingFlag ? mOverQuotaWaitQueuePtr : mWaitQueuePtr,
+        inClient.mOverQuotaWaitingFlag ?
+            mOverQuotaWaitQueuePtr : mWaitQueuePtr[inClient.mRequestClass],
         inClient
     );
     if (inClient.mOverQuotaWaitingFlag) {
@@ -161,9 +233,10 @@ BufferManager::ChangeOverQuotaWait(
 
     bool
 BufferManager::Modify(
-    BufferManager::Client&   inClient,
-    BufferManager::ByteCount inByteCount,
-    bool                     inForDiskIoFlag)
+    BufferManager::Client&      inClient,
+    BufferManager::ByteCount    inByteCount,
+    bool                        inForDiskIoFlag,
+    BufferManager::RequestClass inClass)
 {
     if (! mEnabledFlag) {
         return true;
@@ -177,6 +250,7 @@ BufferManager::Modify(
 
     const bool theHadBuffersFlag = inClient.mByteCount > 0;
     mRemainingCount += inClient.mByteCount;
+    mClassByteCount[inClient.mRequestClass] -= inClient.mByteCount;
     if (inByteCount < 0) {
         mPutRequestCount++;
         inClient.mByteCount += inByteCount;
@@ -184,6 +258,7 @@ BufferManager::Modify(
             inClient.mByteCount = 0;
         }
         mRemainingCount -= inClient.mByteCount;
+        mClassByteCount[inClient.mRequestClass] += inClient.mByteCount;
         if (theHadBuffersFlag && inClient.mByteCount <= 0) {
             mClientsWihtBuffersCount--;
         }
@@ -197,6 +272,10 @@ BufferManager::Modify(
     mCounters.mRequestByteCount += inByteCount;
     mGetRequestCount++;
     inClient.mManagerPtr = this;
+    if (! inClient.IsWaiting()) {
+        // The client's buffers are accounted in the class of its last request.
+        inClient.mRequestClass = inClass;
+    }
     const ByteCount theReqByteCount  =
         inClient.mWaitingForByteCount + inClient.mByteCount + inByteCount;
     const bool      theOverQuotaFlag = mMaxClientQuota < theReqByteCount;
@@ -204,13 +283,15 @@ BufferManager::Modify(
         theReqByteCount <= 0 || (
             (! inForDiskIoFlag || ! mDiskOverloadedFlag) &&
             ! IsLowOnBuffers() &&
-            theReqByteCount < mRemainingCount &&
+            theReqByteCount + GetReservedByteCount(inClient.mRequestClass) <
+                mRemainingCount &&
             ! theOverQuotaFlag
         )
     );
     if (theGrantedFlag) {
         inClient.mByteCount = theReqByteCount;
         mRemainingCount -= theReqByteCount;
+        mCounters.mWaitHistogram[inClient.mRequestClass][0]++;
         mCounters.mRequestGrantedCount++;
         mCounters.mRequestGrantedByteCount += inByteCount;
     } else {
@@ -229,7 +310,9 @@ BufferManager::Modify(
             inClient.mWaitStart            = microseconds();
             inClient.mOverQuotaWaitingFlag = theOverQuotaFlag;
             WaitQueue::PushBack(
-                theOverQuotaFlag ? mOverQuotaWaitQueuePtr : mWaitQueuePtr,
+                theOverQuotaFlag ?
+                    mOverQuotaWaitQueuePtr :
+                    mWaitQueuePtr[inClient.mRequestClass],
                 inClient
             );
             if (theOverQuotaFlag) {
@@ -246,6 +329,7 @@ BufferManager::Modify(
         mRemainingCount -= inClient.mByteCount;
         inClient.mWaitingForByteCount += inByteCount;
     }
+    mClassByteCount[inClient.mRequestClass] += inClient.mByteCount;
     QCASSERT(mRemainingCount >= 0 && mRemainingCount <= mTotalCount);
     QCASSERT(inClient.IsWaiting() || inClient.mWaitingForByteCount == 0);
     if (! theHadBuffersFlag && inClient.mByteCount > 0) {
@@ -272,7 +356,7 @@ BufferManager::Unregister(
         }
         WaitQueue::Remove(
             inClient.mOverQuotaWaitingFlag ?
-                mOverQuotaWaitQueuePtr : mWaitQueuePtr,
+                mOverQuotaWaitQueuePtr : mWaitQueuePtr[inClient.mRequestClass],
             inClient
         );
     }
@@ -297,7 +381,8 @@ BufferManager::CancelRequest(
     mCounters.mReqeustCanceledCount++;
     mCounters.mReqeustCanceledBytes += inClient.mWaitingForByteCount;
     WaitQueue::Remove(
-        inClient.mOverQuotaWaitingFlag ? mOverQuotaWaitQueuePtr : mWaitQueuePtr,
+        inClient.mOverQuotaWaitingFlag ?
+            mOverQuotaWaitQueuePtr : mWaitQueuePtr[inClient.mRequestClass],
         inClient
     );
     if (inClient.mOverQuotaWaitingFlag) {
@@ -323,42 +408,107 @@ BufferManager::IsLowOnBuffers() const
     );
 }
 
+    void
+BufferManager::Granted(
+    BufferManager::Client& inClient,
+    int64_t                inNowUsecs)
+{
+    const int theClass = inClient.mRequestClass;
+    WaitQueue::Remove(mWaitQueuePtr[theClass], inClient);
+    mWaitingCount--;
+    const ByteCount theGrantedCount = inClient.mWaitingForByteCount;
+    QCASSERT(theGrantedCount > 0);
+    mRemainingCount -= theGrantedCount;
+    QCASSERT(mRemainingCount <= mTotalCount);
+    mWaitingByteCount -= theGrantedCount;
+    mClassByteCount[theClass] += theGrantedCount;
+    mClassDeficit[theClass]   -= theGrantedCount;
+    if (inClient.mByteCount <= 0 && theGrantedCount > 0) {
+        mClientsWihtBuffersCount++;
+    }
+    const int64_t theWaitUsecs =
+        max(int64_t(0), inNowUsecs - inClient.mWaitStart);
+    int theIdx = 0;
+    for (int64_t theLimit = 1000;
+            theIdx < kWaitHistogramBucketCount - 1 && theLimit <= theWaitUsecs;
+            theLimit <<= 2) {
+        theIdx++;
+    }
+    mCounters.mWaitHistogram[theClass][theIdx]++;
+    mCounters.mRequestWaitUsecs += theWaitUsecs;
+    mCounters.mRequestGrantedCount++;
+    mCounters.mRequestGrantedByteCount += theGrantedCount;
+    inClient.mByteCount += theGrantedCount;
+    inClient.mWaitingForByteCount = 0;
+    inClient.Granted(theGrantedCount);
+}
+
     /* virtual */ void
 BufferManager::Timeout()
 {
-    bool    theSetTimeFlag = true;
-    int64_t theNowUsecs    = 0;
-    while (! mDiskOverloadedFlag && ! IsLowOnBuffers()) {
-        Client* const theClientPtr = WaitQueue::Front(mWaitQueuePtr);
-        if (! theClientPtr ||
-                theClientPtr->mWaitingForByteCount > mRemainingCount) {
-            break;
+    // Deficit round robin between request classes. The class quantum is added
+    // to the class deficit on each class turn. The current class requests are
+    // granted while the deficit covers the request size. When there are no
+    // buffers to grant the current class request with sufficient deficit, the
+    // grants stop until buffers are released, in order to guarantee progress
+    // for the large requests.
+    // The loop ends after one full rotation where no class can make progress,
+    // i.e. every class is either empty, or has sufficient deficit but can not
+    // be granted due to other classes unmet reservations. Classes with
+    // insufficient deficit make progress by accumulating deficit.
+    const ByteCount theQuantum  = GetClassQuantum();
+    int64_t         theNowUsecs = -1;
+    int             theStallCnt = 0;
+    while (! mDiskOverloadedFlag && ! IsLowOnBuffers() &&
+            theStallCnt < kRequestClassCount) {
+        Client* const theClientPtr = WaitQueue::Front(mWaitQueuePtr[mCurClass]);
+        if (theClientPtr) {
+            const ByteCount theReqCount = theClientPtr->mWaitingForByteCount;
+            if (theReqCount <= mClassDeficit[mCurClass]) {
+                if (mRemainingCount < theReqCount) {
+                    break;
+                }
+                if (theReqCount + GetReservedByteCount(mCurClass) <=
+                        mRemainingCount) {
+                    if (theNowUsecs < 0) {
+                        theNowUsecs = microseconds();
+                    }
+                    Granted(*theClientPtr, theNowUsecs);
+                    theStallCnt = 0;
+                    continue;
+                }
+                // Let the classes with unmet reservation to proceed.
+                theStallCnt++;
+            } else {
+                theStallCnt = 0;
+            }
+        } else {
+            theStallCnt++;
+            mClassDeficit[mCurClass] = 0;
         }
-        WaitQueue::Remove(mWaitQueuePtr, *theClientPtr);
-        mWaitingCount--;
-        const ByteCount theGrantedCount = theClientPtr->mWaitingForByteCount;
-        QCASSERT(theGrantedCount > 0);
-        mRemainingCount -= theGrantedCount;
-        QCASSERT(mRemainingCount <= mTotalCount);
-        mWaitingByteCount -= theGrantedCount;
-        if (theClientPtr->mByteCount <= 0 && theGrantedCount > 0) {
-            mClientsWihtBuffersCount++;
+        if (kRequestClassCount <= ++mCurClass) {
+            mCurClass = 0;
         }
-        if (theSetTimeFlag) {
-            theSetTimeFlag = false;
-            theNowUsecs    = microseconds();
+        if (! WaitQueue::IsEmpty(mWaitQueuePtr[mCurClass])) {
+            mClassDeficit[mCurClass] += mClassWeight[mCurClass] * theQuantum;
         }
-        mCounters.mRequestWaitUsecs += max(int64_t(0),
-            theNowUsecs - theClientPtr->mWaitStart);
-        mCounters.mRequestGrantedCount++;
-        mCounters.mRequestGrantedByteCount += theGrantedCount;
-        theClientPtr->mByteCount += theGrantedCount;
-        theClientPtr->mWaitingForByteCount = 0;
-        theClientPtr->Granted(theGrantedCount);
     }
     UpdateWaitingAvg();
 }
 
+    int64_t
+BufferManager::GetOldestWaitStart() const
+{
+    int64_t theRet = -1;
+    for (int i = 0; i < kRequestClassCount; i++) {
+        const Client* const thePtr = WaitQueue::Front(mWaitQueuePtr[i]);
+        if (thePtr && (theRet < 0 || thePtr->mWaitStart < theRet)) {
+            theRet = thePtr->mWaitStart;
+        }
+    }
+    return theRet;
+}
+
 static const int64_t kWaitingAvgExp[] = {
 1507,2484,2935,3190,3354,3467,3551,3615,3665,3706,
 3740,3769,3793,3814,3832,3848,3862,3875,3886,3896,
@@ -533,9 +683,9 @@ BufferManager::UpdateWaitingAvg()
     }
     const int64_t theNowUsecs  = microseconds();
     const int64_t theEnd       = theNowUsecs - kWaitingAvgIntervalUsec;
-    const int64_t theWaitUsecs = WaitQueue::IsEmpty(mWaitQueuePtr) ?
-        int64_t(0) : max(int64_t(0),
-            theNowUsecs - WaitQueue::Front(mWaitQueuePtr)->mWaitStart);
+    const int64_t theWaitStart = GetOldestWaitStart();
+    const int64_t theWaitUsecs = theWaitStart < 0 ?
+        int64_t(0) : max(int64_t(0), theNowUsecs - theWaitStart);
     while (mWaitingAvgUsecsLast <= theEnd) {
         mWaitingAvgBytes = CalcWaitingAvg(mWaitingAvgBytes, mWaitingByteCount);
         mWaitingAvgCount = CalcWaitingAvg(mWaitingAvgCount, mWaitingCount);
@@ -44,11 +44,30 @@ namespace KFS
 // server as feedback chunk server "load" metric in chunk placement. The load
 // metric presently has the most effect for write append chunk placement with
 // large number of append clients in radix sort.
+//
+// Waiting requests are queued by request class, and the classes are served
+// with deficit round robin, in order to prevent a few clients with large
+// requests of one class, for example writes, from starving the clients with
+// small requests of other classes, for example random reads, when buffers run
+// low. Each class can have minimum buffer reservation, which is only enforced
+// while the class has waiting requests.
 class BufferManager : private ITimeout
 {
 public:
     typedef int64_t ByteCount;
     typedef int64_t RequestCount;
+    enum RequestClass
+    {
+        kRequestClassOther       = 0,
+        kRequestClassRead        = 1,
+        kRequestClassWrite       = 2,
+        kRequestClassAppend      = 3,
+        kRequestClassReplication = 4,
+        kRequestClassCount
+    };
+    // Wait time histogram buckets upper bounds are 1ms, 4ms, 16ms, 64ms,
+    // 256ms, 1s, 4s, and the last bucket has no upper bound.
+    enum { kWaitHistogramBucketCount = 8 };
     struct Counters
     {
         typedef int64_t Counter;
@@ -64,6 +83,7 @@ public:
         Counter mRequestWaitUsecs;
         Counter mOverQuotaRequestDeniedCount;
         Counter mOverQuotaRequestDeniedByteCount;
+        Counter mWaitHistogram[kRequestClassCount][kWaitHistogramBucketCount];
 
         void Clear()
         {
@@ -78,6 +98,11 @@ public:
             mRequestWaitUsecs                = 0;
             mOverQuotaRequestDeniedCount     = 0;
             mOverQuotaRequestDeniedByteCount = 0;
+            for (int i = 0; i < kRequestClassCount; i++) {
+                for (int k = 0; k < kWaitHistogramBucketCount; k++) {
+                    mWaitHistogram[i][k] = 0;
+                }
+            }
         }
     };
 
@@ -120,6 +145,7 @@ public:
         ByteCount      mByteCount;
         ByteCount      mWaitingForByteCount;
         int64_t        mWaitStart;
+        RequestClass   mRequestClass;
         bool           mOverQuotaWaitingFlag;
 
         inline void Reset();
@@ -150,21 +176,26 @@ public:
             inClient.mByteCount + inClient.mWaitingForByteCount + inByteCount);
     }
     bool Get(
-        Client&   inClient,
-        ByteCount inByteCount,
-        bool      inForDiskIoFlag = false)
+        Client&      inClient,
+        ByteCount    inByteCount,
+        bool         inForDiskIoFlag = false,
+        RequestClass inClass         = kRequestClassOther)
     {
         return (inByteCount <= 0 ||
-            Modify(inClient, inByteCount, inForDiskIoFlag));
+            Modify(inClient, inByteCount, inForDiskIoFlag, inClass));
     }
     bool Put(
         Client&   inClient,
         ByteCount inByteCount)
-        { return (inByteCount <= 0 || Modify(inClient, -inByteCount, false)); }
+    {
+        return (inByteCount <= 0 ||
+            Modify(inClient, -inByteCount, false, kRequestClassOther));
+    }
     bool GetForDiskIo(
-        Client&   inClient,
-        ByteCount inByteCount)
-        { return Get(inClient, inByteCount, true); }
+        Client&      inClient,
+        ByteCount    inByteCount,
+        RequestClass inClass = kRequestClassOther)
+        { return Get(inClient, inByteCount, true, inClass); }
     ByteCount GetTotalCount() const
         { return mTotalCount; }
     bool IsLowOnBuffers() const;
@@ -173,7 +204,8 @@ public:
         const Client& inClient) const
     {
         return (
-            WaitQueue::IsInList(mWaitQueuePtr, inClient) ||
+            WaitQueue::IsInList(
+                mWaitQueuePtr[inClient.mRequestClass], inClient) ||
             WaitQueue::IsInList(mOverQuotaWaitQueuePtr, inClient)
         );
     }
@@ -237,6 +269,17 @@ public:
     {
         return ((mWaitingAvgIntervalIdx + 1) * kWaitingAvgSampleIntervalSec);
     }
+    // Request class deficit round robin weight, and minimum reservation as a
+    // fraction of the total buffer bytes.
+    void SetClassParameters(
+        RequestClass inClass,
+        int          inWeight,
+        double       inMinReserveRatio);
+    ByteCount GetClassByteCount(
+        RequestClass inClass) const
+        { return mClassByteCount[inClass]; }
+    static const char* GetRequestClassName(
+        RequestClass inClass);
 private:
     typedef QCDLList<Client, 0> WaitQueue;
     // 39 bits integer part -- max 0.5TB bytes waiting
@@ -245,7 +288,7 @@ private:
     enum { kWaitingAvgFracBits = 12 };
     enum { kWaitingAvgSampleIntervalSec = 1 };
 
-    Client*         mWaitQueuePtr[1];
+    Client*         mWaitQueuePtr[kRequestClassCount][1];
     Client*         mOverQuotaWaitQueuePtr[1];
     QCIoBufferPool* mBufferPoolPtr;
     ByteCount       mTotalCount;
@@ -269,12 +312,26 @@ private:
     int64_t         mWaitingAvgBytes;
     int64_t         mWaitingAvgCount;
     int64_t         mWaitingAvgUsecs;
+    int             mCurClass;
+    int             mClassWeight[kRequestClassCount];
+    double          mClassMinReserveRatio[kRequestClassCount];
+    ByteCount       mClassMinReserve[kRequestClassCount];
+    ByteCount       mClassByteCount[kRequestClassCount];
+    ByteCount       mClassDeficit[kRequestClassCount];
     Counters        mCounters;
 
     bool Modify(
-        Client&   inClient,
-        ByteCount inByteCount,
-        bool      inForDiskIoFlag);
+        Client&      inClient,
+        ByteCount    inByteCount,
+        bool         inForDiskIoFlag,
+        RequestClass inClass);
+    ByteCount GetReservedByteCount(
+        int inClass) const;
+    ByteCount GetClassQuantum() const;
+    void Granted(
+        Client& inClient,
+        int64_t inNowUsecs);
+    int64_t GetOldestWaitStart() const;
     void UpdateWaitingAvg();
     int64_t CalcWaitingAvg(
         int64_t inAvg,
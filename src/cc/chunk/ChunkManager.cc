@@ -36,6 +36,8 @@
 #include "BufferManager.h"
 #include "ClientManager.h"
 #include "ClientSM.h"
+#include "ChunkScrubber.h"
+#include "ShortCircuitServer.h"
 
 #include "common/MsgLogger.h"
 #include "common/kfstypes.h"
@@ -54,6 +56,7 @@
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
 
 #include <fstream>
@@ -61,6 +64,7 @@
 #include <algorithm>
 #include <string>
 #include <set>
+#include <bitset>
 
 #include <boost/bind.hpp>
 
@@ -75,10 +79,12 @@ using std::string;
 using std::vector;
 using std::make_pair;
 using std::sort;
+using std::nth_element;
 using std::unique;
 using std::greater;
 using std::set;
 using std::binary_function;
+using std::bitset;
 using boost::bind;
 
 using namespace KFS::libkfsio;
@@ -87,6 +93,7 @@ ChunkManager gChunkManager;
 
 typedef QCDLList<ChunkInfoHandle, 0> ChunkList;
 typedef QCDLList<ChunkInfoHandle, 1> ChunkDirList;
+typedef QCDLList<ChunkInfoHandle, 2> ChunkMetaCacheList;
 typedef ChunkList ChunkLru;
 
 // Chunk directory state. The present production deployment use one chunk
@@ -97,10 +104,13 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
         : ITimeout(),
           dirname(),
           bufferedIoFlag(false),
+          bufferedReadFlag(false),
+          memoryFlag(false),
           storageTier(kKfsSTierUndef),
           usedSpace(0),
           availableSpace(-1),
           totalSpace(0),
+          memoryMaxSpace(-1),
           notStableSpace(0),
           totalNotStableSpace(0),
           pendingReadBytes(0),
@@ -136,6 +146,9 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
           notifyAvailableChunksStartFlag(false),
           timeoutPendingFlag(false),
           chunksAvailableInFlightSortedFlag(false),
+          chunkFilePoolInFlightFlag(false),
+          destageInFlightFlag(false),
+          slowFlag(false),
           lastEvacuationActivityTime(
             globalNetManager().Now() - 365 * 24 * 60 * 60),
           startTime(globalNetManager().Now()),
@@ -146,13 +159,22 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
           writeCounters(),
           totalReadCounters(),
           totalWriteCounters(),
+          latency(),
           availableChunks(),
+          chunkFilePool(),
+          chunkFilePoolNextSeq(0),
+          chunkFilePoolInFlightSeq(-1),
+          reclaimQueue(),
+          reclaimNextSeq(0),
+          pendingReclaimSpace(0),
+          reclaimInFlightCount(0),
           fsSpaceAvailCb(),
           checkDirCb(),
           checkEvacuateFileCb(),
           evacuateChunksCb(),
           renameEvacuateFileCb(),
           availableChunksCb(),
+          chunkFilePoolCb(),
           evacuateChunksOp(0, &evacuateChunksCb),
           availableChunksOp(0, &availableChunksCb),
           chunkDirInfoOp(*this)
@@ -169,6 +191,8 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
             &ChunkDirInfo::RenameEvacuateFileDone);
         availableChunksCb.SetHandler(this,
             &ChunkDirInfo::AvailableChunksDone);
+        chunkFilePoolCb.SetHandler(this,
+            &ChunkDirInfo::ChunkFilePoolDone);
         for (int i = 0; i < kChunkDirListCount; i++) {
             ChunkList::Init(chunkLists[i]);
             ChunkDirList::Init(chunkLists[i]);
@@ -188,6 +212,7 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
     void DiskError(int sysErr);
     int EvacuateChunksDone(int code, void* data);
     int AvailableChunksDone(int code, void* data);
+    int ChunkFilePoolDone(int code, void* data);
     void ScheduleEvacuate(int maxChunkCount = -1);
     void RestartEvacuation();
     void NotifyAvailableChunks(bool tmeoutFlag = false);
@@ -196,6 +221,11 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
         notifyAvailableChunksStartFlag = true;
         NotifyAvailableChunks();
     }
+    void UpdateLatency(int64_t ioTimeMicrosec)
+    {
+        latency.Update(ioTimeMicrosec,
+            gChunkManager.mSlowDirLatencyEwmaWeight);
+    }
     void UpdateLastEvacuationActivityTime()
     {
         lastEvacuationActivityTime = globalNetManager().Now();
@@ -256,6 +286,15 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
         evacuateStartByteCount         = -1;
         notifyAvailableChunksStartFlag = false;
         availableChunks.Clear();
+        latency.Reset();
+        slowFlag                       = false;
+        // The pool files are removed when the directory is added back.
+        chunkFilePool.clear();
+        // Same for the reclaim files, in flight deletes are ignored on
+        // completion, as the start count changes.
+        reclaimQueue.clear();
+        pendingReclaimSpace            = 0;
+        reclaimInFlightCount           = 0;
         if (timeoutPendingFlag) {
             timeoutPendingFlag = false;
             globalNetManager().UnRegisterTimeoutHandler(this);
@@ -271,6 +310,7 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
         startCount++;
         readCounters.Reset();
         writeCounters.Reset();
+        latency.Reset();
         const bool kResetLastCountersFlag = true;
         chunkDirInfoOp.Enqueue(kResetLastCountersFlag);
         NotifyAvailableChunksStart();
@@ -469,6 +509,76 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
         Counter mIoCount;
         Counter mByteCount;
     };
+    // Disk io latency exponentially weighted moving average, and log2
+    // histogram used to compute latency percentiles. The histogram counts
+    // are halved on every slow directory check, in order to give more weight
+    // to the recent io.
+    class LatencyStats
+    {
+    public:
+        enum { kBucketCount = 32 };
+
+        LatencyStats()
+            : mEwmaUsec(0),
+              mCount(0)
+            { Reset(); }
+        void Reset()
+        {
+            mEwmaUsec = 0;
+            mCount    = 0;
+            for (int i = 0; i < kBucketCount; i++) {
+                mBuckets[i] = 0;
+            }
+        }
+        void Update(
+            int64_t inTimeMicrosec,
+            double  inWeight)
+        {
+            if (inTimeMicrosec <= 0) {
+                return; // Served from memory.
+            }
+            mEwmaUsec = mCount <= 0 ? (double)inTimeMicrosec :
+                mEwmaUsec + inWeight * (inTimeMicrosec - mEwmaUsec);
+            mCount++;
+            int i = 0;
+            while (i < kBucketCount - 1 &&
+                    (int64_t(2) << i) <= inTimeMicrosec) {
+                i++;
+            }
+            mBuckets[i]++;
+        }
+        void Decay()
+        {
+            for (int i = 0; i < kBucketCount; i++) {
+                mBuckets[i] >>= 1;
+            }
+        }
+        // Returns the percentile's histogram bucket upper bound.
+        int64_t GetPercentile(
+            double inRatio) const
+        {
+            int64_t total = 0;
+            for (int i = 0; i < kBucketCount; i++) {
+                total += mBuckets[i];
+            }
+            if (total <= 0) {
+                return 0;
+            }
+            const int64_t target = max(int64_t(1), (int64_t)(total * inRatio));
+            int64_t       sum    = 0;
+            for (int i = 0; i < kBucketCount; i++) {
+                sum += mBuckets[i];
+                if (target <= sum) {
+                    return (int64_t(2) << i);
+                }
+            }
+            return (int64_t(2) << (kBucketCount - 1));
+        }
+
+        double  mEwmaUsec;
+        int64_t mCount;
+        int64_t mBuckets[kBucketCount];
+    };
     class ChunkDirInfoOp : public KfsOp
     {
     public:
@@ -586,10 +696,30 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
                 "\r\n"
             "Buffered-io: "           << (mChunkDir.bufferedIoFlag ? 1 : 0) <<
                 "\r\n"
+            "Buffered-read: "         <<
+                (mChunkDir.bufferedReadFlag ? 1 : 0) << "\r\n"
+            "Memory: "                << (mChunkDir.memoryFlag ? 1 : 0) <<
+                "\r\n"
+            "Chunk-file-pool: "       << mChunkDir.chunkFilePool.size() <<
+                "\r\n"
             "Space-reservation: "     <<
                 (mChunkDir.supportsSpaceReservatonFlag ? 1 : 0) <<  "\r\n"
             "Pending-reservation: "   <<
                 mChunkDir.pendingSpaceReservationSize << "\r\n"
+            "Pending-reclaim: "       << mChunkDir.pendingReclaimSpace <<
+                "\r\n"
+            "Reclaim-in-flight: "     << mChunkDir.reclaimInFlightCount <<
+                "\r\n"
+            "Slow: "                  << (mChunkDir.slowFlag ? 1 : 0) <<
+                "\r\n"
+            "Latency-ewma-usec: "     << (int64_t)mChunkDir.latency.mEwmaUsec <<
+                "\r\n"
+            "Latency-p50-usec: "      << mChunkDir.latency.GetPercentile(0.5) <<
+                "\r\n"
+            "Latency-p90-usec: "      << mChunkDir.latency.GetPercentile(0.9) <<
+                "\r\n"
+            "Latency-p99-usec: "      <<
+                mChunkDir.latency.GetPercentile(0.99) << "\r\n"
             "Wait-avg-usec: "         <<
                 (bufMgr ? bufMgr->GetWaitingAvgUsecs() : int64_t(0)) << "\r\n"
             "Wait-avg-bytes: "        <<
@@ -640,10 +770,13 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
 
     string                 dirname;
     bool                   bufferedIoFlag;
+    bool                   bufferedReadFlag;
+    bool                   memoryFlag;
     kfsSTier_t             storageTier;
     int64_t                usedSpace;
     int64_t                availableSpace;
     int64_t                totalSpace;
+    int64_t                memoryMaxSpace;
     int64_t                notStableSpace;
     int64_t                totalNotStableSpace;
     int64_t                pendingReadBytes;
@@ -679,6 +812,9 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
     bool                   notifyAvailableChunksStartFlag:1;
     bool                   timeoutPendingFlag:1;
     bool                   chunksAvailableInFlightSortedFlag:1;
+    bool                   chunkFilePoolInFlightFlag:1;
+    bool                   destageInFlightFlag:1;
+    bool                   slowFlag:1;
     time_t                 lastEvacuationActivityTime;
     time_t                 startTime;
     time_t                 stopTime;
@@ -688,13 +824,27 @@ struct ChunkManager::ChunkDirInfo : public ITimeout
     Counters               writeCounters;
     Counters               totalReadCounters;
     Counters               totalWriteCounters;
+    LatencyStats           latency;
     DirChecker::ChunkInfos availableChunks;
+    // Sequence numbers of the preallocated chunk files in the pool directory.
+    typedef vector<int64_t> ChunkFilePool;
+    ChunkFilePool          chunkFilePool;
+    int64_t                chunkFilePoolNextSeq;
+    int64_t                chunkFilePoolInFlightSeq;
+    // Sequence numbers and sizes of the stale chunk files in the reclaim
+    // directory pending delete.
+    typedef vector<pair<int64_t, int64_t> > ReclaimQueue;
+    ReclaimQueue           reclaimQueue;
+    int64_t                reclaimNextSeq;
+    int64_t                pendingReclaimSpace;
+    int32_t                reclaimInFlightCount;
     KfsCallbackObj         fsSpaceAvailCb;
     KfsCallbackObj         checkDirCb;
     KfsCallbackObj         checkEvacuateFileCb;
     KfsCallbackObj         evacuateChunksCb;
     KfsCallbackObj         renameEvacuateFileCb;
     KfsCallbackObj         availableChunksCb;
+    KfsCallbackObj         chunkFilePoolCb;
     EvacuateChunksOp       evacuateChunksOp;
     AvailableChunksOp      availableChunksOp;
     ChunkDirInfoOp         chunkDirInfoOp;
@@ -816,6 +966,186 @@ struct WriteChunkMetaOp : public KfsOp
     }
 };
 
+/// Sequential read detection and read ahead buffer of an open chunk. Created
+/// on the first chunk read, and deleted when the chunk file is closed. If the
+/// chunk handle goes away with read ahead in flight, the object is detached
+/// from the handle, and deletes itself on the read completion.
+class ChunkReadAhead : public KfsCallbackObj, public BufferManager::Client
+{
+public:
+    struct Waiter
+    {
+        Waiter(ReadOp* op, int64_t offset, size_t numBytes)
+            : mOp(op), mOffset(offset), mNumBytes(numBytes)
+            {}
+        ReadOp* mOp;
+        int64_t mOffset;
+        size_t  mNumBytes;
+    };
+    typedef vector<Waiter> Waiters;
+
+    ChunkReadAhead(ChunkInfoHandle* cih)
+        : KfsCallbackObj(),
+          BufferManager::Client(),
+          chunkInfoHandle(cih),
+          nextOffset(-1),
+          sequentialCount(0),
+          bufOffset(0),
+          buf(),
+          readOffset(0),
+          readSize(0),
+          headerSize(0),
+          diskIo(),
+          waiters()
+    {
+        SET_HANDLER(this, &ChunkReadAhead::HandleDone);
+    }
+    virtual ~ChunkReadAhead()
+    {
+        assert(! diskIo && waiters.empty());
+    }
+    virtual void Granted(ByteCount /* byteCount */)
+    {
+        // Read ahead never waits for buffers.
+        die("invalid read ahead buffer grant");
+    }
+    int HandleDone(int code, void* data)
+    {
+        gChunkManager.ReadAheadDone(*this, code, data);
+        return 0;
+    }
+    bool IsInFlight() const
+        { return (diskIo != 0); }
+    int64_t GetBufEnd() const
+        { return (bufOffset + buf.BytesConsumable()); }
+    void Discard()
+    {
+        buf.Clear();
+        bufOffset = 0;
+        UpdateBufferAccounting();
+    }
+    void Consume(int64_t offset)
+    {
+        if (offset <= bufOffset) {
+            return;
+        }
+        if (GetBufEnd() <= offset) {
+            Discard();
+            return;
+        }
+        buf.Consume((int)(offset - bufOffset));
+        bufOffset = offset;
+        UpdateBufferAccounting();
+    }
+    void UpdateBufferAccounting()
+    {
+        const ByteCount cnt = GetByteCount() -
+            (buf.BytesConsumable() + (ByteCount)readSize);
+        if (0 < cnt) {
+            DiskIo::GetBufferManager().Put(*this, cnt);
+        }
+    }
+    void Detach()
+    {
+        chunkInfoHandle = 0;
+        Discard();
+        if (! IsInFlight()) {
+            delete this;
+        }
+    }
+
+    ChunkInfoHandle* chunkInfoHandle;
+    /// End of the last read, and the number of sequential reads.
+    int64_t          nextOffset;
+    int              sequentialCount;
+    /// Buffered read ahead data start offset and the data.
+    int64_t          bufOffset;
+    IOBuffer         buf;
+    /// Read ahead in flight, and read ops waiting for its completion.
+    int64_t          readOffset;
+    size_t           readSize;
+    int64_t          headerSize;
+    DiskIoPtr        diskIo;
+    Waiters          waiters;
+private:
+    ChunkReadAhead(const ChunkReadAhead&);
+    ChunkReadAhead& operator=(const ChunkReadAhead&);
+};
+
+/// Adjacent checksum block aligned chunk writes coalesced into a single disk
+/// write. The write ops are "started" when added, and their completion is
+/// invoked in order upon the disk write completion, with the number of bytes
+/// written that corresponds to each op.
+class ChunkWriteCoalescer : public KfsCallbackObj
+{
+public:
+    typedef vector<WriteOp*> WriteOps;
+
+    ChunkWriteCoalescer(ChunkInfoHandle* cih, int64_t offset)
+        : KfsCallbackObj(),
+          chunkInfoHandle(cih),
+          offset(offset),
+          numBytes(0),
+          ops(),
+          checksums(),
+          buf(),
+          diskIo()
+    {
+        List::Init(*this);
+        SET_HANDLER(this, &ChunkWriteCoalescer::HandleDone);
+    }
+    bool IsAdjacent(const WriteOp& op) const
+        { return (offset + numBytes == op.offset); }
+    void Add(WriteOp* op)
+    {
+        ops.push_back(op);
+        checksums.insert(checksums.end(),
+            op->checksums.begin(), op->checksums.end());
+        buf.Copy(&op->dataBuf, (int)op->numBytesIO);
+        numBytes += op->numBytesIO;
+    }
+    int HandleDone(int code, void* data)
+    {
+        const int res = data ? *reinterpret_cast<const int*>(data) : -EIO;
+        for (WriteOps::const_iterator it = ops.begin(); it != ops.end(); ++it) {
+            WriteOp* const op = *it;
+            if (code == EVENT_DISK_WROTE) {
+                int len = (int)max(int64_t(0), min((int64_t)op->numBytesIO,
+                    (int64_t)res - (op->offset - offset)));
+                op->HandleEvent(EVENT_DISK_WROTE, &len);
+            } else {
+                int status = res;
+                op->HandleEvent(EVENT_DISK_ERROR, &status);
+            }
+        }
+        delete this;
+        return 0;
+    }
+    void Fail(int status)
+    {
+        HandleDone(EVENT_DISK_ERROR, &status);
+    }
+
+    ChunkInfoHandle*  chunkInfoHandle;
+    const int64_t     offset;
+    int64_t           numBytes;
+    WriteOps          ops;
+    vector<uint32_t>  checksums;
+    IOBuffer          buf;
+    DiskIoPtr         diskIo;
+private:
+    typedef QCDLListOp<ChunkWriteCoalescer> List;
+    ChunkWriteCoalescer* mPrevPtr[1];
+    ChunkWriteCoalescer* mNextPtr[1];
+    friend class QCDLListOp<ChunkWriteCoalescer>;
+
+    virtual ~ChunkWriteCoalescer()
+        { assert(! List::IsInList(*this)); }
+    ChunkWriteCoalescer(const ChunkWriteCoalescer&);
+    ChunkWriteCoalescer& operator=(const ChunkWriteCoalescer&);
+};
+typedef QCDLList<ChunkWriteCoalescer> WriteCoalesceList;
+
 /// Encapsulate a chunk file descriptor and information about the
 /// chunk such as name and version #.
 class ChunkInfoHandle : public KfsCallbackObj
@@ -831,6 +1161,8 @@ public:
           dataFH(),
           lastIOTime(0),
           readChunkMetaOp(0),
+          readAhead(0),
+          writeCoalescer(0),
           mBeingReplicatedFlag(false),
           mDeleteFlag(false),
           mWriteAppenderOwnsFlag(false),
@@ -841,6 +1173,9 @@ public:
           mKeepFlag(false),
           mForceDeleteObjectStoreBlockFlag(false),
           mWriteIdIssuedFlag(false),
+          mFdEvictedFlag(false),
+          mFdHotFlag(false),
+          mShortCircuitGrantFlag(false),
           mChunkList(ChunkManager::kChunkLruList),
           mChunkDirList(ChunkDirInfo::kChunkDirList),
           mRenamesInFlight(0),
@@ -850,10 +1185,12 @@ public:
           mWriteMetaOpsTail(0),
           mReadableNotifyHead(0),
           mReadableNotifyTail(0),
+          mVerifiedBlocks(0),
           mChunkDir(chunkdir)
     {
         ChunkList::Init(*this);
         ChunkDirList::Init(*this);
+        ChunkMetaCacheList::Init(*this);
         ChunkDirList::PushBack(mChunkDir.chunkLists[mChunkDirList], *this);
         SET_HANDLER(this, &ChunkInfoHandle::HandleChunkMetaWriteDone);
         mChunkDir.chunkCount++;
@@ -914,8 +1251,19 @@ public:
     time_t           lastIOTime;
     /// keep track of the op that is doing the read
     ReadChunkMetaOp* readChunkMetaOp;
+    /// sequential read ahead state, if any
+    ChunkReadAhead*  readAhead;
+    /// coalesced writes pending flush, if any
+    ChunkWriteCoalescer* writeCoalescer;
 
-    void Release(ChunkLists* chunkInfoLists);
+    void ReleaseReadAhead() {
+        if (readAhead) {
+            ChunkReadAhead* const ra = readAhead;
+            readAhead = 0;
+            ra->Detach();
+        }
+    }
+    void Release(ChunkLists* chunkInfoLists, bool keepChecksumsFlag = false);
     bool IsFileOpen() const {
         return (dataFH && dataFH->IsOpen());
     }
@@ -927,6 +1275,8 @@ public:
     }
     void StartWrite(WriteOp* /* op */) {
         assert(mWritesInFlight >= 0);
+        InvalidateVerifiedBlocks();
+        RevokeShortCircuit();
         mWritesInFlight++;
         mMetaDirtyFlag = true;
     }
@@ -1098,6 +1448,9 @@ public:
             mChunkDir.readCounters.Update(status, readSize, ioTimeMicrosec);
             mChunkDir.totalReadCounters.Update(
                 status, readSize, ioTimeMicrosec);
+            if (0 <= status) {
+                mChunkDir.UpdateLatency(ioTimeMicrosec);
+            }
         }
     }
     void WriteStats(int status, int64_t writeSize, int64_t ioTimeMicrosec) {
@@ -1105,6 +1458,9 @@ public:
             mChunkDir.writeCounters.Update(status, writeSize, ioTimeMicrosec);
             mChunkDir.totalWriteCounters.Update(
                 status, writeSize, ioTimeMicrosec);
+            if (0 <= status) {
+                mChunkDir.UpdateLatency(ioTimeMicrosec);
+            }
         }
     }
     void UpdateDirStableCount() {
@@ -1161,6 +1517,68 @@ public:
     bool GetWriteIdIssuedFlag() const {
         return mWriteIdIssuedFlag;
     }
+    // Fd cache state: evicted is set when the fd is closed by the inactive
+    // fd cleanup, hot is set when the chunk is re-opened shortly after.
+    void SetFdEvictedFlag(bool flag) {
+        mFdEvictedFlag = flag;
+    }
+    bool GetFdEvictedFlag() const {
+        return mFdEvictedFlag;
+    }
+    void SetFdHotFlag(bool flag) {
+        mFdHotFlag = flag;
+    }
+    bool GetFdHotFlag() const {
+        return mFdHotFlag;
+    }
+    // Blocks with checksums verified by the prior reads of the stable chunk
+    // with buffered io, where the subsequent reads are likely to be served
+    // from the os buffer cache. The bitmap is discarded on write, truncate,
+    // close, and when it gets older than the max age.
+    class VerifiedBlocks : public bitset<MAX_CHUNK_CHECKSUM_BLOCKS>
+    {
+    public:
+        VerifiedBlocks(time_t now)
+            : bitset<MAX_CHUNK_CHECKSUM_BLOCKS>(),
+              time(now)
+            {}
+        const time_t time;
+    };
+    const VerifiedBlocks* GetVerifiedBlocks(time_t now, int maxAge) {
+        if (mVerifiedBlocks && mVerifiedBlocks->time + maxAge < now) {
+            InvalidateVerifiedBlocks();
+        }
+        return mVerifiedBlocks;
+    }
+    void SetBlocksVerified(size_t start, size_t count, time_t now) {
+        if (! chunkInfo.AreChecksumsLoaded()) {
+            return;
+        }
+        if (! mVerifiedBlocks) {
+            mVerifiedBlocks = new VerifiedBlocks(now);
+        }
+        for (size_t i = start;
+                i < start + count && i < MAX_CHUNK_CHECKSUM_BLOCKS;
+                i++) {
+            // No checksum for sparse blocks.
+            if (chunkInfo.chunkBlockChecksum[i] != 0) {
+                mVerifiedBlocks->set(i);
+            }
+        }
+    }
+    void InvalidateVerifiedBlocks() {
+        delete mVerifiedBlocks;
+        mVerifiedBlocks = 0;
+    }
+    void SetShortCircuitGranted() {
+        mShortCircuitGrantFlag = true;
+    }
+    void RevokeShortCircuit() {
+        if (mShortCircuitGrantFlag) {
+            mShortCircuitGrantFlag = false;
+            gShortCircuitServer.Revoke(chunkInfo.chunkId);
+        }
+    }
     inline bool ScheduleObjTableCleanup(
         ChunkLists* chunkInfoLists);
 
@@ -1175,6 +1593,9 @@ private:
     bool                        mKeepFlag:1;
     bool                        mForceDeleteObjectStoreBlockFlag:1;
     bool                        mWriteIdIssuedFlag:1;
+    bool                        mFdEvictedFlag:1;
+    bool                        mFdHotFlag:1;
+    bool                        mShortCircuitGrantFlag:1;
     ChunkManager::ChunkListType mChunkList:2;
     ChunkDirInfo::ChunkListType mChunkDirList:2;
     unsigned int                mRenamesInFlight:19;
@@ -1186,9 +1607,11 @@ private:
     WriteChunkMetaOp*           mWriteMetaOpsTail;
     KfsOp*                      mReadableNotifyHead;
     KfsOp*                      mReadableNotifyTail;
+    VerifiedBlocks*             mVerifiedBlocks;
     ChunkDirInfo&               mChunkDir;
-    ChunkInfoHandle*            mPrevPtr[ChunkDirInfo::kChunkInfoHDirListCount];
-    ChunkInfoHandle*            mNextPtr[ChunkDirInfo::kChunkInfoHDirListCount];
+    // The last entry is chunk meta data cache list.
+    ChunkInfoHandle*            mPrevPtr[ChunkDirInfo::kChunkInfoHDirListCount + 1];
+    ChunkInfoHandle*            mNextPtr[ChunkDirInfo::kChunkInfoHDirListCount + 1];
 
     void DetachFromChunkDir(bool evacuateFlag) {
         if (mChunkDirList == ChunkDirInfo::kChunkDirListNone) {
@@ -1230,6 +1653,14 @@ private:
         if (IsFileOpen()) {
             globals().ctrOpenDiskFds.Update(-1);
         }
+        ReleaseReadAhead();
+        InvalidateVerifiedBlocks();
+        RevokeShortCircuit();
+        if (writeCoalescer) {
+            writeCoalescer->chunkInfoHandle = 0;
+            gChunkManager.WriteCoalesceFlush(*writeCoalescer);
+        }
+        gChunkManager.ChunkMetaCacheRemove(*this);
     }
     void UpdateState() {
         if (mInDoneHandlerFlag) {
@@ -1270,6 +1701,7 @@ private:
     }
     friend class QCDLListOp<ChunkInfoHandle, 0>;
     friend class QCDLListOp<ChunkInfoHandle, 1>;
+    friend class QCDLListOp<ChunkInfoHandle, 2>;
 private:
     ChunkInfoHandle(const  ChunkInfoHandle&);
     ChunkInfoHandle& operator=(const  ChunkInfoHandle&);
@@ -1372,7 +1804,49 @@ ChunkManager::LruUpdate(ChunkInfoHandle& cih)
 inline void
 ChunkManager::Release(ChunkInfoHandle& cih)
 {
-    cih.Release(mChunkInfoLists);
+    // Keep checksums of closed stable chunks in the cache, the chunk header
+    // read is not needed if the chunk is re-opened soon after.
+    const bool keepChecksumsFlag =
+        0 < mChunkMetaCacheMaxSize &&
+        cih.IsFileOpen() &&
+        0 <= cih.chunkInfo.chunkVersion &&
+        cih.IsStable() &&
+        ! cih.IsStale() &&
+        ! cih.IsBeingReplicated() &&
+        cih.chunkInfo.AreChecksumsLoaded();
+    ChunkMetaCacheRemove(cih);
+    cih.Release(mChunkInfoLists, keepChecksumsFlag);
+    if (keepChecksumsFlag) {
+        ChunkMetaCacheList::PushBack(mChunkMetaCacheList, cih);
+        mChunkMetaCacheCount++;
+        ChunkMetaCacheTrim();
+    }
+}
+
+inline bool
+ChunkManager::ChunkMetaCacheRemove(ChunkInfoHandle& cih)
+{
+    if (! ChunkMetaCacheList::IsInList(mChunkMetaCacheList, cih)) {
+        return false;
+    }
+    ChunkMetaCacheList::Remove(mChunkMetaCacheList, cih);
+    mChunkMetaCacheCount--;
+    assert(0 <= mChunkMetaCacheCount);
+    return true;
+}
+
+inline void
+ChunkManager::ChunkMetaCacheTrim()
+{
+    const int64_t maxCount = mChunkMetaCacheMaxSize /
+        (int64_t)(MAX_CHUNK_CHECKSUM_BLOCKS * sizeof(uint32_t));
+    ChunkInfoHandle* cih;
+    while (maxCount < mChunkMetaCacheCount &&
+            (cih = ChunkMetaCacheList::PopFront(mChunkMetaCacheList))) {
+        mChunkMetaCacheCount--;
+        mCounters.mChunkMetaCacheEvictCount++;
+        cih->chunkInfo.UnloadChecksums();
+    }
 }
 
 inline void
@@ -1431,6 +1905,9 @@ inline void
 ChunkManager::MakeStale(ChunkInfoHandle& cih,
     bool forceDeleteFlag, bool evacuatedFlag, KfsOp* op)
 {
+    if (cih.writeCoalescer) {
+        WriteCoalesceFlush(*cih.writeCoalescer);
+    }
     cih.MakeStale(mChunkInfoLists,
         (! forceDeleteFlag && ! mForceDeleteStaleChunksFlag) ||
         (evacuatedFlag && mKeepEvacuatedChunksFlag),
@@ -1441,9 +1918,14 @@ ChunkManager::MakeStale(ChunkInfoHandle& cih,
 }
 
 void
-ChunkInfoHandle::Release(ChunkInfoHandle::ChunkLists* chunkInfoLists)
+ChunkInfoHandle::Release(ChunkInfoHandle::ChunkLists* chunkInfoLists,
+    bool keepChecksumsFlag)
 {
-    chunkInfo.UnloadChecksums();
+    ReleaseReadAhead();
+    InvalidateVerifiedBlocks();
+    if (! keepChecksumsFlag) {
+        chunkInfo.UnloadChecksums();
+    }
     if (! IsFileOpen()) {
         if (dataFH) {
             dataFH.reset();
@@ -1704,6 +2186,10 @@ ChunkInfoHandle::HandleChunkMetaWriteDone(int codeIn, void* dataIn)
                     IsFileOpen();
                 mStableFlag = mWriteMetaOpsHead->stableFlag;
                 chunkInfo.chunkVersion = mWriteMetaOpsHead->targetVersion;
+                if (! mStableFlag) {
+                    InvalidateVerifiedBlocks();
+                    RevokeShortCircuit();
+                }
                 if (updateFlag) {
                     UpdateDirStableCount();
                 }
@@ -1782,6 +2268,17 @@ ChunkManager::ChunkManager()
       mChunkTable(),
       mObjTable(),
       mMaxIORequestSize(4 << 20),
+      mChunkMetaCacheCount(0),
+      mChunkMetaCacheMaxSize(int64_t(64) << 20),
+      mReadAheadMaxSize(4 << 20),
+      mReadAheadMinSequentialCount(2),
+      mReadAheadQueueDepthThreshold(16),
+      mReadAheadDoneQueue(),
+      mReadAheadDoneQueueTmp(),
+      mWriteCoalesceMaxSize(1 << 20),
+      mChunkFilePoolSize(0),
+      mChunkFilePoolMinFreeSpaceRatio(0.1),
+      mReclaimMaxInFlightPerDir(1),
       mNextChunkDirsCheckTime(globalNetManager().Now() - 360000),
       mChunkDirsCheckIntervalSecs(120),
       mNextGetFsSpaceAvailableTime(globalNetManager().Now() - 360000),
@@ -1792,6 +2289,14 @@ ChunkManager::ChunkManager()
       mNextInactiveFdCleanupTime(globalNetManager().Now() - 365 * 24 * 60 * 60),
       mInactiveFdFullScanIntervalSecs(2),
       mNextInactiveFdFullScanTime(globalNetManager().Now() - 365 * 24 * 60 * 60),
+      mFdCacheReopenWindowSecs(10 * 60),
+      mFdCacheHotMaxIdleSecs(10 * 60),
+      mFdCacheHotMaxFdUseRatio(0.5),
+      mChunkReadCounts(),
+      mChunkReadCountsStartTime(globalNetManager().Now()),
+      mHotChunkMinReadRate(8),
+      mHotChunkMaxTracked(16 << 10),
+      mHotChunkMaxReported(64),
       mReadChecksumMismatchMaxRetryCount(0),
       mAbortOnChecksumMismatchFlag(false),
       mRequireChunkHeaderChecksumFlag(false),
@@ -1806,6 +2311,11 @@ ChunkManager::ChunkManager()
       mMaxPlacementSpaceRatio(0.2),
       mMinPendingIoThreshold(8 << 20),
       mPlacementMaxWaitingAvgUsecsThreshold(5 * 60 * 1000 * 1000),
+      mSlowDirLatencyRatio(5),
+      mSlowDirMinLatencyUsec(20 * 1000),
+      mSlowDirMinIoCount(256),
+      mSlowDirLatencyEwmaWeight(0.02),
+      mSlowDirPlacementWeight(0.1),
       mAllowSparseChunksFlag(true),
       mBufferedIoFlag(false),
       mSyncChunkHeaderFlag(false),
@@ -1818,9 +2328,12 @@ ChunkManager::ChunkManager()
       mCleanupChunkDirsFlag(true),
       mStaleChunksDir("lost+found"),
       mDirtyChunksDir("dirty"),
+      mChunkFilePoolDir("chunkpool"),
+      mReclaimDir("reclaim"),
       mEvacuateFileName("evacuate"),
       mEvacuateDoneFileName(mEvacuateFileName + ".done"),
       mChunkDirLockName("lock"),
+      mChunkInventoryFileName("chunkinventory"),
       mEvacuationInactivityTimeout(300),
       mMetaHeartbeatTime(globalNetManager().Now() - 365 * 24 * 60 * 60),
       mMetaEvacuateCount(-1),
@@ -1833,9 +2346,12 @@ ChunkManager::ChunkManager()
       mObjStorageTiersPrefixes(),
       mObjStorageTiersSetFlag(false),
       mBufferedIoPrefixes(),
+      mStorageTierIoPolicy(),
+      mMemoryStorageTierMaxSpace(-1),
       mBufferedIoSetFlag(false),
       mDiskBufferManagerEnabledFlag(true),
       mForceVerifyDiskReadChecksumFlag(false),
+      mReadVerifiedBlocksMaxAge(60),
       mWritePrepareReplyFlag(true),
       mCryptoKeys(globalNetManager(), 0 /* inMutexPtr */),
       mFileSystemId(-1),
@@ -1857,6 +2373,13 @@ ChunkManager::ChunkManager()
       mObjStoreBlockMaxNonStableDisconnectedTime(LEASE_INTERVAL_SECS * 3 / 2),
       mObjBlockDiscardMinMetaUptime(90),
       mObjStoreIoThreadCount(-1),
+      mStorageTierStaging(),
+      mDestageMinIdleSec(60),
+      mDestageMaxInFlight(2),
+      mDestageIoSize(4 << 20),
+      mDestageInFlight(0),
+      mNextDestageTime(0),
+      mDestageShutdownFlag(false),
       mRand(),
       mChunkHeaderBuffer()
 {
@@ -1865,6 +2388,12 @@ ChunkManager::ChunkManager()
     for (int i = 0; i < kChunkInfoListCount; i++) {
         ChunkList::Init(mChunkInfoLists[i]);
     }
+    ChunkMetaCacheList::Init(mChunkMetaCacheList);
+    WriteCoalesceList::Init(mWriteCoalesceList);
+    for (size_t i = 0; i < kKfsSTierCount; i++) {
+        mStagingTiers[i] = kKfsSTierUndef;
+        mDestageTiers[i] = kKfsSTierUndef;
+    }
     globalNetManager().SetMaxAcceptsPerRead(4096);
 }
 
@@ -1938,7 +2467,11 @@ ChunkManager::Shutdown()
     // Force meta server connection down first.
     gMetaServerSM.Shutdown();
     mDirChecker.Stop();
+    gChunkScrubber.Shutdown();
+    gShortCircuitServer.Shutdown();
+    mDestageShutdownFlag = true;
     gClientManager.Shutdown();
+    RunWriteCoalesceQueue();
     // Run delete queue before removing chunk table entries.
     RunStaleChunksQueue();
     for (int i = 0; ;) {
@@ -1962,6 +2495,7 @@ ChunkManager::Shutdown()
         }
         usleep(10000);
     }
+    WriteChunkInventories();
     ScavengePendingWrites(time(0) + 2 * mMaxPendingWriteLruSecs);
     ClearTable(mObjTable);
     ClearTable(mChunkTable);
@@ -1986,6 +2520,82 @@ ChunkManager::Shutdown()
     }
 }
 
+void
+ChunkManager::WriteChunkInventories()
+{
+    if (mChunkInventoryFileName.empty() || mChunkDirs.empty()) {
+        return;
+    }
+    vector<DirChecker::ChunkInfos> dirChunks(mChunkDirs.size());
+    vector<bool>                   skipFlags(mChunkDirs.size(), false);
+    mChunkTable.First();
+    const CMapEntry* p;
+    while ((p = mChunkTable.Next())) {
+        const ChunkInfoHandle* const cih = p->GetVal();
+        const size_t idx = &cih->GetDirInfo() - mChunkDirs.begin();
+        if (mChunkDirs.size() <= idx || skipFlags[idx]) {
+            continue;
+        }
+        if (cih->IsRenameInFlight()) {
+            // The directory content is about to change.
+            skipFlags[idx] = true;
+            continue;
+        }
+        // Non stable chunks are in the dirty chunks directory, and deleted on
+        // restart.
+        if (! cih->IsStable() || cih->chunkInfo.chunkVersion < 0) {
+            continue;
+        }
+        DirChecker::ChunkInfo ci;
+        ci.mFileId       = cih->chunkInfo.fileId;
+        ci.mChunkId      = cih->chunkInfo.chunkId;
+        ci.mChunkVersion = cih->chunkInfo.chunkVersion;
+        ci.mChunkSize    = cih->chunkInfo.chunkSize;
+        dirChunks[idx].PushBack(ci);
+    }
+    for (size_t i = 0; i < mChunkDirs.size(); i++) {
+        const ChunkDirInfo& dir = mChunkDirs[i];
+        if (dir.availableSpace < 0 || skipFlags[i]) {
+            continue;
+        }
+        mDirChecker.WriteChunkInventory(
+            dir.dirname, dir.fileSystemId, dirChunks[i]);
+    }
+}
+
+void
+ChunkManager::GetStableChunkIds(DirChunkIds& outDirChunkIds)
+{
+    outDirChunkIds.clear();
+    if (mChunkDirs.empty()) {
+        return;
+    }
+    vector<ChunkIds> dirChunks(mChunkDirs.size());
+    mChunkTable.First();
+    const CMapEntry* p;
+    while ((p = mChunkTable.Next())) {
+        const ChunkInfoHandle* const cih = p->GetVal();
+        const size_t idx = &cih->GetDirInfo() - mChunkDirs.begin();
+        if (mChunkDirs.size() <= idx ||
+                ! cih->IsStable() ||
+                cih->chunkInfo.chunkVersion < 0 ||
+                cih->chunkInfo.chunkSize <= 0 ||
+                cih->IsRenameInFlight()) {
+            continue;
+        }
+        dirChunks[idx].push_back(cih->chunkInfo.chunkId);
+    }
+    for (size_t i = 0; i < mChunkDirs.size(); i++) {
+        const ChunkDirInfo& dir = mChunkDirs[i];
+        if (dir.availableSpace < 0 || dir.evacuateStartedFlag) {
+            continue;
+        }
+        ChunkIds& ids = outDirChunkIds[dir.dirname];
+        ids.swap(dirChunks[i]);
+        sort(ids.begin(), ids.end());
+    }
+}
+
 bool
 ChunkManager::IsWriteAppenderOwns(
     kfsChunkId_t chunkId, int64_t chunkVersion) const
@@ -2025,6 +2635,47 @@ ChunkManager::SetParameters(const Properties& prop)
     mInactiveFdFullScanIntervalSecs = max(0, (int)prop.getValue(
         "chunkServer.inactiveFdFullScanIntervalSecs",
         (double)mInactiveFdFullScanIntervalSecs));
+    mFdCacheReopenWindowSecs = max(0, prop.getValue(
+        "chunkServer.fdCache.reopenWindowSecs", mFdCacheReopenWindowSecs));
+    mFdCacheHotMaxIdleSecs = max(0, prop.getValue(
+        "chunkServer.fdCache.hotMaxIdleSecs", mFdCacheHotMaxIdleSecs));
+    mFdCacheHotMaxFdUseRatio = max(0.0, min(1.0, prop.getValue(
+        "chunkServer.fdCache.hotMaxFdUseRatio", mFdCacheHotMaxFdUseRatio)));
+    mHotChunkMinReadRate = prop.getValue(
+        "chunkServer.hotChunks.minReadRate", mHotChunkMinReadRate);
+    mHotChunkMaxTracked = prop.getValue(
+        "chunkServer.hotChunks.maxTracked", mHotChunkMaxTracked);
+    mHotChunkMaxReported = prop.getValue(
+        "chunkServer.hotChunks.maxReported", mHotChunkMaxReported);
+    if (mHotChunkMinReadRate <= 0 || mHotChunkMaxTracked <= 0 ||
+            mHotChunkMaxReported <= 0) {
+        mChunkReadCounts.clear();
+    }
+    mChunkMetaCacheMaxSize = max(int64_t(0), (int64_t)prop.getValue(
+        "chunkServer.chunkMetaCacheMaxSize",
+        (double)mChunkMetaCacheMaxSize));
+    ChunkMetaCacheTrim();
+    mReadAheadMaxSize = max(int64_t(0), (int64_t)prop.getValue(
+        "chunkServer.readAhead.maxSize",
+        (double)mReadAheadMaxSize));
+    mReadAheadMinSequentialCount = max(1, prop.getValue(
+        "chunkServer.readAhead.minSequentialCount",
+        mReadAheadMinSequentialCount));
+    mReadAheadQueueDepthThreshold = prop.getValue(
+        "chunkServer.readAhead.queueDepthThreshold",
+        mReadAheadQueueDepthThreshold);
+    mWriteCoalesceMaxSize = max(int64_t(0), (int64_t)prop.getValue(
+        "chunkServer.writeCoalesce.maxSize",
+        (double)mWriteCoalesceMaxSize));
+    mChunkFilePoolSize = max(0, prop.getValue(
+        "chunkServer.chunkFilePool.size",
+        mChunkFilePoolSize));
+    mChunkFilePoolMinFreeSpaceRatio = prop.getValue(
+        "chunkServer.chunkFilePool.minFreeSpaceRatio",
+        mChunkFilePoolMinFreeSpaceRatio);
+    mReclaimMaxInFlightPerDir = max(0, prop.getValue(
+        "chunkServer.reclaim.maxInFlightPerDir",
+        mReclaimMaxInFlightPerDir));
     mMaxPendingWriteLruSecs = max(1, (int)prop.getValue(
         "chunkServer.maxPendingWriteLruSecs",
         (double)mMaxPendingWriteLruSecs));
@@ -2089,6 +2740,21 @@ ChunkManager::SetParameters(const Properties& prop)
     mPlacementMaxWaitingAvgUsecsThreshold = (int64_t)(1e6 * prop.getValue(
         "chunkServer.placementMaxWaitingAvgSecsThreshold",
         (double)mPlacementMaxWaitingAvgUsecsThreshold * 1e-6));
+    mSlowDirLatencyRatio = prop.getValue(
+        "chunkServer.slowDir.latencyRatio",
+        mSlowDirLatencyRatio);
+    mSlowDirMinLatencyUsec = (int64_t)(1e3 * prop.getValue(
+        "chunkServer.slowDir.minLatencyMs",
+        (double)mSlowDirMinLatencyUsec * 1e-3));
+    mSlowDirMinIoCount = prop.getValue(
+        "chunkServer.slowDir.minIoCount",
+        mSlowDirMinIoCount);
+    mSlowDirLatencyEwmaWeight = min(1., max(1e-6, prop.getValue(
+        "chunkServer.slowDir.latencyEwmaWeight",
+        mSlowDirLatencyEwmaWeight)));
+    mSlowDirPlacementWeight = prop.getValue(
+        "chunkServer.slowDir.placementWeight",
+        mSlowDirPlacementWeight);
     mMaxPlacementSpaceRatio = prop.getValue(
         "chunkServer.maxPlacementSpaceRatio",
         mMaxPlacementSpaceRatio);
@@ -2128,6 +2794,9 @@ ChunkManager::SetParameters(const Properties& prop)
     mDirChecker.SetMaxChunkFilesSampled(prop.getValue(
         "chunkServer.dirCheckMaxChunkFilesSampled",
         mDirChecker.GetMaxChunkFilesSampled()));
+    mDirChecker.SetMaxScanThreads(prop.getValue(
+        "chunkServer.dirCheckMaxScanThreads",
+        mDirChecker.GetMaxScanThreads()));
     mCleanupChunkDirsFlag = prop.getValue(
         "chunkServer.cleanupChunkDirs",
         mCleanupChunkDirsFlag);
@@ -2140,6 +2809,16 @@ ChunkManager::SetParameters(const Properties& prop)
         "chunkServer.tcpSocket.sendBufSize",
         TcpSocket::GetDefaultSendBufSize()));
 
+    NetConnection::SetZeroCopyMinSize(prop.getValue(
+        "chunkServer.net.zeroCopyMinSize",
+        NetConnection::GetZeroCopyMinSize()));
+    NetManager::SetSlowDispatchThresholdUsec(prop.getValue(
+        "chunkServer.netManager.slowDispatchThresholdUsec",
+        NetManager::GetSlowDispatchThresholdUsec()));
+    NetManager::SetEdgeTriggeredPoll(prop.getValue(
+        "chunkServer.netManager.edgeTriggeredPoll",
+        NetManager::GetEdgeTriggeredPoll() ? 1 : 0) != 0);
+
     globalNetManager().SetMaxAcceptsPerRead(prop.getValue(
         "chunkServer.net.maxAcceptsPerRead",
         globalNetManager().GetMaxAcceptsPerRead()));
@@ -2165,6 +2844,9 @@ ChunkManager::SetParameters(const Properties& prop)
         "chunkServer.availableChunksRetryInterval",
         (double)mAvailableChunksRetryInterval / 1000) * 1000.));
 
+    gChunkScrubber.SetParameters(prop);
+    gShortCircuitServer.SetParameters(prop);
+
     DirChecker::FileNames names;
     names.insert(mEvacuateDoneFileName);
     mDirChecker.SetDontUseIfExist(names);
@@ -2175,6 +2857,10 @@ ChunkManager::SetParameters(const Properties& prop)
     if (! mCheckDirWritableTmpFileName.empty()) {
         names.insert(mCheckDirWritableTmpFileName);
     }
+    if (! gChunkScrubber.GetProgressFileName().empty()) {
+        names.insert(gChunkScrubber.GetProgressFileName());
+        names.insert(gChunkScrubber.GetProgressTmpFileName());
+    }
     mDirChecker.SetIgnoreFileNames(names);
 
     gAtomicRecordAppendManager.SetParameters(prop);
@@ -2198,6 +2884,9 @@ ChunkManager::SetParameters(const Properties& prop)
     mForceVerifyDiskReadChecksumFlag = prop.getValue(
         "chunkServer.forceVerifyDiskReadChecksum",
         mForceVerifyDiskReadChecksumFlag ? 1 : 0) != 0;
+    mReadVerifiedBlocksMaxAge = prop.getValue(
+        "chunkServer.readVerifiedBlocksMaxAgeSec",
+        mReadVerifiedBlocksMaxAge);
     mWritePrepareReplyFlag = prop.getValue(
         "chunkServer.debugTestWriteSync",
         mWritePrepareReplyFlag ? 0 : 1) == 0;
@@ -2255,8 +2944,11 @@ ChunkManager::SetParameters(const Properties& prop)
     mDirChecker.SetFsIdPrefix(mFsIdFileNamePrefix);
     SetDirCheckerIoTimeout();
     ClientSM::SetParameters(prop);
+    gChunkServer.SetParameters(prop);
+    KfsClientChunkOp::SetParameters(prop);
     SetStorageTiers(prop);
     SetBufferedIo(prop);
+    SetStagingTiers(prop);
     string errMsg;
     const int err = mCryptoKeys.SetParameters(
         "chunkServer.cryptoKeys.", prop, errMsg);
@@ -2291,6 +2983,8 @@ ChunkManager::SetStorageTiers(const Properties& props)
         } else {
             SetStorageTiers(mStorageTiersPrefixes, mChunkDirs, mStorageTiers);
             mStorageTiersSetFlag = true;
+            // Tier io policy depends on the tier assignment.
+            mBufferedIoSetFlag   = false;
         }
     }
     const string prevObjPrefixes = mObjStorageTiersPrefixes;
@@ -2384,10 +3078,19 @@ ChunkManager::SetStorageTiers(
 void
 ChunkManager::SetBufferedIo(const Properties& props)
 {
-    const string prevPrefixes = mBufferedIoPrefixes;
+    const string  prevPrefixes    = mBufferedIoPrefixes;
+    const string  prevPolicy      = mStorageTierIoPolicy;
+    const int64_t prevMemMaxSpace = mMemoryStorageTierMaxSpace;
     mBufferedIoPrefixes = props.getValue(
         "chunkServer.bufferedIoDirPrefixes", mBufferedIoPrefixes);
-    if (prevPrefixes == mBufferedIoPrefixes && mBufferedIoSetFlag) {
+    mStorageTierIoPolicy = props.getValue(
+        "chunkServer.storageTierIoPolicy", mStorageTierIoPolicy);
+    mMemoryStorageTierMaxSpace = props.getValue(
+        "chunkServer.memoryStorageTierMaxSpace", mMemoryStorageTierMaxSpace);
+    if (prevPrefixes == mBufferedIoPrefixes &&
+            prevPolicy == mStorageTierIoPolicy &&
+            prevMemMaxSpace == mMemoryStorageTierMaxSpace &&
+            mBufferedIoSetFlag) {
         return;
     }
     if (mChunkDirs.empty()) {
@@ -2400,6 +3103,47 @@ ChunkManager::SetBufferedIo(const Properties& props)
     while ((is >> prefix)) {
         prefixes.insert(prefix);
     }
+    // Per tier policy: direct, buffered, bufferedRead, or memory. The
+    // bufferedRead uses buffered io only for reading stable chunks, in order
+    // to let os page cache hold "hot" chunks, while writes and re-replication
+    // continue to use direct io. The memory policy declares the tier chunk
+    // directories memory backed (tmpfs), with buffered io, no chunk file pool,
+    // and the space optionally bounded by memoryStorageTierMaxSpace.
+    enum {
+        kIoPolicyDirect,
+        kIoPolicyBuffered,
+        kIoPolicyBufferedRead,
+        kIoPolicyMemory
+    };
+    int tierPolicy[kKfsSTierMax + 1];
+    for (int i = 0; i <= kKfsSTierMax; i++) {
+        tierPolicy[i] = kIoPolicyDirect;
+    }
+    istringstream pis(mStorageTierIoPolicy);
+    int    tier;
+    string policy;
+    while ((pis >> tier >> policy)) {
+        if (tier < kKfsSTierMin || kKfsSTierMax < tier) {
+            KFS_LOG_STREAM_ERROR <<
+                "storage tier io policy: invalid tier: " << tier <<
+            KFS_LOG_EOM;
+            continue;
+        }
+        if (policy == "buffered") {
+            tierPolicy[tier] = kIoPolicyBuffered;
+        } else if (policy == "bufferedRead") {
+            tierPolicy[tier] = kIoPolicyBufferedRead;
+        } else if (policy == "memory") {
+            tierPolicy[tier] = kIoPolicyMemory;
+        } else if (policy == "direct") {
+            tierPolicy[tier] = kIoPolicyDirect;
+        } else {
+            KFS_LOG_STREAM_ERROR <<
+                "storage tier io policy: invalid policy: " << policy <<
+                " tier: " << tier <<
+            KFS_LOG_EOM;
+        }
+    }
     for (ChunkDirs::iterator it = mChunkDirs.begin();
             it != mChunkDirs.end();
             ++it) {
@@ -2412,7 +3156,16 @@ ChunkManager::SetBufferedIo(const Properties& props)
                 break;
             }
         }
-        const bool bufferedIoFlag = pit != prefixes.end();
+        const int  policy         = (kKfsSTierMin <= it->storageTier &&
+                it->storageTier <= kKfsSTierMax) ?
+            tierPolicy[it->storageTier] : (int)kIoPolicyDirect;
+        it->memoryFlag     = policy == kIoPolicyMemory;
+        it->memoryMaxSpace = it->memoryFlag ? mMemoryStorageTierMaxSpace : -1;
+        // Memory file systems do not support direct io.
+        const bool bufferedIoFlag = pit != prefixes.end() ||
+            policy == kIoPolicyBuffered || it->memoryFlag;
+        it->bufferedReadFlag = ! bufferedIoFlag &&
+            policy == kIoPolicyBufferedRead;
         if (bufferedIoFlag != it->bufferedIoFlag) {
             it->bufferedIoFlag = bufferedIoFlag;
             if (it->availableSpace < 0 && ! it->dirLock) {
@@ -2509,9 +3262,26 @@ ChunkManager::Init(const vector<string>& chunkDirs, const Properties& prop)
     mDirtyChunksDir = prop.getValue(
         "chunkServer.dirtyChunksDir",
         mDirtyChunksDir);
+    mChunkFilePoolDir = prop.getValue(
+        "chunkServer.chunkFilePoolDir",
+        mChunkFilePoolDir);
+    mReclaimDir = prop.getValue(
+        "chunkServer.reclaimDir",
+        mReclaimDir);
     mChunkDirLockName = prop.getValue(
         "chunkServer.dirLockFileName",
         mChunkDirLockName);
+    mChunkInventoryFileName = prop.getValue(
+        "chunkServer.chunkInventoryFileName",
+        mChunkInventoryFileName);
+    if (mChunkInventoryFileName.find('/') != string::npos ||
+            (! mChunkInventoryFileName.empty() &&
+                mChunkInventoryFileName == mChunkDirLockName)) {
+        KFS_LOG_STREAM_ERROR <<
+            "invalid chunk inventory file name: " << mChunkInventoryFileName <<
+        KFS_LOG_EOM;
+        return false;
+    }
     if (mStaleChunksDir.empty() || mStaleChunksDir.find('/') != string::npos) {
         KFS_LOG_STREAM_ERROR <<
             "invalid stale chunks dir name: " << mStaleChunksDir <<
@@ -2524,8 +3294,29 @@ ChunkManager::Init(const vector<string>& chunkDirs, const Properties& prop)
         KFS_LOG_EOM;
         return false;
     }
-    mStaleChunksDir = AddTrailingPathSeparator(mStaleChunksDir);
-    mDirtyChunksDir = AddTrailingPathSeparator(mDirtyChunksDir);
+    if (mChunkFilePoolDir.empty() ||
+            mChunkFilePoolDir.find('/') != string::npos ||
+            mChunkFilePoolDir == mDirtyChunksDir ||
+            mChunkFilePoolDir == mStaleChunksDir) {
+        KFS_LOG_STREAM_ERROR <<
+            "invalid chunk file pool dir name: " << mChunkFilePoolDir <<
+        KFS_LOG_EOM;
+        return false;
+    }
+    if (mReclaimDir.empty() ||
+            mReclaimDir.find('/') != string::npos ||
+            mReclaimDir == mDirtyChunksDir ||
+            mReclaimDir == mStaleChunksDir ||
+            mReclaimDir == mChunkFilePoolDir) {
+        KFS_LOG_STREAM_ERROR <<
+            "invalid reclaim dir name: " << mReclaimDir <<
+        KFS_LOG_EOM;
+        return false;
+    }
+    mStaleChunksDir   = AddTrailingPathSeparator(mStaleChunksDir);
+    mDirtyChunksDir   = AddTrailingPathSeparator(mDirtyChunksDir);
+    mChunkFilePoolDir = AddTrailingPathSeparator(mChunkFilePoolDir);
+    mReclaimDir       = AddTrailingPathSeparator(mReclaimDir);
 
     mMaxOpenFds = SetMaxNoFileLimit();
     mMaxClientCount = mMaxOpenFds * 2 / 3;
@@ -2686,7 +3477,8 @@ ChunkManager::AllocChunk(
     ChunkDirInfo* const chunkdir = GetDirForChunk(
         chunkVersion < 0,
         minTier == kKfsSTierUndef ? mAllocDefaultMinTier : minTier,
-        maxTier == kKfsSTierUndef ? mAllocDefaultMaxTier : maxTier
+        maxTier == kKfsSTierUndef ? mAllocDefaultMaxTier : maxTier,
+        ! isBeingReplicated
     );
     if (! chunkdir) {
         KFS_LOG_STREAM_INFO <<
@@ -2726,9 +3518,35 @@ ChunkManager::AllocChunk(
             ! cih->ScheduleObjTableCleanup(mChunkInfoLists)) {
         die("alloc object schedule cleanup failure");
     }
+    // Use preallocated file from the directory pool, if any. The disk queue
+    // renames the file into place, or creates the new file if rename fails.
+    int64_t poolSeq = -1;
+    string  poolFileName;
+    if (0 <= chunkVersion && chunkdir->supportsSpaceReservatonFlag) {
+        if (chunkdir->chunkFilePool.empty()) {
+            if (0 < mChunkFilePoolSize) {
+                mCounters.mChunkFilePoolMissCount++;
+            }
+        } else {
+            poolSeq = chunkdir->chunkFilePool.back();
+            chunkdir->chunkFilePool.pop_back();
+            poolFileName = MakeChunkFilePoolPathname(*chunkdir, poolSeq);
+            mCounters.mChunkFilePoolHitCount++;
+        }
+    }
     KFS_LOG_STREAM_INFO << "creating chunk: " << MakeChunkPathname(cih) <<
+        (poolFileName.empty() ? "" : " from: ") << poolFileName <<
     KFS_LOG_EOM;
-    int ret = OpenChunk(cih, O_RDWR | O_CREAT);
+    int ret = OpenChunk(cih, O_RDWR | O_CREAT,
+        poolFileName.empty() ? 0 : poolFileName.c_str());
+    if (0 <= poolSeq) {
+        if (ret < 0) {
+            // Open request was not queued, the file remains in the pool.
+            chunkdir->chunkFilePool.push_back(poolSeq);
+        } else {
+            UpdateChunkFilePool(*chunkdir);
+        }
+    }
     if (ret < 0) {
         // open chunk failed: the entry in the chunk table is cleared and
         // Delete(*cih) is also called in OpenChunk().  Return the
@@ -3018,6 +3836,10 @@ ChunkManager::ReadChunkMetadata(
 
     LruUpdate(*cih);
     if (cih->chunkInfo.AreChecksumsLoaded()) {
+        if (ChunkMetaCacheList::IsInList(mChunkMetaCacheList, *cih)) {
+            ChunkMetaCacheList::PushBack(mChunkMetaCacheList, *cih);
+            mCounters.mChunkMetaCacheHitCount++;
+        }
         int res = 0;
         cb->HandleEvent(EVENT_CMD_DONE, &res);
         return 0;
@@ -3365,6 +4187,8 @@ ChunkManager::TruncateChunk(kfsChunkId_t chunkId, int64_t chunkSize)
         mUsedSpace += chunkSize;
     }
     cih->chunkInfo.chunkSize = chunkSize;
+    cih->InvalidateVerifiedBlocks();
+    cih->RevokeShortCircuit();
 
     UpdateDirSpace(cih, cih->chunkInfo.chunkSize);
 
@@ -3594,7 +4418,7 @@ ChunkManager::SetChunkSize(ChunkInfo_t& ci, int64_t chunkSize)
 
 template<typename T>
 ChunkManager::ChunkDirInfo*
-ChunkManager::GetDirForChunkT(T start, T end)
+ChunkManager::GetDirForChunkT(T start, T end, bool skipSlowDirsFlag)
 {
     if (start == end) {
         return 0;
@@ -3605,6 +4429,7 @@ ChunkManager::GetDirForChunkT(T start, T end)
     int64_t    totalPendingWrite = 0;
     int64_t    maxFreeSpace      = 0;
     int        dirCount          = 0;
+    int        slowSkipCount     = 0;
     for (T it = start; it != end; ++it) {
         ChunkDirInfo& di = **it;
         di.placementSkipFlag = true;
@@ -3624,6 +4449,11 @@ ChunkManager::GetDirForChunkT(T start, T end)
                 mPlacementMaxWaitingAvgUsecsThreshold) {
             continue;
         }
+        if (skipSlowDirsFlag && di.slowFlag &&
+                mSlowDirPlacementWeight <= drand48()) {
+            slowSkipCount++;
+            continue;
+        }
         dirCount++;
         totalFreeSpace += space;
         if (dirToUse == end) {
@@ -3659,7 +4489,8 @@ ChunkManager::GetDirForChunkT(T start, T end)
         totalPendingWrite += di.pendingWriteBytes;
     }
     if (dirCount <= 0 || totalFreeSpace <= 0) {
-        return 0;
+        // Use slow directories, if these are the only ones available.
+        return (0 < slowSkipCount ? GetDirForChunkT(start, end, false) : 0);
     }
     if (dirCount == 1) {
         return &(**dirToUse);
@@ -3748,12 +4579,24 @@ ChunkManager::GetDirForChunkT(T start, T end)
 
 ChunkManager::ChunkDirInfo*
 ChunkManager::GetDirForChunk(
-    bool objFlag, kfsSTier_t minTier, kfsSTier_t maxTier)
+    bool objFlag, kfsSTier_t minTier, kfsSTier_t maxTier, bool stagingFlag)
 {
     StorageTiers& tiers = objFlag ? mObjStorageTiers : mStorageTiers;
     for (StorageTiers::const_iterator it = tiers.lower_bound(minTier);
             it != tiers.end() && it->first <= maxTier;
             ++it) {
+        if (stagingFlag && ! objFlag && kKfsSTierMin <= it->first &&
+                it->first <= kKfsSTierMax &&
+                mStagingTiers[it->first] != kKfsSTierUndef) {
+            StorageTiers::const_iterator const sit =
+                tiers.find(mStagingTiers[it->first]);
+            ChunkDirInfo* const dir = sit == tiers.end() ? 0 :
+                GetDirForChunkT(sit->second.begin(), sit->second.end());
+            if (dir) {
+                mCounters.mStagedChunkCount++;
+                return dir;
+            }
+        }
         ChunkDirInfo* const dir = GetDirForChunkT(
             it->second.begin(), it->second.end());
         if (dir) {
@@ -3827,8 +4670,11 @@ ChunkManager::AddMapping(ChunkManager::ChunkDirInfo& dir,
         string fileName;
         string staleName;
         string keepName;
-        // Keep the chunk with the higher version.
-        if (cih->chunkInfo.chunkVersion < chunkVers) {
+        // Keep the chunk with the higher version. With the same version keep
+        // destaged copy, as the staged copy deletion might not have completed.
+        if (cih->chunkInfo.chunkVersion < chunkVers ||
+                (cih->chunkInfo.chunkVersion == chunkVers &&
+                    IsStagingDir(cih->GetDirInfo()) && ! IsStagingDir(dir))) {
             fileName  = MakeChunkPathname(cih);
             staleName = MakeStaleChunkPathname(cih);
             keepName  = MakeChunkPathname(
@@ -3882,13 +4728,21 @@ ChunkManager::AddMapping(ChunkManager::ChunkDirInfo& dir,
 }
 
 int
-ChunkManager::OpenChunk(ChunkInfoHandle* cih, int openFlags)
+ChunkManager::OpenChunk(ChunkInfoHandle* cih, int openFlags,
+    const char* preallocatedFileName /* = 0 */)
 {
     if (cih->IsFileOpen()) {
         return 0;
     }
     const bool openFlag = 0 == (openFlags & O_CREAT);
+    // Remove from the meta data cache prior to the fd cleanup as the cleanup
+    // might add entries to the cache, and evict this one.
+    const bool metaCachedFlag = ChunkMetaCacheRemove(*cih);
     if (! CleanupInactiveFds(globalNetManager().Now(), cih)) {
+        if (metaCachedFlag) {
+            ChunkMetaCacheList::PushBack(mChunkMetaCacheList, *cih);
+            mChunkMetaCacheCount++;
+        }
         KFS_LOG_STREAM_ERROR <<
             "failed to " << (openFlag ? "open" : "create") <<
             " chunk file: " << MakeChunkPathname(cih) <<
@@ -3906,6 +4760,8 @@ ChunkManager::OpenChunk(ChunkInfoHandle* cih, int openFlags)
     string errMsg;
     const string fn = MakeChunkPathname(cih);
     bool tempFailureFlag = false;
+    const bool bufferedReadFlag = cih->GetDirInfo().bufferedReadFlag &&
+        cih->IsStable() && (openFlags & (O_WRONLY | O_RDWR)) == 0;
     // Set reservation size larger than max chunk size in order to detect files
     // that weren't properly closed. + 1 here will make file one io block bigger
     // QCDiskQueue::OpenFile() makes EOF block size aligned.
@@ -3917,7 +4773,10 @@ ChunkManager::OpenChunk(ChunkInfoHandle* cih, int openFlags)
             (openFlags & O_CREAT) != 0,
             &errMsg,
             &tempFailureFlag,
-            mBufferedIoFlag || cih->GetDirInfo().bufferedIoFlag)) {
+            mBufferedIoFlag || cih->GetDirInfo().bufferedIoFlag ||
+                bufferedReadFlag,
+            bufferedReadFlag,
+            (openFlags & O_CREAT) != 0 ? preallocatedFileName : 0)) {
         mCounters.mOpenErrorCount++;
         if ((openFlags & O_CREAT) != 0 || ! tempFailureFlag) {
             //
@@ -3940,6 +4799,10 @@ ChunkManager::OpenChunk(ChunkInfoHandle* cih, int openFlags)
             Delete(*cih);
         } else {
             cih->dataFH.reset();
+            if (metaCachedFlag) {
+                ChunkMetaCacheList::PushBack(mChunkMetaCacheList, *cih);
+                mChunkMetaCacheCount++;
+            }
         }
         KFS_LOG_STREAM_ERROR <<
             "failed to " << (openFlag ? "open" : "create") <<
@@ -3948,6 +4811,21 @@ ChunkManager::OpenChunk(ChunkInfoHandle* cih, int openFlags)
         return (tempFailureFlag ? -EAGAIN : -EBADF);
     }
     globals().ctrOpenDiskFds.Update(1);
+    if (openFlag) {
+        mCounters.mFdOpenCount++;
+        // Re-open after the fd cleanup closed the file. The last io time is
+        // the time of the last io prior to the close.
+        const bool reopenFlag = cih->GetFdEvictedFlag() &&
+            globalNetManager().Now() <=
+                cih->lastIOTime + mFdCacheReopenWindowSecs;
+        if (reopenFlag) {
+            mCounters.mFdReopenCount++;
+        }
+        cih->SetFdHotFlag(reopenFlag);
+    } else {
+        cih->SetFdHotFlag(false);
+    }
+    cih->SetFdEvictedFlag(false);
     LruUpdate(*cih);
     if (! cih->IsStable()) {
         cih->UpdateDirStableCount();
@@ -4141,10 +5019,18 @@ ChunkManager::ReadChunk(ReadOp* op)
         KFS_LOG_EOM;
         return -EBADVERS;
     }
+    if (cih->writeCoalescer) {
+        WriteCoalesceFlush(*cih->writeCoalescer);
+    }
     DiskIo* const d = SetupDiskIo(cih, op);
     if (! d) {
         return -ESERVERBUSY;
     }
+    if (op->scrubOp) {
+        d->SetPriorityClass(QCDiskQueue::kPriorityClassMaintenance);
+    } else if (op->wop && op->wop->isFromReReplication) {
+        d->SetPriorityClass(QCDiskQueue::kPriorityClassRecovery);
+    }
 
     op->diskIo.reset(d);
 
@@ -4171,6 +5057,13 @@ ChunkManager::ReadChunk(ReadOp* op)
     if ((int64_t) (offset + numBytesIO) > cih->chunkInfo.chunkSize) {
         numBytesIO = cih->chunkInfo.chunkSize - offset;
     }
+    // Scrub must verify the on disk data, bypass read ahead.
+    if (! op->scrubOp && ReadAheadLookup(*cih, op, offset, numBytesIO)) {
+        if (! op->wop) {
+            CountChunkRead(op->chunkId);
+        }
+        return 0;
+    }
     op->diskIOTime = microseconds();
     const int ret = op->diskIo->Read(
         offset + cih->chunkInfo.GetHeaderSize(), numBytesIO);
@@ -4180,45 +5073,313 @@ ChunkManager::ReadChunk(ReadOp* op)
         return ret;
     }
     // read was successfully scheduled
+    if (! op->scrubOp) {
+        ReadAheadStart(*cih, offset, numBytesIO);
+        if (! op->wop) {
+            CountChunkRead(op->chunkId);
+        }
+    }
     return 0;
 }
 
-int
-ChunkManager::WriteChunk(WriteOp* op, const DiskIo::FilePtr* filePtr /* = 0 */)
+///
+/// Sequential read detection, and serve the read from the read ahead buffer,
+/// or attach it to the read ahead in flight, if the read ahead covers the
+/// checksum block aligned read range.
+///
+bool
+ChunkManager::ReadAheadLookup(ChunkInfoHandle& cih, ReadOp* op,
+    int64_t offset, size_t numBytes)
 {
-    const bool kAddObjectBlockMappingFlag = false;
-    ChunkInfoHandle* const cih = GetChunkInfoHandle(op->chunkId, op->chunkVersion,
-        kAddObjectBlockMappingFlag);
-    if (! cih) {
-        return -EBADF;
+    if (! cih.IsChunkReadable()) {
+        if (cih.readAhead) {
+            cih.readAhead->sequentialCount = 0;
+            cih.readAhead->Discard();
+        }
+        return false;
     }
-    if (filePtr && *filePtr != cih->dataFH) {
-        return -EINVAL;
+    if (mReadAheadMaxSize <= 0 && ! cih.readAhead) {
+        return false;
     }
-    // the checksums should be loaded...
-    cih->chunkInfo.VerifyChecksumsLoaded();
-
-    // schedule a write based on the chunk size.  Make sure that a
-    // write doesn't overflow the size of a chunk.
-    op->numBytesIO = min((size_t) (CHUNKSIZE - op->offset), op->numBytes);
-    if (0 == op->numBytes && 0 == op->numBytesIO && op->wpop) {
-        // Empty write prepare can be used to keep write lease in a period of
-        // write inactivity.
-        op->diskIo.reset(SetupDiskIo(cih, op));
-        if (! op->diskIo) {
-            return -ESERVERBUSY;
-        }
-        cih->StartWrite(op);
-        op->diskIOTime = microseconds();
-        // Do not queue empty IO (it isn't presently supported anyway), invoke
-        // completion instead.
-        int res = 0;
-        op->HandleEvent(EVENT_DISK_WROTE, &res);
-        return 0;
+    if (! cih.readAhead) {
+        cih.readAhead = new ChunkReadAhead(&cih);
+    }
+    ChunkReadAhead& ra = *cih.readAhead;
+    if (op->offset == ra.nextOffset) {
+        if (ra.sequentialCount < (1 << 30)) {
+            ra.sequentialCount++;
+        }
+    } else {
+        ra.sequentialCount = 0;
+    }
+    ra.nextOffset = op->offset + op->numBytesIO;
+    if (! op->dataBuf.IsEmpty() || op->wop) {
+        return false;
+    }
+    const int64_t end = offset + (int64_t)numBytes;
+    if (ra.bufOffset <= offset && end <= ra.GetBufEnd()) {
+        // The data before the read is no longer needed. Keep the served
+        // range, as the next read might start in its last checksum block.
+        ra.Consume(offset);
+        ReadAheadServe(ra, op, offset, numBytes);
+        ReadAheadStart(cih, offset, numBytes);
+        return true;
+    }
+    if (ra.sequentialCount <= 0) {
+        ra.Discard();
+    }
+    if (ra.IsInFlight() &&
+            ra.readOffset <= offset &&
+            end <= ra.readOffset + (int64_t)ra.readSize) {
+        op->diskIOTime = microseconds();
+        ra.waiters.push_back(ChunkReadAhead::Waiter(op, offset, numBytes));
+        return true;
+    }
+    return false;
+}
+
+void
+ChunkManager::ReadAheadServe(ChunkReadAhead& ra, ReadOp* op,
+    int64_t offset, size_t numBytes)
+{
+    assert(ra.bufOffset <= offset &&
+        offset + (int64_t)numBytes <= ra.GetBufEnd());
+    IOBuffer buf;
+    buf.Copy(&ra.buf, (int)(offset - ra.bufOffset + numBytes));
+    buf.Consume((int)(offset - ra.bufOffset));
+    op->dataBuf.Move(&buf);
+    mCounters.mReadAheadHitCount++;
+    mCounters.mReadAheadHitByteCount += numBytes;
+    op->diskIOTime = microseconds();
+    if (mReadAheadDoneQueue.empty()) {
+        globalNetManager().Wakeup();
+    }
+    mReadAheadDoneQueue.push_back(op);
+}
+
+///
+/// Start read ahead past the end of the current read, if the reads are
+/// sequential, and the data past the read end isn't already buffered or being
+/// read.
+///
+void
+ChunkManager::ReadAheadStart(ChunkInfoHandle& cih,
+    int64_t offset, size_t numBytes)
+{
+    ChunkReadAhead* const ra = cih.readAhead;
+    if (! ra || ra->IsInFlight() ||
+            ra->sequentialCount < mReadAheadMinSequentialCount ||
+            ! cih.IsFileOpen()) {
+        return;
+    }
+    const int64_t readEnd   = offset + (int64_t)numBytes;
+    const int64_t chunkSize = cih.chunkInfo.chunkSize;
+    int64_t       start     = readEnd;
+    if (! ra->buf.IsEmpty()) {
+        if (ra->bufOffset <= readEnd && readEnd <= ra->GetBufEnd()) {
+            start = ra->GetBufEnd();
+        } else {
+            ra->Discard();
+        }
+    }
+    const int64_t size = GetReadAheadSize(cih, numBytes);
+    // Refill when the buffered data past the read end drops below half of
+    // the read ahead size.
+    if (chunkSize <= start || size <= 0 || size / 2 < start - readEnd) {
+        return;
+    }
+    const size_t len = (size_t)min(size, chunkSize - start);
+    BufferManager& bufMgr = DiskIo::GetBufferManager();
+    if (! bufMgr.GetForDiskIo(*ra, (BufferManager::ByteCount)len,
+            BufferManager::kRequestClassRead)) {
+        ra->CancelRequest();
+        return;
+    }
+    ra->diskIo.reset(new DiskIo(cih.dataFH, ra));
+    ra->readOffset = start;
+    ra->readSize   = len;
+    ra->headerSize = cih.chunkInfo.GetHeaderSize();
+    const int ret = ra->diskIo->Read(
+        start + cih.chunkInfo.GetHeaderSize(), len);
+    if (ret < 0) {
+        KFS_LOG_STREAM_DEBUG <<
+            "chunk: "      << cih.chunkInfo.chunkId  <<
+            " version: "   << cih.chunkInfo.chunkVersion  <<
+            " read ahead:"
+            " offset: "    << start <<
+            " size: "      << len <<
+            " error: "     << ret <<
+        KFS_LOG_EOM;
+        ra->diskIo.reset();
+        ra->readSize = 0;
+        ra->UpdateBufferAccounting();
+        return;
+    }
+    mCounters.mReadAheadCount++;
+    mCounters.mReadAheadByteCount += len;
+}
+
+///
+/// Read ahead size ramps up with the number of sequential reads, and decreases
+/// with the disk queue depth: the read ahead is halved for each
+/// chunkServer.readAhead.queueDepthThreshold requests pending in the chunk
+/// directory disk queue.
+///
+int64_t
+ChunkManager::GetReadAheadSize(ChunkInfoHandle& cih, size_t numBytes) const
+{
+    const int shift = min(4, max(0,
+        cih.readAhead->sequentialCount - mReadAheadMinSequentialCount));
+    int64_t size = min(mReadAheadMaxSize, (int64_t)mMaxIORequestSize);
+    size = min(size, max((int64_t)numBytes, (int64_t)CHECKSUM_BLOCKSIZE) <<
+        shift);
+    int     freeRequestCount = 0;
+    int     requestCount     = 0;
+    int64_t readBlockCount   = 0;
+    int64_t writeBlockCount  = 0;
+    int     blockSize        = 0;
+    cih.dataFH->GetDiskQueuePendingCount(
+        freeRequestCount,
+        requestCount,
+        readBlockCount,
+        writeBlockCount,
+        blockSize
+    );
+    if (freeRequestCount <= 0) {
+        return 0;
+    }
+    if (0 < mReadAheadQueueDepthThreshold) {
+        size >>= min(30, requestCount / mReadAheadQueueDepthThreshold);
+    }
+    return (size - size % (int64_t)CHECKSUM_BLOCKSIZE);
+}
+
+void
+ChunkManager::ReadAheadDone(ChunkReadAhead& ra, int code, void* data)
+{
+    DiskIoPtr diskIo;
+    diskIo.swap(ra.diskIo);
+    const int64_t offset = ra.readOffset;
+    ra.readSize = 0;
+    ChunkReadAhead::Waiters waiters;
+    waiters.swap(ra.waiters);
+    if (code == EVENT_DISK_READ && data && ra.chunkInfoHandle &&
+            ra.chunkInfoHandle->IsFileEquals(diskIo) &&
+            ra.chunkInfoHandle->IsChunkReadable()) {
+        IOBuffer* const b = reinterpret_cast<IOBuffer*>(data);
+        if (ra.buf.IsEmpty() || ra.GetBufEnd() != offset) {
+            ra.buf.Clear();
+            ra.bufOffset = offset;
+        }
+        ra.buf.Move(b);
+    } else {
+        if (code != EVENT_DISK_READ) {
+            KFS_LOG_STREAM_DEBUG <<
+                "read ahead:"
+                " offset: " << offset <<
+                " status: " << (data ? *reinterpret_cast<int*>(data) : -1) <<
+            KFS_LOG_EOM;
+        }
+        ra.buf.Clear();
+        ra.bufOffset = 0;
+    }
+    ra.UpdateBufferAccounting();
+    for (ChunkReadAhead::Waiters::const_iterator it = waiters.begin();
+            it != waiters.end();
+            ++it) {
+        ReadOp* const op = it->mOp;
+        if (ra.bufOffset <= it->mOffset && ! ra.buf.IsEmpty() &&
+                it->mOffset + (int64_t)it->mNumBytes <= ra.GetBufEnd()) {
+            ReadAheadServe(ra, op, it->mOffset, it->mNumBytes);
+            continue;
+        }
+        // Read ahead failed or was short, issue the read. The op's disk io has
+        // a reference to the chunk file, therefore the file remains open.
+        op->diskIOTime = microseconds();
+        int ret = op->diskIo ? op->diskIo->Read(
+            it->mOffset + ra.headerSize, it->mNumBytes) : -EIO;
+        if (ret < 0) {
+            op->HandleEvent(EVENT_DISK_ERROR, &ret);
+        }
+    }
+    if (! ra.chunkInfoHandle) {
+        delete &ra;
+    }
+}
+
+void
+ChunkManager::RunReadAheadDoneQueue()
+{
+    if (mReadAheadDoneQueue.empty()) {
+        return;
+    }
+    mReadAheadDoneQueueTmp.swap(mReadAheadDoneQueue);
+    for (ReadAheadDoneQueue::const_iterator it =
+                mReadAheadDoneQueueTmp.begin();
+            it != mReadAheadDoneQueueTmp.end();
+            ++it) {
+        ReadOp* const op = *it;
+        IOBuffer      buf;
+        buf.Move(&op->dataBuf);
+        op->HandleEvent(EVENT_DISK_READ, &buf);
+    }
+    mReadAheadDoneQueueTmp.clear();
+}
+
+int
+ChunkManager::WriteChunk(WriteOp* op, const DiskIo::FilePtr* filePtr /* = 0 */)
+{
+    const bool kAddObjectBlockMappingFlag = false;
+    ChunkInfoHandle* const cih = GetChunkInfoHandle(op->chunkId, op->chunkVersion,
+        kAddObjectBlockMappingFlag);
+    if (! cih) {
+        return -EBADF;
+    }
+    if (filePtr && *filePtr != cih->dataFH) {
+        return -EINVAL;
+    }
+    // the checksums should be loaded...
+    cih->chunkInfo.VerifyChecksumsLoaded();
+
+    // schedule a write based on the chunk size.  Make sure that a
+    // write doesn't overflow the size of a chunk.
+    op->numBytesIO = min((size_t) (CHUNKSIZE - op->offset), op->numBytes);
+    if (0 == op->numBytes && 0 == op->numBytesIO && op->wpop) {
+        // Empty write prepare can be used to keep write lease in a period of
+        // write inactivity.
+        op->diskIo.reset(SetupDiskIo(cih, op));
+        if (! op->diskIo) {
+            return -ESERVERBUSY;
+        }
+        cih->StartWrite(op);
+        op->diskIOTime = microseconds();
+        // Do not queue empty IO (it isn't presently supported anyway), invoke
+        // completion instead.
+        int res = 0;
+        op->HandleEvent(EVENT_DISK_WROTE, &res);
+        return 0;
     }
     if (op->numBytesIO <= 0 || op->offset < 0) {
         return -EINVAL;
     }
+    const bool coalesceFlag =
+        0 < mWriteCoalesceMaxSize &&
+        ! filePtr &&
+        op->wpop &&
+        ! op->isFromReReplication &&
+        ! op->isFromRecordAppend &&
+        0 <= cih->chunkInfo.chunkVersion &&
+        OffsetToChecksumBlockStart(op->offset) == op->offset &&
+        op->numBytesIO % CHECKSUM_BLOCKSIZE == 0 &&
+        (int64_t)op->numBytesIO < mWriteCoalesceMaxSize;
+    if (cih->writeCoalescer && (! coalesceFlag ||
+            ! cih->writeCoalescer->IsAdjacent(*op) ||
+            mWriteCoalesceMaxSize <
+                cih->writeCoalescer->numBytes + (int64_t)op->numBytesIO)) {
+        // Flush pending writes first, in order to keep the writes, and
+        // chunk size and checksums updates in order.
+        WriteCoalesceFlush(*cih->writeCoalescer);
+    }
     const int64_t addedBytes(op->offset + op->numBytesIO - cih->chunkInfo.chunkSize);
     if (0 <= cih->chunkInfo.chunkVersion &&
             0 < addedBytes && mUsedSpace + addedBytes >= mTotalSpace) {
@@ -4323,10 +5484,17 @@ ChunkManager::WriteChunk(WriteOp* op, const DiskIo::FilePtr* filePtr /* = 0 */)
         numBytesIO = numBytes;
     }
 
+    if (coalesceFlag) {
+        return (WriteCoalesce(*cih, op) ? (int)numBytesIO : -ESERVERBUSY);
+    }
     DiskIo* const d = SetupDiskIo(cih, op);
     if (! d) {
         return -ESERVERBUSY;
     }
+    if (op->isFromReReplication) {
+        // Re-replication and recovery writes.
+        d->SetPriorityClass(QCDiskQueue::kPriorityClassRecovery);
+    }
     op->diskIo.reset(d);
 
     /*
@@ -4353,19 +5521,106 @@ ChunkManager::WriteChunk(WriteOp* op, const DiskIo::FilePtr* filePtr /* = 0 */)
     return res;
 }
 
+///
+/// Queue write for coalescing with the adjacent writes that follow. The
+/// coalesced writes are flushed from the timer, i.e. on the next network
+/// event loop iteration, or when the max size is reached.
+///
+bool
+ChunkManager::WriteCoalesce(ChunkInfoHandle& cih, WriteOp* op)
+{
+    DiskIo* const d = SetupDiskIo(&cih, op);
+    if (! d) {
+        return false;
+    }
+    // The op's disk io isn't used to issue io, but keeps the chunk file
+    // reference, for the completion to find the chunk the same way as with
+    // the normal write.
+    op->diskIo.reset(d);
+    if (! cih.writeCoalescer) {
+        cih.writeCoalescer = new ChunkWriteCoalescer(&cih, op->offset);
+        if (WriteCoalesceList::IsEmpty(mWriteCoalesceList)) {
+            globalNetManager().Wakeup();
+        }
+        WriteCoalesceList::PushBack(mWriteCoalesceList, *cih.writeCoalescer);
+    }
+    ChunkWriteCoalescer& wc = *cih.writeCoalescer;
+    assert(wc.IsAdjacent(*op));
+    wc.Add(op);
+    cih.StartWrite(op);
+    if (mWriteCoalesceMaxSize <= wc.numBytes) {
+        WriteCoalesceFlush(wc);
+    }
+    return true;
+}
+
+void
+ChunkManager::WriteCoalesceFlush(ChunkWriteCoalescer& wc)
+{
+    WriteCoalesceList::Remove(mWriteCoalesceList, wc);
+    ChunkInfoHandle* const cih = wc.chunkInfoHandle;
+    if (! cih) {
+        // Chunk handle deleted.
+        wc.Fail(-EBADF);
+        return;
+    }
+    assert(cih->writeCoalescer == &wc && ! wc.ops.empty());
+    cih->writeCoalescer  = 0;
+    wc.chunkInfoHandle = 0;
+    const int64_t now = microseconds();
+    for (ChunkWriteCoalescer::WriteOps::const_iterator it = wc.ops.begin();
+            it != wc.ops.end();
+            ++it) {
+        (*it)->diskIOTime = now;
+    }
+    wc.diskIo.reset(new DiskIo(wc.ops.front()->diskIo->GetFilePtr(), &wc));
+    const int res = wc.diskIo->Write(
+        wc.offset + cih->chunkInfo.GetHeaderSize(), (size_t)wc.numBytes,
+        &wc.buf);
+    if (res < 0) {
+        wc.diskIo.reset();
+        cih->WriteStats(res, wc.numBytes, 0);
+        ReportIOFailure(cih, res);
+        wc.Fail(res);
+        return;
+    }
+    UpdateChecksums(cih, wc.offset, wc.numBytes, wc.checksums);
+    if (1 < wc.ops.size()) {
+        mCounters.mWriteCoalesceCount++;
+        mCounters.mWriteCoalesceOpCount   += wc.ops.size();
+        mCounters.mWriteCoalesceByteCount += wc.numBytes;
+    }
+}
+
+void
+ChunkManager::RunWriteCoalesceQueue()
+{
+    ChunkWriteCoalescer* wc;
+    while ((wc = WriteCoalesceList::Front(mWriteCoalesceList))) {
+        WriteCoalesceFlush(*wc);
+    }
+}
+
 void
 ChunkManager::UpdateChecksums(ChunkInfoHandle *cih, WriteOp *op)
 {
-    int64_t endOffset = op->offset + op->numBytesIO;
+    UpdateChecksums(cih, op->offset, op->numBytesIO, op->checksums);
+}
+
+void
+ChunkManager::UpdateChecksums(ChunkInfoHandle *cih, int64_t startOffset,
+    int64_t numBytes, const vector<uint32_t>& checksums)
+{
+    int64_t endOffset = startOffset + numBytes;
 
     // the checksums should be loaded...
     cih->chunkInfo.VerifyChecksumsLoaded();
 
-    for (vector<uint32_t>::size_type i = 0; i < op->checksums.size(); i++) {
-        int64_t  offset = op->offset + i * CHECKSUM_BLOCKSIZE;
+    for (vector<uint32_t>::size_type i = 0; i < checksums.size(); i++) {
+        int64_t  offset = startOffset + i * CHECKSUM_BLOCKSIZE;
         uint32_t checksumBlock = OffsetToChecksumBlockNum(offset);
 
-        cih->chunkInfo.chunkBlockChecksum[checksumBlock] = op->checksums[i];
+        cih->chunkInfo.chunkBlockChecksum[checksumBlock] = checksums[i];
     }
 
     if (cih->chunkInfo.chunkSize < endOffset) {
@@ -4400,6 +5655,51 @@ ChunkManager::WriteDone(WriteOp* op)
     cih->WriteDone(op);
 }
 
+// Compute checksums of the blocks that are not in the verified set, and use
+// chunk checksums for the verified blocks. Returns the number of bytes with
+// the checksum computation skipped.
+static int64_t
+ComputeNotVerifiedChecksums(
+    const IOBuffer&                        buf,
+    int                                    blockCount,
+    const ChunkInfoHandle::VerifiedBlocks& verified,
+    size_t                                 firstBlock,
+    const uint32_t*                        blockChecksums,
+    vector<uint32_t>&                      checksums)
+{
+    checksums.resize((size_t)blockCount);
+    IOBuffer::iterator const eit     = buf.end();
+    IOBuffer::iterator       it      = buf.begin();
+    int                      pos     = 0;
+    int64_t                  skipped = 0;
+    for (int i = 0; i < blockCount; i++) {
+        const size_t idx          = firstBlock + i;
+        const bool   verifiedFlag = verified.test(idx);
+        uint32_t     cs           = kKfsNullChecksum;
+        for (int rem = (int)CHECKSUM_BLOCKSIZE; 0 < rem && it != eit; ) {
+            const int nb = it->BytesConsumable() - pos;
+            if (nb <= 0) {
+                ++it;
+                pos = 0;
+                continue;
+            }
+            const int l = min(nb, rem);
+            if (! verifiedFlag) {
+                cs = ComputeBlockChecksum(cs, it->Consumer() + pos, (size_t)l);
+            }
+            pos += l;
+            rem -= l;
+        }
+        if (verifiedFlag) {
+            checksums[i] = blockChecksums[idx];
+            skipped += CHECKSUM_BLOCKSIZE;
+        } else {
+            checksums[i] = cs;
+        }
+    }
+    return skipped;
+}
+
 bool
 ChunkManager::ReadChunkDone(ReadOp* op)
 {
@@ -4476,6 +5776,12 @@ ChunkManager::ReadChunkDone(ReadOp* op)
         op->status = -EFAULT;
         return true;
     }
+    // Verified blocks can only be used if the checksums are verified here.
+    const time_t now                = globalNetManager().Now();
+    const size_t firstChecksumBlock = checksumBlock;
+    const bool   useVerifiedFlag    = ! op->skipVerifyDiskChecksumFlag &&
+        0 < mReadVerifiedBlocksMaxAge && cih->IsStable() &&
+        cih->GetDirInfo().bufferedIoFlag;
     // either nothing to verify or it better match
     bool   mismatchFlag = false;
     size_t obi          = 0;
@@ -4673,9 +5979,19 @@ ChunkManager::ReadChunkDone(ReadOp* op)
         mCounters.mReadSkipDiskVerifyCount++;
         mCounters.mReadSkipDiskVerifyByteCount += op->numBytesIO;
     } else {
+        const ChunkInfoHandle::VerifiedBlocks* const vb = useVerifiedFlag ?
+            cih->GetVerifiedBlocks(now, mReadVerifiedBlocksMaxAge) : 0;
         mCounters.mReadChecksumCount++;
-        mCounters.mReadChecksumByteCount += bufSize;
-        op->checksum = ComputeChecksums(&op->dataBuf, bufSize);
+        if (vb) {
+            const int64_t skipped = ComputeNotVerifiedChecksums(
+                op->dataBuf, blockCount, *vb, checksumBlock,
+                cih->chunkInfo.chunkBlockChecksum, op->checksum);
+            mCounters.mReadChecksumByteCount         += bufSize - skipped;
+            mCounters.mReadChecksumVerifiedByteCount += skipped;
+        } else {
+            mCounters.mReadChecksumByteCount += bufSize;
+            op->checksum = ComputeChecksums(&op->dataBuf, bufSize);
+        }
         if ((size_t)blockCount != op->checksum.size()) {
             die("read verify: invalid checksum vector size");
             op->status = -EFAULT;
@@ -4707,6 +6023,9 @@ ChunkManager::ReadChunkDone(ReadOp* op)
         }
     }
     if (! mismatchFlag) {
+        if (useVerifiedFlag) {
+            cih->SetBlocksVerified(firstChecksumBlock, blockCount, now);
+        }
         // for checksums to verify, we did reads in multiples of
         // checksum block sizes.  so, get rid of the extra
         cih->ReadStats(op->status, readLen, op->diskIOTime);
@@ -4715,6 +6034,8 @@ ChunkManager::ReadChunkDone(ReadOp* op)
     }
     const bool retry = op->retryCnt++ < mReadChecksumMismatchMaxRetryCount;
     op->status = -EBADCKSUM;
+    cih->InvalidateVerifiedBlocks();
+    cih->RevokeShortCircuit();
     cih->ReadStats(op->status, readLen, op->diskIOTime);
 
     ostringstream os;
@@ -4731,6 +6052,9 @@ ChunkManager::ReadChunkDone(ReadOp* op)
     KFS_LOG_STREAM_ERROR << str << KFS_LOG_EOM;
     if (retry) {
         op->dataBuf.Clear();
+        if (cih->readAhead) {
+            cih->readAhead->Discard();
+        }
         if (ReadChunk(op) == 0) {
             return false;
         }
@@ -5019,6 +6343,102 @@ ChunkManager::ZeroPad(IOBuffer *buffer)
     }
 }
 
+///
+/// The read data has been verified against the chunk checksums. Stable chunk
+/// file content does not change, therefore the data can be sent to the client
+/// directly from the file, i.e. from the page cache with buffered io, and the
+/// io buffers can be released as soon as the response is queued.
+///
+void
+ChunkManager::ReadSendFileSetup(ReadOp* op)
+{
+    if (0 <= op->sendFileFd || op->numBytesIO <= 0 || ! op->diskIo ||
+            op->status < 0) {
+        return;
+    }
+    const bool kAddObjectBlockMappingFlag = false;
+    ChunkInfoHandle* const cih = GetChunkInfoHandle(
+        op->chunkId, op->chunkVersion, kAddObjectBlockMappingFlag);
+    const DiskIo::FilePtr filePtr = op->diskIo->GetFilePtr();
+    if (! cih || ! cih->IsChunkReadable() || ! cih->IsFileEquals(op->diskIo) ||
+            ! filePtr || ! filePtr->IsBufferedIo() ||
+            cih->chunkInfo.chunkSize < op->offset + op->numBytesIO) {
+        mCounters.mReadSendFileSkipCount++;
+        return;
+    }
+    const int fd = filePtr->DupFd();
+    if (fd < 0) {
+        KFS_LOG_STREAM_DEBUG << "sendfile setup:"
+            " chunk: "   << op->chunkId <<
+            " version: " << op->chunkVersion <<
+            " error: "   << QCUtils::SysError(-fd) <<
+        KFS_LOG_EOM;
+        mCounters.mReadSendFileSkipCount++;
+        return;
+    }
+    op->sendFileFd     = fd;
+    op->sendFileOffset = op->offset + cih->chunkInfo.GetHeaderSize();
+    mCounters.mReadSendFileCount++;
+    mCounters.mReadSendFileByteCount += op->numBytesIO;
+}
+
+int64_t
+ChunkManager::ShortCircuitGrant(kfsChunkId_t chunkId, int64_t chunkVersion,
+    int64_t& headerSize)
+{
+    if (! gShortCircuitServer.IsEnabled()) {
+        return -ENOTSUP;
+    }
+    const bool kAddObjectBlockMappingFlag = false;
+    ChunkInfoHandle* const cih = GetChunkInfoHandle(
+        chunkId, chunkVersion, kAddObjectBlockMappingFlag);
+    // Only buffered io stable chunk files, the chunk data and the checksums
+    // returned with the grant are immutable.
+    if (! cih || ! cih->IsChunkReadable() || ! cih->IsFileOpen() ||
+            ! cih->dataFH->IsBufferedIo() ||
+            ! cih->chunkInfo.AreChecksumsLoaded() ||
+            cih->IsRenameInFlight()) {
+        return -EAGAIN;
+    }
+    // The chunk files are opened read write, even for reads. Hand out a new
+    // read only open of the chunk file instead of the duplicate of the chunk
+    // server file descriptor, in order to prevent the client from modifying
+    // the chunk file. Ensure that the opened file is the chunk server file.
+    const int srvFd = cih->dataFH->DupFd();
+    if (srvFd < 0) {
+        return srvFd;
+    }
+    const string fn = MakeChunkPathname(cih);
+    int          fd = open(fn.c_str(), O_RDONLY);
+    struct stat  srvStat;
+    struct stat  fdStat;
+    if (fd < 0 ||
+            fstat(srvFd, &srvStat) ||
+            fstat(fd, &fdStat) ||
+            srvStat.st_dev != fdStat.st_dev ||
+            srvStat.st_ino != fdStat.st_ino) {
+        const int err = fd < 0 ? errno : EAGAIN;
+        KFS_LOG_STREAM_ERROR <<
+            "short circuit grant: " << fn <<
+            " read only open failure: " << QCUtils::SysError(err) <<
+        KFS_LOG_EOM;
+        if (0 <= fd) {
+            close(fd);
+        }
+        fd = err > 0 ? -err : -EAGAIN;
+    }
+    close(srvFd);
+    if (fd < 0) {
+        return fd;
+    }
+    const int64_t id = gShortCircuitServer.Grant(fd, chunkId);
+    if (0 < id) {
+        headerSize = cih->chunkInfo.GetHeaderSize();
+        cih->SetShortCircuitGranted();
+    }
+    return id;
+}
+
 void
 ChunkManager::AdjustDataRead(ReadOp *op)
 {
@@ -5113,7 +6533,12 @@ ChunkManager::RemoveDirtyChunks()
         if (it->availableSpace < 0) {
             continue;
         }
-        const string dir = it->dirname + mDirtyChunksDir;
+        // Chunk file pool files are removed as well, as the pool starts empty.
+        // Stale chunk files left in the reclaim directory are queued for
+        // background delete.
+        for (int i = 0; i < 3; i++) {
+        const string dir = it->dirname + (i == 0 ? mDirtyChunksDir :
+            (i == 1 ? mChunkFilePoolDir : mReclaimDir));
         DIR* const dirStream = opendir(dir.c_str());
         if (! dirStream) {
             const int err = errno;
@@ -5130,8 +6555,22 @@ ChunkManager::RemoveDirtyChunks()
             if (stat(name.c_str(), &buf) || ! S_ISREG(buf.st_mode)) {
                 continue;
             }
+            if (i == 2) {
+                char*         end = 0;
+                const int64_t seq = strtoll(dent->d_name, &end, 10);
+                if (0 <= seq && end != dent->d_name && end && *end == 0) {
+                    it->reclaimQueue.push_back(
+                        make_pair(seq, (int64_t)buf.st_size));
+                    it->pendingReclaimSpace += buf.st_size;
+                    it->reclaimNextSeq = max(it->reclaimNextSeq, seq + 1);
+                    continue;
+                }
+            }
             KFS_LOG_STREAM_INFO <<
-                "cleaning out dirty chunk: " << name <<
+                "cleaning out " <<
+                    (i == 0 ? "dirty chunk: " :
+                    (i == 1 ? "chunk pool file: " : "reclaim file: ")) <<
+                    name <<
             KFS_LOG_EOM;
             if (unlink(name.c_str())) {
                 const int err = errno;
@@ -5142,6 +6581,14 @@ ChunkManager::RemoveDirtyChunks()
             }
         }
         closedir(dirStream);
+        if (i == 2 && ! it->reclaimQueue.empty()) {
+            KFS_LOG_STREAM_INFO <<
+                "chunk directory: " << it->dirname <<
+                " queued reclaim files: " << it->reclaimQueue.size() <<
+                " bytes: "                << it->pendingReclaimSpace <<
+            KFS_LOG_EOM;
+        }
+        }
     }
 }
 
@@ -5231,8 +6678,12 @@ ChunkManager::GetHostedChunks(
     const ChunkManager::HostedChunkList& stable,
     const ChunkManager::HostedChunkList& notStableAppend,
     const ChunkManager::HostedChunkList& notStable,
-    bool                                 noFidsFlag)
+    bool                                 noFidsFlag,
+    uint64_t*                            stableChecksum,
+    int64_t*                             renameInFlightCount)
 {
+    uint64_t checksum = 0;
+    int64_t  renames  = 0;
     // walk thru the table and pick up the chunk-ids
     mChunkTable.First();
     const CMapEntry* p;
@@ -5254,6 +6705,10 @@ ChunkManager::GetHostedChunks(
             // not be "readable" and the client will be asked to come back later.
             bool stableFlag = false;
             const kfsSeq_t vers = cih->GetTargetStateAndVersion(stableFlag);
+            renames++;
+            if (stableFlag) {
+                checksum += ChunkIdInventoryChecksum(cih->chunkInfo.chunkId);
+            }
             AppendToHostedList(
                 stableFlag ? stable :
                     (cih->IsWriteAppenderOwns() ?
@@ -5263,8 +6718,12 @@ ChunkManager::GetHostedChunks(
                     noFidsFlag
             );
         } else {
+            const bool stableFlag = IsChunkStable(cih);
+            if (stableFlag) {
+                checksum += ChunkIdInventoryChecksum(cih->chunkInfo.chunkId);
+            }
             AppendToHostedList(
-                IsChunkStable(cih) ?
+                stableFlag ?
                     stable :
                     (cih->IsWriteAppenderOwns() ?
                         notStableAppend :
@@ -5275,6 +6734,12 @@ ChunkManager::GetHostedChunks(
             );
         }
     }
+    if (stableChecksum) {
+        *stableChecksum = checksum;
+    }
+    if (renameInFlightCount) {
+        *renameInFlightCount = renames;
+    }
 }
 
 ChunkInfoHandle*
@@ -5339,14 +6804,7 @@ ChunkManager::AllocateWriteId(
         wi->statusMsg = "write append in progress";
         wi->status = -EINVAL;
     } else {
-        mWriteId++;
-        if (PendingWrites::IsObjStoreWriteId(mWriteId) ==
-                (0 <= wi->chunkVersion)) {
-            mWriteId++;
-            assert(PendingWrites::IsObjStoreWriteId(mWriteId) !=
-                (0 <= wi->chunkVersion));
-        }
-        wi->writeId = mWriteId;
+        wi->writeId = NextWriteId(wi->chunkVersion);
         if (wi->isForRecordAppend) {
             gAtomicRecordAppendManager.AllocateWriteId(
                 wi, replicationPos, peerLoc, cih->dataFH);
@@ -5380,6 +6838,61 @@ ChunkManager::AllocateWriteId(
     return wi->status;
 }
 
+int
+ChunkManager::AllocateWriteId(WritePrepareOp* wp)
+{
+    const bool kAddObjectBlockMappingFlag = false;
+    ChunkInfoHandle* const cih = GetChunkInfoHandle(
+        wp->chunkId, wp->chunkVersion, kAddObjectBlockMappingFlag);
+    if (! cih) {
+        wp->statusMsg = "no such chunk";
+        wp->status = -EBADF;
+    } else if (wp->chunkVersion != cih->chunkInfo.chunkVersion) {
+        wp->statusMsg = "chunk version mismatch";
+        wp->status = -EINVAL;
+    } else if (cih->IsWriteAppenderOwns()) {
+        wp->statusMsg = "write append in progress";
+        wp->status = -EINVAL;
+    } else if (cih->IsStable()) {
+        wp->statusMsg = "chunk stable";
+        wp->status = -EINVAL;
+    } else if (cih->IsRenameInFlight()) {
+        wp->statusMsg = "chunk state transition is in progress";
+        wp->status = -EAGAIN;
+    } else {
+        wp->writeId = NextWriteId(wp->chunkVersion);
+        WriteOp* const op = new WriteOp(
+            wp->seq, wp->chunkId, wp->chunkVersion,
+            wp->offset, wp->numBytes, wp->writeId
+        );
+        op->enqueueTime     = globalNetManager().Now();
+        op->isWriteIdHolder = true;
+        mPendingWrites.push_back(op);
+        LruUpdate(*cih); // Move back to prevent spurious scans.
+        cih->SetWriteIdIssuedFlag(true);
+    }
+    if (0 != wp->status) {
+        KFS_LOG_STREAM_ERROR <<
+            "write id allocation failed: " << wp->Show() <<
+            " status: " << wp->status <<
+            " "         << wp->statusMsg <<
+        KFS_LOG_EOM;
+    }
+    return wp->status;
+}
+
+int64_t
+ChunkManager::NextWriteId(int64_t chunkVersion)
+{
+    mWriteId++;
+    if (PendingWrites::IsObjStoreWriteId(mWriteId) == (0 <= chunkVersion)) {
+        mWriteId++;
+        assert(PendingWrites::IsObjStoreWriteId(mWriteId) !=
+            (0 <= chunkVersion));
+    }
+    return mWriteId;
+}
+
 WriteOp*
 ChunkManager::CloneWriteOp(int64_t writeId)
 {
@@ -5497,6 +7010,10 @@ ChunkManager::RunStaleChunksQueue(bool completionFlag)
                 bool ok;
                 if (cih->IsKeep()) {
                     ok = MarkChunkStale(cih, &cb) == 0;
+                } else if (0 < mReclaimMaxInFlightPerDir &&
+                        0 <= cih->chunkInfo.chunkVersion &&
+                        ! cih->GetDirInfo().memoryFlag) {
+                    ok = ReclaimStaleChunk(cih, &cb);
                 } else {
                     const string fileName = MakeChunkPathname(cih);
                     string       err;
@@ -5528,6 +7045,9 @@ ChunkManager::RunStaleChunksQueue(bool completionFlag)
 void
 ChunkManager::Timeout()
 {
+    RunReadAheadDoneQueue();
+    RunWriteCoalesceQueue();
+
     const time_t now = globalNetManager().Now();
 
     if (now >= mNextCheckpointTime) {
@@ -5551,6 +7071,7 @@ ChunkManager::Timeout()
         SendChunkDirInfo();
         mNextSendChunDirInfoTime = now + mSendChunDirInfoIntervalSecs;
     }
+    StartDestage(now);
     gLeaseClerk.Timeout();
     gAtomicRecordAppendManager.Timeout();
 }
@@ -5636,6 +7157,13 @@ ChunkManager::CleanupInactiveFds(time_t now, const ChunkInfoHandle* cur)
     }
     const time_t       unstableObjBlockExpireTime =
         now - mInactiveFdsCleanupIntervalSecs;
+    // Keep hot chunks open longer while fds are plentiful.
+    const time_t hotExpireTime = now - mFdCacheHotMaxIdleSecs;
+    const bool   hotKeepFlag   = releaseCnt <= 0 &&
+        mInactiveFdsCleanupIntervalSecs < mFdCacheHotMaxIdleSecs &&
+        (double)(globals().ctrOpenDiskFds.GetValue() * mFdsPerChunk +
+            globals().ctrOpenNetFds.GetValue()) <
+        mMaxOpenFds * mFdCacheHotMaxFdUseRatio;
     ChunkLru::Iterator it(mChunkInfoLists[kChunkLruList]);
     ChunkInfoHandle*   cih;
     while ((cih = it.Next())) {
@@ -5655,6 +7183,20 @@ ChunkManager::CleanupInactiveFds(time_t now, const ChunkInfoHandle* cur)
         if (expireTime <= cih->lastIOTime) {
             break;
         }
+        if (cih->GetFdHotFlag()) {
+            if (0 < releaseCnt) {
+                // Give hot chunk second chance by moving it to the lru end.
+                // The iteration ends with this entry, if reached again.
+                cih->SetFdHotFlag(false);
+                ChunkLru::PushBack(mChunkInfoLists[kChunkLruList], *cih);
+                mCounters.mFdSecondChanceCount++;
+                continue;
+            }
+            if (hotKeepFlag && hotExpireTime < cih->lastIOTime) {
+                mCounters.mFdHotKeepCount++;
+                continue;
+            }
+        }
         bool   hasLeaseFlag         = false;
         bool   writePendingFlag     = false;
         bool   objBlockMetaDownFlag = false;
@@ -5707,10 +7249,12 @@ ChunkManager::CleanupInactiveFds(time_t now, const ChunkInfoHandle* cur)
             " had write id: " << cih->GetWriteIdIssuedFlag() <<
             " last io: "      << (now - cih->lastIOTime) << " sec. ago" <<
         KFS_LOG_EOM;
-        const bool openFlag = releaseCnt > 0 && cih->IsFileOpen();
+        const bool openFlag = cih->IsFileOpen();
         Release(*cih);
-        if (releaseCnt > 0 && openFlag && ! cih->IsFileOpen()) {
-            if (--releaseCnt <= 0) {
+        if (openFlag && ! cih->IsFileOpen()) {
+            cih->SetFdEvictedFlag(true);
+            mCounters.mFdEvictCount++;
+            if (releaseCnt > 0 && --releaseCnt <= 0) {
                 break;
             }
         }
@@ -5741,6 +7285,7 @@ ChunkManager::StartDiskIo()
         return false;
     }
     mDirChecker.SetLockFileName(mChunkDirLockName);
+    mDirChecker.SetChunkInventoryFileName(mChunkInventoryFileName);
     // Ignore host fs errors and do not remove files / dirs on the initial load.
     mDirChecker.SetRemoveFilesFlag(false);
     mDirChecker.SetIgnoreErrorsFlag(true);
@@ -5751,6 +7296,8 @@ ChunkManager::StartDiskIo()
     }
     mDirChecker.AddSubDir(mStaleChunksDir, mForceDeleteStaleChunksFlag);
     mDirChecker.AddSubDir(mDirtyChunksDir, true);
+    mDirChecker.AddSubDir(mChunkFilePoolDir, true);
+    mDirChecker.AddSubDir(mReclaimDir, true);
     mDirChecker.SetIoTimeout(-1); // Turn off on startup.
     DirChecker::DirsAvailable dirs;
     mDirChecker.Start(dirs);
@@ -5834,6 +7381,10 @@ ChunkManager::StartDiskIo()
         bool   kBufferDataIgnoreOverwriteFlag = false;
         int    kinBufferDataTailToKeepSize    = 0;
         bool   kCreateExclusiveFlag           = true;
+        const int     kThreadCount            = -1;
+        const int64_t kMaxFileSize            = -1;
+        // IO method, if configured, is used only with direct io, as io method
+        // open has no buffered io parameter.
         if (! DiskIo::StartIoQueue(
                 it->dirname.c_str(),
                 it->deviceId,
@@ -5844,7 +7395,11 @@ ChunkManager::StartDiskIo()
                 kinBufferDataTailToKeepSize,
                 kCreateExclusiveFlag,
                 mDiskIoRequestAffinityFlag,
-                mDiskIoSerializeMetaRequestsFlag
+                mDiskIoSerializeMetaRequestsFlag,
+                kThreadCount,
+                kMaxFileSize,
+                ! mBufferedIoFlag && ! it->bufferedIoFlag &&
+                    ! it->bufferedReadFlag
             )) {
             KFS_LOG_STREAM_FATAL <<
                 "failed to start disk queue for: " << it->dirname <<
@@ -6257,6 +7812,15 @@ ChunkManager::ChunkDirInfo::FsSpaceAvailDone(int code, void* data)
             KFS_LOG_EOM;
             totalSpace     = max(int64_t(0), fsTotal);
             availableSpace = min(totalSpace, max(int64_t(0), fsAvail));
+            if (0 <= memoryMaxSpace) {
+                totalSpace     = min(totalSpace, memoryMaxSpace);
+                availableSpace = min(availableSpace,
+                    max(int64_t(0), memoryMaxSpace - usedSpace));
+            }
+            // Space of the stale chunks pending reclaim will be freed shortly,
+            // do not let placement see the directory as full.
+            availableSpace = min(totalSpace,
+                availableSpace + pendingReclaimSpace);
             if (supportsSpaceReservatonFlag) {
                 availableSpace = max(
                     int64_t(0), availableSpace - pendingSpaceReservationSize);
@@ -6277,42 +7841,302 @@ ChunkManager::ChunkDirInfo::FsSpaceAvailDone(int code, void* data)
     return 0;
 }
 
-void
-ChunkManager::ChunkDirInfo::DiskError(int sysErr)
-{
-    if (availableSpace < 0) {
-        return; // Ignore, already marked not in use.
-    }
-    KFS_LOG_STREAM_ERROR <<
-        "chunk directory: " << dirname <<
-        " error: "          << QCUtils::SysError(-sysErr) <<
-        " space:"
-        " available: "      << availableSpace <<
-        " used: "           << usedSpace <<
-    KFS_LOG_EOM;
-    if ((sysErr != -EMFILE && sysErr != -ENFILE) &&
-            (sysErr != -ETIMEDOUT || ++diskTimeoutCount >
-            gChunkManager.GetMaxDirCheckDiskTimeouts())) {
-        gChunkManager.NotifyMetaChunksLost(*this);
-    }
-}
-
 int
-ChunkManager::ChunkDirInfo::CheckEvacuateFileDone(int code, void* data)
+ChunkManager::ChunkDirInfo::ChunkFilePoolDone(int code, void* data)
 {
-    if ((code != EVENT_DISK_GET_FS_SPACE_AVAIL_DONE &&
-            code != EVENT_DISK_ERROR) || ! checkEvacuateFileInFlightFlag) {
-        die("CheckEvacuateFileDone invalid completion");
+    if ((code != EVENT_DISK_PREALLOCATE_DONE &&
+            code != EVENT_DISK_DELETE_DONE &&
+            code != EVENT_DISK_ERROR) || ! chunkFilePoolInFlightFlag) {
+        die("ChunkFilePoolDone invalid completion");
     }
-
-    checkEvacuateFileInFlightFlag = false;
+    chunkFilePoolInFlightFlag = false;
+    const int64_t seq = chunkFilePoolInFlightSeq;
+    chunkFilePoolInFlightSeq = -1;
     if (availableSpace < 0) {
         return 0; // Ignore, already marked not in use.
     }
-
+    const int fileSize = (int)(CHUNKSIZE + KFS_CHUNK_HEADER_SIZE + 1);
     if (code == EVENT_DISK_ERROR) {
-        const int sysErr = *reinterpret_cast<int*>(data);
-        KFS_LOG_STREAM(sysErr == -ENOENT ?
+        // Retry with the next space check.
+        KFS_LOG_STREAM_ERROR <<
+            "chunk directory: " << dirname <<
+            " chunk file pool " << (0 <= seq ? "allocation" : "delete") <<
+            " error: "          <<
+                QCUtils::SysError(-*reinterpret_cast<const int*>(data)) <<
+        KFS_LOG_EOM;
+        return 0;
+    }
+    if (0 <= seq) {
+        chunkFilePool.push_back(seq);
+        UpdateAvailableSpace(fileSize);
+    } else {
+        UpdateAvailableSpace(-fileSize);
+    }
+    gChunkManager.UpdateChunkFilePool(*this);
+    return 0;
+}
+
+string
+ChunkManager::MakeChunkFilePoolPathname(const ChunkDirInfo& dir, int64_t seq)
+{
+    string ret = dir.dirname + mChunkFilePoolDir;
+    AppendDecIntToString(ret, seq);
+    return ret;
+}
+
+void
+ChunkManager::UpdateChunkFilePool(ChunkDirInfo& dir)
+{
+    if (dir.availableSpace < 0 || dir.chunkFilePoolInFlightFlag) {
+        return;
+    }
+    // Use the same size as chunk open, the disk queue rounds it up to the io
+    // block size.
+    const int64_t fileSize     = CHUNKSIZE + KFS_CHUNK_HEADER_SIZE + 1;
+    const int64_t minFreeSpace = max(mMinFsAvailableSpace,
+        (int64_t)(dir.totalSpace * mChunkFilePoolMinFreeSpaceRatio));
+    // Memory backed directory pool files would only pin memory.
+    const int     poolSize     = (dir.supportsSpaceReservatonFlag &&
+            ! dir.memoryFlag &&
+            ! dir.evacuateFlag && ! dir.evacuateStartedFlag) ?
+        mChunkFilePoolSize : 0;
+    string err;
+    if (poolSize < (int)dir.chunkFilePool.size() ||
+            (! dir.chunkFilePool.empty() && dir.availableSpace < minFreeSpace)) {
+        const string name = MakeChunkFilePoolPathname(
+            dir, dir.chunkFilePool.back());
+        dir.chunkFilePool.pop_back();
+        dir.chunkFilePoolInFlightFlag = true;
+        dir.chunkFilePoolInFlightSeq  = -1;
+        if (! DiskIo::Delete(name.c_str(), &dir.chunkFilePoolCb, &err)) {
+            dir.chunkFilePoolInFlightFlag = false;
+            KFS_LOG_STREAM_ERROR << "failed to queue"
+                " chunk file pool delete request for: " << name <<
+                " : " << err <<
+            KFS_LOG_EOM;
+        }
+        return;
+    }
+    if (poolSize <= (int)dir.chunkFilePool.size() ||
+            dir.availableSpace < minFreeSpace + fileSize) {
+        return;
+    }
+    const int64_t seq  = dir.chunkFilePoolNextSeq++;
+    const string  name = MakeChunkFilePoolPathname(dir, seq);
+    dir.chunkFilePoolInFlightFlag = true;
+    dir.chunkFilePoolInFlightSeq  = seq;
+    if (! DiskIo::Preallocate(
+            name.c_str(), fileSize, &dir.chunkFilePoolCb, &err)) {
+        dir.chunkFilePoolInFlightFlag = false;
+        dir.chunkFilePoolInFlightSeq  = -1;
+        KFS_LOG_STREAM_ERROR << "failed to queue"
+            " chunk file pool allocation request for: " << name <<
+            " : " << err <<
+        KFS_LOG_EOM;
+    }
+}
+
+// Stale chunk file rename into reclaim directory, and reclaim file delete
+// completion. The completions of the requests issued before the chunk
+// directory was stopped, are ignored.
+class ChunkManager::ChunkReclaimer : public KfsCallbackObj
+{
+public:
+    ChunkReclaimer(
+        ChunkDirInfo&   dir,
+        int64_t         seq,
+        int64_t         size,
+        KfsCallbackObj* cb)
+        : KfsCallbackObj(),
+          mDir(dir),
+          mStartCount(dir.startCount),
+          mSeq(seq),
+          mSize(size),
+          mCb(cb)
+    {
+        if (mCb) {
+            SET_HANDLER(this, &ChunkReclaimer::RenameDone);
+        } else {
+            SET_HANDLER(this, &ChunkReclaimer::DeleteDone);
+        }
+    }
+private:
+    ChunkDirInfo&         mDir;
+    const int32_t         mStartCount;
+    const int64_t         mSeq;
+    const int64_t         mSize;
+    KfsCallbackObj* const mCb;
+
+    bool IsCurrent() const
+    {
+        return (0 <= mDir.availableSpace && mStartCount == mDir.startCount);
+    }
+    int RenameDone(int code, void* data)
+    {
+        if (code != EVENT_DISK_RENAME_DONE && code != EVENT_DISK_ERROR) {
+            die("ChunkReclaimer::RenameDone invalid completion");
+        }
+        if (code == EVENT_DISK_RENAME_DONE && IsCurrent()) {
+            mDir.reclaimQueue.push_back(make_pair(mSeq, mSize));
+            mDir.pendingReclaimSpace += mSize;
+            gChunkManager.RunReclaimQueue(mDir);
+        }
+        KfsCallbackObj* const cb = mCb;
+        delete this;
+        return cb->HandleEvent(code, data);
+    }
+    int DeleteDone(int code, void* data)
+    {
+        if (code != EVENT_DISK_DELETE_DONE && code != EVENT_DISK_ERROR) {
+            die("ChunkReclaimer::DeleteDone invalid completion");
+        }
+        if (IsCurrent()) {
+            ChunkManager::Counters& counters = gChunkManager.mCounters;
+            if (code == EVENT_DISK_DELETE_DONE) {
+                counters.mReclaimCount++;
+                counters.mReclaimByteCount += mSize;
+            } else {
+                // Do not retry, the file is removed on restart, or when the
+                // directory is added back.
+                counters.mReclaimErrorCount++;
+                KFS_LOG_STREAM_ERROR <<
+                    "chunk directory: " << mDir.dirname <<
+                    " reclaim: "        << mSeq <<
+                    " delete error: "   <<
+                    QCUtils::SysError(-*reinterpret_cast<const int*>(data)) <<
+                KFS_LOG_EOM;
+            }
+            if (0 < mDir.reclaimInFlightCount) {
+                mDir.reclaimInFlightCount--;
+            }
+            mDir.pendingReclaimSpace -= min(mDir.pendingReclaimSpace, mSize);
+            gChunkManager.RunReclaimQueue(mDir);
+        }
+        delete this;
+        return 0;
+    }
+private:
+    ChunkReclaimer(const ChunkReclaimer&);
+    ChunkReclaimer& operator=(const ChunkReclaimer&);
+};
+
+string
+ChunkManager::MakeReclaimPathname(const ChunkDirInfo& dir, int64_t seq)
+{
+    string ret = dir.dirname + mReclaimDir;
+    AppendDecIntToString(ret, seq);
+    return ret;
+}
+
+bool
+ChunkManager::ReclaimStaleChunk(ChunkInfoHandle* cih, KfsCallbackObj* cb)
+{
+    // Rename is cheap, and makes the chunk file disappear from the chunk
+    // directory, the delete is issued by RunReclaimQueue().
+    ChunkDirInfo&   dir         = cih->GetDirInfo();
+    const int64_t   seq         = dir.reclaimNextSeq++;
+    const string    fileName    = MakeChunkPathname(cih);
+    const string    reclaimName = MakeReclaimPathname(dir, seq);
+    ChunkReclaimer& reclaimer   = *(new ChunkReclaimer(dir, seq,
+        cih->chunkInfo.chunkSize + cih->chunkInfo.GetHeaderSize(), cb));
+    string          err;
+    const bool      ok          = DiskIo::Rename(
+        fileName.c_str(), reclaimName.c_str(), &reclaimer, &err);
+    KFS_LOG_STREAM(ok ?
+            MsgLogger::kLogLevelINFO :
+            MsgLogger::kLogLevelERROR) <<
+        "reclaiming stale chunk: " << fileName <<
+        " => "            << reclaimName <<
+        (ok ? " ok" : " error: ") << err <<
+        " in flight: "    << mStaleChunkOpsInFlight <<
+    KFS_LOG_EOM;
+    if (! ok) {
+        delete &reclaimer;
+    }
+    return ok;
+}
+
+void
+ChunkManager::RunReclaimQueue(ChunkDirInfo& dir)
+{
+    // Drain the queue even if reclaim was turned off after the files were
+    // queued.
+    while (dir.reclaimInFlightCount < max(1, mReclaimMaxInFlightPerDir) &&
+            0 <= dir.availableSpace && dir.diskQueue &&
+            ! dir.reclaimQueue.empty()) {
+        const int64_t seq  = dir.reclaimQueue.back().first;
+        const int64_t size = dir.reclaimQueue.back().second;
+        dir.reclaimQueue.pop_back();
+        const string    name      = MakeReclaimPathname(dir, seq);
+        ChunkReclaimer& reclaimer = *(new ChunkReclaimer(dir, seq, size, 0));
+        string          err;
+        const bool      kBackgroundFlag = true;
+        if (! DiskIo::Delete(name.c_str(), &reclaimer, &err,
+                kBackgroundFlag)) {
+            delete &reclaimer;
+            // Retry on the next space check.
+            dir.reclaimQueue.push_back(make_pair(seq, size));
+            KFS_LOG_STREAM_ERROR << "failed to queue"
+                " reclaim delete request for: " << name <<
+                " : " << err <<
+            KFS_LOG_EOM;
+            break;
+        }
+        dir.reclaimInFlightCount++;
+    }
+}
+
+void
+ChunkManager::GetCounters(Counters& counters)
+{
+    counters = mCounters;
+    counters.mReclaimPendingByteCount = 0;
+    counters.mSlowDirCount            = 0;
+    for (ChunkDirs::const_iterator it = mChunkDirs.begin();
+            it < mChunkDirs.end(); ++it) {
+        counters.mReclaimPendingByteCount += it->pendingReclaimSpace;
+        if (it->slowFlag) {
+            counters.mSlowDirCount++;
+        }
+    }
+}
+
+void
+ChunkManager::ChunkDirInfo::DiskError(int sysErr)
+{
+    if (availableSpace < 0) {
+        return; // Ignore, already marked not in use.
+    }
+    KFS_LOG_STREAM_ERROR <<
+        "chunk directory: " << dirname <<
+        " error: "          << QCUtils::SysError(-sysErr) <<
+        " space:"
+        " available: "      << availableSpace <<
+        " used: "           << usedSpace <<
+    KFS_LOG_EOM;
+    if ((sysErr != -EMFILE && sysErr != -ENFILE) &&
+            (sysErr != -ETIMEDOUT || ++diskTimeoutCount >
+            gChunkManager.GetMaxDirCheckDiskTimeouts())) {
+        gChunkManager.NotifyMetaChunksLost(*this);
+    }
+}
+
+int
+ChunkManager::ChunkDirInfo::CheckEvacuateFileDone(int code, void* data)
+{
+    if ((code != EVENT_DISK_GET_FS_SPACE_AVAIL_DONE &&
+            code != EVENT_DISK_ERROR) || ! checkEvacuateFileInFlightFlag) {
+        die("CheckEvacuateFileDone invalid completion");
+    }
+
+    checkEvacuateFileInFlightFlag = false;
+    if (availableSpace < 0) {
+        return 0; // Ignore, already marked not in use.
+    }
+
+    if (code == EVENT_DISK_ERROR) {
+        const int sysErr = *reinterpret_cast<int*>(data);
+        KFS_LOG_STREAM(sysErr == -ENOENT ?
                 MsgLogger::kLogLevelDEBUG :
                 MsgLogger::kLogLevelERROR) <<
             "chunk directory: " << dirname <<
@@ -6887,6 +8711,489 @@ ChunkManager::GetNumOpenObjects() const
     return (long)mObjTable.GetSize();
 }
 
+uint32_t
+ChunkManager::GetMemoryStorageTiersMask() const
+{
+    uint32_t mask = 0;
+    for (ChunkDirs::const_iterator it = mChunkDirs.begin();
+            it < mChunkDirs.end(); ++it) {
+        if (it->memoryFlag && 0 <= it->availableSpace &&
+                ! it->evacuateFlag &&
+                kKfsSTierMin <= it->storageTier &&
+                it->storageTier <= kKfsSTierMax) {
+            mask |= uint32_t(1) << it->storageTier;
+        }
+    }
+    return mask;
+}
+
+void
+ChunkManager::SetStagingTiers(const Properties& props)
+{
+    mStorageTierStaging = props.getValue(
+        "chunkServer.storageTierStaging", mStorageTierStaging);
+    mDestageMinIdleSec = props.getValue(
+        "chunkServer.destage.minIdleSec", mDestageMinIdleSec);
+    mDestageMaxInFlight = props.getValue(
+        "chunkServer.destage.maxInFlight", mDestageMaxInFlight);
+    mDestageIoSize = props.getValue(
+        "chunkServer.destage.ioSize", mDestageIoSize);
+    mDestageIoSize = max((int)CHECKSUM_BLOCKSIZE,
+        mDestageIoSize - mDestageIoSize % (int)CHECKSUM_BLOCKSIZE);
+    for (size_t i = 0; i < kKfsSTierCount; i++) {
+        mStagingTiers[i] = kKfsSTierUndef;
+        mDestageTiers[i] = kKfsSTierUndef;
+    }
+    istringstream is(mStorageTierStaging);
+    int tier;
+    int stagingTier;
+    while ((is >> tier >> stagingTier)) {
+        if (tier < kKfsSTierMin || kKfsSTierMax < tier ||
+                stagingTier < kKfsSTierMin || kKfsSTierMax < stagingTier ||
+                tier == stagingTier ||
+                mStagingTiers[tier] != kKfsSTierUndef ||
+                mDestageTiers[tier] != kKfsSTierUndef ||
+                mStagingTiers[stagingTier] != kKfsSTierUndef ||
+                mDestageTiers[stagingTier] != kKfsSTierUndef) {
+            KFS_LOG_STREAM_ERROR <<
+                "storage tier staging: invalid or duplicate"
+                " tier: "         << tier <<
+                " staging tier: " << stagingTier <<
+            KFS_LOG_EOM;
+            continue;
+        }
+        mStagingTiers[tier]        = (kfsSTier_t)stagingTier;
+        mDestageTiers[stagingTier] = (kfsSTier_t)tier;
+    }
+}
+
+bool
+ChunkManager::IsStagingDir(const ChunkDirInfo& dir) const
+{
+    return (kKfsSTierMin <= dir.storageTier &&
+        dir.storageTier <= kKfsSTierMax &&
+        mDestageTiers[dir.storageTier] != kKfsSTierUndef);
+}
+
+bool
+ChunkManager::IsDestageCandidate(
+    const ChunkInfoHandle& cih, time_t idleTime) const
+{
+    return (
+        0 <= cih.chunkInfo.chunkVersion &&
+        cih.IsChunkReadable() &&
+        ! cih.IsStale() &&
+        ! cih.IsBeingReplicated() &&
+        ! cih.IsRenameInFlight() &&
+        ! cih.IsWriteAppenderOwns() &&
+        ! cih.IsEvacuate() &&
+        ! cih.readChunkMetaOp &&
+        ! cih.writeCoalescer &&
+        cih.lastIOTime <= idleTime &&
+        ! mPendingWrites.HasChunkId(
+            cih.chunkInfo.chunkId, cih.chunkInfo.chunkVersion)
+    );
+}
+
+// Copies one staged stable chunk file into the destination chunk directory
+// with sequential reads and writes. The copy is written into the destination
+// directory "dirty" sub directory, which is cleaned up on restart, and renamed
+// into place once written and synced. On the rename completion the chunk
+// table entry is switched to the destination directory, and the staged file
+// is deleted. If the chunk server restarts before the staged file deletion,
+// the chunk directories scan keeps the destination copy, see AddMapping().
+// The chunk reads continue to be served from the staged file while the copy
+// is in flight. If the chunk is modified, deleted, or is in use at the time
+// of the switch, the copy is discarded, and destage is re-tried later.
+class ChunkManager::ChunkDestager : public KfsCallbackObj
+{
+public:
+    ChunkDestager(
+        ChunkManager&    mgr,
+        ChunkInfoHandle& cih,
+        ChunkDirInfo&    dstDir)
+        : KfsCallbackObj(),
+          mMgr(mgr),
+          mSrcDir(cih.GetDirInfo()),
+          mDstDir(dstDir),
+          mChunkId(cih.chunkInfo.chunkId),
+          mChunkVersion(cih.chunkInfo.chunkVersion),
+          mFileSize(cih.chunkInfo.chunkSize + cih.chunkInfo.GetHeaderSize()),
+          mSrcName(mgr.MakeChunkPathname(&cih)),
+          mTmpName(mgr.MakeChunkPathname(dstDir.dirname,
+            cih.chunkInfo.fileId, mChunkId, mChunkVersion,
+            mgr.mDirtyChunksDir)),
+          mDstName(mgr.MakeChunkPathname(dstDir.dirname,
+            cih.chunkInfo.fileId, mChunkId, mChunkVersion, string())),
+          mSrcFile(new DiskIo::File()),
+          mDstFile(new DiskIo::File()),
+          mDiskIo(),
+          mOffset(0),
+          mState(kStateNone)
+    {
+        SET_HANDLER(this, &ChunkDestager::HandleEvent);
+        mSrcDir.destageInFlightFlag = true;
+        mMgr.mDestageInFlight++;
+    }
+    ~ChunkDestager()
+    {
+        CloseFiles();
+        mSrcDir.destageInFlightFlag = false;
+        mMgr.mDestageInFlight--;
+    }
+    void Start()
+    {
+        KFS_LOG_STREAM_INFO <<
+            "destage: chunk: "  << mChunkId <<
+            " version: "        << mChunkVersion <<
+            " size: "           << mFileSize <<
+            " "                 << mSrcName <<
+            " => "              << mDstName <<
+        KFS_LOG_EOM;
+        string errMsg;
+        if (! mSrcFile->Open(
+                mSrcName.c_str(),
+                CHUNKSIZE + KFS_CHUNK_HEADER_SIZE + 1,
+                true,  // read only
+                false, // reserve space
+                false, // create
+                &errMsg,
+                0,
+                mMgr.mBufferedIoFlag || mSrcDir.bufferedIoFlag)) {
+            Error(mSrcName, -EIO, errMsg);
+            return;
+        }
+        globals().ctrOpenDiskFds.Update(1);
+        if (! mDstFile->Open(
+                mTmpName.c_str(),
+                CHUNKSIZE + KFS_CHUNK_HEADER_SIZE + 1,
+                false, // read only
+                mDstDir.supportsSpaceReservatonFlag,
+                true,  // create
+                &errMsg,
+                0,
+                mMgr.mBufferedIoFlag || mDstDir.bufferedIoFlag)) {
+            Error(mTmpName, -EIO, errMsg);
+            return;
+        }
+        globals().ctrOpenDiskFds.Update(1);
+        Read();
+    }
+    int HandleEvent(
+        int   code,
+        void* data)
+    {
+        DiskIoPtr diskIo;
+        diskIo.swap(mDiskIo);
+        if (code == EVENT_DISK_ERROR) {
+            const int status = data ? *reinterpret_cast<int*>(data) : -EIO;
+            if (mState == kStateDelete || mState == kStateDeleteCopy) {
+                Done();
+            } else {
+                Error(mState == kStateRead ? mSrcName :
+                    (mState == kStateWrite ? mTmpName : mDstName),
+                    status < 0 ? status : -EIO, "io error");
+            }
+            return 0;
+        }
+        if (mMgr.mDestageShutdownFlag) {
+            Done();
+            return 0;
+        }
+        switch (mState) {
+            case kStateRead:
+                if (code == EVENT_DISK_READ && data) {
+                    Write(*reinterpret_cast<IOBuffer*>(data));
+                    return 0;
+                }
+                break;
+            case kStateWrite:
+                if (code == EVENT_DISK_WROTE) {
+                    if (mOffset < mFileSize) {
+                        Read();
+                    } else {
+                        Rename();
+                    }
+                    return 0;
+                }
+                break;
+            case kStateRename:
+                if (code == EVENT_DISK_RENAME_DONE) {
+                    Switch();
+                    return 0;
+                }
+                break;
+            case kStateDelete:
+            case kStateDeleteCopy:
+                if (code == EVENT_DISK_DELETE_DONE) {
+                    Done();
+                    return 0;
+                }
+                break;
+            default:
+                break;
+        }
+        die("destage: invalid completion");
+        return -1;
+    }
+private:
+    enum State
+    {
+        kStateNone,
+        kStateRead,
+        kStateWrite,
+        kStateRename,
+        kStateDelete,
+        kStateDeleteCopy
+    };
+    ChunkManager&      mMgr;
+    ChunkDirInfo&      mSrcDir;
+    ChunkDirInfo&      mDstDir;
+    kfsChunkId_t const mChunkId;
+    kfsSeq_t const     mChunkVersion;
+    int64_t const      mFileSize;
+    string const       mSrcName;
+    string const       mTmpName;
+    string const       mDstName;
+    DiskIo::FilePtr    mSrcFile;
+    DiskIo::FilePtr    mDstFile;
+    DiskIoPtr          mDiskIo;
+    int64_t            mOffset;
+    State              mState;
+
+    void Read()
+    {
+        if (mSrcDir.availableSpace < 0 || mDstDir.availableSpace < 0) {
+            Abort("chunk directory is no longer available");
+            return;
+        }
+        const size_t size = (size_t)min(mFileSize - mOffset, (int64_t)max(
+            (size_t)CHECKSUM_BLOCKSIZE,
+            min((size_t)mMgr.mDestageIoSize, mMgr.mMaxIORequestSize)));
+        mState = kStateRead;
+        mDiskIo.reset(new DiskIo(mSrcFile, this));
+        mDiskIo->SetPriorityClass(QCDiskQueue::kPriorityClassMaintenance);
+        const ssize_t res = mDiskIo->Read(mOffset, size);
+        if (res < 0) {
+            mDiskIo.reset();
+            Error(mSrcName, (int)res, "read failure");
+        }
+    }
+    void Write(
+        IOBuffer& buf)
+    {
+        const int size = buf.BytesConsumable();
+        if (size <= 0 || mFileSize - mOffset < size) {
+            Error(mSrcName, -EIO, "invalid read size");
+            return;
+        }
+        IOBuffer data;
+        data.Move(&buf);
+        mMgr.ZeroPad(&data);
+        const int64_t offset = mOffset;
+        mOffset += size;
+        mState = kStateWrite;
+        mDiskIo.reset(new DiskIo(mDstFile, this));
+        mDiskIo->SetPriorityClass(QCDiskQueue::kPriorityClassMaintenance);
+        const ssize_t res = mDiskIo->Write(offset, data.BytesConsumable(),
+            &data, mFileSize <= mOffset, mFileSize);
+        if (res < 0) {
+            mDiskIo.reset();
+            Error(mTmpName, (int)res, "write failure");
+        }
+    }
+    void Rename()
+    {
+        string errMsg;
+        if (! CloseFiles(&errMsg)) {
+            Error(mTmpName, -EIO, errMsg);
+            return;
+        }
+        ChunkInfoHandle** const ci = mMgr.mChunkTable.Find(mChunkId);
+        if (! ci || &(*ci)->GetDirInfo() != &mSrcDir ||
+                (*ci)->chunkInfo.chunkVersion != mChunkVersion ||
+                ! mMgr.IsDestageCandidate(**ci, (*ci)->lastIOTime)) {
+            Abort("chunk has changed");
+            return;
+        }
+        mState = kStateRename;
+        if (! DiskIo::Rename(mTmpName.c_str(), mDstName.c_str(), this,
+                &errMsg)) {
+            Error(mDstName, -EIO, errMsg);
+        }
+    }
+    void Switch()
+    {
+        const int res = mMgr.DestageSwitch(
+            mSrcDir, mDstDir, mChunkId, mChunkVersion);
+        if (res < 0) {
+            // The destination file now belongs to the chunk.
+            mMgr.mCounters.mDestageAbortCount++;
+            Done();
+            return;
+        }
+        string errMsg;
+        if (0 < res) {
+            mMgr.mCounters.mDestageCount++;
+            mMgr.mCounters.mDestageByteCount += mFileSize;
+            mState = kStateDelete;
+            if (! DiskIo::Delete(mSrcName.c_str(), this, &errMsg)) {
+                KFS_LOG_STREAM_ERROR <<
+                    "destage: " << mSrcName << ": " << errMsg <<
+                KFS_LOG_EOM;
+                Done();
+            }
+            return;
+        }
+        mMgr.mCounters.mDestageAbortCount++;
+        KFS_LOG_STREAM_INFO <<
+            "destage: chunk: " << mChunkId <<
+            " version: "       << mChunkVersion <<
+            " has changed, discarding " << mDstName <<
+        KFS_LOG_EOM;
+        mState = kStateDeleteCopy;
+        if (! DiskIo::Delete(mDstName.c_str(), this, &errMsg)) {
+            Done();
+        }
+    }
+    void Abort(
+        const char* reason)
+    {
+        mMgr.mCounters.mDestageAbortCount++;
+        KFS_LOG_STREAM_INFO <<
+            "destage: chunk: " << mChunkId <<
+            " version: "       << mChunkVersion <<
+            " canceled: "      << reason <<
+        KFS_LOG_EOM;
+        DeleteCopy();
+    }
+    void Error(
+        const string& name,
+        int           status,
+        const string& msg)
+    {
+        mMgr.mCounters.mDestageErrorCount++;
+        KFS_LOG_STREAM_ERROR <<
+            "destage: chunk: " << mChunkId <<
+            " version: "       << mChunkVersion <<
+            " "                << name <<
+            " status: "        << status <<
+            " "                << msg <<
+        KFS_LOG_EOM;
+        DeleteCopy();
+    }
+    void DeleteCopy()
+    {
+        // Remove the copy, if any, in the destination dirty directory. The
+        // restart cleans up the dirty directory, if the delete fails.
+        CloseFiles();
+        mState = kStateDeleteCopy;
+        if (mMgr.mDestageShutdownFlag ||
+                ! DiskIo::Delete(mTmpName.c_str(), this)) {
+            Done();
+        }
+    }
+    bool CloseFiles(
+        string* errMsg = 0)
+    {
+        bool ret = true;
+        if (mSrcFile && mSrcFile->IsOpen()) {
+            mSrcFile->Close();
+            globals().ctrOpenDiskFds.Update(-1);
+        }
+        if (mDstFile && mDstFile->IsOpen()) {
+            ret = mDstFile->Close(mFileSize, errMsg);
+            globals().ctrOpenDiskFds.Update(-1);
+        }
+        return ret;
+    }
+    void Done()
+        { delete this; }
+private:
+    ChunkDestager(const ChunkDestager&);
+    ChunkDestager& operator=(const ChunkDestager&);
+};
+
+/// Switches the chunk table entry to the destination directory. Returns 1 on
+/// success, 0 if the chunk has changed or can not be switched at the moment,
+/// and -1 if the chunk is already in the destination directory.
+int
+ChunkManager::DestageSwitch(ChunkDirInfo& srcDir, ChunkDirInfo& dstDir,
+    kfsChunkId_t chunkId, kfsSeq_t chunkVersion)
+{
+    ChunkInfoHandle** const ci  = mChunkTable.Find(chunkId);
+    ChunkInfoHandle*  const cih = ci ? *ci : 0;
+    if (! cih || cih->chunkInfo.chunkVersion != chunkVersion) {
+        return 0;
+    }
+    if (&cih->GetDirInfo() == &dstDir) {
+        return -1;
+    }
+    if (&cih->GetDirInfo() != &srcDir || srcDir.availableSpace < 0 ||
+            dstDir.availableSpace < 0 || cih->IsFileInUse() ||
+            ! IsDestageCandidate(*cih, cih->lastIOTime)) {
+        return 0;
+    }
+    if (cih->IsFileOpen()) {
+        Release(*cih);
+    }
+    ChunkMetaCacheRemove(*cih);
+    ChunkInfoHandle* const ncih = new ChunkInfoHandle(dstDir);
+    ncih->chunkInfo.fileId       = cih->chunkInfo.fileId;
+    ncih->chunkInfo.chunkId      = cih->chunkInfo.chunkId;
+    ncih->chunkInfo.chunkVersion = cih->chunkInfo.chunkVersion;
+    ncih->chunkInfo.chunkSize    = cih->chunkInfo.chunkSize;
+    ncih->chunkInfo.SetMinHeaderSize(
+        cih->chunkInfo.GetHeaderSize() == KFS_MIN_CHUNK_HEADER_SIZE);
+    UpdateDirSpace(cih, -cih->chunkInfo.chunkSize);
+    *ci = ncih;
+    UpdateDirSpace(ncih, ncih->chunkInfo.chunkSize);
+    DeleteSelf(*cih);
+    LruUpdate(*ncih);
+    return 1;
+}
+
+void
+ChunkManager::StartDestage(time_t now)
+{
+    if (mDestageShutdownFlag || mDestageMaxInFlight <= mDestageInFlight ||
+            now < mNextDestageTime) {
+        return;
+    }
+    mNextDestageTime = now + 1;
+    const time_t idleTime = now - mDestageMinIdleSec;
+    for (ChunkDirs::iterator it = mChunkDirs.begin();
+            it < mChunkDirs.end() && mDestageInFlight < mDestageMaxInFlight;
+            ++it) {
+        if (it->availableSpace < 0 || it->destageInFlightFlag ||
+                it->evacuateStartedFlag || ! IsStagingDir(*it)) {
+            continue;
+        }
+        // Destage in chunk id order, as the chunk ids are assigned
+        // sequentially, this makes the destination writes roughly follow
+        // the file order.
+        ChunkInfoHandle* cih = 0;
+        ChunkDirList::Iterator cit(it->chunkLists[ChunkDirInfo::kChunkDirList]);
+        ChunkInfoHandle* c;
+        while ((c = cit.Next())) {
+            if ((! cih || c->chunkInfo.chunkId < cih->chunkInfo.chunkId) &&
+                    IsDestageCandidate(*c, idleTime)) {
+                cih = c;
+            }
+        }
+        if (! cih) {
+            continue;
+        }
+        const kfsSTier_t tier = mDestageTiers[it->storageTier];
+        ChunkDirInfo* const dir = GetDirForChunk(false, tier, tier);
+        if (! dir || dir == &*it) {
+            continue;
+        }
+        ChunkDestager& destager = *(new ChunkDestager(*this, *cih, *dir));
+        destager.Start();
+    }
+}
+
 void
 ChunkManager::CheckChunkDirs()
 {
@@ -6918,6 +9225,8 @@ ChunkManager::CheckChunkDirs()
             bool   kBufferDataIgnoreOverwriteFlag = false;
             int    kinBufferDataTailToKeepSize    = 0;
             bool   kCreateExclusiveFlag           = true;
+            const int     kThreadCount            = -1;
+            const int64_t kMaxFileSize            = -1;
             string errMsg;
             if (DiskIo::StartIoQueue(
                     it->dirname.c_str(),
@@ -6929,7 +9238,11 @@ ChunkManager::CheckChunkDirs()
                     kinBufferDataTailToKeepSize,
                     kCreateExclusiveFlag,
                     mDiskIoRequestAffinityFlag,
-                    mDiskIoSerializeMetaRequestsFlag
+                    mDiskIoSerializeMetaRequestsFlag,
+                    kThreadCount,
+                    kMaxFileSize,
+                    ! mBufferedIoFlag && ! it->bufferedIoFlag &&
+                        ! it->bufferedReadFlag
                 )) {
                 if (! (it->diskQueue = DiskIo::FindDiskQueue(
                         it->dirname.c_str()))) {
@@ -7030,9 +9343,69 @@ ChunkManager::CheckChunkDirs()
     }
 }
 
+void
+ChunkManager::UpdateSlowDirs()
+{
+    // Compare each directory latency average with the median of all
+    // directories averages, in order to detect the drives that still work,
+    // but are much slower than their peers. The lower median is used, as
+    // with two directories it is the faster of the two.
+    vector<double> latencies;
+    for (ChunkDirs::const_iterator it = mChunkDirs.begin();
+            it < mChunkDirs.end(); ++it) {
+        if (0 <= it->availableSpace &&
+                mSlowDirMinIoCount <= it->latency.mCount) {
+            latencies.push_back(it->latency.mEwmaUsec);
+        }
+    }
+    const size_t mid = latencies.empty() ? 0 : (latencies.size() - 1) / 2;
+    if (! latencies.empty()) {
+        nth_element(latencies.begin(), latencies.begin() + mid,
+            latencies.end());
+    }
+    const double threshold = latencies.size() < 2 ? -1. :
+        max((double)mSlowDirMinLatencyUsec,
+            mSlowDirLatencyRatio * latencies[mid]);
+    for (ChunkDirs::iterator it = mChunkDirs.begin();
+            it < mChunkDirs.end(); ++it) {
+        if (it->availableSpace < 0) {
+            continue;
+        }
+        it->latency.Decay();
+        bool slowFlag = false;
+        if (mSlowDirLatencyRatio <= 0) {
+            slowFlag = false;
+        } else if (threshold < 0 || it->latency.mCount < mSlowDirMinIoCount) {
+            slowFlag = it->slowFlag; // Not enough data.
+        } else {
+            // Clear with hysteresis, in order to avoid flapping.
+            slowFlag = (it->slowFlag ? threshold * 0.5 : threshold) <
+                it->latency.mEwmaUsec;
+        }
+        if (slowFlag == it->slowFlag) {
+            continue;
+        }
+        it->slowFlag = slowFlag;
+        if (slowFlag) {
+            mCounters.mSlowDirDetectCount++;
+        }
+        KFS_LOG_STREAM(slowFlag ?
+                MsgLogger::kLogLevelWARN : MsgLogger::kLogLevelNOTICE) <<
+            "chunk directory: " << it->dirname <<
+            (slowFlag ? " is slow" : " is no longer slow") <<
+            " latency average: " << (int64_t)it->latency.mEwmaUsec <<
+            " p99: "             << it->latency.GetPercentile(0.99) <<
+            " threshold: "       << (int64_t)threshold <<
+            " usec" <<
+        KFS_LOG_EOM;
+        it->chunkDirInfoOp.Enqueue();
+    }
+}
+
 void
 ChunkManager::GetFsSpaceAvailable()
 {
+    UpdateSlowDirs();
     for (ChunkDirs::iterator it = mChunkDirs.begin();
             it < mChunkDirs.end(); ++it) {
         if (it->availableSpace < 0) {
@@ -7063,6 +9436,8 @@ ChunkManager::GetFsSpaceAvailable()
                     mMetaHeartbeatTime) {
             it->RestartEvacuation();
         }
+        UpdateChunkFilePool(*it);
+        RunReclaimQueue(*it);
         if (it->fsSpaceAvailInFlightFlag) {
             continue;
         }
@@ -7087,4 +9462,47 @@ ChunkManager::MetaHeartbeat(HeartbeatOp& op)
     mMetaEvacuateCount = op.metaEvacuateCount;
 }
 
+void
+ChunkManager::CountChunkRead(kfsChunkId_t chunkId)
+{
+    if (mHotChunkMinReadRate <= 0 || mHotChunkMaxReported <= 0) {
+        return;
+    }
+    ChunkReadCounts::iterator const it = mChunkReadCounts.find(chunkId);
+    if (it != mChunkReadCounts.end()) {
+        it->second++;
+    } else if ((int)mChunkReadCounts.size() < mHotChunkMaxTracked) {
+        mChunkReadCounts.insert(make_pair(chunkId, int64_t(1)));
+    }
+}
+
+void
+ChunkManager::GetHotChunks(ChunkManager::HotChunks& hotChunks)
+{
+    hotChunks.clear();
+    const time_t now      = globalNetManager().Now();
+    const time_t interval = max(time_t(1), now - mChunkReadCountsStartTime);
+    mChunkReadCountsStartTime = now;
+    if (mChunkReadCounts.empty()) {
+        return;
+    }
+    const int64_t minCount = (int64_t)(mHotChunkMinReadRate * interval + .5);
+    for (ChunkReadCounts::const_iterator it = mChunkReadCounts.begin();
+            it != mChunkReadCounts.end();
+            ++it) {
+        if (minCount <= it->second) {
+            hotChunks.push_back(make_pair(it->first,
+                (int)min(int64_t(1) << 30, it->second / interval)));
+        }
+    }
+    mChunkReadCounts.clear();
+    if (mHotChunkMaxReported < (int)hotChunks.size()) {
+        // Report the chunks with the highest read rates.
+        nth_element(hotChunks.begin(),
+            hotChunks.begin() + mHotChunkMaxReported,
+            hotChunks.end(), HotChunkRateCompare());
+        hotChunks.resize(mHotChunkMaxReported);
+    }
+}
+
 } // namespace KFS
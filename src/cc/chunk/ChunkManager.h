@@ -38,6 +38,7 @@
 #include "kfsio/CryptoKeys.h"
 #include "kfsio/PrngIsaac64.h"
 #include "common/LinearHash.h"
+#include "common/OpenHash.h"
 #include "common/StdAllocator.h"
 
 #include <vector>
@@ -59,6 +60,8 @@ using std::make_pair;
 using std::less;
 
 class ChunkInfoHandle;
+class ChunkReadAhead;
+class ChunkWriteCoalescer;
 class Properties;
 class BufferManager;
 
@@ -91,6 +94,37 @@ public:
         Counter mReadSkipDiskVerifyErrorCount;
         Counter mReadSkipDiskVerifyByteCount;
         Counter mReadSkipDiskVerifyChecksumByteCount;
+        Counter mReadChecksumVerifiedByteCount;
+        Counter mChunkMetaCacheHitCount;
+        Counter mChunkMetaCacheEvictCount;
+        Counter mReadAheadCount;
+        Counter mReadAheadByteCount;
+        Counter mReadAheadHitCount;
+        Counter mReadAheadHitByteCount;
+        Counter mWriteCoalesceCount;
+        Counter mWriteCoalesceOpCount;
+        Counter mWriteCoalesceByteCount;
+        Counter mChunkFilePoolHitCount;
+        Counter mChunkFilePoolMissCount;
+        Counter mReadSendFileCount;
+        Counter mReadSendFileByteCount;
+        Counter mReadSendFileSkipCount;
+        Counter mStagedChunkCount;
+        Counter mDestageCount;
+        Counter mDestageByteCount;
+        Counter mDestageErrorCount;
+        Counter mDestageAbortCount;
+        Counter mFdOpenCount;
+        Counter mFdEvictCount;
+        Counter mFdReopenCount;
+        Counter mFdHotKeepCount;
+        Counter mFdSecondChanceCount;
+        Counter mReclaimCount;
+        Counter mReclaimByteCount;
+        Counter mReclaimErrorCount;
+        Counter mReclaimPendingByteCount;
+        Counter mSlowDirDetectCount;
+        Counter mSlowDirCount;
 
         void Clear()
         {
@@ -109,6 +143,37 @@ public:
             mReadSkipDiskVerifyErrorCount        = 0;
             mReadSkipDiskVerifyByteCount         = 0;
             mReadSkipDiskVerifyChecksumByteCount = 0;
+            mReadChecksumVerifiedByteCount       = 0;
+            mChunkMetaCacheHitCount              = 0;
+            mChunkMetaCacheEvictCount            = 0;
+            mReadAheadCount                      = 0;
+            mReadAheadByteCount                  = 0;
+            mReadAheadHitCount                   = 0;
+            mReadAheadHitByteCount               = 0;
+            mWriteCoalesceCount                  = 0;
+            mWriteCoalesceOpCount                = 0;
+            mWriteCoalesceByteCount              = 0;
+            mChunkFilePoolHitCount               = 0;
+            mChunkFilePoolMissCount              = 0;
+            mReadSendFileCount                   = 0;
+            mReadSendFileByteCount               = 0;
+            mReadSendFileSkipCount               = 0;
+            mStagedChunkCount                    = 0;
+            mDestageCount                        = 0;
+            mDestageByteCount                    = 0;
+            mDestageErrorCount                   = 0;
+            mDestageAbortCount                   = 0;
+            mFdOpenCount                         = 0;
+            mFdEvictCount                        = 0;
+            mFdReopenCount                       = 0;
+            mFdHotKeepCount                      = 0;
+            mFdSecondChanceCount                 = 0;
+            mReclaimCount                        = 0;
+            mReclaimByteCount                    = 0;
+            mReclaimErrorCount                   = 0;
+            mReclaimPendingByteCount             = 0;
+            mSlowDirDetectCount                  = 0;
+            mSlowDirCount                        = 0;
         }
     };
 
@@ -243,6 +308,14 @@ public:
     /// @param[in] op  The write op that just finished
     ///
     bool ReadChunkDone(ReadOp *op);
+    /// Setup sending the verified read data directly from the chunk file
+    /// with sendfile, if the chunk is stable and its file uses buffered io.
+    void ReadSendFileSetup(ReadOp* op);
+    /// Grant the local client access to the stable chunk file descriptor
+    /// through the short circuit server. Returns positive grant id, or
+    /// negative error code.
+    int64_t ShortCircuitGrant(kfsChunkId_t chunkId, int64_t chunkVersion,
+        int64_t& headerSize);
     void ReplicationDone(kfsChunkId_t chunkId, int status,
         const DiskIo::FilePtr& filePtr);
     /// Determine the size of a chunk.
@@ -260,11 +333,15 @@ public:
 
     /// Retrieve the chunks hosted on this chunk server.
     typedef pair<int64_t*, ostream*> HostedChunkList;
+    /// Optionally return the stable chunks inventory checksum, and the number
+    /// of the chunks with version change or make stable in flight.
     void GetHostedChunks(
         const HostedChunkList& stable,
         const HostedChunkList& notStableAppend,
         const HostedChunkList& notStable,
-        bool                   noFidsFlag);
+        bool                   noFidsFlag,
+        uint64_t*              stableChecksum      = 0,
+        int64_t*               renameInFlightCount = 0);
 
     typedef EvacuateChunksOp::StorageTierInfo  StorageTierInfo;
     typedef EvacuateChunksOp::StorageTiersInfo StorageTiersInfo;
@@ -284,6 +361,9 @@ public:
     long GetNumWritableChunks() const;
     long GetNumWritableObjects() const;
     long GetNumOpenObjects() const;
+    /// Bit mask of the storage tiers with memory backed chunk directories
+    /// in use, see chunkServer.storageTierIoPolicy "memory" policy.
+    uint32_t GetMemoryStorageTiersMask() const;
 
     /// For a write, the client is defining a write operation.  The op
     /// is queued and the client pushes data for it subsequently.
@@ -293,6 +373,10 @@ public:
         WriteIdAllocOp*       wi,
         int                   replicationPos,
         const ServerLocation& peerLoc);
+    /// Allocate write id for the write prepare that carries both the write
+    /// id allocation and the write data.
+    int AllocateWriteId(
+        WritePrepareOp* wp);
 
     /// Check if a write is pending to a chunk.
     /// @param[in] chunkId  The chunkid for which we are checking for
@@ -340,14 +424,22 @@ public:
         return mMaxIORequestSize;
     }
     void Shutdown();
+    typedef vector<kfsChunkId_t>    ChunkIds;
+    typedef map<string, ChunkIds> DirChunkIds;
+    /// Return sorted stable chunk ids for each usable chunk directory.
+    void GetStableChunkIds(DirChunkIds& outDirChunkIds);
     bool IsWriteAppenderOwns(kfsChunkId_t chunkId, int64_t chunkVersion) const;
 
     inline void LruUpdate(ChunkInfoHandle& cih);
     inline bool IsInLru(const ChunkInfoHandle& cih) const;
     inline void UpdateStale(ChunkInfoHandle& cih);
+    inline bool ChunkMetaCacheRemove(ChunkInfoHandle& cih);
+    void ReadAheadDone(ChunkReadAhead& ra, int code, void* data);
+    void WriteCoalesceFlush(ChunkWriteCoalescer& wc);
 
-    void GetCounters(Counters& counters)
-        { counters = mCounters; }
+    void GetCounters(Counters& counters);
+    void GetDirCheckerCounters(DirChecker::Counters& counters)
+        { mDirChecker.GetCounters(counters); }
 
     /// Utility function that sets up a disk connection for an
     /// I/O operation on a chunk.
@@ -392,6 +484,12 @@ public:
         { return mEvacuateDoneFileName; }
     int UpdateCountFsSpaceAvailable();
     void MetaHeartbeat(HeartbeatOp& op);
+    // Chunk ids and client read rates, in reads per second since the
+    // previous call, of the chunks with read rate at or above the min hot
+    // chunk read rate. The read counts are reset on every invocation,
+    // therefore this must be called only from the heartbeat.
+    typedef vector<pair<kfsChunkId_t, int> > HotChunks;
+    void GetHotChunks(HotChunks& hotChunks);
     int GetMaxEvacuateIoErrors() const
         { return mMaxEvacuateIoErrors; }
     int GetAvailableChunksRetryInterval() const
@@ -770,6 +868,12 @@ private:
         ChunkDirs& operator=(const ChunkDirs&);
     };
 
+    typedef map<
+        kfsChunkId_t,
+        int64_t,
+        less<kfsChunkId_t>,
+        StdFastAllocator<pair<const kfsChunkId_t, int64_t> >
+    > ChunkReadCounts;
     typedef map<
         kfsSTier_t,
         vector<ChunkDirs::iterator, StdAllocator<ChunkDirs::iterator> >,
@@ -795,10 +899,16 @@ private:
     };
 
     bool StartDiskIo();
+    int64_t NextWriteId(int64_t chunkVersion);
 
     /// Map from a chunk id to a chunk handle
     ///
+    /// The tables are only iterated read only, and the insert results are
+    /// not retained, therefore the open addressing table can be used instead.
     typedef KVPair<kfsChunkId_t, ChunkInfoHandle*> CMapEntry;
+#if defined(KFS_CHUNK_TABLE_OPEN_HASH)
+    typedef OpenHash<CMapEntry, KeyCompare<kfsChunkId_t> > CMap;
+#else
     typedef LinearHash<
         CMapEntry,
         KeyCompare<kfsChunkId_t>,
@@ -808,6 +918,7 @@ private:
         >,
         StdFastAllocator<CMapEntry>
     > CMap;
+#endif
     typedef KVPair<pair<kfsChunkId_t, int64_t>, ChunkInfoHandle*> ObjTableEntry;
     struct ObjHash
     {
@@ -815,6 +926,12 @@ private:
             const ObjTableEntry::Key& inVal)
             { return size_t(inVal.first); }
     };
+#if defined(KFS_CHUNK_TABLE_OPEN_HASH)
+    typedef OpenHash<
+        ObjTableEntry,
+        KeyCompare<ObjTableEntry::Key, ObjHash>
+    > ObjTable;
+#else
     typedef LinearHash<
         ObjTableEntry,
         KeyCompare<ObjTableEntry::Key, ObjHash>,
@@ -824,6 +941,7 @@ private:
         >,
         StdFastAllocator<ObjTableEntry>
     > ObjTable;
+#endif
 
     /// How long should a pending write be held in LRU
     int mMaxPendingWriteLruSecs;
@@ -862,6 +980,39 @@ private:
     size_t mMaxIORequestSize;
     /// Chunk lru, and stale chunks list heads.
     ChunkLists mChunkInfoLists[kChunkInfoListCount];
+    /// Closed stable chunks with checksums kept in memory, in lru order,
+    /// in order to avoid chunk header read on re-open.
+    ChunkLists mChunkMetaCacheList;
+    int64_t    mChunkMetaCacheCount;
+    int64_t    mChunkMetaCacheMaxSize;
+    /// Sequential read ahead parameters, and the read ops served from the
+    /// read ahead buffers with completion pending. The completion is invoked
+    /// from the timer, in order to make read chunk completion asynchronous
+    /// the same way as for disk io.
+    typedef vector<ReadOp*> ReadAheadDoneQueue;
+    int64_t            mReadAheadMaxSize;
+    int                mReadAheadMinSequentialCount;
+    int                mReadAheadQueueDepthThreshold;
+    ReadAheadDoneQueue mReadAheadDoneQueue;
+    ReadAheadDoneQueue mReadAheadDoneQueueTmp;
+    /// Adjacent checksum block aligned client writes to the same chunk
+    /// received within one network event loop iteration are coalesced into
+    /// a single disk write, up to the max size. The list contains coalescers
+    /// pending flush.
+    int64_t              mWriteCoalesceMaxSize;
+    ChunkWriteCoalescer* mWriteCoalesceList[1];
+    /// Per chunk directory pool of created files with space allocated,
+    /// used by chunk allocation instead of creating new chunk files. The pool
+    /// is topped up in the background, and shrunk when the directory's free
+    /// space falls below the threshold.
+    int                  mChunkFilePoolSize;
+    double               mChunkFilePoolMinFreeSpaceRatio;
+    /// Stale chunk files are renamed into per directory reclaim directory,
+    /// and then deleted in the background with the lowest io priority, with
+    /// at most the following number of deletes in flight per directory. The
+    /// space pending reclaim is counted as available. 0 -- delete stale
+    /// chunk files directly.
+    int                  mReclaimMaxInFlightPerDir;
 
     /// Periodically do an IO and check the chunk dirs and identify failed drives
     time_t mNextChunkDirsCheckTime;
@@ -876,6 +1027,22 @@ private:
     time_t mNextInactiveFdCleanupTime;
     int    mInactiveFdFullScanIntervalSecs;
     time_t mNextInactiveFdFullScanTime;
+    // Chunks re-opened within the re-open window after their fds were closed
+    // by the inactive fd cleanup are considered "hot", i.e. part of the
+    // working set. Hot chunks fds are kept open for up to hot max idle time,
+    // while the fd use is below the max use ratio of the fd limit, and get
+    // second chance when fds have to be released to open other chunks.
+    int    mFdCacheReopenWindowSecs;
+    int    mFdCacheHotMaxIdleSecs;
+    double mFdCacheHotMaxFdUseRatio;
+    // Client read counts per chunk since the last heartbeat, used by the meta
+    // server to create temporary extra replicas of the "hot" read chunks.
+    // The number of chunks tracked is limited by max tracked.
+    ChunkReadCounts mChunkReadCounts;
+    time_t          mChunkReadCountsStartTime;
+    double          mHotChunkMinReadRate;
+    int             mHotChunkMaxTracked;
+    int             mHotChunkMaxReported;
 
     int mReadChecksumMismatchMaxRetryCount;
     bool mAbortOnChecksumMismatchFlag; // For debugging
@@ -891,6 +1058,17 @@ private:
     double mMaxPlacementSpaceRatio;
     int64_t mMinPendingIoThreshold;
     int64_t mPlacementMaxWaitingAvgUsecsThreshold;
+    /// Slow chunk directory detection: the directory is declared slow if its
+    /// io latency moving average exceeds max(min latency, ratio x median of
+    /// all directories latency averages). Slow directory is used for new
+    /// chunk placement with the configured probability weight, and reported
+    /// to the meta server with chunk directory info, in order to
+    /// de-prioritize the chunk server for reads and placement.
+    double  mSlowDirLatencyRatio;
+    int64_t mSlowDirMinLatencyUsec;
+    int64_t mSlowDirMinIoCount;
+    double  mSlowDirLatencyEwmaWeight;
+    double  mSlowDirPlacementWeight;
     bool mAllowSparseChunksFlag;
     bool mBufferedIoFlag;
     bool mSyncChunkHeaderFlag;
@@ -905,9 +1083,12 @@ private:
     bool       mCleanupChunkDirsFlag;
     string     mStaleChunksDir;
     string     mDirtyChunksDir;
+    string     mChunkFilePoolDir;
+    string     mReclaimDir;
     string     mEvacuateFileName;
     string     mEvacuateDoneFileName;
     string     mChunkDirLockName;
+    string     mChunkInventoryFileName;
     int        mEvacuationInactivityTimeout;
     time_t     mMetaHeartbeatTime;
     int64_t    mMetaEvacuateCount;
@@ -920,9 +1101,12 @@ private:
     string     mObjStorageTiersPrefixes;
     bool       mObjStorageTiersSetFlag;
     string     mBufferedIoPrefixes;
+    string     mStorageTierIoPolicy;
+    int64_t    mMemoryStorageTierMaxSpace;
     bool       mBufferedIoSetFlag;
     bool       mDiskBufferManagerEnabledFlag;
     bool       mForceVerifyDiskReadChecksumFlag;
+    int        mReadVerifiedBlocksMaxAge;
     bool       mWritePrepareReplyFlag;
     CryptoKeys mCryptoKeys;
     int64_t    mFileSystemId;
@@ -944,12 +1128,47 @@ private:
     int        mObjStoreBlockMaxNonStableDisconnectedTime;
     int        mObjBlockDiscardMinMetaUptime;
     int        mObjStoreIoThreadCount;
+    /// Write staging: the chunks created by the clients in a tier with the
+    /// staging tier configured are placed into the staging tier directories
+    /// (ssd), and copied ("destaged") later, once stable and idle, into
+    /// the tier (hdd) directories with large sequential writes in chunk id
+    /// order.
+    string     mStorageTierStaging;
+    kfsSTier_t mStagingTiers[kKfsSTierCount];
+    kfsSTier_t mDestageTiers[kKfsSTierCount];
+    int        mDestageMinIdleSec;
+    int        mDestageMaxInFlight;
+    int        mDestageIoSize;
+    int        mDestageInFlight;
+    time_t     mNextDestageTime;
+    bool       mDestageShutdownFlag;
+
+    class ChunkDestager;
+    friend class ChunkDestager;
+    class ChunkReclaimer;
+    friend class ChunkReclaimer;
 
     PrngIsaac64       mRand;
     ChunkHeaderBuffer mChunkHeaderBuffer;
 
     inline void Delete(ChunkInfoHandle& cih);
     inline void Release(ChunkInfoHandle& cih);
+    inline void ChunkMetaCacheTrim();
+    bool ReadAheadLookup(ChunkInfoHandle& cih, ReadOp* op,
+        int64_t offset, size_t numBytes);
+    void ReadAheadStart(ChunkInfoHandle& cih, int64_t offset, size_t numBytes);
+    int64_t GetReadAheadSize(ChunkInfoHandle& cih, size_t numBytes) const;
+    void CountChunkRead(kfsChunkId_t chunkId);
+    struct HotChunkRateCompare
+    {
+        bool operator()(
+            const HotChunks::value_type& lhs,
+            const HotChunks::value_type& rhs) const
+            { return (rhs.second < lhs.second); }
+    };
+    void ReadAheadServe(ChunkReadAhead& ra, ReadOp* op,
+        int64_t offset, size_t numBytes);
+    void RunReadAheadDoneQueue();
 
     /// When a checkpoint file is read, update the mChunkTable[] to
     /// include a mapping for cih->chunkInfo.chunkId.
@@ -959,8 +1178,17 @@ private:
     /// Of the various directories this chunkserver is configured with, find the
     /// directory to store a chunk file.
     /// This method does a "directory allocation".
+    /// With staging flag set, the staging tier directories are used first,
+    /// if configured for the tier.
     ChunkDirInfo* GetDirForChunk(
-        bool objFlag, kfsSTier_t minTier, kfsSTier_t maxTier);
+        bool objFlag, kfsSTier_t minTier, kfsSTier_t maxTier,
+        bool stagingFlag = false);
+    void SetStagingTiers(const Properties& props);
+    bool IsStagingDir(const ChunkDirInfo& dir) const;
+    bool IsDestageCandidate(const ChunkInfoHandle& cih, time_t idleTime) const;
+    void StartDestage(time_t now);
+    int DestageSwitch(ChunkDirInfo& srcDir, ChunkDirInfo& dstDir,
+        kfsChunkId_t chunkId, kfsSeq_t chunkVersion);
 
     void CheckChunkDirs();
     void GetFsSpaceAvailable();
@@ -1013,6 +1241,10 @@ private:
     /// On a restart, nuke out all the dirty chunks
     void RemoveDirtyChunks();
 
+    /// On clean shutdown, store stable chunks list in each chunk directory to
+    /// avoid the chunk directory scan on restart.
+    void WriteChunkInventories();
+
     /// Scan the chunk dirs and rebuild the list of chunks that are hosted on
     /// this server
     void Restore();
@@ -1021,9 +1253,19 @@ private:
 
     /// Update the checksums in the chunk metadata based on the op.
     void UpdateChecksums(ChunkInfoHandle *cih, WriteOp *op);
+    void UpdateChecksums(ChunkInfoHandle *cih, int64_t offset,
+        int64_t numBytes, const vector<uint32_t>& checksums);
+    bool WriteCoalesce(ChunkInfoHandle& cih, WriteOp* op);
+    void RunWriteCoalesceQueue();
     bool IsChunkStable(const ChunkInfoHandle* cih) const;
     void RunStaleChunksQueue(bool completionFlag = false);
-    int OpenChunk(ChunkInfoHandle* cih, int openFlags);
+    int OpenChunk(ChunkInfoHandle* cih, int openFlags,
+        const char* preallocatedFileName = 0);
+    void UpdateChunkFilePool(ChunkDirInfo& dir);
+    string MakeChunkFilePoolPathname(const ChunkDirInfo& dir, int64_t seq);
+    bool ReclaimStaleChunk(ChunkInfoHandle* cih, KfsCallbackObj* cb);
+    void RunReclaimQueue(ChunkDirInfo& dir);
+    string MakeReclaimPathname(const ChunkDirInfo& dir, int64_t seq);
     void SendChunkDirInfo();
     void SetStorageTiers(const Properties& props);
     void SetStorageTiers(
@@ -1035,7 +1277,9 @@ private:
         ChunkManager::ChunkDirs& storageDirs);
     void SetBufferedIo(const Properties& props);
     void SetDirCheckerIoTimeout();
-    template<typename T> ChunkDirInfo* GetDirForChunkT(T start, T end);
+    template<typename T> ChunkDirInfo* GetDirForChunkT(T start, T end,
+        bool skipSlowDirsFlag = true);
+    void UpdateSlowDirs();
     template<typename T> void ClearTable(T& table);
     template<typename T> void RunIoCompletion(T& table);
 
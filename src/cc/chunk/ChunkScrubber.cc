@@ -0,0 +1,381 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \file ChunkScrubber.cc
+// \brief Chunk server background chunk scrubber implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "ChunkScrubber.h"
+#include "ChunkManager.h"
+#include "KfsOps.h"
+
+#include "common/MsgLogger.h"
+#include "common/Properties.h"
+#include "common/time.h"
+
+#include "kfsio/Globals.h"
+#include "kfsio/NetManager.h"
+
+#include "qcdio/QCUtils.h"
+#include "qcdio/qcdebug.h"
+
+#include <algorithm>
+#include <vector>
+#include <fstream>
+
+#include <errno.h>
+#include <stdio.h>
+
+namespace KFS
+{
+using std::vector;
+using std::upper_bound;
+using std::ifstream;
+using std::ofstream;
+using std::max;
+using libkfsio::globalNetManager;
+
+ChunkScrubber gChunkScrubber;
+
+// Scrubs one chunk at a time in the chunk id order, as the chunk directory
+// read rate limit permits.
+class ChunkScrubber::DirScrubber : public KfsCallbackObj
+{
+public:
+    typedef ChunkManager::ChunkIds ChunkIds;
+
+    DirScrubber(
+        ChunkScrubber& inOuter,
+        const string&  inDirName)
+        : KfsCallbackObj(),
+          mOuter(inOuter),
+          mDirName(inDirName),
+          mChunkIds(),
+          mPos(0),
+          mLastChunkId(-1),
+          mNextPassTime(0),
+          mNextStartUsec(0),
+          mStartUsec(0),
+          mNextProgressWriteTime(0),
+          mOpPtr(0),
+          mProgressDirtyFlag(false),
+          mDeleteFlag(false)
+    {
+        SET_HANDLER(this, &DirScrubber::HandleEvent);
+        LoadProgress();
+    }
+    virtual ~DirScrubber()
+        { QCRTASSERT(! mOpPtr); }
+    void SetChunkIds(
+        ChunkIds& inChunkIds)
+    {
+        mChunkIds.swap(inChunkIds);
+        mPos = 0 <= mLastChunkId ? (size_t)(upper_bound(
+            mChunkIds.begin(), mChunkIds.end(), mLastChunkId) -
+            mChunkIds.begin()) : size_t(0);
+    }
+    bool NeedsChunkIds(
+        time_t inNow) const
+    {
+        return (mChunkIds.size() <= mPos && ! mOpPtr &&
+            mNextPassTime <= inNow);
+    }
+    void Start(
+        time_t  inNow,
+        int64_t inNowUsec)
+    {
+        if (mOpPtr || mDeleteFlag) {
+            return;
+        }
+        if (mProgressDirtyFlag && mNextProgressWriteTime <= inNow) {
+            WriteProgress(inNow);
+        }
+        if (mChunkIds.size() <= mPos || inNowUsec < mNextStartUsec) {
+            return;
+        }
+        GetChunkMetadataOp& theOp = *(new GetChunkMetadataOp(0));
+        theOp.chunkId        = mChunkIds[mPos];
+        theOp.readVerifyFlag = true;
+        theOp.clnt           = this;
+        mOpPtr     = &theOp;
+        mStartUsec = inNowUsec;
+        SubmitOp(&theOp);
+    }
+    int HandleEvent(
+        int   inCode,
+        void* inDataPtr)
+    {
+        QCRTASSERT(inCode == EVENT_CMD_DONE && inDataPtr == mOpPtr && mOpPtr);
+        GetChunkMetadataOp& theOp = *mOpPtr;
+        mOpPtr = 0;
+        const int64_t theByteCount = max(int64_t(0), theOp.numBytesScrubbed);
+        if (theOp.status < 0 && theOp.status != -EBADF) {
+            // Checksum mismatches and io errors are reported to the meta
+            // server by the chunk manager. The chunk might have been deleted
+            // since the chunk list was created, ignore such errors.
+            mOuter.mCounters.mErrorCount++;
+            KFS_LOG_STREAM_ERROR <<
+                "scrub: " << mDirName <<
+                " chunk: "  << theOp.chunkId <<
+                " status: " << theOp.status <<
+                " "         << theOp.statusMsg <<
+            KFS_LOG_EOM;
+        }
+        mOuter.mCounters.mChunkCount++;
+        mOuter.mCounters.mByteCount += theByteCount;
+        mLastChunkId       = theOp.chunkId;
+        mProgressDirtyFlag = true;
+        delete &theOp;
+        if (mDeleteFlag) {
+            delete this;
+            return 0;
+        }
+        if (0 < mOuter.mMaxDirBytesPerSec) {
+            mNextStartUsec = mStartUsec +
+                theByteCount * 1000 * 1000 / mOuter.mMaxDirBytesPerSec;
+        }
+        const time_t theNow = globalNetManager().Now();
+        if (mChunkIds.size() <= ++mPos) {
+            mOuter.mCounters.mPassCount++;
+            KFS_LOG_STREAM_INFO <<
+                "scrub: " << mDirName <<
+                " pass complete chunks: " << mChunkIds.size() <<
+            KFS_LOG_EOM;
+            ChunkIds theIds;
+            mChunkIds.swap(theIds);
+            mPos          = 0;
+            mLastChunkId  = -1;
+            mNextPassTime = theNow + mOuter.mMinPassIntervalSec;
+            WriteProgress(theNow);
+        }
+        return 0;
+    }
+    void Delete()
+    {
+        mDeleteFlag = true;
+        if (! mOpPtr) {
+            delete this;
+        }
+    }
+    void WriteProgress(
+        time_t inNow)
+    {
+        mNextProgressWriteTime = inNow + mOuter.mProgressWriteIntervalSec;
+        if (mOuter.mProgressFileName.empty()) {
+            mProgressDirtyFlag = false;
+            return;
+        }
+        const string theTmpName = mDirName + mOuter.GetProgressTmpFileName();
+        const string theName    = mDirName + mOuter.mProgressFileName;
+        ofstream theStream(theTmpName.c_str(),
+            ofstream::out | ofstream::trunc);
+        if (theStream) {
+            theStream << mLastChunkId << " " << (int64_t)mNextPassTime << "\n";
+            theStream.close();
+        }
+        if (! theStream || rename(theTmpName.c_str(), theName.c_str()) != 0) {
+            const int theErr = errno;
+            mOuter.mCounters.mProgressWriteErrorCount++;
+            KFS_LOG_STREAM_ERROR <<
+                "scrub: " << theName << ": " <<
+                    QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            return;
+        }
+        mProgressDirtyFlag = false;
+    }
+    bool IsProgressDirty() const
+        { return mProgressDirtyFlag; }
+private:
+    ChunkScrubber&      mOuter;
+    string const        mDirName;
+    ChunkIds            mChunkIds;
+    size_t              mPos;
+    kfsChunkId_t        mLastChunkId;
+    time_t              mNextPassTime;
+    int64_t             mNextStartUsec;
+    int64_t             mStartUsec;
+    time_t              mNextProgressWriteTime;
+    GetChunkMetadataOp* mOpPtr;
+    bool                mProgressDirtyFlag;
+    bool                mDeleteFlag;
+
+    void LoadProgress()
+    {
+        if (mOuter.mProgressFileName.empty()) {
+            return;
+        }
+        const string theName = mDirName + mOuter.mProgressFileName;
+        ifstream     theStream(theName.c_str());
+        kfsChunkId_t theChunkId  = -1;
+        int64_t      theNextTime = 0;
+        if (theStream && (theStream >> theChunkId >> theNextTime)) {
+            mLastChunkId  = theChunkId;
+            mNextPassTime = (time_t)theNextTime;
+            KFS_LOG_STREAM_INFO <<
+                "scrub: " << mDirName <<
+                " resuming after chunk: " << mLastChunkId <<
+                " next pass: " << (int64_t)mNextPassTime <<
+            KFS_LOG_EOM;
+        }
+    }
+private:
+    DirScrubber(
+        const DirScrubber& inScrubber);
+    DirScrubber& operator=(
+        const DirScrubber& inScrubber);
+};
+
+ChunkScrubber::ChunkScrubber()
+    : ITimeout(),
+      mDirs(),
+      mMaxDirBytesPerSec(0),
+      mMinPassIntervalSec(24 * 60 * 60),
+      mProgressWriteIntervalSec(5 * 60),
+      mDirRescanIntervalSec(5 * 60),
+      mProgressFileName("scrubprogress"),
+      mNextDirRescanTime(0),
+      mRegisteredFlag(false),
+      mShutdownFlag(false),
+      mCounters()
+{
+    mCounters.Clear();
+    SetTimeoutInterval(100);
+}
+
+ChunkScrubber::~ChunkScrubber()
+{
+    ChunkScrubber::Shutdown();
+}
+
+    string
+ChunkScrubber::GetProgressTmpFileName() const
+{
+    return (mProgressFileName.empty() ? string() : mProgressFileName + ".tmp");
+}
+
+    void
+ChunkScrubber::SetParameters(
+    const Properties& inProps)
+{
+    mMaxDirBytesPerSec = inProps.getValue(
+        "chunkServer.scrubber.maxDirBytesPerSec", mMaxDirBytesPerSec);
+    mMinPassIntervalSec = inProps.getValue(
+        "chunkServer.scrubber.minPassIntervalSec", mMinPassIntervalSec);
+    mProgressWriteIntervalSec = inProps.getValue(
+        "chunkServer.scrubber.progressWriteIntervalSec",
+        mProgressWriteIntervalSec);
+    mDirRescanIntervalSec = inProps.getValue(
+        "chunkServer.scrubber.dirRescanIntervalSec", mDirRescanIntervalSec);
+    // Allow to change the progress file name only before scrub starts, as the
+    // chunk directory checker ignores the current name.
+    if (mDirs.empty()) {
+        mProgressFileName = inProps.getValue(
+            "chunkServer.scrubber.progressFileName", mProgressFileName);
+        if (mProgressFileName.find('/') != string::npos) {
+            KFS_LOG_STREAM_ERROR <<
+                "invalid scrubber progress file name: " << mProgressFileName <<
+                " progress will not be saved" <<
+            KFS_LOG_EOM;
+            mProgressFileName.clear();
+        }
+    }
+    const bool theEnableFlag = 0 < mMaxDirBytesPerSec && ! mShutdownFlag;
+    if (theEnableFlag != mRegisteredFlag) {
+        mRegisteredFlag = theEnableFlag;
+        if (mRegisteredFlag) {
+            mNextDirRescanTime = 0;
+            globalNetManager().RegisterTimeoutHandler(this);
+        } else {
+            globalNetManager().UnRegisterTimeoutHandler(this);
+        }
+    }
+}
+
+    void
+ChunkScrubber::Shutdown()
+{
+    if (mRegisteredFlag) {
+        mRegisteredFlag = false;
+        globalNetManager().UnRegisterTimeoutHandler(this);
+    }
+    mShutdownFlag = true;
+    if (mDirs.empty()) {
+        return;
+    }
+    const time_t theNow = globalNetManager().Now();
+    for (Dirs::iterator theIt = mDirs.begin(); theIt != mDirs.end(); ++theIt) {
+        if (theIt->second->IsProgressDirty()) {
+            theIt->second->WriteProgress(theNow);
+        }
+        theIt->second->Delete();
+    }
+    mDirs.clear();
+}
+
+    void
+ChunkScrubber::RescanDirs(
+    time_t inNow)
+{
+    mNextDirRescanTime = inNow + max(1, mDirRescanIntervalSec);
+    ChunkManager::DirChunkIds theDirChunkIds;
+    gChunkManager.GetStableChunkIds(theDirChunkIds);
+    for (Dirs::iterator theIt = mDirs.begin(); theIt != mDirs.end(); ) {
+        if (theDirChunkIds.find(theIt->first) == theDirChunkIds.end()) {
+            // The directory is no longer available.
+            KFS_LOG_STREAM_INFO <<
+                "scrub: " << theIt->first << " stopped" <<
+            KFS_LOG_EOM;
+            theIt->second->Delete();
+            mDirs.erase(theIt++);
+        } else {
+            ++theIt;
+        }
+    }
+    for (ChunkManager::DirChunkIds::iterator theIt = theDirChunkIds.begin();
+            theIt != theDirChunkIds.end();
+            ++theIt) {
+        Dirs::iterator theDirIt = mDirs.find(theIt->first);
+        if (theDirIt == mDirs.end()) {
+            theDirIt = mDirs.insert(make_pair(theIt->first,
+                new DirScrubber(*this, theIt->first))).first;
+        }
+        if (theDirIt->second->NeedsChunkIds(inNow)) {
+            theDirIt->second->SetChunkIds(theIt->second);
+        }
+    }
+}
+
+    /* virtual */ void
+ChunkScrubber::Timeout()
+{
+    const time_t theNow = globalNetManager().Now();
+    if (mNextDirRescanTime <= theNow) {
+        RescanDirs(theNow);
+    }
+    const int64_t theNowUsec = microseconds();
+    for (Dirs::iterator theIt = mDirs.begin(); theIt != mDirs.end(); ++theIt) {
+        theIt->second->Start(theNow, theNowUsec);
+    }
+}
+
+}
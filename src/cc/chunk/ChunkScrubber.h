@@ -0,0 +1,115 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \file ChunkScrubber.h
+// \brief Chunk server background chunk scrubber. Periodically reads and
+// verifies checksums of all stable chunks, one chunk at a time per chunk
+// directory, with the configured per chunk directory read rate limit, using
+// the lowest disk queue priority class. Checksum mismatches and read errors
+// are reported to the meta server through the normal chunk read path, i.e.
+// ChunkManager::ChunkIOFailed(). The scan progress is persisted in each chunk
+// directory, in order to resume the scan on restart.
+//
+//----------------------------------------------------------------------------
+
+#ifndef CHUNKSERVER_CHUNKSCRUBBER_H
+#define CHUNKSERVER_CHUNKSCRUBBER_H
+
+#include "kfsio/ITimeout.h"
+
+#include <string>
+#include <map>
+
+#include <inttypes.h>
+#include <time.h>
+
+namespace KFS
+{
+using std::string;
+using std::map;
+
+class Properties;
+
+class ChunkScrubber : public ITimeout
+{
+public:
+    struct Counters
+    {
+        typedef int64_t Counter;
+
+        Counter mChunkCount;
+        Counter mByteCount;
+        Counter mErrorCount;
+        Counter mPassCount;
+        Counter mProgressWriteErrorCount;
+
+        void Clear()
+        {
+            mChunkCount              = 0;
+            mByteCount               = 0;
+            mErrorCount              = 0;
+            mPassCount               = 0;
+            mProgressWriteErrorCount = 0;
+        }
+    };
+
+    ChunkScrubber();
+    virtual ~ChunkScrubber();
+    void SetParameters(
+        const Properties& inProps);
+    void Shutdown();
+    virtual void Timeout();
+    void GetCounters(
+        Counters& outCounters) const
+        { outCounters = mCounters; }
+    const string& GetProgressFileName() const
+        { return mProgressFileName; }
+    string GetProgressTmpFileName() const;
+private:
+    class DirScrubber;
+    friend class DirScrubber;
+    typedef map<string, DirScrubber*> Dirs;
+
+    Dirs     mDirs;
+    int64_t  mMaxDirBytesPerSec;
+    int      mMinPassIntervalSec;
+    int      mProgressWriteIntervalSec;
+    int      mDirRescanIntervalSec;
+    string   mProgressFileName;
+    time_t   mNextDirRescanTime;
+    bool     mRegisteredFlag;
+    bool     mShutdownFlag;
+    Counters mCounters;
+
+    void RescanDirs(
+        time_t inNow);
+private:
+    ChunkScrubber(
+        const ChunkScrubber& inScrubber);
+    ChunkScrubber& operator=(
+        const ChunkScrubber& inScrubber);
+};
+
+extern ChunkScrubber gChunkScrubber;
+
+}
+
+#endif /* CHUNKSERVER_CHUNKSCRUBBER_H */
@@ -31,16 +31,139 @@
 #include "ChunkManager.h"
 #include "MetaServerSM.h"
 #include "Logger.h"
+#include "KfsOps.h"
 #include "utils.h"
 
 #include "common/MsgLogger.h"
+#include "common/Properties.h"
 #include "kfsio/Globals.h"
+#include "kfsio/ITimeout.h"
+#include "kfsio/MetricsServer.h"
 #include "qcdio/qcstutils.h"
+#include "qcdio/QCUtils.h"
+
+#include <sstream>
+#include <algorithm>
 
 namespace KFS {
 
 using std::string;
+using std::ostringstream;
+using std::max;
 using libkfsio::globalNetManager;
+using libkfsio::globals;
+
+// OpenMetrics scrape endpoint. The snapshot is built from the heartbeat
+// counters and the global counters on the main thread, and served by the
+// metrics server thread.
+class ChunkServer::Metrics : public ITimeout
+{
+public:
+    Metrics()
+        : ITimeout(),
+          mServer(),
+          mBuilder(),
+          mOs(),
+          mText(),
+          mLocation(),
+          mIpV6OnlyFlag(false),
+          mMaxConnections(16),
+          mIoTimeoutSec(60),
+          mUpdateIntervalSec(10)
+    {
+        SetTimeoutInterval(mUpdateIntervalSec * 1000);
+        globalNetManager().RegisterTimeoutHandler(this);
+    }
+    virtual ~Metrics()
+    {
+        globalNetManager().UnRegisterTimeoutHandler(this);
+        mServer.Stop();
+    }
+    void SetParameters(
+        const Properties& props)
+    {
+        ServerLocation location(
+            props.getValue("chunkServer.metrics.host", mLocation.hostname),
+            props.getValue("chunkServer.metrics.port", mLocation.port)
+        );
+        const bool ipV6OnlyFlag = props.getValue(
+            "chunkServer.metrics.ipV6Only", mIpV6OnlyFlag ? 1 : 0) != 0;
+        const int  maxConnections = props.getValue(
+            "chunkServer.metrics.maxConnections", mMaxConnections);
+        const int  ioTimeoutSec = props.getValue(
+            "chunkServer.metrics.ioTimeoutSec", mIoTimeoutSec);
+        mUpdateIntervalSec = max(1, props.getValue(
+            "chunkServer.metrics.updateIntervalSec", mUpdateIntervalSec));
+        SetTimeoutInterval(mUpdateIntervalSec * 1000);
+        if (mServer.IsRunning() &&
+                location == mLocation &&
+                ipV6OnlyFlag == mIpV6OnlyFlag &&
+                maxConnections == mMaxConnections &&
+                ioTimeoutSec == mIoTimeoutSec) {
+            return;
+        }
+        mServer.Stop();
+        mLocation       = location;
+        mIpV6OnlyFlag   = ipV6OnlyFlag;
+        mMaxConnections = maxConnections;
+        mIoTimeoutSec   = ioTimeoutSec;
+        if (mLocation.port < 0) {
+            return;
+        }
+        const int err = mServer.Start(
+            mLocation, mIpV6OnlyFlag, mMaxConnections, mIoTimeoutSec);
+        if (err != 0) {
+            KFS_LOG_STREAM_ERROR <<
+                "failed to start metrics server on: " << mLocation <<
+                " " << QCUtils::SysError(-err) <<
+            KFS_LOG_EOM;
+            return;
+        }
+        Timeout();
+    }
+    bool IsEnabled() const
+        { return (0 <= mLocation.port); }
+    virtual void Timeout()
+    {
+        if (! mServer.IsRunning()) {
+            return;
+        }
+        ostream* os[2];
+        os[0] = &mOs;
+        os[1] = 0;
+        HeartbeatOp::AppendCounters(os);
+        mOs.flush();
+        const string& str = mOs.str();
+        const char* const kPrefix = "qfs_chunk_";
+        const char* const kLabels = "";
+        mBuilder.Clear();
+        mBuilder.AddKeyValues(kPrefix, kLabels, str.data(), str.size());
+        mOs.str(string());
+        mBuilder.AddCounters(kPrefix, kLabels, globals().counterManager);
+        MetricsServer::Counters cntrs;
+        mServer.GetCounters(cntrs);
+        mBuilder.Add(kPrefix, "metrics_requests", kLabels,
+            cntrs.mRequestCount, MetricsBuilder::kTypeCounter);
+        mBuilder.Add(kPrefix, "metrics_rejected_connections", kLabels,
+            cntrs.mRejectCount, MetricsBuilder::kTypeCounter);
+        mText.clear();
+        mBuilder.Write(mText);
+        mServer.SetSnapshot(mText);
+    }
+private:
+    MetricsServer  mServer;
+    MetricsBuilder mBuilder;
+    ostringstream  mOs;
+    string         mText;
+    ServerLocation mLocation;
+    bool           mIpV6OnlyFlag;
+    int            mMaxConnections;
+    int            mIoTimeoutSec;
+    int            mUpdateIntervalSec;
+private:
+    Metrics(const Metrics&);
+    Metrics& operator=(const Metrics&);
+};
 
 
 ChunkServer gChunkServer;
@@ -178,9 +301,27 @@ ChunkServer::MainLoop(
     mRemoteSyncers.ReleaseAllServers();
     gChunkManager.Shutdown();
     RemoteSyncSM::Shutdown();
+    delete mMetricsPtr;
+    mMetricsPtr = 0;
     return true;
 }
 
+void
+ChunkServer::SetParameters(const Properties& props)
+{
+    if (! mMetricsPtr) {
+        if (props.getValue("chunkServer.metrics.port", -1) < 0) {
+            return;
+        }
+        mMetricsPtr = new Metrics();
+    }
+    mMetricsPtr->SetParameters(props);
+    if (! mMetricsPtr->IsEnabled()) {
+        delete mMetricsPtr;
+        mMetricsPtr = 0;
+    }
+}
+
 void
 StopNetProcessor(int /* status */)
 {
@@ -200,6 +341,8 @@ ChunkServer::FindServer(
     int&                  err,
     string&               errMsg)
 {
+    // Replication reads can use multiple connections to the same peer.
+    const bool kMultipleConnectionsFlag = true;
     return RemoteSyncSM::FindServer(
         mRemoteSyncers,
         location,
@@ -211,7 +354,8 @@ ChunkServer::FindServer(
         writeMasterFlag,
         shutdownSslFlag,
         err,
-        errMsg
+        errMsg,
+        kMultipleConnectionsFlag
     );
 }
 
@@ -38,6 +38,8 @@ class QCMutex;
 
 namespace KFS
 {
+class Properties;
+
 using std::string;
 using std::vector;
 using std::list;
@@ -51,7 +53,8 @@ public:
         mUpdateServerIpFlag(false),
         mLocation(),
         mRemoteSyncers(),
-        mMutex(0)
+        mMutex(0),
+        mMetricsPtr(0)
         {}
 
     bool Init(
@@ -101,13 +104,17 @@ public:
         return mUpdateServerIpFlag;
     }
     inline void SetLocation(const ServerLocation& loc);
+    void SetParameters(const Properties& props);
 private:
+    class Metrics;
+
     // # of ops in the system
     int              mOpCount;
     bool             mUpdateServerIpFlag;
     ServerLocation   mLocation;
     RemoteSyncSMList mRemoteSyncers;
     QCMutex*         mMutex;
+    Metrics*         mMetricsPtr;
 private:
     // No copy.
     ChunkServer(const ChunkServer&);
@@ -30,6 +30,7 @@
 
 #include "common/Properties.h"
 #include "common/MsgLogger.h"
+#include "common/time.h"
 
 #include "kfsio/SslFilter.h"
 #include "kfsio/DelegationToken.h"
@@ -187,7 +188,13 @@ ClientManager::ClientManager()
       mCurThreadIdx(0),
       mFirstClientThreadIndex(0),
       mThreadCount(0),
-      mThreadsPtr(0)
+      mThreadsPtr(0),
+      mThreadLoadBalanceFlag(false),
+      mThreadLoadSampleIntervalMs(1000),
+      mThreadLoadSampleTime(0),
+      mClientEventRate(0),
+      mThreadLoadPtr(0),
+      mOpPhaseStats()
 {
     mCounters.Clear();
 }
@@ -197,6 +204,7 @@ ClientManager::~ClientManager()
     delete mAcceptorPtr;
     delete &mAuth;
     delete [] mThreadsPtr;
+    delete [] mThreadLoadPtr;
     KfsOp::SetMutex(0);
 }
 
@@ -211,9 +219,11 @@ ClientManager::BindAcceptor(
     Stop();
     delete mAcceptorPtr;
     delete [] mThreadsPtr;
-    mAcceptorPtr = 0;
-    mThreadsPtr  = 0;
-    mThreadCount = 0;
+    delete [] mThreadLoadPtr;
+    mAcceptorPtr   = 0;
+    mThreadsPtr    = 0;
+    mThreadLoadPtr = 0;
+    mThreadCount   = 0;
     const bool kBindOnlyFlag = true;
     mAcceptorPtr = new Acceptor(
         globalNetManager(), clientListener, ipV6OnlyFlag, this, kBindOnlyFlag);
@@ -224,6 +234,9 @@ ClientManager::BindAcceptor(
         mThreadsPtr  = ClientThread::CreateThreads(
             inThreadCount, inFirstCpuIdx, outMutexPtr);
         mThreadCount = mThreadsPtr ? inThreadCount : 0;
+        if (0 < mThreadCount) {
+            mThreadLoadPtr = new ThreadLoad[mThreadCount];
+        }
     } else {
         outMutexPtr = 0;
     }
@@ -298,6 +311,12 @@ ClientManager::SetParameters(
     mFirstClientThreadIndex =
         inProps.getValue(theParamName.Truncate(thePrefLen).Append(
         "firstClientThreadIndex"), mFirstClientThreadIndex);
+    mThreadLoadBalanceFlag  =
+        inProps.getValue(theParamName.Truncate(thePrefLen).Append(
+        "threadLoadBalance"), mThreadLoadBalanceFlag ? 1 : 0) != 0;
+    mThreadLoadSampleIntervalMs =
+        inProps.getValue(theParamName.Truncate(thePrefLen).Append(
+        "threadLoadSampleIntervalMs"), mThreadLoadSampleIntervalMs);
     mMaxClientCount = inMaxClientCount;
     return mAuth.SetParameters(
         theParamName.Truncate(thePrefLen).Append("auth.").GetPtr(),
@@ -351,14 +370,91 @@ ClientManager::GetNextClientThreadPtr()
         return 0;
     }
     QCASSERT(0 <= mCurThreadIdx && mCurThreadIdx < mThreadCount);
+    const int theFirstIdx = max(mFirstClientThreadIndex, 0);
+    if (mCurThreadIdx < theFirstIdx) {
+        mCurThreadIdx = theFirstIdx;
+    }
+    if (mThreadLoadBalanceFlag && mThreadLoadPtr &&
+            theFirstIdx + 1 < mThreadCount) {
+        return GetLeastLoadedClientThreadPtr(theFirstIdx);
+    }
     ClientThread* const theRetPtr = mThreadsPtr + mCurThreadIdx;
     mCurThreadIdx++;
     if (mThreadCount <= mCurThreadIdx) {
-        mCurThreadIdx = max(mFirstClientThreadIndex, 0);
+        mCurThreadIdx = theFirstIdx;
     }
     return theRetPtr;
 }
 
+    void
+ClientManager::UpdateThreadLoad(
+    int inFirstIdx)
+{
+    // Estimate each thread's load as the rate of the client connection events
+    // dispatched by the thread over the last sample interval.
+    const int64_t theNow     = microseconds();
+    const int64_t theElapsed = theNow - mThreadLoadSampleTime;
+    if (theElapsed < int64_t(max(1, mThreadLoadSampleIntervalMs)) * 1000 &&
+            0 < mThreadLoadSampleTime) {
+        return;
+    }
+    const bool theFirstSampleFlag = mThreadLoadSampleTime <= 0;
+    mThreadLoadSampleTime = theNow;
+    double theTotalRate    = 0;
+    int    theClientCount  = 0;
+    for (int i = inFirstIdx; i < mThreadCount; i++) {
+        ThreadLoad&   theLoad  = mThreadLoadPtr[i];
+        const int64_t theCount = mThreadsPtr[i].GetEventCount();
+        theLoad.mRate = theFirstSampleFlag ? 0. :
+            double(theCount - theLoad.mPrevEventCount) * 1e6 /
+                double(max(int64_t(1), theElapsed));
+        theLoad.mPrevEventCount = theCount;
+        theLoad.mAssignedCount  = 0;
+        theTotalRate   += theLoad.mRate;
+        theClientCount += mThreadsPtr[i].GetClientCount();
+    }
+    mClientEventRate = 0 < theClientCount ?
+        theTotalRate / theClientCount : 0.;
+}
+
+    ClientThread*
+ClientManager::GetLeastLoadedClientThreadPtr(
+    int inFirstIdx)
+{
+    UpdateThreadLoad(inFirstIdx);
+    // Connections assigned since the last sample are accounted using the
+    // average per connection event rate, in order to spread connection
+    // bursts. Ties are broken by the connection count, and then by the round
+    // robin order.
+    const double theClientRate = max(1., mClientEventRate);
+    int          theBestIdx    = -1;
+    double       theBestLoad   = 0;
+    int          theBestCount  = 0;
+    int          theIdx        = mCurThreadIdx;
+    for (int i = inFirstIdx; i < mThreadCount; i++) {
+        const ThreadLoad& theLoad  = mThreadLoadPtr[theIdx];
+        const double      theRate  =
+            theLoad.mRate + theLoad.mAssignedCount * theClientRate;
+        const int         theCount = mThreadsPtr[theIdx].GetClientCount();
+        if (theBestIdx < 0 || theRate < theBestLoad ||
+                (theRate == theBestLoad && theCount < theBestCount)) {
+            theBestIdx   = theIdx;
+            theBestLoad  = theRate;
+            theBestCount = theCount;
+        }
+        if (mThreadCount <= ++theIdx) {
+            theIdx = inFirstIdx;
+        }
+    }
+    QCASSERT(inFirstIdx <= theBestIdx && theBestIdx < mThreadCount);
+    mThreadLoadPtr[theBestIdx].mAssignedCount++;
+    mCurThreadIdx = theBestIdx + 1;
+    if (mThreadCount <= mCurThreadIdx) {
+        mCurThreadIdx = inFirstIdx;
+    }
+    return (mThreadsPtr + theBestIdx);
+}
+
     ClientThread*
 ClientManager::GetClientThread(
     int inIdx)
@@ -366,4 +462,38 @@ ClientManager::GetClientThread(
     return ((inIdx < 0 || mThreadCount <= inIdx) ? 0 : mThreadsPtr + inIdx);
 }
 
+    void
+ClientManager::GetClientThreadsEventStats(
+    NetManager::EventStats& outStats)
+{
+    // Client threads update the stats without synchronization, the values are
+    // approximate.
+    outStats.Clear();
+    for (int i = 0; i < mThreadCount; i++) {
+        NetManager::EventStats theStats;
+        mThreadsPtr[i].GetNetManager().GetEventStats(theStats);
+        outStats.Add(theStats);
+    }
+}
+
+    void
+ClientManager::UpdateOpPhaseStats(
+    ClientThread* inThreadPtr,
+    const KfsOp&  inOp)
+{
+    (inThreadPtr ? inThreadPtr->GetOpPhaseStats() : mOpPhaseStats).Update(
+        inOp, microseconds());
+}
+
+    void
+ClientManager::GetOpPhaseStats(
+    KfsOpPhaseStats& outStats)
+{
+    // Similarly to the event stats the values are approximate.
+    outStats = mOpPhaseStats;
+    for (int i = 0; i < mThreadCount; i++) {
+        outStats.Add(mThreadsPtr[i].GetOpPhaseStats());
+    }
+}
+
 }
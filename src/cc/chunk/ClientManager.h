@@ -30,6 +30,7 @@
 #include <cassert>
 #include <inttypes.h>
 #include "kfsio/Acceptor.h"
+#include "kfsio/NetManager.h"
 #include "KfsOps.h"
 
 class QCMutex;
@@ -210,6 +211,13 @@ public:
     ClientThread* GetNextClientThreadPtr();
     ClientThread* GetClientThread(
         int inIdx);
+    void GetClientThreadsEventStats(
+        NetManager::EventStats& outStats);
+    void UpdateOpPhaseStats(
+        ClientThread* inThreadPtr,
+        const KfsOp&  inOp);
+    void GetOpPhaseStats(
+        KfsOpPhaseStats& outStats);
     bool IsAuthEnabled() const;
     bool SetParameters(
         const char*       inParamsPrefixPtr,
@@ -221,6 +229,17 @@ public:
         { return mMaxClientCount; }
 private:
     class Auth;
+    struct ThreadLoad
+    {
+        ThreadLoad()
+            : mPrevEventCount(0),
+              mRate(0),
+              mAssignedCount(0)
+            {}
+        int64_t mPrevEventCount;
+        double  mRate;
+        int     mAssignedCount;
+    };
 
     Acceptor*     mAcceptorPtr;
     int           mIoTimeoutSec;
@@ -232,6 +251,18 @@ private:
     int           mFirstClientThreadIndex;
     int           mThreadCount;
     ClientThread* mThreadsPtr;
+    bool          mThreadLoadBalanceFlag;
+    int           mThreadLoadSampleIntervalMs;
+    int64_t       mThreadLoadSampleTime;
+    double        mClientEventRate;
+    ThreadLoad*   mThreadLoadPtr;
+    // Op phase stats of the requests not handled by the client threads.
+    KfsOpPhaseStats mOpPhaseStats;
+
+    void UpdateThreadLoad(
+        int inFirstIdx);
+    ClientThread* GetLeastLoadedClientThreadPtr(
+        int inFirstIdx);
 
 private:
     // No copy.
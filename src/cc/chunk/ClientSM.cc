@@ -74,6 +74,8 @@ bool     ClientSM::sTraceRequestResponseFlag = false;
 bool     ClientSM::sEnforceMaxWaitFlag       = true;
 int      ClientSM::sMaxReqSizeDiscard        = 256 << 10;
 size_t   ClientSM::sMaxAppendRequestSize     = CHUNKSIZE;
+int      ClientSM::sSendFileMinSize          = -1;
+int      ClientSM::sMaxPendingOps            = 0;
 uint64_t ClientSM::sInstanceNum              = 10000;
 
 inline time_t
@@ -94,6 +96,29 @@ ClientSM::GetBufferManager()
     return DiskIo::GetBufferManager();
 }
 
+inline static BufferManager::RequestClass
+GetBufferRequestClass(const KfsOp& op)
+{
+    switch (op.op) {
+        case CMD_READ:
+            // Replicator and recovery reader set the replication flag. The
+            // client reads skip disk checksum verification too, therefore the
+            // checksum flag can not be used here.
+            return (static_cast<const ReadOp&>(op).replicationReadFlag ?
+                BufferManager::kRequestClassReplication :
+                BufferManager::kRequestClassRead);
+        case CMD_WRITE_PREPARE:
+        case CMD_WRITE_SYNC:
+        case CMD_WRITE:
+            return BufferManager::kRequestClassWrite;
+        case CMD_RECORD_APPEND:
+            return BufferManager::kRequestClassAppend;
+        default:
+            break;
+    }
+    return BufferManager::kRequestClassOther;
+}
+
 inline /* static */ BufferManager*
 ClientSM::FindDevBufferManager(KfsOp& op)
 {
@@ -177,6 +202,12 @@ ClientSM::SetParameters(const Properties& prop)
     sMaxCmdHeaderReadAhead = prop.getValue(
         "chunkServer.clientSM.maxCmdHeaderReadAhead",
         sMaxCmdHeaderReadAhead);
+    sSendFileMinSize = prop.getValue(
+        "chunkServer.clientSM.sendFileMinSize",
+        sSendFileMinSize);
+    sMaxPendingOps = prop.getValue(
+        "chunkServer.clientSM.maxPendingOps",
+        sMaxPendingOps);
 }
 
 ClientSM::ClientSM(
@@ -208,7 +239,9 @@ ClientSM::ClientSM(
       mContentReceivedFlag(false),
       mDelegationToken(),
       mSessionKey(),
-      mHandleTerminateFlag(false)
+      mHandleTerminateFlag(false),
+      mBufferWaitStart(0),
+      mPendingOpsLimitFlag(false)
 {
     if (! mNetConnection) {
         die("ClientSM: null connection");
@@ -289,8 +322,20 @@ ClientSM::SendResponseSelf(KfsOp& op)
     IOBuffer* iobuf = 0;
     int       len   = 0;
     op.ResponseContent(iobuf, len);
-    mNetConnection->Write(iobuf, len);
+    ReadOp* const rop = (0 < len && op.op == CMD_READ) ?
+        static_cast<ReadOp*>(&op) : 0;
+    if (rop && 0 <= rop->sendFileFd && mNetConnection->WriteFile(
+            rop->sendFileFd, rop->sendFileOffset, len)) {
+        // The connection owns the file descriptor now, and the data buffers
+        // are no longer needed. The buffer manager accounting stays the same,
+        // as the file range is included into the bytes to write.
+        rop->sendFileFd = -1;
+        iobuf->Clear();
+    } else {
+        mNetConnection->Write(iobuf, len);
+    }
     gClientManager.RequestDone(timespent, op);
+    gClientManager.UpdateOpPhaseStats(GetClientThreadPtr(), op);
 }
 
 ///
@@ -339,7 +384,8 @@ ClientSM::HandleRequest(int code, void* data)
         bool      gotCmd = false;
         IOBuffer& iobuf  = mNetConnection->GetInBuffer();
         assert(&iobuf == data);
-        while ((mCurOp || GetReceivedOp() || IsMsgAvail(&iobuf, &cmdLen)) &&
+        while ((mCurOp || GetReceivedOp() || (! IsPendingOpsLimit() &&
+                    IsMsgAvail(&iobuf, &cmdLen))) &&
                 (gotCmd = HandleClientCmd(iobuf, cmdLen))) {
             cmdLen = 0;
             gotCmd = false;
@@ -355,7 +401,8 @@ ClientSM::HandleRequest(int code, void* data)
                     KFS_LOG_EOM;
                     gClientManager.BadRequest();
                 }
-            } else if ((hdrsz = iobuf.BytesConsumable()) > MAX_RPC_HEADER_LEN) {
+            } else if (! mPendingOpsLimitFlag &&
+                    (hdrsz = iobuf.BytesConsumable()) > MAX_RPC_HEADER_LEN) {
                 CLIENT_SM_LOG_STREAM_ERROR <<
                     " exceeded max request header size: " << hdrsz <<
                     " limit: " << MAX_RPC_HEADER_LEN <<
@@ -386,6 +433,9 @@ ClientSM::HandleRequest(int code, void* data)
         KfsOp* op = reinterpret_cast<KfsOp*>(data);
         gChunkServer.OpFinished();
         op->done = true;
+        if (op->doneTime <= 0) {
+            op->doneTime = microseconds();
+        }
         if (sTraceRequestResponseFlag) {
             IOBuffer::OStream os;
             op->Response(os);
@@ -506,6 +556,13 @@ ClientSM::HandleRequest(int code, void* data)
         if (! IsClientThread()) {
             mNetConnection->StartFlush();
         }
+        if (mPendingOpsLimitFlag && mNetConnection->IsGood() &&
+                ! IsWaiting() && ! mDevBufMgr && ! IsPendingOpsLimit() &&
+                ! mNetConnection->GetInBuffer().IsEmpty()) {
+            // Pending ops limit is no longer reached, process the requests
+            // that are already in the input buffer.
+            HandleRequest(EVENT_NET_READ, &(mNetConnection->GetInBuffer()));
+        }
         if (mNetConnection->IsGood()) {
             // Enforce 5 min timeout if connection has pending read and write.
             mNetConnection->SetInactivityTimeout(
@@ -513,7 +570,7 @@ ClientSM::HandleRequest(int code, void* data)
                     mNetConnection->IsWriteReady()) ?
                 gClientManager.GetIoTimeoutSec() :
                 gClientManager.GetIdleTimeoutSec());
-            if (IsWaiting() || mDevBufMgr) {
+            if (IsWaiting() || mDevBufMgr || IsPendingOpsLimit()) {
                 mNetConnection->SetMaxReadAhead(0);
                 ReceiveClear();
             } else if (! mCurOp || ! mNetConnection->IsReadReady()) {
@@ -700,10 +757,13 @@ ClientSM::GetWriteOp(KfsOp& op, int align, int numBytes,
         }
         mDiscardByteCnt = 0;
         mCurOp          = &op;
-        if (mDevBufMgr && mDevBufMgr->GetForDiskIo(*mgrCli, bufferBytes)) {
+        const BufferManager::RequestClass reqClass = GetBufferRequestClass(op);
+        if (mDevBufMgr &&
+                mDevBufMgr->GetForDiskIo(*mgrCli, bufferBytes, reqClass)) {
             mDevBufMgr = 0;
         }
-        if (mDevBufMgr || ! bufMgr.GetForDiskIo(*this, bufferBytes)) {
+        if (mDevBufMgr ||
+                ! bufMgr.GetForDiskIo(*this, bufferBytes, reqClass)) {
             const BufferManager& mgr      = mDevBufMgr ? *mDevBufMgr : bufMgr;
             const bool           failFlag =
                 numBytes <= sMaxReqSizeDiscard + nAvail &&
@@ -722,6 +782,7 @@ ClientSM::GetWriteOp(KfsOp& op, int align, int numBytes,
             if (failFlag) {
                 mDiscardByteCnt = numBytes;
             } else {
+                BufferWaitStart();
                 return false;
             }
         }
@@ -871,7 +932,9 @@ ClientSM::HandleClientCmd(IOBuffer& iobuf, int inCmdLen)
             } else if (iobuf.BytesConsumable() < contentLength) {
                 const ByteCount bufferBytes = contentLength;
                 BufferManager&  bufMgr      = GetBufferManager();
-                if (! bufMgr.Get(*this, bufferBytes)) {
+                const bool kForDiskIoFlag = false;
+                if (! bufMgr.Get(*this, bufferBytes, kForDiskIoFlag,
+                        GetBufferRequestClass(*op))) {
                     const bool exceedsWaitFlag = FailIfExceedsWait(bufMgr, 0);
                     CLIENT_SM_LOG_STREAM_DEBUG <<
                         "request for: " << bufferBytes << " bytes denied" <<
@@ -884,6 +947,7 @@ ClientSM::HandleClientCmd(IOBuffer& iobuf, int inCmdLen)
                             "exceeds max wait" : " waiting for buffers") <<
                     KFS_LOG_EOM;
                     if (! exceedsWaitFlag) {
+                        BufferWaitStart();
                         return false;
                     }
                 }
@@ -984,11 +1048,14 @@ ClientSM::HandleClientCmd(IOBuffer& iobuf, int inCmdLen)
                 op->statusMsg      = "exceeds max request size";
                 submitResponseFlag = true;
             } else {
-                if (mDevBufMgr &&
-                        mDevBufMgr->GetForDiskIo(*mgrCli, bufferBytes)) {
+                const BufferManager::RequestClass reqClass =
+                    GetBufferRequestClass(*op);
+                if (mDevBufMgr && mDevBufMgr->GetForDiskIo(
+                        *mgrCli, bufferBytes, reqClass)) {
                     mDevBufMgr = 0;
                 }
-                if (mDevBufMgr || ! bufMgr.GetForDiskIo(*this, bufferBytes)) {
+                if (mDevBufMgr ||
+                        ! bufMgr.GetForDiskIo(*this, bufferBytes, reqClass)) {
                     mCurOp = op;
                     const BufferManager& mgr =
                         mDevBufMgr ? *mDevBufMgr : bufMgr;
@@ -1006,6 +1073,7 @@ ClientSM::HandleClientCmd(IOBuffer& iobuf, int inCmdLen)
                         " op: "    << op->Show() <<
                     KFS_LOG_EOM;
                     if (! submitResponseFlag) {
+                        BufferWaitStart();
                         return false;
                     }
                     bufferBytes = 0; // Buffer accounting is already done.
@@ -1013,6 +1081,11 @@ ClientSM::HandleClientCmd(IOBuffer& iobuf, int inCmdLen)
             }
         }
         mCurOp = 0;
+        if (! submitResponseFlag && op->op == CMD_READ &&
+                0 <= sSendFileMinSize && sSendFileMinSize <= reqBytes &&
+                mNetConnection->CanWriteFile()) {
+            static_cast<ReadOp*>(op)->sendFileFlag = true;
+        }
     }
 
     if (bufferBytes < 0 && ! submitResponseFlag) {
@@ -1059,6 +1132,7 @@ ClientSM::HandleClientCmd(IOBuffer& iobuf, int inCmdLen)
                         "exceeds max wait" : " waiting for buffers") <<
                 KFS_LOG_EOM;
                 if (! submitResponseFlag) {
+                    BufferWaitStart();
                     return false;
                 }
             }
@@ -1165,6 +1239,8 @@ ClientSM::FindServer(
     int&                  err,
     string&               errMsg)
 {
+    // Use single connection per peer to preserve forwarded write ops order.
+    const bool kMultipleConnectionsFlag = false;
     return RemoteSyncSM::FindServer(
         mRemoteSyncers,
         location,
@@ -1178,7 +1254,8 @@ ClientSM::FindServer(
             shutdownSslFlag :
             mNetConnection && ! mNetConnection->GetFilter(),
         err,
-        errMsg
+        errMsg,
+        kMultipleConnectionsFlag
     );
 }
 
@@ -1207,6 +1284,12 @@ ClientSM::HandleGranted()
         return 0;
     }
     mGrantedFlag = true;
+    if (0 < mBufferWaitStart) {
+        if (mCurOp) {
+            mCurOp->bufferWaitTime += microseconds() - mBufferWaitStart;
+        }
+        mBufferWaitStart = 0;
+    }
     return HandleRequest(EVENT_NET_READ, &(mNetConnection->GetInBuffer()));
 }
 
@@ -72,20 +72,7 @@ private:
     typedef QCDLList<ClientThreadListEntry, kDispatchQueueIdx> DispatchQueue;
 protected:
     ClientThreadListEntry(
-        ClientThread* inClientThreadPtr)
-        : mClientThreadPtr(inClientThreadPtr),
-          mOpsHeadPtr(0),
-          mOpsTailPtr(0),
-          mReceivedOpPtr(0),
-          mBlocksChecksums(),
-          mChecksum(0),
-          mFirstChecksumBlockLen(CHECKSUM_BLOCKSIZE),
-          mReceiveByteCount(-1),
-          mReceivedHeaderLen(0),
-          mGrantedFlag(false),
-          mReceiveOpFlag(false),
-          mComputeChecksumFlag(false)
-        { DispatchQueue::Init(*this); }
+        ClientThread* inClientThreadPtr);
     ~ClientThreadListEntry();
     void ReceiveClear()
     {
@@ -135,6 +122,8 @@ protected:
         { return mReceiveByteCount; }
     bool IsClientThread() const
         { return (mClientThreadPtr != 0); }
+    ClientThread* GetClientThreadPtr() const
+        { return mClientThreadPtr; }
     int DispatchEvent(
         ClientSM& inClient,
         int       inCode,
@@ -381,6 +370,8 @@ private:
     DelegationToken            mDelegationToken;
     string                     mSessionKey;
     bool                       mHandleTerminateFlag;
+    int64_t                    mBufferWaitStart;
+    bool                       mPendingOpsLimitFlag;
 
     static int                 sMaxCmdHeaderReadAhead;
     static bool                sTraceRequestResponseFlag;
@@ -388,6 +379,8 @@ private:
     static bool                sSslPskEnabledFlag;
     static int                 sMaxReqSizeDiscard;
     static size_t              sMaxAppendRequestSize;
+    static int                 sSendFileMinSize;
+    static int                 sMaxPendingOps;
     static uint64_t            sInstanceNum;
 
     int HandleRequest(int code, void *data);
@@ -423,6 +416,18 @@ private:
         BufferManager&         bufMgr,
         BufferManager::Client* mgrCli);
     void GrantedSelf(ByteCount byteCount, bool devBufManagerFlag);
+    bool IsPendingOpsLimit()
+    {
+        mPendingOpsLimitFlag =
+            0 < sMaxPendingOps && sMaxPendingOps <= mInFlightOpCount;
+        return mPendingOpsLimitFlag;
+    }
+    void BufferWaitStart()
+    {
+        if (mBufferWaitStart <= 0) {
+            mBufferWaitStart = microseconds();
+        }
+    }
     virtual unsigned long GetPsk(
         const char*    inIdentityPtr,
 	unsigned char* inPskBufferPtr,
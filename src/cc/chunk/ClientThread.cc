@@ -27,6 +27,7 @@
 #include "ClientSM.h"
 #include "RemoteSyncSM.h"
 #include "Replicator.h"
+#include "KfsOps.h"
 
 #include "common/kfsatomic.h"
 
@@ -177,6 +178,9 @@ public:
           mTmpSyncSMQueue(),
           mTmpRSReplicatorQueue(),
           mWakeupCnt(0),
+          mClientCount(0),
+          mEventCount(0),
+          mOpPhaseStats(),
           mOuter(inOuter)
     {
         QCASSERT(GetMutex().IsOwned());
@@ -361,6 +365,7 @@ public:
         void*     inDataPtr)
     {
         if (inCode == EVENT_CMD_DONE) {
+            mEventCount++;
             if (GetCurrentClientThreadPtr() == &mOuter) {
                 int theRet = DispatchGrantedIfPendingAndNoOps(inClient);
                 if (theRet != 0) {
@@ -378,7 +383,11 @@ public:
                 return theRet;
             }
             QCASSERT(inDataPtr);
-            if (AddPending(*reinterpret_cast<KfsOp*>(inDataPtr), inClient) &&
+            KfsOp& theOp = *reinterpret_cast<KfsOp*>(inDataPtr);
+            if (theOp.doneTime <= 0) {
+                theOp.doneTime = microseconds();
+            }
+            if (AddPending(theOp, inClient) &&
                     Enqueue(inClient)) {
                 Wakeup();
             }
@@ -417,6 +426,7 @@ public:
             }
         }
         StMutexLocker theLocker(mOuter);
+        mEventCount++;
         int theRet = DispatchGrantedIfPendingAndNoOps(inClient);
         if (theRet != 0) {
             return theRet;
@@ -445,8 +455,30 @@ public:
     }
     NetManager& GetNetManager()
         { return mNetManager; }
+    void ClientCreated()
+    {
+        QCASSERT(GetMutex().IsOwned() && 0 <= mClientCount);
+        mClientCount++;
+    }
+    void ClientDeleted()
+    {
+        QCASSERT(GetMutex().IsOwned() && 0 < mClientCount);
+        mClientCount--;
+    }
+    int GetClientCount() const
+    {
+        QCASSERT(GetMutex().IsOwned());
+        return mClientCount;
+    }
+    int64_t GetEventCount() const
+    {
+        QCASSERT(GetMutex().IsOwned());
+        return mEventCount;
+    }
     const QCThread& GetThread() const
         { return mThread; }
+    KfsOpPhaseStats& GetOpPhaseStats()
+        { return mOpPhaseStats; }
     void Enqueue(
         RemoteSyncSM& inSyncSM,
         KfsOp&        inOp)
@@ -513,6 +545,9 @@ private:
     TmpSyncSMQueue         mTmpSyncSMQueue;
     TmpRSReplicatorQueue   mTmpRSReplicatorQueue;
     volatile int           mWakeupCnt;
+    int                    mClientCount;
+    int64_t                mEventCount;
+    KfsOpPhaseStats        mOpPhaseStats;
     ClientThread&          mOuter;
     ClientThreadListEntry* mAddQueuePtr[kDispatchQueueCount];
     ClientThreadListEntry* mDispatchQueuePtr[kDispatchQueueCount];
@@ -698,6 +733,27 @@ private:
 ClientThread* ClientThreadImpl::sCurrentClientThreadPtr = 0;
 int           ClientThreadImpl::sLockCnt                = 0;
 
+ClientThreadListEntry::ClientThreadListEntry(
+    ClientThread* inClientThreadPtr)
+    : mClientThreadPtr(inClientThreadPtr),
+      mOpsHeadPtr(0),
+      mOpsTailPtr(0),
+      mReceivedOpPtr(0),
+      mBlocksChecksums(),
+      mChecksum(0),
+      mFirstChecksumBlockLen(CHECKSUM_BLOCKSIZE),
+      mReceiveByteCount(-1),
+      mReceivedHeaderLen(0),
+      mGrantedFlag(false),
+      mReceiveOpFlag(false),
+      mComputeChecksumFlag(false)
+{
+    DispatchQueue::Init(*this);
+    if (mClientThreadPtr) {
+        ClientThreadImpl::GetImpl(*mClientThreadPtr).ClientCreated();
+    }
+}
+
 ClientThreadListEntry::~ClientThreadListEntry()
 {
     if (mOpsHeadPtr || mOpsTailPtr || mGrantedFlag ||
@@ -715,6 +771,9 @@ ClientThreadListEntry::~ClientThreadListEntry()
         ;
         die(theStream.str());
     }
+    if (mClientThreadPtr) {
+        ClientThreadImpl::GetImpl(*mClientThreadPtr).ClientDeleted();
+    }
     // To catch double delete.
     mPrevPtr[kDispatchQueueIdx] = 0;
     mNextPtr[kDispatchQueueIdx] = 0;
@@ -823,12 +882,30 @@ ClientThread::GetNetManager()
     return mImpl.GetNetManager();
 }
 
+    int
+ClientThread::GetClientCount() const
+{
+    return mImpl.GetClientCount();
+}
+
+    int64_t
+ClientThread::GetEventCount() const
+{
+    return mImpl.GetEventCount();
+}
+
     const QCThread&
 ClientThread::GetThread() const
 {
     return mImpl.GetThread();
 }
 
+    KfsOpPhaseStats&
+ClientThread::GetOpPhaseStats()
+{
+    return mImpl.GetOpPhaseStats();
+}
+
     /* static */ const QCMutex&
 ClientThread::GetMutex()
 {
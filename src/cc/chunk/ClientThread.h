@@ -26,6 +26,8 @@
 #ifndef CLIENT_THREAD_H
 #define CLIENT_THREAD_H
 
+#include <inttypes.h>
+
 class QCMutex;
 class QCThread;
 
@@ -38,6 +40,7 @@ class NetManager;
 class RemoteSyncSM;
 class RSReplicatorEntry;
 struct KfsOp;
+class KfsOpPhaseStats;
 
 class ClientThreadImpl;
 class ClientThread
@@ -77,9 +80,18 @@ public:
     void Add(
         ClientSM& inClient);
     NetManager& GetNetManager();
+    // The following two methods must be invoked with the client thread mutex
+    // owned. Client count is the number of client connections assigned to
+    // the thread, event count is the total number of client connection
+    // events dispatched by the thread, and used as the thread load measure.
+    int GetClientCount() const;
+    int64_t GetEventCount() const;
     void Lock();
     void Unlock();
     const QCThread& GetThread() const;
+    // Op phase stats are updated by the thread that sends the op response,
+    // and read without synchronization, the values are approximate.
+    KfsOpPhaseStats& GetOpPhaseStats();
     static ClientThread* GetCurrentClientThreadPtr();
     static const QCMutex& GetMutex();
     static ClientThread* CreateThreads(
@@ -43,6 +43,7 @@
 #include "qcdio/qcdebug.h"
 
 #include "kfsio/PrngIsaac64.h"
+#include "kfsio/checksum.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -54,12 +55,18 @@
 #include <utility>
 #include <map>
 #include <deque>
+#include <vector>
+#include <algorithm>
 
 namespace KFS
 {
 
 using std::pair;
 using std::make_pair;
+using std::min;
+using std::max;
+
+static const char kChunkInventoryMagic[] = "QFSCINV1";
 
 class DirChecker::Impl : public QCRunnable
 {
@@ -102,21 +109,13 @@ public:
           mIgnoreErrorsFlag(false),
           mDeleteAllChaunksOnFsMismatchFlag(false),
           mMaxChunkFilesSampled(16),
-          mRandom(),
-          mChunkHeaderBuffer(),
-          mTestIoBufferAllocPtr(new char[kTestIoBufferAlign + kTestIoSize]),
-          mTestIoBufferPtr(mTestIoBufferAllocPtr +
-            (unsigned int)kTestIoBufferAlign -
-            (unsigned int)((mTestIoBufferAllocPtr - (char*)0) %
-                kTestIoBufferAlign))
-    {
-        memset(mTestIoBufferPtr, kTestByte, kTestIoSize);
-    }
+          mMaxScanThreads(16),
+          mInventoryFileName(),
+          mCounters(),
+          mScanner()
+        {}
     virtual ~Impl()
-    {
-        Impl::Stop();
-        delete [] mTestIoBufferAllocPtr;
-    }
+        { Impl::Stop(); }
     virtual void Run()
     {
         QCStMutexLocker theLocker(mMutex);
@@ -126,6 +125,7 @@ public:
         FileNames       theIgnoreFileNames         = mIgnoreFileNames;
         string          theLockFileName;
         string          theFsIdPrefix;
+        string          theInventoryFileName;
         DirLocks        theDirLocks;
         mUpdateDirInfosFlag = false;
         int64_t         theLastCheckStartTime      = microseconds();
@@ -161,9 +161,13 @@ public:
             const int     theIoTimeoutSec                     = mIoTimeoutSec;
             const size_t  theMaxChunkFilesSampled             =
                 mMaxChunkFilesSampled;
-            theLockFileName = mLockFileName;
-            theFsIdPrefix   = mFsIdPrefix;
+            const int     theMaxScanThreads                   =
+                mMaxScanThreads;
+            theLockFileName      = mLockFileName;
+            theFsIdPrefix        = mFsIdPrefix;
+            theInventoryFileName = mInventoryFileName;
             DirsAvailable theAvailableDirs;
+            Counters      theCounters;
             theDirLocks.swap(mDirLocks);
             QCASSERT(mDirLocks.empty());
             {
@@ -175,30 +179,37 @@ public:
                 theDirLocks.clear();
                 if (theCheckDirsFlag) {
                     theLastCheckStartTime = theNow;
-                    CheckDirs(
-                        theDirInfos,
+                    ScanParams theParams(
                         theSubDirNames,
                         theDontUseIfExistFileNames,
                         theIgnoreFileNames,
-                        mDeviceIds,
-                        mNextDevId,
-                        theRemoveFilesFlag,
-                        theIgnoreErrorsFlag,
                         theLockFileName,
-                        theRequireChunkHeaderChecksumFlag,
-                        mChunkHeaderBuffer,
                         theFsIdPrefix,
-                        theFileSystemId,
-                        theDeleteAllChaunksOnFsMismatchFlag,
-                        theIoTimeoutSec,
-                        mTestIoBufferPtr,
-                        theMaxChunkFilesSampled,
-                        mRandom,
+                        theInventoryFileName
+                    );
+                    theParams.mRemoveFilesFlag  = theRemoveFilesFlag;
+                    theParams.mIgnoreErrorsFlag = theIgnoreErrorsFlag;
+                    theParams.mRequireChunkHeaderChecksumFlag =
+                        theRequireChunkHeaderChecksumFlag;
+                    theParams.mDeleteAllChaunksOnFsMismatchFlag =
+                        theDeleteAllChaunksOnFsMismatchFlag;
+                    theParams.mFileSystemId         = theFileSystemId;
+                    theParams.mIoTimeout            = theIoTimeoutSec;
+                    theParams.mMaxChunkFilesSampled = theMaxChunkFilesSampled;
+                    theParams.mMaxScanThreads       = theMaxScanThreads;
+                    CheckDirs(
+                        theDirInfos,
+                        theParams,
+                        mDeviceIds,
+                        mNextDevId,
+                        mScanner,
+                        theCounters,
                         theAvailableDirs
                     );
                 }
                 theUnlocker.Lock();
             }
+            Add(mCounters, theCounters);
             bool theUpdateDirInfosFlag = false;
             for (DirsAvailable::iterator theIt = theAvailableDirs.begin();
                     theIt != theAvailableDirs.end();
@@ -451,6 +462,53 @@ public:
         QCStMutexLocker theLocker(mMutex);
         return (int)mMaxChunkFilesSampled;
     }
+    void SetMaxScanThreads(
+        int inValue)
+    {
+        QCStMutexLocker theLocker(mMutex);
+        mMaxScanThreads = inValue < 1 ? 1 : inValue;
+    }
+    int GetMaxScanThreads()
+    {
+        QCStMutexLocker theLocker(mMutex);
+        return mMaxScanThreads;
+    }
+    void SetChunkInventoryFileName(
+        const string& inName)
+    {
+        QCStMutexLocker theLocker(mMutex);
+        mInventoryFileName = inName;
+    }
+    int WriteChunkInventory(
+        const string&     inDirName,
+        int64_t           inFileSystemId,
+        const ChunkInfos& inChunkInfos)
+    {
+        string theFileName;
+        {
+            QCStMutexLocker theLocker(mMutex);
+            theFileName = mInventoryFileName;
+        }
+        if (theFileName.empty() || inDirName.empty()) {
+            return 0;
+        }
+        const string theDirName = Normalize(inDirName);
+        const int    theErr     = StoreChunkInventory(
+            theDirName, theDirName + theFileName, inFileSystemId, inChunkInfos);
+        QCStMutexLocker theLocker(mMutex);
+        if (theErr == 0) {
+            mCounters.mInventoryWriteCount++;
+        } else {
+            mCounters.mInventoryWriteErrorCount++;
+        }
+        return theErr;
+    }
+    void GetCounters(
+        Counters& outCounters)
+    {
+        QCStMutexLocker theLocker(mMutex);
+        outCounters = mCounters;
+    }
     void Wakeup()
     {
         QCStMutexLocker theLocker(mMutex);
@@ -463,6 +521,151 @@ private:
     typedef std::map<string, bool>    DirInfos;
     typedef std::map<string, bool>    SubDirNames;
 
+    struct InventoryHeader
+    {
+        char     mMagic[8];
+        uint64_t mCount;
+        int64_t  mFileSystemId;
+        uint64_t mDirDevice;
+        uint64_t mDirInode;
+        int64_t  mDirModTimeSec;
+        int64_t  mDirModTimeNSec;
+        uint32_t mChecksum;
+        uint32_t mReserved;
+    };
+    enum { kInventoryIoEntries = 4 << 10 };
+    class ScanParams
+    {
+    public:
+        ScanParams(
+            const SubDirNames& inSubDirNames,
+            const FileNames&   inDontUseIfExistFileNames,
+            const FileNames&   inIgnoreFileNames,
+            const string&      inLockName,
+            const string&      inFsIdPrefix,
+            const string&      inInventoryFileName)
+            : mSubDirNames(inSubDirNames),
+              mDontUseIfExistFileNames(inDontUseIfExistFileNames),
+              mIgnoreFileNames(inIgnoreFileNames),
+              mLockName(inLockName),
+              mFsIdPrefix(inFsIdPrefix),
+              mInventoryFileName(inInventoryFileName),
+              mRemoveFilesFlag(false),
+              mIgnoreErrorsFlag(false),
+              mRequireChunkHeaderChecksumFlag(false),
+              mDeleteAllChaunksOnFsMismatchFlag(false),
+              mFileSystemId(-1),
+              mIoTimeout(-1),
+              mMaxChunkFilesSampled(0),
+              mMaxScanThreads(1)
+            {}
+        const SubDirNames& mSubDirNames;
+        const FileNames&   mDontUseIfExistFileNames;
+        const FileNames&   mIgnoreFileNames;
+        const string&      mLockName;
+        const string&      mFsIdPrefix;
+        const string&      mInventoryFileName;
+        bool               mRemoveFilesFlag;
+        bool               mIgnoreErrorsFlag;
+        bool               mRequireChunkHeaderChecksumFlag;
+        bool               mDeleteAllChaunksOnFsMismatchFlag;
+        int64_t            mFileSystemId;
+        int                mIoTimeout;
+        size_t             mMaxChunkFilesSampled;
+        int                mMaxScanThreads;
+    private:
+        ScanParams(
+            const ScanParams& inParams);
+        ScanParams& operator=(
+            const ScanParams& inParams);
+    };
+    struct ScanResult
+    {
+        ScanResult()
+            : mAvailableFlag(false),
+              mInventoryLoadedFlag(false),
+              mInventoryInvalidFlag(false),
+              mDevice(),
+              mDirInfo()
+            {}
+        bool    mAvailableFlag;
+        bool    mInventoryLoadedFlag;
+        bool    mInventoryInvalidFlag;
+        dev_t   mDevice;
+        DirInfo mDirInfo;
+    };
+    typedef std::vector<ScanResult>               ScanResults;
+    typedef std::vector<DirInfos::const_iterator> ScanDirs;
+    typedef std::vector<std::vector<size_t> >     ScanGroups;
+    struct ScanJobs
+    {
+        ScanJobs(
+            const ScanParams& inParams,
+            const ScanDirs&   inDirs,
+            const ScanGroups& inGroups,
+            ScanResults&      inResults)
+            : mParams(inParams),
+              mDirs(inDirs),
+              mGroups(inGroups),
+              mResults(inResults),
+              mMutex(),
+              mNextGroup(0),
+              mDoneCount(0)
+            {}
+        const ScanParams& mParams;
+        const ScanDirs&   mDirs;
+        const ScanGroups& mGroups;
+        ScanResults&      mResults;
+        QCMutex           mMutex;
+        size_t            mNextGroup;
+        size_t            mDoneCount;
+    };
+    // Per thread directory scan state.
+    class DirScanner : public QCRunnable
+    {
+    public:
+        DirScanner()
+            : QCRunnable(),
+              mRandom(),
+              mChunkHeaderBuffer(),
+              mTestIoBufferAllocPtr(new char[kTestIoBufferAlign + kTestIoSize]),
+              mTestIoBufferPtr(mTestIoBufferAllocPtr +
+                (unsigned int)kTestIoBufferAlign -
+                (unsigned int)((mTestIoBufferAllocPtr - (char*)0) %
+                    kTestIoBufferAlign)),
+              mThread(),
+              mJobsPtr(0)
+        {
+            memset(mTestIoBufferPtr, kTestByte, kTestIoSize);
+        }
+        virtual ~DirScanner()
+            { delete [] mTestIoBufferAllocPtr; }
+        virtual void Run()
+            { Impl::ScanDirGroups(*mJobsPtr, *this); }
+        void Start(
+            ScanJobs& inJobs)
+        {
+            mJobsPtr = &inJobs;
+            const int kStackSize = 32 << 10;
+            mThread.Start(this, kStackSize, "DirScanner");
+        }
+        void Join()
+            { mThread.Join(); }
+
+        PrngIsaac64       mRandom;
+        ChunkHeaderBuffer mChunkHeaderBuffer;
+        char* const       mTestIoBufferAllocPtr;
+        char* const       mTestIoBufferPtr;
+    private:
+        QCThread  mThread;
+        ScanJobs* mJobsPtr;
+    private:
+        DirScanner(
+            const DirScanner& inScanner);
+        DirScanner& operator=(
+            const DirScanner& inScanner);
+    };
+
     DeviceIds         mDeviceIds;
     DeviceId          mNextDevId;
     DirInfos          mDirInfos;
@@ -489,32 +692,26 @@ private:
     bool              mIgnoreErrorsFlag;
     bool              mDeleteAllChaunksOnFsMismatchFlag;
     size_t            mMaxChunkFilesSampled;
-    PrngIsaac64       mRandom;
-    ChunkHeaderBuffer mChunkHeaderBuffer;
-    char* const       mTestIoBufferAllocPtr;
-    char* const       mTestIoBufferPtr;
+    int               mMaxScanThreads;
+    string            mInventoryFileName;
+    Counters          mCounters;
+    DirScanner        mScanner;
 
     static void CheckDirs(
-        const DirInfos&    inDirInfos,
-        const SubDirNames& inSubDirNames,
-        const FileNames&   inDontUseIfExistFileNames,
-        const FileNames&   inIgnoreFileNames,
-        DeviceIds&         inDeviceIds,
-        DeviceId&          ioNextDevId,
-        bool               inRemoveFilesFlag,
-        bool               inIgnoreErrorsFlag,
-        const string&      inLockName,
-        bool               inRequireChunkHeaderChecksumFlag,
-        ChunkHeaderBuffer& inChunkHeaderBuffer,
-        const string       inFsIdPrefix,
-        int64_t            inFileSystemId,
-        bool               inDeleteAllChaunksOnFsMismatchFlag,
-        int                inIoTimeout,
-        char*              inTestBufferPtr,
-        size_t             inMaxChunkFilesSampled,
-        PrngIsaac64&       inRandom,
-        DirsAvailable&     outDirsAvailable)
+        const DirInfos&   inDirInfos,
+        const ScanParams& inParams,
+        DeviceIds&        inDeviceIds,
+        DeviceId&         ioNextDevId,
+        DirScanner&       inScanner,
+        Counters&         ioCounters,
+        DirsAvailable&    outDirsAvailable)
     {
+        // Group directories by device, and scan each device's directories
+        // sequentially, and different devices in parallel.
+        typedef std::map<dev_t, size_t> DevGroups;
+        ScanDirs   theDirs;
+        ScanGroups theGroups;
+        DevGroups  theDevGroups;
         for (DirInfos::const_iterator theIt = inDirInfos.begin();
                 theIt != inDirInfos.end();
                 ++theIt) {
@@ -523,214 +720,572 @@ private:
                    ! S_ISDIR(theStat.st_mode)) {
                 continue;
             }
-            FileNames::const_iterator theEit =
-                inDontUseIfExistFileNames.begin();
-            for (theEit = inDontUseIfExistFileNames.begin();
-                    theEit != inDontUseIfExistFileNames.end();
-                    ++theEit) {
-                string theFileName = theIt->first + *theEit;
-                if (stat(theFileName.c_str(), &theStat) == 0) {
-                    break;
-                }
-                const int theSysErr = errno;
-                if (theSysErr != ENOENT) {
-                    KFS_LOG_STREAM_ERROR <<
-                        "stat " << theFileName << ": " <<
-                        QCUtils::SysError(errno) <<
-                    KFS_LOG_EOM;
-                    break;
-                }
+            pair<DevGroups::iterator, bool> const theRes = theDevGroups.insert(
+                make_pair(theStat.st_dev, theGroups.size()));
+            if (theRes.second) {
+                theGroups.push_back(ScanGroups::value_type());
+            }
+            theGroups[theRes.first->second].push_back(theDirs.size());
+            theDirs.push_back(theIt);
+        }
+        if (theDirs.empty()) {
+            return;
+        }
+        const int64_t theStartTime = microseconds();
+        ScanResults   theResults(theDirs.size());
+        ScanJobs      theJobs(inParams, theDirs, theGroups, theResults);
+        const size_t  theThreadCount = min(theGroups.size(),
+            (size_t)max(1, inParams.mMaxScanThreads));
+        if (theThreadCount <= 1) {
+            ScanDirGroups(theJobs, inScanner);
+        } else {
+            // The calling thread scans along with the additional threads.
+            DirScanner* const theScannersPtr =
+                new DirScanner[theThreadCount - 1];
+            for (size_t i = 0; i < theThreadCount - 1; i++) {
+                theScannersPtr[i].Start(theJobs);
+            }
+            ScanDirGroups(theJobs, inScanner);
+            for (size_t i = 0; i < theThreadCount - 1; i++) {
+                theScannersPtr[i].Join();
+            }
+            delete [] theScannersPtr;
+        }
+        const int64_t theScanTime   = microseconds() - theStartTime;
+        size_t        theAvailCnt   = 0;
+        size_t        theChunkCnt   = 0;
+        size_t        theLoadedCnt  = 0;
+        ioCounters.mScanTimeMicroSec += theScanTime;
+        for (size_t i = 0; i < theDirs.size(); i++) {
+            ScanResult& theRes = theResults[i];
+            ioCounters.mDirScanCount++;
+            if (theRes.mInventoryInvalidFlag) {
+                ioCounters.mInventoryInvalidCount++;
             }
-            if (theEit != inDontUseIfExistFileNames.end()) {
+            if (! theRes.mAvailableFlag) {
                 continue;
             }
-            LockFdPtr theLockFdPtr;
-            bool      theSupportsSpaceReservatonFlag = false;
-            int       theIoTimeSec                   = -1;
-            if (! inLockName.empty()) {
-                const string theLockName = theIt->first + inLockName;
-                const int    theLockFd   = TryLock(
-                    theLockName,
-                    theIt->second,
-                    inTestBufferPtr,
-                    theSupportsSpaceReservatonFlag,
-                    theIoTimeSec);
-                if (theLockFd < 0) {
-                    KFS_LOG_STREAM_ERROR <<
-                        theLockName << ": " <<
-                        QCUtils::SysError(-theLockFd) <<
-                    KFS_LOG_EOM;
-                    continue;
-                }
-                theLockFdPtr.reset(new LockFd(theLockFd));
-                if (0 < inIoTimeout && inIoTimeout < theIoTimeSec) {
-                    KFS_LOG_STREAM_ERROR <<
-                        theLockName << ": " <<
-                        "test io time: "         << theIoTimeSec <<
-                        " exceeded time limit: " << inIoTimeout  <<
-                    KFS_LOG_EOM;
-                    theLockFdPtr.reset();
-                    continue;
-                }
+            theAvailCnt++;
+            theChunkCnt += theRes.mDirInfo.mChunkInfos.GetSize();
+            if (theRes.mInventoryLoadedFlag) {
+                theLoadedCnt++;
             }
-            SubDirNames::const_iterator theSit;
-            for (theSit = inSubDirNames.begin();
-                    theSit != inSubDirNames.end();
-                    ++theSit) {
-                string theDirName = theIt->first + theSit->first;
-                if (mkdir(theDirName.c_str(), 0755)) {
-                    if (errno != EEXIST) {
-                        KFS_LOG_STREAM_ERROR <<
-                            "mkdir " << theDirName << ": " <<
-                            QCUtils::SysError(errno) <<
-                        KFS_LOG_EOM;
-                        break;
-                    }
-                    if (stat(theDirName.c_str(), &theStat) != 0) {
-                        KFS_LOG_STREAM_ERROR <<
-                            theDirName << ": " <<
-                            QCUtils::SysError(errno) <<
-                        KFS_LOG_EOM;
-                        break;
-                    }
-                    if (! S_ISDIR(theStat.st_mode)) {
-                        KFS_LOG_STREAM_ERROR <<
-                            theDirName << ": " <<
-                            " not a directory" <<
-                        KFS_LOG_EOM;
-                        break;
-                    }
-                    if (inRemoveFilesFlag && theSit->second &&
-                            Remove(theDirName, true) != 0) {
-                        break;
-                    }
+            pair<DeviceIds::iterator, bool> const theDevRes =
+                inDeviceIds.insert(make_pair(theRes.mDevice, ioNextDevId));
+            if (theDevRes.second) {
+                ioNextDevId++;
+            }
+            const DirInfo& theInfo = theRes.mDirInfo;
+            pair<DirsAvailable::iterator, bool> const theDirRes =
+                outDirsAvailable.insert(make_pair(theDirs[i]->first,
+                    DirInfo(
+                        theDevRes.first->second,
+                        theInfo.mLockFdPtr,
+                        theInfo.mBufferedIoFlag,
+                        theInfo.mSupportsSpaceReservatonFlag,
+                        theInfo.mFileSystemId
+                    )));
+            if (! theRes.mDirInfo.mChunkInfos.IsEmpty() && theDirRes.second) {
+                theRes.mDirInfo.mChunkInfos.Swap(
+                    theDirRes.first->second.mChunkInfos);
+            }
+        }
+        ioCounters.mChunkFileCount     += theChunkCnt;
+        ioCounters.mInventoryLoadCount += theLoadedCnt;
+        KFS_LOG_STREAM(0 < theAvailCnt ?
+                MsgLogger::kLogLevelINFO : MsgLogger::kLogLevelDEBUG) <<
+            "scanned directories: " << theDirs.size() <<
+            " devices: "            << theGroups.size() <<
+            " threads: "            << theThreadCount <<
+            " available: "          << theAvailCnt <<
+            " chunks: "             << theChunkCnt <<
+            " inventories: "        << theLoadedCnt <<
+            " time: "               << theScanTime * 1e-6 << " sec." <<
+        KFS_LOG_EOM;
+    }
+    static void ScanDirGroups(
+        ScanJobs&   inJobs,
+        DirScanner& inScanner)
+    {
+        QCStMutexLocker theLocker(inJobs.mMutex);
+        while (inJobs.mNextGroup < inJobs.mGroups.size()) {
+            const ScanGroups::value_type& theGroup =
+                inJobs.mGroups[inJobs.mNextGroup++];
+            for (size_t i = 0; i < theGroup.size(); i++) {
+                const size_t                   theIdx = theGroup[i];
+                const DirInfos::const_iterator theIt  = inJobs.mDirs[theIdx];
+                ScanResult&                    theRes = inJobs.mResults[theIdx];
+                {
+                    QCStMutexUnlocker theUnlocker(inJobs.mMutex);
+                    CheckDir(
+                        theIt->first,
+                        theIt->second,
+                        inJobs.mParams,
+                        inScanner,
+                        theRes
+                    );
                 }
+                inJobs.mDoneCount++;
+                KFS_LOG_STREAM(theRes.mAvailableFlag ?
+                        MsgLogger::kLogLevelINFO : MsgLogger::kLogLevelDEBUG) <<
+                    "scanned: "    << inJobs.mDoneCount <<
+                    " of "         << inJobs.mDirs.size() <<
+                    " directory: " << theIt->first <<
+                    (theRes.mAvailableFlag ? "" : " not available") <<
+                    " chunks: "    << theRes.mDirInfo.mChunkInfos.GetSize() <<
+                    (theRes.mInventoryLoadedFlag ? " from inventory" : "") <<
+                KFS_LOG_EOM;
             }
-            if (theSit != inSubDirNames.end()) {
-                continue;
+        }
+    }
+    static void CheckDir(
+        const string&     inDirName,
+        bool              inBufferedIoFlag,
+        const ScanParams& inParams,
+        DirScanner&       inScanner,
+        ScanResult&       outResult)
+    {
+        struct stat theStat = {0};
+        if (stat(inDirName.c_str(), &theStat) != 0 ||
+               ! S_ISDIR(theStat.st_mode)) {
+            return;
+        }
+        // Validate inventory against the directory modification time obtained
+        // prior to lock and sub directories creation, as both modify the
+        // directory.
+        const struct stat theDirStat = theStat;
+        FileNames::const_iterator theEit =
+            inParams.mDontUseIfExistFileNames.begin();
+        for (theEit = inParams.mDontUseIfExistFileNames.begin();
+                theEit != inParams.mDontUseIfExistFileNames.end();
+                ++theEit) {
+            string theFileName = inDirName + *theEit;
+            if (stat(theFileName.c_str(), &theStat) == 0) {
+                break;
             }
-            int64_t    theFsId = -1;
-            ChunkInfos theChunkInfos;
-            string     theFsIdPathName;
-            if (GetChunkFiles(
-                    theIt->first,
-                    inLockName,
-                    inIgnoreFileNames,
-                    inRequireChunkHeaderChecksumFlag,
-                    inRemoveFilesFlag,
-                    inIgnoreErrorsFlag,
-                    inFsIdPrefix,
-                    inChunkHeaderBuffer,
-                    inIoTimeout,
-                    inMaxChunkFilesSampled,
-                    inRandom,
-                    theFsId,
-                    theFsIdPathName,
-                    theChunkInfos) != 0) {
-                continue;
+            const int theSysErr = errno;
+            if (theSysErr != ENOENT) {
+                KFS_LOG_STREAM_ERROR <<
+                    "stat " << theFileName << ": " <<
+                    QCUtils::SysError(errno) <<
+                KFS_LOG_EOM;
+                break;
             }
-            if (0 < inFileSystemId && 0 < theFsId &&
-                    inFileSystemId != theFsId) {
-                const int theCleanupFlag =
-                    inDeleteAllChaunksOnFsMismatchFlag || theChunkInfos.IsEmpty();
-                KFS_LOG_STREAM(theCleanupFlag ?
-                    MsgLogger::kLogLevelINFO : MsgLogger::kLogLevelERROR) <<
-                    theIt->first <<
-                    " file system id: "             << theFsId <<
-                    " does not match expected id: " << inFileSystemId <<
-                    (theCleanupFlag ? " deleting all chunks" : "") <<
+        }
+        if (theEit != inParams.mDontUseIfExistFileNames.end()) {
+            return;
+        }
+        LockFdPtr theLockFdPtr;
+        bool      theSupportsSpaceReservatonFlag = false;
+        int       theIoTimeSec                   = -1;
+        if (! inParams.mLockName.empty()) {
+            const string theLockName = inDirName + inParams.mLockName;
+            const int    theLockFd   = TryLock(
+                theLockName,
+                inBufferedIoFlag,
+                inScanner.mTestIoBufferPtr,
+                theSupportsSpaceReservatonFlag,
+                theIoTimeSec);
+            if (theLockFd < 0) {
+                KFS_LOG_STREAM_ERROR <<
+                    theLockName << ": " <<
+                    QCUtils::SysError(-theLockFd) <<
                 KFS_LOG_EOM;
-                if (! theCleanupFlag) {
-                    continue;
-                }
-                string                    theName = theIt->first;
-                const size_t              theSize = theName.size();
-                ChunkInfos::ConstIterator theCIt(theChunkInfos);
-                const ChunkInfo*          thePtr;
-                char                      theBuf[32];
-                char* const               theBufEndPtr =
-                    theBuf + sizeof(theBuf) / sizeof(theBuf[0]) - 1;
-                *theBufEndPtr = 0;
-                while ((thePtr = theCIt.Next())) {
-                    theName.resize(theSize);
-                    theName += IntToDecString(thePtr->mFileId, theBufEndPtr);
-                    theName += ".";
-                    theName += IntToDecString(thePtr->mChunkId, theBufEndPtr);
-                    theName += ".";
-                    theName += IntToDecString(
-                        thePtr->mChunkVersion, theBufEndPtr);
-                    if (unlink(theName.c_str())) {
-                        const int theErr = errno;
-                        KFS_LOG_STREAM_ERROR <<
-                            theName <<
-                            " error: " << QCUtils::SysError(theErr) <<
-                        KFS_LOG_EOM;
-                        break;
-                    }
+                return;
+            }
+            theLockFdPtr.reset(new LockFd(theLockFd));
+            if (0 < inParams.mIoTimeout && inParams.mIoTimeout < theIoTimeSec) {
+                KFS_LOG_STREAM_ERROR <<
+                    theLockName << ": " <<
+                    "test io time: "         << theIoTimeSec <<
+                    " exceeded time limit: " << inParams.mIoTimeout  <<
+                KFS_LOG_EOM;
+                theLockFdPtr.reset();
+                return;
+            }
+        }
+        SubDirNames::const_iterator theSit;
+        for (theSit = inParams.mSubDirNames.begin();
+                theSit != inParams.mSubDirNames.end();
+                ++theSit) {
+            string theDirName = inDirName + theSit->first;
+            if (mkdir(theDirName.c_str(), 0755)) {
+                if (errno != EEXIST) {
+                    KFS_LOG_STREAM_ERROR <<
+                        "mkdir " << theDirName << ": " <<
+                        QCUtils::SysError(errno) <<
+                    KFS_LOG_EOM;
+                    break;
                 }
-                if (thePtr) {
-                    // Cleanup error.
-                    continue;
+                if (stat(theDirName.c_str(), &theStat) != 0) {
+                    KFS_LOG_STREAM_ERROR <<
+                        theDirName << ": " <<
+                        QCUtils::SysError(errno) <<
+                    KFS_LOG_EOM;
+                    break;
                 }
-                if (! theFsIdPathName.empty() &&
-                        unlink(theFsIdPathName.c_str())) {
-                    const int theErr = errno;
+                if (! S_ISDIR(theStat.st_mode)) {
                     KFS_LOG_STREAM_ERROR <<
-                        theFsIdPathName <<
-                        " error: " << QCUtils::SysError(theErr) <<
+                        theDirName << ": " <<
+                        " not a directory" <<
                     KFS_LOG_EOM;
-                    continue;
+                    break;
+                }
+                if (inParams.mRemoveFilesFlag && theSit->second &&
+                        Remove(theDirName, true) != 0) {
+                    break;
                 }
-                theFsIdPathName.clear();
-                theChunkInfos.Clear();
-                theFsId = inFileSystemId;
             }
-            if ((0 < inFileSystemId || 0 < theFsId) &&
-                    theFsIdPathName.empty() &&
-                    ! inFsIdPrefix.empty()) {
-                string theName = theIt->first;
-                theName += inFsIdPrefix;
-                char        theBuf[32];
-                char* const theBufEndPtr =
-                    theBuf + sizeof(theBuf) / sizeof(theBuf[0]) - 1;
-                *theBufEndPtr = 0;
+        }
+        if (theSit != inParams.mSubDirNames.end()) {
+            return;
+        }
+        int64_t    theFsId = -1;
+        ChunkInfos theChunkInfos;
+        string     theFsIdPathName;
+        outResult.mInventoryLoadedFlag = LoadChunkInventory(
+            inDirName,
+            theDirStat,
+            inParams,
+            theFsId,
+            theFsIdPathName,
+            theChunkInfos,
+            outResult.mInventoryInvalidFlag
+        );
+        if (! outResult.mInventoryLoadedFlag && GetChunkFiles(
+                inDirName,
+                inParams.mLockName,
+                inParams.mInventoryFileName,
+                inParams.mIgnoreFileNames,
+                inParams.mRequireChunkHeaderChecksumFlag,
+                inParams.mRemoveFilesFlag,
+                inParams.mIgnoreErrorsFlag,
+                inParams.mFsIdPrefix,
+                inScanner.mChunkHeaderBuffer,
+                inParams.mIoTimeout,
+                inParams.mMaxChunkFilesSampled,
+                inScanner.mRandom,
+                theFsId,
+                theFsIdPathName,
+                theChunkInfos) != 0) {
+            return;
+        }
+        if (0 < inParams.mFileSystemId && 0 < theFsId &&
+                inParams.mFileSystemId != theFsId) {
+            const int theCleanupFlag =
+                inParams.mDeleteAllChaunksOnFsMismatchFlag ||
+                theChunkInfos.IsEmpty();
+            KFS_LOG_STREAM(theCleanupFlag ?
+                MsgLogger::kLogLevelINFO : MsgLogger::kLogLevelERROR) <<
+                inDirName <<
+                " file system id: "             << theFsId <<
+                " does not match expected id: " << inParams.mFileSystemId <<
+                (theCleanupFlag ? " deleting all chunks" : "") <<
+            KFS_LOG_EOM;
+            if (! theCleanupFlag) {
+                return;
+            }
+            string                    theName = inDirName;
+            const size_t              theSize = theName.size();
+            ChunkInfos::ConstIterator theCIt(theChunkInfos);
+            const ChunkInfo*          thePtr;
+            char                      theBuf[32];
+            char* const               theBufEndPtr =
+                theBuf + sizeof(theBuf) / sizeof(theBuf[0]) - 1;
+            *theBufEndPtr = 0;
+            while ((thePtr = theCIt.Next())) {
+                theName.resize(theSize);
+                theName += IntToDecString(thePtr->mFileId, theBufEndPtr);
+                theName += ".";
+                theName += IntToDecString(thePtr->mChunkId, theBufEndPtr);
+                theName += ".";
                 theName += IntToDecString(
-                    0 < inFileSystemId ? inFileSystemId : theFsId,
-                    theBufEndPtr
-                );
-                const int theFd = open(theName.c_str(),
-                    O_CREAT|O_RDWR|O_TRUNC, 0644);
-                if (theFd < 0 || close(theFd)) {
+                    thePtr->mChunkVersion, theBufEndPtr);
+                if (unlink(theName.c_str())) {
                     const int theErr = errno;
                     KFS_LOG_STREAM_ERROR <<
                         theName <<
                         " error: " << QCUtils::SysError(theErr) <<
                     KFS_LOG_EOM;
+                    break;
+                }
+            }
+            if (thePtr) {
+                // Cleanup error.
+                return;
+            }
+            if (! theFsIdPathName.empty() &&
+                    unlink(theFsIdPathName.c_str())) {
+                const int theErr = errno;
+                KFS_LOG_STREAM_ERROR <<
+                    theFsIdPathName <<
+                    " error: " << QCUtils::SysError(theErr) <<
+                KFS_LOG_EOM;
+                return;
+            }
+            theFsIdPathName.clear();
+            theChunkInfos.Clear();
+            theFsId = inParams.mFileSystemId;
+        }
+        if ((0 < inParams.mFileSystemId || 0 < theFsId) &&
+                theFsIdPathName.empty() &&
+                ! inParams.mFsIdPrefix.empty()) {
+            string theName = inDirName;
+            theName += inParams.mFsIdPrefix;
+            char        theBuf[32];
+            char* const theBufEndPtr =
+                theBuf + sizeof(theBuf) / sizeof(theBuf[0]) - 1;
+            *theBufEndPtr = 0;
+            theName += IntToDecString(
+                0 < inParams.mFileSystemId ? inParams.mFileSystemId : theFsId,
+                theBufEndPtr
+            );
+            const int theFd = open(theName.c_str(),
+                O_CREAT|O_RDWR|O_TRUNC, 0644);
+            if (theFd < 0 || close(theFd)) {
+                const int theErr = errno;
+                KFS_LOG_STREAM_ERROR <<
+                    theName <<
+                    " error: " << QCUtils::SysError(theErr) <<
+                KFS_LOG_EOM;
+                return;
+            }
+        }
+        outResult.mAvailableFlag = true;
+        outResult.mDevice        = theDirStat.st_dev;
+        outResult.mDirInfo       = DirInfo(
+            -1,
+            theLockFdPtr,
+            inBufferedIoFlag,
+            theSupportsSpaceReservatonFlag,
+            theFsId
+        );
+        theChunkInfos.Swap(outResult.mDirInfo.mChunkInfos);
+    }
+    static void GetModTime(
+        const struct stat& inStat,
+        int64_t&           outSec,
+        int64_t&           outNanoSec)
+    {
+#ifdef KFS_OS_NAME_DARWIN
+        outSec     = inStat.st_mtimespec.tv_sec;
+        outNanoSec = inStat.st_mtimespec.tv_nsec;
+#else
+        outSec     = inStat.st_mtim.tv_sec;
+        outNanoSec = inStat.st_mtim.tv_nsec;
+#endif
+    }
+    static bool IsInventoryValid(
+        const InventoryHeader& inHeader,
+        const struct stat&     inDirStat)
+    {
+        int64_t theSec     = -1;
+        int64_t theNanoSec = -1;
+        GetModTime(inDirStat, theSec, theNanoSec);
+        return (
+            memcmp(inHeader.mMagic, kChunkInventoryMagic,
+                sizeof(inHeader.mMagic)) == 0 &&
+            inHeader.mDirDevice      == (uint64_t)inDirStat.st_dev &&
+            inHeader.mDirInode       == (uint64_t)inDirStat.st_ino &&
+            inHeader.mDirModTimeSec  == theSec &&
+            inHeader.mDirModTimeNSec == theNanoSec &&
+            inHeader.mCount          <= (uint64_t)ChunkInfos::MaxSize()
+        );
+    }
+    static bool LoadChunkInventory(
+        const string&      inDirName,
+        const struct stat& inDirStat,
+        const ScanParams&  inParams,
+        int64_t&           outFileSystemId,
+        string&            outFsIdPathName,
+        ChunkInfos&        outChunkInfos,
+        bool&              outInvalidFlag)
+    {
+        outInvalidFlag = false;
+        if (inParams.mInventoryFileName.empty()) {
+            return false;
+        }
+        const string theFileName = inDirName + inParams.mInventoryFileName;
+        const int    theFd       = open(theFileName.c_str(), O_RDWR);
+        if (theFd < 0) {
+            const int theErr = errno;
+            if (theErr != ENOENT) {
+                KFS_LOG_STREAM_ERROR <<
+                    theFileName << ": " << QCUtils::SysError(theErr) <<
+                KFS_LOG_EOM;
+            }
+            return false;
+        }
+        InventoryHeader theHeader;
+        const ssize_t   theNRd = read(theFd, &theHeader, sizeof(theHeader));
+        bool            theLoadedFlag = false;
+        if (theNRd == (ssize_t)sizeof(theHeader) &&
+                IsInventoryValid(theHeader, inDirStat)) {
+            const uint32_t theExpectedChecksum = theHeader.mChecksum;
+            theHeader.mChecksum = 0;
+            uint32_t theChecksum = ComputeBlockChecksum(kKfsNullChecksum,
+                reinterpret_cast<const char*>(&theHeader), sizeof(theHeader));
+            std::vector<ChunkInfo> theBuf(kInventoryIoEntries);
+            uint64_t               theRem = theHeader.mCount;
+            while (0 < theRem) {
+                const size_t theCnt =
+                    (size_t)min(theRem, (uint64_t)kInventoryIoEntries);
+                const size_t theLen = theCnt * sizeof(theBuf[0]);
+                if (read(theFd, &theBuf[0], theLen) != (ssize_t)theLen) {
+                    break;
+                }
+                theChecksum = ComputeBlockChecksum(theChecksum,
+                    reinterpret_cast<const char*>(&theBuf[0]), theLen);
+                for (size_t i = 0; i < theCnt; i++) {
+                    outChunkInfos.PushBack(theBuf[i]);
+                }
+                theRem -= theCnt;
+            }
+            theLoadedFlag = theRem <= 0 && theChecksum == theExpectedChecksum;
+            outInvalidFlag = ! theLoadedFlag;
+        } else {
+            outInvalidFlag = theNRd != 0;
+        }
+        // Invalidate inventory, as the chunk directory content is about to
+        // change. The in place truncate does not change the directory
+        // modification time.
+        if ((theLoadedFlag || outInvalidFlag) && ftruncate(theFd, 0)) {
+            const int theErr = errno;
+            KFS_LOG_STREAM_ERROR <<
+                theFileName << ": truncate: " << QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            theLoadedFlag = false;
+        }
+        close(theFd);
+        if (! theLoadedFlag) {
+            outChunkInfos.Clear();
+            if (outInvalidFlag) {
+                KFS_LOG_STREAM_NOTICE <<
+                    theFileName << ": ignoring chunk inventory:"
+                    " directory was modified or invalid inventory" <<
+                KFS_LOG_EOM;
+            }
+            return false;
+        }
+        outFileSystemId = theHeader.mFileSystemId;
+        outFsIdPathName.clear();
+        if (0 < outFileSystemId && ! inParams.mFsIdPrefix.empty()) {
+            string theName = inDirName;
+            theName += inParams.mFsIdPrefix;
+            AppendDecIntToString(theName, outFileSystemId);
+            struct stat theStat = {0};
+            if (stat(theName.c_str(), &theStat) == 0 &&
+                    S_ISREG(theStat.st_mode)) {
+                outFsIdPathName = theName;
+            }
+        }
+        KFS_LOG_STREAM_INFO <<
+            theFileName << ": loaded chunk inventory:"
+            " chunks: "  << outChunkInfos.GetSize() <<
+            " fs id: "   << outFileSystemId <<
+        KFS_LOG_EOM;
+        return true;
+    }
+    static int StoreChunkInventory(
+        const string&     inDirName,
+        const string&     inFileName,
+        int64_t           inFileSystemId,
+        const ChunkInfos& inChunkInfos)
+    {
+        const int theFd = open(inFileName.c_str(), O_CREAT | O_RDWR, 0644);
+        if (theFd < 0) {
+            const int theErr = errno;
+            KFS_LOG_STREAM_ERROR <<
+                inFileName << ": " << QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            return (0 < theErr ? -theErr : -EIO);
+        }
+        // Get the directory modification time after the inventory file is
+        // created, and write the inventory in place in order to leave the
+        // directory modification time unchanged.
+        struct stat theStat = {0};
+        int         theErr  = 0;
+        if (stat(inDirName.c_str(), &theStat) || ftruncate(theFd, 0)) {
+            theErr = errno;
+        }
+        InventoryHeader theHeader;
+        memset(&theHeader, 0, sizeof(theHeader));
+        memcpy(theHeader.mMagic, kChunkInventoryMagic, sizeof(theHeader.mMagic));
+        theHeader.mCount        = inChunkInfos.GetSize();
+        theHeader.mFileSystemId = inFileSystemId;
+        theHeader.mDirDevice    = (uint64_t)theStat.st_dev;
+        theHeader.mDirInode     = (uint64_t)theStat.st_ino;
+        GetModTime(theStat, theHeader.mDirModTimeSec,
+            theHeader.mDirModTimeNSec);
+        uint32_t theChecksum = ComputeBlockChecksum(kKfsNullChecksum,
+            reinterpret_cast<const char*>(&theHeader), sizeof(theHeader));
+        std::vector<ChunkInfo>    theBuf;
+        off_t                     thePos = sizeof(theHeader);
+        ChunkInfos::ConstIterator theIt(inChunkInfos);
+        const ChunkInfo*          thePtr = 0;
+        theBuf.reserve(kInventoryIoEntries);
+        while (theErr == 0) {
+            if ((thePtr = theIt.Next())) {
+                theBuf.push_back(*thePtr);
+                if (theBuf.size() < kInventoryIoEntries) {
                     continue;
                 }
             }
-            pair<DeviceIds::iterator, bool> const theDevRes =
-                inDeviceIds.insert(make_pair(theStat.st_dev, ioNextDevId));
-            if (theDevRes.second) {
-                ioNextDevId++;
+            if (theBuf.empty()) {
+                break;
             }
-            pair<DirsAvailable::iterator, bool> const theDirRes =
-                outDirsAvailable.insert(make_pair(theIt->first,
-                    DirInfo(
-                        theDevRes.first->second,
-                        theLockFdPtr,
-                        theIt->second,
-                        theSupportsSpaceReservatonFlag,
-                        theFsId
-                    )));
-            if (! theChunkInfos.IsEmpty() && theDirRes.second) {
-                theChunkInfos.Swap(theDirRes.first->second.mChunkInfos);
+            const size_t theLen = theBuf.size() * sizeof(theBuf[0]);
+            theChecksum = ComputeBlockChecksum(theChecksum,
+                reinterpret_cast<const char*>(&theBuf[0]), theLen);
+            if (pwrite(theFd, &theBuf[0], theLen, thePos) != (ssize_t)theLen) {
+                theErr = errno != 0 ? errno : EIO;
+                break;
+            }
+            thePos += theLen;
+            theBuf.clear();
+        }
+        if (theErr == 0) {
+            theHeader.mChecksum = theChecksum;
+            if (pwrite(theFd, &theHeader, sizeof(theHeader), 0) !=
+                    (ssize_t)sizeof(theHeader) || fsync(theFd)) {
+                theErr = errno != 0 ? errno : EIO;
+            }
+        }
+        if (theErr == 0) {
+            // Discard the inventory if the directory was modified.
+            struct stat theCurStat = {0};
+            if (stat(inDirName.c_str(), &theCurStat)) {
+                theErr = errno;
+            } else if (! IsInventoryValid(theHeader, theCurStat)) {
+                theErr = EAGAIN;
             }
         }
+        if (theErr != 0 && ftruncate(theFd, 0)) {
+            const int theCurErr = errno;
+            KFS_LOG_STREAM_ERROR <<
+                inFileName << ": truncate: " << QCUtils::SysError(theCurErr) <<
+            KFS_LOG_EOM;
+        }
+        if (close(theFd) && theErr == 0) {
+            theErr = errno != 0 ? errno : EIO;
+        }
+        if (theErr != 0) {
+            KFS_LOG_STREAM_ERROR <<
+                inFileName << ": chunk inventory write failure: " <<
+                QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            return (0 < theErr ? -theErr : theErr);
+        }
+        KFS_LOG_STREAM_INFO <<
+            inFileName << ": stored chunk inventory:"
+            " chunks: " << theHeader.mCount <<
+        KFS_LOG_EOM;
+        return 0;
     }
     static int GetChunkFiles(
         const string&      inDirName,
         const string&      inLockName,
+        const string&      inInventoryFileName,
         const FileNames&   inIgnoreFileNames,
         bool               inRequireChunkHeaderChecksumFlag,
         bool               inRemoveFilesFlag,
@@ -769,7 +1324,8 @@ private:
         while ((theEntryPtr = readdir(theDirStream))) {
             if (strcmp(theEntryPtr->d_name, ".") == 0 ||
                     strcmp(theEntryPtr->d_name, "..") == 0 ||
-                    inLockName == theEntryPtr->d_name) {
+                    inLockName == theEntryPtr->d_name ||
+                    inInventoryFileName == theEntryPtr->d_name) {
                 continue;
             }
             theName = theEntryPtr->d_name;
@@ -1008,6 +1564,20 @@ private:
         }
         return theErr;
     }
+    static void Add(
+        Counters&       ioCounters,
+        const Counters& inCounters)
+    {
+        ioCounters.mDirScanCount             += inCounters.mDirScanCount;
+        ioCounters.mChunkFileCount           += inCounters.mChunkFileCount;
+        ioCounters.mInventoryLoadCount       += inCounters.mInventoryLoadCount;
+        ioCounters.mInventoryInvalidCount    +=
+            inCounters.mInventoryInvalidCount;
+        ioCounters.mInventoryWriteCount      += inCounters.mInventoryWriteCount;
+        ioCounters.mInventoryWriteErrorCount +=
+            inCounters.mInventoryWriteErrorCount;
+        ioCounters.mScanTimeMicroSec         += inCounters.mScanTimeMicroSec;
+    }
     template<typename T>
     static void Swap(
         T& inLeft,
@@ -1452,4 +2022,40 @@ DirChecker::Wakeup()
     mImpl.Wakeup();
 }
 
+    void
+DirChecker::SetMaxScanThreads(
+    int inValue)
+{
+    mImpl.SetMaxScanThreads(inValue);
+}
+
+    int
+DirChecker::GetMaxScanThreads()
+{
+    return mImpl.GetMaxScanThreads();
+}
+
+    void
+DirChecker::SetChunkInventoryFileName(
+    const string& inName)
+{
+    mImpl.SetChunkInventoryFileName(inName);
+}
+
+    int
+DirChecker::WriteChunkInventory(
+    const string&     inDirName,
+    int64_t           inFileSystemId,
+    const ChunkInfos& inChunkInfos)
+{
+    return mImpl.WriteChunkInventory(inDirName, inFileSystemId, inChunkInfos);
+}
+
+    void
+DirChecker::GetCounters(
+    Counters& outCounters)
+{
+    mImpl.GetCounters(outCounters);
+}
+
 }
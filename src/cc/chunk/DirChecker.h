@@ -56,6 +56,11 @@ using boost::shared_ptr;
 // Directories with files with names from the "black" / "don't use" list aren't
 // considered available until such files are removed / renamed. Typically the
 // "black" list contains "evacuate", and "evacuate.done".
+// Directories on different devices are scanned in parallel. If the chunk
+// inventory file name is set, the chunk list is loaded from the inventory file,
+// written by WriteChunkInventory(), instead of scanning the directory, if
+// the directory modification time matches the time recorded in the inventory.
+// The inventory is invalidated once loaded.
 class DirChecker
 {
 public:
@@ -113,6 +118,31 @@ public:
         ChunkInfos mChunkInfos;
     };
     typedef map<string, DirInfo> DirsAvailable;
+    struct Counters
+    {
+        typedef int64_t Counter;
+
+        Counter mDirScanCount;
+        Counter mChunkFileCount;
+        Counter mInventoryLoadCount;
+        Counter mInventoryInvalidCount;
+        Counter mInventoryWriteCount;
+        Counter mInventoryWriteErrorCount;
+        Counter mScanTimeMicroSec;
+
+        Counters()
+            { Clear(); }
+        void Clear()
+        {
+            mDirScanCount             = 0;
+            mChunkFileCount           = 0;
+            mInventoryLoadCount       = 0;
+            mInventoryInvalidCount    = 0;
+            mInventoryWriteCount      = 0;
+            mInventoryWriteErrorCount = 0;
+            mScanTimeMicroSec         = 0;
+        }
+    };
 
     DirChecker();
     ~DirChecker();
@@ -162,6 +192,17 @@ public:
     void SetMaxChunkFilesSampled(
         int inValue);
     int GetMaxChunkFilesSampled();
+    void SetMaxScanThreads(
+        int inValue);
+    int GetMaxScanThreads();
+    void SetChunkInventoryFileName(
+        const string& inName);
+    int WriteChunkInventory(
+        const string&     inDirName,
+        int64_t           inFileSystemId,
+        const ChunkInfos& inChunkInfos);
+    void GetCounters(
+        Counters& outCounters);
     void Wakeup();
 private:
     class Impl;
@@ -101,6 +101,7 @@ static int DiskQueueToSysError(
         case QCDiskQueue::kErrorGetFsAvailable:       return EIO;
         case QCDiskQueue::kErrorCheckDirReadable:     return EIO;
         case QCDiskQueue::kErrorCheckDirWritable:     return EIO;
+        case QCDiskQueue::kErrorPreallocate:          return EIO;
         default:                                      break;
     }
     return EINVAL;
@@ -264,6 +265,31 @@ private:
 };
 
 const char* const kDiskQueueParametersPrefixPtr = "chunkServer.diskQueue.";
+
+static void
+SetBufferManagerClassParameters(
+    BufferManager&    inBufferManager,
+    const Properties& inProperties)
+{
+    string theName("chunkServer.bufferManager.");
+    const size_t thePrefixLen = theName.size();
+    for (int i = 0; i < BufferManager::kRequestClassCount; i++) {
+        const BufferManager::RequestClass theClass =
+            BufferManager::RequestClass(i);
+        theName.resize(thePrefixLen);
+        theName += BufferManager::GetRequestClassName(theClass);
+        theName += ".";
+        const size_t theLen = theName.size();
+        theName += "weight";
+        const int theWeight = inProperties.getValue(theName, 1);
+        theName.resize(theLen);
+        theName += "minReserveRatio";
+        const double theMinReserveRatio = inProperties.getValue(theName, 0.);
+        inBufferManager.SetClassParameters(
+            theClass, theWeight, theMinReserveRatio);
+    }
+}
+
 // Disk io queue.
 class DiskQueue : public QCDiskQueue,
     private QCDiskQueue::DebugTracer
@@ -296,6 +322,7 @@ public:
           mGetFsSpaceAvailableNullFilePtr(new DiskIo::File()),
           mCheckDirReadableNullFilePtr(new DiskIo::File()),
           mCheckDirWritableNullFilePtr(new DiskIo::File()),
+          mPreallocateNullFilePtr(new DiskIo::File()),
           mBufferManager(true),
           mSimulatorPtr(inSimulatorConfigPtr ?
             new DiskErrorSimulator(*inSimulatorConfigPtr) : 0),
@@ -317,12 +344,23 @@ public:
         mGetFsSpaceAvailableNullFilePtr->mQueuePtr = this;
         mCheckDirReadableNullFilePtr->mQueuePtr    = this;
         mCheckDirWritableNullFilePtr->mQueuePtr    = this;
+        mPreallocateNullFilePtr->mQueuePtr         = this;
         mBufferManager.Init(0, inMaxBuffersBytes, inMaxClientQuota, 0);
         mBufferManager.SetWaitingAvgInterval(inWaitingAvgInterval);
     }
+    bool GetIoMethodCacheCounters(
+        IOMethod::CacheCounters& outCounters)
+    {
+        return (mIoMethodsPtr && 0 < mThreadCount &&
+            mIoMethodsPtr[0]->GetCacheCounters(outCounters));
+    }
     void SetParameters(
         const Properties& inProperties)
     {
+        SetPriorityClassParameters(inProperties);
+        SetWriteBehindParameters(inProperties);
+        SetElevatorParameters(inProperties);
+        SetBufferManagerClassParameters(mBufferManager, inProperties);
         if (! mIoMethodsPtr) {
             return;
         }
@@ -333,6 +371,57 @@ public:
             );
         }
     }
+    void SetWriteBehindParameters(
+        const Properties& inProperties)
+    {
+        string theName(kDiskQueueParametersPrefixPtr);
+        theName += "writeBehindSize";
+        QCDiskQueue::SetWriteBehindSize(
+            inProperties.getValue(theName, int64_t(0)));
+    }
+    void SetElevatorParameters(
+        const Properties& inProperties)
+    {
+        string theName(kDiskQueueParametersPrefixPtr);
+        theName += "elevator.";
+        const size_t thePrefixLen = theName.size();
+        theName += "windowSize";
+        const int theWindowSize = inProperties.getValue(theName, 0);
+        theName.resize(thePrefixLen);
+        theName += "maxWaitMilliSec";
+        const int64_t theMaxWait = inProperties.getValue(
+            theName, int64_t(100));
+        QCDiskQueue::SetElevatorParameters(theWindowSize, theMaxWait * 1000);
+    }
+    void SetPriorityClassParameters(
+        const Properties& inProperties)
+    {
+        static const char* const kNames[kPriorityClassCount] =
+            { "client", "recovery", "maintenance" };
+        static const int kDefaultWeights[kPriorityClassCount] = { 8, 2, 1 };
+        string theName(kDiskQueueParametersPrefixPtr);
+        theName += "priority.";
+        const size_t thePrefixLen = theName.size();
+        for (int i = 0; i < kPriorityClassCount; i++) {
+            theName.resize(thePrefixLen);
+            theName += kNames[i];
+            theName += ".";
+            const size_t theLen = theName.size();
+            theName += "weight";
+            const int theWeight = inProperties.getValue(
+                theName, kDefaultWeights[i]);
+            theName.resize(theLen);
+            theName += "deadlineMilliSec";
+            const int64_t theDeadline = inProperties.getValue(
+                theName, int64_t(0));
+            theName.resize(theLen);
+            theName += "maxInFlight";
+            const int theMaxInFlight = inProperties.getValue(theName, 0);
+            QCDiskQueue::SetPriorityClassParameters(
+                PriorityClass(i), theWeight, theDeadline * 1000,
+                theMaxInFlight);
+        }
+    }
     void Delete(
         DiskQueue** inListPtr)
     {
@@ -386,10 +475,11 @@ public:
     EnqueueStatus DeleteFile(
         const char*   inFileNamePtr,
         IoCompletion* inIoCompletionPtr,
-        Time          inTimeWaitNanoSec)
+        Time          inTimeWaitNanoSec,
+        bool          inBackgroundFlag)
     {
-        return QCDiskQueue::Delete(
-            inFileNamePtr, inIoCompletionPtr, inTimeWaitNanoSec);
+        return QCDiskQueue::Delete(inFileNamePtr, inIoCompletionPtr,
+            inTimeWaitNanoSec, inBackgroundFlag);
     }
     bool IsFileNamePrefixMatches(
         const char* inFileNamePtr) const
@@ -463,6 +553,8 @@ public:
         { return mCheckDirReadableNullFilePtr; };
     DiskIo::FilePtr GetCheckDirWritableNullFile()
         { return mCheckDirWritableNullFilePtr; }
+    DiskIo::FilePtr GetPreallocateNullFile()
+        { return mPreallocateNullFilePtr; }
     virtual void TraceMsg(
         const char* inMsgPtr,
         int         inLength)
@@ -506,6 +598,7 @@ private:
     DiskIo::FilePtr           mGetFsSpaceAvailableNullFilePtr;
     DiskIo::FilePtr           mCheckDirReadableNullFilePtr;
     DiskIo::FilePtr           mCheckDirWritableNullFilePtr;
+    DiskIo::FilePtr           mPreallocateNullFilePtr;
     BufferManager             mBufferManager;
     DiskErrorSimulator* const mSimulatorPtr;
     int                 const mMinWriteBlkSize;
@@ -577,6 +670,10 @@ public:
             "chunkServer.ioBufferPool.bufferSize", 4 << 10)),
           mBufferPoolLockMemoryFlag(inConfig.getValue(
             "chunkServer.ioBufferPool.lockMemory", false)),
+          mBufferPoolHugePageSize(inConfig.getValue(
+            "chunkServer.ioBufferPool.hugePageSize", 0)),
+          mBufferPoolNumaNodeCount(inConfig.getValue(
+            "chunkServer.ioBufferPool.numaNodeCount", 0)),
           mDiskOverloadedPendingRequestCount(inConfig.getValue(
             "chunkServer.diskIo.overloadedPendingRequestCount",
                 mDiskQueueMaxQueueDepth * 3 / 4)),
@@ -630,6 +727,8 @@ public:
           mDiskErrorSimulatorConfig(inConfig),
           mCpuAffinity(inConfig.getValue(
             "chunkServer.diskQueue.cpuAffinity", -1)),
+          mNumaAffinityFlag(inConfig.getValue(
+            "chunkServer.diskQueue.numaAffinity", 0) != 0),
           mDiskQueueTraceFlag(inConfig.getValue(
             "chunkServer.diskQueue.trace", 0) != 0),
           mParameters(inConfig)
@@ -656,7 +755,9 @@ public:
             mBufferPoolPartitionCount,
             mBufferPoolPartitionBufferCount,
             mBufferPoolBufferSize,
-            mBufferPoolLockMemoryFlag
+            mBufferPoolLockMemoryFlag,
+            mBufferPoolHugePageSize,
+            mBufferPoolNumaNodeCount
         );
         if (theSysError) {
             if (inErrMessagePtr) {
@@ -958,13 +1059,30 @@ public:
             theThreadCount,
             theIoMethodsPtr
         );
+        QCDiskQueue::CpuAffinity theCpuAffinity = mCpuAffinity;
+        if (mNumaAffinityFlag) {
+            // Run the queue threads on the numa node the device is attached
+            // to, in order to keep the buffers and device io on the same node.
+            const int theNode = QCThread::GetPathNumaNode(inDirNamePtr);
+            const QCDiskQueue::CpuAffinity theNodeAffinity =
+                QCThread::GetNumaNodeCpuAffinity(theNode);
+            if (theNodeAffinity != QCDiskQueue::CpuAffinity::None()) {
+                theCpuAffinity = theNodeAffinity;
+            }
+            KFS_LOG_STREAM_INFO <<
+                "disk queue: " << inDirNamePtr <<
+                " numa node: " << theNode <<
+                (theCpuAffinity == theNodeAffinity ?
+                    "" : " using default cpu affinity") <<
+            KFS_LOG_EOM;
+        }
         const int theSysErr = theQueuePtr->Start(
             mDiskQueueMaxQueueDepth,
             mDiskQueueMaxBuffersPerRequest,
             inMaxOpenFiles,
             0, // FileNamesPtr
             GetBufferPool(),
-            mCpuAffinity,
+            theCpuAffinity,
             mDiskQueueTraceFlag,
             inCreateExclusiveFlag,
             inRequestAffinityFlag || 0 != theIoMethodsPtr,
@@ -979,6 +1097,9 @@ public:
             }
             return false;
         }
+        theQueuePtr->SetPriorityClassParameters(mParameters);
+        theQueuePtr->SetWriteBehindParameters(mParameters);
+        theQueuePtr->SetElevatorParameters(mParameters);
         return true;
     }
     DiskQueue::Time GetMaxEnqueueWaitTimeNanoSec() const
@@ -1103,18 +1224,100 @@ public:
             mCounters.mCheckDirWritableErrorCount++;
         }
     }
+    void PreallocateDone(
+        int64_t inRetCode)
+    {
+        if (inRetCode >= 0) {
+            mCounters.mPreallocateCount++;
+        } else {
+            mCounters.mPreallocateErrorCount++;
+        }
+    }
     int GetFdCountPerFile() const
         { return mDiskQueueThreadCount; }
     void GetCounters(
         Counters& outCounters)
-        { outCounters = mCounters; }
+    {
+        outCounters = mCounters;
+        outCounters.mPageCacheHitCount      = 0;
+        outCounters.mPageCacheHitByteCount  = 0;
+        outCounters.mPageCacheMissCount     = 0;
+        outCounters.mPageCacheMissByteCount = 0;
+        outCounters.mSyncTimedCount         = 0;
+        outCounters.mSyncTimeMicroSec       = 0;
+        outCounters.mSyncMaxTimeMicroSec    = 0;
+        outCounters.mWriteBehindCount       = 0;
+        outCounters.mWriteBehindByteCount   = 0;
+        // Object store read cache is process wide, use the first IO method
+        // that has one.
+        IOMethod::CacheCounters theCacheCounters;
+        bool                    theCacheFlag = false;
+        DiskQueueList::Iterator theIt(mDiskQueuesPtr);
+        DiskQueue* thePtr;
+        while ((thePtr = theIt.Next())) {
+            if (! theCacheFlag) {
+                theCacheFlag = thePtr->GetIoMethodCacheCounters(
+                    theCacheCounters);
+            }
+            int64_t theHitCnt;
+            int64_t theHitBytes;
+            int64_t theMissCnt;
+            int64_t theMissBytes;
+            thePtr->GetPageCacheCounters(
+                theHitCnt, theHitBytes, theMissCnt, theMissBytes);
+            outCounters.mPageCacheHitCount      += theHitCnt;
+            outCounters.mPageCacheHitByteCount  += theHitBytes;
+            outCounters.mPageCacheMissCount     += theMissCnt;
+            outCounters.mPageCacheMissByteCount += theMissBytes;
+            int64_t theWriteBehindCnt;
+            int64_t theWriteBehindBytes;
+            int64_t theSyncCnt;
+            int64_t theSyncTime;
+            int64_t theSyncMaxTime;
+            thePtr->GetSyncCounters(theWriteBehindCnt, theWriteBehindBytes,
+                theSyncCnt, theSyncTime, theSyncMaxTime);
+            outCounters.mWriteBehindCount     += theWriteBehindCnt;
+            outCounters.mWriteBehindByteCount += theWriteBehindBytes;
+            outCounters.mSyncTimedCount       += theSyncCnt;
+            outCounters.mSyncTimeMicroSec     += theSyncTime;
+            outCounters.mSyncMaxTimeMicroSec  = max(
+                outCounters.mSyncMaxTimeMicroSec, theSyncMaxTime);
+        }
+        outCounters.mObjStoreCacheHitCount        = theCacheCounters.mHitCount;
+        outCounters.mObjStoreCacheHitByteCount    =
+            theCacheCounters.mHitByteCount;
+        outCounters.mObjStoreCacheMissCount       = theCacheCounters.mMissCount;
+        outCounters.mObjStoreCacheMissByteCount   =
+            theCacheCounters.mMissByteCount;
+        outCounters.mObjStoreCacheInsertByteCount =
+            theCacheCounters.mInsertByteCount;
+        outCounters.mObjStoreCacheEvictCount      = theCacheCounters.mEvictCount;
+        outCounters.mObjStoreCacheErrorCount      = theCacheCounters.mErrorCount;
+        outCounters.mObjStoreCacheSize            = theCacheCounters.mSize;
+        outCounters.mObjStoreCacheCapacity        = theCacheCounters.mCapacity;
+    }
+    void GetPriorityClassCounters(
+        QCDiskQueue::PriorityClass          inPriorityClass,
+        QCDiskQueue::PriorityClassCounters& outCounters)
+    {
+        outCounters.Clear();
+        QCDiskQueue::PriorityClassCounters theCounters;
+        DiskQueueList::Iterator theIt(mDiskQueuesPtr);
+        DiskQueue* thePtr;
+        while ((thePtr = theIt.Next())) {
+            thePtr->GetPriorityClassCounters(inPriorityClass, theCounters);
+            outCounters.Add(theCounters);
+        }
+    }
     void SetInFlight(
         DiskIo* inIoPtr)
     {
         if (! inIoPtr) {
             return;
         }
-        inIoPtr->mEnqueueTime = Now();
+        inIoPtr->mEnqueueTime   = Now();
+        inIoPtr->mQueueWaitTime = 0;
+        inIoPtr->mIoTime        = 0;
         QCStMutexLocker theLocker(mMutex);
         AddInFlight(*inIoPtr);
     }
@@ -1164,6 +1367,7 @@ public:
         }
         mMaxIoTime = max(1, inProperties.getValue(
             "chunkServer.diskIo.maxIoTimeSec", mMaxIoTime));
+        SetBufferManagerClassParameters(mBufferManager, inProperties);
         mParameters = inProperties;
         DiskQueue* thePtr;
         DiskQueueList::Iterator theIt(mDiskQueuesPtr);
@@ -1245,6 +1449,8 @@ private:
     const int                      mBufferPoolPartitionBufferCount;
     const int                      mBufferPoolBufferSize;
     const int                      mBufferPoolLockMemoryFlag;
+    const int                      mBufferPoolHugePageSize;
+    const int                      mBufferPoolNumaNodeCount;
     const int                      mDiskOverloadedPendingRequestCount;
     const int                      mDiskClearOverloadedPendingRequestCount;
     const int                      mDiskOverloadedMinFreeBufferCount;
@@ -1279,6 +1485,7 @@ private:
     Counters                       mCounters;
     DiskErrorSimulator::Config     mDiskErrorSimulatorConfig;
     const QCDiskQueue::CpuAffinity mCpuAffinity;
+    const bool                     mNumaAffinityFlag;
     const int                      mDiskQueueTraceFlag;
     Properties                     mParameters;
 
@@ -1540,18 +1747,38 @@ DiskIo::GetCounters(
     sDiskIoQueuesPtr->GetCounters(outCounters);
 }
 
+    /* static */ void
+DiskIo::GetPriorityClassCounters(
+    QCDiskQueue::PriorityClass          inPriorityClass,
+    QCDiskQueue::PriorityClassCounters& outCounters)
+{
+    if (! sDiskIoQueuesPtr) {
+        outCounters.Clear();
+        return;
+    }
+    sDiskIoQueuesPtr->GetPriorityClassCounters(inPriorityClass, outCounters);
+}
+
      /* static */ bool
 DiskIo::Delete(
     const char*     inFileNamePtr,
     KfsCallbackObj* inCallbackObjPtr /* = 0 */,
-    string*         inErrMessagePtr /* = 0 */)
+    string*         inErrMessagePtr /* = 0 */,
+    bool            inBackgroundFlag /* = false */)
 {
+    const bool    kBufferedIoFlag = false;
+    const bool    kAllocSpaceFlag = false;
+    const int64_t kWriteSize      = 0;
     return EnqueueMeta(
         kMetaOpTypeDelete,
         inFileNamePtr,
         0,
         inCallbackObjPtr,
-        inErrMessagePtr
+        inErrMessagePtr,
+        kBufferedIoFlag,
+        kAllocSpaceFlag,
+        kWriteSize,
+        inBackgroundFlag
     );
 }
 
@@ -1622,6 +1849,27 @@ DiskIo::CheckDirWritable(
     );
 }
 
+     /* static */ bool
+DiskIo::Preallocate(
+    const char*     inFileNamePtr,
+    int64_t         inFileSize,
+    KfsCallbackObj* inCallbackObjPtr /* = 0 */,
+    string*         inErrMessagePtr /* = 0 */)
+{
+    const bool kBufferedIoFlag = false;
+    const bool kAllocSpaceFlag = true;
+    return EnqueueMeta(
+        kMetaOpTypePreallocate,
+        inFileNamePtr,
+        0,
+        inCallbackObjPtr,
+        inErrMessagePtr,
+        kBufferedIoFlag,
+        kAllocSpaceFlag,
+        inFileSize
+    );
+}
+
     /* static */ bool
 DiskIo::GetDiskQueuePendingCount(
     DiskQueue* inDiskQueuePtr,
@@ -1683,7 +1931,8 @@ DiskIo::EnqueueMeta(
     string*            inErrMessagePtr,
     bool               inBufferedIoFlag,
     bool               inAllocSpaceFlag,
-    int64_t            inWriteSize)
+    int64_t            inWriteSize,
+    bool               inBackgroundFlag)
 {
     const char* theErrMsgPtr = 0;
     if (! inNamePtr) {
@@ -1729,7 +1978,8 @@ DiskIo::EnqueueMeta(
                     theStatus = theQueuePtr->DeleteFile(
                         inNamePtr,
                         theDiskIoPtr,
-                        sDiskIoQueuesPtr->GetMaxEnqueueWaitTimeNanoSec()
+                        sDiskIoQueuesPtr->GetMaxEnqueueWaitTimeNanoSec(),
+                        inBackgroundFlag
                     );
                     if (theStatus.IsError()) {
                         sDiskIoQueuesPtr->DeleteDone(-1);
@@ -1783,6 +2033,22 @@ DiskIo::EnqueueMeta(
                         sDiskIoQueuesPtr->CheckDirWritableDone(-1);
                     }
                     break;
+                case kMetaOpTypePreallocate:
+                    theDiskIoPtr = new DiskIo(
+                        theQueuePtr->GetPreallocateNullFile(),
+                        theCallbackPtr
+                    );
+                    sDiskIoQueuesPtr->SetInFlight(theDiskIoPtr);
+                    theStatus = theQueuePtr->Preallocate(
+                        inNamePtr,
+                        inWriteSize,
+                        theDiskIoPtr,
+                        sDiskIoQueuesPtr->GetMaxEnqueueWaitTimeNanoSec()
+                    );
+                    if (theStatus.IsError()) {
+                        sDiskIoQueuesPtr->PreallocateDone(-1);
+                    }
+                    break;
                 default:
                     QCRTASSERT(! "invalid op type");
             }
@@ -1831,7 +2097,9 @@ DiskIo::File::Open(
     bool           inCreateFlag           /* = false */,
     string*        inErrMessagePtr        /* = 0 */,
     bool*          inRetryFlagPtr         /* = 0 */,
-    bool           inBufferedIoFlag       /* = false */)
+    bool           inBufferedIoFlag       /* = false */,
+    bool           inRandomReadHintFlag   /* = false */,
+    const char*    inPreallocatedFileNamePtr /* = 0 */)
 {
     const char* theErrMsgPtr = 0;
     if (IsOpen()) {
@@ -1861,7 +2129,8 @@ DiskIo::File::Open(
         inMaxFileSize > 0 && inReserveFileSpaceFlag;
     QCDiskQueue::OpenFileStatus const theStatus = mQueuePtr->OpenFile(
         inFileNamePtr, mReadOnlyFlag ? -1 : inMaxFileSize, mReadOnlyFlag,
-        mSpaceReservedFlag, inCreateFlag, inBufferedIoFlag);
+        mSpaceReservedFlag, inCreateFlag, inBufferedIoFlag,
+        inRandomReadHintFlag, inPreallocatedFileNamePtr);
     if (theStatus.IsError()) {
         if (inErrMessagePtr) {
             *inErrMessagePtr =
@@ -1876,7 +2145,8 @@ DiskIo::File::Open(
         }
         return false;
     }
-    mFileIdx = theStatus.GetFileIdx();
+    mFileIdx        = theStatus.GetFileIdx();
+    mBufferedIoFlag = inBufferedIoFlag;
     sDiskIoQueuesPtr->UpdateOpenFilesCount(+1);
     return true;
 }
@@ -1934,6 +2204,21 @@ DiskIo::File::GetDiskQueuePendingCount(
     }
 }
 
+    int
+DiskIo::File::DupFd() const
+{
+    if (mFileIdx < 0 || ! mQueuePtr) {
+        return -EBADF;
+    }
+    int theFd = -1;
+    const QCDiskQueue::Status theStatus = mQueuePtr->DupFd(mFileIdx, theFd);
+    if (theStatus.IsError()) {
+        const int theErr = theStatus.GetSysError();
+        return (theErr > 0 ? -theErr : -EBADF);
+    }
+    return theFd;
+}
+
     int
 DiskIo::File::GetMinWriteBlkSize() const
 {
@@ -1984,6 +2269,7 @@ DiskIo::File::Reset()
     mFileIdx           = -1;
     mReadOnlyFlag      = false;
     mSpaceReservedFlag = false;
+    mBufferedIoFlag    = false;
     mError             = 0;
     mIoBuffers.clear();
 }
@@ -2000,8 +2286,11 @@ DiskIo::DiskIo(
       mBlockIdx(0),
       mIoRetCode(0),
       mEnqueueTime(),
+      mQueueWaitTime(0),
+      mIoTime(0),
       mWriteSyncFlag(false),
       mCachedFlag(false),
+      mPriorityClass(QCDiskQueue::kPriorityClassClient),
       mCompletionRequestId(QCDiskQueue::kRequestIdNone),
       mCompletionCode(QCDiskQueue::kErrorNone),
       mChainedPtr(0)
@@ -2015,6 +2304,16 @@ DiskIo::~DiskIo()
     DiskIo::Close();
 }
 
+    /* virtual */ void
+DiskIo::SetTimes(
+    QCDiskQueue::RequestId /* inRequestId */,
+    int64_t                inWaitTimeMicroSec,
+    int64_t                inIoTimeMicroSec)
+{
+    mQueueWaitTime = inWaitTimeMicroSec;
+    mIoTime        = inIoTimeMicroSec;
+}
+
     void
 DiskIo::Close()
 {
@@ -2153,7 +2452,8 @@ DiskIo::Read(
         0, // inBufferIteratorPtr // allocate buffers just beofre read
         theBufferCnt,
         this,
-        sDiskIoQueuesPtr->GetMaxEnqueueWaitTimeNanoSec()
+        sDiskIoQueuesPtr->GetMaxEnqueueWaitTimeNanoSec(),
+        mPriorityClass
     );
     if (theStatus.IsGood()) {
         sDiskIoQueuesPtr->ReadPending(inNumBytes);
@@ -2519,7 +2819,8 @@ DiskIo::SubmitWrite(
         this,
         sDiskIoQueuesPtr->GetMaxEnqueueWaitTimeNanoSec(),
         inSyncFlag,
-        inEofHint
+        inEofHint,
+        mPriorityClass
     );
     if (theStatus.IsGood()) {
         sDiskIoQueuesPtr->WritePending(inNumBytes);
@@ -2683,6 +2984,12 @@ DiskIo::RunCompletion()
         theMetaFlag = true;
         theCode = EVENT_DISK_CHECK_DIR_WRITABLE_DONE;
         sDiskIoQueuesPtr->CheckDirWritableDone(mIoRetCode);
+    } else if (mFilePtr.get() ==
+            theQueuePtr->GetPreallocateNullFile().get()) {
+        theOpNamePtr = "preallocate";
+        theMetaFlag = true;
+        theCode = EVENT_DISK_PREALLOCATE_DONE;
+        sDiskIoQueuesPtr->PreallocateDone(mIoRetCode);
     } else if (mReadLength > 0) {
         sDiskIoQueuesPtr->ReadPending(
             -int64_t(mReadLength), mIoRetCode, mCachedFlag);
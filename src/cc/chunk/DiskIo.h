@@ -65,6 +65,11 @@ public:
         Counter mWriteErrorCount;
         Counter mSyncCount;
         Counter mSyncErrorCount;
+        Counter mSyncTimedCount;
+        Counter mSyncTimeMicroSec;
+        Counter mSyncMaxTimeMicroSec;
+        Counter mWriteBehindCount;
+        Counter mWriteBehindByteCount;
         Counter mCheckOpenCount;
         Counter mCheckOpenErrorCount;
         Counter mDeleteCount;
@@ -77,10 +82,25 @@ public:
         Counter mCheckDirWritableCount;
         Counter mCheckDirReadableErrorCount;
         Counter mCheckDirWritableErrorCount;
+        Counter mPreallocateCount;
+        Counter mPreallocateErrorCount;
         Counter mTimedOutErrorCount;
         Counter mTimedOutErrorReadByteCount;
         Counter mTimedOutErrorWriteByteCount;
         Counter mOpenFilesCount;
+        Counter mPageCacheHitCount;
+        Counter mPageCacheHitByteCount;
+        Counter mPageCacheMissCount;
+        Counter mPageCacheMissByteCount;
+        Counter mObjStoreCacheHitCount;
+        Counter mObjStoreCacheHitByteCount;
+        Counter mObjStoreCacheMissCount;
+        Counter mObjStoreCacheMissByteCount;
+        Counter mObjStoreCacheInsertByteCount;
+        Counter mObjStoreCacheEvictCount;
+        Counter mObjStoreCacheErrorCount;
+        Counter mObjStoreCacheSize;
+        Counter mObjStoreCacheCapacity;
         void Clear()
         {
             mReadCount                     = 0;
@@ -91,6 +111,11 @@ public:
             mWriteErrorCount               = 0;
             mSyncCount                     = 0;
             mSyncErrorCount                = 0;
+            mSyncTimedCount                = 0;
+            mSyncTimeMicroSec              = 0;
+            mSyncMaxTimeMicroSec           = 0;
+            mWriteBehindCount              = 0;
+            mWriteBehindByteCount          = 0;
             mCheckOpenCount                = 0;
             mCheckOpenErrorCount           = 0;
             mDeleteCount                   = 0;
@@ -102,10 +127,25 @@ public:
             mCheckDirReadableCount         = 0;
             mCheckDirReadableErrorCount    = 0;
             mCheckDirWritableErrorCount    = 0;
+            mPreallocateCount              = 0;
+            mPreallocateErrorCount         = 0;
             mTimedOutErrorCount            = 0;
             mTimedOutErrorReadByteCount    = 0;
             mTimedOutErrorWriteByteCount   = 0;
             mOpenFilesCount                = 0;
+            mPageCacheHitCount             = 0;
+            mPageCacheHitByteCount         = 0;
+            mPageCacheMissCount            = 0;
+            mPageCacheMissByteCount        = 0;
+            mObjStoreCacheHitCount         = 0;
+            mObjStoreCacheHitByteCount     = 0;
+            mObjStoreCacheMissCount        = 0;
+            mObjStoreCacheMissByteCount    = 0;
+            mObjStoreCacheInsertByteCount  = 0;
+            mObjStoreCacheEvictCount       = 0;
+            mObjStoreCacheErrorCount       = 0;
+            mObjStoreCacheSize             = 0;
+            mObjStoreCacheCapacity         = 0;
         }
     };
     typedef int64_t Offset;
@@ -143,10 +183,16 @@ public:
         DiskQueue* inDiskQueuePtr);
     static void GetCounters(
         Counters& outCounters);
+    static void GetPriorityClassCounters(
+        QCDiskQueue::PriorityClass          inPriorityClass,
+        QCDiskQueue::PriorityClassCounters& outCounters);
+    // Background delete is not ordered with respect to other meta requests,
+    // and is queued with the lowest (maintenance) priority.
     static bool Delete(
         const char*     inFileNamePtr,
         KfsCallbackObj* inCallbackObjPtr = 0,
-        string*    inErrMessagePtr  = 0);
+        string*    inErrMessagePtr  = 0,
+        bool            inBackgroundFlag = false);
     static bool Rename(
         const char*     inSrcFileNamePtr,
         const char*     inDstFileNamePtr,
@@ -167,6 +213,11 @@ public:
         int64_t         inWriteSize,
         KfsCallbackObj* inCallbackObjPtr = 0,
         string*         inErrMessagePtr  = 0);
+    static bool Preallocate(
+        const char*     inFileNamePtr,
+        int64_t         inFileSize,
+        KfsCallbackObj* inCallbackObjPtr = 0,
+        string*         inErrMessagePtr  = 0);
     static bool GetDiskQueuePendingCount(
         DiskQueue* inDiskQueuePtr,
         int&       outFreeRequestCount,
@@ -191,6 +242,7 @@ public:
               mFileIdx(-1),
               mReadOnlyFlag(false),
               mSpaceReservedFlag(false),
+              mBufferedIoFlag(false),
               mError(0)
             {}
         ~File()
@@ -207,7 +259,9 @@ public:
             bool        inCreateFlag           = false,
             string*     inErrMessagePtr        = 0,
             bool*       inRetryFlagPtr         = 0,
-            bool        inBufferedIoFlag       = false);
+            bool        inBufferedIoFlag       = false,
+            bool        inRandomReadHintFlag   = false,
+            const char* inPreallocatedFileNamePtr = 0);
         bool IsOpen() const
             { return (mFileIdx >= 0); }
         // Close with IOs in flight will result in crash.
@@ -220,6 +274,11 @@ public:
             { return mFileIdx; }
         bool IsReadOnly() const
             { return mReadOnlyFlag; }
+        bool IsBufferedIo() const
+            { return mBufferedIoFlag; }
+        /// Returns duplicate of the file descriptor owned by the caller, or
+        /// negative error code.
+        int DupFd() const;
         bool ReserveSpace(
             string* inErrMessagePtr = 0);
         void GetDiskQueuePendingCount(
@@ -237,6 +296,7 @@ public:
         int        mFileIdx;
         bool       mReadOnlyFlag:1;
         bool       mSpaceReservedFlag:1;
+        bool       mBufferedIoFlag:1;
         int        mError;
 
         void Reset();
@@ -286,6 +346,16 @@ public:
 
     FilePtr GetFilePtr() const
         { return mFilePtr; }
+    /// Disk queue priority class of the subsequent reads and writes.
+    void SetPriorityClass(
+        QCDiskQueue::PriorityClass inPriorityClass)
+        { mPriorityClass = inPriorityClass; }
+    /// The last completed request disk queue wait and io times in
+    /// microseconds.
+    int64_t GetQueueWaitTime() const
+        { return mQueueWaitTime; }
+    int64_t GetIoTime() const
+        { return mIoTime; }
 private:
     /// Owning KfsCallbackObj.
     KfsCallbackObj* const  mCallbackObjPtr;
@@ -297,8 +367,11 @@ private:
     int64_t                mBlockIdx;
     int64_t                mIoRetCode;
     time_t                 mEnqueueTime;
+    int64_t                mQueueWaitTime;
+    int64_t                mIoTime;
     bool                   mWriteSyncFlag;
     bool                   mCachedFlag;
+    QCDiskQueue::PriorityClass mPriorityClass;
     QCDiskQueue::RequestId mCompletionRequestId;
     QCDiskQueue::Error     mCompletionCode;
     DiskIo*                mChainedPtr;
@@ -325,6 +398,10 @@ private:
         QCDiskQueue::Error          inCompletionCode,
         int                         inSysErrorCode,
         int64_t                     inIoByteCount);
+    virtual void SetTimes(
+        QCDiskQueue::RequestId inRequestId,
+        int64_t                inWaitTimeMicroSec,
+        int64_t                inIoTimeMicroSec);
 
     enum MetaOpType
     {
@@ -334,6 +411,7 @@ private:
         kMetaOpTypeGetFsSpaceAvailable = 3,
         kMetaOpTypeCheckDirReadable    = 4,
         kMetaOpTypeCheckDirWritable    = 5,
+        kMetaOpTypePreallocate         = 6,
         kMetaOpTypeNumOps
     };
 
@@ -345,7 +423,8 @@ private:
         string*         inErrMessagePtr,
         bool            inBufferedIoFlag = false,
         bool            inAllocSpaceFlag = false,
-        int64_t         inWriteSize      = 0);
+        int64_t         inWriteSize      = 0,
+        bool            inBackgroundFlag = false);
 
     friend class QCDLListOp<DiskIo, 0>;
     friend class DiskIoQueues;
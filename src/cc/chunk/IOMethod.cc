@@ -110,6 +110,9 @@ IOMethod::Create(
         &KFS_MAKE_REGISTERED_IO_METHOD_NAME(inType))
 
 __KFS_DECLARE_EXTERN_IO_METHOD(KFS_IO_METHOD_NAME_S3ION);
+#ifdef KFS_IO_METHOD_IOURING
+__KFS_DECLARE_EXTERN_IO_METHOD(KFS_IO_METHOD_NAME_IOURING);
+#endif
 
 #undef __KFS_DECLARE_EXTERN_IO_METHOD    
 
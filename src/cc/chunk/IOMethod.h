@@ -37,6 +37,31 @@ class Properties;
 class IOMethod : public QCDiskQueue::RequestProcessor
 {
 public:
+    struct CacheCounters
+    {
+        typedef int64_t Counter;
+
+        CacheCounters()
+            : mHitCount(0),
+              mHitByteCount(0),
+              mMissCount(0),
+              mMissByteCount(0),
+              mInsertByteCount(0),
+              mEvictCount(0),
+              mErrorCount(0),
+              mSize(0),
+              mCapacity(0)
+            {}
+        Counter mHitCount;
+        Counter mHitByteCount;
+        Counter mMissCount;
+        Counter mMissByteCount;
+        Counter mInsertByteCount;
+        Counter mEvictCount;
+        Counter mErrorCount;
+        Counter mSize;
+        Counter mCapacity;
+    };
     static IOMethod* Create(
         const char*       inUrlPtr,
         const char*       inLogPrefixPtr,
@@ -53,6 +78,11 @@ public:
     virtual void SetParameters(
         const char*       inPrefixPtr,
         const Properties& inParameters) = 0;
+    // Returns true and sets the counters of the process wide read cache, if
+    // the IO method has one. Can be invoked from any thread.
+    virtual bool GetCacheCounters(
+        CacheCounters& /* outCounters */)
+        { return false; }
 protected:
     IOMethod(
         bool inAllocatesReadBuffersFlag = false)
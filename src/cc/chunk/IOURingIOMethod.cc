@@ -0,0 +1,807 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Copyright 2016 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Linux io_uring host file system IO method.
+//
+// Each disk queue thread owns one ring. Read and write requests are queued
+// into the ring as readv / writev submission entries, and submitted in
+// batches. The queue thread reaps completions in ProcessAndWait(), and
+// invokes disk queue completion directly, this way the io submission and
+// completion do not require thread context switch per request, and the
+// number of the requests in flight is no longer limited by the number of io
+// threads. The queue "wakeup" is implemented by polling event fd, with the
+// poll request always pending in the ring.
+// Open, close, and meta requests are executed synchronously, the same way as
+// the disk queue's threads execute these.
+//
+//----------------------------------------------------------------------------
+
+#include "chunk/IOMethodDef.h"
+
+#include "common/MsgLogger.h"
+#include "common/Properties.h"
+
+#include "qcdio/QCUtils.h"
+#include "qcdio/qcdebug.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+
+#include <liburing.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace KFS
+{
+
+using std::string;
+using std::vector;
+using std::min;
+
+class IOURingION : public IOMethod
+{
+public:
+    typedef QCDiskQueue::Request       Request;
+    typedef QCDiskQueue::ReqType       ReqType;
+    typedef QCDiskQueue::BlockIdx      BlockIdx;
+    typedef QCDiskQueue::InputIterator InputIterator;
+    typedef QCDiskQueue::Error         Error;
+
+    static IOMethod* New(
+        const char*       inUrlPtr,
+        const char*       inLogPrefixPtr,
+        const char*       inParamsPrefixPtr,
+        const Properties& inParameters)
+    {
+        // Host file system directories only, no url scheme.
+        if (! inUrlPtr || ! *inUrlPtr || strstr(inUrlPtr, "://")) {
+            return 0;
+        }
+        const string thePrefix = inParamsPrefixPtr ? inParamsPrefixPtr : "";
+        if (inParameters.getValue(
+                thePrefix + "ioUring.enabled", 0) == 0) {
+            return 0;
+        }
+        IOURingION* const thePtr = new IOURingION(inUrlPtr, inLogPrefixPtr);
+        thePtr->SetParameters(inParamsPrefixPtr, inParameters);
+        if (! thePtr->Start()) {
+            delete thePtr;
+            return 0;
+        }
+        return thePtr;
+    }
+    virtual ~IOURingION()
+    {
+        IOURingION::Stop();
+        for (IoReqs::const_iterator theIt = mIoReqs.begin();
+                theIt != mIoReqs.end();
+                ++theIt) {
+            delete *theIt;
+        }
+    }
+    virtual bool Init(
+        QCDiskQueue& inDiskQueue,
+        int          inBlockSize,
+        int64_t      /* inMinWriteBlkSize */,
+        int64_t      /* inMaxFileSize */,
+        bool&        outCanEnforceIoTimeoutFlag)
+    {
+        if (inBlockSize <= 0) {
+            KFS_LOG_STREAM_ERROR << mLogPrefix <<
+                "invalid block size: " << inBlockSize <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        mDiskQueuePtr = &inDiskQueue;
+        mBlockSize    = inBlockSize;
+        // The kernel owns the request buffers until completion, therefore
+        // the queue must not time out and release in flight requests.
+        outCanEnforceIoTimeoutFlag = false;
+        return true;
+    }
+    virtual void SetParameters(
+        const char*       inPrefixPtr,
+        const Properties& inParameters)
+    {
+        // Ring size cannot be changed after the ring is created.
+        const string thePrefix = inPrefixPtr ? inPrefixPtr : "";
+        if (! mRingInitFlag) {
+            mQueueDepth = inParameters.getValue(
+                thePrefix + "ioUring.queueDepth", mQueueDepth);
+            if (mQueueDepth < 4) {
+                mQueueDepth = 4;
+            }
+        }
+        mSubmitBatchSize = inParameters.getValue(
+            thePrefix + "ioUring.submitBatchSize", mSubmitBatchSize);
+        if (mSubmitBatchSize < 1) {
+            mSubmitBatchSize = 1;
+        }
+    }
+    virtual void ProcessAndWait()
+    {
+        if (! mRingInitFlag) {
+            return;
+        }
+        Submit();
+        // Wait for at least one completion, the wakeup poll is always
+        // pending, therefore the wait always ends on queue wakeup.
+        struct io_uring_cqe* theCqePtr = 0;
+        const int theRet = io_uring_wait_cqe(&mRing, &theCqePtr);
+        if (theRet < 0 && theRet != -EINTR) {
+            KFS_LOG_STREAM_ERROR << mLogPrefix <<
+                "wait: " << QCUtils::SysError(-theRet) <<
+            KFS_LOG_EOM;
+        }
+        Reap();
+    }
+    virtual void Wakeup()
+    {
+        if (mEventFd < 0) {
+            return;
+        }
+        const uint64_t theVal = 1;
+        while (write(mEventFd, &theVal, sizeof(theVal)) < 0 &&
+            errno == EINTR)
+            {}
+    }
+    virtual void Stop()
+    {
+        if (mRingInitFlag) {
+            // Wait for all in flight io requests to complete, the buffers
+            // have to be returned to the disk queue.
+            Submit();
+            while (0 < mInFlightCount) {
+                struct io_uring_cqe* theCqePtr = 0;
+                const int theRet = io_uring_wait_cqe(&mRing, &theCqePtr);
+                if (theRet < 0 && theRet != -EINTR) {
+                    KFS_LOG_STREAM_FATAL << mLogPrefix <<
+                        "stop: wait: " << QCUtils::SysError(-theRet) <<
+                        " in flight: " << mInFlightCount <<
+                    KFS_LOG_EOM;
+                    break;
+                }
+                Reap();
+            }
+            io_uring_queue_exit(&mRing);
+            mRingInitFlag = false;
+            mPollPendingFlag = false;
+        }
+        if (0 <= mEventFd) {
+            close(mEventFd);
+            mEventFd = -1;
+        }
+    }
+    virtual int Open(
+        const char* inFileNamePtr,
+        bool        inReadOnlyFlag,
+        bool        inCreateFlag,
+        bool        inCreateExclusiveFlag,
+        int64_t&    ioMaxFileSize)
+    {
+        const int theFlags =
+            (inReadOnlyFlag ? O_RDONLY : O_RDWR) |
+            (inCreateFlag ? O_CREAT : 0) |
+            ((inCreateFlag && inCreateExclusiveFlag) ? O_EXCL : 0) |
+            GetOpenCommonFlags(false);
+        const int theFd = open(inFileNamePtr, theFlags, S_IRUSR | S_IWUSR);
+        if (theFd < 0) {
+            const int theErr = errno ? errno : EIO;
+            KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+                "open: " << inFileNamePtr <<
+                " "      << QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            return -theErr;
+        }
+        if (fcntl(theFd, F_SETFD, FD_CLOEXEC)) {
+            const int theErr = errno ? errno : EIO;
+            close(theFd);
+            return -theErr;
+        }
+        if (ioMaxFileSize < 0) {
+            struct stat theStat = { 0 };
+            if (fstat(theFd, &theStat)) {
+                const int theErr = errno ? errno : EIO;
+                close(theFd);
+                return -theErr;
+            }
+            ioMaxFileSize = theStat.st_size;
+        }
+        return theFd;
+    }
+    virtual int Close(
+        int     inFd,
+        int64_t inEof)
+    {
+        int theRet = 0;
+        if (0 <= inEof && ftruncate(inFd, (off_t)inEof)) {
+            theRet = errno ? errno : EIO;
+        }
+        if (close(inFd) && 0 == theRet) {
+            theRet = errno ? errno : EIO;
+        }
+        return theRet;
+    }
+    virtual void StartIo(
+        Request&        inRequest,
+        ReqType         inReqType,
+        int             inFd,
+        BlockIdx        inStartBlockIdx,
+        int             inBufferCount,
+        InputIterator*  inInputIteratorPtr,
+        int64_t         inSpaceAllocSize,
+        int64_t         /* inEof */)
+    {
+        const bool theReadFlag = QCDiskQueue::kReqTypeRead == inReqType;
+        const bool theSyncFlag = QCDiskQueue::kReqTypeWriteSync == inReqType;
+        if (! theReadFlag && ! theSyncFlag &&
+                QCDiskQueue::kReqTypeWrite != inReqType) {
+            Done(inRequest, QCDiskQueue::kErrorParameter, EINVAL, 0,
+                inStartBlockIdx);
+            return;
+        }
+        if (0 < inSpaceAllocSize) {
+            // Allocate space before the first write, the same way as the
+            // disk queue io thread does.
+            const int64_t theResv =
+                QCUtils::ReserveFileSpace(inFd, inSpaceAllocSize);
+            int theSysErr = 0;
+            if (theResv < 0) {
+                theSysErr = int(-theResv);
+            } else if (0 < theResv && ftruncate(inFd, inSpaceAllocSize)) {
+                theSysErr = errno ? errno : EIO;
+            }
+            if (0 != theSysErr) {
+                Done(inRequest, QCDiskQueue::kErrorSpaceAlloc, theSysErr, 0,
+                    inStartBlockIdx);
+                return;
+            }
+        }
+        if (inBufferCount <= 0 || ! inInputIteratorPtr) {
+            Done(inRequest, QCDiskQueue::kErrorParameter, EINVAL, 0,
+                inStartBlockIdx);
+            return;
+        }
+        IoReq& theReq = GetIoReq();
+        theReq.mRequestPtr = &inRequest;
+        theReq.mBlockIdx   = inStartBlockIdx;
+        theReq.mReadFlag   = theReadFlag;
+        theReq.mSyncFlag   = theSyncFlag;
+        theReq.mError      = QCDiskQueue::kErrorNone;
+        theReq.mSysErr     = 0;
+        theReq.mIoByteCount = 0;
+        theReq.mIoVec.clear();
+        char* thePtr;
+        while ((thePtr = inInputIteratorPtr->Get())) {
+            struct iovec theIoVec;
+            theIoVec.iov_base = thePtr;
+            theIoVec.iov_len  = mBlockSize;
+            theReq.mIoVec.push_back(theIoVec);
+        }
+        theReq.mExpectedByteCount = (int64_t)theReq.mIoVec.size() * mBlockSize;
+        const off_t theOffset = (off_t)inStartBlockIdx * mBlockSize;
+        if (theReq.mIoVec.empty() || IOV_MAX < (int)theReq.mIoVec.size() ||
+                ! mRingInitFlag) {
+            // Too many buffers for a single vector io request, or ring is
+            // not running: perform io synchronously.
+            SyncIo(theReq, inFd, theOffset, theSyncFlag);
+            return;
+        }
+        WaitInFlight(theSyncFlag ? 2 : 1);
+        struct io_uring_sqe* theSqePtr = GetSqe();
+        if (theReadFlag) {
+            io_uring_prep_readv(theSqePtr, inFd, &theReq.mIoVec.front(),
+                (unsigned int)theReq.mIoVec.size(), theOffset);
+        } else {
+            io_uring_prep_writev(theSqePtr, inFd, &theReq.mIoVec.front(),
+                (unsigned int)theReq.mIoVec.size(), theOffset);
+        }
+        io_uring_sqe_set_data(theSqePtr, &theReq);
+        theReq.mPendingCount = 1;
+        if (theSyncFlag) {
+            // Link fsync with the write, fsync completes with -ECANCELED if
+            // write fails.
+            theSqePtr->flags |= IOSQE_IO_LINK;
+            theSqePtr = GetSqe();
+            io_uring_prep_fsync(theSqePtr, inFd, 0);
+            io_uring_sqe_set_data(theSqePtr, &theReq);
+            theReq.mPendingCount++;
+        }
+        mInFlightCount += theReq.mPendingCount;
+        mUnsubmittedCount += theReq.mPendingCount;
+        if (mSubmitBatchSize <= mUnsubmittedCount) {
+            Submit();
+        }
+        // Opportunistically complete what is already done.
+        Reap();
+    }
+    virtual void StartMeta(
+        Request&    inRequest,
+        ReqType     inReqType,
+        const char* inNamePtr,
+        const char* inName2Ptr)
+    {
+        BlockIdx theBlkIdx   = -1;
+        int64_t  theRetCount = 0;
+        int      theSysErr   = 0;
+        Error    theError    = QCDiskQueue::kErrorNone;
+        switch (inReqType) {
+            case QCDiskQueue::kReqTypeDelete:
+                if (unlink(inNamePtr)) {
+                    theSysErr = errno;
+                    theError  = QCDiskQueue::kErrorDelete;
+                }
+                break;
+            case QCDiskQueue::kReqTypeRename:
+                if (! inName2Ptr || rename(inNamePtr, inName2Ptr)) {
+                    theSysErr = inName2Ptr ? errno : EINVAL;
+                    theError  = QCDiskQueue::kErrorRename;
+                }
+                break;
+            case QCDiskQueue::kReqTypeGetFsAvailable: {
+                    struct statvfs theStat;
+                    if (statvfs(inNamePtr, &theStat)) {
+                        theSysErr = errno;
+                        theError  = QCDiskQueue::kErrorGetFsAvailable;
+                    } else {
+                        theRetCount = (int64_t)theStat.f_bavail *
+                            theStat.f_frsize;
+                        theBlkIdx   = (BlockIdx)((int64_t)theStat.f_blocks *
+                            theStat.f_frsize / mBlockSize);
+                    }
+                }
+                break;
+            case QCDiskQueue::kReqTypeCheckDirReadable: {
+                    struct stat theStat = { 0 };
+                    DIR*        theDirPtr = 0;
+                    if (stat(inNamePtr, &theStat) ||
+                            ! (theDirPtr = opendir(inNamePtr)) ||
+                            closedir(theDirPtr)) {
+                        theSysErr = errno;
+                        theError  = QCDiskQueue::kErrorCheckDirReadable;
+                    }
+                }
+                break;
+            case QCDiskQueue::kReqTypeCheckDirWritable:
+                theSysErr = CheckDirWritable(inNamePtr, inName2Ptr);
+                if (theSysErr) {
+                    theError = QCDiskQueue::kErrorCheckDirWritable;
+                }
+                break;
+            case QCDiskQueue::kReqTypePreallocate:
+                theSysErr = Preallocate(inNamePtr, inName2Ptr);
+                if (theSysErr) {
+                    theError = QCDiskQueue::kErrorPreallocate;
+                }
+                break;
+            default:
+                theSysErr = EINVAL;
+                break;
+        }
+        mDiskQueuePtr->Done(
+            *this,
+            inRequest,
+            theError,
+            theSysErr,
+            theRetCount,
+            theBlkIdx
+        );
+    }
+private:
+    class IoReq
+    {
+    public:
+        typedef vector<struct iovec> IoVec;
+
+        IoReq()
+            : mRequestPtr(0),
+              mBlockIdx(0),
+              mReadFlag(false),
+              mSyncFlag(false),
+              mPendingCount(0),
+              mError(QCDiskQueue::kErrorNone),
+              mSysErr(0),
+              mIoByteCount(0),
+              mExpectedByteCount(0),
+              mNextPtr(0),
+              mIoVec()
+            {}
+        Request* mRequestPtr;
+        BlockIdx mBlockIdx;
+        bool     mReadFlag;
+        bool     mSyncFlag;
+        int      mPendingCount;
+        Error    mError;
+        int      mSysErr;
+        int64_t  mIoByteCount;
+        int64_t  mExpectedByteCount;
+        IoReq*   mNextPtr;
+        IoVec    mIoVec;
+    };
+    typedef vector<IoReq*> IoReqs;
+
+    const string   mLogPrefix;
+    QCDiskQueue*   mDiskQueuePtr;
+    int            mBlockSize;
+    int            mQueueDepth;
+    int            mSubmitBatchSize;
+    int            mEventFd;
+    bool           mRingInitFlag;
+    bool           mPollPendingFlag;
+    int            mInFlightCount;
+    int            mUnsubmittedCount;
+    IoReq*         mFreeListPtr;
+    IoReqs         mIoReqs;
+    uint64_t       mEventFdVal;
+    struct io_uring mRing;
+
+    IOURingION(
+        const char* inUrlPtr,
+        const char* inLogPrefixPtr)
+        : IOMethod(),
+          mLogPrefix(string(inLogPrefixPtr ? inLogPrefixPtr : "") +
+            (inLogPrefixPtr ? " " : "") + "io_uring " + inUrlPtr + " "),
+          mDiskQueuePtr(0),
+          mBlockSize(0),
+          mQueueDepth(256),
+          mSubmitBatchSize(8),
+          mEventFd(-1),
+          mRingInitFlag(false),
+          mPollPendingFlag(false),
+          mInFlightCount(0),
+          mUnsubmittedCount(0),
+          mFreeListPtr(0),
+          mIoReqs(),
+          mEventFdVal(0)
+        { memset(&mRing, 0, sizeof(mRing)); }
+    static int GetOpenCommonFlags(
+        bool inBufferedIoFlag)
+    {
+        return (0
+#ifdef O_DIRECT
+        | (inBufferedIoFlag ? 0 : O_DIRECT)
+#endif
+#ifdef O_NOATIME
+        | O_NOATIME
+#endif
+        );
+    }
+    bool Start()
+    {
+        mEventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (mEventFd < 0) {
+            KFS_LOG_STREAM_ERROR << mLogPrefix <<
+                "eventfd: " << QCUtils::SysError(errno) <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        const int theRet = io_uring_queue_init(
+            (unsigned int)mQueueDepth, &mRing, 0);
+        if (theRet < 0) {
+            KFS_LOG_STREAM_ERROR << mLogPrefix <<
+                "ring init: " << QCUtils::SysError(-theRet) <<
+                " queue depth: " << mQueueDepth <<
+            KFS_LOG_EOM;
+            close(mEventFd);
+            mEventFd = -1;
+            return false;
+        }
+        mRingInitFlag = true;
+        ArmPoll();
+        Submit();
+        KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+            "started:"
+            " queue depth: " << mQueueDepth <<
+            " batch: "       << mSubmitBatchSize <<
+        KFS_LOG_EOM;
+        return true;
+    }
+    void ArmPoll()
+    {
+        struct io_uring_sqe* const theSqePtr = GetSqe();
+        io_uring_prep_poll_add(theSqePtr, mEventFd, POLLIN);
+        io_uring_sqe_set_data(theSqePtr, 0);
+        mUnsubmittedCount++;
+        mPollPendingFlag = true;
+    }
+    void WaitInFlight(
+        int inCount)
+    {
+        // Keep the number of requests in flight below the ring size, in
+        // order to avoid completion queue overflow. One entry is reserved for
+        // the wakeup poll.
+        while (0 < mInFlightCount &&
+                mQueueDepth - 1 < mInFlightCount + inCount) {
+            Submit();
+            struct io_uring_cqe* theCqePtr = 0;
+            const int theRet = io_uring_wait_cqe(&mRing, &theCqePtr);
+            if (theRet < 0 && theRet != -EINTR) {
+                KFS_LOG_STREAM_FATAL << mLogPrefix <<
+                    "wait: " << QCUtils::SysError(-theRet) <<
+                KFS_LOG_EOM;
+                QCUtils::FatalError("io_uring_wait_cqe", -theRet);
+            }
+            Reap();
+        }
+    }
+    struct io_uring_sqe* GetSqe()
+    {
+        struct io_uring_sqe* theSqePtr = io_uring_get_sqe(&mRing);
+        if (! theSqePtr) {
+            Submit();
+            theSqePtr = io_uring_get_sqe(&mRing);
+            QCRTASSERT(theSqePtr);
+        }
+        return theSqePtr;
+    }
+    void Submit()
+    {
+        if (mUnsubmittedCount <= 0) {
+            return;
+        }
+        int theRet;
+        while ((theRet = io_uring_submit(&mRing)) == -EINTR ||
+                theRet == -EAGAIN)
+            {}
+        if (theRet < 0) {
+            KFS_LOG_STREAM_FATAL << mLogPrefix <<
+                "submit: " << QCUtils::SysError(-theRet) <<
+            KFS_LOG_EOM;
+            QCUtils::FatalError("io_uring_submit", -theRet);
+        }
+        mUnsubmittedCount = 0;
+    }
+    void Reap()
+    {
+        struct io_uring_cqe* theCqePtr;
+        while (io_uring_peek_cqe(&mRing, &theCqePtr) == 0 && theCqePtr) {
+            IoReq* const theReqPtr =
+                reinterpret_cast<IoReq*>(io_uring_cqe_get_data(theCqePtr));
+            const int theRes = theCqePtr->res;
+            io_uring_cqe_seen(&mRing, theCqePtr);
+            if (! theReqPtr) {
+                // Wakeup poll.
+                mPollPendingFlag = false;
+                while (read(mEventFd, &mEventFdVal, sizeof(mEventFdVal)) < 0 &&
+                    errno == EINTR)
+                    {}
+                continue;
+            }
+            mInFlightCount--;
+            IoComplete(*theReqPtr, theRes);
+        }
+        if (! mPollPendingFlag && mRingInitFlag) {
+            ArmPoll();
+            Submit();
+        }
+    }
+    void IoComplete(
+        IoReq& inReq,
+        int    inRes)
+    {
+        QCASSERT(0 < inReq.mPendingCount);
+        if (0 == inReq.mSysErr && QCDiskQueue::kErrorNone == inReq.mError) {
+            if (inRes < 0) {
+                inReq.mSysErr = -inRes;
+                inReq.mError  = inReq.mReadFlag ?
+                    QCDiskQueue::kErrorRead : QCDiskQueue::kErrorWrite;
+            } else if (inReq.mPendingCount == (inReq.mSyncFlag ? 2 : 1)) {
+                // Read or write completion, linked fsync completes last.
+                inReq.mIoByteCount = inRes;
+                if (! inReq.mReadFlag && inRes != inReq.mExpectedByteCount) {
+                    inReq.mError  = QCDiskQueue::kErrorWrite;
+                    inReq.mSysErr = EIO;
+                }
+            }
+        }
+        if (0 < --inReq.mPendingCount) {
+            return;
+        }
+        Done(*inReq.mRequestPtr, inReq.mError, inReq.mSysErr,
+            inReq.mIoByteCount, inReq.mBlockIdx);
+        PutIoReq(inReq);
+    }
+    void SyncIo(
+        IoReq& inReq,
+        int    inFd,
+        off_t  inOffset,
+        bool   inSyncFlag)
+    {
+        size_t  theIdx    = 0;
+        off_t   theOffset = inOffset;
+        Error   theError  = QCDiskQueue::kErrorNone;
+        int     theSysErr = 0;
+        int64_t theTotal  = 0;
+        while (theIdx < inReq.mIoVec.size()) {
+            const int theCnt = (int)min(
+                inReq.mIoVec.size() - theIdx, (size_t)IOV_MAX);
+            const ssize_t theExp = (ssize_t)theCnt * mBlockSize;
+            const ssize_t theNio = inReq.mReadFlag ?
+                preadv(inFd, &inReq.mIoVec[theIdx], theCnt, theOffset) :
+                pwritev(inFd, &inReq.mIoVec[theIdx], theCnt, theOffset);
+            if (theNio < 0) {
+                theSysErr = errno ? errno : EIO;
+                theError  = inReq.mReadFlag ?
+                    QCDiskQueue::kErrorRead : QCDiskQueue::kErrorWrite;
+                break;
+            }
+            theTotal += theNio;
+            if (theNio != theExp) {
+                if (! inReq.mReadFlag) {
+                    theSysErr = EIO;
+                    theError  = QCDiskQueue::kErrorWrite;
+                }
+                break;
+            }
+            theIdx    += theCnt;
+            theOffset += theExp;
+        }
+        if (inSyncFlag && QCDiskQueue::kErrorNone == theError && fsync(inFd)) {
+            theSysErr = errno ? errno : EIO;
+            theError  = QCDiskQueue::kErrorWrite;
+        }
+        Done(*inReq.mRequestPtr, theError, theSysErr, theTotal,
+            inReq.mBlockIdx);
+        PutIoReq(inReq);
+    }
+    int CheckDirWritable(
+        const char* inNamePtr,
+        const char* inName2Ptr)
+    {
+        if (! inName2Ptr) {
+            return EINVAL;
+        }
+        const char* thePtr = inName2Ptr;
+        const bool theBufferedIoFlag    = (*thePtr++ & 0xFF) != '0';
+        const bool theAllocateSpaceFlag = (*thePtr++ & 0xFF) != '0';
+        int64_t    theSize              = 0;
+        int        theSym;
+        while ((theSym = (*thePtr++ & 0xFF))) {
+            theSym -= '0';
+            theSize <<= 4;
+            theSize |= theSym & 0xF;
+        }
+        const int theFd = open(inNamePtr,
+            O_RDWR | O_CREAT | O_EXCL | GetOpenCommonFlags(theBufferedIoFlag),
+            S_IRUSR | S_IWUSR);
+        if (theFd < 0) {
+            return (errno ? errno : EIO);
+        }
+        int theSysErr = 0;
+        if (0 < theSize) {
+            if (theAllocateSpaceFlag) {
+                const int64_t theResv =
+                    QCUtils::ReserveFileSpace(theFd, theSize);
+                if (theResv < 0) {
+                    theSysErr = int(-theResv);
+                }
+            }
+            void* theBufPtr = 0;
+            if (0 == theSysErr &&
+                    0 == posix_memalign(&theBufPtr, mBlockSize, mBlockSize)) {
+                memset(theBufPtr, 0xF9, mBlockSize);
+                for (int64_t theIoBytes = 0; theIoBytes < theSize;
+                        theIoBytes += mBlockSize) {
+                    if (write(theFd, theBufPtr, mBlockSize) != mBlockSize) {
+                        theSysErr = errno ? errno : EIO;
+                        break;
+                    }
+                }
+                free(theBufPtr);
+            }
+            // Out of memory silently ignored, the same way as the disk queue
+            // ignores out of buffers.
+        }
+        if (close(theFd) && 0 == theSysErr) {
+            theSysErr = errno ? errno : EIO;
+        }
+        if (unlink(inNamePtr) && 0 == theSysErr) {
+            theSysErr = errno ? errno : EIO;
+        }
+        return theSysErr;
+    }
+    int Preallocate(
+        const char* inNamePtr,
+        const char* inName2Ptr)
+    {
+        if (! inName2Ptr) {
+            return EINVAL;
+        }
+        const char* thePtr  = inName2Ptr;
+        int64_t     theSize = 0;
+        int         theSym;
+        while ((theSym = (*thePtr++ & 0xFF))) {
+            theSym -= '0';
+            theSize <<= 4;
+            theSize |= theSym & 0xF;
+        }
+        const int theFd = open(inNamePtr,
+            O_RDWR | O_CREAT | O_EXCL | GetOpenCommonFlags(false),
+            S_IRUSR | S_IWUSR);
+        if (theFd < 0) {
+            return (errno ? errno : EIO);
+        }
+        int theSysErr = QCUtils::AllocateFileSpace(theFd, theSize);
+        if (close(theFd) && 0 == theSysErr) {
+            theSysErr = errno ? errno : EIO;
+        }
+        if (theSysErr) {
+            unlink(inNamePtr);
+        }
+        return theSysErr;
+    }
+    void Done(
+        Request& inRequest,
+        Error    inError,
+        int      inSysErr,
+        int64_t  inIoByteCount,
+        BlockIdx inBlockIdx)
+    {
+        mDiskQueuePtr->Done(
+            *this,
+            inRequest,
+            inError,
+            inSysErr,
+            inIoByteCount,
+            inBlockIdx
+        );
+    }
+    IoReq& GetIoReq()
+    {
+        if (mFreeListPtr) {
+            IoReq& theReq = *mFreeListPtr;
+            mFreeListPtr = theReq.mNextPtr;
+            theReq.mNextPtr = 0;
+            return theReq;
+        }
+        mIoReqs.push_back(new IoReq());
+        return *mIoReqs.back();
+    }
+    void PutIoReq(
+        IoReq& inReq)
+    {
+        inReq.mRequestPtr   = 0;
+        inReq.mPendingCount = 0;
+        inReq.mNextPtr      = mFreeListPtr;
+        mFreeListPtr        = &inReq;
+    }
+private:
+    IOURingION(
+        const IOURingION& inIo);
+    IOURingION& operator=(
+        const IOURingION& inIo);
+};
+
+KFS_REGISTER_IO_METHOD(KFS_IO_METHOD_NAME_IOURING, IOURingION::New);
+
+} // namespace KFS
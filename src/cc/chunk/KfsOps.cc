@@ -39,6 +39,8 @@
 #include "utils.h"
 #include "MetaServerSM.h"
 #include "ClientManager.h"
+#include "ChunkScrubber.h"
+#include "ShortCircuitServer.h"
 
 #include "common/Version.h"
 #include "common/kfstypes.h"
@@ -46,6 +48,8 @@
 #include "common/RequestParser.h"
 #include "common/kfserrno.h"
 #include "common/IntToString.h"
+#include "common/KfsTraceNew.h"
+#include "common/StatsDelta.h"
 
 #include "kfsio/Globals.h"
 #include "kfsio/checksum.h"
@@ -59,6 +63,8 @@
 #include <iomanip>
 #include <iterator>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #ifdef KFS_OS_NAME_SUNOS
 #include <sys/loadavg.h>
@@ -172,6 +178,7 @@ private:
         instance.AddCounter("Get Chunk Metadata", CMD_GET_CHUNK_METADATA);
         instance.AddCounter("Alloc", CMD_ALLOC_CHUNK);
         instance.AddCounter("Delete", CMD_DELETE_CHUNK);
+        instance.AddCounter("Delete batch", CMD_DELETE_CHUNK_BATCH);
         instance.AddCounter("Truncate", CMD_TRUNCATE_CHUNK);
         instance.AddCounter("Replicate", CMD_REPLICATE_CHUNK);
         instance.AddCounter("Heartbeat", CMD_HEARTBEAT);
@@ -428,6 +435,11 @@ KfsOp::KfsOp(KfsOp_t o, kfsSeq_t s, KfsCallbackObj* c)
       statusMsg(),
       clnt(c),
       startTime(microseconds()),
+      bufferWaitTime(0),
+      diskQueueTime(0),
+      diskIoTime(0),
+      checksumTime(0),
+      doneTime(0),
       bufferBytes(),
       next(0),
       nextOp()
@@ -469,6 +481,193 @@ KfsOp::CleanupChecker::~CleanupChecker()
     }
 }
 
+/* static */ const char*
+KfsOp::GetOpName(KfsOp_t op)
+{
+    switch (op) {
+        case CMD_UNKNOWN: return "UNKNOWN";
+        case CMD_ALLOC_CHUNK: return "ALLOC_CHUNK";
+        case CMD_DELETE_CHUNK: return "DELETE_CHUNK";
+        case CMD_TRUNCATE_CHUNK: return "TRUNCATE_CHUNK";
+        case CMD_REPLICATE_CHUNK: return "REPLICATE_CHUNK";
+        case CMD_CHANGE_CHUNK_VERS: return "CHANGE_CHUNK_VERS";
+        case CMD_BEGIN_MAKE_CHUNK_STABLE: return "BEGIN_MAKE_CHUNK_STABLE";
+        case CMD_MAKE_CHUNK_STABLE: return "MAKE_CHUNK_STABLE";
+        case CMD_COALESCE_BLOCK: return "COALESCE_BLOCK";
+        case CMD_HEARTBEAT: return "HEARTBEAT";
+        case CMD_STALE_CHUNKS: return "STALE_CHUNKS";
+        case CMD_RETIRE: return "RETIRE";
+        case CMD_DELETE_CHUNK_BATCH: return "DELETE_CHUNK_BATCH";
+        case CMD_META_HELLO: return "META_HELLO";
+        case CMD_CORRUPT_CHUNK: return "CORRUPT_CHUNK";
+        case CMD_LEASE_RENEW: return "LEASE_RENEW";
+        case CMD_LEASE_RELINQUISH: return "LEASE_RELINQUISH";
+        case CMD_SYNC: return "SYNC";
+        case CMD_CLOSE: return "CLOSE";
+        case CMD_READ: return "READ";
+        case CMD_WRITE_ID_ALLOC: return "WRITE_ID_ALLOC";
+        case CMD_WRITE_PREPARE: return "WRITE_PREPARE";
+        case CMD_WRITE_PREPARE_FWD: return "WRITE_PREPARE_FWD";
+        case CMD_WRITE_SYNC: return "WRITE_SYNC";
+        case CMD_SIZE: return "SIZE";
+        case CMD_RECORD_APPEND: return "RECORD_APPEND";
+        case CMD_SPC_RESERVE: return "SPC_RESERVE";
+        case CMD_SPC_RELEASE: return "SPC_RELEASE";
+        case CMD_GET_RECORD_APPEND_STATUS: return "GET_RECORD_APPEND_STATUS";
+        case CMD_GET_CHUNK_METADATA: return "GET_CHUNK_METADATA";
+        case CMD_PING: return "PING";
+        case CMD_STATS: return "STATS";
+        case CMD_DUMP_CHUNKMAP: return "DUMP_CHUNKMAP";
+        case CMD_HEAP_PROFILE: return "HEAP_PROFILE";
+        case CMD_NOOP: return "NOOP";
+        case CMD_CHECKPOINT: return "CHECKPOINT";
+        case CMD_WRITE: return "WRITE";
+        case CMD_WRITE_CHUNKMETA: return "WRITE_CHUNKMETA";
+        case CMD_READ_CHUNKMETA: return "READ_CHUNKMETA";
+        case CMD_KILL_REMOTE_SYNC: return "KILL_REMOTE_SYNC";
+        case CMD_TIMEOUT: return "TIMEOUT";
+        case CMD_DISKIO_COMPLETION: return "DISKIO_COMPLETION";
+        case CMD_SET_PROPERTIES: return "SET_PROPERTIES";
+        case CMD_RESTART_CHUNK_SERVER: return "RESTART_CHUNK_SERVER";
+        case CMD_EVACUATE_CHUNKS: return "EVACUATE_CHUNKS";
+        case CMD_AVAILABLE_CHUNKS: return "AVAILABLE_CHUNKS";
+        case CMD_CHUNKDIR_INFO: return "CHUNKDIR_INFO";
+        case CMD_AUTHENTICATE: return "AUTHENTICATE";
+        case CMD_NULL: return "NULL";
+        default: break;
+    }
+    return "INVALID";
+}
+
+/* static */ void
+KfsOp::ShowInFlight(ostream& os, const char* prefix)
+{
+    int64_t count[CMD_NCMDS];
+    int64_t minStart[CMD_NCMDS];
+    for (int i = 0; i < CMD_NCMDS; i++) {
+        count[i]    = 0;
+        minStart[i] = 0;
+    }
+    const int64_t now = microseconds();
+    {
+        QCStMutexLocker theLocker(sMutex);
+        OpsList::Iterator it(sOpsList);
+        const KfsOp* ptr;
+        while ((ptr = it.Next())) {
+            const int type = ptr->op;
+            if (type <= CMD_UNKNOWN || CMD_NCMDS <= type) {
+                continue;
+            }
+            if (count[type]++ <= 0 || ptr->startTime < minStart[type]) {
+                minStart[type] = ptr->startTime;
+            }
+        }
+    }
+    for (int i = 0; i < CMD_NCMDS; i++) {
+        if (count[i] <= 0) {
+            continue;
+        }
+        os << prefix << GetOpName(KfsOp_t(i)) << ": " << count[i] << "," <<
+            max(int64_t(0), now - minStart[i]) << "\r\n";
+    }
+}
+
+static const char* const kOpPhaseNames[KfsOpPhaseStats::kPhaseCount] = {
+    "total",
+    "buffer-wait",
+    "disk-queue",
+    "disk-io",
+    "checksum",
+    "response"
+};
+
+KfsOpPhaseStats::KfsOpPhaseStats()
+{
+    KfsOpPhaseStats::Clear();
+}
+
+void
+KfsOpPhaseStats::Clear()
+{
+    memset(mCounters, 0, sizeof(mCounters));
+}
+
+inline static int
+OpPhaseBucket(int64_t usec)
+{
+    int idx = 0;
+    while (idx < KfsOpPhaseStats::kBucketCount - 1 &&
+            (int64_t(1) << idx) <= usec) {
+        idx++;
+    }
+    return idx;
+}
+
+void
+KfsOpPhaseStats::Update(const KfsOp& op, int64_t now)
+{
+    if (op.op <= CMD_UNKNOWN || CMD_NCMDS <= op.op) {
+        return;
+    }
+    int64_t times[kPhaseCount];
+    times[kPhaseTotal]      = now - op.startTime;
+    times[kPhaseBufferWait] = op.bufferWaitTime;
+    times[kPhaseDiskQueue]  = op.diskQueueTime;
+    times[kPhaseDiskIo]     = op.diskIoTime;
+    times[kPhaseChecksum]   = op.checksumTime;
+    times[kPhaseResponse]   = 0 < op.doneTime ? now - op.doneTime : 0;
+    Counters& counters = mCounters[op.op];
+    counters.mCount++;
+    for (int i = 0; i < kPhaseCount; i++) {
+        const int64_t t = max(int64_t(0), times[i]);
+        counters.mTotal[i] += t;
+        counters.mHist[i][OpPhaseBucket(t)]++;
+    }
+}
+
+KfsOpPhaseStats&
+KfsOpPhaseStats::Add(const KfsOpPhaseStats& stats)
+{
+    for (int k = 0; k < CMD_NCMDS; k++) {
+        Counters&       dst = mCounters[k];
+        const Counters& src = stats.mCounters[k];
+        dst.mCount += src.mCount;
+        for (int i = 0; i < kPhaseCount; i++) {
+            dst.mTotal[i] += src.mTotal[i];
+            for (int b = 0; b < kBucketCount; b++) {
+                dst.mHist[i][b] += src.mHist[i][b];
+            }
+        }
+    }
+    return *this;
+}
+
+void
+KfsOpPhaseStats::Display(ostream& os, const char* prefix,
+    bool totalOnlyFlag) const
+{
+    const int phaseCount = totalOnlyFlag ? kPhaseTotal + 1 : kPhaseCount;
+    for (int k = 0; k < CMD_NCMDS; k++) {
+        const Counters& counters = mCounters[k];
+        if (counters.mCount <= 0) {
+            continue;
+        }
+        const char* const name = KfsOp::GetOpName(KfsOp_t(k));
+        for (int i = 0; i < phaseCount; i++) {
+            os << prefix << name << "-" << kOpPhaseNames[i] << ": " <<
+                counters.mCount << "," << counters.mTotal[i];
+            int last = kBucketCount;
+            while (0 < last && counters.mHist[i][last - 1] <= 0) {
+                last--;
+            }
+            for (int b = 0; b < last; b++) {
+                os << "," << counters.mHist[i][b];
+            }
+            os << "\r\n";
+        }
+    }
+}
+
 /* static */ uint32_t
 KfsOp::Checksum(
     const char* name,
@@ -492,6 +691,147 @@ KfsOp::FindDeviceBufferManager(kfsChunkId_t chunkId, int64_t chunkVersion)
     return gChunkManager.FindDeviceBufferManager(chunkId, chunkVersion);
 }
 
+// Per thread cache of successfully verified chunk access tokens. Clients
+// typically issue many chunk requests with the same chunk access token, and
+// the token verification, HMAC computation in particular, is relatively
+// expensive. The cache is per thread, as the requests are parsed and validated
+// by the client threads without holding the global mutex.
+class ChunkAccessTokenCache
+{
+public:
+    static bool Process(
+        kfsChunkId_t inChunkId,
+        const char*  inTokenPtr,
+        int          inTokenLen,
+        int64_t      inSubjectId,
+        time_t       inNow,
+        kfsUid_t&    outUid,
+        uint16_t&    outFlags,
+        string*      outErrMsgPtr)
+    {
+        const int theSize = sSize;
+        if (theSize <= 0 || kMaxTokenLen < inTokenLen) {
+            return Verify(inChunkId, inTokenPtr, inTokenLen, inSubjectId, inNow,
+                outUid, outFlags, outErrMsgPtr, 0);
+        }
+        Entries* theEntriesPtr = sEntriesPtr;
+        if (! theEntriesPtr || (int)theEntriesPtr->size() != theSize) {
+            delete theEntriesPtr;
+            sEntriesPtr = theEntriesPtr = new Entries(theSize);
+        }
+        Entry& theEntry = (*theEntriesPtr)[
+            Hash(inChunkId, inTokenPtr, inTokenLen) % theSize];
+        if (inNow < theEntry.mExpires &&
+                theEntry.mChunkId   == inChunkId &&
+                theEntry.mSubjectId == inSubjectId &&
+                theEntry.mToken.size() == (size_t)inTokenLen &&
+                memcmp(theEntry.mToken.data(), inTokenPtr, inTokenLen) == 0) {
+            outUid   = theEntry.mUid;
+            outFlags = theEntry.mFlags;
+            return true;
+        }
+        return Verify(inChunkId, inTokenPtr, inTokenLen, inSubjectId, inNow,
+            outUid, outFlags, outErrMsgPtr, &theEntry);
+    }
+    static void SetParameters(
+        const Properties& inProps)
+    {
+        sSize = max(0, inProps.getValue(
+            "chunkServer.chunkAccessTokenCache.size", sSize));
+        sMaxAgeSec = inProps.getValue(
+            "chunkServer.chunkAccessTokenCache.maxAgeSec", sMaxAgeSec);
+    }
+private:
+    enum { kMaxTokenLen = 512 };
+    struct Entry
+    {
+        Entry()
+            : mChunkId(-1),
+              mSubjectId(-1),
+              mExpires(0),
+              mUid(kKfsUserNone),
+              mFlags(0),
+              mToken()
+            {}
+        kfsChunkId_t mChunkId;
+        int64_t      mSubjectId;
+        time_t       mExpires;
+        kfsUid_t     mUid;
+        uint16_t     mFlags;
+        string       mToken;
+    };
+    typedef vector<Entry> Entries;
+
+    static __thread Entries* sEntriesPtr;
+    static int               sSize;
+    static int               sMaxAgeSec;
+
+    static bool Verify(
+        kfsChunkId_t inChunkId,
+        const char*  inTokenPtr,
+        int          inTokenLen,
+        int64_t      inSubjectId,
+        time_t       inNow,
+        kfsUid_t&    outUid,
+        uint16_t&    outFlags,
+        string*      outErrMsgPtr,
+        Entry*       inEntryPtr)
+    {
+        ChunkAccessToken theToken;
+        if (! theToken.Process(
+                inChunkId,
+                inTokenPtr,
+                inTokenLen,
+                inNow,
+                gChunkManager.GetCryptoKeys(),
+                outErrMsgPtr,
+                inSubjectId)) {
+            return false;
+        }
+        outUid   = theToken.Get().GetUid();
+        outFlags = theToken.Get().GetFlags();
+        if (inEntryPtr) {
+            // Limit the cached entry lifetime, in order to bound the time the
+            // token remains valid after its crypto key removal.
+            inEntryPtr->mChunkId   = inChunkId;
+            inEntryPtr->mSubjectId = inSubjectId;
+            inEntryPtr->mExpires   = (time_t)min(
+                theToken.Get().GetIssuedTime() +
+                    (int64_t)theToken.Get().GetValidForSec(),
+                (int64_t)inNow + max(0, sMaxAgeSec));
+            inEntryPtr->mUid       = outUid;
+            inEntryPtr->mFlags     = outFlags;
+            inEntryPtr->mToken.assign(inTokenPtr, inTokenLen);
+        }
+        return true;
+    }
+    static size_t Hash(
+        kfsChunkId_t inChunkId,
+        const char*  inTokenPtr,
+        int          inTokenLen)
+    {
+        // FNV-1a
+        uint64_t theHash = 14695981039346656037ULL ^ (uint64_t)inChunkId;
+        const unsigned char*       thePtr = (const unsigned char*)inTokenPtr;
+        const unsigned char* const theEndPtr = thePtr + inTokenLen;
+        while (thePtr < theEndPtr) {
+            theHash ^= *thePtr++;
+            theHash *= 1099511628211ULL;
+        }
+        return (size_t)(theHash ^ (theHash >> 32));
+    }
+};
+
+__thread ChunkAccessTokenCache::Entries* ChunkAccessTokenCache::sEntriesPtr = 0;
+int ChunkAccessTokenCache::sSize      = 256;
+int ChunkAccessTokenCache::sMaxAgeSec = 60;
+
+/* static */ void
+KfsClientChunkOp::SetParameters(const Properties& props)
+{
+    ChunkAccessTokenCache::SetParameters(props);
+}
+
 inline bool
 KfsClientChunkOp::Validate()
 {
@@ -499,17 +839,19 @@ KfsClientChunkOp::Validate()
         return false;
     }
     if ((hasChunkAccessTokenFlag = ! chunkAccessVal.empty())) {
-        ChunkAccessToken token;
-        if ((chunkAccessTokenValidFlag = token.Process(
+        kfsUid_t uid   = kKfsUserNone;
+        uint16_t flags = 0;
+        if ((chunkAccessTokenValidFlag = ChunkAccessTokenCache::Process(
                 chunkId,
                 chunkAccessVal.mPtr,
                 chunkAccessVal.mLen,
+                subjectId,
                 globalNetManager().Now(),
-                gChunkManager.GetCryptoKeys(),
-                &statusMsg,
-                subjectId))) {
-            chunkAccessUid   = token.Get().GetUid();
-            chunkAccessFlags = token.Get().GetFlags();
+                uid,
+                flags,
+                &statusMsg))) {
+            chunkAccessUid   = uid;
+            chunkAccessFlags = flags;
         }
         chunkAccessVal.clear();
     }
@@ -639,6 +981,8 @@ MakeClientRequestHandler()
     .MakeParser<PingOp                  >("PING")
     .MakeParser<DumpChunkMapOp          >("DUMP_CHUNKMAP")
     .MakeParser<StatsOp                 >("STATS")
+    .MakeParser<HeapProfileOp           >("HEAP_PROFILE")
+    .MakeParser<NoopOp                  >("NOOP")
     ;
 }
 
@@ -650,6 +994,7 @@ MakeMetaRequestHandler()
     return MakeCommonRequestHandler(sHandler)
     .MakeParser<AllocChunkOp            >("ALLOCATE")
     .MakeParser<DeleteChunkOp           >("DELETE")
+    .MakeParser<DeleteChunkBatchOp      >("DELETE_BATCH")
     .MakeParser<TruncateChunkOp         >("TRUNCATE")
     .MakeParser<ReplicateChunkOp        >("REPLICATE")
     .MakeParser<HeartbeatOp             >("HEARTBEAT")
@@ -786,6 +1131,76 @@ WriteSyncOp::Validate()
     return KfsClientChunkOp::Validate();
 }
 
+bool
+ReadOp::Validate()
+{
+    if (rangeCount <= 0) {
+        return KfsClientChunkOp::Validate();
+    }
+    // The ranges header size is bounded by the max request header size.
+    const char*       ptr = rangesStr.GetPtr();
+    const char* const end = ptr + rangesStr.GetSize();
+    int64_t           start = -1;
+    int64_t           last  = -1;
+    ranges.clear();
+    ranges.reserve(2 * rangeCount);
+    for (int i = 0; i < 2 * rangeCount; i++) {
+        int64_t val = -1;
+        if (! ValueParser::ParseInt(ptr, end - ptr, val)) {
+            return false;
+        }
+        ranges.push_back(val);
+        while (ptr < end && (*ptr & 0xFF) > ' ') {
+            ++ptr;
+        }
+        if ((i & 1) == 0) {
+            if (val < 0) {
+                return false;
+            }
+            continue;
+        }
+        const int64_t pos = ranges[i - 1];
+        if (val <= 0 || (int64_t)CHUNKSIZE - pos < val) {
+            return false;
+        }
+        start = start < 0 ? pos : min(start, pos);
+        last  = max(last, pos + val);
+    }
+    // Read all ranges with a single disk read of the ranges extent.
+    offset   = start;
+    numBytes = (size_t)(last - start);
+    return KfsClientChunkOp::Validate();
+}
+
+void
+ReadOp::ExtractRanges()
+{
+    // Replace the read data with the concatenation of the ranges data, and
+    // replace the checksums of the extent with the checksum of each range.
+    IOBuffer buf;
+    checksum.clear();
+    rangesStr.clear();
+    for (size_t i = 0; i + 1 < ranges.size(); i += 2) {
+        const int64_t pos = ranges[i] - offset;
+        const int64_t len = max(int64_t(0),
+            min(pos + ranges[i + 1], (int64_t)numBytesIO) - pos);
+        ranges[i + 1] = len;
+        if (len <= 0) {
+            checksum.push_back(kKfsNullChecksum);
+            continue;
+        }
+        IOBuffer tmp;
+        tmp.Copy(&dataBuf, (int)(pos + len));
+        tmp.Consume((int)pos);
+        checksum.push_back(ComputeBlockChecksum(&tmp, (size_t)len));
+        buf.Move(&tmp);
+    }
+    dataBuf.Clear();
+    dataBuf.Move(&buf);
+    numBytesIO = dataBuf.BytesConsumable();
+    status     = numBytesIO;
+}
+
 bool MakeChunkStableOp::Validate()
 {
     hasChecksum = ! checksumStr.empty();
@@ -812,6 +1227,14 @@ KfsOp::HandleDone(int code, void *data)
     return 0;
 }
 
+ReadOp::~ReadOp()
+{
+    assert(! wop);
+    if (0 <= sendFileFd) {
+        close(sendFileFd);
+    }
+}
+
 ///
 /// A read op finished.  Set the status and the # of bytes read
 /// alongwith the data and notify the client.
@@ -819,6 +1242,7 @@ KfsOp::HandleDone(int code, void *data)
 int
 ReadOp::HandleDone(int code, void *data)
 {
+    int64_t checksumStart = 0;
     if (code == EVENT_DISK_ERROR) {
         status = -1;
         if (data) {
@@ -840,8 +1264,11 @@ ReadOp::HandleDone(int code, void *data)
         // Order matters...when we append b, we take the data from b
         // and put it into our buffer.
         dataBuf.Move(b);
+        DiskIoDone(diskIo.get());
+        checksumStart = microseconds();
         // verify checksum
         if (! gChunkManager.ReadChunkDone(this)) {
+            checksumTime += microseconds() - checksumStart;
             return 0; // Retry.
         }
         numBytesIO = dataBuf.BytesConsumable();
@@ -872,6 +1299,14 @@ ReadOp::HandleDone(int code, void *data)
             assert((size_t)((numBytesIO + CHECKSUM_BLOCKSIZE - 1) /
                 CHECKSUM_BLOCKSIZE) == checksum.size());
         }
+        if (sendFileFlag && 0 < numBytesIO && ! wop && ! scrubOp &&
+                ranges.empty()) {
+            // Has to be done before releasing disk io below.
+            gChunkManager.ReadSendFileSetup(this);
+        }
+    }
+    if (0 < checksumStart) {
+        checksumTime += microseconds() - checksumStart;
     }
 
     if (wop) {
@@ -899,6 +1334,9 @@ ReadOp::HandleDone(int code, void *data)
         KFS_LOG_EOM;
         gChunkManager.CloseChunk(chunkId, ci->chunkVersion);
     }
+    if (0 <= status && ! ranges.empty()) {
+        ExtractRanges();
+    }
 
     gLogger.Submit(this);
     return 0;
@@ -1000,6 +1438,9 @@ WriteOp::HandleWriteDone(int code, void *data)
 {
     // DecrementCounter(CMD_WRITE);
 
+    if (wpop) {
+        wpop->DiskIoDone(diskIo.get());
+    }
     gChunkManager.WriteDone(this);
     if (isFromReReplication) {
         if (code == EVENT_DISK_WROTE) {
@@ -1385,6 +1826,52 @@ DeleteChunkOp::Done(int code, void* data)
     return 0;
 }
 
+bool
+DeleteChunkBatchOp::ParseContent(istream& is)
+{
+    if (status != 0) {
+        return false;
+    }
+    if (numChunks < 0) {
+        statusMsg = "invalid chunk count";
+        status    = -EINVAL;
+        return false;
+    }
+    kfsChunkId_t c = -1;
+    chunkIds.reserve(numChunks);
+    const istream::fmtflags isFlags = is.flags();
+    is >> hex;
+    for (int i = 0; i < numChunks; ++i) {
+        if (! (is >> c)) {
+            statusMsg = "failed to parse delete batch request: expected: ";
+            AppendDecIntToString(statusMsg, numChunks)
+                .append(" got: ");
+            AppendDecIntToString(statusMsg, i);
+            status = -EINVAL;
+            break;
+        }
+        chunkIds.push_back(c);
+    }
+    is.flags(isFlags);
+    return (status == 0);
+}
+
+void
+DeleteChunkBatchOp::Execute()
+{
+    status     = 0;
+    numDeleted = 0;
+    for (ChunkIds::const_iterator it = chunkIds.begin();
+            it != chunkIds.end();
+            ++it) {
+        if (gChunkManager.DeleteChunk(*it, 0) == 0) {
+            numDeleted++;
+        }
+    }
+    KFS_LOG_STREAM_DEBUG << Show() << KFS_LOG_EOM;
+    gLogger.Submit(this);
+}
+
 void
 TruncateChunkOp::Execute()
 {
@@ -1590,16 +2077,96 @@ AppendStorageTiersInfo(ostream& os, const ChunkManager::StorageTiersInfo& tiersI
     os << "\r\n";
 }
 
-// This is the heartbeat sent by the meta server
-void
-HeartbeatOp::Execute()
+// Always emit hot chunks, even if the list is empty, in order to clear the
+// previously reported list on the meta server with the heartbeat delta.
+inline static void
+AppendHotChunks(ostream** os)
+{
+    static ChunkManager::HotChunks sHotChunks;
+    gChunkManager.GetHotChunks(sHotChunks);
+    *os[0] << "Hot-chunks: " << sHotChunks.size();
+    for (ChunkManager::HotChunks::const_iterator it = sHotChunks.begin();
+            it != sHotChunks.end();
+            ++it) {
+        *os[0] << " " << it->first << " " << it->second;
+    }
+    *os[0] << "\r\n";
+    if (os[1]) {
+        *os[1] << " hot: " << sHotChunks.size();
+    }
+}
+
+// Heartbeat delta: if the meta server has the previous heartbeat response,
+// then send only the counters that have changed since. The counters are
+// emitted in the same order every time, therefore the lines are compared
+// by position. Any key mismatch results in sending all counters.
+static bool
+HBDiff(const string& prev, const string& cur, string& delta)
+{
+    size_t pp = 0;
+    size_t cp = 0;
+    while (cp < cur.size()) {
+        size_t ce = cur.find('\n', cp);
+        if (ce == string::npos) {
+            ce = cur.size() - 1;
+        }
+        size_t pe = prev.find('\n', pp);
+        if (pe == string::npos) {
+            return false;
+        }
+        size_t kc = cur.find(':', cp);
+        if (ce < kc) {
+            kc = ce;
+        }
+        const size_t klen = kc - cp + 1;
+        if (pe + 1 - pp < klen || cur.compare(cp, klen, prev, pp, klen) != 0) {
+            return false;
+        }
+        if (cur.compare(cp, ce + 1 - cp, prev, pp, pe + 1 - pp) != 0) {
+            delta.append(cur, cp, ce + 1 - cp);
+        }
+        cp = ce + 1;
+        pp = pe + 1;
+    }
+    return (pp == prev.size());
+}
+
+static void
+HBDelta(IOBuffer& response, kfsSeq_t seq, int64_t deltaSeq)
+{
+    static string   sPrev;
+    static string   sCur;
+    static string   sDelta;
+    static kfsSeq_t sPrevSeq = -1;
+
+    const int len = response.BytesConsumable();
+    sCur.resize(len);
+    if (0 < len) {
+        response.CopyOut(&sCur[0], len);
+    }
+    if (0 <= deltaSeq && deltaSeq == sPrevSeq) {
+        sDelta = "Delta-seq: ";
+        AppendDecIntToString(sDelta, deltaSeq).append("\r\n");
+        if (HBDiff(sPrev, sCur, sDelta)) {
+            sDelta.append("\r\n");
+            response.Clear();
+            response.CopyIn(sDelta.data(), (int)sDelta.size());
+        }
+        sDelta.clear();
+    }
+    sPrev.swap(sCur);
+    sPrevSeq = seq;
+}
+
+// Append all heartbeat counters. Used by the heartbeat, and by the metrics
+// scrape endpoint snapshot.
+/* static */ void
+HeartbeatOp::AppendCounters(ostream** os)
 {
     double loadavg[3] = {-1, -1, -1};
 #ifndef KFS_OS_NAME_CYGWIN
     getloadavg(loadavg, 3);
 #endif
-    gChunkManager.MetaHeartbeat(*this);
-
     const int64_t writeCount       = gChunkManager.GetNumWritableChunks();
     const int64_t writeAppendCount =
         gAtomicRecordAppendManager.GetOpenAppendersCount();
@@ -1620,21 +2187,6 @@ HeartbeatOp::Execute()
     int64_t devWaitAvgUsec         = 0;
     ChunkManager::StorageTiersInfo tiersInfo;
 
-    static IOBuffer::WOStream sWOs;
-    static ostringstream      sOs;
-    ostream* os[2];
-    os[0] = &sWOs.Set(response);
-    if (MsgLogger::GetLogger() &&
-            MsgLogger::GetLogger()->IsLogLevelEnabled(
-                MsgLogger::kLogLevelDEBUG)) {
-        cmdShow.clear();
-        cmdShow.reserve(2 << 10);
-        sOs.str(cmdShow);
-        cmdShow = string(); // De-reference.
-        os[1] = &sOs;
-    } else {
-        os[1] = 0;
-    }
     HBAppend(os, 0, "space", "");
     HBAppend(os, "Total-space",    "total",  gChunkManager.GetTotalSpace(
         totalFsSpace, chunkDirs, evacuateInFlightCount, writableDirs,
@@ -1660,6 +2212,8 @@ HeartbeatOp::Execute()
     HBAppend(os, "Evacuate-done-bytes",   "evac-d-b", evacuateDoneByteCount);
     HBAppend(os, "Evacuate-in-flight",    "evac-fl",  evacuateInFlightCount);
     AppendStorageTiersInfo(*os[0], tiersInfo);
+    HBAppend(os, "Memory-tiers",          "memtiers",
+        gChunkManager.GetMemoryStorageTiersMask());
     HBAppend(os, "Num-random-writes",     "rwr",  writeCount);
     HBAppend(os, "Num-appends",           "awr",  writeAppendCount);
     HBAppend(os, "Num-re-replications",   "rep",  replicationCount);
@@ -1686,6 +2240,8 @@ HeartbeatOp::Execute()
     HBAppend(os, 0, "rdchksum", "");
     HBAppend(os, "Read-chksum",               "rcs", cm.mReadChecksumCount);
     HBAppend(os, "Read-chksum-bytes",         "rcb", cm.mReadChecksumByteCount);
+    HBAppend(os, "Read-chksum-verified-bytes", "rvb",
+        cm.mReadChecksumVerifiedByteCount);
     HBAppend(os, "Read-chksum-skip",          "rsv",
         cm.mReadSkipDiskVerifyCount);
     HBAppend(os, "Read-chksum-skip-err",      "rse",
@@ -1694,6 +2250,64 @@ HeartbeatOp::Execute()
         cm.mReadSkipDiskVerifyByteCount);
     HBAppend(os, "Read-chksum-skip-cs-bytes", "rsc",
         cm.mReadSkipDiskVerifyChecksumByteCount);
+    HBAppend(os, 0, "sendfile", "");
+    HBAppend(os, "Read-sendfile",       "cnt",   cm.mReadSendFileCount);
+    HBAppend(os, "Read-sendfile-bytes", "bytes", cm.mReadSendFileByteCount);
+    HBAppend(os, "Read-sendfile-skip",  "skip",  cm.mReadSendFileSkipCount);
+    HBAppend(os, 0, "metacache", "");
+    HBAppend(os, "Chunk-meta-cache-hit",   "hit",   cm.mChunkMetaCacheHitCount);
+    HBAppend(os, "Chunk-meta-cache-evict", "evict",
+        cm.mChunkMetaCacheEvictCount);
+    HBAppend(os, 0, "readahead", "");
+    HBAppend(os, "Read-ahead-count", "cnt",   cm.mReadAheadCount);
+    HBAppend(os, "Read-ahead-bytes", "bytes", cm.mReadAheadByteCount);
+    HBAppend(os, "Read-ahead-hit",   "hit",   cm.mReadAheadHitCount);
+    HBAppend(os, "Read-ahead-hit-bytes", "hbytes",
+        cm.mReadAheadHitByteCount);
+    HBAppend(os, 0, "wrcoalesce", "");
+    HBAppend(os, "Write-coalesce-count", "cnt", cm.mWriteCoalesceCount);
+    HBAppend(os, "Write-coalesce-ops",   "ops", cm.mWriteCoalesceOpCount);
+    HBAppend(os, "Write-coalesce-bytes", "bytes",
+        cm.mWriteCoalesceByteCount);
+    HBAppend(os, 0, "chunkpool", "");
+    HBAppend(os, "Chunk-file-pool-hit",  "hit",  cm.mChunkFilePoolHitCount);
+    HBAppend(os, "Chunk-file-pool-miss", "miss", cm.mChunkFilePoolMissCount);
+    HBAppend(os, 0, "destage", "");
+    HBAppend(os, "Staged-chunks",        "staged", cm.mStagedChunkCount);
+    HBAppend(os, "Destage-count",        "cnt",    cm.mDestageCount);
+    HBAppend(os, "Destage-bytes",        "bytes",  cm.mDestageByteCount);
+    HBAppend(os, "Destage-errors",       "err",    cm.mDestageErrorCount);
+    HBAppend(os, "Destage-aborts",       "abort",  cm.mDestageAbortCount);
+    HBAppend(os, 0, "reclaim", "");
+    HBAppend(os, "Reclaim-count",   "cnt",     cm.mReclaimCount);
+    HBAppend(os, "Reclaim-bytes",   "bytes",   cm.mReclaimByteCount);
+    HBAppend(os, "Reclaim-errors",  "err",     cm.mReclaimErrorCount);
+    HBAppend(os, "Reclaim-pending", "pending", cm.mReclaimPendingByteCount);
+    HBAppend(os, 0, "slowdir", "");
+    HBAppend(os, "Slow-dirs",        "slow",   cm.mSlowDirCount);
+    HBAppend(os, "Slow-dir-detects", "detect", cm.mSlowDirDetectCount);
+    HBAppend(os, 0, "fdcache", "");
+    HBAppend(os, "Fd-cache-open",          "open",   cm.mFdOpenCount);
+    HBAppend(os, "Fd-cache-evict",         "evict",  cm.mFdEvictCount);
+    HBAppend(os, "Fd-cache-reopen",        "reopen", cm.mFdReopenCount);
+    HBAppend(os, "Fd-cache-hot-keep",      "hotkeep",
+        cm.mFdHotKeepCount);
+    HBAppend(os, "Fd-cache-second-chance", "second",
+        cm.mFdSecondChanceCount);
+    DirChecker::Counters dc;
+    gChunkManager.GetDirCheckerCounters(dc);
+    HBAppend(os, 0, "dirscan", "");
+    HBAppend(os, "Dir-scan-count",     "cnt",    dc.mDirScanCount);
+    HBAppend(os, "Dir-scan-chunks",    "chunks", dc.mChunkFileCount);
+    HBAppend(os, "Dir-scan-time-usec", "usec",   dc.mScanTimeMicroSec);
+    HBAppend(os, "Dir-scan-inventory-loaded",  "inv",
+        dc.mInventoryLoadCount);
+    HBAppend(os, "Dir-scan-inventory-invalid", "invinv",
+        dc.mInventoryInvalidCount);
+    HBAppend(os, "Dir-scan-inventory-writes",  "invwr",
+        dc.mInventoryWriteCount);
+    HBAppend(os, "Dir-scan-inventory-write-errors", "invwrerr",
+        dc.mInventoryWriteErrorCount);
 
     MetaServerSM::Counters mc;
     gMetaServerSM.GetCounters(mc);
@@ -1752,6 +2366,39 @@ HeartbeatOp::Execute()
     HBAppend(os, "Timer-overrun-sec",   "sec",
         globalNetManager().GetTimerOverrunSec());
 
+    NetManager::EventStats evStats[2];
+    globalNetManager().GetEventStats(evStats[0]);
+    gClientManager.GetClientThreadsEventStats(evStats[1]);
+    for (int i = 0; i < 2; i++) {
+        const NetManager::EventStats& st   = evStats[i];
+        const char* const             pref = i == 0 ? "Net-main-" : "Net-cli-";
+        HBAppend(os, 0, i == 0 ? "evloop: main" : "evloop: cli", "");
+        ostringstream loopHist;
+        ostringstream dispHist;
+        for (int k = 0; k < NetManager::EventStats::kHistogramSize; k++) {
+            loopHist << (0 < k ? "," : "") << st.mLoopHistogram[k];
+            dispHist << (0 < k ? "," : "") << st.mDispatchHistogram[k];
+        }
+        HBAppend(os, (string(pref) + "loop-count").c_str(),    "lcnt",
+            st.mLoopCount);
+        HBAppend(os, (string(pref) + "loop-max-usec").c_str(), "lmax",
+            st.mLoopMaxUsec);
+        HBAppend(os, (string(pref) + "loop-hist").c_str(),     "lh",
+            loopHist.str());
+        HBAppend(os, (string(pref) + "dispatch-count").c_str(), "dcnt",
+            st.mDispatchCount);
+        HBAppend(os, (string(pref) + "dispatch-max-usec").c_str(), "dmax",
+            st.mDispatchMaxUsec);
+        HBAppend(os, (string(pref) + "dispatch-slow").c_str(), "slow",
+            st.mSlowDispatchCount);
+        HBAppend(os, (string(pref) + "dispatch-hist").c_str(), "dh",
+            dispHist.str());
+    }
+    KfsOpPhaseStats* const phaseStats = new KfsOpPhaseStats();
+    gClientManager.GetOpPhaseStats(*phaseStats);
+    phaseStats->Display(*os[0], "Op-latency-", true);
+    delete phaseStats;
+
     HBAppend(os, 0, "wappend", "");
     HBAppend(os, "Write-appenders", "cur",
         gAtomicRecordAppendManager.GetAppendersCount());
@@ -1811,6 +2458,7 @@ HeartbeatOp::Execute()
     HBAppend(os, "WAppend-lost-chunks",   "csum", wa.mLostChunkCount);
     HBAppend(os, "WAppend-pending-bytes", "pbt",  wa.mPendingByteCount);
     HBAppend(os, "WAppend-low-buf-flush", "lobf", wa.mLowOnBuffersFlushCount);
+    HBAppend(os, "WAppend-group-flush-defer", "gfd", wa.mGroupFlushDeferCount);
 
     const BufferManager&  bufMgr = DiskIo::GetBufferManager();
     HBAppend(os, 0, "buffers: bytes", "");
@@ -1856,6 +2504,18 @@ HeartbeatOp::Execute()
         bmCnts.mOverQuotaRequestDeniedCount);
     HBAppend(os, "Buffer-req-denied-quota-bytes", "bdq",
         bmCnts.mOverQuotaRequestDeniedByteCount);
+    for (int i = 0; i < BufferManager::kRequestClassCount; i++) {
+        const BufferManager::RequestClass cls = BufferManager::RequestClass(i);
+        string key1("Buffer-wait-hist-");
+        string key2("wh-");
+        key1 += BufferManager::GetRequestClassName(cls);
+        key2 += BufferManager::GetRequestClassName(cls);
+        ostringstream hist;
+        for (int k = 0; k < BufferManager::kWaitHistogramBucketCount; k++) {
+            hist << (0 < k ? "," : "") << bmCnts.mWaitHistogram[i][k];
+        }
+        HBAppend(os, key1.c_str(), key2.c_str(), hist.str());
+    }
 
     DiskIo::Counters dio;
     DiskIo::GetCounters(dio);
@@ -1870,6 +2530,13 @@ HeartbeatOp::Execute()
     HBAppend(os, 0, "sync", "");
     HBAppend(os, "Disk-sync-count", "cnt",   dio.mSyncCount);
     HBAppend(os, "Disk-sync-errors","err",   dio.mSyncErrorCount);
+    HBAppend(os, "Disk-sync-timed-count",   "tcnt",   dio.mSyncTimedCount);
+    HBAppend(os, "Disk-sync-time-usec",     "usec",   dio.mSyncTimeMicroSec);
+    HBAppend(os, "Disk-sync-max-time-usec", "maxusec",
+        dio.mSyncMaxTimeMicroSec);
+    HBAppend(os, "Disk-write-behind-count", "wbcnt",  dio.mWriteBehindCount);
+    HBAppend(os, "Disk-write-behind-bytes", "wbbytes",
+        dio.mWriteBehindByteCount);
     HBAppend(os, 0, "del", "");
     HBAppend(os, "Disk-delete-count", "cnt",   dio.mDeleteCount);
     HBAppend(os, "Disk-delete-errors","err",   dio.mDeleteErrorCount);
@@ -1890,6 +2557,11 @@ HeartbeatOp::Execute()
         dio.mCheckDirWritableCount);
     HBAppend(os, "Disk-dir-writable-errors","wer",
         dio.mCheckDirWritableErrorCount);
+    HBAppend(os, 0, "prealloc", "");
+    HBAppend(os, "Disk-preallocate-count",  "cnt",
+        dio.mPreallocateCount);
+    HBAppend(os, "Disk-preallocate-errors", "err",
+        dio.mPreallocateErrorCount);
     HBAppend(os, 0, "timedout", "");
     HBAppend(os, "Disk-timedout-count",      "cnt",
         dio.mTimedOutErrorCount);
@@ -1899,6 +2571,58 @@ HeartbeatOp::Execute()
         dio.mTimedOutErrorWriteByteCount);
     HBAppend(os, "Disk-open-files",          "fopen",
         dio.mOpenFilesCount);
+    HBAppend(os, 0, "pagecache", "");
+    HBAppend(os, "Disk-page-cache-hit",       "hit",
+        dio.mPageCacheHitCount);
+    HBAppend(os, "Disk-page-cache-hit-bytes", "hitbytes",
+        dio.mPageCacheHitByteCount);
+    HBAppend(os, "Disk-page-cache-miss",      "miss",
+        dio.mPageCacheMissCount);
+    HBAppend(os, "Disk-page-cache-miss-bytes","missbytes",
+        dio.mPageCacheMissByteCount);
+    HBAppend(os, 0, "objstorecache", "");
+    HBAppend(os, "Obj-store-cache-hit",         "hit",
+        dio.mObjStoreCacheHitCount);
+    HBAppend(os, "Obj-store-cache-hit-bytes",   "hitbytes",
+        dio.mObjStoreCacheHitByteCount);
+    HBAppend(os, "Obj-store-cache-miss",        "miss",
+        dio.mObjStoreCacheMissCount);
+    HBAppend(os, "Obj-store-cache-miss-bytes",  "missbytes",
+        dio.mObjStoreCacheMissByteCount);
+    HBAppend(os, "Obj-store-cache-insert-bytes","insbytes",
+        dio.mObjStoreCacheInsertByteCount);
+    HBAppend(os, "Obj-store-cache-evict",       "evict",
+        dio.mObjStoreCacheEvictCount);
+    HBAppend(os, "Obj-store-cache-errors",      "err",
+        dio.mObjStoreCacheErrorCount);
+    HBAppend(os, "Obj-store-cache-size",        "size",
+        dio.mObjStoreCacheSize);
+    HBAppend(os, "Obj-store-cache-capacity",    "cap",
+        dio.mObjStoreCacheCapacity);
+    static const char* const kDiskQueuePriorityClassNames[] = {
+        "diskprio: client",
+        "diskprio: recovery",
+        "diskprio: maintenance"
+    };
+    static const char* const kDiskQueuePriorityClassKeys[] = {
+        "Disk-prio-client-",
+        "Disk-prio-recovery-",
+        "Disk-prio-maintenance-"
+    };
+    for (int i = 0; i < QCDiskQueue::kPriorityClassCount; i++) {
+        QCDiskQueue::PriorityClassCounters pc;
+        DiskIo::GetPriorityClassCounters(QCDiskQueue::PriorityClass(i), pc);
+        const string pref = kDiskQueuePriorityClassKeys[i];
+        HBAppend(os, 0, kDiskQueuePriorityClassNames[i], "");
+        HBAppend(os, (pref + "pending").c_str(),   "pend", pc.mPendingCount);
+        HBAppend(os, (pref + "in-flight").c_str(), "infl", pc.mInFlightCount);
+        HBAppend(os, (pref + "count").c_str(),     "cnt",  pc.mRequestCount);
+        HBAppend(os, (pref + "blocks").c_str(),    "blk",  pc.mBlockCount);
+        HBAppend(os, (pref + "wait-usec").c_str(), "wait",
+            pc.mWaitTimeMicroSec);
+        HBAppend(os, (pref + "io-usec").c_str(),   "io",   pc.mIoTimeMicroSec);
+        HBAppend(os, (pref + "deadline").c_str(),  "ddl",  pc.mDeadlineCount);
+    }
 
     HBAppend(os, 0, "msglog", "");
     MsgLogger::Counters msgLogCntrs;
@@ -1933,6 +2657,32 @@ HeartbeatOp::Execute()
     HBAppend(os, "Replicator-read-bytes", "rrb",  replCntrs.mReadByteCount);
     HBAppend(os, "Replicator-writes",      "rwc", replCntrs.mWriteCount);
     HBAppend(os, "Replicator-write-bytes", "rwb", replCntrs.mWriteByteCount);
+    HBAppend(os, "Replicator-rate-limit-waits", "rlw",
+        replCntrs.mRateLimitWaitCount);
+    HBAppend(os, "Replicator-rate-limit-wait-usec", "rlu",
+        replCntrs.mRateLimitWaitMicroSecs);
+
+    ChunkScrubber::Counters scrubCntrs;
+    gChunkScrubber.GetCounters(scrubCntrs);
+    HBAppend(os, 0, "scrub", "");
+    HBAppend(os, "Scrubber-chunks", "cnt",   scrubCntrs.mChunkCount);
+    HBAppend(os, "Scrubber-bytes",  "bytes", scrubCntrs.mByteCount);
+    HBAppend(os, "Scrubber-errors", "err",   scrubCntrs.mErrorCount);
+    HBAppend(os, "Scrubber-passes", "pass",  scrubCntrs.mPassCount);
+    HBAppend(os, "Scrubber-progress-write-errors", "perr",
+        scrubCntrs.mProgressWriteErrorCount);
+
+    ShortCircuitServer::Counters scCntrs;
+    gShortCircuitServer.GetCounters(scCntrs);
+    HBAppend(os, 0, "shortcircuit", "");
+    HBAppend(os, "Short-circuit-grants",  "grant",  scCntrs.mGrantCount);
+    HBAppend(os, "Short-circuit-claims",  "claim",  scCntrs.mClaimCount);
+    HBAppend(os, "Short-circuit-expired", "exp",    scCntrs.mExpiredCount);
+    HBAppend(os, "Short-circuit-revoked", "rev",    scCntrs.mRevokedCount);
+    HBAppend(os, "Short-circuit-claim-errors", "cerr",
+        scCntrs.mClaimErrorCount);
+    HBAppend(os, "Short-circuit-in-flight", "inf",
+        scCntrs.mGrantsInFlightCount);
 
     HBAppend(os, "Ops-in-flight-count", "opsf", gChunkServer.GetNumOps());
     HBAppend(os, 0, "gcntrs", "");
@@ -1954,6 +2704,31 @@ HeartbeatOp::Execute()
         gClientManager.IsAuthEnabled() ? 1 : 0);
     HBAppend(os, "Auth-rsync", "authrs", RemoteSyncSM::IsAuthEnabled() ? 1 : 0);
     HBAppend(os, "Auth-meta",  "authms", gMetaServerSM.IsAuthEnabled() ? 1 : 0);
+    AppendHotChunks(os);
+}
+
+// This is the heartbeat sent by the meta server
+void
+HeartbeatOp::Execute()
+{
+    gChunkManager.MetaHeartbeat(*this);
+
+    static IOBuffer::WOStream sWOs;
+    static ostringstream      sOs;
+    ostream* os[2];
+    os[0] = &sWOs.Set(response);
+    if (MsgLogger::GetLogger() &&
+            MsgLogger::GetLogger()->IsLogLevelEnabled(
+                MsgLogger::kLogLevelDEBUG)) {
+        cmdShow.clear();
+        cmdShow.reserve(2 << 10);
+        sOs.str(cmdShow);
+        cmdShow = string(); // De-reference.
+        os[1] = &sOs;
+    } else {
+        os[1] = 0;
+    }
+    AppendCounters(os);
     *os[0] << "\r\n";
     os[0]->flush();
     sWOs.Reset();
@@ -1962,6 +2737,7 @@ HeartbeatOp::Execute()
         cmdShow = sOs.str();
         sOs.str(string());
     }
+    HBDelta(response, seq, deltaSeq);
 
     status = 0;
     gLogger.Submit(this);
@@ -2314,17 +3090,34 @@ WritePrepareOp::Execute()
     SET_HANDLER(this, &WritePrepareOp::Done);
 
     // check if we need to forward anywhere
+    // With the write id allocation the servers list has no write ids, each
+    // server in the chain allocates its write id, and returns the write ids of
+    // itself and the downstream servers, in the same format as write id alloc.
     ServerLocation peerLoc;
     int            myPos         = -1;
     const bool     needToForward = needToForwardToPeer(
-        servers, numServers, myPos, peerLoc, true, writeId);
+        servers, numServers, myPos, peerLoc, ! allocWriteIdFlag, writeId);
     if (myPos < 0) {
         statusMsg = "invalid or missing Servers: field";
         status = -EINVAL;
         gLogger.Submit(this);
         return;
     }
-    if (chunkAccessTokenValidFlag &&
+    if (allocWriteIdFlag) {
+        writeId = -1;
+        if (chunkAccessTokenValidFlag &&
+                (chunkAccessFlags & ChunkAccessToken::kUsesWriteIdFlag) != 0) {
+            status    = -EPERM;
+            statusMsg = "no write id subject allowed";
+        } else if (! replyRequestedFlag || chunkVersion < 0) {
+            status    = -EINVAL;
+            statusMsg = "write id allocation requires write prepare reply";
+        }
+        if (status < 0) {
+            gLogger.Submit(this);
+            return;
+        }
+    } else if (chunkAccessTokenValidFlag &&
             (chunkAccessFlags & ChunkAccessToken::kUsesWriteIdFlag) != 0 &&
             subjectId != writeId) {
         status    = -EPERM;
@@ -2334,7 +3127,7 @@ WritePrepareOp::Execute()
     }
 
     const bool writeMaster = (myPos == 0);
-    if (! gChunkManager.IsValidWriteId(writeId)) {
+    if (! allocWriteIdFlag && ! gChunkManager.IsValidWriteId(writeId)) {
         statusMsg = "invalid write id";
         status = -EINVAL;
         gLogger.Submit(this);
@@ -2367,22 +3160,21 @@ WritePrepareOp::Execute()
         // signal the lease clerk to renew the lease for the chunk when appropriate.
         gLeaseClerk.DoingWrite(chunkId, chunkVersion);
     }
-
-    if (blocksChecksums.empty()) {
-        blocksChecksums = ComputeChecksums(&dataBuf, numBytes, &receivedChecksum);
-    }
-    if (receivedChecksum != checksum) {
-        statusMsg = "checksum mismatch";
-        KFS_LOG_STREAM_ERROR <<
-            "checksum mismatch: sent: " << checksum <<
-            ", computed: " << receivedChecksum << " for " << Show() <<
-        KFS_LOG_EOM;
-        status = -EBADCKSUM;
-        Done(EVENT_CMD_DONE, this);
-        return;
+    if (allocWriteIdFlag) {
+        if (gChunkManager.AllocateWriteId(this) != 0) {
+            if (0 <= status) {
+                status = -EINVAL;
+            }
+            Done(EVENT_CMD_DONE, this);
+            return;
+        }
+        const ServerLocation& loc = gChunkServer.GetLocation();
+        writeIdStr.Copy(loc.hostname.data(), loc.hostname.size()).Append(
+            (char)' ');
+        AppendDecIntToString(writeIdStr, loc.port).Append((char)' ');
+        AppendDecIntToString(writeIdStr, writeId);
     }
 
-    // will clone only when the op is good
     writeOp = gChunkManager.CloneWriteOp(writeId);
 
     if (! writeOp) {
@@ -2395,6 +3187,10 @@ WritePrepareOp::Execute()
         return;
     }
 
+    // Forward before computing the checksums, if these were not computed
+    // while receiving the data, in order to overlap the checksum computation
+    // with the data transfer to the next replica. The peer verifies the
+    // checksum independently.
     if (needToForward) {
         ForwardToPeer(peerLoc, writeMaster, allowCSClearTextFlag);
         if (status < 0) {
@@ -2404,6 +3200,22 @@ WritePrepareOp::Execute()
         }
     }
 
+    if (blocksChecksums.empty()) {
+        const int64_t start = microseconds();
+        blocksChecksums = ComputeChecksums(&dataBuf, numBytes, &receivedChecksum);
+        checksumTime += microseconds() - start;
+    }
+    if (receivedChecksum != checksum) {
+        statusMsg = "checksum mismatch";
+        KFS_LOG_STREAM_ERROR <<
+            "checksum mismatch: sent: " << checksum <<
+            ", computed: " << receivedChecksum << " for " << Show() <<
+        KFS_LOG_EOM;
+        status = -EBADCKSUM;
+        Done(EVENT_CMD_DONE, this);
+        return;
+    }
+
     writeOp->offset = offset;
     writeOp->numBytes = numBytes;
     writeOp->dataBuf.Move(&dataBuf);
@@ -2468,6 +3280,9 @@ WritePrepareOp::Done(int code, void *data)
     if (writeFwdOp && numDone < 2) {
         return 0;
     }
+    if (allocWriteIdFlag && status >= 0 && writeFwdOp) {
+        writeIdStr.Append(' ').Append(writeFwdOp->writeIdStr);
+    }
     KFS_LOG_STREAM(
         status >= 0 ? MsgLogger::kLogLevelINFO : MsgLogger::kLogLevelERROR) <<
         (status >= 0 ? "done: " : "failed: ") << Show() <<
@@ -2919,6 +3734,15 @@ GetChunkMetadataOp::HandleChunkMetaReadDone(int code, void *data)
         status = -EBADF;
     }
 
+    if (0 <= status && shortCircuitFlag) {
+        shortCircuitId = gChunkManager.ShortCircuitGrant(
+            chunkId, chunkVersion, shortCircuitHeaderSize);
+        KFS_LOG_STREAM_DEBUG << "short circuit grant:"
+            " chunk: "   << chunkId <<
+            " version: " << chunkVersion <<
+            " status: "  << (shortCircuitId < 0 ? shortCircuitId : 0) <<
+        KFS_LOG_EOM;
+    }
     if (status < 0 || ! readVerifyFlag) {
         gLogger.Submit(this);
         return 0;
@@ -2970,7 +3794,9 @@ GetChunkMetadataOp::HandleScrubReadDone(int code, void *data)
             readOp.dataBuf.Trim(readOp.numBytes);
         }
         // verify checksum
-        gChunkManager.ReadChunkDone(&readOp);
+        if (! gChunkManager.ReadChunkDone(&readOp)) {
+            return 0; // Checksum mismatch re-read is in flight.
+        }
         status = readOp.status;
         if (status == 0) {
             KFS_LOG_STREAM_DEBUG << "scrub read succeeded"
@@ -3045,12 +3871,55 @@ StatsOp::Execute()
     os << "Num aios: " << 0 << "\r\n";
     os << "Num ops: " << gChunkServer.GetNumOps() << "\r\n";
     globals().counterManager.Show(os);
+    // The stats are too large for the stack.
+    KfsOpPhaseStats* const phaseStats = new KfsOpPhaseStats();
+    gClientManager.GetOpPhaseStats(*phaseStats);
+    phaseStats->Display(os, "Op-latency-");
+    delete phaseStats;
+    KfsOp::ShowInFlight(os, "Op-in-flight-");
     stats = os.str();
+    if (deltaId != 0) {
+        static StatsDelta sStatsDelta;
+        deltaGen = sStatsDelta.Encode(deltaId, deltaGen,
+            globalNetManager().Now(), stats, deltaFullFlag);
+    }
     status = 0;
     // clnt->HandleEvent(EVENT_CMD_DONE, this);
     gLogger.Submit(this);
 }
 
+void
+NoopOp::Execute()
+{
+    status = 0;
+    gLogger.Submit(this);
+}
+
+void
+HeapProfileOp::Execute()
+{
+    if (KfsTraceNewHeapProfileIsAvailable()) {
+        if (0 <= sampleInterval) {
+            KfsTraceNewHeapProfileSetSampleInterval((size_t)sampleInterval);
+        }
+        size_t      len = 0;
+        char* const ptr = KfsTraceNewHeapProfileGet(&len);
+        if (ptr) {
+            response.CopyIn(ptr, (int)len);
+            free(ptr);
+        }
+        if (resetFlag) {
+            KfsTraceNewHeapProfileReset();
+        }
+        status = 0;
+    } else {
+        status    = -ENOSYS;
+        statusMsg = "heap profiler is not available,"
+            " chunk server is not linked with KfsTraceNew";
+    }
+    gLogger.Submit(this);
+}
+
 inline static bool
 OkHeader(const KfsOp* op, ostream &os, bool checkStatus = true)
 {
@@ -3097,6 +3966,15 @@ ChunkAccessRequestOp::Response(ostream &os)
     os << "\r\n";
 }
 
+void
+DeleteChunkBatchOp::Response(ostream &os)
+{
+    if (! OkHeader(this, os)) {
+        return;
+    }
+    os << "Num-deleted: " << numDeleted << "\r\n\r\n";
+}
+
 void
 SizeOp::Response(ostream &os)
 {
@@ -3116,7 +3994,18 @@ GetChunkMetadataOp::Response(ostream &os)
         "Chunk-handle: "   << chunkId      << "\r\n"
         "Chunk-version: "  << chunkVersion << "\r\n"
         "Size: "           << chunkSize    << "\r\n"
-        "Content-length: " << numBytesIO   << "\r\n"
+    ;
+    if (0 < shortCircuitId) {
+        os <<
+            "Short-circuit-id: "     << shortCircuitId << "\r\n"
+            "Short-circuit-socket: " <<
+                gShortCircuitServer.GetSocketPath() << "\r\n"
+            "Short-circuit-lease: "  <<
+                gShortCircuitServer.GetLeaseSec()   << "\r\n"
+            "Short-circuit-offset: " << shortCircuitHeaderSize << "\r\n"
+        ;
+    }
+    os << "Content-length: " << numBytesIO << "\r\n"
     "\r\n";
 }
 
@@ -3130,6 +4019,15 @@ ReadOp::Response(ostream &os)
     }
 
     os << "DiskIOtime: " << (diskIOTime * 1e-6) << "\r\n";
+    if (! ranges.empty()) {
+        // Each range length, and the checksums of each range data.
+        os << "Range-count: " << ranges.size() / 2 << "\r\n"
+            "Range-lengths:";
+        for (size_t i = 1; i < ranges.size(); i += 2) {
+            os << ' ' << ranges[i];
+        }
+        os << "\r\n";
+    }
     os << "Checksum-entries: " << checksum.size() << "\r\n";
     if (skipVerifyDiskChecksumFlag) {
         os << "Skip-Disk-Chksum: 1\r\n";
@@ -3166,7 +4064,16 @@ WritePrepareOp::Response(ostream &os)
         // no reply for a prepare...the reply is covered by sync
         return;
     }
-    ChunkAccessRequestOp::Response(os);
+    if (! allocWriteIdFlag) {
+        ChunkAccessRequestOp::Response(os);
+        return;
+    }
+    if (! OkHeader(this, os)) {
+        return;
+    }
+    WriteChunkAccessResponse(os, writeId, ChunkAccessToken::kUsesWriteIdFlag);
+    os << "Write-id: " << writeIdStr << "\r\n"
+    "\r\n";
 }
 
 void
@@ -3308,6 +4215,9 @@ ReadOp::Request(ostream& os)
     if (skipVerifyDiskChecksumFlag) {
         os << "Skip-Disk-Chksum: 1\r\n";
     }
+    if (replicationReadFlag) {
+        os << "Replication-read: 1\r\n";
+    }
     if (requestChunkAccess) {
         os << "C-access: " << requestChunkAccess << "\r\n";
     }
@@ -3349,6 +4259,9 @@ WritePrepareFwdOp::Request(ostream& os)
     "Reply: "         << (owner.replyRequestedFlag ? 1 : 0) << "\r\n"
     "Servers: "       << owner.servers << "\r\n"
     ;
+    if (owner.allocWriteIdFlag) {
+        os << "Alloc-write-id: 1\r\n";
+    }
     WriteSyncReplicationAccess(
         owner.syncReplicationAccess, os, "Access-fwd-length: ");
 }
@@ -3451,7 +4364,28 @@ DumpChunkMapOp::Response(ostream &os)
 void
 StatsOp::Response(ostream &os)
 {
-    PutHeader(this, os) << stats << "\r\n";
+    PutHeader(this, os);
+    if (deltaId != 0 && 0 <= status) {
+        os <<
+            "Delta-gen: "  << deltaGen               << "\r\n"
+            "Delta-full: " << (deltaFullFlag ? 1 : 0) << "\r\n";
+    }
+    os << stats << "\r\n";
+}
+
+void
+NoopOp::Response(ostream &os)
+{
+    PutHeader(this, os) << "\r\n";
+}
+
+void
+HeapProfileOp::Response(ostream &os)
+{
+    if (! OkHeader(this, os)) {
+        return;
+    }
+    os << "Content-length: " << response.BytesConsumable() << "\r\n\r\n";
 }
 
 ////////////////////////////////////////////////
@@ -3720,8 +4654,8 @@ HelloMetaOp::Request(ostream& os, IOBuffer& buf)
         "Total-fs-space: " << totalFsSpace << "\r\n"
         "Used-space: " << usedSpace << "\r\n"
         "Uptime: " << globalNetManager().UpTime() << "\r\n"
-        "Num-chunks: " <<
-            chunkLists[kStableChunkList].count << "\r\n"
+        "Num-chunks: " << (0 != resumeInstanceId ?
+            int64_t(0) : chunkLists[kStableChunkList].count) << "\r\n"
         "Num-not-stable-append-chunks: " <<
             chunkLists[kNotStableAppendChunkList].count << "\r\n"
         "Num-not-stable-chunks: " <<
@@ -3731,6 +4665,7 @@ HelloMetaOp::Request(ostream& os, IOBuffer& buf)
         "Num-re-replications: " << Replicator::GetNumReplications() << "\r\n"
         "Stale-chunks-hex-format: 1\r\n"
         "Content-int-base: 16\r\n"
+        "Delete-batch: 1\r\n"
     ;
     if (noFidsFlag) {
         os << "NoFids: 1\r\n";
@@ -3741,6 +4676,17 @@ HelloMetaOp::Request(ostream& os, IOBuffer& buf)
     if (sendCurrentKeyFlag) {
         SendCryptoKey(os, currentKeyId, currentKey);
     }
+    if (0 != resumeInstanceId) {
+        // The meta server has the stable chunk list, if the count and
+        // checksum match.
+        os <<
+            "Resume-instance: "   << resumeInstanceId << "\r\n"
+            "Resume-num-chunks: " <<
+                chunkLists[kStableChunkList].count << "\r\n"
+            "Resume-checksum: "   << stableChunksChecksum << "\r\n"
+        ;
+        chunkLists[kStableChunkList].ioBuf.Clear();
+    }
     int64_t contentLength = 0;
     for (int i = 0; i < kChunkListCount; i++) {
         contentLength += chunkLists[i].ioBuf.BytesConsumable();
@@ -3828,12 +4774,19 @@ HelloMetaOp::Execute()
         lists[i].first  = &(chunkLists[i].count);
         lists[i].second = &(streams[i].Set(chunkLists[i].ioBuf) << hex);
     }
+    int64_t renameInFlightCount = 0;
     gChunkManager.GetHostedChunks(
         lists[kStableChunkList],
         lists[kNotStableAppendChunkList],
         lists[kNotStableChunkList],
-        noFidsFlag
+        noFidsFlag,
+        &stableChunksChecksum,
+        &renameInFlightCount
     );
+    if (0 < renameInFlightCount) {
+        // Let the meta server check the chunk versions.
+        resumeInstanceId = 0;
+    }
     for (int i = 0; i < kChunkListCount; i++) {
         lists[i].second->flush();
         streams[i].Reset();
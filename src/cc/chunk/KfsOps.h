@@ -88,6 +88,7 @@ enum KfsOp_t {
     CMD_HEARTBEAT,
     CMD_STALE_CHUNKS,
     CMD_RETIRE,
+    CMD_DELETE_CHUNK_BATCH,
     // Chunk server->Meta server ops
     CMD_META_HELLO,
     CMD_CORRUPT_CHUNK,
@@ -119,6 +120,8 @@ enum KfsOp_t {
     CMD_PING,
     CMD_STATS,
     CMD_DUMP_CHUNKMAP,
+    CMD_HEAP_PROFILE,
+    CMD_NOOP,
     // Internally generated ops
     CMD_CHECKPOINT,
     CMD_WRITE,
@@ -283,6 +286,12 @@ struct KfsOp : public KfsCallbackObj
     KfsCallbackObj* clnt;
     // keep statistics
     int64_t         startTime;
+    // Processing phase times in microseconds, see KfsOpPhaseStats.
+    int64_t         bufferWaitTime;
+    int64_t         diskQueueTime;
+    int64_t         diskIoTime;
+    int64_t         checksumTime;
+    int64_t         doneTime;
     BufferBytes     bufferBytes;
     KfsOp*          next;
     NextOp          nextOp;
@@ -375,6 +384,16 @@ struct KfsOp : public KfsCallbackObj
     inline static Display ShowOp(const KfsOp* op)
         { return (op ? Display(*op) : Display(GetNullOp())); }
     virtual bool CheckAccess(ClientSM& sm);
+    void DiskIoDone(const DiskIo* io)
+    {
+        if (io) {
+            diskQueueTime += io->GetQueueWaitTime();
+            diskIoTime    += io->GetIoTime();
+        }
+    }
+    // Show count and max. age in microseconds of ops in flight by op type.
+    static void ShowInFlight(ostream& os, const char* prefix);
+    static const char* GetOpName(KfsOp_t op);
 protected:
     virtual void Request(ostream& /* os */) {
         // fill this method if the op requires a message to be sent to a server.
@@ -406,6 +425,46 @@ private:
 inline static ostream& operator<<(ostream& os, const KfsOp::Display& disp)
 { return disp.Show(os); }
 
+// Per op type latency histograms of the client op processing phases, with
+// power of two microseconds buckets. Each client thread has its own instance,
+// updated without synchronization when the op response is sent, therefore
+// the aggregated values are approximate.
+class KfsOpPhaseStats
+{
+public:
+    enum Phase
+    {
+        kPhaseTotal      = 0, // op parse to response send
+        kPhaseBufferWait = 1, // waiting for io buffers
+        kPhaseDiskQueue  = 2, // waiting in disk queue
+        kPhaseDiskIo     = 3, // disk io
+        kPhaseChecksum   = 4, // checksum computation and verification
+        kPhaseResponse   = 5, // op completion to response send
+        kPhaseCount
+    };
+    enum { kBucketCount = 24 };
+
+    KfsOpPhaseStats();
+    void Update(const KfsOp& op, int64_t now);
+    void Clear();
+    KfsOpPhaseStats& Add(const KfsOpPhaseStats& stats);
+    // For each op type with non zero count and each phase emits:
+    // <prefix><op>-<phase>: count,total-usec,bucket-0,...,bucket-N
+    // where bucket i counts phase times less than 2^i usec, with the last
+    // bucket counting everything above. Trailing empty buckets are omitted.
+    // If total only flag is set, only the total phase is shown.
+    void Display(ostream& os, const char* prefix,
+        bool totalOnlyFlag = false) const;
+private:
+    struct Counters
+    {
+        int64_t mCount;
+        int64_t mTotal[kPhaseCount];
+        int64_t mHist[kPhaseCount][kBucketCount];
+    };
+    Counters mCounters[CMD_NCMDS];
+};
+
 struct KfsClientChunkOp : public KfsOp
 {
     kfsChunkId_t chunkId;
@@ -438,6 +497,7 @@ struct KfsClientChunkOp : public KfsOp
     }
     inline bool Validate();
     virtual bool CheckAccess(ClientSM& sm);
+    static void SetParameters(const Properties& props);
 private:
     TokenValue chunkAccessVal;
 };
@@ -715,6 +775,41 @@ struct DeleteChunkOp : public KfsOp {
     }
 };
 
+struct DeleteChunkBatchOp : public KfsOp {
+    typedef vector<kfsChunkId_t> ChunkIds;
+    int      contentLength;
+    int      numChunks;
+    int64_t  numDeleted; // output
+    ChunkIds chunkIds;
+
+    DeleteChunkBatchOp(kfsSeq_t s = 0)
+       : KfsOp(CMD_DELETE_CHUNK_BATCH, s),
+         contentLength(0),
+         numChunks(0),
+         numDeleted(0),
+         chunkIds()
+        {}
+    void Execute();
+    void Response(ostream &os);
+    virtual ostream& ShowSelf(ostream& os) const {
+        return os <<
+            "delete-chunk-batch:"
+            " seq: "     << seq <<
+            " count: "   << numChunks <<
+            " deleted: " << numDeleted
+        ;
+    }
+    virtual int GetContentLength() const { return contentLength; }
+    virtual bool ParseContent(istream& is);
+    template<typename T> static T& ParserDef(T& parser)
+    {
+        return KfsOp::ParserDef(parser)
+        .Def("Content-length", &DeleteChunkBatchOp::contentLength)
+        .Def("Num-chunks",     &DeleteChunkBatchOp::numChunks)
+        ;
+    }
+};
+
 struct TruncateChunkOp : public KfsOp {
     kfsChunkId_t chunkId;  // input
     size_t       chunkSize; // size to which file should be truncated to
@@ -748,10 +843,14 @@ struct TruncateChunkOp : public KfsOp {
 // Op for replicating the chunk.  The metaserver is asking this
 // chunkserver to create a copy of a chunk.  We replicate the chunk
 // and then notify the server upon completion.
+// With source chunk id set, the source chunk data is copied into the new
+// chunk id with the target version, the chunk at the location can be hosted
+// by this chunk server.
 //
 struct ReplicateChunkOp : public KfsOp {
     kfsFileId_t     fid;          // input
     kfsChunkId_t    chunkId;      // input
+    kfsChunkId_t    sourceChunkId; // input: copy this chunk into chunkId
     ServerLocation  location;     // input: where to get the chunk from
     int64_t         chunkVersion; // io: we tell the metaserver what we replicated
     int64_t         targetVersion;
@@ -775,6 +874,7 @@ struct ReplicateChunkOp : public KfsOp {
         KfsOp(CMD_REPLICATE_CHUNK, s),
         fid(-1),
         chunkId(-1),
+        sourceChunkId(-1),
         location(),
         chunkVersion(-1),
         targetVersion(-1),
@@ -802,6 +902,7 @@ struct ReplicateChunkOp : public KfsOp {
             " seq: "        << seq <<
             " fid: "        << fid <<
             " chunk: "      << chunkId <<
+            " src-chunk: "  << sourceChunkId <<
             " version: "    << chunkVersion <<
             " targetVers: " << targetVersion <<
             " offset: "     << chunkOffset <<
@@ -828,6 +929,7 @@ struct ReplicateChunkOp : public KfsOp {
         return KfsOp::ParserDef(parser)
         .Def("File-handle",          &ReplicateChunkOp::fid,            kfsFileId_t(-1))
         .Def("Chunk-handle",         &ReplicateChunkOp::chunkId,        kfsChunkId_t(-1))
+        .Def("Source-chunk-handle",  &ReplicateChunkOp::sourceChunkId,  kfsChunkId_t(-1))
         .Def("Chunk-version",        &ReplicateChunkOp::chunkVersion,   int64_t(-1))
         .Def("Target-version",       &ReplicateChunkOp::targetVersion,  int64_t(-1))
         .Def("Chunk-location",       &ReplicateChunkOp::locationStr)
@@ -850,6 +952,7 @@ struct ReplicateChunkOp : public KfsOp {
 
 struct HeartbeatOp : public KfsOp {
     int64_t           metaEvacuateCount; // input
+    int64_t           deltaSeq;          // input
     bool              authenticateFlag;
     IOBuffer          response;
     string            cmdShow;
@@ -860,6 +963,7 @@ struct HeartbeatOp : public KfsOp {
     HeartbeatOp(kfsSeq_t s = 0)
         : KfsOp(CMD_HEARTBEAT, s),
           metaEvacuateCount(-1),
+          deltaSeq(-1),
           authenticateFlag(false),
           response(),
           cmdShow(),
@@ -869,6 +973,8 @@ struct HeartbeatOp : public KfsOp {
         {}
     void Execute();
     void Response(ostream &os);
+    // os[0] -- "Key: value\r\n" lines, os[1] -- optional short form.
+    static void AppendCounters(ostream** os);
     virtual ostream& ShowSelf(ostream& os) const {
         if (cmdShow.empty()) {
             return os << "heartbeat";
@@ -883,6 +989,7 @@ struct HeartbeatOp : public KfsOp {
     {
         return KfsOp::ParserDef(parser)
         .Def("Num-evacuate", &HeartbeatOp::metaEvacuateCount, int64_t(-1))
+        .Def("Delta-seq",    &HeartbeatOp::deltaSeq,          int64_t(-1))
         .Def("Authenticate", &HeartbeatOp::authenticateFlag, false)
         ;
     }
@@ -1290,6 +1397,8 @@ struct WritePrepareOp : public ChunkAccessRequestOp {
     uint32_t              checksum;   /* input: as computed by the sender; 0 means sender didn't send */
     StringBufT<256>       servers;    /* input: set of servers on which to write */
     bool                  replyRequestedFlag;
+    bool                  allocWriteIdFlag; /* input: allocate write ids */
+    StringBufT<256>       writeIdStr; /* output: with write id allocation */
     int                   accessFwdLength;
     int                   chunkAccessLength;
     SyncReplicationAccess syncReplicationAccess;
@@ -1309,6 +1418,8 @@ struct WritePrepareOp : public ChunkAccessRequestOp {
           checksum(0),
           servers(),
           replyRequestedFlag(false),
+          allocWriteIdFlag(false),
+          writeIdStr(),
           accessFwdLength(0),
           chunkAccessLength(0),
           syncReplicationAccess(),
@@ -1361,6 +1472,7 @@ struct WritePrepareOp : public ChunkAccessRequestOp {
         .Def("Servers",           &WritePrepareOp::servers)
         .Def("Checksum",          &WritePrepareOp::checksum)
         .Def("Reply",             &WritePrepareOp::replyRequestedFlag)
+        .Def("Alloc-write-id",    &WritePrepareOp::allocWriteIdFlag)
         .Def("Access-fwd-length", &WritePrepareOp::accessFwdLength, 0)
         .Def("C-access-length",   &WritePrepareOp::chunkAccessLength)
         ;
@@ -1369,12 +1481,27 @@ struct WritePrepareOp : public ChunkAccessRequestOp {
 
 struct WritePrepareFwdOp : public KfsOp {
     const WritePrepareOp& owner;
+    StringBufT<256>       writeIdStr; /* peers write ids, with allocation */
 
     WritePrepareFwdOp(WritePrepareOp& o)
         : KfsOp(CMD_WRITE_PREPARE_FWD, 0),
-          owner(o)
+          owner(o),
+          writeIdStr()
         {}
     void Request(ostream &os);
+    virtual bool ParseResponse(const Properties& props, IOBuffer& /* iobuf */)
+    {
+        if (! owner.allocWriteIdFlag) {
+            return true;
+        }
+        const Properties::String* const wids = props.getValue("Write-id");
+        if (wids) {
+            writeIdStr = *wids;
+        } else {
+            writeIdStr.clear();
+        }
+        return (! writeIdStr.empty());
+    }
     // nothing to do...we send the data to peer and wait. have a
     // decl. to keep compiler happy
     void Execute() {}
@@ -1624,6 +1751,13 @@ struct ReadOp : public KfsClientChunkOp {
     int64_t          diskIOTime; /* how long did the AIOs take */
     int              retryCnt;
     bool             skipVerifyDiskChecksumFlag;
+    bool             replicationReadFlag; /* replication or recovery read */
+    bool             sendFileFlag;   /* try to send reply data with sendfile */
+    int              sendFileFd;     /* chunk file fd for sendfile or -1 */
+    int64_t          sendFileOffset; /* data offset in the chunk file */
+    int              rangeCount;     /* input: multi range read */
+    StringBufT<256>  rangesStr;      /* input: offset length pairs */
+    vector<int64_t>  ranges;         /* offset length pairs */
     const char*      requestChunkAccess;
     /*
      * for writes that require the associated checksum block to be
@@ -1645,6 +1779,13 @@ struct ReadOp : public KfsClientChunkOp {
           diskIOTime(0),
           retryCnt(0),
           skipVerifyDiskChecksumFlag(false),
+          replicationReadFlag(false),
+          sendFileFlag(false),
+          sendFileFd(-1),
+          sendFileOffset(-1),
+          rangeCount(0),
+          rangesStr(),
+          ranges(),
           requestChunkAccess(0),
           wop(0),
           scrubOp(0),
@@ -1661,6 +1802,13 @@ struct ReadOp : public KfsClientChunkOp {
           diskIOTime(0),
           retryCnt(0),
           skipVerifyDiskChecksumFlag(false),
+          replicationReadFlag(false),
+          sendFileFlag(false),
+          sendFileFd(-1),
+          sendFileOffset(-1),
+          rangeCount(0),
+          rangesStr(),
+          ranges(),
           requestChunkAccess(0),
           wop(w),
           scrubOp(0),
@@ -1671,9 +1819,7 @@ struct ReadOp : public KfsClientChunkOp {
         chunkVersion = w->chunkVersion;
         SET_HANDLER(this, &ReadOp::HandleDone);
     }
-    ~ReadOp() {
-        assert(! wop);
-    }
+    ~ReadOp();
 
     void SetScrubOp(GetChunkMetadataOp *sop) {
         scrubOp = sop;
@@ -1686,6 +1832,7 @@ struct ReadOp : public KfsClientChunkOp {
         size = buf ? numBytesIO : 0;
     }
     void Execute();
+    bool Validate();
     int HandleDone(int code, void *data);
     // handler for reading in the chunk meta-data
     int HandleChunkMetaReadDone(int code, void *data);
@@ -1701,7 +1848,10 @@ struct ReadOp : public KfsClientChunkOp {
             " version: "  << chunkVersion <<
             " offset: "   << offset <<
             " numBytes: " << numBytes <<
-            (skipVerifyDiskChecksumFlag ? " skip-disk-chksum" : "")
+            " ranges: "   << rangeCount <<
+            (skipVerifyDiskChecksumFlag ? " skip-disk-chksum" : "") <<
+            (replicationReadFlag ? " replication" : "") <<
+            (sendFileFd >= 0 ? " sendfile" : "")
         ;
     }
     virtual bool IsChunkReadOp(int64_t& outNumBytes, kfsChunkId_t& outChunkId);
@@ -1728,8 +1878,13 @@ struct ReadOp : public KfsClientChunkOp {
         .Def("Offset",           &ReadOp::offset)
         .Def("Num-bytes",        &ReadOp::numBytes)
         .Def("Skip-Disk-Chksum", &ReadOp::skipVerifyDiskChecksumFlag, false)
+        .Def("Replication-read", &ReadOp::replicationReadFlag,        false)
+        .Def("Range-count",      &ReadOp::rangeCount,                 0)
+        .Def("Ranges",           &ReadOp::rangesStr)
         ;
     }
+private:
+    void ExtractRanges();
 };
 
 // used for retrieving a chunk's size
@@ -1872,6 +2027,9 @@ struct ChunkSpaceReleaseOp : public KfsClientChunkOp {
 
 struct GetChunkMetadataOp : public KfsClientChunkOp {
     bool         readVerifyFlag;
+    bool         shortCircuitFlag;
+    int64_t      shortCircuitId;         // output
+    int64_t      shortCircuitHeaderSize; // output
     int64_t      chunkSize; // output
     IOBuffer     dataBuf; // buffer with the checksum info
     size_t       numBytesIO;
@@ -1883,6 +2041,9 @@ struct GetChunkMetadataOp : public KfsClientChunkOp {
     GetChunkMetadataOp(kfsSeq_t s = 0)
         : KfsClientChunkOp(CMD_GET_CHUNK_METADATA, s),
           readVerifyFlag(false),
+          shortCircuitFlag(false),
+          shortCircuitId(-1),
+          shortCircuitHeaderSize(0),
           chunkSize(0),
           dataBuf(),
           numBytesIO(0),
@@ -1935,7 +2096,8 @@ struct GetChunkMetadataOp : public KfsClientChunkOp {
     template<typename T> static T& ParserDef(T& parser)
     {
         return KfsClientChunkOp::ParserDef(parser)
-        .Def("Read-verify",  &GetChunkMetadataOp::readVerifyFlag)
+        .Def("Read-verify",   &GetChunkMetadataOp::readVerifyFlag)
+        .Def("Short-circuit", &GetChunkMetadataOp::shortCircuitFlag)
         ;
     }
 };
@@ -1993,11 +2155,19 @@ struct DumpChunkMapOp : public KfsOp {
 
 // used to extract out all the counters we have
 struct StatsOp : public KfsOp {
-    string stats; // result
+    string  stats; // result
+    // Delta subscription: with non 0 deltaId only the stats changed since the
+    // response with generation deltaGen are returned.
+    int64_t deltaId;
+    int64_t deltaGen;
+    bool    deltaFullFlag;
 
     StatsOp(kfsSeq_t s = 0)
         : KfsOp(CMD_STATS, s),
-          stats()
+          stats(),
+          deltaId(0),
+          deltaGen(0),
+          deltaFullFlag(true)
         {}
     void Response(ostream &os);
     void Execute();
@@ -2005,6 +2175,68 @@ struct StatsOp : public KfsOp {
     {
         return os <<
             "monitoring stats:"
+            " seq: "       << seq <<
+            " delta gen: " << deltaGen
+        ;
+    }
+    template<typename T> static T& ParserDef(T& parser)
+    {
+        return KfsOp::ParserDef(parser)
+        .Def("Delta-id",  &StatsOp::deltaId,  int64_t(0))
+        .Def("Delta-gen", &StatsOp::deltaGen, int64_t(0))
+        ;
+    }
+};
+
+// Dump and / or reset sampling heap profile, available only if chunk server
+// is linked with KfsTraceNew.
+struct HeapProfileOp : public KfsOp {
+    bool     resetFlag;
+    int64_t  sampleInterval;
+    IOBuffer response;
+
+    HeapProfileOp(kfsSeq_t s = 0)
+        : KfsOp(CMD_HEAP_PROFILE, s),
+          resetFlag(false),
+          sampleInterval(-1),
+          response()
+        {}
+    void Response(ostream &os);
+    void Execute();
+    virtual void ResponseContent(IOBuffer*& buf, int& size) {
+        buf  = status >= 0 ? &response : 0;
+        size = buf ? response.BytesConsumable() : 0;
+    }
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        return os <<
+            "heap profile:"
+            " seq: "      << seq <<
+            " reset: "    << resetFlag <<
+            " interval: " << sampleInterval
+        ;
+    }
+    template<typename T> static T& ParserDef(T& parser)
+    {
+        return KfsOp::ParserDef(parser)
+        .Def("Reset",           &HeapProfileOp::resetFlag,      false)
+        .Def("Sample-interval", &HeapProfileOp::sampleInterval, int64_t(-1))
+        ;
+    }
+};
+
+// No operation, used to measure rpc round trip time, and request processing
+// overhead.
+struct NoopOp : public KfsOp {
+    NoopOp(kfsSeq_t s = 0)
+        : KfsOp(CMD_NOOP, s)
+        {}
+    void Response(ostream &os);
+    void Execute();
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        return os <<
+            "noop:"
             " seq: " << seq
         ;
     }
@@ -2159,6 +2391,11 @@ struct HelloMetaOp : public KfsOp {
     int64_t           metaFileSystemId;
     bool              deleteAllChunksFlag;
     bool              noFidsFlag;
+    // Meta server instance id to resume with, sends the stable chunks count
+    // and checksum instead of the stable chunk list.
+    int64_t           resumeInstanceId;
+    uint64_t          stableChunksChecksum;
+    int64_t           metaInstanceId;
 
     HelloMetaOp(kfsSeq_t s, const ServerLocation& l,
             const string& k, const string& m, int r)
@@ -2178,7 +2415,10 @@ struct HelloMetaOp : public KfsOp {
           fileSystemId(-1),
           metaFileSystemId(-1),
           deleteAllChunksFlag(false),
-          noFidsFlag(false)
+          noFidsFlag(false),
+          resumeInstanceId(0),
+          stableChunksChecksum(0),
+          metaInstanceId(0)
         {}
     void Execute();
     void Request(ostream& os, IOBuffer& buf);
@@ -2198,7 +2438,8 @@ struct HelloMetaOp : public KfsOp {
             " append: "      << chunkLists[kNotStableAppendChunkList].count <<
             " fsid: "        << fileSystemId <<
             " metafsid: "    << metaFileSystemId <<
-            " delete flag: " << deleteAllChunksFlag
+            " delete flag: " << deleteAllChunksFlag <<
+            " resume: "      << resumeInstanceId
         ;
     }
 };
@@ -87,9 +87,14 @@ MetaServerSM::MetaServerSM()
       mCurrentKeyId(),
       mUpdateCurrentKeyFlag(false),
       mNoFidsFlag(true),
+      mInventoryResumeFlag(true),
+      mMetaInstanceId(0),
       mOp(0),
       mRequestFlag(false),
       mContentLength(0),
+      mPendingResponses(),
+      mDeferredResponses(),
+      mMaxSendBacklog(64 << 10),
       mCounters(),
       mIStream(),
       mWOStream()
@@ -163,6 +168,11 @@ MetaServerSM::SetParameters(const Properties& prop)
         "chunkServer.meta.maxReadAhead",      mMaxReadAhead);
     mNoFidsFlag        = prop.getValue(
         "chunkServer.meta.noFids",            mNoFidsFlag ? 1 : 0) != 0;
+    mInventoryResumeFlag = prop.getValue(
+        "chunkServer.meta.inventoryResume",
+        mInventoryResumeFlag ? 1 : 0) != 0;
+    mMaxSendBacklog    = prop.getValue(
+        "chunkServer.meta.maxSendBacklog",    mMaxSendBacklog);
     const bool kVerifyFlag = true;
     int ret = mAuthContext.SetParameters(
         "chunkserver.meta.auth.", prop, 0, 0, kVerifyFlag);
@@ -393,8 +403,9 @@ MetaServerSM::SendHello()
         mHelloOp = new HelloMetaOp(
             nextSeq(), gChunkServer.GetLocation(),
             mClusterKey, mMD5Sum, mRackId);
-        mHelloOp->noFidsFlag = mNoFidsFlag;
-        mHelloOp->clnt       = this;
+        mHelloOp->noFidsFlag       = mNoFidsFlag;
+        mHelloOp->resumeInstanceId = GetResumeInstanceId();
+        mHelloOp->clnt             = this;
         // Send the op and wait for the reply.
         SubmitOp(mHelloOp);
     }
@@ -438,6 +449,16 @@ MetaServerSM::Authenticate()
     return true;
 }
 
+int64_t
+MetaServerSM::GetResumeInstanceId()
+{
+    // Resume only once: if hello fails for any reason, the next hello will
+    // send full chunk inventory.
+    const int64_t ret = mInventoryResumeFlag ? mMetaInstanceId : 0;
+    mMetaInstanceId = 0;
+    return ret;
+}
+
 void
 MetaServerSM::DispatchHello()
 {
@@ -528,6 +549,7 @@ MetaServerSM::HandleRequest(int code, void* data)
         if (! mAuthOp && ! mSentHello && ! mHelloOp) {
             SendHello();
         }
+        SendDeferredResponses();
         // Something went out on the network.  For now, we don't
         // track it. Later, we may use it for tracking throttling
         // and such.
@@ -735,6 +757,7 @@ MetaServerSM::HandleReply(IOBuffer& iobuf, int msgLen)
                         mHelloOp->metaFileSystemId,
                         mHelloOp->deleteAllChunksFlag);
                 }
+                mMetaInstanceId = prop.getValue("Instance-id", int64_t(0));
             }
             HelloMetaOp::LostChunkDirs lostDirs;
             lostDirs.swap(mHelloOp->lostChunkDirs);
@@ -962,21 +985,50 @@ MetaServerSM::SendResponse(KfsOp* op)
         mPendingResponses.push_back(op);
         return false;
     }
+    // The meta server matches the responses by sequence number, and the ops
+    // complete out of order, therefore the responses can be re-ordered.
+    // Heartbeat responses are sent immediately, in order to prevent the meta
+    // server heartbeat timeout when the connection has large backlog.
+    if (op->op != CMD_HEARTBEAT && 0 <= mMaxSendBacklog &&
+            (! mDeferredResponses.empty() ||
+                mMaxSendBacklog < mNetConnection->GetNumBytesToWrite())) {
+        mDeferredResponses.push_back(op);
+        return false;
+    }
+    WriteResponse(*op);
+    return true;
+}
+
+void
+MetaServerSM::WriteResponse(KfsOp& op)
+{
     // fire'n'forget.
-    if (op->op == CMD_ALLOC_CHUNK) {
+    if (op.op == CMD_ALLOC_CHUNK) {
         mCounters.mAllocCount++;
-        if (op->status < 0) {
+        if (op.status < 0) {
             mCounters.mAllocErrorCount++;
         }
     }
-    op->Response(mWOStream.Set(mNetConnection->GetOutBuffer()));
+    op.Response(mWOStream.Set(mNetConnection->GetOutBuffer()));
     mWOStream.Reset();
     IOBuffer* iobuf = 0;
     int       len   = 0;
-    op->ResponseContent(iobuf, len);
+    op.ResponseContent(iobuf, len);
     mNetConnection->Write(iobuf, len);
     globalNetManager().Wakeup();
-    return true;
+}
+
+void
+MetaServerSM::SendDeferredResponses()
+{
+    while (! mDeferredResponses.empty() && ! mAuthOp && mSentHello &&
+            IsConnected() &&
+            mNetConnection->GetNumBytesToWrite() <= mMaxSendBacklog) {
+        KfsOp* const op = mDeferredResponses.front();
+        mDeferredResponses.pop_front();
+        WriteResponse(*op);
+        delete op;
+    }
 }
 
 void
@@ -1103,13 +1155,15 @@ MetaServerSM::HandleAuthResponse(IOBuffer& ioBuf)
         while (! mPendingResponses.empty()) {
             KfsOp* const op = mPendingResponses.front();
             mPendingResponses.pop_front();
-            if (! SendResponse(op)) {
+            if (SendResponse(op)) {
+                delete op;
+            } else if (mAuthOp) {
                 die("invalid send response completion");
                 HandleRequest(EVENT_NET_ERROR, 0);
                 return;
             }
-            delete op;
         }
+        SendDeferredResponses();
         if (! mPendingOps.empty()) {
             globalNetManager().Wakeup();
         }
@@ -1127,8 +1181,9 @@ MetaServerSM::HandleAuthResponse(IOBuffer& ioBuf)
     mHelloOp = new HelloMetaOp(
         nextSeq(), gChunkServer.GetLocation(), mClusterKey, mMD5Sum, mRackId);
     mHelloOp->sendCurrentKeyFlag = true;
-    mHelloOp->noFidsFlag = mNoFidsFlag;
-    mHelloOp->clnt       = this;
+    mHelloOp->noFidsFlag         = mNoFidsFlag;
+    mHelloOp->resumeInstanceId   = GetResumeInstanceId();
+    mHelloOp->clnt               = this;
     // Send the op and wait for the reply.
     SubmitOp(mHelloOp);
 }
@@ -1141,6 +1196,11 @@ MetaServerSM::DiscardPendingResponses()
         mPendingResponses.pop_front();
         delete op;
     }
+    while (! mDeferredResponses.empty()) {
+        KfsOp* const op = mDeferredResponses.front();
+        mDeferredResponses.pop_front();
+        delete op;
+    }
 }
 
 } // namespace KFS
@@ -221,10 +221,17 @@ private:
     kfsKeyId_t                    mCurrentKeyId;
     bool                          mUpdateCurrentKeyFlag;
     bool                          mNoFidsFlag;
+    bool                          mInventoryResumeFlag;
+    int64_t                       mMetaInstanceId;
     KfsOp*                        mOp;
     bool                          mRequestFlag;
     int                           mContentLength;
     PendingResponses              mPendingResponses;
+    /// Responses queued while the connection has more than
+    /// mMaxSendBacklog bytes pending to be sent. Heartbeat responses bypass
+    /// the queue, in order to be sent ahead of the bulk data.
+    PendingResponses              mDeferredResponses;
+    int                           mMaxSendBacklog;
     Counters                      mCounters;
     IOBuffer::IStream             mIStream;
     IOBuffer::WOStream            mWOStream;
@@ -241,9 +248,12 @@ private:
     /// Op has finished execution.  Send a response to the meta
     /// server.
     bool SendResponse(KfsOp *op);
+    void WriteResponse(KfsOp& op);
+    void SendDeferredResponses();
 
     /// This is special: we dispatch mHelloOp and get rid of it.
     void DispatchHello();
+    int64_t GetResumeInstanceId();
 
     /// Submit all the enqueued ops
     void DispatchOps();
@@ -59,6 +59,7 @@ using std::list;
 using std::istringstream;
 using std::string;
 using std::make_pair;
+using std::max;
 using libkfsio::globalNetManager;
 
 class ClientThreadRemoteSyncListEntry::StMutexLocker :
@@ -225,6 +226,11 @@ private:
 RemoteSyncSM::Auth* RemoteSyncSM::sAuthPtr                  = 0;
 bool                RemoteSyncSM::sTraceRequestResponseFlag = false;
 int                 RemoteSyncSM::sOpResponseTimeoutSec     = 5 * 60;
+int                 RemoteSyncSM::sIdleTimeoutSec           = -1;
+int                 RemoteSyncSM::sMaxConnectionsPerPeer    = 1;
+int                 RemoteSyncSM::sKeepAliveIdleSec         = -1;
+int                 RemoteSyncSM::sKeepAliveIntervalSec     = -1;
+int                 RemoteSyncSM::sKeepAliveProbeCount      = -1;
 int                 RemoteSyncSM::sRemoteSyncCount          = 0;
 
 const int kMaxCmdHeaderLength = 2 << 10;
@@ -232,11 +238,13 @@ const int kMaxCmdHeaderLength = 2 << 10;
 inline void
 RemoteSyncSM::UpdateRecvTimeout()
 {
-    if (mOpResponseTimeoutSec < 0 || ! mNetConnection) {
+    const int timeout = (mDispatchedOps.empty() && 0 <= mIdleTimeoutSec) ?
+        mIdleTimeoutSec : mOpResponseTimeoutSec;
+    if (timeout < 0 || ! mNetConnection) {
         return;
     }
     const time_t now = GetNetManager().Now();
-    const time_t end = mLastRecvTime + mOpResponseTimeoutSec;
+    const time_t end = mLastRecvTime + timeout;
     mNetConnection->SetInactivityTimeout(end > now ? end - now : 0);
 }
 
@@ -254,6 +262,21 @@ RemoteSyncSM::SetParameters(
     sOpResponseTimeoutSec = props.getValue(
         name.Truncate(len).Append(
             "responseTimeoutSec"), sOpResponseTimeoutSec);
+    sIdleTimeoutSec = props.getValue(
+        name.Truncate(len).Append(
+            "idleTimeoutSec"), sIdleTimeoutSec);
+    sMaxConnectionsPerPeer = max(1, props.getValue(
+        name.Truncate(len).Append(
+            "maxConnectionsPerPeer"), sMaxConnectionsPerPeer));
+    sKeepAliveIdleSec = props.getValue(
+        name.Truncate(len).Append(
+            "keepAlive.idleSec"), sKeepAliveIdleSec);
+    sKeepAliveIntervalSec = props.getValue(
+        name.Truncate(len).Append(
+            "keepAlive.intervalSec"), sKeepAliveIntervalSec);
+    sKeepAliveProbeCount = props.getValue(
+        name.Truncate(len).Append(
+            "keepAlive.probeCount"), sKeepAliveProbeCount);
     if (! sAuthPtr) {
         sAuthPtr = new Auth();
     }
@@ -301,6 +324,7 @@ RemoteSyncSM::RemoteSyncSM(
       mFinishRecursionCount(0),
       mDeletedFlagPtr(0),
       mOpResponseTimeoutSec(sOpResponseTimeoutSec),
+      mIdleTimeoutSec(sIdleTimeoutSec),
       mTraceRequestResponseFlag(sTraceRequestResponseFlag)
 {
     QCASSERT(IsMutexOwner(GetMutexPtr()));
@@ -356,6 +380,12 @@ RemoteSyncSM::Connect()
         delete sock;
         return false;
     }
+    if (0 <= sKeepAliveIdleSec) {
+        // Keep idle pooled connections alive through firewalls and NAT, and
+        // detect dead peers before the connection is used.
+        sock->SetKeepAlive(
+            sKeepAliveIdleSec, sKeepAliveIntervalSec, sKeepAliveProbeCount);
+    }
 
     KFS_LOG_STREAM_INFO <<
         "connection to remote server " << mLocation <<
@@ -817,6 +847,18 @@ RemoteSyncSM::FinishSelf()
     }
 }
 
+size_t
+RemoteSyncSM::GetLoad() const
+{
+    const int kLoadUnitShift = 16;
+    return (mDispatchedOps.size() +
+        (mNetConnection ?
+            (size_t)(mNetConnection->GetNumBytesToWrite() >> kLoadUnitShift) :
+            size_t(0)) +
+        (size_t)(max(0, mReplyNumBytes) >> kLoadUnitShift)
+    );
+}
+
 bool
 RemoteSyncSM::IsAuthEnabled()
 {
@@ -1036,17 +1078,25 @@ RemoteSyncSM::FindServer(
     bool                  writeMasterFlag,
     bool                  shutdownSslFlag,
     int&                  err,
-    string&               errMsg)
+    string&               errMsg,
+    bool                  multipleConnectionsFlag)
 {
     err = 0;
     errMsg.clear();
-    RemoteSyncSMPtr const res = remoteSyncers.Find(
+    int             count = 0;
+    RemoteSyncSMPtr const res = remoteSyncers.FindLeastLoaded(
         RemoteSyncSMMatcher(
             location,
             0 < sessionKeyLen,
             shutdownSslFlag
-    ));
-    if (res) {
+        ), count);
+    // Open additional connection to the peer, if all existing connections
+    // are busy, in order to avoid head of line blocking of replication reads.
+    // The ops order is only preserved within a connection, therefore forwarded
+    // write ops must always use the same, single, connection to the peer.
+    const int maxCount = multipleConnectionsFlag ? sMaxConnectionsPerPeer : 1;
+    if (res && (! connectFlag || count >= maxCount ||
+            res->GetLoad() <= 0)) {
         if (0 < sessionKeyLen) {
             if (sessionTokenLen <= 0) {
                 err    = -EINVAL;
@@ -1086,6 +1136,21 @@ RemoteSyncSM::FindServer(
     if (peer) {
         return remoteSyncers.PutInList(*peer);
     }
+    if (res) {
+        // Use existing busy connection if the new connection has failed.
+        err = 0;
+        errMsg.clear();
+        if (0 < sessionKeyLen && ! res->UpdateSession(
+                sessionTokenPtr,
+                sessionTokenLen,
+                sessionKeyPtr,
+                sessionKeyLen,
+                writeMasterFlag,
+                err,
+                errMsg) && err) {
+            return RemoteSyncSMPtr();
+        }
+    }
     return res;
 }
 
@@ -146,10 +146,14 @@ public:
         bool                  writeMasterFlag,
         bool                  shutdownSslFlag,
         int&                  err,
-        string&               errMsg);
+        string&               errMsg,
+        bool                  multipleConnectionsFlag);
     static int GetResponseTimeoutSec() {
         return sOpResponseTimeoutSec;
     }
+    static int GetMaxConnectionsPerPeer() {
+        return sMaxConnectionsPerPeer;
+    }
     static bool IsAuthEnabled();
     bool HasAuthentication() const
         { return ! mSessionId.empty(); }
@@ -170,6 +174,10 @@ public:
         bool        writeMasterFlag,
         int&        err,
         string&     errMsg);
+    /// Approximate amount of work queued on the connection: the number of
+    /// ops awaiting response, plus pending request and response data in 64KB
+    /// units. Used to spread ops over multiple connections to the same peer.
+    size_t GetLoad() const;
 private:
     typedef map<
         kfsSeq_t,
@@ -206,10 +214,16 @@ private:
     int                mFinishRecursionCount;
     bool*              mDeletedFlagPtr;
     const int          mOpResponseTimeoutSec;
+    const int          mIdleTimeoutSec;
     const bool         mTraceRequestResponseFlag;
 
     static bool        sTraceRequestResponseFlag;
     static int         sOpResponseTimeoutSec;
+    static int         sIdleTimeoutSec;
+    static int         sMaxConnectionsPerPeer;
+    static int         sKeepAliveIdleSec;
+    static int         sKeepAliveIntervalSec;
+    static int         sKeepAliveProbeCount;
     static int         sRemoteSyncCount;
     static Auth*       sAuthPtr;
 
@@ -293,6 +307,28 @@ public:
             mList.begin(), mList.end(), funct);
         return (it == mList.end() ? RemoteSyncSMPtr() : *it);
     }
+    /// Return least loaded matching entry, and the number of matches.
+    template<typename T>
+    RemoteSyncSMPtr FindLeastLoaded(T funct, int& count)
+    {
+        count = 0;
+        RemoteSyncSM::SMList::const_iterator res = mList.end();
+        size_t                               load = 0;
+        for (RemoteSyncSM::SMList::const_iterator it = mList.begin();
+                it != mList.end();
+                ++it) {
+            if (! funct(*it)) {
+                continue;
+            }
+            count++;
+            const size_t cur = (*it)->GetLoad();
+            if (res == mList.end() || cur < load) {
+                res  = it;
+                load = cur;
+            }
+        }
+        return (res == mList.end() ? RemoteSyncSMPtr() : *res);
+    }
     RemoteSyncSMPtr PutInList(RemoteSyncSM& sm)
         { return sm.PutInList(mList); }
 private:
@@ -55,6 +55,7 @@
 #include "kfsio/Globals.h"
 #include "kfsio/ClientAuthContext.h"
 #include "kfsio/checksum.h"
+#include "kfsio/ITimeout.h"
 
 #include "qcdio/qcstutils.h"
 
@@ -64,6 +65,8 @@
 
 #include <string>
 #include <sstream>
+#include <deque>
+#include <map>
 
 namespace KFS
 {
@@ -98,6 +101,11 @@ public:
     // chunk with with 0 version in the the dirty directory. Such chunks
     // will be deleted upon restart.
     //
+    // Chunk copy reads the source chunk and writes the data into the new
+    // chunk id, which is assigned by the metaserver to the destination file
+    // offset. The source can be this chunk server, in which case the data
+    // does not leave the host.
+    //
     typedef Replicator::Counters Counters;
     static int GetNumReplications();
     static void CancelAll();
@@ -111,6 +119,11 @@ public:
             "chunkServer.replicator.readSkipDiskVerify",
             sReadSkipDiskVerifyFlag ? 1 : 0
         ) != 0;
+        sReadWindowCount = max(1, min(int(kMaxReadWindowCount), props.getValue(
+            "chunkServer.replicator.readWindowCount",
+            sReadWindowCount
+        )));
+        sRateLimiter.SetParameters(props);
     }
 
     ReplicatorImpl(ReplicateChunkOp *op, const RemoteSyncSMPtr &peer);
@@ -126,6 +139,8 @@ protected:
     // Inputs from the metaserver
     kfsFileId_t const     mFileId;
     kfsChunkId_t const    mChunkId;
+    // Chunk to read from the peer, differs from mChunkId with chunk copy.
+    kfsChunkId_t const    mSrcChunkId;
     kfsSeq_t              mChunkVersion;
     // What we obtain from the src from where we download the chunk.
     int64_t               mChunkSize;
@@ -144,6 +159,36 @@ protected:
     bool                  mCancelFlag;
     DiskIo::FilePtr       mFileHandle;
 
+    // Reads from the peer in flight, or completed and not yet written, in
+    // offset order. The number of read windows includes the window being
+    // written, and is limited by the buffer manager grant.
+    class PeerReadOp : public ReadOp
+    {
+    public:
+        PeerReadOp(ReplicatorImpl& owner)
+            : ReadOp(0),
+              mReplicator(owner),
+              mReadDoneFlag(false)
+            { SET_HANDLER(this, &PeerReadOp::HandlePeerReadDone); }
+        int HandlePeerReadDone(int code, void* data)
+        {
+            mReadDoneFlag = true;
+            mReplicator.PeerReadDone(*this);
+            return 0;
+        }
+        ReplicatorImpl& mReplicator;
+        bool            mReadDoneFlag;
+    };
+    friend class PeerReadOp;
+    typedef std::deque<PeerReadOp*> PeerReadOps;
+
+    int                   mReadWindowCount;
+    PeerReadOps           mPeerReadOps;
+    int                   mPeerReadsInFlightCount;
+    bool                  mPeerReadWaitFlag;
+    bool                  mTerminatePendingFlag;
+    int                   mTerminatePendingStatus;
+
     // Handle the callback for a size request
     int HandleStartDone(int code, void* data);
     // Handle the callback for a remote read request
@@ -174,6 +219,8 @@ protected:
             // Cancel buffers wait, and fail the op.
             CancelRequest();
             Terminate(ECANCELED);
+        } else if (sRateLimiter.Remove(*this)) {
+            Terminate(ECANCELED);
         }
     }
     virtual ByteCount GetBufferBytesRequired() const;
@@ -181,6 +228,75 @@ protected:
         { delete this; }
 
 private:
+    enum { kMaxReadWindowCount = 16 };
+
+    void EnqueuePeerRead(int64_t offset, bool frontFlag);
+    void PeerReadDone(PeerReadOp& op);
+    void PeerReadComplete();
+    void ClearPeerReads();
+    void StartWrite();
+    void RateLimitWaitDone();
+
+    // Token buckets limiting the replication and recovery write byte rate
+    // globally, per source chunk server, and per destination chunk
+    // directory. The buckets are allowed to go into "debt" by at most one
+    // read window, the replication is delayed until the debt is paid off.
+    class RateLimiter : public ITimeout
+    {
+    public:
+        RateLimiter()
+            : ITimeout(),
+              mMaxRate(0),
+              mMaxPeerRate(0),
+              mMaxDiskRate(0),
+              mBurstSec(1),
+              mBucket(),
+              mPeerBuckets(),
+              mDiskBuckets(),
+              mWaiters(),
+              mRegisteredFlag(false)
+            {}
+        ~RateLimiter()
+        {
+            if (mRegisteredFlag) {
+                globalNetManager().UnRegisterTimeoutHandler(this);
+            }
+        }
+        void SetParameters(const Properties& props);
+        bool Wait(ReplicatorImpl& repl, int64_t bytes);
+        bool Remove(ReplicatorImpl& repl);
+        virtual void Timeout();
+    private:
+        struct Bucket
+        {
+            Bucket()
+                : mTokens(0),
+                  mTime(-1)
+                {}
+            double  mTokens;
+            int64_t mTime;
+        };
+        typedef std::map<string, Bucket>                Buckets;
+        typedef std::multimap<int64_t, ReplicatorImpl*> Waiters;
+
+        int64_t mMaxRate;
+        int64_t mMaxPeerRate;
+        int64_t mMaxDiskRate;
+        double  mBurstSec;
+        Bucket  mBucket;
+        Buckets mPeerBuckets;
+        Buckets mDiskBuckets;
+        Waiters mWaiters;
+        bool    mRegisteredFlag;
+
+        void Consume(Bucket& bucket, int64_t rate, int64_t now,
+            int64_t bytes, int64_t& resumeTime) const;
+    };
+    friend class RateLimiter;
+
+    int64_t               mRateLimitResumeTime;
+    string                mDirName;
+
     typedef std::map<
         kfsChunkId_t, ReplicatorImpl*,
         std::less<kfsChunkId_t>,
@@ -193,6 +309,8 @@ private:
     static Counters             sCounters;
     static bool                 sUseConnectionPoolFlag;
     static bool                 sReadSkipDiskVerifyFlag;
+    static int                  sReadWindowCount;
+    static RateLimiter          sRateLimiter;
 private:
     // No copy.
     ReplicatorImpl(const ReplicatorImpl&);
@@ -206,6 +324,119 @@ ReplicatorImpl::InFlightReplications ReplicatorImpl::sInFlightReplications;
 ReplicatorImpl::Counters             ReplicatorImpl::sCounters;
 bool ReplicatorImpl::sUseConnectionPoolFlag  = false;
 bool ReplicatorImpl::sReadSkipDiskVerifyFlag = true;
+int  ReplicatorImpl::sReadWindowCount        = 2;
+ReplicatorImpl::RateLimiter          ReplicatorImpl::sRateLimiter;
+
+void
+ReplicatorImpl::RateLimiter::SetParameters(const Properties& props)
+{
+    mMaxRate = props.getValue(
+        "chunkServer.replicator.maxRateBytesPerSec", mMaxRate);
+    mMaxPeerRate = props.getValue(
+        "chunkServer.replicator.maxPeerRateBytesPerSec", mMaxPeerRate);
+    mMaxDiskRate = props.getValue(
+        "chunkServer.replicator.maxDirRateBytesPerSec", mMaxDiskRate);
+    mBurstSec = max(0., props.getValue(
+        "chunkServer.replicator.rateBurstSec", mBurstSec));
+    if (mMaxPeerRate <= 0) {
+        mPeerBuckets.clear();
+    }
+    if (mMaxDiskRate <= 0) {
+        mDiskBuckets.clear();
+    }
+}
+
+void
+ReplicatorImpl::RateLimiter::Consume(Bucket& bucket, int64_t rate,
+    int64_t now, int64_t bytes, int64_t& resumeTime) const
+{
+    const double burst = mBurstSec * rate;
+    if (bucket.mTime < 0) {
+        bucket.mTokens = burst;
+    } else if (bucket.mTokens < burst && bucket.mTime < now) {
+        bucket.mTokens = min(burst,
+            bucket.mTokens + (now - bucket.mTime) * 1e-6 * rate);
+    }
+    bucket.mTime    = now;
+    bucket.mTokens -= bytes;
+    if (bucket.mTokens < 0) {
+        resumeTime = max(resumeTime,
+            now + (int64_t)(-bucket.mTokens * 1e6 / rate));
+    }
+}
+
+bool
+ReplicatorImpl::RateLimiter::Wait(ReplicatorImpl& repl, int64_t bytes)
+{
+    if ((mMaxRate <= 0 && mMaxPeerRate <= 0 && mMaxDiskRate <= 0) ||
+            bytes <= 0) {
+        return false;
+    }
+    const int64_t now        = microseconds();
+    int64_t       resumeTime = now;
+    if (0 < mMaxRate) {
+        Consume(mBucket, mMaxRate, now, bytes, resumeTime);
+    }
+    if (0 < mMaxPeerRate && repl.mPeer) {
+        Consume(mPeerBuckets[repl.GetPeerName()], mMaxPeerRate, now, bytes,
+            resumeTime);
+    }
+    if (0 < mMaxDiskRate && ! repl.mDirName.empty()) {
+        Consume(mDiskBuckets[repl.mDirName], mMaxDiskRate, now, bytes,
+            resumeTime);
+    }
+    if (resumeTime <= now) {
+        return false;
+    }
+    Ctrs().mRateLimitWaitCount++;
+    Ctrs().mRateLimitWaitMicroSecs += resumeTime - now;
+    repl.mRateLimitResumeTime = resumeTime;
+    mWaiters.insert(make_pair(resumeTime, &repl));
+    if (! mRegisteredFlag) {
+        mRegisteredFlag = true;
+        globalNetManager().RegisterTimeoutHandler(this);
+    }
+    return true;
+}
+
+bool
+ReplicatorImpl::RateLimiter::Remove(ReplicatorImpl& repl)
+{
+    if (repl.mRateLimitResumeTime <= 0) {
+        return false;
+    }
+    pair<Waiters::iterator, Waiters::iterator> const range =
+        mWaiters.equal_range(repl.mRateLimitResumeTime);
+    repl.mRateLimitResumeTime = 0;
+    for (Waiters::iterator it = range.first; it != range.second; ++it) {
+        if (it->second == &repl) {
+            mWaiters.erase(it);
+            if (mWaiters.empty() && mRegisteredFlag) {
+                mRegisteredFlag = false;
+                globalNetManager().UnRegisterTimeoutHandler(this);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+ReplicatorImpl::RateLimiter::Timeout()
+{
+    const int64_t now = microseconds();
+    Waiters::iterator it;
+    while (! mWaiters.empty() && (it = mWaiters.begin())->first <= now) {
+        ReplicatorImpl& repl = *it->second;
+        mWaiters.erase(it);
+        repl.mRateLimitResumeTime = 0;
+        repl.RateLimitWaitDone();
+    }
+    if (mWaiters.empty() && mRegisteredFlag) {
+        mRegisteredFlag = false;
+        globalNetManager().UnRegisterTimeoutHandler(this);
+    }
+}
 
 int
 ReplicatorImpl::GetNumReplications()
@@ -259,6 +490,7 @@ ReplicatorImpl::ReplicatorImpl(ReplicateChunkOp *op, const RemoteSyncSMPtr &peer
     BufferManager::Client(),
     mFileId(op->fid),
     mChunkId(op->chunkId),
+    mSrcChunkId(0 <= op->sourceChunkId ? op->sourceChunkId : op->chunkId),
     mChunkVersion(op->chunkVersion),
     mOwner(op),
     mOffset(0),
@@ -268,9 +500,17 @@ ReplicatorImpl::ReplicatorImpl(ReplicateChunkOp *op, const RemoteSyncSMPtr &peer
     mWriteOp(op->chunkId, op->chunkVersion),
     mDone(false),
     mCancelFlag(false),
-    mFileHandle()
+    mFileHandle(),
+    mReadWindowCount(sReadWindowCount),
+    mPeerReadOps(),
+    mPeerReadsInFlightCount(0),
+    mPeerReadWaitFlag(false),
+    mTerminatePendingFlag(false),
+    mTerminatePendingStatus(0),
+    mRateLimitResumeTime(0),
+    mDirName()
 {
-    mReadOp.chunkId = op->chunkId;
+    mReadOp.chunkId = mSrcChunkId;
     mReadOp.chunkVersion = op->chunkVersion;
     if (! op->chunkAccess.empty()) {
         mReadOp.requestChunkAccess          = mOwner->chunkAccess.c_str();
@@ -287,17 +527,20 @@ ReplicatorImpl::ReplicatorImpl(ReplicateChunkOp *op, const RemoteSyncSMPtr &peer
 
 ReplicatorImpl::~ReplicatorImpl()
 {
-    if (GetByteCount() != 0 || IsWaiting() || mOwner) {
+    if (GetByteCount() != 0 || IsWaiting() || mOwner ||
+            0 < mPeerReadsInFlightCount || 0 < mRateLimitResumeTime) {
         ostringstream os;
         os << "replication: invalid destructor invocation"
             " "        << (const void*)this <<
             " chunk: " << mChunkId <<
             " owner: " << (const void*)mOwner <<
             " bytes: " << GetByteCount() <<
-            " + "      << GetWaitingForByteCount()
+            " + "      << GetWaitingForByteCount() <<
+            " reads: " << mPeerReadsInFlightCount
         ;
         die(os.str());
     }
+    ClearPeerReads();
 }
 
 void
@@ -337,8 +580,13 @@ ReplicatorImpl::Run()
     }
 
     const ByteCount kChunkHeaderSize = 16 << 10;
+    BufferManager&  bufMgr           = DiskIo::GetBufferManager();
+    // Use fewer read windows rather than failing, if all of them do not fit.
+    while (1 < mReadWindowCount && bufMgr.IsOverQuota(
+            *this, max(kChunkHeaderSize, GetBufferBytesRequired()))) {
+        mReadWindowCount--;
+    }
     const ByteCount bufBytes = max(kChunkHeaderSize, GetBufferBytesRequired());
-    BufferManager&  bufMgr   = DiskIo::GetBufferManager();
     if (bufMgr.IsOverQuota(*this, bufBytes)) {
         KFS_LOG_STREAM_ERROR << "replication:"
             " chunk: "      << mChunkId <<
@@ -365,7 +613,7 @@ ReplicatorImpl::Run()
 ReplicatorImpl::ByteCount
 ReplicatorImpl::GetBufferBytesRequired() const
 {
-    return kDefaultReplicationReadSize;
+    return ((ByteCount)kDefaultReplicationReadSize * mReadWindowCount);
 }
 
 void
@@ -384,7 +632,7 @@ ReplicatorImpl::Start()
 {
     assert(mPeer);
 
-    mChunkMetadataOp.chunkId           = mChunkId;
+    mChunkMetadataOp.chunkId           = mSrcChunkId;
     mReadOp.skipVerifyDiskChecksumFlag = sReadSkipDiskVerifyFlag;
     mChunkMetadataOp.readVerifyFlag    = false;
     SET_HANDLER(this, &ReplicatorImpl::HandleStartDone);
@@ -408,7 +656,10 @@ ReplicatorImpl::HandleStartDone(int code, void* data)
         return 0;
     }
     mChunkSize    = mChunkMetadataOp.chunkSize;
-    mChunkVersion = mChunkMetadataOp.chunkVersion;
+    // The copy gets the version assigned by the metaserver, the source chunk
+    // version is only used to read the source.
+    mChunkVersion = mSrcChunkId == mChunkId ?
+        mChunkMetadataOp.chunkVersion : mOwner->targetVersion;
     if (mChunkSize < 0 || mChunkSize > (int64_t)CHUNKSIZE) {
         KFS_LOG_STREAM_INFO << "replication:"
             " invalid chunk size: " << mChunkSize <<
@@ -418,7 +669,7 @@ ReplicatorImpl::HandleStartDone(int code, void* data)
     }
 
     assert(! mFileHandle);
-    mReadOp.chunkVersion = mChunkVersion;
+    mReadOp.chunkVersion = mChunkMetadataOp.chunkVersion;
     // set the version to a value that will never be used; if
     // replication is successful, we then bump up the counter.
     mWriteOp.chunkVersion = 0;
@@ -450,6 +701,7 @@ ReplicatorImpl::HandleStartDone(int code, void* data)
         Terminate(-EINVAL);
         return -1;
     }
+    mDirName = gChunkManager.GetDirName(mChunkId, mWriteOp.chunkVersion);
     KFS_LOG_STREAM_INFO << "replication:"
         " chunk: "  << mChunkId <<
         " peer: "   << GetPeerName() <<
@@ -484,16 +736,103 @@ ReplicatorImpl::Read()
     if (mOffset % (int)CHECKSUM_BLOCKSIZE != 0) {
         mReadOp.skipVerifyDiskChecksumFlag = false;
     }
-    assert(mPeer);
+    assert(mPeer && ! mPeerReadWaitFlag);
     SET_HANDLER(this, &ReplicatorImpl::HandleReadDone);
-    mReadOp.checksum.clear();
-    mReadOp.status     = 0;
-    mReadOp.offset     = mOffset;
-    mReadOp.numBytesIO = 0;
-    mReadOp.numBytes   = (int)min(
-        mChunkSize - mOffset, int64_t(kDefaultReplicationReadSize));
+    // The front read normally matches the current position, unless the
+    // window has to be re-read, for example with disk checksum verification.
+    if (mPeerReadOps.empty() || mPeerReadOps.front()->offset != mOffset) {
+        EnqueuePeerRead(mOffset, true);
+    }
+    // No write is in flight at this point, therefore all windows can be used
+    // to read ahead, while the front window is being written.
+    const PeerReadOp& back = *mPeerReadOps.back();
+    int64_t           next = back.offset + (int64_t)back.numBytes;
+    while ((int)mPeerReadOps.size() < mReadWindowCount && next < mChunkSize) {
+        EnqueuePeerRead(next, false);
+        next += (int64_t)mPeerReadOps.back()->numBytes;
+    }
+    if (mPeerReadOps.front()->mReadDoneFlag) {
+        PeerReadComplete();
+    } else {
+        mPeerReadWaitFlag = true;
+    }
+}
+
+void
+ReplicatorImpl::EnqueuePeerRead(int64_t offset, bool frontFlag)
+{
+    PeerReadOp* const op = new PeerReadOp(*this);
+    op->chunkId                    = mSrcChunkId;
+    op->chunkVersion               = mReadOp.chunkVersion;
+    op->requestChunkAccess         = mReadOp.requestChunkAccess;
+    op->skipVerifyDiskChecksumFlag = mReadOp.skipVerifyDiskChecksumFlag;
+    op->replicationReadFlag        = true;
+    op->clnt                       = this;
+    op->offset                     = offset;
+    op->numBytes                   = (size_t)min(
+        mChunkSize - offset, int64_t(kDefaultReplicationReadSize));
+    if (frontFlag) {
+        mPeerReadOps.push_front(op);
+    } else {
+        mPeerReadOps.push_back(op);
+    }
+    mPeerReadsInFlightCount++;
+    mPeer->Enqueue(op);
+}
+
+void
+ReplicatorImpl::PeerReadDone(PeerReadOp& op)
+{
+    assert(0 < mPeerReadsInFlightCount);
+    mPeerReadsInFlightCount--;
+    if (mTerminatePendingFlag) {
+        if (mPeerReadsInFlightCount <= 0) {
+            mTerminatePendingFlag = false;
+            Terminate(mTerminatePendingStatus);
+        }
+        return;
+    }
+    if (mPeerReadWaitFlag && &op == mPeerReadOps.front()) {
+        mPeerReadWaitFlag = false;
+        PeerReadComplete();
+    }
+}
+
+void
+ReplicatorImpl::PeerReadComplete()
+{
+    PeerReadOp* const op = mPeerReadOps.front();
+    mPeerReadOps.pop_front();
+    assert(op->mReadDoneFlag && op->offset == mOffset);
+    if (op->status == -EBADCKSUM && op->skipVerifyDiskChecksumFlag &&
+            ! mReadOp.skipVerifyDiskChecksumFlag && ! mCancelFlag) {
+        // Read ahead was issued before the disk checksum verification was
+        // turned on by the previous window read retry.
+        delete op;
+        Read();
+        return;
+    }
+    mReadOp.status                     = op->status;
+    mReadOp.statusMsg.swap(op->statusMsg);
+    mReadOp.offset                     = op->offset;
+    mReadOp.numBytes                   = op->numBytes;
+    mReadOp.numBytesIO                 = op->numBytesIO;
+    mReadOp.skipVerifyDiskChecksumFlag = op->skipVerifyDiskChecksumFlag;
+    mReadOp.checksum.swap(op->checksum);
     mReadOp.dataBuf.Clear();
-    mPeer->Enqueue(&mReadOp);
+    mReadOp.dataBuf.Move(&op->dataBuf);
+    delete op;
+    HandleReadDone(EVENT_CMD_DONE, &mReadOp);
+}
+
+void
+ReplicatorImpl::ClearPeerReads()
+{
+    while (! mPeerReadOps.empty()) {
+        delete mPeerReadOps.back();
+        mPeerReadOps.pop_back();
+    }
+    mPeerReadWaitFlag = false;
 }
 
 int
@@ -591,13 +930,31 @@ ReplicatorImpl::HandleReadDone(int code, void* data)
         Ctrs().mReadCount++;
         Ctrs().mReadByteCount += numRd;
     }
+    if (! sRateLimiter.Wait(*this, numRd)) {
+        StartWrite();
+    }
+    return 0;
+}
+
+void
+ReplicatorImpl::StartWrite()
+{
     SET_HANDLER(this, &ReplicatorImpl::HandleWriteDone);
     const int status = gChunkManager.WriteChunk(&mWriteOp, &mFileHandle);
     if (status < 0) {
         // abort everything
         Terminate(status);
     }
-    return 0;
+}
+
+void
+ReplicatorImpl::RateLimitWaitDone()
+{
+    if (mCancelFlag) {
+        Terminate(ECANCELED);
+        return;
+    }
+    StartWrite();
 }
 
 int
@@ -638,6 +995,14 @@ ReplicatorImpl::HandleWriteDone(int code, void* data)
 void
 ReplicatorImpl::Terminate(int status)
 {
+    if (0 < mPeerReadsInFlightCount) {
+        // Peer read completions reference this, wait for all of them.
+        if (! mTerminatePendingFlag) {
+            mTerminatePendingFlag   = true;
+            mTerminatePendingStatus = status;
+        }
+        return;
+    }
     int res;
     if (mDone && ! mCancelFlag) {
         KFS_LOG_STREAM_INFO << "replication:"
@@ -709,6 +1074,7 @@ ReplicatorImpl::HandleReplicationDone(int code, void* data)
     mWriteOp.diskIo.reset();
     mWriteOp.dataBuf.Clear();
     mReadOp.dataBuf.Clear();
+    ClearPeerReads();
     mReadOp.requestChunkAccess          = 0;
     mChunkMetadataOp.requestChunkAccess = 0;
     // Un-register with the buffer manager, update the counters and remove from
@@ -806,6 +1172,10 @@ public:
         sRSReaderPanicOnInvalidChunkFlag = props.getValue(
             "chunkServer.rsReader.panicOnInvalidChunk",
             sRSReaderPanicOnInvalidChunkFlag ? 1 : 0) != 0;
+        sRSReaderHedgeTimeoutMs = props.getValue(
+            "chunkServer.rsReader.hedgeTimeoutMs",
+            sRSReaderHedgeTimeoutMs
+        );
         sMaxRecoveryThreads = props.getValue(
             "chunkServer.rsReader.maxRecoveryThreads",
             sMaxRecoveryThreads
@@ -1020,7 +1390,10 @@ private:
     }
     virtual ByteCount GetBufferBytesRequired() const
     {
-        return (mReadSize * (mOwner ? mOwner->numStripes + 1 : 0));
+        // With hedged reads all stripes might be read at the same time.
+        return (mReadSize * (mOwner ? 1 + mOwner->numStripes +
+            (0 <= sRSReaderHedgeTimeoutMs ? mOwner->numRecoveryStripes : 0)
+            : 0));
     }
     void Enqueue(State inState)
     {
@@ -1374,6 +1747,7 @@ private:
         if (0 <= mChunkMetadataOp.status) {
             const bool kSkipHolesFlag                 = true;
             const bool kUseDefaultBufferAllocatorFlag = true;
+            mReader.SetRecoveryHedgeTimeout(sRSReaderHedgeTimeoutMs);
             mChunkMetadataOp.status = mReader.Open(
                 mFileId,
                 mOwner->pathName.c_str(),
@@ -1697,6 +2071,7 @@ private:
     static int        sRSReaderMetaOpTimeoutSec;
     static int        sRSReaderMetaIdleTimeoutSec;
     static int        sRSReaderMaxRecoverChunkSize;
+    static int        sRSReaderHedgeTimeoutMs;
     static int        sMaxRecoveryThreads;
     static bool       sRSReaderMetaResetConnectionOnOpTimeoutFlag;
     static bool       sRSReaderPanicOnInvalidChunkFlag;
@@ -1728,6 +2103,7 @@ bool RSReplicatorImpl::sRSReaderMetaResetConnectionOnOpTimeoutFlag = true;
 int  RSReplicatorImpl::sRSReaderMaxRecoverChunkSize                =
     (int)CHUNKSIZE;
 bool RSReplicatorImpl::sRSReaderPanicOnInvalidChunkFlag            = false;
+int  RSReplicatorImpl::sRSReaderHedgeTimeoutMs                     = -1;
 bool RSReplicatorImpl::sDebugSetThreadFlag                         = false;
 uint64_t   RSReplicatorImpl::sAuthUpdateCount                      = 0;
 uint64_t   RSReplicatorImpl::sDebugSetThreadUpdateCount            = 0;
@@ -1811,6 +2187,17 @@ Replicator::Run(ReplicateChunkOp* op)
         SubmitOpResponse(op);
         return;
     }
+    if (0 <= op->sourceChunkId && (! op->location.IsValid() ||
+            op->sourceChunkId == op->chunkId || op->targetVersion <= 0)) {
+        op->status    = -EINVAL;
+        op->statusMsg = "invalid chunk copy request";
+        ReplicatorImpl::Ctrs().mReplicationErrorCount++;
+        KFS_LOG_STREAM_ERROR << "replication: " << op->statusMsg <<
+            " " << op->Show() <<
+        KFS_LOG_EOM;
+        SubmitOpResponse(op);
+        return;
+    }
     ReplicatorImpl* impl = 0;
     if (op->location.IsValid()) {
         ReplicatorImpl::Ctrs().mReplicationCount++;
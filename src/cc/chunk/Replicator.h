@@ -55,6 +55,8 @@ public:
         Counter mWriteCount;
         Counter mReadByteCount;
         Counter mWriteByteCount;
+        Counter mRateLimitWaitCount;
+        Counter mRateLimitWaitMicroSecs;
         Counters()
             : mReplicationCount(0),
               mReplicationErrorCount(0),
@@ -66,7 +68,9 @@ public:
               mReadCount(0),
               mWriteCount(0),
               mReadByteCount(0),
-              mWriteByteCount(0)
+              mWriteByteCount(0),
+              mRateLimitWaitCount(0),
+              mRateLimitWaitMicroSecs(0)
             {}
         void Reset()
             { *this = Counters(); }
@@ -0,0 +1,369 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \file ShortCircuitServer.cc
+// \brief Short circuit local read descriptor server implementation.
+//
+// The unix domain socket protocol: the client sends the grant id as decimal
+// number terminated by new line, the server responds with decimal status
+// terminated by new line, 0 on success, or negative error code. On success
+// the response carries the chunk file descriptor as SCM_RIGHTS ancillary
+// data. The server closes the connection after the response.
+//
+//----------------------------------------------------------------------------
+
+#include "ShortCircuitServer.h"
+
+#include "common/MsgLogger.h"
+#include "common/Properties.h"
+
+#include "qcdio/QCUtils.h"
+#include "qcdio/qcstutils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace KFS
+{
+
+ShortCircuitServer gShortCircuitServer;
+
+ShortCircuitServer::ShortCircuitServer()
+    : QCRunnable(),
+      mMutex(),
+      mThread(),
+      mPrng(),
+      mGrants(),
+      mSocketPath(),
+      mListenFd(-1),
+      mGrantTimeoutSec(10),
+      mLeaseSec(60),
+      mMaxGrants(4 << 10),
+      mStopFlag(false),
+      mParametersSetFlag(false),
+      mCounters()
+{
+    mCounters.Clear();
+}
+
+ShortCircuitServer::~ShortCircuitServer()
+{
+    ShortCircuitServer::Shutdown();
+}
+
+void
+ShortCircuitServer::SetParameters(
+    const Properties& inProps)
+{
+    QCStMutexLocker theLocker(mMutex);
+    mGrantTimeoutSec = inProps.getValue(
+        "chunkServer.shortCircuit.grantTimeoutSec", mGrantTimeoutSec);
+    mLeaseSec = inProps.getValue(
+        "chunkServer.shortCircuit.leaseSec", mLeaseSec);
+    mMaxGrants = inProps.getValue(
+        "chunkServer.shortCircuit.maxGrants", mMaxGrants);
+    if (mParametersSetFlag) {
+        return;
+    }
+    mParametersSetFlag = true;
+    const string thePath = inProps.getValue(
+        "chunkServer.shortCircuit.socketPath", string());
+    if (thePath.empty()) {
+        return;
+    }
+    QCStMutexUnlocker theUnlocker(mMutex);
+    if (Start(thePath)) {
+        mThread.Start(this, -1, "ShortCircuit");
+    }
+}
+
+bool
+ShortCircuitServer::Start(
+    const string& inPath)
+{
+    struct sockaddr_un theAddr;
+    memset(&theAddr, 0, sizeof(theAddr));
+    if (sizeof(theAddr.sun_path) <= inPath.size()) {
+        KFS_LOG_STREAM_ERROR <<
+            "short circuit: socket path is too long: " << inPath <<
+        KFS_LOG_EOM;
+        return false;
+    }
+    theAddr.sun_family = AF_UNIX;
+    memcpy(theAddr.sun_path, inPath.data(), inPath.size());
+    const int theFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (theFd < 0) {
+        const int theErr = errno;
+        KFS_LOG_STREAM_ERROR <<
+            "short circuit: socket: " << QCUtils::SysError(theErr) <<
+        KFS_LOG_EOM;
+        return false;
+    }
+    fcntl(theFd, F_SETFD, FD_CLOEXEC);
+    // Remove stale socket left by the previous run, if any.
+    unlink(inPath.c_str());
+    if (bind(theFd, reinterpret_cast<const struct sockaddr*>(&theAddr),
+                sizeof(theAddr)) != 0 ||
+            listen(theFd, 128) != 0) {
+        const int theErr = errno;
+        KFS_LOG_STREAM_ERROR <<
+            "short circuit: " << inPath <<
+            ": " << QCUtils::SysError(theErr) <<
+        KFS_LOG_EOM;
+        close(theFd);
+        return false;
+    }
+    // The grant ids are secret, and only returned with the authorized
+    // requests, therefore all local users are allowed to connect.
+    chmod(inPath.c_str(), 0666);
+    if (! mPrng.Init()) {
+        KFS_LOG_STREAM_ERROR <<
+            "short circuit: failed to initialize random number generator" <<
+        KFS_LOG_EOM;
+        close(theFd);
+        unlink(inPath.c_str());
+        return false;
+    }
+    QCStMutexLocker theLocker(mMutex);
+    mSocketPath = inPath;
+    mListenFd   = theFd;
+    mStopFlag   = false;
+    KFS_LOG_STREAM_INFO <<
+        "short circuit: listening on: " << mSocketPath <<
+    KFS_LOG_EOM;
+    return true;
+}
+
+void
+ShortCircuitServer::Shutdown()
+{
+    {
+        QCStMutexLocker theLocker(mMutex);
+        if (mListenFd < 0) {
+            return;
+        }
+        mStopFlag = true;
+    }
+    if (mThread.IsStarted()) {
+        mThread.Join();
+    }
+    QCStMutexLocker theLocker(mMutex);
+    close(mListenFd);
+    mListenFd = -1;
+    unlink(mSocketPath.c_str());
+    for (Grants::iterator theIt = mGrants.begin();
+            theIt != mGrants.end();
+            ++theIt) {
+        close(theIt->second.mFd);
+    }
+    mGrants.clear();
+}
+
+int64_t
+ShortCircuitServer::Grant(
+    int          inFd,
+    kfsChunkId_t inChunkId)
+{
+    if (inFd < 0) {
+        return -EBADF;
+    }
+    QCStMutexLocker theLocker(mMutex);
+    if (mListenFd < 0 || mStopFlag) {
+        close(inFd);
+        return -ENOTSUP;
+    }
+    if (mMaxGrants <= (int)mGrants.size()) {
+        close(inFd);
+        return -EAGAIN;
+    }
+    fcntl(inFd, F_SETFD, FD_CLOEXEC);
+    const time_t theExpires = time(0) + mGrantTimeoutSec;
+    int64_t      theId;
+    do {
+        theId = (int64_t)(mPrng.Rand() >> 1);
+    } while (theId <= 0 || mGrants.find(theId) != mGrants.end());
+    mGrants[theId] = GrantEntry(inFd, inChunkId, theExpires);
+    mCounters.mGrantCount++;
+    return theId;
+}
+
+void
+ShortCircuitServer::Revoke(
+    kfsChunkId_t inChunkId)
+{
+    QCStMutexLocker theLocker(mMutex);
+    Grants::iterator theIt = mGrants.begin();
+    while (theIt != mGrants.end()) {
+        if (theIt->second.mChunkId == inChunkId) {
+            close(theIt->second.mFd);
+            mGrants.erase(theIt++);
+            mCounters.mRevokedCount++;
+        } else {
+            ++theIt;
+        }
+    }
+}
+
+void
+ShortCircuitServer::GetCounters(
+    ShortCircuitServer::Counters& outCounters)
+{
+    QCStMutexLocker theLocker(mMutex);
+    outCounters = mCounters;
+    outCounters.mGrantsInFlightCount = (Counters::Counter)mGrants.size();
+}
+
+void
+ShortCircuitServer::Expire(
+    time_t inNow)
+{
+    Grants::iterator theIt = mGrants.begin();
+    while (theIt != mGrants.end()) {
+        if (theIt->second.mExpires < inNow) {
+            close(theIt->second.mFd);
+            mGrants.erase(theIt++);
+            mCounters.mExpiredCount++;
+        } else {
+            ++theIt;
+        }
+    }
+}
+
+void
+ShortCircuitServer::Run()
+{
+    QCStMutexLocker theLocker(mMutex);
+    while (! mStopFlag) {
+        Expire(time(0));
+        const int theListenFd = mListenFd;
+        int       theSocket   = -1;
+        {
+            QCStMutexUnlocker theUnlocker(mMutex);
+            struct pollfd thePoll;
+            thePoll.fd      = theListenFd;
+            thePoll.events  = POLLIN;
+            thePoll.revents = 0;
+            const int kPollTimeoutMs = 1000;
+            if (poll(&thePoll, 1, kPollTimeoutMs) <= 0 ||
+                    (thePoll.revents & POLLIN) == 0) {
+                continue;
+            }
+            if ((theSocket = accept(theListenFd, 0, 0)) < 0) {
+                continue;
+            }
+            fcntl(theSocket, F_SETFD, FD_CLOEXEC);
+            struct timeval theTimeout;
+            theTimeout.tv_sec  = 1;
+            theTimeout.tv_usec = 0;
+            setsockopt(theSocket, SOL_SOCKET, SO_RCVTIMEO,
+                &theTimeout, sizeof(theTimeout));
+            setsockopt(theSocket, SOL_SOCKET, SO_SNDTIMEO,
+                &theTimeout, sizeof(theTimeout));
+        }
+        Claim(theSocket);
+        close(theSocket);
+    }
+}
+
+void
+ShortCircuitServer::Claim(
+    int inSocket)
+{
+    // The mutex is held on entry, release it while waiting for the request.
+    char theBuf[64];
+    int  theLen = 0;
+    {
+        QCStMutexUnlocker theUnlocker(mMutex);
+        while (theLen < (int)sizeof(theBuf) - 1) {
+            const ssize_t theNRd = read(
+                inSocket, theBuf + theLen, sizeof(theBuf) - 1 - theLen);
+            if (theNRd <= 0) {
+                break;
+            }
+            theLen += (int)theNRd;
+            if (memchr(theBuf, '\n', theLen)) {
+                break;
+            }
+        }
+    }
+    theBuf[theLen] = 0;
+    char*         theEndPtr = 0;
+    const int64_t theId     = (int64_t)strtoll(theBuf, &theEndPtr, 10);
+    int           theFd     = -1;
+    int           theStatus = -ENOENT;
+    if (0 < theId && theEndPtr && *theEndPtr == '\n') {
+        Grants::iterator const theIt = mGrants.find(theId);
+        if (theIt != mGrants.end()) {
+            theFd     = theIt->second.mFd;
+            theStatus = 0;
+            mGrants.erase(theIt);
+        }
+    } else {
+        theStatus = -EINVAL;
+    }
+    if (theStatus == 0) {
+        mCounters.mClaimCount++;
+    } else {
+        mCounters.mClaimErrorCount++;
+    }
+    QCStMutexUnlocker theUnlocker(mMutex);
+    char theResp[32];
+    const int theRespLen = snprintf(theResp, sizeof(theResp), "%d\n",
+        theStatus);
+    struct iovec theIov;
+    theIov.iov_base = theResp;
+    theIov.iov_len  = (size_t)theRespLen;
+    struct msghdr theMsg;
+    memset(&theMsg, 0, sizeof(theMsg));
+    theMsg.msg_iov    = &theIov;
+    theMsg.msg_iovlen = 1;
+    char theCtl[CMSG_SPACE(sizeof(int))];
+    if (0 <= theFd) {
+        memset(theCtl, 0, sizeof(theCtl));
+        theMsg.msg_control    = theCtl;
+        theMsg.msg_controllen = sizeof(theCtl);
+        struct cmsghdr* const theCmsgPtr = CMSG_FIRSTHDR(&theMsg);
+        theCmsgPtr->cmsg_level = SOL_SOCKET;
+        theCmsgPtr->cmsg_type  = SCM_RIGHTS;
+        theCmsgPtr->cmsg_len   = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(theCmsgPtr), &theFd, sizeof(theFd));
+    }
+    if (sendmsg(inSocket, &theMsg, 0) != (ssize_t)theRespLen) {
+        const int theErr = errno;
+        KFS_LOG_STREAM_DEBUG <<
+            "short circuit: send: " << QCUtils::SysError(theErr) <<
+        KFS_LOG_EOM;
+    }
+    if (0 <= theFd) {
+        close(theFd);
+    }
+}
+
+}
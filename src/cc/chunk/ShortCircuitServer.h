@@ -0,0 +1,156 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \file ShortCircuitServer.h
+// \brief Short circuit local read descriptor server. The get chunk metadata
+// request with short circuit flag, validated with the chunk access token by
+// the client connection state machine, creates a grant: read only open of
+// the stable chunk file, keyed by random grant id, and returns the id
+// along with the chunk checksums. The client on the same host connects to
+// the unix domain socket, sends the grant id, and receives the file
+// descriptor with SCM_RIGHTS. Grants that are not claimed within the grant
+// timeout are closed. Grants are revoked when the chunk becomes stale, not
+// stable, or deleted. Once claimed, the descriptor use is bounded by the
+// lease time returned with the grant, after which the client must request a
+// new grant. The socket thread only accesses the grant table, and never the
+// chunk manager, in order to avoid any locking in the chunk server main
+// thread, except the grant table mutex.
+//
+//----------------------------------------------------------------------------
+
+#ifndef CHUNKSERVER_SHORTCIRCUITSERVER_H
+#define CHUNKSERVER_SHORTCIRCUITSERVER_H
+
+#include "common/kfstypes.h"
+#include "kfsio/PrngIsaac64.h"
+#include "qcdio/QCThread.h"
+#include "qcdio/QCMutex.h"
+
+#include <string>
+#include <map>
+
+#include <inttypes.h>
+#include <time.h>
+
+namespace KFS
+{
+using std::string;
+using std::map;
+
+class Properties;
+
+class ShortCircuitServer : public QCRunnable
+{
+public:
+    struct Counters
+    {
+        typedef int64_t Counter;
+
+        Counter mGrantCount;
+        Counter mClaimCount;
+        Counter mExpiredCount;
+        Counter mRevokedCount;
+        Counter mClaimErrorCount;
+        Counter mGrantsInFlightCount;
+
+        void Clear()
+        {
+            mGrantCount          = 0;
+            mClaimCount          = 0;
+            mExpiredCount        = 0;
+            mRevokedCount        = 0;
+            mClaimErrorCount     = 0;
+            mGrantsInFlightCount = 0;
+        }
+    };
+
+    ShortCircuitServer();
+    virtual ~ShortCircuitServer();
+    // The socket path is only used by the first call, i.e. can only be set
+    // at startup.
+    void SetParameters(
+        const Properties& inProps);
+    void Shutdown();
+    bool IsEnabled() const
+        { return (0 <= mListenFd); }
+    // Takes ownership of the file descriptor. Returns positive grant id, or
+    // negative error code, in which case the descriptor is closed.
+    int64_t Grant(
+        int          inFd,
+        kfsChunkId_t inChunkId);
+    // Close all not yet claimed grants of the chunk.
+    void Revoke(
+        kfsChunkId_t inChunkId);
+    const string& GetSocketPath() const
+        { return mSocketPath; }
+    int GetLeaseSec() const
+        { return mLeaseSec; }
+    void GetCounters(
+        Counters& outCounters);
+    virtual void Run();
+private:
+    struct GrantEntry
+    {
+        GrantEntry(
+            int          inFd      = -1,
+            kfsChunkId_t inChunkId = -1,
+            time_t       inExpires = 0)
+            : mFd(inFd),
+              mChunkId(inChunkId),
+              mExpires(inExpires)
+            {}
+        int          mFd;
+        kfsChunkId_t mChunkId;
+        time_t       mExpires;
+    };
+    typedef map<int64_t, GrantEntry> Grants;
+
+    QCMutex     mMutex;
+    QCThread    mThread;
+    PrngIsaac64 mPrng;
+    Grants      mGrants;
+    string      mSocketPath;
+    int         mListenFd;
+    int         mGrantTimeoutSec;
+    int         mLeaseSec;
+    int         mMaxGrants;
+    bool        mStopFlag;
+    bool        mParametersSetFlag;
+    Counters    mCounters;
+
+    bool Start(
+        const string& inPath);
+    void Claim(
+        int inSocket);
+    void Expire(
+        time_t inNow);
+private:
+    ShortCircuitServer(
+        const ShortCircuitServer& inServer);
+    ShortCircuitServer& operator=(
+        const ShortCircuitServer& inServer);
+};
+
+extern ShortCircuitServer gShortCircuitServer;
+
+}
+
+#endif /* CHUNKSERVER_SHORTCIRCUITSERVER_H */
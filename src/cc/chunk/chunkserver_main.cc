@@ -39,6 +39,7 @@
 #include "kfsio/SslFilter.h"
 #include "kfsio/NetErrorSimulator.h"
 #include "qcdio/QCUtils.h"
+#include "qcdio/QCThread.h"
 
 #include <signal.h>
 #include <sys/stat.h>
@@ -324,6 +325,7 @@ public:
           mClientListenerIpV6OnlyFlag(false),
           mClientThreadCount(0),
           mFirstCpuIndex(-1),
+          mNumaNetInterface(),
           mChunkServerHostname(),
           mClusterKey(),
           mChunkServerRackId(-1),
@@ -341,6 +343,7 @@ private:
     bool           mClientListenerIpV6OnlyFlag;
     int            mClientThreadCount;
     int            mFirstCpuIndex;
+    string         mNumaNetInterface;
     string         mChunkServerHostname;
     string         mClusterKey;
     int            mChunkServerRackId;
@@ -348,6 +351,7 @@ private:
 
     void ComputeMD5(const char *pathname);
     bool LoadParams(const char *fileName);
+    void SetNumaAffinity();
 };
 
 void
@@ -444,6 +448,8 @@ ChunkServerMain::LoadParams(const char* fileName)
     KFS_LOG_STREAM_INFO << "chunk server client thread count: " <<
         mClientThreadCount <<  " first cpu: " << mFirstCpuIndex <<
     KFS_LOG_EOM;
+    mNumaNetInterface = mProp.getValue(
+        "chunkServer.numaNetInterface", mNumaNetInterface);
 
     mChunkServerHostname = mProp.getValue("chunkServer.hostname",
         mChunkServerHostname);
@@ -535,6 +541,41 @@ static void SigHupHandler(int /* sig */)
     gMetaServerSM.Reconnect();
 }
 
+// Pin the main thread to the cpus of the numa node the network interface is
+// attached to. The client threads and disk queue threads created by the main
+// thread inherit the affinity, unless their affinity is explicitly configured.
+void
+ChunkServerMain::SetNumaAffinity()
+{
+    if (mNumaNetInterface.empty()) {
+        return;
+    }
+    const int theNode = QCThread::GetNetInterfaceNumaNode(
+        mNumaNetInterface.c_str());
+    const QCThread::CpuAffinity theAffinity =
+        QCThread::GetNumaNodeCpuAffinity(theNode);
+    if (theAffinity == QCThread::CpuAffinity::None()) {
+        KFS_LOG_STREAM_ERROR <<
+            "network interface: " << mNumaNetInterface <<
+            " numa node: " << theNode <<
+            " unable to determine numa node cpus, no affinity set" <<
+        KFS_LOG_EOM;
+        return;
+    }
+    const int err = QCThread::SetCurrentThreadAffinity(theAffinity);
+    if (err) {
+        KFS_LOG_STREAM_ERROR <<
+            "failed to set numa node: " << theNode << " affinity: " <<
+            QCUtils::SysError(err) <<
+        KFS_LOG_EOM;
+        return;
+    }
+    KFS_LOG_STREAM_INFO <<
+        "network interface: " << mNumaNetInterface <<
+        " numa node: " << theNode << " affinity set" <<
+    KFS_LOG_EOM;
+}
+
 int
 ChunkServerMain::Run(int argc, char **argv)
 {
@@ -581,6 +622,7 @@ ChunkServerMain::Run(int argc, char **argv)
     if (! LoadParams(argv[1])) {
         return 1;
     }
+    SetNumaAffinity();
 
     KFS_LOG_STREAM_INFO << "Starting chunkserver..." << KFS_LOG_EOM;
     KFS_LOG_STREAM_INFO <<
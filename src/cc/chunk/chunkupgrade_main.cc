@@ -30,7 +30,14 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
 #include <boost/scoped_array.hpp>
 #include <iostream>
 #include <sstream>
@@ -38,22 +45,24 @@
 #include "kfsio/checksum.h"
 #include "kfsio/Globals.h"
 #include "common/MsgLogger.h"
+#include "common/time.h"
 #include "kfsio/FileHandle.h"
+#include "qcdio/QCThread.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
 #include "Chunk.h"
-#include "ChunkManager.h"
 
 using std::cout;
+using std::cerr;
 using std::endl;
 using std::string;
+using std::vector;
+using std::set;
+using std::map;
+using std::max;
 using std::ostringstream;
 using boost::scoped_array;
 
-string KFS::RestartChunkServer();
-string KFS::RestartChunkServer()
-{
-    return string("not supported");
-}
-
 using namespace KFS;
 
 // This structure is on-disk
@@ -78,28 +87,242 @@ struct DiskChunkInfoV1_t {
     // ...
     uint32_t chunkVersion;
     uint32_t numReads;
-    char filename[MAX_FILENAME_LEN];
+    char filename[CHUNK_META_MAX_FILENAME_LEN];
 };
 
-static void upgradeChunkFile(string chunkDir, string fn, bool verbose);
+static bool upgradeChunkFile(string chunkDir, string fn, bool verbose,
+    string& newfn);
 static string makeChunkFilename(const string &chunkDir, const DiskChunkInfo_t &chunkInfo);
 
+// Per chunk directory upgrade state. The checkpoint file in the chunk
+// directory has one record per line: "s <name>" written before the chunk
+// header is re-written, and "d <name> <new name>" after the chunk file is
+// renamed. On restart the completed files, under both old and new names, are
+// skipped without reading their headers. The files with start, but without
+// done record are reported and skipped, as their header might have already
+// been re-written.
+class UpgradeDir
+{
+public:
+    UpgradeDir(const string& name)
+        : dirName(name),
+          files(),
+          interruptedCount(0),
+          doneCount(0),
+          errorCount(0),
+          checkpoint(0)
+        {}
+    ~UpgradeDir()
+    {
+        if (checkpoint) {
+            fclose(checkpoint);
+        }
+    }
+    bool Scan(const string& ckptName, bool dryRunFlag)
+    {
+        const string ckptPath = dirName + "/" + ckptName;
+        set<string> done;
+        set<string> started;
+        FILE* const in = fopen(ckptPath.c_str(), "r");
+        if (in) {
+            char line[4 << 10];
+            while (fgets(line, sizeof(line), in)) {
+                char* const nl = strchr(line, '\n');
+                if (! nl) {
+                    continue; // Partial last record.
+                }
+                *nl = 0;
+                if (line[0] == 's' && line[1] == ' ') {
+                    started.insert(line + 2);
+                } else if (line[0] == 'd' && line[1] == ' ') {
+                    char* const sep = strchr(line + 2, ' ');
+                    if (sep) {
+                        *sep = 0;
+                        started.erase(line + 2);
+                        done.insert(line + 2);
+                        done.insert(sep + 1);
+                    }
+                }
+            }
+            fclose(in);
+        }
+        struct dirent** entries = 0;
+        const int count = scandir(dirName.c_str(), &entries, 0, alphasort);
+        if (count < 0) {
+            cerr << "Unable to open: " << dirName << endl;
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            const string name = entries[i]->d_name;
+            free(entries[i]);
+            const string fn = dirName + "/" + name;
+            struct stat statBuf;
+            if (name == ckptName || stat(fn.c_str(), &statBuf) != 0 ||
+                    ! S_ISREG(statBuf.st_mode) ||
+                    done.find(name) != done.end()) {
+                continue;
+            }
+            if (started.find(name) != started.end()) {
+                cerr << "Skipping interrupted upgrade: " << fn << endl;
+                interruptedCount++;
+                continue;
+            }
+            files.push_back(name);
+        }
+        free(entries);
+        doneCount = (int64_t)done.size() / 2;
+        if (dryRunFlag || files.empty()) {
+            return true;
+        }
+        checkpoint = fopen(ckptPath.c_str(), "a");
+        if (! checkpoint) {
+            cerr << "Unable to open checkpoint: " << ckptPath << endl;
+            return false;
+        }
+        return true;
+    }
+    void Record(const string& name, const string* newName)
+    {
+        if (newName) {
+            fprintf(checkpoint, "d %s %s\n", name.c_str(), newName->c_str());
+        } else {
+            fprintf(checkpoint, "s %s\n", name.c_str());
+        }
+        fflush(checkpoint);
+    }
+
+    const string   dirName;
+    vector<string> files;
+    int64_t        interruptedCount;
+    int64_t        doneCount;
+    int64_t        errorCount;
+private:
+    FILE*          checkpoint;
+};
+
+// All chunk directories on the same device are upgraded by the device's
+// workers. The workers pick the next file from the device queue.
+class UpgradeDrive : public QCRunnable
+{
+public:
+    UpgradeDrive(dev_t dev)
+        : deviceId(dev),
+          dirs(),
+          mutex(),
+          dirIdx(0),
+          fileIdx(0),
+          upgradedCount(0),
+          verbose(false)
+        {}
+    int64_t GetRemaining() const
+    {
+        int64_t ret = 0;
+        for (size_t i = 0; i < dirs.size(); i++) {
+            ret += (int64_t)dirs[i]->files.size();
+        }
+        return ret;
+    }
+    // Returns average header read time in microseconds of up to sampleCount
+    // files, or -1 if there are no files to upgrade.
+    int64_t SampleReadTime(int sampleCount) const
+    {
+        int64_t total = 0;
+        int     cnt   = 0;
+        for (size_t i = 0; i < dirs.size() && cnt < sampleCount; i++) {
+            const UpgradeDir& dir = *dirs[i];
+            const size_t step = max(size_t(1), dir.files.size() /
+                (size_t)max(1, sampleCount / (int)dirs.size()));
+            for (size_t k = 0; k < dir.files.size() && cnt < sampleCount;
+                    k += step) {
+                const string  fn    = dir.dirName + "/" + dir.files[k];
+                const int64_t start = microseconds();
+                const int     fd    = open(fn.c_str(), O_RDONLY);
+                if (fd < 0) {
+                    continue;
+                }
+                DiskChunkInfoV1_t chunkInfoV1;
+                const ssize_t res =
+                    pread(fd, &chunkInfoV1, sizeof(chunkInfoV1), 0);
+                close(fd);
+                if (res < 0) {
+                    continue;
+                }
+                total += microseconds() - start;
+                cnt++;
+            }
+        }
+        return (cnt <= 0 ? int64_t(-1) : total / cnt);
+    }
+    virtual void Run()
+    {
+        for (; ;) {
+            UpgradeDir* dir  = 0;
+            string      name;
+            {
+                QCStMutexLocker locker(mutex);
+                while (dirIdx < dirs.size() &&
+                        dirs[dirIdx]->files.size() <= fileIdx) {
+                    dirIdx++;
+                    fileIdx = 0;
+                }
+                if (dirs.size() <= dirIdx) {
+                    break;
+                }
+                dir  = dirs[dirIdx];
+                name = dir->files[fileIdx++];
+                dir->Record(name, 0);
+            }
+            string     newName;
+            const bool ok = upgradeChunkFile(
+                dir->dirName, name, verbose, newName);
+            QCStMutexLocker locker(mutex);
+            if (ok) {
+                dir->Record(name, &newName);
+                upgradedCount++;
+            } else {
+                dir->errorCount++;
+            }
+        }
+    }
+
+    const dev_t         deviceId;
+    vector<UpgradeDir*> dirs;
+    QCMutex             mutex;
+    size_t              dirIdx;
+    size_t              fileIdx;
+    int64_t             upgradedCount;
+    bool                verbose;
+};
+
 int main(int argc, char **argv)
 {
-    char optchar;
+    int optchar;
     bool help = false;
-    const char *chunkDir = NULL;
-    int res, count;
-    struct dirent **entries;
-    struct stat statBuf;
+    vector<string> chunkDirs;
+    int workersPerDrive = 1;
+    int sampleCount = 64;
+    bool dryRun = false;
+    string ckptName("chunkupgrade.ckpt");
     bool verbose = false;
 
     KFS::MsgLogger::Init(0, KFS::MsgLogger::kLogLevelINFO);
 
-    while ((optchar = getopt(argc, argv, "hvd:")) != -1) {
+    while ((optchar = getopt(argc, argv, "hvnd:w:c:s:")) != -1) {
         switch (optchar) {
             case 'd': 
-                chunkDir = optarg;
+                chunkDirs.push_back(optarg);
+                break;
+            case 'w':
+                workersPerDrive = atoi(optarg);
+                break;
+            case 'c':
+                ckptName = optarg;
+                break;
+            case 's':
+                sampleCount = atoi(optarg);
+                break;
+            case 'n':
+                dryRun = true;
                 break;
             case 'v':
                 verbose = true;
@@ -111,32 +334,126 @@ int main(int argc, char **argv)
         }
     }
 
-    if ((help) || (chunkDir == NULL)) {
-        cout << "Usage: " << argv[0] << " -d <chunkdir> {-v}" << endl;
-        exit(-1);
-    }
-    
-    res = scandir(chunkDir, &entries, 0, alphasort);
-    if (res < 0) {
-        cout << "Unable to open: " << chunkDir << endl;
+    if (help || chunkDirs.empty() || workersPerDrive <= 0 ||
+            sampleCount <= 0 || ckptName.empty() ||
+            ckptName.find('/') != string::npos) {
+        cout << "Usage: " << argv[0] <<
+            " -d <chunkdir> [-d <chunkdir>...]"
+            " [-w <workers per drive>]"
+            " [-c <checkpoint file name>]"
+            " [-n dry run]"
+            " [-s <dry run sample files per drive>]"
+            " {-v}\n"
+            "Upgrades chunk directories on different drives in parallel.\n"
+            "Progress is recorded in the checkpoint file in each chunk"
+            " directory,\n"
+            "interrupted run resumes from the checkpoint.\n"
+            "Dry run estimates the remaining upgrade time.\n"
+            "Defaults: -w 1 -c chunkupgrade.ckpt -s 64" << endl;
         exit(-1);
     }
 
-    count = res;
-    for (int i = 0; i < count; i++) {
-        string fn = chunkDir;
-        fn = fn + "/" + entries[i]->d_name;
-        res = stat(fn.c_str(), &statBuf);
-        if ((res < 0) || (!S_ISREG(statBuf.st_mode)))
+    typedef map<dev_t, UpgradeDrive*> Drives;
+    Drives              drives;
+    vector<UpgradeDir*> dirs;
+    int                 status = 0;
+    for (size_t i = 0; i < chunkDirs.size(); i++) {
+        struct stat statBuf;
+        if (stat(chunkDirs[i].c_str(), &statBuf) != 0 ||
+                ! S_ISDIR(statBuf.st_mode)) {
+            cerr << "Unable to open: " << chunkDirs[i] << endl;
+            status = -1;
+            continue;
+        }
+        UpgradeDir* const dir = new UpgradeDir(chunkDirs[i]);
+        dirs.push_back(dir);
+        if (! dir->Scan(ckptName, dryRun)) {
+            status = -1;
             continue;
-        upgradeChunkFile(chunkDir, entries[i]->d_name, verbose);
-        free(entries[i]);
+        }
+        UpgradeDrive*& drive = drives[statBuf.st_dev];
+        if (! drive) {
+            drive = new UpgradeDrive(statBuf.st_dev);
+            drive->verbose = verbose;
+        }
+        drive->dirs.push_back(dir);
+    }
+
+    if (dryRun) {
+        double maxSec = 0;
+        for (Drives::const_iterator it = drives.begin();
+                it != drives.end(); ++it) {
+            const UpgradeDrive& drive     = *it->second;
+            const int64_t       remaining = drive.GetRemaining();
+            const int64_t       readTime  = drive.SampleReadTime(sampleCount);
+            // Each upgrade reads and writes the chunk header, and renames the
+            // chunk file; assume that write and rename cost the same as read.
+            const double        sec       = readTime < 0 ? 0. :
+                3e-6 * readTime * remaining / workersPerDrive;
+            maxSec = max(maxSec, sec);
+            int64_t done        = 0;
+            int64_t interrupted = 0;
+            for (size_t i = 0; i < drive.dirs.size(); i++) {
+                done        += drive.dirs[i]->doneCount;
+                interrupted += drive.dirs[i]->interruptedCount;
+            }
+            cout << "device: "       << drive.deviceId <<
+                " dirs: "            << drive.dirs.size() <<
+                " done: "            << done <<
+                " interrupted: "     << interrupted <<
+                " remaining: "       << remaining <<
+                " avg-read-usec: "   << readTime <<
+                " estimate-sec: "    << (int64_t)sec <<
+            endl;
+        }
+        cout << "devices: "       << drives.size() <<
+            " workers-per-drive: " << workersPerDrive <<
+            " estimate-sec: "      << (int64_t)maxSec <<
+        endl;
+    } else {
+        vector<QCThread*> threads;
+        for (Drives::const_iterator it = drives.begin();
+                it != drives.end(); ++it) {
+            for (int i = 0; i < workersPerDrive; i++) {
+                QCThread* const thread = new QCThread(it->second);
+                thread->Start(it->second, -1, "chunkupgrade");
+                threads.push_back(thread);
+            }
+        }
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i]->Join();
+            delete threads[i];
+        }
+        for (Drives::const_iterator it = drives.begin();
+                it != drives.end(); ++it) {
+            const UpgradeDrive& drive = *it->second;
+            for (size_t i = 0; i < drive.dirs.size(); i++) {
+                const UpgradeDir& dir = *drive.dirs[i];
+                cout << "dir: "       << dir.dirName <<
+                    " upgraded: "     << (int64_t)dir.files.size() -
+                        dir.errorCount <<
+                    " errors: "       << dir.errorCount <<
+                    " interrupted: "  << dir.interruptedCount <<
+                    " previously-done: " << dir.doneCount <<
+                endl;
+                if (0 < dir.errorCount || 0 < dir.interruptedCount) {
+                    status = -1;
+                }
+            }
+        }
+    }
+    for (Drives::const_iterator it = drives.begin();
+            it != drives.end(); ++it) {
+        delete it->second;
     }
-    free(entries);
-    exit(0);
+    for (size_t i = 0; i < dirs.size(); i++) {
+        delete dirs[i];
+    }
+    exit(status);
 }
 
-static void upgradeChunkFile(string chunkDir, string chunkfn, bool verbose)
+static bool upgradeChunkFile(string chunkDir, string chunkfn, bool verbose,
+    string& newName)
 {
     DiskChunkInfoV1_t chunkInfoV1;
     int fd, res;
@@ -148,37 +465,45 @@ static void upgradeChunkFile(string chunkDir, string chunkfn, bool verbose)
 
     fd = open(fn.c_str(), O_RDWR);
     if (fd < 0) {
-        cout << "Unable to open: " << fn << endl;
-        return;
+        cerr << "Unable to open: " << fn << endl;
+        return false;
     }
     f.reset(new FileHandle_t(fd));
     res = pread(fd, &chunkInfoV1, sizeof(DiskChunkInfoV1_t), 0);
     if (res < 0) {
-        cout << "Unable to read chunkinfo for: " << fn << endl;
-        return;
+        cerr << "Unable to read chunkinfo for: " << fn << endl;
+        return false;
     }
 
-    DiskChunkInfo_t chunkInfo(chunkInfoV1.fileId, chunkInfoV1.chunkId, 
-                              chunkInfoV1.chunkSize, chunkInfoV1.chunkVersion);
+    DiskChunkInfo_t chunkInfo(chunkInfoV1.fileId, chunkInfoV1.chunkId,
+        chunkInfoV1.chunkSize, chunkInfoV1.chunkVersion,
+        DiskChunkInfo_t::kFlagsNone);
     chunkInfo.SetChecksums(chunkInfoV1.chunkBlockChecksum);
     res = pwrite(fd, &chunkInfo, sizeof(DiskChunkInfo_t), 0);
     if (res < 0) {
-        cout << "Unable to write chunkinfo for: " << fn << endl;
-        return;
+        cerr << "Unable to write chunkinfo for: " << fn << endl;
+        return false;
     }
     
     if (verbose) {
-        cout << "fid: "<< chunkInfo.fileId << endl;
-        cout << "chunkId: "<< chunkInfo.chunkId << endl;
-        cout << "size: "<< chunkInfo.chunkSize << endl;
-        cout << "version: "<< chunkInfo.chunkVersion << endl;
+        // Single write, as the workers run concurrently.
+        ostringstream os;
+        os << "fid: "<< chunkInfo.fileId << "\n";
+        os << "chunkId: "<< chunkInfo.chunkId << "\n";
+        os << "size: "<< chunkInfo.chunkSize << "\n";
+        os << "version: "<< chunkInfo.chunkVersion << "\n";
+        cout << os.str() << std::flush;
     }
     // upgrade the meta-data
     
     newfn = makeChunkFilename(chunkDir, chunkInfo);
     res = rename(fn.c_str(), newfn.c_str());
-    if (res < 0)
+    if (res < 0) {
         perror("rename");
+        return false;
+    }
+    newName = newfn.substr(chunkDir.size() + 1);
+    return true;
 }
 
 string makeChunkFilename(const string &chunkDir, const DiskChunkInfo_t &chunkInfo)
@@ -45,6 +45,7 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <vector>
 #include <string>
@@ -799,6 +800,11 @@ public:
         LogLevel inLogLevel,
         bool     inDiscardFlag)
     {
+        MsgStream* const theThreadStreamPtr = GetThreadStream();
+        if (theThreadStreamPtr) {
+            theThreadStreamPtr->Clear(inLogLevel, inDiscardFlag);
+            return *theThreadStreamPtr;
+        }
         QCStMutexLocker theLocker(mMutex);
 
         MsgStream* theRetPtr = mMsgStreamHeadPtr;
@@ -816,13 +822,16 @@ public:
     void PutStream(
         ostream& inStream)
     {
-        QCStMutexLocker theLocker(mMutex);
-
         MsgStream& theStream = static_cast<MsgStream&>(inStream);
         if (! theStream.IsDiscard()) {
+            QCStMutexLocker theLocker(mMutex);
             AppendSelf(theStream.GetLogLevel(),
                 theStream.GetMsgPtr(), theStream.GetMsgLength());
         }
+        if (PutThreadStream(theStream)) {
+            return;
+        }
+        QCStMutexLocker theLocker(mMutex);
         if (mMsgStreamCount < mMaxMsgStreamCount) {
             theStream.tie(0);
             theStream.Next() = mMsgStreamHeadPtr;
@@ -975,6 +984,46 @@ private:
     MsgStream*   mMsgStreamHeadPtr;
     char         mLogTimeStampPrefixStr[256];
 
+    // Per thread message stream, in order to avoid acquiring the mutex twice
+    // per log message: first to get the stream, then to append the message.
+    // The stream message formatting is done by the calling thread without
+    // holding the mutex, the mutex is held only to copy the formatted
+    // message into the log buffer.
+    static pthread_once_t sThreadStreamKeyOnce;
+    static pthread_key_t  sThreadStreamKey;
+    static bool           sThreadStreamKeyValidFlag;
+    static void DeleteThreadStream(
+        void* inStreamPtr)
+        { delete reinterpret_cast<MsgStream*>(inStreamPtr); }
+    static void CreateThreadStreamKey()
+    {
+        sThreadStreamKeyValidFlag =
+            pthread_key_create(&sThreadStreamKey, &DeleteThreadStream) == 0;
+    }
+    static MsgStream* GetThreadStream()
+    {
+        pthread_once(&sThreadStreamKeyOnce, &CreateThreadStreamKey);
+        if (! sThreadStreamKeyValidFlag) {
+            return 0;
+        }
+        MsgStream* const theRetPtr = reinterpret_cast<MsgStream*>(
+            pthread_getspecific(sThreadStreamKey));
+        if (theRetPtr) {
+            pthread_setspecific(sThreadStreamKey, 0);
+        }
+        return theRetPtr;
+    }
+    static bool PutThreadStream(
+        MsgStream& inStream)
+    {
+        if (! sThreadStreamKeyValidFlag ||
+                pthread_getspecific(sThreadStreamKey)) {
+            return false;
+        }
+        inStream.tie(0);
+        inStream.Next() = 0;
+        return (pthread_setspecific(sThreadStreamKey, &inStream) == 0);
+    }
     static inline Time Seconds(
         Time inSec)
         { return (inSec * 1000000); }
@@ -1305,6 +1354,11 @@ private:
         const Impl& inImpl);
 };
 
+pthread_once_t BufferedLogWriter::Impl::sThreadStreamKeyOnce      =
+    PTHREAD_ONCE_INIT;
+pthread_key_t  BufferedLogWriter::Impl::sThreadStreamKey;
+bool           BufferedLogWriter::Impl::sThreadStreamKeyValidFlag = false;
+
 BufferedLogWriter::BufferedLogWriter(
     int                         inFd,
     const char*                 inFileNamePtr               /* = 0 */,
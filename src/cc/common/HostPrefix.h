@@ -32,6 +32,9 @@
 
 #include <string.h>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <utility>
 #include <istream>
 #include <ostream>
 #include <sstream>
@@ -43,6 +46,8 @@ using std::vector;
 using std::istream;
 using std::ostringstream;
 using std::make_pair;
+using std::min;
+using std::pair;
 
 class HostPrefix
 {
@@ -21,12 +21,19 @@
 // permissions and limitations under the License.
 //
 // Compile and link against this to replace global operator new and delete,
-// and trace / debug memory allocation.
+// and trace / debug memory allocation. Also implements the sampling heap
+// profiler declared in KfsTraceNew.h.
 //
 //----------------------------------------------------------------------------
 
+#define KFS_TRACE_NEW_IMPL
+#include "KfsTraceNew.h"
+
 #include <new>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
@@ -44,6 +51,411 @@
 struct mallinfo {};
 #endif
 
+// Sampling heap profiler. All profiler memory is allocated with malloc, in
+// order to avoid recursion. The live samples are kept in the open addressing
+// pointer hash table. The free fast path checks the lock free counting filter
+// indexed by the pointer hash, and takes the mutex only if the filter
+// indicates that the pointer might be sampled.
+class KfsHeapProfiler
+{
+public:
+    KfsHeapProfiler()
+        : mSampleInterval(0),
+          mStacksPtr(0),
+          mSamplesPtr(0),
+          mFilterPtr(0),
+          mStackCount(0),
+          mSampleCount(0),
+          mDroppedCount(0)
+        { pthread_mutex_init(&mMutex, 0); }
+    void SetSampleInterval(
+        size_t inInterval)
+    {
+        if (0 < inInterval) {
+            pthread_mutex_lock(&mMutex);
+            const bool theOkFlag = Allocate();
+            pthread_mutex_unlock(&mMutex);
+            if (! theOkFlag) {
+                return;
+            }
+#ifdef KFS_OS_NAME_LINUX
+            // Force backtrace initialization, that might allocate memory,
+            // before sampling starts.
+            void* theTrace[kMaxStackDepth];
+            backtrace(theTrace, kMaxStackDepth);
+#endif
+        }
+        mSampleInterval = inInterval;
+    }
+    size_t GetSampleInterval() const
+        { return mSampleInterval; }
+    void Allocated(
+        void*  inPtr,
+        size_t inSize)
+    {
+        if (mSampleInterval <= 0 || ! inPtr ||
+                0 < (sBytesUntilSample -= (int64_t)inSize)) {
+            return;
+        }
+        Sample(inPtr, inSize);
+    }
+    void Freed(
+        void* inPtr)
+    {
+        if (! mFilterPtr || ! inPtr ||
+                mFilterPtr[Hash(inPtr) & (kFilterSize - 1)] == 0) {
+            return;
+        }
+        Remove(inPtr);
+    }
+    void Reset()
+    {
+        pthread_mutex_lock(&mMutex);
+        if (mStacksPtr) {
+            memset(mStacksPtr, 0, sizeof(mStacksPtr[0]) * kMaxStacks);
+            memset(mSamplesPtr, 0, sizeof(mSamplesPtr[0]) * kMaxSamples);
+            memset((void*)mFilterPtr, 0, sizeof(mFilterPtr[0]) * kFilterSize);
+        }
+        mStackCount   = 0;
+        mSampleCount  = 0;
+        mDroppedCount = 0;
+        pthread_mutex_unlock(&mMutex);
+    }
+    char* Get(
+        size_t* outLenPtr);
+private:
+    enum
+    {
+        kMaxStackDepth = 24,
+        kSkipFrames    = 3,
+        kMaxStacks     = 1 << 14,
+        kMaxSamples    = 1 << 18,
+        kFilterSize    = 1 << 16
+    };
+    struct Stack
+    {
+        size_t  mHash;
+        int     mDepth;
+        int64_t mLiveCount;
+        int64_t mLiveBytes;
+        int64_t mAllocCount;
+        int64_t mAllocBytes;
+        void*   mTrace[kMaxStackDepth];
+    };
+    struct SampleEntry
+    {
+        void*   mPtr;
+        int64_t mBytes;
+        int     mStackIdx;
+    };
+    class Buffer
+    {
+    public:
+        Buffer()
+            : mPtr(0),
+              mLen(0),
+              mCapacity(0)
+            {}
+        void Append(
+            const char* inFmtPtr,
+            ...)
+        {
+            for (; ;) {
+                va_list theArgs;
+                va_start(theArgs, inFmtPtr);
+                const int theLen = mPtr ? vsnprintf(mPtr + mLen,
+                    mCapacity - mLen, inFmtPtr, theArgs) : 0;
+                va_end(theArgs);
+                if (mPtr && 0 <= theLen && mLen + theLen < mCapacity) {
+                    mLen += theLen;
+                    return;
+                }
+                if (theLen < 0) {
+                    return;
+                }
+                const size_t theCapacity = mCapacity * 2 + theLen + (64 << 10);
+                char* const thePtr = (char*)realloc(mPtr, theCapacity);
+                if (! thePtr) {
+                    return;
+                }
+                mPtr      = thePtr;
+                mCapacity = theCapacity;
+            }
+        }
+        char*  mPtr;
+        size_t mLen;
+        size_t mCapacity;
+    };
+
+    volatile size_t    mSampleInterval;
+    Stack*             mStacksPtr;
+    SampleEntry*       mSamplesPtr;
+    uint16_t* volatile mFilterPtr;
+    int                mStackCount;
+    int                mSampleCount;
+    int64_t            mDroppedCount;
+    pthread_mutex_t    mMutex;
+
+    static __thread int64_t  sBytesUntilSample;
+    static __thread bool     sInProfilerFlag;
+    static __thread uint64_t sRandom;
+
+    static size_t Hash(
+        const void* inPtr)
+    {
+        uint64_t theVal = (uint64_t)(size_t)inPtr;
+        theVal ^= theVal >> 33;
+        theVal *= 0xff51afd7ed558ccdULL;
+        theVal ^= theVal >> 33;
+        return (size_t)theVal;
+    }
+    bool Allocate()
+    {
+        if (mStacksPtr) {
+            return true;
+        }
+        Stack* const       theStacksPtr  =
+            (Stack*)calloc(kMaxStacks, sizeof(Stack));
+        SampleEntry* const theSamplesPtr =
+            (SampleEntry*)calloc(kMaxSamples, sizeof(SampleEntry));
+        uint16_t* const    theFilterPtr  =
+            (uint16_t*)calloc(kFilterSize, sizeof(uint16_t));
+        if (! theStacksPtr || ! theSamplesPtr || ! theFilterPtr) {
+            free(theStacksPtr);
+            free(theSamplesPtr);
+            free(theFilterPtr);
+            return false;
+        }
+        mStacksPtr  = theStacksPtr;
+        mSamplesPtr = theSamplesPtr;
+        mFilterPtr  = theFilterPtr;
+        return true;
+    }
+    void NextSample()
+    {
+        // Randomize the interval, in order to avoid aliasing with periodic
+        // allocation patterns, the mean interval is the sample interval.
+        if (sRandom == 0) {
+            sRandom = Hash(&sRandom) | 1;
+        }
+        sRandom ^= sRandom << 13;
+        sRandom ^= sRandom >> 7;
+        sRandom ^= sRandom << 17;
+        const size_t theInterval = mSampleInterval;
+        sBytesUntilSample = (int64_t)(theInterval / 2 +
+            (0 < theInterval ? sRandom % theInterval : 0));
+    }
+    void Sample(
+        void*  inPtr,
+        size_t inSize)
+    {
+        if (sInProfilerFlag) {
+            return;
+        }
+        sInProfilerFlag = true;
+        NextSample();
+        void* theTrace[kMaxStackDepth + kSkipFrames];
+        int   theDepth = 0;
+#ifdef KFS_OS_NAME_LINUX
+        theDepth = backtrace(theTrace, kMaxStackDepth + kSkipFrames);
+#endif
+        const int theSkip = theDepth < kSkipFrames ? theDepth : kSkipFrames;
+        theDepth -= theSkip;
+        size_t theHash = (size_t)theDepth;
+        for (int i = 0; i < theDepth; i++) {
+            theHash = theHash * 31 + Hash(theTrace[theSkip + i]);
+        }
+        const size_t  theInterval = mSampleInterval;
+        const int64_t theBytes    =
+            (int64_t)(inSize < theInterval ? theInterval : inSize);
+        pthread_mutex_lock(&mMutex);
+        if (mStacksPtr) {
+            Insert(inPtr, theBytes, theHash, theTrace + theSkip, theDepth);
+        }
+        pthread_mutex_unlock(&mMutex);
+        sInProfilerFlag = false;
+    }
+    void Insert(
+        void*        inPtr,
+        int64_t      inBytes,
+        size_t       inHash,
+        void* const* inTracePtr,
+        int          inDepth)
+    {
+        if (kMaxStacks * 3 / 4 <= mStackCount ||
+                kMaxSamples * 3 / 4 <= mSampleCount) {
+            mDroppedCount++;
+            return;
+        }
+        size_t theIdx = inHash & (kMaxStacks - 1);
+        for (; ; theIdx = (theIdx + 1) & (kMaxStacks - 1)) {
+            Stack& theStack = mStacksPtr[theIdx];
+            if (theStack.mDepth <= 0) {
+                theStack.mHash  = inHash;
+                theStack.mDepth = inDepth <= 0 ? 1 : inDepth;
+                memcpy(theStack.mTrace, inTracePtr,
+                    sizeof(theStack.mTrace[0]) * inDepth);
+                mStackCount++;
+                break;
+            }
+            if (theStack.mHash == inHash && theStack.mDepth == inDepth &&
+                    memcmp(theStack.mTrace, inTracePtr,
+                        sizeof(theStack.mTrace[0]) * inDepth) == 0) {
+                break;
+            }
+        }
+        Stack& theStack = mStacksPtr[theIdx];
+        theStack.mLiveCount++;
+        theStack.mLiveBytes += inBytes;
+        theStack.mAllocCount++;
+        theStack.mAllocBytes += inBytes;
+        const size_t thePtrHash = Hash(inPtr);
+        size_t       theSIdx    = thePtrHash & (kMaxSamples - 1);
+        while (mSamplesPtr[theSIdx].mPtr) {
+            theSIdx = (theSIdx + 1) & (kMaxSamples - 1);
+        }
+        SampleEntry& theSample = mSamplesPtr[theSIdx];
+        theSample.mPtr      = inPtr;
+        theSample.mBytes    = inBytes;
+        theSample.mStackIdx = (int)theIdx;
+        mSampleCount++;
+        mFilterPtr[thePtrHash & (kFilterSize - 1)]++;
+    }
+    void Remove(
+        void* inPtr)
+    {
+        const size_t thePtrHash = Hash(inPtr);
+        pthread_mutex_lock(&mMutex);
+        size_t theIdx = thePtrHash & (kMaxSamples - 1);
+        while (mSamplesPtr[theIdx].mPtr && mSamplesPtr[theIdx].mPtr != inPtr) {
+            theIdx = (theIdx + 1) & (kMaxSamples - 1);
+        }
+        if (mSamplesPtr[theIdx].mPtr) {
+            Stack& theStack = mStacksPtr[mSamplesPtr[theIdx].mStackIdx];
+            theStack.mLiveCount--;
+            theStack.mLiveBytes -= mSamplesPtr[theIdx].mBytes;
+            mFilterPtr[thePtrHash & (kFilterSize - 1)]--;
+            mSampleCount--;
+            // Linear probing backward shift deletion.
+            size_t theHole = theIdx;
+            size_t theNext = theIdx;
+            for (; ;) {
+                theNext = (theNext + 1) & (kMaxSamples - 1);
+                SampleEntry& theEntry = mSamplesPtr[theNext];
+                if (! theEntry.mPtr) {
+                    break;
+                }
+                const size_t theHome = Hash(theEntry.mPtr) & (kMaxSamples - 1);
+                if (((theNext - theHome) & (kMaxSamples - 1)) >=
+                        ((theNext - theHole) & (kMaxSamples - 1))) {
+                    mSamplesPtr[theHole] = theEntry;
+                    theHole = theNext;
+                }
+            }
+            mSamplesPtr[theHole].mPtr = 0;
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+    static int CompareLiveBytes(
+        const void* inLhsPtr,
+        const void* inRhsPtr)
+    {
+        const Stack& theLhs = **(const Stack* const*)inLhsPtr;
+        const Stack& theRhs = **(const Stack* const*)inRhsPtr;
+        return (theLhs.mLiveBytes > theRhs.mLiveBytes ? -1 :
+            (theLhs.mLiveBytes < theRhs.mLiveBytes ? 1 :
+            (theLhs.mAllocBytes > theRhs.mAllocBytes ? -1 :
+            (theLhs.mAllocBytes < theRhs.mAllocBytes ? 1 : 0))));
+    }
+};
+
+__thread int64_t  KfsHeapProfiler::sBytesUntilSample = 0;
+__thread bool     KfsHeapProfiler::sInProfilerFlag   = false;
+__thread uint64_t KfsHeapProfiler::sRandom           = 0;
+
+char*
+KfsHeapProfiler::Get(
+    size_t* outLenPtr)
+{
+    // Copy the stacks, then format the copy with the mutex released, as
+    // backtrace_symbols() uses malloc.
+    const bool theInProfilerFlag = sInProfilerFlag;
+    sInProfilerFlag = true;
+    pthread_mutex_lock(&mMutex);
+    const int     theCount       = mStacksPtr ? mStackCount : 0;
+    const int     theSampleCount = mSampleCount;
+    const int64_t theDropped     = mDroppedCount;
+    Stack* const  theStacksPtr   = 0 < theCount ?
+        (Stack*)malloc(sizeof(Stack) * theCount) : 0;
+    int theNStacks = 0;
+    if (theStacksPtr) {
+        for (int i = 0; i < kMaxStacks && theNStacks < theCount; i++) {
+            if (0 < mStacksPtr[i].mDepth) {
+                theStacksPtr[theNStacks++] = mStacksPtr[i];
+            }
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+    Stack** const theSortedPtr = 0 < theNStacks ?
+        (Stack**)malloc(sizeof(Stack*) * theNStacks) : 0;
+    if (! theSortedPtr) {
+        theNStacks = 0;
+    }
+    int64_t theLiveBytes  = 0;
+    int64_t theAllocBytes = 0;
+    for (int i = 0; i < theNStacks; i++) {
+        theSortedPtr[i] = theStacksPtr + i;
+        theLiveBytes  += theStacksPtr[i].mLiveBytes;
+        theAllocBytes += theStacksPtr[i].mAllocBytes;
+    }
+    if (0 < theNStacks) {
+        qsort(theSortedPtr, theNStacks, sizeof(theSortedPtr[0]),
+            &KfsHeapProfiler::CompareLiveBytes);
+    }
+    Buffer theBuf;
+    theBuf.Append(
+        "Heap-profile-sample-interval: %lu\n"
+        "Heap-profile-live-bytes: %lld\n"
+        "Heap-profile-alloc-bytes: %lld\n"
+        "Heap-profile-live-samples: %d\n"
+        "Heap-profile-call-sites: %d\n"
+        "Heap-profile-dropped-samples: %lld\n",
+        (unsigned long)mSampleInterval,
+        (long long)theLiveBytes,
+        (long long)theAllocBytes,
+        theSampleCount,
+        theNStacks,
+        (long long)theDropped
+    );
+    for (int i = 0; i < theNStacks; i++) {
+        const Stack& theStack = *theSortedPtr[i];
+        theBuf.Append(
+            "\nlive-bytes: %lld live-samples: %lld"
+            " alloc-bytes: %lld alloc-samples: %lld\n",
+            (long long)theStack.mLiveBytes,
+            (long long)theStack.mLiveCount,
+            (long long)theStack.mAllocBytes,
+            (long long)theStack.mAllocCount
+        );
+        char** theSymsPtr = 0;
+#ifdef KFS_OS_NAME_LINUX
+        theSymsPtr = backtrace_symbols(theStack.mTrace, theStack.mDepth);
+#endif
+        for (int k = 0; k < theStack.mDepth; k++) {
+            theBuf.Append("  %p %s\n", theStack.mTrace[k],
+                theSymsPtr ? theSymsPtr[k] : "");
+        }
+        free(theSymsPtr);
+    }
+    free(theSortedPtr);
+    free(theStacksPtr);
+    sInProfilerFlag = theInProfilerFlag;
+    if (outLenPtr) {
+        *outLenPtr = theBuf.mLen;
+    }
+    return theBuf.mPtr;
+}
+
 struct KfsTraceNew
 {
     KfsTraceNew()
@@ -59,10 +471,11 @@ struct KfsTraceNew
           mRlimAs(),
           mRlimData(),
           mRlimCore(),
-          mMallinfo()
+          mMallinfo(),
+          mHeapProfiler()
     {
-        // Format: fd,maxsize,abort
-        // Example: KFS_TRACE_NEW_PARAMS=2,1e3,1
+        // Format: fd,maxsize,abort,heap_profile_sample_interval
+        // Example: KFS_TRACE_NEW_PARAMS=2,1e3,1,512e3
         sKfsTraceNewInstancePtr = this;
         mMapsBuf[0] = 0;
         if (! mParametersPtr || ! *mParametersPtr) {
@@ -80,7 +493,16 @@ struct KfsTraceNew
             theEndPtr = 0;
             mContinueOnMallocFailureFlag = strtol(thePtr, &theEndPtr, 0) == 0;
         }
+        size_t theSampleInterval = 0;
+        if ((*theEndPtr & 0xFF) == ',') {
+            const char* thePtr = theEndPtr + 1;
+            theEndPtr = 0;
+            theSampleInterval = (size_t)strtod(thePtr, &theEndPtr);
+        }
         mParamsSetFlag = true;
+        if (0 < theSampleInterval) {
+            mHeapProfiler.SetSampleInterval(theSampleInterval);
+        }
     }
     void Trace(
         const char* inMsgPtr,
@@ -114,6 +536,8 @@ struct KfsTraceNew
             if (inRaiseExceptionOnFailureFlag) {
                 throw std::bad_alloc();
             }
+        } else {
+            mHeapProfiler.Allocated(thePtr, inSize);
         }
         return thePtr;
     }
@@ -122,6 +546,7 @@ struct KfsTraceNew
         void*       inPtr)
     {
         Trace(inMsgPtr, -1, inPtr);
+        mHeapProfiler.Freed(inPtr);
         free(inPtr);
     }
     static KfsTraceNew& Instance()
@@ -147,6 +572,7 @@ struct KfsTraceNew
     struct mallinfo   mMallinfo;
     char              mMapsBuf[16 << 10];
     void*             mStackTrace[kMaxStackTraceDepth];
+    KfsHeapProfiler   mHeapProfiler;
 
     static KfsTraceNew* sKfsTraceNewInstancePtr;
 };
@@ -157,13 +583,13 @@ void
 KfsTraceNew::MallocFailed(
     size_t inSize)
 {
+    mFailedSize = inSize;
     getrlimit(RLIMIT_AS,   &mRlimAs);
     getrlimit(RLIMIT_DATA, &mRlimData);
     getrlimit(RLIMIT_CORE, &mRlimCore);
 #ifdef KFS_OS_NAME_LINUX
     struct mallinfo info = mallinfo();
-    mFailedSize = inSize;
-    mMallinfo   = info;
+    mMallinfo = info;
     const int theFd = open("/proc/self/maps", O_RDONLY);
     int theMapsSize = 0;
     if (theFd >= 0) {
@@ -199,26 +625,60 @@ KfsTraceNew::MallocFailed(
     abort();
 }
 
+// Dynamic exception specifications are not allowed since C++17, and
+// deprecated since C++11.
+#if __cplusplus < 201103L
+#   define KFS_TRACE_NEW_THROW_BAD_ALLOC throw (std::bad_alloc)
+#   define KFS_TRACE_NEW_NO_THROW        throw ()
+#else
+#   define KFS_TRACE_NEW_THROW_BAD_ALLOC
+#   define KFS_TRACE_NEW_NO_THROW        noexcept
+#endif
+
 void*
-operator new(std::size_t inSize) throw (std::bad_alloc)
+operator new(std::size_t inSize) KFS_TRACE_NEW_THROW_BAD_ALLOC
 {
     return KfsTraceNew::Instance().Allocate(inSize, true);
 }
 
 void
-operator delete(void* inPtr) throw()
+operator delete(void* inPtr) KFS_TRACE_NEW_NO_THROW
 {
     KfsTraceNew::Instance().Free("delete", inPtr);
 }
 
 void*
-operator new(std::size_t inSize, const std::nothrow_t&) throw()
+operator new(std::size_t inSize, const std::nothrow_t&) KFS_TRACE_NEW_NO_THROW
 {
     return KfsTraceNew::Instance().Allocate(inSize, false);
 }
 
 void
-operator delete(void* inPtr, const std::nothrow_t&) throw()
+operator delete(void* inPtr, const std::nothrow_t&) KFS_TRACE_NEW_NO_THROW
 {
     KfsTraceNew::Instance().Free("delete_nt", inPtr);
 }
+
+void
+KfsTraceNewHeapProfileSetSampleInterval(size_t inInterval)
+{
+    KfsTraceNew::Instance().mHeapProfiler.SetSampleInterval(inInterval);
+}
+
+size_t
+KfsTraceNewHeapProfileGetSampleInterval()
+{
+    return KfsTraceNew::Instance().mHeapProfiler.GetSampleInterval();
+}
+
+char*
+KfsTraceNewHeapProfileGet(size_t* outLenPtr)
+{
+    return KfsTraceNew::Instance().mHeapProfiler.Get(outLenPtr);
+}
+
+void
+KfsTraceNewHeapProfileReset()
+{
+    KfsTraceNew::Instance().mHeapProfiler.Reset();
+}
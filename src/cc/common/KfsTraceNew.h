@@ -0,0 +1,72 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Sampling heap profiler interface, implemented by KfsTraceNew.cc.
+//
+// The profiler is available only if KfsTraceNew.cc is linked into the
+// executable (cmake -DENABLE_TRACE_NEW=ON), otherwise the weak symbols below
+// are null, and the callers must check KfsTraceNewHeapProfileIsAvailable()
+// before using the profiler.
+//
+// When enabled, the profiler samples on average one allocation per sample
+// interval bytes allocated, captures the allocation call stack, and keeps
+// the estimated live and cumulative allocated bytes per call stack. The
+// sample interval can also be set with the fourth value of the
+// KFS_TRACE_NEW_PARAMS environment variable: fd,maxsize,abort,interval
+//
+//----------------------------------------------------------------------------
+
+#ifndef KFS_TRACE_NEW_H
+#define KFS_TRACE_NEW_H
+
+#include <stddef.h>
+
+#ifdef KFS_TRACE_NEW_IMPL
+#   define KFS_TRACE_NEW_WEAK
+#else
+#   define KFS_TRACE_NEW_WEAK __attribute__((weak))
+#endif
+
+extern "C"
+{
+// Set sample interval in bytes. 0 stops sampling, the already sampled live
+// allocations remain in the profile until freed or reset.
+void KfsTraceNewHeapProfileSetSampleInterval(size_t inInterval)
+    KFS_TRACE_NEW_WEAK;
+size_t KfsTraceNewHeapProfileGetSampleInterval() KFS_TRACE_NEW_WEAK;
+// Returns text profile, with call sites sorted by the estimated live bytes in
+// descending order. The returned buffer must be released with free().
+char* KfsTraceNewHeapProfileGet(size_t* outLenPtr) KFS_TRACE_NEW_WEAK;
+// Discard all samples.
+void KfsTraceNewHeapProfileReset() KFS_TRACE_NEW_WEAK;
+}
+
+#ifndef KFS_TRACE_NEW_IMPL
+inline static bool
+KfsTraceNewHeapProfileIsAvailable()
+{
+    return (&KfsTraceNewHeapProfileGet != 0);
+}
+#endif
+
+#undef KFS_TRACE_NEW_WEAK
+
+#endif /* KFS_TRACE_NEW_H */
@@ -0,0 +1,159 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Fixed size latency histogram with log linear buckets, similar to HDR
+// histogram: each power of two range is split into 8 equal sub-buckets,
+// therefore the percentile values are within 12.5% of the recorded values.
+// The histogram is not thread safe, and no locking is required as long as
+// each thread updates its own histogram, and the histograms are merged in
+// order to get the combined distribution.
+//
+//----------------------------------------------------------------------------
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+
+namespace KFS
+{
+
+class LatencyHistogram
+{
+public:
+    typedef int64_t Counter;
+    enum
+    {
+        kSubBucketBits  = 3,
+        kSubBucketCount = 1 << kSubBucketBits,
+        kMaxValueBits   = 31,
+        kBucketCount    =
+            kSubBucketCount + (kMaxValueBits - kSubBucketBits) * kSubBucketCount
+    };
+
+    LatencyHistogram()
+        { LatencyHistogram::Clear(); }
+    void Clear()
+    {
+        mCount    = 0;
+        mTotal    = 0;
+        mMaxValue = 0;
+        for (int i = 0; i < kBucketCount; i++) {
+            mBuckets[i] = 0;
+        }
+    }
+    void Add(
+        int64_t inValue)
+    {
+        const int64_t theValue = inValue < 0 ? int64_t(0) : inValue;
+        mBuckets[GetBucket(theValue)]++;
+        mCount++;
+        mTotal += theValue;
+        if (mMaxValue < theValue) {
+            mMaxValue = theValue;
+        }
+    }
+    LatencyHistogram& Add(
+        const LatencyHistogram& inHistogram)
+    {
+        for (int i = 0; i < kBucketCount; i++) {
+            mBuckets[i] += inHistogram.mBuckets[i];
+        }
+        mCount += inHistogram.mCount;
+        mTotal += inHistogram.mTotal;
+        if (mMaxValue < inHistogram.mMaxValue) {
+            mMaxValue = inHistogram.mMaxValue;
+        }
+        return *this;
+    }
+    // Returns upper bound of the bucket that contains the percentile, the
+    // percentile is in 1/10 of percent units, i.e. 990 is 99th percentile.
+    int64_t GetPercentile(
+        int inPerMille) const
+    {
+        if (mCount <= 0) {
+            return 0;
+        }
+        const Counter theRank = (mCount * inPerMille + 999) / 1000;
+        Counter       theSum  = 0;
+        for (int i = 0; i < kBucketCount; i++) {
+            if (theRank <= (theSum += mBuckets[i])) {
+                const int64_t theBound = GetBucketUpperBound(i);
+                return (mMaxValue < theBound ? mMaxValue : theBound);
+            }
+        }
+        return mMaxValue;
+    }
+    Counter GetCount() const
+        { return mCount; }
+    Counter GetTotal() const
+        { return mTotal; }
+    int64_t GetMax() const
+        { return mMaxValue; }
+    template<typename T>
+    void Enumerate(
+        T& inFunctor) const
+    {
+        inFunctor("Count", mCount);
+        inFunctor("Total", mTotal);
+        inFunctor("P50",   GetPercentile(500));
+        inFunctor("P90",   GetPercentile(900));
+        inFunctor("P99",   GetPercentile(990));
+        inFunctor("P999",  GetPercentile(999));
+        inFunctor("Max",   mMaxValue);
+    }
+    static int GetBucket(
+        int64_t inValue)
+    {
+        if (inValue < kSubBucketCount) {
+            return (int)inValue;
+        }
+        int theBits = kSubBucketBits;
+        while (theBits < kMaxValueBits && (inValue >> (theBits + 1)) != 0) {
+            theBits++;
+        }
+        if (kMaxValueBits <= theBits) {
+            return (kBucketCount - 1);
+        }
+        return ((theBits - kSubBucketBits + 1) * kSubBucketCount +
+            (int)((inValue >> (theBits - kSubBucketBits)) &
+                (kSubBucketCount - 1)));
+    }
+    static int64_t GetBucketUpperBound(
+        int inBucket)
+    {
+        if (inBucket < kSubBucketCount) {
+            return inBucket;
+        }
+        const int theShift = inBucket / kSubBucketCount - 1;
+        return (((int64_t)(kSubBucketCount + inBucket % kSubBucketCount + 1)
+            << theShift) - 1);
+    }
+private:
+    Counter mCount;
+    Counter mTotal;
+    int64_t mMaxValue;
+    Counter mBuckets[kBucketCount];
+};
+
+}
+
+#endif /* LATENCY_HISTOGRAM_H */
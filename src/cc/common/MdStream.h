@@ -58,6 +58,13 @@ public:
     {
         EVP_cleanup();
     }
+    // Empty name selects md5.
+    static bool IsDigestSupported(
+        const string& inDigestName)
+    {
+        return (inDigestName.empty() ||
+            EVP_get_digestbyname(inDigestName.c_str()));
+    }
     MdStreamT(
         OStreamT*     inStreamPtr  = 0,
         bool          inSyncFlag   = true,
@@ -148,6 +155,18 @@ public:
         mStreamPtr = inStreamPtr;
         return *this;
     }
+    // Reset and switch to the digest with the given name.
+    ostream& Reset(
+        OStreamT*     inStreamPtr,
+        const string& inDigestName)
+    {
+        flush();
+        SyncSelf();
+        mDigestName = inDigestName;
+        return Reset(inStreamPtr);
+    }
+    const string& GetDigestName() const
+        { return mDigestName; }
     ostream& SetWriteTrough(
         bool inWriteTroughFlag)
     {
@@ -250,7 +269,7 @@ protected:
     }
 
 private:
-    const string mDigestName;
+    string       mDigestName;
     char* const  mBufferPtr;
     char*        mCurPtr;
     char* const  mEndPtr;
@@ -0,0 +1,490 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Open addressing hash table with the LinearHash interface. The entries are
+// stored in the table slots, the slot control bytes are kept in a separate
+// array, and probed 16 at a time (with SSE2 if available). The lookup cost is
+// typically one control bytes and one slots array cache miss, as opposed to
+// the bucket, and the entry list cache misses with LinearHash.
+//
+// The table grows incrementally: when the load factor limit is reached, a new
+// table is allocated, and insert moves a group of slots from the old into the
+// new table, therefore no single insert re-hashes the entire table.
+//
+// Unlike LinearHash, Insert() moves entries: it invalidates the pointers
+// returned by Find() and Insert(), and the cursor. Erase() does not move
+// entries, and can be used while iterating. Suitable for tables with small
+// entries, where the entry address stability is not required.
+//
+//----------------------------------------------------------------------------
+
+#ifndef OPEN_HASH_H
+#define OPEN_HASH_H
+
+#include "LinearHash.h"
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <algorithm>
+
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#   define KFS_OPEN_HASH_SSE2
+#endif
+
+namespace KFS
+{
+
+template<
+  typename KVPairT,
+  typename KeyIdT          = KeyCompare<typename KVPairT::Key>,
+  typename DeleteObserverT = DeleteObserver<KVPairT>
+>
+class OpenHash
+{
+public:
+    typedef typename KVPairT::Key Key;
+    typedef typename KVPairT::Val Val;
+    typedef std::size_t           size_t;
+    // For compatibility with the LinearHash users that refer to the entry
+    // value type.
+    struct Entry
+    {
+        typedef KVPairT value_type;
+    };
+
+    static inline size_t MaxSize()
+        { return (~size_t(0) / 2 / sizeof(KVPairT)); }
+
+    OpenHash()
+        : mTable(),
+          mOld(),
+          mMigrateIdx(0),
+          mCursorTablePtr(0),
+          mCursorIdx(0),
+          mKeyId(),
+          mDelObserverPtr(0)
+        {}
+    OpenHash(
+        const OpenHash& inHash)
+        : mTable(),
+          mOld(),
+          mMigrateIdx(0),
+          mCursorTablePtr(0),
+          mCursorIdx(0),
+          mKeyId(),
+          mDelObserverPtr(0)
+        { *this = inHash; }
+    ~OpenHash()
+        { OpenHash::Clear(); }
+    OpenHash& operator=(
+        const OpenHash& inHash)
+    {
+        if (this == &inHash) {
+            return *this;
+        }
+        Clear();
+        const Table* const theTables[] = { &inHash.mOld, &inHash.mTable };
+        for (size_t t = 0; t < 2; t++) {
+            const Table& theTable = *theTables[t];
+            for (size_t i = 0; i < theTable.mCapacity; i++) {
+                if (IsFull(theTable.mCtrlPtr[i])) {
+                    const KVPairT& theEntry = theTable.mSlotsPtr[i];
+                    bool theInsertedFlag;
+                    Insert(theEntry.GetKey(), theEntry.GetVal(),
+                        theInsertedFlag);
+                }
+            }
+        }
+        return *this;
+    }
+    void SetDeleteObserver(
+        DeleteObserverT* inObserverPtr)
+        { mDelObserverPtr = inObserverPtr; }
+    size_t GetSize() const
+        { return (mTable.mSize + mOld.mSize); }
+    size_t IsEmpty() const
+        { return (GetSize() <= 0); }
+    void Clear()
+    {
+        Clear(mOld);
+        Clear(mTable);
+        mMigrateIdx     = 0;
+        mCursorTablePtr = 0;
+        mCursorIdx      = 0;
+    }
+    Val* Find(
+        const Key& inKey) const
+    {
+        if (IsEmpty()) {
+            return 0;
+        }
+        const size_t theHash = Mix(mKeyId.Hash(inKey));
+        const Table* theTablePtr = &mTable;
+        size_t       theIdx      = FindSlot(mTable, inKey, theHash);
+        if (theIdx == kNotFound && 0 < mOld.mSize) {
+            theTablePtr = &mOld;
+            theIdx      = FindSlot(mOld, inKey, theHash);
+        }
+        return (theIdx == kNotFound ? 0 :
+            &(theTablePtr->mSlotsPtr[theIdx].GetVal()));
+    }
+    Val* Insert(
+        const Key& inKey,
+        const Val& inVal,
+        bool&      outInsertedFlag)
+    {
+        const size_t theHash = Mix(mKeyId.Hash(inKey));
+        if (! IsEmpty()) {
+            size_t theIdx = FindSlot(mTable, inKey, theHash);
+            if (theIdx != kNotFound) {
+                outInsertedFlag = false;
+                return &(mTable.mSlotsPtr[theIdx].GetVal());
+            }
+            if (0 < mOld.mSize &&
+                    (theIdx = FindSlot(mOld, inKey, theHash)) != kNotFound) {
+                outInsertedFlag = false;
+                return &(mOld.mSlotsPtr[theIdx].GetVal());
+            }
+        }
+        mCursorTablePtr = 0;
+        if (0 < mOld.mCapacity) {
+            Migrate();
+        }
+        if (mOld.mCapacity <= 0 &&
+                mTable.mCapacity / 8 * 7 <= mTable.mSize + mTable.mDeleted) {
+            StartRehash();
+        }
+        const size_t theIdx = InsertSlot(mTable, theHash);
+        KVPairT* const thePtr = mTable.mSlotsPtr + theIdx;
+        new (thePtr) KVPairT(inKey, inVal);
+        outInsertedFlag = true;
+        return &(thePtr->GetVal());
+    }
+    size_t Erase(
+        const Key& inKey)
+    {
+        if (IsEmpty()) {
+            return 0;
+        }
+        const size_t theHash = Mix(mKeyId.Hash(inKey));
+        size_t       theIdx  = FindSlot(mTable, inKey, theHash);
+        if (theIdx != kNotFound) {
+            EraseSlot(mTable, theIdx);
+            return 1;
+        }
+        if (0 < mOld.mSize &&
+                (theIdx = FindSlot(mOld, inKey, theHash)) != kNotFound) {
+            EraseSlot(mOld, theIdx);
+            return 1;
+        }
+        return 0;
+    }
+    void First()
+    {
+        mCursorTablePtr = 0 < mOld.mCapacity ? &mOld : &mTable;
+        mCursorIdx      = 0;
+    }
+    const KVPairT* Next()
+    {
+        while (mCursorTablePtr) {
+            const Table& theTable = *mCursorTablePtr;
+            while (mCursorIdx < theTable.mCapacity) {
+                const size_t theIdx = mCursorIdx++;
+                if (IsFull(theTable.mCtrlPtr[theIdx])) {
+                    return (theTable.mSlotsPtr + theIdx);
+                }
+            }
+            mCursorIdx      = 0;
+            mCursorTablePtr = mCursorTablePtr == &mOld ? &mTable : 0;
+        }
+        return 0;
+    }
+    void Swap(
+        OpenHash& inHash)
+    {
+        if (this == &inHash) {
+            return;
+        }
+        // The cursor points to the table member, which is not swapped.
+        mTable.Swap(inHash.mTable);
+        mOld.Swap(inHash.mOld);
+        std::swap(mMigrateIdx,     inHash.mMigrateIdx);
+        std::swap(mKeyId,          inHash.mKeyId);
+        std::swap(mDelObserverPtr, inHash.mDelObserverPtr);
+        mCursorTablePtr        = 0;
+        inHash.mCursorTablePtr = 0;
+    }
+private:
+    enum
+    {
+        kGroupSize          = 16,
+        kMinCapacity        = 2 * kGroupSize,
+        kMigrateGroupsCount = 2
+    };
+    static const uint8_t kCtrlEmpty   = 0x80;
+    static const uint8_t kCtrlDeleted = 0xFE;
+    static const size_t  kNotFound    = ~size_t(0);
+
+    struct Table
+    {
+        Table()
+            : mCtrlPtr(0),
+              mSlotsPtr(0),
+              mCapacity(0),
+              mSize(0),
+              mDeleted(0)
+            {}
+        void Swap(
+            Table& inTable)
+        {
+            std::swap(mCtrlPtr,  inTable.mCtrlPtr);
+            std::swap(mSlotsPtr, inTable.mSlotsPtr);
+            std::swap(mCapacity, inTable.mCapacity);
+            std::swap(mSize,     inTable.mSize);
+            std::swap(mDeleted,  inTable.mDeleted);
+        }
+        uint8_t* mCtrlPtr;
+        KVPairT* mSlotsPtr;
+        size_t   mCapacity;
+        size_t   mSize;
+        size_t   mDeleted;
+    };
+
+    Table            mTable;
+    Table            mOld;        // The table being migrated into mTable.
+    size_t           mMigrateIdx; // Next old table slot to migrate.
+    const Table*     mCursorTablePtr;
+    size_t           mCursorIdx;
+    KeyIdT           mKeyId;
+    DeleteObserverT* mDelObserverPtr;
+
+    static size_t Mix(
+        size_t inHash)
+    {
+        // 64 bit finalizer, spreads the sequential keys, such as chunk ids.
+        uint64_t theHash = (uint64_t)inHash;
+        theHash ^= theHash >> 33;
+        theHash *= 0xff51afd7ed558ccdULL;
+        theHash ^= theHash >> 33;
+        theHash *= 0xc4ceb9fe1a85ec53ULL;
+        theHash ^= theHash >> 33;
+        return (size_t)theHash;
+    }
+    static uint8_t Tag(
+        size_t inHash)
+        { return (uint8_t)((uint64_t)inHash >> 57); }
+    static bool IsFull(
+        uint8_t inCtrl)
+        { return ((inCtrl & 0x80) == 0); }
+#if defined(KFS_OPEN_HASH_SSE2)
+    static unsigned int Match(
+        const uint8_t* inGroupPtr,
+        uint8_t        inCtrl)
+    {
+        return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_set1_epi8((char)inCtrl),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(inGroupPtr))));
+    }
+    static unsigned int MatchEmptyOrDeleted(
+        const uint8_t* inGroupPtr)
+    {
+        return (unsigned int)_mm_movemask_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(inGroupPtr)));
+    }
+#else
+    static unsigned int Match(
+        const uint8_t* inGroupPtr,
+        uint8_t        inCtrl)
+    {
+        unsigned int theMask = 0;
+        for (int i = 0; i < kGroupSize; i++) {
+            theMask |= (unsigned int)(inGroupPtr[i] == inCtrl) << i;
+        }
+        return theMask;
+    }
+    static unsigned int MatchEmptyOrDeleted(
+        const uint8_t* inGroupPtr)
+    {
+        unsigned int theMask = 0;
+        for (int i = 0; i < kGroupSize; i++) {
+            theMask |= (unsigned int)(inGroupPtr[i] >> 7) << i;
+        }
+        return theMask;
+    }
+#endif
+    static int LowestBit(
+        unsigned int inMask)
+        { return __builtin_ctz(inMask); }
+    size_t FindSlot(
+        const Table& inTable,
+        const Key&   inKey,
+        size_t       inHash) const
+    {
+        if (inTable.mSize <= 0) {
+            return kNotFound;
+        }
+        // Triangular probing visits all groups, as the number of groups is
+        // power of 2.
+        const size_t  theMask = inTable.mCapacity / kGroupSize - 1;
+        const uint8_t theTag  = Tag(inHash);
+        size_t        theGrp  = inHash & theMask;
+        for (size_t i = 1; ; i++) {
+            const uint8_t* const theGroupPtr =
+                inTable.mCtrlPtr + theGrp * kGroupSize;
+            for (unsigned int theBits = Match(theGroupPtr, theTag);
+                    theBits != 0;
+                    theBits &= theBits - 1) {
+                const size_t theIdx = theGrp * kGroupSize + LowestBit(theBits);
+                if (mKeyId.Equals(inKey, inTable.mSlotsPtr[theIdx].GetKey())) {
+                    return theIdx;
+                }
+            }
+            if (Match(theGroupPtr, kCtrlEmpty) != 0 || theMask < i) {
+                return kNotFound;
+            }
+            theGrp = (theGrp + i) & theMask;
+        }
+    }
+    static size_t InsertSlot(
+        Table& inTable,
+        size_t inHash)
+    {
+        const size_t theMask = inTable.mCapacity / kGroupSize - 1;
+        size_t       theGrp  = inHash & theMask;
+        for (size_t i = 1; ; i++) {
+            uint8_t* const     theGroupPtr =
+                inTable.mCtrlPtr + theGrp * kGroupSize;
+            const unsigned int theBits     = MatchEmptyOrDeleted(theGroupPtr);
+            if (theBits != 0) {
+                const size_t theIdx = theGrp * kGroupSize + LowestBit(theBits);
+                if (inTable.mCtrlPtr[theIdx] == kCtrlDeleted) {
+                    inTable.mDeleted--;
+                }
+                inTable.mCtrlPtr[theIdx] = Tag(inHash);
+                inTable.mSize++;
+                return theIdx;
+            }
+            theGrp = (theGrp + i) & theMask;
+        }
+    }
+    void EraseSlot(
+        Table& inTable,
+        size_t inIdx)
+    {
+        KVPairT& theEntry = inTable.mSlotsPtr[inIdx];
+        if (mDelObserverPtr) {
+            (*mDelObserverPtr)(theEntry);
+        }
+        theEntry.~KVPairT();
+        // Probe sequence never continued past a group with an empty slot,
+        // therefore the slot can be marked empty.
+        const uint8_t* const theGroupPtr =
+            inTable.mCtrlPtr + inIdx / kGroupSize * kGroupSize;
+        if (Match(theGroupPtr, kCtrlEmpty) != 0) {
+            inTable.mCtrlPtr[inIdx] = kCtrlEmpty;
+        } else {
+            inTable.mCtrlPtr[inIdx] = kCtrlDeleted;
+            inTable.mDeleted++;
+        }
+        inTable.mSize--;
+    }
+    static void Allocate(
+        Table& inTable,
+        size_t inCapacity)
+    {
+        inTable.mSlotsPtr = static_cast<KVPairT*>(
+            ::operator new(inCapacity * sizeof(KVPairT)));
+        inTable.mCtrlPtr  = static_cast<uint8_t*>(::operator new(inCapacity));
+        memset(inTable.mCtrlPtr, kCtrlEmpty, inCapacity);
+        inTable.mCapacity = inCapacity;
+        inTable.mSize     = 0;
+        inTable.mDeleted  = 0;
+    }
+    static void Free(
+        Table& inTable)
+    {
+        ::operator delete(inTable.mSlotsPtr);
+        ::operator delete(inTable.mCtrlPtr);
+        inTable = Table();
+    }
+    void Clear(
+        Table& inTable)
+    {
+        if (inTable.mCapacity <= 0) {
+            return;
+        }
+        for (size_t i = 0; i < inTable.mCapacity && 0 < inTable.mSize; i++) {
+            if (IsFull(inTable.mCtrlPtr[i])) {
+                EraseSlot(inTable, i);
+            }
+        }
+        Free(inTable);
+    }
+    void StartRehash()
+    {
+        // The new table capacity ensures that the migration completes before
+        // the new table reaches the load factor limit, with migrating
+        // kMigrateGroupsCount groups per insert.
+        size_t theCapacity = kMinCapacity;
+        while (theCapacity / 2 < mTable.mSize + 1 ||
+                theCapacity < mTable.mCapacity / 4) {
+            theCapacity += theCapacity;
+        }
+        mOld.Swap(mTable);
+        Allocate(mTable, theCapacity);
+        mMigrateIdx = 0;
+        if (mOld.mSize <= 0) {
+            Free(mOld);
+        }
+    }
+    void Migrate()
+    {
+        const size_t theEnd = std::min(mOld.mCapacity,
+            mMigrateIdx + kMigrateGroupsCount * kGroupSize);
+        for (; mMigrateIdx < theEnd && 0 < mOld.mSize; mMigrateIdx++) {
+            const uint8_t theCtrl = mOld.mCtrlPtr[mMigrateIdx];
+            if (! IsFull(theCtrl)) {
+                continue;
+            }
+            KVPairT&     theEntry = mOld.mSlotsPtr[mMigrateIdx];
+            const size_t theIdx   = InsertSlot(mTable,
+                Mix(mKeyId.Hash(theEntry.GetKey())));
+            new (mTable.mSlotsPtr + theIdx) KVPairT(theEntry);
+            theEntry.~KVPairT();
+            // Mark deleted, not empty, in order to continue probing past the
+            // migrated slots.
+            mOld.mCtrlPtr[mMigrateIdx] = kCtrlDeleted;
+            mOld.mSize--;
+        }
+        if (mOld.mSize <= 0) {
+            Free(mOld);
+            mMigrateIdx = 0;
+        }
+    }
+};
+
+}
+
+#endif /* OPEN_HASH_H */
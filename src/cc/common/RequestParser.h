@@ -28,6 +28,7 @@
 #define REQUEST_PARSER_H
 
 #include <map>
+#include <vector>
 #include <utility>
 #include <string>
 #include <algorithm>
@@ -50,6 +51,7 @@ using std::min;
 using std::make_pair;
 using std::map;
 using std::less;
+using std::vector;
 
 // Multiple inheritance below used only to enforce construction order.
 class BufferInputStream :
@@ -517,6 +519,107 @@ private:
     const bool        mIgnoreMalformedFlag;
 };
 
+// Collision free open addressing hash table with the header name keys. The
+// table is built once, after all keys are defined, by searching for the hash
+// seed and the table size that map every key into its own slot. The lookup
+// requires a single hash computation and a single key comparison, and does
+// no memory allocation.
+template <typename T>
+class TokenPerfectHash
+{
+public:
+    typedef PropertiesTokenizer::Token Key;
+    typedef map<Key, T, less<Key> >    Map;
+
+    TokenPerfectHash()
+        : mSeed(0),
+          mMask(0),
+          mTable()
+        {}
+    bool Build(
+        const Map& inMap)
+    {
+        mTable.clear();
+        mSeed = 0;
+        mMask = 0;
+        if (inMap.empty()) {
+            return false;
+        }
+        const size_t kMaxSeedTries = 512;
+        size_t       theSize       = 4;
+        while (theSize < inMap.size() * 2) {
+            theSize <<= 1;
+        }
+        const size_t theMaxSize = theSize << 4;
+        Table        theTable;
+        for (; theSize <= theMaxSize; theSize <<= 1) {
+            for (size_t theTry = 0; theTry < kMaxSeedTries; theTry++) {
+                const unsigned int theSeed =
+                    (unsigned int)(theTry * 0x9E3779B9u + 1);
+                const size_t       theMask = theSize - 1;
+                theTable.assign(theSize, Entry());
+                typename Map::const_iterator theIt;
+                for (theIt = inMap.begin(); theIt != inMap.end(); ++theIt) {
+                    Entry& theEntry =
+                        theTable[Hash(theSeed, theIt->first) & theMask];
+                    if (theEntry.mKey.mPtr) {
+                        break;
+                    }
+                    theEntry.mKey   = theIt->first;
+                    theEntry.mValue = theIt->second;
+                }
+                if (theIt == inMap.end()) {
+                    mSeed = theSeed;
+                    mMask = theMask;
+                    mTable.swap(theTable);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    bool IsBuilt() const
+        { return (! mTable.empty()); }
+    const T* Find(
+        const Key& inKey) const
+    {
+        const Entry& theEntry = mTable[Hash(mSeed, inKey) & mMask];
+        return ((theEntry.mKey.mPtr && theEntry.mKey == inKey) ?
+            &theEntry.mValue : 0);
+    }
+private:
+    struct Entry
+    {
+        Entry()
+            : mKey(),
+              mValue()
+            {}
+        Key mKey;
+        T   mValue;
+    };
+    typedef vector<Entry> Table;
+
+    unsigned int mSeed;
+    size_t       mMask;
+    Table        mTable;
+
+    static size_t Hash(
+        unsigned int inSeed,
+        const Key&   inKey)
+    {
+        // FNV-1a with seed.
+        unsigned int               theHash   =
+            inSeed ^ (unsigned int)inKey.mLen;
+        const unsigned char*       thePtr    =
+            reinterpret_cast<const unsigned char*>(inKey.mPtr);
+        const unsigned char* const theEndPtr = thePtr + inKey.mLen;
+        while (thePtr < theEndPtr) {
+            theHash = (theHash ^ *thePtr++) * 16777619u;
+        }
+        return (theHash ^ (theHash >> 15));
+    }
+};
+
 // Create parser for object fields, and invoke appropriate parsers based on the
 // request header names.
 template <typename OBJ, typename VALUE_PARSER=ValueParser>
@@ -532,7 +635,8 @@ public:
 
     ObjectParser()
         : mDefDoneFlag(false),
-          mFields()
+          mFields(),
+          mFieldsHash()
         {}
     virtual ~ObjectParser()
     {
@@ -559,6 +663,9 @@ public:
     }
     ObjectParser& DefDone()
     {
+        if (! mDefDoneFlag) {
+            mFieldsHash.Build(mFields);
+        }
         mDefDoneFlag = true;
         return *this;
     }
@@ -569,17 +676,17 @@ public:
         OBJ*       inObjPtr) const
     {
         while (inTokenizer.Next()) {
-            const Token& theKey = inTokenizer.GetKey();
-            typename Fields::const_iterator const theIt = mFields.find(theKey);
-            if (theIt == mFields.end()) {
+            const Token&               theKey      = inTokenizer.GetKey();
+            const AbstractField* const theFieldPtr = FindField(theKey);
+            if (theFieldPtr) {
+                theFieldPtr->Set(inObjPtr, inTokenizer.GetValue());
+            } else {
                 const Token& theValue = inTokenizer.GetValue();
                 if (! inObjPtr->HandleUnknownField(
                         theKey.mPtr,    theKey.mLen,
                         theValue.mPtr, theValue.mLen)) {
                     break;
                 }
-            } else {
-                theIt->second->Set(inObjPtr, inTokenizer.GetValue());
             }
         }
     }
@@ -635,10 +742,23 @@ private:
         T const       mDefault;
     };
 
-    typedef map<Key, AbstractField*, less<Key> > Fields;
+    typedef TokenPerfectHash<AbstractField*> FieldsHash;
+    typedef typename FieldsHash::Map         Fields;
+
+    bool       mDefDoneFlag;
+    Fields     mFields;
+    FieldsHash mFieldsHash;
 
-    bool   mDefDoneFlag;
-    Fields mFields;
+    const AbstractField* FindField(
+        const Key& inKey) const
+    {
+        if (mFieldsHash.IsBuilt()) {
+            AbstractField* const* const thePtr = mFieldsHash.Find(inKey);
+            return (thePtr ? *thePtr : 0);
+        }
+        typename Fields::const_iterator const theIt = mFields.find(inKey);
+        return (theIt == mFields.end() ? 0 : theIt->second);
+    }
 };
 
 template <typename ABSTRACT_OBJ>
@@ -730,6 +850,8 @@ public:
     typedef typename Parser::Checksum           Checksum;
 
     RequestHandler()
+        : mParsers(),
+          mParsersHash()
         {}
     ~RequestHandler()
         {}
@@ -749,10 +871,10 @@ public:
         while (thePtr < theEndPtr && ! IsWSpace(*thePtr)) {
             thePtr++;
         }
-        const size_t theNameLen = thePtr - theNamePtr;
-        typename Parsers::const_iterator const theIt =
-            mParsers.find(Name(theNamePtr, theNameLen));
-        if (theIt == mParsers.end()) {
+        const size_t        theNameLen   = thePtr - theNamePtr;
+        const Parser* const theParserPtr =
+            FindParser(Name(theNamePtr, theNameLen));
+        if (! theParserPtr) {
             return 0;
         }
         // Get optional header checksum.
@@ -767,7 +889,7 @@ public:
         while (thePtr < theEndPtr && IsWSpace(*thePtr)) {
             thePtr++;
         }
-        return theIt->second->Parse(
+        return theParserPtr->Parse(
             thePtr,
             theEndPtr - thePtr,
             theNamePtr,
@@ -793,6 +915,9 @@ public:
             // Duplicate name -- definition error.
             abort();
         }
+        // Parsers are defined at startup, rebuild the hash table with
+        // every new parser.
+        mParsersHash.Build(mParsers);
         return *this;
     }
     template <typename OBJ>
@@ -810,10 +935,23 @@ public:
     }
 
 private:
-    typedef PropertiesTokenizer::Token Name;
-    typedef map<Name, const Parser*>   Parsers;
+    typedef PropertiesTokenizer::Token       Name;
+    typedef TokenPerfectHash<const Parser*>  ParsersHash;
+    typedef typename ParsersHash::Map        Parsers;
 
-    Parsers mParsers;
+    Parsers     mParsers;
+    ParsersHash mParsersHash;
+
+    const Parser* FindParser(
+        const Name& inName) const
+    {
+        if (mParsersHash.IsBuilt()) {
+            const Parser* const* const thePtr = mParsersHash.Find(inName);
+            return (thePtr ? *thePtr : 0);
+        }
+        typename Parsers::const_iterator const theIt = mParsers.find(inName);
+        return (theIt == mParsers.end() ? 0 : theIt->second);
+    }
 };
 
 }
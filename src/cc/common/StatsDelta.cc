@@ -0,0 +1,125 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Stats delta encoder implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "StatsDelta.h"
+
+namespace KFS
+{
+using std::make_pair;
+
+StatsDelta::StatsDelta(
+    size_t inMaxSubscribers,
+    int    inExpireSec)
+    : mMaxSubscribers(inMaxSubscribers),
+      mExpireSec(inExpireSec),
+      mSubscribers()
+    {}
+
+StatsDelta::~StatsDelta()
+    {}
+
+int64_t
+StatsDelta::Encode(
+    int64_t inSubscriberId,
+    int64_t inBaseGen,
+    time_t  inNow,
+    string& ioStats,
+    bool&   outFullFlag)
+{
+    Subscribers::iterator theIt = mSubscribers.find(inSubscriberId);
+    if (theIt == mSubscribers.end()) {
+        Expire(inNow);
+        theIt = mSubscribers.insert(
+            make_pair(inSubscriberId, Entry())).first;
+    }
+    Entry&       theEntry    = theIt->second;
+    const bool   theBaseFlag = 0 < theEntry.mGen && theEntry.mGen == inBaseGen;
+    Values       theValues;
+    string       theDelta;
+    const size_t theLen      = ioStats.size();
+    size_t       thePos      = 0;
+    while (thePos < theLen) {
+        size_t theEnd = ioStats.find('\n', thePos);
+        theEnd = theEnd == string::npos ? theLen : theEnd + 1;
+        const size_t theSep = ioStats.find(':', thePos);
+        if (theSep == string::npos || theEnd <= theSep) {
+            // Not a stats line, always include.
+            theDelta.append(ioStats, thePos, theEnd - thePos);
+            thePos = theEnd;
+            continue;
+        }
+        const string theName(ioStats, thePos, theSep - thePos);
+        const string theValue(ioStats, theSep, theEnd - theSep);
+        Values::const_iterator const thePrevIt = theBaseFlag ?
+            theEntry.mValues.find(theName) : theEntry.mValues.end();
+        if (thePrevIt == theEntry.mValues.end() ||
+                thePrevIt->second != theValue) {
+            theDelta.append(ioStats, thePos, theEnd - thePos);
+        }
+        theValues[theName] = theValue;
+        thePos = theEnd;
+    }
+    outFullFlag = ! theBaseFlag;
+    if (theBaseFlag) {
+        // Removed stats are sent with empty value.
+        for (Values::const_iterator theIt = theEntry.mValues.begin();
+                theIt != theEntry.mValues.end();
+                ++theIt) {
+            if (theValues.find(theIt->first) == theValues.end()) {
+                theDelta += theIt->first;
+                theDelta += ":\r\n";
+            }
+        }
+        ioStats.swap(theDelta);
+    }
+    theEntry.mValues.swap(theValues);
+    theEntry.mLastUsed = inNow;
+    return ++theEntry.mGen;
+}
+
+void
+StatsDelta::Expire(
+    time_t inNow)
+{
+    Subscribers::iterator theLruIt = mSubscribers.end();
+    Subscribers::iterator theIt    = mSubscribers.begin();
+    while (theIt != mSubscribers.end()) {
+        if (theIt->second.mLastUsed + mExpireSec < inNow) {
+            mSubscribers.erase(theIt++);
+            continue;
+        }
+        if (theLruIt == mSubscribers.end() ||
+                theIt->second.mLastUsed < theLruIt->second.mLastUsed) {
+            theLruIt = theIt;
+        }
+        ++theIt;
+    }
+    if (mMaxSubscribers <= mSubscribers.size() &&
+            theLruIt != mSubscribers.end()) {
+        mSubscribers.erase(theLruIt);
+    }
+}
+
+} // namespace KFS
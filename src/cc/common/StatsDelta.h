@@ -0,0 +1,93 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Stats delta encoder: for each monitoring subscriber the encoder retains the
+// last "name: value" stats lines sent, and replaces the full stats with the
+// lines that changed since the last response, as long as the subscriber
+// acknowledges the last response generation. The stats lines that are no
+// longer present are sent with empty value. Full stats are sent to new
+// subscribers, and on generation mismatch, e.g. lost response. The number of
+// subscribers is bounded, the least recently used subscribers are evicted.
+// Not thread safe.
+//
+//----------------------------------------------------------------------------
+
+#ifndef STATS_DELTA_H
+#define STATS_DELTA_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+#include <map>
+
+namespace KFS
+{
+using std::string;
+using std::map;
+
+class StatsDelta
+{
+public:
+    StatsDelta(
+        size_t inMaxSubscribers = 256,
+        int    inExpireSec      = 15 * 60);
+    ~StatsDelta();
+    // Replace ioStats with the delta, and return the generation of the
+    // response. The subscriber must pass the returned generation as
+    // inBaseGen with the next request.
+    int64_t Encode(
+        int64_t inSubscriberId,
+        int64_t inBaseGen,
+        time_t  inNow,
+        string& ioStats,
+        bool&   outFullFlag);
+private:
+    typedef map<string, string> Values;
+    struct Entry
+    {
+        Entry()
+            : mGen(0),
+              mLastUsed(0),
+              mValues()
+            {}
+        int64_t mGen;
+        time_t  mLastUsed;
+        Values  mValues;
+    };
+    typedef map<int64_t, Entry> Subscribers;
+
+    const size_t mMaxSubscribers;
+    const int    mExpireSec;
+    Subscribers  mSubscribers;
+
+    void Expire(
+        time_t inNow);
+private:
+    StatsDelta(
+        const StatsDelta& inDelta);
+    StatsDelta& operator=(
+        const StatsDelta& inDelta);
+};
+
+} // namespace KFS
+
+#endif /* STATS_DELTA_H */
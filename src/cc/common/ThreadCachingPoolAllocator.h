@@ -0,0 +1,306 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Thread caching front end for PoolAllocator. Each thread allocates from and
+// de-allocates into its own LIFO free list without any locks. The thread free
+// list is refilled from, and trimmed into the shared mutex protected depot in
+// batches of TBatchSize elements, in order to amortize the locking cost. The
+// depot keeps the full batches on a separate list, and moves a batch in and
+// out with O(1) pointer swaps. The depot allocates new elements from
+// PoolAllocator. The thread free list is returned into the depot on thread
+// exit. Elements can be allocated by one thread and de-allocated by another.
+// The allocated space is never released back to the os, and the allocator
+// "leaks" all its space if destroyed, therefore the allocator must outlive
+// all the threads that use it.
+//
+//----------------------------------------------------------------------------
+
+#ifndef THREAD_CACHING_POOL_ALLOCATOR_H
+#define THREAD_CACHING_POOL_ALLOCATOR_H
+
+#include "PoolAllocator.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/QCUtils.h"
+#include "qcdio/qcstutils.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+namespace KFS
+{
+
+struct ThreadCachingPoolAllocatorStats
+{
+    typedef int64_t Counter;
+
+    Counter mStorageSize;
+    Counter mElemCount;
+    Counter mDepotFreeCount;
+    Counter mOutstandingCount;
+    Counter mThreadCacheCount;
+    Counter mRefillCount;
+    Counter mTrimCount;
+
+    ThreadCachingPoolAllocatorStats()
+        : mStorageSize(0),
+          mElemCount(0),
+          mDepotFreeCount(0),
+          mOutstandingCount(0),
+          mThreadCacheCount(0),
+          mRefillCount(0),
+          mTrimCount(0)
+        {}
+    ThreadCachingPoolAllocatorStats& Add(
+        const ThreadCachingPoolAllocatorStats& inStats)
+    {
+        mStorageSize      += inStats.mStorageSize;
+        mElemCount        += inStats.mElemCount;
+        mDepotFreeCount   += inStats.mDepotFreeCount;
+        mOutstandingCount += inStats.mOutstandingCount;
+        mThreadCacheCount += inStats.mThreadCacheCount;
+        mRefillCount      += inStats.mRefillCount;
+        mTrimCount        += inStats.mTrimCount;
+        return *this;
+    }
+};
+
+template<
+    size_t TItemSize,
+    size_t TMinStorageAlloc,
+    size_t TMaxStorageAlloc,
+    size_t TBatchSize
+>
+class ThreadCachingPoolAllocator
+{
+public:
+    typedef ThreadCachingPoolAllocatorStats Stats;
+
+    enum
+    {
+        // Use second word of the batch head element to link the batches.
+        kElemSize = (TItemSize + sizeof(char*) - 1) / sizeof(char*) *
+            sizeof(char*) < 2 * sizeof(char*) ? 2 * sizeof(char*) :
+            (TItemSize + sizeof(char*) - 1) / sizeof(char*) * sizeof(char*)
+    };
+
+    ThreadCachingPoolAllocator()
+        : mMutex(),
+          mPool(),
+          mBatchListPtr(0),
+          mFreeListPtr(0),
+          mFreeCount(0),
+          mBatchCount(0),
+          mStats(),
+          mKey()
+    {
+        const int theErr = pthread_key_create(&mKey, &DeleteThreadCache);
+        if (theErr != 0) {
+            QCUtils::FatalError("pthread_key_create", theErr);
+        }
+    }
+    ~ThreadCachingPoolAllocator()
+    {
+        // Thread caches are deleted on thread exit. The cache of the thread
+        // that destroys the allocator is "leaked", as well as the pool space,
+        // if there are elements still in use.
+        pthread_key_delete(mKey);
+    }
+    char* Allocate()
+    {
+        ThreadCache& theCache = GetThreadCache();
+        if (! theCache.mFreeListPtr) {
+            Refill(theCache);
+        }
+        char* const theRetPtr = theCache.mFreeListPtr;
+        theCache.mFreeListPtr = Next(theRetPtr);
+        theCache.mFreeCount--;
+        return theRetPtr;
+    }
+    void Deallocate(
+        void* inPtr)
+    {
+        if (! inPtr) {
+            return;
+        }
+        ThreadCache& theCache = GetThreadCache();
+        char* const  thePtr   = reinterpret_cast<char*>(inPtr);
+        Next(thePtr) = theCache.mFreeListPtr;
+        theCache.mFreeListPtr = thePtr;
+        if (2 * TBatchSize <= ++theCache.mFreeCount) {
+            Trim(theCache);
+        }
+    }
+    void GetStats(
+        Stats& outStats)
+    {
+        QCStMutexLocker theLocker(mMutex);
+        outStats = mStats;
+        outStats.mStorageSize    = (typename Stats::Counter)
+            mPool.GetStorageSize();
+        outStats.mElemCount      = (typename Stats::Counter)
+            mPool.GetInUseCount();
+        outStats.mDepotFreeCount = (typename Stats::Counter)
+            (mFreeCount + mBatchCount * TBatchSize);
+    }
+    static size_t GetItemSize()
+        { return TItemSize; }
+    static size_t GetElemSize()
+        { return kElemSize; }
+private:
+    typedef PoolAllocator<
+        kElemSize,
+        TMinStorageAlloc,
+        TMaxStorageAlloc,
+        false
+    > Pool;
+    class ThreadCache
+    {
+    public:
+        ThreadCache(
+            ThreadCachingPoolAllocator& inAllocator)
+            : mAllocator(inAllocator),
+              mFreeListPtr(0),
+              mFreeCount(0)
+            {}
+        ThreadCachingPoolAllocator& mAllocator;
+        char*                       mFreeListPtr;
+        size_t                      mFreeCount;
+    };
+
+    QCMutex        mMutex;
+    Pool           mPool;
+    char*          mBatchListPtr;
+    char*          mFreeListPtr;
+    size_t         mFreeCount;
+    size_t         mBatchCount;
+    Stats          mStats;
+    pthread_key_t  mKey;
+
+    static char*& Next(
+        char* inPtr)
+        { return *reinterpret_cast<char**>(inPtr); }
+    static char*& NextBatch(
+        char* inPtr)
+        { return reinterpret_cast<char**>(inPtr)[1]; }
+    ThreadCache& GetThreadCache()
+    {
+        ThreadCache* thePtr =
+            reinterpret_cast<ThreadCache*>(pthread_getspecific(mKey));
+        if (thePtr) {
+            return *thePtr;
+        }
+        thePtr = new ThreadCache(*this);
+        const int theErr = pthread_setspecific(mKey, thePtr);
+        if (theErr != 0) {
+            QCUtils::FatalError("pthread_setspecific", theErr);
+        }
+        QCStMutexLocker theLocker(mMutex);
+        mStats.mThreadCacheCount++;
+        return *thePtr;
+    }
+    void Refill(
+        ThreadCache& inCache)
+    {
+        assert(! inCache.mFreeListPtr && inCache.mFreeCount == 0);
+        QCStMutexLocker theLocker(mMutex);
+        mStats.mRefillCount++;
+        mStats.mOutstandingCount += TBatchSize;
+        if (mBatchListPtr) {
+            inCache.mFreeListPtr = mBatchListPtr;
+            inCache.mFreeCount   = TBatchSize;
+            mBatchListPtr = NextBatch(mBatchListPtr);
+            mBatchCount--;
+            return;
+        }
+        for (size_t i = 0; i < TBatchSize; i++) {
+            char* thePtr;
+            if (mFreeListPtr) {
+                thePtr       = mFreeListPtr;
+                mFreeListPtr = Next(thePtr);
+                mFreeCount--;
+            } else {
+                thePtr = mPool.Allocate();
+            }
+            Next(thePtr) = inCache.mFreeListPtr;
+            inCache.mFreeListPtr = thePtr;
+        }
+        inCache.mFreeCount = TBatchSize;
+    }
+    void Trim(
+        ThreadCache& inCache)
+    {
+        // Detach batch outside of the critical section.
+        char* const theBatchPtr = inCache.mFreeListPtr;
+        char*       theLastPtr  = theBatchPtr;
+        for (size_t i = 1; i < TBatchSize; i++) {
+            theLastPtr = Next(theLastPtr);
+        }
+        inCache.mFreeListPtr = Next(theLastPtr);
+        inCache.mFreeCount -= TBatchSize;
+        Next(theLastPtr) = 0;
+        QCStMutexLocker theLocker(mMutex);
+        mStats.mTrimCount++;
+        mStats.mOutstandingCount -= TBatchSize;
+        NextBatch(theBatchPtr) = mBatchListPtr;
+        mBatchListPtr = theBatchPtr;
+        mBatchCount++;
+    }
+    void Release(
+        ThreadCache& inCache)
+    {
+        while (TBatchSize <= inCache.mFreeCount) {
+            Trim(inCache);
+        }
+        QCStMutexLocker theLocker(mMutex);
+        mStats.mOutstandingCount -= inCache.mFreeCount;
+        mStats.mThreadCacheCount--;
+        while (inCache.mFreeListPtr) {
+            char* const thePtr = inCache.mFreeListPtr;
+            inCache.mFreeListPtr = Next(thePtr);
+            Next(thePtr) = mFreeListPtr;
+            mFreeListPtr = thePtr;
+            mFreeCount++;
+        }
+        inCache.mFreeCount = 0;
+    }
+    static void DeleteThreadCache(
+        void* inPtr)
+    {
+        ThreadCache* const thePtr = reinterpret_cast<ThreadCache*>(inPtr);
+        if (! thePtr) {
+            return;
+        }
+        thePtr->mAllocator.Release(*thePtr);
+        delete thePtr;
+    }
+private:
+    ThreadCachingPoolAllocator(
+        const ThreadCachingPoolAllocator& inAlloc);
+    ThreadCachingPoolAllocator& operator=(
+        const ThreadCachingPoolAllocator& inAlloc);
+};
+
+}
+
+#endif /* THREAD_CACHING_POOL_ALLOCATOR_H */
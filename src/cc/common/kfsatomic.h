@@ -54,6 +54,24 @@ template<typename T> T SyncAddAndFetch(volatile T& val, T inc)
     return ret;
 }
 
+template<typename T> bool SyncCompareAndSwap(
+    volatile T& val, T oldVal, T newVal)
+{
+    atomicmpl::AtomicLock();
+    const bool ret = val == oldVal;
+    if (ret) {
+        val = newVal;
+    }
+    atomicmpl::AtomicUnlock();
+    return ret;
+}
+
+inline void SyncMemoryBarrier()
+{
+    atomicmpl::AtomicLock();
+    atomicmpl::AtomicUnlock();
+}
+
 #else
 
 template<typename T> T SyncAddAndFetch(volatile T& val, T inc)
@@ -61,6 +79,17 @@ template<typename T> T SyncAddAndFetch(volatile T& val, T inc)
     return __sync_add_and_fetch(&val, inc);
 }
 
+template<typename T> bool SyncCompareAndSwap(
+    volatile T& val, T oldVal, T newVal)
+{
+    return __sync_bool_compare_and_swap(&val, oldVal, newVal);
+}
+
+inline void SyncMemoryBarrier()
+{
+    __sync_synchronize();
+}
+
 #endif /* _KFS_ATOMIC_USE_MUTEX */
 }
 
@@ -123,11 +123,17 @@ enum StripedFileType
     KFS_STRIPED_FILE_TYPE_COUNT
 };
 
+// Per file block compression codecs, see libclient/CompressedFile.h
+const int KFS_COMPRESSION_NONE          = 0;
+const int KFS_COMPRESSION_ZLIB          = 1;
+const int KFS_COMPRESSION_MAX           = KFS_COMPRESSION_ZLIB;
+
 const int KFS_STRIPE_ALIGNMENT          = 4096;
 const int KFS_MIN_STRIPE_SIZE           = KFS_STRIPE_ALIGNMENT;
 const int KFS_MAX_STRIPE_SIZE           = (int)CHUNKSIZE;
 // The bit fields width in the file attribute definition.
 // BaseFattr in meta/meta.h.depends on these.
+#define KFS_COMPRESSION_FIELD_BIT_WIDTH           3
 #define KFS_DATA_STRIPE_COUNT_FIELD_BIT_WIDTH     9
 #define KFS_RECOVERY_STRIPE_COUNT_FIELD_BIT_WIDTH 7
 const int KFS_MAX_DATA_STRIPE_COUNT     =
@@ -153,6 +159,19 @@ static inline bool ValidateStripeParameters(
     );
 }
 
+// Chunk inventory checksum is the sum of the chunk id terms, and is updated
+// incrementally as the chunks are added and removed. The chunk server and the
+// meta server compute the stable chunks inventory checksum in order to detect
+// if the chunk server inventory has changed since the last time it was known
+// by the meta server.
+static inline uint64_t ChunkIdInventoryChecksum(int64_t chunkId)
+{
+    uint64_t x = (uint64_t)chunkId + 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return (x ^ (x >> 31));
+}
+
 enum AuthenticationType
 {
     kAuthenticationTypeUndef = 0x0,
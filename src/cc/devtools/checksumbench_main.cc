@@ -0,0 +1,125 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Copyright 2016 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Block checksum performance test. Compares zlib adler32 with the
+// block checksum Adler-32 implementation, and CRC32C, and validates that the
+// block checksum produces the same result as zlib.
+//
+//----------------------------------------------------------------------------
+
+#include "kfsio/checksum.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#include <iostream>
+#include <vector>
+
+using namespace KFS;
+using namespace std;
+
+static double
+Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+static void
+Report(const char* name, size_t bytes, double secs, uint32_t sum)
+{
+    cout <<
+        name << ": " << bytes / (secs * (1 << 20)) << " MB/sec"
+        " sec: " << secs << " sum: " << sum <<
+    "\n";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
+        cout << "Usage: " << argv[0] << " [total MB] [block size]\n";
+        return 0;
+    }
+    const size_t totalBytes = (size_t)(
+        (argc > 1 ? atof(argv[1]) : 4096.) * (1 << 20));
+    const size_t blockSize  = argc > 2 ?
+        (size_t)atol(argv[2]) : (size_t)CHECKSUM_BLOCKSIZE;
+    if (blockSize <= 0) {
+        cerr << "invalid block size\n";
+        return 1;
+    }
+    // Use buffer larger than the last level cache to include memory
+    // bandwidth, but not too large to keep the setup time short.
+    const size_t  bufSize = max(blockSize, size_t(64) << 20) / blockSize *
+        blockSize;
+    vector<char>  buf(bufSize);
+    unsigned int  seed = 1;
+    for (size_t i = 0; i < bufSize; i++) {
+        buf[i] = (char)(rand_r(&seed) >> 8);
+    }
+    // Validate first, including unaligned buffers and odd lengths.
+    for (size_t i = 0; i < 4096; i++) {
+        const size_t   off = (size_t)rand_r(&seed) % 64;
+        const size_t   len = (size_t)rand_r(&seed) %
+            min(bufSize - off, size_t(2) * CHECKSUM_BLOCKSIZE);
+        const uint32_t chk = (uint32_t)rand_r(&seed) % 65521;
+        if (adler32(chk, reinterpret_cast<const Bytef*>(&buf[off]), len) !=
+                ComputeAdler32(&buf[off], len, chk)) {
+            cerr << "adler32 mismatch: offset: " << off <<
+                " length: " << len << "\n";
+            return 1;
+        }
+    }
+    cout << "adler32 implementation: " << GetChecksumImplementationName() <<
+        " block size: " << blockSize << "\n";
+    const size_t count = max(size_t(1), totalBytes / blockSize);
+    for (int t = 0; t < 3; t++) {
+        uint32_t     sum   = 0;
+        size_t       pos   = 0;
+        const double start = Now();
+        for (size_t i = 0; i < count; i++) {
+            const char* const p = &buf[pos];
+            switch (t) {
+                case 0:
+                    sum += adler32(kKfsNullChecksum,
+                        reinterpret_cast<const Bytef*>(p), blockSize);
+                    break;
+                case 1:
+                    sum += ComputeBlockChecksum(p, blockSize);
+                    break;
+                default:
+                    sum += ComputeCrc32c(p, blockSize);
+                    break;
+            }
+            pos += blockSize;
+            if (bufSize <= pos) {
+                pos = 0;
+            }
+        }
+        const double secs = max(1e-9, Now() - start);
+        static const char* const kNames[] =
+            { "zlib adler32", "block checksum", "crc32c" };
+        Report(kNames[t], count * blockSize, secs, sum);
+    }
+    return 0;
+}
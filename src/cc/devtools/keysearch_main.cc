@@ -0,0 +1,157 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Copyright 2016 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Meta tree node key search performance test. Compares the node key
+// array lower bound search with std::lower_bound for different node fan outs.
+// The number of nodes is chosen such that the key arrays do not fit into the
+// cache, to approximate the meta tree lookup.
+//
+//----------------------------------------------------------------------------
+
+#include "meta/KeyArray.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace KFS;
+using namespace std;
+
+static uint64_t sRandState = 88172645463325252ULL;
+
+static uint64_t
+Rand()
+{
+    sRandState ^= sRandState << 13;
+    sRandState ^= sRandState >> 7;
+    sRandState ^= sRandState << 17;
+    return sRandState;
+}
+
+static Key
+RandKey()
+{
+    const MetaType types[] = { KFS_FATTR, KFS_CHUNKINFO, KFS_DENTRY };
+    return Key(types[Rand() % 3], (KeyData)(Rand() >> 24),
+        (KeyData)(Rand() >> 8));
+}
+
+template<int NKEY>
+struct TestNode
+{
+    KeyArrayT<NKEY> keys;
+    Key             sorted[NKEY];
+};
+
+template<int NKEY>
+static int
+Test(size_t totalKeys, size_t numLookups)
+{
+    typedef TestNode<NKEY> Node;
+    const size_t  numNodes = max(size_t(1), totalKeys / NKEY);
+    vector<Node>  nodes(numNodes);
+    vector<Key>   tests(4096);
+    for (size_t n = 0; n < numNodes; n++) {
+        Node& node = nodes[n];
+        for (int i = 0; i < NKEY; i++) {
+            node.sorted[i] = RandKey();
+        }
+        sort(node.sorted, node.sorted + NKEY);
+        for (int i = 0; i < NKEY; i++) {
+            node.keys.set(i, node.sorted[i]);
+        }
+    }
+    for (size_t i = 0; i < tests.size(); i++) {
+        tests[i] = i % 4 == 0 ?
+            nodes[Rand() % numNodes].sorted[Rand() % NKEY] : RandKey();
+    }
+    // Validate first.
+    for (size_t i = 0; i < tests.size(); i++) {
+        const Node& node = nodes[Rand() % numNodes];
+        const int   count = (int)(Rand() % NKEY) + 1;
+        const int   expected = (int)(lower_bound(
+            node.sorted, node.sorted + count, tests[i]) - node.sorted);
+        if (node.keys.lowerBound(tests[i], count) != expected ||
+                node.keys.lowerBoundScalar(tests[i], count) != expected) {
+            cerr << "fanout: " << NKEY << " search mismatch\n";
+            return 1;
+        }
+    }
+    int64_t sum[3]  = { 0, 0, 0 };
+    double  secs[3] = { 0, 0, 0 };
+    for (int t = 0; t < 3; t++) {
+        sRandState = 88172645463325252ULL;
+        const clock_t start = clock();
+        for (size_t i = 0; i < numLookups; i++) {
+            const Node& node = nodes[Rand() % numNodes];
+            const Key&  test = tests[i & (tests.size() - 1)];
+            switch (t) {
+                case 0:
+                    sum[t] += lower_bound(node.sorted, node.sorted + NKEY,
+                        test) - node.sorted;
+                    break;
+                case 1:
+                    sum[t] += node.keys.lowerBoundScalar(test, NKEY);
+                    break;
+                default:
+                    sum[t] += node.keys.lowerBound(test, NKEY);
+                    break;
+            }
+        }
+        secs[t] = double(clock() - start) / CLOCKS_PER_SEC;
+    }
+    if (sum[0] != sum[1] || sum[0] != sum[2]) {
+        cerr << "fanout: " << NKEY << " search result mismatch\n";
+        return 1;
+    }
+    cout <<
+        "fanout: "         << NKEY <<
+        " nodes: "         << numNodes <<
+        " lookups: "       << numLookups <<
+        " lower_bound: "   << secs[0] <<
+        " linear: "        << secs[1] <<
+        " key array: "     << secs[2] <<
+        " levels: "        << 1 +
+            (int)(log2f((float)totalKeys) / log2f((float)NKEY)) <<
+    "\n";
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
+        cout << "Usage: " << argv[0] << " [total keys] [lookups]\n";
+        return 0;
+    }
+    const size_t totalKeys  = argc > 1 ? (size_t)atof(argv[1]) : (16 << 20);
+    const size_t numLookups = argc > 2 ? (size_t)atof(argv[2]) : (16 << 20);
+    return (
+        Test<16>(totalKeys, numLookups)  ||
+        Test<32>(totalKeys, numLookups)  ||
+        Test<64>(totalKeys, numLookups)  ||
+        Test<120>(totalKeys, numLookups) ||
+        Test<256>(totalKeys, numLookups)
+    ) ? 1 : 0;
+}
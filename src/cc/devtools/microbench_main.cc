@@ -0,0 +1,856 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Hot primitives micro benchmarks: IOBuffer move, copy, and replace,
+// block checksums, Reed-Solomon encode and decode with each vector kernel
+// supported by the cpu, request parser, linear hash, and pool allocator.
+//
+// Timing methodology: each benchmark is run once to warm up caches and
+// calibrate the number of iterations, such that one sample takes at least the
+// minimum sample time, then the given number of samples is taken. The
+// minimum, median, and maximum time per operation over the samples are
+// reported. The median is the value to compare between builds; the spread
+// between min and max indicates the measurement noise. For stable numbers
+// run on an otherwise idle host, with the cpu frequency scaling disabled, and
+// the process pinned to a cpu, for example with taskset.
+// The results are written as JSON to stdout by default.
+//
+//----------------------------------------------------------------------------
+
+#include "kfsio/IOBuffer.h"
+#include "kfsio/checksum.h"
+#include "common/RequestParser.h"
+#include "common/LinearHash.h"
+#include "common/PoolAllocator.h"
+#include "common/IntToString.h"
+#include "qcrs/rs.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace KFS
+{
+using std::cout;
+using std::cerr;
+using std::string;
+using std::vector;
+using std::ostream;
+using std::sort;
+using std::max;
+
+// Sink to prevent the compiler from optimizing away the benchmark loops.
+static volatile uint64_t sSink = 0;
+
+static int64_t
+NowNanoSec()
+{
+    struct timespec theTs;
+    clock_gettime(CLOCK_MONOTONIC, &theTs);
+    return ((int64_t)theTs.tv_sec * 1000 * 1000 * 1000 + theTs.tv_nsec);
+}
+
+class MicroBench
+{
+public:
+    MicroBench(
+        const string& inName,
+        int64_t       inBytesPerOp)
+        : mName(inName),
+          mBytesPerOp(inBytesPerOp)
+        {}
+    virtual ~MicroBench()
+        {}
+    virtual void Run(
+        int64_t inIterations) = 0;
+    const string& GetName() const
+        { return mName; }
+    int64_t GetBytesPerOp() const
+        { return mBytesPerOp; }
+protected:
+    const string  mName;
+    const int64_t mBytesPerOp;
+private:
+    MicroBench(
+        const MicroBench& inBench);
+    MicroBench& operator=(
+        const MicroBench& inBench);
+};
+
+static void
+FillRandom(
+    char*         inPtr,
+    size_t        inLen,
+    unsigned int& ioSeed)
+{
+    for (size_t i = 0; i < inLen; i++) {
+        inPtr[i] = (char)(rand_r(&ioSeed) >> 8);
+    }
+}
+
+static string
+MakeName(
+    const char* inPrefixPtr,
+    int64_t     inSize)
+{
+    string theRet(inPrefixPtr);
+    theRet += '.';
+    if (inSize % (1 << 20) == 0) {
+        AppendDecIntToString(theRet, inSize >> 20);
+        theRet += 'm';
+    } else if (inSize % (1 << 10) == 0) {
+        AppendDecIntToString(theRet, inSize >> 10);
+        theRet += 'k';
+    } else {
+        AppendDecIntToString(theRet, inSize);
+    }
+    return theRet;
+}
+
+//----------------------------------------------------------------------------
+// IOBuffer
+//----------------------------------------------------------------------------
+
+class IOBufferBench : public MicroBench
+{
+public:
+    enum Type
+    {
+        kTypeCopyIn,
+        kTypeCopyOut,
+        kTypeMove,
+        kTypeCopy,
+        kTypeReplace,
+        kTypeReplaceKeepBuffersFull,
+        kTypeConsume
+    };
+
+    IOBufferBench(
+        const char* inNamePtr,
+        Type        inType,
+        int         inSize)
+        : MicroBench(MakeName(inNamePtr, inSize), inSize),
+          mType(inType),
+          mSize(inSize),
+          mData(inSize),
+          mSrc(),
+          mDst()
+    {
+        unsigned int theSeed = 1;
+        FillRandom(&mData[0], mData.size(), theSeed);
+        mSrc.CopyIn(&mData[0], mSize);
+        if (mType == kTypeReplace || mType == kTypeReplaceKeepBuffersFull) {
+            mDst.CopyIn(&mData[0], mSize);
+        }
+    }
+    virtual void Run(
+        int64_t inIterations)
+    {
+        // Replace at unaligned offset, replacing half of the buffer, in order
+        // to exercise buffer split and coalescing.
+        const int theOffset = mSize / 4 + 1;
+        const int theLen    = mSize / 2;
+        for (int64_t i = 0; i < inIterations; i++) {
+            switch (mType) {
+                case kTypeCopyIn:
+                    mDst.CopyIn(&mData[0], mSize);
+                    sSink += mDst.BytesConsumable();
+                    mDst.Clear();
+                    break;
+                case kTypeCopyOut:
+                    sSink += mSrc.CopyOut(&mData[0], mSize);
+                    break;
+                case kTypeMove:
+                    mDst.Move(&mSrc, mSize);
+                    mSrc.Move(&mDst, mSize);
+                    sSink += mSrc.BytesConsumable();
+                    break;
+                case kTypeCopy:
+                    // Shares the buffers, no data copy.
+                    mDst.Copy(&mSrc, mSize);
+                    sSink += mDst.BytesConsumable();
+                    mDst.Clear();
+                    break;
+                case kTypeReplace: {
+                    IOBuffer theTmp;
+                    theTmp.CopyIn(&mData[0], theLen);
+                    mDst.Replace(&theTmp, theOffset, theLen);
+                    sSink += mDst.BytesConsumable();
+                    break;
+                }
+                case kTypeReplaceKeepBuffersFull: {
+                    IOBuffer theTmp;
+                    theTmp.CopyIn(&mData[0], theLen);
+                    mDst.ReplaceKeepBuffersFull(&theTmp, theOffset, theLen);
+                    sSink += mDst.BytesConsumable();
+                    break;
+                }
+                case kTypeConsume:
+                    mDst.Copy(&mSrc, mSize);
+                    while (! mDst.IsEmpty()) {
+                        mDst.Consume(1000);
+                    }
+                    sSink += mDst.BytesConsumable();
+                    break;
+            }
+        }
+    }
+private:
+    const Type   mType;
+    const int    mSize;
+    vector<char> mData;
+    IOBuffer     mSrc;
+    IOBuffer     mDst;
+};
+
+//----------------------------------------------------------------------------
+// Checksums
+//----------------------------------------------------------------------------
+
+class ChecksumBench : public MicroBench
+{
+public:
+    enum Type
+    {
+        kTypeBlock,
+        kTypeCrc32c,
+        kTypeIOBuffer
+    };
+
+    ChecksumBench(
+        const char* inNamePtr,
+        Type        inType,
+        int         inSize)
+        : MicroBench(MakeName(inNamePtr, inSize), inSize),
+          mType(inType),
+          mSize(inSize),
+          mData(inSize),
+          mBuf()
+    {
+        unsigned int theSeed = 2;
+        FillRandom(&mData[0], mData.size(), theSeed);
+        mBuf.CopyIn(&mData[0], mSize);
+    }
+    virtual void Run(
+        int64_t inIterations)
+    {
+        for (int64_t i = 0; i < inIterations; i++) {
+            switch (mType) {
+                case kTypeBlock:
+                    sSink += ComputeBlockChecksum(&mData[0], mSize);
+                    break;
+                case kTypeCrc32c:
+                    sSink += ComputeCrc32c(&mData[0], mSize);
+                    break;
+                case kTypeIOBuffer:
+                    sSink += ComputeChecksums(&mBuf, mSize).size();
+                    break;
+            }
+        }
+    }
+private:
+    const Type   mType;
+    const int    mSize;
+    vector<char> mData;
+    IOBuffer     mBuf;
+};
+
+//----------------------------------------------------------------------------
+// Reed-Solomon
+//----------------------------------------------------------------------------
+
+class RsBench : public MicroBench
+{
+public:
+    enum { kRecoveryStripes = RS_LIB_MAX_RECOVERY_BLOCKS };
+
+    RsBench(
+        const string& inKernel,
+        int           inDataStripes,
+        int           inMissingCount,
+        int           inBlockSize)
+        : MicroBench(MakeName(
+            MakeRsName(inKernel, inMissingCount).c_str(), inBlockSize),
+            (int64_t)inDataStripes * inBlockSize),
+          mKernel(inKernel),
+          mDataStripes(inDataStripes),
+          mMissingCount(inMissingCount),
+          mBlockSize(inBlockSize),
+          mStorage(),
+          mPtrs(inDataStripes + kRecoveryStripes)
+    {
+        // The blocks must be 16 byte aligned.
+        const int theCount = mDataStripes + kRecoveryStripes;
+        mStorage.resize((size_t)theCount * mBlockSize + 16);
+        char* thePtr = &mStorage[0];
+        thePtr += (16 - (size_t)thePtr % 16) % 16;
+        unsigned int theSeed = 3;
+        for (int i = 0; i < theCount; i++) {
+            mPtrs[i] = thePtr + (size_t)i * mBlockSize;
+        }
+        FillRandom(thePtr, (size_t)mDataStripes * mBlockSize, theSeed);
+    }
+    virtual void Run(
+        int64_t inIterations)
+    {
+        // Throughput is reported as the data stripes bytes per op.
+        rs_set_kernel(mKernel.c_str());
+        const int theCount = mDataStripes + kRecoveryStripes;
+        for (int64_t i = 0; i < inIterations; i++) {
+            switch (mMissingCount) {
+                case 1:
+                    rs_decode1(theCount, mBlockSize, 0, &mPtrs[0]);
+                    break;
+                case 2:
+                    rs_decode2(theCount, mBlockSize, 0, 1, &mPtrs[0]);
+                    break;
+                case 3:
+                    rs_decode3(theCount, mBlockSize, 0, 1, 2, &mPtrs[0]);
+                    break;
+                default:
+                    rs_encode(theCount, mBlockSize, &mPtrs[0]);
+                    break;
+            }
+            sSink += *reinterpret_cast<const unsigned char*>(mPtrs[0]);
+        }
+    }
+private:
+    const string  mKernel;
+    const int     mDataStripes;
+    const int     mMissingCount;
+    const int     mBlockSize;
+    vector<char>  mStorage;
+    vector<void*> mPtrs;
+
+    static string MakeRsName(
+        const string& inKernel,
+        int           inMissingCount)
+    {
+        string theRet;
+        if (inMissingCount <= 0) {
+            theRet = "rs.encode.";
+        } else {
+            theRet = "rs.decode";
+            theRet += (char)('0' + inMissingCount);
+            theRet += '.';
+        }
+        return (theRet + inKernel);
+    }
+};
+
+//----------------------------------------------------------------------------
+// Request parser
+//----------------------------------------------------------------------------
+
+class ParserBenchReqBase
+{
+public:
+    int64_t seq;
+
+    ParserBenchReqBase()
+        : seq(-1)
+        {}
+    virtual ~ParserBenchReqBase()
+        {}
+    bool Validate() const
+        { return true; }
+    bool ValidateRequestHeader(
+        const char* /* name */,
+        size_t      /* nameLen */,
+        const char* /* header */,
+        size_t      /* headerLen */,
+        bool        /* hasChecksum */,
+        uint32_t    /* checksum */)
+        { return true; }
+    bool HandleUnknownField(
+        const char* /* key */, size_t /* keyLen */,
+        const char* /* val */, size_t /* valLen */)
+        { return true; }
+    template<typename T> static T& ParserDef(
+        T& inParser)
+    {
+        return inParser
+            .Def("Cseq", &ParserBenchReqBase::seq, int64_t(-1))
+        ;
+    }
+};
+
+class ParserBenchReq : public ParserBenchReqBase
+{
+public:
+    int             vers;
+    StringBufT<64>  host;
+    StringBufT<256> path;
+    int64_t         fid;
+    int64_t         offset;
+    int64_t         reserve;
+    bool            append;
+    int             maxAppenders;
+
+    ParserBenchReq()
+        : ParserBenchReqBase(),
+          vers(-1),
+          host(),
+          path(),
+          fid(-1),
+          offset(-1),
+          reserve(-1),
+          append(false),
+          maxAppenders(64)
+        {}
+    template<typename T> static T& ParserDef(
+        T& inParser)
+    {
+        return ParserBenchReqBase::ParserDef(inParser)
+            .Def("Client-Protocol-Version", &ParserBenchReq::vers, -1)
+            .Def("Client-host",   &ParserBenchReq::host                     )
+            .Def("Pathname",      &ParserBenchReq::path                     )
+            .Def("File-handle",   &ParserBenchReq::fid,          int64_t(-1))
+            .Def("Chunk-offset",  &ParserBenchReq::offset,       int64_t(-1))
+            .Def("Chunk-append",  &ParserBenchReq::append,       false      )
+            .Def("Space-reserve", &ParserBenchReq::reserve,      int64_t(-1))
+            .Def("Max-appenders", &ParserBenchReq::maxAppenders, 64         )
+        ;
+    }
+};
+
+static const char kParserBenchRequest[] =
+    "ALLOCATE\r\n"
+    "Cseq: 1234567\r\n"
+    "Version: KFS/1.0\r\n"
+    "Client-Protocol-Version: 100\r\n"
+    "Client-host: somehostname\r\n"
+    "Pathname: /sort/job/1/fanout/27/file.27\r\n"
+    "File-handle: 12345678\r\n"
+    "Chunk-offset: 0\r\n"
+    "Chunk-append: 1\r\n"
+    "Space-reserve: 0\r\n"
+    "Max-appenders: 640000000\r\n"
+    "\r\n"
+;
+
+class ParserBench : public MicroBench
+{
+public:
+    ParserBench()
+        : MicroBench("requestparser.allocate",
+            sizeof(kParserBenchRequest) - 1),
+          mHandler()
+    {
+        mHandler
+            .MakeParser<ParserBenchReq>("ALLOCATE")
+            .MakeParser<ParserBenchReq>("LOOKUP")
+        ;
+    }
+    virtual void Run(
+        int64_t inIterations)
+    {
+        for (int64_t i = 0; i < inIterations; i++) {
+            ParserBenchReqBase* const thePtr =
+                mHandler.Handle(kParserBenchRequest,
+                    sizeof(kParserBenchRequest) - 1);
+            if (! thePtr) {
+                cerr << "request parse failure\n";
+                abort();
+            }
+            sSink += thePtr->seq;
+            delete thePtr;
+        }
+    }
+private:
+    typedef RequestHandler<ParserBenchReqBase> Handler;
+    Handler mHandler;
+};
+
+//----------------------------------------------------------------------------
+// Linear hash and pool allocator
+//----------------------------------------------------------------------------
+
+template<typename T>
+class PoolStdAllocator
+{
+public:
+    T* allocate(size_t inCount)
+    {
+        if (inCount != 1) {
+            abort();
+        }
+        return reinterpret_cast<T*>(mAlloc.Allocate());
+    }
+    void deallocate(T* inPtr, size_t inCount)
+    {
+        if (inCount != 1) {
+            abort();
+        }
+        mAlloc.Deallocate(inPtr);
+    }
+    static void construct(T* inPtr, const T& inOther)
+        {  new (inPtr) T(inOther); }
+    static void destroy(T* inPtr)
+        { inPtr->~T(); }
+    template <typename TOther>
+    struct rebind {
+        typedef PoolStdAllocator<TOther> other;
+    };
+private:
+    typedef PoolAllocator<
+            sizeof(T),         // size_t TItemSize,
+            size_t(1)   << 20, // size_t TMinStorageAlloc,
+            size_t(128) << 20, // size_t TMaxStorageAlloc,
+            true               // bool   TForceCleanupFlag
+    > Alloc;
+    Alloc mAlloc;
+};
+
+class LinearHashBench : public MicroBench
+{
+public:
+    typedef KVPair<int64_t, int64_t> KVP;
+    typedef LinearHash<
+        KVP,
+        KeyCompare<int64_t>,
+        DynamicArray<SingleLinkedList<KVP>*, 22>,
+        PoolStdAllocator<KVP>
+    > Hash;
+
+    LinearHashBench(
+        bool inFindFlag,
+        int  inSize)
+        : MicroBench(MakeName(inFindFlag ?
+            "linearhash.find" : "linearhash.insert_erase", inSize), 0),
+          mFindFlag(inFindFlag),
+          mKeys(inSize),
+          mHash()
+    {
+        unsigned int theSeed = 4;
+        for (size_t i = 0; i < mKeys.size(); i++) {
+            mKeys[i] = ((int64_t)rand_r(&theSeed) << 31) | rand_r(&theSeed);
+        }
+        if (mFindFlag) {
+            bool theInsertedFlag = false;
+            for (size_t i = 0; i < mKeys.size(); i++) {
+                mHash.Insert(mKeys[i], mKeys[i], theInsertedFlag);
+            }
+        }
+    }
+    // One op is one find, or one insert and one erase.
+    virtual void Run(
+        int64_t inIterations)
+    {
+        const size_t theSize = mKeys.size();
+        size_t       theIdx  = 0;
+        bool         theInsertedFlag = false;
+        for (int64_t i = 0; i < inIterations; i++) {
+            if (mFindFlag) {
+                const int64_t* const thePtr = mHash.Find(mKeys[theIdx]);
+                sSink += thePtr ? *thePtr : 0;
+            } else {
+                mHash.Insert(mKeys[theIdx], mKeys[theIdx], theInsertedFlag);
+                sSink += theInsertedFlag ? 1 : 0;
+            }
+            if (theSize <= ++theIdx) {
+                theIdx = 0;
+                if (! mFindFlag) {
+                    for (size_t k = 0; k < theSize; k++) {
+                        mHash.Erase(mKeys[k]);
+                    }
+                }
+            }
+        }
+        if (! mFindFlag) {
+            mHash.Clear();
+        }
+    }
+private:
+    const bool      mFindFlag;
+    vector<int64_t> mKeys;
+    Hash            mHash;
+};
+
+class PoolAllocatorBench : public MicroBench
+{
+public:
+    enum { kBatchSize = 1024 };
+
+    PoolAllocatorBench()
+        : MicroBench("poolallocator.alloc_free.64", 0),
+          mAlloc(),
+          mPtrs(kBatchSize)
+        {}
+    // One op is one allocate and one deallocate, batched, in order to
+    // exercise the free list and the storage growth.
+    virtual void Run(
+        int64_t inIterations)
+    {
+        for (int64_t i = 0; i < inIterations; ) {
+            const int theCnt = (int)std::min(int64_t(kBatchSize),
+                inIterations - i);
+            for (int k = 0; k < theCnt; k++) {
+                mPtrs[k] = mAlloc.Allocate();
+            }
+            for (int k = theCnt - 1; 0 <= k; k--) {
+                mAlloc.Deallocate(mPtrs[k]);
+            }
+            i += theCnt;
+            sSink += theCnt;
+        }
+    }
+private:
+    typedef PoolAllocator<
+        64,                // size_t TItemSize,
+        size_t(1)  << 20,  // size_t TMinStorageAlloc,
+        size_t(64) << 20,  // size_t TMaxStorageAlloc,
+        false              // bool   TForceCleanupFlag
+    > Alloc;
+    Alloc         mAlloc;
+    vector<char*> mPtrs;
+};
+
+//----------------------------------------------------------------------------
+// Driver
+//----------------------------------------------------------------------------
+
+class MicroBenchRunner
+{
+public:
+    struct Result
+    {
+        string  mName;
+        int64_t mIterations;
+        int64_t mBytesPerOp;
+        double  mMinNs;
+        double  mMedianNs;
+        double  mMaxNs;
+    };
+
+    MicroBenchRunner(
+        int64_t inMinSampleNs,
+        int     inSamples)
+        : mMinSampleNs(inMinSampleNs),
+          mSamples(inSamples)
+        {}
+    Result Run(
+        MicroBench& inBench)
+    {
+        // Warm up and calibrate: double the iterations until the run takes
+        // at least the min sample time.
+        int64_t theIterations = 1;
+        for (; ;) {
+            const int64_t theStart = NowNanoSec();
+            inBench.Run(theIterations);
+            const int64_t theTime = NowNanoSec() - theStart;
+            if (mMinSampleNs <= theTime) {
+                break;
+            }
+            theIterations = theTime * 8 < mMinSampleNs ?
+                theIterations * 8 : theIterations * 2;
+        }
+        vector<double> theTimes;
+        for (int i = 0; i < mSamples; i++) {
+            const int64_t theStart = NowNanoSec();
+            inBench.Run(theIterations);
+            theTimes.push_back(
+                (double)(NowNanoSec() - theStart) / theIterations);
+        }
+        sort(theTimes.begin(), theTimes.end());
+        Result theRet;
+        theRet.mName       = inBench.GetName();
+        theRet.mIterations = theIterations;
+        theRet.mBytesPerOp = inBench.GetBytesPerOp();
+        theRet.mMinNs      = theTimes.front();
+        theRet.mMedianNs   = theTimes[theTimes.size() / 2];
+        theRet.mMaxNs      = theTimes.back();
+        return theRet;
+    }
+private:
+    const int64_t mMinSampleNs;
+    const int     mSamples;
+};
+
+static void
+WriteJson(
+    ostream&                                inStream,
+    const vector<MicroBenchRunner::Result>& inResults,
+    int64_t                                 inMinSampleNs,
+    int                                     inSamples)
+{
+    inStream <<
+        "{\n"
+        "  \"context\": {\n"
+        "    \"checksum_implementation\": \"" <<
+            GetChecksumImplementationName() << "\",\n"
+        "    \"rs_default_kernel\": \"" << rs_get_kernel_name() << "\",\n"
+        "    \"min_sample_ns\": " << inMinSampleNs << ",\n"
+        "    \"samples\": " << inSamples << "\n"
+        "  },\n"
+        "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < inResults.size(); i++) {
+        const MicroBenchRunner::Result& theRes = inResults[i];
+        inStream <<
+            "    {"
+            "\"name\": \"" << theRes.mName << "\", "
+            "\"iterations\": " << theRes.mIterations << ", "
+            "\"ns_per_op_min\": " << theRes.mMinNs << ", "
+            "\"ns_per_op_median\": " << theRes.mMedianNs << ", "
+            "\"ns_per_op_max\": " << theRes.mMaxNs;
+        if (0 < theRes.mBytesPerOp) {
+            inStream <<
+                ", \"bytes_per_op\": " << theRes.mBytesPerOp <<
+                ", \"mb_per_sec_median\": " <<
+                    theRes.mBytesPerOp * 1e3 / theRes.mMedianNs / (1 << 20);
+        }
+        inStream << "}" << (i + 1 < inResults.size() ? "," : "") << "\n";
+    }
+    inStream << "  ]\n}\n";
+}
+
+static void
+WriteText(
+    ostream&                                inStream,
+    const vector<MicroBenchRunner::Result>& inResults)
+{
+    for (size_t i = 0; i < inResults.size(); i++) {
+        const MicroBenchRunner::Result& theRes = inResults[i];
+        inStream << theRes.mName <<
+            " ns/op: " << theRes.mMedianNs <<
+            " [" << theRes.mMinNs << " " << theRes.mMaxNs << "]";
+        if (0 < theRes.mBytesPerOp) {
+            inStream << " MB/sec: " <<
+                theRes.mBytesPerOp * 1e3 / theRes.mMedianNs / (1 << 20);
+        }
+        inStream << "\n";
+    }
+}
+
+static int
+MicroBenchMain(
+    int    inArgCount,
+    char** inArgsPtr)
+{
+    int         theOpt;
+    bool        theHelpFlag   = false;
+    bool        theTextFlag   = false;
+    bool        theListFlag   = false;
+    const char* theFilterPtr  = 0;
+    double      theMinSampleMs = 100;
+    int         theSamples     = 7;
+    while ((theOpt = getopt(inArgCount, inArgsPtr, "f:t:r:Tlh")) != -1) {
+        switch (theOpt) {
+            case 'f': theFilterPtr   = optarg;       break;
+            case 't': theMinSampleMs = atof(optarg); break;
+            case 'r': theSamples     = atoi(optarg); break;
+            case 'T': theTextFlag    = true;         break;
+            case 'l': theListFlag    = true;         break;
+            default:  theHelpFlag    = true;         break;
+        }
+    }
+    if (theHelpFlag || theSamples <= 0 || theMinSampleMs <= 0) {
+        cerr << "Usage: " << inArgsPtr[0] <<
+            " [-f <name substring>] [-t <min sample ms>] [-r <samples>]"
+            " [-T] [-l]\n"
+            " -f: run only benchmarks with the name containing the substring\n"
+            " -t: min sample time, default 100 ms\n"
+            " -r: number of samples, default 7\n"
+            " -T: text output, default is JSON\n"
+            " -l: list benchmarks\n";
+        return 1;
+    }
+    vector<MicroBench*> theBenchs;
+    static const int kIOBufferSizes[] = { 4 << 10, 64 << 10, 1 << 20 };
+    for (size_t i = 0;
+            i < sizeof(kIOBufferSizes) / sizeof(kIOBufferSizes[0]);
+            i++) {
+        const int theSize = kIOBufferSizes[i];
+        theBenchs.push_back(new IOBufferBench("iobuffer.copyin",
+            IOBufferBench::kTypeCopyIn, theSize));
+        theBenchs.push_back(new IOBufferBench("iobuffer.copyout",
+            IOBufferBench::kTypeCopyOut, theSize));
+        theBenchs.push_back(new IOBufferBench("iobuffer.move",
+            IOBufferBench::kTypeMove, theSize));
+        theBenchs.push_back(new IOBufferBench("iobuffer.copy",
+            IOBufferBench::kTypeCopy, theSize));
+        theBenchs.push_back(new IOBufferBench("iobuffer.replace",
+            IOBufferBench::kTypeReplace, theSize));
+        theBenchs.push_back(new IOBufferBench("iobuffer.replacekeepfull",
+            IOBufferBench::kTypeReplaceKeepBuffersFull, theSize));
+        theBenchs.push_back(new IOBufferBench("iobuffer.consume",
+            IOBufferBench::kTypeConsume, theSize));
+    }
+    theBenchs.push_back(new ChecksumBench("checksum.block",
+        ChecksumBench::kTypeBlock, (int)CHECKSUM_BLOCKSIZE));
+    theBenchs.push_back(new ChecksumBench("checksum.crc32c",
+        ChecksumBench::kTypeCrc32c, (int)CHECKSUM_BLOCKSIZE));
+    theBenchs.push_back(new ChecksumBench("checksum.iobuffer",
+        ChecksumBench::kTypeIOBuffer, 1 << 20));
+    const char* theKernelPtr;
+    for (int k = 0; (theKernelPtr = rs_get_supported_kernel_name(k)); k++) {
+        for (int m = 0; m <= RsBench::kRecoveryStripes; m++) {
+            theBenchs.push_back(new RsBench(theKernelPtr, 6, m, 64 << 10));
+        }
+    }
+    theBenchs.push_back(new ParserBench());
+    theBenchs.push_back(new LinearHashBench(false, 1 << 16));
+    theBenchs.push_back(new LinearHashBench(true,  1 << 20));
+    theBenchs.push_back(new PoolAllocatorBench());
+
+    const int64_t theMinSampleNs = (int64_t)(theMinSampleMs * 1e6);
+    MicroBenchRunner                 theRunner(theMinSampleNs, theSamples);
+    vector<MicroBenchRunner::Result> theResults;
+    for (size_t i = 0; i < theBenchs.size(); i++) {
+        MicroBench& theBench = *theBenchs[i];
+        if (theFilterPtr &&
+                theBench.GetName().find(theFilterPtr) == string::npos) {
+            continue;
+        }
+        if (theListFlag) {
+            cout << theBench.GetName() << "\n";
+            continue;
+        }
+        theResults.push_back(theRunner.Run(theBench));
+        if (theTextFlag) {
+            WriteText(cout, vector<MicroBenchRunner::Result>(
+                1, theResults.back()));
+            cout.flush();
+        }
+    }
+    if (! theListFlag && ! theTextFlag) {
+        WriteJson(cout, theResults, theMinSampleNs, theSamples);
+    }
+    for (size_t i = 0; i < theBenchs.size(); i++) {
+        delete theBenchs[i];
+    }
+    return (0 < sSink ? 0 : 0);
+}
+
+} // namespace KFS
+
+int
+main(int argc, char** argv)
+{
+    return KFS::MicroBenchMain(argc, argv);
+}
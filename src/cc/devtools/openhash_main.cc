@@ -0,0 +1,226 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Open addressing hash table unit tests, and performance comparison
+// with the linear hash table.
+//
+//----------------------------------------------------------------------------
+
+#include "common/OpenHash.h"
+#include "common/LinearHash.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <iostream>
+#include <set>
+
+typedef int64_t                    MyKey;
+typedef KFS::KVPair<MyKey, MyKey>  MyKVPair;
+typedef KFS::OpenHash<MyKVPair>    MyOH;
+typedef KFS::LinearHash<MyKVPair>  MyLH;
+
+using namespace std;
+typedef set<MyKey> MySet;
+
+static void
+TestFailed(int line)
+{
+    cerr << "test failed: line: " << line << "\n";
+    abort();
+}
+
+#define OH_TEST(cond) if (! (cond)) { TestFailed(__LINE__); }
+
+static void
+Verify(const MySet& set, MyOH& ht)
+{
+    OH_TEST(set.size() == ht.GetSize());
+    for (MySet::const_iterator it = set.begin(); it != set.end(); ++it) {
+        const MyKey* const p = ht.Find(*it);
+        OH_TEST(p && *p == *it + 1);
+    }
+    // Each entry must be returned by the iteration exactly once, including
+    // while the incremental re-hash is in progress.
+    MySet seen;
+    ht.First();
+    for (const MyKVPair* p; (p = ht.Next()); ) {
+        OH_TEST(set.find(p->GetKey()) != set.end() &&
+            seen.insert(p->GetKey()).second);
+    }
+    OH_TEST(seen.size() == set.size());
+}
+
+static void
+UnitTest()
+{
+    MyOH ht;
+    bool inserted = false;
+    OH_TEST(ht.IsEmpty() && ! ht.Find(1) && ht.Erase(1) == 0);
+    OH_TEST(*ht.Insert(500, 501, inserted) == 501 && inserted);
+    OH_TEST(*ht.Insert(100, 101, inserted) == 101 && inserted);
+    OH_TEST(*ht.Insert(500, 0, inserted) == 501 && ! inserted);
+    OH_TEST(! ht.Find(3) && ht.GetSize() == 2);
+    OH_TEST(ht.Erase(500) == 1 && ht.Erase(500) == 0 && ! ht.Find(500));
+    OH_TEST(*ht.Find(100) == 101);
+    ht.Clear();
+    OH_TEST(ht.IsEmpty() && ! ht.Find(100));
+
+    // Random insert and erase, verified against the set, with the table
+    // growing through multiple incremental re-hashes.
+    MySet              myset;
+    const int          kRandTestSize = 100 * 1000;
+    const unsigned int kSeed         = 10;
+    srandom(kSeed);
+    for (int i = 0; i < kRandTestSize; i++) {
+        const MyKey r = (MyKey)(random() % (kRandTestSize * 4));
+        inserted = false;
+        OH_TEST(*ht.Insert(r, r + 1, inserted) == r + 1);
+        OH_TEST(myset.insert(r).second == inserted);
+        if (i % 9973 == 0) {
+            Verify(myset, ht);
+        }
+    }
+    Verify(myset, ht);
+    cout << "inserted: " << ht.GetSize() << " of " << kRandTestSize << "\n";
+
+    srandom(kSeed);
+    for (int i = 0; i < kRandTestSize; i++) {
+        const MyKey r = (MyKey)(random() % (kRandTestSize * 4));
+        if (i % 3 != 0) {
+            continue;
+        }
+        const size_t rht = ht.Erase(r);
+        OH_TEST(rht == myset.erase(r) && ! ht.Find(r));
+    }
+    Verify(myset, ht);
+    cout << "removed: size: " << ht.GetSize() <<
+        " of " << kRandTestSize << "\n";
+
+    // Re-insert into the slots marked deleted.
+    for (int i = 0; i < kRandTestSize; i++) {
+        const MyKey r = (MyKey)(random() % (kRandTestSize * 4));
+        OH_TEST(*ht.Insert(r, r + 1, inserted) == r + 1);
+        OH_TEST(myset.insert(r).second == inserted);
+    }
+    Verify(myset, ht);
+
+    // Copy and swap.
+    MyOH copy(ht);
+    Verify(myset, copy);
+    MyOH other;
+    other.Swap(copy);
+    OH_TEST(copy.IsEmpty());
+    Verify(myset, other);
+
+    // Erase while iterating: erase every other entry.
+    ht.First();
+    size_t k = 0;
+    for (const MyKVPair* p; (p = ht.Next()); k++) {
+        if ((k & 1) == 0) {
+            const MyKey key = p->GetKey();
+            OH_TEST(ht.Erase(key) == 1 && myset.erase(key) == 1);
+        }
+    }
+    Verify(myset, ht);
+    cout << "erased while iterating: size: " << ht.GetSize() << "\n";
+
+    // Erase all with iteration.
+    ht.First();
+    for (const MyKVPair* p; (p = ht.Next()); ) {
+        OH_TEST(ht.Erase(p->GetKey()) == 1);
+    }
+    OH_TEST(ht.IsEmpty());
+    ht.First();
+    OH_TEST(! ht.Next());
+}
+
+template<typename T>
+static void
+PerfTest(const char* name, int count)
+{
+    T       ht;
+    bool    inserted = false;
+    clock_t s        = clock();
+    int     k        = 0;
+    for (MyKey i = 1000 * 1000 + 345; k < count; i += 33, k++) {
+        if (! ht.Insert(i, i, inserted) || ! inserted) {
+            TestFailed(__LINE__);
+        }
+    }
+    clock_t e = clock();
+    cout << name << ": insert: " << k << " " <<
+        double(e - s) / CLOCKS_PER_SEC << "\n";
+    s = clock();
+    k = 0;
+    for (MyKey i = 1000 * 1000 + 345; k < count; i += 33, k++) {
+        if (! ht.Find(i)) {
+            TestFailed(__LINE__);
+        }
+    }
+    e = clock();
+    cout << name << ": find: " << k << " " <<
+        double(e - s) / CLOCKS_PER_SEC << "\n";
+    s = clock();
+    k = 0;
+    ht.First();
+    int64_t t = 0;
+    for (const MyKVPair* p; (p = ht.Next()); k++) {
+        t += p->GetKey();
+    }
+    e = clock();
+    cout << name << ": iterate: " << k << " " <<
+        double(e - s) / CLOCKS_PER_SEC << " " << t << "\n";
+    s = clock();
+    k = 0;
+    for (MyKey i = 1000 * 1000 + 345; k < count; i += 33, k++) {
+        if (ht.Erase(i) != 1) {
+            TestFailed(__LINE__);
+        }
+    }
+    e = clock();
+    cout << name << ": erase: " << k << " " <<
+        double(e - s) / CLOCKS_PER_SEC << "\n";
+    if (! ht.IsEmpty()) {
+        TestFailed(__LINE__);
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    if (1 < argc && (! strcmp(argv[1], "-h") || ! strcmp(argv[1], "--help"))) {
+        cout << "Usage: " << argv[0] << " [performance test size]\n"
+            "Runs unit tests, and open addressing and linear hash tables"
+            " performance test.\n"
+            "Default performance test size is 1048576.\n";
+        return 0;
+    }
+    UnitTest();
+    const int count = 1 < argc ? (int)atof(argv[1]) : (1 << 20);
+    if (0 < count) {
+        PerfTest<MyOH>("open hash", count);
+        PerfTest<MyLH>("linear hash", count);
+    }
+    return 0;
+}
@@ -25,12 +25,14 @@
 
 #include "common/RequestParser.h"
 #include "common/Properties.h"
+#include "common/time.h"
 
 #include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
 
 using namespace KFS;
+using std::max;
 
 class AbstractTest
 {
@@ -202,6 +204,8 @@ Max-appenders: 640000000\r
 /*
     To benchmark:
     ../src/test-scripts/allocatesend.pl 1e6 | ( time src/cc/devtools/requestparser_test q )
+    or, to compare header parser with properties parser without input:
+    src/cc/devtools/requestparser b [iterations]
 */
 
 typedef RequestHandler<AbstractTest> ReqHandler;
@@ -215,12 +219,61 @@ static const ReqHandler& MakeRequestHandler()
 }
 static const ReqHandler& sReqHandler = MakeRequestHandler();
 
+static int
+Bench(int argc, char** argv)
+{
+    static const char kRequest[] =
+        "ALLOCATE\r\n"
+        "Cseq: 1234567\r\n"
+        "Version: KFS/1.0\r\n"
+        "Client-Protocol-Version: 100\r\n"
+        "Client-host: somehostname\r\n"
+        "Pathname: /sort/job/1/fanout/27/file.27\r\n"
+        "File-handle: 12345678\r\n"
+        "Chunk-offset: 0\r\n"
+        "Chunk-append: 1\r\n"
+        "Space-reserve: 0\r\n"
+        "Max-appenders: 640000000\r\n"
+        "\r\n"
+    ;
+    const size_t  kLen  = sizeof(kRequest) - 1;
+    const int64_t count = 2 < argc ? (int64_t)atof(argv[2]) : int64_t(1e6);
+    BufferInputStream myis;
+    int64_t       sum   = 0;
+    for (int k = 0; k < 2; k++) {
+        const bool    useprop = k != 0;
+        const int64_t start   = microseconds();
+        for (int64_t i = 0; i < count; i++) {
+            AbstractTest* const tst = useprop ?
+                Test::Load(myis.Set(kRequest, kLen)) :
+                sReqHandler.Handle(kRequest, kLen);
+            if (! tst) {
+                std::cout << "parse failure\n";
+                return 1;
+            }
+            sum += tst->seq;
+            delete tst;
+        }
+        const int64_t usec = max(int64_t(1), microseconds() - start);
+        std::cout << (useprop ? "properties" : "request parser") <<
+            ": requests: "     << count <<
+            " usec: "          << usec <<
+            " nsec/request: "  << usec * 1000 / max(int64_t(1), count) <<
+            " requests/sec: "  << count * 1000000 / usec <<
+        "\n";
+    }
+    return (sum == 2 * count * 1234567 ? 0 : 1);
+}
+
 int
 main(int argc, char** argv)
 {
     if (argc <= 1 || (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
         return 0;
     }
+    if (strchr(argv[1], 'b')) {
+        return Bench(argc, argv);
+    }
 
     static char buf[1 << 20];
     char* ptr = buf;
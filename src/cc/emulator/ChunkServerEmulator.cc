@@ -42,7 +42,7 @@ ChunkServerEmulator::ChunkServerEmulator(
       ChunkServer(NetConnectionPtr(
         new NetConnection(this, this, false, false)), peerName),
       mPendingReqs(),
-      mOut(0)
+      mRecordPlanFlag(false)
 {
     SetServerLocation(loc);
     SetRack(rack);
@@ -79,15 +79,19 @@ ChunkServerEmulator::Dispatch()
         }
         if (r->op == META_CHUNK_REPLICATE) {
             MetaChunkReplicate* const mcr = static_cast<MetaChunkReplicate*>(r);
+            // The completion resets the source, compute the move priority
+            // prior to the completion.
+            const int64_t priority = mRecordPlanFlag ?
+                gLayoutEmulator.GetMovePriority(*mcr) : int64_t(0);
             if (gLayoutEmulator.ChunkReplicationDone(mcr)) {
                 KFS_LOG_STREAM_DEBUG <<
                     "moved chunk: " << mcr->chunkId <<
                     " to " << mcr->server->GetServerLocation() <<
                 KFS_LOG_EOM;
-                if (mOut) {
-                    (*mOut) <<
-                        mcr->chunkId << " " << mcr->server->GetServerLocation() <<
-                    "\n";
+                if (mRecordPlanFlag) {
+                    gLayoutEmulator.AddToRebalancePlan(
+                        mcr->chunkId, mcr->server->GetServerLocation(),
+                        priority);
                 }
             }
         } else if (r->op == META_CHUNK_DELETE) {
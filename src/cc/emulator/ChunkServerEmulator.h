@@ -57,9 +57,9 @@ public:
         mUsedSpace += chunksize;
         mAllocSpace = mUsedSpace;
     }
-    void SetRebalancePlanOutFd(ostream* os)
+    void SetRecordRebalancePlan(bool flag)
     {
-        mOut = os;
+        mRecordPlanFlag = flag;
     }
     void InitSpace(int64_t totalSpace, int64_t usedSpace,
             bool useFsTotalSpaceFlag)
@@ -85,7 +85,7 @@ protected:
 private:
     typedef vector<MetaChunkRequest*> PendingReqs;
     PendingReqs mPendingReqs;
-    ostream*    mOut;
+    bool        mRecordPlanFlag;
 private:
     ChunkServerEmulator(const ChunkServerEmulator&);
     ChunkServerEmulator& operator=(const ChunkServerEmulator&);
@@ -51,6 +51,8 @@ using std::string;
 using std::ifstream;
 using std::for_each;
 using std::ofstream;
+using std::sort;
+using std::stable_sort;
 using boost::bind;
 
 static inline ChunkServerEmulator&
@@ -281,17 +283,17 @@ LayoutEmulator::GetChunkSize(const CSMap::Entry& ci) const
     }
     const int        chunkStripeIdx = (int)(pos / (chunkOff_t)CHUNKSIZE %
         (fa->numStripes + fa->numRecoveryStripes));
-    const chunkOff_t strideSize     = fa->stripeSize * fa->numStripes;
+    const chunkOff_t strideSize     = fa->stripeSize() * fa->numStripes;
     const chunkOff_t strideCount    = size / strideSize;
     const chunkOff_t strideHead     = size % strideSize;
-    const chunkOff_t stripeIdx      = strideHead / fa->stripeSize;
+    const chunkOff_t stripeIdx      = strideHead / fa->stripeSize();
     const int        idx            =
             chunkStripeIdx < (int)fa->numStripes ? chunkStripeIdx : 0;
-    chunkOff_t       chunkSize      = strideCount * fa->stripeSize;
+    chunkOff_t       chunkSize      = strideCount * fa->stripeSize();
     if (idx < stripeIdx) {
-        chunkSize += fa->stripeSize;
+        chunkSize += fa->stripeSize();
     } else if (idx == stripeIdx) {
-        chunkSize += strideHead % fa->stripeSize;
+        chunkSize += strideHead % fa->stripeSize();
     }
     return (size_t)chunkSize;
 }
@@ -351,8 +353,78 @@ LayoutEmulator::SetRebalancePlanOutFile(const string &rebalancePlanFn)
     for (Servers::iterator i = mChunkServers.begin();
             i != mChunkServers.end();
             i++) {
-        GetCSEmulator(**i).SetRebalancePlanOutFd(&mPlanFile);
+        GetCSEmulator(**i).SetRecordRebalancePlan(true);
     }
+    mPlan.clear();
+    return 0;
+}
+
+int
+LayoutEmulator::SetPlacementReportOutFile(const string& reportFn)
+{
+    mReportFile.close();
+    mReportFile.open(reportFn.c_str(), ofstream::out);
+    if (! mReportFile) {
+        const int err = errno;
+        KFS_LOG_STREAM_ERROR << reportFn << ": " << strerror(err) <<
+        KFS_LOG_EOM;
+        return -1;
+    }
+    mReportFile <<
+        "#problem\treason\tchunk\tpos\tsize\tblock\tfile\ttype"
+        "\tnode\track\treplicas\tactual\tpath\n"
+        "#summary\tname\tvalue\n"
+    ;
+    return 0;
+}
+
+void
+LayoutEmulator::AddToRebalancePlan(chunkId_t chunkId,
+    const ServerLocation& loc, int64_t priority)
+{
+    mPlan.push_back(PlanEntry(chunkId, loc, priority));
+}
+
+int64_t
+LayoutEmulator::GetMovePriority(const MetaChunkReplicate& req) const
+{
+    // Priority is the space utilization difference between the source and
+    // destination in parts per million at the time of the move. Moves off
+    // the most over utilized servers onto the least utilized ones have the
+    // highest priority.
+    int64_t priority = 0;
+    if (req.dataServer) {
+        priority = (int64_t)(1e6 * (
+            req.dataServer->GetSpaceUtilization(mUseFsTotalSpaceFlag) -
+            req.server->GetSpaceUtilization(mUseFsTotalSpaceFlag)));
+    }
+    return max(int64_t(0), priority);
+}
+
+int
+LayoutEmulator::WriteRebalancePlan()
+{
+    // Stable sort preserves the planning order of the moves with the same
+    // priority.
+    stable_sort(mPlan.begin(), mPlan.end());
+    for (Plan::const_iterator it = mPlan.begin();
+            it != mPlan.end() && mPlanFile;
+            ++it) {
+        mPlanFile <<
+            it->mChunkId << " " << it->mLocation << " " << it->mPriority <<
+        "\n";
+    }
+    mPlanFile.flush();
+    if (! mPlanFile) {
+        const int err = errno;
+        KFS_LOG_STREAM_ERROR << "re-balance plan write failure: " <<
+            strerror(err) <<
+        KFS_LOG_EOM;
+        return -1;
+    }
+    KFS_LOG_STREAM_INFO << "re-balance plan moves: " << mPlan.size() <<
+    KFS_LOG_EOM;
+    mPlan.clear();
     return 0;
 }
 
@@ -641,6 +713,20 @@ public:
         ;
         return os;
     }
+    ostream& reportRecords(ostream& os, size_t chunkCount)
+    {
+        os <<
+        "summary\tchunks\t"           << chunkCount      << "\n"
+        "summary\tmissing\t"          << missing         << "\n"
+        "summary\tsame-rack\t"        << sameRack        << "\n"
+        "summary\tunder-replicated\t" << underReplicated << "\n"
+        "summary\tover-replicated\t"  << overReplicated  << "\n"
+        "summary\tsame-node\t"        << sameNode        << "\n"
+        "summary\tstripe-same-node\t" << stripeSameNode  << "\n"
+        "summary\thealthy\t"          << (IsHealthy() ? 1 : 0) << "\n"
+        ;
+        return os;
+    }
     bool IsHealthy() const
         { return (missing <= 0); }
 };
@@ -677,6 +763,15 @@ operator<<(ostream& os, const DisplayFileType& d) {
     return d.Display(os);
 }
 
+inline const char*
+TrimReason(const char* reason)
+{
+    while (*reason == ' ') {
+        ++reason;
+    }
+    return reason;
+}
+
 void
 LayoutEmulator::ShowPlacementError(
     ostream&            os,
@@ -684,10 +779,31 @@ LayoutEmulator::ShowPlacementError(
     const ChunkServer*  srv,
     string&             fileName,
     size_t              replicas,
-    const char*         reason)
+    const char*         reason,
+    bool                showFlag)
 {
     const MetaFattr* const fa  = c.GetFattr();
     const chunkOff_t       pos = c.GetChunkInfo()->offset;
+    if (mReportFile.is_open()) {
+        mReportFile <<
+            "problem"                                       << "\t" <<
+            TrimReason(reason)                              << "\t" <<
+            c.GetChunkId()                                  << "\t" <<
+            pos                                             << "\t" <<
+            GetChunkSize(c)                                 << "\t" <<
+            fa->ChunkPosToChunkBlkIndex(pos)                << "\t" <<
+            c.GetFileId()                                   << "\t" <<
+            DisplayFileType(fa)                             << "\t" <<
+            (srv ? srv->GetServerLocation() : ServerLocation()) << "\t" <<
+            (srv ? srv->GetRack() : -1)                     << "\t" <<
+            fa->numReplicas                                 << "\t" <<
+            replicas                                        << "\t" <<
+            GetFileName(fa, fileName)                       <<
+        "\n";
+    }
+    if (! showFlag) {
+        return;
+    }
     os <<
         reason <<
         " chunk: "    << c.GetChunkId() <<
@@ -719,10 +835,8 @@ LayoutEmulator::VerifyPlacement(
     string                 fileName;
 
     if (servers.empty()) {
-        if (verboseFlag) {
-            ShowPlacementError(os, c, 0, fileName, servers.size(),
-                "no replicas");
-        }
+        ShowPlacementError(os, c, 0, fileName, servers.size(),
+            "no replicas", verboseFlag);
         verifier.missing++;
         return;
     }
@@ -736,24 +850,20 @@ LayoutEmulator::VerifyPlacement(
                         servers.end()) {
                 verifier.sameNode++;
                 ShowPlacementError(os, c, &srv, fileName, servers.size(),
-                    "duplicate server");
+                    "duplicate server", true);
             } else if (reportAllFlag ||
                     placement.GetExcludedServersCount() <
                     mChunkServers.size()) {
                 verifier.stripeSameNode++;
-                if (verboseFlag) {
-                    ShowPlacementError(os, c, &srv, fileName, servers.size(),
-                        "same node");
-                }
+                ShowPlacementError(os, c, &srv, fileName, servers.size(),
+                    "same node", verboseFlag);
             }
             placement.ExcludeServerAndRack(srv, c.GetChunkId());
         } else if (! placement.ExcludeServerAndRack(srv, c.GetChunkId()) &&
                 (reportAllFlag || placement.HasCandidateRacks())) {
             verifier.sameRack++;
-            if (verboseFlag) {
-                ShowPlacementError(os, c, &srv, fileName, servers.size(),
-                    "same rack");
-            }
+            ShowPlacementError(os, c, &srv, fileName, servers.size(),
+                "same rack", verboseFlag);
         }
     }
     if (! servers.empty() &&
@@ -765,11 +875,9 @@ LayoutEmulator::VerifyPlacement(
         } else {
             verifier.overReplicated++;
         }
-        if (verboseFlag) {
-            ShowPlacementError(os, c, 0, fileName, servers.size(),
-                (underReplicatedFlag ? " under replicated" :
-                    " over replicated"));
-        }
+        ShowPlacementError(os, c, 0, fileName, servers.size(),
+            (underReplicatedFlag ? " under replicated" :
+                " over replicated"), verboseFlag);
     }
 }
 
@@ -802,6 +910,15 @@ LayoutEmulator::VerifyRackAwareReplication(
             os, verboseFlag, reportAllFlag, verifier);
     }
     verifier.report(os, mChunkToServerMap.Size());
+    if (mReportFile.is_open()) {
+        verifier.reportRecords(mReportFile, mChunkToServerMap.Size());
+        mReportFile.flush();
+        if (! mReportFile) {
+            KFS_LOG_STREAM_ERROR << "placement report write failure" <<
+            KFS_LOG_EOM;
+            return 1;
+        }
+    }
     return (verifier.IsHealthy() ? 0 : 1);
 }
 
@@ -920,6 +1037,190 @@ LayoutEmulator::RunFsck(
     return err;
 }
 
+static void
+ShowLatencies(
+    ostream&         os,
+    const char*      name,
+    vector<int64_t>& latencies,
+    int64_t          totalTime)
+{
+    sort(latencies.begin(), latencies.end());
+    const size_t cnt = latencies.size();
+    os << name <<
+        ": count: "     << cnt <<
+        " time: "       << totalTime * 1e-6 << " sec." <<
+        " rate: "       << (cnt * 1e6 / max(int64_t(1), totalTime)) <<
+            " per sec.";
+    if (0 < cnt) {
+        os <<
+        " latency usec.:"
+        " p50: "  << latencies[cnt / 2] <<
+        " p90: "  << latencies[cnt * 9 / 10] <<
+        " p99: "  << latencies[cnt * 99 / 100] <<
+        " max: "  << latencies.back();
+    }
+    os << "\n";
+}
+
+void
+LayoutEmulator::BenchmarkPlacement(
+    size_t count, int numReplicas, ostream& os)
+{
+    // Allocation burst: the same candidate selection as chunk allocation,
+    // with one replica per rack, while racks are available.
+    PrepareRebalance(false);
+    StTmp<ChunkPlacement> placementTmp(mChunkPlacementTmp);
+    ChunkPlacement&       placement = placementTmp.Get();
+    vector<int64_t>       latencies;
+    latencies.reserve(count);
+    size_t                replicasCount = 0;
+    size_t                failedCount   = 0;
+    const int64_t         start         = microseconds();
+    for (size_t i = 0; i < count && ! mStopFlag; i++) {
+        const int64_t t   = microseconds();
+        int           cnt = 0;
+        placement.clear();
+        placement.FindCandidates(kKfsSTierMin, kKfsSTierMax);
+        for (; ;) {
+            const ChunkServerPtr srv = placement.GetNext(false);
+            if (srv) {
+                placement.ExcludeServerAndRack(srv);
+                if (numReplicas <= ++cnt) {
+                    break;
+                }
+            }
+            if (placement.IsLastAttempt() || ! placement.NextRack()) {
+                break;
+            }
+        }
+        latencies.push_back(microseconds() - t);
+        replicasCount += cnt;
+        if (cnt < numReplicas) {
+            failedCount++;
+        }
+    }
+    ShowLatencies(os, "placement", latencies, microseconds() - start);
+    os << "placement: replicas: " << replicasCount <<
+        " incomplete: " << failedCount << "\n";
+}
+
+void
+LayoutEmulator::RunReplication(const char* name, ostream& os)
+{
+    PrepareRebalance(false);
+    const int     startDone   = mNumBlksRebalanced;
+    const int64_t start       = microseconds();
+    int64_t       checkerTime = 0;
+    int64_t       opsTime     = 0;
+    size_t        rounds      = 0;
+    for (; ;) {
+        if (mCleanupScheduledFlag) {
+            ScheduleCleanup();
+        }
+        int64_t t = microseconds();
+        ChunkReplicationChecker();
+        const int64_t now = microseconds();
+        checkerTime += now - t;
+        t = now;
+        const size_t opsCount = RunChunkserverOps();
+        opsTime += microseconds() - t;
+        rounds++;
+        if (mStopFlag || mChunkServers.empty() ||
+                (opsCount <= 0 &&
+                ! mCleanupScheduledFlag &&
+                ! mChunkToServerMap.Front(
+                    CSMap::Entry::kStateCheckReplicationUrgent) &&
+                ! mChunkToServerMap.Front(
+                    CSMap::Entry::kStateCheckReplication))) {
+            break;
+        }
+    }
+    const int64_t totalTime = microseconds() - start;
+    const int     done      = mNumBlksRebalanced - startDone;
+    os << name <<
+        ": replications: "      << done <<
+        " rounds: "             << rounds <<
+        " time: "               << totalTime * 1e-6 << " sec."
+        " scheduling: "         << checkerTime * 1e-6 << " sec."
+        " ops: "                << opsTime * 1e-6 << " sec."
+        " scheduling rate: "    <<
+            (done * 1e6 / max(int64_t(1), checkerTime)) << " per sec."
+        " pending replication: " <<
+            mChunkToServerMap.GetCount(
+                CSMap::Entry::kStatePendingReplication) <<
+        " no destination: "      <<
+            mChunkToServerMap.GetCount(
+                CSMap::Entry::kStateNoDestination) <<
+    "\n";
+}
+
+void
+LayoutEmulator::BenchmarkRackFailure(int rack, ostream& os)
+{
+    RackInfos::const_iterator it = mRacks.begin();
+    if (0 <= rack) {
+        while (it != mRacks.end() && it->id() != rack) {
+            ++it;
+        }
+    }
+    if (it == mRacks.end()) {
+        os << "rack failure: no such rack: " << rack << "\n";
+        return;
+    }
+    rack = it->id();
+    vector<ServerLocation> locs;
+    const Servers& servers = it->getServers();
+    for (Servers::const_iterator si = servers.begin();
+            si != servers.end();
+            ++si) {
+        locs.push_back((*si)->GetServerLocation());
+    }
+    vector<int64_t> latencies;
+    latencies.reserve(locs.size());
+    const int64_t start = microseconds();
+    for (vector<ServerLocation>::const_iterator li = locs.begin();
+            li != locs.end();
+            ++li) {
+        const int64_t t = microseconds();
+        MarkServerDown(*li);
+        latencies.push_back(microseconds() - t);
+    }
+    os << "rack failure: rack: " << rack << "\n";
+    ShowLatencies(os, "server down", latencies, microseconds() - start);
+    RunReplication("rack failure recovery", os);
+}
+
+void
+LayoutEmulator::BenchmarkRetire(size_t count, ostream& os)
+{
+    mAllowChunkServerRetireFlag = true;
+    vector<int64_t> latencies;
+    Servers         retiring;
+    const int64_t   start = microseconds();
+    for (Servers::const_iterator it = mChunkServers.begin();
+            it != mChunkServers.end() && retiring.size() < count;
+            ++it) {
+        if ((*it)->IsRetiring() || (*it)->GetNumChunks() <= 0) {
+            continue;
+        }
+        const int64_t t = microseconds();
+        if (RetireServer((*it)->GetServerLocation(), 0) == 0) {
+            latencies.push_back(microseconds() - t);
+            retiring.push_back(*it);
+        }
+    }
+    ShowLatencies(os, "retire", latencies, microseconds() - start);
+    RunReplication("retire evacuation", os);
+    size_t remaining = 0;
+    for (Servers::const_iterator it = retiring.begin();
+            it != retiring.end();
+            ++it) {
+        remaining += (*it)->GetNumChunks();
+    }
+    os << "retire: servers: " << retiring.size() <<
+        " chunks remaining: " << remaining << "\n";
+}
+
 LayoutEmulator gLayoutEmulator;
 LayoutManager& gLayoutManager = gLayoutEmulator;
 const UserAndGroup& MetaUserAndGroup::sUserAndGroup =
@@ -51,6 +51,8 @@ public:
           mNumBlksRebalanced(0),
           mStopFlag(false),
           mPlanFile(),
+          mReportFile(),
+          mPlan(),
           mLoc2Server()
     {
         SetMinChunkserversToExitRecovery(0);
@@ -59,6 +61,7 @@ public:
     ~LayoutEmulator()
     {
         mPlanFile.close();
+        mReportFile.close();
     }
     // Given a chunk->location data in a file, rebuild the chunk->location map.
     //
@@ -73,6 +76,15 @@ public:
             min(1., max(0., utilizationPercentVariationFromMean * 1e-2));
     }
     int SetRebalancePlanOutFile(const string& rebalancePlanFn);
+    // Write placement problems found by VerifyRackAwareReplication() into the
+    // file as tab separated records, followed by the summary records.
+    int SetPlacementReportOutFile(const string& reportFn);
+    // Record chunk move, the plan is written by WriteRebalancePlan() ordered
+    // by the move priority, the most valuable moves first.
+    void AddToRebalancePlan(chunkId_t chunkId, const ServerLocation& loc,
+        int64_t priority);
+    int64_t GetMovePriority(const MetaChunkReplicate& req) const;
+    int WriteRebalancePlan();
     void BuildRebalancePlan();
     bool ChunkReplicationDone(MetaChunkReplicate* req);
     void ExecuteRebalancePlan();
@@ -92,11 +104,32 @@ public:
         mStopFlag = true;
     }
     int RunFsck(const string& fileName);
+    // Benchmarks: placement decisions, server down and retire handling, and
+    // the resulting re-replication throughput. The results are written into
+    // os.
+    void BenchmarkPlacement(size_t count, int numReplicas, ostream& os);
+    void BenchmarkRackFailure(int rack, ostream& os);
+    void BenchmarkRetire(size_t count, ostream& os);
 private:
     typedef map<ServerLocation, ChunkServerPtr> Loc2Server;
     class PlacementVerifier;
+    struct PlanEntry
+    {
+        PlanEntry(chunkId_t id, const ServerLocation& loc, int64_t priority)
+            : mChunkId(id),
+              mLocation(loc),
+              mPriority(priority)
+            {}
+        bool operator<(const PlanEntry& other) const
+            { return (other.mPriority < mPriority); }
+        chunkId_t      mChunkId;
+        ServerLocation mLocation;
+        int64_t        mPriority;
+    };
+    typedef vector<PlanEntry> Plan;
 
     size_t RunChunkserverOps();
+    void RunReplication(const char* name, ostream& os);
     void CalculateRebalaceThresholds();
     void PrepareRebalance(bool enableRebalanceFlag);
     bool Parse(const char* line, size_t size,
@@ -107,7 +140,8 @@ private:
         const ChunkServer*  srv,
         string&             fileName,
         size_t              replicas,
-        const char*         reason);
+        const char*         reason,
+        bool                showFlag);
     void VerifyPlacement(
         const CSMap::Entry&           c,
         const Servers&                servers,
@@ -127,6 +161,8 @@ private:
     int        mNumBlksRebalanced;
     bool       mStopFlag;
     ofstream   mPlanFile;
+    ofstream   mReportFile;
+    Plan       mPlan;
     Loc2Server mLoc2Server;
 private:
     // No copy.
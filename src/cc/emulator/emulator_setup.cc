@@ -52,7 +52,8 @@ EmulatorSetup(
     string&  networkFn,
     string&  chunkmapFn,
     int16_t  minReplicasPerFile,
-    bool     addChunksToReplicationChecker)
+    bool     addChunksToReplicationChecker,
+    int      restoreThreadCount)
 {
     logger_setup_paths(logdir);
     checkpointer_setup_paths(cpdir);
@@ -62,6 +63,7 @@ EmulatorSetup(
     int status;
     if (file_exists(LASTCP)) {
         Restorer r;
+        r.setThreadCount(restoreThreadCount);
         status = r.rebuild(LASTCP, minReplicasPerFile) ? 0 : -EIO;
         // gLayoutEmulator.InitRecoveryStartTime();
     } else {
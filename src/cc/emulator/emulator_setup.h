@@ -37,13 +37,15 @@ using std::string;
 using std::ostream;
 
 // pass an optional argument that enables changing the degree of replication for a file.
+// restoreThreadCount > 0 restores the checkpoint with the parallel restorer.
 int EmulatorSetup(
     string&  logdir,
     string&  cpdir,
     string&  networkFn,
     string&  chunkmapFn,
     int16_t  minReplicasPerFile = 1,
-    bool     addChunksToReplicationChecker = false);
+    bool     addChunksToReplicationChecker = false,
+    int      restoreThreadCount = 0);
 }
 
 #endif // EMULATOR_EMULATORSETUP_H
@@ -0,0 +1,146 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Copyright 2016 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Chunk placement and replication scheduling benchmark. Load
+// checkpoint, network definition, and chunk map, then run synthetic workloads:
+// chunk allocation burst, rack failure, and chunk server retire, and report
+// latencies and throughput.
+//
+//----------------------------------------------------------------------------
+
+#include "LayoutEmulator.h"
+#include "emulator_setup.h"
+
+#include "common/MdStream.h"
+#include "common/MsgLogger.h"
+#include "common/Properties.h"
+#include "meta/AuditLog.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+using std::string;
+using std::cout;
+using std::cerr;
+
+using namespace KFS;
+
+int
+main(int argc, char** argv)
+{
+    string logdir("kfslog");
+    string cpdir("kfscp");
+    string networkFn("network.def");
+    string chunkmapFn("chunkmap.txt");
+    string propsFn;
+    int    optchar;
+    bool   helpFlag     = false;
+    size_t allocCount   = 100000;
+    int    numReplicas  = 3;
+    int    rack         = -1;
+    bool   rackFailFlag = true;
+    size_t retireCount  = 1;
+
+    while ((optchar = getopt(argc, argv, "c:l:n:b:p:a:r:k:Kt:h")) != -1) {
+        switch (optchar) {
+            case 'l':
+                logdir = optarg;
+                break;
+            case 'c':
+                cpdir = optarg;
+                break;
+            case 'n':
+                networkFn = optarg;
+                break;
+            case 'b':
+                chunkmapFn = optarg;
+                break;
+            case 'p':
+                propsFn = optarg;
+                break;
+            case 'a':
+                allocCount = (size_t)atof(optarg);
+                break;
+            case 'r':
+                numReplicas = atoi(optarg);
+                break;
+            case 'k':
+                rack = atoi(optarg);
+                break;
+            case 'K':
+                rackFailFlag = false;
+                break;
+            case 't':
+                retireCount = (size_t)atol(optarg);
+                break;
+            case 'h':
+                helpFlag = true;
+                break;
+            default:
+                cerr << "Unrecognized flag " << (char)optchar << "\n";
+                helpFlag = true;
+                break;
+        }
+    }
+
+    if (helpFlag || numReplicas <= 0) {
+        cout << "Usage: " << argv[0] << "\n"
+            "[-l <log directory> (default " << logdir << ")]\n"
+            "[-c <checkpoint directory> (default " << cpdir << ")]\n"
+            "[-n <network definition file name> (default " <<
+                networkFn << ")]\n"
+            "[-b <chunkmap file> (default " << chunkmapFn << ")]\n"
+            "[-p <[meta server] configuration file> (default none)]\n"
+            "[-a <number of chunk allocations> (default " <<
+                allocCount << ")]\n"
+            "[-r <replication> (default " << numReplicas << ")]\n"
+            "[-k <rack id to fail> (default first rack)]\n"
+            "[-K do not run rack failure]\n"
+            "[-t <number of chunk servers to retire> (default " <<
+                retireCount << ")]\n"
+        ;
+        return 1;
+    }
+
+    MdStream::Init();
+    MsgLogger::Init(0, MsgLogger::kLogLevelNOTICE);
+    Properties props;
+    int status = 0;
+    if (propsFn.empty() ||
+            (status = props.loadProperties(propsFn.c_str(), char('=')))
+            == 0) {
+        gLayoutEmulator.SetParameters(props);
+        if ((status = EmulatorSetup(logdir, cpdir, networkFn, chunkmapFn)) ==
+                0) {
+            if (0 < allocCount) {
+                gLayoutEmulator.BenchmarkPlacement(
+                    allocCount, numReplicas, cout);
+            }
+            if (rackFailFlag) {
+                gLayoutEmulator.BenchmarkRackFailure(rack, cout);
+            }
+            if (0 < retireCount) {
+                gLayoutEmulator.BenchmarkRetire(retireCount, cout);
+            }
+        }
+    }
+    AuditLog::Stop();
+    MdStream::Cleanup();
+    return (status == 0 ? 0 : 1);
+}
@@ -58,13 +58,14 @@ main(int argc, char** argv)
     string  chunkmapFn("chunkmap.txt");
     string  propsFn;
     string  chunkMapDir;
+    string  updatePlanFn;
     int     optchar;
     int16_t minReplication   = -1;
     double  variationFromAvg = 0;
     bool    helpFlag         = false;
     bool    debugFlag        = false;
 
-    while ((optchar = getopt(argc, argv, "c:l:n:b:r:hp:o:dm:t:")) != -1) {
+    while ((optchar = getopt(argc, argv, "c:l:n:b:r:hp:o:dm:t:u:")) != -1) {
         switch (optchar) {
             case 'l':
                 logdir = optarg;
@@ -99,13 +100,17 @@ main(int argc, char** argv)
             case 'm':
                 minReplication = atoi(optarg);
                 break;
+            case 'u':
+                updatePlanFn = optarg;
+                break;
             default:
                 cerr << "Unrecognized flag: " << (char)optchar << "\n";
                 helpFlag = true;
                 break;
         }
     }
-    if (helpFlag || rebalancePlanFn.empty()) {
+    if (helpFlag || rebalancePlanFn.empty() ||
+            updatePlanFn == rebalancePlanFn) {
         cout <<
         "Usage: " << argv[0] << "\n"
             "[-l <log directory> (default " << logdir << ")]\n"
@@ -121,6 +126,12 @@ main(int argc, char** argv)
             "[-o <new chunk map output directory> (default none)]\n"
             "[-d debug -- print chunk layout before and after]\n"
             "[-m <min replicas per file> (default -1 -- no change)]\n"
+            "[-u <existing re-balance plan to update> (default none)]\n"
+            "The moves of the existing plan that are still valid with the\n"
+            "current chunk map and utilization are kept, and new moves are\n"
+            "added. The existing plan file must differ from the output.\n"
+            "The plan moves are ordered by priority -- the utilization\n"
+            "difference between the source and destination.\n"
             "To create network defininiton file and chunk map files:\n"
             "telnet to the meta server, and issue DUMP_CHUNKTOSERVERMAP\n"
             "followed by an empty line.\n"
@@ -163,10 +174,23 @@ main(int argc, char** argv)
             if (debugFlag) {
                 gLayoutEmulator.PrintChunkserverBlockCount(cout);
             }
+            if (! updatePlanFn.empty() &&
+                    (status = gLayoutEmulator.LoadRebalancePlan(
+                        updatePlanFn)) == 0) {
+                KFS_LOG_STREAM_NOTICE << "updating re-balance plan: " <<
+                    updatePlanFn <<
+                KFS_LOG_EOM;
+                // Re-play the existing plan, only the moves still valid
+                // are recorded.
+                gLayoutEmulator.ExecuteRebalancePlan();
+            }
+        }
+        if (status == 0) {
             KFS_LOG_STREAM_NOTICE << "creating re-balance plan: " <<
                 rebalancePlanFn <<
             KFS_LOG_EOM;
             gLayoutEmulator.BuildRebalancePlan();
+            status = gLayoutEmulator.WriteRebalancePlan();
             if (! chunkMapDir.empty()) {
                 gLayoutEmulator.DumpChunkToServerMap(chunkMapDir);
             }
@@ -50,12 +50,14 @@ main(int argc, char** argv)
     string chunkmapFn("chunkmap.txt");
     string fsckFn("-");
     string propsFn;
+    string reportFn;
     int    optchar;
     bool   helpFlag      = false;
     bool   reportAllFlag = false;
     bool   verboseFlag   = false;
+    int    threadCount   = 0;
 
-    while ((optchar = getopt(argc, argv, "avc:l:n:b:r:hf:p:")) != -1) {
+    while ((optchar = getopt(argc, argv, "avc:l:n:b:r:hf:p:j:o:")) != -1) {
         switch (optchar) {
             case 'l':
                 logdir = optarg;
@@ -84,6 +86,12 @@ main(int argc, char** argv)
             case 'p':
                 propsFn = optarg;
                 break;
+            case 'j':
+                threadCount = atoi(optarg);
+                break;
+            case 'o':
+                reportFn = optarg;
+                break;
             default:
                 cerr << "Unrecognized flag " << (char)optchar << "\n";
                 helpFlag = true;
@@ -103,6 +111,10 @@ main(int argc, char** argv)
                 fsckFn << ")]\n"
             "[-v verbose replica check output]\n"
             "[-a report all placement problems]\n"
+            "[-j <checkpoint restore threads> (default " <<
+                threadCount << ")]\n"
+            "[-o <placement report file> (tab separated problem and"
+                " summary records) (default none)]\n"
         ;
         return 1;
     }
@@ -116,8 +128,14 @@ main(int argc, char** argv)
             (status = props.loadProperties(propsFn.c_str(), char('=')))
             == 0) {
         gLayoutEmulator.SetParameters(props);
-        if ((status = EmulatorSetup(logdir, cpdir, networkFn, chunkmapFn)) ==
-                0) {
+        const int16_t kMinReplicasPerFile            = 1;
+        const bool    kAddChunksToReplicationChecker = false;
+        if ((reportFn.empty() ||
+                (status = gLayoutEmulator.SetPlacementReportOutFile(
+                    reportFn)) == 0) &&
+                (status = EmulatorSetup(logdir, cpdir, networkFn, chunkmapFn,
+                    kMinReplicasPerFile, kAddChunksToReplicationChecker,
+                    threadCount)) == 0) {
             if (! fsckFn.empty()) {
                 fsckStatus = gLayoutEmulator.RunFsck(fsckFn);
             }
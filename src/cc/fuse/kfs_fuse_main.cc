@@ -355,7 +355,8 @@ fatal(const char *fmt, ...)
 }
 
 static void
-initkfs(char* addr, const string& cfg_file, const string& cfg_props)
+initkfs(char* addr, const string& cfg_file, const string& cfg_props,
+    int read_ahead, int io_buf_size)
 {
     char *cp;
 
@@ -386,10 +387,18 @@ initkfs(char* addr, const string& cfg_file, const string& cfg_props)
     if (! client) {
         fatal("connect: %s:%d", host.c_str(), port);
     }
+    // The kernel issues concurrent reads with async_read, and the client
+    // read ahead fetches the subsequent data in parallel with these.
+    if (0 <= read_ahead) {
+        client->SetDefaultReadAheadSize(read_ahead);
+    }
+    if (0 < io_buf_size) {
+        client->SetDefaultIoBufferSize(io_buf_size);
+    }
 }
 
 static struct fuse_args*
-get_fs_args(struct fuse_args* args)
+get_fs_args(struct fuse_args* args, const string& fs_options)
 {
 #ifdef KFS_OS_NAME_DARWIN
     return NULL;
@@ -397,15 +406,61 @@ get_fs_args(struct fuse_args* args)
     if (! args) {
         return 0;
     }
+    string opts("-obig_writes");
+    if (! fs_options.empty()) {
+        opts += ",";
+        opts += fs_options;
+    }
     args->argc = 2;
     args->argv = (char**)calloc(sizeof(char*), args->argc + 1);
     args->argv[0] = strdup("qfs_fuse");
-    args->argv[1] = strdup("-obig_writes");
+    args->argv[1] = strdup(opts.c_str());
     args->allocated = 1;
     return args;
 #endif
 }
 
+/*
+ * Fuse library options, as opposed to the mount options, have to be passed
+ * to fuse_new(): max_write, caching, and splice options.
+ */
+static bool
+is_fs_option(const string& token)
+{
+    static const char* const fs_options[] = {
+        "max_write=",
+        "max_readahead=",
+        "entry_timeout=",
+        "negative_timeout=",
+        "attr_timeout=",
+        "ac_attr_timeout=",
+        "kernel_cache",
+        "auto_cache",
+        "noauto_cache",
+        "async_read",
+        "sync_read",
+        "splice_read",
+        "splice_write",
+        "splice_move",
+        "no_splice_read",
+        "no_splice_write",
+        "no_splice_move",
+        NULL
+    };
+#ifdef KFS_OS_NAME_DARWIN
+    return false;
+#else
+    for (const char* const* p = fs_options; *p; ++p) {
+        const size_t len = strlen(*p);
+        if ((*p)[len - 1] == '=' ?
+                token.compare(0, len, *p) == 0 : token == *p) {
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
 static struct fuse_args*
 get_mount_args(struct fuse_args* args, const char* options)
 {
@@ -430,7 +485,8 @@ get_mount_args(struct fuse_args* args, const char* options)
 static int
 massage_options(
     char** opt_argv, int opt_argc, string* options, bool* readonly,
-    string& out_cfg_file, string& out_cfg_props)
+    string& out_cfg_file, string& out_cfg_props, string& out_fs_options,
+    int& out_read_ahead, int& out_io_buf_size)
 {
     if (!opt_argv || !readonly || !options) {
         return -1;
@@ -469,12 +525,29 @@ massage_options(
     }
     const string cfg("cfg=");
     const string cfg_file("cfg=FILE:");
+    const string read_ahead("readahead=");
+    const string io_buf_size("iobufsize=");
     while (! opts.empty()) {
         const string token = opts.back();
         opts.pop_back();
         if (token == "rw" || token == "ro") {
             continue;
         }
+        if (token.compare(0, read_ahead.length(), read_ahead) == 0) {
+            out_read_ahead = atoi(token.c_str() + read_ahead.length());
+            continue;
+        }
+        if (token.compare(0, io_buf_size.length(), io_buf_size) == 0) {
+            out_io_buf_size = atoi(token.c_str() + io_buf_size.length());
+            continue;
+        }
+        if (is_fs_option(token)) {
+            if (! out_fs_options.empty()) {
+                out_fs_options.append(",");
+            }
+            out_fs_options.append(token);
+            continue;
+        }
         if (cfg.length() <= token.length() &&
                 token.compare(0, cfg.length(), cfg) == 0) {
             if (cfg_file.length() <= token.length() &&
@@ -499,14 +572,16 @@ massage_options(
 static void
 initfuse(char* kfs_host_address, const char* mountpoint,
          const char* options, bool readonly, bool fork_flag,
-         const string& cfg_file, const string& cfg_props)
+         const string& cfg_file, const string& cfg_props,
+         const string& fs_options, int read_ahead, int io_buf_size)
 {
     int pid = fork_flag ? fork() : 0;
     if (pid < 0) {
         fatal("fork:");
     }
     if (pid == 0) {
-        initkfs(kfs_host_address, cfg_file, cfg_props);
+        initkfs(kfs_host_address, cfg_file, cfg_props,
+            read_ahead, io_buf_size);
 
         struct fuse_args fs_args;
         struct fuse_args mnt_args;
@@ -519,7 +594,7 @@ initfuse(char* kfs_host_address, const char* mountpoint,
         }
 
         struct fuse* fuse = NULL;
-        fuse = fuse_new(ch, get_fs_args(&fs_args),
+        fuse = fuse_new(ch, get_fs_args(&fs_args, fs_options),
                         (readonly ? &ops_readonly : &ops),
                         (readonly ? sizeof(ops_readonly) : sizeof(ops)),
                         NULL);
@@ -544,7 +619,13 @@ usage(int e, const char* name)
     fprintf(stderr,
         "usage: %s qfshost mountpoint [-o opt1[,opt2..]]\n"
         "       eg: %s 127.0.0.1:20000 "
-        "/mnt/qfs -o allow_other,ro,cfg=FILE:client_config_file.prp\n",
+        "/mnt/qfs -o allow_other,ro,cfg=FILE:client_config_file.prp\n"
+        "       large io and caching eg: -o max_read=1048576,"
+        "max_write=1048576,max_readahead=1048576,\n"
+        "         attr_timeout=5,entry_timeout=5,splice_read,splice_write,"
+        "readahead=4194304\n"
+        "       readahead=n -- qfs client default read ahead size\n"
+        "       iobufsize=n -- qfs client default io buffer size\n",
         name, name
     );
     exit(e);
@@ -579,9 +660,13 @@ main(int argc, char **argv)
     bool readonly = true;
     string cfg_file;
     string cfg_props;
+    string fs_options;
+    int    read_ahead  = -1;
+    int    io_buf_size = -1;
     if (argc > 2) {
         if (massage_options(argv + 2, argc - 2, &options, &readonly,
-                cfg_file, cfg_props) < 0) {
+                cfg_file, cfg_props, fs_options, read_ahead,
+                io_buf_size) < 0) {
             usage(1, name);
         }
     }
@@ -589,7 +674,7 @@ main(int argc, char **argv)
     //setsid(); // detach from console
 
     initfuse(argv[0], argv[1], options.c_str(), readonly,
-        fork_flag, cfg_file, cfg_props);
+        fork_flag, cfg_file, cfg_props, fs_options, read_ahead, io_buf_size);
 
     return 0;
 }
@@ -87,6 +87,9 @@ public:
     int64_t GetValue() const {
         return mCount;
     }
+    int64_t GetTimeSpent() const {
+        return mTimeSpent;
+    }
 protected:
     /// Name of this counter object
     string mName;
@@ -155,6 +158,16 @@ public:
         for_each(mCounters.begin(), mCounters.end(), ShowCounter(os));
     }
 
+    /// Invoke func(const Counter&) for each counter in name order.
+    template<typename T>
+    void Enumerate(T& func) const {
+        for (CounterMap::const_iterator it = mCounters.begin();
+                it != mCounters.end();
+                ++it) {
+            func(*it->second);
+        }
+    }
+
 private:
     /// Map that tracks all the counters in the system
     CounterMap  mCounters;
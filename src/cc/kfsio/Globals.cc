@@ -40,6 +40,8 @@ Globals_t::Globals_t()
       ctrOpenDiskFds     ("Open disk fds"),
       ctrNetBytesRead    ("Bytes read from network"),
       ctrNetBytesWritten ("Bytes written to network"),
+      ctrNetZeroCopyBytesWritten("Bytes written to network with zero copy"),
+      ctrNetZeroCopySendsCopied("Zero copy network sends copied"),
       ctrDiskBytesRead   ("Bytes read from disk"),
       ctrDiskBytesWritten("Bytes written to disk"),
       ctrDiskIOErrors    ("Disk I/O errors"),
@@ -51,6 +53,8 @@ Globals_t::Globals_t()
     counterManager.AddCounter(&ctrOpenDiskFds);
     counterManager.AddCounter(&ctrNetBytesRead);
     counterManager.AddCounter(&ctrNetBytesWritten);
+    counterManager.AddCounter(&ctrNetZeroCopyBytesWritten);
+    counterManager.AddCounter(&ctrNetZeroCopySendsCopied);
     counterManager.AddCounter(&ctrDiskBytesRead);
     counterManager.AddCounter(&ctrDiskBytesWritten);
     counterManager.AddCounter(&ctrDiskIOErrors);
@@ -44,6 +44,8 @@ struct Globals_t
     Counter ctrOpenDiskFds;
     Counter ctrNetBytesRead;
     Counter ctrNetBytesWritten;
+    Counter ctrNetZeroCopyBytesWritten;
+    Counter ctrNetZeroCopySendsCopied;
     Counter ctrDiskBytesRead;
     Counter ctrDiskBytesWritten;
     // track the # of failed read/writes
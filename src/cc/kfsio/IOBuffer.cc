@@ -183,6 +183,10 @@ private:
     libkfsio::IOBufferAllocator& mAllocator;
 };
 
+// Allocate shared pointer reference count blocks from the pool, in order to
+// make buffer allocation, and release with pool io buffer allocator malloc free.
+typedef StdFastAllocator<char> IOBufferRefCountAllocator;
+
 // Call this function if you want to change the default allocator.
 bool
 libkfsio::SetIOBufferAllocator(libkfsio::IOBufferAllocator* allocator)
@@ -215,7 +219,8 @@ IOBufferData::Init(char* buf, int bufSize)
     if (size <= 0 && ! buf) {
         mData.reset();
     } else {
-        mData.reset(buf ? buf : new char [size], IOBufferArrayDeallocator());
+        mData.reset(buf ? buf : new char [size], IOBufferArrayDeallocator(),
+            IOBufferRefCountAllocator());
     }
     mProducer = mData.get();
     mEnd      = mProducer + size;
@@ -231,10 +236,10 @@ IOBufferData::Init(char* buf, libkfsio::IOBufferAllocator& allocator)
         }
         sIsIOBufferAllocatorUsed = true;
         mData.reset(buf ? buf : allocator.Allocate(),
-            IOBufferDeallocator());
+            IOBufferDeallocator(), IOBufferRefCountAllocator());
     } else {
         mData.reset(buf ? buf : allocator.Allocate(),
-            IOBufferDeallocatorCustom(allocator));
+            IOBufferDeallocatorCustom(allocator), IOBufferRefCountAllocator());
     }
     if (! (mProducer = mData.get())) {
         abort();
@@ -259,6 +264,18 @@ IOBufferData::IOBufferData(const IOBufferData& other,
     }
 }
 
+inline void
+IOBufferData::SetShared(char* c, char* e, char* p /* = 0 */)
+{
+    char* const prod = p ? p : e;
+    if (! (mData.get() <= c && c <= prod && prod <= e && e <= mEnd)) {
+        abort();
+    }
+    mEnd      = e;
+    mProducer = prod;
+    mConsumer = c;
+}
+
 IOBufferData::IOBufferData()
     : mData(),
       mEnd(0),
@@ -654,7 +671,8 @@ IOBuffer::EnsureSpaceAvailable(int numBytes)
         assert(nb > 0);
         if (nBytes + nb > numBytes) {
             char* const p = buf.Producer();
-            mBuf.push_back(IOBufferData(buf, p, p + numBytes - nBytes, p));
+            mBuf.push_back(buf);
+            mBuf.back().SetShared(p, p + numBytes - nBytes, p);
             nBytes = numBytes;
         } else {
             mBuf.push_back(buf);
@@ -779,8 +797,8 @@ IOBuffer::Move(IOBuffer* other, int numBytes)
             // this is the last buffer being moved; only partial data
             // from the buffer needs to be moved.  do the move by
             // sharing the block (and therby avoid data copy)
-            mBuf.push_back(IOBufferData(
-                s, s.Consumer(), s.Consumer() + nBytes));
+            mBuf.push_back(s);
+            mBuf.back().SetShared(s.Consumer(), s.Consumer() + nBytes);
             nBytes -= s.Consume(nBytes);
             assert(nBytes == 0);
         }
@@ -844,8 +862,9 @@ IOBuffer::MoveSpace(IOBuffer* other, int numBytes)
             // from the buffer needs to be moved.  do the move by
             // sharing the block (and therby avoid data copy)
             char* const c = s.Consumer();
-            mBuf.push_back(IOBufferData(s, c, c + nBytes, c + min(nBytes, nb)));
-            s = IOBufferData(s, c + nBytes, c + st, c + max(nBytes, nb));
+            mBuf.push_back(s);
+            mBuf.back().SetShared(c, c + nBytes, c + min(nBytes, nb));
+            s.SetShared(c + nBytes, c + st, c + max(nBytes, nb));
             const int n = mBuf.back().BytesConsumable();
             other->mByteCount -= n;
             mByteCount += n;
@@ -891,8 +910,8 @@ IOBuffer::SplitBufferListAt(IOBuffer::BList& buf, int& nBytes)
             continue;
         }
         if (nb > nBytes) {
-            buf.insert(iter, IOBufferData(
-                data, data.Consumer(), data.Consumer() + nBytes));
+            buf.insert(iter, data)->SetShared(
+                data.Consumer(), data.Consumer() + nBytes);
             nBytes -= data.Consume(nBytes);
             assert(nBytes == 0);
         } else {
@@ -1289,7 +1308,7 @@ IOBuffer::Read(int fd, int maxReadAhead, IOBuffer::Reader* reader)
 }
 
 int
-IOBuffer::Write(int fd)
+IOBuffer::Write(int fd, int maxWrite)
 {
     DebugVerify();
     const int    kMaxWritevBufs      = 32;
@@ -1297,14 +1316,15 @@ IOBuffer::Write(int fd)
     const int    kPreferredWriteSize = 64 << 10;
     struct iovec writeVec[kMaxWritevBufs];
     ssize_t      totWr = 0;
+    ssize_t      rem   = maxWrite < 0 ? ssize_t(mByteCount) : ssize_t(maxWrite);
 
-    while (! mBuf.empty()) {
+    while (! mBuf.empty() && 0 < rem) {
         BList::iterator it;
         int             nVec;
         ssize_t         toWr;
         for (it = mBuf.begin(), nVec = 0, toWr = 0;
                 it != mBuf.end() && nVec < maxWriteBufs &&
-                    toWr < kPreferredWriteSize;
+                    toWr < kPreferredWriteSize && toWr < rem;
                 ) {
             const int nBytes = it->BytesConsumable();
             if (nBytes <= 0) {
@@ -1312,8 +1332,8 @@ IOBuffer::Write(int fd)
                 continue;
             }
             writeVec[nVec].iov_base = it->Consumer();
-            writeVec[nVec].iov_len  = (size_t)nBytes;
-            toWr += nBytes;
+            writeVec[nVec].iov_len  = (size_t)min(ssize_t(nBytes), rem - toWr);
+            toWr += (ssize_t)writeVec[nVec].iov_len;
             nVec++;
             ++it;
         }
@@ -1323,12 +1343,15 @@ IOBuffer::Write(int fd)
             break;
         }
         const ssize_t nWr = writev(fd, writeVec, nVec);
-        if (nWr == toWr && it == mBuf.end()) {
+        if (nWr == toWr && it == mBuf.end() &&
+                (0 < nVec && writeVec[nVec - 1].iov_len ==
+                    (size_t)mBuf.back().BytesConsumable())) {
             mBuf.clear();
         } else {
             ssize_t nBytes = nWr;
             int nb;
-            while ((nb = mBuf.front().BytesConsumable()) <= nBytes) {
+            while (! mBuf.empty() &&
+                    (nb = mBuf.front().BytesConsumable()) <= nBytes) {
                 nBytes -= nb;
                 mBuf.pop_front();
             }
@@ -1339,6 +1362,7 @@ IOBuffer::Write(int fd)
         }
         if (nWr > 0) {
             totWr += nWr;
+            rem   -= nWr;
             globals().ctrNetBytesWritten.Update(nWr);
         } else if (totWr <= 0 && (totWr = -(errno == 0 ? EAGAIN : errno)) > 0) {
             totWr = -totWr;
@@ -1586,7 +1610,8 @@ IOBuffer::Copy(const IOBuffer* buf, int numBytes)
             continue;
         }
         char* const c = const_cast<char*>(it->Consumer());
-        mBuf.push_back(IOBufferData(*it, c, c + nb));
+        mBuf.push_back(*it);
+        mBuf.back().SetShared(c, c + nb);
         rem -= nb;
     }
     rem = numBytes - rem;
@@ -1608,9 +1633,10 @@ IOBuffer::Clone() const
     BList::const_iterator  it;
     for (it = mBuf.begin(); it != mBuf.end(); ++it) {
         if (! it->IsEmpty()) {
-            clone->mBuf.push_back(IOBufferData(*it,
+            clone->mBuf.push_back(*it);
+            clone->mBuf.back().SetShared(
                 const_cast<char*>(it->Consumer()),
-                const_cast<char*>(it->Producer())));
+                const_cast<char*>(it->Producer()));
         }
     }
     assert(mByteCount >= 0);
@@ -213,8 +213,14 @@ private:
 
     inline int MaxAvailable(int numBytes) const;
     inline int MaxConsumable(int numBytes) const;
+    /// Restrict the shared copy to [c, e), with the producer at p or e. Used
+    /// by IOBuffer on list element copies, in order to avoid creating
+    /// temporary objects, and the corresponding reference count updates.
+    inline void SetShared(char* c, char* e, char* p = 0);
 
     static int sDefaultBufferSize;
+
+    friend class IOBuffer;
 };
 
 
@@ -291,7 +297,10 @@ public:
     int Read(int fd, int maxReadAhead, Reader* reader);
     int Read(int fd, int maxReadAhead = -1)
         { return Read(fd, maxReadAhead, 0); }
-    int Write(int fd);
+    int Write(int fd)
+        { return Write(fd, -1); }
+    /// Write at most maxWrite bytes, maxWrite < 0 -- no limit.
+    int Write(int fd, int maxWrite);
 
     /// Move data from one buffer to another.  This involves (mostly)
     /// shuffling pointers without incurring data copying.
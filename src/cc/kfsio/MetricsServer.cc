@@ -0,0 +1,657 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief OpenMetrics http scrape endpoint and metrics builder implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "MetricsServer.h"
+#include "Acceptor.h"
+#include "NetManager.h"
+#include "NetConnection.h"
+#include "KfsCallbackObj.h"
+#include "IOBuffer.h"
+#include "Counter.h"
+#include "event.h"
+
+#include "common/MsgLogger.h"
+#include "common/Properties.h"
+#include "common/IntToString.h"
+#include "common/kfsdecls.h"
+
+#include "qcdio/QCThread.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
+#include "qcdio/qcdebug.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdio.h>
+
+namespace KFS
+{
+
+    string&
+MetricsBuilder::AddSample(
+    const char* inPrefixPtr,
+    const char* inKeyPtr,
+    size_t      inKeyLen,
+    const char* inLabelsPtr,
+    Type        inType)
+{
+    mName.clear();
+    if (inPrefixPtr) {
+        mName += inPrefixPtr;
+    }
+    mName.append(inKeyPtr, inKeyLen);
+    for (string::iterator theIt = mName.begin();
+            theIt != mName.end();
+            ++theIt) {
+        const int theSym = *theIt & 0xFF;
+        if (isalnum(theSym)) {
+            *theIt = (char)tolower(theSym);
+        } else {
+            *theIt = '_';
+        }
+    }
+    if (inType == kTypeCounter && 6 < mName.size() &&
+            mName.compare(mName.size() - 6, 6, "_total") == 0) {
+        mName.erase(mName.size() - 6);
+    }
+    Family& theFamily = mFamilies[mName];
+    theFamily.mType = inType;
+    string& theSamples = theFamily.mSamples;
+    theSamples += mName;
+    if (inType == kTypeCounter) {
+        theSamples += "_total";
+    }
+    if (inLabelsPtr && *inLabelsPtr) {
+        theSamples += '{';
+        theSamples += inLabelsPtr;
+        theSamples += '}';
+    }
+    theSamples += ' ';
+    return theSamples;
+}
+
+    void
+MetricsBuilder::Add(
+    const char* inPrefixPtr,
+    const char* inKeyPtr,
+    const char* inLabelsPtr,
+    int64_t     inValue,
+    MetricsBuilder::Type inType)
+{
+    AppendDecIntToString(AddSample(
+        inPrefixPtr, inKeyPtr, strlen(inKeyPtr), inLabelsPtr, inType),
+        inValue) += '\n';
+}
+
+    void
+MetricsBuilder::Add(
+    const char* inPrefixPtr,
+    const char* inKeyPtr,
+    const char* inLabelsPtr,
+    double      inValue,
+    MetricsBuilder::Type inType)
+{
+    char theBuf[64];
+    const int theLen = snprintf(theBuf, sizeof(theBuf), "%.17g", inValue);
+    AddSample(inPrefixPtr, inKeyPtr, strlen(inKeyPtr), inLabelsPtr, inType
+        ).append(theBuf, 0 < theLen ? theLen : 0) += '\n';
+}
+
+    static bool
+IsNumber(
+    const char* inPtr,
+    size_t      inLen)
+{
+    if (inLen <= 0 || 63 < inLen) {
+        return false;
+    }
+    char theBuf[64];
+    memcpy(theBuf, inPtr, inLen);
+    theBuf[inLen] = 0;
+    char* theEndPtr = theBuf;
+    strtod(theBuf, &theEndPtr);
+    return (theEndPtr == theBuf + inLen && ! isspace(theBuf[0] & 0xFF));
+}
+
+    void
+MetricsBuilder::AddKeyValues(
+    const char* inPrefixPtr,
+    const char* inLabelsPtr,
+    const char* inTextPtr,
+    size_t      inTextLen,
+    char        inDelimiter)
+{
+    const char*       thePtr    = inTextPtr;
+    const char* const theEndPtr = inTextPtr + inTextLen;
+    while (thePtr < theEndPtr) {
+        const char* theEolPtr = thePtr;
+        while (theEolPtr < theEndPtr && *theEolPtr != '\n') {
+            ++theEolPtr;
+        }
+        const char* theDelimPtr = thePtr;
+        while (theDelimPtr < theEolPtr && *theDelimPtr != inDelimiter) {
+            ++theDelimPtr;
+        }
+        const char* theKeyEndPtr = theDelimPtr;
+        while (thePtr < theKeyEndPtr && (theKeyEndPtr[-1] & 0xFF) <= ' ') {
+            --theKeyEndPtr;
+        }
+        const char* theValPtr    = theDelimPtr + 1;
+        const char* theValEndPtr = theEolPtr;
+        while (theValPtr < theValEndPtr && (*theValPtr & 0xFF) <= ' ') {
+            ++theValPtr;
+        }
+        while (theValPtr < theValEndPtr && (theValEndPtr[-1] & 0xFF) <= ' ') {
+            --theValEndPtr;
+        }
+        if (theDelimPtr < theEolPtr && thePtr < theKeyEndPtr &&
+                IsNumber(theValPtr, theValEndPtr - theValPtr)) {
+            AddSample(inPrefixPtr, thePtr, theKeyEndPtr - thePtr,
+                inLabelsPtr, kTypeGauge).append(
+                    theValPtr, theValEndPtr - theValPtr) += '\n';
+        }
+        thePtr = theEolPtr + 1;
+    }
+}
+
+    void
+MetricsBuilder::AddProperties(
+    const char*       inPrefixPtr,
+    const char*       inLabelsPtr,
+    const Properties& inProps)
+{
+    for (Properties::iterator theIt = inProps.begin();
+            theIt != inProps.end();
+            ++theIt) {
+        const char* const thePtr = theIt->second.GetPtr();
+        const size_t      theLen = theIt->second.GetSize();
+        if (0 < theIt->first.GetSize() && IsNumber(thePtr, theLen)) {
+            AddSample(inPrefixPtr, theIt->first.GetPtr(),
+                theIt->first.GetSize(), inLabelsPtr, kTypeGauge).append(
+                    thePtr, theLen) += '\n';
+        }
+    }
+}
+
+class MetricsBuilderAddCounter
+{
+public:
+    MetricsBuilderAddCounter(
+        MetricsBuilder& inBuilder,
+        const char*     inPrefixPtr,
+        const char*     inLabelsPtr)
+        : mBuilder(inBuilder),
+          mPrefixPtr(inPrefixPtr),
+          mLabelsPtr(inLabelsPtr),
+          mName()
+        {}
+    void operator()(
+        const Counter& inCounter)
+    {
+        mName = inCounter.GetName();
+        mBuilder.Add(mPrefixPtr, mName.c_str(), mLabelsPtr,
+            inCounter.GetValue(), MetricsBuilder::kTypeCounter);
+        mName += "_seconds";
+        mBuilder.Add(mPrefixPtr, mName.c_str(), mLabelsPtr,
+            inCounter.GetTimeSpent() * 1e-6, MetricsBuilder::kTypeCounter);
+    }
+private:
+    MetricsBuilder&   mBuilder;
+    const char* const mPrefixPtr;
+    const char* const mLabelsPtr;
+    string            mName;
+};
+
+    void
+MetricsBuilder::AddCounters(
+    const char*           inPrefixPtr,
+    const char*           inLabelsPtr,
+    const CounterManager& inCounters)
+{
+    MetricsBuilderAddCounter theFunc(*this, inPrefixPtr, inLabelsPtr);
+    inCounters.Enumerate(theFunc);
+}
+
+    void
+MetricsBuilder::Write(
+    string& ioText) const
+{
+    for (Families::const_iterator theIt = mFamilies.begin();
+            theIt != mFamilies.end();
+            ++theIt) {
+        ioText += "# TYPE ";
+        ioText += theIt->first;
+        ioText += theIt->second.mType == kTypeCounter ?
+            " counter\n" : " gauge\n";
+        ioText += theIt->second.mSamples;
+    }
+    ioText += "# EOF\n";
+}
+
+    /* static */ string&
+MetricsBuilder::AppendLabel(
+    string&     ioLabels,
+    const char* inNamePtr,
+    const char* inValuePtr,
+    size_t      inValueLen)
+{
+    if (! ioLabels.empty()) {
+        ioLabels += ',';
+    }
+    ioLabels += inNamePtr;
+    ioLabels += "=\"";
+    const char* const theEndPtr = inValuePtr + inValueLen;
+    for (const char* thePtr = inValuePtr; thePtr < theEndPtr; ++thePtr) {
+        switch (*thePtr) {
+            case '\\': ioLabels += "\\\\"; break;
+            case '"':  ioLabels += "\\\""; break;
+            case '\n': ioLabels += "\\n";  break;
+            default:   ioLabels += *thePtr; break;
+        }
+    }
+    ioLabels += '"';
+    return ioLabels;
+}
+
+class MetricsServer::Impl :
+    public QCRunnable,
+    public IAcceptorOwner,
+    public NetManager::Dispatcher
+{
+public:
+    Impl()
+        : QCRunnable(),
+          IAcceptorOwner(),
+          NetManager::Dispatcher(),
+          mMutex(),
+          mSnapshot("# EOF\n"),
+          mCounters(),
+          mNetManager(),
+          mAcceptorPtr(0),
+          mThread(),
+          mStopFlag(false),
+          mMaxConnectionCount(16),
+          mIoTimeoutSec(60),
+          mConnectionCount(0)
+        {}
+    ~Impl()
+        { Impl::Stop(); }
+    int Start(
+        const ServerLocation& inLocation,
+        bool                  inIpV6OnlyFlag,
+        int                   inMaxConnectionCount,
+        int                   inIoTimeoutSec)
+    {
+        if (mThread.IsStarted()) {
+            return -EINVAL;
+        }
+        mMaxConnectionCount = inMaxConnectionCount;
+        mIoTimeoutSec       = inIoTimeoutSec;
+        mStopFlag           = false;
+        const bool kBindOnlyFlag = false;
+        mAcceptorPtr = new Acceptor(
+            mNetManager, inLocation, inIpV6OnlyFlag, this, kBindOnlyFlag);
+        if (! mAcceptorPtr->IsAcceptorStarted()) {
+            delete mAcceptorPtr;
+            mAcceptorPtr = 0;
+            return -EADDRNOTAVAIL;
+        }
+        const int kStackSize = 64 << 10;
+        mThread.Start(this, kStackSize, "MetricsServer");
+        KFS_LOG_STREAM_INFO <<
+            "metrics server started on: " << mAcceptorPtr->GetLocation() <<
+        KFS_LOG_EOM;
+        return 0;
+    }
+    void Stop()
+    {
+        if (! mThread.IsStarted()) {
+            return;
+        }
+        QCStMutexLocker theLock(mMutex);
+        mStopFlag = true;
+        theLock.Unlock();
+        mNetManager.Wakeup();
+        mThread.Join();
+        delete mAcceptorPtr;
+        mAcceptorPtr = 0;
+    }
+    void ChildAtFork()
+        { mNetManager.ChildAtFork(); }
+    bool IsRunning() const
+        { return (mThread.IsStarted()); }
+    int GetPort() const
+        { return (mAcceptorPtr ? mAcceptorPtr->GetPort() : -1); }
+    void SetSnapshot(
+        string& ioText)
+    {
+        QCStMutexLocker theLock(mMutex);
+        mSnapshot.swap(ioText);
+    }
+    void GetCounters(
+        Counters& outCounters) const
+    {
+        QCStMutexLocker theLock(mMutex);
+        outCounters = mCounters;
+    }
+    virtual void Run()
+    {
+        QCMutex* const kNullMutexPtr         = 0;
+        bool     const kWakeupAndCleanupFlag = true;
+        mNetManager.MainLoop(kNullMutexPtr, kWakeupAndCleanupFlag, this);
+    }
+    virtual void DispatchStart()
+    {
+        QCStMutexLocker theLock(mMutex);
+        if (mStopFlag) {
+            mNetManager.Shutdown();
+        }
+    }
+    virtual void DispatchEnd()
+        {}
+    virtual void DispatchExit()
+        {}
+    virtual KfsCallbackObj* CreateKfsCallbackObj(
+        NetConnectionPtr& inConnPtr)
+    {
+        QCStMutexLocker theLock(mMutex);
+        if (mMaxConnectionCount <= mConnectionCount) {
+            mCounters.mRejectCount++;
+            return 0;
+        }
+        mCounters.mAcceptCount++;
+        theLock.Unlock();
+        return new Connection(*this, inConnPtr);
+    }
+private:
+    enum { kMaxHeaderLen = 16 << 10 };
+
+    class Connection : public KfsCallbackObj
+    {
+    public:
+        Connection(
+            Impl&                   inImpl,
+            const NetConnectionPtr& inConnPtr)
+            : KfsCallbackObj(),
+              mImpl(inImpl),
+              mConnPtr(inConnPtr),
+              mCloseFlag(false)
+        {
+            mImpl.mConnectionCount++;
+            SET_HANDLER(this, &Connection::Handle);
+            mConnPtr->SetMaxReadAhead(kMaxHeaderLen);
+            mConnPtr->SetInactivityTimeout(mImpl.mIoTimeoutSec);
+        }
+        ~Connection()
+            { mImpl.mConnectionCount--; }
+        int Handle(
+            int   inCode,
+            void* /* inDataPtr */)
+        {
+            switch (inCode) {
+                case EVENT_NET_READ:
+                    if (! mCloseFlag) {
+                        Read();
+                    }
+                    break;
+                case EVENT_NET_WROTE:
+                    break;
+                case EVENT_INACTIVITY_TIMEOUT:
+                case EVENT_NET_ERROR:
+                    mConnPtr->Close();
+                    break;
+                default:
+                    QCASSERT(! "unexpected event");
+                    break;
+            }
+            if (mCloseFlag && mConnPtr->IsGood() &&
+                    ! mConnPtr->IsWriteReady()) {
+                mConnPtr->Close();
+            }
+            if (! mConnPtr->IsGood()) {
+                delete this;
+            }
+            return 0;
+        }
+    private:
+        Impl&                  mImpl;
+        NetConnectionPtr const mConnPtr;
+        bool                   mCloseFlag;
+
+        void Read()
+        {
+            IOBuffer& theInBuf = mConnPtr->GetInBuffer();
+            int       theIdx;
+            while (! mCloseFlag &&
+                    0 <= (theIdx = theInBuf.IndexOf(0, "\r\n\r\n"))) {
+                const int theLen = theIdx + 4;
+                if (kMaxHeaderLen < theLen) {
+                    break;
+                }
+                int         theHdrLen = theLen;
+                const char* thePtr    =
+                    theInBuf.CopyOutOrGetBufPtr(mImpl.mHeaderBuf, theHdrLen);
+                Request(thePtr, theHdrLen);
+                theInBuf.Consume(theLen);
+            }
+            if (! mCloseFlag && kMaxHeaderLen < theInBuf.BytesConsumable()) {
+                Respond(400, "Bad Request", false);
+                mCloseFlag = true;
+            }
+            if (mCloseFlag) {
+                theInBuf.Clear();
+            }
+            mConnPtr->StartFlush();
+        }
+        void Request(
+            const char* inPtr,
+            int         inLen)
+        {
+            const char* const theEndPtr = inPtr + inLen;
+            const char*       thePtr    = inPtr;
+            const char* const theMethodPtr = thePtr;
+            while (thePtr < theEndPtr && *thePtr != ' ') {
+                ++thePtr;
+            }
+            const size_t theMethodLen = thePtr - theMethodPtr;
+            ++thePtr;
+            const char* const thePathPtr = thePtr;
+            while (thePtr < theEndPtr && *thePtr != ' ' && *thePtr != '?' &&
+                    *thePtr != '\r') {
+                ++thePtr;
+            }
+            const size_t thePathLen = thePtr - thePathPtr;
+            while (thePtr < theEndPtr && *thePtr != ' ' && *thePtr != '\r') {
+                ++thePtr;
+            }
+            const char* const kHttp11    = " HTTP/1.1";
+            const size_t      kHttp11Len = strlen(kHttp11);
+            if (thePtr + kHttp11Len > theEndPtr ||
+                    memcmp(thePtr, kHttp11, kHttp11Len) != 0 ||
+                    HasHeader(inPtr, inLen, "\nconnection: close")) {
+                mCloseFlag = true;
+            }
+            const bool theHeadFlag =
+                theMethodLen == 4 && memcmp(theMethodPtr, "HEAD", 4) == 0;
+            if (! theHeadFlag && (theMethodLen != 3 ||
+                    memcmp(theMethodPtr, "GET", 3) != 0)) {
+                Respond(405, "Method Not Allowed", false);
+                mCloseFlag = true;
+                return;
+            }
+            if ((thePathLen != 1 || *thePathPtr != '/') &&
+                    (thePathLen != 8 ||
+                        memcmp(thePathPtr, "/metrics", 8) != 0)) {
+                Respond(404, "Not Found", false);
+                return;
+            }
+            Respond(200, "OK", ! theHeadFlag);
+        }
+        static bool HasHeader(
+            const char* inPtr,
+            int         inLen,
+            const char* inHeaderPtr)
+        {
+            // Case insensitive search.
+            const int theLen = (int)strlen(inHeaderPtr);
+            for (int i = 0; i + theLen <= inLen; i++) {
+                int k = 0;
+                while (k < theLen &&
+                        tolower(inPtr[i + k] & 0xFF) == inHeaderPtr[k]) {
+                    k++;
+                }
+                if (k == theLen) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        void Respond(
+            int         inStatus,
+            const char* inReasonPtr,
+            bool        inContentFlag)
+        {
+            IOBuffer&   theOutBuf = mConnPtr->GetOutBuffer();
+            string&     theHdr    = mImpl.mResponseHeader;
+            QCStMutexLocker theLock(mImpl.mMutex);
+            const bool  theOkFlag = inStatus == 200;
+            if (theOkFlag) {
+                mImpl.mCounters.mRequestCount++;
+            } else {
+                mImpl.mCounters.mBadRequestCount++;
+            }
+            const int theContentLen = theOkFlag ?
+                (int)mImpl.mSnapshot.size() : 0;
+            theHdr = "HTTP/1.1 ";
+            AppendDecIntToString(theHdr, inStatus);
+            theHdr += ' ';
+            theHdr += inReasonPtr;
+            theHdr += "\r\n";
+            if (theOkFlag) {
+                theHdr += "Content-Type: application/openmetrics-text;"
+                    " version=1.0.0; charset=utf-8\r\n";
+            }
+            theHdr += "Content-Length: ";
+            AppendDecIntToString(theHdr, theContentLen);
+            theHdr += "\r\n";
+            if (mCloseFlag) {
+                theHdr += "Connection: close\r\n";
+            }
+            theHdr += "\r\n";
+            theOutBuf.CopyIn(theHdr.data(), (int)theHdr.size());
+            mImpl.mCounters.mBytesSentCount += theHdr.size();
+            if (inContentFlag && 0 < theContentLen) {
+                theOutBuf.CopyIn(mImpl.mSnapshot.data(), theContentLen);
+                mImpl.mCounters.mBytesSentCount += theContentLen;
+            }
+        }
+    private:
+        Connection(
+            const Connection& inConnection);
+        Connection& operator=(
+            const Connection& inConnection);
+    };
+    friend class Connection;
+
+    mutable QCMutex mMutex;
+    string          mSnapshot;
+    Counters        mCounters;
+    NetManager      mNetManager;
+    Acceptor*       mAcceptorPtr;
+    QCThread        mThread;
+    bool            mStopFlag;
+    int             mMaxConnectionCount;
+    int             mIoTimeoutSec;
+    int             mConnectionCount;
+    string          mResponseHeader;
+    char            mHeaderBuf[kMaxHeaderLen];
+private:
+    Impl(
+        const Impl& inImpl);
+    Impl& operator=(
+        const Impl& inImpl);
+};
+
+MetricsServer::MetricsServer()
+    : mImpl(*(new Impl()))
+    {}
+
+MetricsServer::~MetricsServer()
+{
+    delete &mImpl;
+}
+
+    int
+MetricsServer::Start(
+    const ServerLocation& inLocation,
+    bool                  inIpV6OnlyFlag,
+    int                   inMaxConnectionCount,
+    int                   inIoTimeoutSec)
+{
+    return mImpl.Start(
+        inLocation, inIpV6OnlyFlag, inMaxConnectionCount, inIoTimeoutSec);
+}
+
+    void
+MetricsServer::Stop()
+{
+    mImpl.Stop();
+}
+
+    void
+MetricsServer::ChildAtFork()
+{
+    mImpl.ChildAtFork();
+}
+
+    bool
+MetricsServer::IsRunning() const
+{
+    return mImpl.IsRunning();
+}
+
+    int
+MetricsServer::GetPort() const
+{
+    return mImpl.GetPort();
+}
+
+    void
+MetricsServer::SetSnapshot(
+    string& ioText)
+{
+    mImpl.SetSnapshot(ioText);
+}
+
+    void
+MetricsServer::GetCounters(
+    MetricsServer::Counters& outCounters) const
+{
+    mImpl.GetCounters(outCounters);
+}
+
+}
@@ -0,0 +1,196 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief OpenMetrics (Prometheus) http scrape endpoint, and the metrics text
+// exposition builder.
+//
+// The server runs on its own thread with its own net manager, and serves the
+// last snapshot set by the owner. The snapshot is "pre-aggregated" by the
+// owner at its own pace, in order to keep the scrape cost independent of the
+// metrics collection cost, and off the owner's thread.
+//
+//----------------------------------------------------------------------------
+
+#ifndef KFSIO_METRICS_SERVER_H
+#define KFSIO_METRICS_SERVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <map>
+
+namespace KFS
+{
+using std::string;
+using std::map;
+
+class Properties;
+class CounterManager;
+struct ServerLocation;
+
+// Metrics text builder. Samples are grouped by metric family, as required by
+// the exposition format, therefore the samples of the same family can be
+// added in any order, for example per server samples one server at a time.
+class MetricsBuilder
+{
+public:
+    enum Type
+    {
+        kTypeGauge,
+        kTypeCounter
+    };
+    MetricsBuilder()
+        : mFamilies(),
+          mName()
+        {}
+    void Clear()
+        { mFamilies.clear(); }
+    bool IsEmpty() const
+        { return mFamilies.empty(); }
+    // The name prefix and the key are converted into metric name, by
+    // replacing all characters other than alpha numeric and underscore with
+    // underscore, and converting to lower case. Labels must be formatted with
+    // AppendLabel(), or empty. Counter samples get _total suffix.
+    void Add(
+        const char* inPrefixPtr,
+        const char* inKeyPtr,
+        const char* inLabelsPtr,
+        int64_t     inValue,
+        Type        inType = kTypeGauge);
+    void Add(
+        const char* inPrefixPtr,
+        const char* inKeyPtr,
+        const char* inLabelsPtr,
+        double      inValue,
+        Type        inType = kTypeGauge);
+    // Add "key<delimiter> value" lines, one gauge per line, as produced by
+    // the stats and heartbeat responses. Non numeric values are skipped.
+    void AddKeyValues(
+        const char* inPrefixPtr,
+        const char* inLabelsPtr,
+        const char* inTextPtr,
+        size_t      inTextLen,
+        char        inDelimiter = ':');
+    // Add properties with numeric values as gauges.
+    void AddProperties(
+        const char*       inPrefixPtr,
+        const char*       inLabelsPtr,
+        const Properties& inProps);
+    // Add counter manager counters: count and time in seconds.
+    void AddCounters(
+        const char*           inPrefixPtr,
+        const char*           inLabelsPtr,
+        const CounterManager& inCounters);
+    // Appends the exposition text terminated with "# EOF" line.
+    void Write(
+        string& ioText) const;
+    // Append name="value" label to the label list, escaping the value.
+    static string& AppendLabel(
+        string&     ioLabels,
+        const char* inNamePtr,
+        const char* inValuePtr,
+        size_t      inValueLen);
+    static string& AppendLabel(
+        string&       ioLabels,
+        const char*   inNamePtr,
+        const string& inValue)
+    {
+        return AppendLabel(
+            ioLabels, inNamePtr, inValue.data(), inValue.size());
+    }
+private:
+    struct Family
+    {
+        Family()
+            : mType(kTypeGauge),
+              mSamples()
+            {}
+        Type   mType;
+        string mSamples;
+    };
+    typedef map<string, Family> Families;
+
+    Families mFamilies;
+    string   mName;
+
+    string& AddSample(
+        const char* inPrefixPtr,
+        const char* inKeyPtr,
+        size_t      inKeyLen,
+        const char* inLabelsPtr,
+        Type        inType);
+};
+
+class MetricsServer
+{
+public:
+    struct Counters
+    {
+        typedef int64_t Counter;
+
+        Counters()
+            : mAcceptCount(0),
+              mRejectCount(0),
+              mRequestCount(0),
+              mBadRequestCount(0),
+              mBytesSentCount(0)
+            {}
+        Counter mAcceptCount;
+        Counter mRejectCount;
+        Counter mRequestCount;
+        Counter mBadRequestCount;
+        Counter mBytesSentCount;
+    };
+    MetricsServer();
+    ~MetricsServer();
+    // Bind to the location, and start the server thread. Returns 0 on
+    // success, or negative error code.
+    int Start(
+        const ServerLocation& inLocation,
+        bool                  inIpV6OnlyFlag,
+        int                   inMaxConnectionCount,
+        int                   inIoTimeoutSec);
+    void Stop();
+    // Close the listener and connections in the forked child process, the
+    // child must not call Stop(), as the server thread does not exist there.
+    void ChildAtFork();
+    bool IsRunning() const;
+    int GetPort() const;
+    // Replace the snapshot served with the text, the text content is swapped
+    // with the previous snapshot.
+    void SetSnapshot(
+        string& ioText);
+    void GetCounters(
+        Counters& outCounters) const;
+private:
+    class Impl;
+    Impl& mImpl;
+private:
+    MetricsServer(
+        const MetricsServer& inServer);
+    MetricsServer& operator=(
+        const MetricsServer& inServer);
+};
+
+}
+
+#endif /* KFSIO_METRICS_SERVER_H */
@@ -32,11 +32,32 @@
 
 #include <cerrno>
 #include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#ifdef KFS_OS_NAME_LINUX
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <string.h>
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && \
+    defined(SO_EE_ORIGIN_ZEROCOPY)
+#define KFS_NET_CONNECTION_ZERO_COPY
+#endif
+#endif
+
+#ifdef KFS_NET_CONNECTION_ZERO_COPY
+#include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
+#endif
 
 namespace KFS
 {
 
 using namespace KFS::libkfsio;
+using std::min;
+
+int NetConnection::sZeroCopyMinSize = -1;
 
 #ifndef NET_CONNECTION_LOG_STREAM_DEBUG
 #define NET_CONNECTION_LOG_STREAM_DEBUG \
@@ -68,6 +89,7 @@ NetConnection::HandleReadEvent(int maxAcceptsPerRead /* = 1 */)
                     conn->Update();
                 }
             } else {
+                mNetManagerEntry.SetReadDrained();
                 if (i == 0 || IsFatalError(err)) {
                     NET_CONNECTION_LOG_STREAM_DEBUG <<
                         " accept failure: " << QCUtils::SysError(err) <<
@@ -83,6 +105,12 @@ NetConnection::HandleReadEvent(int maxAcceptsPerRead /* = 1 */)
         const int nread = mFilter ?
             mFilter->Read(*this, *mSock, mInBuffer, maxReadAhead) : 
             mInBuffer.Read(mSock->GetFd(), maxReadAhead);
+        // Short read, or no data means that the socket has no more data
+        // available for now. The filter might stop reading for other reasons.
+        if (! mFilter && (nread == -EAGAIN || nread == -EWOULDBLOCK ||
+                (0 < nread && (maxReadAhead < 0 || nread < maxReadAhead)))) {
+            mNetManagerEntry.SetReadDrained();
+        }
         if (nread <= 0 && IsFatalError(-nread)) {
             if (nread != 0) {
                 GetErrorMsg();
@@ -114,11 +142,14 @@ NetConnection::HandleWriteEvent()
     if (IsGood()) {
         mTryWrite = false; // Reset to prevent possible recursion.
         bool forceInvokeErrHandlerFlag = false;
-        nwrote = WantWrite() ? (mFilter ?
+        nwrote = WantWrite() ? ((mFilter && ! mFilter->IsWriteThrough()) ?
             mFilter->Write(*this, *mSock, mOutBuffer,
                 forceInvokeErrHandlerFlag) :
-            mOutBuffer.Write(mSock->GetFd())
+            WriteOut()
         ) : 0;
+        if (! mFilter && (nwrote == -EAGAIN || nwrote == -EWOULDBLOCK)) {
+            mNetManagerEntry.SetWriteBlocked();
+        }
         if (nwrote < 0 && IsFatalError(-nwrote)) {
             GetErrorMsg();
             IsAuthFailure();
@@ -142,13 +173,316 @@ NetConnection::HandleWriteEvent()
     Update(nwrote != 0);
 }
 
+int
+NetConnection::WriteOut()
+{
+    const int fd = mSock->GetFd();
+    if (mFileSends.empty()) {
+        if (0 < sZeroCopyMinSize && 0 <= mZeroCopyState && ! mFilter &&
+                sZeroCopyMinSize <= mOutBuffer.BytesConsumable()) {
+            return WriteZeroCopy(fd);
+        }
+        return mOutBuffer.Write(fd);
+    }
+    int total = 0;
+    int nwr   = 0;
+    for (; ;) {
+        if (mFileSends.empty()) {
+            if (! mOutBuffer.IsEmpty() && 0 < (nwr = mOutBuffer.Write(fd))) {
+                total += nwr;
+            }
+            break;
+        }
+        FileSend& fs = mFileSends.front();
+        if (0 < fs.mOutBytes && mOutBuffer.IsEmpty()) {
+            // Out buffer was modified externally, send the file range now.
+            mFileSendOutBytes -= fs.mOutBytes;
+            fs.mOutBytes = 0;
+        }
+        if (0 < fs.mOutBytes) {
+            if ((nwr = mOutBuffer.Write(fd, fs.mOutBytes)) <= 0) {
+                break;
+            }
+            total             += nwr;
+            fs.mOutBytes      -= nwr;
+            mFileSendOutBytes -= nwr;
+            if (0 < fs.mOutBytes) {
+                break; // Socket buffer is full.
+            }
+            continue;
+        }
+        if ((nwr = SendFile(fd, fs)) <= 0) {
+            break;
+        }
+        total          += nwr;
+        mFileSendBytes -= nwr;
+        if (0 < fs.mNumBytes) {
+            break;
+        }
+        close(fs.mFd);
+        mFileSends.pop_front();
+    }
+    return (0 < total ? total : nwr);
+}
+
+int
+NetConnection::SendFile(int fd, FileSend& fileSend)
+{
+#ifdef KFS_OS_NAME_LINUX
+    const int64_t kMaxSendSize = 1 << 20;
+    off_t         offset       = (off_t)fileSend.mOffset;
+    const ssize_t nwr          = sendfile(fd, fileSend.mFd, &offset,
+        (size_t)min(kMaxSendSize, fileSend.mNumBytes));
+    if (nwr < 0) {
+        return (errno == 0 ? -EAGAIN : -errno);
+    }
+    if (nwr == 0) {
+        // File is shorter than the range queued, the data promised to the
+        // peer can not be delivered.
+        KFS_LOG_STREAM_ERROR << "netconn: " << fd <<
+            " sendfile: unexpected end of file:"
+            " offset: " << fileSend.mOffset <<
+            " remaining: " << fileSend.mNumBytes <<
+        KFS_LOG_EOM;
+        return -EIO;
+    }
+    fileSend.mOffset   += nwr;
+    fileSend.mNumBytes -= nwr;
+    globals().ctrNetBytesWritten.Update(nwr);
+    return (int)nwr;
+#else
+    return -ENOSYS;
+#endif
+}
+
+void
+NetConnection::ClearFileSends()
+{
+    while (! mFileSends.empty()) {
+        close(mFileSends.front().mFd);
+        mFileSends.pop_front();
+    }
+    mFileSendBytes    = 0;
+    mFileSendOutBytes = 0;
+}
+
+/* static */ bool
+NetConnection::IsFileSendSupported()
+{
+#ifdef KFS_OS_NAME_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+/* static */ bool
+NetConnection::IsZeroCopySupported()
+{
+#ifdef KFS_NET_CONNECTION_ZERO_COPY
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef KFS_NET_CONNECTION_ZERO_COPY
+// Zero copy sent buffers of the closed connections, with possibly not yet
+// transmitted data. The buffers are released after the linger time, in order
+// to prevent buffer re-use while the kernel might still reference the data.
+class NetConnectionZeroCopyLinger
+{
+public:
+    static void Add(IOBuffer& buf)
+        { sInstance.AddSelf(buf); }
+private:
+    enum { kLingerTimeSec = 15 * 60 };
+    typedef std::pair<time_t, IOBuffer*> Entry;
+    typedef deque<Entry>                 Entries;
+
+    QCMutex mMutex;
+    Entries mEntries;
+
+    NetConnectionZeroCopyLinger()
+        : mMutex(),
+          mEntries()
+        {}
+    ~NetConnectionZeroCopyLinger()
+    {
+        while (! mEntries.empty()) {
+            delete mEntries.front().second;
+            mEntries.pop_front();
+        }
+    }
+    void AddSelf(IOBuffer& buf)
+    {
+        IOBuffer* const theBufPtr = new IOBuffer();
+        theBufPtr->Move(&buf);
+        const time_t now = time(0);
+        QCStMutexLocker lock(mMutex);
+        while (! mEntries.empty() && mEntries.front().first <= now) {
+            delete mEntries.front().second;
+            mEntries.pop_front();
+        }
+        mEntries.push_back(Entry(now + kLingerTimeSec, theBufPtr));
+    }
+    static NetConnectionZeroCopyLinger sInstance;
+};
+NetConnectionZeroCopyLinger NetConnectionZeroCopyLinger::sInstance;
+#endif
+
+int
+NetConnection::WriteZeroCopy(int fd)
+{
+#ifdef KFS_NET_CONNECTION_ZERO_COPY
+    // Bound the number of zero copy sends in flight, and the amount of
+    // pinned buffers.
+    const size_t kMaxZeroCopySends = 256;
+    if (mZeroCopyState == 0) {
+        const int on = 1;
+        mZeroCopyState = setsockopt(
+            fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0 ? 1 : -1;
+        if (mZeroCopyState < 0) {
+            NET_CONNECTION_LOG_STREAM_DEBUG <<
+                QCUtils::SysError(errno, "SO_ZEROCOPY") <<
+            KFS_LOG_EOM;
+        }
+    }
+    if (! mZeroCopySends.empty()) {
+        ZeroCopyCompletions();
+    }
+    if (mZeroCopyState < 0 || kMaxZeroCopySends <= mZeroCopySends.size()) {
+        return mOutBuffer.Write(fd);
+    }
+    const int    kMaxWriteBufs = 64;
+    struct iovec writeVec[kMaxWriteBufs];
+    int          nVec = 0;
+    for (IOBuffer::iterator it = mOutBuffer.begin();
+            it != mOutBuffer.end() && nVec < kMaxWriteBufs;
+            ++it) {
+        const int nBytes = it->BytesConsumable();
+        if (nBytes <= 0) {
+            continue;
+        }
+        writeVec[nVec].iov_base = const_cast<char*>(it->Consumer());
+        writeVec[nVec].iov_len  = (size_t)nBytes;
+        nVec++;
+    }
+    if (nVec <= 0) {
+        return 0;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = writeVec;
+    msg.msg_iovlen = nVec;
+    const ssize_t nWr = sendmsg(fd, &msg, MSG_ZEROCOPY);
+    if (nWr <= 0) {
+        const int err = errno;
+        if (nWr < 0 && err == ENOBUFS) {
+            // Socket option memory limit reached, use regular send.
+            return mOutBuffer.Write(fd);
+        }
+        return (nWr == 0 ? 0 : (err == 0 ? -EAGAIN : -err));
+    }
+    mZeroCopySends.push_back(ZeroCopySend((int)nWr));
+    mZeroCopyBuf.Move(&mOutBuffer, (int)nWr);
+    globals().ctrNetBytesWritten.Update(nWr);
+    globals().ctrNetZeroCopyBytesWritten.Update(nWr);
+    return (int)nWr;
+#else
+    mZeroCopyState = -1;
+    return mOutBuffer.Write(fd);
+#endif
+}
+
+bool
+NetConnection::ZeroCopyCompletions()
+{
+    bool ret = false;
+#ifdef KFS_NET_CONNECTION_ZERO_COPY
+    if (! mSock) {
+        return ret;
+    }
+    const int fd = mSock->GetFd();
+    for (; ;) {
+        char          control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+            break;
+        }
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+                cm;
+                cm = CMSG_NXTHDR(&msg, cm)) {
+            if (! ((cm->cmsg_level == SOL_IP &&
+                        cm->cmsg_type == IP_RECVERR) ||
+                    (cm->cmsg_level == SOL_IPV6 &&
+                        cm->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            const struct sock_extended_err& se =
+                *reinterpret_cast<const struct sock_extended_err*>(
+                    CMSG_DATA(cm));
+            if (se.ee_errno != 0 || se.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            if ((se.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0) {
+                globals().ctrNetZeroCopySendsCopied.Update(1);
+            }
+            // Completion range is inclusive, and completions might arrive out
+            // of order.
+            const uint32_t lo = se.ee_info - mZeroCopySeq;
+            uint32_t       hi = se.ee_data - mZeroCopySeq;
+            if (hi < lo || mZeroCopySends.size() <= lo) {
+                continue;
+            }
+            hi = min(hi, uint32_t(mZeroCopySends.size() - 1));
+            for (uint32_t i = lo; i <= hi; i++) {
+                mZeroCopySends[i].mDoneFlag = true;
+            }
+            ret = true;
+        }
+    }
+    while (! mZeroCopySends.empty() && mZeroCopySends.front().mDoneFlag) {
+        mZeroCopyBuf.Consume(mZeroCopySends.front().mByteCount);
+        mZeroCopySends.pop_front();
+        mZeroCopySeq++;
+    }
+#endif
+    return ret;
+}
+
+void
+NetConnection::ZeroCopyClose()
+{
+    ZeroCopyCompletions();
+    if (mZeroCopySends.empty()) {
+        return;
+    }
+#ifdef KFS_NET_CONNECTION_ZERO_COPY
+    NetConnectionZeroCopyLinger::Add(mZeroCopyBuf);
+#endif
+    mZeroCopyBuf.Clear();
+    mZeroCopySends.clear();
+}
+
 void
 NetConnection::HandleErrorEvent()
 {
     if (IsGood()) {
+        // Zero copy send completions are reported via socket error queue.
+        const bool zeroCopyFlag = ! mZeroCopySends.empty() &&
+            ZeroCopyCompletions();
+        const int  sockErr      = GetSocketError();
+        if (zeroCopyFlag && sockErr == 0) {
+            Update();
+            return;
+        }
         GetErrorMsg();
         IsAuthFailure();
-        int status = mAuthFailureFlag ? -EPERM : -GetSocketError();
+        int status = mAuthFailureFlag ? -EPERM : -sockErr;
         NET_CONNECTION_LOG_STREAM_DEBUG <<
             "closing connection due to error" <<
             (mAuthFailureFlag ? " auth failure" : "") <<
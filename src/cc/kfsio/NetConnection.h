@@ -38,11 +38,13 @@
 #include <errno.h>
 
 #include <list>
+#include <deque>
 #include <boost/shared_ptr.hpp>
 
 namespace KFS
 {
 using std::list;
+using std::deque;
 using std::string;
 
 class NetManager;
@@ -110,6 +112,10 @@ public:
             { return false; }
         virtual string GetPeerId() const
             { return string(); }
+        /// Returns true if the data can presently be written directly into
+        /// the socket, bypassing the filter, for example with kernel tls.
+        virtual bool IsWriteThrough() const
+            { return false; }
         bool IsReadPending() const
             { return mReadPendingFlag; }
     protected:
@@ -139,7 +145,14 @@ public:
           maxReadAhead(-1),
           mPeerName(),
           mLstErrorMsg(),
-          mFilter(filter) {
+          mFilter(filter),
+          mFileSends(),
+          mFileSendBytes(0),
+          mFileSendOutBytes(0),
+          mZeroCopyBuf(),
+          mZeroCopySends(),
+          mZeroCopySeq(0),
+          mZeroCopyState(0) {
         assert(mSock);
     }
 
@@ -151,6 +164,12 @@ public:
         if (mFilter == filter) {
             return 0;
         }
+        if (filter && ! mFileSends.empty()) {
+            if (outErrMsg) {
+                *outErrMsg = "file send is in progress";
+            }
+            return -EINVAL;
+        }
         if (mFilter) {
             mFilter->Detach(*this, mSock);
         }
@@ -160,12 +179,17 @@ public:
 
     ~NetConnection() {
         NetConnection::Close();
+        ClearFileSends();
     }
 
     void SetOwningKfsCallbackObj(KfsCallbackObj* c) {
         mCallbackObj = c;
     }
 
+    KfsCallbackObj* GetOwningKfsCallbackObj() const {
+        return mCallbackObj;
+    }
+
     void EnableReadIfOverloaded() {
         mNetManagerEntry.EnableReadIfOverloaded();
         Update(false);
@@ -220,12 +244,12 @@ public:
 
     /// Is data available for writing?
     bool IsWriteReady() const {
-        return (! mOutBuffer.IsEmpty());
+        return (! mOutBuffer.IsEmpty() || ! mFileSends.empty());
     }
 
     /// # of bytes available for writing(false),
     int GetNumBytesToWrite() const {
-        return mOutBuffer.BytesConsumable();
+        return (mOutBuffer.BytesConsumable() + (int)mFileSendBytes);
     }
 
     /// Is the connection still good?
@@ -296,6 +320,45 @@ public:
     }
 
     /// Enqueue data to be sent out.
+    /// Returns true if file ranges can be sent with WriteFile(). File send
+    /// bypasses the filter, and therefore is not supported with the filter,
+    /// unless the filter is write through.
+    bool CanWriteFile() const {
+        return ((! mFilter || mFilter->IsWriteThrough()) &&
+            IsGood() && IsFileSendSupported());
+    }
+
+    static bool IsFileSendSupported();
+
+    /// Use MSG_ZEROCOPY send with no filter, when the out buffer has at least
+    /// the specified number of bytes. The sent buffers are kept until the
+    /// kernel reports send completion. Negative value disables zero copy.
+    static void SetZeroCopyMinSize(int size)
+        { sZeroCopyMinSize = size; }
+    static int GetZeroCopyMinSize()
+        { return sZeroCopyMinSize; }
+    static bool IsZeroCopySupported();
+
+    /// Queue file range for sending right after the data that is presently
+    /// in the out buffer, without copying file data into the io buffers.
+    /// On success the connection takes the ownership of the file descriptor,
+    /// and closes it when the range is sent, or the connection is closed. The
+    /// file must not be truncated while the range is being sent.
+    bool WriteFile(int fd, int64_t offset, int64_t numBytes,
+            bool resetTimerFlag = true) {
+        if (fd < 0 || offset < 0 || numBytes <= 0 || ! CanWriteFile()) {
+            return false;
+        }
+        const bool resetTimer = resetTimerFlag && ! IsWriteReady();
+        const int  outBytes   =
+            mOutBuffer.BytesConsumable() - mFileSendOutBytes;
+        mFileSends.push_back(FileSend(fd, offset, numBytes, outBytes));
+        mFileSendBytes    += numBytes;
+        mFileSendOutBytes += outBytes;
+        Update(resetTimer);
+        return true;
+    }
+
     void Write(const char *data, int numBytes, bool resetTimerFlag = true) {
         const bool resetTimer = resetTimerFlag && mOutBuffer.IsEmpty();
         if (mOutBuffer.CopyIn(data, numBytes) > 0) {
@@ -338,11 +401,15 @@ public:
         }
         // To avoid race with file descriptor number re-use by the OS,
         // remove the socket from poll set first, then close the socket.
+        if (! mZeroCopySends.empty()) {
+            ZeroCopyClose();
+        }
         TcpSocket* const sock = mOwnsSocket ? mSock : 0;
         mSock = 0;
         // Clear data that can not be sent, but keep input data if any.
         if (clearOutBufferFlag) {
             mOutBuffer.Clear();
+            ClearFileSends();
         }
         Update();
         if (sock) {
@@ -389,6 +456,7 @@ public:
 
     void DiscardWrite() {
         mOutBuffer.Clear();
+        ClearFileSends();
         Update();
     }
 
@@ -439,6 +507,9 @@ public:
               mPendingUpdateFlag(false),
               mPendingCloseFlag(false),
               mPendingResetTimerFlag(false),
+              mEdgeFlag(false),
+              mReadReadyFlag(false),
+              mWriteReadyFlag(false),
               mFd(-1),
               mWriteByteCount(0),
               mTimerWheelSlot(-1),
@@ -456,6 +527,10 @@ public:
         bool IsAdded() const              { return mAdded; }
         bool IsPendingClose() const       { return mPendingCloseFlag; }
         time_t TimeNow() const;
+        // With edge triggered poll the socket stays ready until read or
+        // write reports that no more data can be transferred.
+        void SetReadDrained()             { mReadReadyFlag  = false; }
+        void SetWriteBlocked()            { mWriteReadyFlag = false; }
 
     private:
         bool             mIn:1;
@@ -468,6 +543,9 @@ public:
         bool             mPendingUpdateFlag:1;
         bool             mPendingCloseFlag:1;
         bool             mPendingResetTimerFlag:1;
+        bool             mEdgeFlag:1;
+        bool             mReadReadyFlag:1;
+        bool             mWriteReadyFlag:1;
         int              mFd;
         int              mWriteByteCount;
         int              mTimerWheelSlot;
@@ -527,6 +605,51 @@ private:
     string          mPeerName;
     string          mLstErrorMsg;
     Filter*         mFilter;
+    /// File ranges queued by WriteFile(), each one preceded by mOutBytes from
+    /// the out buffer.
+    struct FileSend
+    {
+        FileSend(int fd, int64_t offset, int64_t numBytes, int outBytes)
+            : mFd(fd),
+              mOffset(offset),
+              mNumBytes(numBytes),
+              mOutBytes(outBytes)
+            {}
+        int     mFd;
+        int64_t mOffset;
+        int64_t mNumBytes;
+        int     mOutBytes;
+    };
+    typedef list<FileSend> FileSends;
+    FileSends       mFileSends;
+    int64_t         mFileSendBytes;
+    int             mFileSendOutBytes;
+    /// Data sent with MSG_ZEROCOPY, and the byte counts of the corresponding
+    /// sends, in the send order, starting from mZeroCopySeq zero copy
+    /// completion sequence number.
+    struct ZeroCopySend
+    {
+        ZeroCopySend(int byteCount)
+            : mByteCount(byteCount),
+              mDoneFlag(false)
+            {}
+        int  mByteCount;
+        bool mDoneFlag;
+    };
+    typedef deque<ZeroCopySend> ZeroCopySends;
+    IOBuffer        mZeroCopyBuf;
+    ZeroCopySends   mZeroCopySends;
+    uint32_t        mZeroCopySeq;
+    int             mZeroCopyState;
+
+    static int sZeroCopyMinSize;
+
+    int WriteOut();
+    int SendFile(int fd, FileSend& fileSend);
+    void ClearFileSends();
+    int WriteZeroCopy(int fd);
+    bool ZeroCopyCompletions();
+    void ZeroCopyClose();
 
     friend class NetManagerEntry;
 private:
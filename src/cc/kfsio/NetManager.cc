@@ -43,12 +43,70 @@
 #include "qcdio/QCMutex.h"
 #include "qcdio/qcstutils.h"
 
+#include <typeinfo>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
+
 namespace KFS
 {
 using std::min;
 using std::max;
 using std::numeric_limits;
 
+int64_t NetManager::sSlowDispatchThresholdUsec = -1;
+bool    NetManager::sEdgeTriggeredPollFlag     = false;
+
+void
+NetManager::EventStats::Clear()
+{
+    mLoopCount         = 0;
+    mLoopMaxUsec       = 0;
+    mDispatchCount     = 0;
+    mDispatchMaxUsec   = 0;
+    mSlowDispatchCount = 0;
+    for (int i = 0; i < kHistogramSize; i++) {
+        mLoopHistogram[i]     = 0;
+        mDispatchHistogram[i] = 0;
+    }
+}
+
+void
+NetManager::EventStats::Add(const NetManager::EventStats& stats)
+{
+    mLoopCount         += stats.mLoopCount;
+    mLoopMaxUsec        = max(mLoopMaxUsec, stats.mLoopMaxUsec);
+    mDispatchCount     += stats.mDispatchCount;
+    mDispatchMaxUsec    = max(mDispatchMaxUsec, stats.mDispatchMaxUsec);
+    mSlowDispatchCount += stats.mSlowDispatchCount;
+    for (int i = 0; i < kHistogramSize; i++) {
+        mLoopHistogram[i]     += stats.mLoopHistogram[i];
+        mDispatchHistogram[i] += stats.mDispatchHistogram[i];
+    }
+}
+
+ostream&
+NetManager::EventStats::Display(ostream& os, const char* prefix) const
+{
+    const char* const pref = prefix ? prefix : "";
+    os <<
+        pref << "Loop-count: "          << mLoopCount         << "\r\n" <<
+        pref << "Loop-max-usec: "       << mLoopMaxUsec       << "\r\n" <<
+        pref << "Loop-hist:";
+    for (int i = 0; i < kHistogramSize; i++) {
+        os << (0 < i ? "," : " ") << mLoopHistogram[i];
+    }
+    os << "\r\n" <<
+        pref << "Dispatch-count: "      << mDispatchCount     << "\r\n" <<
+        pref << "Dispatch-max-usec: "   << mDispatchMaxUsec   << "\r\n" <<
+        pref << "Dispatch-slow-count: " << mSlowDispatchCount << "\r\n" <<
+        pref << "Dispatch-hist:";
+    for (int i = 0; i < kHistogramSize; i++) {
+        os << (0 < i ? "," : " ") << mDispatchHistogram[i];
+    }
+    return (os << "\r\n");
+}
+
 NetManager::NetManager(int timeoutMs)
     : mRemove(),
       mTimerWheelBucketItr(mRemove.end()),
@@ -65,6 +123,7 @@ NetManager::NetManager(int timeoutMs)
       mTimeoutMs(timeoutMs),
       mStartTime(time(0)),
       mNow(mStartTime),
+      mPollTime(mNow),
       mLastTimerTime(mNow - 1),
       mMaxOutgoingBacklog(0),
       mNumBytesToSend(0),
@@ -76,6 +135,7 @@ NetManager::NetManager(int timeoutMs)
       mPendingReadList(),
       mPendingUpdate(),
       mCurTimeoutHandler(0),
+      mTimeoutHandlersNextRunMs(numeric_limits<int64_t>::max()),
       mEpollError()
 {
     TimeoutHandlers::Init(mTimeoutHandlers);
@@ -128,7 +188,65 @@ NetManager::RegisterTimeoutHandler(ITimeout* handler)
 {
     if (handler) {
         TimeoutHandlers::PushBack(mTimeoutHandlers, *handler);
+        UpdateTimeoutHandlersNextRun(*handler, handler->mLastCall);
+    }
+}
+
+inline void
+NetManager::UpdateTimeoutHandlersNextRun(
+    const ITimeout& handler, int64_t lastCallMs)
+{
+    // Handlers with no interval are invoked on every poll return, and do not
+    // affect poll timeout.
+    if (! handler.mDisabled && 0 < handler.mIntervalMs) {
+        mTimeoutHandlersNextRunMs = min(mTimeoutHandlersNextRunMs,
+            lastCallMs + handler.mIntervalMs);
+    }
+}
+
+inline int
+NetManager::GetPollTimeoutMs() const
+{
+    if (PendingReadList::IsInList(mPendingReadList)) {
+        return 0;
+    }
+    if (mTimeoutHandlersNextRunMs == numeric_limits<int64_t>::max()) {
+        return mTimeoutMs;
+    }
+    const int64_t rem = mTimeoutHandlersNextRunMs - ITimeout::NowMs();
+    return (rem <= 0 ? 0 : (int)min(int64_t(mTimeoutMs), rem));
+}
+
+inline void
+NetManager::DispatchDone(int64_t& startUsec, const char* typeName,
+    const char* eventName, int pollOp)
+{
+    const int64_t now  = microseconds();
+    const int64_t usec = now - startUsec;
+    startUsec = now;
+    mEventStats.mDispatchCount++;
+    EventStats::Update(mEventStats.mDispatchHistogram,
+        mEventStats.mDispatchMaxUsec, usec);
+    if (sSlowDispatchThresholdUsec < 0 || usec <= sSlowDispatchThresholdUsec) {
+        return;
     }
+    mEventStats.mSlowDispatchCount++;
+    const char* name      = typeName ? typeName : "none";
+    char*       demangled = 0;
+#ifdef __GNUC__
+    int status = -1;
+    demangled = abi::__cxa_demangle(name, 0, 0, &status);
+    if (demangled && status == 0) {
+        name = demangled;
+    }
+#endif
+    KFS_LOG_STREAM_INFO <<
+        "slow dispatch: " << name <<
+        " event: "        << eventName <<
+        " poll: "         << pollOp <<
+        " usec: "         << usec <<
+    KFS_LOG_EOM;
+    free(demangled);
 }
 
 void
@@ -313,7 +431,34 @@ NetManager::UpdateSelf(NetConnection::NetManagerEntry& entry, int fd,
     const bool in  = (! mIsOverloaded || entry.mEnableReadIfOverloaded) &&
         conn.WantRead();
     const bool out = entry.mConnectPending || conn.WantWrite();
-    if (in != entry.mIn || out != entry.mOut) {
+    const bool edge = sEdgeTriggeredPollFlag && ! conn.GetFilter();
+    if (0 <= entry.mFd &&
+            (edge != entry.mEdgeFlag || (edge && fd != entry.mFd))) {
+        PollRemove(entry.mFd);
+        entry.mFd  = -1;
+        entry.mIn  = false;
+        entry.mOut = false;
+    }
+    if (edge) {
+        // The fd stays in the poll set until the connection is closed.
+        if (entry.mFd < 0 && (in || out)) {
+            assert(fd >= 0);
+            if (CheckFatalPollSysError(
+                    mPoll.Add(fd,
+                        QCFdPoll::kOpTypeIn + QCFdPoll::kOpTypeOut +
+                        QCFdPoll::kOpTypeEdgeTriggered, &conn),
+                    "failed to add fd to poll set") != 0) {
+                UpdateSelf(entry, fd, false, true);
+                return; // Tail recursion
+            }
+            entry.mFd             = fd;
+            entry.mEdgeFlag       = true;
+            entry.mReadReadyFlag  = false;
+            entry.mWriteReadyFlag = false;
+        }
+        entry.mIn  = in  && entry.mFd >= 0;
+        entry.mOut = out && entry.mFd >= 0;
+    } else if (in != entry.mIn || out != entry.mOut) {
         assert(fd >= 0);
         const int op =
             (in ? QCFdPoll::kOpTypeIn : 0) + (out ? QCFdPoll::kOpTypeOut : 0);
@@ -326,7 +471,8 @@ NetManager::UpdateSelf(NetConnection::NetManagerEntry& entry, int fd,
                 if (CheckFatalPollSysError(
                         mPoll.Add(fd, op, &conn),
                         "failed to add fd to poll set") == 0) {
-                    entry.mFd = fd;
+                    entry.mFd       = fd;
+                    entry.mEdgeFlag = false;
                 } else {
                     UpdateSelf(entry, fd, false, true);
                     return; // Tail recursion
@@ -344,7 +490,12 @@ NetManager::UpdateSelf(NetConnection::NetManagerEntry& entry, int fd,
         entry.mIn  = in  && entry.mFd >= 0;
         entry.mOut = out && entry.mFd >= 0;
     }
-    if (conn.IsReadPending()) {
+    // With edge triggered poll, dispatch the ready connection without
+    // waiting for the poll event, as the event will only be reported when
+    // the socket readiness changes.
+    if (conn.IsReadPending() || (entry.mEdgeFlag &&
+            ((entry.mIn && entry.mReadReadyFlag) ||
+            (entry.mOut && entry.mWriteReadyFlag)))) {
         PendingReadList::Insert(
             entry, PendingReadList::GetPrev(mPendingReadList));
     } else {
@@ -352,6 +503,12 @@ NetManager::UpdateSelf(NetConnection::NetManagerEntry& entry, int fd,
     }
 }
 
+/* static */ void
+NetManager::SetEdgeTriggeredPoll(bool flag)
+{
+    sEdgeTriggeredPollFlag = flag && QCFdPoll::IsEdgeTriggeredSupported();
+}
+
 void
 NetManager::Wakeup()
 {
@@ -375,6 +532,7 @@ NetManager::MainLoop(
         mRunFlag = true;
     }
     const int timerOverrunWarningTime(mTimeoutMs / (1000/2));
+    int64_t   loopStartUsec = -1;
     while (mRunFlag) {
         const bool wasOverloaded = mIsOverloaded;
         CheckIfOverloaded();
@@ -404,8 +562,12 @@ NetManager::MainLoop(
         if (dispatcher) {
             dispatcher->DispatchEnd();
         }
-        const int timeout = PendingReadList::IsInList(mPendingReadList) ?
-            0 : mTimeoutMs;
+        if (0 <= loopStartUsec) {
+            mEventStats.mLoopCount++;
+            EventStats::Update(mEventStats.mLoopHistogram,
+                mEventStats.mLoopMaxUsec, microseconds() - loopStartUsec);
+        }
+        const int timeout = GetPollTimeoutMs();
         const int fdCount = mConnectionsCount + 1;
         assert(mPendingUpdate.empty());
         mPollFlag = true;
@@ -418,8 +580,11 @@ NetManager::MainLoop(
         }
         unlocker.Lock();
         mPollFlag = false;
-        const int64_t nowMs = ITimeout::NowMs();
-        mNow = time_t(nowMs / 1000);
+        loopStartUsec = microseconds();
+        int64_t       dispatchStartUsec = loopStartUsec;
+        const int64_t nowMs             = loopStartUsec / 1000;
+        mNow      = time_t(nowMs / 1000);
+        mPollTime = mNow;
         for (PendingUpdate::const_iterator it = mPendingUpdate.begin();
                 it != mPendingUpdate.end();
                 ++it) {
@@ -430,6 +595,7 @@ NetManager::MainLoop(
         if (dispatcher) {
             dispatcher->DispatchStart();
         }
+        mTimeoutHandlersNextRunMs = numeric_limits<int64_t>::max();
         mCurTimeoutHandler = TimeoutHandlers::Front(mTimeoutHandlers);
         while (mCurTimeoutHandler) {
             ITimeout& cur = *mCurTimeoutHandler;
@@ -437,7 +603,20 @@ NetManager::MainLoop(
             if (mCurTimeoutHandler == TimeoutHandlers::Front(mTimeoutHandlers)) {
                 mCurTimeoutHandler = 0;
             }
-            cur.TimerExpired(nowMs);
+            // The handler might un-register and delete itself, compute its
+            // next run time prior to the invocation.
+            const bool expiredFlag = cur.mIntervalMs <= 0 ||
+                cur.mLastCall + cur.mIntervalMs <= nowMs;
+            UpdateTimeoutHandlersNextRun(cur,
+                expiredFlag ? nowMs : cur.mLastCall);
+            if (expiredFlag) {
+                const char* const typeName = typeid(cur).name();
+                dispatchStartUsec = microseconds();
+                cur.TimerExpired(nowMs);
+                DispatchDone(dispatchStartUsec, typeName, "timer");
+            } else {
+                cur.TimerExpired(nowMs);
+            }
         }
         // Move pending read list into temporary list, as the pending read might
         // change as a result of event dispatch.
@@ -452,12 +631,26 @@ NetManager::MainLoop(
                 continue;
             }
             NetConnection& conn = *reinterpret_cast<NetConnection*>(ptr);
-            if (! conn.GetNetManagerEntry()->mAdded) {
+            NetConnection::NetManagerEntry& entry = *conn.GetNetManagerEntry();
+            if (! entry.mAdded) {
                 // Skip stale event, the conection should be in mRemove list.
                 continue;
             }
+            if (entry.mEdgeFlag) {
+                const int kReadyMask = QCFdPoll::kOpTypeError |
+                    QCFdPoll::kOpTypeHup;
+                if ((op & (QCFdPoll::kOpTypeIn | kReadyMask)) != 0) {
+                    entry.mReadReadyFlag = true;
+                }
+                if ((op & (QCFdPoll::kOpTypeOut | kReadyMask)) != 0) {
+                    entry.mWriteReadyFlag = true;
+                }
+            }
             // Defer update for this connection.
             mCurConnection = &conn;
+            KfsCallbackObj* const obj = conn.GetOwningKfsCallbackObj();
+            const char* const typeName = obj ? typeid(*obj).name() : 0;
+            dispatchStartUsec = microseconds();
             if (mPollEventHook) {
                 mPollEventHook->Event(*this, conn, op);
             }
@@ -482,13 +675,31 @@ NetManager::MainLoop(
             // Update the connection.
             mCurConnection = 0;
             conn.Update();
+            DispatchDone(dispatchStartUsec, typeName, "poll", op);
         }
         // Process connections with pending read (inside filter).
         while (PendingReadList::IsInList(pendingRead)) {
             NetManagerEntry& cur = PendingReadList::GetNext(pendingRead);
             PendingReadList::Remove(cur);
             NetConnection& conn = **cur.mListIt;
-            conn.HandleReadEvent(mMaxAcceptsPerRead);
+            if (! cur.mEdgeFlag) {
+                conn.HandleReadEvent(mMaxAcceptsPerRead);
+                continue;
+            }
+            KfsCallbackObj* const obj = conn.GetOwningKfsCallbackObj();
+            const char* const typeName = obj ? typeid(*obj).name() : 0;
+            dispatchStartUsec = microseconds();
+            mCurConnection = &conn;
+            if (cur.mIn && cur.mReadReadyFlag && conn.IsGood()) {
+                conn.HandleReadEvent(mMaxAcceptsPerRead);
+            }
+            if (cur.mOut && cur.mWriteReadyFlag && conn.IsGood()) {
+                conn.HandleWriteEvent();
+            }
+            conn.StartFlush();
+            mCurConnection = 0;
+            conn.Update();
+            DispatchDone(dispatchStartUsec, typeName, "ready");
         }
         while (! mEpollError.empty()) {
             assert(mEpollError.front());
@@ -523,7 +734,11 @@ NetManager::MainLoop(
                     // No timeout, move it to the corresponding list.
                     UpdateTimer(entry, timeOut);
                 } else if (entry.mExpirationTime <= mNow) {
+                    KfsCallbackObj* const obj = conn.GetOwningKfsCallbackObj();
+                    const char* const typeName = obj ? typeid(*obj).name() : 0;
+                    dispatchStartUsec = microseconds();
                     conn.HandleTimeoutEvent();
+                    DispatchDone(dispatchStartUsec, typeName, "timeout");
                 } else {
                     // Not expired yet, move to the new slot, taking into the
                     // account possible timer overrun.
@@ -540,6 +755,9 @@ NetManager::MainLoop(
         mLastTimerTime = mNow;
         mTimerWheelBucketItr = mRemove.end();
         if (runOnceFlag) {
+            mEventStats.mLoopCount++;
+            EventStats::Update(mEventStats.mLoopHistogram,
+                mEventStats.mLoopMaxUsec, microseconds() - loopStartUsec);
             break;
         }
     }
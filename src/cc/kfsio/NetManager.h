@@ -35,6 +35,7 @@
 
 #include <list>
 #include <vector>
+#include <ostream>
 
 class QCFdPoll;
 class QCMutex;
@@ -43,6 +44,7 @@ namespace KFS
 {
 using std::list;
 using std::vector;
+using std::ostream;
 
 ///
 /// \file NetManager.h
@@ -73,6 +75,46 @@ public:
             {}
     };
     typedef NetConnection::NetManagerEntry NetManagerEntry;
+    /// Event loop iteration, and event dispatch, i.e. connection event and
+    /// timeout handler invocation, execution time histograms. Bucket i
+    /// upper bound is 16 << (2 * i) microseconds, the last bucket has no
+    /// upper bound.
+    struct EventStats
+    {
+        enum { kHistogramSize = 10 };
+        typedef int64_t Counter;
+
+        Counter mLoopCount;
+        Counter mLoopMaxUsec;
+        Counter mLoopHistogram[kHistogramSize];
+        Counter mDispatchCount;
+        Counter mDispatchMaxUsec;
+        Counter mSlowDispatchCount;
+        Counter mDispatchHistogram[kHistogramSize];
+
+        EventStats()
+            { Clear(); }
+        void Clear();
+        void Add(const EventStats& stats);
+        ostream& Display(ostream& os, const char* prefix) const;
+        static int GetHistogramBucket(int64_t usec)
+        {
+            int i = 0;
+            for (int64_t lim = 16; i < kHistogramSize - 1 && lim < usec;
+                    lim <<= 2) {
+                i++;
+            }
+            return i;
+        }
+        static void Update(Counter* histogram, Counter& maxUsec,
+                int64_t usec)
+        {
+            histogram[GetHistogramBucket(usec)]++;
+            if (maxUsec < usec) {
+                maxUsec = usec;
+            }
+        }
+    };
 
     NetManager(int timeoutMs = 1000);
     ~NetManager();
@@ -111,6 +153,11 @@ public:
         { return mStartTime; }
     time_t Now() const
         { return mNow; }
+    // Time when the last poll returned. The data received after that time
+    // has not been read yet, even though Now() might be well past it when
+    // the event dispatch or the timer processing takes long.
+    time_t GetPollTime() const
+        { return mPollTime; }
     time_t UpTime() const
         { return (mNow - mStartTime); }
     bool IsRunning() const
@@ -127,6 +174,29 @@ public:
     void UpdateTimeNow() { mNow = time(0); }
     int GetConnectionCount() const
         { return mConnectionsCount; }
+    /// The stats are updated by the net manager thread, and intended to be
+    /// read by other threads without synchronization, as such the values
+    /// might not be consistent with each other.
+    void GetEventStats(EventStats& stats) const
+        { stats = mEventStats; }
+    /// Log the callback type, event, and execution time of the dispatches
+    /// that take longer than the threshold. Negative value turns logging
+    /// off. Applies to all net manager instances.
+    static void SetSlowDispatchThresholdUsec(int64_t usec)
+        { sSlowDispatchThresholdUsec = usec; }
+    static int64_t GetSlowDispatchThresholdUsec()
+        { return sSlowDispatchThresholdUsec; }
+    /// Use edge triggered poll for the connections without filter, where
+    /// supported. The connection fd is added to the poll set with both read
+    /// and write notification once, and the connection read and write
+    /// interest changes then require no poll set system calls. The net
+    /// manager tracks socket readiness, and dispatches ready connections
+    /// until the socket read or write returns EAGAIN. Applies to all net
+    /// manager instances, the connections switch the poll mode with the
+    /// next update.
+    static void SetEdgeTriggeredPoll(bool flag);
+    static bool GetEdgeTriggeredPoll()
+        { return sEdgeTriggeredPollFlag; }
 
     // Primarily for debugging, to simulate network failures.
     class PollEventHook
@@ -231,6 +301,7 @@ private:
     const int       mTimeoutMs;
     const time_t    mStartTime;
     time_t          mNow;
+    time_t          mPollTime;
     time_t          mLastTimerTime;
     int64_t         mMaxOutgoingBacklog;
     int64_t         mNumBytesToSend;
@@ -245,12 +316,24 @@ private:
     /// returns.  To the handlers, the notification is a timeout signal.
     ITimeout*       mCurTimeoutHandler;
     ITimeout*       mTimeoutHandlers[1];
+    /// The earliest expiration time of the timeout handlers with non zero
+    /// interval, used to limit poll timeout.
+    int64_t         mTimeoutHandlersNextRunMs;
+    EventStats      mEventStats;
+
+    static int64_t  sSlowDispatchThresholdUsec;
+    static bool     sEdgeTriggeredPollFlag;
     List            mEpollError;
     List            mTimerWheel[kTimerWheelSize + 1];
 
     void CheckIfOverloaded();
     void CleanUp(bool childAtForkFlag = false, bool onlyCloseFdFlag = false);
     inline void UpdateTimer(NetManagerEntry& entry, int timeOut);
+    inline void UpdateTimeoutHandlersNextRun(const ITimeout& handler,
+        int64_t lastCallMs);
+    inline int GetPollTimeoutMs() const;
+    inline void DispatchDone(int64_t& startUsec, const char* typeName,
+        const char* eventName, int pollOp = 0);
     void UpdateSelf(NetManagerEntry& entry, int fd,
         bool resetTimer, bool epollError);
     void PollRemove(int fd);
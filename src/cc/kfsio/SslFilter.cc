@@ -49,6 +49,11 @@
 #include <string>
 #include <algorithm>
 
+#if defined(KFS_OS_NAME_LINUX) && defined(SSL_OP_ENABLE_KTLS) && \
+    defined(BIO_get_ktls_send) && defined(BIO_get_ktls_recv)
+#   define KFS_SSL_FILTER_KTLS
+#endif
+
 namespace KFS
 {
 using std::string;
@@ -180,17 +185,46 @@ public:
         const Properties& inParams,
         string*           inErrMsgPtr)
     {
+        Properties::String theParamName;
+        if (inParamsPrefixPtr) {
+            theParamName.Append(inParamsPrefixPtr);
+        }
+        const size_t thePrefLen = theParamName.GetSize();
+#ifdef KFS_SSL_FILTER_KTLS
+        // Linux kernel tls supports only tls 1.2 and up, use version flexible
+        // method, and limit max version to 1.2 in order to retain the same
+        // psk key exchange and session handling as with tls 1.0.
+        const bool theKtlsFlag = inParams.getValue(
+            theParamName.Truncate(thePrefLen).Append("ktls"), 0) != 0;
+        SSL_CTX* const theRetPtr = SSL_CTX_new(theKtlsFlag ?
+            (inServerFlag ? TLS_server_method() : TLS_client_method()) :
+            (inServerFlag ? TLSv1_server_method() : TLSv1_client_method()));
+        if (! theRetPtr) {
+            return 0;
+        }
+        if (theKtlsFlag) {
+            SSL_CTX_set_max_proto_version(theRetPtr, TLS1_2_VERSION);
+            SSL_CTX_set_options(theRetPtr, SSL_OP_ENABLE_KTLS);
+        }
+#else
         SSL_CTX* const theRetPtr = SSL_CTX_new(
             inServerFlag ? TLSv1_server_method() : TLSv1_client_method());
         if (! theRetPtr) {
             return 0;
         }
+#endif
         SSL_CTX_set_mode(theRetPtr, SSL_MODE_ENABLE_PARTIAL_WRITE);
-        Properties::String theParamName;
-        if (inParamsPrefixPtr) {
-            theParamName.Append(inParamsPrefixPtr);
+#ifdef SSL_MODE_RELEASE_BUFFERS
+        // Optionally free read and write record buffers while the connection
+        // is idle, in order to reduce memory footprint of idle connections.
+        // Off by default, as the buffers are re-allocated with every request,
+        // and busy connections gain nothing.
+        if (inParams.getValue(
+                theParamName.Truncate(thePrefLen).Append("releaseBuffers"),
+                0) != 0) {
+            SSL_CTX_set_mode(theRetPtr, SSL_MODE_RELEASE_BUFFERS);
         }
-        const size_t thePrefLen = theParamName.GetSize();
+#endif
         if (! SSL_CTX_set_cipher_list(
             theRetPtr,
             inParams.getValue(
@@ -473,6 +507,23 @@ public:
                 (inConnection.IsWriteReady() && SSL_is_init_finished(mSslPtr))))
         );
     }
+    bool IsWriteThrough() const
+    {
+#ifdef KFS_SSL_FILTER_KTLS
+        // With kernel tls send the kernel encrypts the data written to the
+        // socket, therefore io buffer writev and sendfile can be used
+        // directly once handshake is complete, and no ssl write is pending.
+        return (
+            mSslPtr && mError == 0 && ! mSslErrorFlag &&
+            ! mShutdownInitiatedFlag &&
+            SSL_is_init_finished(mSslPtr) &&
+            ! SSL_want_write(mSslPtr) &&
+            BIO_get_ktls_send(SSL_get_wbio(mSslPtr))
+        );
+#else
+        return false;
+#endif
+    }
     int Read(
         NetConnection& inConnection,
         TcpSocket&     inSocket,
@@ -732,6 +783,14 @@ public:
         if (! mSslPtr || SSL_get_fd(mSslPtr) != inSocket.GetFd()) {
             return -EINVAL;
         }
+#ifdef KFS_SSL_FILTER_KTLS
+        if (BIO_get_ktls_send(SSL_get_wbio(mSslPtr)) ||
+                BIO_get_ktls_recv(SSL_get_rbio(mSslPtr))) {
+            // Kernel tls can not be turned off on the socket, therefore
+            // clear text communication can not be resumed after ssl shutdown.
+            return -EOPNOTSUPP;
+        }
+#endif
         int theRet = ShutdownSelf(inConnection, inOuter);
         // Check the return first, as the object might be already delete in
         // the case if return is 0.
@@ -1538,6 +1597,12 @@ SslFilter::GetPeerId() const
     return mImpl.GetPeerId();
 }
 
+    bool
+SslFilter::IsWriteThrough() const
+{
+    return mImpl.IsWriteThrough();
+}
+
     bool
 SslFilter::IsAuthFailure() const
 {
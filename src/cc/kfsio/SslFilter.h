@@ -165,6 +165,7 @@ public:
     virtual int GetErrorCode() const;
     virtual bool IsShutdownReceived() const;
     virtual string GetPeerId() const;
+    virtual bool IsWriteThrough() const;
     bool IsHandshakeDone() const;
     static bool GetCtxX509EndTime(
         Ctx&     inCtx,
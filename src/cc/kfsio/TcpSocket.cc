@@ -549,6 +549,37 @@ TcpSocket::GetSocketError() const
     return err;
 }
 
+int
+TcpSocket::SetKeepAlive(int idleSec, int intervalSec, int probeCount)
+{
+    if (mSockFd < 0) {
+        return -EBADF;
+    }
+    const int flag = 1;
+    if (SetSockOpt(mSockFd, SOL_SOCKET, SO_KEEPALIVE, flag)) {
+        return Perror("setsockopt SO_KEEPALIVE");
+    }
+#ifdef TCP_KEEPIDLE
+    if (0 < idleSec &&
+            SetSockOpt(mSockFd, IPPROTO_TCP, TCP_KEEPIDLE, idleSec)) {
+        return Perror("setsockopt TCP_KEEPIDLE");
+    }
+#endif
+#ifdef TCP_KEEPINTVL
+    if (0 < intervalSec &&
+            SetSockOpt(mSockFd, IPPROTO_TCP, TCP_KEEPINTVL, intervalSec)) {
+        return Perror("setsockopt TCP_KEEPINTVL");
+    }
+#endif
+#ifdef TCP_KEEPCNT
+    if (0 < probeCount &&
+            SetSockOpt(mSockFd, IPPROTO_TCP, TCP_KEEPCNT, probeCount)) {
+        return Perror("setsockopt TCP_KEEPCNT");
+    }
+#endif
+    return 0;
+}
+
 string
 TcpSocket::ToString(const Address& saddr)
 {
@@ -114,6 +114,10 @@ public:
     int Shutdown() { return Shutdown(true, true); }
     /// Get and clear pending socket error: getsockopt(SO_ERROR)
     int GetSocketError() const;
+    /// Turn on tcp keep alive. Non positive idle, interval, or probe count
+    /// leave the corresponding system default.
+    /// @retval 0 on success, or negative errno.
+    int SetKeepAlive(int idleSec, int intervalSec, int probeCount);
     Type GetType() const { return mType; }
     static int Validate(const string& address);
     static int GetDefaultRecvBufSize() { return sRecvBufSize; }
@@ -0,0 +1,179 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Zlib deflate of io buffer content.
+//
+//----------------------------------------------------------------------------
+
+#include "ZlibDeflate.h"
+#include "IOBuffer.h"
+#include "qcdio/QCUtils.h"
+
+#include <zlib.h>
+#include <string.h>
+
+namespace KFS
+{
+
+class ZlibDeflate::Impl
+{
+public:
+    Impl(
+        int inLevel)
+        : mLevel(inLevel),
+          mAllocatedFlag(false)
+    {
+    }
+    ~Impl()
+    {
+        Reset();
+    }
+    int Run(
+        IOBuffer& inBuffer,
+        IOBuffer& outBuffer)
+    {
+        int theStatus = Allocate();
+        if (theStatus != Z_OK) {
+            return theStatus;
+        }
+        IOBufferData       theOut;
+        bool               theDoneFlag = false;
+        IOBuffer::iterator theIt       = inBuffer.begin();
+        while (! theDoneFlag) {
+            while (theIt != inBuffer.end() && theIt->IsEmpty()) {
+                ++theIt;
+            }
+            const bool theLastFlag = theIt == inBuffer.end();
+            const int  theInLen    = theLastFlag ? 0 : theIt->BytesConsumable();
+            mStream.avail_in = (uInt)theInLen;
+            mStream.next_in  = theLastFlag ? Z_NULL :
+                (Bytef*)const_cast<char*>(theIt->Consumer());
+            do {
+                if (theOut.IsFull()) {
+                    outBuffer.Append(theOut);
+                    theOut = IOBufferData();
+                }
+                const size_t theSpace = theOut.SpaceAvailable();
+                mStream.avail_out = (uInt)theSpace;
+                mStream.next_out  = (Bytef*)theOut.Producer();
+                theStatus = deflate(&mStream,
+                    theLastFlag ? Z_FINISH : Z_NO_FLUSH);
+                if (theStatus == Z_STREAM_ERROR) {
+                    break;
+                }
+                QCRTASSERT(mStream.avail_out <= theSpace);
+                theOut.Fill((int)(theSpace - mStream.avail_out));
+                theDoneFlag = theStatus == Z_STREAM_END;
+            } while (! theDoneFlag &&
+                (mStream.avail_out == 0 || mStream.avail_in > 0));
+            if (theStatus == Z_STREAM_ERROR) {
+                break;
+            }
+            theStatus = Z_OK;
+            if (! theLastFlag) {
+                ++theIt;
+            }
+        }
+        if (0 < theOut.BytesConsumable()) {
+            outBuffer.Append(theOut);
+        }
+        if (theStatus == Z_OK) {
+            inBuffer.Clear();
+        }
+        Reset();
+        return theStatus;
+    }
+    const char* StrError(
+        int inStatus)
+    {
+        switch (inStatus) {
+            case Z_STREAM_ERROR:
+                return "zlib invalid compression level or stream state";
+            case Z_MEM_ERROR:
+                return "zlib out of memory";
+            case Z_VERSION_ERROR:
+                return "zlib version mismatch";
+            case Z_OK:
+                return "zlib no error";
+            default:
+                break;
+        }
+        return "zlib unspecified error";
+    }
+private:
+    const int  mLevel;
+    bool       mAllocatedFlag;
+    z_stream_s mStream;
+
+    int Allocate()
+    {
+        if (mAllocatedFlag) {
+            return Z_OK;
+        }
+        memset(&mStream, 0, sizeof(mStream));
+        mStream.zalloc = Z_NULL;
+        mStream.zfree  = Z_NULL;
+        mStream.opaque = Z_NULL;
+        const int theStatus = deflateInit(&mStream,
+            (mLevel < 0 || 9 < mLevel) ? Z_DEFAULT_COMPRESSION : mLevel);
+        mAllocatedFlag = theStatus == Z_OK;
+        return theStatus;
+    }
+    void Reset()
+    {
+        if (mAllocatedFlag) {
+            deflateEnd(&mStream);
+            mAllocatedFlag = false;
+        }
+    }
+private:
+    Impl(
+        const Impl& inImpl);
+    Impl& operator=(
+        const Impl& inImpl);
+};
+
+ZlibDeflate::ZlibDeflate(
+    int inLevel)
+    : mImpl(*(new Impl(inLevel)))
+{}
+
+ZlibDeflate::~ZlibDeflate()
+{
+    delete &mImpl;
+}
+
+    int
+ZlibDeflate::Run(
+    IOBuffer& inBuffer,
+    IOBuffer& outBuffer)
+{
+    return mImpl.Run(inBuffer, outBuffer);
+}
+
+    const char*
+ZlibDeflate::StrError(
+    int inStatus)
+{
+    return mImpl.StrError(inStatus);
+}
+
+}
@@ -0,0 +1,62 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Zlib deflate of io buffer content. The input is read one io
+// buffer block at a time, and the output is written directly into io buffer
+// blocks, in order to avoid copying the data into contiguous buffers.
+// The output has zlib header, and can be decompressed with ZlibInflate.
+//
+//----------------------------------------------------------------------------
+
+#ifndef KFSIO_ZLIBDEFLATE_H
+#define KFSIO_ZLIBDEFLATE_H
+
+namespace KFS
+{
+
+class IOBuffer;
+
+class ZlibDeflate
+{
+public:
+    ZlibDeflate(
+        int inLevel = -1);
+    ~ZlibDeflate();
+    // Compress and consume all inBuffer content, and append the result to
+    // outBuffer. Returns 0 on success, or zlib error code.
+    int Run(
+        IOBuffer& inBuffer,
+        IOBuffer& outBuffer);
+    const char* StrError(
+        int inStatus);
+private:
+    class Impl;
+
+    Impl& mImpl;
+private:
+    ZlibDeflate(
+        const ZlibDeflate& inDeflate);
+    ZlibDeflate& operator=(
+        const ZlibDeflate& inDeflate);
+};
+
+}
+#endif /* KFSIO_ZLIBDEFLATE_H */
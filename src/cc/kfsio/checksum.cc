@@ -23,6 +23,11 @@
 //
 // An adaptation of the 32-bit Adler checksum algorithm
 //
+// Adler-32 is computed with SSSE3 or AVX2 vector instructions, selected at run
+// time on x86-64, or with NEON on AArch64. The vector versions produce the same
+// result as zlib adler32. CRC32C uses SSE4.2 or ARMv8 crc instructions when
+// available.
+//
 //----------------------------------------------------------------------------
 
 #include "checksum.h"
@@ -31,6 +36,18 @@
 #include <vector>
 #include <zlib.h>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#   include <immintrin.h>
+#   define KFS_CHECKSUM_X86_64
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#   include <arm_neon.h>
+#   define KFS_CHECKSUM_NEON
+#   if defined(__ARM_FEATURE_CRC32)
+#       include <arm_acle.h>
+#       define KFS_CHECKSUM_ARM_CRC32
+#   endif
+#endif
+
 namespace KFS {
 
 using std::min;
@@ -38,10 +55,246 @@ using std::max;
 using std::vector;
 using std::list;
 
+const uint32_t kAdler32Base = 65521; // largest prime smaller than 65536
+// Largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1, from zlib.
+const size_t   kAdler32NMax = 5552;
+// Bytes per vector loop iteration.
+const size_t   kAdler32VecBlockSize = 32;
+
+static inline uint32_t
+Adler32Tail(uint32_t s1, uint32_t s2, const unsigned char* buf, size_t len)
+{
+    while (0 < len) {
+        size_t n = min(len, kAdler32NMax);
+        len -= n;
+        while (0 < n--) {
+            s1 += *buf++;
+            s2 += s1;
+        }
+        s1 %= kAdler32Base;
+        s2 %= kAdler32Base;
+    }
+    return (s1 | (s2 << 16));
+}
+
+#if defined(KFS_CHECKSUM_X86_64)
+
+__attribute__((target("ssse3"))) static uint32_t
+Adler32Ssse3(uint32_t adler, const unsigned char* buf, size_t len)
+{
+    uint32_t s1     = adler & 0xffff;
+    uint32_t s2     = adler >> 16;
+    size_t   blocks = len / kAdler32VecBlockSize;
+    len -= blocks * kAdler32VecBlockSize;
+    const __m128i tap1 = _mm_setr_epi8(
+        32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(
+        16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    while (0 < blocks) {
+        size_t n = min(blocks, kAdler32NMax / kAdler32VecBlockSize);
+        blocks -= n;
+        // s2 gets 32 * s1 per block, accumulate s1 prior to each block in ps.
+        __m128i vps = _mm_set_epi32(0, 0, 0, (int)(s1 * n));
+        __m128i vs2 = _mm_set_epi32(0, 0, 0, (int)s2);
+        __m128i vs1 = _mm_setzero_si128();
+        do {
+            const __m128i b1 = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(buf));
+            const __m128i b2 = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(buf + 16));
+            vps = _mm_add_epi32(vps, vs1);
+            vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(b1, zero));
+            vs2 = _mm_add_epi32(vs2,
+                _mm_madd_epi16(_mm_maddubs_epi16(b1, tap1), ones));
+            vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(b2, zero));
+            vs2 = _mm_add_epi32(vs2,
+                _mm_madd_epi16(_mm_maddubs_epi16(b2, tap2), ones));
+            buf += kAdler32VecBlockSize;
+        } while (0 < --n);
+        vs2 = _mm_add_epi32(vs2, _mm_slli_epi32(vps, 5));
+        vs1 = _mm_add_epi32(vs1, _mm_shuffle_epi32(vs1, _MM_SHUFFLE(2,3,0,1)));
+        vs1 = _mm_add_epi32(vs1, _mm_shuffle_epi32(vs1, _MM_SHUFFLE(1,0,3,2)));
+        s1 += (uint32_t)_mm_cvtsi128_si32(vs1);
+        vs2 = _mm_add_epi32(vs2, _mm_shuffle_epi32(vs2, _MM_SHUFFLE(2,3,0,1)));
+        vs2 = _mm_add_epi32(vs2, _mm_shuffle_epi32(vs2, _MM_SHUFFLE(1,0,3,2)));
+        s2 = (uint32_t)_mm_cvtsi128_si32(vs2);
+        s1 %= kAdler32Base;
+        s2 %= kAdler32Base;
+    }
+    return Adler32Tail(s1, s2, buf, len);
+}
+
+__attribute__((target("avx2"))) static uint32_t
+Adler32Avx2(uint32_t adler, const unsigned char* buf, size_t len)
+{
+    uint32_t s1     = adler & 0xffff;
+    uint32_t s2     = adler >> 16;
+    size_t   blocks = len / kAdler32VecBlockSize;
+    len -= blocks * kAdler32VecBlockSize;
+    const __m256i tap  = _mm256_setr_epi8(
+        32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+        16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    while (0 < blocks) {
+        size_t n = min(blocks, kAdler32NMax / kAdler32VecBlockSize);
+        blocks -= n;
+        __m256i vps = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, (int)(s1 * n));
+        __m256i vs2 = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, (int)s2);
+        __m256i vs1 = _mm256_setzero_si256();
+        do {
+            const __m256i b = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(buf));
+            vps = _mm256_add_epi32(vps, vs1);
+            vs1 = _mm256_add_epi32(vs1, _mm256_sad_epu8(b, zero));
+            vs2 = _mm256_add_epi32(vs2,
+                _mm256_madd_epi16(_mm256_maddubs_epi16(b, tap), ones));
+            buf += kAdler32VecBlockSize;
+        } while (0 < --n);
+        vs2 = _mm256_add_epi32(vs2, _mm256_slli_epi32(vps, 5));
+        __m128i h1 = _mm_add_epi32(_mm256_castsi256_si128(vs1),
+            _mm256_extracti128_si256(vs1, 1));
+        h1 = _mm_add_epi32(h1, _mm_shuffle_epi32(h1, _MM_SHUFFLE(2,3,0,1)));
+        h1 = _mm_add_epi32(h1, _mm_shuffle_epi32(h1, _MM_SHUFFLE(1,0,3,2)));
+        s1 += (uint32_t)_mm_cvtsi128_si32(h1);
+        __m128i h2 = _mm_add_epi32(_mm256_castsi256_si128(vs2),
+            _mm256_extracti128_si256(vs2, 1));
+        h2 = _mm_add_epi32(h2, _mm_shuffle_epi32(h2, _MM_SHUFFLE(2,3,0,1)));
+        h2 = _mm_add_epi32(h2, _mm_shuffle_epi32(h2, _MM_SHUFFLE(1,0,3,2)));
+        s2 = (uint32_t)_mm_cvtsi128_si32(h2);
+        s1 %= kAdler32Base;
+        s2 %= kAdler32Base;
+    }
+    return Adler32Tail(s1, s2, buf, len);
+}
+
+#elif defined(KFS_CHECKSUM_NEON)
+
+static uint32_t
+Adler32Neon(uint32_t adler, const unsigned char* buf, size_t len)
+{
+    uint32_t s1     = adler & 0xffff;
+    uint32_t s2     = adler >> 16;
+    size_t   blocks = len / kAdler32VecBlockSize;
+    len -= blocks * kAdler32VecBlockSize;
+    static const uint16_t kTaps[32] = {
+        32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+        16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1
+    };
+    while (0 < blocks) {
+        size_t n = min(blocks, kAdler32NMax / kAdler32VecBlockSize);
+        blocks -= n;
+        uint32x4_t vs2  = vsetq_lane_u32((uint32_t)(s1 * n), vdupq_n_u32(0), 0);
+        uint32x4_t vs1  = vdupq_n_u32(0);
+        // Per byte position column sums, n * 255 fits into 16 bits.
+        uint16x8_t col1 = vdupq_n_u16(0);
+        uint16x8_t col2 = vdupq_n_u16(0);
+        uint16x8_t col3 = vdupq_n_u16(0);
+        uint16x8_t col4 = vdupq_n_u16(0);
+        do {
+            const uint8x16_t b1 = vld1q_u8(buf);
+            const uint8x16_t b2 = vld1q_u8(buf + 16);
+            vs2  = vaddq_u32(vs2, vs1);
+            vs1  = vpadalq_u16(vs1, vpadalq_u8(vpaddlq_u8(b1), b2));
+            col1 = vaddw_u8(col1, vget_low_u8(b1));
+            col2 = vaddw_u8(col2, vget_high_u8(b1));
+            col3 = vaddw_u8(col3, vget_low_u8(b2));
+            col4 = vaddw_u8(col4, vget_high_u8(b2));
+            buf += kAdler32VecBlockSize;
+        } while (0 < --n);
+        vs2 = vshlq_n_u32(vs2, 5);
+        vs2 = vmlal_u16(vs2, vget_low_u16(col1),  vld1_u16(kTaps));
+        vs2 = vmlal_u16(vs2, vget_high_u16(col1), vld1_u16(kTaps + 4));
+        vs2 = vmlal_u16(vs2, vget_low_u16(col2),  vld1_u16(kTaps + 8));
+        vs2 = vmlal_u16(vs2, vget_high_u16(col2), vld1_u16(kTaps + 12));
+        vs2 = vmlal_u16(vs2, vget_low_u16(col3),  vld1_u16(kTaps + 16));
+        vs2 = vmlal_u16(vs2, vget_high_u16(col3), vld1_u16(kTaps + 20));
+        vs2 = vmlal_u16(vs2, vget_low_u16(col4),  vld1_u16(kTaps + 24));
+        vs2 = vmlal_u16(vs2, vget_high_u16(col4), vld1_u16(kTaps + 28));
+        s1 += vaddvq_u32(vs1);
+        s2 += vaddvq_u32(vs2);
+        s1 %= kAdler32Base;
+        s2 %= kAdler32Base;
+    }
+    return Adler32Tail(s1, s2, buf, len);
+}
+
+#endif
+
+static uint32_t
+Adler32Zlib(uint32_t adler, const unsigned char* buf, size_t len)
+{
+    return adler32(adler, buf, len);
+}
+
+typedef uint32_t (*Adler32Func)(uint32_t, const unsigned char*, size_t);
+
+static uint32_t Adler32Select(uint32_t, const unsigned char*, size_t);
+static Adler32Func sAdler32Func = &Adler32Select;
+
+static Adler32Func
+GetAdler32Func()
+{
+#if defined(KFS_CHECKSUM_X86_64)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &Adler32Avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return &Adler32Ssse3;
+    }
+#elif defined(KFS_CHECKSUM_NEON)
+    return &Adler32Neon;
+#endif
+    return &Adler32Zlib;
+}
+
+static uint32_t
+Adler32Select(uint32_t adler, const unsigned char* buf, size_t len)
+{
+    // The selection is idempotent, concurrent first invocations are benign.
+    sAdler32Func = GetAdler32Func();
+    return sAdler32Func(adler, buf, len);
+}
+
+const char*
+GetChecksumImplementationName()
+{
+    const Adler32Func func = GetAdler32Func();
+#if defined(KFS_CHECKSUM_X86_64)
+    if (func == &Adler32Avx2) {
+        return "avx2";
+    }
+    if (func == &Adler32Ssse3) {
+        return "ssse3";
+    }
+#elif defined(KFS_CHECKSUM_NEON)
+    if (func == &Adler32Neon) {
+        return "neon";
+    }
+#endif
+    return "zlib";
+}
+
+// Vector versions do not pay off for short buffers.
+const size_t kAdler32VecMinLen = 64;
+
 static inline uint32_t
 KfsChecksum(uint32_t chksum, const void* buf, size_t len)
 {
-    return adler32(chksum, reinterpret_cast<const Bytef*>(buf), len);
+    const unsigned char* const p = reinterpret_cast<const unsigned char*>(buf);
+    if (len < kAdler32VecMinLen) {
+        return Adler32Tail(chksum & 0xffff, chksum >> 16, p, len);
+    }
+    return sAdler32Func(chksum, p, len);
+}
+
+uint32_t
+ComputeAdler32(const char* data, size_t len, uint32_t chksum)
+{
+    return KfsChecksum(chksum, data, len);
 }
 
 #ifndef _KFS_NO_ADDLER32_COMBINE
@@ -259,5 +512,115 @@ ComputeCrc32(const char* data, size_t len, uint32_t cchksum /* = 0 */)
     return crc32(cchksum, reinterpret_cast<const Bytef*>(data), len);
 }
 
+// CRC32C (Castagnoli) reflected polynomial.
+const uint32_t kCrc32cPoly = 0x82F63B78;
+
+static const uint32_t*
+GetCrc32cTable()
+{
+    static uint32_t sTable[256];
+    static volatile bool sInitFlag = false;
+    if (! sInitFlag) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; k++) {
+                crc = (crc >> 1) ^ (kCrc32cPoly & (0 - (crc & 1)));
+            }
+            sTable[i] = crc;
+        }
+        sInitFlag = true;
+    }
+    return sTable;
+}
+
+static uint32_t
+Crc32cSw(uint32_t crc, const unsigned char* buf, size_t len)
+{
+    const uint32_t* const table = GetCrc32cTable();
+    while (0 < len--) {
+        crc = table[(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(KFS_CHECKSUM_X86_64)
+
+__attribute__((target("sse4.2"))) static uint32_t
+Crc32cHw(uint32_t crc, const unsigned char* buf, size_t len)
+{
+    uint64_t crc64 = crc;
+    while (0 < len && (reinterpret_cast<uintptr_t>(buf) & 7) != 0) {
+        crc64 = _mm_crc32_u8((uint32_t)crc64, *buf++);
+        len--;
+    }
+    while (8 <= len) {
+        crc64 = _mm_crc32_u64(crc64, *reinterpret_cast<const uint64_t*>(buf));
+        buf += 8;
+        len -= 8;
+    }
+    while (0 < len--) {
+        crc64 = _mm_crc32_u8((uint32_t)crc64, *buf++);
+    }
+    return (uint32_t)crc64;
+}
+
+static bool
+IsCrc32cHwSupported()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+
+#elif defined(KFS_CHECKSUM_ARM_CRC32)
+
+static uint32_t
+Crc32cHw(uint32_t crc, const unsigned char* buf, size_t len)
+{
+    while (0 < len && (reinterpret_cast<uintptr_t>(buf) & 7) != 0) {
+        crc = __crc32cb(crc, *buf++);
+        len--;
+    }
+    while (8 <= len) {
+        crc = __crc32cd(crc, *reinterpret_cast<const uint64_t*>(buf));
+        buf += 8;
+        len -= 8;
+    }
+    while (0 < len--) {
+        crc = __crc32cb(crc, *buf++);
+    }
+    return crc;
+}
+
+static bool
+IsCrc32cHwSupported()
+{
+    return true;
+}
+
+#else
+
+static uint32_t
+Crc32cHw(uint32_t crc, const unsigned char* buf, size_t len)
+{
+    return Crc32cSw(crc, buf, len);
+}
+
+static bool
+IsCrc32cHwSupported()
+{
+    return false;
+}
+
+#endif
+
+uint32_t
+ComputeCrc32c(const char* data, size_t len, uint32_t chksum /* = 0 */)
+{
+    static const bool sHwFlag = IsCrc32cHwSupported();
+    const unsigned char* const p = reinterpret_cast<const unsigned char*>(data);
+    const uint32_t             crc = ~chksum;
+    return ~(sHwFlag ? Crc32cHw(crc, p, len) : Crc32cSw(crc, p, len));
+}
+
 }
 
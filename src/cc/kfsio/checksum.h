@@ -70,6 +70,14 @@ vector<uint32_t> ComputeChecksums(
     const char* data, size_t len, uint32_t* chksum = 0);
 
 uint32_t ComputeCrc32(const char* data, size_t len, uint32_t cchksum = 0);
+/// CRC32C (Castagnoli), uses SSE4.2 or ARMv8 crc instructions if available.
+uint32_t ComputeCrc32c(const char* data, size_t len, uint32_t chksum = 0);
+/// Adler-32 with the block checksum implementation, for testing.
+uint32_t ComputeAdler32(const char* data, size_t len,
+    uint32_t chksum = kKfsNullChecksum);
+/// Returns the name of Adler-32 implementation selected: avx2, ssse3, neon,
+/// or zlib.
+const char* GetChecksumImplementationName();
 
 }
 
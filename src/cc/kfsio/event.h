@@ -52,7 +52,8 @@ enum EventCode_t {
     EVENT_DISK_RENAME_DONE,
     EVENT_DISK_GET_FS_SPACE_AVAIL_DONE,
     EVENT_DISK_CHECK_DIR_READABLE_DONE,
-    EVENT_DISK_CHECK_DIR_WRITABLE_DONE
+    EVENT_DISK_CHECK_DIR_WRITABLE_DONE,
+    EVENT_DISK_PREALLOCATE_DONE
 };
 
 }
@@ -0,0 +1,133 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// In memory Kerberos authenticator replay cache implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "KrbReplayCache.h"
+
+#include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
+
+#include <string>
+#include <map>
+#include <deque>
+
+namespace KFS
+{
+using std::string;
+using std::map;
+using std::deque;
+using std::pair;
+using std::make_pair;
+
+class KrbReplayCacheImpl
+{
+public:
+    enum { kStripeCount = 64 };
+    // The authenticator is encrypted and integrity protected, and it is at
+    // the end of the AP-REQ, therefore the AP-REQ length and the authenticator
+    // tail uniquely identify the request.
+    enum { kMaxKeySize = 64 };
+
+    static KrbReplayCacheImpl& Instance()
+    {
+        static KrbReplayCacheImpl sInstance;
+        return sInstance;
+    }
+    bool Insert(
+        const char* inDataPtr,
+        int         inDataLen,
+        time_t      inNow,
+        int         inWindowSec)
+    {
+        if (! inDataPtr || inDataLen <= 0) {
+            return true;
+        }
+        const int theKeyLen = inDataLen < kMaxKeySize ? inDataLen : kMaxKeySize;
+        const char* const theKeyPtr = inDataPtr + inDataLen - theKeyLen;
+        string theKey;
+        theKey.reserve(sizeof(inDataLen) + theKeyLen);
+        theKey.assign(reinterpret_cast<const char*>(&inDataLen),
+            sizeof(inDataLen));
+        theKey.append(theKeyPtr, theKeyLen);
+        Stripe& theStripe = mStripes[Hash(theKeyPtr, theKeyLen) % kStripeCount];
+        QCStMutexLocker theLock(theStripe.mMutex);
+        const time_t theExpired = inNow - inWindowSec;
+        while (! theStripe.mExpirationQueue.empty() &&
+                theStripe.mExpirationQueue.front()->second < theExpired) {
+            theStripe.mEntries.erase(theStripe.mExpirationQueue.front());
+            theStripe.mExpirationQueue.pop_front();
+        }
+        pair<Entries::iterator, bool> const theRes =
+            theStripe.mEntries.insert(make_pair(theKey, inNow));
+        if (! theRes.second) {
+            return false;
+        }
+        theStripe.mExpirationQueue.push_back(theRes.first);
+        return true;
+    }
+private:
+    typedef map<string, time_t>      Entries;
+    typedef deque<Entries::iterator> ExpirationQueue;
+    struct Stripe
+    {
+        Stripe()
+            : mMutex(),
+              mEntries(),
+              mExpirationQueue()
+            {}
+        QCMutex         mMutex;
+        Entries         mEntries;
+        ExpirationQueue mExpirationQueue;
+    };
+    Stripe mStripes[kStripeCount];
+
+    KrbReplayCacheImpl()
+        {}
+    static size_t Hash(
+        const char* inPtr,
+        int         inLen)
+    {
+        // FNV-1a
+        size_t theHash = 2166136261u;
+        for (const char* const theEndPtr = inPtr + inLen;
+                inPtr < theEndPtr;
+                ++inPtr) {
+            theHash = (theHash ^ (*inPtr & 0xFF)) * 16777619u;
+        }
+        return theHash;
+    }
+};
+
+    /* static */ bool
+KrbReplayCache::Insert(
+    const char* inDataPtr,
+    int         inDataLen,
+    time_t      inNow,
+    int         inWindowSec)
+{
+    return KrbReplayCacheImpl::Instance().Insert(
+        inDataPtr, inDataLen, inNow, inWindowSec);
+}
+
+}
@@ -0,0 +1,62 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// In memory Kerberos authenticator replay cache. Used by the service instead
+// of the krb5 file based replay cache, in order to avoid the replay cache file
+// access, and serialization at the time when a large number of clients
+// authenticate at once. The cache is shared by all service instances in the
+// process, and is lock striped in order to minimize contention between the
+// threads verifying authenticators concurrently.
+//
+//----------------------------------------------------------------------------
+
+#ifndef KFS_KRB_REPLAY_CACHE_H
+#define KFS_KRB_REPLAY_CACHE_H
+
+#include <time.h>
+
+namespace KFS
+{
+
+class KrbReplayCache
+{
+public:
+    // Returns false if the same AP-REQ was seen within the window. Entries
+    // older than the window are discarded. The window must be at least twice
+    // of the kerberos maximum clock skew, as the library accepts
+    // authenticators with the time stamp within the clock skew.
+    static bool Insert(
+        const char* inDataPtr,
+        int         inDataLen,
+        time_t      inNow,
+        int         inWindowSec);
+private:
+    KrbReplayCache();
+    ~KrbReplayCache();
+    KrbReplayCache(
+        const KrbReplayCache& inCache);
+    KrbReplayCache& operator=(
+        const KrbReplayCache& inCache);
+};
+
+}
+
+#endif /* KFS_KRB_REPLAY_CACHE_H */
@@ -26,8 +26,10 @@
 
 #include "KrbService.h"
 #include "KfsKrb5.h"
+#include "KrbReplayCache.h"
 
 #include <errno.h>
+#include <time.h>
 
 #include <string>
 #include <algorithm>
@@ -60,6 +62,7 @@ public:
           mAuthInitedFlag(false),
           mDetectReplayFlag(false),
           mInMemoryKeytabUsedFlag(false),
+          mReplayCacheWindowSec(0),
           mServiceName(),
           mServiceHostName(),
           mErrorMsg()
@@ -74,10 +77,12 @@ public:
         const char* inServeiceNamePtr,
         const char* inKeyTabNamePtr,
         const char* inMemKeyTabNamePtr,
-        bool        inDetectReplayFlag)
+        bool        inDetectReplayFlag,
+        int         inReplayCacheWindowSec)
     {
         CleanupSelf();
-        mDetectReplayFlag = inDetectReplayFlag;
+        mDetectReplayFlag     = inDetectReplayFlag;
+        mReplayCacheWindowSec = inReplayCacheWindowSec;
         mErrCode = 0;
         mErrorMsg.clear();
         mServiceName.clear();
@@ -149,7 +154,15 @@ public:
             );
             // krb5_free_ticket(mCtx, theTicket);
             if (! mErrCode) {
-                return 0;
+                if (! IsMemReplayCacheUsed() || KrbReplayCache::Insert(
+                        inDataPtr, inDataLen, time(0),
+                        mReplayCacheWindowSec)) {
+                    return 0;
+                }
+                mErrCode  = KRB5KRB_AP_ERR_REPEAT;
+                mErrorMsg = "request is a replay";
+                CleanupAuth();
+                return mErrorMsg.c_str();
             }
             mErrorMsg = ErrToStr(mErrCode);
             CleanupAuth();
@@ -280,10 +293,13 @@ private:
     bool              mAuthInitedFlag;
     bool              mDetectReplayFlag;
     bool              mInMemoryKeytabUsedFlag;
+    int               mReplayCacheWindowSec;
     string            mServiceName;
     string            mServiceHostName;
     string            mErrorMsg;
 
+    bool IsMemReplayCacheUsed() const
+        { return (mDetectReplayFlag && 0 < mReplayCacheWindowSec); }
     void InitSelf()
     {
         mErrCode = krb5_init_context(&mCtx);
@@ -403,12 +419,15 @@ private:
             return;
         }
         // theFlags |= KRB5_AUTH_CONTEXT_DO_SEQUENCE;
-        if (! mDetectReplayFlag) {
+        // With the in memory replay cache the krb5 replay cache is not used,
+        // the authenticator time stamp is still checked against the maximum
+        // clock skew by krb5_rd_req().
+        if (! mDetectReplayFlag || IsMemReplayCacheUsed()) {
             theFlags &=
                 ~(KRB5_AUTH_CONTEXT_DO_TIME | KRB5_AUTH_CONTEXT_RET_TIME);
         }
         mErrCode = krb5_auth_con_setflags(mCtx, mAuthCtx, theFlags);
-        if (mDetectReplayFlag) {
+        if (mDetectReplayFlag && ! IsMemReplayCacheUsed()) {
             krb5_rcache theRCachePtr = 0;
             mErrCode = krb5_auth_con_getrcache(mCtx, mAuthCtx, &theRCachePtr);
             if (mErrCode) {
@@ -507,14 +526,16 @@ KrbService::Init(
     const char* inServeiceNamePtr,
     const char* inKeyTabNamePtr,
     const char* inMemKeyTabNamePtr,
-    bool        inDetectReplayFlag)
+    bool        inDetectReplayFlag,
+    int         inReplayCacheWindowSec)
 {
     return mImpl.Init(
         inServiceHostNamePtr,
         inServeiceNamePtr,
         inKeyTabNamePtr,
         inMemKeyTabNamePtr,
-        inDetectReplayFlag
+        inDetectReplayFlag,
+        inReplayCacheWindowSec
     );
 }
 
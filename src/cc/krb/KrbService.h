@@ -47,7 +47,8 @@ public:
         const char* inServeiceNamePtr,
         const char* inKeyTabNamePtr,
         const char* inMemKeyTabNamePtr,
-        bool        inDetectReplayFlag);
+        bool        inDetectReplayFlag,
+        int         inReplayCacheWindowSec = 0);
     const char* Cleanup();
     const char* Request(
         const char* inDataPtr,
@@ -0,0 +1,193 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client wide chunk checksum block cache implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "ChunkBlockCache.h"
+#include "qcdio/qcdebug.h"
+
+#include <algorithm>
+
+namespace KFS
+{
+namespace client
+{
+using std::make_pair;
+using std::min;
+
+ChunkBlockCache::ChunkBlockCache(
+    int64_t inMaxBytes,
+    int     inMaxReadSize)
+    : mMap(),
+      mMaxBytes(inMaxBytes),
+      mMaxReadSize(inMaxReadSize),
+      mByteCount(0),
+      mStats()
+{
+    List::Init(mLru);
+}
+
+ChunkBlockCache::~ChunkBlockCache()
+{
+    ChunkBlockCache::Clear();
+}
+
+void
+ChunkBlockCache::SetParameters(
+    int64_t inMaxBytes,
+    int     inMaxReadSize)
+{
+    mMaxBytes    = inMaxBytes;
+    mMaxReadSize = inMaxReadSize;
+    if (! IsEnabled()) {
+        Clear();
+        return;
+    }
+    Evict();
+}
+
+bool
+ChunkBlockCache::Get(
+    kfsChunkId_t inChunkId,
+    int64_t      inChunkVersion,
+    Offset       inOffset,
+    int          inSize,
+    IOBuffer&    outBuffer)
+{
+    if (! IsEnabled() || inOffset < 0 || inSize <= 0) {
+        return false;
+    }
+    const Offset  kBlockSize = (Offset)CHECKSUM_BLOCKSIZE;
+    const int64_t theStart   = inOffset / kBlockSize;
+    const int64_t theEnd     = (inOffset + inSize + kBlockSize - 1) / kBlockSize;
+    // The chunk blocks are adjacent in the map, check that all are present
+    // before copying the data out.
+    Map::iterator const theStartIt =
+        mMap.find(Key(inChunkId, inChunkVersion, theStart));
+    Map::iterator       theIt      = theStartIt;
+    for (int64_t i = theStart; i < theEnd; ++i, ++theIt) {
+        if (theIt == mMap.end() || theIt->first.mBlockIdx != i ||
+                theIt->first.mChunkId != inChunkId ||
+                theIt->first.mChunkVersion != inChunkVersion) {
+            mStats.mMissCount++;
+            return false;
+        }
+    }
+    theIt = theStartIt;
+    Offset thePos = inOffset - theStart * kBlockSize;
+    int    theRem = inSize;
+    for (int64_t i = theStart; i < theEnd; ++i, ++theIt) {
+        Entry& theEntry = *theIt->second;
+        QCASSERT(theEntry.mData.BytesConsumable() == (int)kBlockSize);
+        for (IOBuffer::iterator theBIt = theEntry.mData.begin();
+                0 < theRem && theBIt != theEntry.mData.end();
+                ++theBIt) {
+            const int theLen = theBIt->BytesConsumable();
+            if (thePos >= theLen) {
+                thePos -= theLen;
+                continue;
+            }
+            const int theCnt = min(theRem, theLen - (int)thePos);
+            outBuffer.CopyIn(theBIt->Consumer() + thePos, theCnt);
+            theRem -= theCnt;
+            thePos = 0;
+        }
+        List::PushBack(mLru, theEntry);
+    }
+    QCASSERT(theRem == 0);
+    mStats.mHitCount++;
+    mStats.mHitByteCount += inSize;
+    return true;
+}
+
+void
+ChunkBlockCache::Put(
+    kfsChunkId_t    inChunkId,
+    int64_t         inChunkVersion,
+    Offset          inOffset,
+    const IOBuffer& inBuffer,
+    int             inSize)
+{
+    const Offset kBlockSize = (Offset)CHECKSUM_BLOCKSIZE;
+    if (! IsEnabled() || inChunkId <= 0 || inOffset < 0 ||
+            inOffset % kBlockSize != 0 || inSize < (int)kBlockSize) {
+        return;
+    }
+    IOBuffer theBuffer;
+    theBuffer.Copy(&inBuffer, min(inSize, inBuffer.BytesConsumable()));
+    for (int64_t theIdx = inOffset / kBlockSize;
+            (int)kBlockSize <= theBuffer.BytesConsumable();
+            ++theIdx) {
+        const Key                 theKey(inChunkId, inChunkVersion, theIdx);
+        pair<Map::iterator, bool> theRes =
+            mMap.insert(make_pair(theKey, (Entry*)0));
+        if (! theRes.second) {
+            theBuffer.Consume((int)kBlockSize);
+            List::PushBack(mLru, *theRes.first->second);
+            continue;
+        }
+        Entry& theEntry = *(new Entry(theKey));
+        theRes.first->second = &theEntry;
+        theEntry.mData.Move(&theBuffer, (int)kBlockSize);
+        mByteCount += kBlockSize;
+        mStats.mInsertCount++;
+        List::PushBack(mLru, theEntry);
+    }
+    Evict();
+}
+
+void
+ChunkBlockCache::Clear()
+{
+    while (! mMap.empty()) {
+        Erase(mMap.begin());
+    }
+    List::Init(mLru);
+    mByteCount = 0;
+}
+
+void
+ChunkBlockCache::Evict()
+{
+    Entry* thePtr;
+    while (mMaxBytes < mByteCount && (thePtr = List::Front(mLru))) {
+        mStats.mEvictCount++;
+        Erase(mMap.find(thePtr->mKey));
+    }
+}
+
+void
+ChunkBlockCache::Erase(
+    ChunkBlockCache::Map::iterator inIt)
+{
+    Entry* const thePtr = inIt->second;
+    mMap.erase(inIt);
+    if (! thePtr) {
+        return;
+    }
+    mByteCount -= thePtr->mData.BytesConsumable();
+    List::Remove(mLru, *thePtr);
+    delete thePtr;
+}
+
+}}
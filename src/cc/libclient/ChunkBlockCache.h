@@ -0,0 +1,198 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client wide LRU cache of the chunk checksum blocks: (chunk id, version,
+// block index) to the block data. Shared by all readers of a protocol worker,
+// in order to avoid repeating chunk server reads with small random reads of
+// the same file regions. Only full checksum blocks that passed checksum
+// verification are cached. The cache is limited by the total size of the
+// cached data, and is not thread safe, and is intended to be used only from
+// the protocol worker thread.
+//
+//----------------------------------------------------------------------------
+
+#ifndef CHUNK_BLOCK_CACHE_H
+#define CHUNK_BLOCK_CACHE_H
+
+#include "common/kfstypes.h"
+#include "common/StdAllocator.h"
+#include "kfsio/IOBuffer.h"
+#include "kfsio/checksum.h"
+#include "qcdio/QCDLList.h"
+
+#include <map>
+
+namespace KFS
+{
+namespace client
+{
+using std::map;
+using std::less;
+using std::pair;
+
+class ChunkBlockCache
+{
+public:
+    struct Stats
+    {
+        typedef int64_t Counter;
+
+        Stats()
+            : mHitCount(0),
+              mMissCount(0),
+              mInsertCount(0),
+              mEvictCount(0),
+              mHitByteCount(0),
+              mSize(0),
+              mByteCount(0)
+            {}
+        template<typename T>
+        void Enumerate(
+            T& inFunctor) const
+        {
+            inFunctor("Hit",       mHitCount);
+            inFunctor("Miss",      mMissCount);
+            inFunctor("Insert",    mInsertCount);
+            inFunctor("Evict",     mEvictCount);
+            inFunctor("HitBytes",  mHitByteCount);
+            inFunctor("Size",      mSize);
+            inFunctor("Bytes",     mByteCount);
+        }
+        Counter mHitCount;
+        Counter mMissCount;
+        Counter mInsertCount;
+        Counter mEvictCount;
+        Counter mHitByteCount;
+        Counter mSize;
+        Counter mByteCount;
+    };
+    typedef int64_t Offset;
+
+    ChunkBlockCache(
+        int64_t inMaxBytes    = 0,
+        int     inMaxReadSize = 2 * CHECKSUM_BLOCKSIZE);
+    ~ChunkBlockCache();
+    void SetParameters(
+        int64_t inMaxBytes,
+        int     inMaxReadSize);
+    bool IsEnabled() const
+        { return (CHECKSUM_BLOCKSIZE <= mMaxBytes && 0 < mMaxReadSize); }
+    // Max. checksum block aligned read size that goes through the cache. The
+    // larger reads bypass the cache, in order not to evict the blocks of small
+    // reads with sequential scans.
+    int GetMaxReadSize() const
+        { return mMaxReadSize; }
+    // Returns true and appends the data to the buffer if all the blocks
+    // covering the chunk range are in the cache.
+    bool Get(
+        kfsChunkId_t inChunkId,
+        int64_t      inChunkVersion,
+        Offset       inOffset,
+        int          inSize,
+        IOBuffer&    outBuffer);
+    // Inserts all full checksum blocks from the buffer, the chunk offset
+    // must be checksum block aligned. The buffer data is shared, not copied.
+    void Put(
+        kfsChunkId_t    inChunkId,
+        int64_t         inChunkVersion,
+        Offset          inOffset,
+        const IOBuffer& inBuffer,
+        int             inSize);
+    void Clear();
+    void GetStats(
+        Stats& outStats) const
+    {
+        outStats = mStats;
+        outStats.mSize      = (Stats::Counter)mMap.size();
+        outStats.mByteCount = mByteCount;
+    }
+private:
+    struct Key
+    {
+        Key(
+            kfsChunkId_t inChunkId      = -1,
+            int64_t      inChunkVersion = -1,
+            int64_t      inBlockIdx     = -1)
+            : mChunkId(inChunkId),
+              mChunkVersion(inChunkVersion),
+              mBlockIdx(inBlockIdx)
+            {}
+        bool operator<(
+            const Key& inRhs) const
+        {
+            return (mChunkId < inRhs.mChunkId || (mChunkId == inRhs.mChunkId &&
+                (mChunkVersion < inRhs.mChunkVersion ||
+                (mChunkVersion == inRhs.mChunkVersion &&
+                    mBlockIdx < inRhs.mBlockIdx))));
+        }
+        kfsChunkId_t mChunkId;
+        int64_t      mChunkVersion;
+        int64_t      mBlockIdx;
+    };
+    class Entry
+    {
+    public:
+        Entry(
+            const Key& inKey)
+            : mKey(inKey),
+              mData()
+            { List::Init(*this); }
+        Key const mKey;
+        IOBuffer  mData;
+    private:
+        Entry*    mPrevPtr[1];
+        Entry*    mNextPtr[1];
+
+        friend class QCDLListOp<Entry, 0>;
+    private:
+        Entry(
+            const Entry& inEntry);
+        Entry& operator=(
+            const Entry& inEntry);
+    };
+    typedef QCDLList<Entry, 0> List;
+    typedef map<
+        Key,
+        Entry*,
+        less<Key>,
+        StdFastAllocator<pair<const Key, Entry*> >
+    > Map;
+
+    Map     mMap;
+    int64_t mMaxBytes;
+    int     mMaxReadSize;
+    int64_t mByteCount;
+    Stats   mStats;
+    Entry*  mLru[1];
+
+    void Erase(
+        Map::iterator inIt);
+    void Evict();
+private:
+    ChunkBlockCache(
+        const ChunkBlockCache& inCache);
+    ChunkBlockCache& operator=(
+        const ChunkBlockCache& inCache);
+};
+
+}}
+
+#endif /* CHUNK_BLOCK_CACHE_H */
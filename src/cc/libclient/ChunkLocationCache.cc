@@ -0,0 +1,165 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client wide chunk location cache implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "ChunkLocationCache.h"
+
+namespace KFS
+{
+namespace client
+{
+using std::make_pair;
+
+ChunkLocationCache::ChunkLocationCache(
+    size_t inMaxEntries,
+    int    inTtlSec)
+    : mMap(),
+      mMaxEntries(inMaxEntries),
+      mTtlSec(inTtlSec),
+      mStats()
+{
+    List::Init(mLru);
+}
+
+ChunkLocationCache::~ChunkLocationCache()
+{
+    ChunkLocationCache::Clear();
+}
+
+void
+ChunkLocationCache::SetParameters(
+    size_t inMaxEntries,
+    int    inTtlSec)
+{
+    mMaxEntries = inMaxEntries;
+    mTtlSec     = inTtlSec;
+    if (! IsEnabled()) {
+        Clear();
+        return;
+    }
+    Entry* thePtr;
+    while (mMaxEntries < mMap.size() && (thePtr = List::Front(mLru))) {
+        mStats.mEvictCount++;
+        Erase(mMap.find(thePtr->mKey));
+    }
+}
+
+bool
+ChunkLocationCache::Get(
+    kfsFileId_t   inFileId,
+    chunkOff_t    inChunkOffset,
+    time_t        inNow,
+    kfsChunkId_t& outChunkId,
+    int64_t&      outChunkVersion,
+    bool&         outServersOrderedFlag,
+    Servers&      outServers)
+{
+    if (! IsEnabled()) {
+        return false;
+    }
+    Map::iterator const theIt = mMap.find(Key(inFileId, inChunkOffset));
+    if (theIt == mMap.end()) {
+        mStats.mMissCount++;
+        return false;
+    }
+    Entry& theEntry = theIt->second;
+    if (theEntry.mExpirationTime <= inNow) {
+        mStats.mExpiredCount++;
+        mStats.mMissCount++;
+        Erase(theIt);
+        return false;
+    }
+    mStats.mHitCount++;
+    outChunkId            = theEntry.mChunkId;
+    outChunkVersion       = theEntry.mChunkVersion;
+    outServersOrderedFlag = theEntry.mServersOrderedFlag;
+    outServers            = theEntry.mServers;
+    List::PushBack(mLru, theEntry);
+    return true;
+}
+
+void
+ChunkLocationCache::Put(
+    kfsFileId_t    inFileId,
+    chunkOff_t     inChunkOffset,
+    time_t         inNow,
+    kfsChunkId_t   inChunkId,
+    int64_t        inChunkVersion,
+    bool           inServersOrderedFlag,
+    const Servers& inServers)
+{
+    if (! IsEnabled() || inChunkId <= 0 || inServers.empty()) {
+        return;
+    }
+    const Key                  theKey(inFileId, inChunkOffset);
+    pair<Map::iterator, bool> const theRes =
+        mMap.insert(make_pair(theKey, Entry()));
+    Entry& theEntry = theRes.first->second;
+    if (theRes.second) {
+        List::Init(theEntry);
+        theEntry.mKey = theKey;
+        mStats.mInsertCount++;
+    }
+    theEntry.mExpirationTime     = inNow + mTtlSec;
+    theEntry.mChunkId            = inChunkId;
+    theEntry.mChunkVersion       = inChunkVersion;
+    theEntry.mServersOrderedFlag = inServersOrderedFlag;
+    theEntry.mServers            = inServers;
+    List::PushBack(mLru, theEntry);
+    Entry* thePtr;
+    while (mMaxEntries < mMap.size() && (thePtr = List::Front(mLru))) {
+        mStats.mEvictCount++;
+        Erase(mMap.find(thePtr->mKey));
+    }
+}
+
+void
+ChunkLocationCache::Invalidate(
+    kfsFileId_t  inFileId,
+    chunkOff_t   inChunkOffset)
+{
+    Map::iterator const theIt = mMap.find(Key(inFileId, inChunkOffset));
+    if (theIt == mMap.end()) {
+        return;
+    }
+    mStats.mInvalidateCount++;
+    Erase(theIt);
+}
+
+void
+ChunkLocationCache::Clear()
+{
+    List::Init(mLru);
+    mMap.clear();
+}
+
+void
+ChunkLocationCache::Erase(
+    ChunkLocationCache::Map::iterator inIt)
+{
+    List::Remove(mLru, inIt->second);
+    mMap.erase(inIt);
+}
+
+}}
@@ -0,0 +1,179 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client wide LRU cache of chunk locations: (file id, chunk file offset) to
+// (chunk id, version, chunk servers). Shared by all readers of a protocol
+// worker, in order to avoid repeating get alloc meta server requests with
+// re-opens and multiple readers of the same file. The entries expire after
+// the configured time, and are invalidated by the readers on chunk server
+// errors. The cache is not thread safe, and is intended to be used only from
+// the protocol worker thread.
+//
+//----------------------------------------------------------------------------
+
+#ifndef CHUNK_LOCATION_CACHE_H
+#define CHUNK_LOCATION_CACHE_H
+
+#include "common/kfstypes.h"
+#include "common/kfsdecls.h"
+#include "common/StdAllocator.h"
+#include "qcdio/QCDLList.h"
+
+#include <map>
+#include <vector>
+#include <utility>
+
+#include <time.h>
+
+namespace KFS
+{
+namespace client
+{
+using std::map;
+using std::vector;
+using std::pair;
+using std::less;
+
+class ChunkLocationCache
+{
+public:
+    struct Stats
+    {
+        typedef int64_t Counter;
+
+        Stats()
+            : mHitCount(0),
+              mMissCount(0),
+              mExpiredCount(0),
+              mInvalidateCount(0),
+              mEvictCount(0),
+              mInsertCount(0),
+              mSize(0)
+            {}
+        template<typename T>
+        void Enumerate(
+            T& inFunctor) const
+        {
+            inFunctor("Hit",        mHitCount);
+            inFunctor("Miss",       mMissCount);
+            inFunctor("Expired",    mExpiredCount);
+            inFunctor("Invalidate", mInvalidateCount);
+            inFunctor("Evict",      mEvictCount);
+            inFunctor("Insert",     mInsertCount);
+            inFunctor("Size",       mSize);
+        }
+        Counter mHitCount;
+        Counter mMissCount;
+        Counter mExpiredCount;
+        Counter mInvalidateCount;
+        Counter mEvictCount;
+        Counter mInsertCount;
+        Counter mSize;
+    };
+    typedef vector<ServerLocation> Servers;
+
+    ChunkLocationCache(
+        size_t inMaxEntries = 0,
+        int    inTtlSec     = 30);
+    ~ChunkLocationCache();
+    void SetParameters(
+        size_t inMaxEntries,
+        int    inTtlSec);
+    bool IsEnabled() const
+        { return (0 < mMaxEntries && 0 < mTtlSec); }
+    // Returns true and sets the chunk location outputs, if valid entry exists.
+    bool Get(
+        kfsFileId_t   inFileId,
+        chunkOff_t    inChunkOffset,
+        time_t        inNow,
+        kfsChunkId_t& outChunkId,
+        int64_t&      outChunkVersion,
+        bool&         outServersOrderedFlag,
+        Servers&      outServers);
+    void Put(
+        kfsFileId_t    inFileId,
+        chunkOff_t     inChunkOffset,
+        time_t         inNow,
+        kfsChunkId_t   inChunkId,
+        int64_t        inChunkVersion,
+        bool           inServersOrderedFlag,
+        const Servers& inServers);
+    void Invalidate(
+        kfsFileId_t  inFileId,
+        chunkOff_t   inChunkOffset);
+    void Clear();
+    void GetStats(
+        Stats& outStats) const
+    {
+        outStats = mStats;
+        outStats.mSize = (Stats::Counter)mMap.size();
+    }
+private:
+    typedef pair<kfsFileId_t, chunkOff_t> Key;
+    class Entry
+    {
+    public:
+        Entry()
+            : mKey(-1, -1),
+              mExpirationTime(0),
+              mChunkId(-1),
+              mChunkVersion(-1),
+              mServersOrderedFlag(false),
+              mServers()
+            { List::Init(*this); }
+        Key          mKey;
+        time_t       mExpirationTime;
+        kfsChunkId_t mChunkId;
+        int64_t      mChunkVersion;
+        bool         mServersOrderedFlag;
+        Servers      mServers;
+    private:
+        Entry*       mPrevPtr[1];
+        Entry*       mNextPtr[1];
+
+        friend class QCDLListOp<Entry, 0>;
+    };
+    typedef QCDLList<Entry, 0> List;
+    typedef map<
+        Key,
+        Entry,
+        less<Key>,
+        StdFastAllocator<pair<const Key, Entry> >
+    > Map;
+
+    Map    mMap;
+    size_t mMaxEntries;
+    int    mTtlSec;
+    Stats  mStats;
+    Entry* mLru[1];
+
+    void Erase(
+        Map::iterator inIt);
+private:
+    ChunkLocationCache(
+        const ChunkLocationCache& inCache);
+    ChunkLocationCache& operator=(
+        const ChunkLocationCache& inCache);
+};
+
+}}
+
+#endif /* CHUNK_LOCATION_CACHE_H */
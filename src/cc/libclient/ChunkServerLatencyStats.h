@@ -0,0 +1,167 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client observed chunk server op latency histograms, and retry counters per
+// chunk server and op type. Shared by all readers, writers, and appenders of
+// a protocol worker. The stats are not thread safe, and are intended to be
+// used only from the protocol worker thread.
+//
+//----------------------------------------------------------------------------
+
+#ifndef CHUNK_SERVER_LATENCY_STATS_H
+#define CHUNK_SERVER_LATENCY_STATS_H
+
+#include "common/kfsdecls.h"
+#include "common/LatencyHistogram.h"
+#include "common/StdAllocator.h"
+
+#include <map>
+#include <string>
+
+namespace KFS
+{
+namespace client
+{
+using std::map;
+using std::less;
+using std::pair;
+using std::make_pair;
+using std::string;
+
+class ChunkServerLatencyStats
+{
+public:
+    enum OpType
+    {
+        kOpTypeRead   = 0,
+        kOpTypeWrite  = 1,
+        kOpTypeAppend = 2,
+        kOpTypeCount
+    };
+    typedef LatencyHistogram::Counter Counter;
+
+    ChunkServerLatencyStats(
+        size_t inMaxServerCount = 4 << 10)
+        : mServers(),
+          mTotals(),
+          mMaxServerCount(inMaxServerCount)
+        {}
+    void Add(
+        OpType                inType,
+        const ServerLocation& inLocation,
+        int64_t               inUsec)
+    {
+        mTotals.mHistograms[inType].Add(inUsec);
+        Entry* const thePtr = GetEntry(inLocation);
+        if (thePtr) {
+            thePtr->mHistograms[inType].Add(inUsec);
+        }
+    }
+    void AddRetry(
+        OpType                inType,
+        const ServerLocation& inLocation)
+    {
+        mTotals.mRetryCount[inType]++;
+        Entry* const thePtr = GetEntry(inLocation);
+        if (thePtr) {
+            thePtr->mRetryCount[inType]++;
+        }
+    }
+    template<typename T>
+    void Enumerate(
+        T& inEnumerator) const
+    {
+        Enumerate(inEnumerator, "Total", mTotals);
+        for (Servers::const_iterator theIt = mServers.begin();
+                theIt != mServers.end();
+                ++theIt) {
+            Enumerate(inEnumerator, theIt->first.ToString(), theIt->second);
+        }
+    }
+private:
+    struct Entry
+    {
+        Entry()
+        {
+            for (int i = 0; i < kOpTypeCount; i++) {
+                mRetryCount[i] = 0;
+            }
+        }
+        LatencyHistogram mHistograms[kOpTypeCount];
+        Counter          mRetryCount[kOpTypeCount];
+    };
+    typedef map<
+        ServerLocation,
+        Entry,
+        less<ServerLocation>,
+        StdFastAllocator<pair<const ServerLocation, Entry> >
+    > Servers;
+
+    Servers      mServers;
+    Entry        mTotals;
+    size_t const mMaxServerCount;
+
+    Entry* GetEntry(
+        const ServerLocation& inLocation)
+    {
+        Servers::iterator theIt = mServers.find(inLocation);
+        if (theIt == mServers.end()) {
+            if (! inLocation.IsValid() || mMaxServerCount <= mServers.size()) {
+                return 0;
+            }
+            theIt = mServers.insert(make_pair(inLocation, Entry())).first;
+        }
+        return &theIt->second;
+    }
+    template<typename T>
+    static void Enumerate(
+        T&            inEnumerator,
+        const string& inName,
+        const Entry&  inEntry)
+    {
+        static const char* const kOpNames[kOpTypeCount] =
+            { "Read", "Write", "Append" };
+        string thePrefix;
+        for (int i = 0; i < kOpTypeCount; i++) {
+            if (inEntry.mHistograms[i].GetCount() <= 0 &&
+                    inEntry.mRetryCount[i] <= 0) {
+                continue;
+            }
+            thePrefix = "Latency.";
+            thePrefix += kOpNames[i];
+            thePrefix += ".";
+            thePrefix += inName;
+            thePrefix += ".";
+            inEnumerator.SetPrefix(thePrefix.c_str());
+            inEntry.mHistograms[i].Enumerate(inEnumerator);
+            inEnumerator("Retries", inEntry.mRetryCount[i]);
+        }
+    }
+private:
+    ChunkServerLatencyStats(
+        const ChunkServerLatencyStats& inStats);
+    ChunkServerLatencyStats& operator=(
+        const ChunkServerLatencyStats& inStats);
+};
+
+}}
+
+#endif /* CHUNK_SERVER_LATENCY_STATS_H */
@@ -31,6 +31,7 @@
 #include "KfsNetClient.h"
 
 #include <map>
+#include <vector>
 #include <utility>
 #include <sstream>
 
@@ -45,10 +46,16 @@ using std::map;
 using std::less;
 using std::ostringstream;
 using std::string;
+using std::vector;
 
 // Client connection (KfsNetClient) pool. Used to reduce number of chunk
-// server connections. Presently used only with radix sort with write append
-// with M clients each appending to N buckets.
+// server connections, and the number of chunk server authentication
+// handshakes, by sharing connections between the readers and appenders of the
+// protocol worker. The ops of different readers and appenders are multiplexed
+// over the same connection, and matched to the responses by the op sequence
+// numbers. Up to max connections per server are created: Get() returns the
+// connection with the least number of pending ops, and creates a new
+// connection only if all existing connections have at least max pending ops.
 class ClientPool
 {
 public:
@@ -67,7 +74,9 @@ public:
         int                inMaxContentLength               = MAX_RPC_HEADER_LEN,
         bool               inFailAllOpsOnOpTimeoutFlag      = false,
         bool               inMaxOneOutstandingOpFlag        = false,
-        ClientAuthContext* inAuthContextPtr                 = 0)
+        ClientAuthContext* inAuthContextPtr                 = 0,
+        int                inMaxConnectionsPerServer        = 1,
+        int                inMaxPendingOpsPerConnection     = 0)
         : mClients(),
           mNetManager(inNetManager),
           mMaxRetryCount(inMaxRetryCount),
@@ -81,44 +90,76 @@ public:
           mMaxContentLength(inMaxContentLength),
           mFailAllOpsOnOpTimeoutFlag(inFailAllOpsOnOpTimeoutFlag),
           mMaxOneOutstandingOpFlag(inMaxOneOutstandingOpFlag),
-          mAuthContextPtr(inAuthContextPtr)
+          mAuthContextPtr(inAuthContextPtr),
+          mMaxConnectionsPerServer(
+            inMaxConnectionsPerServer < 1 ? 1 : inMaxConnectionsPerServer),
+          mMaxPendingOpsPerConnection(
+            inMaxPendingOpsPerConnection < 0 ? 0 :
+            (size_t)inMaxPendingOpsPerConnection),
+          mSize(0)
         {}
     ~ClientPool()
     {
         for (Clients::const_iterator it = mClients.begin();
                 it != mClients.end();
                 ++it) {
-            delete it->second;
+            for (Connections::const_iterator theIt = it->second.begin();
+                    theIt != it->second.end();
+                    ++theIt) {
+                delete *theIt;
+            }
         }
     }
     KfsNetClient& Get(
         const ServerLocation& inLocation)
     {
-        Clients::iterator it = mClients.find(inLocation);
-        if (it == mClients.end()) {
-            ostringstream theStream;
-            theStream <<
-                mLogPrefix << (mLogPrefix.empty() ? "" : ":") <<
-                inLocation.hostname << ":" << inLocation.port;
-            const string thePrefix = theStream.str();
-            it = mClients.insert(make_pair(inLocation, new KfsNetClient(
-                mNetManager,
-                inLocation.hostname,
-                inLocation.port,
-                mMaxRetryCount,
-                mTimeSecBetweenRetries,
-                mOpTimeoutSec,
-                mIdleTimeoutSec,
-                mInitialSeqNum++,
-                thePrefix.c_str(),
-                mResetConnectionOnOpTimeoutFlag,
-                mMaxContentLength,
-                mFailAllOpsOnOpTimeoutFlag,
-                mMaxOneOutstandingOpFlag,
-                mAuthContextPtr))).first;
-            it->second->SetRetryConnectOnly(mRetryConnectOnlyFlag);
+        Connections&  theConnections = mClients[inLocation];
+        KfsNetClient* theBestPtr     = 0;
+        size_t        theMinPending  = 0;
+        for (Connections::const_iterator it = theConnections.begin();
+                it != theConnections.end();
+                ++it) {
+            const size_t thePending = (*it)->GetPendingOpsCount();
+            if (! theBestPtr || thePending < theMinPending) {
+                theBestPtr    = *it;
+                theMinPending = thePending;
+                if (theMinPending <= 0) {
+                    break;
+                }
+            }
+        }
+        if (theBestPtr && (mMaxPendingOpsPerConnection <= 0 ||
+                theMinPending < mMaxPendingOpsPerConnection ||
+                mMaxConnectionsPerServer <= (int)theConnections.size())) {
+            return *theBestPtr;
+        }
+        ostringstream theStream;
+        theStream <<
+            mLogPrefix << (mLogPrefix.empty() ? "" : ":") <<
+            inLocation.hostname << ":" << inLocation.port;
+        if (! theConnections.empty()) {
+            theStream << "#" << theConnections.size();
         }
-        return *(it->second);
+        const string thePrefix = theStream.str();
+        KfsNetClient* const theRetPtr = new KfsNetClient(
+            mNetManager,
+            inLocation.hostname,
+            inLocation.port,
+            mMaxRetryCount,
+            mTimeSecBetweenRetries,
+            mOpTimeoutSec,
+            mIdleTimeoutSec,
+            mInitialSeqNum++,
+            thePrefix.c_str(),
+            mResetConnectionOnOpTimeoutFlag,
+            mMaxContentLength,
+            mFailAllOpsOnOpTimeoutFlag,
+            mMaxOneOutstandingOpFlag,
+            mAuthContextPtr);
+        theRetPtr->SetRetryConnectOnly(mRetryConnectOnlyFlag);
+        theConnections.push_back(theRetPtr);
+        mSize++;
+        return *theRetPtr;
     }
     void GetStats(
         Stats& outStats) const
@@ -128,8 +169,12 @@ public:
         for (Clients::const_iterator it = mClients.begin();
                 it != mClients.end();
                 ++it) {
-            it->second->GetStats(theStats);
-            outStats.Add(theStats);
+            for (Connections::const_iterator theIt = it->second.begin();
+                    theIt != it->second.end();
+                    ++theIt) {
+                (*theIt)->GetStats(theStats);
+                outStats.Add(theStats);
+            }
         }
     }
     void ClearMaxOneOutstandingOpFlag(
@@ -143,8 +188,13 @@ public:
             for (Clients::const_iterator theIt = mClients.begin();
                     theIt != mClients.end();
                     ++theIt) {
-                theIt->second->SetFailAllOpsOnOpTimeoutFlag(
-                    mFailAllOpsOnOpTimeoutFlag);
+                for (Connections::const_iterator theCIt =
+                            theIt->second.begin();
+                        theCIt != theIt->second.end();
+                        ++theCIt) {
+                    (*theCIt)->SetFailAllOpsOnOpTimeoutFlag(
+                        mFailAllOpsOnOpTimeoutFlag);
+                }
             }
             return;
         }
@@ -153,19 +203,26 @@ public:
         for (Clients::const_iterator theIt = mClients.begin();
                 theIt != mClients.end();
                 ++theIt) {
-            theIt->second->SetFailAllOpsOnOpTimeoutFlag(
-                mFailAllOpsOnOpTimeoutFlag);
-            theIt->second->ClearMaxOneOutstandingOpFlag();
+            for (Connections::const_iterator theCIt = theIt->second.begin();
+                    theCIt != theIt->second.end();
+                    ++theCIt) {
+                (*theCIt)->SetFailAllOpsOnOpTimeoutFlag(
+                    mFailAllOpsOnOpTimeoutFlag);
+                (*theCIt)->ClearMaxOneOutstandingOpFlag();
+            }
         }
     }
     size_t GetSize() const
+        { return mSize; }
+    size_t GetServerCount() const
         { return mClients.size(); }
 private:
+    typedef vector<KfsNetClient*> Connections;
     typedef map<
         ServerLocation,
-        KfsNetClient*,
+        Connections,
         less<ServerLocation>,
-        StdFastAllocator<pair<const ServerLocation, KfsNetClient*> >
+        StdFastAllocator<pair<const ServerLocation, Connections> >
     > Clients;
     Clients            mClients;
     NetManager&        mNetManager;
@@ -181,6 +238,9 @@ private:
     bool               mFailAllOpsOnOpTimeoutFlag;
     bool               mMaxOneOutstandingOpFlag;
     ClientAuthContext* mAuthContextPtr;
+    const int          mMaxConnectionsPerServer;
+    const size_t       mMaxPendingOpsPerConnection;
+    size_t             mSize;
 private:
     ClientPool(
         const ClientPool& inPool);
@@ -0,0 +1,522 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client side per file block compression implementation.
+//
+// The chunk header layout, all integers are little endian:
+// 0  magic "QFSZ"
+// 4  codec
+// 8  logical block size
+// 12 block count
+// 16 chunk logical size, 8 bytes
+// 24 reserved, 8 bytes
+// 32 block count entries: the block physical length, the most significant
+//    bit is set if the block is stored uncompressed.
+//
+//----------------------------------------------------------------------------
+
+#include "CompressedFile.h"
+
+#include "common/MsgLogger.h"
+#include "kfsio/IOBuffer.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <string.h>
+
+namespace KFS
+{
+namespace client
+{
+using std::min;
+using std::max;
+
+const chunkOff_t CompressedFile::kChunkLogicalSize;
+
+static const char     kMagic[4]     = { 'Q', 'F', 'S', 'Z' };
+static const uint32_t kRawBlockFlag = uint32_t(1) << 31;
+// Favor speed, the data is compressed on the write path.
+static const int      kDeflateLevel = 1;
+
+static inline void
+Put32(
+    char*    inPtr,
+    uint64_t inVal)
+{
+    for (int i = 0; i < 4; i++) {
+        inPtr[i] = (char)((inVal >> (8 * i)) & 0xFF);
+    }
+}
+
+static inline void
+Put64(
+    char*    inPtr,
+    uint64_t inVal)
+{
+    Put32(inPtr, inVal);
+    Put32(inPtr + 4, inVal >> 32);
+}
+
+static inline uint32_t
+Get32(
+    const char* inPtr)
+{
+    uint32_t theRet = 0;
+    for (int i = 3; 0 <= i; i--) {
+        theRet = (theRet << 8) | (unsigned char)inPtr[i];
+    }
+    return theRet;
+}
+
+static inline uint64_t
+Get64(
+    const char* inPtr)
+{
+    return ((uint64_t)Get32(inPtr + 4) << 32 | Get32(inPtr));
+}
+
+static inline chunkOff_t
+GetBlockPos(
+    const vector<uint32_t>& inIndex,
+    size_t                  inBlock)
+{
+    chunkOff_t theRet = 0;
+    for (size_t i = 0; i < inBlock; i++) {
+        theRet += inIndex[i] & ~kRawBlockFlag;
+    }
+    return theRet;
+}
+
+class InflateOutput : public ZlibInflate::Output
+{
+public:
+    InflateOutput(
+        vector<char>& inBuf)
+        : mBuf(inBuf),
+          mLen(0)
+        {}
+    virtual int GetBuffer(
+        char*&  outBufferPtr,
+        size_t& outBufferSize)
+    {
+        // Anything past the block size is invalid.
+        if (mBuf.size() <= mLen) {
+            return -EIO;
+        }
+        outBufferPtr  = &mBuf[0] + mLen;
+        outBufferSize = mBuf.size() - mLen;
+        return 0;
+    }
+    virtual int Write(
+        const char* /* inBufferPtr */,
+        size_t      inBufferSize)
+    {
+        mLen += inBufferSize;
+        return 0;
+    }
+    size_t GetLength() const
+        { return mLen; }
+private:
+    vector<char>& mBuf;
+    size_t        mLen;
+};
+
+CompressedFile::CompressedFile(
+    Io&        inIo,
+    int        inFd,
+    int        inCodec,
+    chunkOff_t inPhysicalSize,
+    bool       inWriteFlag)
+    : mIo(inIo),
+      mFd(inFd),
+      mCodec(inCodec),
+      mWriteFlag(inWriteFlag),
+      mStatus(0),
+      mSize(0),
+      mPhysicalSize(inPhysicalSize < 0 ? chunkOff_t(0) : inPhysicalSize),
+      mWriteChunk(0),
+      mWritePos(0),
+      mWriteIndex(),
+      mWriteBufLen(0),
+      mReadChunk(-1),
+      mReadChunkSize(0),
+      mReadIndex(),
+      mReadBlock(-1),
+      mReadBufLen(0),
+      mWriteBuf(),
+      mReadBuf(),
+      mTmpBuf(),
+      mDeflate(kDeflateLevel),
+      mInflate()
+{
+    if (mWriteFlag) {
+        mWriteBuf.resize(kBlockSize);
+    }
+}
+
+CompressedFile::~CompressedFile()
+{}
+
+int
+CompressedFile::Load()
+{
+    if (mPhysicalSize <= 0) {
+        return mStatus;
+    }
+    const chunkOff_t theChunk = (mPhysicalSize - 1) / (chunkOff_t)CHUNKSIZE;
+    int theStatus = LoadIndex(theChunk);
+    if (theStatus < 0) {
+        return theStatus;
+    }
+    mSize = theChunk * kChunkLogicalSize + mReadChunkSize;
+    if (! mWriteFlag) {
+        return 0;
+    }
+    mWriteChunk = theChunk;
+    mWriteIndex = mReadIndex;
+    mWritePos   = GetBlockPos(mWriteIndex, mWriteIndex.size());
+    const int theTail = (int)(mReadChunkSize % kBlockSize);
+    if (theTail == 0) {
+        if ((int)mWriteIndex.size() < kBlocksPerChunk) {
+            return 0;
+        }
+        mWriteChunk++;
+        mWriteIndex.clear();
+        mWritePos = 0;
+        return 0;
+    }
+    // Move the last partial block into the write buffer, the block is
+    // re-written by the subsequent writes.
+    const chunkOff_t theBlock = (chunkOff_t)mWriteIndex.size() - 1;
+    if ((theStatus = ReadBlock(theChunk, theBlock)) < 0) {
+        return theStatus;
+    }
+    memcpy(&mWriteBuf[0], &mReadBuf[0], theTail);
+    mWriteBufLen = theTail;
+    mWritePos -= mWriteIndex.back() & ~kRawBlockFlag;
+    mWriteIndex.pop_back();
+    return 0;
+}
+
+int
+CompressedFile::LoadIndex(
+    chunkOff_t inChunk)
+{
+    if (mReadChunk == inChunk) {
+        return 0;
+    }
+    mReadChunk = -1;
+    mReadBlock = -1;
+    mReadIndex.clear();
+    mTmpBuf.resize(kMaxIndexSize);
+    const ssize_t theNRd = mIo.ReadPhysical(mFd, &mTmpBuf[0], kMaxIndexSize,
+        inChunk * (chunkOff_t)CHUNKSIZE);
+    if (theNRd < 0) {
+        return (int)theNRd;
+    }
+    const char* const thePtr   = &mTmpBuf[0];
+    const uint32_t    theCount = kIndexHeaderSize <= theNRd ?
+        Get32(thePtr + 12) : uint32_t(0);
+    const uint64_t    theSize  = Get64(thePtr + 16);
+    if (theNRd < kIndexHeaderSize ||
+            memcmp(thePtr, kMagic, sizeof(kMagic)) != 0 ||
+            Get32(thePtr + 4) != (uint32_t)mCodec ||
+            Get32(thePtr + 8) != (uint32_t)kBlockSize ||
+            theCount <= 0 || (uint32_t)kBlocksPerChunk < theCount ||
+            theNRd < (ssize_t)(kIndexHeaderSize + theCount * 4) ||
+            (uint64_t)theCount * kBlockSize < theSize ||
+            theSize <= (uint64_t)(theCount - 1) * kBlockSize) {
+        KFS_LOG_STREAM_ERROR <<
+            "fd: "     << mFd <<
+            " chunk: " << inChunk <<
+            " invalid compressed chunk header" <<
+            " read: "  << theNRd <<
+        KFS_LOG_EOM;
+        return -EIO;
+    }
+    mReadIndex.reserve(theCount);
+    for (uint32_t i = 0; i < theCount; i++) {
+        mReadIndex.push_back(Get32(thePtr + kIndexHeaderSize + i * 4));
+    }
+    mReadChunk     = inChunk;
+    mReadChunkSize = (chunkOff_t)theSize;
+    return 0;
+}
+
+int
+CompressedFile::ReadBlock(
+    chunkOff_t inChunk,
+    chunkOff_t inBlock)
+{
+    if (mReadChunk == inChunk && mReadBlock == inBlock) {
+        return 0;
+    }
+    int theStatus = LoadIndex(inChunk);
+    if (theStatus < 0) {
+        return theStatus;
+    }
+    mReadBlock = -1;
+    if ((chunkOff_t)mReadIndex.size() <= inBlock) {
+        return -EIO;
+    }
+    const int        theLen     = (int)min(
+        mReadChunkSize - inBlock * kBlockSize, (chunkOff_t)kBlockSize);
+    const uint32_t   theEntry   = mReadIndex[inBlock];
+    const bool       theRawFlag = (theEntry & kRawBlockFlag) != 0;
+    const int        thePhysLen = (int)(theEntry & ~kRawBlockFlag);
+    const chunkOff_t thePos     = inChunk * (chunkOff_t)CHUNKSIZE +
+        kHeaderSize + GetBlockPos(mReadIndex, (size_t)inBlock);
+    // One extra byte to detect blocks that inflate past the block size.
+    mReadBuf.resize(kBlockSize + 1);
+    if (theRawFlag) {
+        if (thePhysLen != theLen) {
+            return -EIO;
+        }
+        const ssize_t theNRd = mIo.ReadPhysical(
+            mFd, &mReadBuf[0], theLen, thePos);
+        if (theNRd != theLen) {
+            return (theNRd < 0 ? (int)theNRd : -EIO);
+        }
+    } else {
+        if (thePhysLen <= 0 || kBlockSize < thePhysLen) {
+            return -EIO;
+        }
+        mTmpBuf.resize(thePhysLen);
+        const ssize_t theNRd = mIo.ReadPhysical(
+            mFd, &mTmpBuf[0], thePhysLen, thePos);
+        if (theNRd != thePhysLen) {
+            return (theNRd < 0 ? (int)theNRd : -EIO);
+        }
+        InflateOutput theOutput(mReadBuf);
+        bool          theDoneFlag = false;
+        mInflate.Reset();
+        theStatus = mInflate.Run(
+            &mTmpBuf[0], thePhysLen, theOutput, theDoneFlag);
+        if (theStatus != 0 || ! theDoneFlag ||
+                theOutput.GetLength() != (size_t)theLen) {
+            KFS_LOG_STREAM_ERROR <<
+                "fd: "        << mFd <<
+                " chunk: "    << inChunk <<
+                " block: "    << inBlock <<
+                " inflate: "  << mInflate.StrError(theStatus) <<
+                " length: "   << theOutput.GetLength() <<
+                " expected: " << theLen <<
+            KFS_LOG_EOM;
+            return -EIO;
+        }
+    }
+    mReadBlock  = inBlock;
+    mReadBufLen = theLen;
+    return 0;
+}
+
+ssize_t
+CompressedFile::Read(
+    char*      inBufPtr,
+    size_t     inSize,
+    chunkOff_t inPos)
+{
+    if (mStatus < 0) {
+        return mStatus;
+    }
+    if (mWriteFlag || inPos < 0) {
+        return -EINVAL;
+    }
+    if (mSize <= inPos) {
+        return 0;
+    }
+    const size_t theSize = (size_t)min((chunkOff_t)inSize, mSize - inPos);
+    size_t       theRet  = 0;
+    while (theRet < theSize) {
+        const chunkOff_t thePos    = inPos + (chunkOff_t)theRet;
+        const chunkOff_t theChunk  = thePos / kChunkLogicalSize;
+        const chunkOff_t theOff    = thePos % kChunkLogicalSize;
+        const chunkOff_t theBlock  = theOff / kBlockSize;
+        const int        theBOff   = (int)(theOff % kBlockSize);
+        const int        theStatus = ReadBlock(theChunk, theBlock);
+        if (theStatus < 0) {
+            return theStatus;
+        }
+        if (mReadBufLen <= theBOff) {
+            return -EIO;
+        }
+        const size_t theLen = min(theSize - theRet,
+            (size_t)(mReadBufLen - theBOff));
+        memcpy(inBufPtr + theRet, &mReadBuf[theBOff], theLen);
+        theRet += theLen;
+    }
+    return (ssize_t)theRet;
+}
+
+ssize_t
+CompressedFile::Write(
+    const char* inBufPtr,
+    size_t      inSize,
+    chunkOff_t  inPos)
+{
+    if (mStatus < 0) {
+        return mStatus;
+    }
+    if (! mWriteFlag) {
+        return -EINVAL;
+    }
+    if (inPos != mSize) {
+        return -ESPIPE;
+    }
+    size_t theRet = 0;
+    while (theRet < inSize) {
+        const size_t theLen = min(inSize - theRet,
+            (size_t)(kBlockSize - mWriteBufLen));
+        memcpy(&mWriteBuf[mWriteBufLen], inBufPtr + theRet, theLen);
+        mWriteBufLen += (int)theLen;
+        mSize        += (chunkOff_t)theLen;
+        theRet       += theLen;
+        if (mWriteBufLen < kBlockSize) {
+            break;
+        }
+        int theStatus = WriteBlock();
+        if (theStatus < 0) {
+            return Fail(theStatus);
+        }
+        mWriteBufLen = 0;
+        if ((int)mWriteIndex.size() < kBlocksPerChunk) {
+            continue;
+        }
+        if ((theStatus = WriteHeader()) < 0) {
+            return Fail(theStatus);
+        }
+        mWriteChunk++;
+        mWriteIndex.clear();
+        mWritePos = 0;
+    }
+    return (ssize_t)theRet;
+}
+
+int
+CompressedFile::WriteBlock()
+{
+    IOBuffer theIn;
+    IOBuffer theOut;
+    theIn.CopyIn(&mWriteBuf[0], mWriteBufLen);
+    const int theStatus = mDeflate.Run(theIn, theOut);
+    if (theStatus != 0) {
+        KFS_LOG_STREAM_ERROR <<
+            "fd: "       << mFd <<
+            " deflate: " << mDeflate.StrError(theStatus) <<
+        KFS_LOG_EOM;
+        return -EIO;
+    }
+    const int   theCompLen = theOut.BytesConsumable();
+    const bool  theRawFlag = mWriteBufLen <= theCompLen;
+    const int   theLen     = theRawFlag ? mWriteBufLen : theCompLen;
+    const char* thePtr     = &mWriteBuf[0];
+    if (! theRawFlag) {
+        mTmpBuf.resize(theLen);
+        theOut.CopyOut(&mTmpBuf[0], theLen);
+        thePtr = &mTmpBuf[0];
+    }
+    const chunkOff_t thePos = mWriteChunk * (chunkOff_t)CHUNKSIZE +
+        kHeaderSize + mWritePos;
+    const ssize_t theNWr = mIo.WritePhysical(mFd, thePtr, theLen, thePos);
+    if (theNWr != theLen) {
+        return (theNWr < 0 ? (int)theNWr : -EIO);
+    }
+    mWriteIndex.push_back((uint32_t)theLen | (theRawFlag ? kRawBlockFlag : 0));
+    mWritePos     += theLen;
+    mPhysicalSize = max(mPhysicalSize, thePos + theLen);
+    return 0;
+}
+
+int
+CompressedFile::WriteHeader()
+{
+    if (mWriteIndex.empty()) {
+        return 0;
+    }
+    const int theLen = kIndexHeaderSize + (int)mWriteIndex.size() * 4;
+    mTmpBuf.assign(theLen, 0);
+    char* const thePtr = &mTmpBuf[0];
+    memcpy(thePtr, kMagic, sizeof(kMagic));
+    Put32(thePtr + 4,  (uint32_t)mCodec);
+    Put32(thePtr + 8,  (uint32_t)kBlockSize);
+    Put32(thePtr + 12, (uint32_t)mWriteIndex.size());
+    Put64(thePtr + 16, (uint64_t)(mSize - mWriteChunk * kChunkLogicalSize));
+    for (size_t i = 0; i < mWriteIndex.size(); i++) {
+        Put32(thePtr + kIndexHeaderSize + i * 4, mWriteIndex[i]);
+    }
+    const ssize_t theNWr = mIo.WritePhysical(
+        mFd, thePtr, theLen, mWriteChunk * (chunkOff_t)CHUNKSIZE);
+    if (theNWr != theLen) {
+        return (theNWr < 0 ? (int)theNWr : -EIO);
+    }
+    if (mReadChunk == mWriteChunk) {
+        mReadChunk = -1;
+        mReadBlock = -1;
+    }
+    return 0;
+}
+
+int
+CompressedFile::FlushSelf(
+    bool inCloseFlag)
+{
+    if (mStatus < 0 || ! mWriteFlag) {
+        return mStatus;
+    }
+    const int        theBufLen = mWriteBufLen;
+    const chunkOff_t theWrPos  = mWritePos;
+    int              theStatus;
+    if (0 < theBufLen && (theStatus = WriteBlock()) < 0) {
+        return Fail(theStatus);
+    }
+    if ((theStatus = WriteHeader()) < 0) {
+        return Fail(theStatus);
+    }
+    if (inCloseFlag) {
+        mWriteBufLen = 0;
+    } else if (0 < theBufLen) {
+        // Keep the partial block buffered, and re-write it with the next
+        // block write.
+        mWriteIndex.pop_back();
+        mWritePos = theWrPos;
+    }
+    return 0;
+}
+
+void
+CompressedFile::Reset()
+{
+    mStatus        = 0;
+    mSize          = 0;
+    mPhysicalSize  = 0;
+    mWriteChunk    = 0;
+    mWritePos      = 0;
+    mWriteBufLen   = 0;
+    mReadChunk     = -1;
+    mReadChunkSize = 0;
+    mReadBlock     = -1;
+    mReadBufLen    = 0;
+    mWriteIndex.clear();
+    mReadIndex.clear();
+}
+
+}}
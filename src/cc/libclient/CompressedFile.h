@@ -0,0 +1,172 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client side per file block compression. The file data is split into fixed
+// size logical blocks, each block is compressed independently, and stored
+// uncompressed if compression does not reduce its size. Each chunk holds a
+// fixed number of logical blocks: logical chunk k maps to physical chunk k.
+// The chunk starts with the header, the index of the block compressed
+// lengths, followed by the blocks, therefore any block can be read with at
+// most two chunk reads. The logical file size is the sum of the logical
+// sizes of the preceding chunks, and the logical size of the last chunk
+// recorded in its header.
+//
+// Compressed files are written sequentially, and can be appended to. Sync
+// writes the current partial block and the chunk header, the partial block
+// is re-written by the subsequent writes. Reads have random access at block
+// granularity. Not thread safe.
+//
+//----------------------------------------------------------------------------
+
+#ifndef COMPRESSED_FILE_H
+#define COMPRESSED_FILE_H
+
+#include "common/kfstypes.h"
+#include "kfsio/checksum.h"
+#include "kfsio/ZlibDeflate.h"
+#include "kfsio/ZlibInflate.h"
+
+#include <vector>
+
+#include <sys/types.h>
+
+namespace KFS
+{
+namespace client
+{
+using std::vector;
+
+class CompressedFile
+{
+public:
+    class Io
+    {
+    public:
+        // Read or write the physical file data at the physical position.
+        // Return the number of bytes transferred, or negative error code.
+        virtual ssize_t ReadPhysical(
+            int        inFd,
+            char*      inBufPtr,
+            size_t     inSize,
+            chunkOff_t inPos) = 0;
+        virtual ssize_t WritePhysical(
+            int         inFd,
+            const char* inBufPtr,
+            size_t      inSize,
+            chunkOff_t  inPos) = 0;
+    protected:
+        Io()
+            {}
+        virtual ~Io()
+            {}
+    };
+    enum
+    {
+        kBlockSize       = CHECKSUM_BLOCKSIZE,
+        kHeaderSize      = CHECKSUM_BLOCKSIZE,
+        kBlocksPerChunk  = (CHUNKSIZE - kHeaderSize) / kBlockSize,
+        kIndexHeaderSize = 32,
+        kMaxIndexSize    = kIndexHeaderSize + kBlocksPerChunk * 4
+    };
+    static const chunkOff_t kChunkLogicalSize =
+        (chunkOff_t)kBlocksPerChunk * kBlockSize;
+
+    CompressedFile(
+        Io&        inIo,
+        int        inFd,
+        int        inCodec,
+        chunkOff_t inPhysicalSize,
+        bool       inWriteFlag);
+    ~CompressedFile();
+    // Read the last chunk header to determine the logical size, and, with
+    // write, load the last partial block in order to continue writing.
+    int Load();
+    ssize_t Read(
+        char*      inBufPtr,
+        size_t     inSize,
+        chunkOff_t inPos);
+    // Only sequential writes at the logical end of the file are supported.
+    ssize_t Write(
+        const char* inBufPtr,
+        size_t      inSize,
+        chunkOff_t  inPos);
+    int Flush()
+        { return FlushSelf(false); }
+    int Close()
+        { return FlushSelf(true); }
+    // Discard the file content, the file was truncated to 0.
+    void Reset();
+    chunkOff_t GetSize() const
+        { return mSize; }
+    chunkOff_t GetPhysicalSize() const
+        { return mPhysicalSize; }
+private:
+    typedef vector<uint32_t> Index;
+
+    Io&          mIo;
+    const int    mFd;
+    const int    mCodec;
+    const bool   mWriteFlag;
+    int          mStatus;
+    chunkOff_t   mSize;
+    chunkOff_t   mPhysicalSize;
+    chunkOff_t   mWriteChunk;
+    chunkOff_t   mWritePos;
+    Index        mWriteIndex;
+    int          mWriteBufLen;
+    chunkOff_t   mReadChunk;
+    chunkOff_t   mReadChunkSize;
+    Index        mReadIndex;
+    chunkOff_t   mReadBlock;
+    int          mReadBufLen;
+    vector<char> mWriteBuf;
+    vector<char> mReadBuf;
+    vector<char> mTmpBuf;
+    ZlibDeflate  mDeflate;
+    ZlibInflate  mInflate;
+
+    int LoadIndex(
+        chunkOff_t inChunk);
+    int ReadBlock(
+        chunkOff_t inChunk,
+        chunkOff_t inBlock);
+    int WriteBlock();
+    int WriteHeader();
+    int FlushSelf(
+        bool inCloseFlag);
+    int Fail(
+        int inStatus)
+    {
+        if (mStatus == 0) {
+            mStatus = inStatus;
+        }
+        return mStatus;
+    }
+private:
+    CompressedFile(
+        const CompressedFile& inFile);
+    CompressedFile& operator=(
+        const CompressedFile& inFile);
+};
+
+}}
+
+#endif /* COMPRESSED_FILE_H */
@@ -33,6 +33,7 @@
 #include "common/kfsatomic.h"
 #include "common/StdAllocator.h"
 #include "common/IntToString.h"
+#include "common/time.h"
 
 #include "qcdio/QCUtils.h"
 #include "qcdio/QCDLList.h"
@@ -42,6 +43,7 @@
 #include <sstream>
 
 #include <stdlib.h>
+#include <string.h>
 #endif
 
 namespace KFS
@@ -74,7 +76,7 @@ protected:
         return (inMethodType == KFS_STRIPED_FILE_TYPE_RS_JERASURE);
     }
     virtual string GetDescription() const
-        { return mDescription; }
+        { return mDescription + mTechniques; }
     void Release(
         int inMethodType)
     {
@@ -129,6 +131,23 @@ protected:
     }
 private:
     enum { kMaxCodersCacheCount = 2 << 10 };
+    // Galois field region multiply variants that produce identical results
+    // and do not change the data layout, i.e. without "ALTMAP". Therefore
+    // the encoded data remains the same regardless of the variant selected.
+    struct Technique
+    {
+        const char* mNamePtr;
+        int         mMultType;
+        int         mRegionType;
+        int         mArg1;
+        int         mArg2;
+    };
+    enum
+    {
+        // Default stripe size.
+        kTuneRegionSize  = 64 << 10,
+        kTuneIterations  = 16
+    };
     class JXCoder;
     typedef map<
         pair<int, int>,
@@ -257,10 +276,126 @@ private:
 
     typedef JXCoder::List LruList;
     const string mDescription;
+    string       mTechniques;
     JXCoders     mJXCoders;
     JXCoder*     mLru[1];
     bool         mInitDoneFlag;
 
+    static const Technique* GetTechniques(
+        int inW)
+    {
+        static const Technique sW8[] = {
+            { "split 8 4",       GF_MULT_SPLIT_TABLE, GF_REGION_DEFAULT, 8, 4 },
+            { "split 8 4 nosse", GF_MULT_SPLIT_TABLE, GF_REGION_NOSSE,   8, 4 },
+            { "table double",    GF_MULT_TABLE,  GF_REGION_DOUBLE_TABLE, 0, 0 },
+            { "table",           GF_MULT_TABLE,       GF_REGION_DEFAULT, 0, 0 },
+            { "log",             GF_MULT_LOG_TABLE,   GF_REGION_DEFAULT, 0, 0 },
+            { 0, 0, 0, 0, 0 }
+        };
+        static const Technique sW16[] = {
+            { "split 16 4",       GF_MULT_SPLIT_TABLE, GF_REGION_DEFAULT, 16, 4 },
+            { "split 16 4 nosse", GF_MULT_SPLIT_TABLE, GF_REGION_NOSSE,   16, 4 },
+            { "split 16 8",       GF_MULT_SPLIT_TABLE, GF_REGION_DEFAULT, 16, 8 },
+            { "log",              GF_MULT_LOG_TABLE,   GF_REGION_DEFAULT,  0, 0 },
+            { 0, 0, 0, 0, 0 }
+        };
+        static const Technique sW32[] = {
+            { "split 32 4",       GF_MULT_SPLIT_TABLE, GF_REGION_DEFAULT, 32, 4 },
+            { "split 32 4 nosse", GF_MULT_SPLIT_TABLE, GF_REGION_NOSSE,   32, 4 },
+            { "split 32 8",       GF_MULT_SPLIT_TABLE, GF_REGION_DEFAULT, 32, 8 },
+            { 0, 0, 0, 0, 0 }
+        };
+        return (inW == 8 ? sW8 : (inW == 16 ? sW16 : sW32));
+    }
+    // Benchmark region multiply variants supported by the gf-complete build
+    // and the cpu with stripe size regions, and install the fastest as the
+    // jerasure "w" field. The jerasure default field is used as the
+    // reference for the results validation, and is kept if no variant is
+    // faster.
+    void TuneField(
+        int inW)
+    {
+        gf_t* const theDefaultPtr = galois_get_field_ptr(inW);
+        void*       theBufPtr     = 0;
+        if (! theDefaultPtr || posix_memalign(
+                &theBufPtr, 64, 3 * kTuneRegionSize) != 0 || ! theBufPtr) {
+            return;
+        }
+        char* const theSrcPtr = reinterpret_cast<char*>(theBufPtr);
+        char* const theRefPtr = theSrcPtr + kTuneRegionSize;
+        char* const theDstPtr = theRefPtr + kTuneRegionSize;
+        for (int i = 0; i < kTuneRegionSize; i++) {
+            theSrcPtr[i] = (char)((i * 131 + 7) ^ (i >> 8));
+        }
+        const gf_val_32_t theVal = 0x8e;
+        memset(theRefPtr, 0, kTuneRegionSize);
+        theDefaultPtr->multiply_region.w32(theDefaultPtr,
+            theSrcPtr, theRefPtr, theVal, kTuneRegionSize, 1);
+        const int64_t theDefaultTime = TimeRegionMultiply(
+            *theDefaultPtr, theSrcPtr, theDstPtr, theVal);
+        int64_t          theBestTime = theDefaultTime;
+        const Technique* theBestPtr  = 0;
+        for (const Technique* thePtr = GetTechniques(inW);
+                thePtr->mNamePtr;
+                ++thePtr) {
+            gf_t theGf;
+            memset(&theGf, 0, sizeof(theGf));
+            if (! gf_init_hard(&theGf, inW, thePtr->mMultType,
+                    thePtr->mRegionType, GF_DIVIDE_DEFAULT, 0,
+                    thePtr->mArg1, thePtr->mArg2, 0, 0)) {
+                if (theGf.scratch) {
+                    gf_free(&theGf, 0);
+                }
+                continue;
+            }
+            memset(theDstPtr, 0, kTuneRegionSize);
+            theGf.multiply_region.w32(&theGf,
+                theSrcPtr, theDstPtr, theVal, kTuneRegionSize, 1);
+            if (memcmp(theDstPtr, theRefPtr, kTuneRegionSize) == 0) {
+                const int64_t theTime = TimeRegionMultiply(
+                    theGf, theSrcPtr, theDstPtr, theVal);
+                if (theTime < theBestTime) {
+                    theBestTime = theTime;
+                    theBestPtr  = thePtr;
+                }
+            }
+            gf_free(&theGf, 0);
+        }
+        free(theBufPtr);
+        mTechniques += "; w ";
+        AppendDecIntToString(mTechniques, inW) += ": ";
+        if (theBestPtr) {
+            gf_t* const theGfPtr =
+                reinterpret_cast<gf_t*>(malloc(sizeof(gf_t)));
+            if (theGfPtr) {
+                memset(theGfPtr, 0, sizeof(*theGfPtr));
+                if (gf_init_hard(theGfPtr, inW, theBestPtr->mMultType,
+                        theBestPtr->mRegionType, GF_DIVIDE_DEFAULT, 0,
+                        theBestPtr->mArg1, theBestPtr->mArg2, 0, 0)) {
+                    // Jerasure frees the scratch of the default field.
+                    galois_change_technique(theGfPtr, inW);
+                    mTechniques += theBestPtr->mNamePtr;
+                    return;
+                }
+                free(theGfPtr);
+            }
+        }
+        mTechniques += "default";
+    }
+    static int64_t TimeRegionMultiply(
+        gf_t&       inGf,
+        char*       inSrcPtr,
+        char*       inDstPtr,
+        gf_val_32_t inVal)
+    {
+        const int64_t theStart = microseconds();
+        for (int i = 0; i < kTuneIterations; i++) {
+            inGf.multiply_region.w32(&inGf,
+                inSrcPtr, inDstPtr, inVal, kTuneRegionSize, 1);
+        }
+        return (microseconds() - theStart);
+    }
+
     JXCoder* GetXCoder(
         int     inMethodType,
         int     inStripeCount,
@@ -300,6 +435,10 @@ private:
                 }
                 return 0;
             }
+            mTechniques.clear();
+            for (int theW = 8; theW <= 32; theW *= 2) {
+                TuneField(theW);
+            }
             mInitDoneFlag = true;
         }
         JXCoders::iterator const theIt = mJXCoders.find(make_pair(
@@ -350,6 +489,7 @@ protected:
     QCECMethodJerasure()
         : ECMethod(),
           mDescription(Describe()),
+          mTechniques(),
           mJXCoders(),
           mInitDoneFlag(false)
         { LruList::Init(mLru); }
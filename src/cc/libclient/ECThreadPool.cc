@@ -0,0 +1,290 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Erasure code worker thread pool implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "ECThreadPool.h"
+
+#include "qcdio/qcstutils.h"
+#include "qcdio/qcdebug.h"
+#include "qcdio/QCUtils.h"
+
+#include <algorithm>
+
+namespace KFS
+{
+namespace client
+{
+using std::max;
+using std::min;
+
+ECThreadPool::ECThreadPool(
+    int inThreadCount,
+    int inMinParallelSize)
+    : mThreadCount(max(0, inThreadCount)),
+      mMinParallelSize(max(0, inMinParallelSize)),
+      mWorkersPtr(0 < mThreadCount ? new Worker[mThreadCount] : 0),
+      mMutex(),
+      mWorkCond(),
+      mDoneCond(),
+      mBuffers(),
+      mLengths(),
+      mBufferCount(0),
+      mPendingBytes(0),
+      mEncoderPtr(0),
+      mDecoderPtr(0),
+      mTaskPtr(0),
+      mStripeCount(0),
+      mRecoveryStripeCount(0),
+      mMissingStripesIdxPtr(0),
+      mNextIdx(0),
+      mEndIdx(0),
+      mClaimCount(1),
+      mDoneCount(0),
+      mStatus(0),
+      mRunFlag(true),
+      mStats()
+{
+    for (int i = 0; i < mThreadCount; i++) {
+        mWorkersPtr[i].Start(*this, i);
+    }
+}
+
+ECThreadPool::~ECThreadPool()
+{
+    {
+        QCStMutexLocker theLocker(mMutex);
+        mRunFlag = false;
+        mWorkCond.NotifyAll();
+    }
+    for (int i = 0; i < mThreadCount; i++) {
+        mWorkersPtr[i].Join();
+    }
+    delete [] mWorkersPtr;
+}
+
+void
+ECThreadPool::Add(
+    int    inBufferCount,
+    int    inLength,
+    void** inBuffersPtr)
+{
+    QCASSERT(0 < inBufferCount && 0 < inLength);
+    if (mLengths.empty()) {
+        mBufferCount = inBufferCount;
+    } else {
+        QCRTASSERT(inBufferCount == mBufferCount);
+    }
+    mBuffers.insert(mBuffers.end(), inBuffersPtr, inBuffersPtr + inBufferCount);
+    mLengths.push_back(inLength);
+    mPendingBytes += inLength;
+}
+
+void
+ECThreadPool::Clear()
+{
+    mBuffers.clear();
+    mLengths.clear();
+    mPendingBytes = 0;
+}
+
+int
+ECThreadPool::Encode(
+    ECMethod::Encoder& inEncoder,
+    int                inStripeCount,
+    int                inRecoveryStripeCount)
+{
+    return Run(&inEncoder, 0, inStripeCount, inRecoveryStripeCount, 0);
+}
+
+int
+ECThreadPool::Decode(
+    ECMethod::Decoder& inDecoder,
+    int                inStripeCount,
+    int                inRecoveryStripeCount,
+    int const*         inMissingStripesIdxPtr)
+{
+    return Run(0, &inDecoder, inStripeCount, inRecoveryStripeCount,
+        inMissingStripesIdxPtr);
+}
+
+int
+ECThreadPool::Run(
+    ECMethod::Encoder* inEncoderPtr,
+    ECMethod::Decoder* inDecoderPtr,
+    int                inStripeCount,
+    int                inRecoveryStripeCount,
+    int const*         inMissingStripesIdxPtr)
+{
+    const int theCount = (int)mLengths.size();
+    if (theCount <= 0) {
+        return 0;
+    }
+    QCRTASSERT(inStripeCount + inRecoveryStripeCount == mBufferCount);
+    mEncoderPtr           = inEncoderPtr;
+    mDecoderPtr           = inDecoderPtr;
+    mStripeCount          = inStripeCount;
+    mRecoveryStripeCount  = inRecoveryStripeCount;
+    mMissingStripesIdxPtr = inMissingStripesIdxPtr;
+    const int theStatus = RunSelf(theCount, mPendingBytes);
+    mEncoderPtr           = 0;
+    mDecoderPtr           = 0;
+    mMissingStripesIdxPtr = 0;
+    Clear();
+    return theStatus;
+}
+
+int
+ECThreadPool::Run(
+    ECThreadPool::Task& inTask,
+    int                 inSegmentCount,
+    int64_t             inByteCount)
+{
+    if (inSegmentCount <= 0) {
+        return 0;
+    }
+    QCRTASSERT(mLengths.empty() && ! mTaskPtr);
+    mTaskPtr = &inTask;
+    const int theStatus = RunSelf(inSegmentCount, inByteCount);
+    mTaskPtr = 0;
+    return theStatus;
+}
+
+int
+ECThreadPool::RunSelf(
+    int     inCount,
+    int64_t inByteCount)
+{
+    const int theCount = inCount;
+    mStats.mRunCount++;
+    mStats.mSegmentCount += theCount;
+    mStats.mByteCount    += inByteCount;
+    int theStatus = 0;
+    if (mThreadCount <= 0 || theCount <= 1 ||
+            inByteCount < mMinParallelSize) {
+        for (int i = 0; i < theCount; i++) {
+            const int theRet = Process(i);
+            if (theRet != 0 && theStatus == 0) {
+                theStatus = theRet;
+            }
+        }
+    } else {
+        mStats.mParallelRunCount++;
+        QCStMutexLocker theLocker(mMutex);
+        mNextIdx    = 0;
+        mEndIdx     = theCount;
+        mDoneCount  = 0;
+        mStatus     = 0;
+        // Claim a few segments at a time to reduce the mutex contention, while
+        // still balancing the load between the threads.
+        mClaimCount = max(1, theCount / ((mThreadCount + 1) * 4));
+        mWorkCond.NotifyAll();
+        Process();
+        while (mDoneCount < mEndIdx) {
+            mDoneCond.Wait(mMutex);
+        }
+        theStatus = mStatus;
+        mNextIdx  = 0;
+        mEndIdx   = 0;
+    }
+    return theStatus;
+}
+
+int
+ECThreadPool::Process(
+    int inIdx)
+{
+    if (mTaskPtr) {
+        return mTaskPtr->Process(inIdx);
+    }
+    void** const theBuffersPtr = &mBuffers[0] + (size_t)inIdx * mBufferCount;
+    if (mEncoderPtr) {
+        return mEncoderPtr->Encode(
+            mStripeCount, mRecoveryStripeCount, mLengths[inIdx],
+            theBuffersPtr);
+    }
+    return mDecoderPtr->Decode(
+        mStripeCount, mRecoveryStripeCount, mLengths[inIdx],
+        theBuffersPtr, mMissingStripesIdxPtr);
+}
+
+void
+ECThreadPool::Process()
+{
+    // Mutex must be locked.
+    while (mNextIdx < mEndIdx) {
+        const int theStart = mNextIdx;
+        const int theEnd   = min(mEndIdx, theStart + mClaimCount);
+        int       theStatus = 0;
+        mNextIdx = theEnd;
+        {
+            QCStMutexUnlocker theUnlocker(mMutex);
+            for (int i = theStart; i < theEnd; i++) {
+                const int theRet = Process(i);
+                if (theRet != 0 && theStatus == 0) {
+                    theStatus = theRet;
+                }
+            }
+        }
+        if (theStatus != 0 && mStatus == 0) {
+            mStatus = theStatus;
+        }
+        mDoneCount += theEnd - theStart;
+        if (mEndIdx <= mDoneCount) {
+            mDoneCond.Notify();
+        }
+    }
+}
+
+void
+ECThreadPool::WorkerRun()
+{
+    QCStMutexLocker theLocker(mMutex);
+    while (mRunFlag) {
+        if (mNextIdx < mEndIdx) {
+            Process();
+        } else {
+            mWorkCond.Wait(mMutex);
+        }
+    }
+}
+
+void
+ECThreadPool::Worker::Start(
+    ECThreadPool& inPool,
+    int           inIdx)
+{
+    mPoolPtr = &inPool;
+    const int kStackSize = 64 << 10;
+    string    theName("ECThreadPool");
+    theName += (char)('0' + inIdx % 10);
+    mThread.Start(this, kStackSize, theName.c_str());
+}
+
+void
+ECThreadPool::Worker::Run()
+{
+    mPoolPtr->WorkerRun();
+}
+
+}}
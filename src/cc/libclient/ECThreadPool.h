@@ -0,0 +1,190 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Erasure code worker thread pool. The striper queues the encode or decode
+// segments, each with its own set of stripe buffer pointers, and then runs
+// the queued segments in parallel on the pool threads and the calling thread.
+// The segments must not overlap, as the byte ranges are processed
+// independently. The run returns after all segments are processed, therefore
+// the striper write ordering logic is not affected. The pool is intended to be
+// used only from the protocol worker thread. The pool also runs generic tasks
+// split into independent segments, for example, the read checksum
+// verification.
+//
+//----------------------------------------------------------------------------
+
+#ifndef EC_THREAD_POOL_H
+#define EC_THREAD_POOL_H
+
+#include "ECMethod.h"
+
+#include "qcdio/QCMutex.h"
+#include "qcdio/QCThread.h"
+
+#include <vector>
+
+namespace KFS
+{
+namespace client
+{
+using std::vector;
+
+class ECThreadPool
+{
+public:
+    struct Stats
+    {
+        typedef int64_t Counter;
+
+        Stats()
+            : mRunCount(0),
+              mParallelRunCount(0),
+              mSegmentCount(0),
+              mByteCount(0)
+            {}
+        template<typename T>
+        void Enumerate(
+            T& inFunctor) const
+        {
+            inFunctor("Runs",         mRunCount);
+            inFunctor("ParallelRuns", mParallelRunCount);
+            inFunctor("Segments",     mSegmentCount);
+            inFunctor("Bytes",        mByteCount);
+        }
+        Counter mRunCount;
+        Counter mParallelRunCount;
+        Counter mSegmentCount;
+        Counter mByteCount;
+    };
+    class Task
+    {
+    public:
+        // Process segment, invoked concurrently with different indexes.
+        virtual int Process(
+            int inIdx) = 0;
+    protected:
+        virtual ~Task() {}
+    };
+
+    ECThreadPool(
+        int inThreadCount,
+        int inMinParallelSize = 256 << 10);
+    ~ECThreadPool();
+    int GetThreadCount() const
+        { return mThreadCount; }
+    bool IsEmpty() const
+        { return mLengths.empty(); }
+    // Queue segment, the buffer pointers are copied.
+    void Add(
+        int    inBufferCount,
+        int    inLength,
+        void** inBuffersPtr);
+    void Clear();
+    // Run all queued segments, and clear the queue. Returns first non 0
+    // encoder or decoder status.
+    int Encode(
+        ECMethod::Encoder& inEncoder,
+        int                inStripeCount,
+        int                inRecoveryStripeCount);
+    int Decode(
+        ECMethod::Decoder& inDecoder,
+        int                inStripeCount,
+        int                inRecoveryStripeCount,
+        int const*         inMissingStripesIdxPtr);
+    // Run task segments from 0 to count - 1. The byte count is used to decide
+    // if the parallel run is worth the thread synchronization overhead.
+    // Returns first non 0 segment status.
+    int Run(
+        Task&   inTask,
+        int     inSegmentCount,
+        int64_t inByteCount);
+    void GetStats(
+        Stats& outStats) const
+        { outStats = mStats; }
+private:
+    class Worker : public QCRunnable
+    {
+    public:
+        Worker()
+            : mPoolPtr(0),
+              mThread()
+            {}
+        void Start(
+            ECThreadPool& inPool,
+            int           inIdx);
+        void Join()
+            { mThread.Join(); }
+        virtual void Run();
+    private:
+        ECThreadPool* mPoolPtr;
+        QCThread      mThread;
+    };
+    friend class Worker;
+    typedef vector<void*> Buffers;
+    typedef vector<int>   Lengths;
+
+    const int          mThreadCount;
+    const int          mMinParallelSize;
+    Worker* const      mWorkersPtr;
+    QCMutex            mMutex;
+    QCCondVar          mWorkCond;
+    QCCondVar          mDoneCond;
+    Buffers            mBuffers;
+    Lengths            mLengths;
+    int                mBufferCount;
+    int64_t            mPendingBytes;
+    ECMethod::Encoder* mEncoderPtr;
+    ECMethod::Decoder* mDecoderPtr;
+    Task*              mTaskPtr;
+    int                mStripeCount;
+    int                mRecoveryStripeCount;
+    int const*         mMissingStripesIdxPtr;
+    int                mNextIdx;
+    int                mEndIdx;
+    int                mClaimCount;
+    int                mDoneCount;
+    int                mStatus;
+    bool               mRunFlag;
+    Stats              mStats;
+
+    int Run(
+        ECMethod::Encoder* inEncoderPtr,
+        ECMethod::Decoder* inDecoderPtr,
+        int                inStripeCount,
+        int                inRecoveryStripeCount,
+        int const*         inMissingStripesIdxPtr);
+    int RunSelf(
+        int     inCount,
+        int64_t inByteCount);
+    void Process();
+    int Process(
+        int inIdx);
+    void WorkerRun();
+private:
+    ECThreadPool(
+        const ECThreadPool& inPool);
+    ECThreadPool& operator=(
+        const ECThreadPool& inPool);
+};
+
+}}
+
+#endif /* EC_THREAD_POOL_H */
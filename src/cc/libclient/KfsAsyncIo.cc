@@ -0,0 +1,274 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Asynchronous positional read and write with user completion callbacks.
+//
+//----------------------------------------------------------------------------
+
+#include "KfsClientInt.h"
+#include "KfsProtocolWorker.h"
+#include "common/MsgLogger.h"
+#include "qcdio/qcstutils.h"
+
+#include <cerrno>
+#include <limits>
+
+#include <fcntl.h>
+
+namespace KFS
+{
+namespace client
+{
+
+using std::min;
+using std::max;
+using std::numeric_limits;
+
+// Asynchronous request that invokes user completion, and deletes itself when
+// done. With no copy async write the protocol worker invokes Done() when the
+// write buffer is released, with no error code. The write errors are
+// reported by the subsequent sync and close.
+class AsyncIoRequest : public KfsProtocolWorker::Request
+{
+public:
+    typedef KfsClient::IoCompletion Completion;
+
+    AsyncIoRequest(
+        int         inFd,
+        bool        inWriteFlag,
+        bool        inSkipHolesFlag,
+        Completion& inCompletion,
+        chunkOff_t  inPackedOffset = 0)
+        : Request(),
+          mOpenParams(),
+          mCompletion(inCompletion),
+          mFd(inFd),
+          mWriteFlag(inWriteFlag),
+          mSkipHolesFlag(inSkipHolesFlag),
+          mPackedOffset(inPackedOffset)
+        {}
+    virtual void Done(
+        int64_t inStatus)
+    {
+        Completion&      theCompletion = mCompletion;
+        const int        theFd         = mFd;
+        const chunkOff_t thePos        = GetOffset() - mPackedOffset;
+        char* const      theBufPtr     = reinterpret_cast<char*>(
+            GetBufferPtr());
+        int64_t          theStatus     = inStatus;
+        if (mWriteFlag) {
+            if (0 <= theStatus) {
+                theStatus = GetSize();
+            }
+        } else if (theStatus == -ENOENT && mSkipHolesFlag) {
+            theStatus = 0;
+        }
+        delete this;
+        theCompletion.Done(theFd, thePos, theBufPtr, (ssize_t)theStatus);
+    }
+    Params mOpenParams;
+private:
+    Completion&      mCompletion;
+    const int        mFd;
+    const bool       mWriteFlag;
+    const bool       mSkipHolesFlag;
+    // Packed file read, see FileAttr::GetReadOffset().
+    const chunkOff_t mPackedOffset;
+
+    virtual ~AsyncIoRequest()
+        {}
+private:
+    AsyncIoRequest(
+        const AsyncIoRequest& inReq);
+    AsyncIoRequest& operator=(
+        const AsyncIoRequest& inReq);
+};
+
+ssize_t
+KfsClientImpl::ReadAsync(
+    int                      inFd,
+    chunkOff_t               inPos,
+    char*                    inBufPtr,
+    size_t                   inSize,
+    KfsClient::IoCompletion& inCompletion)
+{
+    if (! inBufPtr || inPos < 0) {
+        return -EINVAL;
+    }
+
+    QCStMutexLocker theLocker(mMutex);
+
+    if (! valid_fd(inFd)) {
+        KFS_LOG_STREAM_ERROR <<
+            "async read error invalid fd: " << inFd <<
+        KFS_LOG_EOM;
+        return -EBADF;
+    }
+    FileTableEntry& theEntry = *mFileTable[inFd];
+    if (theEntry.openMode == O_WRONLY || theEntry.cachedAttrFlag) {
+        return -EINVAL;
+    }
+    if (theEntry.fattr.isDirectory) {
+        return -EISDIR;
+    }
+    if (theEntry.compressedFile) {
+        return -ENOTSUP;
+    }
+    const int64_t kChunkSize = (int64_t)CHUNKSIZE;
+    const int64_t theEof     = theEntry.eofMark < 0 ?
+        theEntry.fattr.fileSize :
+        min(theEntry.eofMark, theEntry.fattr.fileSize);
+    int64_t       theSize    = min(theEof - inPos, (int64_t)min(
+        inSize, (size_t)numeric_limits<int>::max()));
+    if (theEntry.skipHoles && ! theEntry.fattr.IsPacked()) {
+        theSize = min(theSize, kChunkSize - inPos % kChunkSize);
+    }
+    if (theSize <= 0) {
+        return 0;
+    }
+    StartProtocolWorker();
+    AsyncIoRequest& theReq = *(new AsyncIoRequest(
+        inFd, false, theEntry.skipHoles && ! theEntry.fattr.IsPacked(),
+        inCompletion, theEntry.fattr.GetReadOffset(0)));
+    KfsProtocolWorker::Request::Params& theParams = theReq.mOpenParams;
+    theParams.mPathName            = theEntry.pathname;
+    theParams.mFileSize            = theEntry.fattr.GetReadFileSize();
+    theParams.mStriperType         = theEntry.fattr.striperType;
+    theParams.mStripeSize          = theEntry.fattr.stripeSize;
+    theParams.mStripeCount         = theEntry.fattr.numStripes;
+    theParams.mRecoveryStripeCount = theEntry.fattr.numRecoveryStripes;
+    theParams.mReplicaCount        = theEntry.fattr.numReplicas;
+    theParams.mSkipHolesFlag       =
+        theEntry.skipHoles && ! theEntry.fattr.IsPacked();
+    theParams.mFailShortReadsFlag  = theEntry.failShortReadsFlag;
+    theParams.mMsgLogId            = inFd;
+    theReq.Reset(
+        KfsProtocolWorker::kRequestTypeReadAsync,
+        theEntry.instance + 1,
+        theEntry.fattr.GetReadFileId(),
+        &theParams,
+        inBufPtr,
+        (int)theSize,
+        0, // inMaxPending,
+        theEntry.fattr.GetReadOffset(inPos)
+    );
+    theEntry.readUsedProtocolWorkerFlag = true;
+    KfsProtocolWorker& theWorker = GetProtocolWorker(theEntry.instance);
+    theLocker.Unlock();
+    QCASSERT(! mMutex.IsOwned());
+
+    theWorker.Enqueue(theReq);
+    return (ssize_t)theSize;
+}
+
+ssize_t
+KfsClientImpl::WriteAsync(
+    int                      inFd,
+    chunkOff_t               inPos,
+    const char*              inBufPtr,
+    size_t                   inSize,
+    KfsClient::IoCompletion& inCompletion)
+{
+    if (! inBufPtr || inPos < 0) {
+        return -EINVAL;
+    }
+    if ((size_t)numeric_limits<int>::max() < inSize ||
+            inPos + (chunkOff_t)inSize < 0) {
+        return -EFBIG;
+    }
+
+    QCStMutexLocker theLocker(mMutex);
+
+    if (! valid_fd(inFd)) {
+        KFS_LOG_STREAM_ERROR <<
+            "async write error invalid fd: " << inFd <<
+        KFS_LOG_EOM;
+        return -EBADF;
+    }
+    FileTableEntry& theEntry = *mFileTable[inFd];
+    if (theEntry.openMode == O_RDONLY || (theEntry.openMode & O_APPEND) != 0) {
+        return -EINVAL;
+    }
+    if (theEntry.fattr.fileId <= 0) {
+        return -EBADF;
+    }
+    if (theEntry.fattr.isDirectory) {
+        return -EISDIR;
+    }
+    if (theEntry.compressedFile) {
+        return -ENOTSUP;
+    }
+    if (inSize <= 0) {
+        return 0;
+    }
+    StartProtocolWorker();
+    AsyncIoRequest& theReq = *(new AsyncIoRequest(
+        inFd, true, false, inCompletion));
+    KfsProtocolWorker::Request::Params* theParamsPtr = 0;
+    if (! theEntry.usedProtocolWorkerFlag) {
+        theParamsPtr = &theReq.mOpenParams;
+        KfsProtocolWorker::Request::Params& theParams = *theParamsPtr;
+        theParams.mPathName            = theEntry.pathname;
+        theParams.mFileSize            = theEntry.fattr.fileSize;
+        theParams.mStriperType         = theEntry.fattr.striperType;
+        theParams.mStripeSize          = theEntry.fattr.stripeSize;
+        theParams.mStripeCount         = theEntry.fattr.numStripes;
+        theParams.mRecoveryStripeCount = theEntry.fattr.numRecoveryStripes;
+        theParams.mReplicaCount        = theEntry.fattr.numReplicas;
+        theParams.mMsgLogId            = inFd;
+        if (theEntry.fattr.striperType == KFS_STRIPED_FILE_TYPE_NONE) {
+            theParams.mDiskIoSize = theEntry.ioBufferSize;
+        } else {
+            const int kChecksumBlockSize  = (int)CHECKSUM_BLOCKSIZE;
+            const int theTotalStripeCount =
+               theEntry.fattr.numStripes + theEntry.fattr.numRecoveryStripes;
+            theParams.mDiskIoSize = (theEntry.ioBufferSize /
+                theTotalStripeCount + kChecksumBlockSize - 1) /
+                kChecksumBlockSize * kChecksumBlockSize;
+        }
+    }
+    theEntry.usedProtocolWorkerFlag = true;
+    theReq.Reset(
+        KfsProtocolWorker::kRequestTypeWriteAsyncNoCopy,
+        theEntry.instance,
+        theEntry.fattr.fileId,
+        theParamsPtr,
+        const_cast<char*>(inBufPtr),
+        (int)inSize,
+        max(0, theEntry.ioBufferSize),
+        inPos
+    );
+    KFS_LOG_STREAM_DEBUG <<
+        inFd << "," << theEntry.fattr.fileId <<
+        "," << theEntry.instance << "," << theEntry.pathname <<
+        " async write ->"
+        " offset: " << inPos <<
+        " size: "   << inSize <<
+    KFS_LOG_EOM;
+    KfsProtocolWorker& theWorker = GetProtocolWorker(theEntry.instance);
+    theLocker.Unlock();
+    QCASSERT(! mMutex.IsOwned());
+
+    theWorker.Enqueue(theReq);
+    return (ssize_t)inSize;
+}
+
+}}
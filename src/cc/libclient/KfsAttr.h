@@ -67,6 +67,12 @@ struct FileAttr : public Permissions
     int32_t         stripeSize;
     kfsSTier_t      minSTier;
     kfsSTier_t      maxSTier;
+    kfsFileId_t     packedContainer; /// pack container file id, or -1
+    chunkOff_t      packedOffset;    /// packed file data container offset
+    int16_t         compression;     /// block compression codec
+    /// Compressed file size as stored, or -1. For compressed file the
+    /// fileSize is the logical size, see CompressedFile.h
+    chunkOff_t      physicalSize;
 
     FileAttr()
         : Permissions(),
@@ -84,7 +90,11 @@ struct FileAttr : public Permissions
           striperType(KFS_STRIPED_FILE_TYPE_NONE),
           stripeSize(0),
           minSTier(kKfsSTierMax),
-          maxSTier(kKfsSTierMax)
+          maxSTier(kKfsSTierMax),
+          packedContainer(-1),
+          packedOffset(-1),
+          compression(KFS_COMPRESSION_NONE),
+          physicalSize(-1)
         {}
     void Reset()
         { *this = FileAttr(); }
@@ -101,6 +111,15 @@ struct FileAttr : public Permissions
         { return (isDirectory ? subCount1 : int64_t(0)); }
     int64_t dirCount() const
         { return (isDirectory ? subCount2 : int64_t(0)); }
+    bool IsPacked() const
+        { return (! isDirectory && 0 <= packedContainer); }
+    // Packed file data is read from the pack container file extent.
+    kfsFileId_t GetReadFileId() const
+        { return (IsPacked() ? packedContainer : fileId); }
+    chunkOff_t GetReadOffset(chunkOff_t pos) const
+        { return (IsPacked() ? packedOffset + pos : pos); }
+    chunkOff_t GetReadFileSize() const
+        { return (IsPacked() ? packedOffset + fileSize : fileSize); }
     void ToStat(struct stat& outStat) const;
 };
 
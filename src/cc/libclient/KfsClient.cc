@@ -51,6 +51,9 @@
 #include "kfsio/SslFilter.h"
 #include "kfsio/DelegationToken.h"
 
+#include "MountTable.h"
+#include "Path.h"
+
 #include <signal.h>
 #include <stdlib.h>
 
@@ -61,6 +64,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <deque>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
@@ -80,12 +84,14 @@ using std::istream;
 using std::min;
 using std::max;
 using std::map;
+using std::deque;
 using std::vector;
 using std::sort;
 using std::transform;
 using std::numeric_limits;
 using std::unique;
 using std::find;
+using std::count;
 using std::ostringstream;
 using std::cerr;
 
@@ -94,11 +100,16 @@ using boost::bind;
 
 using client::RSStriperValidate;
 using client::KfsNetClient;
+using client::MountTable;
+using client::Path;
 
 // Set read dir limit larger than meta server's default 8K, to allow to
 // make it larger, if required, by changing the meta server configuration.
 const int kMaxReaddirEntries = 16 << 10;
 const int kMaxReadDirRetries = 16;
+// Limit batched lookup request header size to leave room for the common
+// request headers, the meta server limits the max request header size.
+const size_t kMaxLookupBatchRequestSize = MAX_RPC_HEADER_LEN * 3 / 4;
 
 KfsClient*
 Connect(const char* propFile)
@@ -195,16 +206,273 @@ RandomSeqNo()
     return ((ret < 0 ? -ret : ret) >> 1);
 }
 
+// Mounted meta server clients. The mount index is stored in the high bits
+// of the file descriptors returned to the caller. Index 0 is the default meta
+// server, therefore its file descriptors remain unchanged.
+class KfsClient::Mounts
+{
+public:
+    enum { kFdShift   = 20 };
+    enum { kFdMask    = (1 << kFdShift) - 1 };
+    enum { kMaxMounts = (1 << (31 - kFdShift)) - 2 };
+
+    Mounts(
+        KfsClientImpl& inDefault)
+        : mTable(),
+          mImpls(1, &inDefault)
+        {}
+    ~Mounts()
+    {
+        for (size_t i = 1; i < mImpls.size(); i++) {
+            delete mImpls[i];
+        }
+    }
+    int Init(
+        const char*       inSpecPtr,
+        const Properties& inProps)
+    {
+        string    errMsg;
+        const int status = mTable.Parse(inSpecPtr, errMsg);
+        if (status != 0 || kMaxMounts < mTable.GetSize()) {
+            KFS_LOG_STREAM_ERROR <<
+                "mount table: " << (status != 0 ?
+                    errMsg : string("too many mounts")) <<
+            KFS_LOG_EOM;
+            return (status != 0 ? status : -EINVAL);
+        }
+        for (size_t i = 0; i < mTable.GetSize(); i++) {
+            const MountTable::Mount& mount = mTable.Get(i);
+            KfsClientImpl* const     impl  = new KfsClientImpl(0);
+            mImpls.push_back(impl);
+            const int ret = impl->Init(
+                mount.mLocation.hostname, mount.mLocation.port, &inProps);
+            if (ret < 0 || ! impl->IsInitialized()) {
+                KFS_LOG_STREAM_ERROR <<
+                    "mount: " << mount.mPrefix <<
+                    " "       << mount.mLocation <<
+                    " initialization failure: " << ErrorCodeToStr(ret) <<
+                KFS_LOG_EOM;
+                return (ret < 0 ? ret : -EHOSTUNREACH);
+            }
+            KFS_LOG_STREAM_INFO <<
+                "mount: " << mount.mPrefix <<
+                " "       << mount.mLocation <<
+            KFS_LOG_EOM;
+        }
+        return 0;
+    }
+    // Returns the mount index, and sets the absolute normalized path, as the
+    // mounted meta server clients have no notion of the current working
+    // directory. Returns -1 if the path is invalid.
+    int Find(
+        const char* inPathPtr,
+        string&     outPath) const
+    {
+        if (*inPathPtr == '/') {
+            outPath = inPathPtr;
+        } else {
+            outPath = mImpls[0]->GetCwd();
+            outPath += "/";
+            outPath += inPathPtr;
+        }
+        Path path;
+        if (! path.Set(outPath.data(), outPath.size())) {
+            return -1;
+        }
+        const bool dirFlag = path.IsDir();
+        outPath = path.NormPath();
+        const int idx = mTable.Find(outPath) + 1;
+        if (dirFlag && outPath != "/") {
+            outPath += "/";
+        }
+        return idx;
+    }
+    int Find(
+        const string& inPath,
+        string&       outPath) const
+        { return Find(inPath.c_str(), outPath); }
+    size_t GetSize() const
+        { return mImpls.size(); }
+    KfsClientImpl& Get(
+        size_t inIdx) const
+        { return *mImpls[inIdx]; }
+    // Splits the path list by mount, and invokes the functor for each mount.
+    template<typename FT>
+    int Execute(
+        const vector<string>& inPaths,
+        vector<int>&          outStatus,
+        FT&                   inFunctor) const
+    {
+        vector<vector<string> > paths(mImpls.size());
+        vector<vector<size_t> > index(mImpls.size());
+        string                  path;
+        for (size_t i = 0; i < inPaths.size(); i++) {
+            const int idx = inPaths[i].empty() ? -1 : Find(inPaths[i], path);
+            if (idx < 0) {
+                paths[0].push_back(inPaths[i]);
+                index[0].push_back(i);
+            } else {
+                paths[idx].push_back(path);
+                index[idx].push_back(i);
+            }
+        }
+        outStatus.assign(inPaths.size(), 0);
+        int         ret = 0;
+        vector<int> status;
+        for (size_t k = 0; k < mImpls.size(); k++) {
+            if (paths[k].empty()) {
+                continue;
+            }
+            status.clear();
+            const int res = inFunctor(*mImpls[k], paths[k], index[k], status);
+            if (res < 0 && ret == 0) {
+                ret = res;
+            }
+            for (size_t i = 0; i < index[k].size() && i < status.size(); i++) {
+                outStatus[index[k][i]] = status[i];
+            }
+        }
+        for (size_t i = 0; i < outStatus.size(); i++) {
+            if (outStatus[i] < 0) {
+                return outStatus[i];
+            }
+        }
+        return ret;
+    }
+    static int ToFd(
+        int inIdx,
+        int inFd)
+    {
+        return ((inFd < 0 || inIdx <= 0) ?
+            inFd : ((inIdx << kFdShift) | inFd));
+    }
+private:
+    typedef vector<KfsClientImpl*> Impls;
+
+    MountTable mTable;
+    Impls      mImpls;
+private:
+    Mounts(
+        const Mounts& inMounts);
+    Mounts& operator=(
+        const Mounts& inMounts);
+};
+
+class KfsClient::PathRoute
+{
+public:
+    PathRoute(
+        const KfsClient& inClient,
+        const char*      inPathPtr)
+        : mImplPtr(inClient.mImpl),
+          mPathPtr(inPathPtr),
+          mIdx(0),
+          mPath()
+    {
+        if (! inClient.mMountsPtr || ! inPathPtr) {
+            return;
+        }
+        mIdx = inClient.mMountsPtr->Find(inPathPtr, mPath);
+        if (mIdx < 0) {
+            mIdx = 0;
+            return;
+        }
+        mImplPtr = &inClient.mMountsPtr->Get(mIdx);
+        mPathPtr = mPath.c_str();
+    }
+    KfsClientImpl* operator->() const
+        { return mImplPtr; }
+    const char* GetPath() const
+        { return mPathPtr; }
+    int GetIndex() const
+        { return mIdx; }
+    int ToFd(
+        int inFd) const
+        { return Mounts::ToFd(mIdx, inFd); }
+private:
+    KfsClientImpl* mImplPtr;
+    const char*    mPathPtr;
+    int            mIdx;
+    string         mPath;
+};
+
+class KfsClient::FdRoute
+{
+public:
+    FdRoute(
+        const KfsClient& inClient,
+        int              inFd)
+        : mImplPtr(inClient.mImpl),
+          mFd(inFd),
+          mIdx(0)
+    {
+        if (! inClient.mMountsPtr || inFd <= Mounts::kFdMask) {
+            return;
+        }
+        const size_t idx = (size_t)(inFd >> Mounts::kFdShift);
+        if (idx < inClient.mMountsPtr->GetSize()) {
+            mImplPtr = &inClient.mMountsPtr->Get(idx);
+            mFd      = inFd & Mounts::kFdMask;
+            mIdx     = (int)idx;
+        }
+    }
+    KfsClientImpl* operator->() const
+        { return mImplPtr; }
+    int GetFd() const
+        { return mFd; }
+    int GetIndex() const
+        { return mIdx; }
+private:
+    KfsClientImpl* mImplPtr;
+    int            mFd;
+    int            mIdx;
+};
+
+// Async io completion adapter, that converts the mounted meta server client
+// file descriptor back into the caller's file descriptor, and deletes itself
+// when done.
+class MountIoCompletion : public KfsClient::IoCompletion
+{
+public:
+    MountIoCompletion(
+        KfsClient::IoCompletion& inCompletion,
+        int                      inFd)
+        : IoCompletion(),
+          mCompletion(inCompletion),
+          mFd(inFd)
+        {}
+    virtual void Done(int /* fd */, chunkOff_t pos, char* buf,
+        ssize_t status)
+    {
+        KfsClient::IoCompletion& completion = mCompletion;
+        const int                fd         = mFd;
+        delete this;
+        completion.Done(fd, pos, buf, status);
+    }
+private:
+    KfsClient::IoCompletion& mCompletion;
+    const int                mFd;
+};
+
 KfsClient::KfsClient(KfsNetClient* metaServer)
-    : mImpl(new KfsClientImpl(metaServer))
+    : mImpl(new KfsClientImpl(metaServer)),
+      mMountsPtr(0)
 {
 }
 
 KfsClient::~KfsClient()
 {
+    delete mMountsPtr;
     delete mImpl;
 }
 
+KfsClient::KfsClientImpl*
+KfsClient::GetMountImpl(size_t idx) const
+{
+    return ((mMountsPtr && idx + 1 < mMountsPtr->GetSize()) ?
+        &mMountsPtr->Get(idx + 1) : 0);
+}
+
 void
 KfsClient::SetLogLevel(const string& logLevel)
 {
@@ -220,6 +488,17 @@ KfsClient::Init(const string &metaServerHost, int metaServerPort,
     if (IsInitialized()) {
         return -EINVAL;
     }
+    const char* const mountTable = props ?
+        props->getValue("client.mountTable", (const char*)0) : 0;
+    if (mountTable && *mountTable && ! mMountsPtr) {
+        Mounts* const mounts = new Mounts(*mImpl);
+        const int     status = mounts->Init(mountTable, *props);
+        if (status < 0) {
+            delete mounts;
+            return status;
+        }
+        mMountsPtr = mounts;
+    }
     return mImpl->Init(metaServerHost, metaServerPort, props);
 }
 
@@ -232,7 +511,17 @@ KfsClient::IsInitialized()
 int
 KfsClient::Cd(const char *pathname)
 {
-    return mImpl->Cd(pathname);
+    const PathRoute route(*this, pathname);
+    if (route.GetIndex() <= 0) {
+        return mImpl->Cd(route.GetPath());
+    }
+    // The current directory is kept by the default meta server client, and
+    // all paths passed to the mounted meta server clients are absolute.
+    const int ret = route->Cd(route.GetPath());
+    if (ret < 0) {
+        return ret;
+    }
+    return mImpl->SetCwd(route.GetPath());
 }
 
 int
@@ -250,109 +539,212 @@ KfsClient::GetCwd()
 int
 KfsClient::Mkdirs(const char *pathname, kfsMode_t mode)
 {
-    return mImpl->Mkdirs(pathname, mode);
+    const PathRoute route(*this, pathname);
+    return route->Mkdirs(route.GetPath(), mode);
 }
 
 int
 KfsClient::Mkdir(const char *pathname, kfsMode_t mode)
 {
-    return mImpl->Mkdir(pathname, mode);
+    const PathRoute route(*this, pathname);
+    return route->Mkdir(route.GetPath(), mode);
 }
 
 int
 KfsClient::Rmdir(const char *pathname)
 {
-    return mImpl->Rmdir(pathname);
+    const PathRoute route(*this, pathname);
+    return route->Rmdir(route.GetPath());
 }
 
 int
 KfsClient::Rmdirs(const char *pathname,
     KfsClient::ErrorHandler* errHandler)
 {
-    return mImpl->Rmdirs(pathname, errHandler);
+    const PathRoute route(*this, pathname);
+    return route->Rmdirs(route.GetPath(), errHandler);
 }
 
 int
 KfsClient::RmdirsFast(const char *pathname,
     KfsClient::ErrorHandler* errHandler)
 {
-    return mImpl->RmdirsFast(pathname, errHandler);
+    const PathRoute route(*this, pathname);
+    return route->RmdirsFast(route.GetPath(), errHandler);
 }
 
 int
 KfsClient::Readdir(const char *pathname, vector<string> &result)
 {
-    return mImpl->Readdir(pathname, result);
+    const PathRoute route(*this, pathname);
+    return route->Readdir(route.GetPath(), result);
 }
 
 int
 KfsClient::ReaddirPlus(const char *pathname, vector<KfsFileAttr> &result,
     bool computeFilesize, bool updateClientCache, bool fileIdAndTypeOnly)
 {
-    return mImpl->ReaddirPlus(pathname, result,
+    const PathRoute route(*this, pathname);
+    return route->ReaddirPlus(route.GetPath(), result,
         computeFilesize, updateClientCache, fileIdAndTypeOnly);
 }
 
+class MountReaddirPlusFunc
+{
+public:
+    MountReaddirPlusFunc(
+        vector<vector<KfsFileAttr> >& result,
+        bool                          computeFilesize,
+        bool                          updateClientCache,
+        bool                          fileIdAndTypeOnly)
+        : mResult(result),
+          mComputeFilesize(computeFilesize),
+          mUpdateClientCache(updateClientCache),
+          mFileIdAndTypeOnly(fileIdAndTypeOnly),
+          mEntries()
+        {}
+    int operator()(client::KfsClientImpl& impl, const vector<string>& paths,
+        const vector<size_t>& index, vector<int>& status)
+    {
+        const int ret = impl.ReaddirPlus(paths, mEntries, status,
+            mComputeFilesize, mUpdateClientCache, mFileIdAndTypeOnly);
+        for (size_t i = 0; i < index.size() && i < mEntries.size(); i++) {
+            mResult[index[i]].swap(mEntries[i]);
+        }
+        return ret;
+    }
+private:
+    vector<vector<KfsFileAttr> >& mResult;
+    const bool                    mComputeFilesize;
+    const bool                    mUpdateClientCache;
+    const bool                    mFileIdAndTypeOnly;
+    vector<vector<KfsFileAttr> >  mEntries;
+};
+
+int
+KfsClient::ReaddirPlus(const vector<string>& pathnames,
+    vector<vector<KfsFileAttr> >& result, vector<int>& status,
+    bool computeFilesize, bool updateClientCache, bool fileIdAndTypeOnly)
+{
+    if (! mMountsPtr) {
+        return mImpl->ReaddirPlus(pathnames, result, status,
+            computeFilesize, updateClientCache, fileIdAndTypeOnly);
+    }
+    result.clear();
+    result.resize(pathnames.size());
+    MountReaddirPlusFunc func(
+        result, computeFilesize, updateClientCache, fileIdAndTypeOnly);
+    return mMountsPtr->Execute(pathnames, status, func);
+}
+
 int
 KfsClient::OpenDirectory(const char *pathname)
 {
-    return mImpl->OpenDirectory(pathname);
+    const PathRoute route(*this, pathname);
+    return route.ToFd(route->OpenDirectory(route.GetPath()));
 }
 
 int
 KfsClient::Stat(const char *pathname, KfsFileAttr& result, bool computeFilesize)
 {
-    return mImpl->Stat(pathname, result, computeFilesize);
+    const PathRoute route(*this, pathname);
+    return route->Stat(route.GetPath(), result, computeFilesize);
 }
 
 int
 KfsClient::Stat(int fd, KfsFileAttr& result)
 {
-    return mImpl->Stat(fd, result);
+    const FdRoute route(*this, fd);
+    return route->Stat(route.GetFd(), result);
+}
+
+class MountStatFunc
+{
+public:
+    MountStatFunc(
+        vector<KfsFileAttr>& result,
+        bool                 computeFilesize)
+        : mResult(result),
+          mComputeFilesize(computeFilesize),
+          mAttrs()
+        {}
+    int operator()(client::KfsClientImpl& impl, const vector<string>& paths,
+        const vector<size_t>& index, vector<int>& status)
+    {
+        const int ret = impl.Stat(paths, mAttrs, status, mComputeFilesize);
+        for (size_t i = 0; i < index.size() && i < mAttrs.size(); i++) {
+            mResult[index[i]] = mAttrs[i];
+        }
+        return ret;
+    }
+private:
+    vector<KfsFileAttr>& mResult;
+    const bool           mComputeFilesize;
+    vector<KfsFileAttr>  mAttrs;
+};
+
+int
+KfsClient::Stat(const vector<string>& pathnames, vector<KfsFileAttr>& result,
+    vector<int>& status, bool computeFilesize)
+{
+    if (! mMountsPtr) {
+        return mImpl->Stat(pathnames, result, status, computeFilesize);
+    }
+    result.clear();
+    result.resize(pathnames.size());
+    MountStatFunc func(result, computeFilesize);
+    return mMountsPtr->Execute(pathnames, status, func);
 }
 
 int
 KfsClient::GetNumChunks(const char *pathname)
 {
-    return mImpl->GetNumChunks(pathname);
+    const PathRoute route(*this, pathname);
+    return route->GetNumChunks(route.GetPath());
 }
 
 int
 KfsClient::UpdateFilesize(int fd)
 {
-    return mImpl->UpdateFilesize(fd);
+    const FdRoute route(*this, fd);
+    return route->UpdateFilesize(route.GetFd());
 }
 
 bool
 KfsClient::Exists(const char *pathname)
 {
-    return mImpl->Exists(pathname);
+    const PathRoute route(*this, pathname);
+    return route->Exists(route.GetPath());
 }
 
 bool
 KfsClient::IsFile(const char *pathname)
 {
-    return mImpl->IsFile(pathname);
+    const PathRoute route(*this, pathname);
+    return route->IsFile(route.GetPath());
 }
 
 bool
 KfsClient::IsDirectory(const char *pathname)
 {
-    return mImpl->IsDirectory(pathname);
+    const PathRoute route(*this, pathname);
+    return route->IsDirectory(route.GetPath());
 }
 
 int
 KfsClient::EnumerateBlocks(
     const char* pathname, KfsClient::BlockInfos& res, bool getChunkSizesFlag)
 {
-    return mImpl->EnumerateBlocks(pathname, res, getChunkSizesFlag);
+    const PathRoute route(*this, pathname);
+    return route->EnumerateBlocks(route.GetPath(), res, getChunkSizesFlag);
 }
 
 int
 KfsClient::GetReplication(const char* pathname,
     KfsFileAttr& attr, int& minChunkReplication, int& maxChunkReplication)
 {
-    return mImpl->GetReplication(pathname, attr,
+    const PathRoute route(*this, pathname);
+    return route->GetReplication(route.GetPath(), attr,
         minChunkReplication, maxChunkReplication);
 }
 
@@ -429,19 +821,22 @@ KfsClient::GetDelegationTokenInfo(
 int
 KfsClient::CompareChunkReplicas(const char *pathname, string &md5sum)
 {
-    return mImpl->CompareChunkReplicas(pathname, md5sum);
+    const PathRoute route(*this, pathname);
+    return route->CompareChunkReplicas(route.GetPath(), md5sum);
 }
 
 int
 KfsClient::VerifyDataChecksums(const char *pathname)
 {
-    return mImpl->VerifyDataChecksums(pathname);
+    const PathRoute route(*this, pathname);
+    return route->VerifyDataChecksums(route.GetPath());
 }
 
 int
 KfsClient::VerifyDataChecksums(int fd)
 {
-    return mImpl->VerifyDataChecksums(fd);
+    const FdRoute route(*this, fd);
+    return route->VerifyDataChecksums(route.GetFd());
 }
 
 /*static*/ int
@@ -533,9 +928,10 @@ KfsClient::Create(const char *pathname, int numReplicas, bool exclusive,
     int numStripes, int numRecoveryStripes, int stripeSize, int stripedType,
     bool forceTypeFlag, kfsMode_t mode, kfsSTier_t minSTier, kfsSTier_t maxSTier)
 {
-    return mImpl->Create(pathname, numReplicas, exclusive,
+    const PathRoute route(*this, pathname);
+    return route.ToFd(route->Create(route.GetPath(), numReplicas, exclusive,
         numStripes, numRecoveryStripes, stripeSize, stripedType, forceTypeFlag,
-        mode, minSTier, maxSTier);
+        mode, minSTier, maxSTier));
 }
 
 
@@ -555,33 +951,224 @@ KfsClient::Create(const char *pathname, bool exclusive, const char *params)
     if (ret) {
         return ret;
     }
-    return mImpl->Create(pathname, numReplicas, exclusive,
+    const PathRoute route(*this, pathname);
+    return route.ToFd(route->Create(route.GetPath(), numReplicas, exclusive,
         numStripes, numRecoveryStripes, stripeSize, stripedType, true,
-        0666, maxSTier, minSTier);
+        0666, maxSTier, minSTier));
 }
 
 int
 KfsClient::Remove(const char *pathname)
 {
-    return mImpl->Remove(pathname);
+    const PathRoute route(*this, pathname);
+    return route->Remove(route.GetPath());
 }
 
 int
 KfsClient::Rename(const char *oldpath, const char *newpath, bool overwrite)
 {
-    return mImpl->Rename(oldpath, newpath, overwrite);
+    const PathRoute route(*this, oldpath);
+    const PathRoute dst(*this, newpath);
+    if (route.GetIndex() != dst.GetIndex()) {
+        return -EXDEV;
+    }
+    return route->Rename(route.GetPath(), dst.GetPath(), overwrite);
+}
+
+class MountRemoveFunc
+{
+public:
+    int operator()(client::KfsClientImpl& impl, const vector<string>& paths,
+        const vector<size_t>& /* index */, vector<int>& status)
+        { return impl.Remove(paths, status); }
+};
+
+int
+KfsClient::Remove(const vector<string>& pathnames, vector<int>& status)
+{
+    if (! mMountsPtr) {
+        return mImpl->Remove(pathnames, status);
+    }
+    MountRemoveFunc func;
+    return mMountsPtr->Execute(pathnames, status, func);
+}
+
+class MountMkdirFunc
+{
+public:
+    MountMkdirFunc(
+        kfsMode_t mode)
+        : mMode(mode)
+        {}
+    int operator()(client::KfsClientImpl& impl, const vector<string>& paths,
+        const vector<size_t>& /* index */, vector<int>& status)
+        { return impl.Mkdir(paths, status, mMode); }
+private:
+    const kfsMode_t mMode;
+};
+
+int
+KfsClient::Mkdir(const vector<string>& pathnames, vector<int>& status,
+    kfsMode_t mode)
+{
+    if (! mMountsPtr) {
+        return mImpl->Mkdir(pathnames, status, mode);
+    }
+    MountMkdirFunc func(mode);
+    return mMountsPtr->Execute(pathnames, status, func);
+}
+
+// Renames the paths within the mount of the source path. The destination
+// paths are routed by the caller, the pairs with the destination in a
+// different mount have non zero pre-set status.
+class MountRenameFunc
+{
+public:
+    MountRenameFunc(
+        const vector<string>& newpaths,
+        const vector<int>&    presetStatus,
+        bool                  overwrite)
+        : mNewPaths(newpaths),
+          mPresetStatus(presetStatus),
+          mOverwrite(overwrite),
+          mSrc(),
+          mDst(),
+          mIdx(),
+          mStatus()
+        {}
+    int operator()(client::KfsClientImpl& impl, const vector<string>& paths,
+        const vector<size_t>& index, vector<int>& status)
+    {
+        mSrc.clear();
+        mDst.clear();
+        mIdx.clear();
+        status.assign(paths.size(), 0);
+        for (size_t i = 0; i < index.size(); i++) {
+            if ((status[i] = mPresetStatus[index[i]]) != 0) {
+                continue;
+            }
+            mSrc.push_back(paths[i]);
+            mDst.push_back(mNewPaths[index[i]]);
+            mIdx.push_back(i);
+        }
+        if (mSrc.empty()) {
+            return 0;
+        }
+        const int ret = impl.Rename(mSrc, mDst, mStatus, mOverwrite);
+        for (size_t i = 0; i < mIdx.size() && i < mStatus.size(); i++) {
+            status[mIdx[i]] = mStatus[i];
+        }
+        return ret;
+    }
+private:
+    const vector<string>& mNewPaths;
+    const vector<int>&    mPresetStatus;
+    const bool            mOverwrite;
+    vector<string>        mSrc;
+    vector<string>        mDst;
+    vector<size_t>        mIdx;
+    vector<int>           mStatus;
+};
+
+int
+KfsClient::Rename(const vector<string>& oldpaths,
+    const vector<string>& newpaths, vector<int>& status, bool overwrite)
+{
+    if (! mMountsPtr) {
+        return mImpl->Rename(oldpaths, newpaths, status, overwrite);
+    }
+    if (oldpaths.size() != newpaths.size()) {
+        return -EINVAL;
+    }
+    vector<string> dstPaths;
+    vector<int>    presetStatus(oldpaths.size(), 0);
+    dstPaths.reserve(newpaths.size());
+    for (size_t i = 0; i < oldpaths.size(); i++) {
+        if (oldpaths[i].empty() || newpaths[i].empty()) {
+            presetStatus[i] = -EINVAL;
+            dstPaths.push_back(newpaths[i]);
+            continue;
+        }
+        const PathRoute src(*this, oldpaths[i].c_str());
+        const PathRoute dst(*this, newpaths[i].c_str());
+        if (src.GetIndex() != dst.GetIndex()) {
+            presetStatus[i] = -EXDEV;
+        }
+        dstPaths.push_back(dst.GetPath());
+    }
+    MountRenameFunc func(dstPaths, presetStatus, overwrite);
+    return mMountsPtr->Execute(oldpaths, status, func);
 }
 
 int
 KfsClient::CoalesceBlocks(const char *srcPath, const char *dstPath, chunkOff_t *dstStartOffset)
 {
-    return mImpl->CoalesceBlocks(srcPath, dstPath, dstStartOffset);
+    const PathRoute route(*this, srcPath);
+    const PathRoute dst(*this, dstPath);
+    if (route.GetIndex() != dst.GetIndex()) {
+        return -EXDEV;
+    }
+    return route->CoalesceBlocks(route.GetPath(), dst.GetPath(),
+        dstStartOffset);
+}
+
+int
+KfsClient::CopyFileChunks(const char* srcPath, const char* dstPath)
+{
+    const PathRoute route(*this, srcPath);
+    const PathRoute dst(*this, dstPath);
+    if (route.GetIndex() != dst.GetIndex()) {
+        return -EXDEV;
+    }
+    return route->CopyFileChunks(route.GetPath(), dst.GetPath());
+}
+
+int
+KfsClient::PackFiles(const char* containerPath,
+    const vector<string>& pathnames, vector<int>& status)
+{
+    const PathRoute route(*this, containerPath);
+    vector<string>  paths;
+    vector<size_t>  idx;
+    status.assign(pathnames.size(), 0);
+    for (size_t i = 0; i < pathnames.size(); i++) {
+        const PathRoute path(*this, pathnames[i].c_str());
+        if (path.GetIndex() != route.GetIndex()) {
+            status[i] = -EXDEV;
+            continue;
+        }
+        paths.push_back(path.GetPath());
+        idx.push_back(i);
+    }
+    vector<int> pstatus;
+    int         ret = route->PackFiles(route.GetPath(), paths, pstatus);
+    for (size_t i = 0; i < idx.size() && i < pstatus.size(); i++) {
+        status[idx[i]] = pstatus[i];
+    }
+    for (size_t i = 0; i < status.size() && 0 <= ret; i++) {
+        ret = status[i];
+    }
+    return ret;
+}
+
+int
+KfsClient::CompactPackedFiles(const char* dirname, const char* containerPath,
+    double minLiveRatio)
+{
+    const PathRoute route(*this, dirname);
+    const PathRoute container(*this, containerPath);
+    if (route.GetIndex() != container.GetIndex()) {
+        return -EXDEV;
+    }
+    return route->CompactPackedFiles(route.GetPath(), container.GetPath(),
+        minLiveRatio);
 }
 
 int
 KfsClient::SetMtime(const char *pathname, const struct timeval &mtime)
 {
-    return mImpl->SetMtime(pathname, mtime);
+    const PathRoute route(*this, pathname);
+    return route->SetMtime(route.GetPath(), mtime);
 }
 
 int
@@ -589,9 +1176,10 @@ KfsClient::Open(const char *pathname, int openFlags, int numReplicas,
     int numStripes, int numRecoveryStripes, int stripeSize, int stripedType,
     kfsMode_t mode, kfsSTier_t minSTier, kfsSTier_t maxSTier)
 {
-    return mImpl->Open(pathname, openFlags, numReplicas,
+    const PathRoute route(*this, pathname);
+    return route.ToFd(route->Open(route.GetPath(), openFlags, numReplicas,
         numStripes, numRecoveryStripes, stripeSize, stripedType, mode,
-        minSTier, maxSTier);
+        minSTier, maxSTier));
 }
 
 int
@@ -611,27 +1199,31 @@ KfsClient::Open(const char *pathname, int openFlags, const char *params,
     if (ret) {
         return ret;
     }
-    return mImpl->Open(pathname, openFlags, numReplicas,
+    const PathRoute route(*this, pathname);
+    return route.ToFd(route->Open(route.GetPath(), openFlags, numReplicas,
         numStripes, numRecoveryStripes, stripeSize, stripedType, mode,
-        minSTier, maxSTier);
+        minSTier, maxSTier));
 }
 
 int
 KfsClient::Close(int fd)
 {
-    return mImpl->Close(fd);
+    const FdRoute route(*this, fd);
+    return route->Close(route.GetFd());
 }
 
 int
 KfsClient::RecordAppend(int fd, const char *buf, int reclen)
 {
-    return mImpl->RecordAppend(fd, buf, reclen);
+    const FdRoute route(*this, fd);
+    return route->RecordAppend(route.GetFd(), buf, reclen);
 }
 
 int
 KfsClient::AtomicRecordAppend(int fd, const char *buf, int reclen)
 {
-    return mImpl->AtomicRecordAppend(fd, buf, reclen);
+    const FdRoute route(*this, fd);
+    return route->AtomicRecordAppend(route.GetFd(), buf, reclen);
 }
 
 void
@@ -647,147 +1239,348 @@ KfsClient::DisableAsyncRW()
 int
 KfsClient::ReadPrefetch(int fd, char *buf, size_t numBytes)
 {
-    return mImpl->ReadPrefetch(fd, buf, numBytes);
+    const FdRoute route(*this, fd);
+    return route->ReadPrefetch(route.GetFd(), buf, numBytes);
 }
 
 ssize_t
 KfsClient::PRead(int fd, chunkOff_t pos, char *buf, size_t numBytes)
 {
     chunkOff_t cpos = pos;
-    return mImpl->Read(fd, buf, numBytes, &cpos);
+    const FdRoute route(*this, fd);
+    return route->Read(route.GetFd(), buf, numBytes, &cpos);
+}
+
+ssize_t
+KfsClient::ReadRanges(int fd, const chunkOff_t* offsets, const size_t* lengths,
+    int count, char* buf, size_t* readLengths)
+{
+    const FdRoute route(*this, fd);
+    return route->ReadRanges(
+        route.GetFd(), offsets, lengths, count, buf, readLengths);
 }
 
 ssize_t
 KfsClient::PWrite(int fd, chunkOff_t pos, const char *buf, size_t numBytes)
 {
     chunkOff_t cpos = pos;
-    return mImpl->Write(fd, buf, numBytes, &cpos);
+    const FdRoute route(*this, fd);
+    return route->Write(route.GetFd(), buf, numBytes, &cpos);
 }
 
 ssize_t
 KfsClient::Read(int fd, char *buf, size_t numBytes)
 {
-    return mImpl->Read(fd, buf, numBytes);
+    const FdRoute route(*this, fd);
+    return route->Read(route.GetFd(), buf, numBytes);
 }
 
 ssize_t
 KfsClient::Write(int fd, const char *buf, size_t numBytes)
 {
-    return mImpl->Write(fd, buf, numBytes);
+    const FdRoute route(*this, fd);
+    return route->Write(route.GetFd(), buf, numBytes);
 }
 
 int
 KfsClient::WriteAsync(int fd, const char *buf, size_t numBytes)
 {
-    return mImpl->WriteAsync(fd, buf, numBytes);
+    const FdRoute route(*this, fd);
+    return route->WriteAsync(route.GetFd(), buf, numBytes);
 }
 
 int
 KfsClient::WriteAsyncCompletionHandler(int fd)
 {
-    return mImpl->WriteAsyncCompletionHandler(fd);
+    const FdRoute route(*this, fd);
+    return route->WriteAsyncCompletionHandler(route.GetFd());
+}
+
+ssize_t
+KfsClient::ReadAsync(int fd, chunkOff_t pos, char *buf, size_t numBytes,
+    KfsClient::IoCompletion& completion)
+{
+    const FdRoute route(*this, fd);
+    if (route.GetIndex() <= 0) {
+        return route->ReadAsync(fd, pos, buf, numBytes, completion);
+    }
+    MountIoCompletion* const comp = new MountIoCompletion(completion, fd);
+    const ssize_t            ret  =
+        route->ReadAsync(route.GetFd(), pos, buf, numBytes, *comp);
+    if (ret <= 0) {
+        delete comp;
+    }
+    return ret;
+}
+
+ssize_t
+KfsClient::WriteAsync(int fd, chunkOff_t pos, const char *buf,
+    size_t numBytes, KfsClient::IoCompletion& completion)
+{
+    const FdRoute route(*this, fd);
+    if (route.GetIndex() <= 0) {
+        return route->WriteAsync(fd, pos, buf, numBytes, completion);
+    }
+    MountIoCompletion* const comp = new MountIoCompletion(completion, fd);
+    const ssize_t            ret  =
+        route->WriteAsync(route.GetFd(), pos, buf, numBytes, *comp);
+    if (ret <= 0) {
+        delete comp;
+    }
+    return ret;
+}
+
+class ReadFilesContext : public KfsClient::IoCompletion
+{
+public:
+    struct Entry
+    {
+        Entry(
+            size_t  index  = 0,
+            int     fd     = -1,
+            char*   buf    = 0,
+            ssize_t status = 0)
+            : index(index),
+              fd(fd),
+              buf(buf),
+              status(status)
+            {}
+        size_t  index;
+        int     fd;
+        char*   buf;
+        ssize_t status;
+    };
+
+    ReadFilesContext()
+        : KfsClient::IoCompletion(),
+          mutex(),
+          cond(),
+          pending(),
+          done()
+        {}
+    ~ReadFilesContext()
+        { assert(pending.empty() && done.empty()); }
+    void Add(const Entry& entry)
+    {
+        QCStMutexLocker locker(mutex);
+        pending[entry.buf] = entry;
+    }
+    void Remove(char* buf)
+    {
+        QCStMutexLocker locker(mutex);
+        pending.erase(buf);
+    }
+    Entry Wait()
+    {
+        QCStMutexLocker locker(mutex);
+        while (done.empty()) {
+            cond.Wait(mutex);
+        }
+        const Entry entry = done.front();
+        done.pop_front();
+        return entry;
+    }
+    virtual void Done(int /* fd */, chunkOff_t /* pos */, char* buf,
+        ssize_t status)
+    {
+        QCStMutexLocker locker(mutex);
+        map<char*, Entry>::iterator const it = pending.find(buf);
+        if (it == pending.end()) {
+            return;
+        }
+        it->second.status = status;
+        done.push_back(it->second);
+        pending.erase(it);
+        cond.Notify();
+    }
+private:
+    QCMutex           mutex;
+    QCCondVar         cond;
+    map<char*, Entry> pending;
+    deque<Entry>      done;
+};
+
+int
+KfsClient::ReadFiles(const vector<string>& pathnames,
+    KfsClient::ReadFilesCompletion& completion, int maxPendingFiles,
+    chunkOff_t maxFileSize)
+{
+    vector<KfsFileAttr> attrs;
+    vector<int>         status;
+    const bool          kComputeFilesizeFlag = true;
+    // Resolve and cache the attributes with the batched lookups, the opens
+    // below use the cached attributes.
+    Stat(pathnames, attrs, status, kComputeFilesizeFlag);
+    ReadFilesContext ctx;
+    const int        maxPending = max(1, maxPendingFiles);
+    int              inFlight   = 0;
+    int              ret        = 0;
+    size_t           next       = 0;
+    while (next < pathnames.size() || 0 < inFlight) {
+        while (next < pathnames.size() && inFlight < maxPending) {
+            const size_t       i    = next++;
+            const KfsFileAttr& attr = attrs[i];
+            ssize_t            res  = i < status.size() ? status[i] : -EIO;
+            if (res == 0 && attr.isDirectory) {
+                res = -EISDIR;
+            }
+            if (res == 0 && maxFileSize < attr.fileSize) {
+                res = -EFBIG;
+            }
+            int fd = -1;
+            if (res == 0 && 0 < attr.fileSize &&
+                    (res = fd = Open(pathnames[i].c_str(), O_RDONLY)) >= 0) {
+                char* const buf = new char[(size_t)attr.fileSize];
+                ctx.Add(ReadFilesContext::Entry(i, fd, buf));
+                if (0 < (res = ReadAsync(
+                        fd, 0, buf, (size_t)attr.fileSize, ctx))) {
+                    inFlight++;
+                    continue;
+                }
+                ctx.Remove(buf);
+                delete [] buf;
+                Close(fd);
+            }
+            if (res < 0 && ret == 0) {
+                ret = (int)res;
+            }
+            completion.Done(i, pathnames[i], 0, res);
+        }
+        if (inFlight <= 0) {
+            break;
+        }
+        const ReadFilesContext::Entry entry = ctx.Wait();
+        inFlight--;
+        Close(entry.fd);
+        if (entry.status < 0 && ret == 0) {
+            ret = (int)entry.status;
+        }
+        completion.Done(entry.index, pathnames[entry.index], entry.buf,
+            entry.status);
+        delete [] entry.buf;
+    }
+    return ret;
 }
 
 void
 KfsClient::SkipHolesInFile(int fd)
 {
-    mImpl->SkipHolesInFile(fd);
+    const FdRoute route(*this, fd);
+    route->SkipHolesInFile(route.GetFd());
 }
 
 int
 KfsClient::Sync(int fd)
 {
-    return mImpl->Sync(fd);
+    const FdRoute route(*this, fd);
+    return route->Sync(route.GetFd());
 }
 
 chunkOff_t
 KfsClient::Seek(int fd, chunkOff_t offset, int whence)
 {
-    return mImpl->Seek(fd, offset, whence);
+    const FdRoute route(*this, fd);
+    return route->Seek(route.GetFd(), offset, whence);
 }
 
 chunkOff_t
 KfsClient::Seek(int fd, chunkOff_t offset)
 {
-    return mImpl->Seek(fd, offset, SEEK_SET);
+    const FdRoute route(*this, fd);
+    return route->Seek(route.GetFd(), offset, SEEK_SET);
 }
 
 chunkOff_t
 KfsClient::Tell(int fd)
 {
-    return mImpl->Tell(fd);
+    const FdRoute route(*this, fd);
+    return route->Tell(route.GetFd());
 }
 
 int
 KfsClient::Truncate(const char* pathname, chunkOff_t offset)
 {
-    return mImpl->Truncate(pathname, offset);
+    const PathRoute route(*this, pathname);
+    return route->Truncate(route.GetPath(), offset);
 }
 
 int
 KfsClient::Truncate(int fd, chunkOff_t offset)
 {
-    return mImpl->Truncate(fd, offset);
+    const FdRoute route(*this, fd);
+    return route->Truncate(route.GetFd(), offset);
 }
 
 int
 KfsClient::PruneFromHead(int fd, chunkOff_t offset)
 {
-    return mImpl->PruneFromHead(fd, offset);
+    const FdRoute route(*this, fd);
+    return route->PruneFromHead(route.GetFd(), offset);
 }
 
 int
 KfsClient::GetDataLocation(const char *pathname, chunkOff_t start, chunkOff_t len,
         vector< vector <string> >& locations)
 {
-    return mImpl->GetDataLocation(pathname, start, len, locations, 0);
+    const PathRoute route(*this, pathname);
+    return route->GetDataLocation(route.GetPath(), start, len, locations, 0);
 }
 
 int
 KfsClient::GetDataLocation(const char *pathname, chunkOff_t start, chunkOff_t len,
         vector< vector <string> >& locations, chunkOff_t* outBlkSize)
 {
-    return mImpl->GetDataLocation(pathname, start, len, locations, outBlkSize);
+    const PathRoute route(*this, pathname);
+    return route->GetDataLocation(route.GetPath(), start, len, locations,
+        outBlkSize);
 }
 
 int
 KfsClient::GetDataLocation(int fd, chunkOff_t start, chunkOff_t len,
     vector< vector <string> >& locations)
 {
-    return mImpl->GetDataLocation(fd, start, len, locations, 0);
+    const FdRoute route(*this, fd);
+    return route->GetDataLocation(route.GetFd(), start, len, locations, 0);
 }
 
 int
 KfsClient::GetDataLocation(int fd, chunkOff_t start, chunkOff_t len,
     vector< vector <string> >& locations, chunkOff_t* outBlkSize)
 {
-    return mImpl->GetDataLocation(fd, start, len, locations, outBlkSize);
+    const FdRoute route(*this, fd);
+    return route->GetDataLocation(route.GetFd(), start, len, locations,
+        outBlkSize);
 }
 
 int
 KfsClient::GetReplicationFactor(const char *pathname)
 {
-    return mImpl->GetReplicationFactor(pathname);
+    const PathRoute route(*this, pathname);
+    return route->GetReplicationFactor(route.GetPath());
 }
 
 int
 KfsClient::SetReplicationFactor(const char *pathname, int16_t numReplicas)
 {
-    return mImpl->SetReplicationFactor(pathname, numReplicas);
+    const PathRoute route(*this, pathname);
+    return route->SetReplicationFactor(route.GetPath(), numReplicas);
 }
 
 int
 KfsClient::SetReplicationFactorR(const char *pathname, int16_t numReplicas,
     ErrorHandler* errHandler)
 {
-    return mImpl->SetReplicationFactorR(pathname, numReplicas, errHandler);
+    const PathRoute route(*this, pathname);
+    return route->SetReplicationFactorR(route.GetPath(), numReplicas,
+        errHandler);
 }
 
 int
 KfsClient::SetStorageTierRange(
     const char *pathname, kfsSTier_t minSTier, kfsSTier_t maxSTier)
 {
-    return mImpl->SetStorageTierRange(pathname, minSTier, maxSTier);
+    const PathRoute route(*this, pathname);
+    return route->SetStorageTierRange(route.GetPath(), minSTier, maxSTier);
 }
 
 ServerLocation
@@ -800,6 +1593,10 @@ void
 KfsClient::SetDefaultIOTimeout(int nsecs)
 {
     mImpl->SetDefaultIOTimeout(nsecs);
+    KfsClientImpl* impl;
+    for (size_t i = 0; (impl = GetMountImpl(i)); i++) {
+        impl->SetDefaultIOTimeout(nsecs);
+    }
 }
 
 int
@@ -813,6 +1610,10 @@ void
 KfsClient::SetDefaultMetaOpTimeout(int nsecs)
 {
     mImpl->SetDefaultMetaOpTimeout(nsecs);
+    KfsClientImpl* impl;
+    for (size_t i = 0; (impl = GetMountImpl(i)); i++) {
+        impl->SetDefaultMetaOpTimeout(nsecs);
+    }
 }
 
 int
@@ -825,6 +1626,10 @@ void
 KfsClient::SetRetryDelay(int nsecs)
 {
     mImpl->SetRetryDelay(nsecs);
+    KfsClientImpl* impl;
+    for (size_t i = 0; (impl = GetMountImpl(i)); i++) {
+        impl->SetRetryDelay(nsecs);
+    }
 }
 
 int
@@ -837,6 +1642,10 @@ void
 KfsClient::SetMaxRetryPerOp(int retryCount)
 {
     mImpl->SetMaxRetryPerOp(retryCount);
+    KfsClientImpl* impl;
+    for (size_t i = 0; (impl = GetMountImpl(i)); i++) {
+        impl->SetMaxRetryPerOp(retryCount);
+    }
 }
 
 int
@@ -848,7 +1657,12 @@ KfsClient::GetMaxRetryPerOp() const
 ssize_t
 KfsClient::SetDefaultIoBufferSize(size_t size)
 {
-    return mImpl->SetDefaultIoBufferSize(size);
+    const ssize_t ret = mImpl->SetDefaultIoBufferSize(size);
+    KfsClientImpl* impl;
+    for (size_t i = 0; (impl = GetMountImpl(i)); i++) {
+        impl->SetDefaultIoBufferSize(size);
+    }
+    return ret;
 }
 
 ssize_t
@@ -860,19 +1674,26 @@ KfsClient::GetDefaultIoBufferSize() const
 ssize_t
 KfsClient::SetIoBufferSize(int fd, size_t size)
 {
-    return mImpl->SetIoBufferSize(fd, size);
+    const FdRoute route(*this, fd);
+    return route->SetIoBufferSize(route.GetFd(), size);
 }
 
 ssize_t
 KfsClient::GetIoBufferSize(int fd) const
 {
-    return mImpl->GetIoBufferSize(fd);
+    const FdRoute route(*this, fd);
+    return route->GetIoBufferSize(route.GetFd());
 }
 
 ssize_t
 KfsClient::SetDefaultReadAheadSize(size_t size)
 {
-    return mImpl->SetDefaultReadAheadSize(size);
+    const ssize_t ret = mImpl->SetDefaultReadAheadSize(size);
+    KfsClientImpl* impl;
+    for (size_t i = 0; (impl = GetMountImpl(i)); i++) {
+        impl->SetDefaultReadAheadSize(size);
+    }
+    return ret;
 }
 
 ssize_t
@@ -881,22 +1702,42 @@ KfsClient::GetDefaultReadAheadSize() const
     return mImpl->GetDefaultReadAheadSize();
 }
 
+int
+KfsClient::SetDefaultCompression(int codec)
+{
+    const int ret = mImpl->SetDefaultCompression(codec);
+    KfsClientImpl* impl;
+    for (size_t i = 0; ret == 0 && (impl = GetMountImpl(i)); i++) {
+        impl->SetDefaultCompression(codec);
+    }
+    return ret;
+}
+
+int
+KfsClient::GetDefaultCompression() const
+{
+    return mImpl->GetDefaultCompression();
+}
+
 ssize_t
 KfsClient::SetReadAheadSize(int fd, size_t size)
 {
-    return mImpl->SetReadAheadSize(fd, size);
+    const FdRoute route(*this, fd);
+    return route->SetReadAheadSize(route.GetFd(), size);
 }
 
 ssize_t
 KfsClient::GetReadAheadSize(int fd) const
 {
-    return mImpl->GetReadAheadSize(fd);
+    const FdRoute route(*this, fd);
+    return route->GetReadAheadSize(route.GetFd());
 }
 
 void
 KfsClient::SetEOFMark(int fd, chunkOff_t offset)
 {
-    mImpl->SetEOFMark(fd, offset);
+    const FdRoute route(*this, fd);
+    route->SetEOFMark(route.GetFd(), offset);
 }
 
 int
@@ -912,69 +1753,89 @@ void
 KfsClient::SetDefaultFullSparseFileSupport(bool flag)
 {
     mImpl->SetDefaultFullSparseFileSupport(flag);
+    KfsClientImpl* impl;
+    for (size_t i = 0; (impl = GetMountImpl(i)); i++) {
+        impl->SetDefaultFullSparseFileSupport(flag);
+    }
 }
 
 int
 KfsClient::SetFullSparseFileSupport(int fd, bool flag)
 {
-    return mImpl->SetFullSparseFileSupport(fd, flag);
+    const FdRoute route(*this, fd);
+    return route->SetFullSparseFileSupport(route.GetFd(), flag);
 }
 
 void
 KfsClient::SetFileAttributeRevalidateTime(int secs)
 {
     mImpl->SetFileAttributeRevalidateTime(secs);
+    KfsClientImpl* impl;
+    for (size_t i = 0; (impl = GetMountImpl(i)); i++) {
+        impl->SetFileAttributeRevalidateTime(secs);
+    }
 }
 
 int
 KfsClient::Chmod(int fd, kfsMode_t mode)
 {
-    return mImpl->Chmod(fd, mode);
+    const FdRoute route(*this, fd);
+    return route->Chmod(route.GetFd(), mode);
 }
 
 int
 KfsClient::Chmod(const char* pathname, kfsMode_t mode)
 {
-    return mImpl->Chmod(pathname, mode);
+    const PathRoute route(*this, pathname);
+    return route->Chmod(route.GetPath(), mode);
 }
 
 int
 KfsClient::Chown(int fd, kfsUid_t user, kfsGid_t group)
 {
-    return mImpl->Chown(fd, user, group);
+    const FdRoute route(*this, fd);
+    return route->Chown(route.GetFd(), user, group);
 }
 
 int
 KfsClient::Chown(int fd, const char* user, const char* group)
 {
-    return mImpl->Chown(fd, user, group);
+    const FdRoute route(*this, fd);
+    return route->Chown(route.GetFd(), user, group);
 }
 
 int
 KfsClient::ChmodR(const char* pathname, kfsMode_t mode,
     KfsClient::ErrorHandler* errHandler)
 {
-    return mImpl->ChmodR(pathname, mode, errHandler);
+    const PathRoute route(*this, pathname);
+    return route->ChmodR(route.GetPath(), mode, errHandler);
 }
 
 int
 KfsClient::ChownR(const char* pathname, kfsUid_t user, kfsGid_t group,
     KfsClient::ErrorHandler* errHandler)
 {
-    return mImpl->ChownR(pathname, user, group, errHandler);
+    const PathRoute route(*this, pathname);
+    return route->ChownR(route.GetPath(), user, group, errHandler);
 }
 
 int
 KfsClient::ChownR(const char* pathname, const char* user, const char* group,
     KfsClient::ErrorHandler* errHandler)
 {
-    return mImpl->ChownR(pathname, user, group, errHandler);
+    const PathRoute route(*this, pathname);
+    return route->ChownR(route.GetPath(), user, group, errHandler);
 }
 
 void
 KfsClient::SetUMask(kfsMode_t mask)
 {
     mImpl->SetUMask(mask);
+    KfsClientImpl* impl;
+    for (size_t i = 0; (impl = GetMountImpl(i)); i++) {
+        impl->SetUMask(mask);
+    }
 }
 
 kfsMode_t
@@ -986,20 +1847,27 @@ KfsClient::GetUMask() const
 int
 KfsClient::Chown(const char* pathname, kfsUid_t user, kfsGid_t group)
 {
-    return mImpl->Chown(pathname, user, group);
+    const PathRoute route(*this, pathname);
+    return route->Chown(route.GetPath(), user, group);
 }
 
 int
 KfsClient::Chown(const char* pathname, const char* user, const char* group)
 {
-    return mImpl->Chown(pathname, user, group);
+    const PathRoute route(*this, pathname);
+    return route->Chown(route.GetPath(), user, group);
 }
 
 int
 KfsClient::SetEUserAndEGroup(kfsUid_t user, kfsGid_t group,
     kfsGid_t* groups, int groupsCnt)
 {
-    return mImpl->SetEUserAndEGroup(user, group, groups, groupsCnt);
+    const int ret = mImpl->SetEUserAndEGroup(user, group, groups, groupsCnt);
+    KfsClientImpl* impl;
+    for (size_t i = 0; (impl = GetMountImpl(i)); i++) {
+        impl->SetEUserAndEGroup(user, group, groups, groupsCnt);
+    }
+    return ret;
 }
 
 int
@@ -1296,6 +2164,18 @@ private:
             }
             KfsOp::AddDefaultRequestHeaders(mEUser, mEGroup);
             AddUserHeader((uid_t)mEUser);
+            // Opt in to reads from hot standby meta server with bounded
+            // staleness.
+            const char* const s = getenv("QFS_CLIENT_META_MAX_STALENESS_SEC");
+            if (s) {
+                char* e = 0;
+                const long v = strtol(s, &e, 10);
+                if (0 <= v && s < e && (*e & 0xFF) <= ' ') {
+                    ostringstream os;
+                    os << "Max-staleness-sec: " << v << "\r\n";
+                    KfsOp::AddExtraRequestHeaders(os.str());
+                }
+            }
             const mode_t mask = umask(0);
             umask(mask);
             mUMask = mask & Permissions::kAccessModeMask;
@@ -1533,6 +2413,11 @@ KfsClientImpl::KfsClientImpl(
       mPathCacheNone(mPathCache.insert(
         make_pair(string(), static_cast<KfsClientImpl::FAttr*>(0))).first),
       mFAttrPool(),
+      mFAttrCacheMaxSize(16 << 10),
+      mNegativeLookupCache(),
+      mNegativeLookupCacheTime(0),
+      mNegativeLookupCacheMaxSize(8 << 10),
+      mAttrCacheStats(),
       mDeleteClearFattr(0),
       mFreeFileTableEntires(),
       mFattrCacheSkipValidateCnt(0),
@@ -1547,10 +2432,23 @@ KfsClientImpl::KfsClientImpl(
       mSlash("/"),
       mDefaultIoBufferSize(min(CHUNKSIZE, size_t(1) << 20)),
       mDefaultReadAheadSize(min(mDefaultIoBufferSize, size_t(1) << 20)),
+      mAdaptiveReadAheadFlag(false),
+      mAdaptiveReadAheadMinSize(0),
+      mAdaptiveReadAheadMaxSize(32 << 20),
+      mAdaptiveReadAheadMaxMemory(int64_t(256) << 20),
+      mAdaptiveReadAheadMemory(0),
+      mWriteBehindMaxMemory(0),
+      mWriteBehindMemory(0),
       mFailShortReadsFlag(true),
+      mDefaultCompression(KFS_COMPRESSION_NONE),
       mFileInstance(0),
       mProtocolWorker(0),
+      mProtocolWorkers(),
       mMaxNumRetriesPerOp(DEFAULT_NUM_RETRIES_PER_OP),
+      mMetaMaxPendingOps(32),
+      mLatencyStatsFlag(false),
+      mMetaOpStartTimes(),
+      mMetaOpLatencies(),
       mRetryDelaySec(RETRY_DELAY_SECS),
       mDefaultOpTimeout(30),
       mDefaultMetaOpTimeout(120),
@@ -1623,7 +2521,11 @@ KfsClientImpl::~KfsClientImpl()
     while ((p = FAttrLru::Front(mFAttrLru))) {
         Delete(p);
     }
-    delete mProtocolWorker;
+    for (size_t i = 0; i < mProtocolWorkers.size(); i++) {
+        delete mProtocolWorkers[i];
+    }
+    mProtocolWorkers.clear();
+    mProtocolWorker = 0;
     KfsClientImpl::CleanupPendingRead();
     vector <FileTableEntry *>::iterator it = mFileTable.begin();
     while (it != mFileTable.end()) {
@@ -1651,7 +2553,9 @@ KfsClientImpl::ShutdownSelf()
     assert(mMutex.IsOwned());
     if (mProtocolWorker) {
         QCStMutexUnlocker unlock(mMutex);
-        mProtocolWorker->Stop();
+        for (size_t i = 0; i < mProtocolWorkers.size(); i++) {
+            mProtocolWorkers[i]->Stop();
+        }
     }
     mAuthCtx.Clear();
     mProtocolWorkerAuthCtx.Clear();
@@ -1748,6 +2652,47 @@ int KfsClientImpl::Init(const string& metaServerHost, int metaServerPort,
         } else if ((int)CHECKSUM_BLOCKSIZE <= defaultIoBufferSize) {
             mDefaultReadAheadSize = mDefaultIoBufferSize;
         }
+        const int defaultCompression = properties->getValue(
+            "client.compression", mDefaultCompression);
+        if (KFS_COMPRESSION_NONE <= defaultCompression &&
+                defaultCompression <= KFS_COMPRESSION_MAX) {
+            mDefaultCompression = defaultCompression;
+        }
+        mAdaptiveReadAheadFlag = properties->getValue(
+            "client.readAhead.adaptive",
+            mAdaptiveReadAheadFlag ? 1 : 0) != 0;
+        mAdaptiveReadAheadMinSize = max(0, properties->getValue(
+            "client.readAhead.adaptiveMinSize",
+            mAdaptiveReadAheadMinSize));
+        mAdaptiveReadAheadMaxSize = max(mAdaptiveReadAheadMinSize,
+            properties->getValue(
+                "client.readAhead.adaptiveMaxSize",
+                mAdaptiveReadAheadMaxSize));
+        mAdaptiveReadAheadMaxMemory = properties->getValue(
+            "client.readAhead.adaptiveMaxMemory",
+            mAdaptiveReadAheadMaxMemory);
+        mWriteBehindMaxMemory = properties->getValue(
+            "client.writeBehind.maxMemory",
+            mWriteBehindMaxMemory);
+        mMetaMaxPendingOps = max(1, properties->getValue(
+            "client.metaMaxPendingOps",
+            mMetaMaxPendingOps));
+        mLatencyStatsFlag = properties->getValue(
+            "client.latencyStats",
+            mLatencyStatsFlag ? 1 : 0) != 0;
+        mFAttrCacheMaxSize = max(size_t(1), properties->getValue(
+            "client.attrCache.maxEntries",
+            mFAttrCacheMaxSize));
+        mNegativeLookupCacheTime = properties->getValue(
+            "client.attrCache.negativeLookupTimeSec",
+            mNegativeLookupCacheTime);
+        mNegativeLookupCacheMaxSize = properties->getValue(
+            "client.attrCache.negativeLookupMaxEntries",
+            mNegativeLookupCacheMaxSize);
+        if (mNegativeLookupCacheTime <= 0 ||
+                mNegativeLookupCacheMaxSize <= 0) {
+            mNegativeLookupCache.clear();
+        }
         mConfig.clear();
         properties->copyWithPrefix("client.", mConfig);
     }
@@ -2090,6 +3035,62 @@ KfsClientImpl::Mkdir(const char *pathname, kfsMode_t mode)
     return 0;
 }
 
+int
+KfsClientImpl::Mkdir(const vector<string>& pathnames, vector<int>& status,
+    kfsMode_t mode)
+{
+    QCStMutexLocker l(mMutex);
+
+    status.assign(pathnames.size(), 0);
+    MetaOpEntries entries(pathnames.size());
+    const bool    kEnforceLastDirFlag      = false;
+    const bool    kInvalidateSubCountsFlag = true;
+    for (size_t i = 0; i < pathnames.size(); i++) {
+        MetaOpEntry& entry = entries[i];
+        if (pathnames[i].empty()) {
+            status[i] = -EINVAL;
+            continue;
+        }
+        if ((status[i] = GetPathComponents(pathnames[i].c_str(),
+                &entry.parentFid, entry.name, &entry.path,
+                kInvalidateSubCountsFlag, kEnforceLastDirFlag)) < 0) {
+            continue;
+        }
+        entry.op = new MkdirOp(0, entry.parentFid, entry.name.c_str(),
+            Permissions(
+                mUseOsUserAndGroupFlag ? mEUser  : kKfsUserNone,
+                mUseOsUserAndGroupFlag ? mEGroup : kKfsGroupNone,
+                mode != kKfsModeUndef  ? (mode & ~mUMask) : mode
+            ),
+            NextCreateId()
+        );
+    }
+    ExecuteMetaPipelined(entries);
+    const time_t now = time(0);
+    int          ret = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        MkdirOp* const op = static_cast<MkdirOp*>(entries[i].op);
+        if (op) {
+            if (op->status < 0) {
+                status[i] = GetOpStatus(*op);
+            } else {
+                if (! op->userName.empty()) {
+                    UpdateUserId(op->userName, op->permissions.user, now);
+                }
+                if (! op->groupName.empty()) {
+                    UpdateGroupId(op->groupName, op->permissions.group, now);
+                }
+            }
+            entries[i].op = 0;
+            delete op;
+        }
+        if (ret == 0) {
+            ret = status[i];
+        }
+    }
+    return ret;
+}
+
 ///
 /// Remove a directory in KFS.
 /// @param[in] pathname         The full pathname such as /.../dir
@@ -2158,6 +3159,20 @@ KfsClientImpl::RmdirsFast(const char *pathname,
         assert(! "internal error: invalid path name");
         return -EFAULT;
     }
+    if (pos != 0 || dirname != "/") {
+        // Try server side recursive remove first. Older meta servers ignore
+        // the recursive flag, and fail with non empty directory. Fall back to
+        // the client side traversal on any error, in order to remove as much
+        // as possible, and report individual entry errors.
+        const bool kRecursiveFlag = true;
+        RmdirOp op(0, parentFid, dirname.c_str(), path.c_str(),
+            kRecursiveFlag);
+        DoMetaOpWithRetry(&op);
+        if (op.status == 0) {
+            InvalidateAllCachedAttrs();
+            return 0;
+        }
+    }
     DefaultErrHandler errorHandler;
     ret = RmdirsSelf(
         path.substr(0, pos),
@@ -2176,6 +3191,10 @@ KfsClientImpl::InvalidateAllCachedAttrs()
 {
     // Invalidate cached attributes.
     mFAttrCacheGeneration++;
+    if (! mNegativeLookupCache.empty()) {
+        mAttrCacheStats.mNegativeInvalidateCount++;
+        mNegativeLookupCache.clear();
+    }
 }
 
 int
@@ -2193,6 +3212,8 @@ KfsClientImpl::RmdirsSelf(const string& path, const string& dirname,
         }
         entries.clear();
     }
+    // Pipeline the directory files removes.
+    MetaOpEntries removes;
     for (vector<KfsFileAttr>::const_iterator it = entries.begin();
             it != entries.end();
             ++it) {
@@ -2208,11 +3229,30 @@ KfsClientImpl::RmdirsSelf(const string& path, const string& dirname,
                 break;
             }
         } else {
-            res = Remove(p, dirFid, it->filename);
-            if (res < 0 && (res = errHandler(p, res)) != 0) {
-                break;
-            }
+            removes.push_back(MetaOpEntry());
+            MetaOpEntry& entry = removes.back();
+            entry.parentFid = dirFid;
+            entry.name      = it->filename;
+            entry.path      = p + "/" + it->filename;
+        }
+    }
+    if (res == 0) {
+        for (MetaOpEntries::iterator it = removes.begin();
+                it != removes.end();
+                ++it) {
+            it->op = new RemoveOp(
+                0, it->parentFid, it->name.c_str(), it->path.c_str());
+        }
+        ExecuteMetaPipelined(removes);
+    }
+    for (MetaOpEntries::iterator it = removes.begin();
+            it != removes.end();
+            ++it) {
+        if (res == 0 && it->op->status < 0) {
+            res = errHandler(p, GetOpStatus(*it->op));
         }
+        delete it->op;
+        it->op = 0;
     }
     if (res != 0) {
         return res;
@@ -2791,6 +3831,9 @@ private:
             .Def("CR-Time",              &Entry::crtime                        )
             .Def("Replication",          &Entry::numReplicas,        int16_t(1))
             .Def("Chunk-count",          &Entry::subCount1                     )
+            .Def("Packed-container",     &Entry::packedContainer, kfsFileId_t(-1))
+            .Def("Packed-offset",        &Entry::packedOffset,    chunkOff_t(-1))
+            .Def("Compression",          &Entry::compression, int16_t(KFS_COMPRESSION_NONE))
             .Def("File-size",            &Entry::fileSize,       chunkOff_t(-1))
             .Def("Striper-type",         &Entry::striperType, KFS_STRIPED_FILE_TYPE_UNKNOWN)
             .Def("Num-stripes",          &Entry::numStripes                    )
@@ -2826,6 +3869,9 @@ private:
             .Def("CR", &Entry::crtime                          )
             .Def("R",  &Entry::numReplicas,          int16_t(1))
             .Def("CC", &Entry::subCount1                       )
+            .Def("PC", &Entry::packedContainer, kfsFileId_t(-1))
+            .Def("PO", &Entry::packedOffset,     chunkOff_t(-1))
+            .Def("CM", &Entry::compression, int16_t(KFS_COMPRESSION_NONE))
             .Def("S",  &Entry::fileSize,         chunkOff_t(-1))
             .Def("ST", &Entry::striperType, KFS_STRIPED_FILE_TYPE_UNKNOWN)
             .Def("SC", &Entry::numStripes                      )
@@ -2960,6 +4006,12 @@ public:
     }
     void clear()
         { result.clear(); }
+    void reset()
+    {
+        result.clear();
+        fileChunkInfo.clear();
+        hasDirs = false;
+    }
 
     vector<ChunkAttr>                fileChunkInfo;
     const PropertiesTokenizer::Token beginEntry;
@@ -2979,10 +4031,76 @@ private:
         const ReadDirPlusResponseParser&);
 };
 
+static inline void
+PrepareReaddirPlus(ReaddirPlusOp& op)
+{
+    op.seq                = 0;
+    op.status             = 0;
+    op.numEntries         = kMaxReaddirEntries;
+    op.contentLength      = 0;
+    op.hasMoreEntriesFlag = false;
+    op.statusMsg.clear();
+}
+
+///
+/// List the directories with the first page requests pipelined, then fetch
+/// the remaining pages, if any, one directory at a time.
+///
+int
+KfsClientImpl::ReaddirPlus(const vector<string>& pathnames,
+    vector<vector<KfsFileAttr> >& result, vector<int>& status,
+    bool computeFilesize, bool updateClientCache, bool fileIdAndTypeOnly)
+{
+    QCStMutexLocker l(mMutex);
+
+    result.clear();
+    result.resize(pathnames.size());
+    status.assign(pathnames.size(), 0);
+    MetaOpEntries entries(pathnames.size());
+    const bool    kGetLastChunkInfoIfSizeUnknown = true;
+    const bool    kOmitLastChunkInfo             = ! computeFilesize;
+    for (size_t i = 0; i < pathnames.size(); i++) {
+        MetaOpEntry& entry = entries[i];
+        KfsFileAttr  attr;
+        if (pathnames[i].empty()) {
+            status[i] = -EINVAL;
+            continue;
+        }
+        if ((status[i] = StatSelf(
+                pathnames[i].c_str(), attr, false, &entry.path)) < 0) {
+            continue;
+        }
+        if (! attr.isDirectory) {
+            status[i] = -ENOTDIR;
+            continue;
+        }
+        ReaddirPlusOp* const op = new ReaddirPlusOp(
+            0, attr.fileId, kGetLastChunkInfoIfSizeUnknown, kOmitLastChunkInfo,
+            fileIdAndTypeOnly);
+        PrepareReaddirPlus(*op);
+        entry.op = op;
+    }
+    ExecuteMetaPipelined(entries);
+    int ret = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        ReaddirPlusOp* const op = static_cast<ReaddirPlusOp*>(entries[i].op);
+        if (op) {
+            status[i] = ReaddirPlus(entries[i].path, op->fid, result[i],
+                computeFilesize, updateClientCache, fileIdAndTypeOnly, op);
+            entries[i].op = 0;
+            delete op;
+        }
+        if (ret == 0 && status[i] < 0) {
+            ret = status[i];
+        }
+    }
+    return ret;
+}
+
 int
 KfsClientImpl::ReaddirPlus(const string& pathname, kfsFileId_t dirFid,
     vector<KfsFileAttr>& result, bool computeFilesize, bool updateClientCache,
-    bool fileIdAndTypeOnly)
+    bool fileIdAndTypeOnly, ReaddirPlusOp* firstPageOp)
 {
     assert(mMutex.IsOwned());
     if (pathname.empty() || pathname[0] != '/') {
@@ -3004,20 +4122,24 @@ KfsClientImpl::ReaddirPlus(const string& pathname, kfsFileId_t dirFid,
     ReaddirPlusOp                     op(
         0, dirFid, kGetLastChunkInfoIfSizeUnknown, kOmitLastChunkInfo,
         fileIdAndTypeOnly);
-    ReaddirResult                     opResult;
-    ReaddirResult*                    last  = &opResult;
-    int                               count = 0;
+    ReaddirPlusOp                     nextOp(
+        0, dirFid, kGetLastChunkInfoIfSizeUnknown, kOmitLastChunkInfo,
+        fileIdAndTypeOnly);
+    ReaddirPlusOp*                    cur       =
+        firstPageOp ? firstPageOp : &op;
+    ReaddirPlusOp*                    next      = &nextOp;
+    ReaddirResult                     page;
+    bool                              pagedFlag = false;
+    if (! firstPageOp) {
+        // Otherwise the first page request is already executed by the
+        // caller.
+        PrepareReaddirPlus(*cur);
+        DoMetaOpWithRetry(cur);
+    }
     for (int retryCnt = kMaxReadDirRetries; ;) {
-        op.seq                = 0;
-        op.numEntries         = kMaxReaddirEntries;
-        op.contentLength      = 0;
-        op.hasMoreEntriesFlag = false;
-
-        DoMetaOpWithRetry(&op);
-
-        if (op.status < 0) {
-            if (op.fnameStart.empty() ||
-                    (op.status != -ENOENT && op.status != -EAGAIN)) {
+        if (cur->status < 0) {
+            if (cur->fnameStart.empty() ||
+                    (cur->status != -ENOENT && cur->status != -EAGAIN)) {
                 break;
             }
             if (--retryCnt <= 0) {
@@ -3027,26 +4149,28 @@ KfsClientImpl::ReaddirPlus(const string& pathname, kfsFileId_t dirFid,
                     kMaxReadDirRetries <<
                     " times while attempting to list it; giving up" <<
                 KFS_LOG_EOM;
-                op.status = -EAGAIN;
+                cur->status = -EAGAIN;
                 break;
             }
-            last = opResult.Clear();
-            op.fnameStart.clear();
+            parser.reset();
+            cur->fnameStart.clear();
+            PrepareReaddirPlus(*cur);
+            DoMetaOpWithRetry(cur);
             continue;
         }
-        if (op.numEntries <= 0) {
+        if (cur->numEntries <= 0) {
             break;
         }
-        if (op.contentLength <= 0) {
-            op.status = -EIO;
+        if (cur->contentLength <= 0) {
+            cur->status = -EIO;
             break;
         }
         // The response format:
         // Begin-entry <values> Begin-entry <values>
         // The last entry doesn't have a end-marker.
-        if (! beginEntryToken && op.hasMoreEntriesFlag) {
+        if (! beginEntryToken && cur->hasMoreEntriesFlag) {
             PropertiesTokenizer tokenizer(
-                op.contentBuf, op.contentLength, false);
+                cur->contentBuf, cur->contentLength, false);
             tokenizer.Next();
             if (tokenizer.GetKey() == parser.shortBeginEntry) {
                 nameEntryToken  = &nameTokenShort;
@@ -3056,30 +4180,45 @@ KfsClientImpl::ReaddirPlus(const string& pathname, kfsFileId_t dirFid,
                 beginEntryToken = &parser.beginEntry;
             }
         }
-        last = last->Set(op);
-        count += op.numEntries;
-        if (! op.hasMoreEntriesFlag) {
+        const bool moreFlag = cur->hasMoreEntriesFlag;
+        page.Set(*cur);
+        bool pendingFlag = false;
+        if (moreFlag) {
+            pagedFlag = true;
+            if (! page.GetLast(
+                    *beginEntryToken, *nameEntryToken, next->fnameStart)) {
+                cur->status = -EIO;
+                break;
+            }
+            // Fetch the next page while parsing the current one.
+            PrepareReaddirPlus(*next);
+            pendingFlag = StartMeta(*next);
+        }
+        KFS_LOG_STREAM_DEBUG <<
+            "readdirplus parse: entries: " << cur->numEntries <<
+            " more: " << moreFlag <<
+        KFS_LOG_EOM;
+        const int status = page.Parse(parser);
+        page.Clear();
+        if (pendingFlag) {
+            WaitMeta(*next);
+        }
+        if (status != 0) {
+            cur->status = status;
             break;
         }
-        if (! last->GetLast(*beginEntryToken, *nameEntryToken, op.fnameStart)) {
-            op.status = -EIO;
+        if (! moreFlag) {
             break;
         }
+        swap(cur, next);
     }
-    if (op.status == 0) {
-        result.reserve(count);
-        KFS_LOG_STREAM_DEBUG <<
-            "readdirplus parse: entries: " << count <<
-        KFS_LOG_EOM;
-        op.status = opResult.Parse(parser);
-        KFS_LOG_STREAM_DEBUG <<
-            "readdirplus parse done: entries: " << result.size() <<
-        KFS_LOG_EOM;
-    }
-    if (op.status != 0) {
+    if (cur->status != 0) {
         result.clear();
-        return GetOpStatus(op);
+        return GetOpStatus(*cur);
     }
+    KFS_LOG_STREAM_DEBUG <<
+        "readdirplus parse done: entries: " << result.size() <<
+    KFS_LOG_EOM;
     ComputeFilesizes(result, parser.fileChunkInfo);
 
     // if there are too many entries in the dir, then the caller is
@@ -3115,7 +4254,7 @@ KfsClientImpl::ReaddirPlus(const string& pathname, kfsFileId_t dirFid,
         }
     }
     sort(result.begin(), result.end());
-    if (! op.fnameStart.empty()) {
+    if (pagedFlag) {
         // The meta server doesn't guarantee that listing restarts from the
         // exact same position if there were entry names hash collisions,
         // and the the name where collision occurred was used as cursor (the
@@ -3138,8 +4277,109 @@ KfsClientImpl::Stat(const char *pathname, KfsFileAttr& kfsattr, bool computeFile
 {
     QCStMutexLocker l(mMutex);
     const bool kValidSubCountsRequiredFlag = true;
-    return StatSelf(pathname, kfsattr, computeFilesize, 0, 0,
+    const int res = StatSelf(pathname, kfsattr, computeFilesize, 0, 0,
         kValidSubCountsRequiredFlag);
+    if (res != 0 || kfsattr.isDirectory ||
+            kfsattr.compression == KFS_COMPRESSION_NONE) {
+        return res;
+    }
+    kfsattr.physicalSize = kfsattr.fileSize;
+    if (kfsattr.fileSize <= 0) {
+        return res;
+    }
+    l.Unlock();
+    return StatCompressed(pathname, kfsattr);
+}
+
+///
+/// The logical size of compressed file is recorded in its last chunk header,
+/// open the file in order to read the header.
+///
+int
+KfsClientImpl::StatCompressed(const char* pathname, KfsFileAttr& kfsattr)
+{
+    const int fd = Open(pathname, O_RDONLY, 0, 0, 0, 0,
+        KFS_STRIPED_FILE_TYPE_NONE, kKfsModeUndef, kKfsSTierMax, kKfsSTierMax);
+    if (fd < 0) {
+        return fd;
+    }
+    KfsFileAttr attr;
+    int res = Stat(fd, attr);
+    if (res == 0) {
+        kfsattr.fileSize     = attr.fileSize;
+        kfsattr.physicalSize = attr.physicalSize;
+    }
+    Close(fd);
+    return res;
+}
+
+int
+KfsClientImpl::LoadCompressedFile(int fd, QCStMutexLocker& lock)
+{
+    assert(mMutex.IsOwned());
+    FileTableEntry& entry = *mFileTable[fd];
+    CompressedFile& file  = *entry.compressedFile;
+    lock.Unlock();
+    const int res = file.Load();
+    if (res < 0) {
+        KFS_LOG_STREAM_ERROR <<
+            entry.pathname << ": compressed file load failure: " << res <<
+        KFS_LOG_EOM;
+        Close(fd);
+        return res;
+    }
+    return fd;
+}
+
+ssize_t
+KfsClientImpl::CompressedReadWrite(int fd, FileTableEntry& entry, char* buf,
+    size_t numBytes, chunkOff_t* pos, bool writeFlag, QCStMutexLocker& lock)
+{
+    assert(mMutex.IsOwned());
+    CompressedFile&    file     = *entry.compressedFile;
+    const unsigned int instance = entry.instance;
+    const chunkOff_t   offset   = pos ? *pos : entry.currPos.fileOffset;
+    if (offset < 0) {
+        return -EINVAL;
+    }
+    lock.Unlock();
+    const ssize_t ret = writeFlag ?
+        file.Write(buf, numBytes, offset) :
+        file.Read(buf, numBytes, offset);
+    if (ret <= 0) {
+        return ret;
+    }
+    if (pos) {
+        *pos = offset + ret;
+        return ret;
+    }
+    lock.Lock();
+    // File can be closed by other thread, fd entry can be re-used.
+    if (valid_fd(fd) && mFileTable[fd] == &entry &&
+            entry.instance == instance &&
+            entry.currPos.fileOffset == offset) {
+        entry.currPos.fileOffset = offset + ret;
+    }
+    return ret;
+}
+
+ssize_t
+KfsClientImpl::ReadPhysical(int fd, char* buf, size_t numBytes,
+    chunkOff_t pos)
+{
+    const bool kPhysicalFlag = true;
+    return Read(fd, buf, numBytes, &pos, kPhysicalFlag);
+}
+
+ssize_t
+KfsClientImpl::WritePhysical(int fd, const char* buf, size_t numBytes,
+    chunkOff_t pos)
+{
+    const bool kAsyncFlag      = false;
+    const bool kAppendOnlyFlag = false;
+    const bool kPhysicalFlag   = true;
+    return Write(fd, buf, numBytes, kAsyncFlag, kAppendOnlyFlag, &pos,
+        kPhysicalFlag);
 }
 
 int
@@ -3153,6 +4393,10 @@ KfsClientImpl::Stat(int fd, KfsFileAttr& kfsattr)
     FileTableEntry& entry = *(mFileTable[fd]);
     kfsattr          = entry.fattr;
     kfsattr.filename = entry.name;
+    if (entry.compressedFile) {
+        kfsattr.fileSize     = entry.compressedFile->GetSize();
+        kfsattr.physicalSize = entry.compressedFile->GetPhysicalSize();
+    }
     return 0;
 }
 
@@ -3200,6 +4444,8 @@ KfsClientImpl::StatSelf(const char* pathname, KfsFileAttr& kfsattr,
         if (res < 0) {
             return res;
         }
+    } else {
+        mAttrCacheStats.mHitCount++;
     }
     if (fa) {
         kfsattr          = *fa;
@@ -3268,14 +4514,22 @@ KfsClientImpl::LookupAttr(kfsFileId_t parentFid, const string& filename,
         if (fa && (! validSubCountsRequiredFlag || ! fa->staleSubCountsFlag) &&
                 (! computeFilesize || fa->isDirectory || fa->fileSize >= 0) &&
                 IsValid(*fa, time(0))) {
+            mAttrCacheStats.mHitCount++;
             return 0;
         }
+        if (! fa && IsNegativeLookupCached(parentFid, filename, time(0))) {
+            return -ENOENT;
+        }
     }
+    mAttrCacheStats.mMissCount++;
     LookupOp op(0, parentFid, filename.c_str());
     DoMetaOpWithRetry(&op);
     if (op.status < 0) {
         Delete(fa);
         fa = 0;
+        if (op.status == -ENOENT) {
+            NegativeLookupCacheInsert(parentFid, filename, time(0));
+        }
         return GetOpStatus(op);
     }
     const time_t now = time(0);
@@ -3293,6 +4547,141 @@ KfsClientImpl::LookupAttr(kfsFileId_t parentFid, const string& filename,
     return UpdateFattr(parentFid, filename, fa, path, op.fattr, now);
 }
 
+int
+KfsClientImpl::Stat(const vector<string>& pathnames,
+    vector<KfsFileAttr>& result, vector<int>& status, bool computeFilesize)
+{
+    QCStMutexLocker l(mMutex);
+
+    result.clear();
+    result.resize(pathnames.size());
+    status.assign(pathnames.size(), 0);
+    const bool     kValidSubCountsRequiredFlag = true;
+    LookupBatchOp  op(0);
+    vector<size_t> index;
+    vector<string> paths;
+    size_t         reqSize = 0;
+    int            ret     = 0;
+    for (size_t i = 0; i < pathnames.size(); i++) {
+        const string& pathname = pathnames[i];
+        KfsFileAttr&  attr     = result[i];
+        int&          res      = status[i];
+        if (pathname.empty()) {
+            res = -EINVAL;
+            continue;
+        }
+        if (pathname[0] == '/') {
+            mTmpAbsPathStr = pathname;
+        } else {
+            mTmpAbsPathStr.assign(mCwd.data(), mCwd.length());
+            mTmpAbsPathStr.append("/", 1);
+            mTmpAbsPathStr.append(pathname);
+        }
+        FAttr* fa = LookupFAttr(mTmpAbsPathStr, 0);
+        if (fa && (! computeFilesize || fa->isDirectory ||
+                    0 <= fa->fileSize) &&
+                ! fa->staleSubCountsFlag && IsValid(*fa, time(0))) {
+            mAttrCacheStats.mHitCount++;
+            attr          = *fa;
+            attr.filename = fa->fidNameIt->first.second;
+            continue;
+        }
+        kfsFileId_t parentFid;
+        string      filename;
+        string      fpath;
+        mDeleteClearFattr = &fa;
+        res = GetPathComponents(
+            mTmpAbsPathStr.c_str(), &parentFid, filename, &fpath);
+        Validate(fa);
+        mDeleteClearFattr = 0;
+        if (res < 0) {
+            continue;
+        }
+        if (! fa && IsNegativeLookupCached(parentFid, filename, time(0))) {
+            res = -ENOENT;
+            continue;
+        }
+        mAttrCacheStats.mMissCount++;
+        const size_t size = LookupBatchOp::GetEntrySize(filename);
+        if (! LookupBatchOp::IsValidName(filename) ||
+                kMaxLookupBatchRequestSize < size) {
+            res = StatSelf(pathname.c_str(), attr, computeFilesize, 0, 0,
+                kValidSubCountsRequiredFlag);
+            continue;
+        }
+        if (kMaxLookupBatchRequestSize < reqSize + size) {
+            LookupBatch(op, index, paths, result, status, computeFilesize);
+            reqSize = 0;
+        }
+        op.entries.push_back(LookupBatchOp::Entry(parentFid, filename));
+        index.push_back(i);
+        paths.push_back(fpath);
+        reqSize += size;
+    }
+    LookupBatch(op, index, paths, result, status, computeFilesize);
+    for (size_t i = 0; i < status.size() && 0 <= ret; i++) {
+        ret = status[i];
+    }
+    return (0 < ret ? -ret : ret);
+}
+
+int
+KfsClientImpl::LookupBatch(LookupBatchOp& op, vector<size_t>& index,
+    vector<string>& paths, vector<KfsFileAttr>& result,
+    vector<int>& status, bool computeFilesize)
+{
+    assert(mMutex.IsOwned());
+
+    if (op.entries.empty()) {
+        return 0;
+    }
+    DoMetaOpWithRetry(&op);
+    int res = op.ParseEntries();
+    if (res < 0) {
+        op.status = res;
+        res = GetOpStatus(op);
+    }
+    const time_t now = time(0);
+    for (size_t k = 0; k < op.entries.size(); k++) {
+        LookupBatchOp::Entry& entry = op.entries[k];
+        const size_t          i     = index[k];
+        if (res < 0 || entry.status < 0) {
+            status[i] = res < 0 ? res : entry.status;
+            Delete(LookupFAttr(entry.parentFid, entry.name));
+            if (0 <= res && entry.status == -ENOENT) {
+                NegativeLookupCacheInsert(entry.parentFid, entry.name, now);
+            }
+            continue;
+        }
+        UpdateUserAndGroup(entry.userName, entry.groupName, entry.fattr, now);
+        if (! entry.fattr.isDirectory && computeFilesize &&
+                entry.fattr.fileSize < 0) {
+            entry.fattr.fileSize = ComputeFilesize(entry.fattr.fileId);
+            if (entry.fattr.fileSize < 0) {
+                status[i] = -EIO;
+                continue;
+            }
+        }
+        FAttr* fa = LookupFAttr(entry.parentFid, entry.name);
+        if ((status[i] = UpdateFattr(entry.parentFid, entry.name, fa,
+                paths[k], entry.fattr, now)) < 0) {
+            continue;
+        }
+        KfsFileAttr& attr = result[i];
+        attr          = *fa;
+        attr.filename = fa->fidNameIt->first.second;
+    }
+    op.entries.clear();
+    op.seq           = 0;
+    op.status        = 0;
+    op.numEntries    = 0;
+    op.contentLength = 0;
+    op.statusMsg.clear();
+    index.clear();
+    paths.clear();
+    return res;
+}
+
 int
 KfsClientImpl::Create(const char *pathname, int numReplicas, bool exclusive,
     int numStripes, int numRecoveryStripes, int stripeSize, int stripedType,
@@ -3355,6 +4744,8 @@ KfsClientImpl::CreateSelf(const char *pathname, int numReplicas, bool exclusive,
         op.numStripes         = numStripes;
         op.numRecoveryStripes = numRecoveryStripes;
         op.stripeSize         = stripeSize;
+    } else if (0 < numReplicas) {
+        op.compression = mDefaultCompression;
     }
     DoMetaOpWithRetry(&op);
     if (op.status < 0) {
@@ -3398,6 +4789,12 @@ KfsClientImpl::CreateSelf(const char *pathname, int numReplicas, bool exclusive,
     fa.fileSize    = 0; // presently CreateOp always deletes file if exists.
     fa.minSTier    = op.minSTier;
     fa.maxSTier    = op.maxSTier;
+    fa.compression = (int16_t)op.metaCompression;
+    if (fa.compression != KFS_COMPRESSION_NONE) {
+        const bool kWriteFlag = true;
+        entry.compressedFile = new CompressedFile(
+            *this, fte, fa.compression, 0, kWriteFlag);
+    }
     if (op.metaStriperType != KFS_STRIPED_FILE_TYPE_NONE) {
         fa.numStripes         = (int16_t)numStripes;
         fa.numRecoveryStripes = (int16_t)numRecoveryStripes;
@@ -3419,6 +4816,7 @@ KfsClientImpl::CreateSelf(const char *pathname, int numReplicas, bool exclusive,
     // Set optimal io size, like open does.
     SetOptimalReadAheadSize(entry, mDefaultReadAheadSize);
     SetOptimalIoBufferSize(entry, mDefaultIoBufferSize);
+    InitAdaptiveReadAhead(entry);
     KFS_LOG_STREAM_DEBUG <<
         "created:"
         " fd: "       << fte <<
@@ -3457,6 +4855,45 @@ KfsClientImpl::Remove(const char* pathname)
     return GetOpStatus(op);
 }
 
+int
+KfsClientImpl::Remove(const vector<string>& pathnames, vector<int>& status)
+{
+    QCStMutexLocker l(mMutex);
+
+    status.assign(pathnames.size(), 0);
+    MetaOpEntries entries(pathnames.size());
+    const bool    kInvalidateSubCountsFlag = true;
+    for (size_t i = 0; i < pathnames.size(); i++) {
+        MetaOpEntry& entry = entries[i];
+        if (pathnames[i].empty()) {
+            status[i] = -EINVAL;
+            continue;
+        }
+        if ((status[i] = GetPathComponents(pathnames[i].c_str(),
+                &entry.parentFid, entry.name, &entry.path,
+                kInvalidateSubCountsFlag)) < 0) {
+            continue;
+        }
+        entry.op = new RemoveOp(0, entry.parentFid, entry.name.c_str(),
+            entry.path.c_str());
+    }
+    ExecuteMetaPipelined(entries);
+    int ret = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        MetaOpEntry& entry = entries[i];
+        if (entry.op) {
+            Delete(LookupFAttr(entry.parentFid, entry.name));
+            status[i] = GetOpStatus(*entry.op);
+            delete entry.op;
+            entry.op = 0;
+        }
+        if (ret == 0) {
+            ret = status[i];
+        }
+    }
+    return ret;
+}
+
 bool
 KfsClientImpl::InvalidateCachedAttrsWithPathPrefix(
     const string&               path,
@@ -3571,6 +5008,66 @@ KfsClientImpl::Rename(const char* src, const char* dst, bool overwrite)
     return GetOpStatus(op);
 }
 
+int
+KfsClientImpl::Rename(const vector<string>& oldpaths,
+    const vector<string>& newpaths, vector<int>& status, bool overwrite)
+{
+    if (oldpaths.size() != newpaths.size()) {
+        return -EINVAL;
+    }
+
+    QCStMutexLocker l(mMutex);
+
+    status.assign(oldpaths.size(), 0);
+    MetaOpEntries entries(oldpaths.size());
+    const bool    kInvalidateSubCountsFlag = true;
+    bool          startedFlag              = false;
+    for (size_t i = 0; i < oldpaths.size(); i++) {
+        MetaOpEntry& entry = entries[i];
+        if (oldpaths[i].empty() || newpaths[i].empty()) {
+            status[i] = -EINVAL;
+            continue;
+        }
+        if ((status[i] = GetPathComponents(oldpaths[i].c_str(),
+                &entry.parentFid, entry.name, &entry.path,
+                kInvalidateSubCountsFlag)) < 0) {
+            continue;
+        }
+        kfsFileId_t dstParentFid = -1;
+        string      dstFileName;
+        if ((status[i] = GetPathComponents(newpaths[i].c_str(),
+                &dstParentFid, dstFileName, &entry.dstPath,
+                kInvalidateSubCountsFlag)) < 0) {
+            continue;
+        }
+        if (entry.parentFid == dstParentFid && dstFileName == entry.name) {
+            continue; // src and dst are the same.
+        }
+        entry.op = new RenameOp(0, entry.parentFid, entry.name.c_str(),
+            entry.dstPath.c_str(), entry.path.c_str(), overwrite);
+        startedFlag = true;
+    }
+    ExecuteMetaPipelined(entries);
+    if (startedFlag) {
+        // Renames might move directories, invalidate all cached attributes,
+        // instead of invalidating each path prefix.
+        InvalidateAllCachedAttrs();
+    }
+    int ret = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        MetaOpEntry& entry = entries[i];
+        if (entry.op) {
+            status[i] = GetOpStatus(*entry.op);
+            delete entry.op;
+            entry.op = 0;
+        }
+        if (ret == 0) {
+            ret = status[i];
+        }
+    }
+    return ret;
+}
+
 int
 KfsClientImpl::UpdateFattr(
     kfsFileId_t            parentFid,
@@ -3701,6 +5198,272 @@ KfsClientImpl::CoalesceBlocks(const char* src, const char* dst, chunkOff_t *dstS
     return GetOpStatus(op);
 }
 
+int
+KfsClientImpl::CopyFileChunks(const char* src, const char* dst)
+{
+    if (! src || ! dst || ! *src || ! *dst) {
+        return -EINVAL;
+    }
+    KfsFileAttr srcAttr;
+    int         res = Stat(src, srcAttr);
+    if (res < 0) {
+        return res;
+    }
+    KfsFileAttr dstAttr;
+    if ((res = Stat(dst, dstAttr, false)) < 0) {
+        return res;
+    }
+    if (srcAttr.isDirectory || dstAttr.isDirectory) {
+        return -EISDIR;
+    }
+    if (srcAttr.IsPacked() || srcAttr.numReplicas <= 0 ||
+            srcAttr.striperType != KFS_STRIPED_FILE_TYPE_NONE ||
+            srcAttr.compression != KFS_COMPRESSION_NONE ||
+            dstAttr.IsPacked() || dstAttr.numReplicas <= 0 ||
+            dstAttr.striperType != KFS_STRIPED_FILE_TYPE_NONE ||
+            dstAttr.compression != KFS_COMPRESSION_NONE ||
+            srcAttr.fileId == dstAttr.fileId ||
+            dstAttr.fileSize != 0 || srcAttr.fileSize < 0) {
+        return -EINVAL;
+    }
+    {
+        QCStMutexLocker l(mMutex);
+
+        for (chunkOff_t pos = 0; pos < srcAttr.fileSize;
+                pos += (chunkOff_t)CHUNKSIZE) {
+            CopyChunkOp op(0, srcAttr.fileId, pos, dstAttr.fileId, pos);
+            DoMetaOpWithRetry(&op);
+            if (op.status < 0) {
+                KFS_LOG_STREAM_ERROR << "copy chunks: " <<
+                    src << " " << dst << " " << op.Show() <<
+                    " status: " << op.status << " " << op.statusMsg <<
+                KFS_LOG_EOM;
+                res = GetOpStatus(op);
+                break;
+            }
+        }
+        string      dstPath;
+        const int   ret = StatSelf(dst, dstAttr, false, &dstPath);
+        if (ret == 0) {
+            InvalidateAttributeAndCounts(dstPath);
+        }
+    }
+    if (res < 0) {
+        return res;
+    }
+    // The source might have a trailing hole.
+    if ((res = Stat(dst, dstAttr)) < 0) {
+        return res;
+    }
+    if (dstAttr.fileSize < srcAttr.fileSize) {
+        res = Truncate(dst, srcAttr.fileSize);
+    }
+    return res;
+}
+
+int
+KfsClientImpl::PackFiles(const char* containerPath,
+    const vector<string>& pathnames, vector<int>& status)
+{
+    status.assign(pathnames.size(), 0);
+    if (! containerPath || ! *containerPath) {
+        return -EINVAL;
+    }
+    vector<KfsFileAttr> attrs(pathnames.size());
+    for (size_t i = 0; i < pathnames.size(); i++) {
+        KfsFileAttr& attr = attrs[i];
+        int          res  = Stat(pathnames[i].c_str(), attr);
+        if (res < 0) {
+            status[i] = res;
+        } else if (attr.isDirectory) {
+            status[i] = -EISDIR;
+        } else if (attr.IsPacked() || attr.numReplicas <= 0 ||
+                attr.striperType != KFS_STRIPED_FILE_TYPE_NONE) {
+            status[i] = -EINVAL;
+        } else if (attr.fileSize < 0 ||
+                (chunkOff_t)CHUNKSIZE < attr.fileSize) {
+            status[i] = -EFBIG;
+        }
+    }
+    return PackFilesSelf(containerPath, pathnames, attrs, status);
+}
+
+int
+KfsClientImpl::PackFilesSelf(const char* containerPath,
+    const vector<string>& pathnames, const vector<KfsFileAttr>& attrs,
+    vector<int>& status)
+{
+    size_t cnt = 0;
+    for (size_t i = 0; i < pathnames.size(); i++) {
+        if (status[i] == 0) {
+            cnt++;
+        }
+    }
+    if (cnt <= 0) {
+        return (status.empty() ? 0 : status.front());
+    }
+    const bool kExclusiveFlag = true;
+    const int  fd             = Create(containerPath, 3, kExclusiveFlag);
+    if (fd < 0) {
+        return fd;
+    }
+    vector<chunkOff_t> offsets(pathnames.size(), chunkOff_t(-1));
+    vector<char>       buf;
+    chunkOff_t         pos = 0;
+    int                res = 0;
+    for (size_t i = 0; i < pathnames.size() && 0 <= res; i++) {
+        if (status[i] != 0) {
+            continue;
+        }
+        const chunkOff_t size = attrs[i].fileSize;
+        if (buf.size() < (size_t)size) {
+            buf.resize((size_t)size);
+        }
+        const int rfd = Open(pathnames[i].c_str(), O_RDONLY, 3, 0, 0, 0,
+            KFS_STRIPED_FILE_TYPE_NONE, kKfsModeUndef,
+            kKfsSTierMax, kKfsSTierMax);
+        if (rfd < 0) {
+            status[i] = rfd;
+            continue;
+        }
+        chunkOff_t len = 0;
+        while (len < size) {
+            const ssize_t nrd = Read(rfd, &buf[len], (size_t)(size - len));
+            if (nrd <= 0) {
+                break;
+            }
+            len += nrd;
+        }
+        Close(rfd);
+        if (len != size) {
+            // The file was modified or read failed.
+            status[i] = -EAGAIN;
+            continue;
+        }
+        for (chunkOff_t off = 0; off < size && 0 <= res; ) {
+            const ssize_t nwr = Write(fd, &buf[off], (size_t)(size - off));
+            if (nwr <= 0) {
+                res = nwr < 0 ? (int)nwr : -EIO;
+            } else {
+                off += nwr;
+            }
+        }
+        offsets[i] = pos;
+        pos += size;
+    }
+    const int cres = Close(fd);
+    if (0 <= res) {
+        res = cres;
+    }
+    KfsFileAttr cattr;
+    if (0 <= res) {
+        res = Stat(containerPath, cattr);
+    }
+    if (res < 0) {
+        KFS_LOG_STREAM_ERROR << "pack: " << containerPath <<
+            " status: " << res <<
+        KFS_LOG_EOM;
+        Remove(containerPath);
+        return res;
+    }
+    QCStMutexLocker l(mMutex);
+    cnt = 0;
+    for (size_t i = 0; i < pathnames.size(); i++) {
+        if (status[i] != 0 || offsets[i] < 0) {
+            continue;
+        }
+        PackFileOp op(0, attrs[i].fileId, cattr.fileId, offsets[i],
+            attrs[i].fileSize, attrs[i].packedContainer);
+        DoMetaOpWithRetry(&op);
+        status[i] = GetOpStatus(op);
+        if (status[i] == 0) {
+            cnt++;
+        }
+        kfsFileId_t parentFid;
+        string      fileName;
+        if (GetPathComponents(pathnames[i].c_str(), &parentFid, fileName) ==
+                0) {
+            Delete(LookupFAttr(parentFid, fileName));
+        }
+    }
+    if (cnt <= 0) {
+        Remove(containerPath);
+    }
+    for (size_t i = 0; i < status.size(); i++) {
+        if (status[i] < 0) {
+            return status[i];
+        }
+    }
+    return 0;
+}
+
+int
+KfsClientImpl::CompactPackedFiles(const char* dirname,
+    const char* containerPath, double minLiveRatio)
+{
+    if (! dirname || ! *dirname || ! containerPath || ! *containerPath) {
+        return -EINVAL;
+    }
+    vector<KfsFileAttr> entries;
+    int res = ReaddirPlus(dirname, entries);
+    if (res < 0) {
+        return res;
+    }
+    typedef map<kfsFileId_t, chunkOff_t> LiveBytes;
+    LiveBytes live;
+    for (vector<KfsFileAttr>::const_iterator it = entries.begin();
+            it != entries.end();
+            ++it) {
+        if (it->IsPacked()) {
+            live[it->packedContainer] += it->fileSize;
+        }
+    }
+    vector<string> containers;
+    for (LiveBytes::iterator it = live.begin(); it != live.end(); ) {
+        KfsFileAttr            cattr;
+        chunkOff_t             offset       = -1;
+        int64_t                chunkVersion = -1;
+        vector<ServerLocation> servers;
+        if (GetFileOrChunkInfo(it->first, -1, cattr, offset, chunkVersion,
+                    servers) < 0 || cattr.fileSize <= 0 ||
+                (double)cattr.fileSize * minLiveRatio <= (double)it->second) {
+            live.erase(it++);
+        } else {
+            containers.push_back(cattr.filename);
+            ++it;
+        }
+    }
+    if (live.empty()) {
+        return 0;
+    }
+    string dir(dirname);
+    if (*dir.rbegin() != '/') {
+        dir += "/";
+    }
+    vector<string>      pathnames;
+    vector<KfsFileAttr> attrs;
+    for (vector<KfsFileAttr>::const_iterator it = entries.begin();
+            it != entries.end();
+            ++it) {
+        if (it->IsPacked() && live.find(it->packedContainer) != live.end()) {
+            pathnames.push_back(dir + it->filename);
+            attrs.push_back(*it);
+        }
+    }
+    vector<int> status(pathnames.size(), 0);
+    res = PackFilesSelf(containerPath, pathnames, attrs, status);
+    if (res < 0 && status.end() == find(status.begin(), status.end(), 0)) {
+        return res;
+    }
+    for (vector<string>::const_iterator it = containers.begin();
+            it != containers.end();
+            ++it) {
+        // Containers still referenced from other directories remain.
+        Remove(it->c_str());
+    }
+    return (int)count(status.begin(), status.end(), 0);
+}
+
 int
 KfsClientImpl::SetMtime(const char *pathname, const struct timeval &mtime)
 {
@@ -3877,9 +5640,13 @@ KfsClientImpl::Open(const char *pathname, int openMode, int numReplicas,
 {
     QCStMutexLocker l(mMutex);
     const bool kCacheAttributesFlag = false;
-    return OpenSelf(pathname, openMode, numReplicas,
+    const int fd = OpenSelf(pathname, openMode, numReplicas,
         numStripes, numRecoveryStripes, stripeSize, stripedType,
         minSTier, maxSTier, kCacheAttributesFlag, mode);
+    if (fd < 0 || ! mFileTable[fd]->compressedFile) {
+        return fd;
+    }
+    return LoadCompressedFile(fd, l);
 }
 
 int
@@ -3997,6 +5764,9 @@ KfsClientImpl::OpenSelf(const char *pathname, int openMode, int numReplicas,
     if (fattr.isDirectory && openMode != O_RDONLY) {
         return -EISDIR;
     }
+    if (fattr.IsPacked() && (openMode & (O_WRONLY | O_RDWR | O_APPEND)) != 0) {
+        return -EPERM;
+    }
 
     const int fte = AllocFileTableEntry(parentFid, filename, fpath);
     if (fte < 0) { // Too many open files
@@ -4041,9 +5811,22 @@ KfsClientImpl::OpenSelf(const char *pathname, int openMode, int numReplicas,
             fa->fileSize = entry.fattr.fileSize;
         }
     }
+    if (! cacheAttributesFlag && ! entry.fattr.isDirectory &&
+            entry.fattr.compression != KFS_COMPRESSION_NONE) {
+        // Record appends, and unknown codecs are not supported.
+        if ((entry.openMode & O_APPEND) != 0 ||
+                KFS_COMPRESSION_MAX < entry.fattr.compression) {
+            ReleaseFileTableEntry(fte);
+            return -ENOTSUP;
+        }
+        entry.compressedFile = new CompressedFile(*this, fte,
+            entry.fattr.compression, entry.fattr.fileSize,
+            entry.openMode != O_RDONLY);
+    }
     if (! entry.fattr.isDirectory) {
         SetOptimalIoBufferSize(entry, mDefaultIoBufferSize);
         SetOptimalReadAheadSize(entry, mDefaultReadAheadSize);
+        InitAdaptiveReadAhead(entry);
         if (fa && entry.openMode != O_RDONLY) {
             Delete(fa); // Invalidate attribute cache entry if isn't read only.
         }
@@ -4063,6 +5846,7 @@ KfsClientImpl::Close(int fd)
 {
     KfsProtocolWorker::FileInstance fileInstance;
     KfsProtocolWorker::FileId       fileId;
+    KfsProtocolWorker::FileId       readFileId;
     KfsProtocolWorker::RequestType  closeType;
     bool                            readCloseFlag;
     bool                            writeCloseFlag;
@@ -4075,10 +5859,21 @@ KfsClientImpl::Close(int fd)
             return -EBADF;
         }
         FileTableEntry& entry = *mFileTable[fd];
+        if (entry.compressedFile && entry.openMode != O_RDONLY) {
+            // Write the last block and chunk header.
+            CompressedFile& file = *entry.compressedFile;
+            l.Unlock();
+            status = file.Close();
+            l.Lock();
+            if (! valid_fd(fd) || mFileTable[fd] != &entry) {
+                return (status < 0 ? status : -EBADF);
+            }
+        }
         closeType      = (entry.openMode & O_APPEND) != 0 ?
             KfsProtocolWorker::kRequestTypeWriteAppendClose :
             KfsProtocolWorker::kRequestTypeWriteClose;
         fileId         = entry.fattr.fileId;
+        readFileId     = entry.fattr.GetReadFileId();
         fileInstance   = entry.instance;
         readCloseFlag  = entry.readUsedProtocolWorkerFlag && mProtocolWorker;
         writeCloseFlag = entry.usedProtocolWorkerFlag && mProtocolWorker;
@@ -4098,7 +5893,7 @@ KfsClientImpl::Close(int fd)
         ReleaseFileTableEntry(fd);
     }
     if (writeCloseFlag) {
-        const int ret = (int)mProtocolWorker->Execute(
+        const int ret = (int)GetProtocolWorker(fileInstance).Execute(
             closeType,
             fileInstance,
             fileId
@@ -4108,10 +5903,10 @@ KfsClientImpl::Close(int fd)
         }
     }
     if (readCloseFlag) {
-        const int ret = (int)mProtocolWorker->Execute(
+        const int ret = (int)GetProtocolWorker(fileInstance).Execute(
             KfsProtocolWorker::kRequestTypeReadShutdown,
             fileInstance + 1, // reader's instance always +1
-            fileId
+            readFileId
         );
         if (! writeCloseFlag && ret != 0 && status == 0) {
             status = ret;
@@ -4151,13 +5946,25 @@ KfsClientImpl::Sync(int fd)
         return -EBADF;
     }
     FileTableEntry& entry = *mFileTable[fd];
+    if (entry.compressedFile && entry.openMode != O_RDONLY) {
+        CompressedFile& file = *entry.compressedFile;
+        l.Unlock();
+        const int res = file.Flush();
+        if (res < 0) {
+            return res;
+        }
+        l.Lock();
+        if (! valid_fd(fd) || mFileTable[fd] != &entry) {
+            return -EBADF;
+        }
+    }
     if (entry.pending > 0 &&
             mProtocolWorker && entry.usedProtocolWorkerFlag) {
         const KfsProtocolWorker::FileId       fileId       = entry.fattr.fileId;
         const KfsProtocolWorker::FileInstance fileInstance = entry.instance;
-        entry.pending = 0;
+        SetWriteBehindPending(entry, 0);
         l.Unlock();
-        return (int)mProtocolWorker->Execute(
+        return (int)GetProtocolWorker(fileInstance).Execute(
             (entry.openMode & O_APPEND) != 0 ?
                 KfsProtocolWorker::kRequestTypeWriteAppend :
                 KfsProtocolWorker::kRequestTypeWrite,
@@ -4179,7 +5986,18 @@ KfsClientImpl::Truncate(int fd, chunkOff_t offset)
         return syncRes;
     }
     QCStMutexLocker l(mMutex);
-    return TruncateSelf(fd, offset);
+    if (! valid_fd(fd) || ! mFileTable[fd]->compressedFile) {
+        return TruncateSelf(fd, offset);
+    }
+    // Compressed file can only be truncated to 0.
+    if (offset != 0) {
+        return -ENOTSUP;
+    }
+    const int res = TruncateSelf(fd, offset);
+    if (res == 0) {
+        mFileTable[fd]->compressedFile->Reset();
+    }
+    return res;
 }
 
 int
@@ -4196,6 +6014,9 @@ KfsClientImpl::Truncate(const char* pathname, chunkOff_t offset)
     if (attr.isDirectory) {
         return -EISDIR;
     }
+    if (attr.compression != KFS_COMPRESSION_NONE && offset != 0) {
+        return -ENOTSUP;
+    }
     TruncateOp op(0, path.c_str(), attr.fileId, offset);
     op.checkPermsFlag = true;
     op.setEofHintFlag = attr.numStripes > 1;
@@ -4508,8 +6329,8 @@ KfsClientImpl::SetDefaultIOTimeout(int nsecs)
         return;
     }
     mDefaultOpTimeout = timeout;
-    if (mProtocolWorker) {
-        mProtocolWorker->SetOpTimeoutSec(mDefaultOpTimeout);
+    for (size_t i = 0; i < mProtocolWorkers.size(); i++) {
+        mProtocolWorkers[i]->SetOpTimeoutSec(mDefaultOpTimeout);
     }
 }
 
@@ -4530,8 +6351,8 @@ KfsClientImpl::SetDefaultMetaOpTimeout(int nsecs)
         return;
     }
     mDefaultMetaOpTimeout = timeout;
-    if (mProtocolWorker) {
-        mProtocolWorker->SetMetaOpTimeoutSec(mDefaultMetaOpTimeout);
+    for (size_t i = 0; i < mProtocolWorkers.size(); i++) {
+        mProtocolWorkers[i]->SetMetaOpTimeoutSec(mDefaultMetaOpTimeout);
     }
 }
 
@@ -4550,9 +6371,9 @@ KfsClientImpl::SetRetryDelay(int nsecs)
         return;
     }
     mRetryDelaySec = nsecs;
-    if (mProtocolWorker) {
-        mProtocolWorker->SetTimeSecBetweenRetries(mRetryDelaySec);
-        mProtocolWorker->SetMetaTimeSecBetweenRetries(mRetryDelaySec);
+    for (size_t i = 0; i < mProtocolWorkers.size(); i++) {
+        mProtocolWorkers[i]->SetTimeSecBetweenRetries(mRetryDelaySec);
+        mProtocolWorkers[i]->SetMetaTimeSecBetweenRetries(mRetryDelaySec);
     }
 }
 
@@ -4571,9 +6392,9 @@ KfsClientImpl::SetMaxRetryPerOp(int retryCount)
         return;
     }
     mMaxNumRetriesPerOp = retryCount;
-    if (mProtocolWorker) {
-        mProtocolWorker->SetMaxRetryCount(mMaxNumRetriesPerOp);
-        mProtocolWorker->SetMetaMaxRetryCount(mMaxNumRetriesPerOp);
+    for (size_t i = 0; i < mProtocolWorkers.size(); i++) {
+        mProtocolWorkers[i]->SetMaxRetryCount(mMaxNumRetriesPerOp);
+        mProtocolWorkers[i]->SetMetaMaxRetryCount(mMaxNumRetriesPerOp);
     }
 }
 
@@ -4618,18 +6439,91 @@ KfsClientImpl::StartProtocolWorker()
     }
     params.mUseClientPoolFlag = mConfig.getValue(
         "client.connectionPool", params.mUseClientPoolFlag ? 1 : 0) != 0;
-    mProtocolWorker = new KfsProtocolWorker(
-        mMetaServerLoc.hostname,
-        mMetaServerLoc.port,
-        &params
-    );
-    mProtocolWorker->SetOpTimeoutSec(mDefaultOpTimeout);
-    mProtocolWorker->SetMetaOpTimeoutSec(mDefaultMetaOpTimeout);
-    mProtocolWorker->SetMaxRetryCount(mMaxNumRetriesPerOp);
-    mProtocolWorker->SetMetaMaxRetryCount(mMaxNumRetriesPerOp);
-    mProtocolWorker->SetTimeSecBetweenRetries(mRetryDelaySec);
-    mProtocolWorker->SetMetaTimeSecBetweenRetries(mRetryDelaySec);
-    mProtocolWorker->Start();
+    params.mClientPoolMaxConnections = mConfig.getValue(
+        "client.connectionPool.maxConnectionsPerServer",
+        params.mClientPoolMaxConnections);
+    params.mClientPoolMaxPendingOps = mConfig.getValue(
+        "client.connectionPool.maxPendingOpsPerConnection",
+        params.mClientPoolMaxPendingOps);
+    params.mChunkLocationCacheSize = mConfig.getValue(
+        "client.chunkLocationCache.maxEntries",
+        params.mChunkLocationCacheSize);
+    params.mChunkLocationCacheTtlSec = mConfig.getValue(
+        "client.chunkLocationCache.ttlSec",
+        params.mChunkLocationCacheTtlSec);
+    params.mHedgedReadMinTimeoutMs = mConfig.getValue(
+        "client.hedgedRead.minTimeoutMs",
+        params.mHedgedReadMinTimeoutMs);
+    params.mHedgedReadPercentile = mConfig.getValue(
+        "client.hedgedRead.percentile",
+        params.mHedgedReadPercentile);
+    params.mHedgedReadMaxPercent = mConfig.getValue(
+        "client.hedgedRead.maxPercent",
+        params.mHedgedReadMaxPercent);
+    params.mECThreadCount = mConfig.getValue(
+        "client.ecThreadCount",
+        params.mECThreadCount);
+    params.mAppendMaxLingerMs = mConfig.getValue(
+        "client.appendMaxLingerMs",
+        params.mAppendMaxLingerMs);
+    params.mBlockCacheMaxBytes = mConfig.getValue(
+        "client.blockCache.maxBytes",
+        params.mBlockCacheMaxBytes);
+    params.mBlockCacheMaxReadSize = mConfig.getValue(
+        "client.blockCache.maxReadSize",
+        params.mBlockCacheMaxReadSize);
+    params.mLatencyStatsFlag = mLatencyStatsFlag;
+    params.mReadPreferLocalFlag = mConfig.getValue(
+        "client.readPreferLocal",
+        params.mReadPreferLocalFlag ? 1 : 0) != 0;
+    params.mRackId = mConfig.getValue(
+        "client.rackId",
+        params.mRackId);
+    params.mRackPrefixes = mConfig.getValue(
+        "client.rackPrefixes",
+        params.mRackPrefixes);
+    params.mShortCircuitReadFlag = mConfig.getValue(
+        "client.shortCircuitRead",
+        params.mShortCircuitReadFlag ? 1 : 0) != 0;
+    params.mWriteBehindFlushRatio = mConfig.getValue(
+        "client.writeBehind.flushRatio",
+        params.mWriteBehindFlushRatio);
+    params.mLeaseRenewBatchSize = mConfig.getValue(
+        "client.leaseRenewBatch.maxSize",
+        params.mLeaseRenewBatchSize);
+    params.mLeaseRenewBatchDelayMs = mConfig.getValue(
+        "client.leaseRenewBatch.maxDelayMs",
+        params.mLeaseRenewBatchDelayMs);
+    params.mAllocWriteIdWithWriteFlag = mConfig.getValue(
+        "client.allocWriteIdWithWrite",
+        params.mAllocWriteIdWithWriteFlag ? 1 : 0) != 0;
+    params.mNextChunkPreallocRatio = mConfig.getValue(
+        "client.nextChunkPreallocRatio",
+        params.mNextChunkPreallocRatio);
+    params.mMaxSpaceReservationSize = mConfig.getValue(
+        "client.maxAppendSpaceReservationSize",
+        params.mMaxSpaceReservationSize);
+    // Each protocol worker has its own network manager thread, meta and
+    // chunk server connections, and chunk location cache. The files are
+    // sharded across the workers, see GetProtocolWorker().
+    const int workerCount = max(1, min(64, mConfig.getValue(
+        "client.protocolWorkerCount", 1)));
+    for (int i = 0; i < workerCount; i++) {
+        KfsProtocolWorker* const worker = new KfsProtocolWorker(
+            mMetaServerLoc.hostname,
+            mMetaServerLoc.port,
+            &params
+        );
+        worker->SetOpTimeoutSec(mDefaultOpTimeout);
+        worker->SetMetaOpTimeoutSec(mDefaultMetaOpTimeout);
+        worker->SetMaxRetryCount(mMaxNumRetriesPerOp);
+        worker->SetMetaMaxRetryCount(mMaxNumRetriesPerOp);
+        worker->SetTimeSecBetweenRetries(mRetryDelaySec);
+        worker->SetMetaTimeSecBetweenRetries(mRetryDelaySec);
+        worker->Start();
+        mProtocolWorkers.push_back(worker);
+    }
+    mProtocolWorker = mProtocolWorkers.front();
 }
 
 int
@@ -4678,7 +6572,8 @@ KfsClientImpl::Seek(int fd, chunkOff_t offset, int whence)
         newOff = entry.currPos.fileOffset + offset;
         break;
     case SEEK_END:
-        newOff = entry.fattr.fileSize + offset;
+        newOff = (entry.compressedFile ?
+            entry.compressedFile->GetSize() : entry.fattr.fileSize) + offset;
         break;
     default:
         return -EINVAL;
@@ -4826,6 +6721,24 @@ KfsClientImpl::GetDefaultReadAheadSize() const
     return mDefaultReadAheadSize;
 }
 
+int
+KfsClientImpl::SetDefaultCompression(int codec)
+{
+    if (codec < KFS_COMPRESSION_NONE || KFS_COMPRESSION_MAX < codec) {
+        return -EINVAL;
+    }
+    QCStMutexLocker lock(mMutex);
+    mDefaultCompression = codec;
+    return 0;
+}
+
+int
+KfsClientImpl::GetDefaultCompression() const
+{
+    QCStMutexLocker lock(const_cast<KfsClientImpl*>(this)->mMutex);
+    return mDefaultCompression;
+}
+
 void
 KfsClientImpl::SetDefaultFullSparseFileSupport(bool flag)
 {
@@ -5273,24 +7186,127 @@ void
 KfsClientImpl::ExecuteMeta(KfsOp& op)
 {
     if (mMetaServer) {
-        mMetaServer->GetNetManager().UpdateTimeNow();
-        if (! mMetaServer->Enqueue(&op, this)) {
-            if (0 <= op.status) {
-                op.status    = -EFAULT;
-                op.statusMsg = "failed to enqueue";
+        if (StartMeta(op)) {
+            WaitMeta(op);
+        }
+        return;
+    }
+    StartProtocolWorker();
+    MetaOpStarted(op);
+    mProtocolWorker->ExecuteMeta(op);
+    LogMetaOpDone(op);
+}
+
+///
+/// Execute the entries ops keeping up to mMetaMaxPendingOps ops in flight on
+/// the meta server connection. The responses are waited for in the order
+/// the ops are started, and matched to the ops by the sequence numbers.
+///
+void
+KfsClientImpl::ExecuteMetaPipelined(KfsClientImpl::MetaOpEntries& entries)
+{
+    assert(mMutex.IsOwned());
+    InitUserAndGroupMode();
+    if (mMetaServer || mMetaMaxPendingOps <= 1) {
+        // The meta server event loop exits on any op completion, therefore
+        // execute one op at a time.
+        for (MetaOpEntries::iterator it = entries.begin();
+                it != entries.end();
+                ++it) {
+            if (it->op) {
+                ExecuteMeta(*it->op);
             }
-            KFS_LOG_STREAM_ERROR << op.statusMsg <<
-                " op: " << op.Show() <<
-            KFS_LOG_EOM;
-            return;
         }
+        return;
+    }
+    StartProtocolWorker();
+    MetaOpEntries::iterator next = entries.begin();
+    int                     pending = 0;
+    for (MetaOpEntries::iterator it = entries.begin();
+            it != entries.end();
+            ++it) {
+        if (! it->op) {
+            continue;
+        }
+        for (; next != entries.end() && pending < mMetaMaxPendingOps;
+                ++next) {
+            if (next->op) {
+                MetaOpStarted(*next->op);
+                mProtocolWorker->StartMeta(*next->op);
+                pending++;
+            }
+        }
+        mProtocolWorker->WaitMeta(*it->op);
+        pending--;
+        LogMetaOpDone(*it->op);
+    }
+}
+
+bool
+KfsClientImpl::StartMeta(KfsOp& op)
+{
+    MetaOpStarted(op);
+    if (! mMetaServer) {
+        StartProtocolWorker();
+        mProtocolWorker->StartMeta(op);
+        return true;
+    }
+    mMetaServer->GetNetManager().UpdateTimeNow();
+    if (! mMetaServer->Enqueue(&op, this)) {
+        if (0 <= op.status) {
+            op.status    = -EFAULT;
+            op.statusMsg = "failed to enqueue";
+        }
+        KFS_LOG_STREAM_ERROR << op.statusMsg <<
+            " op: " << op.Show() <<
+        KFS_LOG_EOM;
+        mMetaOpStartTimes.erase(&op);
+        return false;
+    }
+    return true;
+}
+
+void
+KfsClientImpl::WaitMeta(KfsOp& op)
+{
+    if (mMetaServer) {
         const bool     kWakeupAndCleanupFlag = false;
         QCMutex* const kNullMutexPtr         = 0;
         mMetaServer->GetNetManager().MainLoop(
             kNullMutexPtr, kWakeupAndCleanupFlag);
     } else {
-        StartProtocolWorker();
-        mProtocolWorker->ExecuteMeta(op);
+        mProtocolWorker->WaitMeta(op);
+    }
+    LogMetaOpDone(op);
+}
+
+void
+KfsClientImpl::MetaOpStarted(const KfsOp& op)
+{
+    if (mLatencyStatsFlag) {
+        mMetaOpStartTimes[&op] = microseconds();
+    }
+}
+
+void
+KfsClientImpl::LogMetaOpDone(const KfsOp& op)
+{
+    NegativeLookupCacheUpdate(op);
+    MetaOpStartTimes::iterator const it = mMetaOpStartTimes.find(&op);
+    if (it != mMetaOpStartTimes.end()) {
+        MetaOpLatency& latency = mMetaOpLatencies[op.op];
+        if (latency.name.empty()) {
+            ostringstream os;
+            os << op.Show();
+            const string str = os.str();
+            const size_t pos = str.find_first_of(" :");
+            latency.name = str.substr(0, pos);
+            if (latency.name.empty()) {
+                latency.name = "unknown";
+            }
+        }
+        latency.histogram.Add(max(int64_t(0), microseconds() - it->second));
+        mMetaOpStartTimes.erase(it);
     }
     KFS_LOG_STREAM_DEBUG <<
         "meta op done:" <<
@@ -5398,6 +7414,74 @@ KfsClientImpl::LookupFAttr(const string& pathname, string* path)
     return 0;
 }
 
+bool
+KfsClientImpl::IsNegativeLookupCached(kfsFileId_t parentFid,
+    const string& name, time_t now)
+{
+    if (mNegativeLookupCache.empty()) {
+        return false;
+    }
+    NegativeLookupCache::iterator const it =
+        mNegativeLookupCache.find(make_pair(parentFid, name));
+    if (it == mNegativeLookupCache.end()) {
+        return false;
+    }
+    if (it->second < now) {
+        mNegativeLookupCache.erase(it);
+        return false;
+    }
+    mAttrCacheStats.mNegativeHitCount++;
+    return true;
+}
+
+void
+KfsClientImpl::NegativeLookupCacheInsert(kfsFileId_t parentFid,
+    const string& name, time_t now)
+{
+    if (mNegativeLookupCacheTime <= 0 || mNegativeLookupCacheMaxSize <= 0) {
+        return;
+    }
+    if (mNegativeLookupCacheMaxSize <= mNegativeLookupCache.size()) {
+        // Remove expired entries, or start over if none expired.
+        for (NegativeLookupCache::iterator it = mNegativeLookupCache.begin();
+                it != mNegativeLookupCache.end(); ) {
+            if (it->second < now) {
+                mNegativeLookupCache.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+        if (mNegativeLookupCacheMaxSize <= mNegativeLookupCache.size()) {
+            mNegativeLookupCache.clear();
+        }
+    }
+    mAttrCacheStats.mNegativeInsertCount++;
+    mNegativeLookupCache[make_pair(parentFid, name)] =
+        now + mNegativeLookupCacheTime;
+}
+
+void
+KfsClientImpl::NegativeLookupCacheUpdate(const KfsOp& op)
+{
+    // The negative lookup cache is not kept coherent with the meta server,
+    // besides expiration time. Invalidate all entries when the name space
+    // changed by this client, instead of tracking each name.
+    if (mNegativeLookupCache.empty() || op.status < 0) {
+        return;
+    }
+    switch (op.op) {
+        case CMD_CREATE:
+        case CMD_MKDIR:
+        case CMD_RENAME:
+        case CMD_COALESCE_BLOCKS:
+            mAttrCacheStats.mNegativeInvalidateCount++;
+            mNegativeLookupCache.clear();
+            break;
+        default:
+            break;
+    }
+}
+
 KfsClientImpl::FAttr*
 KfsClientImpl::NewFAttr(kfsFileId_t parentFid, const string& name,
     const string& pathname)
@@ -5407,12 +7491,15 @@ KfsClientImpl::NewFAttr(kfsFileId_t parentFid, const string& name,
         mFattrCacheSkipValidateCnt = 0;
         ValidateFAttrCache(time(0), mFileAttributeRevalidateScan);
     }
-    const size_t kMaxInodeCacheSize = 16 << 10;
     for (size_t sz = mFidNameToFAttrMap.size();
-            kMaxInodeCacheSize <= sz;
+            mFAttrCacheMaxSize <= sz && 0 < sz;
             sz--) {
+        mAttrCacheStats.mEvictCount++;
         Delete(FAttrLru::Front(mFAttrLru));
     }
+    if (! mNegativeLookupCache.empty()) {
+        mNegativeLookupCache.erase(make_pair(parentFid, name));
+    }
     FAttr* const fa = new (mFAttrPool.Allocate()) FAttr(mFAttrLru);
     pair<FidNameToFAttrMap::iterator, bool> const res =
         mFidNameToFAttrMap.insert(make_pair(make_pair(parentFid, name), fa));
@@ -5532,6 +7619,8 @@ KfsClientImpl::ReleaseFileTableEntry(int fte)
         " fileId: "   << entry.fattr.fileId <<
     KFS_LOG_EOM;
     CancelPendingRead(entry);
+    ChargeAdaptiveReadAhead(entry, 0);
+    SetWriteBehindPending(entry, 0);
     delete &entry;
 }
 
@@ -6110,6 +8199,112 @@ KfsClientImpl::VerifyDataChecksums(int fd)
     return VerifyDataChecksumsFid(entry.fattr);
 }
 
+///
+/// Runs chunk server ops in parallel, with one connection per chunk server,
+/// on the client network manager. Used by the data checksum verification in
+/// order to query all chunk replicas at once.
+///
+class ChunkServerOpsRunner : public KfsNetClient::OpOwner
+{
+public:
+    ChunkServerOpsRunner(
+        NetManager&        netManager,
+        ClientAuthContext& authCtx,
+        int                opTimeoutSec,
+        int                maxRetryCount,
+        int                timeSecBetweenRetries)
+        : mNetManager(netManager),
+          mAuthCtx(authCtx),
+          mOpTimeoutSec(opTimeoutSec),
+          mMaxRetryCount(maxRetryCount),
+          mTimeSecBetweenRetries(timeSecBetweenRetries),
+          mServers(),
+          mPendingCount(0)
+        {}
+    virtual ~ChunkServerOpsRunner()
+    {
+        for (Servers::iterator it = mServers.begin();
+                it != mServers.end();
+                ++it) {
+            it->second->Stop();
+            delete it->second;
+        }
+    }
+    KfsNetClient& Get(const ServerLocation& loc)
+    {
+        Servers::iterator it = mServers.find(loc);
+        if (it == mServers.end()) {
+            KfsNetClient* const server = new KfsNetClient(
+                mNetManager,
+                loc.hostname,
+                loc.port,
+                mMaxRetryCount,
+                mTimeSecBetweenRetries,
+                mOpTimeoutSec
+            );
+            server->SetMaxContentLength(64 << 20);
+            server->SetAuthContext(&mAuthCtx);
+            it = mServers.insert(make_pair(loc, server)).first;
+        }
+        return *(it->second);
+    }
+    void Enqueue(KfsNetClient& server, KfsOp& op)
+    {
+        mPendingCount++;
+        if (! server.Enqueue(&op, this)) {
+            mPendingCount--;
+            if (0 <= op.status) {
+                op.status    = -EFAULT;
+                op.statusMsg = "failed to enqueue";
+            }
+        }
+    }
+    void Run()
+    {
+        const bool     kWakeupAndCleanupFlag = false;
+        QCMutex* const kNullMutexPtr         = 0;
+        while (0 < mPendingCount) {
+            mNetManager.UpdateTimeNow();
+            mNetManager.MainLoop(kNullMutexPtr, kWakeupAndCleanupFlag);
+        }
+    }
+    virtual void OpDone(
+        KfsOp*    inOpPtr,
+        bool      inCanceledFlag,
+        IOBuffer* /* inBufferPtr */)
+    {
+        if (inCanceledFlag && inOpPtr->status == 0) {
+            inOpPtr->status    = -ECANCELED;
+            inOpPtr->statusMsg = "canceled";
+        }
+        KFS_LOG_STREAM_DEBUG <<
+            (inCanceledFlag ? "op canceled: " : "op completed: ") <<
+            inOpPtr->Show() << " status: " << inOpPtr->status <<
+        KFS_LOG_EOM;
+        if (--mPendingCount <= 0) {
+            mNetManager.Shutdown();
+        }
+    }
+private:
+    typedef map<
+        ServerLocation,
+        KfsNetClient*,
+        less<ServerLocation>,
+        StdFastAllocator<pair<const ServerLocation, KfsNetClient*> >
+    > Servers;
+
+    NetManager&        mNetManager;
+    ClientAuthContext& mAuthCtx;
+    const int          mOpTimeoutSec;
+    const int          mMaxRetryCount;
+    const int          mTimeSecBetweenRetries;
+    Servers            mServers;
+    int                mPendingCount;
+private:
+    ChunkServerOpsRunner(const ChunkServerOpsRunner&);
+    ChunkServerOpsRunner& operator=(const ChunkServerOpsRunner&);
+};
+
 int
 KfsClientImpl::VerifyDataChecksumsFid(const FileAttr& attr)
 {
@@ -6122,16 +8317,81 @@ KfsClientImpl::VerifyDataChecksumsFid(const FileAttr& attr)
         KFS_LOG_EOM;
         return GetOpStatus(lop);
     }
+    // With chunk server access the connection keys are per chunk lease,
+    // therefore verify one chunk at a time in this case.
+    const ptrdiff_t maxChunks =
+        (! mUseOsUserAndGroupFlag && mAuthCtx.IsEnabled()) ? 1 : 16;
+    ChunkServerOpsRunner runner(mNetManager, mAuthCtx,
+        mDefaultOpTimeout, mMaxNumRetriesPerOp, mRetryDelaySec);
+    int status = 0;
+    for (vector<ChunkLayoutInfo>::const_iterator it = lop.chunks.begin();
+            it != lop.chunks.end(); ) {
+        const vector<ChunkLayoutInfo>::const_iterator last =
+            it + min(maxChunks, lop.chunks.end() - it);
+        const int ret = VerifyChunksChecksums(it, last, runner);
+        if (status == 0) {
+            status = ret;
+        }
+        it = last;
+    }
+    return status;
+}
+
+class ChunkChecksumsVerifyEntry
+{
+public:
+    typedef vector<GetChunkMetadataOp*> MetaOps;
+    typedef vector<ReadOp*>             ReadOps;
+
+    ChunkChecksumsVerifyEntry()
+        : access(),
+          leaseId(-1),
+          ops(),
+          reads()
+        {}
+    ~ChunkChecksumsVerifyEntry()
+    {
+        for (MetaOps::iterator it = ops.begin(); it != ops.end(); ++it) {
+            delete *it;
+        }
+        ClearReads();
+    }
+    void ClearReads()
+    {
+        for (ReadOps::iterator it = reads.begin(); it != reads.end(); ++it) {
+            delete *it;
+        }
+        reads.clear();
+    }
+    ChunkServerAccess access;
+    int64_t           leaseId;
+    MetaOps           ops;
+    ReadOps           reads;
+};
+
+///
+/// Get the chunk checksums computed by all chunk replicas in parallel, with
+/// chunk servers verifying the data checksums, and compare the checksums.
+/// Only the blocks with mismatched checksums are read from the replicas, in
+/// order to compare the blocks content.
+///
+int
+KfsClientImpl::VerifyChunksChecksums(
+    vector<ChunkLayoutInfo>::const_iterator first,
+    vector<ChunkLayoutInfo>::const_iterator last,
+    ChunkServerOpsRunner&                   runner)
+{
     const size_t numChecksums = CHUNKSIZE / CHECKSUM_BLOCKSIZE;
-    scoped_array<uint32_t> chunkChecksums1;
-    chunkChecksums1.reset(new uint32_t[numChecksums]);
-    scoped_array<uint32_t> chunkChecksums2;
-    chunkChecksums2.reset(new uint32_t[numChecksums]);
+    const size_t maxBlockReads = 64;
+    const bool   leaseFlag     =
+        ! mUseOsUserAndGroupFlag && mAuthCtx.IsEnabled();
+    scoped_array<ChunkChecksumsVerifyEntry> entries(
+        new ChunkChecksumsVerifyEntry[last - first]);
     int status = 0;
-    for (vector<ChunkLayoutInfo>::const_iterator i = lop.chunks.begin();
-            i != lop.chunks.end();
-            ++i) {
-        int ret;
+    ChunkChecksumsVerifyEntry* e = entries.get();
+    for (vector<ChunkLayoutInfo>::const_iterator i = first;
+            i != last;
+            ++i, ++e) {
         if (i->chunkServers.empty()) {
             if (status == 0) {
                 status = -EAGAIN;
@@ -6141,41 +8401,179 @@ KfsClientImpl::VerifyDataChecksumsFid(const FileAttr& attr)
             KFS_LOG_EOM;
             continue;
         }
-        if ((ret = GetDataChecksums(
-                i->chunkServers[0], i->chunkId, i->chunkVersion, i->fileOffset,
-                chunkChecksums1.get())) < 0) {
-            KFS_LOG_STREAM_ERROR << "failed to get checksums from server " <<
-                i->chunkServers[0] << " " << ErrorCodeToStr(ret) <<
-            KFS_LOG_EOM;
-            if (status == 0) {
-                status = ret;
+        if (leaseFlag) {
+            const int ret = GetChunkLease(i->chunkId, i->chunkVersion,
+                i->fileOffset, "", -1, e->access, e->leaseId);
+            if (ret < 0) {
+                KFS_LOG_STREAM_ERROR << "chunk: " << i->chunkId <<
+                    " failed to get chunk access: " << ErrorCodeToStr(ret) <<
+                KFS_LOG_EOM;
+                if (status == 0) {
+                    status = ret;
+                }
+                continue;
             }
-            continue;
         }
-        for (size_t k = 1; k < i->chunkServers.size(); k++) {
-            if ((ret = GetDataChecksums(
-                    i->chunkServers[k], i->chunkId, i->chunkVersion,
-                    i->fileOffset, chunkChecksums2.get())) < 0) {
-                KFS_LOG_STREAM_ERROR << "failed get checksums from server: " <<
+        for (size_t k = 0; k < i->chunkServers.size(); k++) {
+            e->ops.push_back(new GetChunkMetadataOp(0, i->chunkId, true));
+            GetChunkMetadataOp& op     = *e->ops.back();
+            KfsNetClient&       server = runner.Get(i->chunkServers[k]);
+            op.chunkVersion = i->chunkVersion;
+            const int ret = SetChunkAccess(
+                e->access, i->chunkServers[k], i->chunkId, op.access, &server);
+            if (ret < 0) {
+                op.status = ret;
+                continue;
+            }
+            runner.Enqueue(server, op);
+        }
+    }
+    runner.Run();
+    e = entries.get();
+    for (vector<ChunkLayoutInfo>::const_iterator i = first;
+            i != last;
+            ++i, ++e) {
+        // Use the first replica that returned checksums as the reference.
+        size_t ref = e->ops.size();
+        for (size_t k = 0; k < e->ops.size(); k++) {
+            GetChunkMetadataOp& op = *e->ops[k];
+            if (op.status == 0 &&
+                    op.contentLength < numChecksums * sizeof(uint32_t)) {
+                op.status = -EINVAL;
+            }
+            if (op.status < 0) {
+                const int ret = GetOpStatus(op);
+                KFS_LOG_STREAM_ERROR << "chunk: " << i->chunkId <<
+                    " failed to get checksums from server: " <<
                     i->chunkServers[k] << " " << ErrorCodeToStr(ret) <<
+                    (op.status == -EBADCKSUM ?
+                        " checksum mismatch for scrub read" : "") <<
                 KFS_LOG_EOM;
                 if (status == 0) {
                     status = ret;
                 }
                 continue;
             }
-            for (size_t v = 0; v < numChecksums; v++) {
-                if (chunkChecksums1[v] != chunkChecksums2[v]) {
-                    KFS_LOG_STREAM_ERROR <<
-                        "checksum mismatch between servers: " <<
-                        i->chunkServers[0] << " " << i->chunkServers[k] <<
-                    KFS_LOG_EOM;
-                    if (status == 0) {
-                        status = -EINVAL;
+            if (ref >= e->ops.size()) {
+                ref = k;
+            }
+        }
+        if (ref >= e->ops.size()) {
+            continue;
+        }
+        const uint32_t* const refChecksums =
+            reinterpret_cast<const uint32_t*>(e->ops[ref]->contentBuf);
+        vector<size_t> blocks;
+        for (size_t v = 0; v < numChecksums; v++) {
+            for (size_t k = ref + 1; k < e->ops.size(); k++) {
+                const GetChunkMetadataOp& op = *e->ops[k];
+                if (op.status == 0 && refChecksums[v] !=
+                        reinterpret_cast<const uint32_t*>(op.contentBuf)[v]) {
+                    blocks.push_back(v);
+                    break;
+                }
+            }
+        }
+        if (blocks.empty()) {
+            continue;
+        }
+        KFS_LOG_STREAM_ERROR << "chunk: " << i->chunkId <<
+            " checksum mismatch: " << blocks.size() << " blocks" <<
+            " reading mismatched blocks" <<
+        KFS_LOG_EOM;
+        if (status == 0) {
+            status = -EINVAL;
+        }
+        // The replicas with checksums, starting from the reference replica.
+        vector<size_t> replicas;
+        for (size_t k = ref; k < e->ops.size(); k++) {
+            if (e->ops[k]->status == 0) {
+                replicas.push_back(k);
+            }
+        }
+        for (size_t b = 0; b < blocks.size(); b += maxBlockReads) {
+            const size_t bend = min(blocks.size(), b + maxBlockReads);
+            for (size_t n = b; n < bend; n++) {
+                for (size_t r = 0; r < replicas.size(); r++) {
+                    const size_t              k   = replicas[r];
+                    const GetChunkMetadataOp& mop = *e->ops[k];
+                    e->reads.push_back(
+                        new ReadOp(0, i->chunkId, i->chunkVersion));
+                    ReadOp& op = *e->reads.back();
+                    op.offset   = (chunkOff_t)(blocks[n] * CHECKSUM_BLOCKSIZE);
+                    op.numBytes = CHECKSUM_BLOCKSIZE;
+                    op.access   = mop.access;
+                    op.skipVerifyDiskChecksumFlag = true;
+                    KfsNetClient& server = runner.Get(i->chunkServers[k]);
+                    SetChunkAccess(e->access, i->chunkServers[k], i->chunkId,
+                        op.access, &server);
+                    runner.Enqueue(server, op);
+                }
+            }
+            runner.Run();
+            // The reads are in the block, then replica order.
+            const size_t numReplicas = replicas.size();
+            for (size_t n = 0; n < e->reads.size(); n += numReplicas) {
+                const ReadOp& rop = *e->reads[n];
+                for (size_t r = 1; r < numReplicas; r++) {
+                    const ReadOp& op = *e->reads[n + r];
+                    const char* what = 0;
+                    if (rop.status < 0 || op.status < 0) {
+                        what = "read failure";
+                    } else if (rop.contentLength != op.contentLength ||
+                            memcmp(rop.contentBuf, op.contentBuf,
+                                op.contentLength) != 0) {
+                        what = "data mismatch";
+                    } else {
+                        what = "checksum mismatch with identical data";
                     }
+                    KFS_LOG_STREAM_ERROR << "chunk: " << i->chunkId <<
+                        " block offset: " << op.offset <<
+                        " " << what << ": " <<
+                        i->chunkServers[replicas[0]] <<
+                        " status: " << rop.status <<
+                        " vs " << i->chunkServers[replicas[r]] <<
+                        " status: " << op.status <<
+                    KFS_LOG_EOM;
                 }
             }
+            e->ClearReads();
+        }
+    }
+    // Close the chunks, and relinquish the leases.
+    vector<CloseOp*> closeOps;
+    e = entries.get();
+    for (vector<ChunkLayoutInfo>::const_iterator i = first;
+            i != last;
+            ++i, ++e) {
+        for (size_t k = 0; k < e->ops.size(); k++) {
+            closeOps.push_back(new CloseOp(0, i->chunkId));
+            CloseOp& op = *closeOps.back();
+            op.chunkVersion = i->chunkVersion;
+            op.access       = e->ops[k]->access;
+            KfsNetClient& server = runner.Get(i->chunkServers[k]);
+            if (SetChunkAccess(e->access, i->chunkServers[k], i->chunkId,
+                    op.access, &server) == 0) {
+                runner.Enqueue(server, op);
+            }
+        }
+    }
+    runner.Run();
+    for (vector<CloseOp*>::iterator it = closeOps.begin();
+            it != closeOps.end();
+            ++it) {
+        delete *it;
+    }
+    e = entries.get();
+    for (vector<ChunkLayoutInfo>::const_iterator i = first;
+            i != last;
+            ++i, ++e) {
+        if (e->leaseId < 0) {
+            continue;
         }
+        LeaseRelinquishOp op(0, i->chunkId, e->leaseId);
+        op.chunkPos = GetReadLeasePosition(i->chunkVersion, i->fileOffset);
+        DoMetaOpWithRetry(&op);
     }
     return status;
 }
@@ -6283,17 +8681,44 @@ KfsClientImpl::RecursivelyApply(
                 path, attr.fileId, entries, false, false, fileIdAndTypeOnly)) < 0) {
             entries.clear();
         }
-        int res = 0;
+        // Recurse into the sub directories, and pipeline the directory
+        // files ops.
+        MetaOpEntries ops;
+        int           res = 0;
         for (vector<KfsFileAttr>::const_iterator it = entries.begin();
                 it != entries.end();
                 ++it) {
             if (it->filename == "." || it->filename == "..") {
                 continue;
             }
-            if ((res = RecursivelyApply(path, *it, functor)) != 0) {
-                path.resize(prevSize);
-                return res;
+            if (it->isDirectory) {
+                if ((res = RecursivelyApply(path, *it, functor)) != 0) {
+                    break;
+                }
+                continue;
+            }
+            KfsOp* const op = functor.CreateOp(*it);
+            if (! op) {
+                continue;
+            }
+            ops.push_back(MetaOpEntry());
+            MetaOpEntry& entry = ops.back();
+            entry.path = path + (path == "/" ? "" : "/") + it->filename;
+            entry.op   = op;
+        }
+        if (res == 0) {
+            ExecuteMetaPipelined(ops);
+        }
+        for (MetaOpEntries::iterator it = ops.begin(); it != ops.end(); ++it) {
+            if (res == 0) {
+                res = functor.Done(it->path, *it->op);
             }
+            delete it->op;
+            it->op = 0;
+        }
+        if (res != 0) {
+            path.resize(prevSize);
+            return res;
         }
     }
     status = functor(path, attr, status);
@@ -6369,33 +8794,105 @@ public:
                 return ret;
             }
         }
-        ChmodOp op(0, attr.fileId, mMode & (attr.isDirectory ?
-            kfsMode_t(Permissions::kDirModeMask) :
-            kfsMode_t(Permissions::kFileModeMask)));
+        ChmodOp op(0, attr.fileId, GetMode(attr));
         mCli.DoMetaOpWithRetry(&op);
-        if (op.status != 0) {
-            const int ret = mErrHandler(path, GetOpStatus(op));
-            if (ret != 0) {
-                return ret;
-            }
-        }
-        return 0;
+        return Done(path, op);
     }
+    KfsOp* CreateOp(const KfsFileAttr& attr) const
+        { return new ChmodOp(0, attr.fileId, GetMode(attr)); }
+    int Done(const string& path, KfsOp& op) const
+        { return (op.status != 0 ? mErrHandler(path, GetOpStatus(op)) : 0); }
 private:
+    kfsMode_t GetMode(const KfsFileAttr& attr) const
+    {
+        return (mMode & (attr.isDirectory ?
+            kfsMode_t(Permissions::kDirModeMask) :
+            kfsMode_t(Permissions::kFileModeMask)));
+    }
+
     KfsClientImpl&  mCli;
     const kfsMode_t mMode;
     ErrorHandler&   mErrHandler;
 };
 
+///
+/// Change mode or owner of the directory sub tree with the meta server sub
+/// tree batches, one op per batch. The batches are resumed by the cursor
+/// returned by the previous batch, and restarted from the beginning if the
+/// cursor entry was removed or renamed after the previous batch.
+/// @param[out] supportedFlag   set to false if the meta server doesn't
+///                             support the sub tree change
+template<typename T>
+int
+KfsClientImpl::ChangeSubTreeAttr(const char* pathname, T& op,
+    KfsClientImpl::ErrorHandler& errHandler, bool& supportedFlag)
+{
+    const int kMaxRestarts = 4;
+    supportedFlag = true;
+    KfsFileAttr attr;
+    const int   res = StatSelf(pathname, attr, false);
+    if (res != 0) {
+        return res;
+    }
+    if (! attr.IsAnyPermissionDefined()) {
+        return 0; // permissions aren't supported by the meta server.
+    }
+    op.fid           = attr.fileId;
+    op.recursiveFlag = true;
+    op.cursor.clear();
+    int     restartCnt  = 0;
+    int64_t failedCount = 0;
+    for (; ;) {
+        op.seq               = 0;
+        op.status            = 0;
+        op.contentLength     = 0;
+        op.recursiveDoneFlag = -1;
+        op.statusMsg.clear();
+        DoMetaOpWithRetry(&op);
+        if (op.status == -EAGAIN && ! op.cursor.empty() &&
+                restartCnt++ < kMaxRestarts) {
+            op.cursor.clear();
+            failedCount = 0;
+            continue;
+        }
+        if (op.status != 0) {
+            InvalidateAllCachedAttrs();
+            return errHandler(pathname, GetOpStatus(op));
+        }
+        if (op.recursiveDoneFlag < 0) {
+            supportedFlag = false;
+            return 0;
+        }
+        failedCount += op.failedCount;
+        if (op.recursiveDoneFlag != 0) {
+            break;
+        }
+    }
+    InvalidateAllCachedAttrs();
+    // Entries not owned by the user are not changed.
+    return (0 < failedCount ? errHandler(pathname, -EACCES) : 0);
+}
+
 int
 KfsClientImpl::ChmodR(const char* pathname, kfsMode_t mode,
     KfsClientImpl::ErrorHandler* errHandler)
 {
     QCStMutexLocker l(mMutex);
 
+    if (mode == kKfsModeUndef) {
+        return -EINVAL;
+    }
     DefaultErrHandler errorHandler;
+    ChmodOp           op(0, -1, mode & kfsMode_t(Permissions::kDirModeMask));
+    bool              supportedFlag = false;
+    int               ret           = ChangeSubTreeAttr(pathname, op,
+        errHandler ? *errHandler : errorHandler, supportedFlag);
+    if (supportedFlag) {
+        return (errHandler ? ret :
+            (ret != 0 ? ret : errorHandler.GetStatus()));
+    }
     ChmodFunc funct(*this, mode, errHandler ? *errHandler : errorHandler);
-    const int ret = RecursivelyApply(pathname, funct);
+    ret = RecursivelyApply(pathname, funct);
     return (errHandler ? ret : (ret != 0 ? ret : errorHandler.GetStatus()));
 }
 
@@ -6639,6 +9136,18 @@ public:
         op.userName  = mUserName;
         op.groupName = mGroupName;
         mCli.DoMetaOpWithRetry(&op);
+        return Done(path, op);
+    }
+    KfsOp* CreateOp(const KfsFileAttr& attr) const
+    {
+        ChownOp* const op = new ChownOp(0, attr.fileId, mUser, mGroup);
+        op->userName  = mUserName;
+        op->groupName = mGroupName;
+        return op;
+    }
+    int Done(const string& path, KfsOp& inOp) const
+    {
+        ChownOp& op = static_cast<ChownOp&>(inOp);
         if (op.status != 0) {
             const int ret = mErrHandler(path, GetOpStatus(op));
             if (ret != 0) {
@@ -6693,9 +9202,26 @@ KfsClientImpl::ChownRSelf(
         return status;
     }
     DefaultErrHandler errorHandler;
+    ChownOp           op(0, -1, uid, gid);
+    op.userName  = un ? un : "";
+    op.groupName = gn ? gn : "";
+    bool supportedFlag = false;
+    int  ret           = ChangeSubTreeAttr(pathname, op,
+        errHandler ? *errHandler : errorHandler, supportedFlag);
+    if (supportedFlag) {
+        const time_t now = time(0);
+        if (op.status == 0 && ! op.userName.empty()) {
+            UpdateUserId(op.userName, op.user, now);
+        }
+        if (op.status == 0 && ! op.groupName.empty()) {
+            UpdateGroupId(op.groupName, op.group, now);
+        }
+        return (errHandler ? ret :
+            (ret != 0 ? ret : errorHandler.GetStatus()));
+    }
     ChownFunc funct(*this, uid, gid, un, gn,
         errHandler ? *errHandler : errorHandler);
-    const int ret = RecursivelyApply(pathname, funct);
+    ret = RecursivelyApply(pathname, funct);
     return (errHandler ? ret : (ret != 0 ? ret : errorHandler.GetStatus()));
 }
 
@@ -6724,14 +9250,15 @@ public:
         }
         ChangeFileReplicationOp op(0, attr.fileId, mReplication);
         mCli.DoMetaOpWithRetry(&op);
-        if (op.status != 0) {
-            const int ret = mErrHandler(path, GetOpStatus(op));
-            if (ret != 0) {
-                return ret;
-            }
-        }
-        return 0;
+        return Done(path, op);
+    }
+    KfsOp* CreateOp(const KfsFileAttr& attr) const
+    {
+        return (attr.isDirectory ? 0 :
+            new ChangeFileReplicationOp(0, attr.fileId, mReplication));
     }
+    int Done(const string& path, KfsOp& op) const
+        { return (op.status != 0 ? mErrHandler(path, GetOpStatus(op)) : 0); }
 private:
     KfsClientImpl& mCli;
     const int16_t  mReplication;
@@ -6989,10 +9516,12 @@ KfsClientImpl::SetChunkAccess(
     const ChunkServerAccess& inChunkServerAccess,
     const ServerLocation&    inLocation,
     kfsChunkId_t             inChunkId,
-    string&                  outChunkAccess)
+    string&                  outChunkAccess,
+    KfsNetClient*            inServerPtr)
 {
+    KfsNetClient& theServer = inServerPtr ? *inServerPtr : mChunkServer;
     if (inChunkServerAccess.IsEmpty()) {
-        mChunkServer.SetKey(0, 0, 0, 0);
+        theServer.SetKey(0, 0, 0, 0);
         outChunkAccess.clear();
         return 0;
     }
@@ -7000,7 +9529,7 @@ KfsClientImpl::SetChunkAccess(
     const ChunkServerAccess::Entry* const thePtr =
         inChunkServerAccess.Get(inLocation, inChunkId, theKey);
     if (thePtr) {
-        mChunkServer.SetKey(
+        theServer.SetKey(
             thePtr->chunkServerAccessId.mPtr,
             thePtr->chunkServerAccessId.mLen,
             theKey.GetPtr(),
@@ -7184,6 +9713,138 @@ KfsClientImpl::GetChunkFromReplica(
     return (int)nread;
 }
 
+ssize_t
+KfsClientImpl::ReadRanges(
+    int               inFd,
+    const chunkOff_t* inOffsetsPtr,
+    const size_t*     inLengthsPtr,
+    int               inCount,
+    char*             inBufPtr,
+    size_t*           outReadLengthsPtr)
+{
+    QCStMutexLocker theLocker(mMutex);
+
+    if (! valid_fd(inFd)) {
+        return -EBADF;
+    }
+    if (inCount <= 0) {
+        return 0;
+    }
+    FileTableEntry& theEntry = *mFileTable[inFd];
+    if (theEntry.openMode == O_WRONLY || theEntry.cachedAttrFlag ||
+            theEntry.fattr.isDirectory || theEntry.compressedFile ||
+            theEntry.fattr.IsPacked() ||
+            theEntry.fattr.striperType != KFS_STRIPED_FILE_TYPE_NONE ||
+            ! inOffsetsPtr || ! inLengthsPtr || ! inBufPtr) {
+        return -EINVAL;
+    }
+    const chunkOff_t kChunkSize  = (chunkOff_t)CHUNKSIZE;
+    const chunkOff_t theChunkPos =
+        inOffsetsPtr[0] - inOffsetsPtr[0] % kChunkSize;
+    ReadOp           theOp(0, -1, -1);
+    chunkOff_t       theStart = kChunkSize;
+    chunkOff_t       theEnd   = 0;
+    size_t           theSize  = 0;
+    theOp.ranges.reserve(2 * inCount);
+    for (int i = 0; i < inCount; i++) {
+        const chunkOff_t thePos = inOffsetsPtr[i] - theChunkPos;
+        if (inOffsetsPtr[i] < 0 || thePos < 0 || inLengthsPtr[i] <= 0 ||
+                (size_t)(kChunkSize - thePos) < inLengthsPtr[i]) {
+            // All ranges must be within the same chunk.
+            return -EINVAL;
+        }
+        theOp.ranges.push_back(thePos);
+        theOp.ranges.push_back((chunkOff_t)inLengthsPtr[i]);
+        theStart = min(theStart, thePos);
+        theEnd   = max(theEnd, thePos + (chunkOff_t)inLengthsPtr[i]);
+        theSize += inLengthsPtr[i];
+    }
+    ChunkAttr theChunk;
+    int       theStatus = LocateChunk(inFd, theChunkPos, theChunk);
+    if (theStatus < 0) {
+        return theStatus;
+    }
+    if (theChunk.chunkServerLoc.empty()) {
+        return -EAGAIN;
+    }
+    theOp.chunkId      = theChunk.chunkId;
+    theOp.chunkVersion = theChunk.chunkVersion;
+    theOp.offset       = theStart;
+    theOp.numBytes     = (size_t)(theEnd - theStart);
+    theStatus          = -EIO;
+    for (size_t k = 0; k < theChunk.chunkServerLoc.size(); k++) {
+        const ServerLocation& theLocation = theChunk.chunkServerLoc[k];
+        int64_t               theLeaseId  = -1;
+        theOp.access.clear();
+        theStatus = GetChunkAccess(theLocation, theOp.chunkId,
+            theOp.chunkVersion, theChunkPos, theOp.access, theLeaseId);
+        if (0 <= theStatus) {
+            theOp.seq           = 0;
+            theOp.status        = 0;
+            theOp.contentLength = 0;
+            theOp.statusMsg.clear();
+            DoChunkServerOp(theLocation, theOp);
+            theStatus = theOp.status;
+        }
+        if (0 <= theLeaseId) {
+            LeaseRelinquishOp theLeaseRelinquishOp(
+                0, theOp.chunkId, theLeaseId);
+            theLeaseRelinquishOp.chunkPos =
+                GetReadLeasePosition(theOp.chunkVersion, theChunkPos);
+            DoMetaOpWithRetry(&theLeaseRelinquishOp);
+        }
+        if (theStatus < 0) {
+            KFS_LOG_STREAM_ERROR << theLocation <<
+                " " << theOp.Show() <<
+                " status: " << theStatus <<
+                " msg: "    << theOp.statusMsg <<
+            KFS_LOG_EOM;
+            continue;
+        }
+        // Verify each range length and checksum.
+        chunkOff_t theRem = (chunkOff_t)theOp.contentLength;
+        if ((int)theOp.rangeLengths.size() != inCount ||
+                theOp.checksums.size() != theOp.rangeLengths.size()) {
+            theStatus = -EINVAL;
+        }
+        for (int i = 0; 0 <= theStatus && i < inCount; i++) {
+            const chunkOff_t theLen = theOp.rangeLengths[i];
+            if (theLen < 0 || (chunkOff_t)inLengthsPtr[i] < theLen ||
+                    theRem < theLen) {
+                theStatus = -EINVAL;
+            } else if (theOp.checksums[i] != ComputeBlockChecksum(
+                    theOp.contentBuf + (theOp.contentLength - theRem),
+                    (size_t)theLen)) {
+                theStatus = -EBADCKSUM;
+            }
+            theRem -= theLen;
+        }
+        if (0 <= theStatus && theRem != 0) {
+            theStatus = -EINVAL;
+        }
+        if (theStatus < 0) {
+            KFS_LOG_STREAM_ERROR << theLocation <<
+                " " << theOp.Show() <<
+                " invalid read ranges reply: " << ErrorCodeToStr(theStatus) <<
+            KFS_LOG_EOM;
+            continue;
+        }
+        size_t theBufPos = 0;
+        size_t theCPos   = 0;
+        for (int i = 0; i < inCount; i++) {
+            const size_t theLen = (size_t)theOp.rangeLengths[i];
+            memcpy(inBufPtr + theBufPos, theOp.contentBuf + theCPos, theLen);
+            if (outReadLengthsPtr) {
+                outReadLengthsPtr[i] = theLen;
+            }
+            theBufPos += inLengthsPtr[i];
+            theCPos   += theLen;
+        }
+        return (ssize_t)theCPos;
+    }
+    return theStatus;
+}
+
 const string&
 KfsClientImpl::UidToName(kfsUid_t uid, time_t now)
 {
@@ -7337,12 +9998,19 @@ KfsClientImpl::UpdateUserAndGroup(const LookupOp& op, time_t now)
     if (op.status < 0) {
         return;
     }
+    UpdateUserAndGroup(op.userName, op.groupName, op.fattr, now);
+}
+
+void
+KfsClientImpl::UpdateUserAndGroup(const string& userName,
+    const string& groupName, const FileAttr& fattr, time_t now)
+{
     mInitLookupRootFlag = false;
-    if (! op.userName.empty()) {
-        UpdateUserId(op.userName, op.fattr.user, now);
+    if (! userName.empty()) {
+        UpdateUserId(userName, fattr.user, now);
     }
-    if (! op.groupName.empty()) {
-        UpdateGroupId(op.groupName, op.fattr.group, now);
+    if (! groupName.empty()) {
+        UpdateGroupId(groupName, fattr.group, now);
     }
 }
 
@@ -7446,12 +10114,63 @@ KfsClientImpl::GetUserAndGroupNames(kfsUid_t user, kfsGid_t group,
     return 0;
 }
 
+class StatsSetter
+{
+public:
+    StatsSetter(Properties& props, const char* prefix)
+        : mProps(props),
+          mPrefix(prefix),
+          mKey(),
+          mValue()
+        {}
+    void SetPrefix(const string& prefix)
+        { mPrefix = prefix; }
+    template<typename T>
+    void operator()(const char* name, T value)
+    {
+        mKey = mPrefix;
+        mKey += name;
+        mValue.clear();
+        AppendDecIntToString(mValue, value);
+        mProps.setValue(mKey, mValue);
+    }
+private:
+    Properties& mProps;
+    string      mPrefix;
+    string      mKey;
+    string      mValue;
+};
+
 Properties*
 KfsClientImpl::GetStats()
 {
     QCStMutexLocker l(mMutex);
     StartProtocolWorker();
     Properties stats = mProtocolWorker->GetStats();
+    // Report the stats of the other workers with the worker index prefix.
+    string     key;
+    for (size_t i = 1; i < mProtocolWorkers.size(); i++) {
+        const Properties workerStats = mProtocolWorkers[i]->GetStats();
+        for (Properties::iterator it = workerStats.begin();
+                it != workerStats.end();
+                ++it) {
+            key = "ProtocolWorker";
+            AppendDecIntToString(key, i);
+            key += ".";
+            key.append(it->first.GetPtr(), it->first.GetSize());
+            stats.setValue(Properties::String(key), it->second);
+        }
+    }
+    StatsSetter setter(stats, "AttrCache.");
+    mAttrCacheStats.Enumerate(setter);
+    setter("Size",         mFidNameToFAttrMap.size());
+    setter("NegativeSize", mNegativeLookupCache.size());
+    for (MetaOpLatencies::const_iterator it = mMetaOpLatencies.begin();
+            it != mMetaOpLatencies.end();
+            ++it) {
+        setter.SetPrefix("Latency.Meta." + it->second.name + ".");
+        it->second.histogram.Enumerate(setter);
+    }
     if (stats.empty()) {
         return 0;
     }
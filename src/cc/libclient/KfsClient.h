@@ -73,6 +73,47 @@ public:
         ErrorHandler(const ErrorHandler&) {}
         ErrorHandler& operator=(const ErrorHandler&) { return *this; }
     };
+    ///
+    /// Asynchronous read / write completion. Done() is invoked exactly once
+    /// per successfully queued request, normally from the client protocol
+    /// worker thread, and might be invoked before the request submission
+    /// method returns. Done() must not block, and must not invoke KfsClient
+    /// methods, as the protocol worker thread can not make progress until
+    /// Done() returns. An event driven application can, for example, write
+    /// into eventfd or a pipe from Done() in order to wake up its event loop.
+    /// The status is the number of bytes read or written, or -errno.
+    ///
+    class IoCompletion
+    {
+    public:
+        virtual void Done(int fd, chunkOff_t pos, char* buf,
+            ssize_t status) = 0;
+    protected:
+        IoCompletion()  {}
+        virtual ~IoCompletion() {}
+        IoCompletion(const IoCompletion&) {}
+        IoCompletion& operator=(const IoCompletion&) { return *this; }
+    };
+    ///
+    /// Whole file read completion, see ReadFiles(). Done() is invoked exactly
+    /// once per path, from the ReadFiles() caller thread, in the order the
+    /// reads complete. Done() can invoke KfsClient methods. The buffer is
+    /// only valid until Done() returns, and can be null if the status is 0
+    /// or negative. The index is the path index in the ReadFiles() path
+    /// list. The status is the number of bytes read, or -errno.
+    ///
+    class ReadFilesCompletion
+    {
+    public:
+        virtual void Done(size_t index, const string& path, const char* buf,
+            ssize_t status) = 0;
+    protected:
+        ReadFilesCompletion()  {}
+        virtual ~ReadFilesCompletion() {}
+        ReadFilesCompletion(const ReadFilesCompletion&) {}
+        ReadFilesCompletion& operator=(const ReadFilesCompletion&)
+            { return *this; }
+    };
 
     KfsClient(client::KfsNetClient* metaServer = 0);
     ~KfsClient();
@@ -81,6 +122,11 @@ public:
     /// @param[in] metaServerHost  Machine on meta is running
     /// @param[in] metaServerPort  Port at which we should connect to
     /// @retval 0 on success; -1 on failure
+    /// If client.mountTable property is set, the paths with the mount table
+    /// prefixes are routed to the corresponding meta servers, and the rest of
+    /// the paths to the meta server specified by the arguments. Rename and
+    /// coalesce blocks across mounts fail with -EXDEV. The file descriptors
+    /// of the mounted files carry the mount index in the high bits.
     ///
     int Init(const string &metaServerHost, int metaServerPort,
         const Properties* props = 0);
@@ -148,6 +194,23 @@ public:
         bool computeFilesize = true, bool updateClientCache = true,
         bool fileIdAndTypeOnly = false);
 
+    ///
+    /// Read the contents of the directories and retrieve the attributes. Up to
+    /// client.metaMaxPendingOps directory listing requests are kept in flight
+    /// on the meta server connection.
+    /// @param[in] pathnames The full pathnames of the directories
+    /// @param[out] result  The files in each directory and their attributes,
+    /// one entry per pathname
+    /// @param[out] status  The status, one per pathname: 0 if readdirplus was
+    /// successful; -errno otherwise
+    /// @retval 0 if all readdirplus were successful; otherwise the first
+    /// negative entry status
+    ///
+    int ReaddirPlus(const vector<string>& pathnames,
+        vector<vector<KfsFileAttr> >& result, vector<int>& status,
+        bool computeFilesize = true, bool updateClientCache = true,
+        bool fileIdAndTypeOnly = false);
+
     ///
     /// Read a directory's contents and retrieve the attributes
     /// @retval 0 if readdirplus is successful; -errno otherwise
@@ -172,6 +235,22 @@ public:
     int Stat(const char* pathname, KfsFileAttr& result, bool computeFilesize = true);
     int Stat(int fd, KfsFileAttr& result);
 
+    ///
+    /// Stat a list of files and get their attributes. The attributes that are
+    /// not in the client's attribute cache are retrieved from the meta server
+    /// in batched lookup requests, each request covers many files.
+    /// @param[in] pathnames The list of full pathnames
+    /// @param[out] result  The attributes, one per pathname
+    /// @param[out] status  The stat status, one per pathname: 0 if stat was
+    /// successful; -errno otherwise
+    /// @param[in] computeFilesize  When set, for files, the size of
+    /// file is computed and the value is returned in result.st_size
+    /// @retval 0 if all stats were successful; otherwise the first
+    /// negative entry status
+    ///
+    int Stat(const vector<string>& pathnames, vector<KfsFileAttr>& result,
+        vector<int>& status, bool computeFilesize = true);
+
     ///
     /// Given a file, return the # of chunks in the file
     /// @param[in] pathname The full pathname such as /.../foo
@@ -354,8 +433,67 @@ public:
     ///
     int Rename(const char *oldpath, const char *newpath, bool overwrite = true);
 
+    ///
+    /// Pipelined bulk meta data operations: up to client.metaMaxPendingOps
+    /// requests are kept in flight on the meta server connection, instead of
+    /// waiting for each request completion before sending the next one. The
+    /// entries must be independent of each other, as the requests can be
+    /// executed in any order. For example, the parent directory of a Mkdir
+    /// entry must exist prior to the call.
+    /// @param[in] pathnames The full pathnames
+    /// @param[out] status  The status, one per pathname: 0 if the operation
+    /// was successful; -errno otherwise
+    /// @retval 0 if all operations were successful; otherwise the first
+    /// negative entry status
+    ///
+    int Remove(const vector<string>& pathnames, vector<int>& status);
+    int Mkdir(const vector<string>& pathnames, vector<int>& status,
+        kfsMode_t mode = 0777);
+    int Rename(const vector<string>& oldpaths, const vector<string>& newpaths,
+        vector<int>& status, bool overwrite = true);
+
     int CoalesceBlocks(const char *srcPath, const char *dstPath, chunkOff_t *dstStartOffset);
     ///
+    /// Copy non striped replicated file into an empty non striped replicated
+    /// file. The meta server allocates the destination chunks, and the chunk
+    /// servers copy the chunk data, preferably within the same chunk server,
+    /// therefore the data is not transferred through the client. Both files
+    /// must be in the same meta server namespace.
+    /// @param[in] srcPath  the source file
+    /// @param[in] dstPath  the destination file, must exist and be empty
+    /// @retval 0 on success; -errno on failure, the destination might contain
+    /// partial copy in this case
+    ///
+    int CopyFileChunks(const char* srcPath, const char* dstPath);
+    ///
+    /// Pack small non striped files into a new pack container file. The file
+    /// data is copied into the container, and the meta server then replaces
+    /// the file chunks with the container file extent. Packed files are read
+    /// only, and the container can not be modified or removed while it is
+    /// referenced by any packed file. All files and the container must be in
+    /// the same meta server namespace.
+    /// @param[in] containerPath  the new container file, must not exist
+    /// @param[in] pathnames      the files to pack, each must not be larger
+    /// than chunk size
+    /// @param[out] status        the status, one per pathname
+    /// @retval 0 if all files were packed; otherwise the first negative entry
+    /// status, or -errno if container creation or copy failed
+    ///
+    int PackFiles(const char* containerPath, const vector<string>& pathnames,
+        vector<int>& status);
+    ///
+    /// Move packed files of a directory out of the containers with the live,
+    /// still referenced, bytes to the container size ratio less than
+    /// minLiveRatio into a new pack container file, then remove the old
+    /// containers that are no longer referenced.
+    /// @param[in] dirname        the directory with packed files
+    /// @param[in] containerPath  the new container file, must not exist
+    /// @param[in] minLiveRatio   container compaction threshold
+    /// @retval number of moved files, or -errno on failure
+    ///
+    int CompactPackedFiles(const char* dirname, const char* containerPath,
+        double minLiveRatio = 0.5);
+    ///
     /// Set the mtime for a path
     /// @param[in] pathname  for which mtime has to be set
     /// @param[in] mtime     the desired mtime
@@ -468,6 +606,51 @@ public:
     ///
     int WriteAsyncCompletionHandler(int fd);
 
+    ///
+    /// Asynchronous positional read and write with completion callback.
+    /// Many requests can be outstanding at the same time, on the same or
+    /// different files, without a thread per request. The file position
+    /// is not used nor modified. The buffer must not be modified or released
+    /// until the completion is invoked. With ReadAsync() the read is
+    /// truncated to the end of file, and to the chunk boundary in the case
+    /// of skip holes file mode. The write completion reports that the data
+    /// was transferred to the chunk servers, or that the write failed. For
+    /// files opened for writing the write errors are also reported by Sync()
+    /// and Close(). The file must not be closed while the requests are
+    /// outstanding.
+    /// @param[in] fd that corresponds to a previously opened file
+    /// table entry.
+    /// @param[in] pos the file position to read from or write to.
+    /// @param buf  the read or write buffer.
+    /// @param[in] numBytes   The # of bytes of I/O to be done.
+    /// @param[in] completion the completion handler.
+    /// @retval the number of bytes queued, the completion is invoked only
+    /// if the return value is positive; 0 if nothing to read, i.e. the
+    /// position at or past the end of file; -errno on failure.
+    ///
+    ssize_t ReadAsync(int fd, chunkOff_t pos, char *buf, size_t numBytes,
+        IoCompletion& completion);
+    ssize_t WriteAsync(int fd, chunkOff_t pos, const char *buf,
+        size_t numBytes, IoCompletion& completion);
+
+    ///
+    /// Read many small files. The file attributes are retrieved with the
+    /// batched meta server lookups, and cached, therefore opening the files
+    /// does not require meta server round trips. Up to maxPendingFiles whole
+    /// file reads are kept in flight concurrently. Chunk server connections
+    /// are shared between the reads if client.connectionPool is enabled.
+    /// The files larger than maxFileSize fail with -EFBIG.
+    /// @param[in] pathnames  the files to read
+    /// @param[in] completion  the completion handler, invoked once per path
+    /// @param[in] maxPendingFiles  the max number of files read concurrently
+    /// @param[in] maxFileSize  the max file size
+    /// @retval 0 if all files were read successfully; otherwise the first
+    /// negative status
+    ///
+    int ReadFiles(const vector<string>& pathnames,
+        ReadFilesCompletion& completion, int maxPendingFiles = 64,
+        chunkOff_t maxFileSize = chunkOff_t(64) << 20);
+
     ///
     /// Read/write the desired # of bytes to the file, starting at the
     /// "current" position of the file.
@@ -485,6 +668,25 @@ public:
     ssize_t PRead(int fd, chunkOff_t pos, char *buf, size_t numBytes);
     ssize_t PWrite(int fd, chunkOff_t pos, const char *buf, size_t numBytes);
 
+    ///
+    /// Read multiple byte ranges of a single chunk of a replicated file with
+    /// one chunk server request. The chunk server reads the ranges extent
+    /// with one disk read, and returns only the ranges data, therefore the
+    /// ranges should be close to each other.
+    /// @param[in] offsets the ranges file offsets, all ranges must be within
+    /// the same chunk.
+    /// @param[in] lengths the ranges lengths.
+    /// @param[in] count the number of ranges.
+    /// @param[out] buf the range data is stored at the sum of the preceding
+    /// ranges lengths.
+    /// @param[out] readLengths if not null, the number of bytes read for
+    /// each range, which is less than the range length past the chunk end.
+    /// @retval On success, the total number of bytes read;
+    /// on failure, status code (< 0).
+    ///
+    ssize_t ReadRanges(int fd, const chunkOff_t* offsets,
+        const size_t* lengths, int count, char* buf, size_t* readLengths = 0);
+
     /// If there are any holes in a file, such as those at the end of
     /// a chunk, skip over them.
     void SkipHolesInFile(int fd);
@@ -640,6 +842,23 @@ public:
     //
     ssize_t GetDefaultReadAheadSize() const;
 
+    ///
+    /// Set block compression codec of the files created with Create() or
+    /// Open() with O_CREAT. Only replicated files are compressed. The data
+    /// of the compressed file is compressed by the client, the file can only
+    /// be written sequentially, and Stat() reports logical file size in
+    /// fileSize, and the size as stored in physicalSize.
+    /// @param[in] codec KFS_COMPRESSION_NONE or KFS_COMPRESSION_ZLIB
+    /// @retval 0 on success, or -EINVAL if codec is not supported
+    //
+    int SetDefaultCompression(int codec);
+
+    ///
+    /// Get default block compression codec.
+    /// @retval codec
+    //
+    int GetDefaultCompression() const;
+
     ///
     /// Set file read ahead size.
     /// @param[in] fd that corresponds to a previously opened file
@@ -761,8 +980,16 @@ public:
 
 private:
     typedef client::KfsClientImpl KfsClientImpl;
+    class Mounts;
+    class PathRoute;
+    class FdRoute;
+    friend class PathRoute;
+    friend class FdRoute;
 
     KfsClientImpl* const mImpl;
+    Mounts*              mMountsPtr;
+
+    KfsClientImpl* GetMountImpl(size_t idx) const;
 };
 
 ///
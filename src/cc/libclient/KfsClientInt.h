@@ -30,6 +30,7 @@
 #include "common/MsgLogger.h"
 #include "common/hsieh_hash.h"
 #include "common/kfstypes.h"
+#include "common/LatencyHistogram.h"
 #include "common/PoolAllocator.h"
 #include "common/RequestParser.h"
 #include "kfsio/NetManager.h"
@@ -37,11 +38,13 @@
 #include "kfsio/ClientAuthContext.h"
 #include "qcdio/QCDLList.h"
 #include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
 
 #include "KfsNetClient.h"
 #include "KfsAttr.h"
 #include "KfsOps.h"
 #include "KfsClient.h"
+#include "CompressedFile.h"
 #include "Path.h"
 
 #include <string>
@@ -165,6 +168,67 @@ private:
     ReadBuffer& operator=(const ReadBuffer& buf);
 };
 
+///
+/// \brief Per file read access pattern detector used by the adaptive read
+/// ahead. The pattern changes only after two consecutive reads are classified
+/// the same way, in order to ignore occasional seeks.
+///
+class ReadPattern
+{
+public:
+    enum Type
+    {
+        kTypeUnknown    = 0,
+        kTypeSequential = 1,
+        kTypeStrided    = 2,
+        kTypeRandom     = 3
+    };
+    ReadPattern()
+        : mNextPos(-1),
+          mStride(0),
+          mCount(0),
+          mLastType(kTypeUnknown),
+          mType(kTypeUnknown)
+        {}
+    Type Update(chunkOff_t pos, size_t size)
+    {
+        Type type;
+        if (pos == mNextPos) {
+            type = kTypeSequential;
+        } else if (0 <= mNextPos && 0 < mStride && pos - mNextPos == mStride) {
+            type = kTypeStrided;
+        } else {
+            type = kTypeRandom;
+        }
+        mStride  = 0 <= mNextPos ? pos - mNextPos : chunkOff_t(0);
+        mNextPos = pos + (chunkOff_t)size;
+        if (type == mLastType) {
+            if (mCount < kConfirmCount) {
+                mCount++;
+            }
+        } else {
+            mLastType = type;
+            mCount    = 1;
+        }
+        if (kConfirmCount <= mCount) {
+            mType = type;
+        }
+        return mType;
+    }
+    chunkOff_t GetStride() const
+        { return mStride; }
+    Type GetType() const
+        { return mType; }
+private:
+    enum { kConfirmCount = 2 };
+
+    chunkOff_t mNextPos;
+    chunkOff_t mStride;
+    int        mCount;
+    Type       mLastType;
+    Type       mType;
+};
+
 class KfsClientImpl;
 
 ///
@@ -204,11 +268,15 @@ struct FileTableEntry {
     bool                 readUsedProtocolWorkerFlag:1;
     bool                 cachedAttrFlag:1;
     bool                 failShortReadsFlag:1;
+    bool                 adaptiveReadAheadFlag:1;
     unsigned int         instance;
     int64_t              pending;
     vector<KfsFileAttr>* dirEntries;
     int                  ioBufferSize;
     ReadBuffer           buffer;
+    ReadPattern          readPattern;
+    int                  readAheadChargedSize;
+    CompressedFile*      compressedFile;
     ReadRequest*         mReadQueue[1];
 
     FileTableEntry(kfsFileId_t p, const string& n, unsigned int instance):
@@ -224,23 +292,31 @@ struct FileTableEntry {
         readUsedProtocolWorkerFlag(false),
         cachedAttrFlag(false),
         failShortReadsFlag(false),
+        adaptiveReadAheadFlag(false),
         instance(instance),
         pending(0),
         dirEntries(0),
         ioBufferSize(0),
-        buffer()
+        buffer(),
+        readPattern(),
+        readAheadChargedSize(0),
+        compressedFile(0)
         { mReadQueue[0] = 0; }
     ~FileTableEntry()
     {
         delete dirEntries;
+        delete compressedFile;
     }
 };
 
 class KfsProtocolWorker;
+class ChunkServerOpsRunner;
 ///
 /// The kfs client implementation object.
 ///
-class KfsClientImpl : private KfsNetClient::OpOwner
+class KfsClientImpl :
+    private KfsNetClient::OpOwner,
+    private CompressedFile::Io
 {
 public:
     typedef KfsClient::ErrorHandler ErrorHandler;
@@ -322,6 +398,10 @@ public:
     int ReaddirPlus(const char *pathname, vector<KfsFileAttr> &result,
         bool computeFilesize = true, bool updateClientCache = true,
         bool fileIdAndTypeOnly = false);
+    int ReaddirPlus(const vector<string>& pathnames,
+        vector<vector<KfsFileAttr> >& result, vector<int>& status,
+        bool computeFilesize = true, bool updateClientCache = true,
+        bool fileIdAndTypeOnly = false);
 
     ///
     /// Read a directory's contents and retrieve the attributes
@@ -347,6 +427,22 @@ public:
     int Stat(const char* pathname, KfsFileAttr& result, bool computeFilesize = true);
     int Stat(int fd, KfsFileAttr& result);
 
+    ///
+    /// Stat a list of files and get their attributes. The attributes that are
+    /// not in the client's attribute cache are retrieved from the meta server
+    /// in batched lookup requests, each request covers many files.
+    /// @param[in] pathnames The list of full pathnames
+    /// @param[out] result  The attributes, one per pathname
+    /// @param[out] status  The stat status, one per pathname: 0 if stat was
+    /// successful; -errno otherwise
+    /// @param[in] computeFilesize  When set, for files, the size of
+    /// file is computed and the value is returned in result.st_size
+    /// @retval 0 if all stats were successful; otherwise the first
+    /// negative entry status
+    ///
+    int Stat(const vector<string>& pathnames, vector<KfsFileAttr>& result,
+        vector<int>& status, bool computeFilesize = true);
+
     ///
     /// Return the # of chunks in the file specified by the fully qualified pathname.
     /// -1 if there is an error.
@@ -410,7 +506,18 @@ public:
     ///
     int Rename(const char *oldpath, const char *newpath, bool overwrite = true);
 
+    int Remove(const vector<string>& pathnames, vector<int>& status);
+    int Mkdir(const vector<string>& pathnames, vector<int>& status,
+        kfsMode_t mode = 0777);
+    int Rename(const vector<string>& oldpaths, const vector<string>& newpaths,
+        vector<int>& status, bool overwrite = true);
+
     int CoalesceBlocks(const char *srcPath, const char *dstPath, chunkOff_t *dstStartOffset);
+    int CopyFileChunks(const char* srcPath, const char* dstPath);
+    int PackFiles(const char* containerPath, const vector<string>& pathnames,
+        vector<int>& status);
+    int CompactPackedFiles(const char* dirname, const char* containerPath,
+        double minLiveRatio);
 
     ///
     /// Set the mtime for a path
@@ -459,6 +566,11 @@ public:
     int WriteAsync(int fd, const char *buf, size_t numBytes);
     int WriteAsyncCompletionHandler(int fd);
 
+    ssize_t ReadAsync(int fd, chunkOff_t pos, char *buf, size_t numBytes,
+        KfsClient::IoCompletion& completion);
+    ssize_t WriteAsync(int fd, chunkOff_t pos, const char *buf,
+        size_t numBytes, KfsClient::IoCompletion& completion);
+
     ///
     /// Read/write the desired # of bytes to the file, starting at the
     /// "current" position of the file.
@@ -470,7 +582,10 @@ public:
     /// @retval On success, return of bytes of I/O done (>= 0);
     /// on failure, return status code (< 0).
     ///
-    ssize_t Read(int fd, char *buf, size_t numBytes, chunkOff_t* pos = 0);
+    ssize_t Read(int fd, char *buf, size_t numBytes, chunkOff_t* pos = 0,
+        bool physicalFlag = false);
+    ssize_t ReadRanges(int fd, const chunkOff_t* offsets,
+        const size_t* lengths, int count, char* buf, size_t* readLengths);
     ssize_t Write(int fd, const char *buf, size_t numBytes, chunkOff_t* pos = 0);
 
     /// If there are any holes in a file, such as those at the end of
@@ -577,6 +692,9 @@ public:
     ssize_t SetReadAheadSize(int fd, size_t size);
     ssize_t GetReadAheadSize(int fd) const;
 
+    int SetDefaultCompression(int codec);
+    int GetDefaultCompression() const;
+
     /// A read for an offset that is after the specified value will result in EOF
     void SetEOFMark(int fd, chunkOff_t offset);
 
@@ -675,6 +793,63 @@ private:
         less<pair<kfsFileId_t, string> >,
         StdFastAllocator<pair<const pair<kfsFileId_t, string>, FAttr*> >
     > FidNameToFAttrMap;
+    // Negative lookup cache: (parent, name) to expiration time.
+    typedef map<
+        pair<kfsFileId_t, string>, time_t,
+        less<pair<kfsFileId_t, string> >,
+        StdFastAllocator<pair<const pair<kfsFileId_t, string>, time_t> >
+    > NegativeLookupCache;
+    struct AttrCacheStats
+    {
+        typedef int64_t Counter;
+
+        AttrCacheStats()
+            : mHitCount(0),
+              mMissCount(0),
+              mEvictCount(0),
+              mNegativeHitCount(0),
+              mNegativeInsertCount(0),
+              mNegativeInvalidateCount(0)
+            {}
+        template<typename T>
+        void Enumerate(
+            T& inFunctor) const
+        {
+            inFunctor("Hit",                mHitCount);
+            inFunctor("Miss",               mMissCount);
+            inFunctor("Evict",              mEvictCount);
+            inFunctor("NegativeHit",        mNegativeHitCount);
+            inFunctor("NegativeInsert",     mNegativeInsertCount);
+            inFunctor("NegativeInvalidate", mNegativeInvalidateCount);
+        }
+        Counter mHitCount;
+        Counter mMissCount;
+        Counter mEvictCount;
+        Counter mNegativeHitCount;
+        Counter mNegativeInsertCount;
+        Counter mNegativeInvalidateCount;
+    };
+    // Meta op latency histograms, in microseconds, by op type. The op name
+    // is the first token of the op Show() output.
+    struct MetaOpLatency
+    {
+        MetaOpLatency()
+            : name(),
+              histogram()
+            {}
+        string           name;
+        LatencyHistogram histogram;
+    };
+    typedef map<
+        KfsOp_t, MetaOpLatency,
+        less<KfsOp_t>,
+        StdFastAllocator<pair<const KfsOp_t, MetaOpLatency> >
+    > MetaOpLatencies;
+    typedef map<
+        const KfsOp*, int64_t,
+        less<const KfsOp*>,
+        StdFastAllocator<pair<const KfsOp* const, int64_t> >
+    > MetaOpStartTimes;
     class FAttr : public FileAttr
     {
     public:
@@ -765,6 +940,11 @@ private:
     NameToFAttrMap::iterator const mPathCacheNone;
     FAttrPool                      mFAttrPool;
     FAttr*                         mFAttrLru[1];
+    size_t                         mFAttrCacheMaxSize;
+    NegativeLookupCache            mNegativeLookupCache;
+    int                            mNegativeLookupCacheTime;
+    size_t                         mNegativeLookupCacheMaxSize;
+    AttrCacheStats                 mAttrCacheStats;
     FAttr**                        mDeleteClearFattr;
     FreeFileTableEntires           mFreeFileTableEntires;
     unsigned int                   mFattrCacheSkipValidateCnt;
@@ -779,10 +959,24 @@ private:
     const string                   mSlash;
     size_t                         mDefaultIoBufferSize;
     size_t                         mDefaultReadAheadSize;
+    bool                           mAdaptiveReadAheadFlag;
+    int                            mAdaptiveReadAheadMinSize;
+    int                            mAdaptiveReadAheadMaxSize;
+    int64_t                        mAdaptiveReadAheadMaxMemory;
+    int64_t                        mAdaptiveReadAheadMemory;
+    int64_t                        mWriteBehindMaxMemory;
+    int64_t                        mWriteBehindMemory;
     bool                           mFailShortReadsFlag;
+    int                            mDefaultCompression;
     unsigned int                   mFileInstance;
+    // The first protocol worker also runs the meta server ops.
     KfsProtocolWorker*             mProtocolWorker;
+    vector<KfsProtocolWorker*>     mProtocolWorkers;
     int                            mMaxNumRetriesPerOp;
+    int                            mMetaMaxPendingOps;
+    bool                           mLatencyStatsFlag;
+    MetaOpStartTimes               mMetaOpStartTimes;
+    MetaOpLatencies                mMetaOpLatencies;
     int                            mRetryDelaySec;
     int                            mDefaultOpTimeout;
     int                            mDefaultMetaOpTimeout;
@@ -876,6 +1070,11 @@ private:
     ssize_t SetOptimalReadAheadSize(FileTableEntry& entry, size_t size) {
         return SetReadAheadSize(entry, size, true);
     }
+    void InitAdaptiveReadAhead(FileTableEntry& entry);
+    void UpdateAdaptiveReadAhead(FileTableEntry& entry, chunkOff_t pos,
+        size_t size);
+    void ChargeAdaptiveReadAhead(FileTableEntry& entry, int size);
+    void SetWriteBehindPending(FileTableEntry& entry, int64_t pending);
 
     /// Lookup the attributes of a file given its parent file-id
     /// @param[in] parentFid  file-id of the parent directory
@@ -889,11 +1088,23 @@ private:
     int LookupAttr(kfsFileId_t parentFid, const string& filename,
         FAttr*& result, bool computeFilesize, const string& path,
         bool validSubCountsRequiredFlag = false);
+    /// Send the batched lookup, and update the attribute cache and the
+    /// results of the Stat() list version.
+    /// @param[in] index  the result position for each op entry
+    /// @param[in] paths  the file path of each op entry
+    int LookupBatch(LookupBatchOp& op, vector<size_t>& index,
+        vector<string>& paths, vector<KfsFileAttr>& result,
+        vector<int>& status, bool computeFilesize);
 
     FAttr* LookupFAttr(kfsFileId_t parentFid, const string& name);
     FAttr* LookupFAttr(const string& pathname, string* path);
     FAttr* NewFAttr(kfsFileId_t parentFid, const string& name,
         const string& pathname);
+    bool IsNegativeLookupCached(kfsFileId_t parentFid, const string& name,
+        time_t now);
+    void NegativeLookupCacheInsert(kfsFileId_t parentFid, const string& name,
+        time_t now);
+    void NegativeLookupCacheUpdate(const KfsOp& op);
 
    /// Given a chunk, find out which chunk-server is hosting it.  It
     /// is possible that no server is hosting the chunk---if there is
@@ -927,6 +1138,29 @@ private:
     /// dies in the middle, retry the op a few times before giving up.
     void DoMetaOpWithRetry(KfsOp *op);
     void ExecuteMeta(KfsOp& op);
+    // Pipelined meta ops execution. The entry op and its path name strings
+    // are owned by the caller.
+    struct MetaOpEntry
+    {
+        MetaOpEntry()
+            : parentFid(-1),
+              name(),
+              path(),
+              dstPath(),
+              op(0)
+            {}
+        kfsFileId_t parentFid;
+        string      name;
+        string      path;
+        string      dstPath;
+        KfsOp*      op;
+    };
+    typedef vector<MetaOpEntry> MetaOpEntries;
+    void ExecuteMetaPipelined(MetaOpEntries& entries);
+    bool StartMeta(KfsOp& op);
+    void WaitMeta(KfsOp& op);
+    void MetaOpStarted(const KfsOp& op);
+    void LogMetaOpDone(const KfsOp& op);
     void DoChunkServerOp(const ServerLocation& loc, KfsOp& op);
     void DoServerOp(KfsNetClient& server, const ServerLocation& loc, KfsOp& op);
 
@@ -968,6 +1202,10 @@ private:
         uint32_t *checksums, bool readVerifyFlag = true);
 
     int VerifyDataChecksumsFid(const FileAttr& attr);
+    int VerifyChunksChecksums(
+        vector<ChunkLayoutInfo>::const_iterator first,
+        vector<ChunkLayoutInfo>::const_iterator last,
+        ChunkServerOpsRunner&                   runner);
 
     int GetChunkFromReplica(
         const ChunkServerAccess& chunkServerAccess,
@@ -979,26 +1217,48 @@ private:
     int ReaddirPlus(const string& pathname, kfsFileId_t dirFid,
         vector<KfsFileAttr> &result,
         bool computeFilesize = true, bool updateClientCache = true,
-        bool fileIdAndTypeOnly = false);
+        bool fileIdAndTypeOnly = false, ReaddirPlusOp* firstPageOp = 0);
 
     int Rmdirs(const string &parentDir, kfsFileId_t parentFid, const string &dirname, kfsFileId_t dirFid);
     int Remove(const string &parentDir, kfsFileId_t parentFid, const string &entryName);
+    int PackFilesSelf(const char* containerPath,
+        const vector<string>& pathnames, const vector<KfsFileAttr>& attrs,
+        vector<int>& status);
 
     int ReadDirectory(int fd, char *buf, size_t bufSize);
     ssize_t Write(int fd, const char *buf, size_t numBytes,
-        bool asyncFlag, bool appendOnlyFlag, chunkOff_t* pos = 0);
+        bool asyncFlag, bool appendOnlyFlag, chunkOff_t* pos = 0,
+        bool physicalFlag = false);
+    ssize_t CompressedReadWrite(int fd, FileTableEntry& entry, char* buf,
+        size_t numBytes, chunkOff_t* pos, bool writeFlag,
+        QCStMutexLocker& lock);
+    int LoadCompressedFile(int fd, QCStMutexLocker& lock);
+    int StatCompressed(const char* pathname, KfsFileAttr& kfsattr);
+    virtual ssize_t ReadPhysical(int fd, char* buf, size_t numBytes,
+        chunkOff_t pos);
+    virtual ssize_t WritePhysical(int fd, const char* buf, size_t numBytes,
+        chunkOff_t pos);
     void InitPendingRead(FileTableEntry& entry);
     void CancelPendingRead(FileTableEntry& entry);
     void CleanupPendingRead();
     int RmdirsSelf(const string& path, const string& dirname,
         kfsFileId_t parentFid, kfsFileId_t dirFid, ErrorHandler& errHandler);
     void StartProtocolWorker();
+    // Files are sharded across the protocol workers by the file table entry
+    // instance, the writer and reader instances map to the same worker.
+    KfsProtocolWorker& GetProtocolWorker(unsigned int instance) const
+    {
+        return *mProtocolWorkers[
+            (size_t)(instance / 2) % mProtocolWorkers.size()];
+    }
     void InvalidateAllCachedAttrs();
     int GetUserAndGroup(const char* user, const char* group, kfsUid_t& uid, kfsGid_t& gid);
     template<typename T> int RecursivelyApply(
         string& path, const KfsFileAttr& attr, T& functor, bool fileIdAndTypeOnly = false);
     template<typename T> int RecursivelyApply(
         const char* pathname, T& functor, bool fileIdAndTypeOnly = false);
+    template<typename T> int ChangeSubTreeAttr(const char* pathname, T& op,
+        ErrorHandler& errHandler, bool& supportedFlag);
     const string& UidToName(kfsUid_t uid, time_t now);
     const string& GidToName(kfsUid_t uid, time_t now);
     kfsUid_t NameToUid(const string& name, time_t now);
@@ -1024,6 +1284,8 @@ private:
         time_t          now,
         bool            copyPathFlag = false);
     void UpdateUserAndGroup(const LookupOp& op, time_t now);
+    void UpdateUserAndGroup(const string& userName, const string& groupName,
+        const FileAttr& fattr, time_t now);
     void DoNotUseOsUserAndGroup();
     void UpdateUserId(const string& userName, kfsUid_t uid, time_t now);
     void UpdateGroupId(const string& groupName, kfsGid_t gid, time_t now);
@@ -1071,7 +1333,8 @@ private:
         const ChunkServerAccess& inChunkServerAccess,
         const ServerLocation&    inLocation,
         kfsChunkId_t             inChunkId,
-        string&                  outChunkAccess);
+        string&                  outChunkAccess,
+        KfsNetClient*            inServerPtr = 0);
     int GetChunkAccess(
         const ServerLocation& inLocation,
         kfsChunkId_t          inChunkId,
@@ -31,6 +31,7 @@
 #include "kfsio/ITimeout.h"
 #include "kfsio/ClientAuthContext.h"
 #include "kfsio/DelegationToken.h"
+#include "kfsio/ZlibInflate.h"
 #include "common/kfstypes.h"
 #include "common/kfsdecls.h"
 #include "common/MsgLogger.h"
@@ -437,6 +438,8 @@ public:
         { mTimeSecBetweenRetries = inTimeSec; }
     bool IsAllDataSent() const
         { return (mDataSentFlag && mAllDataSentFlag); }
+    size_t GetPendingOpsCount() const
+        { return mPendingOpQueue.size(); }
     bool IsDataReceived() const
         { return mDataReceivedFlag; }
     bool IsDataSent() const
@@ -1154,6 +1157,9 @@ private:
             IOBuffer* const theBufPtr = mInFlightOpPtr->mBufferPtr;
             mInFlightOpPtr = 0;
             theOp.ParseResponseHeader(mProperties);
+            const bool theDeflateFlag = 0 < mContentLength &&
+                mProperties.getValue("Content-encoding", string()) ==
+                    "deflate";
             mProperties.clear();
             if (mContentLength > 0) {
                 mStats.mBytesReceivedCount +=
@@ -1178,6 +1184,9 @@ private:
                             mInFlightRecvBufPtr, mContentLength);
                         mInFlightRecvBufPtr = 0;
                     }
+                    if (theDeflateFlag) {
+                        InflateContent(theOp);
+                    }
                 }
                 mContentLength = 0;
             }
@@ -1185,6 +1194,92 @@ private:
             HandleOp(mCurOpIt);
         }
     }
+    class InflateOutput : public ZlibInflate::Output
+    {
+    public:
+        InflateOutput(
+            int inMaxSize)
+            : ZlibInflate::Output(),
+              mBufPtr(0),
+              mSize(0),
+              mCapacity(0),
+              mMaxSize(size_t(max(0, inMaxSize)))
+            {}
+        virtual ~InflateOutput()
+            { delete [] mBufPtr; }
+        virtual int GetBuffer(
+            char*&  outBufferPtr,
+            size_t& outBufferSize)
+        {
+            if (mCapacity <= mSize) {
+                if (mMaxSize <= mSize) {
+                    return -EFBIG;
+                }
+                const size_t theCapacity = min(mMaxSize,
+                    max(size_t(64) << 10, mCapacity * 2));
+                char* const  thePtr      = new char[theCapacity + 1];
+                memcpy(thePtr, mBufPtr, mSize);
+                delete [] mBufPtr;
+                mBufPtr   = thePtr;
+                mCapacity = theCapacity;
+            }
+            outBufferPtr  = mBufPtr + mSize;
+            outBufferSize = mCapacity - mSize;
+            return 0;
+        }
+        virtual int Write(
+            const char* /* inBufferPtr */,
+            size_t      inBufferSize)
+        {
+            mSize += inBufferSize;
+            return 0;
+        }
+        char* Release(
+            size_t& outSize)
+        {
+            char* const theRetPtr = mBufPtr;
+            if (theRetPtr) {
+                theRetPtr[mSize] = 0;
+            }
+            outSize = mSize;
+            mBufPtr = 0;
+            mSize   = 0;
+            return theRetPtr;
+        }
+    private:
+        char*        mBufPtr;
+        size_t       mSize;
+        size_t       mCapacity;
+        const size_t mMaxSize;
+    };
+    void InflateContent(
+        KfsOp& inOp)
+    {
+        if (inOp.status < 0 || inOp.contentLength <= 0 || ! inOp.contentBuf) {
+            return;
+        }
+        ZlibInflate   theInflate;
+        InflateOutput theOutput(mMaxContentLength);
+        bool          theDoneFlag = false;
+        const int     theStatus   = theInflate.Run(
+            inOp.contentBuf, inOp.contentLength, theOutput, theDoneFlag);
+        if (theStatus != 0 || ! theDoneFlag) {
+            KFS_LOG_STREAM_ERROR << mLogPrefix <<
+                "error: " << mServerLocation <<
+                " seq: "  << inOp.seq <<
+                " content inflate failure: " <<
+                (theStatus != 0 ? theInflate.StrError(theStatus) :
+                    "truncated content") <<
+            KFS_LOG_EOM;
+            inOp.status    = -EIO;
+            inOp.statusMsg = "response content inflate failure";
+            return;
+        }
+        size_t      theSize = 0;
+        char* const thePtr  = theOutput.Release(theSize);
+        inOp.AttachContentBuf(thePtr, theSize);
+        inOp.contentLength = theSize;
+    }
     bool ReadHeader(
         IOBuffer& inBuffer)
     {
@@ -2025,6 +2120,12 @@ KfsNetClient::IsAllDataSent() const
     return mImpl.IsAllDataSent();
 }
 
+    size_t
+KfsNetClient::GetPendingOpsCount() const
+{
+    return mImpl.GetPendingOpsCount();
+}
+
     bool
 KfsNetClient::IsDataReceived() const
 {
@@ -225,6 +225,7 @@ public:
     void SetTimeSecBetweenRetries(
         int inTimeSec);
     bool IsAllDataSent() const;
+    size_t GetPendingOpsCount() const;
     bool IsDataReceived() const;
     bool IsDataSent() const;
     bool IsRetryConnectOnly() const;
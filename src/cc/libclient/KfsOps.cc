@@ -209,6 +209,9 @@ CreateOp::Request(ostream &os)
             "Min-tier: " << (int)minSTier << "\r\n"
             "Max-tier: " << (int)maxSTier << "\r\n";
     }
+    if (compression != KFS_COMPRESSION_NONE) {
+        os << "Compression: " << compression << "\r\n";
+    }
     os << "\r\n";
 }
 
@@ -235,7 +238,11 @@ RmdirOp::Request(ostream &os)
         "Parent File-handle: " << parentFid         << "\r\n"
         "Pathname: "           << pathname          << "\r\n"
         "Directory: "          << dirname           << "\r\n"
-    "\r\n";
+    ;
+    if (recursiveFlag) {
+        os << "Recursive: 1\r\n";
+    }
+    os << "\r\n";
 }
 
 void
@@ -318,7 +325,9 @@ ReaddirPlusOp::Request(ostream &os)
     if (! fnameStart.empty()) {
         os << "Fname-start: " << fnameStart << "\r\n";
     }
-    os << "\r\n";
+    // The response content is inflated by KfsNetClient.
+    os << "Accept-encoding: deflate\r\n"
+    "\r\n";
 }
 
 void
@@ -359,6 +368,23 @@ LookupPathOp::Request(ostream &os)
     "\r\n";
 }
 
+void
+LookupBatchOp::Request(ostream &os)
+{
+    os <<
+        "LOOKUP_BATCH\r\n" << ReqHeaders(*this) <<
+        "Num-entries: "   << entries.size()   << "\r\n"
+        "Entries:"
+    ;
+    for (Entries::const_iterator it = entries.begin();
+            it != entries.end();
+            ++it) {
+        os << " " << it->parentFid << " " << it->name.size() << " " <<
+            it->name;
+    }
+    os << "\r\n\r\n";
+}
+
 void
 GetAllocOp::Request(ostream &os)
 {
@@ -395,6 +421,9 @@ GetLayoutOp::Request(ostream &os)
     if (continueIfNoReplicasFlag) {
         os << "Continue-if-no-replicas: 1\r\n";
     }
+    if (orderReplicasFlag) {
+        os << "Order-replicas: 1\r\n";
+    }
     if (maxChunks > 0) {
         os << "Max-chunks : " << maxChunks << "\r\n";
     }
@@ -411,6 +440,31 @@ CoalesceBlocksOp::Request(ostream &os)
     "\r\n";
 }
 
+void
+PackFileOp::Request(ostream &os)
+{
+    os <<
+        "PACK_FILE\r\n"      << ReqHeaders(*this) <<
+        "File-handle: "        << fid               << "\r\n"
+        "Container-handle: "   << containerFid      << "\r\n"
+        "Container-offset: "   << containerOffset   << "\r\n"
+        "File-size: "          << fileSize          << "\r\n"
+        "Expected-container: " << expectedContainer << "\r\n"
+    "\r\n";
+}
+
+void
+CopyChunkOp::Request(ostream &os)
+{
+    os <<
+        "COPY_CHUNK\r\n"       << ReqHeaders(*this) <<
+        "Source-file-handle: " << srcFid    << "\r\n"
+        "Source-offset: "      << srcOffset << "\r\n"
+        "File-handle: "        << fid       << "\r\n"
+        "Chunk-offset: "       << offset    << "\r\n"
+    "\r\n";
+}
+
 void
 GetChunkMetadataOp::Request(ostream &os)
 {
@@ -418,7 +472,11 @@ GetChunkMetadataOp::Request(ostream &os)
         "GET_CHUNK_METADATA\r\n" << ReqHeaders(*this)        <<
         "Chunk-handle: "         << chunkId                  << "\r\n"
         "Read-verify: "          << (readVerifyFlag ? 1 : 0) << "\r\n"
-        << Access() <<
+    ;
+    if (shortCircuitFlag) {
+        os << "Short-circuit: 1\r\n";
+    }
+    os << Access() <<
     "\r\n";
 }
 
@@ -521,6 +579,17 @@ ReadOp::Request(ostream &os)
     if (skipVerifyDiskChecksumFlag) {
         os << "Skip-Disk-Chksum: 1\r\n";
     }
+    if (replicationReadFlag) {
+        os << "Replication-read: 1\r\n";
+    }
+    if (1 < ranges.size()) {
+        os << "Range-count: " << ranges.size() / 2 << "\r\n"
+            "Ranges:";
+        for (size_t i = 0; i + 1 < ranges.size(); i += 2) {
+            os << ' ' << ranges[i] << ' ' << ranges[i + 1];
+        }
+        os << "\r\n";
+    }
     os << "\r\n";
 }
 
@@ -606,13 +675,20 @@ WritePrepareOp::Request(ostream &os)
     if (replyRequestedFlag) {
         os << "Reply: 1\r\n";
     }
+    // With the write id allocation the chunk servers allocate and return the
+    // write ids, the servers list has no write ids.
+    if (allocWriteIdFlag) {
+        os << "Alloc-write-id: 1\r\n";
+    }
     os <<
         "Num-servers: " << writeInfo.size() << "\r\n"
         "Servers:"
     ;
     for (vector<WriteInfo>::size_type i = 0; i < writeInfo.size(); ++i) {
-        os << writeInfo[i].serverLoc <<
-            ' ' << writeInfo[i].writeId << ' ';
+        os << writeInfo[i].serverLoc << ' ';
+        if (! allocWriteIdFlag) {
+            os << writeInfo[i].writeId << ' ';
+        }
     }
     os << "\r\n\r\n";
 }
@@ -726,6 +802,22 @@ LeaseRenewOp::Request(ostream &os)
     os << "\r\n";
 }
 
+void
+LeaseRenewBatchOp::Request(ostream &os)
+{
+    os <<
+        "LEASE_RENEW_BATCH\r\n" << ReqHeaders(*this) <<
+        "Num-entries: "        << entries.size()   << "\r\n"
+        "Entries:"
+    ;
+    for (Entries::const_iterator it = entries.begin();
+            it != entries.end();
+            ++it) {
+        os << " " << it->chunkId << " " << it->leaseId << " " << it->chunkPos;
+    }
+    os << "\r\n\r\n";
+}
+
 void
 LeaseRelinquishOp::Request(ostream &os)
 {
@@ -899,6 +991,8 @@ CreateOp::ParseResponseHeaderSelf(const Properties &prop)
         groupName         = prop.getValue("GName",    string());
         minSTier          = prop.getValue("Min-tier", minSTier);
         maxSTier          = prop.getValue("Max-tier", maxSTier);
+        metaCompression   = prop.getValue("Compression",
+            int(KFS_COMPRESSION_NONE));
     }
 }
 
@@ -959,6 +1053,11 @@ ParseFileAttribute(const Properties &prop,
         fattr.subCount2 = prop.getValue("Dir-count",  int64_t(-1));
     } else {
         fattr.subCount1 = prop.getValue("Chunk-count", int64_t(0));
+        fattr.packedContainer =
+            prop.getValue("Packed-container", kfsFileId_t(-1));
+        fattr.packedOffset    = prop.getValue("Packed-offset", chunkOff_t(-1));
+        fattr.compression     = (int16_t)prop.getValue(
+            "Compression", int(KFS_COMPRESSION_NONE));
     }
     fattr.fileSize    =          prop.getValue("File-size",   chunkOff_t(-1));
     fattr.numReplicas = (int16_t)prop.getValue("Replication", 1);
@@ -998,6 +1097,57 @@ LookupOp::ParseResponseHeaderSelf(const Properties &prop)
     ParseFileAttribute(prop, fattr, userName, groupName);
 }
 
+void
+LookupBatchOp::ParseResponseHeaderSelf(const Properties &prop)
+{
+    euser      = prop.getValue("EUserId",     euser);
+    egroup     = prop.getValue("EGroupId",    kKfsGroupNone);
+    numEntries = prop.getValue("Num-entries", 0);
+}
+
+///
+/// Parse the entries attributes in the response content. Each entry is
+/// terminated by the empty line, and has the same headers as lookup response.
+///
+int
+LookupBatchOp::ParseEntries()
+{
+    if (status < 0) {
+        return status;
+    }
+    if (numEntries != (int)entries.size() ||
+            (0 < numEntries && ! contentBuf)) {
+        return -EINVAL;
+    }
+    const char*       ptr = contentBuf;
+    const char* const end = ptr + contentLength;
+    const char        separator = ':';
+    Properties        prop;
+    for (Entries::iterator it = entries.begin(); it != entries.end(); ++it) {
+        const char* next = ptr;
+        while (next + 3 < end &&
+                (next[0] != '\r' || next[1] != '\n' ||
+                next[2] != '\r' || next[3] != '\n')) {
+            next++;
+        }
+        if (end <= next + 3) {
+            return -EINVAL;
+        }
+        prop.clear();
+        if (prop.loadProperties(ptr, next + 2 - ptr, separator) != 0) {
+            return -EINVAL;
+        }
+        it->status = prop.getValue("Status", -1);
+        if (it->status < 0) {
+            it->status = -KfsToSysErrno(-it->status);
+        } else {
+            ParseFileAttribute(prop, it->fattr, it->userName, it->groupName);
+        }
+        ptr = next + 4;
+    }
+    return 0;
+}
+
 void
 LookupPathOp::ParseResponseHeaderSelf(const Properties &prop)
 {
@@ -1157,18 +1307,37 @@ ChunkAccessOp::ParseResponseHeaderSelf(const Properties& prop)
     );
 }
 
+void
+GetChunkMetadataOp::ParseResponseHeaderSelf(const Properties& prop)
+{
+    ChunkAccessOp::ParseResponseHeaderSelf(prop);
+    chunkVersion         = prop.getValue("Chunk-version",      chunkVersion);
+    shortCircuitId       = prop.getValue("Short-circuit-id",     int64_t(-1));
+    shortCircuitSocket   = prop.getValue("Short-circuit-socket", string());
+    shortCircuitLeaseSec = prop.getValue("Short-circuit-lease",  0);
+    shortCircuitOffset   = prop.getValue("Short-circuit-offset", int64_t(0));
+}
+
 void
 CoalesceBlocksOp::ParseResponseHeaderSelf(const Properties &prop)
 {
     dstStartOffset = prop.getValue("Dst-start-offset", (chunkOff_t) 0);
 }
 
+void
+CopyChunkOp::ParseResponseHeaderSelf(const Properties &prop)
+{
+    chunkId      = prop.getValue("Chunk-handle",  kfsChunkId_t(-1));
+    chunkVersion = prop.getValue("Chunk-version", int64_t(-1));
+}
+
 void
 GetLayoutOp::ParseResponseHeaderSelf(const Properties &prop)
 {
-    numChunks         = prop.getValue("Num-chunks", 0);
-    hasMoreChunksFlag = prop.getValue("Has-more-chunks", 0) != 0;
-    fileSize          = prop.getValue("File-size", chunkOff_t(-1));
+    numChunks          = prop.getValue("Num-chunks", 0);
+    hasMoreChunksFlag  = prop.getValue("Has-more-chunks", 0) != 0;
+    serversOrderedFlag = prop.getValue("Replicas-ordered", 0) != 0;
+    fileSize           = prop.getValue("File-size", chunkOff_t(-1));
 }
 
 int
@@ -1239,6 +1408,19 @@ ReadOp::ParseResponseHeaderSelf(const Properties &prop)
         ist >> cksum;
         checksums.push_back(cksum);
     }
+    rangeLengths.clear();
+    const int rangeCount = prop.getValue("Range-count", 0);
+    if (rangeCount <= 0) {
+        return;
+    }
+    istringstream isl(prop.getValue("Range-lengths", string()));
+    for (int i = 0; i < rangeCount; i++) {
+        chunkOff_t len = -1;
+        if (! (isl >> len)) {
+            break;
+        }
+        rangeLengths.push_back(len);
+    }
 }
 
 void
@@ -1249,6 +1431,15 @@ WriteIdAllocOp::ParseResponseHeaderSelf(const Properties& prop)
     writePrepReplySupportedFlag = prop.getValue("Write-prepare-reply", 0) != 0;
 }
 
+void
+WritePrepareOp::ParseResponseHeaderSelf(const Properties& prop)
+{
+    ChunkAccessOp::ParseResponseHeaderSelf(prop);
+    if (allocWriteIdFlag) {
+        writeIdStr = prop.getValue("Write-id", string());
+    }
+}
+
 void
 LeaseAcquireOp::ParseResponseHeaderSelf(const Properties& prop)
 {
@@ -1292,6 +1483,31 @@ LeaseRenewOp::ParseResponseHeaderSelf(const Properties& prop)
     allowCSClearTextFlag          = prop.getValue("CS-clear-text", 0) != 0;
 }
 
+void
+LeaseRenewBatchOp::ParseResponseHeaderSelf(const Properties& prop)
+{
+    if (status < 0) {
+        return;
+    }
+    const Properties::String* const str = prop.getValue("Entries-status");
+    const char*                     ptr = str ? str->GetPtr() : 0;
+    const char* const               end = ptr + (str ? str->GetSize() : 0);
+    for (Entries::iterator it = entries.begin(); it != entries.end(); ++it) {
+        int entryStatus = 0;
+        if (! DecIntParser::Parse(ptr, end - ptr, entryStatus)) {
+            status    = -EINVAL;
+            statusMsg = "invalid entries status";
+            return;
+        }
+        it->status = entryStatus < 0 ?
+            -KfsToSysErrno(-entryStatus) : entryStatus;
+    }
+    if (prop.getValue("Num-entries", -1) != (int)entries.size()) {
+        status    = -EINVAL;
+        statusMsg = "invalid number of entries";
+    }
+}
+
 void
 ChangeFileReplicationOp::ParseResponseHeaderSelf(const Properties &prop)
 {
@@ -1341,8 +1557,25 @@ ChmodOp::Request(ostream &os)
         "CHMOD\r\n" << ReqHeaders(*this) <<
         "File-handle: " << fid << "\r\n"
         "Mode: "        << mode << "\r\n"
-        "\r\n";
     ;
+    if (recursiveFlag) {
+        os << "Recursive: 1\r\n";
+        if (! cursor.empty()) {
+            os << "Cursor: " << cursor << "\r\n";
+        }
+    }
+    os << "\r\n";
+}
+
+void
+ChmodOp::ParseResponseHeaderSelf(const Properties& prop)
+{
+    if (0 <= status && recursiveFlag) {
+        count             = prop.getValue("Count",          int64_t(0));
+        failedCount       = prop.getValue("Failed-count",   int64_t(0));
+        recursiveDoneFlag = prop.getValue("Recursive-done", -1);
+        cursor            = prop.getValue("Cursor",         string());
+    }
 }
 
 void
@@ -1363,6 +1596,12 @@ ChownOp::Request(ostream &os)
     if (! groupName.empty()) {
         os << "GName: " << groupName << "\r\n";
     }
+    if (recursiveFlag) {
+        os << "Recursive: 1\r\n";
+        if (! cursor.empty()) {
+            os << "Cursor: " << cursor << "\r\n";
+        }
+    }
     os << "\r\n";
 }
 
@@ -1374,6 +1613,12 @@ ChownOp::ParseResponseHeaderSelf(const Properties& prop)
         group     = prop.getValue("Group", group);
         userName  = prop.getValue("UName", userName);
         groupName = prop.getValue("GName", groupName);
+        if (recursiveFlag) {
+            count             = prop.getValue("Count",          int64_t(0));
+            failedCount       = prop.getValue("Failed-count",   int64_t(0));
+            recursiveDoneFlag = prop.getValue("Recursive-done", -1);
+            cursor            = prop.getValue("Cursor",         string());
+        }
     }
 }
 
@@ -1462,6 +1707,15 @@ MetaPingOp::Request(ostream& os)
     ;
 }
 
+void
+NoopOp::Request(ostream& os)
+{
+    os <<
+    "NOOP\r\n" << ReqHeaders(*this) <<
+    "\r\n"
+    ;
+}
+
 void
 MetaToggleWORMOp::Request(ostream& os)
 {
@@ -1534,34 +1788,68 @@ ChunkPingOp::ParseResponseHeaderSelf(const Properties& prop)
     usedSpace         = prop.getValue("Used-space",       int64_t(0));
 }
 
+static void
+StatsRequest(ostream& os, int64_t deltaId, int64_t deltaGen)
+{
+    if (deltaId != 0) {
+        os <<
+        "Delta-id: "  << deltaId  << "\r\n"
+        "Delta-gen: " << deltaGen << "\r\n"
+        ;
+    }
+    os << "\r\n";
+}
+
+// The server without delta support, or on generation mismatch returns full
+// stats, otherwise merge the changed stats into the previous stats. Removed
+// stats are sent with empty value.
+static void
+ParseStatsResponse(const Properties& prop, Properties& stats,
+    int64_t deltaId, int64_t& deltaGen, bool& deltaFullFlag)
+{
+    deltaGen      = deltaId != 0 ? prop.getValue("Delta-gen", int64_t(0)) : 0;
+    deltaFullFlag = deltaGen <= 0 || prop.getValue("Delta-full", 1) != 0;
+    if (deltaFullFlag) {
+        stats = prop;
+        return;
+    }
+    for (Properties::iterator it = prop.begin(); it != prop.end(); ++it) {
+        if (it->second.empty()) {
+            stats.remove(it->first);
+        } else {
+            stats.setValue(it->first, it->second);
+        }
+    }
+}
+
 void
 MetaStatsOp::Request(ostream& os)
 {
     os <<
-    "STATS\r\n" << ReqHeaders(*this) <<
-    "\r\n"
+    "STATS\r\n" << ReqHeaders(*this)
     ;
+    StatsRequest(os, deltaId, deltaGen);
 }
 
 void
 ChunkStatsOp::Request(ostream& os)
 {
     os <<
-    "STATS\r\n" << ReqHeaders(*this) <<
-    "\r\n"
+    "STATS\r\n" << ReqHeaders(*this)
     ;
+    StatsRequest(os, deltaId, deltaGen);
 }
 
 void
 MetaStatsOp::ParseResponseHeaderSelf(const Properties& prop)
 {
-    stats = prop;
+    ParseStatsResponse(prop, stats, deltaId, deltaGen, deltaFullFlag);
 }
 
 void
 ChunkStatsOp::ParseResponseHeaderSelf(const Properties& prop)
 {
-    stats = prop;
+    ParseStatsResponse(prop, stats, deltaId, deltaGen, deltaFullFlag);
 }
 
 void
@@ -65,6 +65,7 @@ enum KfsOp_t {
     CMD_ALLOCATE,
     CMD_TRUNCATE,
     CMD_LOOKUP,
+    CMD_LOOKUP_BATCH,
     CMD_MKDIR,
     CMD_RMDIR,
     CMD_READDIR,
@@ -76,6 +77,7 @@ enum KfsOp_t {
     CMD_SETMTIME,
     CMD_LEASE_ACQUIRE,
     CMD_LEASE_RENEW,
+    CMD_LEASE_RENEW_BATCH,
     CMD_LEASE_RELINQUISH,
     CMD_COALESCE_BLOCKS,
     CMD_CHUNK_SPACE_RESERVE,
@@ -83,6 +85,8 @@ enum KfsOp_t {
     CMD_RECORD_APPEND,
     CMD_GET_RECORD_APPEND_STATUS,
     CMD_CHANGE_FILE_REPLICATION,
+    CMD_PACK_FILE,
+    CMD_COPY_CHUNK,
     // Chunkserver RPCs
     CMD_CLOSE,
     CMD_READ,
@@ -120,6 +124,8 @@ enum KfsOp_t {
     CMD_META_FORCE_REPLICATION,
     CMD_META_DUMP_CHUNKTOSERVERMAP,
     CMD_META_UPSERVERS,
+    CMD_META_HEAP_PROFILE,
+    CMD_NOOP,
 
     CMD_NCMDS
 };
@@ -268,6 +274,8 @@ struct CreateOp : public KfsOp {
     kfsSeq_t    reqId;
     kfsSTier_t  minSTier;
     kfsSTier_t  maxSTier;
+    int         compression;
+    int         metaCompression;
     string      userName;
     string      groupName;
     CreateOp(kfsSeq_t s,
@@ -294,6 +302,8 @@ struct CreateOp : public KfsOp {
           reqId(id),
           minSTier(minTier),
           maxSTier(maxTier),
+          compression(KFS_COMPRESSION_NONE),
+          metaCompression(KFS_COMPRESSION_NONE),
           userName(),
           groupName()
         {}
@@ -354,8 +364,11 @@ struct RmdirOp : public KfsOp {
     kfsFileId_t parentFid; // input parent file-id
     const char* dirname;
     const char* pathname; // input: full pathname
-    RmdirOp(kfsSeq_t s, kfsFileId_t p, const char* d, const char* pn)
-        : KfsOp(CMD_RMDIR, s), parentFid(p), dirname(d), pathname(pn)
+    bool        recursiveFlag; // input: remove directory content
+    RmdirOp(kfsSeq_t s, kfsFileId_t p, const char* d, const char* pn,
+            bool r = false)
+        : KfsOp(CMD_RMDIR, s), parentFid(p), dirname(d), pathname(pn),
+          recursiveFlag(r)
         {}
     void Request(ostream& os);
     // default parsing of OK/Cseq/Status/Content-length will suffice.
@@ -567,6 +580,65 @@ struct LookupPathOp : public KfsOp {
     }
 };
 
+// Lookup the attributes of a list of files in one request. The entry with
+// negative parent fid is looked up by the path relative to the root dir.
+struct LookupBatchOp : public KfsOp {
+    struct Entry
+    {
+        kfsFileId_t parentFid;
+        string      name;
+        int         status;    // result
+        FileAttr    fattr;     // result
+        string      userName;  // result
+        string      groupName; // result
+        Entry(kfsFileId_t p = -1, const string& n = string())
+            : parentFid(p),
+              name(n),
+              status(0),
+              fattr(),
+              userName(),
+              groupName()
+            {}
+    };
+    typedef vector<Entry> Entries;
+
+    Entries  entries;
+    kfsUid_t euser;  // result -- effective user set by the meta server
+    kfsGid_t egroup; // result -- effective group set by the meta server
+    int      numEntries; // result
+    LookupBatchOp(kfsSeq_t s,
+        kfsUid_t eu = kKfsUserNone, kfsGid_t eg = kKfsGroupNone)
+        : KfsOp(CMD_LOOKUP_BATCH, s),
+          entries(),
+          euser(eu),
+          egroup(eg),
+          numEntries(0)
+        {}
+    void Request(ostream& os);
+    virtual void ParseResponseHeaderSelf(const Properties& prop);
+    int ParseEntries();
+    // Returns true if the name can be sent in the batch request. The names
+    // with line breaks, or trailing white space cannot be sent in the request
+    // header, and must be looked up individually.
+    static bool IsValidName(const string& name)
+    {
+        return (! name.empty() &&
+            (name[name.size() - 1] & 0xFF) > ' ' &&
+            name.find_first_of("\r\n") == string::npos);
+    }
+    // Request header size estimate.
+    static size_t GetEntrySize(const string& name)
+        { return (name.size() + 32); }
+    virtual ostream& ShowSelf(ostream& os) const {
+        os << "lookup_batch: entries: " << entries.size();
+        if (! entries.empty()) {
+            os << " first: " << entries.front().name <<
+                " parent: " << entries.front().parentFid;
+        }
+        return os;
+    }
+};
+
 /// Coalesce blocks from src->dst by appending the blocks of src to
 /// dst.  If the op is successful, src will end up with 0 blocks.
 struct CoalesceBlocksOp: public KfsOp {
@@ -584,6 +656,68 @@ struct CoalesceBlocksOp: public KfsOp {
     }
 };
 
+/// Convert small file into packed file stored as extent of the pack container
+/// file. The file data must be copied into the container prior to the request.
+/// Non negative expectedContainer moves packed file into another container.
+struct PackFileOp: public KfsOp {
+    kfsFileId_t fid;               // input
+    kfsFileId_t containerFid;      // input
+    chunkOff_t  containerOffset;   // input
+    chunkOff_t  fileSize;          // input
+    kfsFileId_t expectedContainer; // input
+    PackFileOp(kfsSeq_t s, kfsFileId_t f, kfsFileId_t c, chunkOff_t o,
+            chunkOff_t sz, kfsFileId_t e)
+        : KfsOp(CMD_PACK_FILE, s),
+          fid(f),
+          containerFid(c),
+          containerOffset(o),
+          fileSize(sz),
+          expectedContainer(e)
+        {}
+    void Request(ostream& os);
+    virtual ostream& ShowSelf(ostream& os) const {
+        os << "pack file: fid: " << fid <<
+            " container: " << containerFid <<
+            " offset: "    << containerOffset <<
+            " size: "      << fileSize <<
+            " expected: "  << expectedContainer;
+        return os;
+    }
+};
+
+/// Copy the source file chunk into a new destination file chunk. The chunk
+/// servers copy the chunk data. Chunk id is -1 if the source file has no chunk
+/// at the source offset.
+struct CopyChunkOp: public KfsOp {
+    kfsFileId_t  srcFid;       // input
+    chunkOff_t   srcOffset;    // input
+    kfsFileId_t  fid;          // input
+    chunkOff_t   offset;       // input
+    kfsChunkId_t chunkId;      // output
+    int64_t      chunkVersion; // output
+    CopyChunkOp(kfsSeq_t s, kfsFileId_t sf, chunkOff_t so,
+            kfsFileId_t f, chunkOff_t o)
+        : KfsOp(CMD_COPY_CHUNK, s),
+          srcFid(sf),
+          srcOffset(so),
+          fid(f),
+          offset(o),
+          chunkId(-1),
+          chunkVersion(-1)
+        {}
+    void Request(ostream& os);
+    virtual void ParseResponseHeaderSelf(const Properties& prop);
+    virtual ostream& ShowSelf(ostream& os) const {
+        os << "copy chunk: src: " << srcFid <<
+            " offset: "  << srcOffset <<
+            " dst: "     << fid <<
+            " offset: "  << offset <<
+            " chunk: "   << chunkId <<
+            " version: " << chunkVersion;
+        return os;
+    }
+};
+
 /// Get the allocation information for a chunk in a file.
 struct GetAllocOp: public KfsOp {
     kfsFileId_t            fid;
@@ -654,9 +788,11 @@ struct GetLayoutOp: public KfsOp {
     bool                    omitLocationsFlag;
     bool                    lastChunkOnlyFlag;
     bool                    continueIfNoReplicasFlag;
+    bool                    orderReplicasFlag;
     int                     numChunks;
     int                     maxChunks;
     bool                    hasMoreChunksFlag;
+    bool                    serversOrderedFlag; // result: same as getalloc
     chunkOff_t              fileSize;
     vector<ChunkLayoutInfo> chunks;
     GetLayoutOp(kfsSeq_t s, kfsFileId_t f)
@@ -666,9 +802,11 @@ struct GetLayoutOp: public KfsOp {
           omitLocationsFlag(false),
           lastChunkOnlyFlag(false),
           continueIfNoReplicasFlag(false),
+          orderReplicasFlag(false),
           numChunks(0),
           maxChunks(-1),
           hasMoreChunksFlag(false),
+          serversOrderedFlag(false),
           fileSize(-1),
           chunks()
         {}
@@ -869,12 +1007,24 @@ operator<<(ostream& os, const ChunkAccessOp::AccessReq& req)
 
 // Get the chunk metadata (aka checksums) stored on the chunkservers
 struct GetChunkMetadataOp: public ChunkAccessOp {
-    bool readVerifyFlag;
+    bool    readVerifyFlag;
+    // Request chunk file descriptor grant for short circuit local read.
+    bool    shortCircuitFlag;
+    int64_t shortCircuitId;       // result: grant id, or -1
+    string  shortCircuitSocket;   // result: unix domain socket path
+    int     shortCircuitLeaseSec; // result
+    int64_t shortCircuitOffset;   // result: chunk data offset in the file
     GetChunkMetadataOp(kfsSeq_t s, kfsChunkId_t c, bool verifyFlag)
         : ChunkAccessOp(CMD_GET_CHUNK_METADATA, s, c),
-          readVerifyFlag(verifyFlag)
+          readVerifyFlag(verifyFlag),
+          shortCircuitFlag(false),
+          shortCircuitId(-1),
+          shortCircuitSocket(),
+          shortCircuitLeaseSec(0),
+          shortCircuitOffset(0)
         {}
     void Request(ostream& os);
+    virtual void ParseResponseHeaderSelf(const Properties& prop);
     virtual ostream& ShowSelf(ostream& os) const {
         os << "get chunk metadata:"
             " chunkId: " << chunkId <<
@@ -1068,18 +1218,26 @@ struct ReadOp : public ChunkAccessOp {
     chunkOff_t       offset;       /* input */
     size_t           numBytes;     /* input */
     bool             skipVerifyDiskChecksumFlag;
+    bool             replicationReadFlag; /* chunk server recovery read */
     struct timeval   submitTime;   /* when the client sent the request to the server */
     vector<uint32_t> checksums;    /* checksum for each 64KB block */
     float            diskIOTime;   /* as reported by the server */
     float            elapsedTime ; /* as measured by the client */
+    /* input: multi range read chunk offset and length pairs, with the
+     * ranges the reply has one checksum per range */
+    vector<chunkOff_t> ranges;
+    vector<chunkOff_t> rangeLengths; /* output: length read for each range */
 
     ReadOp(kfsSeq_t s, kfsChunkId_t c, int64_t v)
         : ChunkAccessOp(CMD_READ, s, c),
           offset(0),
           numBytes(0),
           skipVerifyDiskChecksumFlag(false),
+          replicationReadFlag(false),
           diskIOTime(0.0),
-          elapsedTime(0.0)
+          elapsedTime(0.0),
+          ranges(),
+          rangeLengths()
         { chunkVersion = v; }
     void Request(ostream& os);
     virtual void ParseResponseHeaderSelf(const Properties& prop);
@@ -1089,6 +1247,7 @@ struct ReadOp : public ChunkAccessOp {
             " version: "  << chunkVersion <<
             " offset: "   << offset <<
             " numBytes: " << numBytes <<
+            " ranges: "   << ranges.size() / 2 <<
             " iotm: "     << diskIOTime <<
             (skipVerifyDiskChecksumFlag ? " skip-disk-chksum" : "")
         ;
@@ -1126,18 +1285,23 @@ struct WritePrepareOp : public ChunkAccessOp {
     chunkOff_t        offset;       /* input */
     size_t            numBytes;     /* input */
     bool              replyRequestedFlag;
+    bool              allocWriteIdFlag; /* allocate write ids with the write */
     vector<uint32_t>  checksums;    /* checksum for each 64KB block */
     vector<WriteInfo> writeInfo;    /* input */
+    string            writeIdStr;   /* output: with write id allocation */
 
     WritePrepareOp(kfsSeq_t s, kfsChunkId_t c, int64_t v)
         : ChunkAccessOp(CMD_WRITE_PREPARE, s, c),
           offset(0),
           numBytes(0),
           replyRequestedFlag(false),
+          allocWriteIdFlag(false),
           checksums(),
-          writeInfo()
+          writeInfo(),
+          writeIdStr()
         { chunkVersion = v; }
     void Request(ostream& os);
+    virtual void ParseResponseHeaderSelf(const Properties& prop);
     virtual ostream& ShowSelf(ostream& os) const {
         os << "write-prepare:"
             " chunkid: "  << chunkId <<
@@ -1292,6 +1456,41 @@ struct LeaseRenewOp : public KfsOp {
     }
 };
 
+// Renew a list of read leases in one request. No chunk access is returned,
+// therefore the batch renew can only be used without chunk server client
+// authentication.
+struct LeaseRenewBatchOp : public KfsOp {
+    struct Entry
+    {
+        kfsChunkId_t chunkId;
+        int64_t      chunkPos;
+        int64_t      leaseId;
+        int          status; // result
+        Entry(kfsChunkId_t c = -1, int64_t p = -1, int64_t l = -1)
+            : chunkId(c),
+              chunkPos(p),
+              leaseId(l),
+              status(0)
+            {}
+    };
+    typedef vector<Entry> Entries;
+
+    Entries entries;
+    LeaseRenewBatchOp(kfsSeq_t s)
+        : KfsOp(CMD_LEASE_RENEW_BATCH, s),
+          entries()
+        {}
+    void Request(ostream& os);
+    virtual void ParseResponseHeaderSelf(const Properties& prop);
+    virtual ostream& ShowSelf(ostream& os) const {
+        os << "lease-renew-batch: entries: " << entries.size();
+        if (! entries.empty()) {
+            os << " first chunkid: " << entries.front().chunkId;
+        }
+        return os;
+    }
+};
+
 // Whenever we want to give up a lease early, we notify the metaserver
 // using this op.
 struct LeaseRelinquishOp : public KfsOp {
@@ -1507,12 +1706,23 @@ struct GetPathNameOp : public KfsOp {
 struct ChmodOp : public KfsOp {
     kfsFileId_t fid;
     kfsMode_t   mode;
+    bool        recursiveFlag;     // input: change directory sub tree
+    string      cursor;            // input / output: sub tree position
+    int64_t     count;             // output: sub tree entries traversed
+    int64_t     failedCount;       // output: sub tree entries not changed
+    int         recursiveDoneFlag; // output: -1 not supported by server
     ChmodOp(kfsSeq_t s, kfsFileId_t f, kfsMode_t m)
         : KfsOp(CMD_CHMOD, s),
           fid(f),
-          mode(m)
+          mode(m),
+          recursiveFlag(false),
+          cursor(),
+          count(0),
+          failedCount(0),
+          recursiveDoneFlag(-1)
         {}
     void Request(ostream& os);
+    virtual void ParseResponseHeaderSelf(const Properties& prop);
     virtual ostream& ShowSelf(ostream& os) const {
         os << "chmod:"
             " fid: "    << fid <<
@@ -1529,13 +1739,23 @@ struct ChownOp : public KfsOp {
     kfsGid_t    group;
     string      userName;
     string      groupName;
+    bool        recursiveFlag;     // input: change directory sub tree
+    string      cursor;            // input / output: sub tree position
+    int64_t     count;             // output: sub tree entries traversed
+    int64_t     failedCount;       // output: sub tree entries not changed
+    int         recursiveDoneFlag; // output: -1 not supported by server
     ChownOp(kfsSeq_t s, kfsFileId_t f, kfsUid_t u, kfsGid_t g)
         : KfsOp(CMD_CHOWN, s),
           fid(f),
           user(u),
           group(g),
           userName(),
-          groupName()
+          groupName(),
+          recursiveFlag(false),
+          cursor(),
+          count(0),
+          failedCount(0),
+          recursiveDoneFlag(-1)
         {}
     virtual void Request(ostream& os);
     virtual void ParseResponseHeaderSelf(const Properties& prop);
@@ -1658,6 +1878,20 @@ struct MetaPingOp : public KfsMonOp {
     }
 };
 
+// Meta and chunk server no operation, used to measure rpc round trip time.
+struct NoopOp : public KfsMonOp {
+    NoopOp(kfsSeq_t s)
+        : KfsMonOp(CMD_NOOP, s)
+        {}
+    virtual void Request(ostream& os);
+    virtual ostream& ShowSelf(ostream& os) const {
+        os << "noop:"
+            " status: " << status
+        ;
+        return os;
+    }
+};
+
 struct MetaToggleWORMOp : public KfsMonOp {
     int value;
     MetaToggleWORMOp(kfsSeq_t s, int v)
@@ -1698,9 +1932,17 @@ struct ChunkPingOp : public KfsMonOp {
 
 struct MetaStatsOp : public KfsMonOp {
     Properties stats; // result
-    MetaStatsOp(kfsSeq_t s)
+    // Delta subscription: with non 0 deltaId the server returns only the
+    // stats changed since deltaGen response, merged into stats.
+    int64_t    deltaId;
+    int64_t    deltaGen;
+    bool       deltaFullFlag;
+    MetaStatsOp(kfsSeq_t s, int64_t id = 0)
         : KfsMonOp(CMD_META_STATS, s),
-          stats()
+          stats(),
+          deltaId(id),
+          deltaGen(0),
+          deltaFullFlag(true)
         {}
     virtual void Request(ostream& os);
     virtual void ParseResponseHeaderSelf(const Properties& prop);
@@ -1714,9 +1956,17 @@ struct MetaStatsOp : public KfsMonOp {
 
 struct ChunkStatsOp : public KfsMonOp {
     Properties stats; // result
-    ChunkStatsOp(kfsSeq_t s)
+    // Delta subscription: with non 0 deltaId the server returns only the
+    // stats changed since deltaGen response, merged into stats.
+    int64_t    deltaId;
+    int64_t    deltaGen;
+    bool       deltaFullFlag;
+    ChunkStatsOp(kfsSeq_t s, int64_t id = 0)
         : KfsMonOp(CMD_CHUNK_STATS, s),
-          stats()
+          stats(),
+          deltaId(id),
+          deltaGen(0),
+          deltaFullFlag(true)
         {}
     virtual void Request(ostream& os);
     virtual void ParseResponseHeaderSelf(const Properties& prop);
@@ -50,6 +50,12 @@
 #include "Writer.h"
 #include "Reader.h"
 #include "ClientPool.h"
+#include "ChunkLocationCache.h"
+#include "ChunkBlockCache.h"
+#include "ChunkServerLatencyStats.h"
+#include "ReplicaLocality.h"
+#include "LeaseRenewBatcher.h"
+#include "ECThreadPool.h"
 
 #include <algorithm>
 #include <map>
@@ -128,6 +134,15 @@ public:
           mMaxReadSize(inParameters.mMaxReadSize),
           mReadLeaseRetryTimeout(inParameters.mReadLeaseRetryTimeout),
           mLeaseWaitTimeout(inParameters.mLeaseWaitTimeout),
+          mHedgedReadMinTimeoutMs(inParameters.mHedgedReadMinTimeoutMs),
+          mHedgedReadPercentile(inParameters.mHedgedReadPercentile),
+          mHedgedReadMaxPercent(inParameters.mHedgedReadMaxPercent),
+          mShortCircuitReadFlag(inParameters.mShortCircuitReadFlag),
+          mWriteBehindFlushRatio(inParameters.mWriteBehindFlushRatio),
+          mAllocWriteIdWithWriteFlag(inParameters.mAllocWriteIdWithWriteFlag),
+          mNextChunkPreallocRatio(inParameters.mNextChunkPreallocRatio),
+          mMaxSpaceReservationSize(inParameters.mMaxSpaceReservationSize),
+          mAppendMaxLingerMs(inParameters.mAppendMaxLingerMs),
           mChunkServerInitialSeqNum(
             inParameters.mChunkServerInitialSeqNum > 0 ?
                 inParameters.mChunkServerInitialSeqNum :
@@ -153,19 +168,49 @@ public:
                 ), // inMaxContentLength
                 false,                       // inFailAllOpsOnOpTimeoutFlag
                 false,                       // inMaxOneOutstandingOpFlag
-                0                            // inAuthContextPtr
+                0,                           // inAuthContextPtr
+                inParameters.mClientPoolMaxConnections,
+                inParameters.mClientPoolMaxPendingOps
             ) : 0
         ),
+        mChunkLocationCache(
+            (size_t)max(0, inParameters.mChunkLocationCacheSize),
+            inParameters.mChunkLocationCacheTtlSec
+        ),
+        mChunkBlockCache(
+            inParameters.mBlockCacheMaxBytes,
+            inParameters.mBlockCacheMaxReadSize
+        ),
+        mECThreadPoolPtr(0 < inParameters.mECThreadCount ?
+            new ECThreadPool(inParameters.mECThreadCount) : 0),
+        mLatencyStatsPtr(inParameters.mLatencyStatsFlag ?
+            new ChunkServerLatencyStats() : 0),
+        mReplicaLocality(),
+        mLeaseRenewBatcher(mMetaServer),
         mReadStats(),
         mWriteStats(),
         mAppendStats()
     {
         WorkQueue::Init(mWorkQueue);
         FreeSyncRequests::Init(mFreeSyncRequests);
+        FreeSyncRequests::Init(mStartedSyncRequests);
         CleanupList::Init(mCleanupList);
+        mReplicaLocality.SetParameters(
+            inParameters.mReadPreferLocalFlag,
+            inParameters.mRackId,
+            inParameters.mRackPrefixes
+        );
+        mLeaseRenewBatcher.SetParameters(
+            inParameters.mLeaseRenewBatchSize,
+            inParameters.mLeaseRenewBatchDelayMs
+        );
     }
     virtual ~Impl()
-        { Impl::Stop(); }
+    {
+        Impl::Stop();
+        delete mECThreadPoolPtr;
+        delete mLatencyStatsPtr;
+    }
     virtual void Run()
     {
         mNetManager.RegisterTimeoutHandler(this);
@@ -308,6 +353,43 @@ public:
             inOffset
         ));
     }
+    void StartMeta(
+        KfsOp& inOp)
+    {
+        SyncRequest& theReq = GetSyncRequest(
+            kRequestTypeMetaOp, 1, 1, 0, &inOp, 0, 0, 0);
+        {
+            QCStMutexLocker theLock(mMutex);
+            FreeSyncRequests::PushBack(mStartedSyncRequests, theReq);
+        }
+        theReq.Start(*this);
+    }
+    int64_t WaitMeta(
+        KfsOp& inOp)
+    {
+        SyncRequest* theReqPtr = 0;
+        {
+            QCStMutexLocker theLock(mMutex);
+            SyncRequest* thePtr = FreeSyncRequests::Front(mStartedSyncRequests);
+            while (thePtr) {
+                if (thePtr->IsRequestFor(inOp)) {
+                    FreeSyncRequests::Remove(mStartedSyncRequests, *thePtr);
+                    theReqPtr = thePtr;
+                    break;
+                }
+                thePtr = &FreeSyncRequests::GetNext(*thePtr);
+                if (thePtr == FreeSyncRequests::Front(mStartedSyncRequests)) {
+                    break;
+                }
+            }
+        }
+        if (! theReqPtr) {
+            return kErrParameters;
+        }
+        const int64_t theRet = theReqPtr->Wait();
+        PutSyncRequest(*theReqPtr);
+        return theRet;
+    }
     int64_t Enqueue(
         Request& inRequest)
     {
@@ -674,14 +756,26 @@ private:
         }
         int64_t Execute(
             Impl& inWorker)
+        {
+            Start(inWorker);
+            return Wait();
+        }
+        void Start(
+            Impl& inWorker)
         {
             mWaitingFlag = true;
             inWorker.Enqueue(*this);
+        }
+        int64_t Wait()
+        {
             QCStMutexLocker theLock(mMutex);
             while (mWaitingFlag && mCond.Wait(mMutex))
                 {}
             return mRetStatus;
         }
+        bool IsRequestFor(
+            const KfsOp& inOp) const
+            { return (GetBufferPtr() == &inOp); }
         virtual void OpDone(
             KfsOp*    inOpPtr,
             bool      inCanceledFlag,
@@ -890,7 +984,13 @@ private:
               mDonePos(0),
               mLastSyncReqPtr(0),
               mCloseReqPtr(0)
-            { WorkQueue::Init(mWorkQueue); }
+        {
+            WorkQueue::Init(mWorkQueue);
+            mWAppender.SetMaxLingerTime(inOwner.mAppendMaxLingerMs);
+            mWAppender.SetMaxSpaceReservationSize(
+                inOwner.mMaxSpaceReservationSize);
+            mWAppender.SetLatencyStats(inOwner.mLatencyStatsPtr);
+        }
         virtual ~Appender()
         {
             mWAppender.Shutdown();
@@ -1116,7 +1216,14 @@ private:
                 inOwner.mChunkServerInitialSeqNum
               ),
               mCurRequestPtr(0)
-            { WorkQueue::Init(mWorkQueue); }
+        {
+            WorkQueue::Init(mWorkQueue);
+            mWriter.SetECThreadPool(inOwner.mECThreadPoolPtr);
+            mWriter.SetLatencyStats(inOwner.mLatencyStatsPtr);
+            mWriter.SetAllocWriteIdWithWrite(
+                inOwner.mAllocWriteIdWithWriteFlag);
+            mWriter.SetNextChunkPreallocRatio(inOwner.mNextChunkPreallocRatio);
+        }
         virtual ~FileWriter()
         {
             mWriter.Shutdown();
@@ -1293,6 +1400,23 @@ private:
         const Request* mCurRequestPtr;
         Request*       mWorkQueue[1];
 
+        int GetWriteThreshold(
+            int64_t inMaxPending) const
+        {
+            // Start flushing before the write behind buffer is full, in
+            // order to let the application fill the remaining part of the
+            // buffer while the data is in flight.
+            const double theRatio = mOwner.mWriteBehindFlushRatio;
+            if (inMaxPending <= 0 || ! (0 < theRatio && theRatio < 1)) {
+                return (int)inMaxPending;
+            }
+            const int64_t kChecksumBlockSize = (int64_t)CHECKSUM_BLOCKSIZE;
+            const int64_t theThreshold       = (int64_t)(
+                inMaxPending * theRatio) + kChecksumBlockSize - 1;
+            return (int)min(inMaxPending, max(kChecksumBlockSize,
+                theThreshold / kChecksumBlockSize * kChecksumBlockSize));
+        }
+
         void Write(
             Request& inRequest)
         {
@@ -1333,7 +1457,7 @@ private:
                     theSize,
                     inRequest.mOffset,
                     kFlushFlag,
-                    (int)inRequest.mMaxPendingOrEndPos
+                    GetWriteThreshold(inRequest.mMaxPendingOrEndPos)
                 );
                 QCASSERT(theRet < 0 || theRet == theSize);
                 if (theThrottleFlag) {
@@ -1363,7 +1487,8 @@ private:
                 inRequest.mSize,
                 inRequest.mOffset,
                 theFlushFlag,
-                theThrottleFlag ? (int)inRequest.mMaxPendingOrEndPos : -1
+                theThrottleFlag ?
+                    GetWriteThreshold(inRequest.mMaxPendingOrEndPos) : -1
             );
             QCASSERT(theRet < 0 || theRet == inRequest.mSize);
             if (theRet < 0) {
@@ -1412,11 +1537,30 @@ private:
                 inOwner.mLeaseWaitTimeout,
                 inLogPrefixPtr,
                 inOwner.mChunkServerInitialSeqNum,
-                inOwner.mClientPoolPtr),
+                inOwner.mClientPoolPtr,
+                inOwner.mChunkLocationCache.IsEnabled() ?
+                    &inOwner.mChunkLocationCache : 0,
+                inOwner.mChunkBlockCache.IsEnabled() ?
+                    &inOwner.mChunkBlockCache : 0),
               mCurRequestPtr(0),
               mAsyncReadStatus(0),
               mAsyncReadDoneCount(0)
-            { WorkQueue::Init(mWorkQueue); }
+        {
+            WorkQueue::Init(mWorkQueue);
+            mReader.SetHedgedReadParameters(
+                inOwner.mHedgedReadMinTimeoutMs,
+                inOwner.mHedgedReadPercentile,
+                inOwner.mHedgedReadMaxPercent
+            );
+            mReader.SetECThreadPool(inOwner.mECThreadPoolPtr);
+            mReader.SetLatencyStats(inOwner.mLatencyStatsPtr);
+            mReader.SetReplicaLocality(inOwner.mReplicaLocality.IsEnabled() ?
+                &inOwner.mReplicaLocality : 0);
+            mReader.SetShortCircuitRead(inOwner.mShortCircuitReadFlag);
+            mReader.SetLeaseRenewBatcher(
+                inOwner.mLeaseRenewBatcher.IsEnabled() ?
+                &inOwner.mLeaseRenewBatcher : 0);
+        }
         virtual ~FileReader()
         {
             mReader.Shutdown();
@@ -1655,12 +1799,27 @@ private:
     const int            mMaxReadSize;
     const int            mReadLeaseRetryTimeout;
     const int            mLeaseWaitTimeout;
+    const int            mHedgedReadMinTimeoutMs;
+    const int            mHedgedReadPercentile;
+    const int            mHedgedReadMaxPercent;
+    const bool           mShortCircuitReadFlag;
+    const double         mWriteBehindFlushRatio;
+    const bool           mAllocWriteIdWithWriteFlag;
+    const double         mNextChunkPreallocRatio;
+    const int            mMaxSpaceReservationSize;
+    const int            mAppendMaxLingerMs;
     int64_t              mChunkServerInitialSeqNum;
     DoNotDeallocate      mDoNotDeallocate;
     StopRequest          mStopRequest;
     QCThread             mWorker;
     QCMutex              mMutex;
     ClientPool* const    mClientPoolPtr;
+    ChunkLocationCache   mChunkLocationCache;
+    ChunkBlockCache      mChunkBlockCache;
+    ECThreadPool* const  mECThreadPoolPtr;
+    ChunkServerLatencyStats* const mLatencyStatsPtr;
+    ReplicaLocality      mReplicaLocality;
+    LeaseRenewBatcher    mLeaseRenewBatcher;
     FileReader::Stats    mReadStats;
     FileWriter::Stats    mWriteStats;
     Appender::Stats      mAppendStats;
@@ -1669,6 +1828,7 @@ private:
     Appender::Stats      mTotalAppendStats;
     Request*             mWorkQueue[1];
     SyncRequest*         mFreeSyncRequests[1];
+    SyncRequest*         mStartedSyncRequests[1];
     Worker*              mCleanupList[1];
 
     static void Done(
@@ -1880,6 +2040,28 @@ private:
             mClientPoolPtr->GetStats(theStats);
             theStats.Enumerate(theEnumerator.SetPrefix("ChunkServer.Pool."));
             theEnumerator("Size", mClientPoolPtr->GetSize());
+            theEnumerator("Servers", mClientPoolPtr->GetServerCount());
+        }
+        if (mChunkLocationCache.IsEnabled()) {
+            ChunkLocationCache::Stats theCacheStats;
+            mChunkLocationCache.GetStats(theCacheStats);
+            theCacheStats.Enumerate(
+                theEnumerator.SetPrefix("Read.LocationCache."));
+        }
+        if (mChunkBlockCache.IsEnabled()) {
+            ChunkBlockCache::Stats theCacheStats;
+            mChunkBlockCache.GetStats(theCacheStats);
+            theCacheStats.Enumerate(
+                theEnumerator.SetPrefix("Read.BlockCache."));
+        }
+        if (mECThreadPoolPtr) {
+            ECThreadPool::Stats thePoolStats;
+            mECThreadPoolPtr->GetStats(thePoolStats);
+            thePoolStats.Enumerate(theEnumerator.SetPrefix("ECThreadPool."));
+            theEnumerator("Threads", mECThreadPoolPtr->GetThreadCount());
+        }
+        if (mLatencyStatsPtr) {
+            mLatencyStatsPtr->Enumerate(theEnumerator);
         }
         theEnumerator.SetPrefix("Network.");
         theEnumerator("Sockets",       globals().ctrOpenNetFds.GetValue());
@@ -2017,6 +2199,23 @@ KfsProtocolWorker::ExecuteMeta(
     }
 }
 
+void
+KfsProtocolWorker::StartMeta(
+    KfsOp& inOp)
+{
+    mImpl.StartMeta(inOp);
+}
+
+void
+KfsProtocolWorker::WaitMeta(
+    KfsOp& inOp)
+{
+    const int64_t theRet = mImpl.WaitMeta(inOp);
+    if (theRet < 0 && 0 <= inOp.status) {
+        inOp.status = (int)theRet;
+    }
+}
+
 Properties
 KfsProtocolWorker::GetStats()
 {
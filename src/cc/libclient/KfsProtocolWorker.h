@@ -208,7 +208,30 @@ public:
             int                inLeaseWaitTimeout            = 900,
             int                inMaxMetaServerContentLength  = 1 << 20,
             ClientAuthContext* inAuthContextPtr              = 0,
-            bool               inUseClientPoolFlag           = false)
+            bool               inUseClientPoolFlag           = false,
+            int                inChunkLocationCacheSize      = 0,
+            int                inChunkLocationCacheTtlSec    = 30,
+            int                inHedgedReadMinTimeoutMs      = -1,
+            int                inHedgedReadPercentile        = 95,
+            int                inHedgedReadMaxPercent        = 5,
+            int                inECThreadCount               = 0,
+            int                inAppendMaxLingerMs           = -1,
+            int64_t            inBlockCacheMaxBytes          = 0,
+            int                inBlockCacheMaxReadSize       =
+                2 * KFS::CHECKSUM_BLOCKSIZE,
+            bool               inLatencyStatsFlag            = false,
+            int                inClientPoolMaxConnections    = 1,
+            int                inClientPoolMaxPendingOps     = 0,
+            bool               inReadPreferLocalFlag         = true,
+            int                inRackId                      = -1,
+            const std::string& inRackPrefixes                = std::string(),
+            bool               inShortCircuitReadFlag        = false,
+            double             inWriteBehindFlushRatio       = 0.5,
+            int                inLeaseRenewBatchSize         = 256,
+            int                inLeaseRenewBatchDelayMs      = 1000,
+            bool               inAllocWriteIdWithWriteFlag   = false,
+            double             inNextChunkPreallocRatio      = 0,
+            int                inMaxSpaceReservationSize     = 1 << 20)
             : mMetaMaxRetryCount(inMetaMaxRetryCount),
               mMetaTimeSecBetweenRetries(inMetaTimeSecBetweenRetries),
               mMetaOpTimeoutSec(inMetaOpTimeoutSec),
@@ -232,7 +255,29 @@ public:
               mLeaseWaitTimeout(inLeaseWaitTimeout),
               mMaxMetaServerContentLength(inMaxMetaServerContentLength),
               mAuthContextPtr(inAuthContextPtr),
-              mUseClientPoolFlag(inUseClientPoolFlag)
+              mUseClientPoolFlag(inUseClientPoolFlag),
+              mChunkLocationCacheSize(inChunkLocationCacheSize),
+              mChunkLocationCacheTtlSec(inChunkLocationCacheTtlSec),
+              mHedgedReadMinTimeoutMs(inHedgedReadMinTimeoutMs),
+              mHedgedReadPercentile(inHedgedReadPercentile),
+              mHedgedReadMaxPercent(inHedgedReadMaxPercent),
+              mECThreadCount(inECThreadCount),
+              mAppendMaxLingerMs(inAppendMaxLingerMs),
+              mBlockCacheMaxBytes(inBlockCacheMaxBytes),
+              mBlockCacheMaxReadSize(inBlockCacheMaxReadSize),
+              mLatencyStatsFlag(inLatencyStatsFlag),
+              mClientPoolMaxConnections(inClientPoolMaxConnections),
+              mClientPoolMaxPendingOps(inClientPoolMaxPendingOps),
+              mReadPreferLocalFlag(inReadPreferLocalFlag),
+              mRackId(inRackId),
+              mRackPrefixes(inRackPrefixes),
+              mShortCircuitReadFlag(inShortCircuitReadFlag),
+              mWriteBehindFlushRatio(inWriteBehindFlushRatio),
+              mLeaseRenewBatchSize(inLeaseRenewBatchSize),
+              mLeaseRenewBatchDelayMs(inLeaseRenewBatchDelayMs),
+              mAllocWriteIdWithWriteFlag(inAllocWriteIdWithWriteFlag),
+              mNextChunkPreallocRatio(inNextChunkPreallocRatio),
+              mMaxSpaceReservationSize(inMaxSpaceReservationSize)
             {}
             int                 mMetaMaxRetryCount;
             int                 mMetaTimeSecBetweenRetries;
@@ -258,6 +303,28 @@ public:
             int                 mMaxMetaServerContentLength;
             ClientAuthContext*  mAuthContextPtr;
             bool                mUseClientPoolFlag;
+            int                 mChunkLocationCacheSize;
+            int                 mChunkLocationCacheTtlSec;
+            int                 mHedgedReadMinTimeoutMs;
+            int                 mHedgedReadPercentile;
+            int                 mHedgedReadMaxPercent;
+            int                 mECThreadCount;
+            int                 mAppendMaxLingerMs;
+            int64_t             mBlockCacheMaxBytes;
+            int                 mBlockCacheMaxReadSize;
+            bool                mLatencyStatsFlag;
+            int                 mClientPoolMaxConnections;
+            int                 mClientPoolMaxPendingOps;
+            bool                mReadPreferLocalFlag;
+            int                 mRackId;
+            std::string         mRackPrefixes;
+            bool                mShortCircuitReadFlag;
+            double              mWriteBehindFlushRatio;
+            int                 mLeaseRenewBatchSize;
+            int                 mLeaseRenewBatchDelayMs;
+            bool                mAllocWriteIdWithWriteFlag;
+            double              mNextChunkPreallocRatio;
+            int                 mMaxSpaceReservationSize;
     };
     KfsProtocolWorker(
         std::string       inMetaHost,
@@ -275,6 +342,12 @@ public:
         int64_t                inOffset     = -1);
     void ExecuteMeta(
         KfsOp& inOp);
+    // Asynchronous meta op execution: WaitMeta() must be invoked for every
+    // started op, before the op can be re-used or destroyed.
+    void StartMeta(
+        KfsOp& inOp);
+    void WaitMeta(
+        KfsOp& inOp);
     Properties GetStats();
     void Enqueue(
         Request& inRequest);
@@ -225,7 +225,7 @@ public:
         const int64_t   theEndPos = inOffset + inSize;
         ReadRequest*    thePtr;
         while ((thePtr = theIt.Next())) {
-            const int64_t theReqStart = thePtr->GetOffset();
+            const int64_t theReqStart = thePtr->GetFileOffset();
             const int64_t theReqEnd   = theReqStart + thePtr->GetSize();
             if (theReqStart < theEndPos && inOffset < theReqEnd) {
                 return thePtr->Wait(
@@ -357,11 +357,15 @@ public:
             delete &theReq;
             return 0;
         }
-        inEntry.buffer.mStart   = theReq.GetOffset();
+        inEntry.buffer.mStart   = theReq.GetFileOffset();
         inEntry.buffer.mSize    = theReq.GetSize();
         inEntry.buffer.mReadReq = &theReq;
         return &theReq;
     }
+    // Request offset relative to the beginning of the file, as opposed
+    // to the pack container file.
+    int64_t GetFileOffset() const
+        { return (GetOffset() - mPackedOffset); }
 private:
     typedef QCDLList<ReadRequest, 0> Queue;
 
@@ -373,6 +377,7 @@ private:
     bool                mCanceledFlag:1;
     char*               mBufToDeletePtr;
     int64_t             mStatus;
+    int64_t             mPackedOffset;
     ReadRequest*        mPrevPtr[1];
     ReadRequest*        mNextPtr[1];
 
@@ -388,7 +393,8 @@ private:
           mDoneFlag(false),
           mCanceledFlag(false),
           mBufToDeletePtr(0),
-          mStatus(0)
+          mStatus(0),
+          mPackedOffset(0)
         { Queue::Init(*this); }
     virtual ~ReadRequest()
     {
@@ -409,27 +415,29 @@ private:
         if (inSize <= 0) {
             return 0;
         }
+        mPackedOffset = inEntry.fattr.GetReadOffset(0);
         Reset(
             KfsProtocolWorker::kRequestTypeReadAsync,
             inEntry.instance + 1,
-            inEntry.fattr.fileId,
+            inEntry.fattr.GetReadFileId(),
             &mOpenParams,
             inBufPtr,
             inSize,
             0, // inMaxPending,
-            inOffset
+            inEntry.fattr.GetReadOffset(inOffset)
         );
         if (GetSize() <= 0) {
             return 0;
         }
         mOpenParams.mPathName            = inEntry.pathname;
-        mOpenParams.mFileSize            = inEntry.fattr.fileSize;
+        mOpenParams.mFileSize            = inEntry.fattr.GetReadFileSize();
         mOpenParams.mStriperType         = inEntry.fattr.striperType;
         mOpenParams.mStripeSize          = inEntry.fattr.stripeSize;
         mOpenParams.mStripeCount         = inEntry.fattr.numStripes;
         mOpenParams.mRecoveryStripeCount = inEntry.fattr.numRecoveryStripes;
         mOpenParams.mReplicaCount        = inEntry.fattr.numReplicas;
-        mOpenParams.mSkipHolesFlag       = inEntry.skipHoles;
+        mOpenParams.mSkipHolesFlag       =
+            inEntry.skipHoles && ! inEntry.fattr.IsPacked();
         mOpenParams.mFailShortReadsFlag  = inEntry.failShortReadsFlag;
         mOpenParams.mMsgLogId            = inMsgLogId;
         mWaitingCount = 0;
@@ -524,6 +532,9 @@ KfsClientImpl::ReadPrefetch(
             theEntry.cachedAttrFlag) {
         return -EINVAL;
     }
+    if (theEntry.compressedFile) {
+        return -ENOTSUP;
+    }
     if (theEntry.fattr.isDirectory) {
         return -EISDIR;
     }
@@ -549,10 +560,11 @@ KfsClientImpl::ReadPrefetch(
     }
     theEntry.readUsedProtocolWorkerFlag = true;
     const int theRet = theReqPtr->GetSize();
+    KfsProtocolWorker& theWorker = GetProtocolWorker(theEntry.instance);
     theLocker.Unlock();
     QCASSERT(! mMutex.IsOwned());
 
-    mProtocolWorker->Enqueue(*theReqPtr);
+    theWorker.Enqueue(*theReqPtr);
     return theRet;
 }
 
@@ -571,7 +583,8 @@ KfsClientImpl::Read(
     int         inFd,
     char*       inBufPtr,
     size_t      inSize,
-    chunkOff_t* inPosPtr /* = 0 */)
+    chunkOff_t* inPosPtr      /* = 0 */,
+    bool        inPhysicalFlag /* = false */)
 {
     QCStMutexLocker theLocker(mMutex);
 
@@ -582,20 +595,31 @@ KfsClientImpl::Read(
         return -EBADF;
     }
     FileTableEntry& theEntry = *mFileTable[inFd];
-    if (theEntry.openMode == O_WRONLY || theEntry.cachedAttrFlag) {
+    // Compressed file writer reads the last chunk header and partial block.
+    if ((theEntry.openMode == O_WRONLY && ! inPhysicalFlag) ||
+            theEntry.cachedAttrFlag) {
         return -EINVAL;
     }
     if (theEntry.fattr.isDirectory) {
         return ReadDirectory(inFd, inBufPtr, inSize);
     }
+    if (theEntry.compressedFile && ! inPhysicalFlag) {
+        const bool kWriteFlag = false;
+        return CompressedReadWrite(inFd, theEntry, inBufPtr, inSize,
+            inPosPtr, kWriteFlag, theLocker);
+    }
 
     chunkOff_t& theFilePos = inPosPtr ? *inPosPtr : theEntry.currPos.fileOffset;
     int64_t     theFdPos   = theFilePos;
     if (theFdPos < 0) {
         return -EINVAL;
     }
+    if (theEntry.adaptiveReadAheadFlag) {
+        UpdateAdaptiveReadAhead(theEntry, theFdPos, inSize);
+    }
 
-    const KfsProtocolWorker::FileId       theFileId   = theEntry.fattr.fileId;
+    const KfsProtocolWorker::FileId       theFileId   =
+        theEntry.fattr.GetReadFileId();
     const KfsProtocolWorker::FileInstance theInstance = theEntry.instance + 1;
 
     const int64_t kChunkSize       = (int64_t)CHUNKSIZE;
@@ -604,7 +628,9 @@ KfsClientImpl::Read(
     int64_t       thePos           = theFdPos;
     int64_t       theLen           = min(theEof - thePos, (int64_t)inSize);
     const int     theSize          = (int)theLen;
-    const bool    theSkipHolesFlag = theEntry.skipHoles;
+    const bool    theSkipHolesFlag =
+        theEntry.skipHoles && ! theEntry.fattr.IsPacked();
+    const int64_t thePackedOffset  = theEntry.fattr.GetReadOffset(0);
     if (theLen <= 0) {
         return 0;
     }
@@ -613,7 +639,7 @@ KfsClientImpl::Read(
         theEntry, inBufPtr, (int64_t)inSize, thePos);
     if (theReqPtr) {
         void* const   theBufPtr  = theReqPtr->GetBufferPtr();
-        const int64_t theReqPos  = theReqPtr->GetOffset();
+        const int64_t theReqPos  = theReqPtr->GetFileOffset();
         const int     theReqSize = theReqPtr->GetSize();
         int64_t       theRes     = theReqPtr->Wait(
             mMutex, mFreeCondVarsHead, theEntry);
@@ -701,7 +727,7 @@ KfsClientImpl::Read(
         ReadRequest* const theReqPtr = ReadRequest::InitReadAhead(
             mReadCompletionMutex, theEntry, inFd, theFilePos);
         if (theReqPtr) {
-            mProtocolWorker->Enqueue(*theReqPtr);
+            GetProtocolWorker(theEntry.instance).Enqueue(*theReqPtr);
             if (theSize <= theRet) {
                 return theRet;
             }
@@ -740,7 +766,7 @@ KfsClientImpl::Read(
     }
     KfsProtocolWorker::Request::Params theOpenParams;
     theOpenParams.mPathName            = theEntry.pathname;
-    theOpenParams.mFileSize            = theEntry.fattr.fileSize;
+    theOpenParams.mFileSize            = theEntry.fattr.GetReadFileSize();
     theOpenParams.mStriperType         = theEntry.fattr.striperType;
     theOpenParams.mStripeSize          = theEntry.fattr.stripeSize;
     theOpenParams.mStripeCount         = theEntry.fattr.numStripes;
@@ -761,7 +787,7 @@ KfsClientImpl::Read(
         if (theRdSize <= 0) {
             break;
         }
-        int theStatus = (int)mProtocolWorker->Execute(
+        int theStatus = (int)GetProtocolWorker(theInstance).Execute(
             KfsProtocolWorker::kRequestTypeRead,
             theInstance,
             theFileId,
@@ -769,7 +795,7 @@ KfsClientImpl::Read(
             inBufPtr + theRet,
             theRdSize,
             0,
-            thePos
+            thePos + thePackedOffset
         );
         if (theSkipHolesFlag && theStatus == -ENOENT) {
             theStatus = 0;
@@ -808,7 +834,7 @@ KfsClientImpl::Read(
         }
     }
     if (theReadAheadReqPtr) {
-        mProtocolWorker->Enqueue(*theReadAheadReqPtr);
+        GetProtocolWorker(theInstance).Enqueue(*theReadAheadReqPtr);
     }
     return theRet;
 }
@@ -825,7 +851,86 @@ KfsClientImpl::SetReadAheadSize(
         KFS_LOG_EOM;
         return -EBADF;
     }
-    return SetReadAheadSize(*mFileTable[inFd], inSize);
+    // Explicitly set read ahead size turns off adaptive read ahead.
+    FileTableEntry& theEntry = *mFileTable[inFd];
+    ChargeAdaptiveReadAhead(theEntry, 0);
+    theEntry.adaptiveReadAheadFlag = false;
+    return SetReadAheadSize(theEntry, inSize);
+}
+
+void
+KfsClientImpl::InitAdaptiveReadAhead(
+    FileTableEntry& inEntry)
+{
+    QCASSERT(mMutex.IsOwned());
+
+    ChargeAdaptiveReadAhead(inEntry, 0);
+    inEntry.adaptiveReadAheadFlag = mAdaptiveReadAheadFlag &&
+        ! inEntry.fattr.isDirectory && inEntry.openMode != O_WRONLY;
+    inEntry.readPattern = ReadPattern();
+    if (inEntry.adaptiveReadAheadFlag) {
+        ChargeAdaptiveReadAhead(inEntry, inEntry.buffer.GetBufSize());
+    }
+}
+
+void
+KfsClientImpl::ChargeAdaptiveReadAhead(
+    FileTableEntry& inEntry,
+    int             inSize)
+{
+    mAdaptiveReadAheadMemory += inSize - inEntry.readAheadChargedSize;
+    inEntry.readAheadChargedSize = inSize;
+    QCASSERT(0 <= mAdaptiveReadAheadMemory);
+}
+
+void
+KfsClientImpl::UpdateAdaptiveReadAhead(
+    FileTableEntry& inEntry,
+    chunkOff_t      inPos,
+    size_t          inSize)
+{
+    QCASSERT(mMutex.IsOwned() && inEntry.adaptiveReadAheadFlag);
+
+    const ReadPattern::Type theType = inEntry.readPattern.Update(inPos, inSize);
+    const int               theCur  = inEntry.buffer.GetBufSize();
+    int64_t                 theSize = theCur;
+    switch (theType) {
+        case ReadPattern::kTypeSequential:
+            // Double the window, the larger window also increases the number
+            // of the chunk reads issued in parallel by the reader.
+            theSize = max(int64_t(theCur), int64_t(CHECKSUM_BLOCKSIZE)) * 2;
+            break;
+        case ReadPattern::kTypeStrided: {
+            // Read ahead covers the gaps, and only pays off if the gap is no
+            // larger than the read.
+            const int64_t theStride = inEntry.readPattern.GetStride();
+            theSize = theStride <= (int64_t)inSize ?
+                4 * (theStride + (int64_t)inSize) : int64_t(0);
+            break;
+        }
+        case ReadPattern::kTypeRandom:
+            theSize = theCur / 2;
+            if (theSize < (int64_t)CHECKSUM_BLOCKSIZE) {
+                theSize = 0;
+            }
+            break;
+        default:
+            return;
+    }
+    theSize = max(int64_t(mAdaptiveReadAheadMinSize),
+        min(int64_t(mAdaptiveReadAheadMaxSize), theSize));
+    if (theCur < theSize) {
+        // Grow only within the client wide memory budget.
+        theSize = min(theSize, theCur +
+            max(int64_t(0), mAdaptiveReadAheadMaxMemory -
+                mAdaptiveReadAheadMemory));
+    }
+    if (theSize == theCur || (theCur < theSize &&
+            theSize < theCur + (int64_t)CHECKSUM_BLOCKSIZE)) {
+        return;
+    }
+    SetReadAheadSize(inEntry, (size_t)theSize, true);
+    ChargeAdaptiveReadAhead(inEntry, inEntry.buffer.GetBufSize());
 }
 
 ssize_t
@@ -28,9 +28,11 @@
 #include "KfsProtocolWorker.h"
 #include "common/MsgLogger.h"
 #include "qcdio/qcstutils.h"
+#include "qcdio/qcdebug.h"
 
 #include <cerrno>
 #include <string>
+#include <algorithm>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -39,6 +41,8 @@ namespace KFS {
 namespace client {
 
 using std::string;
+using std::min;
+using std::max;
 
 int
 KfsClientImpl::RecordAppend(int fd, const char *buf, int numBytes)
@@ -80,7 +84,8 @@ KfsClientImpl::WriteAsyncCompletionHandler(int fd)
 
 ssize_t
 KfsClientImpl::Write(int fd, const char *buf, size_t numBytes,
-    bool asyncFlag, bool appendOnlyFlag, chunkOff_t* pos /* = 0 */)
+    bool asyncFlag, bool appendOnlyFlag, chunkOff_t* pos /* = 0 */,
+    bool physicalFlag /* = false */)
 {
     QCStMutexLocker lock(mMutex);
 
@@ -113,6 +118,13 @@ KfsClientImpl::Write(int fd, const char *buf, size_t numBytes,
     if ((offset < 0 || appendOnlyFlag) && ! appendFlag) {
         return -EINVAL;
     }
+    if (entry.compressedFile && ! physicalFlag) {
+        // The data is compressed in the caller's thread, the compressed
+        // blocks are written with the regular write behind.
+        const bool kWriteFlag = true;
+        return CompressedReadWrite(fd, entry, const_cast<char*>(buf),
+            numBytes, pos, kWriteFlag, lock);
+    }
     if (appendFlag) {
         if (numBytes > (int)CHUNKSIZE) {
             return -EFBIG;
@@ -151,16 +163,25 @@ KfsClientImpl::Write(int fd, const char *buf, size_t numBytes,
         }
     }
     entry.usedProtocolWorkerFlag = true;
-    entry.pending += numBytes;
+    SetWriteBehindPending(entry, entry.pending + numBytes);
     const KfsProtocolWorker::FileId       fileId       = entry.fattr.fileId;
     const KfsProtocolWorker::FileInstance fileInstance = entry.instance;
     const string                          pathName     = entry.pathname;
     const int                             bufsz        = entry.ioBufferSize;
     const int                             prevPending  = entry.pending;
-    const bool                            throttle     =
+    bool                                  throttle     =
         ! asyncFlag && bufsz > 0 && bufsz <= entry.pending;
+    int64_t                               maxPending   = bufsz;
+    if (! asyncFlag && bufsz > 0 && 0 < mWriteBehindMaxMemory &&
+            mWriteBehindMaxMemory < mWriteBehindMemory) {
+        // Client wide write behind budget is exceeded, limit this file to
+        // the remaining part of the budget.
+        throttle   = true;
+        maxPending = min(maxPending, max(int64_t(CHECKSUM_BLOCKSIZE),
+            mWriteBehindMaxMemory - (mWriteBehindMemory - entry.pending)));
+    }
     if ((throttle || bufsz <= 0) && ! asyncFlag) {
-        entry.pending = 0;
+        SetWriteBehindPending(entry, 0);
     }
     lock.Unlock();
 
@@ -172,9 +193,10 @@ KfsClientImpl::Write(int fd, const char *buf, size_t numBytes,
         " throttle: " << throttle <<
         " pending: "  << prevPending <<
         " bufsz: "    << bufsz <<
+        " max: "      << maxPending <<
     KFS_LOG_EOM;
 
-    const int64_t status = mProtocolWorker->Execute(
+    const int64_t status = GetProtocolWorker(fileInstance).Execute(
         asyncFlag ?
             (appendFlag ?
                 KfsProtocolWorker::kRequestTypeWriteAppendAsyncNoCopy :
@@ -196,7 +218,7 @@ KfsClientImpl::Write(int fd, const char *buf, size_t numBytes,
         openParamsPtr,
         const_cast<char*>(buf),
         numBytes,
-        (throttle || (! appendFlag && bufsz >= 0)) ? bufsz : -1,
+        (throttle || (! appendFlag && bufsz >= 0)) ? maxPending : -1,
         offset
     );
     if (status < 0) {
@@ -220,10 +242,18 @@ KfsClientImpl::Write(int fd, const char *buf, size_t numBytes,
                 " cur: "    << entry.pending <<
                 " add: "    << status <<
             KFS_LOG_EOM;
-            entry.pending += status;
+            SetWriteBehindPending(entry, entry.pending + status);
         }
     }
     return numBytes;
 }
 
+void
+KfsClientImpl::SetWriteBehindPending(FileTableEntry& entry, int64_t pending)
+{
+    mWriteBehindMemory += pending - entry.pending;
+    entry.pending = pending;
+    QCASSERT(0 <= mWriteBehindMemory);
+}
+
 }}
@@ -0,0 +1,273 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Read lease renew batcher implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "LeaseRenewBatcher.h"
+
+#include "common/MsgLogger.h"
+#include "common/kfserrno.h"
+#include "kfsio/NetManager.h"
+#include "qcdio/QCUtils.h"
+
+#include <errno.h>
+
+namespace KFS
+{
+namespace client
+{
+const int kErrorFault = -EFAULT;
+
+LeaseRenewBatcher::LeaseRenewBatcher(
+    KfsNetClient& inMetaServer)
+    : OpOwner(),
+      ITimeout(),
+      mMetaServer(inMetaServer),
+      mOp(0),
+      mPending(),
+      mInFlight(),
+      mMaxBatchSize(0),
+      mMaxDelayMs(0),
+      mInFlightFlag(false),
+      mTimerFlag(false),
+      mDisabledFlag(false)
+    {}
+
+LeaseRenewBatcher::~LeaseRenewBatcher()
+{
+    StopTimer();
+    if (mInFlightFlag) {
+        mMetaServer.Cancel(&mOp, this);
+    }
+}
+
+void
+LeaseRenewBatcher::SetParameters(
+    int inMaxBatchSize,
+    int inMaxDelayMs)
+{
+    mMaxBatchSize = inMaxBatchSize;
+    mMaxDelayMs   = inMaxDelayMs;
+}
+
+bool
+LeaseRenewBatcher::Enqueue(
+    LeaseRenewOp& inOp,
+    OpOwner&      inOwner)
+{
+    if (! IsEnabled()) {
+        return mMetaServer.Enqueue(&inOp, &inOwner);
+    }
+    mPending.push_back(Entry(&inOp, &inOwner));
+    if (! mInFlightFlag) {
+        Schedule();
+    }
+    return true;
+}
+
+void
+LeaseRenewBatcher::Schedule()
+{
+    if (mMaxDelayMs <= 0 || mMaxBatchSize <= (int)mPending.size()) {
+        StopTimer();
+        Flush();
+    } else if (! mTimerFlag) {
+        mTimerFlag = true;
+        SetTimeoutInterval(mMaxDelayMs, true);
+        mMetaServer.GetNetManager().RegisterTimeoutHandler(this);
+    }
+}
+
+bool
+LeaseRenewBatcher::Cancel(
+    LeaseRenewOp& inOp,
+    OpOwner&      inOwner)
+{
+    if (! Remove(mPending, inOp, inOwner, true) &&
+            ! Remove(mInFlight, inOp, inOwner, false)) {
+        return mMetaServer.Cancel(&inOp, &inOwner);
+    }
+    if (mPending.empty()) {
+        StopTimer();
+    }
+    inOwner.OpDone(&inOp, true, 0);
+    return true;
+}
+
+/* static */ bool
+LeaseRenewBatcher::Remove(
+    LeaseRenewBatcher::Entries& inEntries,
+    LeaseRenewOp&               inOp,
+    LeaseRenewBatcher::OpOwner& inOwner,
+    bool                        inEraseFlag)
+{
+    for (Entries::iterator theIt = inEntries.begin();
+            theIt != inEntries.end();
+            ++theIt) {
+        if (theIt->mOpPtr == &inOp && theIt->mOwnerPtr == &inOwner) {
+            // The in flight entries are cleared, in order to preserve the
+            // entry positions in the batch.
+            if (inEraseFlag) {
+                inEntries.erase(theIt);
+            } else {
+                *theIt = Entry();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+LeaseRenewBatcher::Timeout()
+{
+    StopTimer();
+    if (! mInFlightFlag) {
+        Flush();
+    }
+}
+
+void
+LeaseRenewBatcher::StopTimer()
+{
+    if (! mTimerFlag) {
+        return;
+    }
+    mTimerFlag = false;
+    mMetaServer.GetNetManager().UnRegisterTimeoutHandler(this);
+}
+
+void
+LeaseRenewBatcher::Flush()
+{
+    mOp.seq           = 0;
+    mOp.status        = 0;
+    mOp.lastError     = 0;
+    mOp.statusMsg.clear();
+    mOp.contentLength = 0;
+    mOp.DeallocContentBuf();
+    mOp.entries.clear();
+    mInFlight.clear();
+    Entries::iterator theIt = mPending.begin();
+    while (theIt != mPending.end() &&
+            (int)mInFlight.size() < mMaxBatchSize) {
+        mInFlight.push_back(*theIt);
+        const LeaseRenewOp& theOp = *theIt->mOpPtr;
+        mOp.entries.push_back(LeaseRenewBatchOp::Entry(
+            theOp.chunkId, theOp.chunkPos, theOp.leaseId));
+        ++theIt;
+    }
+    mPending.erase(mPending.begin(), theIt);
+    if (mInFlight.empty()) {
+        return;
+    }
+    KFS_LOG_STREAM_DEBUG <<
+        "+> meta " << mOp.Show() <<
+        " pending: " << mPending.size() <<
+    KFS_LOG_EOM;
+    mInFlightFlag = true;
+    if (! mMetaServer.Enqueue(&mOp, this)) {
+        mOp.status    = kErrorFault;
+        mOp.statusMsg = "meta op enqueue failure";
+        OpDone(&mOp, false, 0);
+    }
+}
+
+void
+LeaseRenewBatcher::OpDone(
+    KfsOp*    inOpPtr,
+    bool      inCanceledFlag,
+    IOBuffer* inBufferPtr)
+{
+    QCRTASSERT(inOpPtr == &mOp && ! inBufferPtr && mInFlightFlag);
+    KFS_LOG_STREAM(mOp.status == 0 ?
+            MsgLogger::kLogLevelDEBUG : MsgLogger::kLogLevelERROR) <<
+        "<- " << (inCanceledFlag ? "canceled " : "") << mOp.Show() <<
+        " status: " << mOp.status <<
+        " msg: "    << mOp.statusMsg <<
+    KFS_LOG_EOM;
+    // Communication failures are reported to each entry owner, in order to
+    // handle these the same way as with the individual renew. Other failures
+    // mean that the meta server does not support batch renew, re-send the ops
+    // individually.
+    const bool theResendFlag = ! inCanceledFlag && mOp.status != 0 &&
+        mOp.status != KfsNetClient::kErrorMaxRetryReached;
+    if (theResendFlag) {
+        mDisabledFlag = true;
+        KFS_LOG_STREAM_ERROR <<
+            "lease renew batch failure: " << mOp.statusMsg <<
+            " disabling batch lease renew" <<
+        KFS_LOG_EOM;
+    }
+    // The owner completion can cancel other ops, and invoke Cancel(), iterate
+    // by index, and clear each entry prior to invoking the completion.
+    for (size_t i = 0; i < mInFlight.size(); i++) {
+        LeaseRenewOp* const theOpPtr    = mInFlight[i].mOpPtr;
+        OpOwner* const      theOwnerPtr = mInFlight[i].mOwnerPtr;
+        if (! theOpPtr) {
+            continue;
+        }
+        mInFlight[i] = Entry();
+        if (theResendFlag) {
+            if (mMetaServer.Enqueue(theOpPtr, theOwnerPtr)) {
+                continue;
+            }
+            theOpPtr->status    = kErrorFault;
+            theOpPtr->statusMsg = "meta op enqueue failure";
+        } else if (! inCanceledFlag) {
+            if (mOp.status != 0) {
+                theOpPtr->status    = mOp.status;
+                theOpPtr->statusMsg = mOp.statusMsg;
+            } else {
+                theOpPtr->status = i < mOp.entries.size() ?
+                    mOp.entries[i].status : -EINVAL;
+                if (theOpPtr->status != 0) {
+                    theOpPtr->statusMsg = "batch lease renew failure";
+                }
+            }
+        }
+        theOwnerPtr->OpDone(theOpPtr, inCanceledFlag, 0);
+    }
+    mInFlight.clear();
+    mOp.entries.clear();
+    mInFlightFlag = false;
+    if (mPending.empty()) {
+        return;
+    }
+    if (! IsEnabled()) {
+        StopTimer();
+        while (! mPending.empty()) {
+            const Entry theEntry = mPending.front();
+            mPending.erase(mPending.begin());
+            if (! mMetaServer.Enqueue(theEntry.mOpPtr, theEntry.mOwnerPtr)) {
+                theEntry.mOpPtr->status    = kErrorFault;
+                theEntry.mOpPtr->statusMsg = "meta op enqueue failure";
+                theEntry.mOwnerPtr->OpDone(theEntry.mOpPtr, false, 0);
+            }
+        }
+        return;
+    }
+    Schedule();
+}
+
+}}
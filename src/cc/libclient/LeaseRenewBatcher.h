@@ -0,0 +1,122 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Read lease renew batcher: coalesces read lease renew requests of all readers
+// of a protocol worker into batched meta server requests. The readers only
+// renew leases of the chunks being read, the batcher delays the renew by up to
+// the configured time in order to collect more renew requests in one batch.
+// At most one batch is in flight, the renew requests queued while the batch
+// is in flight are sent with the next batch. The renews are reported to the
+// op owners the same way as if the ops were sent individually. The batch
+// renew does not return chunk access, therefore it can only be used without
+// chunk server client authentication. Not thread safe.
+//
+//----------------------------------------------------------------------------
+
+#ifndef LEASE_RENEW_BATCHER_H
+#define LEASE_RENEW_BATCHER_H
+
+#include "KfsNetClient.h"
+#include "KfsOps.h"
+
+#include "kfsio/ITimeout.h"
+
+#include <vector>
+
+namespace KFS
+{
+namespace client
+{
+using std::vector;
+
+class LeaseRenewBatcher :
+    public KfsNetClient::OpOwner,
+    public ITimeout
+{
+public:
+    typedef KfsNetClient::OpOwner OpOwner;
+
+    LeaseRenewBatcher(
+        KfsNetClient& inMetaServer);
+    virtual ~LeaseRenewBatcher();
+    void SetParameters(
+        int inMaxBatchSize,
+        int inMaxDelayMs);
+    bool IsEnabled() const
+        { return (1 < mMaxBatchSize && ! mDisabledFlag); }
+    // The completion is reported with the owner OpDone(), with the op status
+    // set to the entry renew status.
+    bool Enqueue(
+        LeaseRenewOp& inOp,
+        OpOwner&      inOwner);
+    // Cancel the renew, and report the cancellation to the owner, or cancel
+    // the op with the meta server, if the op was not enqueued with the
+    // batcher, or was re-sent individually.
+    bool Cancel(
+        LeaseRenewOp& inOp,
+        OpOwner&      inOwner);
+    virtual void OpDone(
+        KfsOp*    inOpPtr,
+        bool      inCanceledFlag,
+        IOBuffer* inBufferPtr);
+    virtual void Timeout();
+private:
+    struct Entry
+    {
+        Entry(
+            LeaseRenewOp* inOpPtr    = 0,
+            OpOwner*      inOwnerPtr = 0)
+            : mOpPtr(inOpPtr),
+              mOwnerPtr(inOwnerPtr)
+            {}
+        LeaseRenewOp* mOpPtr;
+        OpOwner*      mOwnerPtr;
+    };
+    typedef vector<Entry> Entries;
+
+    KfsNetClient&     mMetaServer;
+    LeaseRenewBatchOp mOp;
+    Entries           mPending;
+    Entries           mInFlight;
+    int               mMaxBatchSize;
+    int               mMaxDelayMs;
+    bool              mInFlightFlag;
+    bool              mTimerFlag;
+    bool              mDisabledFlag;
+
+    void Schedule();
+    void Flush();
+    void StopTimer();
+    static bool Remove(
+        Entries&      inEntries,
+        LeaseRenewOp& inOp,
+        OpOwner&      inOwner,
+        bool          inEraseFlag);
+private:
+    LeaseRenewBatcher(
+        const LeaseRenewBatcher& inBatcher);
+    LeaseRenewBatcher& operator=(
+        const LeaseRenewBatcher& inBatcher);
+};
+
+}}
+
+#endif /* LEASE_RENEW_BATCHER_H */
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <map>
 #include <sstream>
@@ -34,6 +35,7 @@ namespace KFS
 using std::find;
 using std::make_pair;
 using std::map;
+using std::max;
 using std::pair;
 using std::string;
 using std::swap;
@@ -345,8 +347,10 @@ private:
                         Counter  currCounterVal =
                                 fsMetrics.currSumOfClientCounters[counterName];
                         Counter  reportVal;
-                        if(counterName.compare("Network.Sockets") == 0) {
-                            // Network.Sockets counter is not accumulative, so
+                        if(counterName.compare("Network.Sockets") == 0 ||
+                                IsLatencyGauge(counterName)) {
+                            // Network.Sockets counter and latency
+                            // percentiles are not accumulative, so
                             // report the new value.
                             reportVal = newCounterVal;
                         }
@@ -392,11 +396,33 @@ private:
             if(currCounterIt == aggregatedResults.end()) {
                 aggregatedResults.insert(make_pair(counterName, counterVal));
             }
+            else if (IsLatencyGauge(counterName)) {
+                // Report the worst latency percentile across the clients.
+                currCounterIt->second =
+                        max(currCounterIt->second, counterVal);
+            }
             else {
                 currCounterIt->second += counterVal;
             }
         }
     }
+    static bool IsLatencyGauge(
+            const string& counterName)
+    {
+        if (counterName.find("Latency.") == string::npos) {
+            return false;
+        }
+        const char* const kSuffixes[] =
+                { ".P50", ".P90", ".P99", ".P999", ".Max", 0 };
+        for (const char* const* suffix = kSuffixes; *suffix; ++suffix) {
+            const size_t len = strlen(*suffix);
+            if (len < counterName.size() && counterName.compare(
+                    counterName.size() - len, len, *suffix) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
     void ClosePlugin()
     {
         if (!mPluginLoaded) {
@@ -0,0 +1,125 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client side mount table implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "MountTable.h"
+#include "Path.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+namespace KFS
+{
+namespace client
+{
+
+int
+MountTable::Parse(
+    const char* inSpecPtr,
+    string&     outErrMsg)
+{
+    mMounts.clear();
+    if (! inSpecPtr) {
+        return 0;
+    }
+    const char* thePtr = inSpecPtr;
+    for (; ;) {
+        while (*thePtr && ((*thePtr & 0xFF) <= ' ' || *thePtr == ',')) {
+            ++thePtr;
+        }
+        if (! *thePtr) {
+            break;
+        }
+        const char* const theStartPtr = thePtr;
+        while (' ' < (*thePtr & 0xFF) && *thePtr != ',') {
+            ++thePtr;
+        }
+        const string      theEntry(theStartPtr, thePtr - theStartPtr);
+        const size_t      theEqPos    = theEntry.find('=');
+        const size_t      theColonPos = theEntry.rfind(':');
+        char*             theEndPtr   = 0;
+        const char* const thePortPtr  = theEntry.c_str() + theColonPos + 1;
+        const long        thePort     = theColonPos == string::npos ? -1 :
+            strtol(thePortPtr, &theEndPtr, 10);
+        if (theEqPos == string::npos || theEqPos <= 0 ||
+                theEntry[0] != '/' ||
+                theColonPos == string::npos ||
+                theColonPos <= theEqPos + 1 ||
+                ! theEndPtr || theEndPtr == thePortPtr || *theEndPtr ||
+                thePort <= 0 || 0xFFFF < thePort) {
+            outErrMsg = "invalid mount table entry: " + theEntry;
+            mMounts.clear();
+            return -EINVAL;
+        }
+        Path thePath;
+        if (! thePath.Set(theEntry.data(), theEqPos)) {
+            outErrMsg = "invalid mount table prefix: " + theEntry;
+            mMounts.clear();
+            return -EINVAL;
+        }
+        const string thePrefix = thePath.NormPath();
+        if (thePrefix.empty() || thePrefix == "/") {
+            outErrMsg = "root directory can not be mounted: " + theEntry;
+            mMounts.clear();
+            return -EINVAL;
+        }
+        for (Mounts::const_iterator theIt = mMounts.begin();
+                theIt != mMounts.end();
+                ++theIt) {
+            if (theIt->mPrefix == thePrefix) {
+                outErrMsg = "duplicate mount table prefix: " + theEntry;
+                mMounts.clear();
+                return -EINVAL;
+            }
+        }
+        mMounts.push_back(Mount(thePrefix, ServerLocation(
+            theEntry.substr(theEqPos + 1, theColonPos - theEqPos - 1),
+            (int)thePort
+        )));
+    }
+    return 0;
+}
+
+int
+MountTable::Find(
+    const string& inPath) const
+{
+    int    theRet    = -1;
+    size_t theMaxLen = 0;
+    for (Mounts::const_iterator theIt = mMounts.begin();
+            theIt != mMounts.end();
+            ++theIt) {
+        const size_t theLen = theIt->mPrefix.size();
+        if (theLen <= theMaxLen || inPath.size() < theLen ||
+                (theLen < inPath.size() && inPath[theLen] != '/') ||
+                inPath.compare(0, theLen, theIt->mPrefix) != 0) {
+            continue;
+        }
+        theMaxLen = theLen;
+        theRet    = (int)(theIt - mMounts.begin());
+    }
+    return theRet;
+}
+
+}}
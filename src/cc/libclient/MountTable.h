@@ -0,0 +1,89 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client side mount table: maps absolute path prefixes to meta server
+// instances, in order to split the name space between multiple meta servers.
+// The mount table specification is a white space or comma separated list of
+// prefix=host:port entries, for example:
+// /user=meta1:20000 /warehouse=meta2:20000
+// The paths that do not match any prefix belong to the default meta server.
+// The longest prefix wins, the prefix only matches at the path component
+// boundary. The mount table is immutable once parsed.
+//
+//----------------------------------------------------------------------------
+
+#ifndef MOUNT_TABLE_H
+#define MOUNT_TABLE_H
+
+#include "common/kfsdecls.h"
+
+#include <string>
+#include <vector>
+
+namespace KFS
+{
+namespace client
+{
+using std::string;
+using std::vector;
+
+class MountTable
+{
+public:
+    class Mount
+    {
+    public:
+        Mount(
+            const string&         inPrefix   = string(),
+            const ServerLocation& inLocation = ServerLocation())
+            : mPrefix(inPrefix),
+              mLocation(inLocation)
+            {}
+        string         mPrefix;
+        ServerLocation mLocation;
+    };
+    typedef vector<Mount> Mounts;
+
+    MountTable()
+        : mMounts()
+        {}
+    // Returns 0 on success, or -EINVAL and sets the error message.
+    int Parse(
+        const char* inSpecPtr,
+        string&     outErrMsg);
+    // Returns the mount index, or -1 if the path belongs to the default meta
+    // server. The path must be absolute and normalized.
+    int Find(
+        const string& inPath) const;
+    bool IsEmpty() const
+        { return mMounts.empty(); }
+    size_t GetSize() const
+        { return mMounts.size(); }
+    const Mount& Get(
+        size_t inIdx) const
+        { return mMounts[inIdx]; }
+private:
+    Mounts mMounts;
+};
+
+}}
+
+#endif /* MOUNT_TABLE_H */
@@ -26,8 +26,11 @@
 #include "RSStriper.h"
 #include "Writer.h"
 #include "ECMethod.h"
+#include "ECThreadPool.h"
 
 #include "kfsio/IOBuffer.h"
+#include "kfsio/ITimeout.h"
+#include "kfsio/NetManager.h"
 #include "kfsio/checksum.h"
 
 #include "common/MsgLogger.h"
@@ -294,7 +297,11 @@ private:
 protected:
     void** const mBufPtr;
 
-    enum { kTempBufSize = kAlign * 16 };
+    // The temporary buffers are used only with unaligned io buffer segments.
+    // Make it large enough to hold the typical io buffer segment in order to
+    // bounce the entire unaligned segment with one encode / decode call.
+    enum { kTempBufSize = 4 << 10 };
+    BOOST_STATIC_ASSERT(kTempBufSize % kAlign == 0);
 
     char* GetTempBufSelfPtr(
         int inIndex,
@@ -823,8 +830,12 @@ private:
             mBuffersPtr[i].mBuffer.Append(theBuf);
             thePendingCount += mBuffersPtr[i].mBuffer.BytesConsumable();
         }
+        // Queue the segments that do not use temporary buffers into the thread
+        // pool, if any, and run them all at once, after the loop.
+        ECThreadPool* const thePoolPtr = GetECThreadPool();
         for (int thePos = 0, thePrevLen = 0; thePos < theSize; ) {
-            int theLen = theSize - thePos;
+            int  theLen      = theSize - thePos;
+            bool theTempFlag = false;
             for (int i = 0; i < mStripeCount; i++) {
                 IOBuffer&           theBuf  = mBuffersPtr[i].mBuffer;
                 IOBuffer::iterator& theIt   = mBuffersPtr[i].mCurIt;
@@ -854,6 +865,7 @@ private:
                 const char* const thePtr = theIt->Consumer() + theSkip;
                 if (theBufSize < kAlign) {
                     char* theDestPtr = GetTempBufPtr(i);
+                    theTempFlag = true;
                     mBufPtr[i] = memcpy(theDestPtr, thePtr, theBufSize);
                     theDestPtr += theBufSize;
                     int theRem = kAlign - theBufSize;
@@ -871,6 +883,7 @@ private:
                     theLen = min(theLen, theBufSize);
                     if ((thePtr - kNullCharPtr) % kAlign != 0) {
                         theLen = min((int)kTempBufSize, theLen);
+                        theTempFlag = true;
                         mBufPtr[i] = memcpy(GetTempBufPtr(i), thePtr, theLen);
                     } else {
                         mBufPtr[i] = const_cast<char*>(thePtr);
@@ -886,9 +899,17 @@ private:
                     " len: " << theLen <<
                 KFS_LOG_EOM;
             }
-            const int theStatus = mEncoderPtr->Encode(
-                mStripeCount, mRecoveryStripeCount, theLen, mBufPtr);
+            if (thePoolPtr && ! theTempFlag) {
+                thePoolPtr->Add(
+                    mStripeCount + mRecoveryStripeCount, theLen, mBufPtr);
+            }
+            const int theStatus = (thePoolPtr && ! theTempFlag) ? 0 :
+                mEncoderPtr->Encode(
+                    mStripeCount, mRecoveryStripeCount, theLen, mBufPtr);
             if (theStatus != 0) {
+                if (thePoolPtr) {
+                    thePoolPtr->Clear();
+                }
                 KFS_LOG_STREAM_ERROR << mLogPrefix <<
                     " recovery:"
                     " encode error: " << theStatus <<
@@ -906,6 +927,19 @@ private:
             thePos += theLen;
             thePrevLen = theLen;
         }
+        if (thePoolPtr && ! thePoolPtr->IsEmpty()) {
+            const int theStatus = thePoolPtr->Encode(
+                *mEncoderPtr, mStripeCount, mRecoveryStripeCount);
+            if (theStatus != 0) {
+                KFS_LOG_STREAM_ERROR << mLogPrefix <<
+                    " recovery:"
+                    " encode error: " << theStatus <<
+                    " off: "          << mRecoveryEndPos <<
+                    " size: "         << theSize <<
+                KFS_LOG_EOM;
+                return false;
+            }
+        }
         if (IOBuffer::IsDebugVerify()) {
             for (int i = mStripeCount;
                     i < mStripeCount + mRecoveryStripeCount;
@@ -1002,11 +1036,22 @@ private:
 // Striped files with and without Reed-Solomon recovery reader implementation.
 // The reader is used by chunk server for RS recovery of both "data" and
 // "recovery" chunks.
-class RSReadStriper : public Reader::Striper, private RSStriper
+class RSReadStriper :
+    public Reader::Striper, private RSStriper, private ITimeout
 {
 public:
     typedef RSStriper::Offset Offset;
 
+    static uint64_t sReadFailureInjectionStripeMask;
+
+    static bool IsReadFailureInjected(
+        int inStripeIdx)
+    {
+        return (sReadFailureInjectionStripeMask != 0 &&
+            0 <= inStripeIdx && inStripeIdx < 64 &&
+            (sReadFailureInjectionStripeMask & (uint64_t(1) << inStripeIdx))
+                != 0);
+    }
     static Striper* Create(
         int                      inType,
         int                      inStripeCount,
@@ -1064,6 +1109,9 @@ public:
     }
     virtual ~RSReadStriper()
     {
+        if (0 < mHedgeTimeoutMs) {
+            GetNetManager().UnRegisterTimeoutHandler(this);
+        }
         Request* thePtr;
         while ((thePtr = Requests::Front(mPendingQueue))) {
             thePtr->Delete(*this, mPendingQueue);
@@ -1362,7 +1410,8 @@ private:
             mInFlightFlag = true;
             // Recovery validates stripe sizes, and wont work if short reads
             // fail -- do not fail short reads if recovery is running.
-            const int theQueuedCount = inOuter.QueueRead(
+            const int theQueuedCount = IsReadFailureInjected(GetStripeIdx()) ?
+                int(kErrorIO) : inOuter.QueueRead(
                 theBuffer,
                 mSize,
                 GetPos(),
@@ -1796,6 +1845,7 @@ private:
         int       mRecursionCount;
         int       mRecoverySize;
         int       mBadStripeCount;
+        int64_t   mStartTimeMs;
 
         static Request& Create(
             Outer&    inOuter,
@@ -1860,6 +1910,7 @@ private:
             mRecursionCount = 0;
             mRecoverySize   = 0;
             mBadStripeCount = 0;
+            mStartTimeMs    = 0;
             const int theBufCount = inOuter.GetBufferCount();
             for (int i = 0; i < theBufCount; i++) {
                 GetBuffer(i).Clear();
@@ -1955,6 +2006,63 @@ private:
         }
         bool IsFailed() const
             { return Outer::IsFailure(mStatus); }
+        bool Hedge(
+            Outer& inOuter)
+        {
+            // Schedule reads of all stripes that are not presently in flight
+            // or already read, and switch to the "get remaining stripes"
+            // round, where ReadDone() cancels the outstanding reads as soon as
+            // enough stripes are available to run recovery.
+            if (0 < mRecoveryRound || 0 < mRecursionCount ||
+                    mRecoverySize <= 0 || IsFailed()) {
+                return false;
+            }
+            const int theBufCount   = inOuter.GetBufferCount();
+            int       theReadyCount = 0;
+            int       theHedgeCount = 0;
+            for (int i = 0; i < theBufCount; i++) {
+                Buffer& theBuf = GetBuffer(i);
+                if (theBuf.IsReadyForRecovery()) {
+                    theReadyCount++;
+                    continue;
+                }
+                if (i == inOuter.mRecoverStripeIdx || theBuf.IsInFlight()) {
+                    continue;
+                }
+                const int theStatus = theBuf.GetStatus();
+                int       theSize   = 0;
+                if (theStatus == 0) {
+                    if (theBuf.GetSize() != mRecoverySize) {
+                        theSize = theBuf.InitRecoveryRead(
+                            inOuter,
+                            mRecoveryPos + i * (Offset)CHUNKSIZE,
+                            mRecoverySize);
+                    }
+                } else if (theStatus != kErrorInvalidChunkSizes &&
+                        theStatus != kErrorInvalChunkSize) {
+                    theSize = theBuf.Retry();
+                }
+                if (0 < theSize) {
+                    mPendingCount += theSize;
+                    theHedgeCount++;
+                }
+            }
+            if (theHedgeCount <= 0) {
+                return false;
+            }
+            mBadStripeCount = theBufCount - theReadyCount;
+            mRecoveryRound++;
+            KFS_LOG_STREAM_DEBUG << inOuter.mLogPrefix <<
+                "hedge recovery read:"
+                " req: "       << mPos            <<
+                ","            << mSize           <<
+                " ready: "     << theReadyCount   <<
+                " hedged: "    << theHedgeCount   <<
+                " bad: "       << mBadStripeCount <<
+                " in flight: " << mInFlightCount  <<
+            KFS_LOG_EOM;
+            return true;
+        }
         void InitRecovery(
             Outer& inOuter)
         {
@@ -2007,7 +2115,8 @@ private:
               mRecoveryRound(0),
               mRecursionCount(0),
               mRecoverySize(0),
-              mBadStripeCount(0)
+              mBadStripeCount(0),
+              mStartTimeMs(0)
             { Requests::Init(*this); }
         ~Request()
             {}
@@ -2558,6 +2667,7 @@ private:
     const Offset             mFileSize;
     const Offset             mRecoverBlockPos;
     const Offset             mRecoverChunkEndPos;
+    const int                mHedgeTimeoutMs;
     RecoveryInfo             mRecoveryInfo;
     BufIterator*             mBufIteratorsPtr;
     IOBufferData*            mZeroBufferPtr;
@@ -2606,6 +2716,8 @@ private:
           mRecoverChunkEndPos(inRecoverChunkPos < 0 ? Offset(-1) :
             inRecoverChunkPos +
             GetChunkSize(mRecoverStripeIdx, mRecoverBlockPos, mFileSize)),
+          mHedgeTimeoutMs(mRecoverStripeIdx < 0 || inRecoveryStripeCount <= 0 ?
+            -1 : GetRecoveryHedgeTimeoutMs()),
           mRecoveryInfo(),
           mBufIteratorsPtr(0),
           mZeroBufferPtr(0),
@@ -2618,6 +2730,9 @@ private:
         Requests::Init(mPendingQueue);
         Requests::Init(mFreeList);
         Requests::Init(mInFlightList);
+        if (0 < mHedgeTimeoutMs) {
+            GetNetManager().RegisterTimeoutHandler(this);
+        }
     }
     void QueueRequest(
         Request& inRequest)
@@ -2627,12 +2742,36 @@ private:
     }
     void Read()
     {
+        const int64_t theNowMs = 0 < mHedgeTimeoutMs ? NowMs() : int64_t(0);
         Request* thePtr;
         while((thePtr = Requests::PopFront(mPendingQueue))) {
             Requests::PushBack(mInFlightList, *thePtr);
+            thePtr->mStartTimeMs = theNowMs;
             thePtr->Read(*this);
         }
     }
+    virtual void Timeout()
+    {
+        if (Requests::IsEmpty(mInFlightList)) {
+            return;
+        }
+        const int64_t theExpiredMs = NowMs() - mHedgeTimeoutMs;
+        Request*      thePtr       = Requests::Front(mInFlightList);
+        while (thePtr) {
+            Request& theReq = *thePtr;
+            thePtr = &Requests::GetNext(theReq);
+            if (thePtr == Requests::Front(mInFlightList)) {
+                thePtr = 0;
+            }
+            if (theReq.mRecoveryRound <= 0 &&
+                    theReq.mStartTimeMs <= theExpiredMs &&
+                    theReq.Hedge(*this)) {
+                theReq.Read(*this);
+                // Read completion might have modified the list.
+                thePtr = Requests::Front(mInFlightList);
+            }
+        }
+    }
     int RecoverChunk(
         IOBuffer& inBuffer,
         int       inLength,
@@ -2688,6 +2827,9 @@ private:
             }
         }
         QueueRequest(theRequest);
+        if (mHedgeTimeoutMs == 0) {
+            theRequest.Hedge(*this);
+        }
         Read();
         return inLength;
     }
@@ -3230,6 +3372,17 @@ private:
         const bool theAllRecoveryStripesRebuildFlag =
             mStripeCount <= mRecoverStripeIdx &&
             ! mDecoderPtr->SupportsOneRecoveryStripeRebuild();
+        // Queue the segments that do not use temporary buffers into the thread
+        // pool, and run them after the loop. The buffer copy in only updates
+        // the buffer byte counts with such segments, as the decode output goes
+        // directly into the failed stripe buffers, therefore the copy in can
+        // be done ahead of decode. The scratch buffers used with all recovery
+        // stripes rebuild share the same space, and the io buffer debug
+        // verify computes checksums on copy in, thus the pool can not be used
+        // in these cases.
+        ECThreadPool* const thePoolPtr =
+            (theAllRecoveryStripesRebuildFlag || IOBuffer::IsDebugVerify()) ?
+            0 : GetECThreadPool();
         StBufferT<int, 32> theTmpBuf;
         int* const theMissingIdx     =
             theTmpBuf.Resize(mRecoveryStripeCount + 1);
@@ -3248,7 +3401,8 @@ private:
         Offset     theMaxChunkSize   = -1;
         theMissingIdx[mRecoveryStripeCount] = -1; // Jerasure end of list.
         for (int thePos = 0; thePos < theSize; ) {
-            int theLen = theSize - thePos;
+            int  theLen      = theSize - thePos;
+            bool theTempFlag = false;
             if (theLen > kAlign) {
                 theLen -= theLen % kAlign;
             }
@@ -3308,9 +3462,16 @@ private:
                     continue;
                 }
                 if (theRem < kAlign || (thePtr - kNullCharPtr) % kAlign != 0) {
+                    // Bounce only the current unaligned segment, or the
+                    // alignment block that spans the segment boundary, in
+                    // order to decode directly from and into the subsequent
+                    // aligned segments.
+                    const int theMaxLen = theRem < kAlign ? (int)kAlign :
+                        min((int)kTempBufSize, theRem - theRem % kAlign);
                     thePtr = GetTempBufPtr(i);
-                    if (theLen > kTempBufSize) {
-                        theLen = kTempBufSize;
+                    theTempFlag = true;
+                    if (theLen > theMaxLen) {
+                        theLen = theMaxLen;
                         QCASSERT(theLen % kAlign == 0);
                     }
                     if (theIt.IsFailure()) {
@@ -3489,7 +3650,12 @@ private:
                     " of: "   << theSize                <<
                 KFS_LOG_EOM;
             }
-            const int theRet = mDecoderPtr->Decode(
+            const bool theQueueFlag = thePoolPtr && ! theTempFlag;
+            if (theQueueFlag) {
+                thePoolPtr->Add(
+                    theBufCount, max(theLen, (int)kAlign), mBufPtr);
+            }
+            const int theRet = theQueueFlag ? 0 : mDecoderPtr->Decode(
                 mStripeCount,
                 mRecoveryStripeCount,
                 max(theLen, (int)kAlign),
@@ -3497,6 +3663,9 @@ private:
                 theMissingIdx
             );
             if (theRet != 0) {
+                if (thePoolPtr) {
+                    thePoolPtr->Clear();
+                }
                 KFS_LOG_STREAM_ERROR << mLogPrefix        <<
                     "read reocvery decode failure"
                     " status: " << theRet                 <<
@@ -3531,6 +3700,26 @@ private:
             thePos += theLen;
             thePrevLen = theLen;
         }
+        if (thePoolPtr && ! thePoolPtr->IsEmpty()) {
+            const int theRet = thePoolPtr->Decode(
+                *mDecoderPtr,
+                mStripeCount,
+                mRecoveryStripeCount,
+                theMissingIdx
+            );
+            if (theRet != 0) {
+                KFS_LOG_STREAM_ERROR << mLogPrefix        <<
+                    "read reocvery decode failure"
+                    " status: " << theRet                 <<
+                    " req: "    << inRequest.mPos         <<
+                    ","         << inRequest.mSize        <<
+                    " pos: "    << inRequest.mRecoveryPos <<
+                    " size: "   << theSize                <<
+                KFS_LOG_EOM;
+                inRequest.mStatus = kErrorIO;
+                return;
+            }
+        }
         mRecoveryInfo.Set(*this, inRequest);
         for (int i = 0; i < mStripeCount; i++) {
             mBufIteratorsPtr[i].SetRecoveryResult(inRequest.GetBuffer(i));
@@ -3849,6 +4038,21 @@ RSStriperCreate(
     );
 }
 
+uint64_t RSReadStriper::sReadFailureInjectionStripeMask = 0;
+
+    void
+RSStriperSetReadFailureInjection(
+    uint64_t inStripeMask)
+{
+    RSReadStriper::sReadFailureInjectionStripeMask = inStripeMask;
+}
+
+    uint64_t
+RSStriperGetReadFailureInjection()
+{
+    return RSReadStriper::sReadFailureInjectionStripeMask;
+}
+
     bool
 RSStriperValidate(
     int     inType,
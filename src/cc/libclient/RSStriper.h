@@ -69,6 +69,15 @@ bool RSStriperValidate(
     int     inStripeSize,
     string* outErrMsgPtr);
 
+// Testing and benchmarking only: fail all reads of the stripes with the
+// corresponding bits set in the mask, without issuing the chunk reads, in
+// order to force the read recovery. The bit 0 corresponds to the first data
+// stripe, the bit [data stripe count] to the first recovery stripe. The
+// setting is global, and applies to all subsequently issued reads.
+void RSStriperSetReadFailureInjection(
+    uint64_t inStripeMask);
+uint64_t RSStriperGetReadFailureInjection();
+
 }}
 
 #endif /* KFS_LIBCLIENT_RSSTRIPER_H */
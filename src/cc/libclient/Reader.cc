@@ -44,6 +44,13 @@
 #include "KfsClient.h"
 #include "RSStriper.h"
 #include "ClientPool.h"
+#include "ChunkLocationCache.h"
+#include "ChunkBlockCache.h"
+#include "ChunkServerLatencyStats.h"
+#include "ReplicaLocality.h"
+#include "LeaseRenewBatcher.h"
+#include "ECThreadPool.h"
+#include "ShortCircuitRead.h"
 #include "Monitor.h"
 
 #include <sstream>
@@ -51,6 +58,7 @@
 #include <cerrno>
 #include <sstream>
 #include <limits>
+#include <map>
 #include <string.h>
 
 namespace KFS
@@ -67,6 +75,92 @@ using std::random_shuffle;
 using std::vector;
 using std::pair;
 using std::make_pair;
+using std::map;
+using std::copy;
+using std::nth_element;
+
+// Read checksum verification task: computes the checksums of the checksum
+// blocks in place in the received buffer, one segment per block, in order to
+// verify large reads on the thread pool.
+class ReadChecksumTask : public ECThreadPool::Task
+{
+public:
+    typedef vector<uint32_t> Checksums;
+
+    ReadChecksumTask()
+        : ECThreadPool::Task(),
+          mStarts(),
+          mChecksums(),
+          mEnd(),
+          mLength(0)
+        {}
+    virtual ~ReadChecksumTask()
+        {}
+    // Returns the number of checksum blocks.
+    int Set(
+        const IOBuffer& inBuffer,
+        int             inLength)
+    {
+        mStarts.clear();
+        mLength = inLength;
+        mEnd    = inBuffer.end();
+        int theNext = 0;
+        int thePos  = 0;
+        for (IOBuffer::iterator theIt = inBuffer.begin();
+                theIt != mEnd && thePos < mLength;
+                ++theIt) {
+            const int theSize = theIt->BytesConsumable();
+            while (theNext < thePos + theSize && theNext < mLength) {
+                mStarts.push_back(make_pair(theIt, theNext - thePos));
+                theNext += (int)CHECKSUM_BLOCKSIZE;
+            }
+            thePos += theSize;
+        }
+        mChecksums.assign(mStarts.size(), kKfsNullChecksum);
+        return (int)mStarts.size();
+    }
+    virtual int Process(
+        int inIdx)
+    {
+        IOBuffer::iterator theIt       = mStarts[inIdx].first;
+        int                theOffset   = mStarts[inIdx].second;
+        int                theRem      = min((int)CHECKSUM_BLOCKSIZE,
+            mLength - inIdx * (int)CHECKSUM_BLOCKSIZE);
+        uint32_t           theChecksum = kKfsNullChecksum;
+        while (0 < theRem && theIt != mEnd) {
+            const int theLen =
+                min(theRem, theIt->BytesConsumable() - theOffset);
+            if (0 < theLen) {
+                theChecksum = ComputeBlockChecksum(
+                    theChecksum, theIt->Consumer() + theOffset,
+                    (size_t)theLen);
+                theRem -= theLen;
+            }
+            theOffset = 0;
+            ++theIt;
+        }
+        mChecksums[inIdx] = theChecksum;
+        return 0;
+    }
+    void Swap(
+        Checksums& ioChecksums)
+    {
+        ioChecksums.swap(mChecksums);
+        mStarts.clear();
+    }
+private:
+    typedef vector<pair<IOBuffer::iterator, int> > Starts;
+
+    Starts             mStarts;
+    Checksums          mChecksums;
+    IOBuffer::iterator mEnd;
+    int                mLength;
+private:
+    ReadChecksumTask(
+        const ReadChecksumTask& inTask);
+    ReadChecksumTask& operator=(
+        const ReadChecksumTask& inTask);
+};
 
 // Kfs client read state machine implementation.
 class Reader::Impl : public QCRefCountedObj
@@ -102,7 +196,9 @@ public:
         int         inLeaseWaitTimeout,
         string      inLogPrefix,
         int64_t     inChunkServerInitialSeqNum,
-        ClientPool* inClientPoolPtr)
+        ClientPool* inClientPoolPtr,
+        ChunkLocationCache* inLocationCachePtr,
+        ChunkBlockCache*    inBlockCachePtr)
         : QCRefCountedObj(),
           mOuter(inOuter),
           mMetaServer(inMetaServer),
@@ -119,11 +215,14 @@ public:
           mLeaseWaitTimeout(inLeaseWaitTimeout),
           mSkipHolesFlag(false),
           mFailShortReadsFlag(false),
+          mRecoveryReadFlag(false),
           mMaxGetAllocRetryCount(inMaxRetryCount),
           mOffset(0),
           mOpenChunkBlockSize(0),
           mChunkServerInitialSeqNum(inChunkServerInitialSeqNum),
           mClientPoolPtr(inClientPoolPtr),
+          mLocationCachePtr(inLocationCachePtr),
+          mBlockCachePtr(inBlockCachePtr),
           mCompletionPtr(inCompletionPtr),
           mLogPrefix(inLogPrefix),
           mStats(),
@@ -131,7 +230,19 @@ public:
           mNetManager(mMetaServer.GetNetManager()),
           mStriperPtr(0),
           mCompletionDepthCount(0),
-          mReplicaCount(-1)
+          mReplicaCount(-1),
+          mRecoveryHedgeTimeoutMs(-1),
+          mHedgedReadMinTimeoutMs(-1),
+          mHedgedReadPercentile(95),
+          mHedgedReadMaxPercent(5),
+          mReadLatencies(),
+          mECThreadPoolPtr(0),
+          mChecksumTask(),
+          mLatencyStatsPtr(0),
+          mReplicaLocalityPtr(0),
+          mShortCircuitReadFlag(false),
+          mLeaseRenewBatcherPtr(0),
+          mLayoutPrefetcher(*this)
         { Readers::Init(mReaders); }
     int Open(
         kfsFileId_t inFileId,
@@ -201,6 +312,7 @@ public:
         mErrorCode          = 0;
         mFileId             = inFileId;
         mFailShortReadsFlag = inFailShortReadsFlag;
+        mRecoveryReadFlag   = 0 <= inRecoverChunkPos;
         return 0;
     }
     int Close()
@@ -246,6 +358,7 @@ public:
         while (! Readers::IsEmpty(mReaders)) {
             delete Readers::Front(mReaders);
         }
+        mLayoutPrefetcher.Stop();
         mClosingFlag = false;
     }
     void Shutdown()
@@ -301,10 +414,93 @@ public:
         { return mErrorCode; }
     int GetReplicaCount() const
         { return mReplicaCount; }
+    void SetRecoveryHedgeTimeout(
+        int inTimeoutMs)
+        { mRecoveryHedgeTimeoutMs = inTimeoutMs; }
+    void SetHedgedReadParameters(
+        int inMinTimeoutMs,
+        int inPercentile,
+        int inMaxPercent)
+    {
+        mHedgedReadMinTimeoutMs = inMinTimeoutMs;
+        mHedgedReadPercentile   = max(0, min(100, inPercentile));
+        mHedgedReadMaxPercent   = max(0, min(100, inMaxPercent));
+    }
+    void SetECThreadPool(
+        ECThreadPool* inPoolPtr)
+        { mECThreadPoolPtr = inPoolPtr; }
+    void SetLatencyStats(
+        ChunkServerLatencyStats* inStatsPtr)
+        { mLatencyStatsPtr = inStatsPtr; }
+    void SetReplicaLocality(
+        ReplicaLocality* inLocalityPtr)
+        { mReplicaLocalityPtr = inLocalityPtr; }
+    void SetShortCircuitRead(
+        bool inFlag)
+        { mShortCircuitReadFlag = inFlag; }
+    void SetLeaseRenewBatcher(
+        LeaseRenewBatcher* inBatcherPtr)
+        { mLeaseRenewBatcherPtr = inBatcherPtr; }
 
 private:
     typedef KfsNetClient ChunkServer;
 
+    // Ring of the most recent chunk read latencies, used to compute hedged
+    // read timeout.
+    class ReadLatencies
+    {
+    public:
+        enum
+        {
+            kMaxSampleCount    = 64,
+            kMinSampleCount    = 16,
+            kRecomputeInterval = 8
+        };
+        ReadLatencies()
+            : mCount(0),
+              mNext(0),
+              mAddedCount(0),
+              mPercentile(-1),
+              mPercentileUsec(-1)
+            {}
+        void Add(
+            int64_t inUsec)
+        {
+            mSamples[mNext] = inUsec;
+            mNext = (mNext + 1) % kMaxSampleCount;
+            if (mCount < kMaxSampleCount) {
+                mCount++;
+            }
+            mAddedCount++;
+        }
+        int64_t GetPercentileUsec(
+            int inPercentile)
+        {
+            if (mCount < kMinSampleCount) {
+                return -1;
+            }
+            if (inPercentile != mPercentile || mPercentileUsec < 0 ||
+                    kRecomputeInterval <= mAddedCount) {
+                int64_t theSamples[kMaxSampleCount];
+                copy(mSamples, mSamples + mCount, theSamples);
+                const int theIdx = min(mCount - 1, mCount * inPercentile / 100);
+                nth_element(theSamples, theSamples + theIdx,
+                    theSamples + mCount);
+                mPercentileUsec = theSamples[theIdx];
+                mPercentile     = inPercentile;
+                mAddedCount     = 0;
+            }
+            return mPercentileUsec;
+        }
+    private:
+        int     mCount;
+        int     mNext;
+        int     mAddedCount;
+        int     mPercentile;
+        int64_t mPercentileUsec;
+        int64_t mSamples[kMaxSampleCount];
+    };
+
     class ChunkReader : private ITimeout, private KfsNetClient::OpOwner
     {
     public:
@@ -335,14 +531,19 @@ private:
             typedef vector<RequestEntry> Requests;
 
             time_t    mOpStartTime;
+            int64_t   mStartUsec;
             IOBuffer  mBuffer;
             IOBuffer  mTmpBuffer;
             RequestId mRequestId;
             RequestId mStriperRequestId;
             Requests  mRequests;
+            Offset    mCacheOffset;
+            int       mCacheSize;
             bool      mRetryIfFailsFlag;
             bool      mFailShortReadFlag;
             bool      mCancelFlag;
+            bool      mCacheHitFlag;
+            bool      mShortCircuitFlag;
 
             ReadOp(
                 int       inOpSize,
@@ -353,14 +554,19 @@ private:
                 bool      inFailShortReadFlag)
                 : KFS::client::ReadOp(-1, -1, -1),
                   mOpStartTime(0),
+                  mStartUsec(0),
                   mBuffer(),
                   mTmpBuffer(),
                   mRequestId(inRequestId),
                   mStriperRequestId(inStriperRequestId),
                   mRequests(),
+                  mCacheOffset(-1),
+                  mCacheSize(0),
                   mRetryIfFailsFlag(inRetryIfFailsFlag),
                   mFailShortReadFlag(inFailShortReadFlag),
-                  mCancelFlag(false)
+                  mCancelFlag(false),
+                  mCacheHitFlag(false),
+                  mShortCircuitFlag(false)
             {
                 Queue::Init(*this);
                 numBytes                   = inOpSize;
@@ -386,6 +592,23 @@ private:
             ReadOp& operator=(
                 const ReadOp& inOp);
         };
+        class HedgeTimer : public ITimeout
+        {
+        public:
+            HedgeTimer(
+                ChunkReader& inReader)
+                : ITimeout(),
+                  mReader(inReader),
+                  mRegisteredFlag(false)
+                {}
+            virtual void Timeout()
+                { mReader.HedgeTimeout(); }
+        private:
+            ChunkReader& mReader;
+            bool         mRegisteredFlag;
+
+            friend class ChunkReader;
+        };
 
         ChunkReader(
             Impl&         inOuter,
@@ -415,6 +638,24 @@ private:
                 ))
               ),
               mChunkServerPtr(0),
+              mHedgeServer(
+                inOuter.mNetManager,
+                string(), -1, // host, port
+                0, // inMaxRetryCount
+                0, // inTimeSecBetweenRetries,
+                inOuter.mOpTimeoutSec,
+                inOuter.mIdleTimeoutSec,
+                inSeqNum + 5000,
+                inLogPrefix.c_str(),
+                false, // inResetConnectionOnOpTimeoutFlag
+                int(min(
+                    int64_t(inOuter.mMaxReadSize) + (64 << 10),
+                    int64_t(std::numeric_limits<int>::max())
+                ))
+              ),
+              mHedgeServerPtr(0),
+              mHedgedOpPtr(0),
+              mHedgeTimer(*this),
               mErrorCode(0),
               mRetryCount(0),
               mOpenChunkBlockFileOffset(-1),
@@ -424,6 +665,11 @@ private:
               mLeaseRenewOp(0, -1, 0, ""),
               mLeaseRelinquishOp(0, -1, 0),
               mSizeOp(0, -1, 0),
+              mShortCircuitOp(0, -1, false),
+              mShortCircuitBuffer(),
+              mShortCircuitRead(),
+              mShortCircuitFailedChunkId(-1),
+              mShortCircuitFailedVersion(-1),
               mChunkServerAccess(),
               mChunkAccess(),
               mLastOpPtr(0),
@@ -441,6 +687,9 @@ private:
               mStartReadRunningFlag(false),
               mRestartStartReadFlag(false),
               mSizeOpInFlightFlag(false),
+              mShortCircuitInFlightFlag(false),
+              mLeaseRenewBatchFlag(false),
+              mCachedLocationFlag(false),
               mLeaseToRelinquish(-1),
               mLogPrefix(inLogPrefix),
               mOpsNoRetryCount(0),
@@ -450,9 +699,11 @@ private:
             Queue::Init(mPendingQueue);
             Queue::Init(mInFlightQueue);
             Queue::Init(mCompletionQueue);
+            Queue::Init(mHedgeQueue);
             Readers::Init(*this);
             Readers::PushFront(mOuter.mReaders, *this);
             mChunkServer.SetRetryConnectOnly(true);
+            mHedgeServer.SetRetryConnectOnly(true);
             mGetAllocOp.fileOffset  = -1;
             mGetAllocOp.chunkId     = -1;
             mLeaseAcquireOp.chunkId = -1;
@@ -467,6 +718,8 @@ private:
             ChunkServer::Stats theStats;
             mChunkServer.GetStats(theStats);
             mOuter.mChunkServersStats.Add(theStats);
+            mHedgeServer.GetStats(theStats);
+            mOuter.mChunkServersStats.Add(theStats);
             Readers::Remove(mOuter.mReaders, *this);
             if (mDeletedFlagPtr) {
                 *mDeletedFlagPtr = true;
@@ -770,6 +1023,10 @@ private:
         Impl&                mOuter;
         ChunkServer          mChunkServer;
         ChunkServer*         mChunkServerPtr;
+        ChunkServer          mHedgeServer;
+        ChunkServer*         mHedgeServerPtr;
+        ReadOp*              mHedgedOpPtr;
+        HedgeTimer           mHedgeTimer;
         int                  mErrorCode;
         int                  mRetryCount;
         Offset               mOpenChunkBlockFileOffset;
@@ -779,6 +1036,11 @@ private:
         LeaseRenewOp         mLeaseRenewOp;
         LeaseRelinquishOp    mLeaseRelinquishOp;
         SizeOp               mSizeOp;
+        GetChunkMetadataOp   mShortCircuitOp;
+        IOBuffer             mShortCircuitBuffer;
+        ShortCircuitRead     mShortCircuitRead;
+        kfsChunkId_t         mShortCircuitFailedChunkId;
+        int64_t              mShortCircuitFailedVersion;
         ChunkServerAccess    mChunkServerAccess;
         ChunkServerAccess    mChunkAccess;
         KfsOp*               mLastOpPtr;
@@ -796,6 +1058,9 @@ private:
         bool                 mStartReadRunningFlag;
         bool                 mRestartStartReadFlag;
         bool                 mSizeOpInFlightFlag;
+        bool                 mShortCircuitInFlightFlag;
+        bool                 mLeaseRenewBatchFlag;
+        bool                 mCachedLocationFlag;
         int64_t              mLeaseToRelinquish;
         string const         mLogPrefix;
         int                  mOpsNoRetryCount;
@@ -804,6 +1069,7 @@ private:
         ReadOp*              mPendingQueue[1];
         ReadOp*              mInFlightQueue[1];
         ReadOp*              mCompletionQueue[1];
+        ReadOp*              mHedgeQueue[1];
         ChunkReader*         mPrevPtr[1];
         ChunkReader*         mNextPtr[1];
 
@@ -827,7 +1093,9 @@ private:
             if (! mLastMetaOpPtr) {
                 return;
             }
-            if (! mOuter.mMetaServer.Cancel(mLastMetaOpPtr, this)) {
+            if (! (mLeaseRenewBatchFlag && mLastMetaOpPtr == &mLeaseRenewOp ?
+                    mOuter.mLeaseRenewBatcherPtr->Cancel(mLeaseRenewOp, *this) :
+                    mOuter.mMetaServer.Cancel(mLastMetaOpPtr, this))) {
                 mOuter.InternalError("failed to cancel meta op");
             }
             mLastMetaOpPtr = 0;
@@ -993,6 +1261,13 @@ private:
                 }
                 return;
             }
+            if (mShortCircuitInFlightFlag) {
+                return;
+            }
+            if (ShouldGetShortCircuit()) {
+                GetShortCircuit();
+                return;
+            }
             Queue::Iterator theIt(mPendingQueue);
             ReadOp* theOpPtr;
             while ( ! mRestartStartReadFlag &&
@@ -1012,6 +1287,30 @@ private:
             Reset(mGetAllocOp);
             mGetAllocOp.chunkServers.clear();
             mGetAllocOp.serversOrderedFlag = false;
+            if (! mGetAllocOp.objectStoreFlag &&
+                    mOuter.mLayoutPrefetcher.Get(mGetAllocOp)) {
+                KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+                    "prefetched: " << mGetAllocOp.Show() <<
+                KFS_LOG_EOM;
+                Done(mGetAllocOp, false, 0);
+                return;
+            }
+            if (! mGetAllocOp.objectStoreFlag && mOuter.mLocationCachePtr &&
+                    mOuter.mLocationCachePtr->Get(
+                        mGetAllocOp.fid,
+                        mGetAllocOp.fileOffset,
+                        Now(),
+                        mGetAllocOp.chunkId,
+                        mGetAllocOp.chunkVersion,
+                        mGetAllocOp.serversOrderedFlag,
+                        mGetAllocOp.chunkServers)) {
+                KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+                    "cached: " << mGetAllocOp.Show() <<
+                KFS_LOG_EOM;
+                mCachedLocationFlag = true;
+                Done(mGetAllocOp, false, 0);
+                return;
+            }
             EnqueueMeta(mGetAllocOp);
         }
         void Done(
@@ -1034,13 +1333,39 @@ private:
                 HandleError(inOp);
                 return;
             }
+            if (mCachedLocationFlag) {
+                // Do not extend cached entry life time.
+                mCachedLocationFlag = false;
+            } else if (! mGetAllocOp.objectStoreFlag &&
+                    mOuter.mLocationCachePtr) {
+                mOuter.mLocationCachePtr->Put(
+                    mGetAllocOp.fid,
+                    mGetAllocOp.fileOffset,
+                    Now(),
+                    mGetAllocOp.chunkId,
+                    mGetAllocOp.chunkVersion,
+                    mGetAllocOp.serversOrderedFlag,
+                    mGetAllocOp.chunkServers
+                );
+            }
             if (! mGetAllocOp.serversOrderedFlag) {
                 random_shuffle(
                     mGetAllocOp.chunkServers.begin(),
                     mGetAllocOp.chunkServers.end()
                 );
             }
+            if (mOuter.mReplicaLocalityPtr) {
+                // Retries and hedged reads follow the list order. Keep the
+                // meta server order within the same locality.
+                mOuter.mReplicaLocalityPtr->Order(
+                    mGetAllocOp.chunkServers,
+                    mGetAllocOp.serversOrderedFlag
+                );
+            }
             mChunkServerIdx = 0;
+            if (! mGetAllocOp.objectStoreFlag && ! mClosingFlag) {
+                mOuter.mLayoutPrefetcher.Prefetch(mGetAllocOp.fileOffset);
+            }
             StartRead();
         }
         void GetLease()
@@ -1163,6 +1488,13 @@ private:
             mLeaseRenewOp.allowCSClearTextFlag          = false;
             mLeaseExpireTime = theNow + LEASE_INTERVAL_SECS;
             mLeaseRenewTime  = theNow + (LEASE_INTERVAL_SECS + 1) / 2;
+            // The batch renew returns no chunk access.
+            mLeaseRenewBatchFlag = mOuter.mLeaseRenewBatcherPtr &&
+                ! mOuter.IsAuthEnabled() &&
+                ! mLeaseRenewOp.getCSAccessFlag &&
+                mSizeOp.access.empty() &&
+                mChunkServerAccess.IsEmpty() &&
+                mChunkAccess.IsEmpty();
             EnqueueMeta(mLeaseRenewOp);
         }
         void Done(
@@ -1274,6 +1606,8 @@ private:
                 mSizeOp.size >= 0
             );
             Reset(inReadOp);
+            RestoreCacheRange(inReadOp);
+            inReadOp.mShortCircuitFlag = false;
             inReadOp.mTmpBuffer.Clear();
             // Use tmp buffer until the op passes checksum verification to use
             // the same buffers with retries.
@@ -1282,6 +1616,7 @@ private:
             inReadOp.chunkId      = mGetAllocOp.chunkId;
             inReadOp.chunkVersion = mGetAllocOp.chunkVersion;
             inReadOp.mOpStartTime = Now();
+            inReadOp.mStartUsec   = microseconds();
             Queue::Remove(mPendingQueue, inReadOp);
             Queue::PushBack(mInFlightQueue, inReadOp);
             if (inReadOp.offset >= mSizeOp.size) {
@@ -1292,8 +1627,16 @@ private:
                 Done(inReadOp, false, &inReadOp.mTmpBuffer);
                 return;
             }
-            inReadOp.access = mSizeOp.access;
+            if (mOuter.mBlockCachePtr && ReadFromCache(inReadOp)) {
+                return;
+            }
+            if (ReadShortCircuit(inReadOp)) {
+                return;
+            }
+            inReadOp.access              = mSizeOp.access;
+            inReadOp.replicationReadFlag = mOuter.mRecoveryReadFlag;
             mOuter.mStats.mOpsReadCount++;
+            ScheduleHedge();
             Enqueue(inReadOp, &inReadOp.mTmpBuffer);
         }
         void Done(
@@ -1305,18 +1648,30 @@ private:
                 inBufferPtr == &inOp.mTmpBuffer &&
                 Queue::IsInList(mInFlightQueue, inOp)
             );
+            if (&inOp == mHedgedOpPtr) {
+                CancelHedge();
+            }
             if (inOp.status == kErrorNoEntry &&
                     mGetAllocOp.status != kErrorNoEntry) {
                 inOp.status = kErrorIO;
             }
-            if (inCanceledFlag || inOp.status < 0 || ! VerifyChecksum(inOp) ||
-                    ! VerifyRead(inOp)) {
+            // Short circuit reads are verified against the chunk checksums.
+            const bool theLocalFlag =
+                inOp.mCacheHitFlag || inOp.mShortCircuitFlag;
+            if (inCanceledFlag || inOp.status < 0 || (! theLocalFlag &&
+                    (! VerifyChecksum(inOp) || ! VerifyRead(inOp)))) {
                 Queue::Remove(mInFlightQueue, inOp);
                 Queue::PushBack(mPendingQueue, inOp);
                 inOp.mTmpBuffer.Clear();
+                RestoreCacheRange(inOp);
                 if (inCanceledFlag) {
                     return;
                 }
+                if (mOuter.mLatencyStatsPtr) {
+                    mOuter.mLatencyStatsPtr->AddRetry(
+                        ChunkServerLatencyStats::kOpTypeRead,
+                        GetChunkServer().GetServerLocation());
+                }
                 Monitor::ReportError(
                         Monitor::kReadOpError,
                         mOuter.mMetaServer.GetServerLocation(),
@@ -1334,6 +1689,9 @@ private:
                 }
                 return;
             }
+            if (0 < inOp.mCacheSize) {
+                CacheReadDone(inOp);
+            }
             const int theDoneCount = (int)inOp.contentLength;
             QCASSERT(
                 theDoneCount >= 0 &&
@@ -1342,6 +1700,24 @@ private:
             );
             mOuter.mStats.mReadCount++;
             mOuter.mStats.mReadByteCount += theDoneCount;
+            if (! theLocalFlag && (mOuter.IsHedgedReadEnabled() ||
+                    mOuter.mLatencyStatsPtr || mOuter.mReplicaLocalityPtr)) {
+                const int64_t theUsec = microseconds() - inOp.mStartUsec;
+                if (mOuter.IsHedgedReadEnabled()) {
+                    mOuter.mReadLatencies.Add(theUsec);
+                }
+                if (mOuter.mReplicaLocalityPtr) {
+                    mOuter.mReplicaLocalityPtr->AddReadLatency(
+                        GetChunkServer().GetServerLocation(),
+                        theUsec);
+                }
+                if (mOuter.mLatencyStatsPtr) {
+                    mOuter.mLatencyStatsPtr->Add(
+                        ChunkServerLatencyStats::kOpTypeRead,
+                        GetChunkServer().GetServerLocation(),
+                        theUsec);
+                }
+            }
             if (theDoneCount < inOp.mTmpBuffer.BytesConsumable()) {
                 // Move available space, if any, to the end of the short read.
                 IOBuffer theBuf;
@@ -1358,6 +1734,208 @@ private:
                 StartRead();
             }
         }
+        bool ReadFromCache(
+            ReadOp& inOp)
+        {
+            ChunkBlockCache& theCache   = *mOuter.mBlockCachePtr;
+            const Offset     kBlockSize = (Offset)CHECKSUM_BLOCKSIZE;
+            const Offset     theEnd     = inOp.offset + (Offset)inOp.numBytes;
+            const Offset     theStart   = inOp.offset - inOp.offset % kBlockSize;
+            Offset           theBlkEnd  = min((Offset)CHUNKSIZE,
+                (theEnd + kBlockSize - 1) / kBlockSize * kBlockSize);
+            if ((Offset)min(theCache.GetMaxReadSize(), mOuter.mMaxReadSize) <
+                    theBlkEnd - theStart) {
+                return false;
+            }
+            if (theEnd <= mSizeOp.size && theCache.Get(
+                    inOp.chunkId,
+                    inOp.chunkVersion,
+                    inOp.offset,
+                    (int)inOp.numBytes,
+                    inOp.mTmpBuffer)) {
+                inOp.status        = 0;
+                inOp.contentLength = inOp.numBytes;
+                inOp.mCacheHitFlag = true;
+                inOp.checksums.clear();
+                Done(inOp, false, &inOp.mTmpBuffer);
+                return true;
+            }
+            // Read whole checksum blocks into the buffers that do not belong
+            // to the caller, in order to cache the blocks, and share the
+            // blocks with the reads of the adjacent ranges. Do not extend past
+            // the chunk size, in order to detect short reads the same way as
+            // without cache.
+            if (mSizeOp.size < theBlkEnd) {
+                theBlkEnd = max(theEnd, mSizeOp.size);
+            }
+            inOp.mCacheOffset = inOp.offset;
+            inOp.mCacheSize   = (int)inOp.numBytes;
+            inOp.offset       = theStart;
+            inOp.numBytes     = (size_t)(theBlkEnd - theStart);
+            inOp.mTmpBuffer.Clear();
+            return false;
+        }
+        bool ShouldGetShortCircuit() const
+        {
+            if (! mOuter.mShortCircuitReadFlag ||
+                    ! mOuter.mReplicaLocalityPtr ||
+                    mGetAllocOp.chunkVersion < 0 ||
+                    mGetAllocOp.chunkServers.size() <= mChunkServerIdx ||
+                    mNoCSAccessFlag ||
+                    (mShortCircuitFailedChunkId == mGetAllocOp.chunkId &&
+                        mShortCircuitFailedVersion ==
+                            mGetAllocOp.chunkVersion) ||
+                    mShortCircuitRead.IsOpen(
+                        mGetAllocOp.chunkId,
+                        mGetAllocOp.chunkVersion,
+                        Now())) {
+                return false;
+            }
+            return (mOuter.mReplicaLocalityPtr->GetLocality(
+                    mGetAllocOp.chunkServers[mChunkServerIdx]) ==
+                ReplicaLocality::kLocalityHost);
+        }
+        void GetShortCircuit()
+        {
+            QCASSERT(! mShortCircuitInFlightFlag && 0 <= mSizeOp.size);
+            mShortCircuitRead.Close();
+            Reset(mShortCircuitOp);
+            mShortCircuitOp.chunkId          = mGetAllocOp.chunkId;
+            mShortCircuitOp.chunkVersion     = mGetAllocOp.chunkVersion;
+            mShortCircuitOp.access           = mSizeOp.access;
+            mShortCircuitOp.shortCircuitFlag = true;
+            mShortCircuitOp.shortCircuitId   = -1;
+            mShortCircuitBuffer.Clear();
+            mShortCircuitInFlightFlag = true;
+            Enqueue(mShortCircuitOp, &mShortCircuitBuffer);
+        }
+        void Done(
+            GetChunkMetadataOp& inOp,
+            bool                inCanceledFlag,
+            IOBuffer*           inBufferPtr)
+        {
+            QCASSERT(&mShortCircuitOp == &inOp &&
+                &mShortCircuitBuffer == inBufferPtr &&
+                mShortCircuitInFlightFlag);
+            mShortCircuitInFlightFlag = false;
+            if (inCanceledFlag) {
+                mShortCircuitBuffer.Clear();
+                return;
+            }
+            int theStatus = inOp.status;
+            if (0 <= theStatus) {
+                theStatus = (inOp.shortCircuitId <= 0 ||
+                        inOp.chunkId != mGetAllocOp.chunkId ||
+                        inOp.chunkVersion != mGetAllocOp.chunkVersion) ?
+                    -ENOTSUP :
+                    mShortCircuitRead.Open(
+                        inOp.shortCircuitSocket,
+                        inOp.shortCircuitId,
+                        inOp.chunkId,
+                        inOp.chunkVersion,
+                        inOp.shortCircuitOffset,
+                        inOp.shortCircuitLeaseSec,
+                        Now(),
+                        mShortCircuitBuffer
+                    );
+            }
+            mShortCircuitBuffer.Clear();
+            if (theStatus < 0) {
+                // Do not retry with this chunk, read through the chunk server.
+                mShortCircuitFailedChunkId = inOp.chunkId;
+                mShortCircuitFailedVersion = mGetAllocOp.chunkVersion;
+                mOuter.mStats.mShortCircuitErrorsCount++;
+            }
+            KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+                "short circuit:"
+                " chunk: "  << inOp.chunkId <<
+                " socket: " << inOp.shortCircuitSocket <<
+                " status: " << theStatus <<
+                " "         << inOp.statusMsg <<
+            KFS_LOG_EOM;
+            StartRead();
+        }
+        bool ReadShortCircuit(
+            ReadOp& inOp)
+        {
+            if (! mShortCircuitRead.IsOpen(
+                    inOp.chunkId, inOp.chunkVersion, Now())) {
+                return false;
+            }
+            const int theRet = mShortCircuitRead.Read(
+                inOp.offset,
+                (int)inOp.numBytes,
+                mSizeOp.size,
+                inOp.mTmpBuffer
+            );
+            if (theRet <= 0) {
+                if (theRet < 0) {
+                    KFS_LOG_STREAM_ERROR << mLogPrefix <<
+                        "short circuit read:"
+                        " chunk: "  << inOp.chunkId <<
+                        " offset: " << inOp.offset <<
+                        " size: "   << inOp.numBytes <<
+                        " error: "  << ErrorCodeToStr(theRet) <<
+                        " reading through chunk server" <<
+                    KFS_LOG_EOM;
+                    mShortCircuitRead.Close();
+                    mShortCircuitFailedChunkId = inOp.chunkId;
+                    mShortCircuitFailedVersion = inOp.chunkVersion;
+                    mOuter.mStats.mShortCircuitErrorsCount++;
+                }
+                return false;
+            }
+            inOp.status            = 0;
+            inOp.contentLength     = (size_t)theRet;
+            inOp.mShortCircuitFlag = true;
+            inOp.checksums.clear();
+            mOuter.mStats.mShortCircuitReadCount++;
+            mOuter.mStats.mShortCircuitReadByteCount += theRet;
+            Done(inOp, false, &inOp.mTmpBuffer);
+            return true;
+        }
+        void CacheReadDone(
+            ReadOp& inOp)
+        {
+            QCASSERT(mOuter.mBlockCachePtr && 0 < inOp.mCacheSize &&
+                inOp.offset <= inOp.mCacheOffset);
+            mOuter.mBlockCachePtr->Put(
+                inOp.chunkId,
+                inOp.chunkVersion,
+                inOp.offset,
+                inOp.mTmpBuffer,
+                (int)inOp.contentLength
+            );
+            const int theSkip = (int)(inOp.mCacheOffset - inOp.offset);
+            const int theLen  = max(0,
+                min((int)inOp.contentLength - theSkip, inOp.mCacheSize));
+            IOBuffer theBuf;
+            theBuf.Move(&inOp.mTmpBuffer);
+            theBuf.Consume(theSkip);
+            RestoreCacheRange(inOp);
+            inOp.contentLength = (size_t)theLen;
+            inOp.mTmpBuffer.UseSpaceAvailable(&inOp.mBuffer, theLen);
+            int theRem = theLen;
+            for (IOBuffer::iterator theIt = theBuf.begin();
+                    0 < theRem && theIt != theBuf.end();
+                    ++theIt) {
+                const int theCnt = min(theRem, theIt->BytesConsumable());
+                inOp.mTmpBuffer.CopyIn(theIt->Consumer(), theCnt);
+                theRem -= theCnt;
+            }
+        }
+        void RestoreCacheRange(
+            ReadOp& inOp)
+        {
+            inOp.mCacheHitFlag = false;
+            if (inOp.mCacheSize <= 0) {
+                return;
+            }
+            inOp.offset       = inOp.mCacheOffset;
+            inOp.numBytes     = (size_t)inOp.mCacheSize;
+            inOp.mCacheOffset = -1;
+            inOp.mCacheSize   = 0;
+        }
         bool ReportCompletion(
             ReadOp&  inOp,
             ReadOp** inQueuePtr)
@@ -1495,8 +2073,9 @@ private:
                 inOp.statusMsg = "received checksum mismatch";
                 return false;
             }
-            vector<uint32_t> const theChecksums =
-                    ComputeChecksums(&inOp.mTmpBuffer, inOp.contentLength);
+            vector<uint32_t> theChecksums;
+            mOuter.ComputeReadChecksums(
+                inOp.mTmpBuffer, inOp.contentLength, theChecksums);
             if (theChecksums == inOp.checksums) {
                 return true;
             }
@@ -1686,6 +2265,10 @@ private:
                 Done(mLeaseRelinquishOp, inCanceledFlag, inBufferPtr);
             } else if (&mSizeOp == inOpPtr) {
                 Done(mSizeOp, inCanceledFlag, inBufferPtr);
+            } else if (&mShortCircuitOp == inOpPtr) {
+                Done(mShortCircuitOp, inCanceledFlag, inBufferPtr);
+            } else if (inOpPtr && inOpPtr == Queue::Front(mHedgeQueue)) {
+                HedgeDone(*static_cast<ReadOp*>(inOpPtr), inCanceledFlag);
             } else if (inOpPtr && inOpPtr->op == CMD_READ) {
                 Done(*static_cast<ReadOp*>(inOpPtr),
                     inCanceledFlag, inBufferPtr);
@@ -1716,6 +2299,7 @@ private:
             mLastOpPtr = 0;
             StopChunkServer();
             mChunkServerSetFlag = false;
+            mShortCircuitRead.Close();
             QCASSERT(Queue::IsEmpty(mInFlightQueue));
             if (mSleepingFlag) {
                 mOuter.mNetManager.UnRegisterTimeoutHandler(this);
@@ -1804,6 +2388,9 @@ private:
                         mOuter.mStats.mReadChecksumErrorsCount++;
                     }
                 }
+                if (inOp.status == -EBADVERS) {
+                    InvalidateCachedLocation();
+                }
                 bool thePossibleDiskCheckusmErrorFlag = false;
                 if (inOp.op == CMD_READ && inOp.status == kErrorChecksum) {
                     ReadOp& theReadOp = static_cast<ReadOp&>(inOp);
@@ -1827,6 +2414,7 @@ private:
                             mRetryCount++;
                             // Restart from get alloc, chunk might have been
                             // moved or re-replicated.
+                            InvalidateCachedLocation();
                             mGetAllocOp.status  = 0;
                             mGetAllocOp.chunkId = -1;
                             if (mNoCSAccessFlag ||
@@ -1897,6 +2485,13 @@ private:
                Timeout();
             }
         }
+        void InvalidateCachedLocation()
+        {
+            if (mOuter.mLocationCachePtr && 0 <= mGetAllocOp.fileOffset) {
+                mOuter.mLocationCachePtr->Invalidate(
+                    mGetAllocOp.fid, mGetAllocOp.fileOffset);
+            }
+        }
         bool ReportCompletionForPendingWithNoRetryOnly(
             int inStatus,
             int inLastError)
@@ -2031,8 +2626,17 @@ private:
                 mLastMetaOpPtr = &inOp;
                 mOuter.mStats.mMetaOpsQueuedCount++;
             }
-            if (! (inServerPtr ? *inServerPtr : mOuter.mMetaServer).Enqueue(
-                    &inOp, this, inBufferPtr)) {
+            bool theOkFlag;
+            if (inServerPtr) {
+                theOkFlag = inServerPtr->Enqueue(&inOp, this, inBufferPtr);
+            } else if (mLeaseRenewBatchFlag && &inOp == &mLeaseRenewOp) {
+                theOkFlag = mOuter.mLeaseRenewBatcherPtr->Enqueue(
+                    mLeaseRenewOp, *this);
+            } else {
+                theOkFlag = mOuter.mMetaServer.Enqueue(
+                    &inOp, this, inBufferPtr);
+            }
+            if (! theOkFlag) {
                 mOuter.InternalError(inServerPtr ?
                     "chunk op enqueue failure" :
                     "meta op enqueue failure"
@@ -2138,6 +2742,8 @@ private:
         }
         void StopChunkServer()
         {
+            CancelHedge();
+            UnregisterHedgeTimer();
             if (&mChunkServer == mChunkServerPtr) {
                 mChunkServer.Stop();
                 return;
@@ -2148,6 +2754,9 @@ private:
             if (mSizeOpInFlightFlag) {
                 mChunkServerPtr->Cancel(&mSizeOp, this);
             }
+            if (mShortCircuitInFlightFlag) {
+                mChunkServerPtr->Cancel(&mShortCircuitOp, this);
+            }
             if (! Queue::IsEmpty(mInFlightQueue)) {
                 mChunkServerPtr->CancelAllWithOwner(this);
             }
@@ -2160,6 +2769,182 @@ private:
         {
             return GetChunkServer().WasDisconnected();
         }
+        bool CanHedge() const
+        {
+            // Hedge only with no chunk server access, as access tokens are
+            // per chunk server.
+            return (
+                mOuter.IsHedgedReadEnabled() &&
+                ! mHedgedOpPtr &&
+                mChunkServerPtr &&
+                ! mNoCSAccessFlag &&
+                mChunkServerAccess.IsEmpty() &&
+                1 < mGetAllocOp.chunkServers.size()
+            );
+        }
+        void ScheduleHedge()
+        {
+            if (mHedgeTimer.mRegisteredFlag || ! CanHedge()) {
+                return;
+            }
+            mHedgeTimer.SetTimeoutInterval(
+                mOuter.GetHedgedReadTimeoutMs(), true);
+            mOuter.mNetManager.RegisterTimeoutHandler(&mHedgeTimer);
+            mHedgeTimer.mRegisteredFlag = true;
+        }
+        void UnregisterHedgeTimer()
+        {
+            if (mHedgeTimer.mRegisteredFlag) {
+                mOuter.mNetManager.UnRegisterTimeoutHandler(&mHedgeTimer);
+                mHedgeTimer.mRegisteredFlag = false;
+            }
+        }
+        void HedgeTimeout()
+        {
+            UnregisterHedgeTimer();
+            // The oldest in flight read is at the front of the queue.
+            ReadOp* const theOpPtr = Queue::Front(mInFlightQueue);
+            if (! theOpPtr || ! CanHedge()) {
+                return;
+            }
+            const int     theTimeoutMs = mOuter.GetHedgedReadTimeoutMs();
+            const int64_t theElapsedMs =
+                (microseconds() - theOpPtr->mStartUsec) / 1000;
+            if (theElapsedMs < theTimeoutMs) {
+                mHedgeTimer.SetTimeoutInterval(
+                    (int)(theTimeoutMs - theElapsedMs), true);
+                mOuter.mNetManager.RegisterTimeoutHandler(&mHedgeTimer);
+                mHedgeTimer.mRegisteredFlag = true;
+                return;
+            }
+            if (! mOuter.CanStartHedgedRead()) {
+                return;
+            }
+            StartHedge(*theOpPtr);
+        }
+        void StartHedge(
+            ReadOp& inOp)
+        {
+            QCASSERT(Queue::IsEmpty(mHedgeQueue) && ! mHedgedOpPtr);
+            const ServerLocation& theLocation = mGetAllocOp.chunkServers[
+                (mChunkServerIdx + 1) % mGetAllocOp.chunkServers.size()];
+            if (mOuter.mClientPoolPtr) {
+                mHedgeServerPtr = &mOuter.mClientPoolPtr->Get(theLocation);
+            } else {
+                mHedgeServerPtr = &mHedgeServer;
+                mHedgeServer.SetServer(theLocation);
+            }
+            if (mHedgeServerPtr == mChunkServerPtr) {
+                return;
+            }
+            mHedgeServerPtr->SetShutdownSsl(mChunkServerPtr->IsShutdownSsl());
+            mHedgeServerPtr->SetKey(0, 0, 0, 0);
+            mHedgeServerPtr->SetAuthContext(0);
+            ReadOp& theOp = *(new ReadOp(
+                (int)inOp.numBytes,
+                inOp.offset,
+                RequestId(),
+                RequestId(),
+                true,
+                inOp.mFailShortReadFlag
+            ));
+            theOp.chunkId             = inOp.chunkId;
+            theOp.chunkVersion        = inOp.chunkVersion;
+            theOp.replicationReadFlag = inOp.replicationReadFlag;
+            theOp.mOpStartTime        = Now();
+            theOp.mStartUsec          = microseconds();
+            Queue::PushBack(mHedgeQueue, theOp);
+            mHedgedOpPtr = &inOp;
+            mOuter.mStats.mHedgedReadCount++;
+            mOuter.mStats.mChunkOpsQueuedCount++;
+            KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+                "+> hedge " << theOp.Show() <<
+                " server: "  << theLocation <<
+                " primary: " << GetChunkServer().GetServerLocation() <<
+                " elapsed: " << (theOp.mStartUsec - inOp.mStartUsec) <<
+                " usec" <<
+            KFS_LOG_EOM;
+            if (! mHedgeServerPtr->Enqueue(&theOp, this, &theOp.mTmpBuffer)) {
+                mOuter.InternalError("hedged read enqueue failure");
+            }
+        }
+        void CancelHedge()
+        {
+            mHedgedOpPtr = 0;
+            ReadOp* const theOpPtr = Queue::Front(mHedgeQueue);
+            if (! theOpPtr) {
+                return;
+            }
+            if (mHedgeServerPtr) {
+                // Cancel invokes HedgeDone(), which deletes the op.
+                mHedgeServerPtr->Cancel(theOpPtr, this);
+            }
+            if (theOpPtr == Queue::Front(mHedgeQueue)) {
+                theOpPtr->Delete(mHedgeQueue);
+            }
+        }
+        void HedgeDone(
+            ReadOp& inOp,
+            bool    inCanceledFlag)
+        {
+            ReadOp* const thePrimaryPtr = mHedgedOpPtr;
+            mHedgedOpPtr = 0;
+            // Use only complete reads, let the primary read handle the rest.
+            if (inCanceledFlag || ! thePrimaryPtr || inOp.status < 0 ||
+                    inOp.contentLength != inOp.numBytes ||
+                    inOp.mTmpBuffer.BytesConsumable() !=
+                        (int)inOp.contentLength ||
+                    ! VerifyChecksum(inOp)) {
+                if (! inCanceledFlag && thePrimaryPtr) {
+                    mOuter.mStats.mHedgedReadErrorsCount++;
+                    KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+                        "hedged read failure: " << inOp.Show() <<
+                        " status: " << inOp.status <<
+                        " "         << inOp.statusMsg <<
+                        " length: " << inOp.contentLength <<
+                    KFS_LOG_EOM;
+                }
+                inOp.Delete(mHedgeQueue);
+                return;
+            }
+            ReadOp& thePrimary = *thePrimaryPtr;
+            QCASSERT(Queue::IsInList(mInFlightQueue, thePrimary));
+            mOuter.mStats.mHedgedReadWinCount++;
+            KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+                "hedged read done: " << inOp.Show() <<
+                " usec: " << (microseconds() - inOp.mStartUsec) <<
+            KFS_LOG_EOM;
+            // Cancel moves the primary read into the pending queue. Move it
+            // back, and complete it with the hedged read data.
+            GetChunkServer().Cancel(&thePrimary, this);
+            if (! Queue::IsInList(mPendingQueue, thePrimary)) {
+                inOp.Delete(mHedgeQueue);
+                return;
+            }
+            Queue::Remove(mPendingQueue, thePrimary);
+            Queue::PushBack(mInFlightQueue, thePrimary);
+            thePrimary.status        = inOp.status;
+            thePrimary.contentLength = inOp.contentLength;
+            thePrimary.statusMsg.swap(inOp.statusMsg);
+            thePrimary.checksums.swap(inOp.checksums);
+            thePrimary.mTmpBuffer.Clear();
+            if (0 < thePrimary.mCacheSize) {
+                // Block cache read, the buffer data must not reside in the
+                // caller's buffer.
+                thePrimary.mTmpBuffer.Move(&inOp.mTmpBuffer);
+            } else {
+                thePrimary.mTmpBuffer.UseSpaceAvailable(
+                    &thePrimary.mBuffer, (int)thePrimary.numBytes);
+                for (IOBuffer::iterator theIt = inOp.mTmpBuffer.begin();
+                        theIt != inOp.mTmpBuffer.end();
+                        ++theIt) {
+                    thePrimary.mTmpBuffer.CopyIn(
+                        theIt->Consumer(), theIt->BytesConsumable());
+                }
+            }
+            inOp.Delete(mHedgeQueue);
+            Done(thePrimary, false, &thePrimary.mTmpBuffer);
+        }
     private:
         ChunkReader(
             const ChunkReader& inChunkReader);
@@ -2195,8 +2980,189 @@ private:
         ReportInvalidChunkOp& operator=(
             const ReportInvalidChunkOp& inOp);
     };
+    // Chunk locations prefetch. With sequential reads the locations of the
+    // chunks past the chunk being read are retrieved ahead with a single get
+    // layout request, in order to avoid meta server round trip at every chunk
+    // boundary. Each prefetched location is used at most once, the chunk
+    // reader retries obtain the location with get alloc.
+    class LayoutPrefetcher : private KfsNetClient::OpOwner
+    {
+    public:
+        enum { kChunkCount = 8 };
+
+        LayoutPrefetcher(
+            Impl& inOuter)
+            : KfsNetClient::OpOwner(),
+              mOuter(inOuter),
+              mOp(0, -1),
+              mChunks(),
+              mEnd(-1),
+              mInFlightFlag(false)
+            {}
+        ~LayoutPrefetcher()
+            { LayoutPrefetcher::Stop(); }
+        bool Get(
+            GetAllocOp& ioOp)
+        {
+            Chunks::iterator const theIt = mChunks.find(ioOp.fileOffset);
+            if (theIt == mChunks.end()) {
+                return false;
+            }
+            Entry&     theEntry     = theIt->second;
+            const bool theValidFlag = mOuter.mNetManager.Now() <
+                theEntry.mExpirationTime;
+            if (theValidFlag) {
+                ioOp.status             = 0;
+                ioOp.chunkId            = theEntry.mInfo.chunkId;
+                ioOp.chunkVersion       = theEntry.mInfo.chunkVersion;
+                ioOp.serversOrderedFlag = theEntry.mServersOrderedFlag;
+                ioOp.chunkServers.swap(theEntry.mInfo.chunkServers);
+            }
+            mChunks.erase(theIt);
+            return theValidFlag;
+        }
+        void Prefetch(
+            Offset inChunkOffset)
+        {
+            if (mInFlightFlag || mOuter.mFileId <= 0 ||
+                    mOuter.mReplicaCount == 0) {
+                return;
+            }
+            const Offset kChunkSize = (Offset)CHUNKSIZE;
+            // Discard the chunks behind the read position.
+            mChunks.erase(mChunks.begin(), mChunks.lower_bound(inChunkOffset));
+            if (mEnd <= inChunkOffset ||
+                    inChunkOffset + (kChunkCount + 1) * kChunkSize < mEnd) {
+                // Not sequential, restart from the next chunk.
+                mEnd = inChunkOffset + kChunkSize;
+            }
+            if (inChunkOffset + kChunkCount / 2 * kChunkSize < mEnd) {
+                return; // Enough chunks ahead.
+            }
+            Reset(mOp);
+            mOp.fid                      = mOuter.mFileId;
+            mOp.startOffset              = mEnd;
+            mOp.maxChunks                = kChunkCount;
+            mOp.continueIfNoReplicasFlag = true;
+            mOp.orderReplicasFlag        = true;
+            mOp.hasMoreChunksFlag        = false;
+            mOp.serversOrderedFlag       = false;
+            mOp.chunks.clear();
+            mEnd += kChunkCount * kChunkSize;
+            mInFlightFlag = true;
+            mOuter.mStats.mMetaOpsQueuedCount++;
+            KFS_LOG_STREAM_DEBUG << mOuter.mLogPrefix <<
+                "+> meta " << mOp.Show() <<
+                " start: " << mOp.startOffset <<
+            KFS_LOG_EOM;
+            if (! mOuter.mMetaServer.Enqueue(&mOp, this)) {
+                mInFlightFlag = false;
+                mEnd          = -1;
+            }
+        }
+        void Stop()
+        {
+            if (mInFlightFlag) {
+                mOuter.mMetaServer.Cancel(&mOp, this);
+                mInFlightFlag = false;
+            }
+            mChunks.clear();
+            mEnd = -1;
+        }
+    private:
+        struct Entry
+        {
+            Entry()
+                : mExpirationTime(0),
+                  mServersOrderedFlag(false),
+                  mInfo()
+                {}
+            time_t          mExpirationTime;
+            bool            mServersOrderedFlag;
+            ChunkLayoutInfo mInfo;
+        };
+        typedef map<Offset, Entry> Chunks;
+
+        Impl&       mOuter;
+        GetLayoutOp mOp;
+        Chunks      mChunks;
+        Offset      mEnd;
+        bool        mInFlightFlag;
+
+        virtual void OpDone(
+            KfsOp*    inOpPtr,
+            bool      inCanceledFlag,
+            IOBuffer* inBufferPtr)
+        {
+            QCRTASSERT(inOpPtr == &mOp && ! inBufferPtr);
+            mInFlightFlag = false;
+            if (inCanceledFlag) {
+                mOuter.mStats.mMetaOpsCancelledCount++;
+                return;
+            }
+            KFS_LOG_STREAM_DEBUG << mOuter.mLogPrefix <<
+                "<- meta " << mOp.Show() <<
+                " status: " << mOp.status <<
+                " msg: "    << mOp.statusMsg <<
+                " chunks: " << mOp.numChunks <<
+            KFS_LOG_EOM;
+            if (mOp.status < 0 || mOp.ParseLayoutInfo() != 0) {
+                mEnd = -1;
+                return;
+            }
+            const time_t theExpirationTime =
+                mOuter.mNetManager.Now() + mOuter.mOpTimeoutSec;
+            for (vector<ChunkLayoutInfo>::iterator theIt = mOp.chunks.begin();
+                    theIt != mOp.chunks.end();
+                    ++theIt) {
+                if (theIt->chunkId <= 0 || theIt->chunkServers.empty()) {
+                    continue;
+                }
+                if (mOuter.mLocationCachePtr) {
+                    mOuter.mLocationCachePtr->Put(
+                        mOuter.mFileId,
+                        theIt->fileOffset,
+                        mOuter.mNetManager.Now(),
+                        theIt->chunkId,
+                        theIt->chunkVersion,
+                        mOp.serversOrderedFlag,
+                        theIt->chunkServers
+                    );
+                }
+                Entry& theEntry = mChunks[theIt->fileOffset];
+                theEntry.mExpirationTime     = theExpirationTime;
+                theEntry.mServersOrderedFlag = mOp.serversOrderedFlag;
+                theEntry.mInfo.fileOffset    = theIt->fileOffset;
+                theEntry.mInfo.chunkId       = theIt->chunkId;
+                theEntry.mInfo.chunkVersion  = theIt->chunkVersion;
+                theEntry.mInfo.chunkServers.swap(theIt->chunkServers);
+            }
+            if (mOp.hasMoreChunksFlag && ! mOp.chunks.empty()) {
+                mEnd = max(mOp.startOffset,
+                    mOp.chunks.back().fileOffset + Offset(CHUNKSIZE));
+            }
+            mOp.chunks.clear();
+        }
+        static void Reset(
+            KfsOp& inOp)
+        {
+            inOp.seq           = 0;
+            inOp.status        = 0;
+            inOp.lastError     = 0;
+            inOp.statusMsg.clear();
+            inOp.checksum      = 0;
+            inOp.contentLength = 0;
+            inOp.DeallocContentBuf();
+        }
+    private:
+        LayoutPrefetcher(
+            const LayoutPrefetcher& inPrefetcher);
+        LayoutPrefetcher& operator=(
+            const LayoutPrefetcher& inPrefetcher);
+    };
     friend class ChunkReader;
     friend class Striper;
+    friend class LayoutPrefetcher;
 
     typedef ChunkReader::Readers Readers;
 
@@ -2215,11 +3181,14 @@ private:
     const int           mLeaseWaitTimeout;
     bool                mSkipHolesFlag;
     bool                mFailShortReadsFlag;
+    bool                mRecoveryReadFlag;
     int                 mMaxGetAllocRetryCount;
     Offset              mOffset;
     Offset              mOpenChunkBlockSize;
     int64_t             mChunkServerInitialSeqNum;
     ClientPool* const   mClientPoolPtr;
+    ChunkLocationCache* const mLocationCachePtr;
+    ChunkBlockCache* const    mBlockCachePtr;
     Completion*         mCompletionPtr;
     string const        mLogPrefix;
     Stats               mStats;
@@ -2228,8 +3197,39 @@ private:
     Striper*            mStriperPtr;
     int                 mCompletionDepthCount;
     int                 mReplicaCount;
+    int                 mRecoveryHedgeTimeoutMs;
+    int                 mHedgedReadMinTimeoutMs;
+    int                 mHedgedReadPercentile;
+    int                 mHedgedReadMaxPercent;
+    ReadLatencies       mReadLatencies;
+    ECThreadPool*       mECThreadPoolPtr;
+    ReadChecksumTask    mChecksumTask;
+    ChunkServerLatencyStats* mLatencyStatsPtr;
+    ReplicaLocality*    mReplicaLocalityPtr;
+    bool                mShortCircuitReadFlag;
+    LeaseRenewBatcher*  mLeaseRenewBatcherPtr;
+    LayoutPrefetcher    mLayoutPrefetcher;
     ChunkReader*        mReaders[1];
 
+    bool IsHedgedReadEnabled() const
+    {
+        return (0 <= mHedgedReadMinTimeoutMs && 0 < mHedgedReadMaxPercent &&
+            ! mStriperPtr);
+    }
+    int GetHedgedReadTimeoutMs()
+    {
+        const int64_t theUsec =
+            mReadLatencies.GetPercentileUsec(mHedgedReadPercentile);
+        return (int)max(
+            int64_t(mHedgedReadMinTimeoutMs), (theUsec + 999) / 1000);
+    }
+    bool CanStartHedgedRead() const
+    {
+        // Allow one hedged read in addition to the configured percentage of
+        // reads, in order to allow hedging the first read.
+        return (mStats.mHedgedReadCount * 100 <
+            mStats.mOpsReadCount * mHedgedReadMaxPercent + 100);
+    }
     void InternalError(
             const char* inMsgPtr = 0)
     {
@@ -2559,6 +3559,22 @@ private:
         ClientAuthContext* const theCtxPtr = mMetaServer.GetAuthContext();
         return (! theCtxPtr || theCtxPtr->IsChunkServerClearTextAllowed());
     }
+    void ComputeReadChecksums(
+        const IOBuffer&   inBuffer,
+        int               inLength,
+        vector<uint32_t>& outChecksums)
+    {
+        // Large reads are verified in place on the thread pool and the
+        // protocol worker thread, one checksum block per segment.
+        int theCount;
+        if (! mECThreadPoolPtr || inLength <= (int)CHECKSUM_BLOCKSIZE ||
+                (theCount = mChecksumTask.Set(inBuffer, inLength)) <= 1) {
+            outChecksums = ComputeChecksums(&inBuffer, inLength);
+            return;
+        }
+        mECThreadPoolPtr->Run(mChecksumTask, theCount, inLength);
+        mChecksumTask.Swap(outChecksums);
+    }
     bool IsAuthEnabled() const
     {
         ClientAuthContext* const theCtxPtr = mMetaServer.GetAuthContext();
@@ -2670,6 +3686,24 @@ Reader::Striper::ReportCompletion(
     );
 }
 
+NetManager&
+Reader::Striper::GetNetManager() const
+{
+    return mOuter.mNetManager;
+}
+
+int
+Reader::Striper::GetRecoveryHedgeTimeoutMs() const
+{
+    return mOuter.mRecoveryHedgeTimeoutMs;
+}
+
+ECThreadPool*
+Reader::Striper::GetECThreadPool() const
+{
+    return mOuter.mECThreadPoolPtr;
+}
+
 void
 Reader::Striper::ReportInvalidChunk(
         kfsChunkId_t inChunkId,
@@ -2697,7 +3731,9 @@ Reader::Reader(
     int                 inLeaseWaitTimeout         /* = 900 */,
     const char*         inLogPrefixPtr             /* = 0 */,
     int64_t             inChunkServerInitialSeqNum /* = 1 */,
-    ClientPool*         inClientPoolPtr            /* = 0 */)
+    ClientPool*         inClientPoolPtr            /* = 0 */,
+    ChunkLocationCache* inLocationCachePtr         /* = 0 */,
+    ChunkBlockCache*    inBlockCachePtr            /* = 0 */)
     : mImpl(*new Reader::Impl(
         *this,
         inMetaServer,
@@ -2712,7 +3748,9 @@ Reader::Reader(
         (inLogPrefixPtr && inLogPrefixPtr[0]) ?
             (inLogPrefixPtr + string(" ")) : string(),
         inChunkServerInitialSeqNum,
-        inClientPoolPtr
+        inClientPoolPtr,
+        inLocationCachePtr,
+        inBlockCachePtr
     ))
 {
     mImpl.Ref();
@@ -2817,6 +3855,64 @@ Reader::GetErrorCode() const
     return mImpl.GetErrorCode();
 }
 
+void
+Reader::SetRecoveryHedgeTimeout(
+    int inTimeoutMs)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetRecoveryHedgeTimeout(inTimeoutMs);
+}
+
+void
+Reader::SetHedgedReadParameters(
+    int inMinTimeoutMs,
+    int inPercentile,
+    int inMaxPercent)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetHedgedReadParameters(inMinTimeoutMs, inPercentile, inMaxPercent);
+}
+
+void
+Reader::SetECThreadPool(
+    ECThreadPool* inPoolPtr)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetECThreadPool(inPoolPtr);
+}
+
+void
+Reader::SetLatencyStats(
+    ChunkServerLatencyStats* inStatsPtr)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetLatencyStats(inStatsPtr);
+}
+
+void
+Reader::SetReplicaLocality(
+    ReplicaLocality* inLocalityPtr)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetReplicaLocality(inLocalityPtr);
+}
+
+void
+Reader::SetShortCircuitRead(
+    bool inFlag)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetShortCircuitRead(inFlag);
+}
+
+void
+Reader::SetLeaseRenewBatcher(
+    LeaseRenewBatcher* inBatcherPtr)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetLeaseRenewBatcher(inBatcherPtr);
+}
+
 void
 Reader::Register(
     Reader::Completion* inCompletionPtr)
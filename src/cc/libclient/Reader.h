@@ -42,6 +42,12 @@ using std::string;
 using std::ostream;
 
 class ClientPool;
+class ChunkLocationCache;
+class ChunkBlockCache;
+class ChunkServerLatencyStats;
+class ECThreadPool;
+class ReplicaLocality;
+class LeaseRenewBatcher;
 
 // Kfs client file read state machine.
 class Reader
@@ -93,7 +99,13 @@ public:
               mReadByteCount(0),
               mReadErrorsCount(0),
               mReadChecksumErrorsCount(0),
-              mReadRecoveriesCount(0)
+              mReadRecoveriesCount(0),
+              mHedgedReadCount(0),
+              mHedgedReadWinCount(0),
+              mHedgedReadErrorsCount(0),
+              mShortCircuitReadCount(0),
+              mShortCircuitReadByteCount(0),
+              mShortCircuitErrorsCount(0)
             {}
         void Clear()
             { *this = Stats(); }
@@ -113,6 +125,12 @@ public:
             mReadErrorsCount         += inStats.mReadErrorsCount;
             mReadChecksumErrorsCount += inStats.mReadChecksumErrorsCount;
             mReadRecoveriesCount     += inStats.mReadRecoveriesCount;
+            mHedgedReadCount         += inStats.mHedgedReadCount;
+            mHedgedReadWinCount      += inStats.mHedgedReadWinCount;
+            mHedgedReadErrorsCount   += inStats.mHedgedReadErrorsCount;
+            mShortCircuitReadCount   += inStats.mShortCircuitReadCount;
+            mShortCircuitReadByteCount += inStats.mShortCircuitReadByteCount;
+            mShortCircuitErrorsCount += inStats.mShortCircuitErrorsCount;
             return *this;
         }
         template<typename T>
@@ -131,6 +149,12 @@ public:
             inFunctor("ReadRecoveries",     mReadRecoveriesCount);
             inFunctor("Reads",              mReadCount);
             inFunctor("ReadBytes",          mReadByteCount);
+            inFunctor("HedgedReads",        mHedgedReadCount);
+            inFunctor("HedgedReadWins",     mHedgedReadWinCount);
+            inFunctor("HedgedReadErrors",   mHedgedReadErrorsCount);
+            inFunctor("ShortCircuitReads",  mShortCircuitReadCount);
+            inFunctor("ShortCircuitReadBytes", mShortCircuitReadByteCount);
+            inFunctor("ShortCircuitErrors", mShortCircuitErrorsCount);
         }
         Counter mMetaOpsQueuedCount;
         Counter mMetaOpsCancelledCount;
@@ -145,6 +169,12 @@ public:
         Counter mReadErrorsCount;
         Counter mReadChecksumErrorsCount;
         Counter mReadRecoveriesCount;
+        Counter mHedgedReadCount;
+        Counter mHedgedReadWinCount;
+        Counter mHedgedReadErrorsCount;
+        Counter mShortCircuitReadCount;
+        Counter mShortCircuitReadByteCount;
+        Counter mShortCircuitErrorsCount;
     };
     class Striper
     {
@@ -211,6 +241,12 @@ public:
             RequestId inRequestId,
             int64_t   inRecoveriesCount);
         void CancelRead();
+        NetManager& GetNetManager() const;
+        // Chunk recovery read hedge timeout: negative -- disabled, 0 -- read
+        // all stripes in parallel, otherwise start reading the remaining
+        // stripes after the timeout.
+        int GetRecoveryHedgeTimeoutMs() const;
+        ECThreadPool* GetECThreadPool() const;
         void ReportInvalidChunk(
             kfsChunkId_t inChunkId,
             int64_t      inChunkVersion,
@@ -237,7 +273,9 @@ public:
         int         inLeaseWaitTimeout         = 900,
         const char* inLogPrefixPtr             = 0,
         int64_t     inChunkServerInitialSeqNum = 1,
-        ClientPool* inClientPoolPtr            = 0);
+        ClientPool* inClientPoolPtr            = 0,
+        ChunkLocationCache* inLocationCachePtr = 0,
+        ChunkBlockCache*    inBlockCachePtr    = 0);
     virtual ~Reader();
     int Open(
         kfsFileId_t inFileId,
@@ -264,6 +302,37 @@ public:
     bool IsClosing() const;
     bool IsActive()  const;
     int GetErrorCode() const;
+    // Must be set before Open() in order to take effect.
+    void SetRecoveryHedgeTimeout(
+        int inTimeoutMs);
+    // Hedged reads of replicated, not striped, files. If a chunk read does not
+    // complete within the max of the min timeout and the read latency
+    // percentile, the same read is issued to the next replica, and the first
+    // successful response is used. The max percent limits the number of hedged
+    // reads relative to the number of reads. Negative min timeout disables
+    // hedged reads.
+    void SetHedgedReadParameters(
+        int inMinTimeoutMs,
+        int inPercentile,
+        int inMaxPercent);
+    // Use the thread pool for the recovery decode, if set.
+    void SetECThreadPool(
+        ECThreadPool* inPoolPtr);
+    // Record chunk server read latencies and retries, if set.
+    void SetLatencyStats(
+        ChunkServerLatencyStats* inStatsPtr);
+    // Order chunk replicas by locality and observed latency, if set.
+    void SetReplicaLocality(
+        ReplicaLocality* inLocalityPtr);
+    // Read stable chunks hosted by the chunk server on the client host
+    // directly from the chunk files, if the chunk server allows it. Requires
+    // replica locality to detect the local chunk server.
+    void SetShortCircuitRead(
+        bool inFlag);
+    // Coalesce read lease renews with other readers, if set. The batch renew
+    // is only used with no chunk server access tokens.
+    void SetLeaseRenewBatcher(
+        LeaseRenewBatcher* inBatcherPtr);
     void Register(
         Completion* inCompletionPtr);
     bool Unregister(
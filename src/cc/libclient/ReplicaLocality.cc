@@ -0,0 +1,236 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client replica locality implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "ReplicaLocality.h"
+
+#include "common/MsgLogger.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <unistd.h>
+
+namespace KFS
+{
+namespace client
+{
+using std::make_pair;
+using std::sort;
+using std::istringstream;
+using std::min;
+using std::max;
+
+class RackIdValidator
+{
+public:
+    bool operator()(
+        const string& /* inPrefix */,
+        int           inRackId) const
+        { return (0 <= inRackId); }
+};
+
+ReplicaLocality::ReplicaLocality(
+    size_t inMaxServerCount)
+    : mEnabledFlag(false),
+      mRackId(-1),
+      mLatencyEwmaWeight(0.1),
+      mLocalHosts(),
+      mRackPrefixes(),
+      mLatencies(),
+      mMaxServerCount(inMaxServerCount)
+    {}
+
+ReplicaLocality::~ReplicaLocality()
+{}
+
+void
+ReplicaLocality::SetParameters(
+    bool          inEnabledFlag,
+    int           inRackId,
+    const string& inRackPrefixes,
+    double        inLatencyEwmaWeight)
+{
+    mEnabledFlag       = inEnabledFlag;
+    mLatencyEwmaWeight = max(1e-3, min(1., inLatencyEwmaWeight));
+    mRackPrefixes.clear();
+    mLatencies.clear();
+    if (! mEnabledFlag) {
+        mLocalHosts.clear();
+        mRackId = -1;
+        return;
+    }
+    LoadLocalHosts();
+    {
+        istringstream theStream(inRackPrefixes);
+        RackIdValidator theValidator;
+        mRackPrefixes.Load(theStream, &theValidator, -1);
+    }
+    mRackId = inRackId;
+    for (LocalHosts::const_iterator theIt = mLocalHosts.begin();
+            mRackId < 0 && theIt != mLocalHosts.end();
+            ++theIt) {
+        mRackId = mRackPrefixes.GetId(*theIt, -1);
+    }
+    KFS_LOG_STREAM_DEBUG <<
+        "replica locality:"
+        " local hosts: " << mLocalHosts.size() <<
+        " rack: "        << mRackId <<
+    KFS_LOG_EOM;
+}
+
+void
+ReplicaLocality::LoadLocalHosts()
+{
+    mLocalHosts.clear();
+    mLocalHosts.insert("127.0.0.1");
+    mLocalHosts.insert("::1");
+    mLocalHosts.insert("localhost");
+    char theName[256];
+    if (gethostname(theName, sizeof(theName)) == 0) {
+        theName[sizeof(theName) - 1] = 0;
+        mLocalHosts.insert(string(theName));
+    }
+    struct ifaddrs* theAddrsPtr = 0;
+    if (getifaddrs(&theAddrsPtr) != 0) {
+        return;
+    }
+    for (const struct ifaddrs* thePtr = theAddrsPtr;
+            thePtr;
+            thePtr = thePtr->ifa_next) {
+        if (! thePtr->ifa_addr) {
+            continue;
+        }
+        char        theBuf[INET6_ADDRSTRLEN + 1];
+        const char* theAddrPtr = 0;
+        if (thePtr->ifa_addr->sa_family == AF_INET) {
+            theAddrPtr = inet_ntop(AF_INET,
+                &reinterpret_cast<const struct sockaddr_in*>(
+                    thePtr->ifa_addr)->sin_addr,
+                theBuf, sizeof(theBuf));
+        } else if (thePtr->ifa_addr->sa_family == AF_INET6) {
+            theAddrPtr = inet_ntop(AF_INET6,
+                &reinterpret_cast<const struct sockaddr_in6*>(
+                    thePtr->ifa_addr)->sin6_addr,
+                theBuf, sizeof(theBuf));
+        }
+        if (theAddrPtr) {
+            mLocalHosts.insert(string(theAddrPtr));
+        }
+    }
+    freeifaddrs(theAddrsPtr);
+}
+
+ReplicaLocality::Locality
+ReplicaLocality::GetLocality(
+    const ServerLocation& inLocation) const
+{
+    if (mLocalHosts.find(inLocation.hostname) != mLocalHosts.end()) {
+        return kLocalityHost;
+    }
+    if (0 <= mRackId &&
+            mRackPrefixes.GetId(inLocation.hostname, -1) == mRackId) {
+        return kLocalityRack;
+    }
+    return kLocalityOther;
+}
+
+int
+ReplicaLocality::GetLatencyClass(
+    const ServerLocation& inLocation) const
+{
+    // Servers with no latency history go first, in order to get their
+    // latency measured.
+    Latencies::const_iterator const theIt = mLatencies.find(inLocation);
+    if (theIt == mLatencies.end()) {
+        return 0;
+    }
+    int     theClass = 1;
+    int64_t theUsec  = (int64_t)theIt->second;
+    while (0 < theUsec && theClass < 63) {
+        theUsec >>= 1;
+        theClass++;
+    }
+    return theClass;
+}
+
+void
+ReplicaLocality::Order(
+    ReplicaLocality::Servers& ioServers,
+    bool                      inKeepOrderFlag) const
+{
+    if (! mEnabledFlag || ioServers.size() < 2) {
+        return;
+    }
+    typedef vector<pair<int, size_t> > Keys;
+    Keys theKeys;
+    theKeys.reserve(ioServers.size());
+    bool theSortFlag = false;
+    for (size_t i = 0; i < ioServers.size(); i++) {
+        const int theKey = GetLocality(ioServers[i]) * 64 +
+            (inKeepOrderFlag ? 0 : GetLatencyClass(ioServers[i]));
+        theSortFlag = theSortFlag ||
+            (! theKeys.empty() && theKey < theKeys.back().first);
+        theKeys.push_back(make_pair(theKey, i));
+    }
+    if (! theSortFlag) {
+        return;
+    }
+    // The index is the second key, the sort is stable.
+    sort(theKeys.begin(), theKeys.end());
+    Servers theServers;
+    theServers.reserve(ioServers.size());
+    for (Keys::const_iterator theIt = theKeys.begin();
+            theIt != theKeys.end();
+            ++theIt) {
+        theServers.push_back(ioServers[theIt->second]);
+    }
+    ioServers.swap(theServers);
+}
+
+void
+ReplicaLocality::AddReadLatency(
+    const ServerLocation& inLocation,
+    int64_t               inUsec)
+{
+    if (! mEnabledFlag || inUsec < 0) {
+        return;
+    }
+    Latencies::iterator theIt = mLatencies.find(inLocation);
+    if (theIt == mLatencies.end()) {
+        if (! inLocation.IsValid() || mMaxServerCount <= mLatencies.size()) {
+            return;
+        }
+        mLatencies.insert(make_pair(inLocation, (double)inUsec));
+        return;
+    }
+    theIt->second += ((double)inUsec - theIt->second) * mLatencyEwmaWeight;
+}
+
+}}
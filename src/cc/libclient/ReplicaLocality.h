@@ -0,0 +1,123 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Client replica locality: orders chunk replica locations such that the
+// chunk servers on the client host go first, then the chunk servers in the
+// client rack, then all others. Within the same locality class the servers
+// are ordered by the observed read latency moving average, rounded to a power
+// of two, in order to preserve the meta server or random order among servers
+// with similar latencies. The rack is defined by the host prefix to rack id
+// map, with the same format as metaServer.rackPrefixes. Shared by all readers
+// of a protocol worker, and not thread safe.
+//
+//----------------------------------------------------------------------------
+
+#ifndef REPLICA_LOCALITY_H
+#define REPLICA_LOCALITY_H
+
+#include "common/kfsdecls.h"
+#include "common/HostPrefix.h"
+#include "common/StdAllocator.h"
+
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+
+namespace KFS
+{
+namespace client
+{
+using std::map;
+using std::set;
+using std::vector;
+using std::string;
+using std::less;
+using std::pair;
+
+class ReplicaLocality
+{
+public:
+    enum Locality
+    {
+        kLocalityHost  = 0,
+        kLocalityRack  = 1,
+        kLocalityOther = 2
+    };
+    typedef vector<ServerLocation> Servers;
+
+    ReplicaLocality(
+        size_t inMaxServerCount = 4 << 10);
+    ~ReplicaLocality();
+    void SetParameters(
+        bool          inEnabledFlag,
+        int           inRackId,
+        const string& inRackPrefixes,
+        double        inLatencyEwmaWeight = 0.1);
+    bool IsEnabled() const
+        { return mEnabledFlag; }
+    int GetRackId() const
+        { return mRackId; }
+    Locality GetLocality(
+        const ServerLocation& inLocation) const;
+    // Stable sort servers by locality, and by latency in the same locality
+    // class, unless the keep order flag is set.
+    void Order(
+        Servers& ioServers,
+        bool     inKeepOrderFlag) const;
+    void AddReadLatency(
+        const ServerLocation& inLocation,
+        int64_t               inUsec);
+private:
+    typedef set<
+        string,
+        less<string>,
+        StdFastAllocator<string>
+    > LocalHosts;
+    typedef map<
+        ServerLocation,
+        double,
+        less<ServerLocation>,
+        StdFastAllocator<pair<const ServerLocation, double> >
+    > Latencies;
+    typedef HostPrefixMap<int> RackPrefixes;
+
+    bool         mEnabledFlag;
+    int          mRackId;
+    double       mLatencyEwmaWeight;
+    LocalHosts   mLocalHosts;
+    RackPrefixes mRackPrefixes;
+    Latencies    mLatencies;
+    size_t const mMaxServerCount;
+
+    void LoadLocalHosts();
+    int GetLatencyClass(
+        const ServerLocation& inLocation) const;
+private:
+    ReplicaLocality(
+        const ReplicaLocality& inLocality);
+    ReplicaLocality& operator=(
+        const ReplicaLocality& inLocality);
+};
+
+}}
+
+#endif /* REPLICA_LOCALITY_H */
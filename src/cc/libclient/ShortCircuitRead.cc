@@ -0,0 +1,264 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Short circuit local chunk read implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "ShortCircuitRead.h"
+
+#include "kfsio/IOBuffer.h"
+#include "kfsio/checksum.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+namespace KFS
+{
+namespace client
+{
+using std::min;
+using std::max;
+
+ShortCircuitRead::ShortCircuitRead()
+    : mFd(-1),
+      mChunkId(-1),
+      mChunkVersion(-1),
+      mHeaderSize(0),
+      mExpires(0),
+      mChecksums(),
+      mBuffer()
+    {}
+
+ShortCircuitRead::~ShortCircuitRead()
+{
+    ShortCircuitRead::Close();
+}
+
+int
+ShortCircuitRead::Open(
+    const string& inSocketPath,
+    int64_t       inGrantId,
+    kfsChunkId_t  inChunkId,
+    int64_t       inChunkVersion,
+    int64_t       inHeaderSize,
+    int           inLeaseSec,
+    time_t        inNow,
+    IOBuffer&     inChecksums)
+{
+    Close();
+    const size_t theCount = (size_t)(CHUNKSIZE / CHECKSUM_BLOCKSIZE);
+    if (inGrantId <= 0 || inHeaderSize < 0 || inLeaseSec <= 0 ||
+            inChecksums.BytesConsumable() !=
+                (int)(theCount * sizeof(mChecksums[0]))) {
+        return -EINVAL;
+    }
+    int       theFd     = -1;
+    const int theStatus = Claim(inSocketPath, inGrantId, theFd);
+    if (theStatus < 0) {
+        return theStatus;
+    }
+    mChecksums.resize(theCount);
+    inChecksums.CopyOut(reinterpret_cast<char*>(&mChecksums[0]),
+        (int)(theCount * sizeof(mChecksums[0])));
+    inChecksums.Clear();
+    mFd           = theFd;
+    mChunkId      = inChunkId;
+    mChunkVersion = inChunkVersion;
+    mHeaderSize   = inHeaderSize;
+    mExpires      = inNow + inLeaseSec;
+    return 0;
+}
+
+int
+ShortCircuitRead::Claim(
+    const string& inSocketPath,
+    int64_t       inGrantId,
+    int&          outFd)
+{
+    outFd = -1;
+    struct sockaddr_un theAddr;
+    memset(&theAddr, 0, sizeof(theAddr));
+    if (inSocketPath.empty() ||
+            sizeof(theAddr.sun_path) <= inSocketPath.size()) {
+        return -EINVAL;
+    }
+    theAddr.sun_family = AF_UNIX;
+    memcpy(theAddr.sun_path, inSocketPath.data(), inSocketPath.size());
+    const int theSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (theSocket < 0) {
+        return (errno > 0 ? -errno : -EIO);
+    }
+    fcntl(theSocket, F_SETFD, FD_CLOEXEC);
+    // The chunk server is on the same host, and responds immediately, the
+    // timeout only bounds the wait if the chunk server is not responsive.
+    struct timeval theTimeout;
+    theTimeout.tv_sec  = 1;
+    theTimeout.tv_usec = 0;
+    setsockopt(theSocket, SOL_SOCKET, SO_RCVTIMEO,
+        &theTimeout, sizeof(theTimeout));
+    setsockopt(theSocket, SOL_SOCKET, SO_SNDTIMEO,
+        &theTimeout, sizeof(theTimeout));
+    char      theBuf[32];
+    const int theLen = snprintf(theBuf, sizeof(theBuf), "%lld\n",
+        (long long)inGrantId);
+    int theStatus = 0;
+    if (connect(theSocket, reinterpret_cast<const struct sockaddr*>(&theAddr),
+                sizeof(theAddr)) != 0 ||
+            write(theSocket, theBuf, (size_t)theLen) != (ssize_t)theLen) {
+        theStatus = errno > 0 ? -errno : -EIO;
+        close(theSocket);
+        return theStatus;
+    }
+    struct iovec theIov;
+    theIov.iov_base = theBuf;
+    theIov.iov_len  = sizeof(theBuf) - 1;
+    char theCtl[CMSG_SPACE(sizeof(int))];
+    memset(theCtl, 0, sizeof(theCtl));
+    struct msghdr theMsg;
+    memset(&theMsg, 0, sizeof(theMsg));
+    theMsg.msg_iov        = &theIov;
+    theMsg.msg_iovlen     = 1;
+    theMsg.msg_control    = theCtl;
+    theMsg.msg_controllen = sizeof(theCtl);
+    const ssize_t theNRd = recvmsg(theSocket, &theMsg, 0);
+    if (theNRd <= 0) {
+        theStatus = theNRd < 0 && errno > 0 ? -errno : -EIO;
+        close(theSocket);
+        return theStatus;
+    }
+    theBuf[theNRd] = 0;
+    char* theEndPtr = 0;
+    theStatus = (int)strtol(theBuf, &theEndPtr, 10);
+    if (! theEndPtr || *theEndPtr != '\n') {
+        theStatus = -EIO;
+    }
+    int theFd = -1;
+    for (struct cmsghdr* theCmsgPtr = CMSG_FIRSTHDR(&theMsg);
+            theCmsgPtr;
+            theCmsgPtr = CMSG_NXTHDR(&theMsg, theCmsgPtr)) {
+        if (theCmsgPtr->cmsg_level == SOL_SOCKET &&
+                theCmsgPtr->cmsg_type == SCM_RIGHTS &&
+                CMSG_LEN(sizeof(int)) <= theCmsgPtr->cmsg_len) {
+            memcpy(&theFd, CMSG_DATA(theCmsgPtr), sizeof(theFd));
+            break;
+        }
+    }
+    close(theSocket);
+    if (0 <= theFd) {
+        fcntl(theFd, F_SETFD, FD_CLOEXEC);
+    }
+    if (theStatus == 0 && theFd < 0) {
+        theStatus = -EIO;
+    }
+    if (theStatus < 0) {
+        if (0 <= theFd) {
+            close(theFd);
+        }
+        return theStatus;
+    }
+    outFd = theFd;
+    return 0;
+}
+
+int
+ShortCircuitRead::Read(
+    chunkOff_t inOffset,
+    int        inNumBytes,
+    chunkOff_t inChunkSize,
+    IOBuffer&  outBuffer)
+{
+    const chunkOff_t kBlockSize = (chunkOff_t)CHECKSUM_BLOCKSIZE;
+    const chunkOff_t theEnd     = min(inOffset + inNumBytes, inChunkSize);
+    if (mFd < 0 || inOffset < 0 || theEnd <= inOffset ||
+            (chunkOff_t)CHUNKSIZE < theEnd) {
+        return 0;
+    }
+    const chunkOff_t theStart  = inOffset - inOffset % kBlockSize;
+    const chunkOff_t theBlkEnd =
+        (theEnd + kBlockSize - 1) / kBlockSize * kBlockSize;
+    // Sparse blocks have no checksums, let the chunk server handle these.
+    for (chunkOff_t thePos = theStart; thePos < theBlkEnd;
+            thePos += kBlockSize) {
+        if (mChecksums[(size_t)(thePos / kBlockSize)] == 0) {
+            return 0;
+        }
+    }
+    const size_t theSize = (size_t)(theBlkEnd - theStart);
+    if (mBuffer.size() < theSize) {
+        mBuffer.resize(theSize);
+    }
+    char*  const thePtr = &mBuffer[0];
+    size_t       theRd  = 0;
+    while (theRd < theSize) {
+        const ssize_t theNRd = pread(mFd, thePtr + theRd, theSize - theRd,
+            (off_t)(mHeaderSize + theStart + (chunkOff_t)theRd));
+        if (theNRd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno > 0 ? -errno : -EIO);
+        }
+        if (theNRd == 0) {
+            break;
+        }
+        theRd += (size_t)theNRd;
+    }
+    if (theRd < (size_t)(theEnd - theStart)) {
+        return -EIO; // Short read, the chunk file is shorter than expected.
+    }
+    // The last partial block checksum is computed with zero padding.
+    memset(thePtr + theRd, 0, theSize - theRd);
+    for (size_t thePos = 0; thePos < theSize; thePos += kBlockSize) {
+        if (ComputeBlockChecksum(thePtr + thePos, (size_t)kBlockSize) !=
+                mChecksums[(size_t)((theStart + thePos) / kBlockSize)]) {
+            return -EBADCKSUM;
+        }
+    }
+    const int theLen = (int)(theEnd - inOffset);
+    outBuffer.CopyIn(thePtr + (inOffset - theStart), theLen);
+    return theLen;
+}
+
+void
+ShortCircuitRead::Close()
+{
+    if (0 <= mFd) {
+        close(mFd);
+    }
+    mFd           = -1;
+    mChunkId      = -1;
+    mChunkVersion = -1;
+    mExpires      = 0;
+    mChecksums.clear();
+}
+
+}}
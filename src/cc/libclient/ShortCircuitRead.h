@@ -0,0 +1,106 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Short circuit local chunk read. Claims the chunk file descriptor granted by
+// the chunk server running on the same host, and reads the stable chunk
+// directly from the file, verifying the data against the chunk checksums
+// returned with the grant. The descriptor is only used until the lease
+// returned with the grant expires.
+//
+//----------------------------------------------------------------------------
+
+#ifndef SHORT_CIRCUIT_READ_H
+#define SHORT_CIRCUIT_READ_H
+
+#include "common/kfstypes.h"
+
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+namespace KFS
+{
+class IOBuffer;
+
+namespace client
+{
+using std::string;
+using std::vector;
+
+class ShortCircuitRead
+{
+public:
+    ShortCircuitRead();
+    ~ShortCircuitRead();
+    // Connect to the chunk server short circuit socket, and claim the chunk
+    // file descriptor. The checksums buffer content is consumed. Returns 0
+    // on success, or negative error code.
+    int Open(
+        const string& inSocketPath,
+        int64_t       inGrantId,
+        kfsChunkId_t  inChunkId,
+        int64_t       inChunkVersion,
+        int64_t       inHeaderSize,
+        int           inLeaseSec,
+        time_t        inNow,
+        IOBuffer&     inChecksums);
+    bool IsOpen(
+        kfsChunkId_t inChunkId,
+        int64_t      inChunkVersion,
+        time_t       inNow) const
+    {
+        return (0 <= mFd && inNow < mExpires &&
+            inChunkId == mChunkId && inChunkVersion == mChunkVersion);
+    }
+    // Read and verify whole checksum blocks covering the range, and copy the
+    // requested range, trimmed to the chunk size, into the buffer. Returns
+    // the number of bytes read, 0 if the range can not be read locally, or
+    // negative error code on io error or checksum mismatch.
+    int Read(
+        chunkOff_t inOffset,
+        int        inNumBytes,
+        chunkOff_t inChunkSize,
+        IOBuffer&  outBuffer);
+    void Close();
+private:
+    int              mFd;
+    kfsChunkId_t     mChunkId;
+    int64_t          mChunkVersion;
+    int64_t          mHeaderSize;
+    time_t           mExpires;
+    vector<uint32_t> mChecksums;
+    vector<char>     mBuffer;
+
+    static int Claim(
+        const string& inSocketPath,
+        int64_t       inGrantId,
+        int&          outFd);
+private:
+    ShortCircuitRead(
+        const ShortCircuitRead& inRead);
+    ShortCircuitRead& operator=(
+        const ShortCircuitRead& inRead);
+};
+
+}}
+
+#endif /* SHORT_CIRCUIT_READ_H */
@@ -45,6 +45,7 @@
 #include "utils.h"
 #include "KfsClient.h"
 #include "ClientPool.h"
+#include "ChunkServerLatencyStats.h"
 
 namespace KFS
 {
@@ -154,7 +155,17 @@ public:
           mNoCSAccessCount(0),
           mClientPoolPtr(inClientPoolPtr),
           mChunkServerPtr(0),
-          mNetManager(mMetaServer.GetNetManager())
+          mNetManager(mMetaServer.GetNetManager()),
+          mMaxLingerMs(0),
+          mFlushPos(0),
+          mAppendStartUsec(0),
+          mAppendLatencyAvgMs8(0),
+          mLingerFlag(false),
+          mLingerExpiredFlag(false),
+          mLatencyStatsPtr(0),
+          mMaxSpaceReservationSize(mDefaultSpaceReservationSize),
+          mSpaceReservationSize(mDefaultSpaceReservationSize),
+          mSpaceReserveTime(0)
     {
         Impl::Reset();
         mChunkServer.SetRetryConnectOnly(true);
@@ -167,6 +178,7 @@ public:
         if (mSleepingFlag) {
             mNetManager.UnRegisterTimeoutHandler(this);
         }
+        CancelLingerTimer();
     }
     int Open(
         const char* inFileNamePtr,
@@ -316,6 +328,7 @@ public:
         } else {
             mWriteQueue.back() += inLength;
         }
+        StartLingerTimer();
         if (! mCurOpPtr && mOpenFlag) {
             StartAppend();
         }
@@ -330,6 +343,9 @@ public:
             mNetManager.UnRegisterTimeoutHandler(this);
             mSleepingFlag = false;
         }
+        CancelLingerTimer();
+        mLingerExpiredFlag = false;
+        mFlushPos          = 0;
         mClosingFlag  = false;
         mOpeningFlag  = false;
         mOpenFlag     = false;
@@ -410,6 +426,41 @@ public:
     void SetForcedAllocationInterval(
         int inInterval)
         { mForcedAllocationInterval = inInterval; }
+    void SetLatencyStats(
+        ChunkServerLatencyStats* inStatsPtr)
+        { mLatencyStatsPtr = inStatsPtr; }
+    void SetMaxSpaceReservationSize(
+        int inSize)
+    {
+        mMaxSpaceReservationSize = max(mDefaultSpaceReservationSize,
+            min((int)KFS::CHUNKSIZE, inSize));
+        mSpaceReservationSize = min(
+            mSpaceReservationSize, mMaxSpaceReservationSize);
+    }
+    void SetMaxLingerTime(
+        int inMs)
+    {
+        mMaxLingerMs = inMs;
+        if (mMaxLingerMs <= 0) {
+            CancelLingerTimer();
+        }
+    }
+    int Flush()
+    {
+        if (mErrorCode) {
+            return GetErrorStatus();
+        }
+        mFlushPos = mBuffer.BytesConsumable();
+        if (mFlushPos <= 0) {
+            return 0;
+        }
+        mStats.mFlushCount++;
+        CancelLingerTimer();
+        if (! mCurOpPtr && mOpenFlag) {
+            StartAppend();
+        }
+        return GetErrorStatus();
+    }
 
 protected:
     virtual void OpDone(
@@ -468,6 +519,7 @@ private:
     enum { kAgainRetryMinTime            = 4      };
     enum { kGetStatusOpMinTime           = 16     };
     enum { kAppendInactivityCheckTimeout = 3 * 60 };
+    enum { kSpaceReserveGrowTime         = 2      };
 
     typedef KfsNetClient      ChunkServer;
     typedef vector<WriteInfo> WriteIds;
@@ -545,6 +597,16 @@ private:
     ClientPool*             mClientPoolPtr;
     ChunkServer*            mChunkServerPtr;
     NetManager&             mNetManager;
+    int                     mMaxLingerMs;
+    int                     mFlushPos;
+    int64_t                 mAppendStartUsec;
+    int64_t                 mAppendLatencyAvgMs8;
+    bool                    mLingerFlag;
+    bool                    mLingerExpiredFlag;
+    ChunkServerLatencyStats* mLatencyStatsPtr;
+    int                     mMaxSpaceReservationSize;
+    int                     mSpaceReservationSize;
+    time_t                  mSpaceReserveTime;
 
     template<typename T> bool Dispatch(
         T&        inObj,
@@ -871,7 +933,8 @@ private:
     {
         QCASSERT(mLookupOp.fattr.fileId > 0);
         Reset(mAllocOp);
-        mSpaceAvailable = 0;
+        mSpaceAvailable       = 0;
+        mSpaceReservationSize = mDefaultSpaceReservationSize;
         chunkOff_t theOffset;
         if (mSpaceReserveOp.status == -ENOSPC) {
             theOffset = (mAllocOp.fileOffset + KFS::CHUNKSIZE) /
@@ -939,9 +1002,42 @@ private:
     {
         return (
             ! mWriteQueue.empty() &&
-            (mClosingFlag || mBuffer.BytesConsumable() >= mWriteThreshold)
+            (mClosingFlag || 0 < mFlushPos || mLingerExpiredFlag ||
+                mBuffer.BytesConsumable() >= mWriteThreshold)
         );
     }
+    int GetLingerTimeMs() const
+    {
+        // Linger up to 4 average append round trips, but no less than quarter
+        // of the max., in order to batch more when the appends are slow, and
+        // keep the latency low when the appends are fast.
+        if (mAppendLatencyAvgMs8 <= 0) {
+            return mMaxLingerMs;
+        }
+        return (int)max(int64_t(max(1, mMaxLingerMs / 4)),
+            min(int64_t(mMaxLingerMs), mAppendLatencyAvgMs8 / 2));
+    }
+    void StartLingerTimer()
+    {
+        if (mMaxLingerMs <= 0 || mLingerFlag || mLingerExpiredFlag ||
+                mSleepingFlag || mClosingFlag || 0 < mFlushPos ||
+                mWriteQueue.empty() ||
+                mWriteThreshold <= mBuffer.BytesConsumable()) {
+            return;
+        }
+        mLingerFlag = true;
+        const bool kResetTimerFlag = true;
+        SetTimeoutInterval(GetLingerTimeMs(), kResetTimerFlag);
+        mNetManager.RegisterTimeoutHandler(this);
+    }
+    void CancelLingerTimer()
+    {
+        if (! mLingerFlag) {
+            return;
+        }
+        mLingerFlag = false;
+        mNetManager.UnRegisterTimeoutHandler(this);
+    }
     void UpdateSpaceAvailable()
     {
         // Chunk server automatically release reserved space in the event of
@@ -959,7 +1055,7 @@ private:
         UpdateSpaceAvailable();
         const int theSpaceNeeded = mWriteQueue.empty() ?
             ((mSpaceAvailable <= 0 && ! mClosingFlag) ?
-                mDefaultSpaceReservationSize : 0) :
+                mSpaceReservationSize : 0) :
             mWriteQueue.front();
         if (! inCheckAppenderFlag && theSpaceNeeded <= mSpaceAvailable) {
             if (CanAppend()) {
@@ -969,6 +1065,15 @@ private:
                 return false; // Nothing to do.
             }
         }
+        // Grow the reservation geometrically when the previous one was
+        // consumed quickly, in order to reduce the number of space
+        // reservation round trips with high append rate.
+        if (! inCheckAppenderFlag && ! mClosingFlag &&
+                mSpaceReservationSize < mMaxSpaceReservationSize &&
+                Now() < mSpaceReserveTime + kSpaceReserveGrowTime) {
+            mSpaceReservationSize = min(
+                mMaxSpaceReservationSize, 2 * mSpaceReservationSize);
+        }
         Reset(mSpaceReserveOp);
         mSpaceReserveOp.chunkId      = mAllocOp.chunkId;
         mSpaceReserveOp.chunkVersion = mAllocOp.chunkVersion,
@@ -976,9 +1081,9 @@ private:
         mSpaceReserveOp.numBytes     = theSpaceNeeded <= mSpaceAvailable ?
             size_t(0) :
             size_t(max(
-                mClosingFlag ? 0 : mDefaultSpaceReservationSize,
+                mClosingFlag ? 0 : mSpaceReservationSize,
                 max(theSpaceNeeded, min(
-                    max(mPreferredAppendSize, mDefaultSpaceReservationSize),
+                    max(mPreferredAppendSize, mSpaceReservationSize),
                     mBuffer.BytesConsumable()))) -
                 mSpaceAvailable
             );
@@ -995,6 +1100,15 @@ private:
         if (inOp.status != 0) {
             if (inOp.status == -ENOSPC) {
                 mStats.mReserveSpaceDeniedCount++;
+                if (mDefaultSpaceReservationSize < mSpaceReservationSize &&
+                        ! mClosingFlag) {
+                    // Retry with the default size, the grown reservation
+                    // might not fit into the remaining chunk space.
+                    mSpaceReservationSize = mDefaultSpaceReservationSize;
+                    mSpaceReserveTime     = 0;
+                    ReserveSpace();
+                    return;
+                }
                 if (mSpaceAvailable > 0) {
                     SpaceRelease();
                 } else {
@@ -1007,6 +1121,7 @@ private:
         }
         mSpaceAvailable += inOp.numBytes;
         mLastAppendActivityTime = Now();
+        mSpaceReserveTime       = mLastAppendActivityTime;
         mSpaceReserveDisconnectCount = GetChunkServer().GetDisconnectCount();
         StartAppend();
     }
@@ -1294,6 +1409,7 @@ private:
         mRecAppendOp.checksum      =
             ComputeBlockChecksum(&mBuffer, mAppendLength);
         mStats.mOpsRecAppendCount++;
+        mAppendStartUsec = microseconds();
         SetAccessAndRequstAccessUpdate(mRecAppendOp);
         Enqueue(mRecAppendOp, &mBuffer);
     }
@@ -1312,6 +1428,11 @@ private:
         QCASSERT(&mRecAppendOp == &inOp && inBufferPtr == &mBuffer &&
             ! mWriteQueue.empty());
         if (inOp.status != 0 || mWriteQueue.empty()) {
+            if (mLatencyStatsPtr) {
+                mLatencyStatsPtr->AddRetry(
+                    ChunkServerLatencyStats::kOpTypeAppend,
+                    GetChunkServer().GetServerLocation());
+            }
             HandleError();
             return;
         }
@@ -1338,6 +1459,20 @@ private:
         mPrevRecordAppendOpSeq  = inOp.seq;
         mStats.mAppendCount++;
         mStats.mAppendByteCount += theConsumed;
+        const int64_t theLatencyUsec = microseconds() - mAppendStartUsec;
+        const int64_t theLatencyMs   = max(int64_t(0), theLatencyUsec / 1000);
+        mStats.mAppendLatencyMs += theLatencyMs;
+        if (mLatencyStatsPtr) {
+            mLatencyStatsPtr->Add(ChunkServerLatencyStats::kOpTypeAppend,
+                GetChunkServer().GetServerLocation(), theLatencyUsec);
+        }
+        // Exponentially weighted moving average with 1/8 weight, kept
+        // multiplied by 8.
+        mAppendLatencyAvgMs8 += theLatencyMs - mAppendLatencyAvgMs8 / 8;
+        mFlushPos = max(0, mFlushPos - theConsumed);
+        mLingerExpiredFlag = false;
+        CancelLingerTimer();
+        StartLingerTimer();
         ReportCompletion();
         if (inResetFlag || (mForcedAllocationInterval > 0 &&
                 (mStats.mOpsRecAppendCount % mForcedAllocationInterval) == 0)) {
@@ -1938,6 +2073,7 @@ private:
         if (inSec <= 0 || mSleepingFlag) {
             return false;
         }
+        CancelLingerTimer();
         KFS_LOG_STREAM_DEBUG << mLogPrefix <<
             "sleeping: "        << inSec <<
             " append: "         << mWriteQueue.front() <<
@@ -1963,6 +2099,15 @@ private:
             " cur op: "         <<
                 (mCurOpPtr ? mCurOpPtr->Show() : kKfsNullOp.Show()) <<
         KFS_LOG_EOM;
+        if (mLingerFlag && ! mSleepingFlag) {
+            CancelLingerTimer();
+            mLingerExpiredFlag = true;
+            mStats.mLingerTimeoutCount++;
+            if (! mCurOpPtr && mOpenFlag && mErrorCode == 0) {
+                StartAppend();
+            }
+            return;
+        }
         if (mSleepingFlag) {
             mNetManager.UnRegisterTimeoutHandler(this);
             mSleepingFlag = false;
@@ -2161,5 +2306,32 @@ WriteAppender::SetForcedAllocationInterval(
     return mImpl.SetForcedAllocationInterval(inInterval);
 }
 
+void
+WriteAppender::SetMaxLingerTime(
+    int inMs)
+{
+    mImpl.SetMaxLingerTime(inMs);
+}
+
+void
+WriteAppender::SetMaxSpaceReservationSize(
+    int inSize)
+{
+    mImpl.SetMaxSpaceReservationSize(inSize);
+}
+
+int
+WriteAppender::Flush()
+{
+    return mImpl.Flush();
+}
+
+void
+WriteAppender::SetLatencyStats(
+    ChunkServerLatencyStats* inStatsPtr)
+{
+    mImpl.SetLatencyStats(inStatsPtr);
+}
+
 }
 }
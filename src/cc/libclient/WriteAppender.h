@@ -40,6 +40,7 @@ namespace client
 {
 
 class ClientPool;
+class ChunkServerLatencyStats;
 
 // Kfs client write append state machine.
 class WriteAppender
@@ -78,7 +79,10 @@ public:
               mRetriesCount(0),
               mBufferCompactionCount(0),
               mAppendCount(0),
-              mAppendByteCount(0)
+              mAppendByteCount(0),
+              mFlushCount(0),
+              mLingerTimeoutCount(0),
+              mAppendLatencyMs(0)
             {}
         void Clear()
             { *this = Stats(); }
@@ -97,6 +101,9 @@ public:
             mBufferCompactionCount   += inStats.mBufferCompactionCount;
             mAppendCount             += inStats.mAppendCount;
             mAppendByteCount         += inStats.mAppendByteCount;
+            mFlushCount              += inStats.mFlushCount;
+            mLingerTimeoutCount      += inStats.mLingerTimeoutCount;
+            mAppendLatencyMs         += inStats.mAppendLatencyMs;
             return *this;
         }
         template<typename T>
@@ -115,6 +122,9 @@ public:
             inFunctor("BufferCompaction",   mBufferCompactionCount);
             inFunctor("AppendCount",        mAppendCount);
             inFunctor("AppendByteCount",    mAppendByteCount);
+            inFunctor("Flush",              mFlushCount);
+            inFunctor("LingerTimeout",      mLingerTimeoutCount);
+            inFunctor("AppendLatencyMs",    mAppendLatencyMs);
         }
         Counter mMetaOpsQueuedCount;
         Counter mMetaOpsCancelledCount;
@@ -128,6 +138,9 @@ public:
         Counter mBufferCompactionCount;
         Counter mAppendCount;
         Counter mAppendByteCount;
+        Counter mFlushCount;
+        Counter mLingerTimeoutCount;
+        Counter mAppendLatencyMs;
     };
     typedef KfsNetClient MetaServer;
     WriteAppender(
@@ -184,6 +197,21 @@ public:
     bool GetPreAllocation() const;
     void SetForcedAllocationInterval(
         int inInterval);
+    // Max. time in milliseconds to hold appended data below the write
+    // threshold, before issuing record append. The effective time adapts to
+    // the observed record append latency. Non positive value disables.
+    void SetMaxLingerTime(
+        int inMs);
+    // Max. chunk space reservation size. The reservation size starts with the
+    // default, and doubles, up to the max., while the reserved space is
+    // consumed quickly. The unused space is released with chunk close.
+    void SetMaxSpaceReservationSize(
+        int inSize);
+    // Append all currently buffered data regardless of the write threshold.
+    int Flush();
+    // Record chunk server append latencies and retries, if set.
+    void SetLatencyStats(
+        ChunkServerLatencyStats* inStatsPtr);
 private:
     class Impl;
     Impl& mImpl;
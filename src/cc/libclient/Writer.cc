@@ -48,6 +48,7 @@
 #include "utils.h"
 #include "KfsClient.h"
 #include "Monitor.h"
+#include "ChunkServerLatencyStats.h"
 
 namespace KFS
 {
@@ -131,7 +132,12 @@ public:
           mOpStartTime(0),
           mCompletionDepthCount(0),
           mStriperProcessCount(0),
-          mStriperPtr(0)
+          mStriperPtr(0),
+          mECThreadPoolPtr(0),
+          mLatencyStatsPtr(0),
+          mAllocWriteIdWithWriteFlag(false),
+          mNextChunkPreallocPos(0),
+          mTruncatePreallocFlag(false)
         { Writers::Init(mWriters); }
     int Open(
         kfsFileId_t inFileId,
@@ -199,6 +205,7 @@ public:
         mTruncateOp.pathname   = 0;
         mTruncateOp.fileOffset = mFileSize;
         mRetryCount            = 0;
+        mTruncatePreallocFlag  = false;
         return StartWrite();
     }
     int Close()
@@ -320,6 +327,21 @@ public:
     }
     Offset GetPendingSize() const
         { return (GetPendingSizeSelf() + mPendingCount); }
+    void SetECThreadPool(
+        ECThreadPool* inPoolPtr)
+        { mECThreadPoolPtr = inPoolPtr; }
+    void SetLatencyStats(
+        ChunkServerLatencyStats* inStatsPtr)
+        { mLatencyStatsPtr = inStatsPtr; }
+    void SetAllocWriteIdWithWrite(
+        bool inFlag)
+        { mAllocWriteIdWithWriteFlag = inFlag; }
+    void SetNextChunkPreallocRatio(
+        double inRatio)
+    {
+        mNextChunkPreallocPos = (0 < inRatio && inRatio < 1) ?
+            (Offset)(inRatio * (double)CHUNKSIZE) : Offset(0);
+    }
     int SetWriteThreshold(
         int inThreshold)
     {
@@ -380,6 +402,7 @@ private:
             size_t         mBeginBlock;
             size_t         mEndBlock;
             time_t         mOpStartTime;
+            int64_t        mStartUsec;
             bool           mChecksumValidFlag;
             WriteOp*       mPrevPtr[1];
             WriteOp*       mNextPtr[1];
@@ -392,6 +415,7 @@ private:
                   mBeginBlock(0),
                   mEndBlock(0),
                   mOpStartTime(0),
+                  mStartUsec(0),
                   mChecksumValidFlag(false)
                 { Queue::Init(*this); }
             void Delete(
@@ -509,6 +533,8 @@ private:
               mLastOpPtr(0),
               mSleepingFlag(false),
               mClosingFlag(false),
+              mAllocWriteIdWithWriteFlag(false),
+              mPreallocFlag(false),
               mLogPrefix(inLogPrefix),
               mOpDoneFlagPtr(0),
               mInFlightBlocks(),
@@ -534,6 +560,10 @@ private:
         }
         ~ChunkWriter()
         {
+            if (mPreallocFlag) {
+                // The chunk might have been allocated, but was never written.
+                mOuter.mTruncatePreallocFlag = true;
+            }
             ChunkWriter::Shutdown();
             ChunkServer::Stats theStats;
             mChunkServer.GetStats(theStats);
@@ -564,6 +594,7 @@ private:
             const Offset kChunkSize         = (Offset)CHUNKSIZE;
             const int    kChecksumBlockSize = (int)CHECKSUM_BLOCKSIZE;
             QCRTASSERT(inOffset >= 0 && ! mClosingFlag);
+            mPreallocFlag = false;
             const Offset theChunkOffset = inOffset % kChunkSize;
             if (mAllocOp.fileOffset < 0) {
                 mAllocOp.fileOffset = inOffset - theChunkOffset;
@@ -727,9 +758,13 @@ private:
             // this.
             // Other methods of this class have to return immediately (unwind)
             // after invoking StartWrite().
-            if (mAllocOp.chunkId > 0 && ! mWriteIds.empty()) {
+            if (mAllocOp.chunkId > 0 &&
+                    (! mWriteIds.empty() || mAllocWriteIdWithWriteFlag)) {
                 if (CanWrite()) {
                     Write();
+                } else if (mAllocWriteIdWithWriteFlag) {
+                    mAllocWriteIdWithWriteFlag = false;
+                    Enqueue(mWriteIdAllocOp);
                 } else {
                     UpdateLease();
                 }
@@ -738,6 +773,27 @@ private:
                 AllocateChunk();
             }
         }
+        // Allocate the chunk ahead of the writes, in order to hide the chunk
+        // allocation latency with sequential writes.
+        void Preallocate(
+            Offset inFileOffset)
+        {
+            QCASSERT(
+                mAllocOp.fileOffset < 0 && ! mLastOpPtr &&
+                0 <= inFileOffset && inFileOffset % CHUNKSIZE == 0
+            );
+            mAllocOp.fileOffset = inFileOffset;
+            mOpenChunkBlockFileOffset = mAllocOp.fileOffset -
+                mAllocOp.fileOffset % mOuter.mOpenChunkBlockSize;
+            mPreallocFlag = true;
+            KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+                "preallocating chunk: offset: " << inFileOffset <<
+            KFS_LOG_EOM;
+            Reset();
+            AllocateChunk();
+        }
+        bool IsPreallocated() const
+            { return mPreallocFlag; }
         void Close()
         {
             if (! mClosingFlag && IsOpen()) {
@@ -811,6 +867,8 @@ private:
         KfsOp*         mLastOpPtr;
         bool           mSleepingFlag;
         bool           mClosingFlag;
+        bool           mAllocWriteIdWithWriteFlag;
+        bool           mPreallocFlag;
         string const   mLogPrefix;
         bool*          mOpDoneFlagPtr;
         ChecksumBlocks mInFlightBlocks;
@@ -844,7 +902,7 @@ private:
                 mAllocOp.fileOffset >= 0 &&
                 (! Queue::IsEmpty(mPendingQueue) ||
                     (0 < mCloseOp.chunkId && mCloseOp.chunkVersion < 0) ||
-                    mKeepLeaseFlag)
+                    mKeepLeaseFlag || mPreallocFlag)
             );
             Reset(mAllocOp);
             if (0 == mOuter.mReplicaCount) {
@@ -948,6 +1006,7 @@ private:
         {
             QCASSERT(mAllocOp.chunkId > 0 && ! mAllocOp.chunkServers.empty());
             Reset(mWriteIdAllocOp);
+            mAllocWriteIdWithWriteFlag                  = false;
             mWriteIdAllocOp.chunkId                     = mAllocOp.chunkId;
             mWriteIdAllocOp.chunkVersion                = mAllocOp.chunkVersion;
             mWriteIdAllocOp.isForRecordAppend           = false;
@@ -1022,6 +1081,16 @@ private:
                         mAllocOp.chunkServers[0],
                         kCancelPendingOpsFlag,
                         &mWriteIdAllocOp.statusMsg)) {
+                    if (mOuter.mAllocWriteIdWithWriteFlag &&
+                            0 <= mAllocOp.chunkVersion &&
+                            CanWrite() &&
+                            ! mAllocOp.invalidateAllFlag) {
+                        // Send the write id allocation with the first write,
+                        // the write id alloc op holds the access parameters.
+                        mAllocWriteIdWithWriteFlag = true;
+                        StartWrite();
+                        return;
+                    }
                     Enqueue(mWriteIdAllocOp);
                     return;
                 }
@@ -1126,9 +1195,21 @@ private:
                 HandleError(inOp);
                 return;
             }
-            const size_t theServerCount = inOp.chunkServerLoc.size();
+            if (! SetWriteIds(inOp.writeIdStr)) {
+                HandleError(inOp);
+                return;
+            }
+            UpdateAccess(inOp);
+            UpdateLeaseExpirationTime();
+            StartWrite();
+        }
+        bool SetWriteIds(
+            const string& inWriteIdStr)
+        {
+            mWriteIds.clear();
+            const size_t theServerCount = mAllocOp.chunkServers.size();
             mWriteIds.reserve(theServerCount);
-            istringstream theStream(inOp.writeIdStr);
+            istringstream theStream(inWriteIdStr);
             for (size_t i = 0; i < theServerCount; i++) {
                 WriteInfo theWInfo;
                 if (! (theStream >>
@@ -1139,19 +1220,17 @@ private:
                         "write id alloc:"
                         " at index: "         << i <<
                         " of: "               << theServerCount <<
-                        " invalid response: " << inOp.writeIdStr <<
+                        " invalid response: " << inWriteIdStr <<
                     KFS_LOG_EOM;
                     break;
                 }
                 mWriteIds.push_back(theWInfo);
             }
             if (theServerCount != mWriteIds.size()) {
-                HandleError(inOp);
-                return;
+                mWriteIds.clear();
+                return false;
             }
-            UpdateAccess(inOp);
-            UpdateLeaseExpirationTime();
-            StartWrite();
+            return true;
         }
         void Write()
         {
@@ -1165,6 +1244,7 @@ private:
             while (! mSleepingFlag &&
                     mErrorCode == 0 &&
                     mAllocOp.chunkId > 0 &&
+                    (! mWriteIds.empty() || mAllocWriteIdWithWriteFlag) &&
                     (theOpPtr = theIt.Next())) {
                 Write(*theOpPtr);
                 if (theOpDoneFlag) {
@@ -1188,19 +1268,45 @@ private:
             inWriteOp.mWritePrepareOp.chunkId            = mAllocOp.chunkId;
             inWriteOp.mWritePrepareOp.chunkVersion       =
                 mAllocOp.chunkVersion;
-            inWriteOp.mWritePrepareOp.writeInfo          = mWriteIds;
             inWriteOp.mWritePrepareOp.contentLength      =
                 inWriteOp.contentLength;
             inWriteOp.mWritePrepareOp.numBytes           =
                 inWriteOp.contentLength;
-            inWriteOp.mWritePrepareOp.replyRequestedFlag =
-                mWriteIdAllocOp.writePrepReplySupportedFlag;
-            // No need to recompute checksums on retry. Presently the buffer
-            // remains the unchanged.
-            SetAccess(
-                inWriteOp.mWritePrepareOp,
-                inWriteOp.mWritePrepareOp.replyRequestedFlag
-            );
+            inWriteOp.mWritePrepareOp.allocWriteIdFlag   =
+                mAllocWriteIdWithWriteFlag;
+            inWriteOp.mWritePrepareOp.writeIdStr.clear();
+            if (mAllocWriteIdWithWriteFlag) {
+                // The chunk servers allocate the write ids, and return these
+                // with the write prepare reply. Wait for the reply before
+                // issuing other writes.
+                mAllocWriteIdWithWriteFlag = false;
+                inWriteOp.mWritePrepareOp.writeInfo.clear();
+                for (vector<ServerLocation>::const_iterator theIt =
+                            mAllocOp.chunkServers.begin();
+                        theIt != mAllocOp.chunkServers.end();
+                        ++theIt) {
+                    inWriteOp.mWritePrepareOp.writeInfo.push_back(
+                        WriteInfo(*theIt, -1));
+                }
+                inWriteOp.mWritePrepareOp.replyRequestedFlag = true;
+                inWriteOp.mWritePrepareOp.access = mWriteIdAllocOp.access;
+                inWriteOp.mWritePrepareOp.createChunkAccessFlag =
+                    mWriteIdAllocOp.createChunkAccessFlag;
+                inWriteOp.mWritePrepareOp.createChunkServerAccessFlag =
+                    mWriteIdAllocOp.createChunkServerAccessFlag;
+                inWriteOp.mWritePrepareOp.decryptKey =
+                    mWriteIdAllocOp.decryptKey;
+            } else {
+                inWriteOp.mWritePrepareOp.writeInfo          = mWriteIds;
+                inWriteOp.mWritePrepareOp.replyRequestedFlag =
+                    mWriteIdAllocOp.writePrepReplySupportedFlag;
+                // No need to recompute checksums on retry. Presently the
+                // buffer remains the unchanged.
+                SetAccess(
+                    inWriteOp.mWritePrepareOp,
+                    inWriteOp.mWritePrepareOp.replyRequestedFlag
+                );
+            }
             if (inWriteOp.mWritePrepareOp.replyRequestedFlag) {
                 if (! inWriteOp.mChecksumValidFlag) {
                     inWriteOp.mWritePrepareOp.checksum = ComputeBlockChecksum(
@@ -1234,6 +1340,7 @@ private:
                 SetAccess(inWriteOp.mWriteSyncOp);
             }
             inWriteOp.mOpStartTime = Now();
+            inWriteOp.mStartUsec   = microseconds();
             Queue::Remove(mPendingQueue, inWriteOp);
             Queue::PushBack(mInFlightQueue, inWriteOp);
             mOuter.mStats.mOpsWriteCount++;
@@ -1252,10 +1359,37 @@ private:
             for (size_t i = inOp.mBeginBlock; i < inOp.mEndBlock; i++) {
                 mInFlightBlocks.set(i, 0);
             }
+            const bool theAllocWriteIdFlag =
+                inOp.mWritePrepareOp.allocWriteIdFlag;
+            inOp.mWritePrepareOp.allocWriteIdFlag = false;
+            if (theAllocWriteIdFlag && ! inCanceledFlag && 0 <= inOp.status &&
+                    ! SetWriteIds(inOp.mWritePrepareOp.writeIdStr)) {
+                inOp.status    = kErrorParameters;
+                inOp.statusMsg = "invalid write prepare write id reply";
+            }
+            if (theAllocWriteIdFlag && ! inCanceledFlag) {
+                if (inOp.status < 0) {
+                    // Chunk servers might not support the write id allocation
+                    // with the write, use write id alloc op from now on.
+                    KFS_LOG_STREAM_ERROR << mLogPrefix <<
+                        "write id allocation with write failure: " <<
+                            inOp.statusMsg <<
+                        " disabling write id allocation with write" <<
+                    KFS_LOG_EOM;
+                    mOuter.mAllocWriteIdWithWriteFlag = false;
+                } else {
+                    mWriteIdAllocOp.writePrepReplySupportedFlag = true;
+                }
+            }
             if (inCanceledFlag || inOp.status < 0) {
                 Queue::Remove(mInFlightQueue, inOp);
                 Queue::PushBack(mPendingQueue, inOp);
                 if (! inCanceledFlag) {
+                    if (mOuter.mLatencyStatsPtr) {
+                        mOuter.mLatencyStatsPtr->AddRetry(
+                            ChunkServerLatencyStats::kOpTypeWrite,
+                            mChunkServer.GetServerLocation());
+                    }
                     Monitor::ReportError(
                             Monitor::kWriteOpError,
                             mOuter.mMetaServer.GetServerLocation(),
@@ -1273,6 +1407,12 @@ private:
                 mPendingCount >= theDoneCount
             );
             mPendingCount -= theDoneCount;
+            if (mOuter.mLatencyStatsPtr) {
+                mOuter.mLatencyStatsPtr->Add(
+                    ChunkServerLatencyStats::kOpTypeWrite,
+                    mChunkServer.GetServerLocation(),
+                    microseconds() - inOp.mStartUsec);
+            }
             if (inOp.mWritePrepareOp.replyRequestedFlag) {
                 UpdateAccess(inOp.mWritePrepareOp);
             } else {
@@ -1454,8 +1594,9 @@ private:
             }
             Reset(mAllocOp);
             mWriteIds.clear();
-            mAllocOp.chunkId = 0;
-            mLastOpPtr       = 0;
+            mAllocOp.chunkId           = 0;
+            mLastOpPtr                 = 0;
+            mAllocWriteIdWithWriteFlag = false;
             mChunkServer.Stop();
             QCASSERT(Queue::IsEmpty(mInFlightQueue));
             if (mSleepingFlag) {
@@ -1734,6 +1875,11 @@ private:
     int                 mCompletionDepthCount;
     int                 mStriperProcessCount;
     Striper*            mStriperPtr;
+    ECThreadPool*       mECThreadPoolPtr;
+    ChunkServerLatencyStats* mLatencyStatsPtr;
+    bool                mAllocWriteIdWithWriteFlag;
+    Offset              mNextChunkPreallocPos;
+    bool                mTruncatePreallocFlag;
     ChunkWriter*        mWriters[1];
 
     void InternalError(
@@ -1817,7 +1963,9 @@ private:
     }
     void SetFileSize()
     {
-        if ((! mStriperPtr && 0 != mReplicaCount) ||
+        // Truncate to remove the trailing preallocated, but not written chunk,
+        // if any.
+        if ((! mStriperPtr && 0 != mReplicaCount && ! mTruncatePreallocFlag) ||
                 mErrorCode != 0 || 0 <= mTruncateOp.fid) {
             return;
         }
@@ -1939,9 +2087,41 @@ private:
         );
         if (theQueuedCount > 0) {
             mOffset += theQueuedCount;
+            PreallocateNextChunk();
             StartQueuedWrite(theQueuedCount);
         }
     }
+    void PreallocateNextChunk()
+    {
+        // Only regular, non striped files are written strictly sequentially
+        // one chunk at a time.
+        if (mNextChunkPreallocPos <= 0 || mStriperPtr || mReplicaCount <= 0 ||
+                mClosingFlag || mErrorCode != 0 ||
+                Writers::IsEmpty(mWriters)) {
+            return;
+        }
+        const Offset theChunkPos = mOffset % CHUNKSIZE;
+        if (theChunkPos < mNextChunkPreallocPos) {
+            return;
+        }
+        const Offset theNextOffset = mOffset - theChunkPos + CHUNKSIZE;
+        Writers::Iterator theIt(mWriters);
+        ChunkWriter* thePtr;
+        while ((thePtr = theIt.Next())) {
+            if (thePtr->GetFileOffset() == theNextOffset) {
+                return;
+            }
+        }
+        ChunkWriter& theCurWriter = *Writers::Front(mWriters);
+        mChunkServerInitialSeqNum += 10000;
+        ChunkWriter& theWriter = *(new ChunkWriter(
+            *this, mChunkServerInitialSeqNum, mLogPrefix));
+        // Keep the writer with the queued writes first in the list, and
+        // prevent the completion from deleting the writers.
+        Writers::PushFront(mWriters, theCurWriter);
+        QCStValueIncrementor<int> theIncrement(mCompletionDepthCount, 1);
+        theWriter.Preallocate(theNextOffset);
+    }
     int QueueWrite(
         IOBuffer& inBuffer,
         int       inSize,
@@ -2004,6 +2184,11 @@ private:
         if (! inWriter.IsOpen() || mClosingFlag) {
             return true;
         }
+        // Keep the preallocated chunk open until the writes reach it, or the
+        // file is closed.
+        if (inWriter.IsPreallocated()) {
+            return false;
+        }
         // The most recently used should always be first.
         const ChunkWriter* const thePtr = Writers::Front(mWriters);
         if (! thePtr) {
@@ -2152,6 +2337,12 @@ Writer::Striper::QueueWrite(
     return theQueuedCount;
 }
 
+ECThreadPool*
+Writer::Striper::GetECThreadPool() const
+{
+    return mOuter.mECThreadPoolPtr;
+}
+
 void
 Writer::Striper::StartQueuedWrite(
     int inQueuedCount)
@@ -2288,6 +2479,38 @@ Writer::SetWriteThreshold(
     return mImpl.SetWriteThreshold(inThreshold);
 }
 
+void
+Writer::SetECThreadPool(
+    ECThreadPool* inPoolPtr)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetECThreadPool(inPoolPtr);
+}
+
+void
+Writer::SetLatencyStats(
+    ChunkServerLatencyStats* inStatsPtr)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetLatencyStats(inStatsPtr);
+}
+
+void
+Writer::SetAllocWriteIdWithWrite(
+    bool inFlag)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetAllocWriteIdWithWrite(inFlag);
+}
+
+void
+Writer::SetNextChunkPreallocRatio(
+    double inRatio)
+{
+    Impl::StRef theRef(mImpl);
+    mImpl.SetNextChunkPreallocRatio(inRatio);
+}
+
 int
 Writer::Flush()
 {
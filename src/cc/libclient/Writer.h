@@ -40,6 +40,9 @@ namespace client
 {
 using std::string;
 
+class ECThreadPool;
+class ChunkServerLatencyStats;
+
 // Kfs client write protocol state machine.
 class Writer
 {
@@ -175,6 +178,7 @@ public:
             int inQueuedCount);
         bool IsWriteQueued() const
             { return mWriteQueuedFlag; }
+        ECThreadPool* GetECThreadPool() const;
     private:
         Impl& mOuter;
         bool  mWriteQueuedFlag;
@@ -216,6 +220,20 @@ public:
         int       inWriteThreshold = -1);
     int SetWriteThreshold(
         int inThreshold);
+    // Use the thread pool for the recovery stripes computation, if set.
+    void SetECThreadPool(
+        ECThreadPool* inPoolPtr);
+    // Record chunk server write latencies and retries, if set.
+    void SetLatencyStats(
+        ChunkServerLatencyStats* inStatsPtr);
+    // Send the chunk write id allocation along with the first chunk write,
+    // instead of waiting for the write id allocation completion.
+    void SetAllocWriteIdWithWrite(
+        bool inFlag);
+    // Allocate the next chunk in the background once the sequential writes
+    // reach the specified fraction of the current chunk; 0 disables.
+    void SetNextChunkPreallocRatio(
+        double inRatio);
     int Flush();
     void Stop();
     void Shutdown();
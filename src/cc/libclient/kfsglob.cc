@@ -36,12 +36,15 @@
 #include <string.h>
 #include <stdlib.h>
 #include <glob.h>
+#include <fnmatch.h>
 #include <dirent.h>
 #include <errno.h>
 #include <sys/stat.h>
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <map>
 #include <algorithm>
 
 // Enabling thread local assumes that the libc glob() implementation is
@@ -58,12 +61,15 @@ namespace client
 {
 using std::vector;
 using std::string;
+using std::deque;
+using std::map;
 using std::find;
 
 class KfsOpenDir
 {
 private:
-    typedef struct stat StatBuf;
+    typedef struct stat         StatBuf;
+    typedef vector<KfsFileAttr> DirConent;
 public:
     class Glob : private QCRefCountedObj
     {
@@ -111,7 +117,15 @@ public:
               mOpenDirs(),
               mError(0),
               mCwd(),
-              mTmpName()
+              mTmpName(),
+              mGlobFlags(0),
+              mPrefetchFlag(false),
+              mComponents(),
+              mPrefetchQueue(),
+              mPrefetched(),
+              mPrefetchPaths(),
+              mPrefetchResults(),
+              mPrefetchStatus()
         {
             // Insure that the mutex constructor is invoked.
             GetMutexPtr();
@@ -153,6 +167,7 @@ public:
             if (*mCwd.rbegin() != '/') {
                 mCwd += "/";
             }
+            SetPattern(inGlobPtr, inGlobFlags);
             inResultPtr->gl_closedir = &Glob::CloseDir;
             inResultPtr->gl_readdir  = &Glob::ReadDir;
             inResultPtr->gl_opendir  = &Glob::OpenDir;
@@ -194,21 +209,31 @@ public:
             KfsOpenDir& theDir = mDirToReusePtr ?
                 mDirToReusePtr->Clear() : *(new KfsOpenDir());
             mDirToReusePtr = 0;
-            const bool kComputeFileSizeFlag   = false;
-            const bool kUpdateClientCacheFlag = true; // Cache dirs i-nodes.
-            const bool kFileIdAndTypeOnlyFalg = true;
-            mError = mClientPtr->ReaddirPlus(
-                theDirNamePtr,
-                theDir.mDirContent,
-                kComputeFileSizeFlag,
-                kUpdateClientCacheFlag,
-                kFileIdAndTypeOnlyFalg
-            );
+            Prefetched::iterator const theIt = mPrefetchFlag ?
+                mPrefetched.find(Normalize(theDirNamePtr)) :
+                mPrefetched.end();
+            if (theIt != mPrefetched.end()) {
+                theDir.mDirContent.swap(theIt->second);
+                mPrefetched.erase(theIt);
+                mError = 0;
+            } else {
+                mError = mClientPtr->ReaddirPlus(
+                    theDirNamePtr,
+                    theDir.mDirContent,
+                    kComputeFileSizeFlag,
+                    kUpdateClientCacheFlag,
+                    kFileIdAndTypeOnlyFalg
+                );
+            }
             if (mError != 0) {
                 mDirToReusePtr = &(theDir.Clear());
                 errno = mError < 0 ? -mError : mError;
                 return 0;
             }
+            if (mPrefetchFlag) {
+                Predict(theDirNamePtr, theDir.mDirContent);
+                Prefetch();
+            }
             theDir.Reset(theDirNamePtr);
             if (mOpenDirs.capacity() == 0) {
                 mOpenDirs.reserve(16);
@@ -277,14 +302,33 @@ public:
             return 0;
         }
     private:
-        typedef vector<KfsOpenDir*> OpenDirs;
+        typedef vector<KfsOpenDir*>      OpenDirs;
+        typedef map<string, DirConent>   Prefetched;
+        typedef vector<DirConent>        PrefetchResults;
+        enum
+        {
+            // The number of directories listed with one batch request, the
+            // batch requests are pipelined up to client.metaMaxPendingOps.
+            kPrefetchBatchSize = 64
+        };
+        static const bool kComputeFileSizeFlag   = false;
+        static const bool kUpdateClientCacheFlag = true; // Cache dirs i-nodes.
+        static const bool kFileIdAndTypeOnlyFalg = true;
 
-        KfsClient*  mClientPtr;
-        KfsOpenDir* mDirToReusePtr;
-        OpenDirs    mOpenDirs;
-        int         mError;
-        string      mCwd;
-        string      mTmpName;
+        KfsClient*      mClientPtr;
+        KfsOpenDir*     mDirToReusePtr;
+        OpenDirs        mOpenDirs;
+        int             mError;
+        string          mCwd;
+        string          mTmpName;
+        int             mGlobFlags;
+        bool            mPrefetchFlag;
+        vector<string>  mComponents;
+        deque<string>   mPrefetchQueue;
+        Prefetched      mPrefetched;
+        vector<string>  mPrefetchPaths;
+        PrefetchResults mPrefetchResults;
+        vector<int>     mPrefetchStatus;
 
 #ifdef KFS_GLOB_USE_THREAD_LOCAL
         static __thread Glob* sInstancePtr;
@@ -311,6 +355,163 @@ public:
             mCwd.clear();
             mTmpName.clear();
             mClientPtr = 0;
+            mGlobFlags = 0;
+            mPrefetchFlag = false;
+            mComponents.clear();
+            mPrefetchQueue.clear();
+            mPrefetched.clear();
+            mPrefetchPaths.clear();
+            mPrefetchResults.clear();
+            mPrefetchStatus.clear();
+        }
+        static void Split(
+            const char*     inPathPtr,
+            vector<string>& outComponents)
+        {
+            outComponents.clear();
+            const char* thePtr = inPathPtr;
+            while (*thePtr) {
+                while (*thePtr == '/') {
+                    ++thePtr;
+                }
+                const char* const theStartPtr = thePtr;
+                while (*thePtr && *thePtr != '/') {
+                    ++thePtr;
+                }
+                if (theStartPtr < thePtr) {
+                    outComponents.push_back(
+                        string(theStartPtr, thePtr - theStartPtr));
+                }
+            }
+        }
+        static string Normalize(
+            const char* inPathPtr)
+        {
+            vector<string> theComponents;
+            Split(inPathPtr, theComponents);
+            string theRet;
+            for (vector<string>::const_iterator theIt = theComponents.begin();
+                    theIt != theComponents.end();
+                    ++theIt) {
+                theRet += "/";
+                theRet += *theIt;
+            }
+            return (theRet.empty() ? string("/") : theRet);
+        }
+        bool HasMagic(
+            const string& inComponent) const
+        {
+            // Treat escapes as magic, in order to let fnmatch() handle these.
+            return (inComponent.find_first_of(
+                (mGlobFlags & GLOB_NOESCAPE) != 0 ? "*?[" : "*?[\\") !=
+                string::npos);
+        }
+        void SetPattern(
+            const char* inGlobPtr,
+            int         inGlobFlags)
+        {
+            // Glob expands the pattern one directory level at a time, and
+            // opens the directories of each level one by one. Predict the
+            // directories that glob will open next from the pattern and the
+            // listing of the directory that glob has opened, and list the
+            // predicted directories ahead with the pipelined batch requests.
+            // Miss predictions only affect performance, as glob still issues
+            // all requests, and the directories that were not prefetched are
+            // listed on demand.
+            mGlobFlags    = inGlobFlags;
+            mPrefetchFlag = inGlobPtr && *inGlobPtr;
+#ifdef GLOB_BRACE
+            if ((inGlobFlags & GLOB_BRACE) != 0 && strchr(inGlobPtr, '{')) {
+                mPrefetchFlag = false;
+            }
+#endif
+#ifdef GLOB_TILDE
+            if ((inGlobFlags & GLOB_TILDE) != 0 && *inGlobPtr == '~') {
+                mPrefetchFlag = false;
+            }
+#endif
+            if (! mPrefetchFlag) {
+                return;
+            }
+            Split(GetAbsPathName(inGlobPtr), mComponents);
+        }
+        void Predict(
+            const char*      inDirNamePtr,
+            const DirConent& inDirContent)
+        {
+            vector<string> theComponents;
+            Split(inDirNamePtr, theComponents);
+            const size_t theLevel = theComponents.size();
+            if (mComponents.size() <= theLevel ||
+                    ! HasMagic(mComponents[theLevel])) {
+                return;
+            }
+            // Glob opens the matching directory for the next component with
+            // wildcards, and only stats the components in between.
+            string theSuffix;
+            size_t theNext = theLevel + 1;
+            while (theNext < mComponents.size() &&
+                    ! HasMagic(mComponents[theNext])) {
+                theSuffix += "/";
+                theSuffix += mComponents[theNext];
+                theNext++;
+            }
+            if (mComponents.size() <= theNext) {
+                return;
+            }
+            const string thePrefix = Normalize(inDirNamePtr);
+            const char*  theSepPtr = thePrefix == "/" ? "" : "/";
+            const int    theFlags  =
+                ((mGlobFlags & GLOB_PERIOD) != 0 ? 0 : FNM_PERIOD) |
+                ((mGlobFlags & GLOB_NOESCAPE) != 0 ? FNM_NOESCAPE : 0);
+            const char* const thePatternPtr = mComponents[theLevel].c_str();
+            for (DirConent::const_iterator theIt = inDirContent.begin();
+                    theIt != inDirContent.end();
+                    ++theIt) {
+                if (! theIt->isDirectory ||
+                        theIt->filename == "." || theIt->filename == ".." ||
+                        fnmatch(thePatternPtr, theIt->filename.c_str(),
+                            theFlags) != 0) {
+                    continue;
+                }
+                mPrefetchQueue.push_back(
+                    thePrefix + theSepPtr + theIt->filename + theSuffix);
+            }
+        }
+        void Prefetch()
+        {
+            // Keep up to two batches listed ahead, and bound the memory use
+            // in the case of miss predictions.
+            if (mPrefetchQueue.empty() ||
+                    (size_t)kPrefetchBatchSize < mPrefetched.size()) {
+                return;
+            }
+            mPrefetchPaths.clear();
+            while (! mPrefetchQueue.empty() &&
+                    mPrefetchPaths.size() < (size_t)kPrefetchBatchSize) {
+                if (mPrefetched.find(mPrefetchQueue.front()) ==
+                        mPrefetched.end()) {
+                    mPrefetchPaths.push_back(mPrefetchQueue.front());
+                }
+                mPrefetchQueue.pop_front();
+            }
+            mClientPtr->ReaddirPlus(
+                mPrefetchPaths,
+                mPrefetchResults,
+                mPrefetchStatus,
+                kComputeFileSizeFlag,
+                kUpdateClientCacheFlag,
+                kFileIdAndTypeOnlyFalg
+            );
+            for (size_t i = 0; i < mPrefetchPaths.size() &&
+                    i < mPrefetchResults.size() &&
+                    i < mPrefetchStatus.size(); i++) {
+                // Errors are reported by the on demand listing.
+                if (mPrefetchStatus[i] == 0) {
+                    mPrefetched[mPrefetchPaths[i]].swap(mPrefetchResults[i]);
+                }
+            }
+            mPrefetchResults.clear();
         }
         const char* GetAbsPathName(
             const char* inPathNamePtr)
@@ -330,7 +531,6 @@ public:
     };
     friend class Glob;
 private:
-    typedef vector<KfsFileAttr> DirConent;
     class DirEntry : public dirent
     {
     public:
@@ -32,9 +32,33 @@
 #include "common/BufferedLogWriter.h"
 #include "common/kfserrno.h"
 #include "common/IntToString.h"
+#include "common/kfsatomic.h"
+#include "common/MsgLogger.h"
+#include "common/Properties.h"
+#include "common/time.h"
+#include "qcdio/QCThread.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/QCUtils.h"
+#include "qcdio/qcstutils.h"
+
+#include <boost/static_assert.hpp>
+
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <arpa/inet.h>
 
 namespace KFS
 {
+using std::vector;
+
+BOOST_STATIC_ASSERT(sizeof(AuditLogRecord) == 80);
+BOOST_STATIC_ASSERT(sizeof(AuditLogFileHeader) == 16);
 
 class AuditLogWriter : public BufferedLogWriter::Writer
 {
@@ -121,10 +145,370 @@ GetAuditMsgWriter()
     return sAuditMsgWriter;
 }
 
+// Binary audit log writer. The request processing threads append fixed size
+// records into the bounded lock free multiple producers single consumer
+// queue. Each queue slot has a sequence number, the producer claims the slot
+// by advancing the queue head with compare and swap, and publishes the
+// record by setting the slot sequence. The records are dropped if the queue
+// is full. The writer thread periodically drains the queue, and writes the
+// records into the log file, rotating the file when it reaches the max size.
+class BinaryAuditLogWriter : public QCRunnable
+{
+public:
+    BinaryAuditLogWriter()
+        : QCRunnable(),
+          mMutex(),
+          mCond(),
+          mThread(),
+          mSlotsPtr(0),
+          mMask(0),
+          mHead(0),
+          mTail(0),
+          mDroppedCount(0),
+          mRunFlag(false),
+          mStopFlag(false),
+          mFileName(),
+          mMaxFileSize(int64_t(256) << 20),
+          mMaxFiles(16),
+          mFlushIntervalMs(100),
+          mQueueSize(1 << 16),
+          mFd(-1),
+          mFileSize(0),
+          mReportedDroppedCount(0),
+          mWriteBuf()
+        {}
+    ~BinaryAuditLogWriter()
+    {
+        BinaryAuditLogWriter::Stop();
+        delete [] mSlotsPtr;
+    }
+    void SetParameters(
+        const Properties& inProps,
+        const char*       inPrefixPtr)
+    {
+        Properties::String theName(inPrefixPtr);
+        const size_t       thePrefLen = theName.GetSize();
+        const string theFileName = inProps.getValue(
+            theName.Truncate(thePrefLen).Append("fileName"), mFileName);
+        QCStMutexLocker theLocker(mMutex);
+        mMaxFileSize = inProps.getValue(
+            theName.Truncate(thePrefLen).Append("maxFileSize"), mMaxFileSize);
+        mMaxFiles = inProps.getValue(
+            theName.Truncate(thePrefLen).Append("maxFiles"), mMaxFiles);
+        mFlushIntervalMs = max(1, inProps.getValue(
+            theName.Truncate(thePrefLen).Append("flushIntervalMs"),
+            mFlushIntervalMs));
+        const int theQueueSize = inProps.getValue(
+            theName.Truncate(thePrefLen).Append("queueSize"), mQueueSize);
+        if (mThread.IsStarted() && theFileName == mFileName) {
+            return;
+        }
+        theLocker.Unlock();
+        Stop();
+        mFileName  = theFileName;
+        mQueueSize = theQueueSize;
+        if (mFileName.empty()) {
+            return;
+        }
+        Start();
+    }
+    bool IsRunning() const
+        { return mRunFlag; }
+    void Append(
+        const MetaRequest& inOp)
+    {
+        if (! mRunFlag) {
+            return;
+        }
+        uint64_t thePos = mHead;
+        Slot*    theSlotPtr;
+        for (; ;) {
+            theSlotPtr = mSlotsPtr + (thePos & mMask);
+            const uint64_t theSeq = theSlotPtr->mSeq;
+            if (theSeq == thePos) {
+                if (SyncCompareAndSwap(mHead, thePos, thePos + 1)) {
+                    break;
+                }
+                thePos = mHead;
+            } else if (theSeq < thePos) {
+                SyncAddAndFetch(mDroppedCount, uint64_t(1));
+                return;
+            } else {
+                thePos = mHead;
+            }
+        }
+        Fill(inOp, theSlotPtr->mRecord);
+        SyncMemoryBarrier();
+        theSlotPtr->mSeq = thePos + 1;
+    }
+    void Stop()
+    {
+        if (! mThread.IsStarted()) {
+            return;
+        }
+        mRunFlag = false;
+        QCStMutexLocker theLocker(mMutex);
+        mStopFlag = true;
+        mCond.Notify();
+        theLocker.Unlock();
+        mThread.Join();
+        Drain();
+        CloseFile();
+    }
+    void PrepareToFork()
+        { mMutex.Lock(); }
+    void ForkDone()
+        { mMutex.Unlock(); }
+    void ChildAtFork()
+    {
+        // The writer thread does not exist in the child process.
+        mRunFlag = false;
+        mMutex.Unlock();
+    }
+    virtual void Run()
+    {
+        QCStMutexLocker theLocker(mMutex);
+        while (! mStopFlag) {
+            mCond.Wait(mMutex,
+                QCMutex::Time(mFlushIntervalMs) * 1000 * 1000);
+            QCStMutexUnlocker theUnlocker(mMutex);
+            Drain();
+        }
+    }
+private:
+    struct Slot
+    {
+        volatile uint64_t mSeq;
+        AuditLogRecord    mRecord;
+    };
+    enum { kMaxWriteBatch = 1 << 10 };
+
+    QCMutex           mMutex;
+    QCCondVar         mCond;
+    QCThread          mThread;
+    Slot*             mSlotsPtr;
+    uint64_t          mMask;
+    volatile uint64_t mHead;
+    uint64_t          mTail;
+    volatile uint64_t mDroppedCount;
+    volatile bool     mRunFlag;
+    bool              mStopFlag;
+    string            mFileName;
+    int64_t           mMaxFileSize;
+    int               mMaxFiles;
+    int               mFlushIntervalMs;
+    int               mQueueSize;
+    int               mFd;
+    int64_t           mFileSize;
+    uint64_t          mReportedDroppedCount;
+    vector<char>      mWriteBuf;
+
+    void Start()
+    {
+        // The queue is allocated once, and never re-sized, as the producers
+        // might still be accessing it after stop. The records appended after
+        // stop are written after the restart.
+        if (! mSlotsPtr) {
+            uint64_t theSize = 1;
+            while (theSize < (uint64_t)max(2, mQueueSize)) {
+                theSize <<= 1;
+            }
+            mSlotsPtr = new Slot[theSize];
+            for (uint64_t i = 0; i < theSize; i++) {
+                mSlotsPtr[i].mSeq = i;
+            }
+            mMask = theSize - 1;
+            mHead = 0;
+            mTail = 0;
+        }
+        mStopFlag = false;
+        mWriteBuf.resize(kMaxWriteBatch * sizeof(AuditLogRecord));
+        SyncMemoryBarrier();
+        mRunFlag  = true;
+        const int kStackSize = 64 << 10;
+        mThread.Start(this, kStackSize, "AuditLogWriter");
+    }
+    static void Fill(
+        const MetaRequest& inOp,
+        AuditLogRecord&    outRec)
+    {
+        const int64_t theNow   = microseconds();
+        const int64_t theStart = 0 < inOp.recvTime ?
+            inOp.recvTime : inOp.submitTime;
+        memset(&outRec, 0, sizeof(outRec));
+        outRec.mTimeUsec        = theNow;
+        outRec.mDurationUsec    = 0 < theStart ? theNow - theStart : -1;
+        outRec.mSeq             = inOp.opSeqno;
+        fid_t theFid = -1;
+        fid_t theDir = -1;
+        inOp.GetAuditIds(theFid, theDir);
+        outRec.mFid             = theFid;
+        outRec.mDirFid          = theDir;
+        outRec.mAuthUid         = inOp.authUid;
+        outRec.mEUser           = inOp.euser;
+        outRec.mEGroup          = inOp.egroup;
+        outRec.mStatus          = inOp.status < 0 ?
+            -SysToKfsErrno(-inOp.status) : inOp.status;
+        outRec.mOp              = (uint16_t)inOp.op;
+        outRec.mClientProtoVers = inOp.clientProtoVers;
+        const char*  thePtr = inOp.clientIp.c_str();
+        size_t       theLen = inOp.clientIp.size();
+        const size_t kMaxAddrLen = 64;
+        if (2 < theLen && theLen < kMaxAddrLen && *thePtr == '[' &&
+                thePtr[theLen - 1] == ']') {
+            char theBuf[kMaxAddrLen];
+            memcpy(theBuf, thePtr + 1, theLen - 2);
+            theBuf[theLen - 2] = 0;
+            if (inet_pton(AF_INET6, theBuf, outRec.mAddr) == 1) {
+                outRec.mAddrFamily = AuditLogRecord::kAddrFamilyV6;
+            }
+        } else if (inet_pton(AF_INET, thePtr, outRec.mAddr) == 1) {
+            outRec.mAddrFamily = AuditLogRecord::kAddrFamilyV4;
+        } else if (inet_pton(AF_INET6, thePtr, outRec.mAddr) == 1) {
+            outRec.mAddrFamily = AuditLogRecord::kAddrFamilyV6;
+        }
+    }
+    void Drain()
+    {
+        for (; ;) {
+            char* const thePtr = &mWriteBuf[0];
+            size_t      theLen = 0;
+            while (theLen < mWriteBuf.size()) {
+                Slot& theSlot = mSlotsPtr[mTail & mMask];
+                if (theSlot.mSeq != mTail + 1) {
+                    break;
+                }
+                SyncMemoryBarrier();
+                memcpy(thePtr + theLen, &theSlot.mRecord,
+                    sizeof(theSlot.mRecord));
+                SyncMemoryBarrier();
+                theSlot.mSeq = mTail + mMask + 1;
+                mTail++;
+                theLen += sizeof(theSlot.mRecord);
+            }
+            if (theLen <= 0) {
+                break;
+            }
+            Write(thePtr, theLen);
+        }
+        const uint64_t theDroppedCount = mDroppedCount;
+        if (theDroppedCount != mReportedDroppedCount) {
+            KFS_LOG_STREAM_ERROR <<
+                "binary audit log: queue full, dropped: " <<
+                    (theDroppedCount - mReportedDroppedCount) <<
+                " total: " << theDroppedCount <<
+            KFS_LOG_EOM;
+            mReportedDroppedCount = theDroppedCount;
+        }
+    }
+    void Write(
+        const char* inPtr,
+        size_t      inLen)
+    {
+        if (mFd < 0 || (0 < mMaxFileSize && mMaxFileSize <= mFileSize)) {
+            if (! OpenFile()) {
+                SyncAddAndFetch(mDroppedCount,
+                    (uint64_t)(inLen / sizeof(AuditLogRecord)));
+                return;
+            }
+        }
+        const char*       thePtr    = inPtr;
+        const char* const theEndPtr = inPtr + inLen;
+        while (thePtr < theEndPtr) {
+            const ssize_t theNWr = write(mFd, thePtr, theEndPtr - thePtr);
+            if (theNWr < 0) {
+                const int theErr = errno;
+                if (theErr == EINTR) {
+                    continue;
+                }
+                KFS_LOG_STREAM_ERROR <<
+                    "binary audit log: " << mFileName <<
+                    ": " << QCUtils::SysError(theErr) <<
+                KFS_LOG_EOM;
+                CloseFile();
+                break;
+            }
+            thePtr    += theNWr;
+            mFileSize += theNWr;
+        }
+    }
+    bool OpenFile()
+    {
+        CloseFile();
+        struct stat theStat;
+        if (0 < mMaxFileSize && stat(mFileName.c_str(), &theStat) == 0 &&
+                mMaxFileSize <= theStat.st_size) {
+            string theTo;
+            string theFrom;
+            for (int i = mMaxFiles - 1; 0 < i; i--) {
+                theTo = mFileName + ".";
+                AppendDecIntToString(theTo, i);
+                theFrom = mFileName;
+                if (1 < i) {
+                    theFrom += ".";
+                    AppendDecIntToString(theFrom, i - 1);
+                }
+                rename(theFrom.c_str(), theTo.c_str());
+            }
+            if (mMaxFiles <= 1) {
+                unlink(mFileName.c_str());
+            }
+        }
+        mFd = open(mFileName.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (mFd < 0) {
+            const int theErr = errno;
+            KFS_LOG_STREAM_ERROR <<
+                "binary audit log: " << mFileName <<
+                ": " << QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        mFileSize = lseek(mFd, 0, SEEK_END);
+        if (mFileSize <= 0) {
+            AuditLogFileHeader theHeader;
+            theHeader.mMagic      = AuditLogFileHeader::kMagic;
+            theHeader.mVersion    = AuditLogFileHeader::kVersion;
+            theHeader.mRecordSize = sizeof(AuditLogRecord);
+            theHeader.mReserved   = 0;
+            mFileSize = 0;
+            Write(reinterpret_cast<const char*>(&theHeader),
+                sizeof(theHeader));
+        }
+        return (0 <= mFd);
+    }
+    void CloseFile()
+    {
+        if (mFd < 0) {
+            return;
+        }
+        close(mFd);
+        mFd       = -1;
+        mFileSize = 0;
+    }
+private:
+    BinaryAuditLogWriter(
+        const BinaryAuditLogWriter&);
+    BinaryAuditLogWriter& operator=(
+        const BinaryAuditLogWriter&);
+};
+
+static BinaryAuditLogWriter&
+GetBinaryAuditLogWriter()
+{
+    static BinaryAuditLogWriter sBinaryAuditLogWriter;
+    return sBinaryAuditLogWriter;
+}
+
+bool AuditLog::sBinaryFlag = false;
+
 /* static */ void
 AuditLog::Log(
     const MetaRequest& inOp)
 {
+    if (sBinaryFlag) {
+        GetBinaryAuditLogWriter().Append(inOp);
+        return;
+    }
     AuditLogWriter theWriter(inOp);
     GetAuditMsgWriter().Append(
         inOp.status >= 0 ?
@@ -140,17 +524,30 @@ AuditLog::SetParameters(
 {
     GetAuditMsgWriter().SetParameters(inProps,
         "metaServer.auditLogWriter.");
+    const bool theBinaryFlag = inProps.getValue(
+        "metaServer.auditLog.binary", sBinaryFlag ? 1 : 0) != 0;
+    BinaryAuditLogWriter& theWriter = GetBinaryAuditLogWriter();
+    if (theBinaryFlag) {
+        theWriter.SetParameters(inProps, "metaServer.auditLog.binary.");
+    } else {
+        sBinaryFlag = false;
+        theWriter.Stop();
+    }
+    sBinaryFlag = theBinaryFlag && theWriter.IsRunning();
 }
 
 /* static */ void
 AuditLog::Stop()
 {
+    sBinaryFlag = false;
+    GetBinaryAuditLogWriter().Stop();
     GetAuditMsgWriter().Stop();
 }
 
 /* static */ void
 AuditLog::PrepareToFork()
 {
+    GetBinaryAuditLogWriter().PrepareToFork();
     GetAuditMsgWriter().PrepareToFork();
 }
 
@@ -158,12 +555,14 @@ AuditLog::PrepareToFork()
 AuditLog::ForkDone()
 {
     GetAuditMsgWriter().ForkDone();
+    GetBinaryAuditLogWriter().ForkDone();
 }
 
 /* static */ void
 AuditLog::ChildAtFork()
 {
     GetAuditMsgWriter().ChildAtFork();
+    GetBinaryAuditLogWriter().ChildAtFork();
 }
 
 }
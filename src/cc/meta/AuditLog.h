@@ -25,17 +25,62 @@
 // \brief Kfs meta server audit log interface. Writes every client request into
 // audit log file.
 //
+// In the binary mode each request is recorded as fixed size binary record,
+// appended to the lock free queue, and written into the log file by the
+// background thread. The qfsauditdecode tool converts binary records to text.
+//
 //----------------------------------------------------------------------------
 
 #ifndef AUDIT_LOG_H
 #define AUDIT_LOG_H
 
+#include <stdint.h>
+
 namespace KFS
 {
 
 struct MetaRequest;
 class Properties;
 
+// Binary audit log file layout: file header followed by records, both in the
+// host byte order.
+struct AuditLogFileHeader
+{
+    enum
+    {
+        kMagic   = 0x44554151, // QAUD
+        kVersion = 1
+    };
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mRecordSize;
+    uint32_t mReserved;
+};
+
+struct AuditLogRecord
+{
+    enum
+    {
+        kAddrFamilyNone = 0,
+        kAddrFamilyV4   = 4,
+        kAddrFamilyV6   = 6
+    };
+    int64_t  mTimeUsec;        // Completion time.
+    int64_t  mDurationUsec;    // Since request receive, or -1 if not known.
+    int64_t  mSeq;             // Client request sequence number.
+    int64_t  mFid;             // File or directory id, -1 if none.
+    int64_t  mDirFid;          // Parent directory id, -1 if none.
+    uint32_t mAuthUid;
+    uint32_t mEUser;
+    uint32_t mEGroup;
+    int32_t  mStatus;          // KFS errno.
+    uint16_t mOp;              // MetaOp
+    uint8_t  mAddrFamily;
+    uint8_t  mReserved;
+    int32_t  mClientProtoVers;
+    uint8_t  mAddr[16];        // Client ip address, network byte order.
+};
+
 class AuditLog
 {
 public:
@@ -45,6 +90,10 @@ public:
     static void PrepareToFork();
     static void ForkDone();
     static void ChildAtFork();
+    static bool IsBinary()
+        { return sBinaryFlag; }
+private:
+    static bool sBinaryFlag;
 };
 
 };
@@ -33,9 +33,12 @@
 #include "common/StdAllocator.h"
 #include "kfsio/SslFilter.h"
 #include "kfsio/Base64.h"
+#include "kfsio/CryptoKeys.h"
+#include "kfsio/DelegationToken.h"
 #include "krb/KrbService.h"
 #include "qcdio/qcdebug.h"
 #include "qcdio/QCUtils.h"
+#include "qcdio/QCDLList.h"
 
 #include <algorithm>
 #include <string>
@@ -45,6 +48,7 @@
 #include <map>
 
 #include <ctype.h>
+#include <string.h>
 
 #include <boost/scoped_ptr.hpp>
 
@@ -52,6 +56,8 @@ namespace KFS
 {
 using std::string;
 using std::max;
+using std::min;
+using std::make_pair;
 using std::ostringstream;
 using std::istringstream;
 using std::hex;
@@ -110,8 +116,12 @@ public:
           mNoAuthMetaOpHosts(),
           mNoAuthMetaOps(),
           mPskKey(),
-          mPskId()
+          mPskId(),
+          mDelegationCache(),
+          mDelegationCacheMaxSize(4 << 10),
+          mDelegationCacheMaxTime(10 * 60)
     {
+        DelegationCacheList::Init(mDelegationCacheLru);
         if (inDefaultNoAuthMetaOpsPtr) {
             for (const int* thePtr = inDefaultNoAuthMetaOpsPtr;
                     0 <= *thePtr && *thePtr < META_NUM_OPS_COUNT; ++thePtr) {
@@ -126,7 +136,7 @@ public:
         }
     }
     ~Impl()
-        {}
+        { ClearDelegationCache(); }
     bool Validate(
         MetaAuthenticate& inOp)
     {
@@ -515,13 +525,21 @@ public:
                 mMemKeytabGen++;
                 ostringstream theStream;
                 theStream << (void*)this << hex << mMemKeytabGen;
-                const string theMemTabName     = theStream.str();
-                const bool   kDetectReplayFlag = false;
-                // No replay detection is needed, as either AP_REP or TLS-PSK
-                // are used. Both these mechanisms are sufficient to protect
-                // against replay attack as both provide mutual authentication.
-                // With no TLS once assume that party other than QFS protects
-                // against replay, man-in-the-middle attacks etc.
+                const string theMemTabName = theStream.str();
+                // By default no replay detection is needed, as either AP_REP
+                // or TLS-PSK are used. Both these mechanisms are sufficient to
+                // protect against replay attack as both provide mutual
+                // authentication. With no TLS once assume that party other
+                // than QFS protects against replay, man-in-the-middle attacks
+                // etc.
+                // If enabled, the in memory replay cache is used by default,
+                // as the krb5 file replay cache serializes authentication.
+                const bool theDetectReplayFlag = inParameters.getValue(
+                    theParamName.Truncate(theCurLen).Append(
+                        "detectReplay"), 0) != 0;
+                const int  theReplayCacheWindowSec = inParameters.getValue(
+                    theParamName.Truncate(theCurLen).Append(
+                        "replayCacheWindowSec"), 10 * 60);
                 theKrbServicePtr.reset(new KrbService());
                 const char* theErrMsgPtr = theKrbServicePtr->Init(
                     inParameters.getValue(
@@ -535,7 +553,8 @@ public:
                         theParamName.Truncate(theCurLen).Append(
                             "copyToMemKeytab"), 1) != 0 ?
                         theMemTabName.c_str() : theNullStrPtr,
-                    kDetectReplayFlag
+                    theDetectReplayFlag,
+                    theReplayCacheWindowSec
                 );
                 if (theErrMsgPtr) {
                     KFS_LOG_STREAM_ERROR <<
@@ -737,6 +756,17 @@ public:
         mMaxAuthenticationValidTime = max(int64_t(5), inParameters.getValue(
             theParamName.Truncate(thePrefLen).Append(
             "maxAuthenticationValidTimeSec"), mMaxAuthenticationValidTime));
+        mDelegationCacheMaxSize = inParameters.getValue(
+            theParamName.Truncate(thePrefLen).Append(
+            "delegationCacheSize"), mDelegationCacheMaxSize);
+        mDelegationCacheMaxTime = inParameters.getValue(
+            theParamName.Truncate(thePrefLen).Append(
+            "delegationCacheMaxTimeSec"), mDelegationCacheMaxTime);
+        if (mDelegationCacheMaxSize <= 0 || mDelegationCacheMaxTime <= 0) {
+            ClearDelegationCache();
+        } else {
+            TrimDelegationCache();
+        }
         mAuthRequiredFlag = ! mAuthNoneFlag &&
             (mAuthTypes & ~(mAllowPskFlag ?
                 int(kAuthenticationTypePSK) : 0)) != 0;
@@ -785,6 +815,66 @@ public:
     bool CanRenewAndCancelDelegation(
         kfsUid_t inUid) const
         { return (mDelegationRenewAndCancelUsersPtr->Find(inUid) != 0); }
+    int ProcessDelegation(
+        const char*       inPtr,
+        int               inLen,
+        int64_t           inTimeNowSec,
+        const CryptoKeys& inKeys,
+        DelegationToken&  outToken,
+        char*             inSessionKeyPtr,
+        int               inMaxSessionKeyLength,
+        string*           outErrMsgPtr)
+    {
+        if (mDelegationCacheMaxSize <= 0 || mDelegationCacheMaxTime <= 0 ||
+                inLen <= 0 || inMaxSessionKeyLength <= 0) {
+            return outToken.Process(inPtr, inLen, inTimeNowSec, inKeys,
+                inSessionKeyPtr, inMaxSessionKeyLength, outErrMsgPtr);
+        }
+        // The token string is the cache key, therefore a hit guarantees that
+        // the token signature was already verified. The key comparison
+        // invalidates the entry if the key was removed or changed, and the
+        // expiration time is never past the token end time.
+        const string              theTokenStr(inPtr, inLen);
+        DelegationCache::iterator theIt = mDelegationCache.find(theTokenStr);
+        CryptoKeys::Key           theKey;
+        if (theIt != mDelegationCache.end()) {
+            DelegationCacheEntry& theEntry = theIt->second;
+            if (inTimeNowSec <= theEntry.mExpirationTime &&
+                    theEntry.mSessionKeyLength <= inMaxSessionKeyLength &&
+                    inKeys.Find(theEntry.mToken.GetKeyId(), theKey) &&
+                    memcmp(theKey.GetPtr(), theEntry.mKey.GetPtr(),
+                        CryptoKeys::Key::GetSize()) == 0) {
+                outToken = theEntry.mToken;
+                memcpy(inSessionKeyPtr, theEntry.mSessionKey,
+                    theEntry.mSessionKeyLength);
+                DelegationCacheList::PushBack(mDelegationCacheLru, theEntry);
+                return theEntry.mSessionKeyLength;
+            }
+            EraseDelegation(theIt);
+        }
+        const int theRet = outToken.Process(inPtr, inLen, inTimeNowSec,
+            inKeys, inSessionKeyPtr, inMaxSessionKeyLength, outErrMsgPtr);
+        if (theRet <= 0 ||
+                DelegationCacheEntry::kMaxSessionKeyLength < theRet ||
+                ! inKeys.Find(outToken.GetKeyId(), theKey)) {
+            return theRet;
+        }
+        theIt = mDelegationCache.insert(
+            make_pair(theTokenStr, DelegationCacheEntry())).first;
+        DelegationCacheEntry& theEntry = theIt->second;
+        DelegationCacheList::Init(theEntry);
+        theEntry.mExpirationTime   = min(
+            inTimeNowSec + mDelegationCacheMaxTime,
+            outToken.GetIssuedTime() + (int64_t)outToken.GetValidForSec());
+        theEntry.mToken            = outToken;
+        theEntry.mKey              = theKey;
+        theEntry.mTokenStrPtr      = &theIt->first;
+        theEntry.mSessionKeyLength = theRet;
+        memcpy(theEntry.mSessionKey, inSessionKeyPtr, theRet);
+        DelegationCacheList::PushBack(mDelegationCacheLru, theEntry);
+        TrimDelegationCache();
+        return theRet;
+    }
     void Clear()
     {
         DontUseUserAndGroup();
@@ -813,6 +903,7 @@ public:
         mNoAuthMetaOps.clear();
         mPskKey.clear();
         mPskId.clear();
+        ClearDelegationCache();
     }
 private:
     typedef scoped_ptr<KrbService> KrbServicePtr;
@@ -883,6 +974,42 @@ private:
         NoAuthMetaOps&    mNoAuthMetaOps;
         string            mCurName;
     };
+    class DelegationCacheEntry
+    {
+    public:
+        enum { kMaxSessionKeyLength = 64 };
+
+        DelegationCacheEntry()
+            : mTokenStrPtr(0),
+              mExpirationTime(0),
+              mToken(),
+              mKey(),
+              mSessionKeyLength(0)
+        {
+            mSessionKey[0] = 0;
+            DelegationCacheList::Init(*this);
+        }
+        ~DelegationCacheEntry()
+            { memset(mSessionKey, 0, sizeof(mSessionKey)); }
+        const string*   mTokenStrPtr;
+        int64_t         mExpirationTime;
+        DelegationToken mToken;
+        CryptoKeys::Key mKey;
+        int             mSessionKeyLength;
+        char            mSessionKey[kMaxSessionKeyLength];
+    private:
+        DelegationCacheEntry* mPrevPtr[1];
+        DelegationCacheEntry* mNextPtr[1];
+
+        friend class QCDLListOp<DelegationCacheEntry, 0>;
+    };
+    typedef QCDLList<DelegationCacheEntry, 0> DelegationCacheList;
+    typedef map<
+        string,
+        DelegationCacheEntry,
+        less<string>,
+        StdFastAllocator<pair<const string, DelegationCacheEntry> >
+    > DelegationCache;
     class HostIpsInserter
     {
     public:
@@ -938,6 +1065,10 @@ private:
     NoAuthMetaOps                    mNoAuthMetaOps;
     string                           mPskKey;
     string                           mPskId;
+    DelegationCache                  mDelegationCache;
+    size_t                           mDelegationCacheMaxSize;
+    int64_t                          mDelegationCacheMaxTime;
+    DelegationCacheEntry*            mDelegationCacheLru[1];
 
     static const OpNamesMap& sOpNamesMap;
 
@@ -1012,6 +1143,25 @@ private:
     }
     bool IsPskAllowed() const
         { return (mAllowPskFlag || ! mPskKey.empty()); }
+    void EraseDelegation(
+        DelegationCache::iterator inIt)
+    {
+        DelegationCacheList::Remove(mDelegationCacheLru, inIt->second);
+        mDelegationCache.erase(inIt);
+    }
+    void TrimDelegationCache()
+    {
+        DelegationCacheEntry* thePtr;
+        while (mDelegationCacheMaxSize < mDelegationCache.size() &&
+                (thePtr = DelegationCacheList::Front(mDelegationCacheLru))) {
+            EraseDelegation(mDelegationCache.find(*thePtr->mTokenStrPtr));
+        }
+    }
+    void ClearDelegationCache()
+    {
+        DelegationCacheList::Init(mDelegationCacheLru);
+        mDelegationCache.clear();
+    }
 
 private:
     Impl(
@@ -1201,6 +1351,21 @@ AuthContext::CanRenewAndCancelDelegation(
     return mImpl.CanRenewAndCancelDelegation(inUid);
 }
 
+    int
+AuthContext::ProcessDelegation(
+    const char*       inPtr,
+    int               inLen,
+    int64_t           inTimeNowSec,
+    const CryptoKeys& inKeys,
+    DelegationToken&  outToken,
+    char*             inSessionKeyPtr,
+    int               inMaxSessionKeyLength,
+    string*           outErrMsgPtr)
+{
+    return mImpl.ProcessDelegation(inPtr, inLen, inTimeNowSec, inKeys,
+        outToken, inSessionKeyPtr, inMaxSessionKeyLength, outErrMsgPtr);
+}
+
     void
 AuthContext::Clear()
 {
@@ -35,6 +35,8 @@ namespace KFS
 using std::string;
 
 struct MetaAuthenticate;
+class CryptoKeys;
+class DelegationToken;
 class Properties;
 class SslFilterServerPsk;
 class SslFilterVerifyPeer;
@@ -97,6 +99,19 @@ public:
     int GetAuthTypes() const;
     bool CanRenewAndCancelDelegation(
         kfsUid_t inUid) const;
+    // Same as DelegationToken::Process(), except that the verified tokens
+    // and the derived session keys are cached, in order to avoid repeating
+    // the signature verification with client re-connects. The cache is not
+    // thread safe, the same as the rest of the context.
+    int ProcessDelegation(
+        const char*       inPtr,
+        int               inLen,
+        int64_t           inTimeNowSec,
+        const CryptoKeys& inKeys,
+        DelegationToken&  outToken,
+        char*             inSessionKeyPtr,
+        int               inMaxSessionKeyLength,
+        string*           outErrMsgPtr);
     void Clear();
 private:
     class Impl;
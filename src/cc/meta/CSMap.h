@@ -57,6 +57,11 @@ private:
 public:
     typedef MetaRequest::Servers Servers;
 
+    // The entry is the chunk's MetaChunkInfo, therefore each chunk belongs to
+    // exactly one file. Chunk deletion, replication and recovery, and the
+    // checkpoint and transaction log formats rely on the single owner.
+    // Sharing chunks between files, for example with copy on write
+    // snapshots, requires chunk to files indirection.
     class Entry : private MetaChunkInfo
     {
     public:
@@ -70,8 +75,16 @@ public:
             kStateNoDestination      = 3,
             kStatePendingRecovery    = 4,
             kStateDelayedRecovery    = 5,
+            // Replication check of the chunks that are one failure away
+            // from becoming unavailable, or that are already lost and
+            // must be recovered. Scanned before kStateCheckReplication.
+            kStateCheckReplicationUrgent = 6,
             kStateCount
         };
+        static bool IsCheckReplication(State state) {
+            return (state == kStateCheckReplication ||
+                state == kStateCheckReplicationUrgent);
+        }
 
         explicit Entry(MetaFattr* fattr = 0, chunkOff_t offset = 0,
                 chunkId_t chunkId = 0, seq_t chunkVersion = 0)
@@ -533,6 +546,7 @@ public:
           mServers(),
           mPendingRemove(),
           mNullSlots(),
+          mHibernatedInventories(),
           mServerCount(0),
           mHibernatedCount(0),
           mRemoveServerScanPtr(0),
@@ -550,6 +564,7 @@ public:
         }
         mMap.SetDeleteObserver(this);
         memset(mHibernatedIndexes, 0, sizeof(mHibernatedIndexes));
+        memset(mPendingRemoveIndexes, 0, sizeof(mPendingRemoveIndexes));
     }
     ~CSMap()
     {
@@ -602,7 +617,7 @@ public:
         }
         Validate();
         mServers[server->GetIndex()].reset();
-        mPendingRemove.push_back(server->GetIndex());
+        AddPendingRemove(server->GetIndex());
         server->SetIndex(-1, mDebugValidateFlag);
         mServerCount--;
         server->ClearHosted();
@@ -615,12 +630,66 @@ public:
                 ! SetHibernated(server->GetIndex())) {
             return false;
         }
+        if (mHibernatedInventories.size() <= (size_t)server->GetIndex()) {
+            mHibernatedInventories.resize(server->GetIndex() + 1);
+        }
+        // Retain the hosted chunks count and checksum, in order to make
+        // RestoreHibernated() possible.
+        HibernatedInventory& inv = mHibernatedInventories[server->GetIndex()];
+        inv.mCount    = server->GetChunkCount();
+        inv.mChecksum = server->GetChunkIdsChecksum();
         mServers[server->GetIndex()].reset();
         idx = server->GetIndex();
         server->SetIndex(-1, mDebugValidateFlag);
         Validate();
         return true;
     }
+    bool GetHibernatedInventory(size_t idx,
+            size_t& count, uint64_t& checksum) const {
+        if (mDebugValidateFlag || Entry::kMaxServers <= idx ||
+                ! IsHibernated(idx)) {
+            return false;
+        }
+        const HibernatedInventory& inv = mHibernatedInventories[idx];
+        count    = inv.mCount;
+        checksum = inv.mChecksum;
+        return true;
+    }
+    // Re-attach the hibernated server's chunks to the server that is back,
+    // instead of removing the hibernated server and adding all chunks again.
+    // The caller must ensure that the server inventory has not changed, i.e.
+    // matches GetHibernatedInventory().
+    bool RestoreHibernated(const ChunkServerPtr& server, size_t idx) {
+        if (! server || Validate(server) || mDebugValidateFlag ||
+                Entry::kMaxServers <= idx || mServers.size() <= idx ||
+                mServers[idx] || ! ClearHibernated(idx)) {
+            return false;
+        }
+        mServers[idx] = server;
+        server->SetIndex(idx, mDebugValidateFlag);
+        const HibernatedInventory& inv = mHibernatedInventories[idx];
+        server->SetHosted(inv.mCount, inv.mChecksum);
+        Validate();
+        return true;
+    }
+    // Remove hibernated servers indexes, used when the chunk version changes,
+    // as the hibernated servers' chunk replicas become stale.
+    size_t RemoveHibernatedServers(Entry& entry) {
+        if (mHibernatedCount <= 0) {
+            return 0;
+        }
+        ValidateHosted(entry);
+        size_t ret = 0;
+        for (size_t i = entry.ServerCount(); i-- > 0; ) {
+            const size_t idx = entry.IndexAt(i);
+            if (! mServers[idx] && IsHibernated(idx)) {
+                RemoveHibernatedHosted(idx, entry);
+                entry.RemoveIndex(idx);
+                ret++;
+            }
+        }
+        return ret;
+    }
     bool RemoveHibernatedServer(size_t idx) {
         if (/* idx < 0 ||*/ idx >= Entry::kMaxServers) {
             return false;
@@ -630,7 +699,7 @@ public:
             return false;
         }
         assert(! mServers[idx] && mServerCount > 0);
-        mPendingRemove.push_back(idx);
+        AddPendingRemove(idx);
         mServerCount--;
         // Start or restart full scan.
         RemoveServerScanFirst();
@@ -811,7 +880,8 @@ public:
         if (! Validate(entry) || ! Validate(state)) {
             return false;
         }
-        SetStateSelf(entry, state);
+        SetStateSelf(entry, Entry::IsCheckReplication(state) ?
+            GetCheckReplicationState(entry) : state);
         if (mRemoveServerScanPtr) {
             // The entry can potentially be missed by the
             // lazy full scan due to its list position change.
@@ -982,7 +1052,9 @@ public:
                 i++) {
             Entry& entry = *mRemoveServerScanPtr;
             mRemoveServerScanPtr = &EList::GetPrev(entry);
-            CleanupStaleServers(entry);
+            if (HasPendingRemove(entry)) {
+                CleanupStaleServers(entry);
+            }
             RemoveServerScanCur();
         }
         return (mRemoveServerScanPtr != 0);
@@ -1037,6 +1109,16 @@ public:
 private:
     typedef vector<Entry::AllocIdx> SlotIndexes;
     typedef uint8_t                 HibernatedBits;
+    struct HibernatedInventory
+    {
+        HibernatedInventory()
+            : mCount(0),
+              mChecksum(0)
+            {}
+        size_t   mCount;
+        uint64_t mChecksum;
+    };
+    typedef vector<HibernatedInventory> HibernatedInventories;
     enum
     {
         kHibernatedBitShift = 3,
@@ -1047,6 +1129,7 @@ private:
     Servers        mServers;
     SlotIndexes    mPendingRemove;
     SlotIndexes    mNullSlots;
+    HibernatedInventories mHibernatedInventories;
     size_t         mServerCount;
     size_t         mHibernatedCount;
     Entry*         mRemoveServerScanPtr;
@@ -1061,6 +1144,11 @@ private:
     HibernatedBits mHibernatedIndexes[
         (Entry::kMaxServers + kHibernatedBitMask) /
         (1 << kHibernatedBitShift)];
+    // Removed server indexes that are still referenced by the entries,
+    // i.e. the indexes in mPendingRemove.
+    HibernatedBits mPendingRemoveIndexes[
+        (Entry::kMaxServers + kHibernatedBitMask) /
+        (1 << kHibernatedBitShift)];
 
     void Erasing(Entry& entry) {
         if (EList::IsInList(entry)) {
@@ -1160,8 +1248,10 @@ private:
                     srv->RemoveHosted(
                         entry.GetChunkId(), idx);
                 } else {
-                    srv->RemoveHosted();
+                    srv->RemoveHosted(entry.GetChunkId());
                 }
+            } else if (IsHibernated(idx)) {
+                RemoveHibernatedHosted(idx, entry);
             }
         }
     }
@@ -1170,7 +1260,7 @@ private:
             server->AddHosted(
                 entry.GetChunkId(), server->GetIndex());
         } else {
-            server->AddHosted();
+            server->AddHosted(entry.GetChunkId());
         }
     }
     void RemoveHosted(const ChunkServerPtr& server,
@@ -1179,8 +1269,18 @@ private:
             server->RemoveHosted(
                 entry.GetChunkId(), server->GetIndex());
         } else {
-            server->RemoveHosted();
+            server->RemoveHosted(entry.GetChunkId());
+        }
+    }
+    void RemoveHibernatedHosted(size_t idx, const Entry& entry) const {
+        HibernatedInventory& inv =
+            const_cast<CSMap*>(this)->mHibernatedInventories[idx];
+        if (inv.mCount <= 0) {
+            InternalError("no hibernated hosted chunks");
+            return;
         }
+        inv.mCount--;
+        inv.mChecksum -= ChunkIdInventoryChecksum(entry.GetChunkId());
     }
     bool Validate() const {
         if (! mDebugValidateFlag) {
@@ -1248,11 +1348,36 @@ private:
         }
         ValidateServersNoScan(entry);
         // Enqueue replication check if servers were removed.
-        if (prev != cnt && entry.GetState() == Entry::kStateNone) {
-            SetStateSelf(entry, Entry::kStateCheckReplication);
+        if (prev != cnt && (entry.GetState() == Entry::kStateNone ||
+                (entry.GetState() == Entry::kStateCheckReplication &&
+                    ret <= 1))) {
+            const Entry::State state = GetCheckReplicationState(entry, ret);
+            if (state != entry.GetState()) {
+                SetStateSelf(entry, state);
+            }
         }
         return ret;
     }
+    Entry::State GetCheckReplicationState(const Entry& entry) const {
+        size_t cnt = 0;
+        for (size_t i = 0, e = entry.ServerCount(); i < e && cnt <= 1; i++) {
+            if (mServers[entry.IndexAt(i)]) {
+                cnt++;
+            }
+        }
+        return GetCheckReplicationState(entry, cnt);
+    }
+    static Entry::State GetCheckReplicationState(
+            const Entry& entry, size_t liveCount) {
+        // Replicated chunk with only one replica left, or striped file
+        // chunk that has to be recovered, goes to the front of the queue.
+        const MetaFattr* const fa = entry.GetFattr();
+        return ((fa && 0 < fa->numReplicas && (
+                (liveCount <= 1 && 1 < fa->numReplicas) ||
+                (liveCount <= 0 && fa->HasRecovery()))) ?
+            Entry::kStateCheckReplicationUrgent :
+            Entry::kStateCheckReplication);
+    }
     void RemoveServerScanFirst() {
         // Scan backwards to avoid scanning the newly added entries,
         // or entries that have been moved.
@@ -1265,6 +1390,13 @@ private:
                     mRemoveServerScanPtr) {
                 mRemoveServerScanPtr = 0;
                 Validate();
+                for (SlotIndexes::const_iterator
+                        it = mPendingRemove.begin();
+                        it != mPendingRemove.end();
+                        ++it) {
+                    mPendingRemoveIndexes[*it >> kHibernatedBitShift] &=
+                        ~(HibernatedBits(1) << (*it & kHibernatedBitMask));
+                }
                 if (mNullSlots.empty()) {
                     mNullSlots.swap(mPendingRemove);
                 } else {
@@ -1311,6 +1443,34 @@ private:
         assert(mCounts[state] > 0);
         EList::Insert(entry, EList::GetPrev(mLists[state + 1]));
     }
+    void AddPendingRemove(size_t idx) {
+        mPendingRemove.push_back(idx);
+        mPendingRemoveIndexes[idx >> kHibernatedBitShift] |=
+            HibernatedBits(1) << (idx & kHibernatedBitMask);
+    }
+    bool IsPendingRemove(size_t idx) const {
+        return (mPendingRemoveIndexes[idx >> kHibernatedBitShift] &
+            (HibernatedBits(1) << (idx & kHibernatedBitMask))) != 0;
+    }
+    bool HasPendingRemove(const Entry& entry) const {
+        // The lazy removal scan visits every entry. Most entries have no
+        // more than kMaxNonAllocSrvs inline indexes, and none of these
+        // belong to removed servers: test the inline indexes against the
+        // removed indexes bit map, and skip the stale servers cleanup.
+        if (entry.IsAddr()) {
+            return true;
+        }
+        for (Entry::IdxData data = entry.mIdxData &
+                    ~Entry::IdxData(Entry::kOtherBitsMask);
+                data != 0;
+                data <<= Entry::kIdxBits) {
+            if (IsPendingRemove(
+                    (size_t)(data >> Entry::kFirstIdxShift) - 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
     bool IsHibernated(size_t idx) const {
         return (mHibernatedIndexes[idx >> kHibernatedBitShift] &
             (HibernatedBits(1) << (idx & kHibernatedBitMask))) != 0;
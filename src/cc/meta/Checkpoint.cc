@@ -30,6 +30,9 @@
  * of replay, a checkpoint is saved to disk.  To save a checkpoint, we iterate
  * through the leaf nodes of the tree copying the contents of each node to a
  * checkpoint file.
+ * With write threads configured, the leaf entries are serialized in parallel
+ * in blocks by the writer threads, and the main thread writes the blocks
+ * into the checkpoint stream in the leaf order, and computes the checksum.
  */
 
 #include "Checkpoint.h"
@@ -39,11 +42,21 @@
 #include "Logger.h"
 #include "util.h"
 #include "LayoutManager.h"
+#include "DiskEntry.h"
+#include "CheckpointCompression.h"
 #include "common/MdStream.h"
 #include "common/FdWriter.h"
+#include "common/MsgLogger.h"
+#include "qcdio/QCUtils.h"
+#include "qcdio/QCThread.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <deque>
+#include <vector>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -53,6 +66,10 @@ namespace KFS
 {
 using std::hex;
 using std::dec;
+using std::ostringstream;
+using std::deque;
+using std::vector;
+using std::max;
 
 // default values
 string CPDIR("./kfscp");        //!< directory for CP files
@@ -60,14 +77,238 @@ string LASTCP(CPDIR + "/latest");   //!< most recent CP file (link)
 
 Checkpoint cp(CPDIR);
 
+/*!
+ * \brief parallel checkpoint leaves writer.
+ * The main thread walks the meta tree leaves, and groups the leaf pointers
+ * into blocks. The blocks are serialized by the writer threads, and written
+ * by the main thread in the leaf order. The meta tree is not modified while
+ * the checkpoint is written, therefore the leaves can be serialized
+ * concurrently.
+ */
+class ParallelCheckpointWriter : public QCRunnable
+{
+public:
+    ParallelCheckpointWriter(
+        ostream& os,
+        bool     binary,
+        int      threadCount)
+        : QCRunnable(),
+          mOs(os),
+          mBinaryFlag(binary),
+          mThreadCount(max(1, threadCount)),
+          mThreads(new QCThread[mThreadCount]),
+          mMutex(),
+          mWorkCond(),
+          mDoneCond(),
+          mWork(),
+          mPending(),
+          mFree(),
+          mStopFlag(false)
+        {}
+    ~ParallelCheckpointWriter()
+    {
+        Stop();
+        delete [] mThreads;
+        for (Pending::iterator it = mPending.begin();
+                it != mPending.end();
+                ++it) {
+            delete *it;
+        }
+        for (Pending::iterator it = mFree.begin(); it != mFree.end(); ++it) {
+            delete *it;
+        }
+    }
+    int Write()
+    {
+        const int kStackSize = 256 << 10;
+        for (int i = 0; i < mThreadCount; i++) {
+            const int err = mThreads[i].TryToStart(
+                this, kStackSize, "CPWrite");
+            if (err) {
+                KFS_LOG_STREAM_ERROR << QCUtils::SysError(
+                    err, "failed to start checkpoint writer thread") <<
+                KFS_LOG_EOM;
+                return (0 < err ? -err : -EIO);
+            }
+        }
+        int         status = 0;
+        Block*      cur    = 0;
+        LeafIter    li(metatree.firstLeaf(), 0);
+        const Meta* m      = li.current();
+        while (status == 0 && m) {
+            if (! cur) {
+                if (mFree.empty()) {
+                    cur = new Block();
+                } else {
+                    cur = mFree.back();
+                    mFree.pop_back();
+                }
+            }
+            cur->leaves.push_back(m);
+            if (kBlockLeafCount <= cur->leaves.size()) {
+                status = Submit(cur);
+                cur = 0;
+            }
+            li.next();
+            Node* const p = li.parent();
+            m = p ? li.current() : 0;
+        }
+        if (status == 0 && cur) {
+            status = Submit(cur);
+            cur = 0;
+        }
+        while (status == 0 && ! mPending.empty()) {
+            status = WriteFront();
+        }
+        delete cur;
+        Stop();
+        return status;
+    }
+    virtual void Run()
+    {
+        QCStMutexLocker locker(mMutex);
+        for (; ;) {
+            while (! mStopFlag && mWork.empty()) {
+                mWorkCond.Wait(mMutex);
+            }
+            if (mWork.empty()) {
+                break;
+            }
+            Block& block = *mWork.front();
+            mWork.pop_front();
+            {
+                QCStMutexUnlocker unlocker(mMutex);
+                Serialize(block);
+            }
+            block.doneFlag = true;
+            mDoneCond.NotifyAll();
+        }
+    }
+private:
+    enum { kBlockLeafCount      = 32 << 10 };
+    enum { kMaxPendingPerThread = 2 };
+
+    class Block
+    {
+    public:
+        typedef vector<const Meta*> Leaves;
+
+        Block()
+            : leaves(),
+              data(),
+              status(0),
+              doneFlag(false)
+            {}
+        void Reset()
+        {
+            leaves.clear();
+            data.clear();
+            status   = 0;
+            doneFlag = false;
+        }
+        Leaves leaves;
+        string data;
+        int    status;
+        bool   doneFlag;
+    };
+    typedef deque<Block*> Pending;
+
+    ostream&        mOs;
+    const bool      mBinaryFlag;
+    const int       mThreadCount;
+    QCThread* const mThreads;
+    QCMutex         mMutex;
+    QCCondVar       mWorkCond;
+    QCCondVar       mDoneCond;
+    Pending         mWork;
+    Pending         mPending;
+    Pending         mFree;
+    bool            mStopFlag;
+
+    void Stop()
+    {
+        QCStMutexLocker locker(mMutex);
+        mStopFlag = true;
+        mWorkCond.NotifyAll();
+        locker.Unlock();
+        for (int i = 0; i < mThreadCount; i++) {
+            if (mThreads[i].IsStarted()) {
+                mThreads[i].Join();
+            }
+        }
+    }
+    void Serialize(
+        Block& block)
+    {
+        // Same format as the checkpoint stream: hex integers after
+        // setintbase/16.
+        ostringstream  os;
+        DEBinaryWriter writer;
+        os << hex;
+        for (Block::Leaves::const_iterator it = block.leaves.begin();
+                it != block.leaves.end() && block.status == 0;
+                ++it) {
+            block.status = mBinaryFlag ?
+                (*it)->checkpoint(os, writer) : (*it)->checkpoint(os);
+        }
+        block.data = os.str();
+    }
+    int Submit(
+        Block* block)
+    {
+        mPending.push_back(block);
+        {
+            QCStMutexLocker locker(mMutex);
+            mWork.push_back(block);
+            mWorkCond.Notify();
+        }
+        int status = 0;
+        while (status == 0 &&
+                (size_t)(mThreadCount * kMaxPendingPerThread) <
+                mPending.size()) {
+            status = WriteFront();
+        }
+        return status;
+    }
+    int WriteFront()
+    {
+        Block& block = *mPending.front();
+        {
+            QCStMutexLocker locker(mMutex);
+            while (! block.doneFlag) {
+                mDoneCond.Wait(mMutex);
+            }
+        }
+        mPending.pop_front();
+        int status = block.status;
+        if (status == 0) {
+            mOs.write(block.data.data(), block.data.size());
+            if (mOs.fail()) {
+                status = -EIO;
+            }
+        }
+        block.Reset();
+        mFree.push_back(&block);
+        return status;
+    }
+private:
+    ParallelCheckpointWriter(const ParallelCheckpointWriter&);
+    ParallelCheckpointWriter& operator=(const ParallelCheckpointWriter&);
+};
+
 int
 Checkpoint::write_leaves(ostream& os)
 {
+    if (1 < writethreads) {
+        ParallelCheckpointWriter writer(os, writebinary, writethreads);
+        return writer.Write();
+    }
     LeafIter li(metatree.firstLeaf(), 0);
     Meta *m = li.current();
     int status = 0;
+    DEBinaryWriter writer;
     while (status == 0 && m) {
-        status = m->checkpoint(os);
+        status = writebinary ? m->checkpoint(os, writer) : m->checkpoint(os);
         li.next();
         Node* const p = li.parent();
         m = p ? li.current() : 0;
@@ -114,12 +355,29 @@ Checkpoint::do_CP()
     }
     if (status == 0) {
         FdWriter fdw(fd);
+        CheckpointDeflateWriter cw(
+            fdw, compressionlevel, compressionblocksize);
         const bool kSyncFlag = false;
-        MdStreamT<FdWriter> os(&fdw, kSyncFlag, string(), writebuffersize);
+        MdStreamT<CheckpointDeflateWriter> os(
+            &cw, kSyncFlag, string(), writebuffersize);
         os << dec;
         os << "checkpoint/" << highest << '\n';
         os << "checksum/last-line\n";
         os << "version/" << VERSION << '\n';
+        if (! digestname.empty()) {
+            // The digest covers the content starting from the digest entry.
+            os.Reset(&cw, digestname);
+            os << "digest/" << digestname << '\n';
+        }
+        if (0 < compressionlevel) {
+            // The remainder of the checkpoint is compressed. The restorer
+            // passes the uncompressed entries through the digest, therefore
+            // the digest covers the uncompressed content.
+            os << CheckpointDeflateWriter::GetCompressionPrefix() <<
+                cw.GetBlockSize() << '\n';
+            os.SetStream(&cw);
+            cw.StartCompression();
+        }
         os << "filesysteminfo/fsid/" << metatree.GetFsId() << "/crtime/" <<
             ShowTime(metatree.GetCreateTime()) << '\n';
         os << "fid/" << fileID.getseed() << '\n';
@@ -146,7 +404,8 @@ Checkpoint::do_CP()
             const string md = os.GetMd();
             os << "checksum/" << md << '\n';
             os.SetStream(0);
-            if ((status = fdw.GetError()) != 0) {
+            cw.Finish();
+            if ((status = cw.GetError()) != 0) {
                 if (status > 0) {
                     status = -status;
                 }
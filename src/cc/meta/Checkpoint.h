@@ -60,7 +60,12 @@ public:
           mutations(0),
           cpcount(0),
           writesync(true),
-          writebuffersize(16 << 20)
+          writebuffersize(16 << 20),
+          writebinary(false),
+          writethreads(0),
+          compressionlevel(0),
+          compressionblocksize(4 << 20),
+          digestname()
         {}
     void setCPDir(const string& d)
         { cpdir = d; }
@@ -75,6 +80,20 @@ public:
     void setWriteSyncFlag(bool flag) { writesync = flag; }
     size_t getWriteBufferSize() const { return writebuffersize; }
     void setWriteBufferSize(size_t size) { writebuffersize = size; }
+    //!< write leaf entries in binary format
+    bool getWriteBinaryFlag() const { return writebinary; }
+    void setWriteBinaryFlag(bool flag) { writebinary = flag; }
+    //!< number of threads to serialize leaf entries, 0 or 1 -- none
+    int getWriteThreadCount() const { return writethreads; }
+    void setWriteThreadCount(int count) { writethreads = count; }
+    //!< zlib compression level, 0 -- no compression
+    int getCompressionLevel() const { return compressionlevel; }
+    void setCompressionLevel(int level) { compressionlevel = level; }
+    size_t getCompressionBlockSize() const { return compressionblocksize; }
+    void setCompressionBlockSize(size_t size) { compressionblocksize = size; }
+    //!< checkpoint digest name, empty -- md5
+    const string& getDigestName() const { return digestname; }
+    void setDigestName(const string& name) { digestname = name; }
 private:
     string  cpdir;       //!< dir for CP files
     string  cpname;      //!< name of CP file
@@ -82,6 +101,11 @@ private:
     int64_t cpcount;     //!< number of CP's since startup
     bool    writesync;
     size_t  writebuffersize;
+    bool    writebinary;
+    int     writethreads;
+    int     compressionlevel;
+    size_t  compressionblocksize;
+    string  digestname;
 
     string cpfile(seq_t highest)    //!< generate the next file name
         { return makename(cpdir, "chkpt", highest); }
@@ -0,0 +1,274 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Checkpoint block compression implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "CheckpointCompression.h"
+#include "common/FdWriter.h"
+#include "common/MsgLogger.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace KFS
+{
+using std::max;
+using std::min;
+
+CheckpointDeflateWriter::CheckpointDeflateWriter(
+    FdWriter& inWriter,
+    int       inLevel,
+    size_t    inBlockSize)
+    : mWriter(inWriter),
+      mLevel(min(9, max(1, inLevel))),
+      mBlockSize(max(size_t(64) << 10, inBlockSize)),
+      mCompressFlag(false),
+      mError(0),
+      mBuf(),
+      mOut()
+    {}
+
+CheckpointDeflateWriter::~CheckpointDeflateWriter()
+    {}
+
+bool
+CheckpointDeflateWriter::write(
+    const void* inBufPtr,
+    size_t      inLength)
+{
+    if (! mCompressFlag) {
+        return mWriter.write(inBufPtr, inLength);
+    }
+    if (mError != 0) {
+        return false;
+    }
+    const char*       thePtr    = static_cast<const char*>(inBufPtr);
+    const char* const theEndPtr = thePtr + inLength;
+    if (mBuf.empty()) {
+        // Compress full blocks in place, with no copy.
+        while (mBlockSize <= (size_t)(theEndPtr - thePtr)) {
+            if (! WriteBlock(thePtr, mBlockSize)) {
+                return false;
+            }
+            thePtr += mBlockSize;
+        }
+    }
+    while (thePtr < theEndPtr) {
+        const size_t theLen = min(
+            (size_t)(theEndPtr - thePtr), mBlockSize - mBuf.size());
+        mBuf.append(thePtr, theLen);
+        thePtr += theLen;
+        if (mBlockSize <= mBuf.size()) {
+            if (! WriteBlock(mBuf.data(), mBuf.size())) {
+                return false;
+            }
+            mBuf.clear();
+        }
+    }
+    return true;
+}
+
+bool
+CheckpointDeflateWriter::Finish()
+{
+    if (! mCompressFlag || mBuf.empty()) {
+        return (mError == 0);
+    }
+    const bool theRet = WriteBlock(mBuf.data(), mBuf.size());
+    mBuf.clear();
+    return theRet;
+}
+
+int
+CheckpointDeflateWriter::GetError() const
+{
+    return (mError != 0 ? mError : mWriter.GetError());
+}
+
+bool
+CheckpointDeflateWriter::WriteBlock(
+    const char* inPtr,
+    size_t      inLength)
+{
+    uLongf theLen = compressBound((uLong)inLength);
+    if (mOut.size() < (size_t)theLen) {
+        mOut.resize(theLen);
+    }
+    const int theStatus = compress2(
+        reinterpret_cast<Bytef*>(&mOut[0]), &theLen,
+        reinterpret_cast<const Bytef*>(inPtr), (uLong)inLength, mLevel);
+    if (theStatus != Z_OK) {
+        KFS_LOG_STREAM_ERROR <<
+            "checkpoint block compression failure: " << theStatus <<
+            " " << zError(theStatus) <<
+        KFS_LOG_EOM;
+        mError = EIO;
+        return false;
+    }
+    char theHeader[64];
+    const int theHLen = snprintf(theHeader, sizeof(theHeader),
+        "block/%lu/%lu\n", (unsigned long)inLength, (unsigned long)theLen);
+    if (! mWriter.write(theHeader, theHLen) ||
+            ! mWriter.write(&mOut[0], theLen)) {
+        return false;
+    }
+    return true;
+}
+
+CheckpointInflateBuf::CheckpointInflateBuf(
+    istream& inStream)
+    : streambuf(),
+      mStream(inStream),
+      mCompressFlag(false),
+      mHeaderLineCount(0),
+      mStatus(0),
+      mLine(),
+      mBuf(),
+      mIn()
+    {}
+
+CheckpointInflateBuf::~CheckpointInflateBuf()
+    {}
+
+CheckpointInflateBuf::int_type
+CheckpointInflateBuf::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (mStatus != 0) {
+        return traits_type::eof();
+    }
+    if (mCompressFlag) {
+        return ReadBlock();
+    }
+    if (mHeaderLineCount < kMaxHeaderLines) {
+        return ReadLine();
+    }
+    // Uncompressed checkpoint, pass through.
+    if (mBuf.size() < (size_t)kReadSize) {
+        mBuf.resize(kReadSize);
+    }
+    mStream.read(&mBuf[0], mBuf.size());
+    if (mStream.bad()) {
+        return Fail(-EIO);
+    }
+    const size_t theLen = (size_t)mStream.gcount();
+    if (theLen <= 0) {
+        return traits_type::eof();
+    }
+    setg(&mBuf[0], &mBuf[0], &mBuf[0] + theLen);
+    return traits_type::to_int_type(*gptr());
+}
+
+CheckpointInflateBuf::int_type
+CheckpointInflateBuf::ReadLine()
+{
+    if (! getline(mStream, mLine)) {
+        return (mStream.bad() ? Fail(-EIO) : traits_type::eof());
+    }
+    if (! mStream.eof()) {
+        mLine += '\n';
+    }
+    mHeaderLineCount++;
+    const char* const thePrefix =
+        CheckpointDeflateWriter::GetCompressionPrefix();
+    if (mLine.compare(0, strlen(thePrefix), thePrefix) == 0) {
+        mCompressFlag = true;
+    } else if (mLine.compare(0, 12, "compression/") == 0) {
+        KFS_LOG_STREAM_ERROR <<
+            "unsupported checkpoint compression: " << mLine <<
+        KFS_LOG_EOM;
+        return Fail(-EINVAL);
+    }
+    if (mBuf.size() < mLine.size()) {
+        mBuf.resize(max(mLine.size(), size_t(4) << 10));
+    }
+    memcpy(&mBuf[0], mLine.data(), mLine.size());
+    setg(&mBuf[0], &mBuf[0], &mBuf[0] + mLine.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+CheckpointInflateBuf::int_type
+CheckpointInflateBuf::ReadBlock()
+{
+    if (! getline(mStream, mLine)) {
+        // End of the last block.
+        return (mStream.bad() ? Fail(-EIO) : traits_type::eof());
+    }
+    unsigned long theLen  = 0;
+    unsigned long theCLen = 0;
+    char          theSym  = 0;
+    if (sscanf(mLine.c_str(), "block/%lu/%lu%c",
+                &theLen, &theCLen, &theSym) != 2 ||
+            theLen <= 0 || (unsigned long)kMaxBlockSize < theLen ||
+            compressBound(theLen) < theCLen) {
+        KFS_LOG_STREAM_ERROR <<
+            "invalid checkpoint block header: " << mLine.substr(0, 64) <<
+        KFS_LOG_EOM;
+        return Fail(-EINVAL);
+    }
+    if (mIn.size() < theCLen) {
+        mIn.resize(theCLen);
+    }
+    if (! mStream.read(&mIn[0], theCLen)) {
+        KFS_LOG_STREAM_ERROR <<
+            "truncated checkpoint block: " << mLine <<
+        KFS_LOG_EOM;
+        return Fail(-EIO);
+    }
+    if (mBuf.size() < theLen) {
+        mBuf.resize(theLen);
+    }
+    uLongf    theDLen   = (uLongf)theLen;
+    const int theStatus = uncompress(
+        reinterpret_cast<Bytef*>(&mBuf[0]), &theDLen,
+        reinterpret_cast<const Bytef*>(&mIn[0]), (uLong)theCLen);
+    if (theStatus != Z_OK || theDLen != theLen) {
+        KFS_LOG_STREAM_ERROR <<
+            "checkpoint block decompression failure: " << theStatus <<
+            " " << zError(theStatus) <<
+            " size: " << theDLen << " expected: " << theLen <<
+        KFS_LOG_EOM;
+        return Fail(-EIO);
+    }
+    setg(&mBuf[0], &mBuf[0], &mBuf[0] + theLen);
+    return traits_type::to_int_type(*gptr());
+}
+
+CheckpointInflateBuf::int_type
+CheckpointInflateBuf::Fail(
+    int inStatus)
+{
+    mStatus = inStatus;
+    setg(0, 0, 0);
+    return traits_type::eof();
+}
+
+}
@@ -0,0 +1,136 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Checkpoint block compression. The checkpoint header lines up to and
+// including the "compression/zlib/blocksize/<size>" line are written
+// uncompressed. The remainder of the checkpoint is written as a sequence of
+// independently compressed blocks, each prefixed with the
+// "block/<uncompressed size>/<compressed size>\n" line. The checkpoint digest
+// is computed over the uncompressed content, and the compression line is part
+// of the digest.
+//
+//----------------------------------------------------------------------------
+
+#ifndef CHECKPOINT_COMPRESSION_H
+#define CHECKPOINT_COMPRESSION_H
+
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+namespace KFS
+{
+using std::istream;
+using std::streambuf;
+using std::string;
+using std::vector;
+
+class FdWriter;
+
+// MdStreamT writer: passes the data through until StartCompression() is
+// invoked, then compresses the data in blocks of the configured size.
+class CheckpointDeflateWriter
+{
+public:
+    CheckpointDeflateWriter(
+        FdWriter& inWriter,
+        int       inLevel,
+        size_t    inBlockSize);
+    ~CheckpointDeflateWriter();
+    static const char* GetCompressionPrefix()
+        { return "compression/zlib/blocksize/"; }
+    void flush()
+        {}
+    bool write(
+        const void* inBufPtr,
+        size_t      inLength);
+    void StartCompression()
+        { mCompressFlag = true; }
+    // Compresses and writes the remaining buffered data.
+    bool Finish();
+    int GetError() const;
+    size_t GetBlockSize() const
+        { return mBlockSize; }
+private:
+    FdWriter&    mWriter;
+    const int    mLevel;
+    const size_t mBlockSize;
+    bool         mCompressFlag;
+    int          mError;
+    string       mBuf;
+    vector<char> mOut;
+
+    bool WriteBlock(
+        const char* inPtr,
+        size_t      inLength);
+private:
+    CheckpointDeflateWriter(
+        const CheckpointDeflateWriter& inWriter);
+    CheckpointDeflateWriter& operator=(
+        const CheckpointDeflateWriter& inWriter);
+};
+
+// Checkpoint input stream buffer: passes uncompressed checkpoint through,
+// and decompresses the blocks that follow the compression header line.
+class CheckpointInflateBuf : public streambuf
+{
+public:
+    CheckpointInflateBuf(
+        istream& inStream);
+    ~CheckpointInflateBuf();
+    // Returns 0 if no decompression or read errors occurred, or negative
+    // error code.
+    int GetStatus() const
+        { return mStatus; }
+    bool IsCompressed() const
+        { return mCompressFlag; }
+protected:
+    virtual int_type underflow();
+private:
+    enum { kMaxHeaderLines = 16 };
+    enum { kReadSize       = 1 << 20 };
+    enum { kMaxBlockSize   = 256 << 20 };
+
+    istream&     mStream;
+    bool         mCompressFlag;
+    int          mHeaderLineCount;
+    int          mStatus;
+    string       mLine;
+    vector<char> mBuf;
+    vector<char> mIn;
+
+    int_type ReadLine();
+    int_type ReadBlock();
+    int_type Fail(
+        int inStatus);
+private:
+    CheckpointInflateBuf(
+        const CheckpointInflateBuf& inBuf);
+    CheckpointInflateBuf& operator=(
+        const CheckpointInflateBuf& inBuf);
+};
+
+}
+
+#endif /* CHECKPOINT_COMPRESSION_H */
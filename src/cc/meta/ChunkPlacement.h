@@ -66,6 +66,10 @@ using boost::bind;
  * The likelihood of a particular server to be chosen from a rack is
  * proportional to the to the reciprocal of the "write load" or available space.
  * For more details look at GetLoad() and LayoutManager::IsCandidateServer().
+ * Only the servers in the rack's per storage tier candidates list, maintained
+ * by LayoutManager::UpdateSrvLoadAvg(), are considered. The weighted selection
+ * without replacement uses binary indexed (Fenwick) tree over the candidates
+ * "load", and takes logarithmic time in the number of candidates.
  *
  * The available space is used for space re-balancing, and write load is used
  * for the initial chunk placement, unless using available space is forced by
@@ -100,12 +104,14 @@ public:
           mServerExcludes(),
           mCandidateRacks(),
           mCandidates(),
+          mLoadTree(),
           mLoadAvgSum(0),
           mRackPos(0),
           mCandidatePos(0),
           mCurRackId(-1),
           mCandidatesInRacksCount(0),
           mMaxReplicationsPerNode(0),
+          mMaxReplicationsPerDrive(0),
           mMaxSpaceUtilizationThreshold(0),
           mCurSTierMaxSpaceUtilizationThreshold(0),
           mForReplicationFlag(false),
@@ -141,7 +147,8 @@ public:
         kfsSTier_t minSTier,
         kfsSTier_t maxSTier,
         bool       forReplicationFlag = false,
-        RackId     rackIdToUse        = -1)
+        RackId     rackIdToUse        = -1,
+        bool       evacuationFlag     = false)
     {
         assert(
             kKfsSTierMin <= minSTier && minSTier <= kKfsSTierMax &&
@@ -161,6 +168,8 @@ public:
             mLayoutManager.GetMaxSpaceUtilizationThreshold();
         mMaxReplicationsPerNode       =
             mLayoutManager.GetMaxConcurrentWriteReplicationsPerNode();
+        mMaxReplicationsPerDrive      = evacuationFlag ?
+            mLayoutManager.GetMaxConcurrentEvacuationWritesPerDrive() : 0;
         FindCandidatesSelf(rackIdToUse);
     }
     void FindCandidatesInRack(
@@ -171,8 +180,9 @@ public:
 
     void FindCandidatesForReplication(
         kfsSTier_t minSTier,
-        kfsSTier_t maxSTier)
-        { FindCandidates(minSTier, maxSTier, true); }
+        kfsSTier_t maxSTier,
+        bool       evacuationFlag = false)
+        { FindCandidates(minSTier, maxSTier, true, -1, evacuationFlag); }
 
     void FindRebalanceCandidates(
         kfsSTier_t minSTier,
@@ -196,6 +206,7 @@ public:
             mLayoutManager.GetMaxSpaceUtilizationThreshold());
         mMaxReplicationsPerNode       =
             mLayoutManager.GetMaxConcurrentWriteReplicationsPerNode();
+        mMaxReplicationsPerDrive      = 0;
         FindCandidatesSelf(rackIdToUse);
     }
 
@@ -251,22 +262,13 @@ public:
         }
         // Random shuffle chosen servers, such that the servers with
         // smaller "load" go before the servers with larger load.
-        if (mCandidatePos == 1) {
-            return mCandidates[--mCandidatePos].second->shared_from_this();
-        }
         assert(mLoadAvgSum > 0);
-        int64_t rnd = Rand(mLoadAvgSum);
-        size_t  ri  = mCandidatePos--;
-        int64_t load;
-        do {
-            --ri;
-            load = mCandidates[ri].first;
-            rnd -= load;
-        } while (rnd >= 0 && ri > 0);
-        iter_swap(mCandidates.begin() + mCandidatePos,
-            mCandidates.begin() + ri);
+        const size_t  ri   = FindLoad(Rand(mLoadAvgSum));
+        const int64_t load = mCandidates[ri].first;
+        UpdateLoad(ri, -load);
         mLoadAvgSum -= load;
-        return mCandidates[mCandidatePos].second->shared_from_this();
+        mCandidatePos--;
+        return mCandidates[ri].second->shared_from_this();
     }
 
     bool IsUsingServerExcludes() const
@@ -716,6 +718,7 @@ private:
             pair<int64_t, ChunkServer*>,
             StdAllocator<pair<int64_t, ChunkServer*> >
         > Candidates;
+    typedef vector<int64_t, StdAllocator<int64_t> > LoadTree;
     typedef Servers Sources;
     enum { kSlaveScaleFracBits = LayoutManager::kSlaveScaleFracBits };
 
@@ -725,12 +728,14 @@ private:
     ServerExcludes   mServerExcludes;
     CandidateRacks   mCandidateRacks;
     Candidates       mCandidates;
+    LoadTree         mLoadTree;
     int64_t          mLoadAvgSum;
     size_t           mRackPos;
     size_t           mCandidatePos;
     RackId           mCurRackId;
     int64_t          mCandidatesInRacksCount;
     int              mMaxReplicationsPerNode;
+    int              mMaxReplicationsPerDrive;
     double           mMaxSpaceUtilizationThreshold;
     double           mCurSTierMaxSpaceUtilizationThreshold;
     bool             mForReplicationFlag;
@@ -841,14 +846,15 @@ private:
             srv.GetStorageTierSpaceUtilization(mCurSTier) <=
                 mCurSTierMaxSpaceUtilizationThreshold &&
             (! mForReplicationFlag ||
-                srv.GetNumChunkReplications() < mMaxReplicationsPerNode)
+                srv.GetNumChunkReplications() < max(mMaxReplicationsPerNode,
+                    srv.GetNumWritableDrives() * mMaxReplicationsPerDrive))
         );
     }
     void FindCandidateServers(
         const RackInfo& rack)
     {
-        FindCandidateServers(
-            rack.getServers(), rack.getPossibleCandidatesCount(mCurSTier));
+        const Sources& candidates = rack.getCandidateServers(mCurSTier);
+        FindCandidateServers(candidates, (int)candidates.size());
     }
     void FindCandidateServers(
         const Sources& sources,
@@ -875,6 +881,49 @@ private:
             mCandidates.push_back(make_pair(load, &srv));
         }
         mCandidatePos = mCandidates.size();
+        // Build the tree in linear time: add each node's partial sum to its
+        // parent.
+        const size_t size = mCandidates.size();
+        mLoadTree.resize(size + 1);
+        mLoadTree[0] = 0;
+        for (size_t i = 1; i <= size; i++) {
+            mLoadTree[i] = mCandidates[i - 1].first;
+        }
+        for (size_t i = 1; i <= size; i++) {
+            const size_t p = i + (i & (0 - i));
+            if (p <= size) {
+                mLoadTree[p] += mLoadTree[i];
+            }
+        }
+    }
+    void UpdateLoad(
+        size_t  idx,
+        int64_t delta)
+    {
+        const size_t size = mCandidates.size();
+        for (size_t i = idx + 1; i <= size; i += i & (0 - i)) {
+            mLoadTree[i] += delta;
+        }
+    }
+    size_t FindLoad(
+        int64_t val) const
+    {
+        // Find the first candidate with load prefix sum greater than val.
+        const size_t size = mCandidates.size();
+        size_t       bit  = 1;
+        while (bit <= size / 2) {
+            bit <<= 1;
+        }
+        size_t pos = 0;
+        for (; bit > 0; bit >>= 1) {
+            const size_t next = pos + bit;
+            if (next <= size && mLoadTree[next] <= val) {
+                pos = next;
+                val -= mLoadTree[next];
+            }
+        }
+        assert(pos < size);
+        return pos;
     }
     void NextTier()
     {
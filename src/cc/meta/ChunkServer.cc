@@ -189,6 +189,7 @@ const time_t kMaxSessionTimeoutSec = 10 * 365 * 24 * 60 * 60;
 int ChunkServer::sHeartbeatTimeout     = 60;
 int ChunkServer::sHeartbeatInterval    = 20;
 int ChunkServer::sHeartbeatLogInterval = 1000;
+bool ChunkServer::sHeartbeatDeltaFlag  = true;
 int ChunkServer::sChunkAllocTimeout    = 40;
 int ChunkServer::sChunkReallocTimeout  = 75;
 int ChunkServer::sMakeStableTimeout    = 330;
@@ -196,6 +197,7 @@ int ChunkServer::sReplicationTimeout   = 510;
 int ChunkServer::sRequestTimeout       = 600;
 int ChunkServer::sMetaClientPort       = 0;
 size_t ChunkServer::sMaxChunksToEvacuate  = 2 << 10; // Max queue size
+size_t ChunkServer::sMaxDeleteBatchSize   = 256;
 // sHeartbeatInterval * sSrvLoadSamplerSampleCount -- boxcar FIR filter
 // if sSrvLoadSamplerSampleCount > 0
 int ChunkServer::sSrvLoadSamplerSampleCount = 0;
@@ -228,6 +230,9 @@ void ChunkServer::SetParameters(const Properties& prop, int clientPort)
     sHeartbeatLogInterval = prop.getValue(
         "metaServer.chunkServer.heartbeatLogInterval",
         sHeartbeatLogInterval);
+    sHeartbeatDeltaFlag = prop.getValue(
+        "metaServer.chunkServer.heartbeatDelta",
+        sHeartbeatDeltaFlag ? 1 : 0) != 0;
     sChunkAllocTimeout = prop.getValue(
         "metaServer.chunkServer.chunkAllocTimeout",
         sChunkAllocTimeout);
@@ -252,6 +257,9 @@ void ChunkServer::SetParameters(const Properties& prop, int clientPort)
     sMaxChunksToEvacuate = max(size_t(1), prop.getValue(
         "metaServer.chunkServer.maxChunksToEvacuate",
         sMaxChunksToEvacuate));
+    sMaxDeleteBatchSize = prop.getValue(
+        "metaServer.chunkServer.maxDeleteBatchSize",
+        sMaxDeleteBatchSize);
     if (clientPort > 0) {
         sMetaClientPort = clientPort;
     }
@@ -346,6 +354,7 @@ ChunkServer::ChunkServer(const NetConnectionPtr& conn, const string& peerName)
       mChunksToEvacuate(),
       mLocation(),
       mHostPortStr(),
+      mReplicaLocationStr(),
       mRackId(-1),
       mNumCorruptChunks(0),
       mTotalSpace(0),
@@ -370,6 +379,7 @@ ChunkServer::ChunkServer(const NetConnectionPtr& conn, const string& peerName)
       mLostChunks(0),
       mUptime(0),
       mHeartbeatProperties(),
+      mHeartbeatDeltaSeq(-1),
       mRestartScheduledFlag(false),
       mRestartQueuedFlag(false),
       mRestartScheduledTime(0),
@@ -389,19 +399,25 @@ ChunkServer::ChunkServer(const NetConnectionPtr& conn, const string& peerName)
       mLoadAvg(0),
       mCanBeCandidateServerFlag(false),
       mStaleChunksHexFormatFlag(false),
+      mDeleteBatchFlag(false),
+      mPendingDeletes(),
       mIStream(),
       mEvacuateCnt(0),
       mEvacuateBytes(0),
       mEvacuateDoneCnt(0),
       mEvacuateDoneBytes(0),
       mEvacuateInFlight(0),
+      mMemoryTiersMask(0),
       mPrevEvacuateDoneCnt(0),
       mPrevEvacuateDoneBytes(0),
       mEvacuateLastRateUpdateTime(TimeNow()),
       mEvacuateCntRate(0.),
       mEvacuateByteRate(0.),
+      mEvacuationReadCredit(0),
+      mEvacuationReadCreditTime(0),
       mLostChunkDirs(),
       mChunkDirInfos(),
+      mSlowChunkDirCount(0),
       mMd5Sum(),
       mPeerName(peerName),
       mCryptoKeyValidFlag(false),
@@ -858,6 +874,7 @@ ChunkServer::ForceDown()
     assert(sChunkDirsCount >= mChunkDirInfos.size());
     sChunkDirsCount -= min(sChunkDirsCount, mChunkDirInfos.size());
     mChunkDirInfos.clear();
+    mSlowChunkDirCount = 0;
     mSelfPtr.reset(); // Unref / delete self
 }
 
@@ -926,6 +943,7 @@ ChunkServer::Error(const char* errorMsg)
     assert(sChunkDirsCount >= mChunkDirInfos.size());
     sChunkDirsCount -= min(sChunkDirsCount, mChunkDirInfos.size());
     mChunkDirInfos.clear();
+    mSlowChunkDirCount = 0;
     if (mHelloDone) {
         // force the server down thru the main loop to avoid races
         MetaBye* const mb = new MetaBye(0, shared_from_this());
@@ -1427,6 +1445,7 @@ ChunkServer::HandleHelloMsg(IOBuffer* iobuf, int msgLen)
     mUptime                   = mHelloOp->uptime;
     mNumAppendsWithWid        = mHelloOp->numAppendsWithWid;
     mStaleChunksHexFormatFlag = mHelloOp->staleChunksHexFormatFlag;
+    mDeleteBatchFlag          = mHelloOp->deleteBatchFlag;
     for (size_t i = 0; i < kKfsSTierCount; i++) {
         mStorageTiersInfoDelta[i].Clear();
     }
@@ -1466,6 +1485,11 @@ ChunkServer::SetServerLocation(const ServerLocation& loc)
     mHostPortStr = mLocation.hostname;
     mHostPortStr += ':';
     AppendDecIntToString(mHostPortStr, mLocation.port);
+    // Getalloc response "Replicas:" list entry, formatted once.
+    mReplicaLocationStr = " ";
+    mReplicaLocationStr += mLocation.hostname;
+    mReplicaLocationStr += ' ';
+    AppendDecIntToString(mReplicaLocationStr, mLocation.port);
 }
 
 ///
@@ -1579,6 +1603,30 @@ ChunkServer::HandleReply(IOBuffer* iobuf, int msgLen)
     }
     op->handleReply(prop);
     if (op->op == META_CHUNK_HEARTBEAT) {
+        const seq_t deltaSeq = prop.getValue("Delta-seq", seq_t(-1));
+        if (0 <= deltaSeq) {
+            // The reply contains only the counters that have changed since
+            // the last heartbeat, merge them with the last heartbeat.
+            if (deltaSeq != mHeartbeatDeltaSeq) {
+                // Request the full heartbeat next time.
+                KFS_LOG_STREAM_ERROR << GetServerLocation() <<
+                    " invalid heartbeat delta seq: " << deltaSeq <<
+                    " expected: " << mHeartbeatDeltaSeq <<
+                KFS_LOG_EOM;
+                mHeartbeatDeltaSeq = -1;
+                mHeartbeatSent     = false;
+                op->resume();
+                return 0;
+            }
+            for (Properties::iterator it = prop.begin();
+                    it != prop.end();
+                    ++it) {
+                mHeartbeatProperties.setValue(it->first, it->second);
+            }
+            prop.swap(mHeartbeatProperties);
+            prop.remove("Delta-seq");
+        }
+        mHeartbeatDeltaSeq = -1;
         mTotalSpace        = prop.getValue("Total-space",           int64_t(0));
         mTotalFsSpace      = prop.getValue("Total-fs-space",       int64_t(-1));
         mUsedSpace         = prop.getValue("Used-space",            int64_t(0));
@@ -1594,6 +1642,7 @@ ChunkServer::HandleReply(IOBuffer* iobuf, int msgLen)
         mEvacuateDoneCnt   = prop.getValue("Evacuate-done",         int64_t(-1));
         mEvacuateDoneBytes = prop.getValue("Evacuate-done-bytes",   int64_t(-1));
         mEvacuateInFlight  = prop.getValue("Evacuate-in-flight",    int64_t(-1));
+        mMemoryTiersMask   = prop.getValue("Memory-tiers", uint32_t(0));
         const int     numWrChunks = prop.getValue("Num-writable-chunks", 0);
         const int     numWrDrives = prop.getValue("Num-wr-drives", mNumDrives);
         const int64_t numObjs     = prop.getValue("Num-objs", int64_t(0));
@@ -1606,6 +1655,10 @@ ChunkServer::HandleReply(IOBuffer* iobuf, int msgLen)
         UpdateStorageTiers(prop.getValue("Storage-tiers"),
             numWrDrives, numWrChunks);
         UpdateChunkWritesPerDrive(numWrChunks, numWrDrives);
+        const Properties::String* const hotChunks = prop.getValue("Hot-chunks");
+        if (hotChunks) {
+            UpdateHotChunks(*hotChunks);
+        }
         const Properties::String* const cryptoKey = prop.getValue("CKey");
         if (cryptoKey) {
             const Properties::String* const keyId = prop.getValue("CKeyId");
@@ -1685,6 +1738,7 @@ ChunkServer::HandleReply(IOBuffer* iobuf, int msgLen)
         mHeartbeatSent    = false;
         mHeartbeatSkipped = mLastHeartbeatSent + sHeartbeatInterval < now;
         mHeartbeatProperties.swap(prop);
+        mHeartbeatDeltaSeq = op->status < 0 ? seq_t(-1) : cseq;
         if (mTotalFsSpace < mTotalSpace) {
             mTotalFsSpace = mTotalSpace;
         }
@@ -1770,6 +1824,10 @@ ChunkServer::TimeSinceLastHeartbeat() const
 void
 ChunkServer::Enqueue(MetaChunkRequest* r, int timeout /* = -1 */)
 {
+    if (r->op != META_CHUNK_DELETE_BATCH && ! mPendingDeletes.IsEmpty()) {
+        // Preserve the rpc order.
+        FlushPendingDeletes();
+    }
     if (r->submitCount++ == 0) {
         r->submitTime = microseconds();
     }
@@ -1896,17 +1954,105 @@ ChunkServer::AllocateChunk(MetaAllocate* r, int64_t leaseId, kfsSTier_t tier)
     return 0;
 }
 
+// Collects servers with pending chunk deletes, and flushes the deletes on the
+// next net manager loop iteration, in order to batch all deletes issued by
+// the meta server while processing the current set of requests, typically
+// file or directory tree removal.
+class ChunkServer::DeleteBatchFlusher : public ITimeout
+{
+public:
+    static void Schedule(const ChunkServerPtr& server)
+        { Instance().ScheduleSelf(server); }
+    virtual void Timeout()
+    {
+        Servers servers;
+        servers.swap(mServers);
+        for (Servers::const_iterator it = servers.begin();
+                it != servers.end();
+                ++it) {
+            (*it)->FlushPendingDeletes();
+        }
+        if (! mServers.empty() || ! mRegisteredFlag) {
+            return;
+        }
+        mRegisteredFlag = false;
+        globalNetManager().UnRegisterTimeoutHandler(this);
+    }
+private:
+    typedef vector<ChunkServerPtr> Servers;
+
+    Servers mServers;
+    bool    mRegisteredFlag;
+
+    DeleteBatchFlusher()
+        : ITimeout(),
+          mServers(),
+          mRegisteredFlag(false)
+        {}
+    virtual ~DeleteBatchFlusher()
+    {
+        if (! mRegisteredFlag) {
+            return;
+        }
+        mRegisteredFlag = false;
+        globalNetManager().UnRegisterTimeoutHandler(this);
+    }
+    void ScheduleSelf(const ChunkServerPtr& server)
+    {
+        mServers.push_back(server);
+        if (mRegisteredFlag) {
+            return;
+        }
+        mRegisteredFlag = true;
+        globalNetManager().RegisterTimeoutHandler(this);
+        globalNetManager().Wakeup();
+    }
+    static DeleteBatchFlusher& Instance()
+    {
+        static DeleteBatchFlusher sDeleteBatchFlusher;
+        return sDeleteBatchFlusher;
+    }
+private:
+    DeleteBatchFlusher(const DeleteBatchFlusher&);
+    DeleteBatchFlusher& operator=(const DeleteBatchFlusher&);
+};
+
 int
 ChunkServer::DeleteChunkVers(chunkId_t chunkId, seq_t chunkVersion)
 {
     if (0 <= chunkVersion) {
         mChunksToEvacuate.Erase(chunkId);
     }
+    if (0 == chunkVersion && mDeleteBatchFlag && 1 < sMaxDeleteBatchSize &&
+            ! mDown) {
+        // Only deletes without version are batched, object store block
+        // deletes require per block completion.
+        if (mPendingDeletes.IsEmpty()) {
+            DeleteBatchFlusher::Schedule(shared_from_this());
+        }
+        mPendingDeletes.PushBack(chunkId);
+        if (sMaxDeleteBatchSize <= mPendingDeletes.GetSize()) {
+            FlushPendingDeletes();
+        }
+        return 0;
+    }
     Enqueue(new MetaChunkDelete(
         NextSeq(), shared_from_this(), chunkId, chunkVersion));
     return 0;
 }
 
+void
+ChunkServer::FlushPendingDeletes()
+{
+    if (mPendingDeletes.IsEmpty()) {
+        return;
+    }
+    MetaChunkDeleteBatch* const r =
+        new MetaChunkDeleteBatch(NextSeq(), shared_from_this());
+    r->chunkIds.Swap(mPendingDeletes);
+    Enqueue(r);
+}
+
 int
 ChunkServer::GetChunkSize(fid_t fid, chunkId_t chunkId, seq_t chunkVersion,
     const string &pathname, bool retryFlag)
@@ -1943,11 +2089,17 @@ int
 ChunkServer::ReplicateChunk(fid_t fid, chunkId_t chunkId,
     const ChunkServerPtr& dataServer, const ChunkRecoveryInfo& recoveryInfo,
     kfsSTier_t minSTier, kfsSTier_t maxSTier,
-    MetaChunkReplicate::FileRecoveryInFlightCount::iterator it)
+    MetaChunkReplicate::FileRecoveryInFlightCount::iterator it,
+    MetaCopyChunk* copyChunk)
 {
     MetaChunkReplicate* const r = new MetaChunkReplicate(
         NextSeq(), shared_from_this(), fid, chunkId,
         dataServer->GetServerLocation(), dataServer, minSTier, maxSTier, it);
+    if (copyChunk) {
+        r->copyChunk    = copyChunk;
+        r->srcChunkId   = copyChunk->srcChunkId;
+        r->chunkVersion = copyChunk->chunkVersion;
+    }
     if (! dataServer) {
         panic("invalid null replication source");
         r->status = -EINVAL;
@@ -2112,8 +2264,14 @@ ChunkServer::Heartbeat()
     const time_t now           = TimeNow();
     const int    timeSinceSent = (int)(now - mLastHeartbeatSent);
     if (mHeartbeatSent) {
+        // Measure the timeout up to the last poll, as the reply that arrived
+        // after the poll has not been read yet. The main thread can take
+        // long to dispatch the events, for example with large number of
+        // client requests, and the timer processing that follows the
+        // dispatch should not declare the server down in this case.
+        const time_t pollTime = min(now, globalNetManager().GetPollTime());
         if (sHeartbeatTimeout >= 0 &&
-                timeSinceSent >= sHeartbeatTimeout) {
+                (int)(pollTime - mLastHeartbeatSent) >= sHeartbeatTimeout) {
             ostringstream& os = GetTmpOStringStream();
             os << "heartbeat timed out, sent: " <<
                 timeSinceSent << " sec. ago";
@@ -2131,7 +2289,7 @@ ChunkServer::Heartbeat()
             KFS_LOG_EOM;
         }
         return(sHeartbeatTimeout < 0 ?
-            sHeartbeatTimeout : sHeartbeatTimeout - timeSinceSent);
+            sHeartbeatTimeout : max(1, sHeartbeatTimeout - timeSinceSent));
     }
     if (timeSinceSent >= sHeartbeatInterval) {
         KFS_LOG_STREAM_DEBUG << GetServerLocation() <<
@@ -2172,7 +2330,8 @@ ChunkServer::Heartbeat()
                 NextSeq(),
                 shared_from_this(),
                 IsRetiring() ? int64_t(1) : (int64_t)mChunksToEvacuate.Size(),
-                reAuthenticateFlag
+                reAuthenticateFlag,
+                sHeartbeatDeltaFlag ? mHeartbeatDeltaSeq : seq_t(-1)
             ),
             2 * sHeartbeatTimeout
         );
@@ -2432,6 +2591,24 @@ ChunkServer::Escape(const char* buf, size_t len)
     return ret;
 }
 
+void
+ChunkServer::UpdateHotChunks(const Properties::String& hotChunks)
+{
+    const char*       p = hotChunks.GetPtr();
+    const char* const e = p + hotChunks.GetSize();
+    int               count;
+    if (! DecIntParser::Parse(p, e - p, count)) {
+        return;
+    }
+    chunkId_t chunkId;
+    int       readRate;
+    while (0 < count-- &&
+            DecIntParser::Parse(p, e - p, chunkId) &&
+            DecIntParser::Parse(p, e - p, readRate)) {
+        gLayoutManager.UpdateHotChunk(chunkId, readRate);
+    }
+}
+
 void
 ChunkServer::UpdateStorageTiersSelf(
     const char* buf,
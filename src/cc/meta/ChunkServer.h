@@ -87,6 +87,7 @@ public:
     CSMapServerInfo()
         : mIndex(-1),
           mChunkCount(0),
+          mChunkIdsChecksum(0),
           mSet(0)
         {}
     ~CSMapServerInfo() {
@@ -94,23 +95,33 @@ public:
     }
     int GetIndex() const { return mIndex; }
     size_t GetChunkCount() const { return mChunkCount; }
+    // Sum of ChunkIdInventoryChecksum() of the hosted chunks.
+    uint64_t GetChunkIdsChecksum() const { return mChunkIdsChecksum; }
 private:
-    int    mIndex;
-    size_t mChunkCount;
+    int      mIndex;
+    size_t   mChunkCount;
+    uint64_t mChunkIdsChecksum;
 
-    void AddHosted() {
+    void AddHosted(chunkId_t chunkId) {
         mChunkCount++;
         assert(mChunkCount > 0);
+        mChunkIdsChecksum += ChunkIdInventoryChecksum(chunkId);
     }
-    void RemoveHosted() {
+    void RemoveHosted(chunkId_t chunkId) {
         if (mChunkCount <= 0) {
             panic("no hosted chunks", false);
             return;
         }
         mChunkCount--;
+        mChunkIdsChecksum -= ChunkIdInventoryChecksum(chunkId);
+    }
+    void SetHosted(size_t count, uint64_t checksum) {
+        mChunkCount       = count;
+        mChunkIdsChecksum = checksum;
     }
     void ClearHosted() {
-        mChunkCount = 0;
+        mChunkCount       = 0;
+        mChunkIdsChecksum = 0;
         if (mSet) {
             mSet->Clear();
         }
@@ -151,7 +162,7 @@ private:
                 ! newEntryFlag)) {
             panic("duplicate chunk id", false);
         }
-        AddHosted();
+        AddHosted(chunkId);
     }
     void RemoveHosted(chunkId_t chunkId, int index) {
         if (mIndex < 0 || index != mIndex) {
@@ -160,7 +171,7 @@ private:
         if (mSet && mSet->Erase(chunkId) <= 0) {
             panic("no such chunk", false);
         }
-        RemoveHosted();
+        RemoveHosted(chunkId);
     }
     const int* HostedIdx(chunkId_t chunkId) const {
         return ((mSet && mSet->Find(chunkId)) ? &mIndex : 0);
@@ -417,11 +428,13 @@ public:
 
     /// Methods to handle (re) replication of a chunk.  If there are
     /// insufficient copies of a chunk, we replicate it.
+    /// With copyChunk the source chunk is copied into the new chunk id.
     int ReplicateChunk(fid_t fid, chunkId_t chunkId,
         const ChunkServerPtr&    dataServer,
         const ChunkRecoveryInfo& recoveryInfo,
         kfsSTier_t minSTier, kfsSTier_t maxSTier,
-        MetaChunkReplicate::FileRecoveryInFlightCount::iterator it);
+        MetaChunkReplicate::FileRecoveryInFlightCount::iterator it,
+        MetaCopyChunk* copyChunk = 0);
     /// Start write append recovery when chunk master is non operational.
     int BeginMakeChunkStable(fid_t fid, chunkId_t chunkId, seq_t chunkVersion);
     /// Notify a chunkserver that the writes to a chunk are done;
@@ -461,6 +474,27 @@ public:
             mNumChunkReadReplications = 0;
     }
 
+    /// Evacuation read bandwidth token bucket, with one second burst.
+    /// Returns true if evacuation replication from this server can be
+    /// started now.
+    bool HasEvacuationReadCredit(time_t now, int64_t bytesPerSec) {
+        if (bytesPerSec <= 0) {
+            return true;
+        }
+        if (mEvacuationReadCreditTime < now) {
+            const int64_t maxDelta = (2 * bytesPerSec -
+                mEvacuationReadCredit - 1) / bytesPerSec;
+            mEvacuationReadCredit = min(bytesPerSec, mEvacuationReadCredit +
+                min(maxDelta, int64_t(now - mEvacuationReadCreditTime)) *
+                bytesPerSec);
+            mEvacuationReadCreditTime = now;
+        }
+        return (0 < mEvacuationReadCredit);
+    }
+    void UpdateEvacuationReadCredit(int64_t bytes) {
+        mEvacuationReadCredit -= bytes;
+    }
+
     /// If a chunkserver isn't responding, don't send any
     /// write load towards it.  We detect loaded servers to be
     /// those that don't respond to heartbeat messages.
@@ -719,6 +753,20 @@ public:
     void SetCanBeCandidateServerFlag(bool flag) {
         mCanBeCandidateServerFlag = flag;
     }
+    /// Returns true if the server has memory backed chunk directories in
+    /// any of the tiers in the specified range.
+    bool HasMemoryStorageTier(kfsSTier_t minTier, kfsSTier_t maxTier) const {
+        if (mMemoryTiersMask == 0) {
+            return false;
+        }
+        for (kfsSTier_t t = minTier; t <= maxTier; t++) {
+            if (kKfsSTierMin <= t && t <= kKfsSTierMax &&
+                    (mMemoryTiersMask & (uint32_t(1) << t)) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
     int64_t GetEvacuateCount() const {
         return mEvacuateCnt;
     }
@@ -740,6 +788,8 @@ public:
     }
     const string& GetHostPortStr() const
         { return mHostPortStr; }
+    const string& GetReplicaLocationStr() const
+        { return mReplicaLocationStr; }
     typedef MetaChunkDirInfo::DirName DirName;
     typedef map <
         DirName,
@@ -754,11 +804,21 @@ public:
         }
         // Find should succeed, except initial load. Use find to avoid
         // key (dirName) copy in the insertion pair constructor.
+        const bool slowFlag = props.getValue("Slow", 0) != 0;
         ChunkDirInfos::iterator const it = mChunkDirInfos.find(dirName);
         if (it != mChunkDirInfos.end()) {
+            if (it->second.first.getValue("Slow", 0) != 0) {
+                mSlowChunkDirCount--;
+            }
+            if (slowFlag) {
+                mSlowChunkDirCount++;
+            }
             it->second.first.swap(props);
             return;
         }
+        if (slowFlag) {
+            mSlowChunkDirCount++;
+        }
         ChunkDirInfos::mapped_type& di = mChunkDirInfos[dirName];
         di.first.swap(props);
         di.second = Escape(dirName);
@@ -767,6 +827,12 @@ public:
     const ChunkDirInfos& GetChunkDirInfos() const {
         return mChunkDirInfos;
     }
+    int GetSlowChunkDirCount() const {
+        return mSlowChunkDirCount;
+    }
+    bool HasNoSlowChunkDirs() const {
+        return (mSlowChunkDirCount <= 0);
+    }
     static void SetMaxHelloBufferBytes(int64_t maxBytes) {
         sMaxHelloBufferBytes = maxBytes;
     }
@@ -843,6 +909,7 @@ protected:
     static int    sHeartbeatTimeout;
     static int    sHeartbeatInterval;
     static int    sHeartbeatLogInterval;
+    static bool   sHeartbeatDeltaFlag;
     static int    sChunkAllocTimeout;
     static int    sChunkReallocTimeout;
     static int    sMakeStableTimeout;
@@ -853,6 +920,7 @@ protected:
     static int    sSrvLoadSamplerSampleCount;
     static string sSrvLoadPropName;
     static size_t sMaxChunksToEvacuate;
+    static size_t sMaxDeleteBatchSize;
 
     /// For record append's, can this node be a chunk master
     bool mCanBeChunkMaster;
@@ -875,6 +943,7 @@ protected:
     /// connect to
     ServerLocation mLocation;
     string         mHostPortStr;
+    string         mReplicaLocationStr;
 
     /// A unique id to denote the rack on which the server is located.
     /// -1 signifies that we don't what rack the server is on and by
@@ -971,6 +1040,7 @@ protected:
     int64_t            mLostChunks;
     int64_t            mUptime;
     Properties         mHeartbeatProperties;
+    seq_t              mHeartbeatDeltaSeq; // Last heartbeat reply seq.
     bool               mRestartScheduledFlag;
     bool               mRestartQueuedFlag;
     time_t             mRestartScheduledTime;
@@ -990,19 +1060,25 @@ protected:
     int64_t            mLoadAvg;
     bool               mCanBeCandidateServerFlag;
     bool               mStaleChunksHexFormatFlag;
+    bool               mDeleteBatchFlag;
+    ChunkIdQueue       mPendingDeletes;
     IOBuffer::IStream  mIStream;
     int64_t            mEvacuateCnt;
     int64_t            mEvacuateBytes;
     int64_t            mEvacuateDoneCnt;
     int64_t            mEvacuateDoneBytes;
     int64_t            mEvacuateInFlight;
+    uint32_t           mMemoryTiersMask;
     int64_t            mPrevEvacuateDoneCnt;
     int64_t            mPrevEvacuateDoneBytes;
     time_t             mEvacuateLastRateUpdateTime;
     double             mEvacuateCntRate;
     double             mEvacuateByteRate;
+    int64_t            mEvacuationReadCredit;
+    time_t             mEvacuationReadCreditTime;
     LostChunkDirs      mLostChunkDirs;
     ChunkDirInfos      mChunkDirInfos;
+    int                mSlowChunkDirCount;
     string             mMd5Sum;
     const string       mPeerName;
     bool               mCryptoKeyValidFlag;
@@ -1034,7 +1110,11 @@ protected:
     friend class QCDLListOp<ChunkServer, 1>;
     typedef QCDLList<ChunkServer, 0> ChunkServersList;
     typedef QCDLList<ChunkServer, 1> PendingHelloList;
+    class DeleteBatchFlusher;
+    friend class DeleteBatchFlusher;
 
+    /// Send the pending chunk deletes, if any, as a single batch rpc.
+    void FlushPendingDeletes();
     void AddToPendingHelloList();
     void RemoveFromPendingHelloList();
     static int64_t GetHelloBytes(MetaHello* req = 0);
@@ -1133,6 +1213,7 @@ protected:
         { UpdateStorageTiersSelf("", 0, 0, 0); }
     void UpdateStorageTiersSelf(const char* buf, size_t len,
         int deviceCount, int writableChunkCount);
+    void UpdateHotChunks(const Properties::String& hotChunks);
     int Authenticate(IOBuffer& iobuf);
     bool ParseCryptoKey(
         const Properties::String& keyId,
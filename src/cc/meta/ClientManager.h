@@ -32,6 +32,7 @@
 #define META_CLIENTMANAGER_H
 
 #include "MetaRequest.h"
+#include "kfsio/NetManager.h"
 
 class QCMutex;
 
@@ -57,7 +58,11 @@ public:
     void ChildAtFork();
     QCMutex& GetMutex();
     void SetParameters(const Properties& params);
+    void GetEventStats(NetManager::EventStats& stats) const;
+    void GetRequestPhaseStats(MetaRequestPhaseStats& stats) const;
     static AuthContext& GetAuthContext(ClientThread* inThread);
+    // Update request phase stats, invoked when response is sent.
+    static void RequestDone(ClientThread* thread, const MetaRequest& op);
     static bool Enqueue(ClientThread* thread, MetaRequest& op)
     {
         if (op.next == &op) {
@@ -84,6 +89,9 @@ public:
     void PrepareCurrentThreadToFork();
     inline void PrepareToFork();
     inline void ForkDone();
+    inline bool StartConcurrentRead();
+    inline void ConcurrentReadDone();
+    inline bool IsConcurrentReadEnabled() const;
 private:
     class Impl;
     Impl& mImpl;
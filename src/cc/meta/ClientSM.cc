@@ -41,6 +41,7 @@
 #include "kfsio/DelegationToken.h"
 #include "common/MsgLogger.h"
 #include "common/Properties.h"
+#include "common/kfsatomic.h"
 #include "AuditLog.h"
 #include "AuthContext.h"
 
@@ -84,6 +85,7 @@ int  ClientSM::sMaxWriteBehind            = 3 << 10;
 int  ClientSM::sBufCompactionThreshold    = 1 << 10;
 int  ClientSM::sOutBufCompactionThreshold = 8 << 10;
 int  ClientSM::sClientCount               = 0;
+volatile int ClientSM::sIdleClientCount   = 0;
 bool ClientSM::sAuditLoggingFlag          = false;
 int  ClientSM::sAuthMaxTimeSkew           = 2 * 60;
 ClientSM* ClientSM::sClientSMPtr[1]       = {0};
@@ -145,6 +147,7 @@ ClientSM::ClientSM(
       mClientProtoVers(KFS_CLIENT_PROTO_VERS),
       mDisconnectFlag(false),
       mDelegationValidFlag(false),
+      mIdleFlag(false),
       mLastReadLeft(0),
       mAuthenticateOp(0),
       mAuthUid(kKfsUserNone),
@@ -180,6 +183,7 @@ ClientSM::ClientSM(
 ClientSM::~ClientSM()
 {
     delete mAuthenticateOp;
+    SetIdle(false);
     QCStMutexLocker locker(gNetDispatch.GetClientManagerMutex());
     ClientSMList::Remove(sClientSMPtr, *this);
     sClientCount--;
@@ -217,6 +221,7 @@ ClientSM::SendResponse(MetaRequest *op)
         mOstream.Set(mNetConnection->GetOutBuffer()),
         mNetConnection->GetOutBuffer());
     mOstream.Reset();
+    ClientManager::RequestDone(mClientThread, *op);
     if (mRecursionCnt <= 0) {
         mNetConnection->StartFlush();
     }
@@ -311,7 +316,8 @@ ClientSM::HandleRequestSelf(int code, void *data)
     case EVENT_CMD_DONE: {
         assert(data && mPendingOpsCount > 0);
         MetaRequest* const op = reinterpret_cast<MetaRequest*>(data);
-        if (sAuditLoggingFlag && ! op->reqHeaders.IsEmpty()) {
+        if (sAuditLoggingFlag &&
+                (AuditLog::IsBinary() || ! op->reqHeaders.IsEmpty())) {
             AuditLog::Log(*op);
         }
         const bool deleteOpFlag = op != mAuthenticateOp;
@@ -467,6 +473,10 @@ ClientSM::HandleRequestSelf(int code, void *data)
             if (numBytes <= sOutBufCompactionThreshold && numBytes > 0) {
                 outbuf.MakeBuffersFull();
             }
+            // Connection with no requests in flight and no buffered data
+            // holds no io buffers, and, with tls, no tls record buffers.
+            SetIdle(mPendingOpsCount <= 0 && inbuf.IsEmpty() &&
+                numBytes <= 0);
             if (mNetConnection->IsReadReady() &&
                     (IsOverPendingOpsLimit() ||
                     sMaxWriteBehind <= mNetConnection->GetNumBytesToWrite() ||
@@ -477,6 +487,7 @@ ClientSM::HandleRequestSelf(int code, void *data)
                 mNetConnection->SetMaxReadAhead(0);
             }
         } else {
+            SetIdle(false);
             if (mPendingOpsCount > 0) {
                 mNetConnection.reset();
             } else {
@@ -494,6 +505,16 @@ ClientSM::HandleRequestSelf(int code, void *data)
     return 0;
 }
 
+void
+ClientSM::SetIdle(bool flag)
+{
+    if (flag == mIdleFlag) {
+        return;
+    }
+    mIdleFlag = flag;
+    SyncAddAndFetch(sIdleClientCount, flag ? 1 : -1);
+}
+
 void
 ClientSM::CloseConnection(const char* msg /* = 0 */)
 {
@@ -543,7 +564,7 @@ ClientSM::HandleClientCmd(IOBuffer& iobuf, int cmdLen)
         KFS_LOG_EOM;
     }
     // Command is ready to be pushed down.  So remove the cmd from the buffer.
-    if (sAuditLoggingFlag) {
+    if (sAuditLoggingFlag && ! AuditLog::IsBinary()) {
         op->reqHeaders.Move(&iobuf, cmdLen);
     } else {
         iobuf.Consume(cmdLen);
@@ -555,6 +576,9 @@ ClientSM::HandleClientCmd(IOBuffer& iobuf, int cmdLen)
         " rd: "   << mNetConnection->GetNumBytesToRead() <<
         " wr: "   << mNetConnection->GetNumBytesToWrite() <<
     KFS_LOG_EOM;
+    if (MetaRequestPhaseStats::IsEnabled()) {
+        op->recvTime = microseconds();
+    }
     op->clientIp            = mClientIp;
     op->fromClientSMFlag    = true;
     op->clnt                = this;
@@ -636,6 +660,15 @@ ClientSM::HandleClientCmd(IOBuffer& iobuf, int cmdLen)
         CmdDone(*op);
         return;
     }
+    switch (gNetDispatch.Admit(*op)) {
+        case NetDispatch::kAdmitQueued:
+            return;
+        case NetDispatch::kAdmitRejected:
+            CmdDone(*op);
+            return;
+        default:
+            break;
+    }
     ClientManager::SubmitRequest(mClientThread, *op);
 }
 
@@ -962,11 +995,12 @@ ClientSM::GetPsk(
     const time_t now      =
         mNetConnection ? mNetConnection->TimeNow() : time(0);
     const int   theIdLen  = (int)strlen(inIdentityPtr);
-    const int   theKeyLen = theKeysPtr ? theDelegationToken.Process(
+    const int   theKeyLen = theKeysPtr ? mAuthContext.ProcessDelegation(
         inIdentityPtr,
         theIdLen,
         (int64_t)now,
         *theKeysPtr,
+        theDelegationToken,
         reinterpret_cast<char*>(inPskBufferPtr),
         (int)min(inPskBufferLen, 0x7FFFFu),
         &theErrMsg
@@ -98,6 +98,7 @@ public:
 
     static void SetParameters(const Properties& prop);
     static int GetClientCount() { return sClientCount; }
+    static int GetIdleClientCount() { return sIdleClientCount; }
     bool Handle(MetaAuthenticate& op);
     bool Handle(MetaDelegate& op);
     bool Handle(MetaLookup& op);
@@ -115,6 +116,7 @@ private:
     int                                mClientProtoVers;
     bool                               mDisconnectFlag:1;
     bool                               mDelegationValidFlag:1;
+    bool                               mIdleFlag:1;
     int                                mLastReadLeft;
     MetaAuthenticate*                  mAuthenticateOp;
     kfsUid_t                           mAuthUid;
@@ -151,6 +153,7 @@ private:
     void HandleAuthenticate(IOBuffer& iobuf);
     void HandleDelegation(MetaDelegate& op);
     void CloseConnection(const char* msg = 0);
+    void SetIdle(bool flag);
 
     static int  sMaxPendingOps;
     static int  sMaxPendingBytes;
@@ -161,6 +164,7 @@ private:
     static int  sOutBufCompactionThreshold;
     static int  sAuthMaxTimeSkew;
     static int  sClientCount;
+    static volatile int sIdleClientCount;
     static bool sAuditLoggingFlag;
     static ClientSM* sClientSMPtr[1];
     static IOBuffer::WOStream sWOStream;
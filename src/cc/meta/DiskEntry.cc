@@ -28,6 +28,8 @@
 #include "DiskEntry.h"
 #include "util.h"
 
+#include <stdio.h>
+
 namespace KFS
 {
 using std::istream;
@@ -49,6 +51,7 @@ DETokenizer::next(ostream* os)
     Token* const tend = tokens + kMaxEntryTokens;
     cur = tokens;
     end = tokens;
+    binaryEntry = false;
     if (os && prevStart < nextEnt) {
         os->write(prevStart, nextEnt - prevStart);
         prevStart = nextEnt;
@@ -57,12 +60,26 @@ DETokenizer::next(ostream* os)
         while (*nextEnt == '\n') {
             ++nextEnt;
         }
+        if (nextEnt < bend && *nextEnt == (char)kBinaryEntryMarker) {
+            const int ret = nextBinary(tend);
+            if (0 < ret) {
+                binaryEntry = true;
+                entryCount++;
+                break;
+            }
+            end = tokens;
+            if (ret < 0 || ! fill(os)) {
+                return false;
+            }
+            continue;
+        }
         char* s = nextEnt;
         char* p = s;
         while (*p != '\n') {
             if (*p == '/') {
                 end->ptr = s;
                 end->len = p - s;
+                end->isnum = false;
                 s = ++p;
                 if (++end >= tend) {
                     end = tokens;
@@ -75,45 +92,147 @@ DETokenizer::next(ostream* os)
         if (p < bend) {
             end->ptr = s;
             end->len = p - s;
+            end->isnum = false;
             ++end;
             nextEnt  = p + 1;
             entryCount++;
             break;
         }
         end = tokens;
-        const size_t size = nextEnt >= bend ? 0 :
-            (p < bend ? p : bend) - nextEnt;
-        if (kMaxEntrySize <= size) {
+        if (! fill(os)) {
             return false;
         }
-        if (os && prevStart < nextEnt) {
-            const size_t sz =
-                (nextEnt < bend ? nextEnt : bend) - prevStart;
-            if (sz > 0) {
-                os->write(prevStart, sz);
-            }
+    }
+    return true;
+}
+
+/*!
+ * \brief move the remaining partial entry to the beginning of the buffer, and
+ * read more data from the input stream.
+ * \return      false if entry is too large, or no more data available
+ */
+bool
+DETokenizer::fill(ostream* os)
+{
+    const size_t size = nextEnt >= bend ? 0 : bend - nextEnt;
+    if (kMaxEntrySize <= size) {
+        return false;
+    }
+    if (os && prevStart < nextEnt) {
+        const size_t sz =
+            (nextEnt < bend ? nextEnt : bend) - prevStart;
+        if (sz > 0) {
+            os->write(prevStart, sz);
         }
-        memmove(buffer, nextEnt, size);
-        nextEnt = buffer;
-        prevStart = nextEnt;
-        if (! is.read(buffer + size, kMaxEntrySize - size)) {
-            bend = buffer + size;
-            if (! is.eof()) {
-                MarkEnd();
-                return false;
-            }
-            streamsize const cnt = is.gcount();
-            if (cnt <= 0) {
-                MarkEnd();
-                return false;
-            }
-            bend += cnt;
+    }
+    memmove(buffer, nextEnt, size);
+    nextEnt = buffer;
+    prevStart = nextEnt;
+    if (! is.read(buffer + size, kMaxEntrySize - size)) {
+        bend = buffer + size;
+        if (! is.eof()) {
             MarkEnd();
+            return false;
         }
+        streamsize const cnt = is.gcount();
+        if (cnt <= 0) {
+            MarkEnd();
+            return false;
+        }
+        bend += cnt;
+        MarkEnd();
     }
     return true;
 }
 
+inline static bool
+getVarint(const unsigned char*& p, const unsigned char* e, uint64_t& v)
+{
+    v = 0;
+    for (int shift = 0; p < e && shift < 64; shift += 7) {
+        const unsigned char c = *p++;
+        v |= (uint64_t)(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+ * \brief split binary entry into tokens
+ * \return      1 if entry was parsed, 0 if more data is needed, and -1 if
+ * entry is invalid
+ */
+int
+DETokenizer::nextBinary(Token* tend)
+{
+    const unsigned char*       p =
+        reinterpret_cast<const unsigned char*>(nextEnt) + 1;
+    const unsigned char* const e =
+        reinterpret_cast<const unsigned char*>(bend);
+    uint64_t len = 0;
+    if (! getVarint(p, e, len)) {
+        return (p < e ? -1 : 0);
+    }
+    if (kMaxEntrySize <= len) {
+        return -1;
+    }
+    if ((uint64_t)(e - p) < len) {
+        return 0;
+    }
+    const unsigned char* const re = p + len;
+    while (p < re) {
+        if (tend <= end) {
+            return -1;
+        }
+        const unsigned char type = *p++;
+        const unsigned char* const s = p;
+        uint64_t v = 0;
+        if (! getVarint(p, re, v)) {
+            return -1;
+        }
+        if (type == kBinaryNumber) {
+            end->ptr   = reinterpret_cast<const char*>(s);
+            end->len   = p - s;
+            end->num   = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+            end->isnum = true;
+        } else if (type == kBinaryString && v <= (uint64_t)(re - p)) {
+            end->ptr   = reinterpret_cast<const char*>(p);
+            end->len   = (size_t)v;
+            end->isnum = false;
+            p += v;
+        } else {
+            return -1;
+        }
+        ++end;
+    }
+    if (end == tokens) {
+        return -1;
+    }
+    nextEnt = const_cast<char*>(reinterpret_cast<const char*>(re));
+    return 1;
+}
+
+string
+DETokenizer::getBinaryEntry() const
+{
+    string ret;
+    for (const Token* t = tokens; t < end; ++t) {
+        if (t != tokens) {
+            ret += '/';
+        }
+        if (t->isnum) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%" PRId64, t->num);
+            ret += buf;
+        } else {
+            ret.append(t->ptr, t->len);
+        }
+    }
+    return ret;
+}
+
 const unsigned char* const DETokenizer::c2hex = char2HexTable();
 
 /*!
@@ -53,15 +53,21 @@ public:
     {
         Token()
             : ptr(0),
-              len(0)
+              len(0),
+              num(0),
+              isnum(false)
             {}
         Token(const char* p)
             : ptr(p),
-              len(strlen(p))
+              len(strlen(p)),
+              num(0),
+              isnum(false)
             {}
         Token(const char* p, size_t l)
             : ptr(p),
-              len(l)
+              len(l),
+              num(0),
+              isnum(false)
             {}
         bool operator==(const Token& other) const {
             return (len == other.len &&
@@ -98,7 +104,12 @@ public:
         }
         const char* ptr;
         size_t      len;
+        int64_t     num;   //!< value of binary encoded number
+        bool        isnum; //!< binary encoded number
     };
+    //!< binary entry marker, also binary encoding version
+    enum { kBinaryEntryMarker = 1 };
+    enum { kBinaryString = 's', kBinaryNumber = 'n' };
     DETokenizer(istream& in)
         : tokens(new Token[kMaxEntryTokens]),
           cur(tokens),
@@ -110,7 +121,8 @@ public:
           nextEnt(bend),
           prevStart(nextEnt),
           base(10),
-          lastOk(true)
+          lastOk(true),
+          binaryEntry(false)
         { MarkEnd(); }
     ~DETokenizer() {
         delete [] tokens;
@@ -135,6 +147,9 @@ public:
         return entryCount;
     }
     string getEntry() const {
+        if (binaryEntry && end != tokens) {
+            return getBinaryEntry();
+        }
         const char* const p = end == tokens ? nextEnt : tokens->ptr;
         const char* const e = strchr(p, '\n');
         return (e ? string(p, e - p) : string(p));
@@ -151,6 +166,10 @@ public:
     }
     int64_t toNumber() {
         assert(cur < end);
+        if (cur->isnum) {
+            lastOk = true;
+            return cur->num;
+        }
         if (cur->len <= 0) {
             return -1;
         }
@@ -185,8 +204,13 @@ private:
     const char* prevStart;
     int         base;
     bool        lastOk;
+    bool        binaryEntry;
     static const unsigned char* const c2hex;
 
+    bool fill(ostream* os);
+    int nextBinary(Token* tend);
+    string getBinaryEntry() const;
+
     void MarkEnd() {
         // sentinel for next()
         assert(bend <= buffer + kMaxEntrySize);
@@ -237,6 +261,86 @@ inline static ostream& operator<<(ostream& os, const DETokenizer::Token& token)
     return os.write(token.ptr, token.len);
 }
 
+/*!
+ * \brief binary checkpoint or log entry writer
+ *
+ * Binary entries carry the same token sequence as the text entries, but with
+ * no separators and with numbers in binary form, thus DETokenizer can split
+ * the entry and the parsers can retrieve numbers with no string to number
+ * conversion. Binary and text entries can be intermixed in the same file.
+ * The entry format is:
+ *
+ *  <marker> <varint body length> <body>
+ *
+ * where <marker> is kBinaryEntryMarker, and the body is a sequence of tokens,
+ * each token is either
+ *  's' <varint length> <bytes>
+ * or
+ *  'n' <zigzag varint number>
+ */
+class DEBinaryWriter
+{
+public:
+    DEBinaryWriter()
+        : buf()
+        {}
+    DEBinaryWriter& str(const char* p, size_t len) {
+        buf += (char)DETokenizer::kBinaryString;
+        putVarint(len);
+        buf.append(p, len);
+        return *this;
+    }
+    DEBinaryWriter& str(const char* p) {
+        return str(p, strlen(p));
+    }
+    DEBinaryWriter& str(const string& s) {
+        return str(s.data(), s.size());
+    }
+    DEBinaryWriter& num(int64_t n) {
+        buf += (char)DETokenizer::kBinaryNumber;
+        putVarint(((uint64_t)n << 1) ^ (uint64_t)(n >> 63));
+        return *this;
+    }
+    DEBinaryWriter& num(const char* tag, int64_t n) {
+        return str(tag).num(n);
+    }
+    //!< same as ShowTime: seconds and micro seconds
+    DEBinaryWriter& time(const char* tag, int64_t t) {
+        const int64_t kMicroseconds = 1000 * 1000;
+        return str(tag).num(t / kMicroseconds).num(t % kMicroseconds);
+    }
+    //!< write entry into the stream, and reset the writer
+    bool write(ostream& os) {
+        char   hdr[1 + 10];
+        char*  p = hdr;
+        *p++ = (char)DETokenizer::kBinaryEntryMarker;
+        for (uint64_t v = buf.size(); ; v >>= 7) {
+            if (v < 0x80) {
+                *p++ = (char)v;
+                break;
+            }
+            *p++ = (char)((v & 0x7F) | 0x80);
+        }
+        os.write(hdr, p - hdr);
+        os.write(buf.data(), buf.size());
+        buf.clear();
+        return ! os.fail();
+    }
+private:
+    string buf;
+
+    void putVarint(uint64_t v) {
+        while (0x80 <= v) {
+            buf += (char)((v & 0x7F) | 0x80);
+            v >>= 7;
+        }
+        buf += (char)v;
+    }
+private:
+    DEBinaryWriter(const DEBinaryWriter&);
+    DEBinaryWriter& operator=(const DEBinaryWriter&);
+};
+
 /*!
  * \brief a checkpoint or log entry read back from disk
  *
@@ -33,6 +33,8 @@ namespace KFS {
 
 typedef int64_t KeyData;    //!< "opaque" key data
 
+template<int NKEY> class KeyArrayT;
+
 /*!
  * \brief search key
  *
@@ -68,7 +70,15 @@ public:
 private:
     uint64_t hi;
     uint64_t lo;
+    static Key Make(uint64_t h, uint64_t l)
+    {
+        Key k;
+        k.hi = h;
+        k.lo = l;
+        return k;
+    }
     friend class PartialMatch;
+    template<int NKEY> friend class KeyArrayT;
 };
 
 class PartialMatch
@@ -98,6 +108,7 @@ public:
         { return ! (*this > test); }
     bool operator >= (const Key &test) const
         { return ! (*this < test); }
+    template<int NKEY> friend class KeyArrayT;
 };
 
 inline bool operator < (const Key &l, const PartialMatch &r) {
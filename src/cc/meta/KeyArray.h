@@ -0,0 +1,244 @@
+/*!
+ * $Id$
+ *
+ * \file KeyArray.h
+ * \brief Fixed size sorted key array for the meta tree nodes.
+ *
+ * Keys are stored as two separate arrays of the high and low 64 bit halves
+ * (structure of arrays) in order to make the key search a linear sequence of
+ * vector compares over contiguous memory. The lower bound search counts the
+ * keys less than the search key, which is equivalent to the binary search on
+ * the sorted array, and has no data dependent branches. Vector instructions
+ * are used when the compiler targets AVX2, SSE4.2, or AArch64 NEON.
+ *
+ * Copyright 2016 Quantcast Corporation. All rights reserved.
+ *
+ * This file is part of Kosmos File System (KFS).
+ *
+ * Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#if !defined(META_KEY_ARRAY_H)
+#define META_KEY_ARRAY_H
+
+#include "Key.h"
+
+#include <string.h>
+
+// Binary search narrows the range down to KFS_KEY_ARRAY_LINEAR_MAX keys, the
+// remaining keys are compared with the linear vector count. The linear scalar
+// count is slower than binary search, therefore with no vector instructions
+// the search is a binary search on the high and low key arrays.
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define KFS_KEY_ARRAY_AVX2
+#   define KFS_KEY_ARRAY_LINEAR_MAX 8
+#elif defined(__SSE4_2__)
+#   include <nmmintrin.h>
+#   define KFS_KEY_ARRAY_SSE42
+#   define KFS_KEY_ARRAY_LINEAR_MAX 4
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#   include <arm_neon.h>
+#   define KFS_KEY_ARRAY_NEON
+#   define KFS_KEY_ARRAY_LINEAR_MAX 4
+#else
+#   define KFS_KEY_ARRAY_LINEAR_MAX 0
+#endif
+
+namespace KFS {
+
+template<int NKEY>
+class KeyArrayT
+{
+public:
+    enum { kCapacity = NKEY };
+    //! Vector width, the arrays are padded to the multiple of this.
+    enum { kLanes = 4 };
+    //! Larger ranges are narrowed by binary search down to this size first.
+    enum { kLinearSearchMax = KFS_KEY_ARRAY_LINEAR_MAX };
+
+    KeyArrayT()
+    {
+        memset(hi, 0, sizeof(hi));
+        memset(lo, 0, sizeof(lo));
+    }
+    Key get(int i) const
+        { return Key::Make(hi[i], lo[i]); }
+    void set(int i, const Key& k)
+    {
+        hi[i] = k.hi;
+        lo[i] = k.lo;
+    }
+    //! memmove n keys starting at src to dst
+    void move(int dst, int src, int n)
+    {
+        if (n > 0) {
+            memmove(hi + dst, hi + src, n * sizeof(hi[0]));
+            memmove(lo + dst, lo + src, n * sizeof(lo[0]));
+        }
+    }
+    //! \return the position of the first key >= test in [0, count)
+    int lowerBound(const Key& test, int count) const
+        { return lowerBound(test.hi, test.lo, ~uint64_t(0), count); }
+    int lowerBound(const PartialMatch& test, int count) const
+    {
+        return lowerBound(test.key.hi, test.key.lo & PartialMatch::mask,
+            PartialMatch::mask, count);
+    }
+    //! Scalar linear count version, used by the tests and benchmarks.
+    int lowerBoundScalar(const Key& test, int count) const
+    {
+        return (int)countLessScalar(
+            test.hi, test.lo, ~uint64_t(0), 0, count);
+    }
+private:
+    enum { kSize = (NKEY + kLanes - 1) / kLanes * kLanes };
+
+    uint64_t hi[kSize];
+    uint64_t lo[kSize];
+
+    int lowerBound(uint64_t th, uint64_t tl, uint64_t mask, int count) const
+    {
+        // Narrow the range with binary search, if the node is large enough.
+        int start = 0;
+        int len   = count;
+        while (kLinearSearchMax < len) {
+            const int half = len / 2;
+            const int mid  = start + half;
+            if (less(mid, th, tl, mask)) {
+                start = mid + 1;
+                len  -= half + 1;
+            } else {
+                len = half;
+            }
+        }
+        return start + (int)countLess(th, tl, mask, start, start + len);
+    }
+    bool less(int i, uint64_t th, uint64_t tl, uint64_t mask) const
+        { return (hi[i] < th || (hi[i] == th && (lo[i] & mask) < tl)); }
+    unsigned int countLessScalar(uint64_t th, uint64_t tl, uint64_t mask,
+        int start, int end) const
+    {
+        unsigned int cnt = 0;
+        for (int i = start; i < end; i++) {
+            cnt += (unsigned int)(
+                (hi[i] < th) | ((hi[i] == th) & ((lo[i] & mask) < tl)));
+        }
+        return cnt;
+    }
+#if defined(KFS_KEY_ARRAY_AVX2)
+    unsigned int countLess(uint64_t th, uint64_t tl, uint64_t mask,
+        int start, int end) const
+    {
+        // No unsigned 64 bit compare: flip the sign bit and compare signed.
+        const __m256i sign =
+            _mm256_set1_epi64x((long long)(uint64_t(1) << 63));
+        const __m256i vm   = _mm256_set1_epi64x((long long)mask);
+        const __m256i vth  = _mm256_xor_si256(
+            _mm256_set1_epi64x((long long)th), sign);
+        const __m256i vtl  = _mm256_xor_si256(
+            _mm256_set1_epi64x((long long)tl), sign);
+        unsigned int cnt = 0;
+        int          i   = start & ~(kLanes - 1);
+        unsigned int skip = (unsigned int)(start - i);
+        for (; i < end; i += kLanes) {
+            const __m256i h = _mm256_xor_si256(_mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(hi + i)), sign);
+            const __m256i l = _mm256_xor_si256(_mm256_and_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo + i)),
+                vm), sign);
+            const __m256i lt = _mm256_or_si256(
+                _mm256_cmpgt_epi64(vth, h),
+                _mm256_and_si256(_mm256_cmpeq_epi64(vth, h),
+                    _mm256_cmpgt_epi64(vtl, l)));
+            unsigned int bits = (unsigned int)_mm256_movemask_pd(
+                _mm256_castsi256_pd(lt));
+            bits &= ~((1u << skip) - 1);
+            skip = 0;
+            if (end < i + kLanes) {
+                bits &= (1u << (end - i)) - 1;
+            }
+            cnt += (unsigned int)__builtin_popcount(bits);
+        }
+        return cnt;
+    }
+#elif defined(KFS_KEY_ARRAY_SSE42)
+    unsigned int countLess(uint64_t th, uint64_t tl, uint64_t mask,
+        int start, int end) const
+    {
+        const __m128i sign =
+            _mm_set1_epi64x((long long)(uint64_t(1) << 63));
+        const __m128i vm   = _mm_set1_epi64x((long long)mask);
+        const __m128i vth  =
+            _mm_xor_si128(_mm_set1_epi64x((long long)th), sign);
+        const __m128i vtl  =
+            _mm_xor_si128(_mm_set1_epi64x((long long)tl), sign);
+        unsigned int cnt  = 0;
+        int          i    = start & ~1;
+        unsigned int skip = (unsigned int)(start - i);
+        for (; i < end; i += 2) {
+            const __m128i h = _mm_xor_si128(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(hi + i)), sign);
+            const __m128i l = _mm_xor_si128(_mm_and_si128(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(lo + i)), vm), sign);
+            const __m128i lt = _mm_or_si128(
+                _mm_cmpgt_epi64(vth, h),
+                _mm_and_si128(_mm_cmpeq_epi64(vth, h),
+                    _mm_cmpgt_epi64(vtl, l)));
+            unsigned int bits = (unsigned int)_mm_movemask_pd(
+                _mm_castsi128_pd(lt));
+            bits &= ~((1u << skip) - 1);
+            skip = 0;
+            if (end < i + 2) {
+                bits &= 1u;
+            }
+            cnt += (bits & 1u) + (bits >> 1);
+        }
+        return cnt;
+    }
+#elif defined(KFS_KEY_ARRAY_NEON)
+    unsigned int countLess(uint64_t th, uint64_t tl, uint64_t mask,
+        int start, int end) const
+    {
+        const uint64x2_t vm  = vdupq_n_u64(mask);
+        const uint64x2_t vth = vdupq_n_u64(th);
+        const uint64x2_t vtl = vdupq_n_u64(tl);
+        unsigned int cnt  = 0;
+        int          i    = start & ~1;
+        unsigned int skip = (unsigned int)(start - i);
+        for (; i < end; i += 2) {
+            const uint64x2_t h  = vld1q_u64(hi + i);
+            const uint64x2_t l  = vandq_u64(vld1q_u64(lo + i), vm);
+            const uint64x2_t lt = vorrq_u64(vcltq_u64(h, vth),
+                vandq_u64(vceqq_u64(h, vth), vcltq_u64(l, vtl)));
+            unsigned int bits =
+                (unsigned int)(vgetq_lane_u64(lt, 0) & 1) |
+                ((unsigned int)(vgetq_lane_u64(lt, 1) & 1) << 1);
+            bits &= ~((1u << skip) - 1);
+            skip = 0;
+            if (end < i + 2) {
+                bits &= 1u;
+            }
+            cnt += (bits & 1u) + (bits >> 1);
+        }
+        return cnt;
+    }
+#else
+    unsigned int countLess(uint64_t th, uint64_t tl, uint64_t mask,
+        int start, int end) const
+        { return countLessScalar(th, tl, mask, start, end); }
+#endif
+};
+
+}
+
+#endif  // !defined(META_KEY_ARRAY_H)
@@ -55,6 +55,13 @@
 #include <boost/mem_fn.hpp>
 #include <boost/bind.hpp>
 
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <math.h>
+
 namespace KFS {
 
 using std::for_each;
@@ -68,6 +75,7 @@ using std::max;
 using std::istringstream;
 using std::ostream;
 using std::ostringstream;
+using std::stringstream;
 using std::make_pair;
 using std::pair;
 using std::make_heap;
@@ -79,6 +87,7 @@ using std::ofstream;
 using std::ifstream;
 using std::numeric_limits;
 using std::iter_swap;
+using std::stable_partition;
 using std::setw;
 using std::setfill;
 using std::hex;
@@ -1313,7 +1322,13 @@ LayoutManager::AddHosted(CSMap::Entry& entry, const ChunkServerPtr& c)
     if (c->IsEvacuationScheduled(entry.GetChunkId())) {
         CheckReplication(entry);
     }
-    return mChunkToServerMap.AddServer(c, entry);
+    if (! mChunkToServerMap.AddServer(c, entry)) {
+        return false;
+    }
+    if (! mChunkHealth.empty()) {
+        UpdateChunkHealth(entry);
+    }
+    return true;
 }
 
 inline bool
@@ -1347,12 +1362,32 @@ LayoutManager::SetReplicationState(CSMap::Entry& entry,
     mChunkToServerMap.SetState(entry, state);
 }
 
+inline size_t
+LayoutManager::GetReplicationCheckCount() const
+{
+    return (
+        mChunkToServerMap.GetCount(CSMap::Entry::kStateCheckReplication) +
+        mChunkToServerMap.GetCount(
+            CSMap::Entry::kStateCheckReplicationUrgent)
+    );
+}
+
 inline void
 LayoutManager::CheckReplication(CSMap::Entry& entry)
 {
     SetReplicationState(entry, CSMap::Entry::kStateCheckReplication);
 }
 
+inline int
+LayoutManager::GetHotChunkExtraReplicas(chunkId_t chunkId) const
+{
+    if (mHotChunks.empty()) {
+        return 0;
+    }
+    HotChunks::const_iterator const it = mHotChunks.find(chunkId);
+    return (it == mHotChunks.end() ? 0 : it->second.mExtraReplicas);
+}
+
 inline seq_t
 LayoutManager::GetChunkVersionRollBack(chunkId_t chunkId)
 {
@@ -1397,6 +1432,10 @@ LayoutManager::IncrementChunkVersionRollBack(chunkId_t chunkId)
 int64_t
 LayoutManager::Rand(int64_t interval)
 {
+    ReadOnlyRequestContext* const ctx = ReadOnlyRequestContext::GetCurrent();
+    if (ctx) {
+        return ctx->Rand(interval);
+    }
     return (int64_t)(mRandom.Rand() % interval);
 }
 
@@ -1427,6 +1466,8 @@ LayoutManager::LayoutManager() :
     mIsRebalancingEnabled(true),
     mMaxRebalanceSpaceUtilThreshold(0.85),
     mMinRebalanceSpaceUtilThreshold(0.75),
+    mRebalanceLoadAvgWeight(0),
+    mRebalanceWritesPerDriveWeight(0),
     mIsExecutingRebalancePlan(false),
     mRecoveryStartTime(0),
     mStartTime(time(0)),
@@ -1436,6 +1477,8 @@ LayoutManager::LayoutManager() :
     mLeaseCleaner(ChunkLeases::kLeaseTimerResolutionSec * 1000),
     mChunkReplicator(5 * 1000),
     mCheckpoint(5 * 1000),
+    mTrashEmptier(60 * 1000),
+    mTierMigrator(60 * 1000),
     mMinChunkserversToExitRecovery(1),
     mChunkServers(),
     mMastersCount(0),
@@ -1450,6 +1493,8 @@ LayoutManager::LayoutManager() :
     mMaxAppendersPerChunk(4 << 10),
     mReservationOvercommitFactor(1.0),
     mServerDownReplicationDelay(2 * 60),
+    mChunkServerInventoryResumeFlag(true),
+    mInstanceId(0),
     mMaxDownServersHistorySize(4 << 10),
     mChunkServersProps(),
     mCSToRestartCount(0),
@@ -1463,8 +1508,35 @@ LayoutManager::LayoutManager() :
     mLastReplicationCheckTime(numeric_limits<int64_t>::min()), // check all
     mLastRecomputeDirsizeTime(TimeNow()),
     mRecomputeDirSizesIntervalSec(60 * 60 * 24 * 3650),
+    mDumpsterCleanupMaxEntries(16 << 10),
+    mTierMigrationIntervalSec(0),
+    mTierMigrationHotMinSTier(kKfsSTierUndef),
+    mTierMigrationHotMaxSTier(kKfsSTierUndef),
+    mTierMigrationColdMinSTier(kKfsSTierUndef),
+    mTierMigrationColdMaxSTier(kKfsSTierUndef),
+    mTierMigrationHeatHalfLifeSec(3600),
+    mTierMigrationPromoteHeat(64),
+    mTierMigrationDemoteHeat(1),
+    mTierMigrationMaxBytesPerHour(int64_t(256) << 30),
+    mTierMigrationMaxTrackedFiles(1 << 20),
+    mTierMigrationMaxScan(16 << 10),
+    mTierMigrationEnabledFlag(false),
+    mTierMigrationBytesCredit(0),
+    mTierMigrationCreditTime(0),
+    mTierMigrationHeatCursor(0),
+    mTierMigrationChunkCursor(-1),
+    mFileHeat(),
+    mNamespaceHealthFlag(true),
+    mNamespaceHealthMaxPingDirs(256),
+    mChunkHealth(),
+    mFileHealth(),
+    mDirHealth(),
+    mHealthTotal(),
     mMaxConcurrentWriteReplicationsPerNode(5),
     mMaxConcurrentReadReplicationsPerNode(10),
+    mMaxConcurrentEvacuationReadsPerDrive(0),
+    mMaxConcurrentEvacuationWritesPerDrive(0),
+    mMaxEvacuationReadBytesPerSecPerNode(0),
     mUseEvacuationRecoveryFlag(true),
     mReplicationFindWorkTimeouts(0),
     // Replication check 30ms/.20-30ms = 120 -- 20% cpu when idle
@@ -1485,6 +1557,8 @@ LayoutManager::LayoutManager() :
         microseconds() - mCompleteReplicationCheckInterval),
     mPastEofRecoveryDelay(int64_t(60) * 6 * 60 * kSecs2MicroSecs),
     mMaxServerCleanupScan(2 << 10),
+    mMaxHelloChunksPerLoop(16 << 10),
+    mPendingHellos(),
     mMaxRebalanceScan(1024),
     mRebalanceReplicationsThreshold(0.5),
     mRebalanceReplicationsThresholdCount(0),
@@ -1522,6 +1596,8 @@ LayoutManager::LayoutManager() :
     mFsckAbandonedFileTimeout(int64_t(1000) * kSecs2MicroSecs),
     mMaxFsckTime(int64_t(19) * 60 * kSecs2MicroSecs),
     mFullFsckFlag(true),
+    mFsckWorkersCount(1),
+    mFsckPartitionDepth(1),
     mMTimeUpdateResolution(kSecs2MicroSecs),
     mMaxPendingRecoveryMsgLogInfo(1 << 10),
     mAllowLocalPlacementFlag(true),
@@ -1555,10 +1631,23 @@ LayoutManager::LayoutManager() :
     mMaxReplicasPerFile(MAX_REPLICAS_PER_FILE),
     mMaxReplicasPerRSFile(MAX_REPLICAS_PER_FILE),
     mGetAllocOrderServersByLoadFlag(true),
+    mReadPreferMemoryTierFlag(true),
+    mReadAvoidSlowChunkDirsFlag(true),
+    mReadPreferClientLocalityFlag(true),
+    mHotChunks(),
+    mHotChunksExtraReplicasCount(0),
+    mHotChunkMinReadRate(32),
+    mHotChunkMaxExtraReplicas(256),
+    mHotChunkMaxExtraReplicasPerChunk(3),
+    mHotChunkExpireSec(10 * 60),
+    mHotChunkIncreaseIntervalSec(2 * 60),
+    mHotChunksExpireCheckTime(0),
+    mMaxSlowChunkDirsRatio(0.5),
     mMinChunkAllocClientProtoVersion(-1),
     mMaxResponseSize(256 << 20),
     mMinIoBufferBytesToProcessRequest(mMaxResponseSize + (10 << 20)),
     mReadDirLimit(8 << 10),
+    mReadDirPlusMaxPageSize(4 << 20),
     mAllowChunkServerRetireFlag(false),
     mPanicOnInvalidChunkFlag(false),
     mAppendCacheCleanupInterval(-1),
@@ -1614,6 +1703,9 @@ LayoutManager::LayoutManager() :
     mObjStoreMaxDeletesPerServer(128),
     mObjStoreDeleteDelay(2 * LEASE_INTERVAL_SECS),
     mObjStoreDeleteSrvIdx(0),
+    mObjStoreDeleteStartedCount(0),
+    mObjStoreDeleteDoneCount(0),
+    mObjStoreDeleteErrorCount(0),
     mObjStoreFilesDeleteQueue(),
     mObjBlocksDeleteRequeue(),
     mObjBlocksDeleteInFlight(),
@@ -1629,6 +1721,9 @@ LayoutManager::LayoutManager() :
     mRandom()
 {
     globals();
+    // Chunk servers use instance id to detect meta server restart.
+    mInstanceId = (int64_t)(((uint64_t)mRandom.Rand() ^
+        (uint64_t)microseconds()) >> 1) | 1;
     mReplicationTodoStats    = new Counter("Num Replications Todo");
     mOngoingReplicationStats = new Counter("Num Ongoing Replications");
     mTotalReplicationStats   = new Counter("Total Num Replications");
@@ -1642,6 +1737,24 @@ LayoutManager::LayoutManager() :
     globals().counterManager.AddCounter(mTotalReplicationStats);
     globals().counterManager.AddCounter(mFailedReplicationStats);
     globals().counterManager.AddCounter(mStaleChunkCount);
+    const char* const healthChunkCounterNames[kHealthCount] = {
+        "Chunks lost",
+        "Chunks endangered",
+        "Chunks under replicated",
+        "Chunks missing recovery"
+    };
+    const char* const healthFileCounterNames[kHealthCount] = {
+        "Files lost",
+        "Files endangered",
+        "Files under replicated",
+        "Files missing recovery"
+    };
+    for (int i = 0; i < kHealthCount; i++) {
+        mHealthChunkCounters[i] = new Counter(healthChunkCounterNames[i]);
+        mHealthFileCounters[i]  = new Counter(healthFileCounterNames[i]);
+        globals().counterManager.AddCounter(mHealthChunkCounters[i]);
+        globals().counterManager.AddCounter(mHealthFileCounters[i]);
+    }
     for (size_t i = 0; i < kKfsSTierCount; i++) {
         mTierSpaceUtilizationThreshold[i]   = 2.;
         mTiersMaxWritesPerDriveThreshold[i] = mMinWritesPerDrive;
@@ -1657,6 +1770,12 @@ LayoutManager::~LayoutManager()
     globals().counterManager.RemoveCounter(mTotalReplicationStats);
     globals().counterManager.RemoveCounter(mFailedReplicationStats);
     globals().counterManager.RemoveCounter(mStaleChunkCount);
+    for (int i = 0; i < kHealthCount; i++) {
+        globals().counterManager.RemoveCounter(mHealthChunkCounters[i]);
+        globals().counterManager.RemoveCounter(mHealthFileCounters[i]);
+        delete mHealthChunkCounters[i];
+        delete mHealthFileCounters[i];
+    }
     delete mReplicationTodoStats;
     delete mOngoingReplicationStats;
     delete mTotalReplicationStats;
@@ -1750,6 +1869,15 @@ LayoutManager::SetParameters(const Properties& props, int clientPort)
     mMaxConcurrentWriteReplicationsPerNode = props.getValue(
         "metaServer.maxConcurrentWriteReplicationsPerNode",
         mMaxConcurrentWriteReplicationsPerNode);
+    mMaxConcurrentEvacuationReadsPerDrive = max(0, props.getValue(
+        "metaServer.maxConcurrentEvacuationReadsPerDrive",
+        mMaxConcurrentEvacuationReadsPerDrive));
+    mMaxConcurrentEvacuationWritesPerDrive = max(0, props.getValue(
+        "metaServer.maxConcurrentEvacuationWritesPerDrive",
+        mMaxConcurrentEvacuationWritesPerDrive));
+    mMaxEvacuationReadBytesPerSecPerNode = props.getValue(
+        "metaServer.maxEvacuationReadBytesPerSecPerNode",
+        mMaxEvacuationReadBytesPerSecPerNode);
     mUseEvacuationRecoveryFlag = props.getValue(
         "metaServer.useEvacuationRecoveryFlag",
         mUseEvacuationRecoveryFlag ? 1 : 0) != 0;
@@ -1783,6 +1911,9 @@ LayoutManager::SetParameters(const Properties& props, int clientPort)
     mMaxServerCleanupScan = max(0, props.getValue(
         "metaServer.maxServerCleanupScan",
         (int)mMaxServerCleanupScan));
+    mMaxHelloChunksPerLoop = max(0, props.getValue(
+        "metaServer.maxHelloChunksPerLoop",
+        (int)mMaxHelloChunksPerLoop));
 
     mMaxRebalanceScan = max(0, props.getValue(
         "metaServer.maxRebalanceScan",
@@ -1805,6 +1936,12 @@ LayoutManager::SetParameters(const Properties& props, int clientPort)
     mMinRebalanceSpaceUtilThreshold = props.getValue(
         "metaServer.minRebalanceSpaceUtilThreshold",
         mMinRebalanceSpaceUtilThreshold);
+    mRebalanceLoadAvgWeight = max(0., props.getValue(
+        "metaServer.rebalanceLoadAvgWeight",
+        mRebalanceLoadAvgWeight));
+    mRebalanceWritesPerDriveWeight = max(0., props.getValue(
+        "metaServer.rebalanceWritesPerDriveWeight",
+        mRebalanceWritesPerDriveWeight));
     mMaxRebalancePlanRead = props.getValue(
         "metaServer.maxRebalancePlanRead",
         mMaxRebalancePlanRead);
@@ -1848,6 +1985,10 @@ LayoutManager::SetParameters(const Properties& props, int clientPort)
     mChunkReplicator.SetTimeoutInterval((int)(props.getValue(
         "metaServer.replicationCheckInterval",
         mChunkReplicator.GetTimeoutInterval() * 1e-3) * 1e3));
+    mTrashEmptier.GetOp().SetParameters(props);
+    mTrashEmptier.SetTimeoutInterval((int)(props.getValue(
+        "metaServer.trash.runInterval",
+        mTrashEmptier.GetTimeoutInterval() * 1e-3) * 1e3));
 
     mCheckpoint.GetOp().SetParameters(props);
 
@@ -1870,6 +2011,9 @@ LayoutManager::SetParameters(const Properties& props, int clientPort)
     mMaxDownServersHistorySize = props.getValue(
         "metaServer.maxDownServersHistorySize",
          mMaxDownServersHistorySize);
+    mChunkServerInventoryResumeFlag = props.getValue(
+        "metaServer.chunkServerInventoryResume",
+        mChunkServerInventoryResumeFlag ? 1 : 0) != 0;
 
     mMaxCSRestarting = props.getValue(
         "metaServer.maxCSRestarting",
@@ -1890,6 +2034,67 @@ LayoutManager::SetParameters(const Properties& props, int clientPort)
     mRecomputeDirSizesIntervalSec = max(0, props.getValue(
         "metaServer.recomputeDirSizesIntervalSec",
         mRecomputeDirSizesIntervalSec));
+    mDumpsterCleanupMaxEntries = max(0, props.getValue(
+        "metaServer.dumpsterCleanupMaxEntries",
+        mDumpsterCleanupMaxEntries));
+    mTierMigrationIntervalSec = max(0, props.getValue(
+        "metaServer.tierMigration.interval",
+        mTierMigrationIntervalSec));
+    mTierMigrationHotMinSTier = (kfsSTier_t)props.getValue(
+        "metaServer.tierMigration.hotMinTier",
+        (int)mTierMigrationHotMinSTier);
+    mTierMigrationHotMaxSTier = (kfsSTier_t)props.getValue(
+        "metaServer.tierMigration.hotMaxTier",
+        (int)mTierMigrationHotMaxSTier);
+    mTierMigrationColdMinSTier = (kfsSTier_t)props.getValue(
+        "metaServer.tierMigration.coldMinTier",
+        (int)mTierMigrationColdMinSTier);
+    mTierMigrationColdMaxSTier = (kfsSTier_t)props.getValue(
+        "metaServer.tierMigration.coldMaxTier",
+        (int)mTierMigrationColdMaxSTier);
+    mTierMigrationHeatHalfLifeSec = max(1., props.getValue(
+        "metaServer.tierMigration.heatHalfLife",
+        mTierMigrationHeatHalfLifeSec));
+    mTierMigrationPromoteHeat = props.getValue(
+        "metaServer.tierMigration.promoteHeat",
+        mTierMigrationPromoteHeat);
+    mTierMigrationDemoteHeat = props.getValue(
+        "metaServer.tierMigration.demoteHeat",
+        mTierMigrationDemoteHeat);
+    mTierMigrationMaxBytesPerHour = max(int64_t(0), props.getValue(
+        "metaServer.tierMigration.maxBytesPerHour",
+        mTierMigrationMaxBytesPerHour));
+    mTierMigrationMaxTrackedFiles = (size_t)max(int64_t(0), props.getValue(
+        "metaServer.tierMigration.maxTrackedFiles",
+        (int64_t)mTierMigrationMaxTrackedFiles));
+    mTierMigrationMaxScan = max(1, props.getValue(
+        "metaServer.tierMigration.maxScan",
+        mTierMigrationMaxScan));
+    mTierMigrationEnabledFlag =
+        0 < mTierMigrationIntervalSec &&
+        kKfsSTierMin <= mTierMigrationHotMinSTier &&
+        mTierMigrationHotMinSTier <= mTierMigrationHotMaxSTier &&
+        mTierMigrationHotMaxSTier <= kKfsSTierMax &&
+        kKfsSTierMin <= mTierMigrationColdMinSTier &&
+        mTierMigrationColdMinSTier <= mTierMigrationColdMaxSTier &&
+        mTierMigrationColdMaxSTier <= kKfsSTierMax &&
+        (mTierMigrationHotMinSTier != mTierMigrationColdMinSTier ||
+            mTierMigrationHotMaxSTier != mTierMigrationColdMaxSTier) &&
+        mTierMigrationDemoteHeat < mTierMigrationPromoteHeat;
+    if (mTierMigrationEnabledFlag) {
+        mTierMigrator.SetTimeoutInterval(mTierMigrationIntervalSec * 1000);
+    } else {
+        mFileHeat.clear();
+    }
+    mNamespaceHealthFlag = props.getValue(
+        "metaServer.namespaceHealth.enabled",
+        mNamespaceHealthFlag ? 1 : 0) != 0;
+    mNamespaceHealthMaxPingDirs = max(0, props.getValue(
+        "metaServer.namespaceHealth.maxPingDirs",
+        mNamespaceHealthMaxPingDirs));
+    if (! mNamespaceHealthFlag) {
+        ClearNamespaceHealth();
+    }
 
     mDelayedRecoveryUpdateMaxScanCount = props.getValue(
         "metaServer.delayedRecoveryUpdateMaxScanCount",
@@ -1917,6 +2122,12 @@ LayoutManager::SetParameters(const Properties& props, int clientPort)
     mFullFsckFlag = props.getValue(
         "metaServer.fullFsck",
         mFullFsckFlag ? 1 : 0) != 0;
+    mFsckWorkersCount = max(1, min(256, props.getValue(
+        "metaServer.fsckWorkers",
+        mFsckWorkersCount)));
+    mFsckPartitionDepth = props.getValue(
+        "metaServer.fsckPartitionDepth",
+        mFsckPartitionDepth);
 
     mMTimeUpdateResolution = (int64_t)(props.getValue(
         "metaServer.MTimeUpdateResolution",
@@ -1947,6 +2158,33 @@ LayoutManager::SetParameters(const Properties& props, int clientPort)
     mGetAllocOrderServersByLoadFlag = props.getValue(
         "metaServer.getAllocOrderServersByLoad",
         mGetAllocOrderServersByLoadFlag ? 1 : 0) != 0;
+    mReadPreferMemoryTierFlag = props.getValue(
+        "metaServer.readPreferMemoryTier",
+        mReadPreferMemoryTierFlag ? 1 : 0) != 0;
+    mReadAvoidSlowChunkDirsFlag = props.getValue(
+        "metaServer.readAvoidSlowChunkDirs",
+        mReadAvoidSlowChunkDirsFlag ? 1 : 0) != 0;
+    mReadPreferClientLocalityFlag = props.getValue(
+        "metaServer.readPreferClientLocality",
+        mReadPreferClientLocalityFlag ? 1 : 0) != 0;
+    mHotChunkMinReadRate = max(1, props.getValue(
+        "metaServer.hotChunks.minReadRate",
+        mHotChunkMinReadRate));
+    mHotChunkMaxExtraReplicas = props.getValue(
+        "metaServer.hotChunks.maxExtraReplicas",
+        mHotChunkMaxExtraReplicas);
+    mHotChunkMaxExtraReplicasPerChunk = props.getValue(
+        "metaServer.hotChunks.maxExtraReplicasPerChunk",
+        mHotChunkMaxExtraReplicasPerChunk);
+    mHotChunkExpireSec = max(1, props.getValue(
+        "metaServer.hotChunks.expireSec",
+        mHotChunkExpireSec));
+    mHotChunkIncreaseIntervalSec = max(0, props.getValue(
+        "metaServer.hotChunks.increaseIntervalSec",
+        mHotChunkIncreaseIntervalSec));
+    mMaxSlowChunkDirsRatio = props.getValue(
+        "metaServer.maxSlowChunkDirsRatio",
+        mMaxSlowChunkDirsRatio);
     mMinChunkAllocClientProtoVersion = props.getValue(
         "metaServer.minChunkAllocClientProtoVersion",
         mMinChunkAllocClientProtoVersion);
@@ -2065,6 +2303,8 @@ LayoutManager::SetParameters(const Properties& props, int clientPort)
     KFS_LOG_EOM;
     mReadDirLimit = props.getValue(
         "metaServer.readDirLimit", mReadDirLimit);
+    mReadDirPlusMaxPageSize = props.getValue(
+        "metaServer.readDirPlusMaxPageSize", mReadDirPlusMaxPageSize);
 
     ClientSM::SetParameters(props);
     gNetDispatch.SetParameters(props);
@@ -2900,6 +3140,11 @@ LayoutManager::AddNewServer(MetaHello *r)
     if (r->server->IsDown()) {
         return;
     }
+    if (0 < r->chunksPos) {
+        // Resume adding stable chunks, the server is already added.
+        AddHelloChunks(r);
+        return;
+    }
     ChunkServer&          srv   = *r->server.get();
     const ServerLocation& srvId = srv.GetServerLocation();
     if (srvId != r->location || ! srvId.IsValid()) {
@@ -2932,10 +3177,50 @@ LayoutManager::AddNewServer(MetaHello *r)
         }
     }
 
+    // Resume: the chunk server sends only the count and checksum of its stable
+    // chunks inventory. If the server is hibernated, and the inventory
+    // matches, re-attach the hibernated chunks, instead of adding all of them.
+    HibernatingServerInfo_t* const hs = 0 != r->resumeInstanceId ?
+        FindHibernatingServer(srvId) : 0;
+    if (0 != r->resumeInstanceId) {
+        size_t   count    = 0;
+        uint64_t checksum = 0;
+        if (r->resumeInstanceId != GetInventoryResumeInstanceId() ||
+                ! hs || ! hs->IsHibernated() ||
+                ! mChunkToServerMap.GetHibernatedInventory(
+                    hs->csmapIdx, count, checksum) ||
+                r->resumeNumChunks != (int64_t)count ||
+                r->resumeChecksum != checksum) {
+            KFS_LOG_STREAM_INFO << srvId <<
+                " chunk inventory resume failed:"
+                " instance: "   << r->resumeInstanceId <<
+                " chunks: "     << r->resumeNumChunks <<
+                " / "           << count <<
+                " checksum: "   << r->resumeChecksum <<
+                " / "           << checksum <<
+                " hibernated: " << (hs ? hs->IsHibernated() : false) <<
+            KFS_LOG_EOM;
+            // The chunk server will re-connect with full inventory.
+            srv.ForceDown();
+            return;
+        }
+    }
     // Add server first, then add chunks, otherwise if/when the server goes
     // down in the process of adding chunks, taking out server from chunk
     // info will not work in ServerDown().
-    if ( ! mChunkToServerMap.AddServer(r->server)) {
+    if (hs) {
+        if (! mChunkToServerMap.RestoreHibernated(r->server, hs->csmapIdx)) {
+            panic("failed to restore hibernated server");
+            srv.ForceDown();
+            return;
+        }
+        KFS_LOG_STREAM_INFO << srvId <<
+            " resumed with hibernated chunk inventory:"
+            " chunks: " << srv.GetChunkCount() <<
+        KFS_LOG_EOM;
+        mHibernatingServers.erase(mHibernatingServers.begin() +
+            (hs - &mHibernatingServers.front()));
+    } else if ( ! mChunkToServerMap.AddServer(r->server)) {
         KFS_LOG_STREAM_WARN <<
             "failed to add server: " << srvId <<
             " no slots available "
@@ -2946,8 +3231,10 @@ LayoutManager::AddNewServer(MetaHello *r)
         return;
     }
     mChunkServers.insert(existing, r->server);
+    r->instanceId = GetInventoryResumeInstanceId();
 
-    const uint64_t allocSpace = r->chunks.size() * CHUNKSIZE;
+    const uint64_t allocSpace =
+        (r->chunks.size() + srv.GetChunkCount()) * CHUNKSIZE;
     srv.SetSpace(r->totalSpace, r->usedSpace, allocSpace);
     RackId rackId;
     if (mUseCSRackAssignmentFlag && 0 <= r->rackId) {
@@ -3017,10 +3304,26 @@ LayoutManager::AddNewServer(MetaHello *r)
     if (! mChunkServersProps.empty() && ! srv.IsDown()) {
         srv.SetProperties(mChunkServersProps);
     }
-    int maxLogInfoCnt = 32;
+    AddHelloChunks(r);
+}
+
+void
+LayoutManager::AddHelloChunks(MetaHello* r)
+{
+    ChunkServer&          srv   = *r->server.get();
+    const ServerLocation& srvId = srv.GetServerLocation();
+    // Add stable chunks in slices of at most mMaxHelloChunksPerLoop in order
+    // to allow the other requests to be processed in between, in the case
+    // when many chunk servers with large chunk inventories connect at the
+    // same time.
+    const size_t endPos = 0 < mMaxHelloChunksPerLoop ?
+        min(r->chunks.size(), r->chunksPos + mMaxHelloChunksPerLoop) :
+        r->chunks.size();
     ChunkIdQueue staleChunkIds;
-    for (MetaHello::ChunkInfos::const_iterator it = r->chunks.begin();
-            it != r->chunks.end() && ! srv.IsDown();
+    for (MetaHello::ChunkInfos::const_iterator
+                it = r->chunks.begin() + r->chunksPos,
+                end = r->chunks.begin() + endPos;
+            it != end && ! srv.IsDown();
             ++it) {
         const chunkId_t     chunkId      = it->chunkId;
         const char*         staleReason  = 0;
@@ -3091,8 +3394,7 @@ LayoutManager::AddNewServer(MetaHello *r)
             staleReason = "no chunk mapping exists";
         }
         if (staleReason) {
-            maxLogInfoCnt--;
-            KFS_LOG_STREAM((maxLogInfoCnt > 0) ?
+            KFS_LOG_STREAM((++r->staleChunkCount < 32) ?
                     MsgLogger::kLogLevelINFO :
                     MsgLogger::kLogLevelDEBUG) <<
                 srvId <<
@@ -3106,6 +3408,18 @@ LayoutManager::AddNewServer(MetaHello *r)
             mStaleChunkCount->Update(1);
         }
     }
+    r->chunksPos = endPos;
+    if (r->chunksPos < r->chunks.size() && ! srv.IsDown()) {
+        if (! staleChunkIds.IsEmpty()) {
+            srv.NotifyStaleChunks(staleChunkIds);
+        }
+        if (! srv.IsDown()) {
+            r->suspended = true;
+            mPendingHellos.push_back(r);
+            ScheduleCleanup();
+            return;
+        }
+    }
 
     for (int i = 0; i < 2; i++) {
         const MetaHello::ChunkInfos& chunks = i == 0 ?
@@ -3136,11 +3450,11 @@ LayoutManager::AddNewServer(MetaHello *r)
             if (staleReason) {
                 staleChunkIds.PushBack(it->chunkId);
                 mStaleChunkCount->Update(1);
+                r->staleChunkCount++;
             }
             // MakeChunkStableDone will process pending recovery.
         }
     }
-    const size_t staleCnt = staleChunkIds.GetSize();
     if (! staleChunkIds.IsEmpty() && ! srv.IsDown()) {
         srv.NotifyStaleChunks(staleChunkIds);
     }
@@ -3183,14 +3497,14 @@ LayoutManager::AddNewServer(MetaHello *r)
         msg << " chunk server: " << r->peerName << "/" <<
             srv.GetServerLocation() <<
         (srv.CanBeChunkMaster() ? " master" : " slave") <<
-        " rack: "            << r->rackId << " => " << rackId <<
+        " rack: "            << r->rackId << " => " << srv.GetRack() <<
         " chunks: stable: "  << r->chunks.size() <<
         " not stable: "      << r->notStableChunks.size() <<
         " append: "          << r->notStableAppendChunks.size() <<
         " +wid: "            << r->numAppendsWithWid <<
         " writes: "          << srv.GetNumChunkWrites() <<
         " +wid: "            << srv.GetNumAppendsWithWid() <<
-        " stale: "           << staleCnt <<
+        " stale: "           << r->staleChunkCount <<
         " masters: "         << mMastersCount <<
         " slaves: "          << mSlavesCount <<
         " total: "           << mChunkServers.size() <<
@@ -3881,7 +4195,9 @@ public:
           mMaxReplication(0),
           mObjectStoreFileCount(0),
           mObjectStoreBlockCount(0),
-          mMaxObjectStoreBlockCount(0)
+          mMaxObjectStoreBlockCount(0),
+          mPartitionDepth(0),
+          mPartitionHeadFlag(true)
     {
         mPath.reserve(8 << 10);
         for (int i = 0, k = 0; i < kStateCount; i++) {
@@ -3905,11 +4221,19 @@ public:
             assert(depth == mDepth + 1);
             mDepth = depth;
         }
+        // Entries above the partition depth are visited by all partitions,
+        // only the first partition accounts for them.
+        const bool skipFlag = mDepth < mPartitionDepth && ! mPartitionHeadFlag;
         if (fa.type == KFS_DIR) {
             mPath.resize(mDepth);
             mPath.push_back(&de);
-            mMaxDirDepth = max(mMaxDirDepth, mDepth);
-            mDirCount++;
+            if (! skipFlag) {
+                mMaxDirDepth = max(mMaxDirDepth, mDepth);
+                mDirCount++;
+            }
+            return true;
+        }
+        if (skipFlag) {
             return true;
         }
         const chunkOff_t fsize = metatree.getFileSize(fa);
@@ -3954,7 +4278,7 @@ public:
         " " << fa.striperType <<
         " " << fa.numStripes <<
         " " << fa.numRecoveryStripes <<
-        " " << fa.stripeSize <<
+        " " << fa.stripeSize() <<
         " " << (0 == fa.numReplicas ?
             (int64_t)(fa.nextChunkOffset() / (chunkOff_t)CHUNKSIZE) :
             fa.chunkcount()) <<
@@ -3985,6 +4309,109 @@ public:
         mStopFlag   = true;
     }
     const string& GetStopReason() const { return mStopReason; }
+    void SetPartition(size_t depth, bool headFlag)
+    {
+        mPartitionDepth    = depth;
+        mPartitionHeadFlag = headFlag;
+    }
+    void Save(ostream& os) const
+    {
+        os << (mStopFlag ? 1 : 0);
+        for (int i = 0; i < kStateCount; i++) {
+            os << " " << mFileCounts[i];
+        }
+        os <<
+        " " << mDirCount <<
+        " " << mFileCount <<
+        " " << mMaxDirDepth <<
+        " " << mOverReplicatedCount <<
+        " " << mUnderReplicatedCount <<
+        " " << mChunkLostCount <<
+        " " << mNoRackCount <<
+        " " << mRecoveryBlock <<
+        " " << mPartialRecoveryBlock <<
+        " " << mReplicaCount <<
+        " " << mMaxReplicaCount <<
+        " " << mToReportFileCount <<
+        " " << mMaxChunkCount <<
+        " " << mTotalChunkCount <<
+        " " << mMaxFileSize <<
+        " " << mTotalFilesSize <<
+        " " << mStripedFilesCount <<
+        " " << mFilesWithRecoveryCount <<
+        " " << mMaxReplication <<
+        " " << mObjectStoreFileCount <<
+        " " << mObjectStoreBlockCount <<
+        " " << mMaxObjectStoreBlockCount <<
+        "\n" << mStopReason << "\n";
+    }
+    bool Merge(istream& is)
+    {
+        FilesChecker in(mLayoutManager, 0, 0);
+        int          stopFlag = 0;
+        is >> stopFlag;
+        for (int i = 0; i < kStateCount; i++) {
+            is >> in.mFileCounts[i];
+        }
+        is >>
+            in.mDirCount >>
+            in.mFileCount >>
+            in.mMaxDirDepth >>
+            in.mOverReplicatedCount >>
+            in.mUnderReplicatedCount >>
+            in.mChunkLostCount >>
+            in.mNoRackCount >>
+            in.mRecoveryBlock >>
+            in.mPartialRecoveryBlock >>
+            in.mReplicaCount >>
+            in.mMaxReplicaCount >>
+            in.mToReportFileCount >>
+            in.mMaxChunkCount >>
+            in.mTotalChunkCount >>
+            in.mMaxFileSize >>
+            in.mTotalFilesSize >>
+            in.mStripedFilesCount >>
+            in.mFilesWithRecoveryCount >>
+            in.mMaxReplication >>
+            in.mObjectStoreFileCount >>
+            in.mObjectStoreBlockCount >>
+            in.mMaxObjectStoreBlockCount;
+        if (! is || is.get() != '\n') {
+            return false;
+        }
+        getline(is, in.mStopReason);
+        if (stopFlag != 0 && ! mStopFlag) {
+            Stop(in.mStopReason);
+        }
+        for (int i = 0; i < kStateCount; i++) {
+            mFileCounts[i] += in.mFileCounts[i];
+        }
+        mDirCount                 += in.mDirCount;
+        mFileCount                += in.mFileCount;
+        mMaxDirDepth               = max(mMaxDirDepth, in.mMaxDirDepth);
+        mOverReplicatedCount      += in.mOverReplicatedCount;
+        mUnderReplicatedCount     += in.mUnderReplicatedCount;
+        mChunkLostCount           += in.mChunkLostCount;
+        mNoRackCount              += in.mNoRackCount;
+        mRecoveryBlock            += in.mRecoveryBlock;
+        mPartialRecoveryBlock     += in.mPartialRecoveryBlock;
+        mReplicaCount             += in.mReplicaCount;
+        mMaxReplicaCount           = max(mMaxReplicaCount,
+            in.mMaxReplicaCount);
+        mToReportFileCount        += in.mToReportFileCount;
+        mMaxChunkCount             = max(mMaxChunkCount, in.mMaxChunkCount);
+        mTotalChunkCount          += in.mTotalChunkCount;
+        mMaxFileSize               = max(mMaxFileSize, in.mMaxFileSize);
+        mTotalFilesSize           += in.mTotalFilesSize;
+        mStripedFilesCount        += in.mStripedFilesCount;
+        mFilesWithRecoveryCount   += in.mFilesWithRecoveryCount;
+        mMaxReplication            = max(mMaxReplication, in.mMaxReplication);
+        mObjectStoreFileCount     += in.mObjectStoreFileCount;
+        mObjectStoreBlockCount    += in.mObjectStoreBlockCount;
+        mMaxObjectStoreBlockCount  = max(mMaxObjectStoreBlockCount,
+            in.mMaxObjectStoreBlockCount);
+        return true;
+    }
     void Report(size_t chunkCount)
     {
         if (! mOs[kStateNone]) {
@@ -4126,6 +4553,8 @@ private:
     size_t         mObjectStoreFileCount;
     int64_t        mObjectStoreBlockCount;
     int64_t        mMaxObjectStoreBlockCount;
+    size_t         mPartitionDepth;
+    bool           mPartitionHeadFlag;
 
     ostream& DisplayPath(ostream& os) const
     {
@@ -4300,13 +4729,134 @@ LayoutManager::Fsck(ostream** os, bool reportAbandonedFilesFlag)
 {
     if (mFullFsckFlag) {
         FilesChecker fsck(*this, mMaxFsckFiles, os);
-        metatree.iterateDentries(fsck);
+        if (mFsckWorkersCount <= 1 || ! ParallelFsck(fsck, os)) {
+            metatree.iterateDentries(fsck);
+        }
         fsck.Report(mChunkToServerMap.Size());
     } else if (os && os[0]) {
         Fsck(*(os[0]), reportAbandonedFilesFlag);
     }
 }
 
+static bool
+CopyFsckFile(FILE* file, ostream& os)
+{
+    if (fflush(file) || fseek(file, 0, SEEK_SET)) {
+        return false;
+    }
+    char buf[64 << 10];
+    size_t nrd;
+    while ((nrd = fread(buf, 1, sizeof(buf), file)) > 0) {
+        os.write(buf, nrd);
+    }
+    return (! ferror(file) && os);
+}
+
+bool
+LayoutManager::RunFsckWorker(
+    int idx, int workersCount, int streamsCount, FILE** files)
+{
+    // The worker runs in forked copy of the fsck process, the alarm is not
+    // inherited by fork, and has to be set again.
+    alarm((unsigned int)(mMaxFsckTime / kSecs2MicroSecs + 1));
+    ostringstream* const streams = new ostringstream[streamsCount];
+    ostream**      const ptr     = new ostream*[streamsCount + 1];
+    for (int i = 0; i < streamsCount; i++) {
+        ptr[i] = streams + i;
+    }
+    ptr[streamsCount] = 0;
+    bool okFlag;
+    {
+        FilesChecker fsck(*this,
+            max(int64_t(1), mMaxFsckFiles / workersCount), ptr);
+        fsck.SetPartition(mFsckPartitionDepth, idx == 0);
+        metatree.iterateDentries(
+            fsck, (size_t)idx, (size_t)workersCount, mFsckPartitionDepth);
+        // The first stream is used to pass the counters to the parent.
+        streams[0].str(string());
+        fsck.Save(streams[0]);
+        okFlag = true;
+        for (int i = 0; okFlag && i < streamsCount; i++) {
+            const string str = streams[i].str();
+            okFlag = fwrite(str.data(), 1, str.size(), files[i]) ==
+                    str.size() && fflush(files[i]) == 0;
+        }
+    }
+    delete [] ptr;
+    delete [] streams;
+    return okFlag;
+}
+
+bool
+LayoutManager::ParallelFsck(FilesChecker& fsck, ostream** os)
+{
+    int streamsCount = 0;
+    while (os && os[streamsCount]) {
+        streamsCount++;
+    }
+    if (streamsCount <= 0) {
+        return false;
+    }
+    // Each worker gets its own set of temporary files, one per output
+    // stream. The workers iterate over disjoint sets of the directory sub
+    // trees at the partition depth, the parent merges the workers counters
+    // and appends their per state output to the corresponding streams.
+    const int     workersCount = mFsckWorkersCount;
+    vector<FILE*> files(workersCount * streamsCount, (FILE*)0);
+    vector<pid_t> pids;
+    pids.reserve(workersCount);
+    bool okFlag = true;
+    for (size_t i = 0; okFlag && i < files.size(); i++) {
+        okFlag = (files[i] = tmpfile()) != 0;
+    }
+    while (okFlag && (int)pids.size() < workersCount) {
+        const int   idx = (int)pids.size();
+        const pid_t pid = fork();
+        if (pid == 0) {
+            _exit(RunFsckWorker(idx, workersCount, streamsCount,
+                &files[idx * streamsCount]) ? 0 : 3);
+        }
+        if (pid < 0) {
+            okFlag = false;
+        } else {
+            pids.push_back(pid);
+        }
+    }
+    if (! okFlag) {
+        for (size_t i = 0; i < pids.size(); i++) {
+            kill(pids[i], SIGKILL);
+        }
+    }
+    for (int i = 0; i < (int)pids.size(); i++) {
+        int   status = 0;
+        pid_t ret;
+        while ((ret = waitpid(pids[i], &status, 0)) < 0 && errno == EINTR)
+            {}
+        if (! okFlag) {
+            continue;
+        }
+        FILE** const wf = &files[i * streamsCount];
+        stringstream ss;
+        if (ret != pids[i] || ! WIFEXITED(status) ||
+                WEXITSTATUS(status) != 0 ||
+                ! CopyFsckFile(wf[0], ss) || ! fsck.Merge(ss)) {
+            ostringstream msg;
+            msg << "fsck worker " << i << " failed";
+            fsck.Stop(msg.str());
+            continue;
+        }
+        for (int k = 1; k < streamsCount; k++) {
+            CopyFsckFile(wf[k], *(os[k]));
+        }
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+        if (files[i]) {
+            fclose(files[i]);
+        }
+    }
+    return okFlag;
+}
+
 void
 LayoutManager::DumpChunkToServerMap(ostream& os)
 {
@@ -4611,7 +5161,9 @@ LayoutManager::IsCandidateServer(
             c.GetNotStableOpenCount(tier) < c.GetDeviceCount(tier) *
                 mTiersMaxWritesPerDriveThreshold[tier] *
                 writableChunksThresholdRatio
-        )
+        ) &&
+        (mMaxSlowChunkDirsRatio <= 0 || c.GetSlowChunkDirCount() <=
+            c.GetNumDrives() * mMaxSlowChunkDirsRatio)
     );
 }
 
@@ -4639,8 +5191,9 @@ LayoutManager::UpdateSrvLoadAvg(ChunkServer& srv, int64_t delta,
         srv.IsResponsiveServer() &&
         ! srv.IsRetiring() &&
         ! srv.IsRestartScheduled();
-    int candidateTiersCount = 0;
-    int racksCandidatesDelta[kKfsSTierCount];
+    int  candidateTiersCount = 0;
+    bool tierCandidateChangedFlag = false;
+    int  racksCandidatesDelta[kKfsSTierCount];
     for (size_t i = 0; i < kKfsSTierCount; i++) {
         const bool flag = isPossibleCandidate &&
             srv.GetDeviceCount(i) > 0 &&
@@ -4683,19 +5236,20 @@ LayoutManager::UpdateSrvLoadAvg(ChunkServer& srv, int64_t delta,
             KFS_LOG_EOM;
         }
         racksCandidatesDelta[i] = flag ? 1 : -1;
+        tierCandidateChangedFlag = true;
     }
     if (isPossibleCandidate && candidateTiersCount <= 0) {
         isPossibleCandidate = false;
     }
     const int inc = wasPossibleCandidate == isPossibleCandidate ? 0 :
         (isPossibleCandidate ? 1 : -1);
-    if (inc == 0 && ! tiersDelta) {
+    if (inc == 0 && ! tiersDelta && ! tierCandidateChangedFlag) {
         return;
     }
     RackInfos::iterator const rackIter = FindRack(srv.GetRack());
     if (rackIter != mRacks.end()) {
         rackIter->updatePossibleCandidatesCount(
-            inc, tiersDelta, racksCandidatesDelta);
+            srv.shared_from_this(), inc, tiersDelta, racksCandidatesDelta);
     }
     if (inc == 0) {
         return;
@@ -4737,6 +5291,89 @@ LayoutManager::UpdateObjectsCount(
         mCSWritableObjectCount <= mCSOpenObjectCount);
 }
 
+void
+LayoutManager::UpdateHotChunk(chunkId_t chunkId, int readRate)
+{
+    if (mHotChunkMaxExtraReplicas <= 0 ||
+            mHotChunkMaxExtraReplicasPerChunk <= 0 ||
+            readRate <= 0 || InRecovery()) {
+        return;
+    }
+    // Any report of the already hot chunk extends its life time, in order
+    // to keep the extra replicas while the read rate of each replica stays
+    // above the chunk server report threshold, which is expected to be
+    // lower than the min. read rate.
+    HotChunks::iterator it = mHotChunks.find(chunkId);
+    if (it == mHotChunks.end() && readRate < mHotChunkMinReadRate) {
+        return;
+    }
+    CSMap::Entry* const ci = mChunkToServerMap.Find(chunkId);
+    if (! ci || ci->GetFattr()->numReplicas <= 0) {
+        return;
+    }
+    const time_t now = TimeNow();
+    if (it == mHotChunks.end()) {
+        it = mHotChunks.insert(make_pair(chunkId, HotChunk())).first;
+    }
+    HotChunk& hot = it->second;
+    hot.mReadRate       = readRate;
+    hot.mLastReportTime = now;
+    const int numReplicas = ci->GetFattr()->numReplicas;
+    const int maxExtra    = min(mHotChunkMaxExtraReplicasPerChunk,
+        min((int)mChunkServers.size(), (int)mMaxReplicasPerFile) -
+        numReplicas);
+    if (readRate < mHotChunkMinReadRate ||
+            maxExtra <= hot.mExtraReplicas ||
+            mHotChunkMaxExtraReplicas <= mHotChunksExtraReplicasCount ||
+            now < hot.mLastIncreaseTime + mHotChunkIncreaseIntervalSec ||
+            // Wait for the previously added replicas to be created.
+            mChunkToServerMap.ServerCount(*ci) <
+                (size_t)(numReplicas + hot.mExtraReplicas)) {
+        return;
+    }
+    hot.mExtraReplicas++;
+    hot.mLastIncreaseTime = now;
+    mHotChunksExtraReplicasCount++;
+    KFS_LOG_STREAM_INFO <<
+        "hot chunk: <" << ci->GetFileId() << "," << chunkId << ">"
+        " read rate: "      << readRate <<
+        " replication: "    << numReplicas <<
+        " extra replicas: " << hot.mExtraReplicas <<
+        " total: "          << mHotChunksExtraReplicasCount <<
+    KFS_LOG_EOM;
+    CheckReplication(*ci);
+}
+
+void
+LayoutManager::ExpireHotChunks(time_t now)
+{
+    mHotChunksExpireCheckTime = now;
+    const time_t expireTime   = now - mHotChunkExpireSec;
+    const bool   expireAllFlag =
+        mHotChunkMaxExtraReplicas <= 0 || InRecovery();
+    for (HotChunks::iterator it = mHotChunks.begin();
+            it != mHotChunks.end(); ) {
+        if (! expireAllFlag && expireTime < it->second.mLastReportTime) {
+            ++it;
+            continue;
+        }
+        const int extra = it->second.mExtraReplicas;
+        mHotChunksExtraReplicasCount -= extra;
+        CSMap::Entry* const ci = mChunkToServerMap.Find(it->first);
+        mHotChunks.erase(it++);
+        if (ci && 0 < extra) {
+            KFS_LOG_STREAM_INFO <<
+                "hot chunk: <" << ci->GetFileId() << "," <<
+                    ci->GetChunkId() << ">"
+                " expired, extra replicas: " << extra <<
+            KFS_LOG_EOM;
+            // The replication check deletes the extra replicas.
+            CheckReplication(*ci);
+        }
+    }
+    assert(0 <= mHotChunksExtraReplicasCount);
+}
+
 void
 LayoutManager::UpdateChunkWritesPerDrive(
     ChunkServer&                          srv,
@@ -5450,7 +6087,7 @@ LayoutManager::GetChunkWriteLease(MetaAllocate* r, bool& isNewLease)
         r->statusMsg = "replication is in progress";
         return -EBUSY;
     }
-    const CSMap::Entry* const ci = mChunkToServerMap.Find(r->chunkId);
+    CSMap::Entry* const ci = mChunkToServerMap.Find(r->chunkId);
     if (! ci) {
         r->statusMsg = "no such chunk";
         return -EINVAL;
@@ -5556,6 +6193,9 @@ LayoutManager::GetChunkWriteLease(MetaAllocate* r, bool& isNewLease)
     }
     isNewLease = true;
     assert(r->chunkVersion == r->initialChunkVersion);
+    // Hibernated replicas do not participate in the version change, and
+    // become stale.
+    mChunkToServerMap.RemoveHibernatedServers(*ci);
     // When issuing a new lease, increment the version, skipping over
     // the failed version increment attemtps.
     r->chunkVersion += IncrementChunkVersionRollBack(r->chunkId);
@@ -6096,6 +6736,9 @@ LayoutManager::GetChunkReadLease(MetaLeaseAcquire* req)
                 ! cs->GetFattr()->CanWrite(req->euser, req->egroup)))) {
         return -EACCES;
     }
+    if (cs && ! req->fromChunkServerFlag && ! req->appendRecoveryFlag) {
+        UpdateFileHeat(cs->GetFileId());
+    }
     if (req->appendRecoveryFlag) {
         if (! mClientCSAuthRequiredFlag || req->authUid == kKfsUserNone) {
             return 0;
@@ -6627,6 +7270,7 @@ LayoutManager::DeleteChunk(CSMap::Entry& entry)
     StTmp<Servers>  serversTmp(mServers3Tmp);
     Servers&        servers = serversTmp.Get();
     mChunkToServerMap.GetServers(entry, servers);
+    RemoveChunkHealth(chunkId);
     // remove the mapping
     mChunkToServerMap.Erase(chunkId);
     DeleteChunk(fid, chunkId, servers);
@@ -6771,9 +7415,29 @@ LayoutManager::GetChunkFileId(chunkId_t chunkId, fid_t& fileId,
     return true;
 }
 
+class ClientLocalityPredicate
+{
+public:
+    ClientLocalityPredicate(const string& host, LayoutManager::RackId rack)
+        : mHost(host),
+          mRack(rack)
+        {}
+    bool operator()(const ChunkServerPtr& c) const
+    {
+        return (mRack < 0 ?
+            c->GetServerLocation().hostname == mHost :
+            c->GetRack() == mRack
+        );
+    }
+private:
+    const string&               mHost;
+    const LayoutManager::RackId mRack;
+};
+
 int
 LayoutManager::GetChunkToServerMapping(MetaChunkInfo& chunkInfo,
-    LayoutManager::Servers& c, MetaFattr*& fa, bool* orderReplicasFlag /* = 0 */)
+    LayoutManager::Servers& c, MetaFattr*& fa,
+    bool* orderReplicasFlag /* = 0 */, const string* clientHost /* = 0 */)
 {
     const CSMap::Entry& entry = GetCsEntry(chunkInfo);
     fa = entry.GetFattr();
@@ -6782,32 +7446,79 @@ LayoutManager::GetChunkToServerMapping(MetaChunkInfo& chunkInfo,
     if (cnt <= 0) {
         return -1;
     }
-    if (cnt <= 1 || ! orderReplicasFlag ||
-            ! mGetAllocOrderServersByLoadFlag) {
+    if (cnt <= 1 || ! orderReplicasFlag) {
         return 0;
     }
-    // Random shuffle hosting servers, such that the servers with
-    // smaller load go before the servers with larger load.
-    int64_t       loadAvgSum    = 0;
-    const int64_t kLoadAvgFloor = 1;
-    for (Servers::const_iterator it = c.begin();
-            it != c.end();
-            ++it) {
-        loadAvgSum += (*it)->GetLoadAvg() + kLoadAvgFloor;
-    }
-    *orderReplicasFlag = true;
-    for (size_t i = c.size(); i >= 2; ) {
-        assert(loadAvgSum > 0);
-        int64_t rnd = Rand(loadAvgSum);
-        size_t  ri  = i--;
-        int64_t load;
-        do {
-            --ri;
-            load = c[ri]->GetLoadAvg() + kLoadAvgFloor;
-            rnd -= load;
-        } while (rnd >= 0 && ri > 0);
-        iter_swap(c.begin() + i, c.begin() + ri);
-        loadAvgSum -= load;
+    if (mGetAllocOrderServersByLoadFlag) {
+        // Random shuffle hosting servers, such that the servers with
+        // smaller load go before the servers with larger load.
+        int64_t       loadAvgSum    = 0;
+        const int64_t kLoadAvgFloor = 1;
+        for (Servers::const_iterator it = c.begin();
+                it != c.end();
+                ++it) {
+            loadAvgSum += (*it)->GetLoadAvg() + kLoadAvgFloor;
+        }
+        *orderReplicasFlag = true;
+        for (size_t i = c.size(); i >= 2; ) {
+            assert(loadAvgSum > 0);
+            int64_t rnd = Rand(loadAvgSum);
+            size_t  ri  = i--;
+            int64_t load;
+            do {
+                --ri;
+                load = c[ri]->GetLoadAvg() + kLoadAvgFloor;
+                rnd -= load;
+            } while (rnd >= 0 && ri > 0);
+            iter_swap(c.begin() + i, c.begin() + ri);
+            loadAvgSum -= load;
+        }
+    } else if (! mHotChunks.empty() &&
+            mHotChunks.find(entry.GetChunkId()) != mHotChunks.end()) {
+        // Random shuffle hot chunk replicas, in order to spread reads
+        // across all replicas, including the temporary extra replicas.
+        *orderReplicasFlag = true;
+        for (size_t i = c.size(); i >= 2; ) {
+            const size_t ri = (size_t)Rand((int64_t)i--);
+            iter_swap(c.begin() + i, c.begin() + ri);
+        }
+    }
+    if (mReadPreferMemoryTierFlag && fa) {
+        // Move the servers with the file tier range memory backed chunk
+        // directories to the front, preserving the relative order. The meta
+        // server does not track replica tiers, therefore the memory tier is
+        // a server capability hint.
+        const kfsSTier_t minTier = fa->minSTier;
+        const kfsSTier_t maxTier = fa->maxSTier;
+        Servers::iterator const it = stable_partition(c.begin(), c.end(),
+            bind(&ChunkServer::HasMemoryStorageTier, _1, minTier, maxTier));
+        if (it != c.begin() && it != c.end()) {
+            *orderReplicasFlag = true;
+        }
+    }
+    if (mReadPreferClientLocalityFlag && clientHost && ! clientHost->empty()) {
+        // Move the servers in the client rack to the front, then the servers
+        // on the client host in front of these, preserving the relative load
+        // order within each group.
+        const RackId rack = GetRackId(*clientHost);
+        for (int pass = rack < 0 ? 1 : 0; pass < 2; pass++) {
+            Servers::iterator const it = stable_partition(c.begin(), c.end(),
+                ClientLocalityPredicate(*clientHost,
+                    pass == 0 ? rack : RackId(-1)));
+            if (it != c.begin() && it != c.end()) {
+                *orderReplicasFlag = true;
+            }
+        }
+    }
+    if (mReadAvoidSlowChunkDirsFlag) {
+        // Move the servers with slow chunk directories to the back. The
+        // chunk servers report slow directories, but not the chunks that
+        // these directories host, therefore all chunks are de-prioritized.
+        Servers::iterator const it = stable_partition(c.begin(), c.end(),
+            bind(&ChunkServer::HasNoSlowChunkDirs, _1));
+        if (it != c.begin() && it != c.end()) {
+            *orderReplicasFlag = true;
+        }
     }
     return 0;
 }
@@ -6907,6 +7618,192 @@ ShowTiersInfo(
     }
 }
 
+int
+LayoutManager::GetChunkHealth(const CSMap::Entry& entry) const
+{
+    const MetaFattr* const fa = entry.GetFattr();
+    if (! fa || fa->numReplicas <= 0) {
+        return -1;
+    }
+    const size_t cnt = mChunkToServerMap.ServerCount(entry);
+    if (cnt <= 0) {
+        // Recovery stripe or data chunk of the file with recovery can
+        // be recovered, as long as enough chunks in the block are present.
+        return (fa->HasRecovery() ? kHealthRecoveryMissing : kHealthLost);
+    }
+    if (cnt == 1 && 1 < fa->numReplicas && ! fa->HasRecovery()) {
+        return kHealthEndangered;
+    }
+    if (cnt < (size_t)fa->numReplicas) {
+        return kHealthUnderReplicated;
+    }
+    return -1;
+}
+
+fid_t
+LayoutManager::GetTopLevelDir(const MetaFattr& fa)
+{
+    const MetaFattr* cur = &fa;
+    while (cur->parent && cur->parent->id() != ROOTFID) {
+        cur = cur->parent;
+    }
+    if (! cur->parent) {
+        return (cur->id() == ROOTFID ? ROOTFID : fid_t(-1));
+    }
+    return (cur->type == KFS_DIR ? cur->id() : ROOTFID);
+}
+
+void
+LayoutManager::UpdateChunkHealth(const CSMap::Entry& entry)
+{
+    const int health = mNamespaceHealthFlag ? GetChunkHealth(entry) : -1;
+    const chunkId_t chunkId = entry.GetChunkId();
+    ChunkHealthMap::iterator const it = mChunkHealth.find(chunkId);
+    if (it == mChunkHealth.end()) {
+        if (health < 0) {
+            return;
+        }
+        const MetaFattr& fa = *entry.GetFattr();
+        ChunkHealth ch;
+        ch.mFid    = fa.id();
+        ch.mTopDir = GetTopLevelDir(fa);
+        ch.mHealth = health;
+        ch.mTier   = fa.minSTier;
+        UpdateHealthCounts(
+            mChunkHealth.insert(make_pair(chunkId, ch)).first->second, 1);
+        return;
+    }
+    if (it->second.mHealth == health) {
+        return;
+    }
+    UpdateHealthCounts(it->second, -1);
+    if (health < 0) {
+        mChunkHealth.erase(it);
+    } else {
+        it->second.mHealth = health;
+        UpdateHealthCounts(it->second, 1);
+    }
+}
+
+void
+LayoutManager::RemoveChunkHealth(chunkId_t chunkId)
+{
+    ChunkHealthMap::iterator const it = mChunkHealth.find(chunkId);
+    if (it == mChunkHealth.end()) {
+        return;
+    }
+    UpdateHealthCounts(it->second, -1);
+    mChunkHealth.erase(it);
+}
+
+void
+LayoutManager::UpdateHealthCounts(const ChunkHealth& health, int inc)
+{
+    const int h = health.mHealth;
+    mHealthTotal.mChunks[h] += inc;
+    mHealthByTier[health.mTier].mChunks[h] += inc;
+    mHealthChunkCounters[h]->Set(mHealthTotal.mChunks[h]);
+    DirHealthMap::iterator dit = mDirHealth.insert(
+        make_pair(health.mTopDir, HealthCounts())).first;
+    dit->second.mChunks[h] += inc;
+    FileHealthMap::iterator fit = mFileHealth.find(health.mFid);
+    if (fit == mFileHealth.end()) {
+        if (inc < 0) {
+            panic("invalid file health entry");
+            return;
+        }
+        FileHealth fh;
+        fh.mTopDir = health.mTopDir;
+        fh.mTier   = health.mTier;
+        fit = mFileHealth.insert(make_pair(health.mFid, fh)).first;
+    }
+    FileHealth& fh = fit->second;
+    const int64_t cnt = fh.mCounts[h] += inc;
+    if ((0 < inc && cnt == 1) || (inc < 0 && cnt == 0)) {
+        const int finc = 0 < inc ? 1 : -1;
+        mHealthTotal.mFiles[h] += finc;
+        mHealthByTier[fh.mTier].mFiles[h] += finc;
+        mHealthFileCounters[h]->Set(mHealthTotal.mFiles[h]);
+        if (fh.mTopDir != health.mTopDir) {
+            if (dit->second.IsEmpty()) {
+                mDirHealth.erase(dit);
+            }
+            dit = mDirHealth.insert(
+                make_pair(fh.mTopDir, HealthCounts())).first;
+        }
+        dit->second.mFiles[h] += finc;
+    }
+    if (dit->second.IsEmpty()) {
+        mDirHealth.erase(dit);
+    }
+    if (inc < 0) {
+        int i = 0;
+        while (i < kHealthCount && fh.mCounts[i] == 0) {
+            i++;
+        }
+        if (kHealthCount <= i) {
+            mFileHealth.erase(fit);
+        }
+    }
+}
+
+void
+LayoutManager::ClearNamespaceHealth()
+{
+    mChunkHealth.clear();
+    mFileHealth.clear();
+    mDirHealth.clear();
+    mHealthTotal = HealthCounts();
+    for (size_t i = 0; i < kKfsSTierCount; i++) {
+        mHealthByTier[i] = HealthCounts();
+    }
+    for (int i = 0; i < kHealthCount; i++) {
+        mHealthChunkCounters[i]->Set(0);
+        mHealthFileCounters[i]->Set(0);
+    }
+}
+
+static void
+ShowHealthCounts(ostream& os,
+    const int64_t* chunks, const int64_t* files, int count)
+{
+    for (int i = 0; i < count; i++) {
+        os << "\t" << chunks[i];
+    }
+    for (int i = 0; i < count; i++) {
+        os << "\t" << files[i];
+    }
+}
+
+void
+LayoutManager::ShowNamespaceHealth(ostream& os)
+{
+    if (! mNamespaceHealthFlag) {
+        return;
+    }
+    os << "\tall";
+    ShowHealthCounts(os,
+        mHealthTotal.mChunks, mHealthTotal.mFiles, kHealthCount);
+    for (size_t i = 0; i < kKfsSTierCount; i++) {
+        const HealthCounts& hc = mHealthByTier[i];
+        if (hc.IsEmpty()) {
+            continue;
+        }
+        os << "\ttier:" << i;
+        ShowHealthCounts(os, hc.mChunks, hc.mFiles, kHealthCount);
+    }
+    int cnt = 0;
+    for (DirHealthMap::const_iterator it = mDirHealth.begin();
+            it != mDirHealth.end() && cnt < mNamespaceHealthMaxPingDirs;
+            ++it, cnt++) {
+        const MetaFattr* const fa = 0 <= it->first ?
+            metatree.getFattr(it->first) : 0;
+        os << "\tdir:" << (fa ? metatree.getPathname(fa) : string("?"));
+        ShowHealthCounts(os,
+            it->second.mChunks, it->second.mFiles, kHealthCount);
+    }
+}
+
 void
 LayoutManager::Ping(IOBuffer& buf, bool wormModeFlag)
 {
@@ -6970,11 +7867,49 @@ LayoutManager::Ping(IOBuffer& buf, bool wormModeFlag)
             ++it) {
         ShowTiersInfo(mWOstream, &*it, it->getStorageTiersInfo(), 0);
     }
+    mWOstream <<
+        "\r\n"
+        "Namespace health info names: "
+        "key"
+        "\tchunks-lost\tchunks-endangered"
+        "\tchunks-under-replicated\tchunks-missing-recovery"
+        "\tfiles-lost\tfiles-endangered"
+        "\tfiles-under-replicated\tfiles-missing-recovery"
+        "\r\n"
+        "Namespace health info: "
+    ;
+    ShowNamespaceHealth(mWOstream);
     mWOstream << "\r\n\r\n"; // End of headers.
     mWOstream.flush();
     // Initial headers.
     mWOstream.Set(mPingResponse);
     mPingUpdateTime = TimeNow();
+    MetaRequest::AllocatorStats reqAllocStats;
+    MetaRequest::GetAllocatorStats(reqAllocStats);
+    // Name space only bytes per file or directory, without chunk info.
+    const size_t fattrCount =
+        MetaNode::getPoolAllocator<MetaFattr>().GetInUseCount();
+    const size_t nsBytesPerFile = fattrCount <= 0 ? size_t(0) : (
+        MetaNode::getPoolAllocator<Node>().GetStorageSize() +
+        MetaNode::getPoolAllocator<MetaDentry>().GetStorageSize() +
+        MetaNode::getPoolAllocator<MetaFattr>().GetStorageSize() +
+        DentryNames::getStorageSize()
+    ) / fattrCount;
+    const size_t csmapStorage =
+        mChunkToServerMap.GetAllocator().GetStorageSize() +
+        CSMap::Entry::GetAllocByteCount();
+    const size_t chunkCount   = mChunkToServerMap.Size();
+    const size_t bytesPerChunk =
+        chunkCount <= 0 ? size_t(0) : csmapStorage / chunkCount;
+    const size_t leasesStorage = mChunkLeases.GetStorageSizeEstimate();
+    const size_t metaStorage   =
+        MetaNode::getPoolAllocator<Node>().GetStorageSize() +
+        MetaNode::getPoolAllocator<MetaDentry>().GetStorageSize() +
+        MetaNode::getPoolAllocator<MetaFattr>().GetStorageSize() +
+        DentryNames::getStorageSize() +
+        csmapStorage +
+        leasesStorage +
+        reqAllocStats.mStorageSize;
     mWOstream <<
         "Build-version: "       << KFS_BUILD_VERSION_STRING << "\r\n"
         "Source-version: "      << KFS_SOURCE_REVISION_STRING << "\r\n"
@@ -6984,8 +7919,9 @@ LayoutManager::Ping(IOBuffer& buf, bool wormModeFlag)
         "Total space= "         << pinger.totalSpace << "\t"
         "Used space= "          << pinger.usedSpace << "\t"
         "Replications= "        << mNumOngoingReplications << "\t"
-        "Replications check= "  << mChunkToServerMap.GetCount(
-            CSMap::Entry::kStateCheckReplication) << "\t"
+        "Replications check= "  << GetReplicationCheckCount() << "\t"
+        "Urgent replications check= " << mChunkToServerMap.GetCount(
+            CSMap::Entry::kStateCheckReplicationUrgent) << "\t"
         "Pending recovery= "    << mChunkToServerMap.GetCount(
             CSMap::Entry::kStatePendingRecovery) << "\t"
         "Repl check timeouts= " << mReplicationCheckTimeouts << "\t"
@@ -6995,8 +7931,14 @@ LayoutManager::Ping(IOBuffer& buf, bool wormModeFlag)
         "Buffers= "             <<
             (mBufferPool ? mBufferPool->GetUsedBufferCount() : 0) << "\t"
         "Clients= "             << ClientSM::GetClientCount() << "\t"
+        "Idle clients= "        << ClientSM::GetIdleClientCount() << "\t"
+        "Hot chunks= "          << mHotChunks.size() << "\t"
+        "Hot chunk extra replicas= " << mHotChunksExtraReplicasCount << "\t"
         "Chunk srvs= "          << ChunkServer::GetChunkServerCount() << "\t"
         "Requests= "            << MetaRequest::GetRequestCount() << "\t"
+        "Request pool storage= " << reqAllocStats.mStorageSize << "\t"
+        "Request pool outstanding= " <<
+            reqAllocStats.mOutstandingCount << "\t"
         "Sockets= "             << globals().ctrOpenNetFds.GetValue() << "\t"
         "Chunks= "              << mChunkToServerMap.Size() << "\t"
         "Pending replication= " << mChunkToServerMap.GetCount(
@@ -7019,6 +7961,9 @@ LayoutManager::Ping(IOBuffer& buf, bool wormModeFlag)
             MetaNode::getPoolAllocator<MetaFattr>().GetItemSize() << "\t"
         "Fattr nodes storage= "  <<
             MetaNode::getPoolAllocator<MetaFattr>().GetStorageSize() << "\t"
+        "Dentry names= "         << DentryNames::getCount() << "\t"
+        "Dentry names storage= " << DentryNames::getStorageSize() << "\t"
+        "Name space bytes per file= " << nsBytesPerFile << "\t"
         "ChunkInfo nodes= "      <<
             CSMap::Entry::GetAllocBlockCount() << "\t"
         "ChunkInfo node size= "  <<
@@ -7035,6 +7980,13 @@ LayoutManager::Ping(IOBuffer& buf, bool wormModeFlag)
             CSMap::Entry::GetAllocBlockCount() << "\t"
         "CSmap entry bytes= "  <<
             CSMap::Entry::GetAllocByteCount() << "\t"
+        "Bytes per chunk= " << bytesPerChunk << "\t"
+        "Read lease table size= " <<
+            mChunkLeases.GetReadLeasesTableSize() << "\t"
+        "Write lease table size= " <<
+            mChunkLeases.GetWriteLeasesTableSize() << "\t"
+        "Lease tables storage= " << leasesStorage << "\t"
+        "Meta data storage= " << metaStorage << "\t"
         "Delayed recovery= " << mChunkToServerMap.GetCount(
             CSMap::Entry::kStateDelayedRecovery) << "\t"
         "Replication backlog= " << mChunkToServerMap.GetCount(
@@ -7060,6 +8012,9 @@ LayoutManager::Ping(IOBuffer& buf, bool wormModeFlag)
         "Max chunk srvs= "    << ChunkServer::GetMaxChunkServerCount() << "\t"
         "Buffers total= "     <<
             (mBufferPool ? mBufferPool->GetTotalBufferCount() : 0) << "\t"
+        "Buffers bytes= "     << (mBufferPool ?
+            (int64_t)mBufferPool->GetTotalBufferCount() *
+                mBufferPool->GetBufferSize() : int64_t(0)) << "\t"
         "Object store enabled= " << mObjectStoreEnabledFlag << "\t"
         "Object store deletes= " << mObjStoreFilesDeleteQueue.GetSize() << "\t"
         "Object store in flight deletes= " <<
@@ -7068,7 +8023,13 @@ LayoutManager::Ping(IOBuffer& buf, bool wormModeFlag)
             mObjBlocksDeleteRequeue.GetSize() << "\t"
         "Object store first delete time= " <<
             (mObjStoreFilesDeleteQueue.IsEmpty() ? time_t(0) :
-                TimeNow() - mObjStoreFilesDeleteQueue.Front()->mTime)
+                TimeNow() - mObjStoreFilesDeleteQueue.Front()->mTime) << "\t"
+        "Object store block deletes started= " <<
+            mObjStoreDeleteStartedCount << "\t"
+        "Object store block deletes done= " <<
+            mObjStoreDeleteDoneCount << "\t"
+        "Object store block delete errors= " <<
+            mObjStoreDeleteErrorCount
     ;
     mWOstream.flush();
     mWOstream.Reset();
@@ -7415,6 +8376,7 @@ LayoutManager::CommitOrRollBackChunkVersion(MetaAllocate* r)
         panic(msg.c_str());
         return;
     }
+    mChunkToServerMap.RemoveHibernatedServers(*ci);
     // Roll back to the initial chunk version, and make chunk stable.
     StTmp<Servers> serversTmp(mServers3Tmp);
     Servers&       srvs = serversTmp.Get();
@@ -7439,8 +8401,9 @@ LayoutManager::LeaseRelinquish(MetaLeaseRelinquish *req)
         *req, mARAChunkCache, mChunkToServerMap);
 }
 
-// Periodically, check the status of all the leases
-// This is an expensive call...use sparingly....
+// Expire leases. The read lease heads and write leases are indexed by the
+// expiration time in the lease timer wheels, therefore the cost is proportional
+// to the number of leases that expire, not to the total number of leases.
 void
 LayoutManager::CheckAllLeases()
 {
@@ -8175,8 +9138,8 @@ LayoutManager::MakeChunkStableDone(const MetaChunkMakeStable* req)
     }
     MetaFattr* const fa     = pinfo->GetFattr();
     const fid_t      fileId = pinfo->GetFileId();
-    if (updateMTimeFlag || mChunkToServerMap.GetState(*pinfo) !=
-            CSMap::Entry::kStateCheckReplication) {
+    if (updateMTimeFlag || ! CSMap::Entry::IsCheckReplication(
+            mChunkToServerMap.GetState(*pinfo))) {
         if (fa->IsStriped()) {
             updateSizeFlag = false;
         }
@@ -8547,7 +9510,16 @@ LayoutManager::ReplicateChunk(
             useServerExcludesFlag = false;
         }
     }
-    placement.FindCandidatesForReplication(minSTier, maxSTier);
+    bool evacuationFlag = false;
+    if (0 < mMaxConcurrentEvacuationWritesPerDrive) {
+        StTmp<Servers> serversTmp(mServers3Tmp);
+        Servers&       servers = serversTmp.Get();
+        mChunkToServerMap.GetServers(clli, servers);
+        evacuationFlag = find_if(servers.begin(), servers.end(),
+            bind(&ChunkServer::IsEvacuationScheduled, _1, clli.GetChunkId())
+        ) != servers.end();
+    }
+    placement.FindCandidatesForReplication(minSTier, maxSTier, evacuationFlag);
     const size_t numRacks = placement.GetCandidateRackCount();
     const size_t numServersPerRack = numRacks <= 1 ?
         (size_t)extraReplicas :
@@ -8597,6 +9569,16 @@ LayoutManager::ReplicateChunk(
         tiers, maxSTier);
 }
 
+bool
+LayoutManager::CanReadForEvacuation(ChunkServer& srv)
+{
+    return (
+        srv.GetReplicationReadLoad() < GetMaxEvacuationReadReplications(srv) &&
+        srv.HasEvacuationReadCredit(
+            TimeNow(), mMaxEvacuationReadBytesPerSecPerNode)
+    );
+}
+
 int
 LayoutManager::ReplicateChunk(
     CSMap::Entry&                 clli,
@@ -8639,11 +9621,10 @@ LayoutManager::ReplicateChunk(
             if (recoveryInfo.HasRecovery()) {
                 reason     = "evacuation recovery";
                 dataServer = c;
-            } else if (ds.GetReplicationReadLoad() <
-                    mMaxConcurrentReadReplicationsPerNode &&
-                    (ds.IsResponsiveServer() ||
-                        servers.size() <= 1)) {
+            } else if ((ds.IsResponsiveServer() || servers.size() <= 1) &&
+                    CanReadForEvacuation(ds)) {
                 dataServer = *iter;
+                ds.UpdateEvacuationReadCredit(CHUNKSIZE);
             }
         } else if (recoveryInfo.HasRecovery()) {
             reason     = "recovery";
@@ -8657,7 +9638,7 @@ LayoutManager::ReplicateChunk(
                 ! dataServer && si != servers.end();
                 ++si) {
             ChunkServer& ss = **si;
-            if (ss.GetReplicationReadLoad() >=
+            if (si == iter || ss.GetReplicationReadLoad() >=
                     mMaxConcurrentReadReplicationsPerNode ||
                     ! ss.IsResponsiveServer()) {
                 continue;
@@ -8703,8 +9684,7 @@ LayoutManager::ReplicateChunk(
         const CSMap::Entry::State replicationState =
             mChunkToServerMap.GetState(clli);
         if (replicationState == CSMap::Entry::kStateNone ||
-                replicationState ==
-                CSMap::Entry::kStateCheckReplication) {
+                CSMap::Entry::IsCheckReplication(replicationState)) {
             SetReplicationState(clli,
                 CSMap::Entry::kStatePendingReplication);
         }
@@ -8848,9 +9828,8 @@ LayoutManager::CanReplicateChunkNow(
             (mUseEvacuationRecoveryFlag &&
                 recoveryInfo &&
                 servers.size() == 1 &&
-                servers.front()->GetReplicationReadLoad() >=
-                    mMaxConcurrentReadReplicationsPerNode &&
                 servers.front()->IsEvacuationScheduled(chunkId) &&
+                ! CanReadForEvacuation(*servers.front()) &&
                 fa->numReplicas == 1 &&
                 fa->HasRecovery())) {
         if (! recoveryInfo || ! fa->HasRecovery()) {
@@ -9032,7 +10011,7 @@ LayoutManager::CanReplicateChunkNow(
         recoveryInfo->striperType        = fa->striperType;
         recoveryInfo->numStripes         = fa->numStripes;
         recoveryInfo->numRecoveryStripes = fa->numRecoveryStripes;
-        recoveryInfo->stripeSize         = fa->stripeSize;
+        recoveryInfo->stripeSize         = fa->stripeSize();
         recoveryInfo->fileSize           = fa->filesize;
     }
     // if any of the chunkservers are retiring, we need to make copies
@@ -9050,6 +10029,12 @@ LayoutManager::CanReplicateChunkNow(
     // retiring plus the # this chunk is under-replicated
     extraReplicas = fa->numReplicas + numRetiringServers -
         (int)servers.size();
+    // Add temporary hot chunk replicas only if the chunk has sufficient
+    // number of replicas, in order to leave re-replication and recovery
+    // unchanged. Once the hot chunk expires the extra replicas are deleted.
+    const int hotExtraReplicas =
+        extraReplicas <= 0 ? GetHotChunkExtraReplicas(chunkId) : 0;
+    extraReplicas += hotExtraReplicas;
     // Do not delete evacuated / retired replicas until there is sufficient
     // number of replicas, then delete all extra copies at once.
     // Take into the account hibernated servers, delay the re-replication /
@@ -9079,6 +10064,7 @@ LayoutManager::CanReplicateChunkNow(
         " replicas: "   << servers.size() <<
         " retiring: "   << numRetiringServers <<
         " target: "     << fa->numReplicas <<
+        " hot: "        << hotExtraReplicas <<
         " rlease: "     << readLeaseWaitFlag <<
         " hibernated: " << hibernatedCount <<
         " needed: "     << extraReplicas <<
@@ -9201,6 +10187,7 @@ LayoutManager::HandoutChunkReplicationWork()
     ChunkRecoveryInfo     recoveryInfo;
     StTmp<ChunkPlacement> placementTmp(mChunkPlacementTmp);
     bool nextRunLowPriorityFlag = false;
+    mChunkToServerMap.First(CSMap::Entry::kStateCheckReplicationUrgent);
     mChunkToServerMap.First(CSMap::Entry::kStateCheckReplication);
     for (; ; loopCount++) {
         if (--pass <= 0) {
@@ -9226,8 +10213,7 @@ LayoutManager::HandoutChunkReplicationWork()
                      " timeouts: "   <<
                         mReplicationCheckTimeouts <<
                      " candidates: " <<
-                        mChunkToServerMap.GetCount(
-                    CSMap::Entry::kStateCheckReplication) <<
+                        GetReplicationCheckCount() <<
                      " initiated: "  << count <<
                      " done: "       << doneCount <<
                      " loop: "       << loopCount <<
@@ -9248,9 +10234,12 @@ LayoutManager::HandoutChunkReplicationWork()
             }
             break;
         }
+        // Chunks closest to data loss first, then the rest of the chunks
+        // in the order their replication check was requested.
         CSMap::Entry* cur = mChunkToServerMap.Next(
-            CSMap::Entry::kStateCheckReplication);
-        if (! cur) {
+            CSMap::Entry::kStateCheckReplicationUrgent);
+        if (! cur && ! (cur = mChunkToServerMap.Next(
+                CSMap::Entry::kStateCheckReplication))) {
             // See if all chunks check was requested.
             if (! (cur = mChunkToServerMap.Next(
                     CSMap::Entry::kStateNone))) {
@@ -9272,6 +10261,7 @@ LayoutManager::HandoutChunkReplicationWork()
                 *cur, CSMap::Entry::kStateCheckReplication);
         }
         CSMap::Entry& entry = *cur;
+        UpdateChunkHealth(entry);
 
         if (GetInFlightChunkOpsCount(entry.GetChunkId(),
                 makePendingOpTypes) > 0) {
@@ -9320,8 +10310,7 @@ LayoutManager::HandoutChunkReplicationWork()
             SetReplicationState(entry, CSMap::Entry::kStateNone);
             doneCount++;
         }
-        if (mNumOngoingReplications > (int64_t)mChunkServers.size() *
-                mMaxConcurrentWriteReplicationsPerNode) {
+        if (mNumOngoingReplications > GetMaxConcurrentReplications()) {
             // throttle...we are handing out
             break;
         }
@@ -9333,12 +10322,19 @@ LayoutManager::HandoutChunkReplicationWork()
 
 void LayoutManager::Timeout()
 {
+    if (! mPendingHellos.empty()) {
+        MetaHello* const r = mPendingHellos.front();
+        mPendingHellos.pop_front();
+        r->suspended = false;
+        submit_request(r);
+    }
     ScheduleCleanup(mMaxServerCleanupScan);
 }
 
 void LayoutManager::ScheduleCleanup(size_t maxScanCount /* = 1 */)
 {
-    if (mChunkToServerMap.RemoveServerCleanup(maxScanCount)) {
+    if (mChunkToServerMap.RemoveServerCleanup(maxScanCount) ||
+            ! mPendingHellos.empty()) {
         if (! mCleanupScheduledFlag) {
             mCleanupScheduledFlag = true;
             globalNetManager().RegisterTimeoutHandler(this);
@@ -9379,6 +10375,12 @@ LayoutManager::ChunkReplicationChecker()
     if (! mPendingBeginMakeStable.empty() && ! InRecoveryPeriod()) {
         ProcessPendingBeginMakeStable();
     }
+    if (! mHotChunks.empty()) {
+        const time_t now = TimeNow();
+        if (mHotChunksExpireCheckTime + min(mHotChunkExpireSec, 10) <= now) {
+            ExpireHotChunks(now);
+        }
+    }
     const bool    recoveryFlag  = InRecovery();
     const int64_t now           = microseconds();
     const bool    fullCheckFlag = mCompleteReplicationCheckTime +
@@ -9414,8 +10416,7 @@ LayoutManager::ChunkReplicationChecker()
         mLastRebalanceRunTime = now;
         RebalanceServers();
     }
-    mReplicationTodoStats->Set(mChunkToServerMap.GetCount(
-        CSMap::Entry::kStateCheckReplication));
+    mReplicationTodoStats->Set(GetReplicationCheckCount());
     ScheduleCleanup(mMaxServerCleanupScan);
 }
 
@@ -9470,15 +10471,12 @@ LayoutManager::ChunkReplicationDone(MetaChunkReplicate* req)
 
     // Since this server is now free,
     // schedule chunk replication scheduler to run.
-    if ((((int64_t)mChunkToServerMap.GetCount(
-                CSMap::Entry::kStateCheckReplication) > 0 ||
+    if ((((int64_t)GetReplicationCheckCount() > 0 ||
             (int64_t)mChunkToServerMap.GetCount(
                 CSMap::Entry::kStateNoDestination) >
-            (int64_t)mChunkServers.size() *
-                mMaxConcurrentWriteReplicationsPerNode) &&
+                GetMaxConcurrentReplications()) &&
             (int64_t)mNumOngoingReplications * 5 / 4 <
-            (int64_t)mChunkServers.size() *
-                mMaxConcurrentWriteReplicationsPerNode) ||
+                GetMaxConcurrentReplications()) ||
             (req->server->GetNumChunkReplications() * 5 / 4 <
                 mMaxConcurrentWriteReplicationsPerNode &&
             ! req->server->IsRetiring() &&
@@ -9629,6 +10627,158 @@ LayoutManager::ChunkReplicationDone(MetaChunkReplicate* req)
     RemoveRetiring(*ci, servers, ci->GetFattr()->numReplicas);
 }
 
+int
+LayoutManager::CopyChunk(MetaCopyChunk& req)
+{
+    if (InRecovery()) {
+        req.statusMsg = "meta server in recovery mode";
+        return -EBUSY;
+    }
+    CSMap::Entry* const ci = mChunkToServerMap.Find(req.srcChunkId);
+    if (! ci) {
+        req.statusMsg = "no source chunk mapping";
+        return -ENOENT;
+    }
+    if (mChunkLeases.GetChunkWriteLease(req.srcChunkId) ||
+            mPendingMakeStable.find(req.srcChunkId) !=
+                mPendingMakeStable.end() ||
+            0 < GetInFlightChunkModificationOpCount(req.srcChunkId)) {
+        req.statusMsg = "source chunk is being modified";
+        return -EBUSY;
+    }
+    kfsSTier_t minTier = req.minSTier;
+    kfsSTier_t maxTier = req.maxSTier;
+    if (! FindStorageTiersRange(minTier, maxTier)) {
+        req.statusMsg = "no space available";
+        return -ENOSPC;
+    }
+    StTmp<Servers> serversTmp(mServers3Tmp);
+    Servers&       servers = serversTmp.Get();
+    mChunkToServerMap.GetServers(*ci, servers);
+    ChunkServerPtr dataServer;
+    ChunkServerPtr dst;
+    for (Servers::const_iterator it = servers.begin();
+            it != servers.end();
+            ++it) {
+        ChunkServer& cs = **it;
+        if (cs.IsDown() || ! cs.IsResponsiveServer() ||
+                mMaxConcurrentReadReplicationsPerNode <=
+                    cs.GetReplicationReadLoad()) {
+            continue;
+        }
+        if (! dataServer) {
+            dataServer = *it;
+        }
+        if (IsCandidateServer(cs, minTier)) {
+            // Local copy: the chunk server reads the source chunk from
+            // itself.
+            dataServer = *it;
+            dst        = *it;
+            break;
+        }
+    }
+    if (! dataServer) {
+        req.statusMsg = "no source chunk server available";
+        return -EAGAIN;
+    }
+    kfsSTier_t tier = minTier;
+    if (! dst) {
+        StTmp<ChunkPlacement> placementTmp(mChunkPlacementTmp);
+        ChunkPlacement&       placement = placementTmp.Get();
+        placement.ExcludeServer(servers);
+        placement.FindCandidatesForReplication(minTier, maxTier);
+        const bool kCanIgnoreServerExcludesFlag = false;
+        for (; ;) {
+            if ((dst = placement.GetNext(kCanIgnoreServerExcludesFlag)) ||
+                    placement.IsLastAttempt() || ! placement.NextRack()) {
+                break;
+            }
+        }
+        if (! dst) {
+            req.statusMsg = "no chunk copy destination available";
+            return -ENOSPC;
+        }
+        tier = placement.GetStorageTier();
+    }
+    KFS_LOG_STREAM_INFO <<
+        "starting chunk copy:"
+        " chunk: " << req.srcChunkId <<
+        " => "     << req.chunkId <<
+        " file: "  << req.srcFid <<
+        " => "     << req.fid <<
+        " from: "  << dataServer->GetServerLocation() <<
+        " to: "    << dst->GetServerLocation() <<
+    KFS_LOG_EOM;
+    dataServer->UpdateReplicationReadLoad(1);
+    ChunkRecoveryInfo recoveryInfo;
+    recoveryInfo.Clear();
+    // Completion is always reported by ChunkCopyDone(), including
+    // synchronous request send failure.
+    dst->ReplicateChunk(req.fid, req.chunkId, dataServer, recoveryInfo,
+        tier, maxTier, mFileRecoveryInFlightCount.end(), &req);
+    return 0;
+}
+
+void
+LayoutManager::ChunkCopyDone(MetaChunkReplicate* req)
+{
+    MetaCopyChunk& op = *req->copyChunk;
+    req->copyChunk = 0;
+    req->server->ReplicateChunkDone(req->chunkId);
+    if (req->dataServer) {
+        req->dataServer->UpdateReplicationReadLoad(-1);
+        req->dataServer.reset();
+    }
+    KFS_LOG_STREAM_INFO <<
+        "chunk copy done:"
+        " chunk: "   << op.srcChunkId <<
+        " => "       << req->chunkId <<
+        " version: " << req->chunkVersion <<
+        " status: "  << req->status <<
+        (req->statusMsg.empty() ? "" : " ") << req->statusMsg <<
+        " server: "  << req->server->GetServerLocation() <<
+        " "          << (req->server->IsDown() ? "down" : "OK") <<
+    KFS_LOG_EOM;
+    op.status    = req->status;
+    op.statusMsg = req->statusMsg;
+    if (0 <= op.status && req->server->IsDown()) {
+        op.status    = -EHOSTUNREACH;
+        op.statusMsg = "chunk copy destination went down";
+    }
+    if (0 <= op.status && req->chunkVersion != op.chunkVersion) {
+        op.status    = -EINVAL;
+        op.statusMsg = "chunk copy version mismatch";
+    }
+    if (0 <= op.status) {
+        chunkId_t curChunkId = op.chunkId;
+        op.status = metatree.assignChunkId(op.fid, op.offset,
+            op.chunkId, op.chunkVersion, 0, &curChunkId);
+        if (0 == op.status) {
+            CSMap::Entry* const ci = mChunkToServerMap.Find(op.chunkId);
+            if (! ci) {
+                panic("chunk copy: missing chunk mapping");
+                op.status = -EFAULT;
+            } else {
+                UpdateReplicationState(*ci);
+                AddHosted(*ci, req->server);
+            }
+        } else if (-EEXIST == op.status) {
+            op.statusMsg = "destination chunk exists";
+        } else if (-ENOENT == op.status) {
+            op.statusMsg = "destination file does not exist";
+        }
+    }
+    if (op.status < 0) {
+        if (! req->server->IsDown()) {
+            // Delete the copy, if any.
+            req->server->NotifyStaleChunk(req->chunkId);
+        }
+    } else {
+        op.status = 0;
+    }
+    op.LayoutDone();
+}
+
 void
 LayoutManager::RemoveRetiring(
     CSMap::Entry&           ci,
@@ -9691,7 +10841,7 @@ LayoutManager::ProcessInvalidStripes(MetaChunkReplicate& req)
     const MetaFattr* const fa = ci->GetFattr();
     if (! fa->HasRecovery() ||
             fa->striperType != req.striperType ||
-            (int)fa->stripeSize != req.stripeSize ||
+            (int)fa->stripeSize() != req.stripeSize ||
             (int)fa->numStripes != req.numStripes ||
             (int)fa->numRecoveryStripes != req.numRecoveryStripes) {
         return;
@@ -9876,10 +11026,35 @@ LayoutManager::DeleteAddlChunkReplicas(
     if (servers.size() <= numReplicas) {
         return;
     }
+    const MetaFattr* const fa = entry.GetFattr();
+    if (mTierMigrationEnabledFlag) {
+        // Remove replicas on the servers with no storage in the file tiers
+        // range first, in order to complete storage tier migration.
+        for (Servers::iterator it = servers.begin();
+                numReplicas < servers.size() && it != servers.end(); ) {
+            ChunkServer& srv = **it;
+            if (HasStorageTier(srv, fa->minSTier, fa->maxSTier)) {
+                ++it;
+                continue;
+            }
+            KFS_LOG_STREAM_INFO <<
+                "<" << entry.GetFileId() << "," << entry.GetChunkId() << ">"
+                " discarding: " << srv.GetServerLocation() <<
+                " no storage in tiers: [" << (int)fa->minSTier <<
+                "," << (int)fa->maxSTier << "]" <<
+            KFS_LOG_EOM;
+            srv.DeleteChunk(entry.GetChunkId());
+            entry.Remove(mChunkToServerMap, *it);
+            it = servers.erase(it);
+        }
+        if (servers.size() <= numReplicas) {
+            return;
+        }
+    }
+    cnt = servers.size();
     placement.clear();
-    const MetaFattr* const fa                    = entry.GetFattr();
-    const int              fileNumReplicas       = fa->numReplicas;
-    bool                   useOtherSrvsRacksFlag = fa->IsStriped();
+    const int fileNumReplicas       = fa->numReplicas;
+    bool      useOtherSrvsRacksFlag = fa->IsStriped();
     if (useOtherSrvsRacksFlag && fileNumReplicas > 1) {
         // If more than one replicas are on the same rack, then do not
         // take into the account placement of other chunks in the stripe
@@ -10071,6 +11246,11 @@ LayoutManager::RebalanceServers()
     if (mRebalanceReplicationsThresholdCount <= mNumOngoingReplications) {
         return;
     }
+    if (0 < mChunkToServerMap.GetCount(
+            CSMap::Entry::kStateCheckReplicationUrgent)) {
+        // Do not compete with the replication of the chunks close to loss.
+        return;
+    }
     // if we are doing rebalancing based on a plan, execute as
     // much of the plan as there is room.
     ExecuteRebalancePlan();
@@ -10187,12 +11367,11 @@ LayoutManager::RebalanceServers()
             if (srvPos >= 0 || rackPos >= 0) {
                 continue;
             }
-            const double util =
-                srv.GetSpaceUtilization(mUseFsTotalSpaceFlag);
-            if (util > max(maxUtil,
+            const double score = GetRebalanceScore(srv);
+            if (score > max(maxUtil,
                     mMaxRebalanceSpaceUtilThreshold)) {
                 loadPos = (int)(it - srvs.begin());
-                maxUtil = util;
+                maxUtil = score;
             }
         }
         if (srcCnt <= 0) {
@@ -10321,6 +11500,27 @@ LayoutManager::RebalanceServers()
     }
 }
 
+double
+LayoutManager::GetRebalanceScore(const ChunkServer& srv) const
+{
+    double score = srv.GetSpaceUtilization(mUseFsTotalSpaceFlag);
+    if (0 < mRebalanceLoadAvgWeight && 0 < mCSTotalLoadAvgSum) {
+        // Load average above the cluster average increases the score.
+        const double ratio = (double)srv.GetLoadAvg() *
+            mChunkServers.size() / mCSTotalLoadAvgSum;
+        if (1 < ratio) {
+            score += mRebalanceLoadAvgWeight * (ratio - 1);
+        }
+    }
+    if (0 < mRebalanceWritesPerDriveWeight && 0 < mMaxWritesPerDriveThreshold) {
+        score += mRebalanceWritesPerDriveWeight *
+            srv.GetNumChunkWrites() /
+            ((double)max(1, srv.GetNumWritableDrives()) *
+                mMaxWritesPerDriveThreshold);
+    }
+    return score;
+}
+
 int
 LayoutManager::LoadRebalancePlan(const string& planFn)
 {
@@ -10366,6 +11566,10 @@ LayoutManager::ReadRebalancePlan(size_t nread)
         if (! (mRebalancePlan >> chunkId >> loc)) {
             break;
         }
+        // Skip the optional move priority. The planner writes the moves
+        // ordered by priority, therefore the most valuable moves are loaded,
+        // and executed first.
+        mRebalancePlan.ignore(numeric_limits<streamsize>::max(), '\n');
         mRebalanceCtrs.PlanLine();
         Servers::const_iterator const it = FindServer(loc);
         if (it == mChunkServers.end()) {
@@ -10662,9 +11866,13 @@ LayoutManager::SetUserAndGroupSelf(const MetaRequest& req,
         }
         return;
     }
-    mLastUidGidRemap.mIp    = ip;
-    mLastUidGidRemap.mUser  = user;
-    mLastUidGidRemap.mGroup = group;
+    // Concurrent read only requests do not update the last remap cache.
+    const bool updateFlag = ! ReadOnlyRequestContext::GetCurrent();
+    if (updateFlag) {
+        mLastUidGidRemap.mIp    = ip;
+        mLastUidGidRemap.mUser  = user;
+        mLastUidGidRemap.mGroup = group;
+    }
     for (HostUserGroupRemap::const_iterator
             it = mHostUserGroupRemap.begin();
             it != mHostUserGroupRemap.end();
@@ -10688,8 +11896,10 @@ LayoutManager::SetUserAndGroupSelf(const MetaRequest& req,
         }
         break;
     }
-    mLastUidGidRemap.mToUser  = user;
-    mLastUidGidRemap.mToGroup = group;
+    if (updateFlag) {
+        mLastUidGidRemap.mToUser  = user;
+        mLastUidGidRemap.mToGroup = group;
+    }
 }
 
 void
@@ -10897,6 +12107,7 @@ LayoutManager::CSMapUnitTest(const Properties& props)
             CSMap::Entry::kStatePendingReplication) <<
     KFS_LOG_EOM;
     mChunkToServerMap.RemoveServerCleanup(0);
+    ClearNamespaceHealth();
     mChunkToServerMap.Clear();
     for (int i = 0; i < kServers; i++) {
         if (mChunkServers[i]->GetIndex() < 0) {
@@ -11126,6 +12337,225 @@ LayoutManager::Handle(MetaForceChunkReplication& op)
     }
 }
 
+void
+LayoutManager::UpdateFileHeatSelf(fid_t fid)
+{
+    const time_t          now = TimeNow();
+    FileHeatMap::iterator it  = mFileHeat.find(fid);
+    if (it == mFileHeat.end()) {
+        if (mTierMigrationMaxTrackedFiles <= mFileHeat.size()) {
+            return;
+        }
+        it = mFileHeat.insert(make_pair(fid, FileHeat(0., now))).first;
+    }
+    it->second.first  = GetDecayedHeat(it->second, now) + 1;
+    it->second.second = now;
+}
+
+double
+LayoutManager::GetDecayedHeat(
+    const LayoutManager::FileHeat& heat, time_t now) const
+{
+    return (heat.second < now ?
+        heat.first * pow(0.5,
+            (double)(now - heat.second) / mTierMigrationHeatHalfLifeSec) :
+        heat.first
+    );
+}
+
+double
+LayoutManager::GetFileHeat(fid_t fid, time_t now) const
+{
+    FileHeatMap::const_iterator const it = mFileHeat.find(fid);
+    return (it == mFileHeat.end() ? 0. : GetDecayedHeat(it->second, now));
+}
+
+/* static */ bool
+LayoutManager::HasStorageTier(
+    const ChunkServer& srv, kfsSTier_t minSTier, kfsSTier_t maxSTier)
+{
+    bool anyFlag = false;
+    for (kfsSTier_t tier = kKfsSTierMin; tier <= kKfsSTierMax; tier++) {
+        if (srv.GetDeviceCount(tier) <= 0) {
+            continue;
+        }
+        if (minSTier <= tier && tier <= maxSTier) {
+            return true;
+        }
+        anyFlag = true;
+    }
+    // Do not move replicas from the servers that have not reported storage
+    // tiers yet.
+    return (! anyFlag);
+}
+
+void
+LayoutManager::SetFileTiers(MetaTierMigrate& op, MetaFattr& fa, bool hotFlag)
+{
+    const kfsSTier_t minSTier =
+        hotFlag ? mTierMigrationHotMinSTier : mTierMigrationColdMinSTier;
+    const kfsSTier_t maxSTier =
+        hotFlag ? mTierMigrationHotMaxSTier : mTierMigrationColdMaxSTier;
+    if (metatree.changeFileReplication(&fa, 0, minSTier, maxSTier) != 0) {
+        return;
+    }
+    op.actions.push_back(
+        MetaTierMigrate::Action(fa.id(), fa.minSTier, fa.maxSTier));
+    KFS_LOG_STREAM_INFO <<
+        "tier migration: " << (hotFlag ? "promote" : "demote") <<
+        " file: "  << fa.id() <<
+        " tiers: [" << (int)fa.minSTier << "," << (int)fa.maxSTier << "]" <<
+    KFS_LOG_EOM;
+}
+
+// Returns false if the migration byte budget is exhausted.
+bool
+LayoutManager::MigrateChunk(CSMap::Entry& entry)
+{
+    if (mTierMigrationBytesCredit < (int64_t)CHUNKSIZE) {
+        return false;
+    }
+    const MetaFattr* const fa          = entry.GetFattr();
+    bool                   migrateFlag = false;
+    {
+        StTmp<Servers> serversTmp(mServers2Tmp);
+        Servers&       servers = serversTmp.Get();
+        mChunkToServerMap.GetServers(entry, servers);
+        for (Servers::const_iterator it = servers.begin();
+                it != servers.end();
+                ++it) {
+            if (! HasStorageTier(**it, fa->minSTier, fa->maxSTier)) {
+                migrateFlag = true;
+                break;
+            }
+        }
+    }
+    const chunkId_t chunkId = entry.GetChunkId();
+    if (! migrateFlag ||
+            0 < GetInFlightChunkModificationOpCount(chunkId) ||
+            mChunkLeases.GetChunkWriteLease(chunkId)) {
+        return true;
+    }
+    const ChunkRecoveryInfo recoveryInfo;
+    StTmp<ChunkPlacement>   placementTmp(mChunkPlacementTmp);
+    ChunkPlacement&         placement     = placementTmp.Get();
+    int                     extraReplicas = 0;
+    if (! CanReplicateChunkNow(entry, extraReplicas, placement) ||
+            extraReplicas != 0) {
+        return true;
+    }
+    // The extra replica outside of the file tiers range is removed by
+    // DeleteAddlChunkReplicas() when the replication completes.
+    if (0 < ReplicateChunk(entry, 1, placement, recoveryInfo)) {
+        mTierMigrationBytesCredit -= (int64_t)CHUNKSIZE;
+    }
+    return true;
+}
+
+bool
+LayoutManager::MigrateFileChunks(fid_t fid, int& scanCount)
+{
+    StTmp<vector<MetaChunkInfo*> > cinfoTmp(mChunkInfos2Tmp);
+    vector<MetaChunkInfo*>&        chunks = cinfoTmp.Get();
+    if (metatree.getalloc(fid, chunks) != 0) {
+        return true;
+    }
+    for (vector<MetaChunkInfo*>::const_iterator it = chunks.begin();
+            it != chunks.end() && scanCount < mTierMigrationMaxScan;
+            ++it) {
+        scanCount++;
+        if (! MigrateChunk(CSMap::Entry::GetCsEntry(**it))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+LayoutManager::Handle(MetaTierMigrate& op)
+{
+    if (! mTierMigrationEnabledFlag || InRecovery()) {
+        return;
+    }
+    const time_t now = TimeNow();
+    if (mTierMigrationCreditTime < now) {
+        const int64_t maxCredit = max(int64_t(CHUNKSIZE),
+            mTierMigrationMaxBytesPerHour * mTierMigrationIntervalSec / 3600);
+        mTierMigrationBytesCredit = (int64_t)min((double)maxCredit,
+            (double)mTierMigrationBytesCredit +
+            (double)mTierMigrationMaxBytesPerHour *
+                (now - mTierMigrationCreditTime) / 3600);
+        mTierMigrationCreditTime = now;
+    }
+    const int64_t prevCredit = mTierMigrationBytesCredit;
+    int           scanCount  = 0;
+    bool          creditFlag = true;
+    // Promote hot files, and stop tracking the files that cooled down.
+    FileHeatMap::iterator it = mFileHeat.lower_bound(mTierMigrationHeatCursor);
+    while (it != mFileHeat.end() && scanCount < mTierMigrationMaxScan) {
+        scanCount++;
+        const double     heat = GetDecayedHeat(it->second, now);
+        MetaFattr* const fa   = heat < mTierMigrationDemoteHeat ?
+            0 : metatree.getFattr(it->first);
+        if (! fa || KFS_FILE != fa->type || fa->numReplicas <= 0) {
+            mFileHeat.erase(it++);
+            continue;
+        }
+        if (mTierMigrationPromoteHeat <= heat) {
+            if (IsTierMigrationRange(*fa, false)) {
+                SetFileTiers(op, *fa, true);
+            }
+            if (IsTierMigrationRange(*fa, true) &&
+                    ! (creditFlag = MigrateFileChunks(fa->id(), scanCount))) {
+                break;
+            }
+        }
+        ++it;
+    }
+    mTierMigrationHeatCursor = it == mFileHeat.end() ? fid_t(0) : it->first;
+    // Demote cold files, and move the chunk replicas of the files that were
+    // not moved the above.
+    CSMap::Entry* entry = 0;
+    if (mTierMigrationChunkCursor < 0 ||
+            ! (entry = mChunkToServerMap.Find(mTierMigrationChunkCursor)) ||
+            mChunkToServerMap.GetState(*entry) != CSMap::Entry::kStateNone) {
+        entry = mChunkToServerMap.Front(CSMap::Entry::kStateNone);
+    }
+    const int64_t minAge = (int64_t)(mTierMigrationHeatHalfLifeSec *
+        kSecs2MicroSecs);
+    while (creditFlag && entry && scanCount < mTierMigrationMaxScan) {
+        scanCount++;
+        CSMap::Entry* const next = mChunkToServerMap.Next(*entry);
+        MetaFattr* const    fa   = entry->GetFattr();
+        if (KFS_FILE == fa->type && 0 < fa->numReplicas) {
+            if (IsTierMigrationRange(*fa, true) &&
+                    fa->mtime + minAge < int64_t(now) * kSecs2MicroSecs &&
+                    GetFileHeat(fa->id(), now) < mTierMigrationDemoteHeat) {
+                SetFileTiers(op, *fa, false);
+                creditFlag = MigrateFileChunks(fa->id(), scanCount);
+            } else if (IsTierMigrationRange(*fa, true) ||
+                    IsTierMigrationRange(*fa, false)) {
+                creditFlag = MigrateChunk(*entry);
+            }
+        }
+        if (creditFlag) {
+            entry = next;
+        }
+    }
+    mTierMigrationChunkCursor = entry ? entry->GetChunkId() : chunkId_t(-1);
+    KFS_LOG_STREAM(prevCredit != mTierMigrationBytesCredit ||
+            ! op.actions.empty() ?
+            MsgLogger::kLogLevelINFO : MsgLogger::kLogLevelDEBUG) <<
+        "tier migration:"
+        " tracked: "  << mFileHeat.size() <<
+        " scanned: "  << scanCount <<
+        " changed: "  << op.actions.size() <<
+        " started: "  <<
+            (prevCredit - mTierMigrationBytesCredit) / (int64_t)CHUNKSIZE <<
+        " credit: "   << mTierMigrationBytesCredit <<
+    KFS_LOG_EOM;
+}
+
 bool
 LayoutManager::FindAccessProxy(
     const string&           host,
@@ -11293,6 +12723,7 @@ LayoutManager::DeleteFileBlocks(fid_t fid, chunkOff_t first, chunkOff_t last,
             mObjBlocksDeleteInFlight.Insert(
                 entry.GetKey(), entry.GetVal(), insertedFlag);
             if (insertedFlag) {
+                mObjStoreDeleteStartedCount++;
                 mChunkServers[mObjStoreDeleteSrvIdx++
                     ]->DeleteChunkVers(fid, chunkVersion);
             }
@@ -11328,10 +12759,12 @@ LayoutManager::Done(MetaChunkDelete& req)
         return;
     }
     if (0 != req.status && -ENOENT != req.status) {
+        mObjStoreDeleteErrorCount++;
         mObjBlocksDeleteRequeue.PushBack(
             make_pair(req.chunkId, -req.chunkVersion - 1));
         return; // Do not re-queue it immediately.
     }
+    mObjStoreDeleteDoneCount++;
     if (mObjBlocksDeleteInFlight.IsEmpty() &&
             mObjBlocksDeleteRequeue.IsEmpty() &&
                 mObjStoreFilesDeleteQueue.IsEmpty()) {
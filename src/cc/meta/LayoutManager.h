@@ -300,6 +300,19 @@ public:
         LeaseId leaseId);
     bool IsEmpty() const
         { return (mReadLeases.IsEmpty() && mWriteLeases.IsEmpty()); }
+    size_t GetReadLeasesTableSize() const
+        { return mReadLeases.GetSize(); }
+    size_t GetWriteLeasesTableSize() const
+        { return mWriteLeases.GetSize(); }
+    // Lease tables storage estimate: the per chunk entries only, the chunk
+    // individual read lease entries are not included.
+    size_t GetStorageSizeEstimate() const
+    {
+        return (
+            mReadLeases.GetSize()  * sizeof(ReadLeases::Entry) +
+            mWriteLeases.GetSize() * sizeof(WriteLeases::Entry)
+        );
+    }
 
 private:
     class EntryKeyHash
@@ -668,10 +681,18 @@ public:
         if (iter != mServers.end()) {
             mServers.erase(iter);
         }
+        for (size_t i = 0; i < kKfsSTierCount; i++) {
+            removeCandidate(i, server);
+        }
     }
     const Servers& getServers() const {
         return mServers;
     }
+    // Servers that can be used for placement in the given storage tier, the
+    // order is not preserved.
+    const Servers& getCandidateServers(kfsSTier_t tier) const {
+        return mTierCandidates[tier];
+    }
     int getPossibleCandidatesCount() const {
         return mPossibleCandidatesCount;
     }
@@ -679,9 +700,17 @@ public:
         return mTierCandidateCount[tier];
     }
     void updatePossibleCandidatesCount(
+            const ChunkServerPtr&  server,
             int                    delta,
             const StorageTierInfo* storageTiersDelta,
             const int*             candidatesDelta) {
+        for (size_t i = 0; i < kKfsSTierCount; i++) {
+            if (candidatesDelta[i] > 0) {
+                mTierCandidates[i].push_back(server);
+            } else if (candidatesDelta[i] < 0) {
+                removeCandidate(i, server);
+            }
+        }
         mPossibleCandidatesCount += delta;
         assert(mPossibleCandidatesCount >= 0);
         if (! storageTiersDelta) {
@@ -689,9 +718,7 @@ public:
         }
         for (size_t i = 0; i < kKfsSTierCount; i++) {
             mStorageTierInfo[i] += storageTiersDelta[i];
-            if (candidatesDelta) {
-                mTierCandidateCount[i] += candidatesDelta[i];
-            }
+            mTierCandidateCount[i] += candidatesDelta[i];
         }
     }
     RackWeight getWeight() const {
@@ -714,7 +741,18 @@ private:
     int             mPossibleCandidatesCount;
     RackWeight      mRackWeight;
     Servers         mServers;
+    Servers         mTierCandidates[kKfsSTierCount];
     int             mTierCandidateCount[kKfsSTierCount];
+
+    void removeCandidate(size_t tier, const ChunkServerPtr& server) {
+        Servers&                candidates = mTierCandidates[tier];
+        Servers::iterator const iter       = find(
+            candidates.begin(), candidates.end(), server);
+        if (iter != candidates.end()) {
+            *iter = candidates.back();
+            candidates.pop_back();
+        }
+    }
     StorageTierInfo mStorageTierInfo[kKfsSTierCount];
 };
 
@@ -1146,10 +1184,13 @@ public:
     /// @param[in] chunkId  chunkId that has been stored
     /// on some server(s)
     /// @param[out] c   server(s) that stores chunk chunkId
+    /// @param[in] clientHost  if set, order the servers by the client
+    /// locality: same host first, then same rack
     /// @retval 0 if a mapping was found; -1 otherwise
     ///
     int GetChunkToServerMapping(MetaChunkInfo& chunkInfo, Servers &c,
-        MetaFattr*& fa, bool* orderReplicasFlag = 0);
+        MetaFattr*& fa, bool* orderReplicasFlag = 0,
+        const string* clientHost = 0);
 
     /// Get the mapping from chunkId -> file id.
     /// @param[in] chunkId  chunkId
@@ -1195,7 +1236,8 @@ public:
     /// gets done over time.
     void InitCheckAllChunks();
 
-    /// Is an expensive call; use sparingly
+    /// Expire leases, the cost is proportional to the number of expired
+    /// leases.
     void CheckAllLeases();
 
     /// Cleanup the lease for a particular chunk
@@ -1224,6 +1266,15 @@ public:
     /// it to do the replication.
     void ChunkReplicationDone(MetaChunkReplicate *req);
 
+    /// Start copying chunk into a new chunk id of the destination file.
+    /// Prefer the chunk server hosting the source chunk as the destination
+    /// in order to keep the data local to the host.
+    /// @retval 0 if chunk copy request was sent, -errno otherwise
+    int CopyChunk(MetaCopyChunk& req);
+    /// Chunk copy finished. On success assign the new chunk to the
+    /// destination file, and schedule replication check.
+    void ChunkCopyDone(MetaChunkReplicate* req);
+
     /// Degree of replication for chunk has changed.  When the replication
     /// checker runs, have it check the status for this chunk.
     /// @param[in] chunkId  chunk whose replication level needs checking
@@ -1318,6 +1369,8 @@ public:
         { return mMaxResponseSize; }
     int GetReadDirLimit() const
         { return mReadDirLimit; }
+    int GetReadDirPlusMaxPageSize() const
+        { return mReadDirPlusMaxPageSize; }
     void ChangeIoBufPending(int64_t delta)
         { SyncAddAndFetch(mIoBufPending, delta); }
     bool IsCandidateServer(
@@ -1326,6 +1379,8 @@ public:
         double             writableChunksThresholdRatio = 1.0);
     bool GetPanicOnInvalidChunkFlag() const
         { return mPanicOnInvalidChunkFlag; }
+    size_t GetDumpsterCleanupMaxEntries() const
+        { return (size_t)mDumpsterCleanupMaxEntries; }
 
     // Chunk placement.
     enum { kSlaveScaleFracBits = 8 };
@@ -1340,12 +1395,16 @@ public:
     int64_t GetSlavePlacementScale();
     int GetMaxConcurrentWriteReplicationsPerNode() const
         { return mMaxConcurrentWriteReplicationsPerNode; }
+    int GetMaxConcurrentEvacuationWritesPerDrive() const
+        { return mMaxConcurrentEvacuationWritesPerDrive; }
     const Servers& GetChunkServers() const
         { return mChunkServers; }
     const RackInfos& GetRacks() const
         { return mRacks; }
     int64_t Rand(int64_t interval);
     PrngIsaac64& GetRandom() { return mRandom; }
+    int64_t GetInventoryResumeInstanceId() const
+        { return (mChunkServerInventoryResumeFlag ? mInstanceId : 0); }
     void UpdateChunkWritesPerDrive(
         ChunkServer&           srv,
         int                    deltaNumChunkWrites,
@@ -1458,6 +1517,14 @@ public:
     bool IsDeleteChunkOnFsIdMismatch() const
         { return mDeleteChunkOnFsIdMismatchFlag; }
     void Handle(MetaForceChunkReplication& op);
+    void Handle(MetaTierMigrate& op);
+    /// Account file read access for the storage tier migration.
+    void UpdateFileHeat(fid_t fid)
+    {
+        if (mTierMigrationEnabledFlag) {
+            UpdateFileHeatSelf(fid);
+        }
+    }
     bool Validate(MetaCreate& createOp) const;
     bool IsObjectStoreEnabled() const
         { return mObjectStoreEnabledFlag; }
@@ -1472,6 +1539,9 @@ public:
     void ClearObjStoreDelete();
     void UpdateObjectsCount(
         ChunkServer& srv, int64_t delta, int64_t writableDelta);
+    // Chunk server heartbeat hot chunk report, the read rate is the number
+    // of reads per second of the reporting server chunk replica.
+    void UpdateHotChunk(chunkId_t chunkId, int readRate);
     bool DeleteChunkServerRollBack(chunkId_t chunkId)
         { return (0 < mChunkVersionRollBack.erase(chunkId)); }
 protected:
@@ -1934,6 +2004,13 @@ protected:
     /// is overloaded (in which case, it can give up blocks).
     double mMaxRebalanceSpaceUtilThreshold;
     double mMinRebalanceSpaceUtilThreshold;
+    /// Weights of the server load average relative to the cluster average,
+    /// and of the writes per drive relative to the max writes per drive in
+    /// the re-balance source server score. The score is compared with
+    /// mMaxRebalanceSpaceUtilThreshold. With 0 weights the score is the space
+    /// utilization.
+    double mRebalanceLoadAvgWeight;
+    double mRebalanceWritesPerDriveWeight;
 
     /// Set when a rebalancing plan is being excuted.
     bool mIsExecutingRebalancePlan;
@@ -1960,6 +2037,10 @@ protected:
     /// sufficient copies of each chunk.
     PeriodicOp<MetaChunkReplicationCheck> mChunkReplicator;
     PeriodicOp<MetaCheckpoint> mCheckpoint;
+    /// Server side trash checkpoint and expiry.
+    PeriodicOp<MetaTrashExpire> mTrashEmptier;
+    /// Access temperature driven storage tier migration.
+    PeriodicOp<MetaTierMigrate> mTierMigrator;
 
     uint32_t mMinChunkserversToExitRecovery;
 
@@ -2027,6 +2108,11 @@ protected:
     double mReservationOvercommitFactor;
     // Delay replication when connection breaks.
     int    mServerDownReplicationDelay;
+    // Allow chunk server that re-connects within the replication delay to
+    // resume with its hibernated chunk inventory, instead of sending and
+    // re-adding all its chunks.
+    bool    mChunkServerInventoryResumeFlag;
+    int64_t mInstanceId;
     uint64_t mMaxDownServersHistorySize;
     // Chunk server properties broadcasted to all chunk servers.
     Properties mChunkServersProps;
@@ -2045,12 +2131,135 @@ protected:
     // "instant du"
     time_t  mLastRecomputeDirsizeTime;
     int     mRecomputeDirSizesIntervalSec;
+    // Max dumpster entries and chunks to remove per lease cleanup, 0 -- no
+    // limit.
+    int     mDumpsterCleanupMaxEntries;
+    // Access temperature driven storage tier migration. The file read
+    // "heat" decays exponentially with the configured half life. Only the
+    // files with the storage tiers range equal to either "hot" or "cold" range
+    // are migrated. Disabled unless the interval is positive, and both ranges
+    // are valid and different.
+    typedef pair<double, time_t> FileHeat;
+    typedef map<
+        fid_t,
+        FileHeat,
+        less<fid_t>,
+        StdFastAllocator<pair<const fid_t, FileHeat> >
+    > FileHeatMap;
+    int         mTierMigrationIntervalSec;
+    kfsSTier_t  mTierMigrationHotMinSTier;
+    kfsSTier_t  mTierMigrationHotMaxSTier;
+    kfsSTier_t  mTierMigrationColdMinSTier;
+    kfsSTier_t  mTierMigrationColdMaxSTier;
+    double      mTierMigrationHeatHalfLifeSec;
+    double      mTierMigrationPromoteHeat;
+    double      mTierMigrationDemoteHeat;
+    int64_t     mTierMigrationMaxBytesPerHour;
+    size_t      mTierMigrationMaxTrackedFiles;
+    int         mTierMigrationMaxScan;
+    bool        mTierMigrationEnabledFlag;
+    int64_t     mTierMigrationBytesCredit;
+    time_t      mTierMigrationCreditTime;
+    fid_t       mTierMigrationHeatCursor;
+    chunkId_t   mTierMigrationChunkCursor;
+    FileHeatMap mFileHeat;
+    // Name space health counters, maintained incrementally by the
+    // replication check, and chunk replica add and delete. Only chunks with
+    // less than the desired number of replicas, and files with such chunks
+    // are tracked. The storage tier and top level directory are recorded
+    // when the chunk or file is first tracked, in order to keep the counters
+    // consistent with tier changes and renames.
+    enum
+    {
+        kHealthLost,
+        kHealthEndangered,
+        kHealthUnderReplicated,
+        kHealthRecoveryMissing,
+        kHealthCount
+    };
+    struct HealthCounts
+    {
+        HealthCounts()
+        {
+            for (int i = 0; i < kHealthCount; i++) {
+                mChunks[i] = 0;
+                mFiles[i]  = 0;
+            }
+        }
+        bool IsEmpty() const
+        {
+            for (int i = 0; i < kHealthCount; i++) {
+                if (mChunks[i] != 0 || mFiles[i] != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        int64_t mChunks[kHealthCount];
+        int64_t mFiles[kHealthCount];
+    };
+    struct ChunkHealth
+    {
+        fid_t      mFid;
+        fid_t      mTopDir;
+        int        mHealth;
+        kfsSTier_t mTier;
+    };
+    struct FileHealth
+    {
+        FileHealth()
+            : mTopDir(-1),
+              mTier(kKfsSTierMax)
+        {
+            for (int i = 0; i < kHealthCount; i++) {
+                mCounts[i] = 0;
+            }
+        }
+        fid_t      mTopDir;
+        kfsSTier_t mTier;
+        int64_t    mCounts[kHealthCount];
+    };
+    typedef map<
+        chunkId_t,
+        ChunkHealth,
+        less<chunkId_t>,
+        StdFastAllocator<pair<const chunkId_t, ChunkHealth> >
+    > ChunkHealthMap;
+    typedef map<
+        fid_t,
+        FileHealth,
+        less<fid_t>,
+        StdFastAllocator<pair<const fid_t, FileHealth> >
+    > FileHealthMap;
+    typedef map<
+        fid_t,
+        HealthCounts,
+        less<fid_t>,
+        StdFastAllocator<pair<const fid_t, HealthCounts> >
+    > DirHealthMap;
+    bool           mNamespaceHealthFlag;
+    int            mNamespaceHealthMaxPingDirs;
+    ChunkHealthMap mChunkHealth;
+    FileHealthMap  mFileHealth;
+    DirHealthMap   mDirHealth;
+    HealthCounts   mHealthTotal;
+    HealthCounts   mHealthByTier[kKfsSTierCount];
+    Counter*       mHealthChunkCounters[kHealthCount];
+    Counter*       mHealthFileCounters[kHealthCount];
     /// Max # of concurrent read/write replications per node
     ///  -- write: is the # of chunks that the node can pull in from outside
     ///  -- read: is the # of chunks that the node is allowed to send out
     ///
     int     mMaxConcurrentWriteReplicationsPerNode;
     int     mMaxConcurrentReadReplicationsPerNode;
+    /// Evacuation (retire, hibernate, and chunk directory evacuation) limits,
+    /// scaled by the number of chunk server drives, in order to run one or
+    /// more replication streams per source and destination drive in parallel.
+    /// 0 -- use the above per node limits. Evacuation read bandwidth is per
+    /// evacuating node, 0 -- no limit.
+    int     mMaxConcurrentEvacuationReadsPerDrive;
+    int     mMaxConcurrentEvacuationWritesPerDrive;
+    int64_t mMaxEvacuationReadBytesPerSecPerNode;
     bool    mUseEvacuationRecoveryFlag;
     int64_t mReplicationFindWorkTimeouts;
     /// How much do we spend on each internal RPC in chunk-replication-check to handout
@@ -2081,6 +2290,8 @@ protected:
     int64_t       mCompleteReplicationCheckTime;
     int64_t       mPastEofRecoveryDelay;
     size_t        mMaxServerCleanupScan;
+    size_t        mMaxHelloChunksPerLoop;
+    deque<MetaHello*> mPendingHellos;
     int           mMaxRebalanceScan;
     double        mRebalanceReplicationsThreshold;
     int64_t       mRebalanceReplicationsThresholdCount;
@@ -2124,6 +2335,8 @@ protected:
     int64_t mFsckAbandonedFileTimeout;
     int64_t mMaxFsckTime;
     bool    mFullFsckFlag;
+    int     mFsckWorkersCount;
+    size_t  mFsckPartitionDepth;
     int64_t mMTimeUpdateResolution;
     int64_t mMaxPendingRecoveryMsgLogInfo;
     bool    mAllowLocalPlacementFlag;
@@ -2158,11 +2371,49 @@ protected:
     int16_t mMaxReplicasPerFile;
     int16_t mMaxReplicasPerRSFile;
     bool    mGetAllocOrderServersByLoadFlag;
+    bool    mReadPreferMemoryTierFlag;
+    bool    mReadAvoidSlowChunkDirsFlag;
+    bool    mReadPreferClientLocalityFlag;
+    // Temporary extra replicas of the "hot" chunks, i.e. the chunks with the
+    // read rate reported by the chunk servers at or above the min. read rate.
+    // The extra replicas are created and deleted by the replication checker,
+    // the total number of the extra replicas is limited by max. extra
+    // replicas.
+    struct HotChunk
+    {
+        HotChunk()
+            : mExtraReplicas(0),
+              mReadRate(0),
+              mLastReportTime(0),
+              mLastIncreaseTime(0)
+            {}
+        int    mExtraReplicas;
+        int    mReadRate;
+        time_t mLastReportTime;
+        time_t mLastIncreaseTime;
+    };
+    typedef map<
+        chunkId_t,
+        HotChunk,
+        less<chunkId_t>,
+        StdFastAllocator<pair<const chunkId_t, HotChunk> >
+    > HotChunks;
+    HotChunks mHotChunks;
+    int64_t   mHotChunksExtraReplicasCount;
+    int       mHotChunkMinReadRate;
+    int       mHotChunkMaxExtraReplicas;
+    int       mHotChunkMaxExtraReplicasPerChunk;
+    int       mHotChunkExpireSec;
+    int       mHotChunkIncreaseIntervalSec;
+    time_t    mHotChunksExpireCheckTime;
+
+    double  mMaxSlowChunkDirsRatio;
     int     mMinChunkAllocClientProtoVersion;
 
     int     mMaxResponseSize;
     int64_t mMinIoBufferBytesToProcessRequest;
     int     mReadDirLimit;
+    int     mReadDirPlusMaxPageSize;
     bool    mAllowChunkServerRetireFlag;
     bool    mPanicOnInvalidChunkFlag;
     int     mAppendCacheCleanupInterval;
@@ -2255,6 +2506,9 @@ protected:
     int                      mObjStoreMaxDeletesPerServer;
     int                      mObjStoreDeleteDelay;
     size_t                   mObjStoreDeleteSrvIdx;
+    int64_t                  mObjStoreDeleteStartedCount;
+    int64_t                  mObjStoreDeleteDoneCount;
+    int64_t                  mObjStoreDeleteErrorCount;
     ObjStoreFilesDeleteQueue mObjStoreFilesDeleteQueue;
     ObjBlocksDeleteRequeue   mObjBlocksDeleteRequeue;
     ObjBlocksDeleteInFlight  mObjBlocksDeleteInFlight;
@@ -2350,10 +2604,49 @@ protected:
     /// Does any server have space/write-b/w available for
     /// re-replication
     int CountServersAvailForReReplication() const;
+    void UpdateFileHeatSelf(fid_t fid);
+    int GetChunkHealth(const CSMap::Entry& entry) const;
+    void UpdateChunkHealth(const CSMap::Entry& entry);
+    void RemoveChunkHealth(chunkId_t chunkId);
+    void UpdateHealthCounts(const ChunkHealth& health, int inc);
+    void ClearNamespaceHealth();
+    void ShowNamespaceHealth(ostream& os);
+    static fid_t GetTopLevelDir(const MetaFattr& fa);
+    double GetFileHeat(fid_t fid, time_t now) const;
+    double GetDecayedHeat(const FileHeat& heat, time_t now) const;
+    static bool HasStorageTier(
+        const ChunkServer& srv, kfsSTier_t minSTier, kfsSTier_t maxSTier);
+    bool IsTierMigrationRange(const MetaFattr& fa, bool hotFlag) const
+    {
+        return (hotFlag ?
+            (fa.minSTier == mTierMigrationHotMinSTier &&
+                fa.maxSTier == mTierMigrationHotMaxSTier) :
+            (fa.minSTier == mTierMigrationColdMinSTier &&
+                fa.maxSTier == mTierMigrationColdMaxSTier)
+        );
+    }
+    void SetFileTiers(MetaTierMigrate& op, MetaFattr& fa, bool hotFlag);
+    bool MigrateChunk(CSMap::Entry& entry);
+    bool MigrateFileChunks(fid_t fid, int& scanCount);
+    int GetMaxEvacuationReadReplications(const ChunkServer& srv) const
+    {
+        return max(mMaxConcurrentReadReplicationsPerNode,
+            srv.GetNumDrives() * mMaxConcurrentEvacuationReadsPerDrive);
+    }
+    int64_t GetMaxConcurrentReplications() const
+    {
+        return max(
+            (int64_t)mChunkServers.size() *
+                mMaxConcurrentWriteReplicationsPerNode,
+            (int64_t)mTotalWritableDrives *
+                mMaxConcurrentEvacuationWritesPerDrive);
+    }
+    bool CanReadForEvacuation(ChunkServer& srv);
 
     /// Periodically, rebalance servers by moving chunks around from
     /// "over utilized" servers to "under utilized" servers.
     void RebalanceServers();
+    double GetRebalanceScore(const ChunkServer& srv) const;
     void UpdateReplicationsThreshold();
 
     /// For a time period that corresponds to the length of a lease interval,
@@ -2376,6 +2669,9 @@ protected:
     inline seq_t IncrementChunkVersionRollBack(chunkId_t chunkId);
     inline void UpdatePendingRecovery(CSMap::Entry& entry);
     inline void CheckReplication(CSMap::Entry& entry);
+    inline int GetHotChunkExtraReplicas(chunkId_t chunkId) const;
+    void ExpireHotChunks(time_t now);
+    inline size_t GetReplicationCheckCount() const;
     bool GetPlacementExcludes(const CSMap::Entry& entry, ChunkPlacement& placement,
         bool includeThisChunkFlag = true,
         bool stopIfHasAnyReplicationsInFlight = false,
@@ -2384,6 +2680,7 @@ protected:
     RackId GetRackId(const ServerLocation& loc) const;
     RackId GetRackId(const string& loc) const;
     void ScheduleCleanup(size_t maxScanCount = 1);
+    void AddHelloChunks(MetaHello* r);
     void RemoveRetiring(CSMap::Entry& ci, Servers& servers, int numReplicas,
         bool deleteRetiringFlag = false);
     void DeleteChunk(fid_t fid, chunkId_t chunkId, const Servers& servers);
@@ -2406,6 +2703,9 @@ protected:
         FilesChecker&     fsck,
         const MetaDentry& de,
         const MetaFattr&  fa);
+    bool ParallelFsck(FilesChecker& fsck, ostream** os);
+    bool RunFsckWorker(
+        int idx, int workersCount, int streamsCount, FILE** files);
     template<typename T, typename OT> void LoadIdRemap(
         istream& fs, T OT::* map);
     void SetUserAndGroupSelf(const MetaRequest& req,
@@ -29,17 +29,31 @@
 #include "util.h"
 #include "Replay.h"
 #include "common/MsgLogger.h"
+#include "common/Properties.h"
+#include "common/time.h"
 #include "kfsio/Globals.h"
+#include "qcdio/QCThread.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/QCUtils.h"
+#include "qcdio/qcstutils.h"
 #include "NetDispatch.h"
 
 #include <iomanip>
+#include <streambuf>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 namespace KFS
 {
 using std::hex;
 using std::dec;
+using std::max;
 using std::ofstream;
 using std::ifstream;
+using std::streambuf;
+using std::streamsize;
 using libkfsio::globalNetManager;
 
 // default values
@@ -48,6 +62,334 @@ string LASTLOG(LOGDIR + "/last");
 
 Logger oplog(LOGDIR);
 
+// Group commit log writer.
+// Log records are serialized by the request processing thread (the thread that
+// owns the global mutex) through the md stream into the writer queue, and the
+// corresponding requests are added to the writer's pending list. The writer
+// thread takes all records queued since the last write, optionally waiting up
+// to the max batch delay for more records to arrive, writes them with a single
+// write, and syncs the log file. Once the batch is on disk the writer moves
+// the batch requests onto the done list, and wakes up the main thread, which
+// then dispatches these requests to NetDispatch from Timeout().
+class Logger::Committer :
+    public  QCRunnable,
+    public  ITimeout,
+    private streambuf,
+    public  ostream
+{
+public:
+    Committer(
+        Logger& logger)
+        : QCRunnable(),
+          ITimeout(),
+          streambuf(),
+          ostream(this),
+          mLogger(logger),
+          mMutex(),
+          mWorkCond(),
+          mDoneCond(),
+          mThread(),
+          mQueue(),
+          mWriteBuf(),
+          mQueueHead(0),
+          mQueueTail(0),
+          mDoneHead(0),
+          mDoneTail(0),
+          mQueueSeq(0),
+          mDoneSeq(0),
+          mFd(-1),
+          mError(0),
+          mWritingFlag(false),
+          mStopFlag(false),
+          mSyncFlag(true),
+          mMaxBatchBytes(1 << 20),
+          mMaxBatchDelayUsec(0)
+        {}
+    ~Committer()
+        { Committer::Stop(); }
+    bool Start()
+    {
+        if (mThread.IsStarted()) {
+            return true;
+        }
+        const int kStackSize = 64 << 10;
+        const int err        = mThread.TryToStart(
+            this, kStackSize, "LogWriter");
+        if (err) {
+            KFS_LOG_STREAM_ERROR << QCUtils::SysError(
+                err, "failed to start log writer thread") <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        globalNetManager().RegisterTimeoutHandler(this);
+        return true;
+    }
+    void Stop()
+    {
+        if (! mThread.IsStarted()) {
+            return;
+        }
+        QCStMutexLocker locker(mMutex);
+        mStopFlag = true;
+        mWorkCond.Notify();
+        locker.Unlock();
+        mThread.Join();
+        globalNetManager().UnRegisterTimeoutHandler(this);
+    }
+    void SetParameters(
+        const Properties& props)
+    {
+        QCStMutexLocker locker(mMutex);
+        mSyncFlag = props.getValue(
+            "metaServer.log.groupCommit.sync",
+            mSyncFlag ? 1 : 0) != 0;
+        mMaxBatchBytes = max(size_t(4 << 10), props.getValue(
+            "metaServer.log.groupCommit.maxBatchBytes", mMaxBatchBytes));
+        mMaxBatchDelayUsec = max(int64_t(0), props.getValue(
+            "metaServer.log.groupCommit.maxBatchDelayMicroSec",
+            mMaxBatchDelayUsec));
+    }
+    void SetFd(
+        int fd)
+    {
+        QCStMutexLocker locker(mMutex);
+        assert(mQueue.empty() && ! mWritingFlag);
+        mFd = fd;
+    }
+    int GetFd() const
+        { return mFd; }
+    void Add(
+        MetaRequest& r)
+    {
+        QCStMutexLocker locker(mMutex);
+        r.next = 0;
+        if (mQueueTail) {
+            mQueueTail->next = &r;
+        } else {
+            mQueueHead = &r;
+        }
+        mQueueTail = &r;
+        mQueueSeq  = r.seqno;
+        mWorkCond.Notify();
+    }
+    //!< wait for all queued log records to be on disk
+    int Sync(
+        seq_t& outCommitted)
+    {
+        QCStMutexLocker locker(mMutex);
+        mWorkCond.Notify();
+        while (mError == 0 &&
+                (mWritingFlag || ! mQueue.empty() || mQueueHead)) {
+            mDoneCond.Wait(mMutex);
+        }
+        outCommitted = mDoneSeq;
+        return mError;
+    }
+    int GetError() const
+        { return mError; }
+    virtual void Timeout()
+    {
+        QCStMutexLocker locker(mMutex);
+        MetaRequest* next      = mDoneHead;
+        const seq_t  committed = mDoneSeq;
+        const int    error     = mError;
+        mDoneHead = 0;
+        mDoneTail = 0;
+        locker.Unlock();
+        if (error != 0) {
+            KFS_LOG_STREAM_FATAL <<
+                "transaction log write failure: " <<
+                    QCUtils::SysError(error) <<
+            KFS_LOG_EOM;
+            panic("Logger::Committer, write", false);
+            return;
+        }
+        if (mLogger.committed < committed) {
+            mLogger.committed = committed;
+        }
+        while (next) {
+            MetaRequest& r = *next;
+            next = r.next;
+            r.next = 0;
+            gNetDispatch.Dispatch(&r);
+        }
+    }
+    virtual void Run()
+    {
+        QCStMutexLocker locker(mMutex);
+        for (; ;) {
+            while (! mStopFlag && mQueue.empty() && ! mQueueHead) {
+                mWorkCond.Wait(mMutex);
+            }
+            if (mQueue.empty() && ! mQueueHead) {
+                break;
+            }
+            if (0 < mMaxBatchDelayUsec && ! mStopFlag) {
+                // Let more records to accumulate, unless the batch is
+                // already large enough.
+                const int64_t end = microseconds() + mMaxBatchDelayUsec;
+                int64_t       now;
+                while (! mStopFlag && mQueue.size() < mMaxBatchBytes &&
+                        (now = microseconds()) < end) {
+                    mWorkCond.Wait(mMutex, QCCondVar::Time(end - now) * 1000);
+                }
+            }
+            mWriteBuf.swap(mQueue);
+            MetaRequest* const head = mQueueHead;
+            MetaRequest* const tail = mQueueTail;
+            const seq_t        seq  = mQueueSeq;
+            const int          fd   = mFd;
+            const bool         sync = mSyncFlag;
+            mQueueHead   = 0;
+            mQueueTail   = 0;
+            mWritingFlag = true;
+            locker.Unlock();
+            const int err = Write(fd, sync);
+            locker.Lock();
+            mWritingFlag = false;
+            mWriteBuf.clear();
+            if (err != 0 && mError == 0) {
+                mError = err;
+            }
+            if (tail) {
+                if (mDoneTail) {
+                    mDoneTail->next = head;
+                } else {
+                    mDoneHead = head;
+                }
+                mDoneTail = tail;
+            }
+            if (mError == 0) {
+                mDoneSeq = seq;
+            }
+            mDoneCond.NotifyAll();
+            globalNetManager().Wakeup();
+        }
+    }
+protected:
+    virtual int overflow(
+        int sym = EOF)
+    {
+        if (sym != EOF) {
+            const char c = (char)sym;
+            QCStMutexLocker locker(mMutex);
+            mQueue.append(&c, 1);
+        }
+        return sym;
+    }
+    virtual streamsize xsputn(
+        const char* buf,
+        streamsize  size)
+    {
+        if (0 < size) {
+            QCStMutexLocker locker(mMutex);
+            mQueue.append(buf, (size_t)size);
+        }
+        return size;
+    }
+private:
+    Logger&      mLogger;
+    QCMutex      mMutex;
+    QCCondVar    mWorkCond;
+    QCCondVar    mDoneCond;
+    QCThread     mThread;
+    string       mQueue;
+    string       mWriteBuf;
+    MetaRequest* mQueueHead;
+    MetaRequest* mQueueTail;
+    MetaRequest* mDoneHead;
+    MetaRequest* mDoneTail;
+    seq_t        mQueueSeq;
+    seq_t        mDoneSeq;
+    int          mFd;
+    int          mError;
+    bool         mWritingFlag;
+    bool         mStopFlag;
+    bool         mSyncFlag;
+    size_t       mMaxBatchBytes;
+    int64_t      mMaxBatchDelayUsec;
+
+    int Write(
+        int  fd,
+        bool sync)
+    {
+        if (fd < 0) {
+            return EBADF;
+        }
+        const char*       ptr = mWriteBuf.data();
+        const char* const end = ptr + mWriteBuf.size();
+        while (ptr < end) {
+            const ssize_t nwr = ::write(fd, ptr, end - ptr);
+            if (nwr < 0) {
+                const int err = errno;
+                if (err == EINTR) {
+                    continue;
+                }
+                return (err == 0 ? EIO : err);
+            }
+            ptr += nwr;
+        }
+        if (sync && ptr != mWriteBuf.data() && fdatasync(fd)) {
+            const int err = errno;
+            return (err == 0 ? EIO : err);
+        }
+        return 0;
+    }
+private:
+    Committer(const Committer&);
+    Committer& operator=(const Committer&);
+};
+
+Logger::~Logger()
+{
+    logstream.flush();
+    if (committer) {
+        seq_t last;
+        committer->Sync(last);
+        committer->Stop();
+        if (0 <= committer->GetFd()) {
+            ::close(committer->GetFd());
+        }
+        delete committer;
+    }
+    logf.close();
+}
+
+bool
+Logger::fail() const
+{
+    if (committer) {
+        return (committer->GetError() != 0 || md.fail());
+    }
+    return (logf.fail() || md.fail());
+}
+
+void
+Logger::setParameters(const Properties& props)
+{
+    // The digest applies to the log segments started after the change.
+    const string digest = props.getValue("metaServer.log.digest", digestName);
+    if (MdStream::IsDigestSupported(digest)) {
+        digestName = digest;
+    } else {
+        KFS_LOG_STREAM_ERROR <<
+            "metaServer.log.digest: " << digest <<
+            " is not supported, using: " <<
+            (digestName.empty() ? "md5" : digestName) <<
+        KFS_LOG_EOM;
+    }
+    if (! committer) {
+        // Group commit mode can only be changed prior to the log start.
+        groupCommitFlag = props.getValue("metaServer.log.groupCommit",
+            groupCommitFlag ? 1 : 0) != 0;
+        if (lognum >= 0 || ! groupCommitFlag) {
+            return;
+        }
+        committer = new Committer(*this);
+    }
+    committer->SetParameters(props);
+}
+
 void
 Logger::dispatch(MetaRequest *r)
 {
@@ -57,6 +399,11 @@ Logger::dispatch(MetaRequest *r)
             panic("Logger::dispatch", true);
         }
         cp.note_mutation();
+        if (committer) {
+            // Dispatch once the log record is on disk.
+            committer->Add(*r);
+            return;
+        }
     }
     gNetDispatch.Dispatch(r);
 }
@@ -69,7 +416,12 @@ Logger::log(MetaRequest *r)
 {
     const int res = r->log(logstream);
     if (res >= 0) {
-        flushResult(r);
+        if (committer) {
+            // Move the record into the writer queue.
+            logstream.flush();
+        } else {
+            flushResult(r);
+        }
     }
     return res;
 }
@@ -126,26 +478,36 @@ Logger::startLog(int seqno, bool appendFlag /* = false */,
             " int base: " << logAppendIntBase <<
             " file: "     << logname <<
         KFS_LOG_EOM;
-        logf.open(logname.c_str(), ofstream::app | ofstream::binary);
-        md.SetStream(&logf);
+        if (openLog(true) < 0) {
+            return -EIO;
+        }
         md.SetWriteTrough(false);
         switch (logAppendIntBase) {
             case 10: logstream << dec; break;
             case 16: logstream << hex; break;
             default:
                 panic("invalid int base parameter", false);
-                logf.close();
+                closeLog();
                 return -EINVAL;
         }
         return (fail() ? -EIO : 0);
     }
-    logf.open(logname.c_str(),
-        ofstream::out | ofstream::binary | ofstream::trunc);
+    if (openLog(false) < 0) {
+        return -EIO;
+    }
     md.SetWriteTrough(false);
-    md.Reset(&logf);
+    ostream* const os = committer ?
+        static_cast<ostream*>(committer) : static_cast<ostream*>(&logf);
+    md.Reset(os, string());
     logstream <<
         "version/" << VERSION << "\n"
-        "checksum/last-line\n"
+        "checksum/last-line\n";
+    if (! digestName.empty()) {
+        // The digest covers the content starting from the digest entry.
+        md.Reset(os, digestName);
+        logstream << "digest/" << digestName << "\n";
+    }
+    logstream <<
         "setintbase/16\n";
     ;
     logstream << "time/" << DisplayIsoDateTime() << '\n';
@@ -154,6 +516,63 @@ Logger::startLog(int seqno, bool appendFlag /* = false */,
     return (fail() ? -EIO : 0);
 }
 
+/*!
+ * \brief open current log file, and set the md stream output
+ * \param[in] appendFlag append to the existing log file
+ * \return      0 if successful, negative on I/O error
+ */
+int
+Logger::openLog(bool appendFlag)
+{
+    if (! committer) {
+        logf.open(logname.c_str(), appendFlag ?
+            ofstream::app | ofstream::binary :
+            ofstream::out | ofstream::binary | ofstream::trunc);
+        if (appendFlag) {
+            md.SetStream(&logf);
+        }
+        return (logf.fail() ? -EIO : 0);
+    }
+    if (! committer->Start()) {
+        return -EIO;
+    }
+    const int fd = ::open(logname.c_str(), O_WRONLY | O_CREAT |
+        (appendFlag ? O_APPEND : O_TRUNC), 0666);
+    if (fd < 0) {
+        const int err = errno;
+        KFS_LOG_STREAM_ERROR << logname << ": " << QCUtils::SysError(err) <<
+        KFS_LOG_EOM;
+        return -EIO;
+    }
+    committer->SetFd(fd);
+    if (appendFlag) {
+        md.SetStream(committer);
+    }
+    return 0;
+}
+
+/*!
+ * \brief close current log file; with group commit wait for the pending
+ * writes to complete first
+ * \return      0 if successful, negative on I/O error
+ */
+int
+Logger::closeLog()
+{
+    if (! committer) {
+        logf.close();
+        return (logf.fail() ? -EIO : 0);
+    }
+    seq_t     last;
+    int       status = committer->Sync(last) == 0 ? 0 : -EIO;
+    const int fd     = committer->GetFd();
+    committer->SetFd(-1);
+    if (0 <= fd && ::close(fd) != 0 && status == 0) {
+        status = -EIO;
+    }
+    return status;
+}
+
 /*!
  * \brief close current log file and begin a new one
  */
@@ -162,15 +581,24 @@ Logger::finishLog()
 {
     // if there has been no update to the log since the last roll, don't
     // roll the file over; otherwise, we'll have a file every N mins
+    if (committer) {
+        seq_t last = committed;
+        if (committer->Sync(last) != 0) {
+            panic("Logger::finishLog, sync", false);
+        }
+        committed = max(committed, last);
+    }
     if (incp == committed) {
         return 0;
     }
     logstream << "time/" << DisplayIsoDateTime() << '\n';
     logstream.flush();
     const string checksum = md.GetMd();
-    logf << "checksum/" << checksum << '\n';
-    logf.close();
-    if (fail()) {
+    ostream& os = committer ?
+        static_cast<ostream&>(*committer) : static_cast<ostream&>(logf);
+    os << "checksum/" << checksum << '\n';
+    os.flush();
+    if (closeLog() != 0 || fail()) {
         panic("Logger::finishLog, close", true);
     }
     if (link_latest(logname, LASTLOG)) {
@@ -258,6 +686,12 @@ logger_set_rotate_interval(int rotateIntervalSec)
     LogRotater::Instance().SetInterval(rotateIntervalSec);
 }
 
+void
+logger_set_parameters(const Properties& props)
+{
+    oplog.setParameters(props);
+}
+
 void
 logger_init(int rotateIntervalSec)
 {
@@ -38,6 +38,8 @@
 
 namespace KFS
 {
+class Properties;
+
 using std::string;
 using std::ostringstream;
 using std::ofstream;
@@ -51,6 +53,10 @@ using std::ofstream;
  *  the log rollover occurs, after we close the log file, we create a link from
  *  "LAST" to the recently closed log file.  This is used by the log compactor
  *  to determine the set of files that can be compacted.
+ *  - optional "group commit" mode, where the log records are written and
+ *  synced to disk by the dedicated log writer thread in batches; mutations are
+ *  dispatched to the sender only after the batch containing the corresponding
+ *  log record is on disk.
  */
 
 class Logger
@@ -66,13 +72,12 @@ public:
           logstream(md),
           nextseq(0),
           committed(0),
-          incp(0)
+          incp(0),
+          groupCommitFlag(false),
+          committer(0),
+          digestName()
         {}
-    ~Logger()
-    {
-        logstream.flush();
-        logf.close();
-    }
+    ~Logger();
     void setLogDir(const string &d)
     {
         logdir = d;
@@ -110,7 +115,10 @@ public:
         incp = committed = nextseq = last;
     }
     MdStream& getMdStream() { return md; }
+    void setParameters(const Properties& props);
 private:
+    class Committer;
+
     string   logdir;      //!< directory where logs are kept
     int      lognum;      //!< for generating log file names
     string   logname;     //!< name of current log file
@@ -120,15 +128,20 @@ private:
     seq_t    nextseq;     //!< next request sequence no.
     seq_t    committed;   //!< highest request known to be on disk
     seq_t    incp;        //!< highest request in a checkpoint
+    bool       groupCommitFlag; //!< use log writer thread
+    Committer* committer;       //!< log writer thread, group commit mode
+    string     digestName;      //!< new log segments digest, empty -- md5
     string genfile(int n) //!< generate a log file name
     {
         ostringstream f(ostringstream::out);
         f << n;
         return logdir + "/log." + f.str();
     }
-    bool fail() const { return (logf.fail() || md.fail()); }
+    bool fail() const;
     void flushLog();
     void flushResult(MetaRequest *r);
+    int openLog(bool appendFlag);
+    int closeLog();
 private:
     // No copy.
     Logger(const Logger&);
@@ -141,6 +154,7 @@ extern Logger oplog;
 extern void logger_setup_paths(const string& logdir);
 extern void logger_init(int rotateIntervalSec);
 extern void logger_set_rotate_interval(int rotateIntervalSec);
+extern void logger_set_parameters(const Properties& props);
 
 }
 #endif // !defined(KFS_LOGGER_H)
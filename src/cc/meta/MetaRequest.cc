@@ -41,6 +41,8 @@
 #include "kfsio/IOBufferWriter.h"
 #include "kfsio/DelegationToken.h"
 #include "kfsio/ChunkAccessToken.h"
+#include "kfsio/PrngIsaac64.h"
+#include "kfsio/ZlibDeflate.h"
 #include "common/MsgLogger.h"
 #include "common/RequestParser.h"
 #include "common/IntToString.h"
@@ -48,6 +50,8 @@
 #include "qcdio/qcstutils.h"
 #include "common/time.h"
 #include "common/kfserrno.h"
+#include "common/KfsTraceNew.h"
+#include "common/StatsDelta.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -73,6 +77,8 @@ using std::numeric_limits;
 using KFS::libkfsio::globals;
 
 static bool    gWormMode = false;
+static bool    gStandbyMode = false;
+static time_t  gStandbyReplayTime = 0;
 static string  gChunkmapDumpDir(".");
 static const char* const ftypes[] = { "empty", "file", "dir" };
 
@@ -129,6 +135,81 @@ setWORMMode(bool value)
     gWormMode = value;
 }
 
+/*
+ * Set hot standby mode. In standby mode the tree is updated only by the
+ * transaction log replay, all mutations are rejected, and only the clients
+ * that explicitly accept bounded staleness are allowed to read.
+ */
+void
+setStandbyMode(bool value)
+{
+    gStandbyMode = value;
+}
+
+bool
+getStandbyMode()
+{
+    return gStandbyMode;
+}
+
+/*
+ * Set the time up to which the standby tree is known to be current.
+ */
+void
+setStandbyReplayTime(time_t value)
+{
+    gStandbyReplayTime = value;
+}
+
+/*
+ * Returns false and sets request status, if the request cannot be executed
+ * in standby mode.
+ */
+static bool
+IsStandbyRequestAllowed(MetaRequest& r)
+{
+    if (! gStandbyMode) {
+        return true;
+    }
+    switch (r.op) {
+        case META_LOOKUP:
+        case META_LOOKUP_PATH:
+        case META_LOOKUP_BATCH:
+        case META_GETALLOC:
+        case META_GETLAYOUT:
+        case META_READDIR:
+        case META_READDIRPLUS:
+        case META_GETPATHNAME:
+            if (r.maxStalenessSec < 0) {
+                r.status    = -EROFS;
+                r.statusMsg = "standby: max staleness is not specified";
+                return false;
+            }
+            if (r.maxStalenessSec <
+                    globalNetManager().Now() - gStandbyReplayTime) {
+                r.status    = -EAGAIN;
+                r.statusMsg = "standby: max staleness exceeded";
+                return false;
+            }
+            return true;
+        case META_PING:
+        case META_STATS:
+        case META_GET_REQUEST_COUNTERS:
+        case META_AUTHENTICATE:
+        case META_DISCONNECT:
+        case META_NOOP:
+            return true;
+        default:
+            break;
+    }
+    if (r.mutation || r.fromClientSMFlag) {
+        r.status    = -EROFS;
+        r.statusMsg = "standby";
+        return false;
+    }
+    return true;
+}
+
 void
 setChunkmapDumpDir(string d)
 {
@@ -290,6 +371,13 @@ FattrReply(const MetaFattr* fa, MFattr& ofa)
         return;
     }
     ofa = *fa;
+    fid_t      container;
+    chunkOff_t offset;
+    if (metatree.getPackedExtent(*fa, container, offset)) {
+        ofa.packedContainer() = container;
+        ofa.packedOffset()    = offset;
+        return;
+    }
     // Keep the following to handle purely theoretical case: "re-open" file
     // for append. Normal append now does not attempt to calculate "the actual"
     // file size as append files are sparse anyway, and always sets file size
@@ -352,11 +440,19 @@ FattrReply(ostream& os, const MFattr& fa, const UserAndGroupNames* ugn)
     "Type: "        << ftypes[fa.type] << "\r\n"
     "File-size: "   << fa.filesize     << "\r\n"
     "Replication: " << fa.numReplicas  << "\r\n";
-    if (fa.type == KFS_FILE) {
+    if (fa.type == KFS_FILE && fa.packedFlag) {
+        os <<
+        "Chunk-count: 0\r\n"
+        "Packed-container: " << fa.packedContainer() << "\r\n"
+        "Packed-offset: "    << fa.packedOffset()    << "\r\n";
+    } else if (fa.type == KFS_FILE) {
         os << "Chunk-count: " << fa.chunkcount() << "\r\n";
         if (0 == fa.numReplicas) {
             os << "Next-chunk-pos: " << fa.nextChunkOffset() << "\r\n";
         }
+        if (KFS_COMPRESSION_NONE != fa.compression) {
+            os << "Compression: " << fa.compression << "\r\n";
+        }
     } else if (fa.type == KFS_DIR) {
         os <<
         "File-count: " << fa.fileCount() << "\r\n"
@@ -370,7 +466,7 @@ FattrReply(ostream& os, const MFattr& fa, const UserAndGroupNames* ugn)
         "Striper-type: "         << int32_t(fa.striperType) << "\r\n"
         "Num-stripes: "          << fa.numStripes           << "\r\n"
         "Num-recovery-stripes: " << fa.numRecoveryStripes   << "\r\n"
-        "Stripe-size: "          << fa.stripeSize           << "\r\n";
+        "Stripe-size: "          << fa.stripeSize()         << "\r\n";
     }
     os <<
     "User: "  << fa.user  << "\r\n"
@@ -532,16 +628,62 @@ CheckIfIoBuffersAvailable()
     }
 }
 
+static int64_t sMaxSubTreeAttrChangeEntries = 64 << 10;
+
 void
 SetRequestParameters(const Properties& props)
 {
     sBuffersWaitQueue.SetParameters(props, "metaServer.buffersWaitQueue.");
+    sMaxSubTreeAttrChangeEntries = max(int64_t(1), props.getValue(
+        "metaServer.maxSubTreeAttrChangeEntries",
+        sMaxSubTreeAttrChangeEntries));
+}
+
+template<typename T>
+static void
+ChangeSubTreeAttr(T& req, MetaFattr* fa, kfsMode_t mode,
+    kfsUid_t user, kfsGid_t group)
+{
+    req.maxEntries = sMaxSubTreeAttrChangeEntries;
+    req.nextCursor = req.cursor;
+    size_t count       = 0;
+    size_t failedCount = 0;
+    req.status = metatree.changeSubTreeAttr(fa, mode, user, group, req.euser,
+        (size_t)req.maxEntries, req.nextCursor, count, failedCount);
+    req.count       = (int64_t)count;
+    req.failedCount = (int64_t)failedCount;
+    if (req.status == -EAGAIN) {
+        req.statusMsg = "cursor entry no longer exists";
+    } else if (req.status == -EINVAL) {
+        req.statusMsg = "invalid cursor";
+    }
+}
+
+template<typename T>
+static ostream&
+SubTreeAttrReply(ostream& os, const T& req)
+{
+    if (! req.recursiveFlag) {
+        return os;
+    }
+    os <<
+        "Count: "          << req.count                      << "\r\n"
+        "Failed-count: "   << req.failedCount                << "\r\n"
+        "Recursive-done: " << (req.nextCursor.empty() ? 1 : 0) << "\r\n"
+    ;
+    if (! req.nextCursor.empty()) {
+        os << "Cursor: " << req.nextCursor << "\r\n";
+    }
+    return os;
 }
 
 static bool
 HasEnoughIoBuffersForResponse(MetaRequest& req)
 {
-    return (! sBuffersWaitQueue.SuspendIfNeeded(req));
+    // Concurrent read only requests never suspended, the io buffers
+    // availability is checked by ReadOnlyRequestContext::IsConcurrent().
+    return (ReadOnlyRequestContext::GetCurrent() ||
+        ! sBuffersWaitQueue.SuspendIfNeeded(req));
 }
 
 class ResponseWOStream : private IOBuffer::WOStream
@@ -588,6 +730,64 @@ MetaLookupPath::handle()
     }
 }
 
+bool
+MetaLookupBatch::Validate()
+{
+    entries.clear();
+    if (numEntries < 0 || (int)entriesStr.size() < numEntries) {
+        status    = -EINVAL;
+        statusMsg = "invalid number of entries";
+        return true;
+    }
+    entries.reserve(numEntries);
+    const char*       ptr = entriesStr.data();
+    const char* const end = ptr + entriesStr.size();
+    while (ptr < end && (int)entries.size() < numEntries) {
+        fid_t dir = -1;
+        int   len = -1;
+        if (! DecIntParser::Parse(ptr, end - ptr, dir) ||
+                ! DecIntParser::Parse(ptr, end - ptr, len) ||
+                len <= 0 || end <= ptr || *ptr != ' ' ||
+                end - ptr - 1 < len) {
+            break;
+        }
+        ptr++;
+        entries.push_back(Entry());
+        Entry& entry = entries.back();
+        entry.dir = dir;
+        entry.name.assign(ptr, len);
+        ptr += len;
+        if (ptr < end && *ptr++ != ' ') {
+            break;
+        }
+    }
+    if (ptr < end || (int)entries.size() != numEntries) {
+        entries.clear();
+        status    = -EINVAL;
+        statusMsg = "invalid entries format";
+    }
+    entriesStr = string();
+    return true;
+}
+
+/* virtual */ void
+MetaLookupBatch::handle()
+{
+    if (status != 0) {
+        return;
+    }
+    SetEUserAndEGroup(*this);
+    for (Entries::iterator it = entries.begin(); it != entries.end(); ++it) {
+        MetaFattr* fa = 0;
+        if ((it->status = it->dir < 0 ?
+                metatree.lookupPath(ROOTFID, it->name, euser, egroup, fa) :
+                metatree.lookup(it->dir, it->name, euser, egroup, fa)
+                ) == 0) {
+            FattrReply(fa, it->fattr);
+        }
+    }
+}
+
 template<typename T> inline static bool
 CheckUserAndGroup(T& req)
 {
@@ -804,6 +1004,11 @@ MetaCreate::handle()
             "storage tier range is not supported with object store files";
         return;
     }
+    if (striperType != KFS_STRIPED_FILE_TYPE_NONE || 0 == numReplicas) {
+        // The compressed layout is only supported with replicated files, the
+        // response tells the client that the file is not compressed.
+        compression = KFS_COMPRESSION_NONE;
+    }
     if (! gLayoutManager.Validate(*this)) {
         if (0 <= status) {
             status = -EINVAL;
@@ -839,6 +1044,7 @@ MetaCreate::handle()
             minSTier = fa->minSTier;
             maxSTier = fa->maxSTier;
         }
+        fa->compression = (uint32_t)compression;
     }
 }
 
@@ -933,12 +1139,22 @@ MetaRmdir::handle()
         return;
     }
     mtime = microseconds();
-    status = metatree.rmdir(dir, name, pathname, euser, egroup, mtime);
+    todumpster = -1;
+    if (recursiveFlag) {
+        status = metatree.rmdirRecursive(dir, name, pathname, euser, egroup,
+            todumpster, mtime);
+    } else {
+        status = metatree.rmdir(dir, name, pathname, euser, egroup, mtime);
+    }
 }
 
 static vector<MetaDentry*>&
 GetReadDirTmpVec()
 {
+    ReadOnlyRequestContext* const ctx = ReadOnlyRequestContext::GetCurrent();
+    if (ctx) {
+        return ctx->GetReadDirTmpVec();
+    }
     static vector<MetaDentry*> sReaddirRes;
     sReaddirRes.clear();
     sReaddirRes.reserve(1024);
@@ -1048,19 +1264,6 @@ public:
     }
 };
 
-class ListServerLocations
-{
-    ostream& os;
-public:
-    ListServerLocations(ostream &out)
-        : os(out)
-        {}
-    void operator()(const ServerLocation& s) const
-    {
-        os << " " << s;
-    }
-};
-
 template<bool ShortFormatFlag>
 class ReaddirPlusWriter
 {
@@ -1116,6 +1319,9 @@ private:
     static const PropName kSRecov;
     static const PropName kSSize;
     static const PropName kCCnt;
+    static const PropName kPackedC;
+    static const PropName kPackedO;
+    static const PropName kCompr;
     static const PropName kFSize;
     static const PropName kRepl;
     static const PropName kUser;
@@ -1281,10 +1487,19 @@ private:
             Write(kSRecov);
             WriteInt(entry.numRecoveryStripes);
             Write(kSSize);
-            WriteInt(entry.stripeSize);
+            WriteInt(entry.stripeSize());
         }
         Write(kCCnt);
-        WriteInt(entry.chunkcount());
+        WriteInt(entry.packedFlag ? int64_t(0) : entry.chunkcount());
+        if (entry.packedFlag) {
+            Write(kPackedC);
+            WriteInt(entry.packedContainer());
+            Write(kPackedO);
+            WriteInt(entry.packedOffset());
+        } else if (KFS_COMPRESSION_NONE != entry.compression) {
+            Write(kCompr);
+            WriteInt(int(entry.compression));
+        }
         Write(kFSize);
         WriteInt(entry.filesize);
         Write(kRepl);
@@ -1298,6 +1513,7 @@ private:
         }
         if (omitLastChunkInfoFlag ||
                 entry.type == KFS_DIR || entry.IsStriped() ||
+                entry.packedFlag ||
                 (getLastChunkInfoOnlyIfSizeUnknown &&
                 entry.filesize >= 0)) {
             Write(kNL);
@@ -1408,6 +1624,15 @@ template<bool F> const typename ReaddirPlusWriter<F>::PropName
 template<bool F> const typename ReaddirPlusWriter<F>::PropName
     ReaddirPlusWriter<F>::kCCnt(
     "\nCC:" , "\r\nChunk-count: ");
+template<bool F> const typename ReaddirPlusWriter<F>::PropName
+    ReaddirPlusWriter<F>::kPackedC(
+    "\nPC:" , "\r\nPacked-container: ");
+template<bool F> const typename ReaddirPlusWriter<F>::PropName
+    ReaddirPlusWriter<F>::kPackedO(
+    "\nPO:" , "\r\nPacked-offset: ");
+template<bool F> const typename ReaddirPlusWriter<F>::PropName
+    ReaddirPlusWriter<F>::kCompr(
+    "\nCM:" , "\r\nCompression: ");
 template<bool F> const typename ReaddirPlusWriter<F>::PropName
     ReaddirPlusWriter<F>::kFSize(
     "\nS:"  , "\r\nFile-size: ");
@@ -1517,9 +1742,16 @@ MetaReaddirPlus::handle()
     maxRespSize = max(0, gLayoutManager.GetMaxResponseSize());
     const int    extSize = IOBufferData::GetDefaultBufferSize() +
         int(MAX_FILE_NAME_LENGTH);
-    const size_t maxSize =
+    size_t       maxSize =
         (size_t)((numEntries >= 0 && extSize * 2 < maxRespSize) ?
         maxRespSize - extSize : maxRespSize);
+    // Paged listing: limit the page size, in order to bound the memory used
+    // by the response, and the time spent building it. The client resumes
+    // listing with the last returned entry name.
+    const int pageSize = gLayoutManager.GetReadDirPlusMaxPageSize();
+    if (numEntries >= 0 && 0 < pageSize && (size_t)pageSize < maxSize) {
+        maxSize = (size_t)pageSize;
+    }
     dentries.reserve(res.size());
     const size_t avgEntrySz[] = {
         148, 272, 64,
@@ -1550,8 +1782,18 @@ MetaReaddirPlus::handle()
         responseSize += name.length() + (fa->type == KFS_DIR ?
             avgDirExtraSize : avgFileExtraSize);
         dentries.push_back(DEntry(*fa, name));
+        if (fa->packedFlag) {
+            DEntry&    de = dentries.back();
+            fid_t      container;
+            chunkOff_t offset;
+            if (metatree.getPackedExtent(*fa, container, offset)) {
+                de.packedContainer() = container;
+                de.packedOffset()    = offset;
+            }
+        }
         if (omitLastChunkInfoFlag || fileIdAndTypeOnlyFlag ||
                 noAttrsFlag || fa->type == KFS_DIR || fa->IsStriped() ||
+                fa->packedFlag ||
                 (getLastChunkInfoOnlyIfSizeUnknown &&
                 fa->filesize >= 0)) {
             continue;
@@ -1619,7 +1861,8 @@ MetaGetalloc::handle()
     }
     MetaFattr* fa  = 0;
     int        err = 0;
-    Servers    c;
+    Servers&   c   = servers;
+    c.clear();
     replicasOrderedFlag = false;
     if (objectStoreFlag) {
         if (! (fa = metatree.getFattr(fid))) {
@@ -1664,18 +1907,20 @@ MetaGetalloc::handle()
         chunkId      = chunkInfo->chunkId;
         chunkVersion = chunkInfo->chunkVersion;
         err = gLayoutManager.GetChunkToServerMapping(
-            *chunkInfo, c, fa, &replicasOrderedFlag);
+            *chunkInfo, c, fa, &replicasOrderedFlag, &clientIp);
         if (! fa) {
             panic("invalid chunk to server map", false);
         }
     }
     if (! CanAccessFile(fa, *this)) {
+        c.clear();
         return;
     }
     if (! fromChunkServerFlag && gLayoutManager.VerifyAllOpsPermissions()) {
         SetEUserAndEGroup(*this);
         if (! fa->CanRead(euser, egroup)) {
             status = -EACCES;
+            c.clear();
             return;
         }
     }
@@ -1688,10 +1933,15 @@ MetaGetalloc::handle()
             "<" << fid << "," << chunkId << "," << offset << ">"
             " " << statusMsg <<
         KFS_LOG_EOM;
+        c.clear();
         return;
     }
-    locations.reserve(c.size());
-    for_each(c.begin(), c.end(), EnumerateLocations(locations));
+    if (! objectStoreFlag && ! fromChunkServerFlag &&
+            ! ReadOnlyRequestContext::GetCurrent()) {
+        // With concurrent execution the file heat is updated by
+        // ReadOnlyRequestContext::Done(), as the heat map is not re-entrant.
+        gLayoutManager.UpdateFileHeat(fid);
+    }
     status = 0;
 }
 
@@ -1755,7 +2005,8 @@ MetaGetlayout::handle()
     if ((hasMoreChunksFlag = maxResCnt > 0 && maxResCnt < numChunks)) {
         numChunks = maxResCnt;
     }
-    ostream&        os     = sWOStream.Set(resp);
+    ReadOnlyRequestContext* const ctx = ReadOnlyRequestContext::GetCurrent();
+    ostream&        os     = ctx ? ctx->SetWOStream(resp) : sWOStream.Set(resp);
     const char*     prefix = "";
     Servers         c;
     ChunkLayoutInfo l;
@@ -1767,7 +2018,9 @@ MetaGetlayout::handle()
         if (! omitLocationsFlag) {
             MetaFattr* cfa = 0;
             const int  err = gLayoutManager.GetChunkToServerMapping(
-                *(chunkInfo[i]), c, cfa);
+                *(chunkInfo[i]), c, cfa,
+                orderReplicasFlag ? &replicasOrderedFlag : 0,
+                orderReplicasFlag ? &clientIp : 0);
             assert(! fa || cfa == fa);
             if (err && ! continueIfNoReplicasFlag) {
                 resp.Clear();
@@ -1790,7 +2043,11 @@ MetaGetlayout::handle()
         status    = -ENOMEM;
         statusMsg = "response exceeds max. size";
     }
-    sWOStream.Reset();
+    if (ctx) {
+        ctx->ResetWOStream();
+    } else {
+        sWOStream.Reset();
+    }
 }
 
 /* virtual */ bool
@@ -2478,6 +2735,121 @@ MetaChangeFileReplication::handle()
     }
 }
 
+/* virtual */ void
+MetaPackFile::handle()
+{
+    MetaFattr* const fa  = metatree.getFattr(fid);
+    MetaFattr* const cfa = metatree.getFattr(containerFid);
+    if (! CanAccessFile(fa, *this) || ! CanAccessFile(cfa, *this)) {
+        return;
+    }
+    SetEUserAndEGroup(*this);
+    status = metatree.pack(fa, cfa, containerOffset, fileSize,
+        expectedContainer, euser, egroup);
+    if (status == -EFBIG) {
+        statusMsg = "file is too large to be packed";
+    } else if (status == -EBUSY) {
+        statusMsg = "file has chunk write lease";
+    } else if (status == -EINVAL && statusMsg.empty()) {
+        statusMsg = "invalid file, container, or extent";
+    }
+}
+
+/* virtual */ void
+MetaCopyChunk::handle()
+{
+    if (layoutDone) {
+        return;
+    }
+    if (gWormMode) {
+        statusMsg = "worm mode";
+        status    = -EPERM;
+        return;
+    }
+    SetEUserAndEGroup(*this);
+    MetaFattr* const sfa = metatree.getFattr(srcFid);
+    if (! CanAccessFile(sfa, *this)) {
+        return;
+    }
+    if (KFS_DIR == sfa->type) {
+        status = -EISDIR;
+        return;
+    }
+    if (0 == sfa->numReplicas || sfa->IsStriped() || sfa->packedFlag) {
+        status    = -EINVAL;
+        statusMsg = "source must be non striped replicated file";
+        return;
+    }
+    if (! sfa->CanRead(euser, egroup)) {
+        status = -EACCES;
+        return;
+    }
+    if (srcOffset % (chunkOff_t)CHUNKSIZE != 0 ||
+            offset % (chunkOff_t)CHUNKSIZE != 0) {
+        status    = -EINVAL;
+        statusMsg = "offset is not chunk aligned";
+        return;
+    }
+    MetaChunkInfo* ci = 0;
+    if (metatree.getalloc(srcFid, srcOffset, &ci) != 0 || ! ci) {
+        // Nothing to copy, the source file has no chunk at this offset.
+        chunkId = -1;
+        status  = 0;
+        return;
+    }
+    srcChunkId = ci->chunkId;
+    MetaFattr* fa              = 0;
+    int16_t    numReplicas     = 0;
+    bool       stripedFileFlag = false;
+    chunkId = 0;
+    status = metatree.allocateChunkId(
+        fid, offset,
+        &chunkId,
+        &chunkVersion,
+        &numReplicas,
+        &stripedFileFlag,
+        0,
+        0,
+        euser,
+        egroup,
+        &fa
+    );
+    if (0 == status && (0 == numReplicas || stripedFileFlag)) {
+        status    = -EINVAL;
+        statusMsg = "destination must be non striped replicated file";
+    }
+    if (0 != status) {
+        if (-EEXIST == status) {
+            statusMsg = "destination chunk exists";
+        }
+        chunkId = -1;
+        return;
+    }
+    minSTier = fa->minSTier;
+    maxSTier = fa->maxSTier;
+    if ((status = gLayoutManager.CopyChunk(*this)) != 0) {
+        chunkId = -1;
+        return;
+    }
+    // Chunk copy completion can be invoked synchronously, if the request
+    // send fails, in which case the request is not suspended.
+    suspended = ! layoutDone;
+}
+
+void
+MetaCopyChunk::LayoutDone()
+{
+    const bool wasSuspended = suspended;
+    suspended  = false;
+    layoutDone = true;
+    if (0 != status) {
+        chunkId = -1;
+    }
+    if (wasSuspended) {
+        submit_request(this);
+    }
+}
+
 /*
  * Move chunks from src file into the end chunk boundary of the dst file.
  */
@@ -2585,6 +2957,71 @@ MetaLeaseRenew::handle()
     status = gLayoutManager.LeaseRenew(this);
 }
 
+bool
+MetaLeaseRenewBatch::Validate()
+{
+    entries.clear();
+    if (numEntries < 0 || (int)entriesStr.size() < numEntries) {
+        status    = -EINVAL;
+        statusMsg = "invalid number of entries";
+        return true;
+    }
+    entries.reserve(numEntries);
+    const char*       ptr = entriesStr.data();
+    const char* const end = ptr + entriesStr.size();
+    while (ptr < end && (int)entries.size() < numEntries) {
+        Entry entry;
+        if (! DecIntParser::Parse(ptr, end - ptr, entry.chunkId) ||
+                ! DecIntParser::Parse(ptr, end - ptr, entry.leaseId) ||
+                ! DecIntParser::Parse(ptr, end - ptr, entry.chunkPos)) {
+            break;
+        }
+        entries.push_back(entry);
+    }
+    while (ptr < end && (*ptr & 0xFF) <= ' ') {
+        ptr++;
+    }
+    if (ptr < end || (int)entries.size() != numEntries) {
+        entries.clear();
+        status    = -EINVAL;
+        statusMsg = "invalid entries format";
+    }
+    entriesStr = string();
+    return true;
+}
+
+/* virtual */ void
+MetaLeaseRenewBatch::handle()
+{
+    if (status != 0) {
+        return;
+    }
+    if (gLayoutManager.IsClientCSAuthRequired() && authUid != kKfsUserNone) {
+        // Chunk access must be returned with each renew.
+        status    = -EPERM;
+        statusMsg = "batch renew is not supported with chunk server"
+            " client authentication";
+        return;
+    }
+    if (gLayoutManager.VerifyAllOpsPermissions()) {
+        SetEUserAndEGroup(*this);
+    }
+    MetaLeaseRenew req;
+    req.leaseType        = READ_LEASE;
+    req.fromClientSMFlag = fromClientSMFlag;
+    req.clientIp         = clientIp;
+    req.euser            = euser;
+    req.egroup           = egroup;
+    for (Entries::iterator it = entries.begin(); it != entries.end(); ++it) {
+        req.status    = 0;
+        req.statusMsg.clear();
+        req.chunkId   = it->chunkId;
+        req.leaseId   = it->leaseId;
+        req.chunkPos  = it->chunkPos;
+        it->status = gLayoutManager.LeaseRenew(&req);
+    }
+}
+
 /* virtual */ void
 MetaLeaseRelinquish::handle()
 {
@@ -2609,11 +3046,200 @@ MetaLeaseCleanup::handle()
     // Checkpoints from the forked copy should alleviate the problem.
     // Defer this for now assuming that checkpoints from forked copy is
     // the default operating mode.
-    metatree.cleanupDumpster();
-    metatree.cleanupPathToFidCache();
+    metatree.cleanupDumpster(gLayoutManager.GetDumpsterCleanupMaxEntries());
     status = 0;
 }
 
+// Trash checkpoint directory name format, must match tools/Trash.cc.
+const char* const kTrashCheckpointFormatPtr = "%y%m%d%H%M";
+
+static inline bool
+IsValidTrashName(const string& name)
+{
+    return (! name.empty() && name != "." && name != ".." &&
+        name.find('/') == string::npos);
+}
+
+void
+MetaTrashExpire::SetParameters(const Properties& props)
+{
+    homesPrefix = props.getValue(
+        "metaServer.trash.homesPrefix", homesPrefix);
+    trashName = props.getValue(
+        "metaServer.trash.trash", trashName);
+    currentName = props.getValue(
+        "metaServer.trash.current", currentName);
+    intervalSec = props.getValue(
+        "metaServer.trash.interval", intervalSec);
+    maxHomesPerRun = max(1, props.getValue(
+        "metaServer.trash.maxHomesPerRun", maxHomesPerRun));
+    maxExpirePerRun = max(1, props.getValue(
+        "metaServer.trash.maxExpirePerRun", maxExpirePerRun));
+    if (0 < intervalSec && (homesPrefix.empty() || homesPrefix[0] != '/' ||
+            ! IsValidTrashName(trashName) ||
+            ! IsValidTrashName(currentName))) {
+        KFS_LOG_STREAM_ERROR <<
+            "invalid trash parameters:"
+            " homes: "   << homesPrefix <<
+            " trash: "   << trashName <<
+            " current: " << currentName <<
+            " trash emptier disabled" <<
+        KFS_LOG_EOM;
+        intervalSec = 0;
+    }
+    nextPassTime = min(nextPassTime, globalNetManager().Now() + intervalSec);
+}
+
+/*!
+ * \brief Expire the trash checkpoints of the home directory, and checkpoint
+ * the current trash directory.
+ * \return false if max number of expired checkpoints reached.
+ */
+bool
+MetaTrashExpire::ExpireHome(fid_t home, time_t now, int& expireCount)
+{
+    MetaFattr* trash = 0;
+    if (metatree.lookup(home, trashName,
+                kKfsUserRoot, kKfsGroupRoot, trash) != 0 ||
+            trash->type != KFS_DIR) {
+        return true;
+    }
+    const fid_t         dir     = trash->id();
+    const time_t        expTime = now - intervalSec;
+    const size_t        kTimeStampLen = size_t(2) * 5;
+    vector<MetaDentry*> entries;
+    metatree.readdir(dir, entries);
+    for (vector<MetaDentry*>::const_iterator it = entries.begin();
+            it != entries.end();
+            ++it) {
+        if ((*it)->getFattr()->type != KFS_DIR) {
+            continue;
+        }
+        const string name = (*it)->getName();
+        if (name == "." || name == ".." ||
+                (name.length() != kTimeStampLen &&
+                (name.length() < kTimeStampLen ||
+                    name[kTimeStampLen] != '.'))) {
+            continue;
+        }
+        struct tm         localTime = { 0 };
+        const char* const ptr       = strptime(
+            name.c_str(), kTrashCheckpointFormatPtr, &localTime);
+        if (! ptr || ptr != name.c_str() + kTimeStampLen) {
+            continue;
+        }
+        const time_t time = mktime(&localTime);
+        if (time == time_t(-1) || expTime < time) {
+            continue;
+        }
+        if (maxExpirePerRun <= expireCount) {
+            return false;
+        }
+        fid_t     todumpster = -1;
+        const int ret        = metatree.rmdirRecursive(dir, name, string(),
+            kKfsUserRoot, kKfsGroupRoot, todumpster, mtime);
+        if (ret != 0) {
+            KFS_LOG_STREAM_ERROR << "trash expire:"
+                " dir: "    << dir <<
+                " name: "   << name <<
+                " status: " << ret <<
+            KFS_LOG_EOM;
+            continue;
+        }
+        expireCount++;
+        actions.push_back(Action(dir, name, 0 < todumpster ?
+            Tree::getDumpsterPath(name, todumpster) : string()));
+    }
+    MetaFattr* current = 0;
+    if (metatree.lookup(dir, currentName,
+            kKfsUserRoot, kKfsGroupRoot, current) != 0) {
+        return true;
+    }
+    char      buf[128];
+    struct tm localTime = { 0 };
+    if (! localtime_r(&now, &localTime) ||
+            strftime(buf, sizeof(buf) / sizeof(buf[0]),
+                kTrashCheckpointFormatPtr, &localTime) <= 0) {
+        return true;
+    }
+    string       name = buf;
+    const size_t len  = name.length();
+    for (int k = 0; metatree.getDentry(dir, name); ) {
+        name.resize(len);
+        name += '.';
+        AppendDecIntToString(name, ++k);
+    }
+    fid_t     todumpster = -1;
+    const int ret        = metatree.rename(dir, currentName, name, string(),
+        false, todumpster, kKfsUserRoot, kKfsGroupRoot, mtime);
+    if (ret == 0) {
+        actions.push_back(Action(dir, currentName, name));
+    } else {
+        KFS_LOG_STREAM_ERROR << "trash checkpoint:"
+            " dir: "    << dir <<
+            " name: "   << name <<
+            " status: " << ret <<
+        KFS_LOG_EOM;
+    }
+    return true;
+}
+
+/* virtual */ void
+MetaTrashExpire::handle()
+{
+    actions.clear();
+    // Nothing to log, unless the tree is changed.
+    status = -EAGAIN;
+    const time_t now = globalNetManager().Now();
+    if (intervalSec <= 0 || gWormMode || now < nextPassTime) {
+        return;
+    }
+    MetaFattr* homes = 0;
+    if (metatree.lookupPath(ROOTFID, homesPrefix,
+                kKfsUserRoot, kKfsGroupRoot, homes) != 0 ||
+            homes->type != KFS_DIR) {
+        homeCursor.clear();
+        nextPassTime = now + intervalSec;
+        return;
+    }
+    mtime = microseconds();
+    vector<MetaDentry*> entries;
+    bool                moreFlag = false;
+    if (homeCursor.empty()) {
+        metatree.readdir(homes->id(), entries, maxHomesPerRun + 2, &moreFlag);
+    } else if (metatree.readdir(homes->id(), homeCursor, entries,
+            maxHomesPerRun, moreFlag) != 0) {
+        // The home directory no longer exists, restart the pass.
+        homeCursor.clear();
+        return;
+    }
+    int  expireCount = 0;
+    bool doneFlag    = true;
+    for (vector<MetaDentry*>::const_iterator it = entries.begin();
+            it != entries.end();
+            ++it) {
+        const string& name = (*it)->getName();
+        if (name == "." || name == "..") {
+            continue;
+        }
+        MetaFattr* const fa = (*it)->getFattr();
+        if (fa->type == KFS_DIR && ! ExpireHome(fa->id(), now, expireCount)) {
+            // Resume with this home directory.
+            doneFlag = false;
+            break;
+        }
+        homeCursor = name;
+    }
+    if (doneFlag && ! moreFlag) {
+        homeCursor.clear();
+        nextPassTime = now + intervalSec;
+    }
+    if (! actions.empty()) {
+        status = 0;
+        KFS_LOG_STREAM_INFO << Show() << KFS_LOG_EOM;
+    }
+}
+
 class PrintChunkServerLocations {
     ostream &os;
 public:
@@ -2681,7 +3307,7 @@ MetaChmod::handle()
         status = -ENOENT;
         return;
     }
-    if (! IsValidMode(mode, fa->type == KFS_DIR)) {
+    if (! IsValidMode(mode, recursiveFlag || fa->type == KFS_DIR)) {
         status = -EINVAL;
         return;
     }
@@ -2690,6 +3316,10 @@ MetaChmod::handle()
         status = -EACCES;
         return;
     }
+    if (recursiveFlag) {
+        ChangeSubTreeAttr(*this, fa, mode, kKfsUserNone, kKfsGroupNone);
+        return;
+    }
     status = 0;
     fa->mode = mode;
 }
@@ -2723,6 +3353,10 @@ MetaChown::handle()
             return;
         }
     }
+    if (recursiveFlag) {
+        ChangeSubTreeAttr(*this, fa, kKfsModeUndef, user, group);
+        return;
+    }
     status = 0;
     if (user != kKfsUserNone) {
         fa->user = user;
@@ -2789,6 +3423,19 @@ MetaChunkDirInfo::handle()
     }
 }
 
+/* virtual */ void
+MetaTierMigrate::handle()
+{
+    actions.clear();
+    // Nothing to log, unless file storage tiers are changed.
+    status = -EAGAIN;
+    gLayoutManager.Handle(*this);
+    if (! actions.empty()) {
+        status = 0;
+        KFS_LOG_STREAM_INFO << Show() << KFS_LOG_EOM;
+    }
+}
+
 /* virtual */ void
 MetaChunkReplicationCheck::handle()
 {
@@ -2850,6 +3497,10 @@ MetaChunkSize::handle()
 /* virtual */ void
 MetaChunkReplicate::handle()
 {
+    if (copyChunk) {
+        gLayoutManager.ChunkCopyDone(this);
+        return;
+    }
     gLayoutManager.ChunkReplicationDone(this);
 }
 
@@ -2857,9 +3508,11 @@ MetaChunkReplicate::handle()
 MetaChunkReplicate::ShowSelf(ostream& os) const
 {
     return os <<
-        (numRecoveryStripes > 0 ? "recover" : "replicate:") <<
+        (numRecoveryStripes > 0 ? "recover" :
+            (0 <= srcChunkId ? "copy:" : "replicate:")) <<
         " chunk: "        << chunkId <<
         " version: "      << chunkVersion <<
+        " src chunk: "    << srcChunkId <<
         " file: "         << fid <<
         " fileSize: "     << fileSize <<
         " path: "         << pathname <<
@@ -2883,6 +3536,38 @@ MetaPing::handle()
 
 }
 
+/* virtual */ void
+MetaNoop::handle()
+{
+    status = 0;
+}
+
+/* virtual */ void
+MetaHeapProfile::handle()
+{
+    if (! HasMetaServerAdminAccess(*this)) {
+        return;
+    }
+    if (! KfsTraceNewHeapProfileIsAvailable()) {
+        status    = -ENOSYS;
+        statusMsg = "heap profiler is not available,"
+            " meta server is not linked with KfsTraceNew";
+        return;
+    }
+    if (0 <= sampleInterval) {
+        KfsTraceNewHeapProfileSetSampleInterval((size_t)sampleInterval);
+    }
+    size_t      theLen = 0;
+    char* const thePtr = KfsTraceNewHeapProfileGet(&theLen);
+    if (thePtr) {
+        resp.CopyIn(thePtr, (int)theLen);
+        free(thePtr);
+    }
+    if (resetFlag) {
+        KfsTraceNewHeapProfileReset();
+    }
+}
+
 /* virtual */ void
 MetaUpServers::handle()
 {
@@ -2959,6 +3644,36 @@ static int DoFork(int childTimeLimit)
     return ret;
 }
 
+// Run external program, the log compactor, with vfork(), in order to avoid
+// copying the page tables, and the copy on write page faults that fork()
+// results in with the large address space.
+static int SpawnProcess(const vector<string>& args, int childTimeLimit)
+{
+    if (args.empty()) {
+        return -EINVAL;
+    }
+    vector<char*> argv;
+    argv.reserve(args.size() + 1);
+    for (vector<string>::const_iterator it = args.begin();
+            it != args.end();
+            ++it) {
+        argv.push_back(const_cast<char*>(it->c_str()));
+    }
+    argv.push_back(0);
+    // The child shares the address space with the parent until exec, and must
+    // not modify any data.
+    const int ret = vfork();
+    if (ret == 0) {
+        signal(SIGALRM, SIG_DFL);
+        if (childTimeLimit > 0) {
+            alarm(childTimeLimit);
+        }
+        execvp(argv[0], &argv[0]);
+        _exit(127);
+    }
+    return (ret < 0 ? (errno > 0 ? -errno : -EIO) : ret);
+}
+
 /* virtual */ void
 MetaDumpChunkToServerMap::handle()
 {
@@ -3224,7 +3939,35 @@ MetaStats::handle()
     ostringstream& os = GetTmpOStringStream();
     status = 0;
     globals().counterManager.Show(os);
+    NetManager::EventStats mainStats;
+    NetManager::EventStats clientThreadsStats;
+    gNetDispatch.GetEventStats(mainStats, clientThreadsStats);
+    mainStats.Display(os, "Net-main-");
+    clientThreadsStats.Display(os, "Net-client-threads-");
+    MetaRequest::AllocatorStats allocStats;
+    MetaRequest::GetAllocatorStats(allocStats);
+    os <<
+        "Request-pool-storage: "       << allocStats.mStorageSize      << "\r\n"
+        "Request-pool-elements: "      << allocStats.mElemCount        << "\r\n"
+        "Request-pool-depot-free: "    << allocStats.mDepotFreeCount   << "\r\n"
+        "Request-pool-outstanding: "   << allocStats.mOutstandingCount << "\r\n"
+        "Request-pool-thread-caches: " << allocStats.mThreadCacheCount << "\r\n"
+        "Request-pool-refills: "       << allocStats.mRefillCount      << "\r\n"
+        "Request-pool-trims: "         << allocStats.mTrimCount        << "\r\n"
+    ;
+    if (MetaRequestPhaseStats::IsEnabled()) {
+        // Large, over 100KB, allocate on the heap.
+        MetaRequestPhaseStats* const phaseStats = new MetaRequestPhaseStats();
+        gNetDispatch.GetRequestPhaseStats(*phaseStats);
+        phaseStats->Display(os, "Request-phase-");
+        delete phaseStats;
+    }
     stats = os.str();
+    if (deltaId != 0) {
+        static StatsDelta sStatsDelta;
+        deltaGen = sStatsDelta.Encode(deltaId, deltaGen,
+            globalNetManager().Now(), stats, deltaFullFlag);
+    }
 }
 
 /* virtual */ void
@@ -3347,7 +4090,8 @@ MetaCheckpoint::handle()
             " done; status: " << status <<
             " failures: "     << failedCount <<
         KFS_LOG_EOM;
-        if (status < 0) {
+        // The child exit status is positive on failure.
+        if (status != 0) {
             failedCount++;
         } else {
             failedCount = 0;
@@ -3419,6 +4163,61 @@ MetaCheckpoint::handle()
         return;
     }
     runningCheckpointId = oplog.checkpointed();
+    if (! logCompactor.empty()) {
+        // The log compactor creates the checkpoint from the last checkpoint,
+        // and the logs up to and including the log that was just finished.
+        // The logs contain all mutations up to this point, therefore the
+        // resulting checkpoint is the same as the one written by the child.
+        vector<string> args;
+        args.push_back(logCompactor);
+        args.push_back("-l");
+        args.push_back(LOGDIR);
+        args.push_back("-c");
+        args.push_back(CPDIR);
+        args.push_back("-s");
+        args.push_back(checkpointWriteSyncFlag ? "1" : "0");
+        args.push_back("-B");
+        args.push_back(string());
+        AppendDecIntToString(args.back(), checkpointWriteBufferSize);
+        if (checkpointWriteBinaryFlag) {
+            args.push_back("-b");
+        }
+        args.push_back("-t");
+        args.push_back(string());
+        AppendDecIntToString(args.back(), checkpointRestoreThreadCount);
+        args.push_back("-w");
+        args.push_back(string());
+        AppendDecIntToString(args.back(), checkpointWriteThreadCount);
+        args.push_back("-z");
+        args.push_back(string());
+        AppendDecIntToString(args.back(), checkpointCompressionLevel);
+        args.push_back("-Z");
+        args.push_back(string());
+        AppendDecIntToString(args.back(), checkpointCompressionBlockSize);
+        if (! checkpointDigest.empty()) {
+            args.push_back("-D");
+            args.push_back(checkpointDigest);
+        }
+        pid = SpawnProcess(args, checkpointWriteTimeoutSec);
+        KFS_LOG_STREAM(pid > 0 ?
+                MsgLogger::kLogLevelINFO :
+                MsgLogger::kLogLevelERROR) <<
+            "checkpoint: "    << lastCheckpointId <<
+            " log compactor: " << logCompactor <<
+            " pid: "          << pid <<
+        KFS_LOG_EOM;
+        if (pid < 0) {
+            status = -1;
+            runningCheckpointId = -1;
+            if (lockFd >= 0) {
+                close(lockFd);
+            }
+            return;
+        }
+        suspended = true;
+        gChildProcessTracker.Track(pid, this);
+        return;
+    }
     // DoFork() / PrepareCurrentThreadToFork() releases and re-acquires the
     // global mutex by waiting on condition with this mutex, but must ensure
     // that no other RPC gets processed. If checkpoint mutation count isn't
@@ -3433,6 +4232,11 @@ MetaCheckpoint::handle()
             metatree.recomputeDirSize();
             cp.setWriteSyncFlag(checkpointWriteSyncFlag);
             cp.setWriteBufferSize(checkpointWriteBufferSize);
+            cp.setWriteBinaryFlag(checkpointWriteBinaryFlag);
+            cp.setWriteThreadCount(checkpointWriteThreadCount);
+            cp.setCompressionLevel(checkpointCompressionLevel);
+            cp.setCompressionBlockSize(checkpointCompressionBlockSize);
+            cp.setDigestName(checkpointDigest);
             status = cp.do_CP();
         }
         // Child does not attempt graceful exit.
@@ -3479,6 +4283,34 @@ MetaCheckpoint::SetParameters(const Properties& props)
     checkpointWriteBufferSize = props.getValue(
         "metaServer.checkpoint.writeBufferSize",
         checkpointWriteBufferSize);
+    checkpointWriteBinaryFlag = props.getValue(
+        "metaServer.checkpoint.writeBinary",
+        checkpointWriteBinaryFlag ? 1 : 0) != 0;
+    checkpointWriteThreadCount = max(0, props.getValue(
+        "metaServer.checkpoint.writeThreads",
+        checkpointWriteThreadCount));
+    checkpointCompressionLevel = max(0, min(9, props.getValue(
+        "metaServer.checkpoint.compressionLevel",
+        checkpointCompressionLevel)));
+    checkpointCompressionBlockSize = props.getValue(
+        "metaServer.checkpoint.compressionBlockSize",
+        checkpointCompressionBlockSize);
+    checkpointRestoreThreadCount = max(0, props.getValue(
+        "metaServer.checkpoint.restoreThreads",
+        checkpointRestoreThreadCount));
+    const string digest = props.getValue(
+        "metaServer.checkpoint.digest", checkpointDigest);
+    if (MdStream::IsDigestSupported(digest)) {
+        checkpointDigest = digest;
+    } else {
+        KFS_LOG_STREAM_ERROR <<
+            "metaServer.checkpoint.digest: " << digest <<
+            " is not supported, using: " <<
+            (checkpointDigest.empty() ? "md5" : checkpointDigest) <<
+        KFS_LOG_EOM;
+    }
+    logCompactor = props.getValue(
+        "metaServer.checkpoint.logCompactor", logCompactor);
 }
 
 /*!
@@ -3499,14 +4331,129 @@ submit_request(MetaRequest *r)
         // accumulate processing time.
         r->processTime = start - r->processTime;
     }
-    r->handle();
+    if (IsStandbyRequestAllowed(*r)) {
+        r->handle();
+    }
+    const int64_t end = microseconds();
+    r->handleTime     += end - start;
+    r->handleDoneTime = end;
     if (r->suspended) {
-        r->processTime = microseconds() - r->processTime;
+        r->processTime = end - r->processTime;
     } else {
         oplog.dispatch(r);
     }
 }
 
+class ReadOnlyRequestContext::Impl
+{
+public:
+    Impl()
+        : mReaddirRes(),
+          mWOStream(),
+          mRandom()
+        {}
+    vector<MetaDentry*> mReaddirRes;
+    ResponseWOStream    mWOStream;
+    PrngIsaac64         mRandom;
+};
+
+__thread ReadOnlyRequestContext* ReadOnlyRequestContext::sCurrentPtr = 0;
+
+ReadOnlyRequestContext::ReadOnlyRequestContext()
+    : mImpl(*(new Impl()))
+{
+}
+
+ReadOnlyRequestContext::~ReadOnlyRequestContext()
+{
+    delete &mImpl;
+}
+
+/* static */ bool
+ReadOnlyRequestContext::IsConcurrent(const MetaRequest& req)
+{
+    switch (req.op) {
+        case META_LOOKUP:
+        case META_LOOKUP_PATH:
+        case META_LOOKUP_BATCH:
+            return true;
+        case META_GETALLOC:
+            // Object store access proxy lookup is not re-entrant.
+            return (! static_cast<const MetaGetalloc&>(req).objectStoreFlag);
+        case META_READDIR:
+        case META_READDIRPLUS:
+        case META_GETLAYOUT:
+            // Requests waiting for io buffers must be resumed in order.
+            return (! sBuffersWaitQueue.HasPendingRequests() &&
+                gLayoutManager.HasEnoughFreeBuffers());
+        default:
+            break;
+    }
+    return false;
+}
+
+void
+ReadOnlyRequestContext::Handle(MetaRequest& req)
+{
+    const int64_t start = microseconds();
+    if (req.submitCount++ == 0) {
+        req.submitTime  = start;
+        req.processTime = start;
+    } else {
+        req.processTime = start - req.processTime;
+    }
+    assert(! sCurrentPtr);
+    if (IsStandbyRequestAllowed(req)) {
+        sCurrentPtr = this;
+        req.handle();
+        sCurrentPtr = 0;
+    }
+    const int64_t end = microseconds();
+    req.handleTime     += end - start;
+    req.handleDoneTime = end;
+    if (req.suspended) {
+        panic("read only request context: request suspended", false);
+    }
+}
+
+/* static */ void
+ReadOnlyRequestContext::Done(MetaRequest& req)
+{
+    if (META_GETALLOC == req.op && 0 == req.status) {
+        const MetaGetalloc& ga = static_cast<const MetaGetalloc&>(req);
+        if (! ga.objectStoreFlag && ! ga.fromChunkServerFlag) {
+            gLayoutManager.UpdateFileHeat(ga.fid);
+        }
+    }
+    oplog.dispatch(&req);
+}
+
+vector<MetaDentry*>&
+ReadOnlyRequestContext::GetReadDirTmpVec()
+{
+    mImpl.mReaddirRes.clear();
+    mImpl.mReaddirRes.reserve(1024);
+    return mImpl.mReaddirRes;
+}
+
+ostream&
+ReadOnlyRequestContext::SetWOStream(IOBuffer& buf)
+{
+    return mImpl.mWOStream.Set(buf);
+}
+
+void
+ReadOnlyRequestContext::ResetWOStream()
+{
+    mImpl.mWOStream.Reset();
+}
+
+int64_t
+ReadOnlyRequestContext::Rand(int64_t interval)
+{
+    return (int64_t)(mImpl.mRandom.Rand() % interval);
+}
+
 /*!
  * \brief print out the leaf nodes for debugging
  */
@@ -3534,6 +4481,15 @@ MetaLookupPath::log(ostream& /* file */) const
     return 0;
 }
 
+/*!
+ * \brief log lookup batch request (nop)
+ */
+int
+MetaLookupBatch::log(ostream& /* file */) const
+{
+    return 0;
+}
+
 /*!
  * \brief log a file create
  */
@@ -3566,6 +4522,9 @@ MetaCreate::log(ostream& file) const
     if (minSTier < kKfsSTierMax) {
         file << "/minTier/" << (int)minSTier << "/maxTier/" << (int)maxSTier;
     }
+    if (compression != KFS_COMPRESSION_NONE) {
+        file << "/compression/" << compression;
+    }
     file << '\n';
     return file.fail() ? -EIO : 0;
 }
@@ -3610,6 +4569,16 @@ MetaRemove::log(ostream &file) const
 int
 MetaRmdir::log(ostream &file) const
 {
+    if (0 < todumpster) {
+        // Recursive remove moves the directory into the dumpster. Insert
+        // sentinel empty entry after the new name for pop_path() to work.
+        file << "rename"
+            "/dir/" << dir <<
+            "/old/" << name <<
+            "/new/" << Tree::getDumpsterPath(name, todumpster) << '/' <<
+            "/mtime/" << ShowTime(mtime) << '\n';
+        return file.fail() ? -EIO : 0;
+    }
     file << "rmdir/dir/" << dir << "/name/" << name <<
         "/mtime/" << ShowTime(mtime) << '\n';
     return file.fail() ? -EIO : 0;
@@ -3755,6 +4724,36 @@ MetaChangeFileReplication::log(ostream &file) const
     return file.fail() ? -EIO : 0;
 }
 
+/*!
+ * \brief log pack file
+ */
+int
+MetaPackFile::log(ostream &file) const
+{
+    file << "pack/file/" << fid << "/container/" << containerFid <<
+        "/offset/" << containerOffset << "/size/" << fileSize <<
+        "/expected/" << expectedContainer << '\n';
+    return file.fail() ? -EIO : 0;
+}
+
+/*!
+ * \brief log chunk copy as the destination file chunk allocation
+ */
+int
+MetaCopyChunk::log(ostream &file) const
+{
+    if (chunkId < 0) {
+        return 0;
+    }
+    file << "allocate/file/" << fid << "/offset/" << offset
+        << "/chunkId/" << chunkId
+        << "/chunkVersion/" << chunkVersion
+        << "/mtime/" << ShowTime(microseconds())
+        << "/append/0"
+        << '\n';
+    return file.fail() ? -EIO : 0;
+}
+
 /*!
  * \brief log retire chunkserver (nop)
  */
@@ -3823,6 +4822,18 @@ MetaUpServers::log(ostream &file) const
     return 0;
 }
 
+int
+MetaHeapProfile::log(ostream& /* file */) const
+{
+    return 0;
+}
+
+int
+MetaNoop::log(ostream& /* file */) const
+{
+    return 0;
+}
+
 /*!
  * \brief for a stats request, there is nothing to log
  */
@@ -3932,6 +4943,15 @@ MetaLeaseRenew::log(ostream &file) const
     return 0;
 }
 
+/*!
+ * \brief for a lease renew batch request, there is nothing to log
+ */
+int
+MetaLeaseRenewBatch::log(ostream& /* file */) const
+{
+    return 0;
+}
+
 /*!
  * \brief for a lease renew relinquish, there is nothing to log
  */
@@ -3950,6 +4970,45 @@ MetaLeaseCleanup::log(ostream &file) const
     return 0;
 }
 
+/*!
+ * \brief log trash checkpoint and expiry as rename and rmdir
+ */
+int
+MetaTrashExpire::log(ostream &file) const
+{
+    for (Actions::const_iterator it = actions.begin();
+            it != actions.end();
+            ++it) {
+        if (it->newName.empty()) {
+            file << "rmdir/dir/" << it->dir << "/name/" << it->name <<
+                "/mtime/" << ShowTime(mtime) << '\n';
+        } else {
+            file << "rename"
+                "/dir/" << it->dir <<
+                "/old/" << it->name <<
+                "/new/" << it->newName << '/' <<
+                "/mtime/" << ShowTime(mtime) << '\n';
+        }
+    }
+    return file.fail() ? -EIO : 0;
+}
+
+/*!
+ * \brief log file storage tiers changes as change file replication
+ */
+int
+MetaTierMigrate::log(ostream &file) const
+{
+    for (Actions::const_iterator it = actions.begin();
+            it != actions.end();
+            ++it) {
+        file << "setrep/file/" << it->fid << "/replicas/0"
+            "/minTier/" << (int)it->minSTier <<
+            "/maxTier/" << (int)it->maxSTier << '\n';
+    }
+    return file.fail() ? -EIO : 0;
+}
+
 /*!
  * \brief This is an internally generated op.  There is
  * nothing to log.
@@ -3987,6 +5046,19 @@ MetaLogMakeChunkStable::log(ostream &file) const
 int
 MetaChmod::log(ostream& file) const
 {
+    if (recursiveFlag) {
+        // One record per sub tree batch, the cursor must be the last.
+        file << "chmodr" <<
+            "/file/"  << fid <<
+            "/mode/"  << mode <<
+            "/euser/" << euser <<
+            "/max/"   << maxEntries;
+        if (! cursor.empty()) {
+            file << "/cursor/" << cursor;
+        }
+        file << '\n';
+        return file.fail() ? -EIO : 0;
+    }
     file << "chmod" <<
         "/file/" << fid <<
         "/mode/" << mode <<
@@ -3997,6 +5069,20 @@ MetaChmod::log(ostream& file) const
 int
 MetaChown::log(ostream& file) const
 {
+    if (recursiveFlag) {
+        // One record per sub tree batch, the cursor must be the last.
+        file << "chownr" <<
+            "/file/"  << fid <<
+            "/user/"  << user <<
+            "/group/" << group <<
+            "/euser/" << euser <<
+            "/max/"   << maxEntries;
+        if (! cursor.empty()) {
+            file << "/cursor/" << cursor;
+        }
+        file << '\n';
+        return file.fail() ? -EIO : 0;
+    }
     file << "chown" <<
         "/file/"  << fid <<
         "/user/"  << user <<
@@ -4029,6 +5115,234 @@ MetaRequest::~MetaRequest()
     sMetaRequestCount--;
 }
 
+template<size_t TSize>
+class MetaRequestPool
+{
+public:
+    typedef ThreadCachingPoolAllocator<
+        TSize,
+        TSize << 7,  // size_t TMinStorageAlloc,
+        TSize << 11, // size_t TMaxStorageAlloc,
+        32           // size_t TBatchSize
+    > Allocator;
+    static Allocator& Get()
+    {
+        // Never destroyed, as the requests and the client threads can
+        // outlive static destructors.
+        static Allocator* const sAllocatorPtr = new Allocator();
+        return *sAllocatorPtr;
+    }
+    static void AddStats(MetaRequest::AllocatorStats& stats)
+    {
+        MetaRequest::AllocatorStats cur;
+        Get().GetStats(cur);
+        stats.Add(cur);
+    }
+};
+
+/* static */ void*
+MetaRequest::operator new(size_t size)
+{
+    if (size <= 256) {
+        return MetaRequestPool<256>::Get().Allocate();
+    }
+    if (size <= 512) {
+        return MetaRequestPool<512>::Get().Allocate();
+    }
+    if (size <= 1024) {
+        return MetaRequestPool<1024>::Get().Allocate();
+    }
+    if (size <= 2048) {
+        return MetaRequestPool<2048>::Get().Allocate();
+    }
+    if (size <= 4096) {
+        return MetaRequestPool<4096>::Get().Allocate();
+    }
+    return ::operator new(size);
+}
+
+/* static */ void
+MetaRequest::operator delete(void* ptr, size_t size)
+{
+    if (! ptr) {
+        return;
+    }
+    if (size <= 256) {
+        MetaRequestPool<256>::Get().Deallocate(ptr);
+    } else if (size <= 512) {
+        MetaRequestPool<512>::Get().Deallocate(ptr);
+    } else if (size <= 1024) {
+        MetaRequestPool<1024>::Get().Deallocate(ptr);
+    } else if (size <= 2048) {
+        MetaRequestPool<2048>::Get().Deallocate(ptr);
+    } else if (size <= 4096) {
+        MetaRequestPool<4096>::Get().Deallocate(ptr);
+    } else {
+        ::operator delete(ptr);
+    }
+}
+
+/* static */ void
+MetaRequest::GetAllocatorStats(MetaRequest::AllocatorStats& stats)
+{
+    stats = AllocatorStats();
+    MetaRequestPool<256>::AddStats(stats);
+    MetaRequestPool<512>::AddStats(stats);
+    MetaRequestPool<1024>::AddStats(stats);
+    MetaRequestPool<2048>::AddStats(stats);
+    MetaRequestPool<4096>::AddStats(stats);
+}
+
+bool    MetaRequestPhaseStats::sEnabledFlag           = true;
+int64_t MetaRequestPhaseStats::sSlowThresholdUsec     = 1000 * 1000;
+int64_t MetaRequestPhaseStats::sSlowLogSampleInterval = 1;
+
+MetaRequestPhaseStats::MetaRequestPhaseStats()
+    : mSlowCount(0)
+{
+    MetaRequestPhaseStats::Clear();
+}
+
+void
+MetaRequestPhaseStats::Clear()
+{
+    memset(mCounters, 0, sizeof(mCounters));
+    mSlowCount = 0;
+}
+
+/* static */ void
+MetaRequestPhaseStats::SetParameters(const Properties& props)
+{
+    sEnabledFlag = props.getValue(
+        "metaServer.requestPhaseStats.enabled",
+        sEnabledFlag ? 1 : 0) != 0;
+    sSlowThresholdUsec = props.getValue(
+        "metaServer.requestPhaseStats.slowThresholdUsec",
+        sSlowThresholdUsec);
+    sSlowLogSampleInterval = max(int64_t(1), props.getValue(
+        "metaServer.requestPhaseStats.slowLogSampleInterval",
+        sSlowLogSampleInterval));
+}
+
+void
+MetaRequestPhaseStats::Update(const MetaRequest& req, int64_t now)
+{
+    if (! sEnabledFlag || req.submitTime <= 0) {
+        return;
+    }
+    // Missing time stamps, for example the requests that are not received by
+    // the client threads, or not logged, have zero duration phases.
+    const int64_t start = 0 < req.recvTime ? req.recvTime :
+        (0 < req.dispatchTime ? req.dispatchTime : req.submitTime);
+    const int64_t handleDone = max(req.submitTime, req.handleDoneTime);
+    const int64_t commit     = max(handleDone, req.commitTime);
+    int64_t       phases[kPhaseCount];
+    phases[kPhaseClientQueue] = (0 < req.recvTime && 0 < req.dispatchTime) ?
+        req.dispatchTime - req.recvTime : 0;
+    phases[kPhaseMainWait]    = req.submitTime - (0 < req.dispatchTime ?
+        req.dispatchTime : start);
+    phases[kPhaseHandle]      = req.handleTime;
+    phases[kPhaseSuspended]   = handleDone - req.submitTime - req.handleTime;
+    phases[kPhaseLogCommit]   = commit - handleDone;
+    phases[kPhaseResponse]    = max(commit, now) - commit;
+    Counters& ctrs = mCounters[
+        (req.op < 0 || (int)kOtherOpIdx <= (int)req.op) ?
+        (int)kOtherOpIdx : (int)req.op];
+    ctrs.mCount++;
+    for (int i = 0; i < kPhaseCount; i++) {
+        const int64_t time = max(int64_t(0), phases[i]);
+        int           idx  = 0;
+        while (idx < kBucketCount - 1 && (int64_t(1) << idx) <= time) {
+            idx++;
+        }
+        ctrs.mTotal[i] += time;
+        ctrs.mHist[i][idx]++;
+    }
+    if (sSlowThresholdUsec < 0 || now - start < sSlowThresholdUsec ||
+            ++mSlowCount % sSlowLogSampleInterval != 0) {
+        return;
+    }
+    KFS_LOG_STREAM_INFO <<
+        "slow request: "   << req.Show() <<
+        " status: "        << req.status <<
+        " usec: total: "   << (now - start) <<
+        " client queue: "  << phases[kPhaseClientQueue] <<
+        " main wait: "     << phases[kPhaseMainWait] <<
+        " handle: "        << phases[kPhaseHandle] <<
+        " suspended: "     << phases[kPhaseSuspended] <<
+        " log commit: "    << phases[kPhaseLogCommit] <<
+        " response: "      << phases[kPhaseResponse] <<
+        " slow count: "    << mSlowCount <<
+    KFS_LOG_EOM;
+}
+
+MetaRequestPhaseStats&
+MetaRequestPhaseStats::Add(const MetaRequestPhaseStats& stats)
+{
+    for (int k = 0; k <= kOtherOpIdx; k++) {
+        Counters&       dst = mCounters[k];
+        const Counters& src = stats.mCounters[k];
+        dst.mCount += src.mCount;
+        for (int i = 0; i < kPhaseCount; i++) {
+            dst.mTotal[i] += src.mTotal[i];
+            for (int b = 0; b < kBucketCount; b++) {
+                dst.mHist[i][b] += src.mHist[i][b];
+            }
+        }
+    }
+    mSlowCount += stats.mSlowCount;
+    return *this;
+}
+
+void
+MetaRequestPhaseStats::Display(ostream& os, const char* prefix) const
+{
+    // For each request type with non zero count, and each phase:
+    // count,total-usec,bucket-0,...,bucket-N
+    // bucket i counts phase durations less than 2^i usec, the trailing empty
+    // buckets are omitted.
+    static const char* const kPhaseNames[kPhaseCount] = {
+        "client-queue",
+        "main-wait",
+        "handle",
+        "suspended",
+        "log-commit",
+        "response"
+    };
+    os << prefix << "slow: " << mSlowCount << "\r\n";
+    for (int k = 0; k <= kOtherOpIdx; k++) {
+        const Counters& ctrs = mCounters[k];
+        if (ctrs.mCount <= 0) {
+            continue;
+        }
+        for (int i = 0; i < kPhaseCount; i++) {
+            os << prefix << GetOpName(k) << "-" << kPhaseNames[i] << ": " <<
+                ctrs.mCount << "," << ctrs.mTotal[i];
+            int last = kBucketCount;
+            while (0 < last && ctrs.mHist[i][last - 1] <= 0) {
+                last--;
+            }
+            for (int b = 0; b < last; b++) {
+                os << "," << ctrs.mHist[i][b];
+            }
+            os << "\r\n";
+        }
+    }
+}
+
+/* static */ const char*
+MetaRequestPhaseStats::GetOpName(int idx)
+{
+    static const char* const kNames[kOtherOpIdx + 1] =
+    {
+#       define KfsMakeMetaOpName(name) #name,
+        KfsForEachMetaOpId(KfsMakeMetaOpName)
+#       undef KfsMakeMetaOpName
+        "OTHER"
+    };
+    return ((idx < 0 || kOtherOpIdx < idx) ? "" : kNames[idx]);
+}
+
 /* virtual */ void
 MetaRequest::handle()
 {
@@ -4042,6 +5356,32 @@ MetaRequest::SetParameters(const Properties& props)
         "metaServer.request.requireHeaderChecksum", 0) != 0;
     sVerifyHeaderChecksumFlag = props.getValue(
         "metaServer.request.verifyHeaderChecksum", 1) != 0;
+    sResponseDeflateMinSize = props.getValue(
+        "metaServer.request.responseDeflateMinSize", sResponseDeflateMinSize);
+    sResponseDeflateLevel = props.getValue(
+        "metaServer.request.responseDeflateLevel", sResponseDeflateLevel);
+}
+
+/* static */ bool
+MetaRequest::DeflateResponse(const string& acceptEncoding, IOBuffer& content)
+{
+    if (sResponseDeflateMinSize < 0 ||
+            content.BytesConsumable() < sResponseDeflateMinSize ||
+            acceptEncoding.find("deflate") == string::npos) {
+        return false;
+    }
+    ZlibDeflate deflate(sResponseDeflateLevel);
+    IOBuffer    out;
+    const int   status = deflate.Run(content, out);
+    if (status != 0) {
+        KFS_LOG_STREAM_ERROR <<
+            "response deflate failure: " << deflate.StrError(status) <<
+        KFS_LOG_EOM;
+        return false;
+    }
+    content.Clear();
+    content.Move(&out);
+    return true;
 }
 
 /* static */ uint32_t
@@ -4057,12 +5397,16 @@ MetaRequest::Checksum(
 
 bool MetaRequest::sRequireHeaderChecksumFlag  = false;
 bool MetaRequest::sVerifyHeaderChecksumFlag   = true;
+int  MetaRequest::sResponseDeflateMinSize     = -1;
+int  MetaRequest::sResponseDeflateLevel       = -1;
 int  MetaRequest::sMetaRequestCount           = 0;
 MetaRequest* MetaRequest::sMetaRequestsPtr[1] = {0};
 
 bool MetaCreate::Validate()
 {
-    return (dir >= 0 && ! name.empty() && 0 <= numReplicas);
+    return (dir >= 0 && ! name.empty() && 0 <= numReplicas &&
+        KFS_COMPRESSION_NONE <= compression &&
+        compression <= KFS_COMPRESSION_MAX);
 }
 
 /*!
@@ -4112,6 +5456,48 @@ MetaLookupPath::response(ostream &os)
     FattrReply(os, fattr, GetUserAndGroupNames(*this)) << "\r\n";
 }
 
+void
+MetaLookupBatch::response(ostream& os, IOBuffer& buf)
+{
+    if (! OkHeader(this, os)) {
+        return;
+    }
+    // The response can be written by the client thread, use local stream.
+    ResponseWOStream               stream;
+    IOBuffer                       resp;
+    ostream&                       ros = stream.Set(resp);
+    const UserAndGroupNames* const ugn = GetUserAndGroupNames(*this);
+    for (Entries::const_iterator it = entries.begin();
+            it != entries.end() && ros;
+            ++it) {
+        ros << "Status: " << (it->status >= 0 ? it->status :
+            -SysToKfsErrno(-it->status)) << "\r\n";
+        if (it->status == 0) {
+            FattrReply(ros, it->fattr, ugn);
+        }
+        ros << "\r\n";
+    }
+    ros.flush();
+    const bool okFlag = !! ros;
+    stream.Reset();
+    entries.clear();
+    if (! okFlag) {
+        resp.Clear();
+        status    = -ENOMEM;
+        statusMsg = "response exceeds max. size";
+        OkHeader(this, os);
+        return;
+    }
+    os <<
+        "EUserId: "        << euser  << "\r\n"
+        "EGroupId: "       << egroup << "\r\n"
+        "Num-entries: "    << numEntries << "\r\n"
+        "Content-length: " << resp.BytesConsumable() << "\r\n"
+    "\r\n";
+    os.flush();
+    buf.Move(&resp);
+}
+
 void
 MetaCreate::response(ostream &os)
 {
@@ -4133,6 +5519,9 @@ MetaCreate::response(ostream &os)
         "Min-tier: " << (int)minSTier << "\r\n"
         "Max-tier: " << (int)maxSTier << "\r\n";
     }
+    if (compression != KFS_COMPRESSION_NONE) {
+        os << "Compression: " << compression << "\r\n";
+    }
     UserAndGroupNamesReply(os, GetUserAndGroupNames(*this), user, group) <<
     "\r\n";
 }
@@ -4226,6 +5615,9 @@ MetaReaddirPlus::response(ostream& os, IOBuffer& buf)
         OkHeader(this, os);
         return;
     }
+    if (DeflateResponse(acceptEncoding, resp)) {
+        os << "Content-encoding: deflate\r\n";
+    }
     os <<
         "Num-Entries: "      << entryCount << "\r\n"
         "Has-more-entries: " << (hasMoreEntriesFlag ? 1 : 0) << "\r\n"
@@ -4251,6 +5643,7 @@ void
 MetaGetalloc::response(ostream& os)
 {
     if (! OkHeader(this, os)) {
+        servers.clear();
         return;
     }
     os <<
@@ -4259,13 +5652,21 @@ MetaGetalloc::response(ostream& os)
     if (replicasOrderedFlag) {
         os << "Replicas-ordered: 1\r\n";
     }
-    os << "Num-replicas: " << locations.size() << "\r\n";
+    os << "Num-replicas: " << servers.size() << "\r\n";
 
-    assert(locations.size() > 0);
+    assert(! servers.empty());
 
+    // The server list is written with the location strings formatted once
+    // per chunk server, and the server references are released right after
+    // the response is written, in order not to extend the servers lifetime.
     os << "Replicas:";
-    for_each(locations.begin(), locations.end(), ListServerLocations(os));
+    for (Servers::const_iterator it = servers.begin();
+            it != servers.end();
+            ++it) {
+        os << (*it)->GetReplicaLocationStr();
+    }
     os << "\r\n\r\n";
+    servers.clear();
 }
 
 void
@@ -4277,6 +5678,9 @@ MetaGetlayout::response(ostream& os, IOBuffer& buf)
     if (hasMoreChunksFlag) {
         os << "Has-more-chunks:  1\r\n";
     }
+    if (replicasOrderedFlag) {
+        os << "Replicas-ordered: 1\r\n";
+    }
     if (0 <= fileSize) {
         os << "File-size: " << fileSize << "\r\n";
     }
@@ -4595,6 +5999,24 @@ MetaLeaseRenew::response(ostream& os, IOBuffer& buf)
     buf.Move(&iobuf);
 }
 
+void
+MetaLeaseRenewBatch::response(ostream& os)
+{
+    if (! OkHeader(this, os)) {
+        return;
+    }
+    os <<
+        "Num-entries: " << entries.size() << "\r\n"
+        "Entries-status:";
+    for (Entries::const_iterator it = entries.begin();
+            it != entries.end();
+            ++it) {
+        os << " " << (it->status >= 0 ? it->status :
+            -SysToKfsErrno(-it->status));
+    }
+    os << "\r\n\r\n";
+}
+
 void
 MetaLeaseRelinquish::response(ostream &os)
 {
@@ -4625,6 +6047,9 @@ MetaHello::response(ostream &os)
             os << "Delete-all-chunks: " << metaFileSystemId << "\r\n";
         }
     }
+    if (0 != instanceId) {
+        os << "Instance-id: " << instanceId << "\r\n";
+    }
     os << "\r\n";
 }
 
@@ -4677,6 +6102,21 @@ MetaChangeFileReplication::response(ostream &os)
         "Num-replicas: " << numReplicas << "\r\n\r\n";
 }
 
+void
+MetaPackFile::response(ostream &os)
+{
+    PutHeader(this, os) << "\r\n";
+}
+
+void
+MetaCopyChunk::response(ostream &os)
+{
+    PutHeader(this, os) <<
+        "Chunk-handle: "  << chunkId      << "\r\n"
+        "Chunk-version: " << chunkVersion << "\r\n"
+    "\r\n";
+}
+
 void
 MetaRetireChunkserver::response(ostream &os)
 {
@@ -4699,6 +6139,23 @@ MetaPing::response(ostream &os, IOBuffer& buf)
     buf.Move(&resp);
 }
 
+void
+MetaNoop::response(ostream& os)
+{
+    PutHeader(this, os) << "\r\n";
+}
+
+void
+MetaHeapProfile::response(ostream& os, IOBuffer& buf)
+{
+    if (! OkHeader(this, os)) {
+        return;
+    }
+    os << "Content-length: " << resp.BytesConsumable() << "\r\n\r\n";
+    os.flush();
+    buf.Move(&resp);
+}
+
 void
 MetaUpServers::response(ostream& os, IOBuffer& buf)
 {
@@ -4713,7 +6170,13 @@ MetaUpServers::response(ostream& os, IOBuffer& buf)
 void
 MetaStats::response(ostream &os)
 {
-    PutHeader(this, os) << stats << "\r\n";
+    PutHeader(this, os);
+    if (deltaId != 0 && 0 <= status) {
+        os <<
+            "Delta-gen: "  << deltaGen               << "\r\n"
+            "Delta-full: " << (deltaFullFlag ? 1 : 0) << "\r\n";
+    }
+    os << stats << "\r\n";
 }
 
 void
@@ -4831,7 +6294,10 @@ MetaGetPathName::response(ostream& os)
 void
 MetaChmod::response(ostream& os)
 {
-    PutHeader(this, os) << "\r\n";
+    if (! OkHeader(this, os)) {
+        return;
+    }
+    SubTreeAttrReply(os, *this) << "\r\n";
 }
 
 void
@@ -4844,6 +6310,7 @@ MetaChown::response(ostream& os)
     "User: "  << user  << "\r\n"
     "Group: " << group << "\r\n"
     ;
+    SubTreeAttrReply(os, *this);
     UserAndGroupNamesReply(os, GetUserAndGroupNames(*this), user, group) <<
     "\r\n";
 }
@@ -5022,6 +6489,9 @@ MetaChunkHeartbeat::request(ostream &os)
     if (reAuthenticateFlag) {
         os << "Authenticate: 1\r\n";
     }
+    if (0 <= deltaSeq) {
+        os << "Delta-seq: " << deltaSeq << "\r\n";
+    }
     os <<
     "\r\n"
     ;
@@ -5087,6 +6557,35 @@ MetaChunkStaleNotify::request(ostream& os, IOBuffer& buf)
     }
 }
 
+void
+MetaChunkDeleteBatch::request(ostream& os, IOBuffer& buf)
+{
+    const size_t count = chunkIds.GetSize();
+    os <<
+        "DELETE_BATCH \r\n"
+        "Cseq: " << opSeqno << "\r\n"
+        "Version: KFS/1.0\r\n"
+        "Num-chunks: " << count << "\r\n"
+    ;
+    const int   kBufEnd = 30;
+    char        tmpBuf[kBufEnd + 1];
+    char* const end = tmpBuf + kBufEnd;
+    ChunkIdQueue::ConstIterator it(chunkIds);
+    const chunkId_t*            id;
+    IOBuffer                    ioBuf;
+    IOBufferWriter              writer(ioBuf);
+    tmpBuf[kBufEnd] = (char)' ';
+    while ((id = it.Next())) {
+        char* const p = IntToHexString(*id, end);
+        writer.Write(p, (int)(end - p + 1));
+    }
+    writer.Close();
+    const int len = ioBuf.BytesConsumable();
+    os << "Content-length: " << len << "\r\n\r\n";
+    os.flush();
+    buf.Move(&ioBuf);
+}
+
 void
 MetaChunkRetire::request(ostream &os)
 {
@@ -5157,6 +6656,12 @@ MetaChunkReplicate::request(ostream& os)
     "Min-tier: "      << (int)minSTier << "\r\n"
     "Max-tier: "      << (int)maxSTier << "\r\n"
     ;
+    if (0 <= srcChunkId) {
+        rs <<
+        "Source-chunk-handle: " << srcChunkId   << "\r\n"
+        "Target-version: "      << chunkVersion << "\r\n"
+        ;
+    }
     if (numRecoveryStripes > 0) {
         rs <<
         "Chunk-version: 0\r\n"
@@ -5193,9 +6698,10 @@ MetaChunkReplicate::request(ostream& os)
             );
             rs << "\r\n"
                 "C-access: ";
+            // Chunk copy reads the source chunk.
             ChunkAccessToken::WriteToken(
                 rs,
-                chunkId,
+                0 <= srcChunkId ? srcChunkId : chunkId,
                 authUid,
                 tokenSeq,
                 keyId,
@@ -46,6 +46,7 @@
 #include "common/StBuffer.h"
 #include "common/StdAllocator.h"
 #include "common/DynamicArray.h"
+#include "common/ThreadCachingPoolAllocator.h"
 #include "qcdio/QCDLList.h"
 
 #include <string.h>
@@ -146,7 +147,16 @@ using std::less;
     f(DELEGATE_CANCEL) \
     f(SET_FILE_SYSTEM_INFO) \
     f(FORCE_CHUNK_REPLICATION) \
-    f(CLEAR_OBJ_STORE_DELETE)
+    f(CLEAR_OBJ_STORE_DELETE) \
+    f(LOOKUP_BATCH) \
+    f(HEAP_PROFILE) \
+    f(TRASH_EXPIRE) /* Internally generated trash checkpoint and expiry */ \
+    f(TIER_MIGRATE) /* Internally generated storage tier migration */ \
+    f(CHUNK_DELETE_BATCH) /* Batched chunk delete RPC from meta->chunk */ \
+    f(PACK_FILE) /* Convert small file into extent of pack container */ \
+    f(LEASE_RENEW_BATCH) /* Renew a list of read leases in one request */ \
+    f(NOOP) \
+    f(COPY_CHUNK) /* Copy chunk into another file by chunk servers */
 
 enum MetaOp {
 #define KfsMakeMetaOpEnumEntry(name) META_##name,
@@ -191,6 +201,11 @@ struct MetaRequest {
     int             submitCount;     //!< for time tracking.
     int64_t         submitTime;      //!< to time requests, optional.
     int64_t         processTime;     //!< same as previous
+    int64_t         recvTime;        //!< parsed by client thread, phase stats
+    int64_t         dispatchTime;    //!< client thread dispatch start
+    int64_t         handleTime;      //!< handle() cumulative time
+    int64_t         handleDoneTime;  //!< last handle() completion
+    int64_t         commitTime;      //!< log commit completion
     string          statusMsg;       //!< optional human readable status message
     seq_t           opSeqno;         //!< command sequence # sent by the client
     seq_t           seqno;           //!< sequence no. in log
@@ -206,6 +221,7 @@ struct MetaRequest {
     kfsUid_t        euser;
     kfsGid_t        egroup;
     int64_t         maxWaitMillisec;
+    int64_t         maxStalenessSec; //!< standby reads opt in, if >= 0
     int64_t         sessionEndTime;
     MetaRequest*    next;
     KfsCallbackObj* clnt;            //!< a handle to the client that generated this request.
@@ -216,6 +232,11 @@ struct MetaRequest {
           submitCount(0),
           submitTime(0),
           processTime(0),
+          recvTime(0),
+          dispatchTime(0),
+          handleTime(0),
+          handleDoneTime(0),
+          commitTime(0),
           statusMsg(),
           opSeqno(opSeq),
           seqno(0),
@@ -231,6 +252,7 @@ struct MetaRequest {
           euser(kKfsUserNone),
           egroup(kKfsGroupNone),
           maxWaitMillisec(-1),
+          maxStalenessSec(-1),
           sessionEndTime(),
           next(0),
           clnt(0)
@@ -244,6 +266,9 @@ struct MetaRequest {
     virtual int log(ostream &file) const = 0; //!< write request to log
     Display Show() const { return Display(*this); }
     virtual void setChunkServer(const ChunkServerPtr& /* cs */) {};
+    //!< file and parent directory ids recorded in the binary audit log.
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = -1; outDir = -1; }
     bool ValidateRequestHeader(
         const char* name,
         size_t      nameLen,
@@ -272,6 +297,7 @@ struct MetaRequest {
         .Def("UserId",                  &MetaRequest::euser,  kKfsUserNone)
         .Def("GroupId",                 &MetaRequest::egroup, kKfsGroupNone)
         .Def("Max-wait-ms",             &MetaRequest::maxWaitMillisec, int64_t(-1))
+        .Def("Max-staleness-sec",       &MetaRequest::maxStalenessSec, int64_t(-1))
         ;
     }
     virtual ostream& ShowSelf(ostream& os) const = 0;
@@ -283,6 +309,17 @@ struct MetaRequest {
         size_t      headerLen);
     static int GetRequestCount()
         { return sMetaRequestCount; }
+    /// Request objects are allocated from the thread caching size class
+    /// pools, as requests are created and destroyed by both the main and
+    /// the client threads. Sized delete requires virtual destructor.
+    static void* operator new(size_t size);
+    static void* operator new(size_t /* size */, void* ptr)
+        { return ptr; }
+    static void operator delete(void* ptr, size_t size);
+    static void operator delete(void* /* ptr */, void* /* place */)
+        {}
+    typedef ThreadCachingPoolAllocatorStats AllocatorStats;
+    static void GetAllocatorStats(AllocatorStats& stats);
     static Display ShowReq(const MetaRequest* req)
     {
         return (req ? *req : GetNullReq()).Show();
@@ -291,12 +328,19 @@ struct MetaRequest {
         { return false; }
 protected:
     virtual void response(ostream& /* os */) {}
+    /// Compress response content in place, if the client accepts deflate
+    /// content encoding, and the content size is above the configured
+    /// threshold. Returns true if the content was compressed.
+    static bool DeflateResponse(
+        const string& acceptEncoding, IOBuffer& content);
 private:
     MetaRequest* mPrevPtr[1];
     MetaRequest* mNextPtr[1];
 
     static bool         sRequireHeaderChecksumFlag;
     static bool         sVerifyHeaderChecksumFlag;
+    static int          sResponseDeflateMinSize;
+    static int          sResponseDeflateLevel;
     static int          sMetaRequestCount;
     static MetaRequest* sMetaRequestsPtr[1];
 
@@ -308,8 +352,96 @@ private:
 inline static ostream& operator<<(ostream& os, const MetaRequest::Display& disp)
 { return disp.Show(os); }
 
+/*!
+ * \brief Per request type latency histograms of the request processing phases.
+ * The phase durations are computed from the request time stamps set by the
+ * client thread, the request processing, and log writer. The main thread
+ * instance is protected by the global mutex, each client thread has its own
+ * instance that is updated without synchronization. The histogram buckets are
+ * powers of two microseconds. The slow requests, exceeding the configured
+ * threshold, are sampled and their phase breakdown is logged.
+ */
+class MetaRequestPhaseStats
+{
+public:
+    enum Phase
+    {
+        kPhaseClientQueue = 0, //!< queued on client thread
+        kPhaseMainWait    = 1, //!< waiting for the global mutex / main thread
+        kPhaseHandle      = 2, //!< handle() execution
+        kPhaseSuspended   = 3, //!< suspended, waiting for chunk servers etc.
+        kPhaseLogCommit   = 4, //!< waiting for log write and commit
+        kPhaseResponse    = 5, //!< waiting for response send
+        kPhaseCount
+    };
+    enum { kBucketCount = 24 };
+
+    MetaRequestPhaseStats();
+    void Update(const MetaRequest& req, int64_t now);
+    void Clear();
+    MetaRequestPhaseStats& Add(const MetaRequestPhaseStats& stats);
+    void Display(ostream& os, const char* prefix) const;
+    static void SetParameters(const Properties& props);
+    static bool IsEnabled()
+        { return sEnabledFlag; }
+private:
+    struct Counters
+    {
+        int64_t mCount;
+        int64_t mTotal[kPhaseCount];
+        int64_t mHist[kPhaseCount][kBucketCount];
+    };
+    enum { kOtherOpIdx = META_NUM_OPS_COUNT };
+
+    Counters mCounters[kOtherOpIdx + 1];
+    int64_t  mSlowCount;
+
+    static bool    sEnabledFlag;
+    static int64_t sSlowThresholdUsec;
+    static int64_t sSlowLogSampleInterval;
+    static const char* GetOpName(int idx);
+};
+
 void submit_request(MetaRequest *r);
 
+/*!
+ * \brief Read only request concurrent execution context.
+ * The client threads execute read only requests (lookup, readdir, and chunk
+ * layout queries) without holding the global mutex, concurrently with each
+ * other, while no mutation is in progress. The client thread makes its
+ * context "current" for the duration of the request handler execution. With
+ * the context current the request handlers use the context scratch buffers
+ * instead of the static ones, do not suspend requests, and do not update the
+ * shared caches and counters.
+ */
+class ReadOnlyRequestContext
+{
+public:
+    ReadOnlyRequestContext();
+    ~ReadOnlyRequestContext();
+    static ReadOnlyRequestContext* GetCurrent()
+        { return sCurrentPtr; }
+    //!< Returns true if the request can be executed concurrently. Must be
+    //!< invoked with the global mutex held.
+    static bool IsConcurrent(const MetaRequest& req);
+    //!< Execute request handler, the global mutex must not be held.
+    void Handle(MetaRequest& req);
+    //!< Complete the request execution with the global mutex held.
+    static void Done(MetaRequest& req);
+    vector<MetaDentry*>& GetReadDirTmpVec();
+    ostream& SetWOStream(IOBuffer& buf);
+    void ResetWOStream();
+    int64_t Rand(int64_t interval);
+private:
+    class Impl;
+    Impl& mImpl;
+
+    static __thread ReadOnlyRequestContext* sCurrentPtr;
+private:
+    ReadOnlyRequestContext(const ReadOnlyRequestContext&);
+    ReadOnlyRequestContext& operator=(const ReadOnlyRequestContext&);
+};
+
 /*!
  * \brief look up a file name
  */
@@ -331,6 +463,8 @@ struct MetaLookup: public MetaRequest {
     virtual int log(ostream& file) const;
     virtual void response(ostream& os);
     virtual bool dispatch(ClientSM& sm);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = -1; outDir = dir; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -375,6 +509,8 @@ struct MetaLookupPath: public MetaRequest {
     virtual void handle();
     virtual int log(ostream& file) const;
     virtual void response(ostream& os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = root; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -396,6 +532,65 @@ struct MetaLookupPath: public MetaRequest {
     }
 };
 
+/*!
+ * \brief look up a list of names, or paths in one request.
+ * Each entry is encoded in the "Entries" header as
+ * <parent fid> <name length> <name>, with entries separated by a single space.
+ * Negative parent fid means that the name is the path relative to the root
+ * directory. The entry names must not contain new line or carriage return.
+ */
+struct MetaLookupBatch: public MetaRequest {
+    struct Entry
+    {
+        fid_t  dir;    //!< parent directory fid, or -1 for the path lookup
+        string name;   //!< name or path to look up
+        int    status; //!< entry lookup status
+        MFattr fattr;
+        Entry()
+            : dir(-1),
+              name(),
+              status(0),
+              fattr()
+            {}
+    };
+    typedef vector<Entry> Entries;
+
+    int     numEntries;
+    string  entriesStr;
+    Entries entries;
+    MetaLookupBatch()
+        : MetaRequest(META_LOOKUP_BATCH, false),
+          numEntries(-1),
+          entriesStr(),
+          entries()
+        {}
+    virtual void handle();
+    virtual int log(ostream& file) const;
+    virtual void response(ostream& os, IOBuffer& buf);
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        os <<
+            "lookup batch:"
+            " entries: " << numEntries
+        ;
+        if (! entries.empty()) {
+            os <<
+                " first: " << entries.front().dir <<
+                " "        << entries.front().name
+            ;
+        }
+        return os;
+    }
+    bool Validate();
+    template<typename T> static T& ParserDef(T& parser)
+    {
+        return MetaRequest::ParserDef(parser)
+        .Def("Num-entries", &MetaLookupBatch::numEntries, int(-1))
+        .Def("Entries",     &MetaLookupBatch::entriesStr    )
+        ;
+    }
+};
+
 /*!
  * \brief create a file
  */
@@ -414,6 +609,7 @@ struct MetaCreate: public MetaRequest {
     kfsMode_t  mode;
     kfsSTier_t minSTier;
     kfsSTier_t maxSTier;
+    int32_t    compression;         //!< client block compression codec
     seq_t      reqId;
     string     name;                //!< name to create
     string     ownerName;
@@ -435,6 +631,7 @@ struct MetaCreate: public MetaRequest {
           mode(kKfsModeUndef),
           minSTier(kKfsSTierMax),
           maxSTier(kKfsSTierMax),
+          compression(KFS_COMPRESSION_NONE),
           reqId(-1),
           name(),
           ownerName(),
@@ -444,6 +641,8 @@ struct MetaCreate: public MetaRequest {
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = dir; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -458,7 +657,8 @@ struct MetaCreate: public MetaRequest {
             " todumpster: "  << todumpster <<
             " user: "        << user <<
             " group: "       << group <<
-            " mode: "        << oct << mode << dec
+            " mode: "        << oct << mode << dec <<
+            " compression: " << compression
         ;
     }
     bool Validate();
@@ -479,6 +679,7 @@ struct MetaCreate: public MetaRequest {
         .Def("ReqId",                &MetaCreate::reqId,              seq_t(-1))
         .Def("Min-tier",             &MetaCreate::minSTier,           kKfsSTierMax)
         .Def("Max-tier",             &MetaCreate::maxSTier,           kKfsSTierMax)
+        .Def("Compression",          &MetaCreate::compression,        int32_t(KFS_COMPRESSION_NONE))
         .Def("OName",                &MetaCreate::ownerName)
         .Def("GName",                &MetaCreate::groupName)
         ;
@@ -519,6 +720,8 @@ struct MetaMkdir: public MetaRequest {
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = dir; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -571,6 +774,8 @@ struct MetaRemove: public MetaRequest {
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = -1; outDir = dir; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -603,23 +808,30 @@ struct MetaRmdir: public MetaRequest {
     string  name;    //!< name to remove
     string  pathname; //!< full pathname to remove
     int64_t mtime;
+    bool    recursiveFlag; //!< remove directory content
+    fid_t   todumpster;    //!< set if directory moved into dumpster
     MetaRmdir()
         : MetaRequest(META_RMDIR, true),
           dir(-1),
           name(),
           pathname(),
-          mtime()
+          mtime(),
+          recursiveFlag(false),
+          todumpster(-1)
         {}
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = -1; outDir = dir; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
             "rmdir:"
-            " path: "   << pathname <<
-            " name: "   << name <<
-            " parent: " << dir
+            " path: "      << pathname <<
+            " name: "      << name <<
+            " parent: "    << dir <<
+            " recursive: " << recursiveFlag
         ;
     }
     bool Validate()
@@ -632,6 +844,7 @@ struct MetaRmdir: public MetaRequest {
         .Def("Parent File-handle", &MetaRmdir::dir, fid_t(-1))
         .Def("Directory",          &MetaRmdir::name          )
         .Def("Pathname",           &MetaRmdir::pathname      )
+        .Def("Recursive",          &MetaRmdir::recursiveFlag, false)
         ;
     }
 };
@@ -656,6 +869,8 @@ struct MetaReaddir: public MetaRequest {
     virtual void handle();
     virtual int log(ostream& file) const;
     virtual void response(ostream& os, IOBuffer& buf);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = dir; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os << "readdir: dir: " << dir;
@@ -737,6 +952,7 @@ struct MetaReaddirPlus: public MetaRequest {
     bool     noAttrsFlag;
     int64_t  ioBufPending;
     string   fnameStart;
+    string   acceptEncoding;
     DEntries dentries;
     CInfos   lastChunkInfos;
 
@@ -752,6 +968,7 @@ struct MetaReaddirPlus: public MetaRequest {
           noAttrsFlag(false),
           ioBufPending(0),
           fnameStart(),
+          acceptEncoding(),
           dentries(),
           lastChunkInfos()
         {}
@@ -759,6 +976,8 @@ struct MetaReaddirPlus: public MetaRequest {
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream& os, IOBuffer& buf);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = dir; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os << "readdir plus: dir: " << dir;
@@ -779,6 +998,7 @@ struct MetaReaddirPlus: public MetaRequest {
             &MetaReaddirPlus::omitLastChunkInfoFlag, false)
         .Def("FidT-only",
             &MetaReaddirPlus::fileIdAndTypeOnlyFlag, false)
+        .Def("Accept-encoding",       &MetaReaddirPlus::acceptEncoding)
         ;
     }
 };
@@ -792,7 +1012,7 @@ struct MetaGetalloc: public MetaRequest {
     bool            objectStoreFlag;
     chunkId_t       chunkId;      //!< Id of the chunk corresponding to offset
     seq_t           chunkVersion; //!< version # assigned to this chunk
-    ServerLocations locations;    //!< where the copies of the chunks are
+    Servers         servers;      //!< where the copies of the chunks are
     StringBufT<256> pathname;     //!< pathname of the file (useful to print in debug msgs)
     bool            replicasOrderedFlag;
     MetaGetalloc()
@@ -802,13 +1022,15 @@ struct MetaGetalloc: public MetaRequest {
           objectStoreFlag(false),
           chunkId(-1),
           chunkVersion(-1),
-          locations(),
+          servers(),
           pathname(),
           replicasOrderedFlag(false)
         {}
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -842,9 +1064,11 @@ struct MetaGetlayout: public MetaRequest {
     bool       omitLocationsFlag;
     bool       lastChunkInfoOnlyFlag;
     bool       continueIfNoReplicasFlag;
+    bool       orderReplicasFlag; //!< order replicas by load like getalloc
     int        maxResCnt;
     int        numChunks;
     bool       hasMoreChunksFlag;
+    bool       replicasOrderedFlag;
     chunkOff_t fileSize;
     IOBuffer   resp;   //!< result
     MetaGetlayout()
@@ -854,15 +1078,19 @@ struct MetaGetlayout: public MetaRequest {
           omitLocationsFlag(false),
           lastChunkInfoOnlyFlag(false),
           continueIfNoReplicasFlag(false),
+          orderReplicasFlag(false),
           maxResCnt(-1),
           numChunks(-1),
           hasMoreChunksFlag(false),
+          replicasOrderedFlag(false),
           fileSize(-1),
           resp()
         {}
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os, IOBuffer& buf);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os << "getlayout: fid: " << fid;
@@ -880,6 +1108,7 @@ struct MetaGetlayout: public MetaRequest {
         .Def("Last-chunk-only",         &MetaGetlayout::lastChunkInfoOnlyFlag,    false)
         .Def("Max-chunks",              &MetaGetlayout::maxResCnt,                -1)
         .Def("Continue-if-no-replicas", &MetaGetlayout::continueIfNoReplicasFlag, false)
+        .Def("Order-replicas",          &MetaGetlayout::orderReplicasFlag,        false)
         ;
     }
 };
@@ -1061,6 +1290,8 @@ struct MetaAllocate: public MetaRequest, public  KfsCallbackObj {
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const;
     void responseSelf(ostream &os);
     void LayoutDone(int64_t chunkAllocProcessTime);
@@ -1117,6 +1348,8 @@ struct MetaTruncate: public MetaRequest {
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -1169,6 +1402,8 @@ struct MetaRename: public MetaRequest {
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = -1; outDir = dir; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -1213,6 +1448,8 @@ struct MetaSetMtime: public MetaRequest {
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -1259,6 +1496,8 @@ struct MetaChangeFileReplication: public MetaRequest {
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -1284,6 +1523,127 @@ struct MetaChangeFileReplication: public MetaRequest {
     }
 };
 
+/*!
+ * \brief convert small file into packed file: the file data is the extent
+ * [containerOffset, containerOffset + fileSize) of the container file. The
+ * client copies the file data into the container prior to issuing the request.
+ * The file chunks are deleted. With expectedContainer >= 0 the request moves
+ * already packed file from the expected container into the new one.
+ */
+struct MetaPackFile: public MetaRequest {
+    fid_t      fid;
+    fid_t      containerFid;
+    chunkOff_t containerOffset;
+    chunkOff_t fileSize;
+    fid_t      expectedContainer;
+    MetaPackFile()
+        : MetaRequest(META_PACK_FILE, true),
+          fid(-1),
+          containerFid(-1),
+          containerOffset(-1),
+          fileSize(-1),
+          expectedContainer(-1)
+        {}
+    virtual void handle();
+    virtual int log(ostream &file) const;
+    virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        return os <<
+            "pack-file:"
+            " fid: "       << fid <<
+            " container: " << containerFid <<
+            " offset: "    << containerOffset <<
+            " size: "      << fileSize <<
+            " expected: "  << expectedContainer
+        ;
+    }
+    bool Validate()
+    {
+        return (0 <= fid && 0 <= containerFid &&
+            0 <= containerOffset && 0 <= fileSize);
+    }
+    template<typename T> static T& ParserDef(T& parser)
+    {
+        return MetaRequest::ParserDef(parser)
+        .Def("File-handle",        &MetaPackFile::fid,               fid_t(-1))
+        .Def("Container-handle",   &MetaPackFile::containerFid,      fid_t(-1))
+        .Def("Container-offset",   &MetaPackFile::containerOffset,   chunkOff_t(-1))
+        .Def("File-size",          &MetaPackFile::fileSize,          chunkOff_t(-1))
+        .Def("Expected-container", &MetaPackFile::expectedContainer, fid_t(-1))
+        ;
+    }
+};
+
+/*!
+ * \brief copy the source file chunk into a new chunk at the destination file
+ * offset. The chunk server hosting the source chunk, if it can host the copy,
+ * or otherwise a chunk server picked by the placement copies the chunk data
+ * into the new chunk id. The new chunk is then assigned to the destination
+ * file, and logged as chunk allocation. The replication check brings the
+ * number of replicas up to the destination file replication. The response
+ * chunk id is -1 if the source file has no chunk at the source offset.
+ */
+struct MetaCopyChunk: public MetaRequest {
+    fid_t      srcFid;
+    chunkOff_t srcOffset;
+    fid_t      fid;
+    chunkOff_t offset;
+    chunkId_t  srcChunkId;
+    chunkId_t  chunkId;
+    seq_t      chunkVersion;
+    kfsSTier_t minSTier;
+    kfsSTier_t maxSTier;
+    bool       layoutDone;
+    MetaCopyChunk()
+        : MetaRequest(META_COPY_CHUNK, true),
+          srcFid(-1),
+          srcOffset(-1),
+          fid(-1),
+          offset(-1),
+          srcChunkId(-1),
+          chunkId(-1),
+          chunkVersion(-1),
+          minSTier(kKfsSTierUndef),
+          maxSTier(kKfsSTierUndef),
+          layoutDone(false)
+        {}
+    virtual void handle();
+    virtual int log(ostream &file) const;
+    virtual void response(ostream &os);
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        return os <<
+            "copy-chunk:"
+            " src: "       << srcFid <<
+            " offset: "    << srcOffset <<
+            " chunk: "     << srcChunkId <<
+            " dst: "       << fid <<
+            " offset: "    << offset <<
+            " chunk: "     << chunkId <<
+            " version: "   << chunkVersion
+        ;
+    }
+    void LayoutDone();
+    bool Validate()
+    {
+        return (0 <= srcFid && 0 <= srcOffset && 0 <= fid && 0 <= offset);
+    }
+    template<typename T> static T& ParserDef(T& parser)
+    {
+        return MetaRequest::ParserDef(parser)
+        .Def("Source-file-handle", &MetaCopyChunk::srcFid,    fid_t(-1))
+        .Def("Source-offset",      &MetaCopyChunk::srcOffset, chunkOff_t(-1))
+        .Def("File-handle",        &MetaCopyChunk::fid,       fid_t(-1))
+        .Def("Chunk-offset",       &MetaCopyChunk::offset,    chunkOff_t(-1))
+        ;
+    }
+};
+
 /*!
  * \brief coalesce blocks of one file with another by appending the blocks from
  * src->dest.  After the coalesce is done, src will be of size 0.
@@ -1416,6 +1776,13 @@ struct MetaHello : public MetaRequest, public ServerLocation {
     int64_t            fileSystemId;
     int64_t            metaFileSystemId;
     bool               noFidsFlag;
+    bool               deleteBatchFlag;
+    int64_t            resumeInstanceId;
+    int64_t            resumeNumChunks;
+    uint64_t           resumeChecksum;
+    int64_t            instanceId;
+    size_t             chunksPos;                //!< Stable chunks added so far
+    size_t             staleChunkCount;
 
     MetaHello()
         : MetaRequest(META_HELLO, false),
@@ -1447,7 +1814,14 @@ struct MetaHello : public MetaRequest, public ServerLocation {
           deleteAllChunksFlag(false),
           fileSystemId(-1),
           metaFileSystemId(-1),
-          noFidsFlag(false)
+          noFidsFlag(false),
+          deleteBatchFlag(false),
+          resumeInstanceId(0),
+          resumeNumChunks(-1),
+          resumeChecksum(0),
+          instanceId(0),
+          chunksPos(0),
+          staleChunkCount(0)
         {}
     virtual void handle();
     virtual int log(ostream &file) const;
@@ -1484,6 +1858,10 @@ struct MetaHello : public MetaRequest, public ServerLocation {
         .Def("CKey",                         &MetaHello::cryptoKey)
         .Def("FsId",                         &MetaHello::fileSystemId,        int64_t(-1))
         .Def("NoFids",                       &MetaHello::noFidsFlag,                false)
+        .Def("Delete-batch",                 &MetaHello::deleteBatchFlag,           false)
+        .Def("Resume-instance",              &MetaHello::resumeInstanceId,     int64_t(0))
+        .Def("Resume-num-chunks",            &MetaHello::resumeNumChunks,     int64_t(-1))
+        .Def("Resume-checksum",              &MetaHello::resumeChecksum,      uint64_t(0))
         ;
     }
 };
@@ -1519,6 +1897,8 @@ struct MetaGetPathName: public MetaRequest {
     virtual void handle();
     virtual void response(ostream &os);
     virtual int log(ostream& /* file */) const { return 0; }
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -1542,21 +1922,37 @@ struct MetaGetPathName: public MetaRequest {
 struct MetaChmod: public MetaRequest {
     fid_t     fid;
     kfsMode_t mode;
+    bool      recursiveFlag; //!< change directory sub tree
+    string    cursor;        //!< sub tree traversal resume position
+    string    nextCursor;
+    int64_t   maxEntries;
+    int64_t   count;
+    int64_t   failedCount;
     MetaChmod()
         : MetaRequest(META_CHMOD, true),
           fid(-1),
-          mode(kKfsModeUndef)
+          mode(kKfsModeUndef),
+          recursiveFlag(false),
+          cursor(),
+          nextCursor(),
+          maxEntries(0),
+          count(0),
+          failedCount(0)
         {}
     virtual void handle();
     virtual void response(ostream &os);
     virtual int log(ostream& file) const;
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
             "chmod:"
-            " fid: "    << fid <<
-            " mode: "   << oct << mode << dec <<
-            " status: " << status
+            " fid: "       << fid <<
+            " mode: "      << oct << mode << dec <<
+            " recursive: " << recursiveFlag <<
+            " cursor: "    << cursor <<
+            " status: "    << status
         ;
     }
     bool Validate()
@@ -1564,8 +1960,10 @@ struct MetaChmod: public MetaRequest {
     template<typename T> static T& ParserDef(T& parser)
     {
         return MetaRequest::ParserDef(parser)
-        .Def("File-handle",  &MetaChmod::fid,    fid_t(-1))
-        .Def("Mode",         &MetaChmod::mode,   kKfsModeUndef)
+        .Def("File-handle",  &MetaChmod::fid,           fid_t(-1))
+        .Def("Mode",         &MetaChmod::mode,          kKfsModeUndef)
+        .Def("Recursive",    &MetaChmod::recursiveFlag, false)
+        .Def("Cursor",       &MetaChmod::cursor                     )
         ;
     }
 };
@@ -1576,17 +1974,31 @@ struct MetaChown: public MetaRequest {
     kfsGid_t group;
     string   ownerName;
     string   groupName;
+    bool     recursiveFlag; //!< change directory sub tree
+    string   cursor;        //!< sub tree traversal resume position
+    string   nextCursor;
+    int64_t  maxEntries;
+    int64_t  count;
+    int64_t  failedCount;
     MetaChown()
         : MetaRequest(META_CHOWN, true),
           fid(-1),
           user(kKfsUserNone),
           group(kKfsGroupNone),
           ownerName(),
-          groupName()
+          groupName(),
+          recursiveFlag(false),
+          cursor(),
+          nextCursor(),
+          maxEntries(0),
+          count(0),
+          failedCount(0)
         {}
     virtual void handle();
     virtual void response(ostream &os);
     virtual int log(ostream& file) const;
+    virtual void GetAuditIds(fid_t& outFid, fid_t& outDir) const
+        { outFid = fid; outDir = -1; }
     virtual ostream& ShowSelf(ostream& os) const
     {
         return os <<
@@ -1594,9 +2006,11 @@ struct MetaChown: public MetaRequest {
             " euser: "  << euser <<
             " egroup: " << egroup <<
             " fid: "    << fid <<
-            " user: "   << user <<
-            " group: "  << group <<
-            " status: " << status
+            " user: "      << user <<
+            " group: "     << group <<
+            " recursive: " << recursiveFlag <<
+            " cursor: "    << cursor <<
+            " status: "    << status
         ;
     }
     bool Validate()
@@ -1604,11 +2018,13 @@ struct MetaChown: public MetaRequest {
     template<typename T> static T& ParserDef(T& parser)
     {
         return MetaRequest::ParserDef(parser)
-        .Def("File-handle", &MetaChown::fid,        fid_t(-1))
-        .Def("Owner",       &MetaChown::user,       kKfsUserNone)
-        .Def("Group",       &MetaChown::group,      kKfsGroupNone)
+        .Def("File-handle", &MetaChown::fid,           fid_t(-1))
+        .Def("Owner",       &MetaChown::user,          kKfsUserNone)
+        .Def("Group",       &MetaChown::group,         kKfsGroupNone)
         .Def("OName",       &MetaChown::ownerName)
         .Def("GName",       &MetaChown::groupName)
+        .Def("Recursive",   &MetaChown::recursiveFlag, false)
+        .Def("Cursor",      &MetaChown::cursor)
         ;
     }
 };
@@ -1696,6 +2112,33 @@ struct MetaChunkDelete: public MetaChunkRequest {
     }
 };
 
+/*!
+ * \brief Delete a batch of chunks with no version specified. Used with chunk
+ * servers that support batch delete, in order to reduce the number of rpcs,
+ * and the meta and chunk server per rpc overhead when large files or
+ * directory trees are removed.
+ */
+struct MetaChunkDeleteBatch: public MetaChunkRequest {
+    ChunkIdQueue chunkIds;
+    int64_t      deletedCount; //!< output
+    MetaChunkDeleteBatch(seq_t n, const ChunkServerPtr& s)
+        : MetaChunkRequest(META_CHUNK_DELETE_BATCH, n, false, s, -1),
+          chunkIds(),
+          deletedCount(-1)
+        {}
+    virtual void request(ostream& os, IOBuffer& buf);
+    virtual void handleReply(const Properties& prop)
+    {
+        deletedCount = prop.getValue("Num-deleted", int64_t(-1));
+    }
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        return os << "meta->chunk delete batch:"
+            " count: "   << chunkIds.GetSize() <<
+            " deleted: " << deletedCount;
+    }
+};
+
 struct MetaChunkVersChange;
 
 /*!
@@ -1742,6 +2185,8 @@ struct MetaChunkReplicate: public MetaChunkRequest {
     MetaChunkVersChange*                versChange;
     FileRecoveryInFlightCount::iterator recovIt;
     string                              metaServerAccess;
+    chunkId_t                           srcChunkId; //!< chunk copy source
+    MetaCopyChunk*                      copyChunk;
     MetaChunkReplicate(seq_t n, const ChunkServerPtr& s,
             fid_t f, chunkId_t c, const ServerLocation& loc,
             const ChunkServerPtr& src, kfsSTier_t minTier, kfsSTier_t maxTier,
@@ -1768,9 +2213,11 @@ struct MetaChunkReplicate: public MetaChunkRequest {
           key(),
           versChange(0),
           recovIt(it),
-          metaServerAccess()
+          metaServerAccess(),
+          srcChunkId(-1),
+          copyChunk(0)
         {}
-    virtual ~MetaChunkReplicate() { assert(! versChange); }
+    virtual ~MetaChunkReplicate() { assert(! versChange && ! copyChunk); }
     virtual void handle();
     virtual void request(ostream &os);
     virtual void handleReply(const Properties& prop);
@@ -1877,11 +2324,14 @@ struct MetaChunkSize: public MetaChunkRequest {
 struct MetaChunkHeartbeat: public MetaChunkRequest {
     int64_t evacuateCount;
     bool    reAuthenticateFlag;
+    seq_t   deltaSeq; //!< Seq. of the last heartbeat reply, or -1 if none
     MetaChunkHeartbeat(seq_t n, const ChunkServerPtr& s,
-            int64_t evacuateCnt, bool reAuthFlag = false)
+            int64_t evacuateCnt, bool reAuthFlag = false,
+            seq_t dSeq = -1)
         : MetaChunkRequest(META_CHUNK_HEARTBEAT, n, false, s, -1),
           evacuateCount(evacuateCnt),
-          reAuthenticateFlag(reAuthFlag)
+          reAuthenticateFlag(reAuthFlag),
+          deltaSeq(dSeq)
         {}
     virtual void request(ostream &os);
     virtual ostream& ShowSelf(ostream& os) const
@@ -2144,6 +2594,70 @@ struct MetaUpServers: public MetaRequest {
     }
 };
 
+/*!
+ * \brief Dump and / or reset sampling heap profile. The profiler is
+ * available only if the meta server is linked with KfsTraceNew.
+ */
+struct MetaHeapProfile: public MetaRequest {
+    bool     resetFlag;
+    int64_t  sampleInterval;
+    IOBuffer resp;
+    MetaHeapProfile()
+        : MetaRequest(META_HEAP_PROFILE, false),
+          resetFlag(false),
+          sampleInterval(-1),
+          resp()
+        {}
+    virtual void handle();
+    virtual int log(ostream& file) const;
+    virtual void response(ostream& os, IOBuffer& buf);
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        return os << "heap profile:"
+            " reset: "    << resetFlag <<
+            " interval: " << sampleInterval
+        ;
+    }
+    bool Validate()
+    {
+        return true;
+    }
+    template<typename T> static T& ParserDef(T& parser)
+    {
+        return MetaRequest::ParserDef(parser)
+        .Def("Reset",           &MetaHeapProfile::resetFlag,      false)
+        .Def("Sample-interval", &MetaHeapProfile::sampleInterval,
+            int64_t(-1))
+        ;
+    }
+};
+
+/*!
+ * \brief No operation, used to measure rpc round trip time, and request
+ * processing overhead.
+ */
+struct MetaNoop: public MetaRequest {
+    MetaNoop()
+        : MetaRequest(META_NOOP, false)
+        {}
+    virtual void handle();
+    virtual int log(ostream& file) const;
+    virtual void response(ostream& os);
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        return os << "noop";
+    }
+    bool Validate()
+    {
+        return true;
+    }
+    template<typename T> static T& ParserDef(T& parser)
+    {
+        return MetaRequest::ParserDef(parser)
+        ;
+    }
+};
+
 /*!
  * \brief To toggle WORM mode of metaserver a client/tool can send a
  * TOGGLE_WORM request. In response, the server changes its WORM state.
@@ -2180,17 +2694,25 @@ struct MetaToggleWORM: public MetaRequest {
  * counters it keeps.
  */
 struct MetaStats: public MetaRequest {
-    string stats; //!< result
+    string  stats; //!< result
+    // Delta subscription: with non 0 deltaId only the stats changed since the
+    // response with generation deltaGen are returned.
+    int64_t deltaId;
+    int64_t deltaGen;
+    bool    deltaFullFlag;
     MetaStats()
         : MetaRequest(META_STATS, false),
-          stats()
+          stats(),
+          deltaId(0),
+          deltaGen(0),
+          deltaFullFlag(true)
         {}
     virtual void handle();
     virtual int log(ostream &file) const;
     virtual void response(ostream &os);
     virtual ostream& ShowSelf(ostream& os) const
     {
-        return os << "stats";
+        return os << "stats delta gen: " << deltaGen;
     }
     bool Validate()
     {
@@ -2199,6 +2721,8 @@ struct MetaStats: public MetaRequest {
     template<typename T> static T& ParserDef(T& parser)
     {
         return MetaRequest::ParserDef(parser)
+        .Def("Delta-id",  &MetaStats::deltaId,  int64_t(0))
+        .Def("Delta-gen", &MetaStats::deltaGen, int64_t(0))
         ;
     }
 };
@@ -2542,6 +3066,13 @@ struct MetaCheckpoint : public MetaRequest {
           checkpointWriteTimeoutSec(60 * 60),
           checkpointWriteSyncFlag(true),
           checkpointWriteBufferSize(16 << 20),
+          checkpointWriteBinaryFlag(false),
+          checkpointWriteThreadCount(0),
+          checkpointCompressionLevel(0),
+          checkpointCompressionBlockSize(4 << 20),
+          checkpointDigest(),
+          checkpointRestoreThreadCount(0),
+          logCompactor(),
           lastCheckpointId(-1),
           runningCheckpointId(-1),
           lastRun(0)
@@ -2567,6 +3098,13 @@ private:
     int    checkpointWriteTimeoutSec;
     bool   checkpointWriteSyncFlag;
     size_t checkpointWriteBufferSize;
+    bool   checkpointWriteBinaryFlag;
+    int    checkpointWriteThreadCount;
+    int    checkpointCompressionLevel;
+    size_t checkpointCompressionBlockSize;
+    string checkpointDigest;
+    int    checkpointRestoreThreadCount;
+    string logCompactor;
     seq_t  lastCheckpointId;
     seq_t  runningCheckpointId;
     time_t lastRun;
@@ -3086,6 +3624,65 @@ private:
     StringBufT<32> leaseTypeStr;
 };
 
+/*!
+ * \brief Op for renewing a list of read leases in one request.
+ * Each entry is encoded in the "Entries" header as
+ * <chunk id> <lease id> <chunk pos>, with entries separated by a single space.
+ * Negative chunk position means that the chunk is not an object store block.
+ * The entries are renewed the same way as with the individual read lease
+ * renew, except that no chunk access is returned, therefore the batch renew
+ * is not supported when chunk server access requires client authentication.
+ * The per entry status is returned in the "Entries-status" response header.
+ */
+struct MetaLeaseRenewBatch: public MetaRequest {
+    struct Entry
+    {
+        chunkId_t  chunkId;
+        int64_t    leaseId;
+        chunkOff_t chunkPos;
+        int        status;
+        Entry()
+            : chunkId(-1),
+              leaseId(-1),
+              chunkPos(-1),
+              status(0)
+            {}
+    };
+    typedef vector<Entry> Entries;
+
+    int     numEntries;
+    string  entriesStr;
+    Entries entries;
+    MetaLeaseRenewBatch()
+        : MetaRequest(META_LEASE_RENEW_BATCH, false),
+          numEntries(-1),
+          entriesStr(),
+          entries()
+        {}
+    virtual void handle();
+    virtual int log(ostream& file) const;
+    virtual void response(ostream& os);
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        os <<
+            "read lease renew batch:"
+            " entries: " << numEntries
+        ;
+        if (! entries.empty()) {
+            os << " first chunkId: " << entries.front().chunkId;
+        }
+        return os;
+    }
+    bool Validate();
+    template<typename T> static T& ParserDef(T& parser)
+    {
+        return MetaRequest::ParserDef(parser)
+        .Def("Num-entries", &MetaLeaseRenewBatch::numEntries, int(-1))
+        .Def("Entries",     &MetaLeaseRenewBatch::entriesStr    )
+        ;
+    }
+};
+
 /*!
  * \brief An internally generated op to force the cleanup of
  * dead leases thru the main event processing loop.
@@ -3103,6 +3700,106 @@ struct MetaLeaseCleanup: public MetaRequest {
     }
 };
 
+/*!
+ * \brief An internally generated op that implements the trash emptier policy
+ * of tools/Trash.cc on the meta server side. Once per interval, the op
+ * renames every user's <homes>/<user>/<trash>/<current> directory into the
+ * time stamp named trash checkpoint directory, and removes the checkpoints
+ * older than the interval with the recursive rmdir. The pass over the home
+ * directories is incremental: each op invocation is bounded by the max
+ * number of home directories, and the max number of expired checkpoints.
+ * The tree changes are logged as the equivalent rename and rmdir records.
+ */
+struct MetaTrashExpire: public MetaRequest {
+    struct Action
+    {
+        Action(fid_t d, const string& n, const string& nn)
+            : dir(d),
+              name(n),
+              newName(nn)
+            {}
+        fid_t  dir;
+        string name;
+        string newName; //!< empty for rmdir
+    };
+    typedef vector<Action> Actions;
+
+    string   homesPrefix;
+    string   trashName;
+    string   currentName;
+    int      intervalSec;
+    int      maxHomesPerRun;
+    int      maxExpirePerRun;
+    string   homeCursor;
+    time_t   nextPassTime;
+    int64_t  mtime;
+    Actions  actions;
+    MetaTrashExpire(seq_t s, KfsCallbackObj *c)
+        : MetaRequest(META_TRASH_EXPIRE, true, s),
+          homesPrefix("/user"),
+          trashName(".Trash"),
+          currentName("Current"),
+          intervalSec(0),
+          maxHomesPerRun(256),
+          maxExpirePerRun(64),
+          homeCursor(),
+          nextPassTime(0),
+          mtime(0),
+          actions()
+            { clnt = c; }
+
+    virtual void handle();
+    virtual int log(ostream &file) const;
+    void SetParameters(const Properties& props);
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        return os <<
+            "trash expire:"
+            " cursor: "  << homeCursor <<
+            " actions: " << actions.size()
+        ;
+    }
+private:
+    bool ExpireHome(fid_t home, time_t now, int& expireCount);
+};
+
+/*!
+ * \brief An internally generated op to move files between the "hot" and
+ * "cold" storage tiers ranges by their read access temperature. The file
+ * storage tiers changes are logged as change file replication, the chunk
+ * replicas are moved by the layout manager.
+ */
+struct MetaTierMigrate: public MetaRequest {
+    struct Action
+    {
+        Action(fid_t f, kfsSTier_t minTier, kfsSTier_t maxTier)
+            : fid(f),
+              minSTier(minTier),
+              maxSTier(maxTier)
+            {}
+        fid_t      fid;
+        kfsSTier_t minSTier;
+        kfsSTier_t maxSTier;
+    };
+    typedef vector<Action> Actions;
+
+    Actions actions;
+    MetaTierMigrate(seq_t s, KfsCallbackObj *c)
+        : MetaRequest(META_TIER_MIGRATE, true, s),
+          actions()
+            { clnt = c; }
+
+    virtual void handle();
+    virtual int log(ostream &file) const;
+    virtual ostream& ShowSelf(ostream& os) const
+    {
+        return os <<
+            "tier migration:"
+            " changes: " << actions.size()
+        ;
+    }
+};
+
 /*!
  * \brief An internally generated op to check that the degree
  * of replication for each chunk is satisfactory.  This op goes
@@ -3173,6 +3870,9 @@ void printleaves();
 void setClusterKey(const char *key);
 void setMD5SumFn(const char *md5sumFn);
 void setWORMMode(bool value);
+void setStandbyMode(bool value);
+bool getStandbyMode();
+void setStandbyReplayTime(time_t value);
 void setMaxReplicasPerFile(int16_t value);
 void setChunkmapDumpDir(string dir);
 void CheckIfIoBuffersAvailable();
@@ -12,6 +12,7 @@ static const MetaRequestHandler& MakeMetaRequestHandler()
     return sHandler
     .MakeParser<MetaLookup               >("LOOKUP")
     .MakeParser<MetaLookupPath           >("LOOKUP_PATH")
+    .MakeParser<MetaLookupBatch          >("LOOKUP_BATCH")
     .MakeParser<MetaCreate               >("CREATE")
     .MakeParser<MetaMkdir                >("MKDIR")
     .MakeParser<MetaRemove               >("REMOVE")
@@ -25,6 +26,8 @@ static const MetaRequestHandler& MakeMetaRequestHandler()
     .MakeParser<MetaRename               >("RENAME")
     .MakeParser<MetaSetMtime             >("SET_MTIME")
     .MakeParser<MetaChangeFileReplication>("CHANGE_FILE_REPLICATION")
+    .MakeParser<MetaPackFile             >("PACK_FILE")
+    .MakeParser<MetaCopyChunk            >("COPY_CHUNK")
     .MakeParser<MetaCoalesceBlocks       >("COALESCE_BLOCKS")
     .MakeParser<MetaRetireChunkserver    >("RETIRE_CHUNKSERVER")
 
@@ -38,11 +41,14 @@ static const MetaRequestHandler& MakeMetaRequestHandler()
     // Lease related ops
     .MakeParser<MetaLeaseAcquire         >("LEASE_ACQUIRE")
     .MakeParser<MetaLeaseRenew           >("LEASE_RENEW")
+    .MakeParser<MetaLeaseRenewBatch      >("LEASE_RENEW_BATCH")
     .MakeParser<MetaLeaseRelinquish      >("LEASE_RELINQUISH")
 
     .MakeParser<MetaCheckLeases          >("CHECK_LEASES")
     .MakeParser<MetaPing                 >("PING")
     .MakeParser<MetaUpServers            >("UPSERVERS")
+    .MakeParser<MetaHeapProfile          >("HEAP_PROFILE")
+    .MakeParser<MetaNoop                 >("NOOP")
     .MakeParser<MetaToggleWORM           >("TOGGLE_WORM")
     .MakeParser<MetaStats                >("STATS")
     .MakeParser<MetaRecomputeDirsize     >("RECOMPUTE_DIRSIZE")
@@ -39,6 +39,7 @@
 #include "kfsio/IOBuffer.h"
 #include "kfsio/SslFilter.h"
 #include "kfsio/CryptoKeys.h"
+#include "kfsio/MetricsServer.h"
 #include "common/Properties.h"
 #include "common/MsgLogger.h"
 #include "common/time.h"
@@ -49,14 +50,26 @@
 #include "qcdio/qcstutils.h"
 
 #include <inttypes.h>
+#include <stdlib.h>
 #include <algorithm>
 #include <vector>
 #include <set>
+#include <map>
+#include <deque>
+#include <sstream>
 
 namespace KFS
 {
 using std::max;
+using std::min;
+using std::ostringstream;
+using std::istringstream;
 using std::vector;
+using std::deque;
+using std::map;
+using std::pair;
+using std::less;
+using std::make_pair;
 
 using KFS::libkfsio::globalNetManager;
 using KFS::libkfsio::globals;
@@ -251,6 +264,617 @@ private:
     uint64_t    mUpdateCount;
 };
 
+// OpenMetrics scrape endpoint. The snapshot is refreshed incrementally by the
+// main thread: the global metrics are collected at the beginning of each
+// update cycle, and the chunk server heartbeat counters in batches of the
+// configured size per timer tick, in order to bound the main thread time
+// spent with large number of chunk servers. The metrics server thread serves
+// the last complete snapshot.
+class NetDispatch::Metrics : public ITimeout
+{
+public:
+    Metrics()
+        : ITimeout(),
+          mServer(),
+          mBuilder(),
+          mServers(),
+          mOs(),
+          mText(),
+          mLabels(),
+          mLocation(),
+          mIpV6OnlyFlag(false),
+          mMaxConnections(16),
+          mIoTimeoutSec(60),
+          mUpdateIntervalSec(10),
+          mMaxChunkServersPerUpdate(256),
+          mNextIdx(0),
+          mNextUpdateTime(0),
+          mNetManagerPtr(0)
+        {}
+    ~Metrics()
+        { Metrics::Stop(); }
+    void SetParameters(
+        const Properties& inProps)
+    {
+        const ServerLocation theLocation(
+            inProps.getValue("metaServer.metrics.host", mLocation.hostname),
+            inProps.getValue("metaServer.metrics.port", mLocation.port)
+        );
+        const bool theIpV6OnlyFlag = inProps.getValue(
+            "metaServer.metrics.ipV6Only", mIpV6OnlyFlag ? 1 : 0) != 0;
+        const int  theMaxConnections = inProps.getValue(
+            "metaServer.metrics.maxConnections", mMaxConnections);
+        const int  theIoTimeoutSec = inProps.getValue(
+            "metaServer.metrics.ioTimeoutSec", mIoTimeoutSec);
+        mUpdateIntervalSec = max(1, inProps.getValue(
+            "metaServer.metrics.updateIntervalSec", mUpdateIntervalSec));
+        mMaxChunkServersPerUpdate = max(1, inProps.getValue(
+            "metaServer.metrics.maxChunkServersPerUpdate",
+            mMaxChunkServersPerUpdate));
+        if (theLocation == mLocation &&
+                theIpV6OnlyFlag == mIpV6OnlyFlag &&
+                theMaxConnections == mMaxConnections &&
+                theIoTimeoutSec == mIoTimeoutSec) {
+            return;
+        }
+        mLocation       = theLocation;
+        mIpV6OnlyFlag   = theIpV6OnlyFlag;
+        mMaxConnections = theMaxConnections;
+        mIoTimeoutSec   = theIoTimeoutSec;
+        if (mNetManagerPtr) {
+            NetManager& theNetManager = *mNetManagerPtr;
+            Stop();
+            Start(theNetManager);
+        }
+    }
+    void Start(
+        NetManager& inNetManager)
+    {
+        if (mNetManagerPtr || mLocation.port < 0) {
+            return;
+        }
+        const int theErr = mServer.Start(
+            mLocation, mIpV6OnlyFlag, mMaxConnections, mIoTimeoutSec);
+        if (theErr != 0) {
+            KFS_LOG_STREAM_ERROR <<
+                "failed to start metrics server on: " << mLocation <<
+                " " << QCUtils::SysError(-theErr) <<
+            KFS_LOG_EOM;
+            return;
+        }
+        mNetManagerPtr  = &inNetManager;
+        mNextIdx        = 0;
+        mNextUpdateTime = 0;
+        mServers.clear();
+        mBuilder.Clear();
+        SetTimeoutInterval(0);
+        mNetManagerPtr->RegisterTimeoutHandler(this);
+    }
+    void Stop()
+    {
+        if (! mNetManagerPtr) {
+            return;
+        }
+        mNetManagerPtr->UnRegisterTimeoutHandler(this);
+        mNetManagerPtr = 0;
+        mServer.Stop();
+        mServers.clear();
+        mBuilder.Clear();
+    }
+    void ChildAtFork()
+    {
+        if (mNetManagerPtr) {
+            mServer.ChildAtFork();
+        }
+    }
+    virtual void Timeout()
+    {
+        if (mNextIdx <= 0) {
+            if (mNetManagerPtr->Now() < mNextUpdateTime) {
+                return;
+            }
+            mNextUpdateTime = mNetManagerPtr->Now() + mUpdateIntervalSec;
+            AddGlobal();
+            mServers = gLayoutManager.GetChunkServers();
+        }
+        const size_t theEnd = min(mServers.size(),
+            mNextIdx + (size_t)mMaxChunkServersPerUpdate);
+        const char* const kPrefix = "qfs_meta_chunk_server_";
+        for (; mNextIdx < theEnd; mNextIdx++) {
+            const ChunkServer& theServer = *mServers[mNextIdx];
+            mLabels.clear();
+            MetricsBuilder::AppendLabel(
+                mLabels, "server", theServer.GetHostPortStr());
+            mBuilder.AddProperties(kPrefix, mLabels.c_str(),
+                theServer.HeartBeatProperties());
+        }
+        if (mNextIdx < mServers.size()) {
+            return;
+        }
+        mNextIdx = 0;
+        mServers.clear();
+        mText.clear();
+        mBuilder.Write(mText);
+        mBuilder.Clear();
+        mServer.SetSnapshot(mText);
+    }
+private:
+    typedef LayoutManager::Servers Servers;
+
+    MetricsServer  mServer;
+    MetricsBuilder mBuilder;
+    Servers        mServers;
+    ostringstream  mOs;
+    string         mText;
+    string         mLabels;
+    ServerLocation mLocation;
+    bool           mIpV6OnlyFlag;
+    int            mMaxConnections;
+    int            mIoTimeoutSec;
+    int            mUpdateIntervalSec;
+    int            mMaxChunkServersPerUpdate;
+    size_t         mNextIdx;
+    time_t         mNextUpdateTime;
+    NetManager*    mNetManagerPtr;
+
+    void AddGlobal()
+    {
+        const char* const kPrefix = "qfs_meta_";
+        const char* const kLabels = "";
+        mBuilder.Clear();
+        mBuilder.AddCounters(kPrefix, kLabels, globals().counterManager);
+        NetManager::EventStats theMainStats;
+        NetManager::EventStats theClientThreadsStats;
+        gNetDispatch.GetEventStats(theMainStats, theClientThreadsStats);
+        mOs.str(string());
+        theMainStats.Display(mOs, "Net-main-");
+        theClientThreadsStats.Display(mOs, "Net-client-threads-");
+        mOs.flush();
+        const string& theStr = mOs.str();
+        mBuilder.AddKeyValues(kPrefix, kLabels, theStr.data(), theStr.size());
+        mOs.str(string());
+        mBuilder.Add(kPrefix, "chunk_servers", kLabels,
+            (int64_t)ChunkServer::GetChunkServerCount());
+        mBuilder.Add(kPrefix, "clients", kLabels,
+            (int64_t)ClientSM::GetClientCount());
+        mBuilder.Add(kPrefix, "requests_in_flight", kLabels,
+            (int64_t)MetaRequest::GetRequestCount());
+        mBuilder.Add(kPrefix, "open_net_fds", kLabels,
+            globals().ctrOpenNetFds.GetValue());
+        MetricsServer::Counters theCntrs;
+        mServer.GetCounters(theCntrs);
+        mBuilder.Add(kPrefix, "metrics_requests", kLabels,
+            theCntrs.mRequestCount, MetricsBuilder::kTypeCounter);
+        mBuilder.Add(kPrefix, "metrics_rejected_connections", kLabels,
+            theCntrs.mRejectCount, MetricsBuilder::kTypeCounter);
+    }
+private:
+    Metrics(
+        const Metrics& inMetrics);
+    Metrics& operator=(
+        const Metrics& inMetrics);
+};
+
+// Per principal request admission control. The principal is user, group, or
+// client host, depending on the configuration. Each principal has a token
+// bucket that limits its request rate, and all principals share the global
+// rate limit token bucket. The requests that exceed either limit are queued
+// per principal. The main thread drains the queues with weighted deficit
+// round robin, in order to share the available global rate between the
+// principals fairly, in proportion to their weights. The admin (root), and
+// chunk server requests bypass admission control, unless the respective
+// weight is set to a positive value.
+class NetDispatch::Admission : public ITimeout
+{
+public:
+    typedef NetDispatch::AdmitStatus Status;
+
+    Admission()
+        : ITimeout(),
+          mPrincipals(),
+          mActive(),
+          mWeights(),
+          mSubmit(),
+          mModeStr("user"),
+          mWeightsStr(),
+          mMode(kModeUser),
+          mPrincipalOpsPerSec(0),
+          mPrincipalBurst(0),
+          mMaxOpsPerSec(0),
+          mBurst(0),
+          mAdminWeight(0),
+          mChunkServerWeight(0),
+          mMaxQueuedPerPrincipal(1024),
+          mMaxQueued(16 << 10),
+          mDrainIntervalMs(10),
+          mIdleExpirationSec(300),
+          mQueuedCount(0),
+          mTokens(0),
+          mTokensTimeUsec(0),
+          mNextCleanupTime(0),
+          mAdmittedCounter("Admission admitted"),
+          mQueuedCounter("Admission queued"),
+          mRejectedCounter("Admission rejected"),
+          mNetManagerPtr(0),
+          mMutexPtr(0)
+        {}
+    ~Admission()
+        { Set(0, 0); }
+    void Set(
+        NetManager* inNetManagerPtr,
+        QCMutex*    inMutexPtr)
+    {
+        if (mNetManagerPtr) {
+            mNetManagerPtr->UnRegisterTimeoutHandler(this);
+            globals().counterManager.RemoveCounter(&mAdmittedCounter);
+            globals().counterManager.RemoveCounter(&mQueuedCounter);
+            globals().counterManager.RemoveCounter(&mRejectedCounter);
+            // Shutdown, the client state machines are about to be deleted.
+            mActive.clear();
+            mPrincipals.clear();
+            mQueuedCount = 0;
+        }
+        mMutexPtr      = inMutexPtr;
+        mNetManagerPtr = inNetManagerPtr;
+        if (mNetManagerPtr) {
+            globals().counterManager.AddCounter(&mAdmittedCounter);
+            globals().counterManager.AddCounter(&mQueuedCounter);
+            globals().counterManager.AddCounter(&mRejectedCounter);
+            SetTimeoutInterval(IsEnabled() ? mDrainIntervalMs : 1000);
+            mNetManagerPtr->RegisterTimeoutHandler(this);
+        }
+    }
+    void SetParameters(
+        const Properties& inProps)
+    {
+        QCStMutexLocker theLocker(mMutexPtr);
+        mModeStr = inProps.getValue("metaServer.admission.mode", mModeStr);
+        mMode    = mModeStr == "group" ? kModeGroup :
+            (mModeStr == "host" ? kModeHost : kModeUser);
+        mPrincipalOpsPerSec = max(0.0, inProps.getValue(
+            "metaServer.admission.principalOpsPerSec", mPrincipalOpsPerSec));
+        mPrincipalBurst = max(0.0, inProps.getValue(
+            "metaServer.admission.principalBurst", mPrincipalBurst));
+        mMaxOpsPerSec = max(0.0, inProps.getValue(
+            "metaServer.admission.maxOpsPerSec", mMaxOpsPerSec));
+        mBurst = max(0.0, inProps.getValue(
+            "metaServer.admission.burst", mBurst));
+        mAdminWeight = max(0.0, inProps.getValue(
+            "metaServer.admission.adminWeight", mAdminWeight));
+        mChunkServerWeight = max(0.0, inProps.getValue(
+            "metaServer.admission.chunkServerWeight", mChunkServerWeight));
+        mMaxQueuedPerPrincipal = max(0, inProps.getValue(
+            "metaServer.admission.maxQueuedPerPrincipal",
+            mMaxQueuedPerPrincipal));
+        mMaxQueued = max(0, inProps.getValue(
+            "metaServer.admission.maxQueued", mMaxQueued));
+        mDrainIntervalMs = max(1, inProps.getValue(
+            "metaServer.admission.drainIntervalMs", mDrainIntervalMs));
+        mIdleExpirationSec = max(1, inProps.getValue(
+            "metaServer.admission.idleExpirationSec", mIdleExpirationSec));
+        mWeightsStr = inProps.getValue(
+            "metaServer.admission.weights", mWeightsStr);
+        // Weights list format: <uid|gid|host>:<weight> ...
+        mWeights.clear();
+        istringstream theStream(mWeightsStr);
+        string        theEntry;
+        while ((theStream >> theEntry)) {
+            const size_t thePos = theEntry.rfind(':');
+            if (thePos == string::npos || thePos <= 0) {
+                continue;
+            }
+            const double theWeight = atof(theEntry.c_str() + thePos + 1);
+            if (theWeight <= 0) {
+                continue;
+            }
+            mWeights[MakeKey(theEntry.substr(0, thePos))] = theWeight;
+        }
+        for (Principals::iterator theIt = mPrincipals.begin();
+                theIt != mPrincipals.end();
+                ++theIt) {
+            theIt->second.mWeight = GetWeight(theIt->first);
+        }
+        if (mNetManagerPtr) {
+            SetTimeoutInterval(IsEnabled() ? mDrainIntervalMs : 1000);
+        }
+    }
+    bool IsEnabled() const
+        { return (0 < mPrincipalOpsPerSec || 0 < mMaxOpsPerSec); }
+    Status Admit(
+        MetaRequest& inOp)
+    {
+        if (! mNetManagerPtr || ! IsEnabled()) {
+            return NetDispatch::kAdmitSubmit;
+        }
+        QCStMutexLocker theLocker(mMutexPtr);
+        Key theKey;
+        if (inOp.fromChunkServerFlag) {
+            if (mChunkServerWeight <= 0) {
+                return NetDispatch::kAdmitSubmit;
+            }
+            theKey = Key(kChunkServer, string());
+        } else if (inOp.euser == kKfsUserRoot) {
+            if (mAdminWeight <= 0) {
+                return NetDispatch::kAdmitSubmit;
+            }
+            theKey = Key(kAdmin, string());
+        } else {
+            theKey = mMode == kModeHost ? Key(kHost, inOp.clientIp) :
+                Key(mMode == kModeGroup ? int64_t(inOp.egroup) :
+                    int64_t(inOp.euser), string());
+        }
+        const int64_t theNowUsec = microseconds();
+        Principals::iterator const theIt = GetPrincipal(theKey, theNowUsec);
+        Principal&                 thePrincipal = theIt->second;
+        Refill(thePrincipal, theNowUsec);
+        RefillGlobal(theNowUsec);
+        if (thePrincipal.mQueue.empty() &&
+                (mMaxOpsPerSec <= 0 || mQueuedCount <= 0) &&
+                HasTokens(thePrincipal)) {
+            ConsumeTokens(thePrincipal);
+            mAdmittedCounter.Update(1);
+            return NetDispatch::kAdmitSubmit;
+        }
+        if (mMaxQueuedPerPrincipal <= (int)thePrincipal.mQueue.size() ||
+                mMaxQueued <= mQueuedCount) {
+            mRejectedCounter.Update(1);
+            inOp.status    = -EAGAIN;
+            inOp.statusMsg = "request rate limit exceeded, try again later";
+            return NetDispatch::kAdmitRejected;
+        }
+        if (thePrincipal.mQueue.empty()) {
+            mActive.push_back(theIt);
+        }
+        thePrincipal.mQueue.push_back(&inOp);
+        mQueuedCount++;
+        mQueuedCounter.Update(1);
+        return NetDispatch::kAdmitQueued;
+    }
+    virtual void Timeout()
+    {
+        QCStMutexLocker theLocker(mMutexPtr);
+        const int64_t theNowUsec = microseconds();
+        if (mQueuedCount <= 0) {
+            Cleanup(theNowUsec);
+            return;
+        }
+        RefillGlobal(theNowUsec);
+        mSubmit.clear();
+        size_t theIdleCount = 0;
+        while (! mActive.empty() && theIdleCount < mActive.size() &&
+                (mMaxOpsPerSec <= 0 || 1 <= mTokens)) {
+            Principals::iterator const theIt = mActive.front();
+            mActive.pop_front();
+            Principal& thePrincipal = theIt->second;
+            Refill(thePrincipal, theNowUsec);
+            // Carry over unused quantum, but no more than one round worth of
+            // it, in order to prevent the throttled principal from
+            // accumulating unbounded credit.
+            thePrincipal.mDeficit = min(
+                thePrincipal.mDeficit + thePrincipal.mWeight,
+                2 * thePrincipal.mWeight
+            );
+            bool theIdleFlag = true;
+            while (! thePrincipal.mQueue.empty() &&
+                    1 <= thePrincipal.mDeficit &&
+                    HasTokens(thePrincipal)) {
+                ConsumeTokens(thePrincipal);
+                thePrincipal.mDeficit -= 1;
+                mSubmit.push_back(thePrincipal.mQueue.front());
+                thePrincipal.mQueue.pop_front();
+                mQueuedCount--;
+                theIdleFlag = false;
+            }
+            if (thePrincipal.mQueue.empty()) {
+                thePrincipal.mDeficit = 0;
+            } else {
+                mActive.push_back(theIt);
+            }
+            theIdleCount = theIdleFlag ? theIdleCount + 1 : 0;
+        }
+        mAdmittedCounter.Update((int64_t)mSubmit.size());
+        theLocker.Unlock();
+        // The main thread holds the dispatch mutex.
+        for (Submit::const_iterator theIt = mSubmit.begin();
+                theIt != mSubmit.end();
+                ++theIt) {
+            submit_request(*theIt);
+        }
+        mSubmit.clear();
+    }
+private:
+    enum Mode
+    {
+        kModeUser,
+        kModeGroup,
+        kModeHost
+    };
+    enum
+    {
+        kHost        = -1,
+        kAdmin       = -2,
+        kChunkServer = -3
+    };
+    typedef pair<int64_t, string> Key;
+    typedef deque<MetaRequest*>   Queue;
+    struct Principal
+    {
+        Principal()
+            : mTokens(0),
+              mTimeUsec(0),
+              mWeight(1),
+              mDeficit(0),
+              mQueue()
+            {}
+        double  mTokens;
+        int64_t mTimeUsec;
+        double  mWeight;
+        double  mDeficit;
+        Queue   mQueue;
+    };
+    typedef map<
+        Key,
+        Principal,
+        less<Key>,
+        StdFastAllocator<pair<const Key, Principal> >
+    > Principals;
+    typedef deque<Principals::iterator> Active;
+    typedef map<Key, double>            Weights;
+    typedef vector<MetaRequest*>        Submit;
+
+    Principals  mPrincipals;
+    Active      mActive;
+    Weights     mWeights;
+    Submit      mSubmit;
+    string      mModeStr;
+    string      mWeightsStr;
+    Mode        mMode;
+    double      mPrincipalOpsPerSec;
+    double      mPrincipalBurst;
+    double      mMaxOpsPerSec;
+    double      mBurst;
+    double      mAdminWeight;
+    double      mChunkServerWeight;
+    int         mMaxQueuedPerPrincipal;
+    int         mMaxQueued;
+    int         mDrainIntervalMs;
+    int         mIdleExpirationSec;
+    int         mQueuedCount;
+    double      mTokens;
+    int64_t     mTokensTimeUsec;
+    time_t      mNextCleanupTime;
+    Counter     mAdmittedCounter;
+    Counter     mQueuedCounter;
+    Counter     mRejectedCounter;
+    NetManager* mNetManagerPtr;
+    QCMutex*    mMutexPtr;
+
+    Key MakeKey(
+        const string& inName) const
+    {
+        if (inName == "admin") {
+            return Key(kAdmin, string());
+        }
+        if (inName == "chunkServer") {
+            return Key(kChunkServer, string());
+        }
+        if (mMode == kModeHost) {
+            return Key(kHost, inName);
+        }
+        return Key(atoll(inName.c_str()), string());
+    }
+    double GetWeight(
+        const Key& inKey) const
+    {
+        if (inKey.first == kAdmin) {
+            return max(1.0, mAdminWeight);
+        }
+        if (inKey.first == kChunkServer) {
+            return max(1.0, mChunkServerWeight);
+        }
+        Weights::const_iterator const theIt = mWeights.find(inKey);
+        // Weight less than 1 can require multiple rounds to dequeue a request.
+        return (theIt == mWeights.end() ? 1.0 : max(1.0, theIt->second));
+    }
+    Principals::iterator GetPrincipal(
+        const Key& inKey,
+        int64_t    inNowUsec)
+    {
+        pair<Principals::iterator, bool> const theRes =
+            mPrincipals.insert(make_pair(inKey, Principal()));
+        if (theRes.second) {
+            Principal& thePrincipal = theRes.first->second;
+            thePrincipal.mWeight   = GetWeight(inKey);
+            thePrincipal.mTokens   = GetBurst(thePrincipal);
+            thePrincipal.mTimeUsec = inNowUsec;
+        }
+        return theRes.first;
+    }
+    double GetBurst(
+        const Principal& inPrincipal) const
+    {
+        return max(1.0, 0 < mPrincipalBurst ? mPrincipalBurst :
+            mPrincipalOpsPerSec * inPrincipal.mWeight);
+    }
+    static double Refill(
+        double&  ioTokens,
+        int64_t& ioTimeUsec,
+        double   inRate,
+        double   inBurst,
+        int64_t  inNowUsec)
+    {
+        if (ioTimeUsec < inNowUsec) {
+            ioTokens = min(inBurst,
+                ioTokens + inRate * (inNowUsec - ioTimeUsec) * 1e-6);
+            ioTimeUsec = inNowUsec;
+        }
+        return ioTokens;
+    }
+    void Refill(
+        Principal& inPrincipal,
+        int64_t    inNowUsec)
+    {
+        if (0 < mPrincipalOpsPerSec) {
+            Refill(inPrincipal.mTokens, inPrincipal.mTimeUsec,
+                mPrincipalOpsPerSec * inPrincipal.mWeight,
+                GetBurst(inPrincipal), inNowUsec);
+        } else {
+            inPrincipal.mTimeUsec = inNowUsec;
+        }
+    }
+    void RefillGlobal(
+        int64_t inNowUsec)
+    {
+        if (0 < mMaxOpsPerSec) {
+            Refill(mTokens, mTokensTimeUsec, mMaxOpsPerSec,
+                max(1.0, 0 < mBurst ? mBurst : mMaxOpsPerSec), inNowUsec);
+        }
+    }
+    bool HasTokens(
+        const Principal& inPrincipal) const
+    {
+        return (
+            (mPrincipalOpsPerSec <= 0 || 1 <= inPrincipal.mTokens) &&
+            (mMaxOpsPerSec <= 0 || 1 <= mTokens)
+        );
+    }
+    void ConsumeTokens(
+        Principal& inPrincipal)
+    {
+        if (0 < mPrincipalOpsPerSec) {
+            inPrincipal.mTokens -= 1;
+        }
+        if (0 < mMaxOpsPerSec) {
+            mTokens -= 1;
+        }
+    }
+    void Cleanup(
+        int64_t inNowUsec)
+    {
+        const time_t theNow = mNetManagerPtr->Now();
+        if (theNow < mNextCleanupTime) {
+            return;
+        }
+        mNextCleanupTime = theNow + mIdleExpirationSec;
+        const int64_t theExpireUsec =
+            inNowUsec - int64_t(mIdleExpirationSec) * 1000 * 1000;
+        // All queues are empty, no active list entries reference principals.
+        Principals::iterator theIt = mPrincipals.begin();
+        while (theIt != mPrincipals.end()) {
+            if (theIt->second.mTimeUsec < theExpireUsec) {
+                mPrincipals.erase(theIt++);
+            } else {
+                ++theIt;
+            }
+        }
+    }
+private:
+    Admission(
+        const Admission& inAdmission);
+    Admission& operator=(
+        const Admission& inAdmission);
+};
+
 bool
 NetDispatch::CancelToken(
     const DelegationToken& token)
@@ -314,6 +938,12 @@ NetDispatch::GetCanceledTokensUpdateCount() const
     return mCanceledTokens.GetUpdateCount();
 }
 
+NetDispatch::AdmitStatus
+NetDispatch::Admit(MetaRequest& op)
+{
+    return mAdmission.Admit(op);
+}
+
 NetDispatch::NetDispatch()
     : mClientManager(),
       mChunkServerFactory(),
@@ -321,6 +951,8 @@ NetDispatch::NetDispatch()
       mClientManagerMutex(0),
       mCryptoKeys(0),
       mCanceledTokens(*(new CanceledTokens())),
+      mMetrics(*(new Metrics())),
+      mAdmission(*(new Admission())),
       mRunningFlag(false),
       mClientThreadCount(0),
       mClientThreadsStartCpuAffinity(-1)
@@ -329,6 +961,8 @@ NetDispatch::NetDispatch()
 
 NetDispatch::~NetDispatch()
 {
+    delete &mAdmission;
+    delete &mMetrics;
     delete &mCanceledTokens;
 }
 
@@ -403,6 +1037,7 @@ NetDispatch::Start()
     // Start the acceptors so that it sets up a connection with the net
     // manager for listening.
     QCMutex cancelTokensMutex;
+    QCMutex admissionMutex;
     if (mClientThreadsStartCpuAffinity >= 0 &&
             (err = QCThread::SetCurrentThreadAffinity(
                 QCThread::CpuAffinity(mClientThreadsStartCpuAffinity)))) {
@@ -423,6 +1058,11 @@ NetDispatch::Start()
             &globalNetManager(),
             GetMutex() ? &cancelTokensMutex : 0
         );
+        mMetrics.Start(globalNetManager());
+        mAdmission.Set(
+            &globalNetManager(),
+            GetMutex() ? &admissionMutex : 0
+        );
         const bool              kWakeupAndCleanupFlag = true;
         MainThreadPrepareToFork prepareToFork(mClientManager);
         // Run main thread event processing.
@@ -434,6 +1074,8 @@ NetDispatch::Start()
     } else {
         err = -EINVAL;
     }
+    mMetrics.Stop();
+    mAdmission.Set(0, 0);
     mClientManager.Shutdown();
     mCanceledTokens.Set(0, 0);
     mRunningFlag = false;
@@ -446,6 +1088,7 @@ NetDispatch::Start()
 void
 NetDispatch::ChildAtFork()
 {
+    mMetrics.ChildAtFork();
     mClientManager.ChildAtFork();
 }
 
@@ -583,6 +1226,7 @@ private:
         AddCounter("Get layout", META_GETLAYOUT);
         AddCounter("Lookup", META_LOOKUP);
         AddCounter("Lookup Path", META_LOOKUP_PATH);
+        AddCounter("Lookup Batch", META_LOOKUP_BATCH);
         AddCounter("Allocate", META_ALLOCATE);
         AddCounter("Truncate", META_TRUNCATE);
         AddCounter("Create", META_CREATE);
@@ -592,9 +1236,14 @@ private:
         AddCounter("Mkdir", META_MKDIR);
         AddCounter("Rmdir", META_RMDIR);
         AddCounter("Change File Replication", META_CHANGE_FILE_REPLICATION);
+        AddCounter("Pack File", META_PACK_FILE);
+        AddCounter("Copy Chunk", META_COPY_CHUNK);
         AddCounter("Lease Acquire", META_LEASE_ACQUIRE);
         AddCounter("Lease Renew", META_LEASE_RENEW);
+        AddCounter("Lease Renew Batch", META_LEASE_RENEW_BATCH);
         AddCounter("Lease Cleanup", META_LEASE_CLEANUP);
+        AddCounter("Trash Expire", META_TRASH_EXPIRE);
+        AddCounter("Tier Migrate", META_TIER_MIGRATE);
         AddCounter("Corrupt Chunk ", META_CHUNK_CORRUPT);
         AddCounter("Chunkserver Hello ", META_HELLO);
         AddCounter("Chunkserver Bye ", META_BYE);
@@ -796,6 +1445,10 @@ private:
     }
 } sReqStatsGatherer;
 
+// Main thread, and no client threads request phase stats, protected by the
+// global mutex.
+static MetaRequestPhaseStats sRequestPhaseStats;
+
 
 void NetDispatch::SetParameters(const Properties& props)
 {
@@ -819,9 +1472,18 @@ void NetDispatch::SetParameters(const Properties& props)
     globalNetManager().SetMaxAcceptsPerRead(props.getValue(
         "metaServer.net.maxAcceptsPerRead",
         globalNetManager().GetMaxAcceptsPerRead()));
+    NetManager::SetSlowDispatchThresholdUsec(props.getValue(
+        "metaServer.netManager.slowDispatchThresholdUsec",
+        NetManager::GetSlowDispatchThresholdUsec()));
+    NetManager::SetEdgeTriggeredPoll(props.getValue(
+        "metaServer.netManager.edgeTriggeredPoll",
+        NetManager::GetEdgeTriggeredPoll() ? 1 : 0) != 0);
 
     sReqStatsGatherer.SetParameters(props);
+    MetaRequestPhaseStats::SetParameters(props);
     mClientManager.SetParameters(props);
+    mMetrics.SetParameters(props);
+    mAdmission.SetParameters(props);
 
     string errMsg;
     int    err;
@@ -844,6 +1506,21 @@ void NetDispatch::GetStatsCsv(IOBuffer& buf)
     sReqStatsGatherer.GetStatsCsv(buf);
 }
 
+void NetDispatch::GetEventStats(
+    NetManager::EventStats& mainStats,
+    NetManager::EventStats& clientThreadsStats) const
+{
+    globalNetManager().GetEventStats(mainStats);
+    mClientManager.GetEventStats(clientThreadsStats);
+}
+
+void NetDispatch::GetRequestPhaseStats(MetaRequestPhaseStats& stats) const
+{
+    stats.Clear();
+    stats.Add(sRequestPhaseStats);
+    mClientManager.GetRequestPhaseStats(stats);
+}
+
 int64_t NetDispatch::GetUserCpuMicroSec() const
 {
     return sReqStatsGatherer.GetUserCpuMicroSec();
@@ -904,6 +1581,13 @@ UpdatePathToFidCacheHit(int count)
 void
 NetDispatch::Dispatch(MetaRequest *r)
 {
+    r->commitTime = microseconds();
+    if (! r->fromClientSMFlag) {
+        // No response send phase, the client sm requests phase stats are
+        // updated when response is sent.
+        sRequestPhaseStats.Update(*r, r->commitTime);
+        r->handleTime = 0;
+    }
     sReqStatsGatherer.OpDone(*r);
     // Reset count for requests like replication check, where the same
     // request reused.
@@ -937,7 +1621,11 @@ public:
           mForkDoneCond(),
           mForkDoneCount(0),
           mPrepareToForkFlag(false),
-          mPrepareToForkCnt(0)
+          mPrepareToForkCnt(0),
+          mConcurrentReadsDoneCond(),
+          mConcurrentReadersCount(0),
+          mPendingWritersCount(0),
+          mConcurrentReadsFlag(false)
         {};
     virtual ~Impl();
     bool Bind(const ServerLocation& location, bool ipV6OnlyFlag);
@@ -955,17 +1643,37 @@ public:
             return;
         }
         assert(mutex->IsOwned());
-        while (mPrepareToForkFlag) {
-            // The prepare thread count includes the "main" thread.
-            if (++mPrepareToForkCnt >= mClientThreadCount) {
-                mPrepareToForkDoneCond.Notify();
-            }
-            const uint64_t forkDoneCount = mForkDoneCount;
-            while (forkDoneCount == mForkDoneCount) {
-                mForkDoneCond.Wait(*mutex);
-            }
+        // Both waits release the mutex, repeat until neither fork nor
+        // concurrent reads are in progress.
+        do {
+            WaitForForkDone(*mutex);
+        } while (WaitForConcurrentReadsDone(*mutex));
+    }
+    // Concurrent read only requests execution starts with the mutex held,
+    // therefore owning the mutex excludes new readers. Mutations must wait
+    // for the readers in flight to finish by invoking PrepareToFork().
+    // Waiting mutations take precedence over the new readers.
+    inline bool StartConcurrentRead()
+    {
+        assert(gNetDispatch.GetMutex() && gNetDispatch.GetMutex()->IsOwned());
+        if (! mConcurrentReadsFlag || 0 < mPendingWritersCount) {
+            return false;
+        }
+        mConcurrentReadersCount++;
+        return true;
+    }
+    inline void ConcurrentReadDone()
+    {
+        QCMutex* const mutex = gNetDispatch.GetMutex();
+        assert(mutex && mutex->IsOwned() && 0 < mConcurrentReadersCount);
+        if (--mConcurrentReadersCount <= 0 && 0 < mPendingWritersCount) {
+            mConcurrentReadsDoneCond.NotifyAll();
         }
+        // Completion doesn't conflict with other readers, wait for fork only.
+        WaitForForkDone(*mutex);
     }
+    bool IsConcurrentReadEnabled() const
+        { return mConcurrentReadsFlag; }
     inline void ForkDone()
     {
         QCMutex* const mutex = gNetDispatch.GetMutex();
@@ -986,11 +1694,16 @@ public:
     {
         mMaxClientCount = min(mMaxClientSocketCount, params.getValue(
             "metaServer.maxClientCount", mMaxClientCount));
+        mConcurrentReadsFlag = params.getValue(
+            "metaServer.clientThreadConcurrentReads",
+            mConcurrentReadsFlag ? 1 : 0) != 0;
     }
     void SetMaxClientSockets(int count)
         { mMaxClientSocketCount = count; }
     int GetMaxClientCount() const
         { return mMaxClientCount; }
+    void GetEventStats(NetManager::EventStats& stats) const;
+    void GetRequestPhaseStats(MetaRequestPhaseStats& stats) const;
 private:
     class ClientThread;
     // The socket object which is setup to accept connections.
@@ -1006,6 +1719,36 @@ private:
     uint64_t                     mForkDoneCount;
     volatile bool                mPrepareToForkFlag;
     volatile int                 mPrepareToForkCnt;
+    QCCondVar                    mConcurrentReadsDoneCond;
+    int                          mConcurrentReadersCount;
+    int                          mPendingWritersCount;
+    bool                         mConcurrentReadsFlag;
+
+    void WaitForForkDone(QCMutex& mutex)
+    {
+        while (mPrepareToForkFlag) {
+            // The prepare thread count includes the "main" thread.
+            if (++mPrepareToForkCnt >= mClientThreadCount) {
+                mPrepareToForkDoneCond.Notify();
+            }
+            const uint64_t forkDoneCount = mForkDoneCount;
+            while (forkDoneCount == mForkDoneCount) {
+                mForkDoneCond.Wait(mutex);
+            }
+        }
+    }
+    bool WaitForConcurrentReadsDone(QCMutex& mutex)
+    {
+        if (mConcurrentReadersCount <= 0) {
+            return false;
+        }
+        mPendingWritersCount++;
+        while (0 < mConcurrentReadersCount) {
+            mConcurrentReadsDoneCond.Wait(mutex);
+        }
+        mPendingWritersCount--;
+        return true;
+    }
 };
 
 void
@@ -1026,6 +1769,18 @@ ClientManager::GetMaxClientCount() const
     return mImpl.GetMaxClientCount();
 }
 
+void
+ClientManager::GetEventStats(NetManager::EventStats& stats) const
+{
+    mImpl.GetEventStats(stats);
+}
+
+void
+ClientManager::GetRequestPhaseStats(MetaRequestPhaseStats& stats) const
+{
+    mImpl.GetRequestPhaseStats(stats);
+}
+
 inline void
 ClientManager::PrepareToFork()
 {
@@ -1050,6 +1805,42 @@ NetDispatch::ForkDone()
     mClientManager.ForkDone();
 }
 
+inline bool
+ClientManager::StartConcurrentRead()
+{
+    return mImpl.StartConcurrentRead();
+}
+
+inline bool
+NetDispatch::StartConcurrentRead()
+{
+    return mClientManager.StartConcurrentRead();
+}
+
+inline void
+ClientManager::ConcurrentReadDone()
+{
+    mImpl.ConcurrentReadDone();
+}
+
+inline void
+NetDispatch::ConcurrentReadDone()
+{
+    mClientManager.ConcurrentReadDone();
+}
+
+inline bool
+ClientManager::IsConcurrentReadEnabled() const
+{
+    return mImpl.IsConcurrentReadEnabled();
+}
+
+inline bool
+NetDispatch::IsConcurrentReadEnabled() const
+{
+    return mClientManager.IsConcurrentReadEnabled();
+}
+
 /* virtual */ void
 MainThreadPrepareToFork::DispatchStart()
 {
@@ -1069,6 +1860,12 @@ MainThreadPrepareToFork::DispatchEnd()
 // The core of the request processing submit_request() / MetaRequest::handle()
 // is serialized with the mutex. The attempt is made to process requests in
 // batches in order to reduce lock acquisition frequency.
+// With concurrent reads enabled the read only requests are executed after the
+// batch mutations, with the mutex released, concurrently with other client
+// threads read only requests. The mutations, including the main thread event
+// processing, wait for the concurrent reads in flight to finish in
+// PrepareToFork(). The read only requests completion is serialized with the
+// mutex.
 // The client thread run loop is in Timeout() method below, which is invoked
 // from NetManager::MainLoop().
 // The pending requests queue depth governed by the ClientSM parameters.
@@ -1095,7 +1892,9 @@ public:
           mReqPendingTail(0),
           mFlushQueue(8 << 10),
           mAuthContext(),
-          mAuthCtxUpdateCount(gLayoutManager.GetAuthCtxUpdateCount() - 1)
+          mAuthCtxUpdateCount(gLayoutManager.GetAuthCtxUpdateCount() - 1),
+          mReadOnlyContext(),
+          mPhaseStats()
     {
         gLayoutManager.UpdateClientAuthContext(
             mAuthCtxUpdateCount, mAuthContext);
@@ -1141,6 +1940,9 @@ public:
         MetaRequest* nextReq = mReqPendingHead;
         mReqPendingHead = 0;
         mReqPendingTail = 0;
+        const int64_t dispatchTime =
+            (nextReq && MetaRequestPhaseStats::IsEnabled()) ?
+            microseconds() : int64_t(0);
 
         // Keep the lock acquisition and PrepareToFork() next to each other, in
         // order to ensure that the mutext is locked while dispatching requests
@@ -1155,12 +1957,46 @@ public:
         }
         assert(! mReqPendingHead && ! mReqPendingTail);
         // Dispatch requests.
+        const bool   readFlag = gNetDispatch.IsConcurrentReadEnabled();
+        MetaRequest* readReq  = 0;
+        MetaRequest* readTail = 0;
         while (nextReq) {
             MetaRequest& op = *nextReq;
             nextReq = op.next;
             op.next = 0;
+            op.dispatchTime = dispatchTime;
+            if (readFlag && ReadOnlyRequestContext::IsConcurrent(op)) {
+                if (readTail) {
+                    readTail->next = &op;
+                } else {
+                    readReq = &op;
+                }
+                readTail = &op;
+                continue;
+            }
             submit_request(&op);
         }
+        const bool concurrentFlag =
+            readReq && gNetDispatch.StartConcurrentRead();
+        if (concurrentFlag) {
+            gNetDispatch.ForkDone();
+            QCStMutexUnlocker dispatchUnlocker(gNetDispatch.GetMutex());
+            for (MetaRequest* op = readReq; op; op = op->next) {
+                mReadOnlyContext.Handle(*op);
+            }
+            dispatchUnlocker.Lock();
+            gNetDispatch.ConcurrentReadDone();
+        }
+        while (readReq) {
+            MetaRequest& op = *readReq;
+            readReq = op.next;
+            op.next = 0;
+            if (concurrentFlag) {
+                ReadOnlyRequestContext::Done(op);
+            } else {
+                submit_request(&op);
+            }
+        }
         gNetDispatch.ForkDone();
         dispatchLocker.Unlock();
 
@@ -1292,23 +2128,31 @@ public:
         { mNetManager.Wakeup(); }
     AuthContext& GetAuthContext()
         { return mAuthContext; }
+    void GetEventStats(NetManager::EventStats& stats) const
+        { mNetManager.GetEventStats(stats); }
+    void RequestDone(const MetaRequest& op)
+        { mPhaseStats.Update(op, microseconds()); }
+    void GetRequestPhaseStats(MetaRequestPhaseStats& stats) const
+        { stats.Add(mPhaseStats); }
 private:
     typedef vector<NetConnectionPtr> FlushQueue;
 
-    QCMutex*           mMutex;
-    QCThread           mThread;
-    NetManager         mNetManager;
-    IOBuffer::WOStream mWOStream;
-    MetaRequest*       mReqHead;
-    MetaRequest*       mReqTail;
-    ClientSM*          mCliHead;
-    ClientSM*          mCliTail;
-    MetaRequest*       mReqPendingHead;
-    MetaRequest*       mReqPendingTail;
-    FlushQueue         mFlushQueue;
-    AuthContext        mAuthContext;
-    uint64_t           mAuthCtxUpdateCount;
-    char               mParseBuffer[MAX_RPC_HEADER_LEN];
+    QCMutex*               mMutex;
+    QCThread               mThread;
+    NetManager             mNetManager;
+    IOBuffer::WOStream     mWOStream;
+    MetaRequest*           mReqHead;
+    MetaRequest*           mReqTail;
+    ClientSM*              mCliHead;
+    ClientSM*              mCliTail;
+    MetaRequest*           mReqPendingHead;
+    MetaRequest*           mReqPendingTail;
+    FlushQueue             mFlushQueue;
+    AuthContext            mAuthContext;
+    uint64_t               mAuthCtxUpdateCount;
+    ReadOnlyRequestContext mReadOnlyContext;
+    MetaRequestPhaseStats  mPhaseStats;
+    char                   mParseBuffer[MAX_RPC_HEADER_LEN];
 
     const NetConnectionPtr& GetConnection(MetaRequest& op)
     {
@@ -1401,6 +2245,28 @@ ClientManager::Impl::CreateKfsCallbackObj(NetConnectionPtr& conn)
     return 0;
 }
 
+void
+ClientManager::Impl::GetEventStats(NetManager::EventStats& stats) const
+{
+    // The client threads update their stats without synchronization, the
+    // values are approximate.
+    stats.Clear();
+    for (int i = 0; i < mClientThreadCount && mClientThreads; i++) {
+        NetManager::EventStats threadStats;
+        mClientThreads[i].GetEventStats(threadStats);
+        stats.Add(threadStats);
+    }
+}
+
+void
+ClientManager::Impl::GetRequestPhaseStats(MetaRequestPhaseStats& stats) const
+{
+    // Similarly to the event stats, the values are approximate.
+    for (int i = 0; i < mClientThreadCount && mClientThreads; i++) {
+        mClientThreads[i].GetRequestPhaseStats(stats);
+    }
+}
+
 void
 ClientManager::Impl::Shutdown()
 {
@@ -1515,6 +2381,17 @@ ClientManager::SubmitRequestSelf(ClientManager::ClientThread* thread,
     thread->Add(op);
 }
 
+/* static */ void
+ClientManager::RequestDone(ClientManager::ClientThread* thread,
+    const MetaRequest& op)
+{
+    if (thread) {
+        thread->RequestDone(op);
+    } else {
+        sRequestPhaseStats.Update(op, microseconds());
+    }
+}
+
 /* static */ AuthContext&
 ClientManager::GetAuthContext(ClientThread* inThread)
 {
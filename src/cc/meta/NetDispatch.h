@@ -64,6 +64,10 @@ public:
     void GetStatsCsv(IOBuffer& buf);
     int64_t GetUserCpuMicroSec() const;
     int64_t GetSystemCpuMicroSec() const;
+    void GetEventStats(
+        NetManager::EventStats& mainStats,
+        NetManager::EventStats& clientThreadsStats) const;
+    void GetRequestPhaseStats(MetaRequestPhaseStats& stats) const;
     QCMutex* GetMutex() const { return mMutex; }
     QCMutex* GetClientManagerMutex() const { return mClientManagerMutex; }
     const CryptoKeys* GetCryptoKeys() const { return mCryptoKeys; }
@@ -72,6 +76,9 @@ public:
     void PrepareCurrentThreadToFork();
     inline void PrepareToFork();
     inline void ForkDone();
+    inline bool StartConcurrentRead();
+    inline void ConcurrentReadDone();
+    inline bool IsConcurrentReadEnabled() const;
     bool CancelToken(const DelegationToken& token);
     bool CancelToken(
         int64_t inExpiration, int64_t inIssued, kfsUid_t inUid,
@@ -95,8 +102,19 @@ public:
     }
     int WriteCanceledTokens(ostream& os);
     uint64_t GetCanceledTokensUpdateCount() const;
+    enum AdmitStatus
+    {
+        kAdmitSubmit,
+        kAdmitQueued,
+        kAdmitRejected
+    };
+    //!< Per principal rate limit and fair queuing. Can be invoked by client
+    //!< threads. Queued requests are submitted later by the main thread.
+    AdmitStatus Admit(MetaRequest& op);
 private:
     class CanceledTokens;
+    class Metrics;
+    class Admission;
 
     ClientManager      mClientManager; //!< tracks the connected clients
     ChunkServerFactory mChunkServerFactory; //!< creates chunk servers when they connect
@@ -104,6 +122,8 @@ private:
     QCMutex*           mClientManagerMutex;
     CryptoKeys*        mCryptoKeys;
     CanceledTokens&    mCanceledTokens;
+    Metrics&           mMetrics;
+    Admission&         mAdmission;
     bool               mRunningFlag;
     int                mClientThreadCount;
     int                mClientThreadsStartCpuAffinity;
@@ -42,6 +42,8 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <time.h>
+
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
@@ -179,12 +181,13 @@ replay_create(DETokenizer& c)
     if (! pop_fid(todumpster, "todumpster", c, ok)) {
         todumpster = -1;
     }
-    kfsUid_t   user     = kKfsUserNone;
-    kfsUid_t   group    = kKfsGroupNone;
-    kfsMode_t  mode     = 0;
-    int64_t    k        = user;
-    kfsSTier_t minSTier = kKfsSTierMax;
-    kfsSTier_t maxSTier = kKfsSTierMax;
+    kfsUid_t   user        = kKfsUserNone;
+    kfsUid_t   group       = kKfsGroupNone;
+    kfsMode_t  mode        = 0;
+    int64_t    k           = user;
+    kfsSTier_t minSTier    = kKfsSTierMax;
+    kfsSTier_t maxSTier    = kKfsSTierMax;
+    int        compression = KFS_COMPRESSION_NONE;
     if (! c.empty()) {
         if (! pop_num(k, "user", c, ok)) {
             return false;
@@ -206,7 +209,7 @@ replay_create(DETokenizer& c)
             return false;
         }
         mode = (kfsMode_t)k;
-        if (! c.empty()) {
+        if (! c.empty() && c.front() == "minTier") {
             if (! pop_num(k, "minTier", c, ok)) {
                 return false;
             }
@@ -216,6 +219,13 @@ replay_create(DETokenizer& c)
             }
             maxSTier = (kfsSTier_t)k;
         }
+        if (! c.empty() && c.front() == "compression") {
+            if (! pop_num(k, "compression", c, ok) ||
+                    k <= KFS_COMPRESSION_NONE || KFS_COMPRESSION_MAX < k) {
+                return false;
+            }
+            compression = (int)k;
+        }
     } else {
         user  = gLayoutManager.GetDefaultLoadUser();
         group = gLayoutManager.GetDefaultLoadGroup();
@@ -250,6 +260,7 @@ replay_create(DETokenizer& c)
             fa->minSTier = minSTier;
             fa->maxSTier = maxSTier;
         }
+        fa->compression = (uint32_t)compression;
     }
     KFS_LOG_STREAM_DEBUG << "replay create:"
         " name: " << myname <<
@@ -677,6 +688,31 @@ replay_setrep(DETokenizer& c)
         fa, numReplicas, minSTier, maxSTier) == 0);
 }
 
+/*!
+ * Replay pack file.
+ * format: pack/file/<fid>/container/<fid>/offset/<o>/size/<s>/expected/<fid>
+ */
+static bool
+replay_pack(DETokenizer& c)
+{
+    c.pop_front();
+    fid_t fid;
+    bool ok = pop_fid(fid, "file", c, true);
+    fid_t container;
+    ok = pop_fid(container, "container", c, ok);
+    chunkOff_t offset;
+    ok = pop_offset(offset, "offset", c, ok);
+    chunkOff_t size;
+    ok = pop_offset(size, "size", c, ok);
+    int64_t expected;
+    ok = pop_num(expected, "expected", c, ok);
+    if (! ok) {
+        return ok;
+    }
+    return (metatree.pack(metatree.getFattr(fid), metatree.getFattr(container),
+        offset, size, expected) == 0);
+}
+
 /*!
  * \brief replay setmtime
  * format: setmtime/file/<fileID>/mtime/<time>
@@ -938,11 +974,88 @@ replay_chown(DETokenizer& c)
         fa->user = user;
     }
     if (group != kKfsGroupNone) {
-        fa->user = group;
+        fa->group = group;
     }
     return true;
 }
 
+static bool
+replay_sub_tree_attr(DETokenizer& c, fid_t fid, kfsMode_t mode,
+    kfsUid_t user, kfsGid_t group)
+{
+    int64_t n = kKfsUserNone;
+    if (! pop_num(n, "euser", c, true)) {
+        return false;
+    }
+    const kfsUid_t euser = (kfsUid_t)n;
+    n = -1;
+    if (! pop_num(n, "max", c, true) || n <= 0) {
+        return false;
+    }
+    const size_t maxEntries = (size_t)n;
+    string       cursor;
+    if (! c.empty() && ! pop_path(cursor, "cursor", c, true)) {
+        return false;
+    }
+    MetaFattr* const fa = metatree.getFattr(fid);
+    if (! fa) {
+        return false;
+    }
+    size_t count       = 0;
+    size_t failedCount = 0;
+    return (metatree.changeSubTreeAttr(fa, mode, user, group, euser,
+        maxEntries, cursor, count, failedCount) == 0);
+}
+
+/*!
+ * \brief replay recursive chmod batch
+ * format: chmodr/file/<fid>/mode/<mode>/euser/<uid>/max/<n>{/cursor/<path>}
+ */
+static bool
+replay_chmodr(DETokenizer& c)
+{
+    c.pop_front();
+    fid_t fid = -1;
+    if (! pop_fid(fid, "file", c, true)) {
+        return false;
+    }
+    int64_t n = 0;
+    if (! pop_num(n, "mode", c, true)){
+        return false;
+    }
+    return replay_sub_tree_attr(c, fid, (kfsMode_t)n,
+        kKfsUserNone, kKfsGroupNone);
+}
+
+/*!
+ * \brief replay recursive chown batch
+ * format: chownr/file/<fid>/user/<uid>/group/<gid>/euser/<uid>/max/<n>
+ * {/cursor/<path>}
+ */
+static bool
+replay_chownr(DETokenizer& c)
+{
+    c.pop_front();
+    fid_t fid = -1;
+    if (! pop_fid(fid, "file", c, true)) {
+        return false;
+    }
+    int64_t n = kKfsUserNone;
+    if (! pop_num(n, "user", c, true)) {
+        return false;
+    }
+    const kfsUid_t user = (kfsUid_t)n;
+    n = kKfsGroupNone;
+    if (! pop_num(n, "group", c, true)) {
+        return false;
+    }
+    const kfsGid_t group = (kfsGid_t)n;
+    if (user == kKfsUserNone && group == kKfsGroupNone) {
+        return false;
+    }
+    return replay_sub_tree_attr(c, fid, kKfsModeUndef, user, group);
+}
+
 static bool
 replay_clear_obj_store_delete(DETokenizer& c)
 {
@@ -971,6 +1084,7 @@ get_entry_map()
     e.add_parser("coalesce",                &replay_coalesce);
     e.add_parser("pruneFromHead",           &replay_pruneFromHead);
     e.add_parser("setrep",                  &replay_setrep);
+    e.add_parser("pack",                    &replay_pack);
     e.add_parser("size",                    &replay_size);
     e.add_parser("setmtime",                &replay_setmtime);
     e.add_parser("chunkVersionInc",         &restore_chunkVersionInc);
@@ -979,9 +1093,12 @@ get_entry_map()
     e.add_parser("mkstabledone",            &restore_mkstabledone);
     e.add_parser("beginchunkversionchange", &replay_beginchunkversionchange);
     e.add_parser("checksum",                &restore_checksum);
+    e.add_parser("digest",                  &restore_digest);
     e.add_parser("rollseeds",               &restore_rollseeds);
     e.add_parser("chmod",                   &replay_chmod);
     e.add_parser("chown",                   &replay_chown);
+    e.add_parser("chmodr",                  &replay_chmodr);
+    e.add_parser("chownr",                  &replay_chownr);
     e.add_parser("delegatecancel",          &restore_delegate_cancel);
     e.add_parser("filesysteminfo",          &restore_filesystem_info);
     e.add_parser("clearobjstoredelete",     &replay_clear_obj_store_delete);
@@ -997,10 +1114,13 @@ int
 Replay::playlog(bool& lastEntryChecksumFlag)
 {
     restoreChecksum.clear();
+    restoreDigest.clear();
     lastLineChecksumFlag = false;
     lastEntryChecksumFlag = false;
     MdStream& mds = oplog.getMdStream();
-    mds.Reset();
+    // Each log segment starts with the default digest, and might select
+    // different digest with the digest entry.
+    mds.Reset(0, string());
     mds.SetWriteTrough(true);
 
     if (! file.is_open()) {
@@ -1015,7 +1135,22 @@ Replay::playlog(bool& lastEntryChecksumFlag)
     seq_t opcount = oplog.checkpointed();
     int status = 0;
     while (tokenizer.next(&mds)) {
-        if (! entrymap.parse(tokenizer)) {
+        OpStat*         stat = 0;
+        struct timespec start;
+        if (opStats && ! tokenizer.empty()) {
+            const DETokenizer::Token& name = tokenizer.front();
+            stat = &(*opStats)[string(name.ptr, name.len)];
+            clock_gettime(CLOCK_MONOTONIC, &start);
+        }
+        const bool ok = entrymap.parse(tokenizer);
+        if (stat) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            stat->count++;
+            stat->timeNsec += (int64_t)(now.tv_sec - start.tv_sec) *
+                1000 * 1000 * 1000 + now.tv_nsec - start.tv_nsec;
+        }
+        if (! ok) {
             KFS_LOG_STREAM_FATAL <<
                 "error " << path <<
                 ":" << tokenizer.getEntryCount() <<
@@ -1024,6 +1159,10 @@ Replay::playlog(bool& lastEntryChecksumFlag)
             status = -EINVAL;
             break;
         }
+        if (! restoreDigest.empty()) {
+            mds.Reset(0, restoreDigest);
+            restoreDigest.clear();
+        }
         lastEntryChecksumFlag = ! restoreChecksum.empty();
         if (lastEntryChecksumFlag) {
             const string md = mds.GetMd();
@@ -1135,6 +1274,26 @@ Replay::playLogs(int last, bool includeLastLogFlag)
     return status;
 }
 
+int
+Replay::playCompletedLogs(bool& replayedFlag)
+{
+    replayedFlag = false;
+    if (number < 0) {
+        return playLogs(false);
+    }
+    int last = -1;
+    lastLogNum = -1;
+    int status = getLastLog(last);
+    if (status != 0 || last < number) {
+        return status;
+    }
+    replayedFlag = true;
+    if ((status = playLogs(last, false)) == 0) {
+        number = last + 1;
+    }
+    return status;
+}
+
 int
 Replay::getLastLog(int& last)
 {
@@ -27,15 +27,30 @@
 
 #include <string>
 #include <fstream>
+#include <map>
+
+#include <stdint.h>
 
 namespace KFS
 {
 using std::string;
 using std::ifstream;
+using std::map;
 
 class Replay
 {
 public:
+    struct OpStat
+    {
+        OpStat()
+            : count(0),
+              timeNsec(0)
+            {}
+        int64_t count;
+        int64_t timeNsec;
+    };
+    typedef map<string, OpStat> OpStats;
+
     Replay()
         : file(),
           path(),
@@ -43,7 +58,8 @@ public:
           lastLogNum(-1),
           lastLogIntBase(-1),
           appendToLastLogFlag(false),
-          rollSeeds(0)
+          rollSeeds(0),
+          opStats(0)
         {}
     ~Replay()
         {}
@@ -60,10 +76,17 @@ public:
     //!< starting from log for logno(),
     //!< replay all logs we have in the logdir.
     int playAllLogs() { return playLogs(true); }
+    //!< replay complete log segments starting from logno(), and advance
+    //!< logno() past the last replayed segment; used by hot standby to tail
+    //!< the log. If replay fails after the tree was modified, replayedFlag
+    //!< is set to true.
+    int playCompletedLogs(bool& replayedFlag);
     bool getAppendToLastLogFlag() const { return appendToLastLogFlag; }
     int getLastLogIntBase() const { return lastLogIntBase; }
     inline void setRollSeeds(int64_t roll);
     int64_t getRollSeeds() const { return rollSeeds; }
+    //!< collect per log record type replay count and time, if not null
+    void setOpStats(OpStats* stats) { opStats = stats; }
 private:
     ifstream file;   //!< the log file being replayed
     string   path;   //!< path name for log file
@@ -72,6 +95,7 @@ private:
     int      lastLogIntBase;
     bool     appendToLastLogFlag;
     int64_t  rollSeeds;
+    OpStats* opStats;
 
     int playLogs(int lastlog, bool includeLastLogFlag);
     int playlog(bool& lastEntryChecksumFlag);
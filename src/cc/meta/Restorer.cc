@@ -36,16 +36,31 @@
 #include "Restorer.h"
 #include "DiskEntry.h"
 #include "Checkpoint.h"
+#include "CheckpointCompression.h"
 #include "LayoutManager.h"
 #include "NetDispatch.h"
 #include "common/MdStream.h"
 #include "common/MsgLogger.h"
 #include "qcdio/QCUtils.h"
+#include "qcdio/QCThread.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
+
+#include <deque>
+#include <vector>
+#include <streambuf>
+#include <algorithm>
 
 namespace KFS
 {
 using std::cerr;
 using std::string;
+using std::istream;
+using std::ostream;
+using std::streambuf;
+using std::vector;
+using std::max;
+using std::min;
 
 static int16_t minReplicasPerFile = 0;
 
@@ -124,31 +139,71 @@ restore_chunkVersionInc(DETokenizer& c)
     return (! c.empty() && c.toNumber() >= 1);
 }
 
+/*!
+ * \brief parsed checkpoint leaf entry: dentry, fattr, or chunkinfo.
+ * The parallel restore parses entries in the parser threads, and then inserts
+ * these into the tree in the checkpoint order.
+ */
+struct RestoreLeaf
+{
+    RestoreLeaf()
+        : type(KFS_UNINIT),
+          id(-1),
+          parent(-1),
+          chunkId(-1),
+          offset(-1),
+          chunkVersion(-1),
+          name(),
+          fattr(),
+          packedContainer(-1),
+          packedOffset(-1)
+        {}
+    MetaType   type;
+    fid_t      id;
+    fid_t      parent;
+    chunkId_t  chunkId;
+    chunkOff_t offset;
+    seq_t      chunkVersion;
+    string     name;
+    MFattr     fattr;
+    fid_t      packedContainer;
+    chunkOff_t packedOffset;
+};
+
 static bool
-restore_dentry(DETokenizer& c)
+parse_dentry(DETokenizer& c, RestoreLeaf& e)
 {
-    string name;
-    fid_t id, parent;
     c.pop_front();
-    bool ok = pop_name(name, "name", c, true);
-    ok = pop_fid(id, "id", c, ok);
-    ok = pop_fid(parent, "parent", c, ok);
-    if (!ok)
-        return false;
+    bool ok = pop_name(e.name, "name", c, true);
+    ok = pop_fid(e.id, "id", c, ok);
+    ok = pop_fid(e.parent, "parent", c, ok);
+    e.type = KFS_DENTRY;
+    return ok;
+}
 
-    MetaDentry* const d = MetaDentry::create(parent, name, id, 0);
-    return (metatree.insert(d) == 0);
+static bool
+apply_dentry(const RestoreLeaf& e)
+{
+    MetaDentry* const d = MetaDentry::create(e.parent, e.name, e.id, 0);
+    return (metatree.append(d) == 0);
+}
+
+static bool
+restore_dentry(DETokenizer& c)
+{
+    static RestoreLeaf e;
+    return (parse_dentry(c, e) && apply_dentry(e));
 }
 
 static bool
-restore_striped_file_params(DETokenizer& c, MetaFattr& f)
+restore_striped_file_params(DETokenizer& c, MFattr& f)
 {
     chunkOff_t t = 0, n = 0, nr = 0, ss = 0;
     if (! pop_offset(t, "striperType", c, true)) {
         f.striperType        = KFS_STRIPED_FILE_TYPE_NONE;
         f.numStripes         = 0;
         f.numRecoveryStripes = 0;
-        f.stripeSize         = 0;
+        f.stripeSizeUnits    = 0;
         return true;
     }
     return (
@@ -161,7 +216,7 @@ restore_striped_file_params(DETokenizer& c, MetaFattr& f)
 }
 
 static bool
-restore_fattr(DETokenizer& c)
+parse_fattr(DETokenizer& c, RestoreLeaf& e)
 {
     FileType type;
     fid_t fid;
@@ -191,12 +246,15 @@ restore_fattr(DETokenizer& c)
     // reason for it being estimate: if a CP is in progress while the
     // metatree is updated, we have cases where the chunkcount is off by 1
     // and the checkpoint contains the newly added chunk.
-    MetaFattr* const f = MetaFattr::create(type, fid, mtime, ctime, crtime,
+    e.type            = KFS_FATTR;
+    e.packedContainer = -1;
+    e.packedOffset    = -1;
+    e.fattr = MFattr(type, fid, mtime, ctime, crtime,
         0, numReplicas, kKfsUserNone, kKfsGroupNone, kKfsModeUndef);
+    MFattr* const f = &e.fattr;
     if (type != KFS_DIR) {
         f->filesize = gotfilesize ? filesize : chunkOff_t(-1);
         if (! restore_striped_file_params(c, *f)) {
-            f->destroy();
             return false;
         }
     }
@@ -204,47 +262,61 @@ restore_fattr(DETokenizer& c)
     const bool gotperms = ! c.empty();
     if (gotperms) {
         if (! pop_num(n, "user", c, true)) {
-            f->destroy();
             return false;
         }
         f->user = (kfsUid_t)n;
         n = f->group;
         if (! pop_num(n, "group", c, true)) {
-            f->destroy();
             return false;
         }
         f->group = (kfsGid_t)n;
         n = f->mode;
         if (! pop_num(n, "mode", c, true)) {
-            f->destroy();
             return false;
         }
         f->mode = (kfsMode_t)n;
         if ((type == KFS_FILE || type == KFS_DIR) && ! c.empty() &&
                 pop_num(n, "minTier", c, ok)) {
-            f->minSTier = (kfsSTier_t)n;
+            // Validate before assigning, as the tiers are bit fields.
+            const int64_t minTier = n;
             if (! pop_num(n, "maxTier", c, ok)) {
-                f->destroy();
                 return false;
             }
-            f->maxSTier = (kfsSTier_t)n;
-            if (f->maxSTier < f->minSTier ||
-                    f->minSTier < kKfsSTierMin || f->minSTier > kKfsSTierMax ||
-                    f->maxSTier < kKfsSTierMin || f->maxSTier > kKfsSTierMax) {
-                f->destroy();
+            const int64_t maxTier = n;
+            if (maxTier < minTier ||
+                    minTier < kKfsSTierMin || minTier > kKfsSTierMax ||
+                    maxTier < kKfsSTierMin || maxTier > kKfsSTierMax) {
                 return false;
             }
+            f->minSTier = (kfsSTier_t)minTier;
+            f->maxSTier = (kfsSTier_t)maxTier;
         }
-        if (! c.empty()) {
+        if (! c.empty() && c.front() == "nextChunkOffset") {
             if (! pop_num(n, "nextChunkOffset", c, ok) ||
                     n < 0 || n % CHUNKSIZE != 0) {
-                f->destroy();
                 return false;
             }
             if (0 == numReplicas) {
                 f->nextChunkOffset() = (chunkOff_t)n;
             }
         }
+        if (type == KFS_FILE && ! c.empty() && c.front() == "compression") {
+            if (! pop_num(n, "compression", c, ok) ||
+                    n <= KFS_COMPRESSION_NONE || KFS_COMPRESSION_MAX < n) {
+                return false;
+            }
+            f->compression = (uint32_t)n;
+        }
+        if (type == KFS_FILE && ! c.empty()) {
+            if (! pop_num(n, "packedContainer", c, ok) || n < 0) {
+                return false;
+            }
+            e.packedContainer = (fid_t)n;
+            if (! pop_num(n, "packedOffset", c, ok) || n < 0) {
+                return false;
+            }
+            e.packedOffset = (chunkOff_t)n;
+        }
     } else {
         f->user  = gLayoutManager.GetDefaultLoadUser();
         f->group = gLayoutManager.GetDefaultLoadGroup();
@@ -252,15 +324,27 @@ restore_fattr(DETokenizer& c)
             gLayoutManager.GetDefaultLoadDirMode() :
             gLayoutManager.GetDefaultLoadFileMode();
     }
-    if (f->user == kKfsUserNone || f->group == kKfsGroupNone ||
-            f->mode == kKfsModeUndef) {
-        f->destroy();
+    return (f->user != kKfsUserNone && f->group != kKfsGroupNone &&
+        f->mode != kKfsModeUndef);
+}
+
+static bool
+apply_fattr(const RestoreLeaf& e)
+{
+    const MFattr& a = e.fattr;
+    MetaFattr* const f = MetaFattr::create(a.type, a.id(),
+        a.mtime, a.ctime, a.crtime, 0, a.numReplicas,
+        a.user, a.group, a.mode);
+    static_cast<MFattr&>(*f) = a;
+    f->packedFlag = 0;
+    if (metatree.append(f) != 0) {
         return false;
     }
-    if (metatree.insert(f) != 0) {
+    if (0 <= e.packedContainer &&
+            ! metatree.setPackedExtent(f, e.packedContainer, e.packedOffset)) {
         return false;
     }
-    if (type == KFS_DIR) {
+    if (a.type == KFS_DIR) {
         UpdateNumDirs(1);
     } else {
         UpdateNumFiles(1);
@@ -269,43 +353,48 @@ restore_fattr(DETokenizer& c)
 }
 
 static bool
-restore_chunkinfo(DETokenizer& c)
+restore_fattr(DETokenizer& c)
 {
-    fid_t fid;
-    chunkId_t cid;
-    chunkOff_t offset;
-    seq_t chunkVersion;
+    static RestoreLeaf e;
+    return (parse_fattr(c, e) && apply_fattr(e));
+}
 
+static bool
+parse_chunkinfo(DETokenizer& c, RestoreLeaf& e)
+{
     c.pop_front();
-    bool ok = pop_fid(fid, "fid", c, true);
-    ok = pop_fid(cid, "chunkid", c, ok);
-    ok = pop_offset(offset, "offset", c, ok);
-    ok = pop_fid(chunkVersion, "chunkVersion", c, ok);
-    if (!ok) {
-        return false;
-    }
+    bool ok = pop_fid(e.id, "fid", c, true);
+    ok = pop_fid(e.chunkId, "chunkid", c, ok);
+    ok = pop_offset(e.offset, "offset", c, ok);
+    ok = pop_fid(e.chunkVersion, "chunkVersion", c, ok);
+    e.type = KFS_CHUNKINFO;
+    return ok;
+}
 
+static bool
+apply_chunkinfo(const RestoreLeaf& e)
+{
     // The chunks of a file are stored next to each other in the tree and
     // are written out contigously.  Use this property when restoring the
     // chunkinfo: stash the fileattr for the the file we are currently
     // working on; as long as this doesn't change, we avoid tree lookups.
     static MetaFattr* sCurrFa = 0;
     MetaFattr* fa = sCurrFa;
-    if (! fa || fa->id() != fid) {
-        fa = metatree.getFattr(fid);
+    if (! fa || fa->id() != e.id) {
+        fa = metatree.getFattr(e.id);
         sCurrFa = fa;
     }
     if (! fa) {
         return false;
     }
-        const chunkOff_t boundary = chunkStartOffset(offset);
+    const chunkOff_t boundary = chunkStartOffset(e.offset);
     bool newEntryFlag = false;
     MetaChunkInfo* const ch = gLayoutManager.AddChunkToServerMapping(
-        fa, boundary, cid, chunkVersion, newEntryFlag);
+        fa, boundary, e.chunkId, e.chunkVersion, newEntryFlag);
     if (! ch || ! newEntryFlag) {
         return false;
     }
-    if (metatree.insert(ch) != 0) {
+    if (metatree.append(ch) != 0) {
         return false;
     }
     if (boundary >= fa->nextChunkOffset()) {
@@ -316,6 +405,44 @@ restore_chunkinfo(DETokenizer& c)
     return true;
 }
 
+static bool
+restore_chunkinfo(DETokenizer& c)
+{
+    static RestoreLeaf e;
+    return (parse_chunkinfo(c, e) && apply_chunkinfo(e));
+}
+
+static bool
+parse_leaf(DETokenizer& c, RestoreLeaf& e)
+{
+    if (c.empty()) {
+        return false;
+    }
+    const DETokenizer::Token& t = c.front();
+    if (t == "dentry") {
+        return parse_dentry(c, e);
+    }
+    if (t == "fattr") {
+        return parse_fattr(c, e);
+    }
+    if (t == "chunkinfo") {
+        return parse_chunkinfo(c, e);
+    }
+    return false;
+}
+
+static bool
+apply_leaf(const RestoreLeaf& e)
+{
+    switch (e.type) {
+        case KFS_DENTRY:    return apply_dentry(e);
+        case KFS_FATTR:     return apply_fattr(e);
+        case KFS_CHUNKINFO: return apply_chunkinfo(e);
+        default:            break;
+    }
+    return false;
+}
+
 static bool
 restore_makestable(DETokenizer& c)
 {
@@ -394,6 +521,39 @@ restore_checksum(DETokenizer& c)
     return true;
 }
 
+string restoreDigest;
+
+/*!
+ * \brief the digest entry selects the digest that covers the content starting
+ * from the digest entry. The reader switches its digest once the entry is
+ * parsed, the entry is added to the digest with the next entry.
+ */
+bool
+restore_digest(DETokenizer& c)
+{
+    c.pop_front();
+    if (c.empty()) {
+        return false;
+    }
+    const string val = c.front();
+    if (val.empty() || ! MdStream::IsDigestSupported(val)) {
+        KFS_LOG_STREAM_ERROR <<
+            "unsupported digest: " << val <<
+        KFS_LOG_EOM;
+        return false;
+    }
+    restoreDigest = val;
+    return true;
+}
+
+static bool
+restore_compression(DETokenizer& c)
+{
+    // Block decompression is handled by the checkpoint input stream buffer.
+    c.pop_front();
+    return ! c.empty();
+}
+
 bool
 restore_delegate_cancel(DETokenizer& c)
 {
@@ -482,6 +642,8 @@ get_entry_map()
     e.add_parser("mkstable",                &restore_makestable);
     e.add_parser("beginchunkversionchange", &restore_beginchunkversionchange);
     e.add_parser("checksum",                &restore_checksum);
+    e.add_parser("digest",                  &restore_digest);
+    e.add_parser("compression",             &restore_compression);
     e.add_parser("delegatecancel",          &restore_delegate_cancel);
     e.add_parser("filesysteminfo",          &restore_filesystem_info);
     e.add_parser("osx",                     &restore_objstore_delete);
@@ -500,6 +662,454 @@ lookupFattr(fid_t dir, const string& name)
     return 0;
 }
 
+/*!
+ * \brief parallel checkpoint loader.
+ * The main thread reads the checkpoint, splits it into entries, and computes
+ * checkpoint checksum. The leaf entries -- dentry, fattr, and chunkinfo -- are
+ * grouped into blocks, and parsed by the parser threads. The parsed blocks are
+ * inserted into the meta tree by the main thread in the checkpoint order, as
+ * the meta tree, chunk to server map, and the meta node allocators are not
+ * thread safe. All other entries are parsed and applied by the main thread,
+ * after all preceding blocks are applied.
+ */
+class ParallelRestorer : public QCRunnable
+{
+public:
+    ParallelRestorer(
+        istream&      in,
+        const string& name,
+        MdStream&     mds,
+        int           threadCount)
+        : QCRunnable(),
+          mIn(in),
+          mName(name),
+          mMds(mds),
+          mEntryMap(get_entry_map()),
+          mThreadCount(max(1, threadCount)),
+          mThreads(new QCThread[mThreadCount]),
+          mMutex(),
+          mWorkCond(),
+          mDoneCond(),
+          mWork(),
+          mPending(),
+          mFree(),
+          mCur(0),
+          mBuf(kReadSize + kMaxEntrySize),
+          mRaw(),
+          mRawEntryCount(0),
+          mEntryCount(0),
+          mBase(10),
+          mChecksumFlag(false),
+          mStopFlag(false)
+        {}
+    ~ParallelRestorer()
+    {
+        Stop();
+        delete [] mThreads;
+        Release(mCur);
+        for (Pending::iterator it = mPending.begin();
+                it != mPending.end();
+                ++it) {
+            delete *it;
+        }
+        for (Pending::iterator it = mFree.begin(); it != mFree.end(); ++it) {
+            delete *it;
+        }
+    }
+    bool Load()
+    {
+        const int kStackSize = 256 << 10;
+        for (int i = 0; i < mThreadCount; i++) {
+            const int err = mThreads[i].TryToStart(
+                this, kStackSize, "CPRestore");
+            if (err) {
+                KFS_LOG_STREAM_FATAL << mName << ": " << QCUtils::SysError(
+                    err, "failed to start checkpoint parser thread") <<
+                KFS_LOG_EOM;
+                return false;
+            }
+        }
+        const bool ok = Read() && Submit() && ApplyRaw();
+        Stop();
+        return ok;
+    }
+    virtual void Run()
+    {
+        QCStMutexLocker locker(mMutex);
+        for (; ;) {
+            while (! mStopFlag && mWork.empty()) {
+                mWorkCond.Wait(mMutex);
+            }
+            if (mWork.empty()) {
+                break;
+            }
+            Block& block = *mWork.front();
+            mWork.pop_front();
+            {
+                QCStMutexUnlocker unlocker(mMutex);
+                Parse(block);
+            }
+            block.doneFlag = true;
+            mDoneCond.NotifyAll();
+        }
+    }
+private:
+    enum { kReadSize      = 4 << 20 };
+    enum { kBlockSize     = 4 << 20 };
+    enum { kMaxEntrySize  = 512 << 10 };
+    enum { kMaxPendingPerThread = 2 };
+
+    class Block
+    {
+    public:
+        Block()
+            : data(),
+              base(10),
+              entryCount(0),
+              leaves(),
+              count(0),
+              errorFlag(false),
+              errorEntry(),
+              doneFlag(false)
+            {}
+        void Reset()
+        {
+            data.clear();
+            count      = 0;
+            errorFlag  = false;
+            errorEntry.clear();
+            doneFlag   = false;
+        }
+        typedef vector<RestoreLeaf> Leaves;
+
+        string data;
+        int    base;
+        size_t entryCount; //!< ordinal of the first entry in the checkpoint
+        Leaves leaves;
+        size_t count;      //!< number of successfully parsed entries
+        bool   errorFlag;
+        string errorEntry;
+        bool   doneFlag;
+    };
+    class StrBuf : public streambuf
+    {
+    public:
+        StrBuf(
+            const string& str)
+            : streambuf()
+        {
+            char* const p = const_cast<char*>(str.data());
+            setg(p, p, p + str.size());
+        }
+    };
+    typedef std::deque<Block*> Pending;
+
+    istream&         mIn;
+    const string&    mName;
+    MdStream&        mMds;
+    DiskEntry&       mEntryMap;
+    const int        mThreadCount;
+    QCThread* const  mThreads;
+    QCMutex          mMutex;
+    QCCondVar        mWorkCond;
+    QCCondVar        mDoneCond;
+    Pending          mWork;
+    Pending          mPending;
+    Pending          mFree;
+    Block*           mCur;
+    vector<char>     mBuf;
+    string           mRaw;
+    size_t           mRawEntryCount;
+    size_t           mEntryCount;
+    int              mBase;
+    bool             mChecksumFlag;
+    bool             mStopFlag;
+
+    void Stop()
+    {
+        QCStMutexLocker locker(mMutex);
+        mStopFlag = true;
+        mWorkCond.NotifyAll();
+        locker.Unlock();
+        for (int i = 0; i < mThreadCount; i++) {
+            if (mThreads[i].IsStarted()) {
+                mThreads[i].Join();
+            }
+        }
+    }
+    static void Parse(
+        Block& block)
+    {
+        StrBuf      buf(block.data);
+        istream     is(&buf);
+        DETokenizer tokenizer(is);
+        tokenizer.setIntBase(block.base);
+        while (tokenizer.next()) {
+            if (block.leaves.size() <= block.count) {
+                block.leaves.resize(block.count + 1);
+            }
+            if (! parse_leaf(tokenizer, block.leaves[block.count])) {
+                block.errorFlag  = true;
+                block.errorEntry = tokenizer.getEntry();
+                break;
+            }
+            block.count++;
+        }
+    }
+    static string GetEntry(
+        const Block& block,
+        size_t       idx)
+    {
+        StrBuf      buf(block.data);
+        istream     is(&buf);
+        DETokenizer tokenizer(is);
+        while (tokenizer.next()) {
+            if (idx-- <= 0) {
+                return tokenizer.getEntry();
+            }
+        }
+        return string();
+    }
+    void Release(
+        Block* block)
+    {
+        if (block) {
+            block->Reset();
+            mFree.push_back(block);
+        }
+    }
+    //!< find the end of the entry starting at ptr
+    //!< \return 1 if entry is complete, 0 if more data is needed, and -1 if
+    //!< entry is invalid
+    static int GetEntryEnd(
+        const char*  ptr,
+        const char*  end,
+        const char*& outEnd)
+    {
+        if (*ptr == (char)DETokenizer::kBinaryEntryMarker) {
+            const unsigned char* p =
+                reinterpret_cast<const unsigned char*>(ptr) + 1;
+            const unsigned char* const e =
+                reinterpret_cast<const unsigned char*>(end);
+            uint64_t len = 0;
+            int      shift;
+            for (shift = 0; p < e && shift < 64; shift += 7) {
+                const unsigned char c = *p++;
+                len |= (uint64_t)(c & 0x7F) << shift;
+                if ((c & 0x80) == 0) {
+                    break;
+                }
+            }
+            if (64 <= shift || kMaxEntrySize <= len) {
+                return -1;
+            }
+            if (e <= p || (uint64_t)(e - p) < len) {
+                return 0;
+            }
+            outEnd = reinterpret_cast<const char*>(p + len);
+            return 1;
+        }
+        const char* const p = reinterpret_cast<const char*>(
+            memchr(ptr, '\n', min(end - ptr, ptrdiff_t(kMaxEntrySize))));
+        if (! p) {
+            return (kMaxEntrySize <= end - ptr ? -1 : 0);
+        }
+        outEnd = p + 1;
+        return 1;
+    }
+    static bool IsPrefix(
+        const char* prefix,
+        const char* ptr,
+        const char* end)
+    {
+        const size_t len = strlen(prefix);
+        return (len <= (size_t)(end - ptr) && memcmp(prefix, ptr, len) == 0);
+    }
+    static bool IsLeaf(
+        const char* ptr,
+        const char* end)
+    {
+        return (*ptr == (char)DETokenizer::kBinaryEntryMarker ||
+            IsPrefix("dentry/",    ptr, end) ||
+            IsPrefix("fattr/",     ptr, end) ||
+            IsPrefix("chunkinfo/", ptr, end)
+        );
+    }
+    bool Read()
+    {
+        char* const buf = &mBuf[0];
+        size_t      pos = 0;
+        size_t      end = 0;
+        bool        eof = false;
+        for (; ;) {
+            size_t start = pos;
+            while (start < end && buf[start] == '\n') {
+                ++start;
+            }
+            const char* ee     = 0;
+            const int   status = start < end ?
+                GetEntryEnd(buf + start, buf + end, ee) : 0;
+            if (status < 0) {
+                KFS_LOG_STREAM_FATAL <<
+                    mName << ":" << (mEntryCount + 1) <<
+                    ": invalid or too large entry" <<
+                KFS_LOG_EOM;
+                return false;
+            }
+            if (status == 0) {
+                if (eof) {
+                    // Partial last entry if any is ignored, the same as
+                    // the sequential restore does.
+                    break;
+                }
+                memmove(buf, buf + pos, end - pos);
+                end -= pos;
+                pos = 0;
+                if (! mIn.read(buf + end, mBuf.size() - end)) {
+                    if (! mIn.eof()) {
+                        KFS_LOG_STREAM_FATAL <<
+                            mName << ":" << mEntryCount << ": read error" <<
+                        KFS_LOG_EOM;
+                        return false;
+                    }
+                    eof = true;
+                }
+                end += mIn.gcount();
+                continue;
+            }
+            const char* const es = buf + start;
+            mEntryCount++;
+            if (mChecksumFlag) {
+                KFS_LOG_STREAM_FATAL <<
+                    mName << ": entry after checksum" <<
+                KFS_LOG_EOM;
+                return false;
+            }
+            if (IsPrefix("checksum/", es, ee) &&
+                    ! IsPrefix("checksum/last-line\n", es, ee)) {
+                // The checksum entry itself is not part of the checksum.
+                mChecksumFlag = true;
+            } else {
+                if (IsPrefix("digest/", es, ee)) {
+                    // Switch the digest prior to adding the entry, the same
+                    // way as the sequential restore does. The entry itself is
+                    // parsed and validated in the checkpoint order.
+                    const char* const ns = es + 7;
+                    mMds.Reset(0, string(ns, ee - ns - 1));
+                }
+                mMds.write(buf + pos, ee - (buf + pos));
+            }
+            if (IsLeaf(es, ee)) {
+                if (! ApplyRaw()) {
+                    return false;
+                }
+                if (! mCur) {
+                    if (mFree.empty()) {
+                        mCur = new Block();
+                    } else {
+                        mCur = mFree.back();
+                        mFree.pop_back();
+                    }
+                    mCur->base       = mBase;
+                    mCur->entryCount = mEntryCount;
+                }
+                mCur->data.append(es, ee - es);
+                if (kBlockSize <= mCur->data.size() && ! Submit()) {
+                    return false;
+                }
+            } else {
+                if (mCur && ! Submit()) {
+                    return false;
+                }
+                if (mRaw.empty()) {
+                    mRawEntryCount = mEntryCount;
+                }
+                mRaw.append(es, ee - es);
+            }
+            pos = ee - buf;
+        }
+        return true;
+    }
+    bool Submit()
+    {
+        if (mCur) {
+            Block* const block = mCur;
+            mCur = 0;
+            mPending.push_back(block);
+            QCStMutexLocker locker(mMutex);
+            mWork.push_back(block);
+            mWorkCond.Notify();
+        }
+        while ((size_t)(mThreadCount * kMaxPendingPerThread) <
+                mPending.size()) {
+            if (! ApplyFront()) {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool ApplyFront()
+    {
+        Block& block = *mPending.front();
+        {
+            QCStMutexLocker locker(mMutex);
+            while (! block.doneFlag) {
+                mDoneCond.Wait(mMutex);
+            }
+        }
+        for (size_t i = 0; i < block.count; i++) {
+            if (! apply_leaf(block.leaves[i])) {
+                KFS_LOG_STREAM_FATAL <<
+                    mName << ":" << (block.entryCount + i) <<
+                    ":" << GetEntry(block, i) <<
+                KFS_LOG_EOM;
+                return false;
+            }
+        }
+        if (block.errorFlag) {
+            KFS_LOG_STREAM_FATAL <<
+                mName << ":" << (block.entryCount + block.count) <<
+                ":" << block.errorEntry <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        mPending.pop_front();
+        Release(&block);
+        return true;
+    }
+    bool ApplyRaw()
+    {
+        while (! mPending.empty()) {
+            if (! ApplyFront()) {
+                return false;
+            }
+        }
+        if (mRaw.empty()) {
+            return true;
+        }
+        StrBuf      buf(mRaw);
+        istream     is(&buf);
+        DETokenizer tokenizer(is);
+        tokenizer.setIntBase(mBase);
+        while (tokenizer.next()) {
+            if (! mEntryMap.parse(tokenizer)) {
+                KFS_LOG_STREAM_FATAL <<
+                    mName << ":" <<
+                    (mRawEntryCount + tokenizer.getEntryCount() - 1) <<
+                    ":" << tokenizer.getEntry() <<
+                KFS_LOG_EOM;
+                return false;
+            }
+        }
+        mBase = tokenizer.getIntBase();
+        mRaw.clear();
+        return true;
+    }
+private:
+    ParallelRestorer(const ParallelRestorer&);
+    ParallelRestorer& operator=(const ParallelRestorer&);
+};
+
 /*!
  * \brief rebuild metadata tree from CP file cpname
  * \param[in] cpname    the CP file
@@ -527,40 +1137,59 @@ Restorer::rebuild(const string cpname, int16_t minReplicas)
         return false;
     }
 
-    DiskEntry& entrymap = get_entry_map();
-        DETokenizer tokenizer(file);
-
     restoreChecksum.clear();
+    restoreDigest.clear();
     lastLineChecksumFlag = false;
     MdStream mds(0, false, string(), 0);
+    CheckpointInflateBuf inflate(file);
+    istream in(&inflate);
     bool is_ok = true;
-    while (tokenizer.next(&mds)) {
-        if (! entrymap.parse(tokenizer)) {
-            KFS_LOG_STREAM_FATAL <<
-                cpname << ":" << tokenizer.getEntryCount() <<
-                ":" << tokenizer.getEntry() <<
-            KFS_LOG_EOM;
-            is_ok = false;
-            break;
-        }
-        if (! restoreChecksum.empty()) {
-            if (tokenizer.next()) {
+    if (0 < threadCount) {
+        ParallelRestorer restorer(in, cpname, mds, threadCount);
+        is_ok = restorer.Load();
+        restoreDigest.clear(); // Handled by the restorer.
+    } else {
+        DiskEntry& entrymap = get_entry_map();
+        DETokenizer tokenizer(in);
+        while (tokenizer.next(&mds)) {
+            if (! entrymap.parse(tokenizer)) {
                 KFS_LOG_STREAM_FATAL <<
-                    cpname << ": entry after checksum" <<
+                    cpname << ":" << tokenizer.getEntryCount() <<
+                    ":" << tokenizer.getEntry() <<
                 KFS_LOG_EOM;
                 is_ok = false;
+                break;
             }
-            break;
+            if (! restoreDigest.empty()) {
+                mds.Reset(0, restoreDigest);
+                restoreDigest.clear();
+            }
+            if (! restoreChecksum.empty()) {
+                if (tokenizer.next()) {
+                    KFS_LOG_STREAM_FATAL <<
+                        cpname << ": entry after checksum" <<
+                    KFS_LOG_EOM;
+                    is_ok = false;
+                }
+                break;
+            }
+        }
+        if (is_ok && ! in.eof()) {
+            KFS_LOG_STREAM_FATAL <<
+                "error " << cpname << ":" << tokenizer.getEntryCount() <<
+                ":" << tokenizer.getEntry() <<
+            KFS_LOG_EOM;
+            is_ok = false;
         }
     }
-    if (is_ok && ! file.eof()) {
+    file.close();
+    if (is_ok && inflate.GetStatus() != 0) {
         KFS_LOG_STREAM_FATAL <<
-            "error " << cpname << ":" << tokenizer.getEntryCount() <<
-            ":" << tokenizer.getEntry() <<
+            cpname << ": checkpoint read failure: " <<
+                QCUtils::SysError(-inflate.GetStatus()) <<
         KFS_LOG_EOM;
         is_ok = false;
     }
-    file.close();
     if (is_ok && lastLineChecksumFlag) {
         const string md = mds.GetMd();
         if (restoreChecksum != md) {
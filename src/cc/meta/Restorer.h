@@ -41,7 +41,8 @@ class Restorer
 {
 public:
     Restorer()
-        : file()
+        : file(),
+          threadCount(0)
         {}
     ~Restorer()
         {}
@@ -51,8 +52,15 @@ public:
      * the filesystem wide degree of replication in a simple manner.
      */
     bool rebuild(string cpname, int16_t minNumReplicasPerFile = 1);
+    /*
+     * number of checkpoint entry parser threads; 0 -- parse and restore
+     * entries in the calling thread.
+     */
+    void setThreadCount(int count)
+        { threadCount = count; }
 private:
     ifstream file;          //!< the CP file
+    int      threadCount;   //!< number of checkpoint parser threads
 private:
     // No copy.
     Restorer(const Restorer&);
@@ -75,6 +83,8 @@ extern int acquire_lockfile(const string &lockfn, int ntries);
 extern string restoreChecksum;
 extern bool   lastLineChecksumFlag;
 extern bool   restore_checksum(DETokenizer& c);
+extern string restoreDigest;
+extern bool   restore_digest(DETokenizer& c);
 extern bool   restore_delegate_cancel(DETokenizer& c);
 extern bool   restore_filesystem_info(DETokenizer& c);
 
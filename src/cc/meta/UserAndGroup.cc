@@ -84,6 +84,7 @@ public:
           mCond(),
           mStopFlag(false),
           mUpdateFlag(false),
+          mReleaseFlag(false),
           mDisabledFlag(false),
           mOverflowFlag(false),
           mUpdatePeriodNanoSec(QCMutex::Time(10) * 365 * 24 * 60 * 60 *
@@ -95,6 +96,8 @@ public:
           mUserExcludes(),
           mGroupExcludes(),
           mParametersReadCount(0),
+          mDbParametersReadCount(~uint64_t(0)),
+          mDbDigest(0),
           mUidNameMapPtr(new UidNameMap()),
           mUidNamePtr(mUidNameMapPtr),
           mNameUidMapPtr(new NameUidMap()),
@@ -105,6 +108,11 @@ public:
           mRootUsersPtr(new RootUsers()),
           mDelegationRenewAndCancelUsersPtr(new UserIdsSet()),
           mGroupUsersMap(),
+          mRetiredUidNamePtr(),
+          mRetiredNameUidPtr(),
+          mRetiredGidNamePtr(),
+          mRetiredRootUsersPtr(),
+          mRetiredDelegationRenewAndCancelUsersPtr(),
           mPendingUidNameMap(),
           mPendingGidNameMap(),
           mPendingNameUidMap(),
@@ -289,16 +297,45 @@ private:
     {
         QCStMutexLocker theLock(mMutex);
         for (; ;) {
-            while (! mStopFlag && ! mUpdateFlag &&
+            while (! mStopFlag && ! mUpdateFlag && ! mReleaseFlag &&
                 mCond.Wait(mMutex, mUpdatePeriodNanoSec))
                 {}
             if (mStopFlag) {
                 break;
             }
+            if (mReleaseFlag) {
+                ReleaseRetired();
+                if (! mUpdateFlag) {
+                    continue;
+                }
+            }
             mUpdateFlag = false;
             Update();
         }
     }
+    void ReleaseRetired()
+    {
+        // Destroy the tables replaced by the last update with the mutex
+        // released, in order not to delay the main thread.
+        mReleaseFlag = false;
+        UidNamePtr   theUidNamePtr;
+        NameUidPtr   theNameUidPtr;
+        GidNamePtr   theGidNamePtr;
+        RootUsersPtr theRootUsersPtr;
+        DelegationRenewAndCancelUsersPtr theDelegationRenewAndCancelUsersPtr;
+        theUidNamePtr.swap(mRetiredUidNamePtr);
+        theNameUidPtr.swap(mRetiredNameUidPtr);
+        theGidNamePtr.swap(mRetiredGidNamePtr);
+        theRootUsersPtr.swap(mRetiredRootUsersPtr);
+        theDelegationRenewAndCancelUsersPtr.swap(
+            mRetiredDelegationRenewAndCancelUsersPtr);
+        QCStMutexUnlocker theUnlock(mMutex);
+        theUidNamePtr.reset();
+        theNameUidPtr.reset();
+        theGidNamePtr.reset();
+        theRootUsersPtr.reset();
+        theDelegationRenewAndCancelUsersPtr.reset();
+    }
     int Update()
     {
         UserExcludes theUserExcludes;
@@ -324,6 +361,7 @@ private:
 
         const uint64_t theParametersReadCount = mParametersReadCount;
         bool           theOverflowFlag        = false;
+        uint64_t       theDigest              = 0;
         const int      theError               = UpdateSelf(
             theUserExcludes,
             theGroupExcludes,
@@ -335,9 +373,24 @@ private:
             theMetaStatsGroupNames,
             theDelegationGroupNames,
             theDelegationUserNames,
-            theOverflowFlag
+            theOverflowFlag,
+            theDigest
         );
-        if (theError == 0) {
+        // Only install the new tables if the user and group database or the
+        // parameters have changed, in order to avoid replacing, and freeing
+        // all the entries with each periodic refresh.
+        if (theError == 0 &&
+                theDigest == mDbDigest &&
+                theParametersReadCount == mDbParametersReadCount &&
+                theOverflowFlag == mOverflowFlag) {
+            KFS_LOG_STREAM_DEBUG <<
+                "user and group database has not changed"
+                " users: "  << mTmpUidNameMap.GetSize() <<
+                " groups: " << mTmpGidNameMap.GetSize() <<
+            KFS_LOG_EOM;
+        } else if (theError == 0) {
+            mDbDigest              = theDigest;
+            mDbParametersReadCount = theParametersReadCount;
             mPendingUidNameMap.Swap(mTmpUidNameMap);
             mPendingGidNameMap.Swap(mTmpGidNameMap);
             mPendingNameUidMap.Swap(mTmpNameUidMap);
@@ -378,20 +431,26 @@ private:
         if (mUpdateCount == mCurUpdateCount) {
             return;
         }
+        // The replaced tables are destroyed by the update thread, see
+        // ReleaseRetired().
         mUidNameMapPtr = new UidNameMap();
         mUidNameMapPtr->Swap(mPendingUidNameMap);
+        mRetiredUidNamePtr.swap(mUidNamePtr);
         mUidNamePtr.reset(mUidNameMapPtr);
 
         mNameUidMapPtr = new NameUidMap();
         mNameUidMapPtr->Swap(mPendingNameUidMap);
+        mRetiredNameUidPtr.swap(mNameUidPtr);
         mNameUidPtr.reset(mNameUidMapPtr);
 
         mGidNameMapPtr = new GidNameMap();
         mGidNameMapPtr->Swap(mPendingGidNameMap);
+        mRetiredGidNamePtr.swap(mGidNamePtr);
         mGidNamePtr.reset(mGidNameMapPtr);
 
         RootUsers* const theRootUsersPtr = new RootUsers();
         theRootUsersPtr->Swap(mPendingRootUsers);
+        mRetiredRootUsersPtr.swap(mRootUsersPtr);
         mRootUsersPtr.reset(theRootUsersPtr);
 
         mNameGidMap.Swap(mPendingNameGidMap);
@@ -405,8 +464,40 @@ private:
             new UserIdsSet();
         theDelegationRenewAndCancelUsersPtr->Swap(
             mPendingDelegationRenewAndCancelUsers);
+        mRetiredDelegationRenewAndCancelUsersPtr.swap(
+            mDelegationRenewAndCancelUsersPtr);
         mDelegationRenewAndCancelUsersPtr.reset(
             theDelegationRenewAndCancelUsersPtr);
+        if (mThread.IsStarted()) {
+            mReleaseFlag = true;
+            mCond.Notify();
+        }
+    }
+    static uint64_t Hash(
+        const void* inPtr,
+        size_t      inSize,
+        uint64_t    inHash = 14695981039346656037ULL)
+    {
+        // FNV-1a
+        const unsigned char*       thePtr    =
+            reinterpret_cast<const unsigned char*>(inPtr);
+        const unsigned char* const theEndPtr = thePtr + inSize;
+        while (thePtr < theEndPtr) {
+            inHash = (inHash ^ *thePtr++) * 1099511628211ULL;
+        }
+        return inHash;
+    }
+    static uint64_t Hash(
+        const char* inStrPtr,
+        uint64_t    inHash)
+        { return Hash(inStrPtr, strlen(inStrPtr) + 1, inHash); }
+    static uint64_t Mix(
+        uint64_t inHash)
+    {
+        inHash ^= inHash >> 33;
+        inHash *= 0xff51afd7ed558ccdULL;
+        inHash ^= inHash >> 33;
+        return inHash;
     }
     static bool StartsWith(
         const string& inString,
@@ -449,7 +540,8 @@ private:
         const MetaStatsGroupNames&  inMetaStatsGroupNames,
         const DelegationUserNames&  inDelegationUserNames,
         const DelegationGroupNames& inDelegationGroupNames,
-        bool&                       outOverflowFlag)
+        bool&                       outOverflowFlag,
+        uint64_t&                   outDigest)
     {
         kfsUid_t const theMinUserId       = mMinUserId;
         kfsUid_t const theMaxUserId       = mMaxUserId;
@@ -489,6 +581,16 @@ private:
                 }
                 break;
             }
+            // Order independent database digest, used to detect changes.
+            uint64_t theHash = Hash(theEntryPtr->gr_name, 1);
+            theHash = Hash(&theEntryPtr->gr_gid, sizeof(theEntryPtr->gr_gid),
+                theHash);
+            for (char** thePtr = theEntryPtr->gr_mem;
+                    thePtr && *thePtr;
+                    ++thePtr) {
+                theHash = Hash(*thePtr, theHash);
+            }
+            outDigest += Mix(theHash);
             const string   theName = theEntryPtr->gr_name;
             kfsGid_t const theGid  = (kfsGid_t)theEntryPtr->gr_gid;
             if (! IsValidName(theName)) {
@@ -595,6 +697,12 @@ private:
                 }
                 break;
             }
+            uint64_t theHash = Hash(theEntryPtr->pw_name, 2);
+            theHash = Hash(&theEntryPtr->pw_uid, sizeof(theEntryPtr->pw_uid),
+                theHash);
+            theHash = Hash(&theEntryPtr->pw_gid, sizeof(theEntryPtr->pw_gid),
+                theHash);
+            outDigest += Mix(theHash);
             const string   theName = theEntryPtr->pw_name;
             kfsUid_t const theUid  = (kfsUid_t)theEntryPtr->pw_uid;
             if (! IsValidName(theName)) {
@@ -840,6 +948,7 @@ private:
     QCCondVar                        mCond;
     bool                             mStopFlag;
     bool                             mUpdateFlag;
+    bool                             mReleaseFlag;
     bool                             mDisabledFlag;
     bool                             mOverflowFlag;
     QCMutex::Time                    mUpdatePeriodNanoSec;
@@ -850,6 +959,8 @@ private:
     UserExcludes                     mUserExcludes;
     GroupExcludes                    mGroupExcludes;
     uint64_t                         mParametersReadCount;
+    uint64_t                         mDbParametersReadCount;
+    uint64_t                         mDbDigest;
     UidNameMap*                      mUidNameMapPtr;
     UidNamePtr                       mUidNamePtr;
     GidNameMap                       mGidNameMap;
@@ -861,6 +972,11 @@ private:
     RootUsersPtr                     mRootUsersPtr;
     DelegationRenewAndCancelUsersPtr mDelegationRenewAndCancelUsersPtr;
     GroupUsersMap                    mGroupUsersMap;
+    UidNamePtr                       mRetiredUidNamePtr;
+    NameUidPtr                       mRetiredNameUidPtr;
+    GidNamePtr                       mRetiredGidNamePtr;
+    RootUsersPtr                     mRetiredRootUsersPtr;
+    DelegationRenewAndCancelUsersPtr mRetiredDelegationRenewAndCancelUsersPtr;
     UidNameMap                       mPendingUidNameMap;
     GidNameMap                       mPendingGidNameMap;
     NameUidMap                       mPendingNameUidMap;
@@ -0,0 +1,469 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Checkpoint write and load benchmark with synthetic namespace.
+// Generates in memory namespace with the given number of files, chunks,
+// directory tree depth and fan out, writes it as checkpoint with the same
+// code path as the meta server and log compactor, and then loads the
+// checkpoint with Restorer in a new process, in order to measure the load
+// time and memory use without the generator memory. The generate and load
+// modes can also be run separately, for example on different hosts, or to
+// avoid keeping the generated namespace in memory while loading very large
+// checkpoint. The checkpoint written references transaction log segment 0.
+//
+//----------------------------------------------------------------------------
+
+#include "kfstree.h"
+#include "Logger.h"
+#include "Checkpoint.h"
+#include "Restorer.h"
+#include "util.h"
+#include "common/MsgLogger.h"
+#include "common/MdStream.h"
+#include "common/time.h"
+#include "common/IntToString.h"
+#include "qcdio/QCUtils.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace KFS
+{
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::string;
+using std::vector;
+
+static int64_t
+GetRssBytes()
+{
+    // Linux specific, returns -1 if /proc is not available.
+    ifstream theStream("/proc/self/statm");
+    int64_t  theSize = -1;
+    int64_t  theRss  = -1;
+    if (! (theStream >> theSize >> theRss)) {
+        return -1;
+    }
+    return theRss * (int64_t)sysconf(_SC_PAGESIZE);
+}
+
+static int64_t
+GetMaxRssBytes()
+{
+    struct rusage theUsage;
+    if (getrusage(RUSAGE_SELF, &theUsage)) {
+        return -1;
+    }
+#ifdef KFS_OS_NAME_DARWIN
+    return (int64_t)theUsage.ru_maxrss;
+#else
+    return (int64_t)theUsage.ru_maxrss * 1024;
+#endif
+}
+
+class SyntheticNamespace
+{
+public:
+    SyntheticNamespace(
+        int64_t inFileCount,
+        int64_t inChunkCount,
+        int     inDepth,
+        int     inFanout,
+        int16_t inNumReplicas)
+        : mFileCount(inFileCount),
+          mChunkCount(inChunkCount),
+          mDepth(inDepth),
+          mFanout(inFanout),
+          mNumReplicas(inNumReplicas),
+          mTime(microseconds()),
+          mLeafDirs(),
+          mDirCount(0),
+          mName()
+        {}
+    int Generate()
+    {
+        int theStatus = MakeDirs(ROOTFID, 0);
+        if (theStatus != 0) {
+            return theStatus;
+        }
+        if (mLeafDirs.empty()) {
+            mLeafDirs.push_back(ROOTFID);
+        }
+        int64_t theChunksLeft = mChunkCount;
+        for (int64_t i = 0; i < mFileCount; i++) {
+            // Distribute the chunks evenly: the first files get one extra
+            // chunk, if the chunk count isn't multiple of the file count.
+            const int64_t theChunks = theChunksLeft / (mFileCount - i) +
+                ((theChunksLeft % (mFileCount - i)) != 0 ? 1 : 0);
+            theChunksLeft -= theChunks;
+            if ((theStatus = MakeFile(
+                    mLeafDirs[(size_t)(i % (int64_t)mLeafDirs.size())],
+                    i, theChunks)) != 0) {
+                return theStatus;
+            }
+        }
+        return 0;
+    }
+    int64_t GetDirCount() const
+        { return mDirCount; }
+private:
+    const int64_t mFileCount;
+    const int64_t mChunkCount;
+    const int     mDepth;
+    const int     mFanout;
+    const int16_t mNumReplicas;
+    const int64_t mTime;
+    vector<fid_t> mLeafDirs;
+    int64_t       mDirCount;
+    string        mName;
+
+    const string& MakeName(
+        char    inPrefix,
+        int64_t inIdx)
+    {
+        mName.clear();
+        mName += inPrefix;
+        AppendDecIntToString(mName, inIdx);
+        return mName;
+    }
+    int MakeDirs(
+        fid_t inDir,
+        int   inLevel)
+    {
+        if (mDepth <= inLevel) {
+            if (0 < inLevel) {
+                mLeafDirs.push_back(inDir);
+            }
+            return 0;
+        }
+        for (int i = 0; i < mFanout; i++) {
+            fid_t      theFid   = -1;
+            MetaFattr* theFattr = 0;
+            const int  theStatus = metatree.mkdir(inDir, MakeName('d', i),
+                kKfsUserRoot, kKfsGroupRoot, 0755,
+                kKfsUserRoot, kKfsGroupRoot, &theFid, &theFattr, mTime);
+            if (theStatus != 0) {
+                KFS_LOG_STREAM_ERROR << "mkdir: " << mName << ": " <<
+                    QCUtils::SysError(-theStatus) <<
+                KFS_LOG_EOM;
+                return theStatus;
+            }
+            mDirCount++;
+            const int theRet = MakeDirs(theFid, inLevel + 1);
+            if (theRet != 0) {
+                return theRet;
+            }
+        }
+        return 0;
+    }
+    int MakeFile(
+        fid_t   inDir,
+        int64_t inIdx,
+        int64_t inChunks)
+    {
+        fid_t      theFid        = -1;
+        fid_t      theToDumpster = -1;
+        MetaFattr* theFattr      = 0;
+        int        theStatus     = metatree.create(
+            inDir, MakeName('f', inIdx), &theFid, mNumReplicas, true,
+            KFS_STRIPED_FILE_TYPE_NONE, 0, 0, 0, theToDumpster,
+            kKfsUserRoot, kKfsGroupRoot, 0644,
+            kKfsUserRoot, kKfsGroupRoot, &theFattr, mTime);
+        if (theStatus != 0) {
+            KFS_LOG_STREAM_ERROR << "create: " << mName << ": " <<
+                QCUtils::SysError(-theStatus) <<
+            KFS_LOG_EOM;
+            return theStatus;
+        }
+        for (int64_t i = 0; i < inChunks; i++) {
+            if ((theStatus = metatree.assignChunkId(
+                    theFid, (chunkOff_t)(i * (int64_t)CHUNKSIZE),
+                    chunkID.genid(), 1)) != 0) {
+                KFS_LOG_STREAM_ERROR << "assign chunk: " << mName << ": " <<
+                    QCUtils::SysError(-theStatus) <<
+                KFS_LOG_EOM;
+                return theStatus;
+            }
+        }
+        if (theFattr) {
+            theFattr->filesize = (chunkOff_t)(inChunks * (int64_t)CHUNKSIZE);
+        }
+        return 0;
+    }
+private:
+    SyntheticNamespace(
+        const SyntheticNamespace& inNamespace);
+    SyntheticNamespace& operator=(
+        const SyntheticNamespace& inNamespace);
+};
+
+static int
+GenerateAndWrite(
+    int64_t inFileCount,
+    int64_t inChunkCount,
+    int     inDepth,
+    int     inFanout,
+    int16_t inNumReplicas)
+{
+    int theStatus = metatree.new_tree();
+    if (theStatus != 0) {
+        return theStatus;
+    }
+    const int64_t theRssStart = GetRssBytes();
+    const int64_t theStart    = microseconds();
+    SyntheticNamespace theNamespace(
+        inFileCount, inChunkCount, inDepth, inFanout, inNumReplicas);
+    if ((theStatus = theNamespace.Generate()) != 0) {
+        return theStatus;
+    }
+    metatree.recomputeDirSize();
+    const int64_t theGenEnd = microseconds();
+    const int64_t theRssGen = GetRssBytes();
+    oplog.setLog(0);
+    if ((theStatus = cp.do_CP()) != 0) {
+        KFS_LOG_STREAM_ERROR << "checkpoint write: " <<
+            QCUtils::SysError(-theStatus) <<
+        KFS_LOG_EOM;
+        return theStatus;
+    }
+    const int64_t theCpEnd = microseconds();
+    struct stat theStat;
+    const int64_t theCpSize = stat(cp.name().c_str(), &theStat) == 0 ?
+        (int64_t)theStat.st_size : int64_t(-1);
+    cout <<
+        "generate:"
+        " files="            << inFileCount <<
+        " dirs="             << theNamespace.GetDirCount() <<
+        " chunks="           << inChunkCount <<
+        " generate-sec="     << (theGenEnd - theStart) * 1e-6 <<
+        " generate-rss="     << (theRssGen - theRssStart) <<
+    "\n"
+        "write:"
+        " checkpoint="       << cp.name() <<
+        " binary="           << cp.getWriteBinaryFlag() <<
+        " sync="             << cp.getWriteSyncFlag() <<
+        " threads="          << cp.getWriteThreadCount() <<
+        " bytes="            << theCpSize <<
+        " write-sec="        << (theCpEnd - theGenEnd) * 1e-6 <<
+        " write-mb-per-sec=" << (theCpEnd <= theGenEnd ? 0. :
+            theCpSize / ((theCpEnd - theGenEnd) * 1e-6) / (1 << 20)) <<
+    "\n";
+    cout.flush();
+    return 0;
+}
+
+static int
+Load(
+    int inThreadCount)
+{
+    const int64_t theRssStart = GetRssBytes();
+    const int64_t theStart    = microseconds();
+    Restorer theRestorer;
+    theRestorer.setThreadCount(inThreadCount);
+    if (! theRestorer.rebuild(LASTCP)) {
+        KFS_LOG_STREAM_ERROR << LASTCP << ": checkpoint load failure" <<
+        KFS_LOG_EOM;
+        return -EIO;
+    }
+    const int64_t theEnd = microseconds();
+    const int64_t theRss = GetRssBytes();
+    int64_t theFiles  = 0;
+    int64_t theDirs   = 0;
+    const MetaFattr* const theRootPtr = metatree.getFattr(ROOTFID);
+    if (theRootPtr) {
+        theFiles  = theRootPtr->fileCount();
+        theDirs   = theRootPtr->dirCount();
+    }
+    const int64_t theEntries = theFiles + theDirs;
+    cout <<
+        "load:"
+        " checkpoint="       << LASTCP <<
+        " threads="          << inThreadCount <<
+        " files="            << theFiles <<
+        " dirs="             << theDirs <<
+        " load-sec="         << (theEnd - theStart) * 1e-6 <<
+        " entries-per-sec="  << (theEnd <= theStart ? 0. :
+            theEntries * 1e6 / (theEnd - theStart)) <<
+        " rss="              << (theRss - theRssStart) <<
+        " max-rss="          << GetMaxRssBytes() <<
+        " rss-per-entry="    << (theEntries <= 0 ? 0. :
+            (double)(theRss - theRssStart) / theEntries) <<
+    "\n";
+    cout.flush();
+    return 0;
+}
+
+static int
+CheckpointBenchMain(int argc, char** argv)
+{
+    int         optchar;
+    bool        help          = false;
+    string      cpdir;
+    const char* mode          = "both";
+    int64_t     fileCount     = 1000 * 1000;
+    int64_t     chunkCount    = -1;
+    int         depth         = 3;
+    int         fanout        = 10;
+    int16_t     numReplicas   = 3;
+    int         threadCount   = 0;
+    int         status        = 0;
+
+    while ((optchar = getopt(argc, argv, "hc:m:n:k:d:w:r:t:W:bs:")) != -1) {
+        switch (optchar) {
+            case 'c':
+                cpdir = optarg;
+                break;
+            case 'm':
+                mode = optarg;
+                break;
+            case 'n':
+                fileCount = (int64_t)atoll(optarg);
+                break;
+            case 'k':
+                chunkCount = (int64_t)atoll(optarg);
+                break;
+            case 'd':
+                depth = atoi(optarg);
+                break;
+            case 'w':
+                fanout = atoi(optarg);
+                break;
+            case 'r':
+                numReplicas = (int16_t)atoi(optarg);
+                break;
+            case 't':
+                threadCount = atoi(optarg);
+                break;
+            case 'W':
+                cp.setWriteThreadCount(atoi(optarg));
+                break;
+            case 'b':
+                cp.setWriteBinaryFlag(true);
+                break;
+            case 's':
+                cp.setWriteSyncFlag(atoi(optarg) != 0);
+                break;
+            case 'h':
+                help = true;
+                break;
+            default:
+                status = 1;
+                break;
+        }
+    }
+    const bool generateFlag =
+        strcmp(mode, "generate") == 0 || strcmp(mode, "both") == 0;
+    const bool loadFlag =
+        strcmp(mode, "load") == 0 || strcmp(mode, "both") == 0;
+    if (chunkCount < 0) {
+        chunkCount = fileCount;
+    }
+    if (! help && (cpdir.empty() || (! generateFlag && ! loadFlag) ||
+            fileCount < 0 || depth < 0 || fanout <= 0 || numReplicas <= 0 ||
+            (fileCount <= 0 && 0 < chunkCount))) {
+        status = 1;
+    }
+    if (help || status != 0) {
+        (status ? cerr : cout) << "Usage: " << argv[0] << "\n"
+            "-c <cpdir>\n"
+            "[-m {generate|load|both} default both]\n"
+            "[-n <# of files> default 1000000]\n"
+            "[-k <# of chunks> default # of files]\n"
+            "[-d <directory tree depth> default 3]\n"
+            "[-w <# of sub directories per directory> default 10]\n"
+            "[-r <# of replicas per file> default 3]\n"
+            "[-t <# of checkpoint load parser threads>]\n"
+            "[-W <# of checkpoint write threads>]\n"
+            "[-b write checkpoint leaf entries in binary format]\n"
+            "[-s {0|1} sync checkpoint writes, default 1]\n"
+        ;
+        return status;
+    }
+
+    MdStream::Init();
+    MsgLogger::Init(0, MsgLogger::kLogLevelINFO);
+
+    // The log directory is not used, the transaction log isn't written.
+    logger_setup_paths(cpdir);
+    checkpointer_setup_paths(cpdir);
+    if (generateFlag) {
+        status = GenerateAndWrite(
+            fileCount, chunkCount, depth, fanout, numReplicas);
+    }
+    if (status == 0 && loadFlag) {
+        if (generateFlag) {
+            // Load in new process, in order to measure the memory used by the
+            // restored namespace alone.
+            const pid_t thePid = fork();
+            if (thePid < 0) {
+                status = errno > 0 ? -errno : -EIO;
+            } else if (thePid == 0) {
+                string theThreads;
+                AppendDecIntToString(theThreads, threadCount);
+                char* theArgs[] = {
+                    argv[0],
+                    const_cast<char*>("-m"), const_cast<char*>("load"),
+                    const_cast<char*>("-c"), const_cast<char*>(cpdir.c_str()),
+                    const_cast<char*>("-t"),
+                    const_cast<char*>(theThreads.c_str()),
+                    0
+                };
+                execvp(argv[0], theArgs);
+                const int theErr = errno;
+                KFS_LOG_STREAM_ERROR << argv[0] << ": " <<
+                    QCUtils::SysError(theErr) <<
+                KFS_LOG_EOM;
+                _exit(1);
+            } else {
+                int theExitStatus = 0;
+                while (waitpid(thePid, &theExitStatus, 0) < 0 &&
+                        errno == EINTR)
+                    {}
+                status = (WIFEXITED(theExitStatus) &&
+                    WEXITSTATUS(theExitStatus) == 0) ? 0 : -EIO;
+            }
+        } else {
+            status = Load(threadCount);
+        }
+    }
+    MdStream::Cleanup();
+    return (status == 0 ? 0 : 1);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    return KFS::CheckpointBenchMain(argc, argv);
+}
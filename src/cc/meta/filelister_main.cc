@@ -23,6 +23,11 @@
 //
 // \brief Given a checkpoint, write out the list of files in the tree and their
 // metadata in a "ls -l" format.
+// With the thread count, filters, or output format specified, the directory
+// sub trees at the partition depth are assigned to the lister threads in round
+// robin order, and each thread writes its own output shard file. The entries
+// above the partition depth are written into the first shard. The path prefix,
+// size, and modification time filters are applied during the tree scan.
 //
 //----------------------------------------------------------------------------
 
@@ -32,11 +37,17 @@
 #include "Restorer.h"
 #include "Replay.h"
 #include "util.h"
+#include "DiskEntry.h"
 #include "common/MdStream.h"
 #include "common/MsgLogger.h"
+#include "common/IntToString.h"
+#include "qcdio/QCUtils.h"
+#include "qcdio/QCThread.h"
 
 #include <iostream>
+#include <fstream>
 #include <cassert>
+#include <limits>
 
 namespace KFS
 {
@@ -44,6 +55,7 @@ using std::cout;
 using std::cerr;
 using std::set;
 using std::istringstream;
+using std::numeric_limits;
 
 static int
 RestoreCheckpoint(const string& lockfn, bool allowEmptyCheckpointFlag)
@@ -59,6 +71,267 @@ RestoreCheckpoint(const string& lockfn, bool allowEmptyCheckpointFlag)
     }
 }
 
+class ShardLister : public QCRunnable
+{
+public:
+    enum Format
+    {
+        kFormatText   = 0,
+        kFormatTsv    = 1,
+        kFormatBinary = 2
+    };
+    class Filter
+    {
+    public:
+        Filter()
+            : prefix(),
+              minSize(-1),
+              maxSize(numeric_limits<int64_t>::max()),
+              minMtime(numeric_limits<int64_t>::min()),
+              maxMtime(numeric_limits<int64_t>::max()),
+              ids()
+            {}
+        string     prefix;
+        int64_t    minSize;
+        int64_t    maxSize;
+        int64_t    minMtime; //!< micro seconds
+        int64_t    maxMtime;
+        set<fid_t> ids;
+    };
+
+    ShardLister()
+        : QCRunnable(),
+          thread(),
+          filter(0),
+          format(kFormatText),
+          index(0),
+          count(1),
+          depth(1),
+          fileName(),
+          status(0),
+          entries(0),
+          os(),
+          writer()
+        {}
+    bool Start(const Filter& flt, Format fmt, int idx, int cnt,
+        size_t partitionDepth, const string& fn)
+    {
+        filter   = &flt;
+        format   = fmt;
+        index    = idx;
+        count    = cnt;
+        depth    = partitionDepth;
+        fileName = fn;
+        os.open(fileName.c_str(), ofstream::binary | ofstream::trunc);
+        if (! os) {
+            status = errno > 0 ? -errno : -EIO;
+            KFS_LOG_STREAM_ERROR << fileName << ": " <<
+                QCUtils::SysError(-status) <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        if (format == kFormatTsv && index == 0) {
+            os << "path\ttype\tfid\tsize\tmtime\treplicas\tstripes"
+                "\trecoverystripes\tuser\tgroup\tmode\n";
+        }
+        const int kStackSize = 256 << 10;
+        const int err = thread.TryToStart(this, kStackSize, "FileLister");
+        if (err) {
+            KFS_LOG_STREAM_ERROR << QCUtils::SysError(
+                err, "failed to start file lister thread") <<
+            KFS_LOG_EOM;
+            status = 0 < err ? -err : -EIO;
+            return false;
+        }
+        return true;
+    }
+    int Join()
+    {
+        if (thread.IsStarted()) {
+            thread.Join();
+        }
+        if (os.is_open()) {
+            os.close();
+            if (status == 0 && os.fail()) {
+                status = -EIO;
+            }
+        }
+        return status;
+    }
+    virtual void Run()
+    {
+        PathListerT<ShardLister> lister(*this);
+        metatree.iterateDentries(lister, (size_t)index, (size_t)count, depth);
+        os.flush();
+        if (! os) {
+            status = -EIO;
+        }
+    }
+    bool operator()(const string& dirpath, const MetaDentry& de,
+        const MetaFattr& fa, size_t entryDepth)
+    {
+        // The entries above the partition depth are visited by all
+        // partitions, and written only into the first shard.
+        if (entryDepth < depth && index != 0) {
+            return true;
+        }
+        const bool dirFlag = fa.type == KFS_DIR;
+        if (dirFlag ? (! filter->ids.empty() || 0 <= filter->minSize) :
+                (! filter->ids.empty() &&
+                    filter->ids.find(fa.id()) == filter->ids.end())) {
+            return true;
+        }
+        if (fa.mtime < filter->minMtime || filter->maxMtime < fa.mtime) {
+            return true;
+        }
+        if (! dirFlag &&
+                (fa.filesize < filter->minSize ||
+                filter->maxSize < fa.filesize)) {
+            return true;
+        }
+        // File path is directory path with trailing slash and the name.
+        if (! filter->prefix.empty() && ! PathStartsWith(
+                dirpath, dirFlag ? 0 : &de.getName(), filter->prefix)) {
+            return true;
+        }
+        switch (format) {
+            case kFormatTsv:
+                WriteTsv(dirpath, de, fa, dirFlag);
+                break;
+            case kFormatBinary:
+                WriteBinary(dirpath, de, fa, dirFlag);
+                break;
+            default:
+                if (dirFlag) {
+                    os << dirpath <<
+                        " <dir> " << fa.id() <<
+                        ' ' << DisplayIsoDateTime(fa.mtime) <<
+                        "\n";
+                } else {
+                    os << dirpath << de.getName() <<
+                        ' ' << fa.id() <<
+                        ' ' << fa.filesize <<
+                        ' ' << DisplayIsoDateTime(fa.mtime) <<
+                        "\n";
+                }
+                break;
+        }
+        entries++;
+        return (! os.fail());
+    }
+    int64_t getEntries() const { return entries; }
+private:
+    QCThread       thread;
+    const Filter*  filter;
+    Format         format;
+    int            index;
+    int            count;
+    size_t         depth;
+    string         fileName;
+    int            status;
+    int64_t        entries;
+    ofstream       os;
+    DEBinaryWriter writer;
+
+    static bool PathStartsWith(const string& dirpath, const string* name,
+        const string& prefix)
+    {
+        if (prefix.size() <= dirpath.size()) {
+            return (dirpath.compare(0, prefix.size(), prefix) == 0);
+        }
+        if (! name || dirpath.compare(0, dirpath.size(),
+                prefix, 0, dirpath.size()) != 0) {
+            return false;
+        }
+        const size_t len = min(name->size(), prefix.size() - dirpath.size());
+        return (name->compare(0, len, prefix, dirpath.size(), len) == 0 &&
+            len == prefix.size() - dirpath.size());
+    }
+    void WriteTsv(const string& dirpath, const MetaDentry& de,
+        const MetaFattr& fa, bool dirFlag)
+    {
+        os << dirpath;
+        if (! dirFlag) {
+            os << de.getName();
+        }
+        os <<
+            '\t' << (dirFlag ? 'd' : 'f') <<
+            '\t' << fa.id() <<
+            '\t' << fa.filesize <<
+            '\t' << fa.mtime <<
+            '\t' << fa.numReplicas <<
+            '\t' << fa.numStripes <<
+            '\t' << fa.numRecoveryStripes <<
+            '\t' << fa.user <<
+            '\t' << fa.group <<
+            '\t' << fa.mode <<
+        '\n';
+    }
+    void WriteBinary(const string& dirpath, const MetaDentry& de,
+        const MetaFattr& fa, bool dirFlag)
+    {
+        // Same length prefixed entry encoding as the binary checkpoint.
+        writer.str(dirFlag ? "d" : "f");
+        if (dirFlag) {
+            writer.str(dirpath);
+        } else {
+            writer.str(dirpath + de.getName());
+        }
+        writer.
+            num(fa.id()).
+            num(fa.filesize).
+            num(fa.mtime).
+            num(fa.numReplicas).
+            num(fa.numStripes).
+            num(fa.numRecoveryStripes).
+            num(fa.user).
+            num(fa.group).
+            num(fa.mode);
+        writer.write(os);
+    }
+private:
+    ShardLister(const ShardLister&);
+    ShardLister& operator=(const ShardLister&);
+};
+
+static int
+ListShards(const string& pathFn, int threadCount, size_t partitionDepth,
+    ShardLister::Format format, const ShardLister::Filter& filter)
+{
+    ShardLister* const listers = new ShardLister[threadCount];
+    int     status  = 0;
+    int     started = 0;
+    for (int i = 0; i < threadCount; i++) {
+        string fn = pathFn;
+        if (1 < threadCount) {
+            fn += ".";
+            AppendDecIntToString(fn, i);
+        }
+        if (! listers[i].Start(
+                filter, format, i, threadCount, partitionDepth, fn)) {
+            status = -EIO;
+            break;
+        }
+        started++;
+    }
+    int64_t entries = 0;
+    for (int i = 0; i < threadCount; i++) {
+        const int ret = listers[i].Join();
+        if (status == 0) {
+            status = ret;
+        }
+        entries += listers[i].getEntries();
+    }
+    delete [] listers;
+    KFS_LOG_STREAM(status == 0 ?
+            MsgLogger::kLogLevelINFO : MsgLogger::kLogLevelERROR) <<
+        "shards: "  << started <<
+        " entries: " << entries <<
+        " status: " << status <<
+    KFS_LOG_EOM;
+    return status;
+}
+
 static int
 FileListerMain(int argc, char **argv)
 {
@@ -72,8 +345,14 @@ FileListerMain(int argc, char **argv)
     bool       allowEmptyCheckpointFlag = false;
     int        status = 0;
     set<fid_t> ids;
+    int        threadCount    = 0;
+    size_t     partitionDepth = 1;
+    bool       shardFlag      = false;
+    ShardLister::Format format = ShardLister::kFormatText;
+    ShardLister::Filter filter;
 
-    while ((optchar = getopt(argc, argv, "hl:c:f:L:i:e:")) != -1) {
+    while ((optchar = getopt(argc, argv,
+            "hl:c:f:L:i:e:t:d:F:p:s:S:m:M:")) != -1) {
         switch (optchar) {
             case 'L':
                 lockfn = optarg;
@@ -93,6 +372,45 @@ FileListerMain(int argc, char **argv)
             case 'e':
                 allowEmptyCheckpointFlag = atoi(optarg) != 0;
                 break;
+            case 't':
+                threadCount = atoi(optarg);
+                shardFlag   = true;
+                break;
+            case 'd':
+                partitionDepth = (size_t)max(0, atoi(optarg));
+                break;
+            case 'F':
+                if (strcmp(optarg, "text") == 0) {
+                    format = ShardLister::kFormatText;
+                } else if (strcmp(optarg, "tsv") == 0) {
+                    format = ShardLister::kFormatTsv;
+                } else if (strcmp(optarg, "binary") == 0) {
+                    format = ShardLister::kFormatBinary;
+                } else {
+                    status = 1;
+                }
+                shardFlag = true;
+                break;
+            case 'p':
+                filter.prefix = optarg;
+                shardFlag = true;
+                break;
+            case 's':
+                filter.minSize = (int64_t)atoll(optarg);
+                shardFlag = true;
+                break;
+            case 'S':
+                filter.maxSize = (int64_t)atoll(optarg);
+                shardFlag = true;
+                break;
+            case 'm':
+                filter.minMtime = (int64_t)atoll(optarg) * 1000 * 1000;
+                shardFlag = true;
+                break;
+            case 'M':
+                filter.maxMtime = (int64_t)atoll(optarg) * 1000 * 1000;
+                shardFlag = true;
+                break;
             case 'i': {
                     istringstream is(optarg);
                     fid_t id;
@@ -115,9 +433,22 @@ FileListerMain(int argc, char **argv)
             "[-f <output fn>]\n"
             "[-i fid]\n"
             "[-e {0|1} allow empty checkpoint]\n"
+            "[-t <# of lister threads> write <output fn>.<n> shards]\n"
+            "[-d <partition directory depth> default 1]\n"
+            "[-F {text|tsv|binary} output format, default text]\n"
+            "[-p <path prefix>]\n"
+            "[-s <min file size>]\n"
+            "[-S <max file size>]\n"
+            "[-m <min modification time, unix seconds>]\n"
+            "[-M <max modification time, unix seconds>]\n"
         ;
         return status;
     }
+    if (shardFlag && (pathFn.empty() || pathFn == "-")) {
+        cerr << "output file name is required with the thread count, output"
+            " format, or filters specified\n";
+        return 1;
+    }
 
     MdStream::Init();
     MsgLogger::Init(0, MsgLogger::kLogLevelINFO);
@@ -126,6 +457,17 @@ FileListerMain(int argc, char **argv)
     checkpointer_setup_paths(cpdir);
     if ((status = RestoreCheckpoint(lockfn, allowEmptyCheckpointFlag)) == 0 &&
             (status = replayer.playLogs()) == 0) {
+        if (shardFlag) {
+            // Set the directory sizes, and the directory entries attribute
+            // pointers, in order to avoid attribute lookups in the lister
+            // threads.
+            metatree.recomputeDirSize();
+            filter.ids.swap(ids);
+            status = ListShards(pathFn, max(1, threadCount), partitionDepth,
+                format, filter);
+            MdStream::Cleanup();
+            return (status == 0 ? 0 : 1);
+        }
         if (pathFn == "-") {
             metatree.listPaths(cout, ids);
             return 0;
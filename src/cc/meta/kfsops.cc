@@ -42,6 +42,7 @@ using std::lower_bound;
 using std::set;
 using std::max;
 using std::make_pair;
+using std::pair;
 
 const string kParentDir("..");
 const string kThisDir(".");
@@ -101,7 +102,7 @@ void
 emptyDumpsterDir()
 {
     makeDumpsterDir();
-    metatree.cleanupDumpster();
+    metatree.cleanupDumpster(0);
 }
 
 /*!
@@ -307,58 +308,6 @@ Tree::unlink(fid_t dir, const string& fname, MetaFattr *fa, bool save_fa)
     }
 }
 
-void Tree::invalidatePathCache(const string& pathname, const string& name,
-    const MetaFattr* fa, bool removeDirPrefixFlag)
-{
-    if (mPathToFidCache.empty()) {
-        return;
-    }
-    string pn;
-    if (! pathname.empty() && pn[0] == '/') {
-        pn = pathname;
-    }
-    if (pn.empty()) {
-        if (! fa->parent && fa->id() != ROOTFID) {
-            panic("invalid file attribute");
-            return;
-        }
-        pn = fa->parent ? getPathname(fa->parent) : string("/");
-        if (! pn.empty()) {
-            if (pn == "/") {
-                pn =  pn + name;
-            } else {
-                pn =  pn + "/" + name;
-            }
-        }
-    }
-    if (pn.empty()) {
-        mPathToFidCache.clear();
-        return;
-    }
-    mPathToFidCache.erase(pn);
-    if (! removeDirPrefixFlag || fa->type != KFS_DIR) {
-        return;
-    }
-    if (*pn.rbegin() != '/') {
-        pn += "/";
-    }
-    const size_t len     = pn.length();
-    int          maxScan = 1 << 10;
-    for (PathToFidCacheMap::iterator it = mPathToFidCache.lower_bound(pn);
-            it != mPathToFidCache.end();
-            ) {
-        const string& cp = it->first;
-        if (cp.length() < len || cp.compare(0, len, pn) != 0) {
-            break;
-        }
-        if (--maxScan < 0) {
-            mPathToFidCache.clear();
-            break;
-        }
-        mPathToFidCache.erase(it++);
-    }
-}
-
 void
 Tree::setFileSize(MetaFattr* fa, chunkOff_t size, int64_t nfiles, int64_t ndirs)
 {
@@ -403,7 +352,10 @@ Tree::remove(fid_t dir, const string& fname, const string& pathname,
     if (IsDeleteRestricted(parent, fa, euser)) {
         return -EPERM;
     }
-    invalidatePathCache(pathname, fname, fa);
+    if (isPackContainer(fa->id())) {
+        // Packed files still reference the container.
+        return -EBUSY;
+    }
     if (0 < fa->chunkcount() || 0 == fa->numReplicas) {
         if (todumpster <= 0) {
             if (0 != fa->numReplicas) {
@@ -436,6 +388,9 @@ Tree::remove(fid_t dir, const string& fname, const string& pathname,
     if (0 == fa->numReplicas) {
         gLayoutManager.DeleteFile(*fa);
     }
+    if (fa->packedFlag) {
+        releasePacked(fa);
+    }
     UpdateNumFiles(-1);
     parent->mtime = mtime;
     setFileSize(fa, 0, -1, 0);
@@ -590,7 +545,6 @@ Tree::rmdir(fid_t dir, const string& dname, const string& pathname,
     if (! emptydir(myID)) {
         return -ENOTEMPTY;
     }
-    invalidatePathCache(pathname, dname, fa);
     UpdateNumDirs(-1);
     parent->mtime = mtime;
     setFileSize(fa, 0, 0, -1);
@@ -600,6 +554,106 @@ Tree::rmdir(fid_t dir, const string& dname, const string& pathname,
     return 0;
 }
 
+/*!
+ * \brief check that the user can remove all entries in the directory sub tree
+ * with the client side recursive remove: every directory has to be readable,
+ * searchable, and writable, and none of the entries must be delete restricted.
+ */
+bool
+Tree::canRemoveSubTree(MetaFattr* dirfa, kfsUid_t euser, kfsGid_t egroup)
+{
+    if (euser == kKfsUserRoot) {
+        return true;
+    }
+    StTmp<vector<MetaDentry*> > dentriesTmp(mDentriesTmp);
+    vector<MetaDentry*>&        v = dentriesTmp.Get();
+    vector<MetaFattr*>          dirs;
+    dirs.push_back(dirfa);
+    while (! dirs.empty()) {
+        MetaFattr* const fa = dirs.back();
+        dirs.pop_back();
+        if (! fa->CanRead(euser, egroup) ||
+                ! fa->CanSearch(euser, egroup) ||
+                ! fa->CanWrite(euser, egroup)) {
+            return false;
+        }
+        v.clear();
+        readdir(fa->id(), v);
+        for (vector<MetaDentry*>::const_iterator it = v.begin();
+                it != v.end();
+                ++it) {
+            const string& name = (*it)->getName();
+            if (name == kThisDir || name == kParentDir) {
+                continue;
+            }
+            MetaFattr* const efa = (*it)->getFattr();
+            if (IsDeleteRestricted(fa, efa, euser)) {
+                return false;
+            }
+            if (efa->type == KFS_DIR) {
+                dirs.push_back(efa);
+            }
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief remove a directory and its content, by moving the directory into the
+ * dumpster, where the sub tree is incrementally removed by cleanupDumpster()
+ * \param[in] dir   file id of the parent directory
+ * \param[in] dname name of directory
+ * \param[in] pathname  fully qualified path to dname
+ * \param[out] todumpster set to the directory id if the directory has been
+ * moved into the dumpster, -1 if the empty directory was removed
+ * \return      status code (zero on success)
+ */
+int
+Tree::rmdirRecursive(fid_t dir, const string& dname, const string& pathname,
+    kfsUid_t euser, kfsGid_t egroup, fid_t& todumpster, int64_t mtime)
+{
+    todumpster = -1;
+    MetaFattr* fa     = 0;
+    MetaFattr* parent = 0;
+    const int  status = lookup(dir, dname, euser, egroup, fa, &parent);
+    if (status != 0) {
+        return status;
+    }
+    if (! fa || ! parent) {
+        panic("rmdir: null file or parent attribute");
+        return -EFAULT;
+    }
+    if (fa->type != KFS_DIR || emptydir(fa->id()) ||
+            dname == kThisDir || dname == kParentDir ||
+            (dir == ROOTFID && (dname == DUMPSTERDIR || dname == "/"))) {
+        return rmdir(dir, dname, pathname, euser, egroup, mtime);
+    }
+    MetaFattr* dumpster = 0;
+    lookup(ROOTFID, DUMPSTERDIR, kKfsUserRoot, kKfsGroupRoot, dumpster);
+    if (dumpster && is_descendant(dumpster->id(), fa->id(), fa)) {
+        // Directory is already in the dumpster.
+        return -EPERM;
+    }
+    if (! parent->CanWrite(euser, egroup)) {
+        return -EACCES;
+    }
+    if (IsDeleteRestricted(parent, fa, euser)) {
+        return -EPERM;
+    }
+    if (! canRemoveSubTree(fa, euser, egroup)) {
+        return -EACCES;
+    }
+    const fid_t id = fa->id();
+    const int   ret = moveToDumpster(dir, dname, id, mtime);
+    if (ret == 0) {
+        todumpster = id;
+        KFS_LOG_STREAM_DEBUG << "moved directory " << pathname <<
+            " " << dname << " to dumpster" <<
+        KFS_LOG_EOM;
+    }
+    return ret;
+}
+
 /*!
  * \brief return attributes for the specified object
  * \param[in] fid   the object's file id
@@ -618,6 +672,24 @@ MetaDentry *
 Tree::getDentry(fid_t dir, const string& fname)
 {
     const KeyData hash = MetaDentry::nameHash(fname);
+    const bool    cacheFlag = mDentryCache.isEnabled();
+    // Concurrent read only requests update neither the cache nor counters.
+    const bool    updateFlag = ! ReadOnlyRequestContext::GetCurrent();
+    if (cacheFlag) {
+        MetaDentry* const de = mDentryCache.find(dir, hash, fname, updateFlag);
+        if (de) {
+            if (updateFlag) {
+                UpdatePathToFidCacheHit(1);
+            }
+            return de;
+        }
+    }
+    // No tree search is needed if no dentry with such name exists, and
+    // interned names can be compared by address.
+    const DentryNames::Name* const name = DentryNames::find(fname);
+    if (! name) {
+        return 0;
+    }
     const Key     key(KFS_DENTRY, dir, hash);
     int           p;
     const Node*   n = findLeaf(key, p);
@@ -626,7 +698,11 @@ Tree::getDentry(fid_t dir, const string& fname)
     }
     while (n && key == n->getkey(p)) {
         MetaDentry* const de = refine<MetaDentry>(n->leaf(p));
-        if (de->getHash() == hash && de->getName() == fname) {
+        if (de->getInternedName() == name) {
+            if (cacheFlag && updateFlag) {
+                UpdatePathToFidCacheMiss(1);
+                mDentryCache.insert(*de);
+            }
             return de;
         }
         if (++p == n->children()) {
@@ -998,36 +1074,11 @@ Tree::lookupPath(fid_t rootdir, const string& path,
     const bool        isabs    = absolute(path);
     const fid_t       cdir     = (rootdir == 0 || isabs) ? ROOTFID : rootdir;
     string::size_type cstart   = isabs ? path.find_first_not_of('/', 1) : 0;
-    bool              usecache =
-        mIsPathToFidCacheEnabled && isabs && cstart == 1;
 
     if (cstart == string::npos) {
         return lookup(cdir, "/", euser, egroup, fa);
     }
 
-    if (usecache) {
-        PathToFidCacheMap::iterator const iter = mPathToFidCache.find(path);
-        if (iter != mPathToFidCache.end()) {
-            // NOTE: We use the fid to extract the fa
-            // and validate that the fa matches. This works because
-            // the fid isn't re-used.  This means that if the
-            // file got deleted and the FA pointer got reused, we
-            // won't find a match for the fid in the tree.
-            // For now do not check access -- path cache should only
-            // be used / enabled for sorter.
-            if (getFattr(iter->second.fid) == iter->second.fa) {
-                UpdatePathToFidCacheHit(1);
-                iter->second.lastAccessTime = TimeNow();
-                KFS_LOG_STREAM_DEBUG << "cache hit for " << path <<
-                    "->" << iter->second.fid <<
-                KFS_LOG_EOM;
-                fa = iter->second.fa;
-                return 0;
-            }
-            mPathToFidCache.erase(iter);
-        }
-    }
-
     fid_t             dir = cdir;
     string            component;
     string::size_type slash ;
@@ -1054,53 +1105,15 @@ Tree::lookupPath(fid_t rootdir, const string& path,
         if (euser != kKfsUserRoot && ! da->CanSearch(euser, egroup)) {
             return -EACCES;
         }
-        usecache = usecache && n == slash + 1 &&
-            component != "." && component != "..";
         cstart = n;
         dir = d->id();
     }
 
     component.assign(path, cstart,
         (slash == string::npos ? path.size() : slash) - cstart);
-    const int status = lookup(dir, component,
+    return lookup(dir, component,
         cdir == dir ? euser  : kKfsUserRoot,
         cdir == dir ? egroup : kKfsGroupRoot, fa);
-    if (usecache && status == 0 && fa) {
-        UpdatePathToFidCacheMiss(1);
-        if (mIsPathToFidCacheEnabled) {
-            PathToFidCacheEntry fce;
-
-            fce.fid = fa->id();
-            fce.fa  = fa;
-            fce.lastAccessTime = TimeNow();
-            mPathToFidCache.insert(make_pair(path, fce));
-        }
-    }
-    return status;
-}
-
-void
-Tree::cleanupPathToFidCache()
-{
-    time_t now = TimeNow();
-
-    if (now - mLastPathToFidCacheCleanupTime <
-            (FID_CACHE_CLEANUP_INTERVAL + 1) / 2) {
-        return;
-    }
-    mLastPathToFidCacheCleanupTime = now;
-    PathToFidCacheMap::iterator iter = mPathToFidCache.begin();
-    while (iter != mPathToFidCache.end()) {
-        if (now <= iter->second.lastAccessTime +
-                FID_CACHE_ENTRY_EXPIRE_INTERVAL) {
-            iter++;
-            continue;
-        }
-        KFS_LOG_STREAM_DEBUG << "Clearing out cache entry: " <<
-            iter->first <<
-        KFS_LOG_EOM;
-        mPathToFidCache.erase(iter++);
-    }
 }
 
 /*
@@ -1519,6 +1532,9 @@ Tree::allocateChunkId(fid_t file, chunkOff_t& offset, chunkId_t* chunkId,
     if (! fa->CanWrite(euser, egroup)) {
         return -EACCES;
     }
+    if (fa->packedFlag || isPackContainer(fa->id())) {
+        return -EPERM;
+    }
     if (numReplicas) {
         *numReplicas = fa->numReplicas;
     }
@@ -1701,16 +1717,23 @@ Tree::coalesceBlocks(MetaFattr* srcFa, MetaFattr* dstFa,
             ! dstFa->CanWrite(euser, egroup)) {
         return -EACCES;
     }
-    if (0 == srcFa->numReplicas || 0 == dstFa->numReplicas) {
+    // The compressed file logical offsets depend on the chunk positions.
+    if (0 == srcFa->numReplicas || 0 == dstFa->numReplicas ||
+            KFS_COMPRESSION_NONE != srcFa->compression ||
+            KFS_COMPRESSION_NONE != dstFa->compression) {
         return -ENOSYS;
     }
+    if (srcFa->packedFlag || dstFa->packedFlag ||
+            isPackContainer(srcFa->id()) || isPackContainer(dstFa->id())) {
+        return -EPERM;
+    }
     // If files are striped, both have to have the same stripe parameters,
     // and the last chunk blocks should be complete.
     if ((srcFa->IsStriped() || dstFa->IsStriped()) && (
             srcFa->striperType != dstFa->striperType ||
             srcFa->numStripes != dstFa->numStripes ||
             srcFa->numRecoveryStripes != dstFa->numRecoveryStripes ||
-            srcFa->stripeSize != dstFa->stripeSize ||
+            srcFa->stripeSize() != dstFa->stripeSize() ||
             (srcFa->chunkcount() > 0 && srcFa->filesize < 0) ||
             (dstFa->chunkcount() > 0 && dstFa->filesize < 0) ||
             (srcFa->ChunkPosToChunkBlkStartPos(
@@ -1853,6 +1876,9 @@ Tree::truncate(fid_t file, chunkOff_t offset, const int64_t* mtime,
     if (fa->filesize == offset) {
         return 0;
     }
+    if (fa->packedFlag || isPackContainer(fa->id())) {
+        return -EPERM;
+    }
     if (0 == fa->numReplicas) {
         if (! setEofHintFlag || 0 <= endOffset ||
                 (0 < offset && fa->nextChunkOffset() <= 0) ||
@@ -1939,6 +1965,110 @@ Tree::truncate(fid_t file, chunkOff_t offset, const int64_t* mtime,
     return 0;
 }
 
+int
+Tree::pack(MetaFattr* fa, MetaFattr* cfa, chunkOff_t offset,
+    chunkOff_t size, fid_t expectedContainer,
+    kfsUid_t euser /* = kKfsUserRoot */, kfsGid_t egroup /* = kKfsGroupRoot */)
+{
+    if (! fa || ! cfa) {
+        return -ENOENT;
+    }
+    if (fa->type != KFS_FILE || cfa->type != KFS_FILE) {
+        return -EISDIR;
+    }
+    if (fa == cfa) {
+        return -EINVAL;
+    }
+    if (! fa->CanWrite(euser, egroup) || ! cfa->CanRead(euser, egroup)) {
+        return -EACCES;
+    }
+    if (0 == fa->numReplicas || 0 == cfa->numReplicas ||
+            fa->IsStriped() || cfa->IsStriped() ||
+            KFS_COMPRESSION_NONE != fa->compression ||
+            KFS_COMPRESSION_NONE != cfa->compression) {
+        return -ENOSYS;
+    }
+    if (cfa->packedFlag || isPackContainer(fa->id())) {
+        return -EINVAL;
+    }
+    PackedExtents::iterator const it = mPackedExtents.find(fa->id());
+    if (expectedContainer < 0 ? fa->packedFlag : (! fa->packedFlag ||
+            it == mPackedExtents.end() ||
+            it->second.container != expectedContainer ||
+            expectedContainer == cfa->id())) {
+        return -EINVAL;
+    }
+    if (fa->filesize < 0 || size != fa->filesize) {
+        return -EINVAL;
+    }
+    if ((chunkOff_t)CHUNKSIZE < size) {
+        return -EFBIG;
+    }
+    if (offset < 0 || cfa->filesize < 0 || cfa->filesize - size < offset) {
+        return -EINVAL;
+    }
+    if (0 < fa->chunkcount()) {
+        StTmp<vector<MetaChunkInfo*> > cinfoTmp(mChunkInfosTmp);
+        vector<MetaChunkInfo*>&        chunkInfo = cinfoTmp.Get();
+        getalloc(fa->id(), chunkInfo);
+        if (gLayoutManager.IsValidLeaseIssued(chunkInfo)) {
+            return -EBUSY;
+        }
+        while (! chunkInfo.empty()) {
+            chunkInfo.back()->DeleteChunk();
+            chunkInfo.pop_back();
+            fa->chunkcount()--;
+            UpdateNumChunks(-1);
+        }
+    }
+    if (fa->packedFlag) {
+        releasePacked(fa);
+    }
+    fa->nextChunkOffset() = 0;
+    return (setPackedExtent(fa, cfa->id(), offset) ? 0 : -EFAULT);
+}
+
+bool
+Tree::setPackedExtent(MetaFattr* fa, fid_t container, chunkOff_t offset)
+{
+    if (! fa || fa->type != KFS_FILE || fa->filesize < 0 ||
+            container < 0 || offset < 0) {
+        return false;
+    }
+    PackedExtent& extent = mPackedExtents[fa->id()];
+    if (fa->packedFlag && 0 <= extent.container) {
+        return false;
+    }
+    extent.container = container;
+    extent.offset    = offset;
+    fa->packedFlag   = 1;
+    PackContainer& pc = mPackContainers[container];
+    pc.refCount++;
+    pc.liveBytes += fa->filesize;
+    return true;
+}
+
+void
+Tree::releasePacked(MetaFattr* fa)
+{
+    PackedExtents::iterator const it = mPackedExtents.find(fa->id());
+    fa->packedFlag = 0;
+    if (it == mPackedExtents.end()) {
+        return;
+    }
+    PackContainers::iterator const ci =
+        mPackContainers.find(it->second.container);
+    mPackedExtents.erase(it);
+    if (ci == mPackContainers.end()) {
+        panic("packed file: invalid container");
+        return;
+    }
+    ci->second.liveBytes -= max(chunkOff_t(0), fa->filesize);
+    if (--ci->second.refCount <= 0) {
+        mPackContainers.erase(ci);
+    }
+}
+
 /*!
  * \brief check whether one directory is a descendant of another
  * \param[in] src file ID of possible ancestor
@@ -2060,10 +2190,6 @@ Tree::rename(fid_t parent, const string& oldname, const string& newname,
         }
     }
 
-    // invalidate the path->fid cache mappings
-    const bool kRemoveDirPrefixFlag = true;
-    invalidatePathCache(oldpath, oldname, sfattr, kRemoveDirPrefixFlag);
-
     sdfattr->mtime = mtime;
     if (t == KFS_DIR && ddfattr) {
         // get rid of the linkage of the "old" ..
@@ -2108,6 +2234,143 @@ Tree::rename(fid_t parent, const string& oldname, const string& newname,
 }
 
 
+static inline bool
+ChangeAttr(MetaFattr& fa, kfsMode_t mode, kfsUid_t user, kfsGid_t group,
+    kfsUid_t euser)
+{
+    if (euser != kKfsUserRoot && fa.user != euser) {
+        return false;
+    }
+    if (mode != kKfsModeUndef) {
+        fa.mode = mode & (fa.type == KFS_DIR ?
+            kfsMode_t(Permissions::kDirModeMask) :
+            kfsMode_t(Permissions::kFileModeMask));
+    }
+    if (user != kKfsUserNone) {
+        fa.user = user;
+    }
+    if (group != kKfsGroupNone) {
+        fa.group = group;
+    }
+    return true;
+}
+
+/*!
+ * \brief Change mode and / or owner of the sub tree entries, in directory
+ * pre-order. Only the entries owned by euser are changed, unless euser is root.
+ * The mode is masked with the file or directory mode mask. At most maxEntries
+ * entries are changed with one invocation, then the cursor is set to the path,
+ * relative to the sub tree root, of the last changed entry. The next
+ * invocation with this cursor resumes the traversal after this entry. The
+ * traversal starts with the sub tree root if the cursor is empty, and the
+ * cursor is cleared once the traversal is complete. The traversal depends
+ * only on the tree state, and is deterministic with log replay.
+ * \param[in] fa   the sub tree root attribute
+ * \param[in/out] cursor  the traversal position
+ * \param[out] count    number of entries traversed
+ * \param[out] failedCount    number of entries not owned by euser
+ * \return      status code (-EAGAIN if the cursor entry no longer exists)
+ */
+int
+Tree::changeSubTreeAttr(MetaFattr* fa, kfsMode_t mode,
+    kfsUid_t user, kfsGid_t group, kfsUid_t euser, size_t maxEntries,
+    string& cursor, size_t& count, size_t& failedCount)
+{
+    const int kMaxReadEntries = 1 << 10;
+    typedef vector<pair<MetaFattr*, string> > Stack;
+    Stack stack;
+    count       = 0;
+    failedCount = 0;
+    if (cursor.empty()) {
+        if (! ChangeAttr(*fa, mode, user, group, euser)) {
+            failedCount++;
+        }
+        count++;
+        if (fa->type == KFS_DIR) {
+            stack.push_back(make_pair(fa, string()));
+        }
+    } else {
+        MetaFattr* dfa   = fa;
+        size_t     start = 0;
+        for (; ;) {
+            if (dfa->type != KFS_DIR) {
+                return -EAGAIN;
+            }
+            const size_t pos  = cursor.find('/', start);
+            const string name = cursor.substr(start,
+                pos == string::npos ? pos : pos - start);
+            if (name.empty() || name == kThisDir || name == kParentDir) {
+                return -EINVAL;
+            }
+            MetaDentry* const de = getDentry(dfa->id(), name);
+            if (! de) {
+                return -EAGAIN;
+            }
+            stack.push_back(make_pair(dfa, name));
+            dfa = de->getFattr();
+            if (pos == string::npos) {
+                break;
+            }
+            start = pos + 1;
+        }
+        if (dfa->type == KFS_DIR) {
+            stack.push_back(make_pair(dfa, string()));
+        }
+    }
+    StTmp<vector<MetaDentry*> > dentriesTmp(mDentriesTmp);
+    vector<MetaDentry*>&        v = dentriesTmp.Get();
+    while (! stack.empty()) {
+        const size_t idx      = stack.size() - 1;
+        const fid_t  dir      = stack[idx].first->id();
+        bool         moreFlag = false;
+        v.clear();
+        if (stack[idx].second.empty()) {
+            readdir(dir, v, kMaxReadEntries, &moreFlag);
+        } else if (readdir(dir, stack[idx].second, v, kMaxReadEntries,
+                moreFlag) != 0) {
+            return -EAGAIN;
+        }
+        bool descendFlag = false;
+        for (vector<MetaDentry*>::const_iterator it = v.begin();
+                it != v.end();
+                ++it) {
+            const string& name = (*it)->getName();
+            if (name == kThisDir || name == kParentDir) {
+                continue;
+            }
+            MetaFattr* const efa = (*it)->getFattr();
+            if (! ChangeAttr(*efa, mode, user, group, euser)) {
+                failedCount++;
+            }
+            stack[idx].second = name;
+            if (efa->type == KFS_DIR) {
+                stack.push_back(make_pair(efa, string()));
+                descendFlag = true;
+            }
+            if (maxEntries <= ++count) {
+                cursor.clear();
+                for (Stack::const_iterator si = stack.begin();
+                        si != stack.end() && ! si->second.empty();
+                        ++si) {
+                    if (si != stack.begin()) {
+                        cursor += '/';
+                    }
+                    cursor += si->second;
+                }
+                return 0;
+            }
+            if (descendFlag) {
+                break;
+            }
+        }
+        if (! descendFlag && ! moreFlag) {
+            stack.pop_back();
+        }
+    }
+    cursor.clear();
+    return 0;
+}
+
 /*!
  * \brief Change the degree of replication for a file.
  * \param[in] dir   file id of the file
@@ -2191,7 +2454,6 @@ Tree::changeFileReplication(MetaFattr* fa, int16_t numReplicas,
 int
 Tree::moveToDumpster(fid_t dir, const string& fname, fid_t todumpster, int64_t mtime)
 {
-    string tempname = "/" + DUMPSTERDIR + "/";
     MetaFattr* fa = 0;
     lookup(ROOTFID, DUMPSTERDIR, kKfsUserRoot, kKfsGroupRoot, fa);
 
@@ -2213,7 +2475,7 @@ Tree::moveToDumpster(fid_t dir, const string& fname, fid_t todumpster, int64_t m
         return -EEXIST;
     }
     // generate a unique name
-    tempname += fname + toString(todumpster);
+    const string tempname = getDumpsterPath(fname, todumpster);
 
     // space accounting has been done before the call to this function.  so,
     // we don't rename to do any accounting and hence pass in "" for the old
@@ -2223,39 +2485,123 @@ Tree::moveToDumpster(fid_t dir, const string& fname, fid_t todumpster, int64_t m
         kKfsUserRoot, kKfsGroupRoot, mtime);
 }
 
-class RemoveDumpsterEntry {
-    const fid_t   dir;
-    const int64_t mtime;
-public:
-    RemoveDumpsterEntry(fid_t d)
-        : dir(d),
-          mtime(microseconds())
-        {}
-    void operator() (MetaDentry *e) {
-        fid_t cnt = -1;
-        metatree.remove(dir, e->getName(), string(), cnt,
-            kKfsUserRoot, kKfsGroupRoot, mtime);
-    }
-};
+string
+Tree::getDumpsterPath(const string& fname, fid_t todumpster)
+{
+    return ("/" + DUMPSTERDIR + "/" + fname + toString(todumpster));
+}
 
 /*!
  * \brief Periodically, cleanup the dumpster and reclaim space.  If
  * the lease issued on a file has expired, then the file can be nuked.
+ * The directory sub trees moved into the dumpster by recursive rmdir are
+ * removed depth first. Busy files in such sub trees are moved to the top of
+ * the dumpster. The work is bounded by maxEntries directory entries and
+ * chunks, zero means no limit. The next invocation resumes the top level
+ * dumpster directory scan after the last entry that was left in place.
+ * \return number of directory entries and chunks processed
  */
-void
-Tree::cleanupDumpster()
+size_t
+Tree::cleanupDumpster(size_t maxEntries)
 {
     MetaFattr* fa = 0;
     lookup(ROOTFID, DUMPSTERDIR, kKfsUserRoot, kKfsGroupRoot, fa);
     if (! fa) {
         // Someone nuked the dumpster
         makeDumpsterDir();
-        return;
+        return 0;
     }
-    const fid_t dir = fa->id();
+    const int     kMaxReadEntries = 1 << 10;
+    const fid_t   dumpster        = fa->id();
+    const int64_t mtime           = microseconds();
+    const size_t  limit           = maxEntries == 0 ? ~size_t(0) : maxEntries;
     StTmp<vector<MetaDentry*> > dentriesTmp(mDentriesTmp);
     vector<MetaDentry*>&        v = dentriesTmp.Get();
-    readdir(dir, v);
-    for_each(v.begin(), v.end(), RemoveDumpsterEntry(dir));
+    MetaFattr*                  dirfa = fa;
+    size_t                      count = 0;
+    string                      topName;
+    string                      name;
+    while (count < limit) {
+        const fid_t dir          = dirfa->id();
+        const int   maxRead      = (int)min(limit - count,
+            size_t(kMaxReadEntries)) + 2;
+        bool        moreFlag     = false;
+        bool        progressFlag = false;
+        v.clear();
+        if (dir == dumpster && ! mDumpsterCleanupCursor.empty()) {
+            if (readdir(dir, mDumpsterCleanupCursor, v, maxRead,
+                    moreFlag) != 0) {
+                // The entry no longer exists, restart from the beginning.
+                mDumpsterCleanupCursor.clear();
+                continue;
+            }
+        } else {
+            readdir(dir, v, maxRead, &moreFlag);
+        }
+        MetaFattr* next = 0;
+        for (vector<MetaDentry*>::const_iterator it = v.begin();
+                it != v.end() && count < limit;
+                ++it) {
+            name = (*it)->getName();
+            if (name == kThisDir || name == kParentDir) {
+                continue;
+            }
+            count++;
+            MetaFattr* const efa = (*it)->getFattr();
+            int              status;
+            if (efa->type == KFS_DIR) {
+                if (! emptydir(efa->id())) {
+                    next = efa;
+                    if (dir == dumpster) {
+                        topName = name;
+                    }
+                    break;
+                }
+                status = rmdir(dir, name, string(),
+                    kKfsUserRoot, kKfsGroupRoot, mtime);
+            } else {
+                count += (size_t)max(int64_t(0), efa->chunkcount());
+                fid_t todumpster = -1;
+                status = remove(dir, name, string(), todumpster,
+                    kKfsUserRoot, kKfsGroupRoot, mtime);
+            }
+            if (status == 0) {
+                progressFlag = true;
+            } else if (dir == dumpster) {
+                // Busy file, resume after it next time.
+                mDumpsterCleanupCursor = name;
+            } else {
+                KFS_LOG_STREAM_ERROR << "dumpster cleanup:"
+                    " dir: "    << dir <<
+                    " name: "   << name <<
+                    " status: " << status <<
+                KFS_LOG_EOM;
+            }
+        }
+        if (next) {
+            dirfa = next;
+            continue;
+        }
+        if (dir == dumpster) {
+            if (moreFlag) {
+                continue;
+            }
+            // The top level scan is complete.
+            mDumpsterCleanupCursor.clear();
+            break;
+        }
+        if (moreFlag && progressFlag) {
+            continue;
+        }
+        if (! progressFlag || ! dirfa->parent) {
+            // Skip the sub tree until the next top level scan, in order to
+            // make progress with the remaining dumpster entries.
+            mDumpsterCleanupCursor = topName;
+            dirfa = fa;
+        } else {
+            dirfa = dirfa->parent;
+        }
+    }
+    return count;
 }
 } // namespace KFS
@@ -26,6 +26,7 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <string.h>
 #include "kfstree.h"
 #include "Checkpoint.h"
 
@@ -47,7 +48,7 @@ void
 Node::addChild(Key *k, MetaNode *child, int pos)
 {
     openHole(pos, 1);
-    childKey[pos] = *k;
+    childKey.set(pos, *k);
     childNode[pos] = child;
 }
 
@@ -69,8 +70,8 @@ void
 Node::moveChildren(Node *dest, int start, int n)
 {
     for (int i = 0; i != n; i++)
-        dest->appendChild(childKey[start + i], childNode[start + i]);
-    childKey[start] = Key(KFS_SENTINEL, 0);
+        dest->appendChild(childKey.get(start + i), childNode[start + i]);
+    childKey.set(start, Key(KFS_SENTINEL, 0));
     childNode[start] = NULL;
 }
 
@@ -119,9 +120,11 @@ Node::openHole(int pos, int skip)
 {
     count += skip;
     assert(count <= NKEY);
-    for (int i = count - 1; i >= pos + skip; --i) {
-        childKey[i] = childKey[i - skip];
-        childNode[i] = childNode[i - skip];
+    const int n = count - pos - skip;
+    if (n > 0) {
+        childKey.move(pos + skip, pos, n);
+        memmove(childNode + pos + skip, childNode + pos,
+            n * sizeof(childNode[0]));
     }
 }
 
@@ -134,11 +137,13 @@ Node::closeHole(int pos, int skip)
 {
     assert(skip < count);
     count -= skip;
-    for (int i = pos; i != count; i++) {
-        childKey[i] = childKey[i + skip];
-        childNode[i] = childNode[i + skip];
+    const int n = count - pos;
+    if (n > 0) {
+        childKey.move(pos, pos + skip, n);
+        memmove(childNode + pos, childNode + pos + skip,
+            n * sizeof(childNode[0]));
     }
-    childKey[count] = Key(KFS_SENTINEL, 0);
+    childKey.set(count, Key(KFS_SENTINEL, 0));
     childNode[count] = NULL;
 }
 
@@ -154,6 +159,49 @@ Node::insertData(Key *k, Meta *item, int pos)
     addChild(k, item, pos);
 }
 
+/*!
+ * \brief append data item to the rightmost leaf node
+ * \param[in] k     the item key
+ * \param[in] item  the item to be inserted
+ * \return  pointer to the new rightmost leaf node if this node is full,
+ *          otherwise NULL
+ *
+ * The rightmost leaf holds the sentinel as its last child.  The item goes
+ * in front of the sentinel.  If the node is full, the item replaces the
+ * sentinel, leaving the node completely packed, and the sentinel moves into
+ * the new rightmost node.
+ */
+Node *
+Node::appendData(Key *k, Meta *item)
+{
+    assert(hasleaves() && next == NULL && count > 0);
+    const int pos = count - 1;
+    if (!isfull()) {
+        addChild(k, item, pos);
+        return NULL;
+    }
+    Key sentinel = childKey.get(pos);
+    MetaNode *s = childNode[pos];
+    placeChild(*k, item, pos);
+    return addPeer(&sentinel, s);
+}
+
+/*!
+ * \brief create new right peer node with a single child.
+ * \param[in] k     the child key
+ * \param[in] child the child node
+ * \return  pointer to newly constructed peer node
+ */
+Node *
+Node::addPeer(Key *k, MetaNode *child)
+{
+    assert(next == NULL);
+    Node *brother = Node::create(flags());
+    brother->appendChild(*k, child);
+    linkToPeer(brother);
+    return brother;
+}
+
 /*
  * This node is absorbed by its left neighbor.
  */
@@ -200,7 +248,7 @@ Node::mergeNeighbor(int pos)
     } else
         return false;
 
-    childKey[base] = childKey[base + 1];
+    childKey.set(base, childKey.get(base + 1));
     childNode[base + 1]->destroy();
     closeHole(base + 1, 1);
 
@@ -216,7 +264,7 @@ Node::insertChildren(Node *dest, int start, int n)
 {
     count -= n;
     for (int i = 0; i != n; i++)
-        dest->placeChild(childKey[start + i], childNode[start + i], i);
+        dest->placeChild(childKey.get(start + i), childNode[start + i], i);
 }
 
 /*
@@ -251,7 +299,7 @@ Node::resetKey(int pos)
 {
     Node *c = child(pos);
     assert(c != NULL);
-    childKey[pos] = c->key();
+    childKey.set(pos, c->key());
 }
 
 /*!
@@ -337,6 +385,65 @@ Tree::insert(Meta *item)
     return 0;
 }
 
+/*!
+ * \brief Append item with the key greater or equal to any key in the tree.
+ * \param item  the item to be inserted
+ * \return  status code
+ *
+ * Bulk load: checkpoint leaves are written in key order, therefore all the
+ * insertions during restore go to the rightmost leaf.  Instead of splitting
+ * full nodes in half on the way down, as insert() does, fill the rightmost
+ * nodes completely and start new rightmost node at each level as needed.
+ * This builds the tree bottom up with all nodes, but the ones on the
+ * rightmost path, packed, and avoids the tree search.  Items that are out of
+ * key order are added with insert().
+ */
+int
+Tree::append(Meta *item)
+{
+    Key mkey = item->key();
+    Node *n = root;
+    Key prev(KFS_UNINIT, 0); //!< largest key in the tree, if any
+    bool hasPrev = false;
+
+    mAppendPath.clear();
+    for (;;) {
+        const int last = n->children() - 1;
+        if (last > 0) {
+            prev = n->getkey(last - 1);
+            hasPrev = true;
+        }
+        if (n->hasleaves())
+            break;
+        mAppendPath.push_back(n);
+        n = n->child(last);
+    }
+    if (hasPrev && mkey < prev)
+        return insert(item);
+
+    Node *brother = n->appendData(&mkey, item);
+    while (brother != NULL) {
+        if (mAppendPath.empty()) {  // this must be the root
+            assert(root == n);
+            pushroot(brother);
+            break;
+        }
+        Node *dad = mAppendPath.back();
+        mAppendPath.pop_back();
+        const int pos = dad->children() - 1;
+        assert(dad->child(pos) == n);
+        dad->resetKey(pos);
+        Key k = brother->key();
+        if (!dad->isfull()) {
+            dad->addChild(&k, brother, pos + 1);
+            break;
+        }
+        brother = dad->addPeer(&k, brother);
+        n = dad;
+    }
+    return 0;
+}
+
 /*
  * If searching carries us into a new level-1 node below, shift the
  * next level of the descent path over by one, repeating as necessary
@@ -374,6 +481,9 @@ Tree::del(Meta *m)
     Node *dad;
     bool removed = false;
 
+    if (m->metaType() == KFS_DENTRY && mDentryCache.isEnabled())
+        mDentryCache.erase(*refine<MetaDentry>(m));
+
     /*
      *  Descend to the appropriate leaf, remembering the
      *  path that we traverse from the root.
@@ -30,6 +30,7 @@
 #define KFS_KFSTREE_H
 
 #include "Key.h"
+#include "KeyArray.h"
 #include "MetaNode.h"
 #include "meta.h"
 #include "common/StdAllocator.h"
@@ -50,9 +51,14 @@ using std::set;
 using std::ostream;
 using std::map;
 using std::less;
+using std::pair;
 
 class Tree;
 
+#if ! defined(KFS_META_TREE_NODE_KEYS)
+#   define KFS_META_TREE_NODE_KEYS 32
+#endif
+
 /*!
  * \brief an internal node in the KFS search tree.
  *
@@ -62,21 +68,24 @@ class Tree;
  * the tree to allow linear traversal.
  */
 class Node: public MetaNode {
-    static const int NKEY = 32;
-    // should size the node to near 4k; 120 gets us there...
-    // static const int NKEY = 120;
+public:
+    // The node fan out can be set at compile time. 120 sizes the node to
+    // near 4k. See devtools/keysearch_main.cc for the key search benchmark.
+    static const int NKEY = KFS_META_TREE_NODE_KEYS;
+private:
     static const int NSPLIT = NKEY / 2;
     static const int NFEWEST = NKEY - NSPLIT;
+    typedef KeyArrayT<NKEY> Keys;
 
     int count;          //!< how many children
-    Key childKey[NKEY];     //!< children's key values
+    Keys childKey;      //!< children's key values
     MetaNode *childNode[NKEY];  //!< and pointers to them
 
     Node *next;         //!< following peer node
 
     void placeChild(Key k, MetaNode *n, int p)
     {
-        childKey[p] = k;
+        childKey.set(p, k);
         childNode[p] = n;
     }
     void appendChild(Key k, MetaNode *n)
@@ -124,11 +133,10 @@ public:
     template<typename MATCH>
     int findplace(const MATCH &test) const
     {
-        const Key* const p = lower_bound(childKey, childKey + count, test);
-        return p - childKey;
+        return childKey.lowerBound(test, count);
     }
     //! \brief rightmost (largest) key in node
-    Key keySelf() const { return childKey[count - 1]; }
+    Key keySelf() const { return childKey.get(count - 1); }
     Node *child(int n) const        //! \brief accessor
     {
         return static_cast <Node *> (childNode[n]);
@@ -137,10 +145,12 @@ public:
     {
         return static_cast <Meta *> (childNode[n]);
     }
-    const Key &getkey(int n) const { return childKey[n]; } //!< accessor
+    Key getkey(int n) const { return childKey.get(n); } //!< accessor
     Node *split(Tree *t, Node *father, int pos);    //!< split full node
     void addChild(Key *k, MetaNode *child, int pos); //!< insert child node
     void insertData(Key *key, Meta *item, int pos); //!< insert data item
+    Node *appendData(Key *key, Meta *item); //!< append data item
+    Node *addPeer(Key *key, MetaNode *child); //!< add new rightmost node
     Node *peer() const { return next; } //!< return adjacent node
     int children() const { return count; } //!< how many children
     bool mergeNeighbor(int pos);        //!< merge underfull nodes
@@ -238,16 +248,134 @@ private:
 typedef MetaIterator<KFS_CHUNKINFO, MetaChunkInfo> ChunkIterator;
 typedef MetaIterator<KFS_DENTRY,    MetaDentry>    DentryIterator;
 
-struct PathToFidCacheEntry
+/*!
+ * \brief bounded directory entry lookup cache.
+ *
+ * Open addressed table keyed by parent directory id and name hash. Lookup
+ * and insert probe a fixed number of adjacent slots; when all probed slots
+ * are in use, insert evicts one of them with CLOCK (second chance) policy.
+ * The cache holds pointers to the directory entries, therefore the tree
+ * must remove the entry from the cache before it deletes the directory entry.
+ * As the key is the parent id, renaming a directory invalidates only the
+ * directory own entry, and not the entries of its descendants.
+ */
+class DentryCache
 {
-    PathToFidCacheEntry()
-        : fid(-1),
-          fa(0),
-          lastAccessTime(0)
+public:
+    DentryCache()
+        : mSlots(0),
+          mMask(0),
+          mHand(0)
         {}
-    fid_t      fid;
-    MetaFattr* fa;
-    time_t     lastAccessTime;
+    ~DentryCache()
+        { delete [] mSlots; }
+    //! set the number of slots, 0 disables the cache
+    void setSize(size_t size)
+    {
+        delete [] mSlots;
+        mSlots = 0;
+        mMask  = 0;
+        if (size <= 0) {
+            return;
+        }
+        size_t sz = 2 * kProbes;
+        while (sz < size) {
+            sz <<= 1;
+        }
+        mSlots = new Slot[sz];
+        mMask  = sz - 1;
+    }
+    bool isEnabled() const
+        { return (mSlots != 0); }
+    //! with refFlag false the lookup does not modify the cache state
+    MetaDentry* find(fid_t dir, KeyData hash, const string& name,
+        bool refFlag = true)
+    {
+        const size_t idx = index(dir, hash);
+        for (size_t i = 0; i < kProbes; i++) {
+            Slot& s = mSlots[(idx + i) & mMask];
+            if (s.dentry && s.dir == dir && s.hash == hash &&
+                    s.dentry->getName() == name) {
+                if (refFlag) {
+                    s.refFlag = true;
+                }
+                return s.dentry;
+            }
+        }
+        return 0;
+    }
+    void insert(MetaDentry& de)
+    {
+        const fid_t   dir  = de.getDir();
+        const KeyData hash = de.getHash();
+        const size_t  idx  = index(dir, hash);
+        Slot*         free = 0;
+        for (size_t i = 0; i < kProbes; i++) {
+            Slot& s = mSlots[(idx + i) & mMask];
+            if (s.dentry == &de) {
+                s.refFlag = true;
+                return;
+            }
+            if (! s.dentry && ! free) {
+                free = &s;
+            }
+        }
+        if (! free) {
+            // Two passes over the probed slots: the first pass clears
+            // the reference flags, unless an unreferenced slot found.
+            for (size_t i = 0; ! free && i < 2 * kProbes; i++) {
+                Slot& s = mSlots[(idx + (mHand++ % kProbes)) & mMask];
+                if (s.refFlag) {
+                    s.refFlag = false;
+                } else {
+                    free = &s;
+                }
+            }
+        }
+        free->dentry  = &de;
+        free->dir     = dir;
+        free->hash    = hash;
+        free->refFlag = false;
+    }
+    void erase(const MetaDentry& de)
+    {
+        const size_t idx = index(de.getDir(), de.getHash());
+        for (size_t i = 0; i < kProbes; i++) {
+            Slot& s = mSlots[(idx + i) & mMask];
+            if (s.dentry == &de) {
+                s = Slot();
+                return;
+            }
+        }
+    }
+private:
+    enum { kProbes = 8 };
+    struct Slot
+    {
+        Slot()
+            : dentry(0),
+              dir(-1),
+              hash(0),
+              refFlag(false)
+            {}
+        MetaDentry* dentry;
+        fid_t       dir;
+        KeyData     hash;
+        bool        refFlag;
+    };
+    Slot*  mSlots;
+    size_t mMask;
+    size_t mHand;
+
+    size_t index(fid_t dir, KeyData hash) const
+    {
+        uint64_t h = (uint64_t)dir * 0x9E3779B97F4A7C15ULL ^ (uint64_t)hash;
+        h ^= h >> 29;
+        return (size_t)h;
+    }
+private:
+    DentryCache(const DentryCache&);
+    DentryCache& operator=(const DentryCache&);
 };
 
 template<typename T>
@@ -294,11 +422,6 @@ protected:
     PathListerT& operator=(const PathListerT&);
 };
 
-//! If a cache entry hasn't been accessed in 600 secs, remove it from cache
-const int FID_CACHE_ENTRY_EXPIRE_INTERVAL = 600;
-//! Once in 10 mins cleanup the cache
-const int FID_CACHE_CLEANUP_INTERVAL = 600;
-
 /*!
  * \brief the KFS search tree.
  *
@@ -315,24 +438,51 @@ class Tree {
         pathlink(Node *nn, int p): n(nn), pos(p) {}
         pathlink(): n(0), pos(-1) { }
     };
-    typedef std::map<
-        string,
-        PathToFidCacheEntry,
-        less<string>,
-        StdAllocator<std::pair<const string, PathToFidCacheEntry> >
-    > PathToFidCacheMap;
-
     bool allowFidToPathConversion;  //!< fid->path translation is enabled?
-    bool mIsPathToFidCacheEnabled; //!< should we enable path->fid cache?
     bool mUpdatePathSpaceUsage;
-    //!< optimize for lookupPath by caching fid's of recently looked up
-    //entries.
-    PathToFidCacheMap mPathToFidCache;
-    time_t mLastPathToFidCacheCleanupTime;
+    //!< optimize lookupPath and lookup by caching recently looked up
+    //directory entries.
+    DentryCache mDentryCache;
     StTmp<vector<MetaChunkInfo*> >::Tmp mChunkInfosTmp;
     StTmp<vector<MetaDentry*> >::Tmp    mDentriesTmp;
+    string        mDumpsterCleanupCursor;
+    vector<Node*> mAppendPath;  //!< rightmost path for append()
     int64_t mFileSystemId;
     int64_t mCrTime;
+    struct PackedExtent
+    {
+        PackedExtent()
+            : container(-1),
+              offset(-1)
+            {}
+        fid_t      container;
+        chunkOff_t offset;
+    };
+    struct PackContainer
+    {
+        PackContainer()
+            : refCount(0),
+              liveBytes(0)
+            {}
+        int64_t    refCount;
+        chunkOff_t liveBytes;
+    };
+    typedef map<
+        fid_t,
+        PackedExtent,
+        less<fid_t>,
+        StdFastAllocator<pair<const fid_t, PackedExtent> >
+    > PackedExtents;
+    typedef map<
+        fid_t,
+        PackContainer,
+        less<fid_t>,
+        StdFastAllocator<pair<const fid_t, PackContainer> >
+    > PackContainers;
+    //!< Only packed files and pack containers have entries. The maps are
+    //!< accessed only by the main thread.
+    PackedExtents  mPackedExtents;
+    PackContainers mPackContainers;
 
 
     template<typename MATCH>
@@ -365,13 +515,22 @@ class Tree {
         kfsUid_t user, kfsGid_t group, kfsMode_t mode,
         MetaFattr* parent, MetaFattr** newFattr, int64_t mtime);
     bool emptydir(fid_t dir);
+    bool canRemoveSubTree(MetaFattr* dirfa, kfsUid_t euser, kfsGid_t egroup);
     bool is_descendant(fid_t src, fid_t dst, const MetaFattr* dstFa);
     void shift_path(vector <pathlink> &path);
     void recomputeDirSize(MetaFattr* dirattr);
     void updateCounts(MetaFattr* fa, chunkOff_t nbytes, int64_t nfiles, int64_t ndirs);
+    struct DentryPartition
+    {
+        size_t index;
+        size_t count;
+        size_t depth;
+        size_t seq;
+    };
     template<typename T>
     void iterateDentriesSelf(
-        T& functor, MetaFattr* parentfa, MetaFattr* curfa, size_t depth)
+        T& functor, MetaFattr* parentfa, MetaFattr* curfa, size_t depth,
+        DentryPartition* part = 0)
     {
         const PartialMatch dkey(KFS_DENTRY, curfa->id());
         int                kp;
@@ -384,13 +543,18 @@ class Tree {
         while ((p = it.parent()) && p->getkey(it.index()) == dkey) {
             MetaDentry* const de = refine<MetaDentry>(it.current());
             MetaFattr*  const fa = getFattr(de);
-            if (fa && fa != parentfa && fa != curfa) {
+            // With partition, the entries above the partition depth are
+            // visited by all partitions, the sub trees at the partition
+            // depth are assigned to the partitions in round robin order.
+            if (fa && fa != parentfa && fa != curfa && (! part ||
+                    depth != part->depth ||
+                    part->seq++ % part->count == part->index)) {
                 if (! functor(*de, *fa, depth)) {
                     return;
                 }
                 if (fa->type == KFS_DIR) {
                     iterateDentriesSelf(
-                        functor, curfa, fa, depth + 1);
+                        functor, curfa, fa, depth + 1, part);
                 }
             }
             it.next();
@@ -400,20 +564,23 @@ class Tree {
         ChunkIterator& cit, MetaChunkInfo*& ci) const;
     void setFileSize(MetaFattr* fa, chunkOff_t size,
         int64_t nfiles, int64_t ndirs);
+    void releasePacked(MetaFattr* fa);
 public:
     Tree()
         : root(0),
           first(0),
           hgt(0),
           allowFidToPathConversion(false),
-          mIsPathToFidCacheEnabled(false),
           mUpdatePathSpaceUsage(false),
-          mPathToFidCache(),
-          mLastPathToFidCacheCleanupTime(0),
+          mDentryCache(),
           mChunkInfosTmp(),
           mDentriesTmp(),
+          mDumpsterCleanupCursor(),
+          mAppendPath(),
           mFileSystemId(-1),
-          mCrTime()
+          mCrTime(),
+          mPackedExtents(),
+          mPackContainers()
     {
         root = Node::create(META_ROOT|META_LEVEL1);
         root->insertData(new Key(KFS_SENTINEL, 0), NULL, 0);
@@ -437,9 +604,10 @@ public:
         return mkdir(ROOTFID, "/", user, group, mode,
             kKfsUserRoot, kKfsGroupRoot, &dummy, 0, 0);
     }
-    void enablePathToFidCache()
+    //!< set the number of the directory entry lookup cache slots
+    void enablePathToFidCache(size_t size = size_t(1) << 16)
     {
-        mIsPathToFidCacheEnabled = true;
+        mDentryCache.setSize(size);
     }
     void setUpdatePathSpaceUsage(bool flag)
     {
@@ -452,6 +620,7 @@ public:
     bool getUpdatePathSpaceUsageFlag() const
         { return mUpdatePathSpaceUsage; }
     int insert(Meta *m);            //!< add data item
+    int append(Meta *m);            //!< add data item in key order
     int del(Meta *m);           //!< remove data item
     Node *getroot() { return root; }    //!< return root node
     Node *firstLeaf() { return first; } //!< leftmost leaf
@@ -480,7 +649,6 @@ public:
     int listPaths(ostream &ofs);    //!< list out the paths in the tree
     //!< list out the paths in the tree for specific fid's
     int listPaths(ostream &ofs, const set<fid_t> specificIds);
-    void cleanupPathToFidCache();
     void recomputeDirSize();        //!< re-compute the size of each dir. in tree
 
     int create(fid_t dir, const string& fname, fid_t *newFid,
@@ -502,6 +670,9 @@ public:
         fid_t* newFid, MetaFattr** newFattr, int64_t mtime);
     int rmdir(fid_t dir, const string& dname, const string& pathname,
         kfsUid_t euser, kfsGid_t egroup, int64_t mtime);
+    int rmdirRecursive(fid_t dir, const string& dname,
+        const string& pathname, kfsUid_t euser, kfsGid_t egroup,
+        fid_t& todumpster, int64_t mtime);
     int readdir(fid_t dir, vector<MetaDentry*>& result,
         int maxEntries = 0, bool* moreEntriesFlag = 0);
     int readdir(fid_t dir, const string& fnameStart, vector<MetaDentry*>& v,
@@ -537,14 +708,58 @@ public:
     }
     int changeFileReplication(MetaFattr *fa, int16_t numReplicas,
         kfsSTier_t minSTier, kfsSTier_t maxSTier);
+    /*
+     * \brief Store small file data as an extent of a shared "container"
+     * file, in order to release the file chunks. The container must be a
+     * closed regular file, that already has the file data at the specified
+     * offset. The packed file becomes read only, and the container can not
+     * be modified or removed while it has packed file extents. Packing an
+     * already packed file moves the file extent into another container,
+     * and is used to compact containers with removed extents.
+     * \param[in] fa  the file attribute
+     * \param[in] cfa the container attribute
+     * \param[in] offset  the file data offset in the container
+     * \param[in] size    the file size, must match the current file size
+     * \param[in] expectedContainer  the current file container; negative
+     *  if the file is not packed
+     * \return      status code
+     */
+    int pack(MetaFattr* fa, MetaFattr* cfa, chunkOff_t offset,
+        chunkOff_t size, fid_t expectedContainer,
+        kfsUid_t euser = kKfsUserRoot, kfsGid_t egroup = kKfsGroupRoot);
+    //!< Checkpoint restore.
+    bool setPackedExtent(MetaFattr* fa, fid_t container, chunkOff_t offset);
+    bool getPackedExtent(const MetaFattr& fa,
+        fid_t& container, chunkOff_t& offset) const
+    {
+        if (! fa.packedFlag) {
+            return false;
+        }
+        PackedExtents::const_iterator const it =
+            mPackedExtents.find(fa.id());
+        if (it == mPackedExtents.end()) {
+            return false;
+        }
+        container = it->second.container;
+        offset    = it->second.offset;
+        return true;
+    }
+    bool isPackContainer(fid_t fid) const
+        { return (mPackContainers.find(fid) != mPackContainers.end()); }
+    size_t getPackedFileCount() const
+        { return mPackedExtents.size(); }
     int changeDirReplication(MetaFattr *dirattr, int16_t numReplicas,
         kfsSTier_t minSTier, kfsSTier_t maxSTier);
     int changePathReplication(fid_t file, int16_t numReplicas,
         kfsSTier_t minSTier, kfsSTier_t maxSTier);
+    int changeSubTreeAttr(MetaFattr* fa, kfsMode_t mode,
+        kfsUid_t user, kfsGid_t group, kfsUid_t euser, size_t maxEntries,
+        string& cursor, size_t& count, size_t& failedCount);
 
     int moveToDumpster(fid_t dir, const string& fname, fid_t todumpster,
         int64_t mtime);
-    void cleanupDumpster();
+    size_t cleanupDumpster(size_t maxEntries);
+    static string getDumpsterPath(const string& fname, fid_t todumpster);
 
     /*!
      * \brief Write-allocation
@@ -646,8 +861,6 @@ public:
      */
     int pruneFromHead(fid_t file, chunkOff_t offset, const int64_t* mtime,
         kfsUid_t euser = kKfsUserRoot, kfsGid_t egroup = kKfsGroupRoot);
-    void invalidatePathCache(const string& pathname, const string& name,
-        const MetaFattr* fa, bool removeDirPrefixFlag = false);
     // PathListerT can be used as argument to build path.
     template<typename T>
     void iterateDentries(T& functor)
@@ -658,6 +871,23 @@ public:
             iterateDentriesSelf(functor, fa, fa, 0);
         }
     }
+    //!< iterate over the sub trees at partitionDepth assigned to partition
+    //!< partitionIdx out of partitionCount, and all entries above it
+    template <typename T>
+    void iterateDentries(T& functor,
+        size_t partitionIdx, size_t partitionCount, size_t partitionDepth)
+    {
+        MetaFattr* fa = 0;
+        lookup(ROOTFID, "/", kKfsUserRoot, kKfsGroupRoot, fa);
+        if (fa) {
+            DentryPartition part;
+            part.index = partitionIdx;
+            part.count = partitionCount;
+            part.depth = partitionDepth;
+            part.seq   = 0;
+            iterateDentriesSelf(functor, fa, fa, 0, &part);
+        }
+    }
     ChunkIterator getAlloc(fid_t fid) const;
     ChunkIterator getAlloc(fid_t fid, MetaFattr*& fa) const;
     DentryIterator readDir(fid_t dir) const;
@@ -43,21 +43,25 @@
 #include "common/MdStream.h"
 
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 
 namespace KFS
 {
 using std::cout;
 using std::cerr;
+using std::max;
 
 static int
-RestoreCheckpoint(const string& lockfn, bool allowEmptyCheckpointFlag)
+RestoreCheckpoint(const string& lockfn, bool allowEmptyCheckpointFlag,
+    int restoreThreadCount)
 {
     if (! lockfn.empty()) {
         acquire_lockfile(lockfn, 10);
     }
     if (! allowEmptyCheckpointFlag || file_exists(LASTCP)) {
         Restorer r;
+        r.setThreadCount(restoreThreadCount);
         return (r.rebuild(LASTCP) ? 0 : -EIO);
     } else {
         return metatree.new_tree();
@@ -75,10 +79,15 @@ LogCompactorMain(int argc, char** argv)
     string  cpdir;
     string  lockFn;
     bool    allowEmptyCheckpointFlag = false;
+    int     restoreThreadCount = 0;
     int     status = 0;
 
-    while ((optchar = getopt(argc, argv, "hpl:c:r:L:e:")) != -1) {
+    while ((optchar = getopt(argc, argv,
+            "hpbl:c:r:L:e:t:w:z:s:B:Z:D:")) != -1) {
         switch (optchar) {
+            case 'b':
+                cp.setWriteBinaryFlag(true);
+                break;
             case 'L':
                 lockFn = optarg;
                 break;
@@ -100,6 +109,28 @@ LogCompactorMain(int argc, char** argv)
             case 'e':
                 allowEmptyCheckpointFlag = atoi(optarg) != 0;
                 break;
+            case 't':
+                restoreThreadCount = atoi(optarg);
+                break;
+            case 'w':
+                cp.setWriteThreadCount(atoi(optarg));
+                break;
+            case 'z':
+                cp.setCompressionLevel(atoi(optarg));
+                break;
+            case 's':
+                cp.setWriteSyncFlag(atoi(optarg) != 0);
+                break;
+            case 'B':
+                cp.setWriteBufferSize((size_t)max(4 << 10, atoi(optarg)));
+                break;
+            case 'Z':
+                cp.setCompressionBlockSize(
+                    (size_t)max(4 << 10, atoi(optarg)));
+                break;
+            case 'D':
+                cp.setDigestName(optarg);
+                break;
             default:
                 status = 1;
                 break;
@@ -113,6 +144,14 @@ LogCompactorMain(int argc, char** argv)
             "[-c <cpdir>]\n"
             "[-r <# of replicas> set replication to this value for all files]\n"
             "[-e {0|1} allow empty checkpoint]\n"
+            "[-b write checkpoint leaf entries in binary format]\n"
+            "[-t <# of checkpoint load parser threads>]\n"
+            "[-w <# of checkpoint write threads>]\n"
+            "[-z <checkpoint zlib compression level 1-9, 0 -- none>]\n"
+            "[-s {0|1} synchronous checkpoint write, default 1]\n"
+            "[-B <checkpoint write buffer size>]\n"
+            "[-Z <checkpoint compression block size>]\n"
+            "[-D <checkpoint digest name, default md5>]\n"
         ;
         return status;
     }
@@ -122,7 +161,8 @@ LogCompactorMain(int argc, char** argv)
 
     logger_setup_paths(logdir);
     checkpointer_setup_paths(cpdir);
-    if ((status = RestoreCheckpoint(lockFn, allowEmptyCheckpointFlag)) == 0) {
+    if ((status = RestoreCheckpoint(
+            lockFn, allowEmptyCheckpointFlag, restoreThreadCount)) == 0) {
         const seq_t lastcp = oplog.checkpointed();
         if ((status = replayer.playLogs()) == 0) {
             metatree.recomputeDirSize();
@@ -0,0 +1,459 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Transaction log replay benchmark. Loads checkpoint, replays the
+// transaction logs, the same way as the log compactor and meta server
+// startup, and reports the replay throughput, in records per second, overall
+// and by log record type. The checkpoint and file system are not modified.
+// Optionally collects sampling cpu profile of the replay with SIGPROF timer,
+// and writes it in the "folded stacks" format, suitable as input for flame
+// graph tools. The function names are resolved with backtrace_symbols(), and
+// therefore only the symbols exported in the dynamic symbol table are
+// resolved, the remaining frames are emitted as addresses, that can be
+// resolved with addr2line.
+//
+//----------------------------------------------------------------------------
+
+#include "kfstree.h"
+#include "Logger.h"
+#include "Checkpoint.h"
+#include "Restorer.h"
+#include "Replay.h"
+#include "util.h"
+#include "common/MsgLogger.h"
+#include "common/MdStream.h"
+#include "qcdio/QCUtils.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <execinfo.h>
+#include <cxxabi.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace KFS
+{
+using std::cout;
+using std::cerr;
+using std::ofstream;
+using std::map;
+using std::vector;
+using std::string;
+using std::sort;
+using std::replace;
+using std::make_pair;
+using std::pair;
+
+static int64_t
+NowNanoSec()
+{
+    struct timespec theTs;
+    clock_gettime(CLOCK_MONOTONIC, &theTs);
+    return ((int64_t)theTs.tv_sec * 1000 * 1000 * 1000 + theTs.tv_nsec);
+}
+
+class ReplayCpuProfiler
+{
+public:
+    enum
+    {
+        kMaxDepth   = 48,
+        kSkipFrames = 2 // Signal handler and signal trampoline.
+    };
+
+    ReplayCpuProfiler(
+        int inMaxSamples)
+        : mMaxSamples(inMaxSamples),
+          mFrames(new void*[(size_t)inMaxSamples * (kMaxDepth + 1)]),
+          mSampleCount(0),
+          mOverflowCount(0)
+        {}
+    ~ReplayCpuProfiler()
+        { delete [] mFrames; }
+    bool Start(
+        int inFrequency)
+    {
+        // Invoke backtrace() once, in order to load and initialize unwinder
+        // outside of the signal handler.
+        void* theFrames[kMaxDepth];
+        backtrace(theFrames, kMaxDepth);
+        sInstancePtr = this;
+        struct sigaction theAction;
+        memset(&theAction, 0, sizeof(theAction));
+        theAction.sa_handler = &ReplayCpuProfiler::Handler;
+        theAction.sa_flags   = SA_RESTART;
+        sigemptyset(&theAction.sa_mask);
+        if (sigaction(SIGPROF, &theAction, 0)) {
+            const int theErr = errno;
+            KFS_LOG_STREAM_ERROR << "sigaction: " <<
+                QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        return SetTimer(1000 * 1000 / inFrequency);
+    }
+    void Stop()
+    {
+        SetTimer(0);
+        signal(SIGPROF, SIG_IGN);
+        sInstancePtr = 0;
+    }
+    int GetSampleCount() const
+        { return mSampleCount; }
+    int GetOverflowCount() const
+        { return mOverflowCount; }
+    bool Write(
+        const char* inFileNamePtr) const
+    {
+        typedef vector<void*>       Stack;
+        typedef map<Stack, int64_t> Stacks;
+        typedef map<void*, string>  Symbols;
+        Stacks theStacks;
+        for (int i = 0; i < mSampleCount; i++) {
+            void* const* const thePtr = mFrames + (size_t)i * (kMaxDepth + 1);
+            const int          theCnt = (int)(intptr_t)thePtr[0];
+            if (theCnt <= kSkipFrames) {
+                continue;
+            }
+            theStacks[Stack(thePtr + 1 + kSkipFrames, thePtr + 1 + theCnt)]++;
+        }
+        Symbols theSymbols;
+        for (Stacks::const_iterator theIt = theStacks.begin();
+                theIt != theStacks.end();
+                ++theIt) {
+            for (Stack::const_iterator theFIt = theIt->first.begin();
+                    theFIt != theIt->first.end();
+                    ++theFIt) {
+                theSymbols.insert(make_pair(*theFIt, string()));
+            }
+        }
+        vector<void*> theAddrs;
+        theAddrs.reserve(theSymbols.size());
+        for (Symbols::const_iterator theIt = theSymbols.begin();
+                theIt != theSymbols.end();
+                ++theIt) {
+            theAddrs.push_back(theIt->first);
+        }
+        char** const theNamesPtr = theAddrs.empty() ? 0 :
+            backtrace_symbols(&theAddrs[0], (int)theAddrs.size());
+        for (size_t i = 0; i < theAddrs.size(); i++) {
+            theSymbols[theAddrs[i]] = GetSymbolName(
+                theAddrs[i], theNamesPtr ? theNamesPtr[i] : 0);
+        }
+        free(theNamesPtr);
+        ofstream theStream(inFileNamePtr);
+        if (! theStream) {
+            const int theErr = errno;
+            KFS_LOG_STREAM_ERROR << inFileNamePtr << ": " <<
+                QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        // Folded stacks: root first, frames separated by semicolon, followed
+        // by space and the sample count.
+        for (Stacks::const_iterator theIt = theStacks.begin();
+                theIt != theStacks.end();
+                ++theIt) {
+            const Stack& theStack = theIt->first;
+            for (Stack::const_reverse_iterator theFIt = theStack.rbegin();
+                    theFIt != theStack.rend();
+                    ++theFIt) {
+                if (theFIt != theStack.rbegin()) {
+                    theStream << ';';
+                }
+                theStream << theSymbols[*theFIt];
+            }
+            theStream << ' ' << theIt->second << '\n';
+        }
+        theStream.close();
+        if (! theStream) {
+            const int theErr = errno;
+            KFS_LOG_STREAM_ERROR << inFileNamePtr << ": " <<
+                QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        return true;
+    }
+private:
+    const int     mMaxSamples;
+    void** const  mFrames;
+    volatile int  mSampleCount;
+    volatile int  mOverflowCount;
+
+    static ReplayCpuProfiler* volatile sInstancePtr;
+
+    static void Handler(
+        int /* inSig */)
+    {
+        ReplayCpuProfiler* const thePtr = sInstancePtr;
+        if (thePtr) {
+            thePtr->Sample();
+        }
+    }
+    void Sample()
+    {
+        if (mMaxSamples <= mSampleCount) {
+            mOverflowCount++;
+            return;
+        }
+        void** const thePtr = mFrames + (size_t)mSampleCount * (kMaxDepth + 1);
+        thePtr[0] = (void*)(intptr_t)backtrace(thePtr + 1, kMaxDepth);
+        mSampleCount++;
+    }
+    static bool SetTimer(
+        int inIntervalUsec)
+    {
+        struct itimerval theTimer;
+        theTimer.it_interval.tv_sec  = inIntervalUsec / (1000 * 1000);
+        theTimer.it_interval.tv_usec = inIntervalUsec % (1000 * 1000);
+        theTimer.it_value = theTimer.it_interval;
+        if (setitimer(ITIMER_PROF, &theTimer, 0)) {
+            const int theErr = errno;
+            KFS_LOG_STREAM_ERROR << "setitimer: " <<
+                QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        return true;
+    }
+    static string GetSymbolName(
+        void*       inAddr,
+        const char* inNamePtr)
+    {
+        // backtrace_symbols() format: binary(mangled+offset) [address]
+        const char* const theStartPtr = inNamePtr ? strchr(inNamePtr, '(') : 0;
+        const char* const theEndPtr   = theStartPtr ?
+            strpbrk(theStartPtr + 1, "+)") : 0;
+        if (! theEndPtr || theEndPtr <= theStartPtr + 1) {
+            char theBuf[32];
+            snprintf(theBuf, sizeof(theBuf), "%p", inAddr);
+            return string(theBuf);
+        }
+        const string theName(theStartPtr + 1, theEndPtr - theStartPtr - 1);
+        int         theStatus    = -1;
+        char* const theDemangled =
+            abi::__cxa_demangle(theName.c_str(), 0, 0, &theStatus);
+        string theRet = (theStatus == 0 && theDemangled) ?
+            string(theDemangled) : theName;
+        free(theDemangled);
+        // Semicolon is the frames separator.
+        replace(theRet.begin(), theRet.end(), ';', ':');
+        return theRet;
+    }
+private:
+    ReplayCpuProfiler(
+        const ReplayCpuProfiler& inProfiler);
+    ReplayCpuProfiler& operator=(
+        const ReplayCpuProfiler& inProfiler);
+};
+
+ReplayCpuProfiler* volatile ReplayCpuProfiler::sInstancePtr = 0;
+
+static bool
+CompareOpStatTime(
+    const pair<string, Replay::OpStat>& inLhs,
+    const pair<string, Replay::OpStat>& inRhs)
+{
+    return (inLhs.second.timeNsec > inRhs.second.timeNsec);
+}
+
+static void
+ReportOpStats(
+    const Replay::OpStats& inStats)
+{
+    vector<pair<string, Replay::OpStat> > theStats(
+        inStats.begin(), inStats.end());
+    sort(theStats.begin(), theStats.end(), &CompareOpStatTime);
+    int64_t theTotalNsec = 0;
+    for (size_t i = 0; i < theStats.size(); i++) {
+        theTotalNsec += theStats[i].second.timeNsec;
+    }
+    for (size_t i = 0; i < theStats.size(); i++) {
+        const Replay::OpStat& theStat = theStats[i].second;
+        cout <<
+            "op=" << theStats[i].first <<
+            " records=" << theStat.count <<
+            " time-sec=" << theStat.timeNsec * 1e-9 <<
+            " time-share=" << (theTotalNsec <= 0 ? 0. :
+                (double)theStat.timeNsec / theTotalNsec) <<
+            " ns-per-record=" << (theStat.count <= 0 ? 0. :
+                (double)theStat.timeNsec / theStat.count) <<
+            " records-per-sec=" << (theStat.timeNsec <= 0 ? 0. :
+                theStat.count * 1e9 / theStat.timeNsec) <<
+        "\n";
+    }
+}
+
+static int
+LogReplayBenchMain(int argc, char** argv)
+{
+    int         optchar;
+    bool        help                     = false;
+    string      logdir;
+    string      cpdir;
+    bool        allowEmptyCheckpointFlag = false;
+    bool        allLogsFlag              = false;
+    bool        opStatsFlag              = true;
+    int         restoreThreadCount       = 0;
+    const char* profileFileNamePtr       = 0;
+    int         profileFrequency         = 100;
+    int         profileMaxSamples        = 1 << 20;
+    int         status                   = 0;
+
+    while ((optchar = getopt(argc, argv, "hl:c:e:t:anP:F:S:")) != -1) {
+        switch (optchar) {
+            case 'l':
+                logdir = optarg;
+                break;
+            case 'c':
+                cpdir = optarg;
+                break;
+            case 'e':
+                allowEmptyCheckpointFlag = atoi(optarg) != 0;
+                break;
+            case 't':
+                restoreThreadCount = atoi(optarg);
+                break;
+            case 'a':
+                allLogsFlag = true;
+                break;
+            case 'n':
+                opStatsFlag = false;
+                break;
+            case 'P':
+                profileFileNamePtr = optarg;
+                break;
+            case 'F':
+                profileFrequency = atoi(optarg);
+                break;
+            case 'S':
+                profileMaxSamples = atoi(optarg);
+                break;
+            case 'h':
+                help = true;
+                break;
+            default:
+                status = 1;
+                break;
+        }
+    }
+    if (! help && status == 0 && profileFileNamePtr &&
+            (profileFrequency <= 0 || 1000 * 1000 < profileFrequency ||
+                profileMaxSamples <= 0)) {
+        status = 1;
+    }
+    if (help || status != 0) {
+        (status ? cerr : cout) << "Usage: " << argv[0] << "\n"
+            "[-l <logdir>]\n"
+            "[-c <cpdir>]\n"
+            "[-e {0|1} allow empty checkpoint]\n"
+            "[-t <# of checkpoint load parser threads>]\n"
+            "[-a replay all logs, including the last one, the default is to\n"
+            "    replay up to the last closed log, like the log compactor]\n"
+            "[-n do not collect per record type stats, in order to measure\n"
+            "    replay throughput without the timing overhead]\n"
+            "[-P <cpu profile output file name>]\n"
+            "[-F <cpu profile sampling frequency hz> default 100]\n"
+            "[-S <max # of cpu profile samples> default 1048576]\n"
+        ;
+        return status;
+    }
+
+    MdStream::Init();
+    MsgLogger::Init(0, MsgLogger::kLogLevelINFO);
+
+    logger_setup_paths(logdir);
+    checkpointer_setup_paths(cpdir);
+    const int64_t theCpStart = NowNanoSec();
+    if (! allowEmptyCheckpointFlag || file_exists(LASTCP)) {
+        Restorer r;
+        r.setThreadCount(restoreThreadCount);
+        status = r.rebuild(LASTCP) ? 0 : -EIO;
+    } else {
+        status = metatree.new_tree();
+    }
+    const int64_t theCpEnd = NowNanoSec();
+    if (status == 0) {
+        cout <<
+            "checkpoint-load-sec=" << (theCpEnd - theCpStart) * 1e-9 <<
+            " checkpoint-seq=" << oplog.checkpointed() <<
+        "\n";
+        Replay::OpStats   opStats;
+        ReplayCpuProfiler profiler(profileFileNamePtr ? profileMaxSamples : 0);
+        if (opStatsFlag) {
+            replayer.setOpStats(&opStats);
+        }
+        const seq_t startSeq = oplog.checkpointed();
+        if (profileFileNamePtr && ! profiler.Start(profileFrequency)) {
+            status = -EINVAL;
+        } else {
+            const int64_t theStart = NowNanoSec();
+            status = allLogsFlag ?
+                replayer.playAllLogs() : replayer.playLogs();
+            const int64_t theEnd = NowNanoSec();
+            if (profileFileNamePtr) {
+                profiler.Stop();
+            }
+            replayer.setOpStats(0);
+            const seq_t   records  = oplog.checkpointed() - startSeq;
+            const int64_t theNsec  = theEnd - theStart;
+            cout <<
+                "replay-status=" << status <<
+                " records=" << records <<
+                " replay-sec=" << theNsec * 1e-9 <<
+                " records-per-sec=" << (theNsec <= 0 ? 0. :
+                    records * 1e9 / theNsec) <<
+                " last-log=" << replayer.logno() <<
+            "\n";
+            ReportOpStats(opStats);
+            if (profileFileNamePtr) {
+                cout <<
+                    "profile-samples=" << profiler.GetSampleCount() <<
+                    " profile-dropped=" << profiler.GetOverflowCount() <<
+                    " profile-file=" << profileFileNamePtr <<
+                "\n";
+                if (! profiler.Write(profileFileNamePtr)) {
+                    status = -EIO;
+                }
+            }
+        }
+    }
+    MdStream::Cleanup();
+    return (status == 0 ? 0 : 1);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    return KFS::LogReplayBenchMain(argc, argv);
+}
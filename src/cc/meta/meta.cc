@@ -27,6 +27,7 @@
 #include "kfstree.h"
 #include "CSMap.h"
 #include "util.h"
+#include "DiskEntry.h"
 
 #include <iostream>
 #include <fstream>
@@ -42,23 +43,64 @@ using std::ostringstream;
 UniqueID fileID(0, ROOTFID);
 UniqueID chunkID(1, ROOTFID);
 
+DentryNames::Table&
+DentryNames::getTable()
+{
+    static Table table;
+    return table;
+}
+
+const DentryNames::Name*
+DentryNames::acquire(const string& name)
+{
+    static const Name kNullName;
+    bool       insertedFlag = false;
+    Name* const ret = getTable().Insert(name, kNullName, insertedFlag);
+    ret->refCount++;
+    return ret;
+}
+
+void
+DentryNames::release(const Name* name)
+{
+    assert(0 < name->refCount);
+    if (--(const_cast<Name*>(name)->refCount) <= 0) {
+        // Erase does not reference the key after deleting the entry.
+        getTable().Erase(name->name);
+    }
+}
+
 inline ostream&
 MetaDentry::showSelf(ostream& os) const
 {
     return (os <<
-    "dentry/name/" << name <<
+    "dentry/name/" << getName() <<
     "/id/"         << id() <<
     "/parent/"     << dir
     );
 }
 
+inline void
+MetaDentry::writeSelf(DEBinaryWriter& w) const
+{
+    w.str("dentry").str("name");
+    const string& name = getName();
+    if (name == "/") {
+        // Same as text: root entry name is two empty components.
+        w.str("").str("");
+    } else {
+        w.str(name);
+    }
+    w.num("id", id()).num("parent", dir);
+}
+
 inline bool
 MetaDentry::matchSelf(const Meta *m) const
 {
     // Try not to fetch name, save 1 dram miss by comparing hash instead.
     return (m->metaType() == KFS_DENTRY &&
         hash == refine<MetaDentry>(m)->hash &&
-        refine<MetaDentry>(m)->compareName(name) == 0);
+        refine<MetaDentry>(m)->name == name);
 }
 
 inline ostream&
@@ -80,7 +122,7 @@ MetaFattr::showSelf(ostream& os) const
             "/striperType/"        << striperType <<
             "/numStripes/"         << numStripes <<
             "/numRecoveryStripes/" << numRecoveryStripes <<
-            "/stripeSize/"         << stripeSize;
+            "/stripeSize/"         << stripeSize();
     }
     os <<
         "/user/"  << user <<
@@ -94,9 +136,55 @@ MetaFattr::showSelf(ostream& os) const
     if (KFS_FILE == type && 0 == numReplicas) {
         os << "/nextChunkOffset/" << nextChunkOffset();
     }
+    if (KFS_FILE == type && KFS_COMPRESSION_NONE != compression) {
+        os << "/compression/" << compression;
+    }
+    fid_t      container;
+    chunkOff_t offset;
+    if (metatree.getPackedExtent(*this, container, offset)) {
+        os <<
+            "/packedContainer/" << container <<
+            "/packedOffset/"    << offset;
+    }
     return os;
 }
 
+inline void
+MetaFattr::writeSelf(DEBinaryWriter& w) const
+{
+    static const char* const fname[] = { "empty", "file", "dir" };
+
+    w.str("fattr").str(fname[type]).
+        num("id",          id()).
+        num("chunkcount",  type == KFS_DIR ? 0 : chunkcount()).
+        num("numReplicas", numReplicas).
+        time("mtime",      mtime).
+        time("ctime",      ctime).
+        time("crtime",     crtime).
+        num("filesize",    filesize);
+    if (IsStriped()) {
+        w.num("striperType",        striperType).
+          num("numStripes",         numStripes).
+          num("numRecoveryStripes", numRecoveryStripes).
+          num("stripeSize",         stripeSize());
+    }
+    w.num("user", user).num("group", group).num("mode", mode);
+    if (minSTier < kKfsSTierMax) {
+        w.num("minTier", minSTier).num("maxTier", maxSTier);
+    }
+    if (KFS_FILE == type && 0 == numReplicas) {
+        w.num("nextChunkOffset", nextChunkOffset());
+    }
+    if (KFS_FILE == type && KFS_COMPRESSION_NONE != compression) {
+        w.num("compression", compression);
+    }
+    fid_t      container;
+    chunkOff_t offset;
+    if (metatree.getPackedExtent(*this, container, offset)) {
+        w.num("packedContainer", container).num("packedOffset", offset);
+    }
+}
+
 void
 MetaChunkInfo::DeleteChunk()
 {
@@ -119,6 +207,36 @@ MetaChunkInfo::showSelf(ostream& os) const
     );
 }
 
+inline void
+MetaChunkInfo::writeSelf(DEBinaryWriter& w) const
+{
+    w.str("chunkinfo").
+        num("fid",          id()).
+        num("chunkid",      chunkId).
+        num("offset",       offset).
+        num("chunkVersion", chunkVersion);
+}
+
+int
+Meta::checkpoint(ostream& file, DEBinaryWriter& writer) const
+{
+    switch (metaType()) {
+        case KFS_FATTR:
+            static_cast<const MetaFattr*>(this)->writeSelf(writer);
+            break;
+        case KFS_CHUNKINFO:
+            static_cast<const MetaChunkInfo*>(this)->writeSelf(writer);
+            break;
+        case KFS_DENTRY:
+            static_cast<const MetaDentry*>(this)->writeSelf(writer);
+            break;
+        default:
+            panic("Meta::checkpoint: invalid node type");
+            return -EINVAL;
+    }
+    return (writer.write(file) ? 0 : -EIO);
+}
+
 void
 MetaNode::destroy()
 {
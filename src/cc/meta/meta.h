@@ -31,6 +31,8 @@
 #include "common/time.h"
 #include "common/hsieh_hash.h"
 #include "common/kfsdecls.h"
+#include "common/LinearHash.h"
+#include "common/PoolAllocator.h"
 
 #include <ostream>
 #include <string>
@@ -63,6 +65,8 @@ public:
     seqid_t id() const { return n; }    //!< return id
 };
 
+class DEBinaryWriter;
+
 /*!
  * \brief base class for data objects (leaf nodes)
  */
@@ -76,6 +80,8 @@ public:
         show(file) << '\n';
         return file.fail() ? -EIO : 0;
     }
+    //!< write binary checkpoint entry
+    int checkpoint(ostream &file, DEBinaryWriter& writer) const;
     //!< Compare for equality
     bool match(const Meta *test) const;
 private:
@@ -100,15 +106,95 @@ refine(const Meta *m)
 
 class MetaFattr;
 
+/*!
+ * \brief Reference counted directory entry name store.
+ *
+ * Identical names, such as "part-00000" in many job output directories, share
+ * a single copy. The names are kept in the hash table nodes allocated from
+ * the pool allocator, thus the dentry name costs one pointer, and identical
+ * names cost neither space, nor allocation during checkpoint restore and
+ * log replay. Interned names can be compared by address. Not thread safe:
+ * the names are acquired and released only by the tree mutations and
+ * restore, while concurrent read only requests can only use find().
+ */
+class DentryNames {
+public:
+    class Name {
+    public:
+        typedef string Key;
+        typedef Name   Val;
+
+        Name(const Key& key, const Val& /* val */)
+            : name(key),
+              refCount(0)
+            {}
+        Name(const Name& other)
+            : name(other.name),
+              refCount(other.refCount)
+            {}
+        const Key& GetKey() const { return name; }
+        Key&       GetKey()       { return name; }
+        const Val& GetVal() const { return *this; }
+        Val&       GetVal()       { return *this; }
+        const string& str() const { return name; }
+    private:
+        string name;
+        size_t refCount;
+
+        Name()
+            : name(),
+              refCount(0)
+            {}
+        friend class DentryNames;
+        Name& operator=(const Name&);
+    };
+    static const Name* acquire(const string& name);
+    static const Name* acquire(const Name* name)
+    {
+        const_cast<Name*>(name)->refCount++;
+        return name;
+    }
+    static void release(const Name* name);
+    //!< returns 0 if no dentry with such name exists
+    static const Name* find(const string& name)
+        { return getTable().Find(name); }
+    static size_t getCount()
+        { return getTable().GetSize(); }
+    static size_t getStorageSize()
+        { return getTable().GetAllocator().GetAllocator().GetStorageSize(); }
+private:
+    struct NameHash {
+        static size_t Hash(const string& name)
+            { return HsiehHash(name.data(), name.size()); }
+    };
+    typedef LinearHash<
+        Name,
+        KeyCompare<string, NameHash>,
+        DynamicArray<
+            SingleLinkedList<Name>*,
+            24 // 2^24 * sizeof(void*) => 128 MB
+        >,
+        PoolAllocatorAdapter<
+            Name,
+            size_t(8)   << 20, // size_t TMinStorageAlloc,
+            size_t(128) << 20, // size_t TMaxStorageAlloc,
+            false              // bool   TForceCleanupFlag
+        >
+    > Table;
+    static Table& getTable();
+};
+
 /*!
  * \brief Directory entry, mapping a file name to a file id
  */
 class MetaDentry: public Meta {
-    fid_t      fid;  //!< id of this item's owner
-    fid_t      dir;  //!< id of parent directory
-    KeyData    hash;
-    MetaFattr* fattr;
-    string     name; //!< name of this entry
+    typedef DentryNames::Name Name;
+
+    fid_t       fid;  //!< id of this item's owner
+    fid_t       dir;  //!< id of parent directory
+    KeyData     hash;
+    MetaFattr*  fattr;
+    const Name* name; //!< name of this entry
 protected:
     MetaDentry(fid_t parent, const string& fname, fid_t myID, MetaFattr* fa)
         : Meta(KFS_DENTRY),
@@ -116,7 +202,7 @@ protected:
           dir(parent),
           hash(nameHash(fname)),
           fattr(fa),
-          name(fname)
+          name(DentryNames::acquire(fname))
           {}
 
     MetaDentry(const MetaDentry *other)
@@ -125,9 +211,9 @@ protected:
           dir(other->dir),
           hash(other->hash),
           fattr(other->fattr),
-          name(other->name)
+          name(DentryNames::acquire(other->name))
           {}
-    ~MetaDentry() {}
+    ~MetaDentry() { DentryNames::release(name); }
 public:
     static inline KeyData nameHash(const string& name)
     {
@@ -156,12 +242,15 @@ public:
     fid_t id() const { return fid; }    //!< return the owner id
     Key keySelf() const { return Key(KFS_DENTRY, dir, hash); }
     inline ostream& showSelf(ostream& os) const;
+    inline void writeSelf(DEBinaryWriter& writer) const;
     //!< accessor that returns the name of this Dentry
-    const string& getName() const { return name; }
+    const string& getName() const { return name->str(); }
+    //!< interned name, see DentryNames::find()
+    const Name* getInternedName() const { return name; }
     fid_t getDir() const { return dir; }
     KeyData getHash() const { return hash; }
     const int compareName(const string& test) const {
-        return name.compare(test);
+        return name->str().compare(test);
     }
     int checkpoint(ostream &file) const;
     bool matchSelf(const Meta *test) const;
@@ -182,16 +271,18 @@ public:
           striperType(KFS_STRIPED_FILE_TYPE_NONE),
           numReplicas(n),
           numRecoveryStripes(0),
+          minSTier(kKfsSTierMax),
           numStripes(0),
-          stripeSize(0),
+          stripeSizeUnits(0),
+          maxSTier(kKfsSTierMax),
+          packedFlag(0),
+          compression(KFS_COMPRESSION_NONE),
           mtime(0),
           ctime(0),
           crtime(0),
           subcount1(0),
           subcount2(0),
-          filesize(0),
-          minSTier(kKfsSTierMax),
-          maxSTier(kKfsSTierMax)
+          filesize(0)
         {}
     BaseFattr(
         FileType  t,
@@ -206,23 +297,37 @@ public:
           striperType(KFS_STRIPED_FILE_TYPE_NONE),
           numReplicas(n),
           numRecoveryStripes(0),
+          minSTier(kKfsSTierMax),
           numStripes(0),
-          stripeSize(0),
+          stripeSizeUnits(0),
+          maxSTier(kKfsSTierMax),
+          packedFlag(0),
+          compression(KFS_COMPRESSION_NONE),
           mtime(mt),
           ctime(ct),
           crtime(crt),
           subcount1(c),
           subcount2(0),
-          filesize(0),
-          minSTier(kKfsSTierMax),
-          maxSTier(kKfsSTierMax)
+          filesize(0)
         {}
+    // The type, striping parameters, and storage tiers are packed into a
+    // single 64 bit word. The stripe size is stored in stripe alignment
+    // units, and storage tiers are validated before assignment. Bit widths
+    // must remain consistent with KFS_MAX_STRIPE_SIZE and kKfsSTierMax.
     FileType        type:2;         //!< file or directory
     StripedFileType striperType:5;
     uint32_t        numReplicas:14; //!< Desired number of replicas for a file
     uint32_t        numRecoveryStripes:KFS_RECOVERY_STRIPE_COUNT_FIELD_BIT_WIDTH;
+    uint32_t        minSTier:4;
     uint32_t        numStripes:KFS_DATA_STRIPE_COUNT_FIELD_BIT_WIDTH;
-    uint32_t        stripeSize:27;
+    uint32_t        stripeSizeUnits:15;
+    uint32_t        maxSTier:4;
+    //!< File data is stored as an extent of a pack container file, see
+    //!< Tree::pack(). Packed file has no chunks.
+    uint32_t        packedFlag:1;
+    //!< Client side block compression codec, the chunks contain compressed
+    //!< blocks, and the file size is the physical size.
+    uint32_t        compression:KFS_COMPRESSION_FIELD_BIT_WIDTH;
     int64_t         mtime; //!< modification time
     int64_t         ctime; //!< attribute change time
     int64_t         crtime; //!< creation time
@@ -236,10 +341,11 @@ public:
     //!< size of file: is only a hint; if we don't have the size, the client will
     //!< compute the size whenever needed.
     chunkOff_t      filesize;
-    kfsSTier_t      minSTier;
-    kfsSTier_t      maxSTier;
 
     fid_t id() const { return fid; }    //!< return the owner id
+    int32_t stripeSize() const {
+        return (int32_t)stripeSizeUnits * KFS_STRIPE_ALIGNMENT;
+    }
     void setReplication(int16_t val) {
         numReplicas = val;
     }
@@ -274,7 +380,7 @@ public:
             striperType        = KFS_STRIPED_FILE_TYPE_NONE;
             numStripes         = 0;
             numRecoveryStripes = 0;
-            stripeSize         = 0;
+            stripeSizeUnits    = 0;
             return true;
         }
         if (! ValidateStripeParameters(t, n, nr, ss)) {
@@ -289,8 +395,8 @@ public:
         if (numRecoveryStripes != (uint32_t)nr) {
             return false;
         }
-        stripeSize = (uint32_t)ss;
-        if (stripeSize != (uint32_t)ss) {
+        stripeSizeUnits = (uint32_t)(ss / KFS_STRIPE_ALIGNMENT);
+        if (stripeSize() != ss) {
             return false;
         }
         return true;
@@ -303,6 +409,12 @@ public:
     const int64_t&    fileCount() const       { return subcount1; }
     chunkOff_t&       dirCount()              { return subcount2; }
     const chunkOff_t& dirCount() const        { return subcount2; }
+    // Packed file extent, set only in the reply copies of the packed file
+    // attributes, as the packed file chunk count is always 0.
+    int64_t&          packedContainer()       { return subcount1; }
+    const int64_t&    packedContainer() const { return subcount1; }
+    chunkOff_t&       packedOffset()          { return subcount2; }
+    const chunkOff_t& packedOffset() const    { return subcount2; }
 };
 
 class MetaUserAndGroup
@@ -412,6 +524,7 @@ public:
     fid_t id() const { return fid; }    //!< return the owner id
     Key keySelf() const { return Key(KFS_FATTR, id()); }
     inline ostream& showSelf(ostream& os) const;
+    inline void writeSelf(DEBinaryWriter& writer) const;
     int checkpoint(ostream &file) const;
     chunkOff_t LastChunkBlkIndex() const {
         return ChunkPosToChunkBlkIndex(nextChunkOffset() - 1);
@@ -447,6 +560,7 @@ public:
     void DeleteChunk();
 
     inline ostream& showSelf(ostream& os) const;
+    inline void writeSelf(DEBinaryWriter& writer) const;
     int checkpoint(ostream &file) const;
     bool matchSelf(const Meta *test) const {
         return (test->metaType() == KFS_CHUNKINFO &&
@@ -55,6 +55,7 @@
 #include <iostream>
 
 #include <sys/resource.h>
+#include <sys/stat.h>
 #include <signal.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -165,9 +166,24 @@ public:
     }
     virtual void Timeout()
     {
+        if (mStandbyFlag) {
+            if (mPromoteFlag) {
+                mPromoteFlag = false;
+                Promote();
+            } else if (mStandbyNextReplayTime <= globalNetManager().Now()) {
+                mStandbyNextReplayTime =
+                    globalNetManager().Now() + mStandbyReplayIntervalSec;
+                TailLogs();
+            }
+        }
         if (mCheckpointFlag) {
             mCheckpointFlag = false;
-            gLayoutManager.DoCheckpoint();
+            if (mStandbyFlag) {
+                KFS_LOG_STREAM_INFO << "standby: checkpoint ignored" <<
+                KFS_LOG_EOM;
+            } else {
+                gLayoutManager.DoCheckpoint();
+            }
         }
         if (mRestartChunkServersFlag) {
             mRestartChunkServersFlag = false;
@@ -198,6 +214,12 @@ private:
           mCheckpointFlag(false),
           mSetParametersFlag(false),
           mRestartChunkServersFlag(false),
+          mStandbyFlag(false),
+          mPromoteFlag(false),
+          mStandbyRollChunkIdSeedFlag(false),
+          mStandbyFsId(0),
+          mStandbyReplayIntervalSec(5),
+          mStandbyNextReplayTime(0),
           mSetParametersCount(0),
           mClientListenerLocation(),
           mChunkServerListenerLocation(),
@@ -210,6 +232,7 @@ private:
           mMaxChunkServersSocketCount(-1),
           mMinReplicasPerFile(1),
           mIsPathToFidCacheEnabled(false),
+          mPathToFidCacheSize(size_t(1) << 16),
           mStartupAbortOnPanicFlag(false),
           mAbortOnPanicFlag(true),
           mLogRotateIntervalSec(600),
@@ -251,6 +274,11 @@ private:
                 errno, "signal(SIGALRM):") << "\n";
             return false;
         }
+        if (signal(SIGUSR2, &MetaServer::Usr2Signal) == SIG_ERR) {
+            cerr << QCUtils::SysError(
+                errno, "signal(SIGUSR2):") << "\n";
+            return false;
+        }
         // Ignore SIGPIPE's that generated when clients break TCP
         // connection.
         //
@@ -280,6 +308,8 @@ private:
         { /* nothing, process tracker does waitpd */ }
     static void AlarmSignal(int)
         { sInstance.mRestartChunkServersFlag = true; }
+    static void Usr2Signal(int)
+        { sInstance.mPromoteFlag = true; }
     static string GetFullPath(string fileName)
     {
         if (! fileName.empty() && fileName[0] == '/') {
@@ -296,6 +326,10 @@ private:
         return (ret + "/" + fileName);
     }
     bool Startup(bool createEmptyFsFlag, bool createEmptyFsIfNoCpExistsFlag);
+    bool StartServicing(bool rollChunkIdSeedFlag, seq_t fsid);
+    void TailLogs();
+    void UpdateStandbyReplayTime();
+    void Promote();
 
     // This is to get settings from the core file.
     string         mFileName;
@@ -304,6 +338,14 @@ private:
     bool           mCheckpointFlag;
     bool           mSetParametersFlag;
     bool           mRestartChunkServersFlag;
+    // Hot standby: tail the transaction log, serve only reads, until
+    // promoted with SIGUSR2.
+    bool           mStandbyFlag;
+    bool           mPromoteFlag;
+    bool           mStandbyRollChunkIdSeedFlag;
+    seq_t          mStandbyFsId;
+    int            mStandbyReplayIntervalSec;
+    time_t         mStandbyNextReplayTime;
     int            mSetParametersCount;
     // Port at which KFS clients connect and send RPCs
     ServerLocation mClientListenerLocation;
@@ -320,6 +362,7 @@ private:
     int            mMaxChunkServersSocketCount;
     int16_t        mMinReplicasPerFile;
     bool           mIsPathToFidCacheEnabled;
+    size_t         mPathToFidCacheSize;
     bool           mStartupAbortOnPanicFlag;
     bool           mAbortOnPanicFlag;
     int            mLogRotateIntervalSec;
@@ -371,6 +414,11 @@ MetaServer::SetParameters(const Properties& props)
             mLogRotateIntervalSec));
 
     logger_set_rotate_interval(mLogRotateIntervalSec);
+    logger_set_parameters(props);
+
+    mStandbyReplayIntervalSec = max(1,
+        props.getValue("metaServer.standby.replayIntervalSec",
+            mStandbyReplayIntervalSec));
 
     string chunkmapDumpDir = props.getValue("metaServer.chunkmapDumpDir", ".");
     setChunkmapDumpDir(chunkmapDumpDir);
@@ -485,8 +533,11 @@ MetaServer::Startup(const Properties& props, bool createEmptyFsFlag)
     // By default, path->fid cache is disabled.
     mIsPathToFidCacheEnabled = props.getValue("metaServer.enablePathToFidCache",
         mIsPathToFidCacheEnabled ? 1 : 0) != 0;
+    mPathToFidCacheSize = props.getValue("metaServer.pathToFidCacheSize",
+        mPathToFidCacheSize);
     KFS_LOG_STREAM_INFO << "path->fid cache " <<
         (mIsPathToFidCacheEnabled ? "enabled" : "disabled") <<
+        " size: " << mPathToFidCacheSize <<
     KFS_LOG_EOM;
     mStartupAbortOnPanicFlag = props.getValue("metaServer.startupAbortOnPanic",
         mStartupAbortOnPanicFlag ? 1 : 0) != 0;
@@ -700,6 +751,8 @@ MetaServer::Startup(bool createEmptyFsFlag, bool createEmptyFsIfNoCpExistsFlag)
         // Init fs id if needed, leave create time 0, restorer will set these
         // unless fsinfo entry doesn't exit.
         Restorer r;
+        r.setThreadCount(mStartupProperties.getValue(
+            "metaServer.checkpoint.restoreThreads", 0));
         status = r.rebuild(LASTCP, mMinReplicasPerFile) ? 0 : -EIO;
         rollChunkIdSeedFlag = true;
     } else {
@@ -726,14 +779,53 @@ MetaServer::Startup(bool createEmptyFsFlag, bool createEmptyFsIfNoCpExistsFlag)
         KFS_LOG_EOM;
         return false;
     }
-    KFS_LOG_STREAM_INFO << "replaying logs" << KFS_LOG_EOM;
-    status = replayer.playAllLogs();
+    mStandbyFlag = ! createEmptyFsFlag &&
+        mStartupProperties.getValue("metaServer.standby", 0) != 0;
+    KFS_LOG_STREAM_INFO << "replaying logs" <<
+        (mStandbyFlag ? " standby" : "") <<
+    KFS_LOG_EOM;
+    if (mStandbyFlag) {
+        // The last log segment might be still written by the primary,
+        // replay only complete segments.
+        bool replayedFlag = false;
+        status = replayer.playCompletedLogs(replayedFlag);
+    } else {
+        status = replayer.playAllLogs();
+    }
     if (status != 0) {
         KFS_LOG_STREAM_FATAL << "log replay failed: " <<
             QCUtils::SysError(-status) <<
         KFS_LOG_EOM;
         return false;
     }
+    // get the sizes of all dirs up-to-date
+    KFS_LOG_STREAM_INFO << "updating space utilization" << KFS_LOG_EOM;
+    metatree.setUpdatePathSpaceUsage(true);
+    metatree.setUpdatePathSpaceUsage(updateSpaceUsageFlag);
+    metatree.enableFidToPathname();
+    if (mIsPathToFidCacheEnabled) {
+        metatree.enablePathToFidCache(mPathToFidCacheSize);
+    }
+    if (mStandbyFlag) {
+        // Defer all tree and log mutations until promotion.
+        setStandbyMode(true);
+        mStandbyRollChunkIdSeedFlag = rollChunkIdSeedFlag;
+        mStandbyFsId                = fsid;
+        mStandbyNextReplayTime =
+            globalNetManager().Now() + mStandbyReplayIntervalSec;
+        UpdateStandbyReplayTime();
+        setAbortOnPanic(mAbortOnPanicFlag);
+        KFS_LOG_STREAM_INFO << "standby:"
+            " log: " << replayer.logno() <<
+        KFS_LOG_EOM;
+        return true;
+    }
+    return StartServicing(rollChunkIdSeedFlag, fsid);
+}
+
+bool
+MetaServer::StartServicing(bool rollChunkIdSeedFlag, seq_t fsid)
+{
     if (rollChunkIdSeedFlag) {
         const int64_t minRollChunkIdSeed = mStartupProperties.getValue(
             "metaServer.rollChunkIdSeed", int64_t(32) << 10);
@@ -743,14 +835,6 @@ MetaServer::Startup(bool createEmptyFsFlag, bool createEmptyFsIfNoCpExistsFlag)
                 minRollChunkIdSeed - max(int64_t(0), replayer.getRollSeeds()));
         }
     }
-    // get the sizes of all dirs up-to-date
-    KFS_LOG_STREAM_INFO << "updating space utilization" << KFS_LOG_EOM;
-    metatree.setUpdatePathSpaceUsage(true);
-    metatree.setUpdatePathSpaceUsage(updateSpaceUsageFlag);
-    metatree.enableFidToPathname();
-    if (mIsPathToFidCacheEnabled) {
-        metatree.enablePathToFidCache();
-    }
     // empty the dumpster dir on startup; if it doesn't exist, create it
     // whatever is in the dumpster needs to be nuked anyway; if we
     // remove all the file entries from that dir, the space for the
@@ -758,6 +842,7 @@ MetaServer::Startup(bool createEmptyFsFlag, bool createEmptyFsIfNoCpExistsFlag)
     // about chunks we don't know and those will nuked due to staleness
     emptyDumpsterDir();
     logger_init(mLogRotateIntervalSec);
+    int status;
     if ((status = checkpointer_init()) != 0) {
         KFS_LOG_STREAM_FATAL << "checkpoint initialization failure: " <<
             QCUtils::SysError(-status) <<
@@ -772,6 +857,79 @@ MetaServer::Startup(bool createEmptyFsFlag, bool createEmptyFsIfNoCpExistsFlag)
     return true;
 }
 
+void
+MetaServer::TailLogs()
+{
+    const int prevLogNum   = replayer.logno();
+    bool      replayedFlag = false;
+    const int status       = replayer.playCompletedLogs(replayedFlag);
+    if (status != 0) {
+        if (replayedFlag) {
+            // The tree is partially updated, and cannot be used.
+            panic("standby: log replay failure", false);
+            return;
+        }
+        KFS_LOG_STREAM_ERROR << "standby: log segment search failure: " <<
+            QCUtils::SysError(-status) <<
+        KFS_LOG_EOM;
+        return;
+    }
+    if (prevLogNum != replayer.logno()) {
+        KFS_LOG_STREAM_INFO << "standby:"
+            " replayed logs: [" << prevLogNum <<
+            ","                 << replayer.logno() << ")" <<
+        KFS_LOG_EOM;
+    }
+    UpdateStandbyReplayTime();
+}
+
+void
+MetaServer::UpdateStandbyReplayTime()
+{
+    // The tree is current as of the last complete segment modification time.
+    // If the next segment that the primary is writing has no records beyond
+    // the header written when the segment was created, then the tree is
+    // current as of now. Log shipping must preserve modification times.
+    const int   logNum = replayer.logno();
+    struct stat st     = {0};
+    if (logNum <= 0 || stat(oplog.logfile(logNum - 1).c_str(), &st) != 0) {
+        setStandbyReplayTime(globalNetManager().Now());
+        return;
+    }
+    const time_t completeTime = st.st_mtime;
+    if (stat(oplog.logfile(logNum).c_str(), &st) == 0 &&
+            st.st_mtime <= completeTime + 1) {
+        setStandbyReplayTime(globalNetManager().Now());
+    } else {
+        setStandbyReplayTime(completeTime);
+    }
+}
+
+void
+MetaServer::Promote()
+{
+    KFS_LOG_STREAM_INFO << "standby: promoting,"
+        " replaying logs starting from: " << replayer.logno() <<
+    KFS_LOG_EOM;
+    const int status = replayer.playAllLogs();
+    if (status != 0) {
+        KFS_LOG_STREAM_FATAL << "log replay failed: " <<
+            QCUtils::SysError(-status) <<
+        KFS_LOG_EOM;
+        panic("standby: promotion log replay failure", false);
+        return;
+    }
+    setStandbyMode(false);
+    mStandbyFlag = false;
+    if (! StartServicing(mStandbyRollChunkIdSeedFlag, mStandbyFsId)) {
+        panic("standby: promotion failure", false);
+        return;
+    }
+    KFS_LOG_STREAM_INFO << "standby: promoted,"
+        " log: " << replayer.logno() <<
+    KFS_LOG_EOM;
+}
+
 }
 
 int
@@ -0,0 +1,191 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Binary audit log decoder. Converts binary audit log records written
+// by the meta server into text, one record per line.
+//
+//----------------------------------------------------------------------------
+
+#include "AuditLog.h"
+#include "MetaRequest.h"
+
+#include <iostream>
+#include <string>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+namespace KFS
+{
+using std::cout;
+using std::cerr;
+using std::ostream;
+using std::string;
+
+static const char*
+GetAuditOpName(
+    int inOp)
+{
+    static const char* const kOpNames[] = {
+#define KfsMakeMetaOpName(name) #name,
+        KfsForEachMetaOpId(KfsMakeMetaOpName)
+#undef KfsMakeMetaOpName
+        0
+    };
+    return ((0 <= inOp && inOp < META_NUM_OPS_COUNT) ?
+        kOpNames[inOp] : "UNKNOWN");
+}
+
+static void
+DecodeRecord(
+    const AuditLogRecord& inRec,
+    bool                  inRawTimeFlag,
+    ostream&              inOs)
+{
+    if (inRawTimeFlag) {
+        inOs << inRec.mTimeUsec;
+    } else {
+        const time_t theTime = (time_t)(inRec.mTimeUsec / 1000000);
+        struct tm    theTm;
+        char         theBuf[64];
+        gmtime_r(&theTime, &theTm);
+        const size_t theLen = strftime(
+            theBuf, sizeof(theBuf), "%Y-%m-%dT%H:%M:%S", &theTm);
+        snprintf(theBuf + theLen, sizeof(theBuf) - theLen, ".%06dZ",
+            (int)(inRec.mTimeUsec % 1000000));
+        inOs << theBuf;
+    }
+    char theAddr[INET6_ADDRSTRLEN];
+    theAddr[0] = 0;
+    if (inRec.mAddrFamily == AuditLogRecord::kAddrFamilyV4) {
+        inet_ntop(AF_INET, inRec.mAddr, theAddr, sizeof(theAddr));
+    } else if (inRec.mAddrFamily == AuditLogRecord::kAddrFamilyV6) {
+        inet_ntop(AF_INET6, inRec.mAddr, theAddr, sizeof(theAddr));
+    }
+    inOs <<
+        " op: "       << GetAuditOpName(inRec.mOp) <<
+        " status: "   << inRec.mStatus <<
+        " usec: "     << inRec.mDurationUsec <<
+        " seq: "      << inRec.mSeq <<
+        " fid: "      << inRec.mFid <<
+        " dir: "      << inRec.mDirFid <<
+        " auth-uid: " << inRec.mAuthUid <<
+        " uid: "      << inRec.mEUser <<
+        " gid: "      << inRec.mEGroup <<
+        " proto: "    << inRec.mClientProtoVers <<
+        " ip: "       << (theAddr[0] ? theAddr : "-") <<
+    "\n";
+}
+
+static bool
+DecodeFile(
+    const char* inFileNamePtr,
+    bool        inRawTimeFlag)
+{
+    const bool  theStdinFlag = strcmp(inFileNamePtr, "-") == 0;
+    FILE* const theFilePtr   = theStdinFlag ?
+        stdin : fopen(inFileNamePtr, "rb");
+    if (! theFilePtr) {
+        cerr << inFileNamePtr << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    bool               theOkFlag = true;
+    AuditLogFileHeader theHeader;
+    if (fread(&theHeader, sizeof(theHeader), 1, theFilePtr) != 1 ||
+            theHeader.mMagic != (uint32_t)AuditLogFileHeader::kMagic) {
+        cerr << inFileNamePtr << ": invalid binary audit log file header\n";
+        theOkFlag = false;
+    } else if (theHeader.mVersion != (uint32_t)AuditLogFileHeader::kVersion ||
+            theHeader.mRecordSize != sizeof(AuditLogRecord)) {
+        cerr << inFileNamePtr << ": unsupported version: " <<
+            theHeader.mVersion << " record size: " <<
+            theHeader.mRecordSize << "\n";
+        theOkFlag = false;
+    } else {
+        AuditLogRecord theRec;
+        size_t         theRead;
+        while ((theRead = fread(&theRec, 1, sizeof(theRec), theFilePtr)) ==
+                sizeof(theRec)) {
+            DecodeRecord(theRec, inRawTimeFlag, cout);
+        }
+        if (0 < theRead) {
+            cerr << inFileNamePtr << ": truncated record ignored\n";
+        }
+        if (ferror(theFilePtr)) {
+            cerr << inFileNamePtr << ": " << strerror(errno) << "\n";
+            theOkFlag = false;
+        }
+    }
+    if (! theStdinFlag) {
+        fclose(theFilePtr);
+    }
+    return theOkFlag;
+}
+
+static int
+AuditDecodeMain(
+    int    inArgCnt,
+    char** inArgsPtr)
+{
+    bool theRawTimeFlag = false;
+    bool theHelpFlag    = false;
+    int  theOpt;
+    while ((theOpt = getopt(inArgCnt, inArgsPtr, "rh")) != -1) {
+        switch (theOpt) {
+            case 'r':
+                theRawTimeFlag = true;
+                break;
+            case 'h':
+                theHelpFlag = true;
+                break;
+            default:
+                theHelpFlag = true;
+                break;
+        }
+    }
+    if (theHelpFlag || inArgCnt <= optind) {
+        cerr <<
+            "Usage: " << inArgsPtr[0] << " [-r] <file> ...\n"
+            " -r -- output time in microseconds since epoch\n"
+            " file name - reads stdin\n"
+        ;
+        return 1;
+    }
+    bool theOkFlag = true;
+    for (int i = optind; i < inArgCnt; i++) {
+        theOkFlag = DecodeFile(inArgsPtr[i], theRawTimeFlag) && theOkFlag;
+    }
+    cout.flush();
+    return (theOkFlag ? 0 : 1);
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+    return KFS::AuditDecodeMain(argc, argv);
+}
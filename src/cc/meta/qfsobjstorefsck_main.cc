@@ -47,9 +47,15 @@
 #include "libclient/KfsNetClient.h"
 #include "libclient/KfsOps.h"
 
+#include "qcdio/QCMutex.h"
+#include "qcdio/QCThread.h"
+#include "qcdio/QCUtils.h"
+
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <vector>
+#include <deque>
 
 #include <boost/static_assert.hpp>
 #include <boost/dynamic_bitset.hpp>
@@ -61,12 +67,242 @@ namespace KFS
 using std::cout;
 using std::cin;
 using std::cerr;
+using std::flush;
 using std::string;
 using std::vector;
+using std::deque;
+using std::ifstream;
+using std::istream;
+using std::pair;
+using std::make_pair;
 using boost::dynamic_bitset;
 
 using namespace client;
 
+// Parsed object store block keys queue, filled by the key readers, and
+// drained by the main thread.
+class KeyQueue
+{
+public:
+    typedef vector<pair<fid_t, seq_t> > Batch;
+
+    KeyQueue()
+        : mMutex(),
+          mCond(),
+          mQueue(),
+          mWritersCnt(0)
+        {}
+    ~KeyQueue()
+    {
+        while (! mQueue.empty()) {
+            delete mQueue.front();
+            mQueue.pop_front();
+        }
+    }
+    void AddWriter()
+    {
+        QCStMutexLocker theLocker(mMutex);
+        mWritersCnt++;
+    }
+    void WriterDone()
+    {
+        QCStMutexLocker theLocker(mMutex);
+        mWritersCnt--;
+        mCond.NotifyAll();
+    }
+    void Put(
+        Batch* inBatchPtr)
+    {
+        QCStMutexLocker theLocker(mMutex);
+        while (kMaxQueuedBatches <= mQueue.size()) {
+            mCond.Wait(mMutex);
+        }
+        mQueue.push_back(inBatchPtr);
+        mCond.NotifyAll();
+    }
+    Batch* Get()
+    {
+        QCStMutexLocker theLocker(mMutex);
+        while (mQueue.empty()) {
+            if (mWritersCnt <= 0) {
+                return 0;
+            }
+            mCond.Wait(mMutex);
+        }
+        Batch* const theRetPtr = mQueue.front();
+        mQueue.pop_front();
+        mCond.NotifyAll();
+        return theRetPtr;
+    }
+private:
+    enum { kMaxQueuedBatches = 64 };
+
+    QCMutex       mMutex;
+    QCCondVar     mCond;
+    deque<Batch*> mQueue;
+    int           mWritersCnt;
+private:
+    KeyQueue(
+        const KeyQueue& inQueue);
+    KeyQueue& operator=(
+        const KeyQueue& inQueue);
+};
+
+// Reads object store block keys, one key per line, from file or standard in,
+// and validates the keys. Each key list is read by its own thread, in order
+// to process the output of parallel object store key prefix listings.
+class KeyReader : public QCRunnable
+{
+public:
+    KeyReader(
+        KeyQueue& inQueue,
+        int64_t   inFileSystemId)
+        : QCRunnable(),
+          mThread(),
+          mQueue(inQueue),
+          mFileSystemId(inFileSystemId),
+          mFileName(),
+          mFile(),
+          mStreamPtr(0),
+          mStatus(0),
+          mKeysCount(0)
+        {}
+    int Start(
+        const char* inFileNamePtr)
+    {
+        mFileName = inFileNamePtr;
+        if (mFileName == "-") {
+            mStreamPtr = &cin;
+        } else {
+            mFile.open(mFileName.c_str());
+            if (! mFile) {
+                mStatus = 0 < errno ? -errno : -EIO;
+                KFS_LOG_STREAM_ERROR << mFileName << ": " <<
+                    QCUtils::SysError(-mStatus) <<
+                KFS_LOG_EOM;
+                return mStatus;
+            }
+            mStreamPtr = &mFile;
+        }
+        mQueue.AddWriter();
+        const int kStackSize = 256 << 10;
+        const int theErr = mThread.TryToStart(this, kStackSize, "KeyReader");
+        if (theErr) {
+            mQueue.WriterDone();
+            KFS_LOG_STREAM_ERROR << QCUtils::SysError(
+                theErr, "failed to start key reader thread") <<
+            KFS_LOG_EOM;
+            mStatus = 0 < theErr ? -theErr : -EIO;
+        }
+        return mStatus;
+    }
+    int Join()
+    {
+        if (mThread.IsStarted()) {
+            mThread.Join();
+        }
+        return mStatus;
+    }
+    int64_t GetKeysCount() const
+        { return mKeysCount; }
+    virtual void Run()
+    {
+        const size_t     kBatchSize = 4 << 10;
+        KeyQueue::Batch* theBatchPtr = 0;
+        string           theExpectedKey;
+        string           theBlockKey;
+        string           theFsIdSuffix;
+        theExpectedKey.reserve(256);
+        theBlockKey.reserve(256);
+        while (getline(*mStreamPtr, theBlockKey)) {
+            KFS_LOG_STREAM_DEBUG <<
+                "key: " << theBlockKey <<
+            KFS_LOG_EOM;
+            const char*       thePtr    = theBlockKey.data();
+            const char* const theEndPtr = thePtr + theBlockKey.size();
+            if (theEndPtr <= thePtr) {
+                continue;
+            }
+            const int kSeparator = '.';
+            thePtr = reinterpret_cast<const char*>(
+                memchr(thePtr, kSeparator, theEndPtr - thePtr));
+            mKeysCount++;
+            fid_t theFid     = -1;
+            seq_t theVersion = 0;
+            if (! thePtr ||
+                    theEndPtr <= ++thePtr ||
+                    ! DecIntParser::Parse(thePtr, theEndPtr - thePtr, theFid) ||
+                    theFid < 0 ||
+                    theEndPtr <= thePtr ||
+                    kSeparator != (0xFF & *thePtr) ||
+                    theEndPtr <= ++thePtr ||
+                    ! DecIntParser::Parse(
+                        thePtr, theEndPtr - thePtr, theVersion) ||
+                    0 <= theVersion ||
+                    theEndPtr <= thePtr ||
+                    kSeparator != (0xFF & *thePtr)) {
+                KFS_LOG_STREAM_ERROR <<
+                    theBlockKey << ": malformed object store block key" <<
+                KFS_LOG_EOM;
+                continue;
+            }
+            theExpectedKey.clear();
+            if (! AppendChunkFileNameOrObjectStoreBlockKey(
+                    theExpectedKey,
+                    mFileSystemId,
+                    theFid,
+                    theFid,
+                    theVersion,
+                    theFsIdSuffix)) {
+                panic("block name generation failure");
+                continue;
+            }
+            if (theExpectedKey != theBlockKey) {
+                KFS_LOG_STREAM_ERROR <<
+                    theBlockKey    << ": invalid object store block key"
+                    " expected: "  << theExpectedKey <<
+                KFS_LOG_EOM;
+                continue;
+            }
+            if (! theBatchPtr) {
+                theBatchPtr = new KeyQueue::Batch();
+                theBatchPtr->reserve(kBatchSize);
+            }
+            theBatchPtr->push_back(make_pair(theFid, theVersion));
+            if (kBatchSize <= theBatchPtr->size()) {
+                mQueue.Put(theBatchPtr);
+                theBatchPtr = 0;
+            }
+        }
+        if (theBatchPtr) {
+            mQueue.Put(theBatchPtr);
+        }
+        if (mStreamPtr->bad()) {
+            KFS_LOG_STREAM_ERROR << mFileName << ": read error" <<
+            KFS_LOG_EOM;
+            mStatus = -EIO;
+        }
+        if (mFile.is_open()) {
+            mFile.close();
+        }
+        mQueue.WriterDone();
+    }
+private:
+    QCThread       mThread;
+    KeyQueue&      mQueue;
+    const int64_t  mFileSystemId;
+    string         mFileName;
+    ifstream       mFile;
+    istream*       mStreamPtr;
+    int            mStatus;
+    int64_t        mKeysCount;
+private:
+    KeyReader(
+        const KeyReader& inReader);
+    KeyReader& operator=(
+        const KeyReader& inReader);
+};
+
 class ObjStoreFsck : public KfsNetClient::OpOwner
 {
 public:
@@ -107,6 +343,8 @@ private:
     int               mError;
     int               mInFlightCnt;
     int               mMaxInFlightCnt;
+    KeyQueue          mKeyQueue;
+    vector<KeyReader*> mKeyReaders;
 
     ObjStoreFsck()
     : OpOwner(),
@@ -127,10 +365,13 @@ private:
       mLostCount(0),
       mError(0),
       mInFlightCnt(0),
-      mMaxInFlightCnt(1 << 10)
+      mMaxInFlightCnt(1 << 10),
+      mKeyQueue(),
+      mKeyReaders()
         { mKfsNetClient.SetAuthContext(&mAuthContext); }
     virtual ~ObjStoreFsck()
     {
+        JoinKeyReaders();
         if (0 != mInFlightCnt) {
             panic("~ObjStoreFsck non 0 in flight count");
         }
@@ -193,7 +434,181 @@ private:
         const string& inPathName)
     {
         mLostCount++;
-        cout << inPathName << "\n";
+        // Flush in order to report lost files as these are found.
+        cout << inPathName << "\n" << flush;
+    }
+    // Object store block key for diagnostic messages, created only if the
+    // message is emitted.
+    class KeyNamer
+    {
+    public:
+        KeyNamer(
+            fid_t   inFid,
+            seq_t   inVersion,
+            int64_t inFsId,
+            string& inKeyBuf,
+            string& inFsIdSuffix)
+            : mFid(inFid),
+              mVersion(inVersion),
+              mFsId(inFsId),
+              mKeyBuf(inKeyBuf),
+              mFsIdSuffix(inFsIdSuffix)
+            {}
+        ostream& Display(
+            ostream& inStream) const
+        {
+            mKeyBuf.clear();
+            AppendChunkFileNameOrObjectStoreBlockKey(
+                mKeyBuf, mFsId, mFid, mFid, mVersion, mFsIdSuffix);
+            return (inStream << mKeyBuf);
+        }
+    private:
+        const fid_t   mFid;
+        const seq_t   mVersion;
+        const int64_t mFsId;
+        string&       mKeyBuf;
+        string&       mFsIdSuffix;
+    };
+    friend ostream& operator<<(
+        ostream&        inStream,
+        const KeyNamer& inNamer)
+        { return inNamer.Display(inStream); }
+    void AddBlock(
+        fid_t               inFid,
+        seq_t               inVersion,
+        int64_t             inFsId,
+        MsgLogger::LogLevel inLogLevelNoFile,
+        string&             ioKeyBuf,
+        string&             ioFsIdSuffix)
+    {
+        const KeyNamer theKey(
+            inFid, inVersion, inFsId, ioKeyBuf, ioFsIdSuffix);
+        MetaFattr* const theFattrPtr = metatree.getFattr(inFid);
+        if (! theFattrPtr) {
+            KFS_LOG_STREAM(inLogLevelNoFile) <<
+                theKey << ": invalid key: no such file" <<
+            KFS_LOG_EOM;
+            return;
+        }
+        if (KFS_FILE != theFattrPtr->type) {
+            KFS_LOG_STREAM_ERROR <<
+                theKey << ": invalid key:"
+                " attribute type: " << theFattrPtr->type <<
+            KFS_LOG_EOM;
+            return;
+        }
+        if (0 != theFattrPtr->numReplicas) {
+            KFS_LOG_STREAM_ERROR <<
+                theKey << ": invalid key:"
+                " replication: " << theFattrPtr->numReplicas <<
+            KFS_LOG_EOM;
+            return;
+        }
+        if (theFattrPtr->filesize <= 0) {
+            KFS_LOG_STREAM_DEBUG <<
+                theKey << ": skipping 0 size file" <<
+            KFS_LOG_EOM;
+            return;
+        }
+        const chunkOff_t thePos = -inVersion - 1 - theFattrPtr->minSTier;
+        if (thePos < 0 || 0 != (thePos % (chunkOff_t)CHUNKSIZE)) {
+            KFS_LOG_STREAM_ERROR <<
+                theKey << ": invalid key:"
+                " position: " << thePos <<
+                " tier: "     << theFattrPtr->minSTier <<
+                " / "         << theFattrPtr->maxSTier <<
+            KFS_LOG_EOM;
+            return;
+        }
+        if (theFattrPtr->nextChunkOffset() < thePos) {
+            KFS_LOG_STREAM(
+                    theFattrPtr->nextChunkOffset() +
+                        (chunkOff_t)CHUNKSIZE < thePos ?
+                    MsgLogger::kLogLevelERROR :
+                    MsgLogger::kLogLevelDEBUG) <<
+                theKey << ": block past last file block"
+                    " position: "   << thePos <<
+                    " last block: " << theFattrPtr->nextChunkOffset()  <<
+            KFS_LOG_EOM;
+            return;
+        }
+        // Chunk count must be 0 for object store files. Use this field to
+        // store bitmap of the blocks that are present in the input. If the
+        // file has more blocks that fits into the chunk count field, then
+        // allocate bit vector and store pointer to it.
+        const size_t theIdx = thePos / CHUNKSIZE;
+        if (HasBitmapSet(*theFattrPtr)) {
+            BlocksBitmap* thePtr = GetBitmapPtr(*theFattrPtr);
+            if (! thePtr) {
+                thePtr = new BlocksBitmap(
+                    1 + theFattrPtr->nextChunkOffset() / CHUNKSIZE);
+                SetBitmapPtr(*theFattrPtr, thePtr);
+            } else if ((*thePtr)[theIdx]) {
+                KFS_LOG_STREAM_DEBUG <<
+                    theKey << ": duplicate input key" <<
+                KFS_LOG_EOM;
+                return;
+            }
+            (*thePtr)[theIdx] = true;
+        } else {
+            const int64_t theBit = int64_t(1) << theIdx;
+            if (0 != (theFattrPtr->chunkcount() & theBit)) {
+                KFS_LOG_STREAM_DEBUG <<
+                    theKey << ": duplicate input key" <<
+                KFS_LOG_EOM;
+                return;
+            }
+            theFattrPtr->chunkcount() |= theBit;
+        }
+    }
+    int ReadKeys(
+        int          inFileCnt,
+        char** const inFileNamesPtr,
+        int64_t      inFsId,
+        int64_t&     outKeysCount)
+    {
+        outKeysCount = 0;
+        int         theStatus = 0;
+        const char* kStdIn    = "-";
+        for (int i = 0; i < max(1, inFileCnt); i++) {
+            KeyReader* const theReaderPtr = new KeyReader(mKeyQueue, inFsId);
+            mKeyReaders.push_back(theReaderPtr);
+            if ((theStatus = theReaderPtr->Start(
+                    0 < inFileCnt ? inFileNamesPtr[i] : kStdIn)) != 0) {
+                break;
+            }
+        }
+        if (0 != theStatus) {
+            // Drain the queue in order to let the started readers finish.
+            KeyQueue::Batch* theBatchPtr;
+            while ((theBatchPtr = mKeyQueue.Get())) {
+                delete theBatchPtr;
+            }
+            JoinKeyReaders(outKeysCount);
+        }
+        return theStatus;
+    }
+    int JoinKeyReaders(
+        int64_t& outKeysCount)
+    {
+        int theStatus = 0;
+        for (vector<KeyReader*>::const_iterator theIt = mKeyReaders.begin();
+                theIt != mKeyReaders.end();
+                ++theIt) {
+            const int theRet = (*theIt)->Join();
+            if (0 == theStatus) {
+                theStatus = theRet;
+            }
+            outKeysCount += (*theIt)->GetKeysCount();
+            delete *theIt;
+        }
+        mKeyReaders.clear();
+        return theStatus;
+    }
+    void JoinKeyReaders()
+    {
+        int64_t theKeysCount = 0;
+        JoinKeyReaders(theKeysCount);
     }
     static int64_t InitialSeq()
     {
@@ -466,11 +881,20 @@ ObjStoreFsck::RunSelf(
             "[-x <max pipelined get info meta ops>] default: 1024\n"
             "[-s <meta server host>]\n"
             "[-p <meta server port>]\n"
+            "[<object store block keys file> ...] default: - standard in\n"
             "\n"
             "Loads checkpoint, replays transaction logs, then"
-            " reads object store block keys from standard in, one key per line,"
+            " reads object store block keys from the key list files, or"
+            " standard in, one key per line,"
             " and outputs \"lost\" file names on standard out (files with keys"
-            " that were not present in standard in), if any."
+            " that were not present in the input), if any."
+            "\n\n"
+            "The key list files are read and validated in parallel, one thread"
+            " per file. The block keys start with url safe base64 encoded"
+            " checksum, therefore the object store listing can be partitioned"
+            " into 64 listings by the first key character, run concurrently,"
+            " and passed to this tool as files or named pipes. Lost files are"
+            " reported as these are found."
             "\n\n"
             "Note that the list of object store block keys must be"
             " more recent than checkpoint, and transaction logs, and valid"
@@ -505,139 +929,27 @@ ObjStoreFsck::RunSelf(
             metatree.enableFidToPathname();
         }
         const int64_t theFileSystemId = metatree.GetFsId();
-        string        theExpectedKey;
         string        theBlockKey;
         string        theFsIdSuffix;
-        theExpectedKey.reserve(256);
-        theBlockKey.reserve(256);
-        int64_t theKeysCount = 0;
-        while (getline(cin, theBlockKey)) {
-            KFS_LOG_STREAM_DEBUG <<
-                "key: " << theBlockKey <<
-            KFS_LOG_EOM;
-            const char*       thePtr    = theBlockKey.data();
-            const char* const theEndPtr = thePtr + theBlockKey.size();
-            if (theEndPtr <= thePtr) {
-                continue;
-            }
-            const int kSeparator = '.';
-            thePtr = reinterpret_cast<const char*>(
-                memchr(thePtr, kSeparator, theEndPtr - thePtr));
-            theKeysCount++;
-            fid_t theFid     = -1;
-            seq_t theVersion = 0;
-            if (! thePtr ||
-                    theEndPtr <= ++thePtr ||
-                    ! DecIntParser::Parse(thePtr, theEndPtr - thePtr, theFid) ||
-                    theFid < 0 ||
-                    theEndPtr <= thePtr ||
-                    kSeparator != (0xFF & *thePtr) ||
-                    theEndPtr <= ++thePtr ||
-                    ! DecIntParser::Parse(
-                        thePtr, theEndPtr - thePtr, theVersion) ||
-                    0 <= theVersion ||
-                    theEndPtr <= thePtr ||
-                    kSeparator != (0xFF & *thePtr)) {
-                KFS_LOG_STREAM_ERROR <<
-                    theBlockKey << ": malformed object store block key" <<
-                KFS_LOG_EOM;
-                continue;
-            }
-            theExpectedKey.clear();
-            if (! AppendChunkFileNameOrObjectStoreBlockKey(
-                    theExpectedKey,
-                    theFileSystemId,
-                    theFid,
-                    theFid,
-                    theVersion,
-                    theFsIdSuffix)) {
-                panic("block name generation failure");
-                continue;
-            }
-            if (theExpectedKey != theBlockKey) {
-                KFS_LOG_STREAM_ERROR <<
-                    theBlockKey    << ": invalid object store block key"
-                    " expected: "  << theExpectedKey <<
-                KFS_LOG_EOM;
-                continue;
-            }
-            MetaFattr* const theFattrPtr = metatree.getFattr(theFid);
-            if (! theFattrPtr) {
-                KFS_LOG_STREAM(theLogLevelNoFile) <<
-                    theBlockKey << ": invalid key: no such file" <<
-                KFS_LOG_EOM;
-                continue;
-            }
-            if (KFS_FILE != theFattrPtr->type) {
-                KFS_LOG_STREAM_ERROR <<
-                    theBlockKey << ": invalid key:"
-                    " attribute type: " << theFattrPtr->type <<
-                KFS_LOG_EOM;
-                continue;
-            }
-            if (0 != theFattrPtr->numReplicas) {
-                KFS_LOG_STREAM_ERROR <<
-                    theBlockKey << ": invalid key:"
-                    " replication: " << theFattrPtr->numReplicas <<
-                KFS_LOG_EOM;
-                continue;
-            }
-            if (theFattrPtr->filesize <= 0) {
-                KFS_LOG_STREAM_DEBUG <<
-                    theBlockKey << ": skipping 0 size file" <<
-                KFS_LOG_EOM;
-                continue;
-            }
-            const chunkOff_t thePos = -theVersion - 1 - theFattrPtr->minSTier;
-            if (thePos < 0 || 0 != (thePos % (chunkOff_t)CHUNKSIZE)) {
-                KFS_LOG_STREAM_ERROR <<
-                    theBlockKey << ": invalid key:"
-                    " position: " << thePos <<
-                    " tier: "     << theFattrPtr->minSTier <<
-                    " / "         << theFattrPtr->maxSTier <<
-                KFS_LOG_EOM;
-                continue;
-            }
-            if (theFattrPtr->nextChunkOffset() < thePos) {
-                KFS_LOG_STREAM(
-                        theFattrPtr->nextChunkOffset() +
-                            (chunkOff_t)CHUNKSIZE < thePos ?
-                        MsgLogger::kLogLevelERROR :
-                        MsgLogger::kLogLevelDEBUG) <<
-                    theBlockKey << ": block past last file block"
-                        " position: "   << thePos <<
-                        " last block: " << theFattrPtr->nextChunkOffset()  <<
-                KFS_LOG_EOM;
-                continue;
-            }
-            // Chunk count must be 0 for object store files. Use this field to
-            // store bitmap of the blocks that are present in the input. If the
-            // file has more blocks that fits into the chunk count field, then
-            // allocate bit vector and store pointer to it.
-            const size_t theIdx = thePos / CHUNKSIZE;
-            if (HasBitmapSet(*theFattrPtr)) {
-                BlocksBitmap* thePtr = GetBitmapPtr(*theFattrPtr);
-                if (! thePtr) {
-                    thePtr = new BlocksBitmap(
-                        1 + theFattrPtr->nextChunkOffset() / CHUNKSIZE);
-                    SetBitmapPtr(*theFattrPtr, thePtr);
-                } else if ((*thePtr)[theIdx]) {
-                    KFS_LOG_STREAM_DEBUG <<
-                        theBlockKey << ": duplicate input key" <<
-                    KFS_LOG_EOM;
-                    continue;
+        int64_t       theKeysCount = 0;
+        theStatus = ReadKeys(inArgCnt - optind, inArgaPtr + optind,
+            theFileSystemId, theKeysCount);
+        if (0 == theStatus) {
+            // Process the keys queued by the readers, the readers only
+            // parse and validate the keys, the file attributes are updated
+            // by this thread.
+            KeyQueue::Batch* theBatchPtr;
+            while ((theBatchPtr = mKeyQueue.Get())) {
+                for (KeyQueue::Batch::const_iterator
+                        theIt = theBatchPtr->begin();
+                        theIt != theBatchPtr->end();
+                        ++theIt) {
+                    AddBlock(theIt->first, theIt->second, theFileSystemId,
+                        theLogLevelNoFile, theBlockKey, theFsIdSuffix);
                 }
-                (*thePtr)[theIdx] = true;
-            } else {
-                const int64_t theBit = int64_t(1) << theIdx;
-                if (0 != (theFattrPtr->chunkcount() & theBit)) {
-                    KFS_LOG_STREAM_DEBUG <<
-                        theBlockKey << ": duplicate input key" <<
-                    KFS_LOG_EOM;
-                    continue;
-                }
-                theFattrPtr->chunkcount() |= theBit;
+                delete theBatchPtr;
             }
+            theStatus = JoinKeyReaders(theKeysCount);
         }
         KFS_LOG_STREAM_INFO
             "read keys: "    << theKeysCount <<
@@ -645,14 +957,16 @@ ObjStoreFsck::RunSelf(
             " files: "       << GetNumFiles() << 
             " directories: " << GetNumDirs() <<
         KFS_LOG_EOM;
-        // Traverse leaf nodes and query the the status for files with missing
-        // blocks.
-        mLeafIter.reset(metatree.firstLeaf(), 0);
-        Next(0);
-        if (0 < mInFlightCnt) {
-            mNetManager.MainLoop();
+        if (0 == theStatus) {
+            // Traverse leaf nodes and query the the status for files with
+            // missing blocks.
+            mLeafIter.reset(metatree.firstLeaf(), 0);
+            Next(0);
+            if (0 < mInFlightCnt) {
+                mNetManager.MainLoop();
+            }
+            theStatus = mError;
         }
-        theStatus = mError;
     }
     if (0 != theStatus) {
         KFS_LOG_STREAM_ERROR <<
@@ -36,12 +36,14 @@
 #include <sys/stat.h>
 #include <sys/uio.h>
 #include <sys/statvfs.h>
+#include <sys/time.h>
 #include <limits.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <dirent.h>
+#include <time.h>
 
 #ifdef QC_OS_NAME_DARWIN
 #include <sys/param.h>
@@ -67,12 +69,25 @@ public:
           mThreadsPtr(0),
           mBuffersPtr(0),
           mRequestsPtr(0),
+          mQueueStatePtr(0),
           mFdPtr(0),
           mFilePendingReqCountPtr(0),
           mIoVecPtr(0),
           mFileInfoPtr(0),
           mPendingReadBlockCount(0),
           mPendingWriteBlockCount(0),
+          mPageCacheHitCount(0),
+          mPageCacheHitByteCount(0),
+          mPageCacheMissCount(0),
+          mPageCacheMissByteCount(0),
+          mWriteBehindSize(0),
+          mElevatorWindowSize(0),
+          mElevatorMaxWait(0),
+          mWriteBehindCount(0),
+          mWriteBehindByteCount(0),
+          mFsyncCount(0),
+          mFsyncTimeMicroSec(0),
+          mFsyncMaxTimeMicroSec(0),
           mPendingCloseHeadPtr(0),
           mPendingCloseTailPtr(0),
           mPendingCount(0),
@@ -92,12 +107,14 @@ public:
           mIoStartObserverPtr(0),
           mRequestProcessorsPtr(0),
           mNextThreadIdx(0),
+          mNextSeq(0),
           mCreateExclusiveFlag(true),
           mRunFlag(false),
           mRequestAffinityFlag(false),
           mSerializeMetaRequestsFlag(true),
+          mPageCacheProbeFlag(true),
           mBarrierFlag(false)
-        {}
+        { SetPriorityClassDefaults(); }
     virtual ~Queue()
         { Queue::Stop(); }
     inline void Done(
@@ -138,7 +155,8 @@ public:
         int            inBufferCount,
         IoCompletion*  inIoCompletionPtr,
         Time           inTimeWaitNanoSec,
-        int64_t        inEofHint);
+        int64_t        inEofHint,
+        PriorityClass  inPriorityClass);
     bool Cancel(
         RequestId inRequestId);
     IoCompletion* CancelOrSetCompletionIfInFlight(
@@ -156,13 +174,88 @@ public:
         outReadBlockCount   = mPendingReadBlockCount;
         outWriteBlockCount  = mPendingWriteBlockCount;
     }
+    void GetPageCacheCounters(
+        int64_t& outHitCount,
+        int64_t& outHitByteCount,
+        int64_t& outMissCount,
+        int64_t& outMissByteCount)
+    {
+        QCStMutexLocker theLocker(mMutex);
+        outHitCount      = mPageCacheHitCount;
+        outHitByteCount  = mPageCacheHitByteCount;
+        outMissCount     = mPageCacheMissCount;
+        outMissByteCount = mPageCacheMissByteCount;
+    }
+    void SetWriteBehindSize(
+        int64_t inSize)
+    {
+        QCStMutexLocker theLocker(mMutex);
+        mWriteBehindSize = Max(int64_t(0), inSize);
+    }
+    void SetElevatorParameters(
+        int     inWindowSize,
+        int64_t inMaxWaitMicroSec)
+    {
+        QCStMutexLocker theLocker(mMutex);
+        mElevatorWindowSize = 1 < inWindowSize ? inWindowSize : 0;
+        mElevatorMaxWait    = Max(int64_t(0), inMaxWaitMicroSec);
+    }
+    void GetSyncCounters(
+        int64_t& outWriteBehindCount,
+        int64_t& outWriteBehindByteCount,
+        int64_t& outFsyncCount,
+        int64_t& outFsyncTimeMicroSec,
+        int64_t& outFsyncMaxTimeMicroSec)
+    {
+        QCStMutexLocker theLocker(mMutex);
+        outWriteBehindCount     = mWriteBehindCount;
+        outWriteBehindByteCount = mWriteBehindByteCount;
+        outFsyncCount           = mFsyncCount;
+        outFsyncTimeMicroSec    = mFsyncTimeMicroSec;
+        outFsyncMaxTimeMicroSec = mFsyncMaxTimeMicroSec;
+    }
+    void SetPriorityClassParameters(
+        PriorityClass inPriorityClass,
+        int           inWeight,
+        int64_t       inDeadlineMicroSec,
+        int           inMaxInFlightCount)
+    {
+        if (inPriorityClass < 0 || kPriorityClassCount <= inPriorityClass) {
+            return;
+        }
+        QCStMutexLocker theLocker(mMutex);
+        PriorityClassInfo& theInfo = mPriorityClasses[inPriorityClass];
+        const bool theWakeupFlag = 0 < theInfo.mMaxInFlightCount &&
+            (inMaxInFlightCount <= 0 ||
+                theInfo.mMaxInFlightCount < inMaxInFlightCount);
+        theInfo.mWeight           =
+            Max(1, Min(int(kPriorityClassMaxWeight), inWeight));
+        theInfo.mDeadline         = Max(int64_t(0), inDeadlineMicroSec);
+        theInfo.mMaxInFlightCount = Max(0, inMaxInFlightCount);
+        if (theWakeupFlag && mRunFlag && ! mBarrierFlag) {
+            NotifyAllWithPending();
+        }
+    }
+    void GetPriorityClassCounters(
+        PriorityClass          inPriorityClass,
+        PriorityClassCounters& outCounters)
+    {
+        if (inPriorityClass < 0 || kPriorityClassCount <= inPriorityClass) {
+            outCounters.Clear();
+            return;
+        }
+        QCStMutexLocker theLocker(mMutex);
+        outCounters = mPriorityClasses[inPriorityClass].mCounters;
+    }
     OpenFileStatus OpenFile(
         const char* inFileNamePtr,
         int64_t     inMaxFileSize,
         bool        inReadOnlyFlag,
         bool        inAllocateFileSpaceFlag,
         bool        inCreateFlag,
-        bool        inBufferedIoFlag);
+        bool        inBufferedIoFlag,
+        bool        inRandomReadHintFlag,
+        const char* inPreallocatedFileNamePtr);
     CloseFileStatus CloseFile(
         FileIdx inFileIdx,
         int64_t inFileSize);
@@ -175,6 +268,9 @@ public:
         Time          inTimeWaitNanoSec);
     Status AllocateFileSpace(
         FileIdx inFileIdx);
+    Status DupFd(
+        FileIdx inFileIdx,
+        int&    outFd);
     EnqueueStatus Rename(
         const char*    inSrcFileNamePtr,
         const char*    inDstFileNamePtr,
@@ -183,7 +279,8 @@ public:
     EnqueueStatus Delete(
         const char*    inFileNamePtr,
         IoCompletion*  inIoCompletionPtr,
-        Time           inTimeWaitNanoSec);
+        Time           inTimeWaitNanoSec,
+        bool           inBackgroundFlag);
     EnqueueStatus GetFsSpaceAvailable(
         const char*    inPathNamePtr,
         IoCompletion*  inIoCompletionPtr,
@@ -199,12 +296,18 @@ public:
         int64_t        inWriteSize,
         IoCompletion*  inIoCompletionPtr,
         Time           inTimeWaitNanoSec);
+    EnqueueStatus Preallocate(
+        const char*    inFileNamePtr,
+        int64_t        inFileSize,
+        IoCompletion*  inIoCompletionPtr,
+        Time           inTimeWaitNanoSec);
     EnqueueStatus EnqueueMeta(
         ReqType        inReqType,
         const char*    inFileName1Ptr,
         const char*    inFileName2Ptr,
         IoCompletion*  inIoCompletionPtr,
-        Time           inTimeWaitNanoSec);
+        Time           inTimeWaitNanoSec,
+        bool           inBackgroundFlag = false);
 
     static bool IsBarrierReqType(
         ReqType inReqType)
@@ -227,7 +330,8 @@ public:
             IsBarrierReqType(inReqType) ||
             inReqType == kReqTypeGetFsAvailable ||
             inReqType == kReqTypeCheckDirReadable ||
-            inReqType == kReqTypeCheckDirWritable
+            inReqType == kReqTypeCheckDirWritable ||
+            inReqType == kReqTypePreallocate
         );
     }
     static bool IsWriteReqType(
@@ -257,12 +361,19 @@ private:
               mBufferCount(0),
               mFileIdx(0),
               mBlockIdx(0),
+              mPriorityClass(kPriorityClassClient),
+              mDispatchedFlag(false),
+              mBackgroundFlag(false),
+              mSeq(0),
+              mQueueIdx(0),
+              mTime(0),
+              mWaitTime(0),
               mIoCompletionPtr(0)
             {}
         ~Request()
             {}
         bool IsBarrier() const
-            { return IsBarrierReqType(mReqType); }
+            { return (! mBackgroundFlag && IsBarrierReqType(mReqType)); }
         bool IsMeta() const
             { return (IsMetaReqType(mReqType)); }
         RequestIdx    mPrevIdx;
@@ -273,8 +384,48 @@ private:
         int           mBufferCount;
         uint64_t      mFileIdx:16;
         uint64_t      mBlockIdx:48;
+        unsigned int  mPriorityClass:2;
+        bool          mDispatchedFlag:1;
+        bool          mBackgroundFlag:1;
+        uint32_t      mSeq;
+        int           mQueueIdx;
+        int64_t       mTime; // Enqueue time, then start time.
+        int64_t       mWaitTime;
         IoCompletion* mIoCompletionPtr;
     };
+    // Weighted fair queueing state of a request queue. Each class has its own
+    // virtual time, advanced by the request size divided by the class weight
+    // when the class request starts. The class with the smallest virtual time
+    // runs next.
+    struct QueueState
+    {
+        QueueState()
+            : mVirtualTime(0),
+              mPendingBarrierCount(0),
+              mElevatorPos(0)
+        {
+            for (int i = 0; i < kPriorityClassCount; i++) {
+                mClassVirtualTime[i] = 0;
+            }
+        }
+        int64_t mVirtualTime;
+        int64_t  mClassVirtualTime[kPriorityClassCount];
+        int      mPendingBarrierCount;
+        uint64_t mElevatorPos; // File index and block past the last read.
+    };
+    struct PriorityClassInfo
+    {
+        PriorityClassInfo()
+            : mWeight(1),
+              mDeadline(0),
+              mMaxInFlightCount(0),
+              mCounters()
+            {}
+        int                   mWeight;
+        int64_t               mDeadline;
+        int                   mMaxInFlightCount;
+        PriorityClassCounters mCounters;
+    };
 
     template <typename T> T static Min(
         T inA,
@@ -426,7 +577,12 @@ private:
               mOpenPendingFlag(false),
               mOpenError(kOpenErrorNone),
               mClosedFlag(false),
+              mBufferedIoFlag(false),
+              mRandomReadHintFlag(false),
+              mPreallocatedFlag(false),
               mCloseFileSize(-1),
+              mWriteBehindStart(-1),
+              mWriteBehindEnd(-1),
               mThreadIdx(0)
             {}
         uint64_t  mLastBlockIdx:48;
@@ -435,7 +591,12 @@ private:
         OpenError mOpenError:2;
         bool      mClosedFlag:1;
         bool      mBufferedIoFlag:1;
+        bool      mRandomReadHintFlag:1;
+        bool      mPreallocatedFlag:1;
         int64_t   mCloseFileSize;
+        // Written byte range, for which write out has not been started yet.
+        int64_t   mWriteBehindStart;
+        int64_t   mWriteBehindEnd;
         int       mThreadIdx;
     };
 
@@ -446,12 +607,25 @@ private:
     IoThread*          mThreadsPtr;
     char**             mBuffersPtr;
     Request*           mRequestsPtr;
+    QueueState*        mQueueStatePtr;
     int*               mFdPtr;
     unsigned int*      mFilePendingReqCountPtr;
     struct iovec*      mIoVecPtr;
     FileInfo*          mFileInfoPtr;
     int64_t            mPendingReadBlockCount;
     int64_t            mPendingWriteBlockCount;
+    int64_t            mPageCacheHitCount;
+    int64_t            mPageCacheHitByteCount;
+    int64_t            mPageCacheMissCount;
+    int64_t            mPageCacheMissByteCount;
+    int64_t            mWriteBehindSize;
+    int                mElevatorWindowSize;
+    int64_t            mElevatorMaxWait;
+    int64_t            mWriteBehindCount;
+    int64_t            mWriteBehindByteCount;
+    int64_t            mFsyncCount;
+    int64_t            mFsyncTimeMicroSec;
+    int64_t            mFsyncMaxTimeMicroSec;
     unsigned int*      mPendingCloseHeadPtr;
     unsigned int*      mPendingCloseTailPtr;
     int                mPendingCount;
@@ -471,10 +645,13 @@ private:
     IoStartObserver*   mIoStartObserverPtr;
     RequestProcessor** mRequestProcessorsPtr;
     int                mNextThreadIdx;
+    uint32_t           mNextSeq;
+    PriorityClassInfo  mPriorityClasses[kPriorityClassCount];
     bool               mCreateExclusiveFlag;
     bool               mRunFlag;
     bool               mRequestAffinityFlag;
     bool               mSerializeMetaRequestsFlag;
+    bool               mPageCacheProbeFlag;
     bool               mBarrierFlag; // New req. can not be processed
                                    // until in flight req. done.
 
@@ -490,6 +667,44 @@ private:
         kFreeFdEnd     = -1,
         kOpenPendingFd = 0x7FFFFFFF
     };
+    enum { kVirtualTimeScale = 1 << 20 };
+
+    static int64_t Now()
+    {
+#if defined(_POSIX_TIMERS) && ! defined(QC_OS_NAME_DARWIN)
+        struct timespec theTime;
+        if (clock_gettime(CLOCK_MONOTONIC, &theTime)) {
+            return 0;
+        }
+        return (int64_t(theTime.tv_sec) * 1000 * 1000 + theTime.tv_nsec / 1000);
+#else
+        struct timeval theTime;
+        if (gettimeofday(&theTime, 0)) {
+            return 0;
+        }
+        return (int64_t(theTime.tv_sec) * 1000 * 1000 + theTime.tv_usec);
+#endif
+    }
+    static bool IsSeqBefore(
+        uint32_t inSeq,
+        uint32_t inOtherSeq)
+        { return (int32_t(inSeq - inOtherSeq) < 0); }
+    void SetPriorityClassDefaults()
+    {
+        for (int i = 0; i < kPriorityClassCount; i++) {
+            mPriorityClasses[i] = PriorityClassInfo();
+        }
+        mPriorityClasses[kPriorityClassClient].mWeight      = 8;
+        mPriorityClasses[kPriorityClassRecovery].mWeight    = 2;
+        mPriorityClasses[kPriorityClassMaintenance].mWeight = 1;
+    }
+    RequestIdx GetQueueHeadIdx(
+        int inQueueIdx,
+        int inPriorityClass) const
+    {
+        return RequestIdx(
+            kIoQueueIdx + inQueueIdx * kPriorityClassCount + inPriorityClass);
+    }
 
     static int GetOpenCommonFlags(
         bool inBufferedIoFlag)
@@ -573,13 +788,41 @@ private:
         { return (mRequestsPtr[inIdx].mNextIdx == inIdx); }
     bool HasPendingReq(
         int inThreadIdx) const
-        { return (! Empty(kIoQueueIdx + inThreadIdx)); }
+    {
+        for (int i = 0; i < kPriorityClassCount; i++) {
+            if (! Empty(GetQueueHeadIdx(inThreadIdx, i))) {
+                return true;
+            }
+        }
+        return false;
+    }
     bool HasPendingNonBarrierReq(
         int inThreadIdx) const
     {
-        const Request* const theReqPtr = Front(kIoQueueIdx + inThreadIdx);
+        const Request* const theReqPtr = OldestFront(inThreadIdx);
         return (theReqPtr && ! theReqPtr->IsBarrier());
     }
+    Request* OldestFront(
+        int inThreadIdx) const
+    {
+        Request* theRetPtr = 0;
+        for (int i = 0; i < kPriorityClassCount; i++) {
+            const RequestIdx theHeadIdx = GetQueueHeadIdx(inThreadIdx, i);
+            const RequestIdx theIdx     = mRequestsPtr[theHeadIdx].mNextIdx;
+            if (theIdx != theHeadIdx && (! theRetPtr ||
+                    IsSeqBefore(mRequestsPtr[theIdx].mSeq, theRetPtr->mSeq))) {
+                theRetPtr = mRequestsPtr + theIdx;
+            }
+        }
+        return theRetPtr;
+    }
+    bool CanStart(
+        int inPriorityClass) const
+    {
+        const PriorityClassInfo& theInfo = mPriorityClasses[inPriorityClass];
+        return (theInfo.mMaxInFlightCount <= 0 ||
+            theInfo.mCounters.mInFlightCount < theInfo.mMaxInFlightCount);
+    }
     int GetReqListSize(
         Request& inReq)
     {
@@ -612,6 +855,9 @@ private:
         inReq.mInFlightFlag    = false;
         inReq.mIoCompletionPtr = 0;
         inReq.mBufferCount     = 0;
+        inReq.mPriorityClass   = kPriorityClassClient;
+        inReq.mDispatchedFlag  = false;
+        inReq.mBackgroundFlag  = false;
         Insert(mRequestsPtr[kFreeQueueIdx], inReq);
         if (mReqWaitersCount > 0) {
             QCASSERT(mFreeCount > 0);
@@ -663,7 +909,23 @@ private:
         int      inThreadIdx)
     {
         Trace("enqueue", inReq);
-        Insert(mRequestsPtr[kIoQueueIdx + inThreadIdx], inReq);
+        const int        theClass   = inReq.mPriorityClass;
+        const RequestIdx theHeadIdx = GetQueueHeadIdx(inThreadIdx, theClass);
+        QueueState&      theState   = mQueueStatePtr[inThreadIdx];
+        if (Empty(theHeadIdx)) {
+            // Do not let idle class accumulate credit.
+            theState.mClassVirtualTime[theClass] = Max(
+                theState.mClassVirtualTime[theClass], theState.mVirtualTime);
+        }
+        if (inReq.IsBarrier()) {
+            theState.mPendingBarrierCount++;
+        }
+        inReq.mSeq            = mNextSeq++;
+        inReq.mQueueIdx       = inThreadIdx;
+        inReq.mTime           = Now();
+        inReq.mDispatchedFlag = false;
+        mPriorityClasses[theClass].mCounters.mPendingCount++;
+        Insert(mRequestsPtr[theHeadIdx], inReq);
         mPendingCount++;
         mFilePendingReqCountPtr[inReq.mFileIdx]++;
         if (inReq.mReqType == kReqTypeRead) {
@@ -676,14 +938,155 @@ private:
         }
     }
     Request* Dequeue(
-        int inThreadIdx)
+        int  inThreadIdx,
+        bool inIgnoreLimitsFlag = false)
     {
-        Request* const theReqPtr = Front(kIoQueueIdx + inThreadIdx);
+        QueueState& theState        = mQueueStatePtr[inThreadIdx];
+        Request*    theReqPtr       = 0;
+        bool        theDeadlineFlag = false;
+        int64_t     theNow          = 0;
+        if (0 < theState.mPendingBarrierCount || inIgnoreLimitsFlag) {
+            // Barrier pending: preserve the order it was enqueued in respect
+            // to the requests of all classes.
+            theReqPtr = OldestFront(inThreadIdx);
+        } else {
+            int64_t theMinDeadline = 0;
+            for (int i = 0; i < kPriorityClassCount; i++) {
+                const int64_t theDeadline = mPriorityClasses[i].mDeadline;
+                if (theDeadline <= 0 || ! CanStart(i)) {
+                    continue;
+                }
+                Request* const thePtr = Front(GetQueueHeadIdx(inThreadIdx, i));
+                if (! thePtr) {
+                    continue;
+                }
+                if (theNow <= 0) {
+                    theNow = Now();
+                }
+                const int64_t theExpires = thePtr->mTime + theDeadline;
+                if (theExpires <= theNow &&
+                        (! theReqPtr || theExpires < theMinDeadline)) {
+                    theReqPtr      = thePtr;
+                    theMinDeadline = theExpires;
+                }
+            }
+            theDeadlineFlag = 0 != theReqPtr;
+            for (int i = 0; ! theDeadlineFlag && i < kPriorityClassCount; i++) {
+                if (! CanStart(i)) {
+                    continue;
+                }
+                Request* const thePtr = Front(GetQueueHeadIdx(inThreadIdx, i));
+                if (thePtr && (! theReqPtr ||
+                        theState.mClassVirtualTime[i] <
+                        theState.mClassVirtualTime[theReqPtr->mPriorityClass])) {
+                    theReqPtr = thePtr;
+                }
+            }
+            if (theReqPtr && ! theDeadlineFlag && 0 < mElevatorWindowSize) {
+                theReqPtr = ElevatorSelect(*theReqPtr, theNow);
+            }
+        }
         if (theReqPtr) {
             RemoveWithSubRequests(*theReqPtr);
+            Started(*theReqPtr, theNow, theDeadlineFlag);
         }
         return theReqPtr;
     }
+    static uint64_t GetElevatorPos(
+        const Request& inReq)
+    {
+        return ((uint64_t(inReq.mFileIdx) << kBlockBitCount) |
+            uint64_t(inReq.mBlockIdx));
+    }
+    // Elevator, or more precisely circular scan: pick the read with the
+    // lowest file position at or after the last read position among the
+    // reads at the front of the class queue, or wrap around to the lowest
+    // position. The scan stops at the first non read request, in order to
+    // preserve the order in respect to the writes and meta requests. The
+    // front request is started as is once its wait time reaches the max.
+    // wait, in order to bound starvation.
+    Request* ElevatorSelect(
+        Request& inFront,
+        int64_t& ioNow)
+    {
+        if (inFront.mReqType != kReqTypeRead) {
+            return &inFront;
+        }
+        if (ioNow <= 0) {
+            ioNow = Now();
+        }
+        if (inFront.mTime + mElevatorMaxWait <= ioNow) {
+            return &inFront;
+        }
+        const uint64_t   theLastPos =
+            mQueueStatePtr[inFront.mQueueIdx].mElevatorPos;
+        const RequestIdx theHeadIdx =
+            GetQueueHeadIdx(inFront.mQueueIdx, inFront.mPriorityClass);
+        Request*         theNextPtr = 0;
+        Request*         theLowPtr  = 0;
+        int              theCount   = 0;
+        for (RequestIdx theIdx = RequestIdx(&inFront - mRequestsPtr);
+                theIdx != theHeadIdx && theCount < mElevatorWindowSize;
+                theIdx = mRequestsPtr[theIdx].mNextIdx) {
+            Request& theReq = mRequestsPtr[theIdx];
+            if (theReq.mReqType == kReqTypeNone) {
+                continue; // Sub request.
+            }
+            if (theReq.mReqType != kReqTypeRead) {
+                break;
+            }
+            theCount++;
+            const uint64_t thePos = GetElevatorPos(theReq);
+            if (theLastPos <= thePos) {
+                if (! theNextPtr || thePos < GetElevatorPos(*theNextPtr)) {
+                    theNextPtr = &theReq;
+                }
+            } else if (! theLowPtr || thePos < GetElevatorPos(*theLowPtr)) {
+                theLowPtr = &theReq;
+            }
+        }
+        return (theNextPtr ? theNextPtr : theLowPtr);
+    }
+    void RemovedFromQueue(
+        Request& inReq)
+    {
+        if (inReq.IsBarrier()) {
+            QueueState& theState = mQueueStatePtr[inReq.mQueueIdx];
+            QCASSERT(0 < theState.mPendingBarrierCount);
+            theState.mPendingBarrierCount--;
+        }
+        mPriorityClasses[inReq.mPriorityClass].mCounters.mPendingCount--;
+    }
+    void Started(
+        Request& inReq,
+        int64_t  inNow,
+        bool     inDeadlineFlag)
+    {
+        RemovedFromQueue(inReq);
+        const int          theClass = inReq.mPriorityClass;
+        PriorityClassInfo& theInfo  = mPriorityClasses[theClass];
+        QueueState&        theState = mQueueStatePtr[inReq.mQueueIdx];
+        int64_t&           theTime  = theState.mClassVirtualTime[theClass];
+        theState.mVirtualTime = Max(theState.mVirtualTime, theTime);
+        theTime += int64_t(Max(1, inReq.mBufferCount)) *
+            (kVirtualTimeScale / theInfo.mWeight);
+        const int64_t theNow = 0 < inNow ? inNow : Now();
+        PriorityClassCounters& theCounters = theInfo.mCounters;
+        theCounters.mInFlightCount++;
+        theCounters.mRequestCount++;
+        theCounters.mBlockCount       += inReq.mBufferCount;
+        inReq.mWaitTime = Max(int64_t(0), theNow - inReq.mTime);
+        theCounters.mWaitTimeMicroSec += inReq.mWaitTime;
+        if (inDeadlineFlag) {
+            theCounters.mDeadlineCount++;
+        }
+        inReq.mTime           = theNow;
+        inReq.mDispatchedFlag = true;
+        if (inReq.mReqType == kReqTypeRead) {
+            theState.mElevatorPos = GetElevatorPos(inReq) +
+                uint64_t(Max(1, inReq.mBufferCount));
+        }
+    }
     void RemoveWithSubRequests(
         Request& inReq)
     {
@@ -713,6 +1116,9 @@ private:
             return false; // Not in flight, or in the queue.
         }
         Trace("cancel", inReq);
+        if (! inReq.mDispatchedFlag) {
+            RemovedFromQueue(inReq);
+        }
         RemoveWithSubRequests(inReq);
         RequestComplete(inReq, kErrorCancel, 0, 0);
         return true;
@@ -752,6 +1158,24 @@ private:
         } else if (IsWriteReqType(inReq.mReqType)) {
             mPendingWriteBlockCount -= inReq.mBufferCount;
         }
+        int64_t theWaitTime = 0;
+        int64_t theIoTime   = 0;
+        if (inReq.mDispatchedFlag) {
+            inReq.mDispatchedFlag = false;
+            PriorityClassInfo& theInfo = mPriorityClasses[inReq.mPriorityClass];
+            PriorityClassCounters& theCounters = theInfo.mCounters;
+            theWaitTime = inReq.mWaitTime;
+            theIoTime   = Max(int64_t(0), Now() - inReq.mTime);
+            theCounters.mIoTimeMicroSec += theIoTime;
+            const bool theWakeupFlag = 0 < theInfo.mMaxInFlightCount &&
+                theInfo.mMaxInFlightCount <= theCounters.mInFlightCount;
+            theCounters.mInFlightCount--;
+            if (theWakeupFlag && mRunFlag && ! mBarrierFlag) {
+                // Class in flight limit prevented other threads from
+                // starting requests.
+                NotifyAllWithPending();
+            }
+        }
         BlockIdx theBlockIdx;
         if (inReq.IsMeta()) {
             // The first "buffer" has file name allocated with "new char[]".
@@ -768,6 +1192,8 @@ private:
         mCompletionRunningCount++;
         if (inReq.mIoCompletionPtr) {
             QCStMutexUnlocker theUnlock(mMutex);
+            inReq.mIoCompletionPtr->SetTimes(
+                GetRequestId(inReq), theWaitTime, theIoTime);
             if (! inReq.mIoCompletionPtr->Done(
                     GetRequestId(inReq),
                     inReq.mFileIdx,
@@ -1003,7 +1429,7 @@ QCDiskQueue::Queue::StopSelf()
     if (mRequestsPtr) {
         Request* theReqPtr;
         for (int i = 0; i < (mRequestAffinityFlag ? mThreadCount : 0); i++) {
-            while ((theReqPtr = Dequeue(i))) {
+            while ((theReqPtr = Dequeue(i, true))) {
                 Cancel(*theReqPtr);
             }
         }
@@ -1029,6 +1455,8 @@ QCDiskQueue::Queue::StopSelf()
     mRequestBufferCount = 0;
     delete [] mRequestsPtr;
     mRequestsPtr = 0;
+    delete [] mQueueStatePtr;
+    mQueueStatePtr = 0;
     delete [] mPendingCloseHeadPtr;
     mPendingCloseHeadPtr = 0;
     mPendingCloseTailPtr = 0;
@@ -1045,6 +1473,8 @@ QCDiskQueue::Queue::StopSelf()
     mReqWaitersCount = 0;
     mDebugTracerPtr = 0;
     mIoStartObserverPtr = 0;
+    mNextSeq = 0;
+    SetPriorityClassDefaults();
 }
 
     int
@@ -1163,6 +1593,8 @@ QCDiskQueue::Queue::Start(
             mFileInfoPtr[i].mOpenError             = kOpenErrorNone;
             mFileInfoPtr[i].mClosedFlag            = false;
             mFileInfoPtr[i].mCloseFileSize         = -1;
+            mFileInfoPtr[i].mWriteBehindStart      = -1;
+            mFileInfoPtr[i].mWriteBehindEnd        = -1;
             mFileInfoPtr[i].mThreadIdx             = mNextThreadIdx++;
             if (theFd < 0 && i < inFileCount) {
                 theFd = mFreeFdHead;
@@ -1176,11 +1608,12 @@ QCDiskQueue::Queue::Start(
     }
     mBuffersPtr = new char*[inMaxQueueDepth * inMaxBuffersPerRequestCount];
     mRequestBufferCount = inMaxBuffersPerRequestCount;
-    mRequestQueueCount  = kRequestQueueCount +
-        (mRequestAffinityFlag ? inThreadCount - 1 : 0);
+    const int theQueueCnt = mRequestAffinityFlag ? inThreadCount : 1;
+    mRequestQueueCount  = kIoQueueIdx + theQueueCnt * kPriorityClassCount;
     const int theReqCnt = mRequestQueueCount + inMaxQueueDepth;
     mRequestsPtr = new Request[theReqCnt];
-    // Init list heads: kFreeQueueIdx kIoQueueIdx.
+    mQueueStatePtr = new QueueState[theQueueCnt];
+    // Init list heads: kFreeQueueIdx, and io queue per priority class.
     for (mTotalCount = 0; mTotalCount < mRequestQueueCount; mTotalCount++) {
         Init(mRequestsPtr[mTotalCount]);
     }
@@ -1214,9 +1647,11 @@ QCDiskQueue::Queue::Enqueue(
     int                         inBufferCount,
     QCDiskQueue::IoCompletion*  inIoCompletionPtr,
     QCDiskQueue::Time           inTimeWaitNanoSec,
-    int64_t                     inEofHint)
+    int64_t                     inEofHint,
+    QCDiskQueue::PriorityClass  inPriorityClass)
 {
     if ((inReqType != kReqTypeRead && ! IsWriteReqType(inReqType)) ||
+            inPriorityClass < 0 || kPriorityClassCount <= inPriorityClass ||
             inBufferCount <= 0 ||
             inBufferCount > (mRequestBufferCount *
                 (mTotalCount - mRequestQueueCount)) ||
@@ -1254,6 +1689,7 @@ QCDiskQueue::Queue::Enqueue(
     theReq.mFileIdx         = inFileIdx;
     theReq.mBlockIdx        = inBlockIdx;
     theReq.mIoCompletionPtr = inIoCompletionPtr;
+    theReq.mPriorityClass   = inPriorityClass;
     if (inBufferIteratorPtr) {
         BuffersIterator theItr(*this, theReq, inBufferCount);
         for (int i = 0; i < inBufferCount; i++) {
@@ -1429,6 +1865,8 @@ QCDiskQueue::Queue::Process(
     const off_t   theOffset    = (off_t)inReq.mBlockIdx * mBlockSize;
     const bool    theReadFlag  = inReq.mReqType == kReqTypeRead;
     const bool    theSyncFlag  = inReq.mReqType == kReqTypeWriteSync;
+    const bool    theProbeFlag = theReadFlag && mPageCacheProbeFlag &&
+        mFileInfoPtr[inReq.mFileIdx].mBufferedIoFlag;
     const int64_t theAllocSize = (IsWriteReqType(inReq.mReqType) &&
         mFileInfoPtr[inReq.mFileIdx].mSpaceAllocPendingFlag) ?
             mFileInfoPtr[inReq.mFileIdx].mLastBlockIdx * mBlockSize : 0;
@@ -1460,6 +1898,40 @@ QCDiskQueue::Queue::Process(
     if (mRequestProcessorsPtr && 0 < theAllocSize) {
         mFileInfoPtr[inReq.mFileIdx].mSpaceAllocPendingFlag = false;
     }
+    // Start write out of the buffered writes in the background once the
+    // written range reaches write behind size, in order to minimize the
+    // amount of dirty data that the final sync has to write.
+    int64_t theWriteBehindStart = -1;
+    int64_t theWriteBehindEnd   = -1;
+    if (! mRequestProcessorsPtr && 0 < mWriteBehindSize &&
+            IsWriteReqType(inReq.mReqType) &&
+            mFileInfoPtr[inReq.mFileIdx].mBufferedIoFlag) {
+        FileInfo& theInfo = mFileInfoPtr[inReq.mFileIdx];
+        if (theSyncFlag) {
+            // Sync writes out the entire file.
+            theInfo.mWriteBehindStart = -1;
+            theInfo.mWriteBehindEnd   = -1;
+        } else {
+            const int64_t theEnd = (int64_t)theOffset +
+                (int64_t)inReq.mBufferCount * mBlockSize;
+            if (theInfo.mWriteBehindStart < 0) {
+                theInfo.mWriteBehindStart = (int64_t)theOffset;
+                theInfo.mWriteBehindEnd   = theEnd;
+            } else {
+                theInfo.mWriteBehindStart =
+                    Min(theInfo.mWriteBehindStart, (int64_t)theOffset);
+                theInfo.mWriteBehindEnd   =
+                    Max(theInfo.mWriteBehindEnd, theEnd);
+            }
+            if (mWriteBehindSize <=
+                    theInfo.mWriteBehindEnd - theInfo.mWriteBehindStart) {
+                theWriteBehindStart = theInfo.mWriteBehindStart;
+                theWriteBehindEnd   = theInfo.mWriteBehindEnd;
+                theInfo.mWriteBehindStart = -1;
+                theInfo.mWriteBehindEnd   = -1;
+            }
+        }
+    }
     const RequestId theReqId = GetRequestId(inReq);
     QCStMutexUnlocker theUnlock(mMutex);
 
@@ -1544,6 +2016,8 @@ QCDiskQueue::Queue::Process(
     BuffersIterator theItr(*this, inReq, inReq.mBufferCount);
     int             theBufCnt    = inReq.mBufferCount;
     int64_t         theIoByteCnt = 0;
+    bool            theHitFlag   = theProbeFlag;
+    bool            theProbeNotSupportedFlag = false;
     while (theBufCnt > 0 && theError == kErrorNone) {
         ssize_t theIoBytes  = 0;
         int     theIoVecCnt = 0;
@@ -1556,7 +2030,33 @@ QCDiskQueue::Queue::Process(
         }
         QCRTASSERT(theIoVecCnt > 0);
         if (theReadFlag) {
-            const ssize_t theNRd = readv(theFd, inIoVecPtr, theIoVecCnt);
+            ssize_t theNRd = -1;
+#if defined(QC_OS_NAME_LINUX) && defined(RWF_NOWAIT)
+            if (theHitFlag) {
+                // Non blocking read succeeds only if all data is in cache.
+                theNRd = preadv2(theFd, inIoVecPtr, theIoVecCnt,
+                    theOffset + theIoByteCnt, RWF_NOWAIT);
+                if (theNRd == theIoBytes) {
+                    if (0 < theBufCnt &&
+                            lseek(theFd, theNRd, SEEK_CUR) < 0) {
+                        theError    = kErrorSeek;
+                        theSysError = errno;
+                        break;
+                    }
+                } else {
+                    if (theNRd < 0 && errno != EAGAIN) {
+                        theProbeNotSupportedFlag =
+                            errno == EOPNOTSUPP || errno == ENOSYS ||
+                            errno == EINVAL;
+                    }
+                    theHitFlag = false;
+                    theNRd     = -1;
+                }
+            }
+#endif
+            if (theNRd < 0) {
+                theNRd = readv(theFd, inIoVecPtr, theIoVecCnt);
+            }
             if (theNRd < 0) {
                 theError = kErrorRead;
                 theSysError = theNRd < 0 ? errno : 0;
@@ -1593,11 +2093,47 @@ QCDiskQueue::Queue::Process(
         mBufferPoolPtr->Put(theIt, inReq.mBufferCount);
         theBufPtr[0] = 0;
     }
-    if (theSyncFlag && theError == kErrorNone && fsync(theFd)) {
-        theError    = kErrorWrite;
-        theSysError = errno;
+    bool theWriteBehindFlag = false;
+#if defined(QC_OS_NAME_LINUX) && defined(SYNC_FILE_RANGE_WRITE)
+    if (0 <= theWriteBehindStart && theError == kErrorNone) {
+        // Initiate write out, do not wait for completion.
+        theWriteBehindFlag = sync_file_range(theFd,
+            (off64_t)theWriteBehindStart,
+            (off64_t)(theWriteBehindEnd - theWriteBehindStart),
+            SYNC_FILE_RANGE_WRITE) == 0;
+    }
+#endif
+    int64_t theFsyncTime = -1;
+    if (theSyncFlag && theError == kErrorNone) {
+        const int64_t theStart = Now();
+        if (fsync(theFd)) {
+            theError    = kErrorWrite;
+            theSysError = errno;
+        }
+        theFsyncTime = Max(int64_t(0), Now() - theStart);
     }
     theUnlock.Lock();
+    if (theWriteBehindFlag) {
+        mWriteBehindCount++;
+        mWriteBehindByteCount += theWriteBehindEnd - theWriteBehindStart;
+    }
+    if (0 <= theFsyncTime) {
+        mFsyncCount++;
+        mFsyncTimeMicroSec += theFsyncTime;
+        mFsyncMaxTimeMicroSec = Max(mFsyncMaxTimeMicroSec, theFsyncTime);
+    }
+    if (theProbeFlag && theError == kErrorNone) {
+        if (theHitFlag) {
+            mPageCacheHitCount++;
+            mPageCacheHitByteCount += theIoByteCnt;
+        } else {
+            mPageCacheMissCount++;
+            mPageCacheMissByteCount += theIoByteCnt;
+        }
+    }
+    if (theProbeNotSupportedFlag) {
+        mPageCacheProbeFlag = false;
+    }
     RequestComplete(inReq, theError, theSysError, theIoByteCnt, theGetBufFlag);
 }
 
@@ -1630,6 +2166,11 @@ QCDiskQueue::Queue::ProcessOpenOrCreate(
         (theReadOnlyFlag ? O_RDONLY : O_RDWR) |
         GetOpenCommonFlags(mFileInfoPtr[theIdx].mBufferedIoFlag);
     const bool        theCreateExclusiveFlag = mCreateExclusiveFlag;
+    const bool        theRandomReadHintFlag  =
+        mFileInfoPtr[theIdx].mRandomReadHintFlag;
+    const char* const thePreallocatedNamePtr =
+        (theCreateFlag && mFileInfoPtr[theIdx].mPreallocatedFlag) ?
+        theFileNamePtr + strlen(theFileNamePtr) + 1 : 0;
 
     QCRTASSERT(theIdx >= 0 && theIdx < mFileCount && theFileNamePtr);
     QCStMutexUnlocker theUnlock(mMutex);
@@ -1645,6 +2186,11 @@ QCDiskQueue::Queue::ProcessOpenOrCreate(
         );
     }
 
+    // Rename the preallocated file into place, and open it instead of creating
+    // the new file. Create the file, if rename fails.
+    const bool theRenamedFlag = thePreallocatedNamePtr &&
+        rename(thePreallocatedNamePtr, theFileNamePtr) == 0;
+    const bool theDoCreateFlag = theCreateFlag && ! theRenamedFlag;
     int theSysErr = 0;
     int i;
     for (i = theIdx; i < mFdCount; i += mFileCount) {
@@ -1655,7 +2201,7 @@ QCDiskQueue::Queue::ProcessOpenOrCreate(
             const int theFd =  mRequestProcessorsPtr[inThreadIdx]->Open(
                 theFileNamePtr,
                 theReadOnlyFlag,
-                i == theIdx && theCreateFlag,
+                i == theIdx && theDoCreateFlag,
                 i == theIdx && theCreateExclusiveFlag,
                 theSize
             );
@@ -1672,7 +2218,7 @@ QCDiskQueue::Queue::ProcessOpenOrCreate(
                 continue;
             }
         } else {
-            const int theFd    = (theCreateFlag && i == theIdx) ?
+            const int theFd    = (theDoCreateFlag && i == theIdx) ?
                 CreateFile(theFileNamePtr, theOpenFlags, S_IRUSR | S_IWUSR,
                     theCreateExclusiveFlag) :
                 open(theFileNamePtr, theOpenFlags);
@@ -1681,6 +2227,12 @@ QCDiskQueue::Queue::ProcessOpenOrCreate(
                 break;
             }
             mFdPtr[i] = theFd;
+#ifdef POSIX_FADV_RANDOM
+            if (theRandomReadHintFlag) {
+                // Turn off os read ahead, the caller does its own if needed.
+                posix_fadvise(theFd, 0, 0, POSIX_FADV_RANDOM);
+            }
+#endif
             if (mFileCount <= i) {
                 continue;
             }
@@ -1829,7 +2381,8 @@ QCDiskQueue::Queue::ProcessMeta(
          inReq.mReqType == kReqTypeRename ||
          inReq.mReqType == kReqTypeGetFsAvailable ||
          inReq.mReqType == kReqTypeCheckDirReadable ||
-         inReq.mReqType == kReqTypeCheckDirWritable) &&
+         inReq.mReqType == kReqTypeCheckDirWritable ||
+         inReq.mReqType == kReqTypePreallocate) &&
          (int)inReq.mFileIdx == mFileCount - 1 // always the last pseudo entry
     );
     inReq.mInFlightFlag = true;
@@ -1859,7 +2412,8 @@ QCDiskQueue::Queue::ProcessMeta(
             inReq,
             inReq.mReqType,
             theNamePtr,
-            kReqTypeRename == inReq.mReqType ?
+            (kReqTypeRename == inReq.mReqType ||
+                kReqTypePreallocate == inReq.mReqType) ?
                 theNamePtr + theNextNameStart : 0
         );
         return;
@@ -1981,6 +2535,34 @@ QCDiskQueue::Queue::ProcessMeta(
                 }
             }
             break;
+        case kReqTypePreallocate: {
+                const char* thePtr  = theNamePtr + theNextNameStart;
+                int64_t     theSize = 0;
+                int         theSym;
+                while ((theSym = (*thePtr++ & 0xFF))) {
+                    theSym -= '0';
+                    QCASSERT((theSym & ~0xF) == 0);
+                    theSize <<= 4;
+                    theSize |= theSym & 0xF;
+                }
+                const int theFd = CreateFile(
+                    theNamePtr, O_RDWR | GetOpenCommonFlags(false),
+                    S_IRUSR | S_IWUSR, theCreateExclusiveFlag);
+                if (theFd < 0) {
+                    theSysErr = errno;
+                    theError  = kErrorPreallocate;
+                } else {
+                    theSysErr = QCUtils::AllocateFileSpace(theFd, theSize);
+                    if (close(theFd) && ! theSysErr) {
+                        theSysErr = errno;
+                    }
+                    if (theSysErr) {
+                        theError = kErrorPreallocate;
+                        unlink(theNamePtr);
+                    }
+                }
+            }
+            break;
         default:
             theSysErr = EINVAL;
             break;
@@ -1997,7 +2579,9 @@ QCDiskQueue::Queue::OpenFile(
     bool        inReadOnlyFlag,
     bool        inAllocateFileSpaceFlag,
     bool        inCreateFlag,
-    bool        inBufferedIoFlag)
+    bool        inBufferedIoFlag,
+    bool        inRandomReadHintFlag,
+    const char* inPreallocatedFileNamePtr)
 {
     if (! inFileNamePtr || ! *inFileNamePtr) {
         return OpenFileStatus(-1, kErrorParameter, EINVAL);
@@ -2035,15 +2619,30 @@ QCDiskQueue::Queue::OpenFile(
     mFileInfoPtr[theIdx].mClosedFlag            = false;
     mFileInfoPtr[theIdx].mLastBlockIdx          = theBlkIdx;
     mFileInfoPtr[theIdx].mCloseFileSize         = -1;
+    mFileInfoPtr[theIdx].mWriteBehindStart      = -1;
+    mFileInfoPtr[theIdx].mWriteBehindEnd        = -1;
     mFileInfoPtr[theIdx].mSpaceAllocPendingFlag = inAllocateFileSpaceFlag &&
         ! inReadOnlyFlag && inMaxFileSize > 0;
     mFileInfoPtr[theIdx].mBufferedIoFlag        = inBufferedIoFlag;
+    mFileInfoPtr[theIdx].mRandomReadHintFlag    =
+        inBufferedIoFlag && inRandomReadHintFlag;
+    mFileInfoPtr[theIdx].mPreallocatedFlag      = inCreateFlag &&
+        inPreallocatedFileNamePtr && *inPreallocatedFileNamePtr;
     mFileInfoPtr[theIdx].mThreadIdx             = mNextThreadIdx++;
 
     Request& theReq = *theReqPtr;
+    // Preallocated file name, if any, follows the file name.
     const size_t theFileNameLen = strlen(inFileNamePtr) + 1;
-    char* const  theFileNamePtr = new char[theFileNameLen];
+    const size_t thePreallocatedNameLen =
+        mFileInfoPtr[theIdx].mPreallocatedFlag ?
+        strlen(inPreallocatedFileNamePtr) + 1 : 0;
+    char* const  theFileNamePtr =
+        new char[theFileNameLen + thePreallocatedNameLen];
     memcpy(theFileNamePtr, inFileNamePtr, theFileNameLen);
+    if (0 < thePreallocatedNameLen) {
+        memcpy(theFileNamePtr + theFileNameLen, inPreallocatedFileNamePtr,
+            thePreallocatedNameLen);
+    }
     GetBuffersPtr(theReq)[0] = theFileNamePtr;
     theReq.mReqType         = inCreateFlag ?
         (inReadOnlyFlag ? kReqTypeCreateRO : kReqTypeCreate) :
@@ -2053,6 +2652,7 @@ QCDiskQueue::Queue::OpenFile(
     theReq.mFileIdx         = theIdx;
     theReq.mBlockIdx        = theBlkIdx;
     theReq.mIoCompletionPtr = 0;
+    theReq.mPriorityClass   = kPriorityClassClient;
     const int theThreadIdx = mFileInfoPtr[theIdx].mThreadIdx;
     Enqueue(theReq, theThreadIdx);
     Notify(theThreadIdx);
@@ -2143,6 +2743,7 @@ QCDiskQueue::Queue::CheckOpenStatus(
     theReq.mFileIdx         = inFileIdx;
     theReq.mBlockIdx        = 0;
     theReq.mIoCompletionPtr = inIoCompletionPtr;
+    theReq.mPriorityClass   = kPriorityClassClient;
     GetBuffersPtr(theReq)[0] = 0;
     const int theThreadIdx = mFileInfoPtr[inFileIdx].mThreadIdx;
     Enqueue(theReq, theThreadIdx);
@@ -2165,6 +2766,37 @@ QCDiskQueue::Queue::AllocateFileSpace(
     return Status(kErrorNone);
 }
 
+    QCDiskQueue::Status
+QCDiskQueue::Queue::DupFd(
+    QCDiskQueue::FileIdx inFileIdx,
+    int&                 outFd)
+{
+    outFd = -1;
+    QCStMutexLocker theLocker(mMutex);
+    if (! mRunFlag) {
+        return Status(kErrorQueueStopped);
+    }
+    if (inFileIdx < 0 || inFileIdx >= mFileCount || mFdPtr[inFileIdx] < 0 ||
+            mFileInfoPtr[inFileIdx].mClosedFlag) {
+        return Status(kErrorFileIdxOutOfRange);
+    }
+    const OpenError theOpenError = mFileInfoPtr[inFileIdx].mOpenError;
+    if (theOpenError != kOpenErrorNone) {
+        return Status(kErrorOpen, Open2SysError(theOpenError));
+    }
+    if (mFileInfoPtr[inFileIdx].mOpenPendingFlag) {
+        return Status(kErrorOpen, EAGAIN);
+    }
+    // The descriptor is only duplicated under the mutex, therefore the
+    // close that might be in flight can not race with dup.
+    outFd = fcntl(mFdPtr[inFileIdx], F_DUPFD_CLOEXEC, 0);
+    if (outFd < 0) {
+        const int theErr = errno;
+        return Status(kErrorOpen, theErr != 0 ? theErr : EBADF);
+    }
+    return Status(kErrorNone);
+}
+
     QCDiskQueue::EnqueueStatus
 QCDiskQueue::Queue::Rename(
         const char*                inSrcFileNamePtr,
@@ -2189,7 +2821,8 @@ QCDiskQueue::Queue::Rename(
 QCDiskQueue::Queue::Delete(
     const char*                inFileNamePtr,
     QCDiskQueue::IoCompletion* inIoCompletionPtr,
-    QCDiskQueue::Time          inTimeWaitNanoSec)
+    QCDiskQueue::Time          inTimeWaitNanoSec,
+    bool                       inBackgroundFlag)
 {
     if (! inFileNamePtr || ! *inFileNamePtr) {
         return EnqueueStatus(kRequestIdNone, kErrorParameter);
@@ -2199,7 +2832,8 @@ QCDiskQueue::Queue::Delete(
         inFileNamePtr,
         0,
         inIoCompletionPtr,
-        inTimeWaitNanoSec
+        inTimeWaitNanoSec,
+        inBackgroundFlag
     );
 }
 
@@ -2274,13 +2908,41 @@ QCDiskQueue::Queue::CheckDirWritable(
     );
 }
 
+    QCDiskQueue::EnqueueStatus
+QCDiskQueue::Queue::Preallocate(
+    const char*                inFileNamePtr,
+    int64_t                    inFileSize,
+    QCDiskQueue::IoCompletion* inIoCompletionPtr,
+    QCDiskQueue::Time          inTimeWaitNanoSec)
+{
+    if (! inFileNamePtr || ! *inFileNamePtr || inFileSize <= 0) {
+        return EnqueueStatus(kRequestIdNone, kErrorParameter);
+    }
+    int64_t theVal = (inFileSize + mBlockSize - 1) / mBlockSize * mBlockSize;
+    char  theParams[1 + sizeof(theVal) * 2];
+    char* thePtr = theParams + sizeof(theParams) / sizeof(theParams[0]);
+    *--thePtr = 0;
+    while (0 < theVal) {
+        *--thePtr = (char)('0' + (theVal & 0xF));
+        theVal >>= 4;
+    }
+    return EnqueueMeta(
+        kReqTypePreallocate,
+        inFileNamePtr,
+        thePtr,
+        inIoCompletionPtr,
+        inTimeWaitNanoSec
+    );
+}
+
     QCDiskQueue::EnqueueStatus
 QCDiskQueue::Queue::EnqueueMeta(
     QCDiskQueue::ReqType       inReqType,
     const char*                inFileName1Ptr,
     const char*                inFileName2Ptr,
     QCDiskQueue::IoCompletion* inIoCompletionPtr,
-    QCDiskQueue::Time          inTimeWaitNanoSec)
+    QCDiskQueue::Time          inTimeWaitNanoSec,
+    bool                       inBackgroundFlag)
 {
     if (! IsMetaReqType(inReqType)) {
         return EnqueueStatus(kRequestIdNone, kErrorParameter);
@@ -2317,6 +2979,11 @@ QCDiskQueue::Queue::EnqueueMeta(
     theReq.mFileIdx          = mFileCount - 1;
     theReq.mBlockIdx         = inFileName2Ptr ? theFileName1Len : 0;
     theReq.mIoCompletionPtr  = inIoCompletionPtr;
+    // Space and directory checks are background requests, barriers are
+    // ordered in respect to all classes.
+    theReq.mBackgroundFlag   = inBackgroundFlag;
+    theReq.mPriorityClass    = theReq.IsBarrier() ?
+        kPriorityClassClient : kPriorityClassMaintenance;
     GetBuffersPtr(theReq)[0] = theFileNamesPtr;
     const int theThreadIdx = mNextThreadIdx++;
     Enqueue(theReq, theThreadIdx);
@@ -2434,6 +3101,7 @@ QCDiskQueue::ToString(
         case kErrorGetFsAvailable:       return "get fs available";
         case kErrorCheckDirReadable:     return "dir readable";
         case kErrorCheckDirWritable:     return "dir writable";
+        case kErrorPreallocate:          return "preallocate";
         default:                         return "invalid error code";
     }
 }
@@ -2521,7 +3189,8 @@ QCDiskQueue::Enqueue(
     int                         inBufferCount,
     QCDiskQueue::IoCompletion*  inIoCompletionPtr,
     QCDiskQueue::Time           inTimeWaitNanoSec,
-    int64_t                     inEofHint)
+    int64_t                     inEofHint,
+    QCDiskQueue::PriorityClass  inPriorityClass)
 {
     if (! mQueuePtr) {
         return EnqueueStatus(kRequestIdNone, kErrorParameter);
@@ -2534,7 +3203,8 @@ QCDiskQueue::Enqueue(
         inBufferCount,
         inIoCompletionPtr,
         inTimeWaitNanoSec,
-        inEofHint);
+        inEofHint,
+        inPriorityClass);
 }
 
     bool
@@ -2571,6 +3241,89 @@ QCDiskQueue::GetPendingCount(
     }
 }
 
+    void
+QCDiskQueue::GetPageCacheCounters(
+    int64_t& outHitCount,
+    int64_t& outHitByteCount,
+    int64_t& outMissCount,
+    int64_t& outMissByteCount)
+{
+    if (mQueuePtr) {
+        mQueuePtr->GetPageCacheCounters(outHitCount, outHitByteCount,
+            outMissCount, outMissByteCount);
+    } else {
+        outHitCount      = 0;
+        outHitByteCount  = 0;
+        outMissCount     = 0;
+        outMissByteCount = 0;
+    }
+}
+
+    void
+QCDiskQueue::SetWriteBehindSize(
+    int64_t inSize)
+{
+    if (mQueuePtr) {
+        mQueuePtr->SetWriteBehindSize(inSize);
+    }
+}
+
+    void
+QCDiskQueue::SetElevatorParameters(
+    int     inWindowSize,
+    int64_t inMaxWaitMicroSec)
+{
+    if (mQueuePtr) {
+        mQueuePtr->SetElevatorParameters(inWindowSize, inMaxWaitMicroSec);
+    }
+}
+
+    void
+QCDiskQueue::GetSyncCounters(
+    int64_t& outWriteBehindCount,
+    int64_t& outWriteBehindByteCount,
+    int64_t& outFsyncCount,
+    int64_t& outFsyncTimeMicroSec,
+    int64_t& outFsyncMaxTimeMicroSec)
+{
+    if (mQueuePtr) {
+        mQueuePtr->GetSyncCounters(outWriteBehindCount,
+            outWriteBehindByteCount, outFsyncCount, outFsyncTimeMicroSec,
+            outFsyncMaxTimeMicroSec);
+    } else {
+        outWriteBehindCount     = 0;
+        outWriteBehindByteCount = 0;
+        outFsyncCount           = 0;
+        outFsyncTimeMicroSec    = 0;
+        outFsyncMaxTimeMicroSec = 0;
+    }
+}
+
+    void
+QCDiskQueue::SetPriorityClassParameters(
+    QCDiskQueue::PriorityClass inPriorityClass,
+    int                        inWeight,
+    int64_t                    inDeadlineMicroSec,
+    int                        inMaxInFlightCount)
+{
+    if (mQueuePtr) {
+        mQueuePtr->SetPriorityClassParameters(inPriorityClass,
+            inWeight, inDeadlineMicroSec, inMaxInFlightCount);
+    }
+}
+
+    void
+QCDiskQueue::GetPriorityClassCounters(
+    QCDiskQueue::PriorityClass          inPriorityClass,
+    QCDiskQueue::PriorityClassCounters& outCounters)
+{
+    if (mQueuePtr) {
+        mQueuePtr->GetPriorityClassCounters(inPriorityClass, outCounters);
+    } else {
+        outCounters.Clear();
+    }
+}
+
     QCDiskQueue::CompletionStatus
 QCDiskQueue::SyncIo(
     QCDiskQueue::ReqType         inReqType,
@@ -2606,12 +3359,15 @@ QCDiskQueue::OpenFile(
     bool        inReadOnlyFlag          /* = false */,
     bool        inAllocateFileSpaceFlag /* = false */,
     bool        inCreateFlag            /* false */,
-    bool        inBufferedIoFlag        /* false */)
+    bool        inBufferedIoFlag        /* false */,
+    bool        inRandomReadHintFlag    /* false */,
+    const char* inPreallocatedFileNamePtr /* 0 */)
 {
     return ((mQueuePtr && inFileNamePtr) ?
         mQueuePtr->OpenFile(inFileNamePtr, inMaxFileSize,
             inReadOnlyFlag, inAllocateFileSpaceFlag, inCreateFlag,
-            inBufferedIoFlag) :
+            inBufferedIoFlag, inRandomReadHintFlag,
+            inPreallocatedFileNamePtr) :
         OpenFileStatus(-1, kErrorParameter, 0)
     );
 }
@@ -2666,10 +3422,12 @@ QCDiskQueue::Rename(
 QCDiskQueue::Delete(
     const char*                inFileNamePtr,
     QCDiskQueue::IoCompletion* inIoCompletionPtr,
-    QCDiskQueue::Time          inTimeWaitNanoSec /* = -1 */)
+    QCDiskQueue::Time          inTimeWaitNanoSec /* = -1 */,
+    bool                       inBackgroundFlag  /* = false */)
 {
     return (mQueuePtr ?
-        mQueuePtr->Delete(inFileNamePtr, inIoCompletionPtr, inTimeWaitNanoSec) :
+        mQueuePtr->Delete(inFileNamePtr, inIoCompletionPtr, inTimeWaitNanoSec,
+            inBackgroundFlag) :
         EnqueueStatus(kRequestIdNone, kErrorParameter)
     );
 }
@@ -2717,6 +3475,20 @@ QCDiskQueue::CheckDirWritable(
     );
 }
 
+    QCDiskQueue::EnqueueStatus
+QCDiskQueue::Preallocate(
+    const char*                inFileNamePtr,
+    int64_t                    inFileSize,
+    QCDiskQueue::IoCompletion* inIoCompletionPtr,
+    QCDiskQueue::Time          inTimeWaitNanoSec /* = -1 */)
+{
+    return (mQueuePtr ?
+        mQueuePtr->Preallocate(inFileNamePtr, inFileSize,
+            inIoCompletionPtr, inTimeWaitNanoSec) :
+        EnqueueStatus(kRequestIdNone, kErrorParameter)
+    );
+}
+
     int
 QCDiskQueue::GetBlockSize() const
 {
@@ -2732,3 +3504,15 @@ QCDiskQueue::AllocateFileSpace(
         Status(kErrorParameter)
     );
 }
+
+    QCDiskQueue::Status
+QCDiskQueue::DupFd(
+    QCDiskQueue::FileIdx inFileIdx,
+    int&                 outFd)
+{
+    if (! mQueuePtr) {
+        outFd = -1;
+        return Status(kErrorParameter);
+    }
+    return mQueuePtr->DupFd(inFileIdx, outFd);
+}
@@ -35,6 +35,11 @@
 // close that is queued after read request will be executed after the read
 // request completes.
 //
+// Read and write requests have priority class. The classes share io threads
+// by weighted fair queueing, with optional per class deadline and in flight
+// requests limit. Meta requests are processed in the order they were enqueued
+// in respect to the requests of all classes.
+//
 //----------------------------------------------------------------------------
 
 #ifndef QCDISKQUEUE_H
@@ -65,6 +70,7 @@ public:
         kReqTypeClose            = 11,
         kReqTypeWriteSync        = 12,
         kReqTypeCheckDirWritable = 13,
+        kReqTypePreallocate      = 14,
         kReqTypeMax
     };
 
@@ -91,11 +97,64 @@ public:
         kErrorRename               = 18,
         kErrorGetFsAvailable       = 19,
         kErrorCheckDirReadable     = 20,
-        kErrorCheckDirWritable     = 21
+        kErrorCheckDirWritable     = 21,
+        kErrorPreallocate          = 22
     };
 
     enum { kRequestIdNone = -1 };
 
+    // Requests of the same class are processed in the order they were
+    // enqueued. While the requests of more than one class are pending each
+    // class gets the share of the io requests proportional to its weight. The
+    // oldest request of a class with expired deadline runs first. The in
+    // flight limit caps the class share regardless of the other classes load.
+    enum PriorityClass
+    {
+        kPriorityClassClient      = 0,
+        kPriorityClassRecovery    = 1,
+        kPriorityClassMaintenance = 2,
+        kPriorityClassCount
+    };
+    enum { kPriorityClassMaxWeight = 1 << 10 };
+
+    class PriorityClassCounters
+    {
+    public:
+        typedef int64_t Counter;
+
+        PriorityClassCounters()
+            { Clear(); }
+        void Clear()
+        {
+            mPendingCount     = 0;
+            mInFlightCount    = 0;
+            mRequestCount     = 0;
+            mBlockCount       = 0;
+            mWaitTimeMicroSec = 0;
+            mIoTimeMicroSec   = 0;
+            mDeadlineCount    = 0;
+        }
+        PriorityClassCounters& Add(
+            const PriorityClassCounters& inCounters)
+        {
+            mPendingCount     += inCounters.mPendingCount;
+            mInFlightCount    += inCounters.mInFlightCount;
+            mRequestCount     += inCounters.mRequestCount;
+            mBlockCount       += inCounters.mBlockCount;
+            mWaitTimeMicroSec += inCounters.mWaitTimeMicroSec;
+            mIoTimeMicroSec   += inCounters.mIoTimeMicroSec;
+            mDeadlineCount    += inCounters.mDeadlineCount;
+            return *this;
+        }
+        Counter mPendingCount;     // Queued, not yet started.
+        Counter mInFlightCount;    // Started, not yet completed.
+        Counter mRequestCount;     // Started.
+        Counter mBlockCount;
+        Counter mWaitTimeMicroSec; // Total time in queue before start.
+        Counter mIoTimeMicroSec;   // Total time from start to completion.
+        Counter mDeadlineCount;    // Started due to deadline expiration.
+    };
+
     typedef int      RequestId;
     typedef int      FileIdx;
     typedef int64_t  BlockIdx;
@@ -200,6 +259,14 @@ public:
             Error          inCompletionCode,
             int            inSysErrorCode,
             int64_t        inIoBytes) = 0;
+        // Invoked prior to Done(), with the time in microseconds the request
+        // spent in the queue prior to the io start, and the io time. Both
+        // times are 0 if the request was not started.
+        virtual void SetTimes(
+            RequestId /* inRequestId */,
+            int64_t   /* inWaitTimeMicroSec */,
+            int64_t   /* inIoTimeMicroSec */)
+            {}
     protected:
         IoCompletion()
             {}
@@ -328,7 +395,8 @@ public:
         int            inBufferCount,
         IoCompletion*  inIoCompletionPtr,
         Time           inTimeWaitNanoSec = -1,
-        int64_t        inEofHint         = -1);
+        int64_t        inEofHint         = -1,
+        PriorityClass  inPriorityClass   = kPriorityClassClient);
 
     EnqueueStatus Read(
         FileIdx        inFileIdx,
@@ -336,7 +404,8 @@ public:
         InputIterator* inBufferIteratorPtr,
         int            inBufferCount,
         IoCompletion*  inIoCompletionPtr,
-        Time           inTimeWaitNanoSec = -1)
+        Time           inTimeWaitNanoSec = -1,
+        PriorityClass  inPriorityClass   = kPriorityClassClient)
     {
         return Enqueue(
             kReqTypeRead,
@@ -345,7 +414,9 @@ public:
             inBufferIteratorPtr,
             inBufferCount,
             inIoCompletionPtr,
-            inTimeWaitNanoSec);
+            inTimeWaitNanoSec,
+            -1,
+            inPriorityClass);
     }
 
     EnqueueStatus Write(
@@ -356,7 +427,8 @@ public:
         IoCompletion*  inIoCompletionPtr,
         Time           inTimeWaitNanoSec = -1,
         bool           inSyncFlag        = false,
-        int64_t        inEofHint         = -1)
+        int64_t        inEofHint         = -1,
+        PriorityClass  inPriorityClass   = kPriorityClassClient)
     {
         return Enqueue(
             inSyncFlag ? kReqTypeWriteSync : kReqTypeWrite,
@@ -366,7 +438,8 @@ public:
             inBufferCount,
             inIoCompletionPtr,
             inTimeWaitNanoSec,
-            inEofHint);
+            inEofHint,
+            inPriorityClass);
     }
 
     CompletionStatus SyncIo(
@@ -428,13 +501,63 @@ public:
         int64_t& outReadBlockCount,
         int64_t& outWriteBlockCount);
 
+    // Buffered io read requests first try to read from the os page / buffer
+    // cache without blocking, where supported. The following returns the
+    // number of read requests and bytes that were fully served from the cache,
+    // and the number of the remaining buffered io read requests and bytes.
+    void GetPageCacheCounters(
+        int64_t& outHitCount,
+        int64_t& outHitByteCount,
+        int64_t& outMissCount,
+        int64_t& outMissByteCount);
+
+    // If write behind size is greater than 0, then the write out of buffered
+    // io writes is started in the background, with sync_file_range() where
+    // supported, once the written, and not yet written out range of the file
+    // reaches the specified size. The intent is to minimize the duration of
+    // the subsequent sync. Write behind has no effect with request processors.
+    void SetWriteBehindSize(
+        int64_t inSize);
+    // With window size greater than 1 the reads at the front of the priority
+    // class queue, up to the window size, are started in the ascending file
+    // index and block order, starting from the last read position, instead of
+    // the queue order. A read that waited the specified max. time or longer
+    // is started regardless of its position. Window size 1 or less turns the
+    // read re-ordering off.
+    void SetElevatorParameters(
+        int     inWindowSize,
+        int64_t inMaxWaitMicroSec);
+    // Returns the number of write behind requests and bytes, and the number
+    // of syncs performed along with their total and max duration.
+    void GetSyncCounters(
+        int64_t& outWriteBehindCount,
+        int64_t& outWriteBehindByteCount,
+        int64_t& outFsyncCount,
+        int64_t& outFsyncTimeMicroSec,
+        int64_t& outFsyncMaxTimeMicroSec);
+
+    // Weight is in [1, kPriorityClassMaxWeight] range. Deadline and in flight
+    // limit 0 or less turn the respective limit off. The parameters are reset
+    // to the defaults by Start().
+    void SetPriorityClassParameters(
+        PriorityClass inPriorityClass,
+        int           inWeight,
+        int64_t       inDeadlineMicroSec,
+        int           inMaxInFlightCount);
+
+    void GetPriorityClassCounters(
+        PriorityClass          inPriorityClass,
+        PriorityClassCounters& outCounters);
+
     OpenFileStatus OpenFile(
         const char* inFileNamePtr,
         int64_t     inMaxFileSize           = -1,
         bool        inReadOnlyFlag          = false,
         bool        inAllocateFileSpaceFlag = false,
         bool        inCreateFlag            = false,
-        bool        inBufferedIoFlag        = false);
+        bool        inBufferedIoFlag        = false,
+        bool        inRandomReadHintFlag    = false,
+        const char* inPreallocatedFileNamePtr = 0);
 
     CloseFileStatus CloseFile(
         FileIdx inFileIdx,
@@ -448,10 +571,15 @@ public:
         IoCompletion*  inIoCompletionPtr,
         Time           inTimeWaitNanoSec = -1);
 
+    // Background delete is not a barrier, and is queued with maintenance
+    // priority class. Intended for deleting files that are not visible to
+    // and not accessed by any other request, for example files in the
+    // directory used to reclaim stale chunks space.
     EnqueueStatus Delete(
         const char*    inFileNamePtr,
         IoCompletion*  inIoCompletionPtr,
-        Time           inTimeWaitNanoSec = -1);
+        Time           inTimeWaitNanoSec = -1,
+        bool           inBackgroundFlag  = false);
 
     EnqueueStatus GetFsSpaceAvailable(
         const char*    inFileNamePtr,
@@ -471,11 +599,30 @@ public:
         IoCompletion*  inIoCompletionPtr,
         Time           inTimeWaitNanoSec = -1);
 
+    // Create new file, and allocate space for it. The file size is rounded up
+    // to the block size, in order to match the size that OpenFile() with the
+    // same max file size would allocate. The file is intended to be passed
+    // later to OpenFile() as preallocated file, in order to make file creation
+    // and space allocation cheaper.
+    EnqueueStatus Preallocate(
+        const char*    inFileNamePtr,
+        int64_t        inFileSize,
+        IoCompletion*  inIoCompletionPtr,
+        Time           inTimeWaitNanoSec = -1);
+
     int GetBlockSize() const;
 
     Status AllocateFileSpace(
         FileIdx inFileIdx);
 
+    // Duplicate the file descriptor of the open file, for example for
+    // sendfile() or splice() from the page cache. The caller owns the returned
+    // descriptor, and must close it. The descriptor is not tracked by the
+    // queue, and remains valid after the file is closed.
+    Status DupFd(
+        FileIdx inFileIdx,
+        int&    outFd);
+
 private:
     class Queue;
     class RequestWaiter;
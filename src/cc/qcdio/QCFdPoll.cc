@@ -52,6 +52,7 @@ class QCFdPollImplBase
 {
 public:
     class Waker;
+    enum { kEdgeTriggeredSupportedFlag = 0 };
     QCFdPollImplBase(
         Waker* inWakerPtr)
         : mWakerPtr(inWakerPtr)
@@ -309,6 +310,7 @@ class QCFdPoll::Impl : public QCFdPollImplBase
 {
 public:
     enum { kFdCountHint = 1 << 10 };
+    enum { kEdgeTriggeredSupportedFlag = 1 };
 
     Impl(
         QCFdPollImplBase::Waker* inWakerPtr)
@@ -420,6 +422,9 @@ private:
         if ((inOpType & kOpTypePri) != 0) {
             theRet += EPOLLPRI;
         }
+        if ((inOpType & kOpTypeEdgeTriggered) != 0) {
+            theRet += EPOLLET;
+        }
         return theRet;
     }
     int FdPollMask(
@@ -974,6 +979,12 @@ QCFdPoll::Remove(
     return mImpl.Remove(inFd);
 }
 
+    /* static */ bool
+QCFdPoll::IsEdgeTriggeredSupported()
+{
+    return (Impl::kEdgeTriggeredSupportedFlag != 0);
+}
+
     bool
 QCFdPoll::Wakeup()
 {
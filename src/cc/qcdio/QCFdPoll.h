@@ -41,7 +41,13 @@ public:
         kOpTypeOut   = 0x02,
         kOpTypePri   = 0x04,
         kOpTypeError = 0x08,
-        kOpTypeHup   = 0x10
+        kOpTypeHup   = 0x10,
+        // Add and Set flag, supported only by epoll, see
+        // IsEdgeTriggeredSupported(). With edge triggered notification an
+        // event is reported only when the fd becomes ready, therefore the
+        // caller must read or write until EAGAIN before waiting for the
+        // next event.
+        kOpTypeEdgeTriggered = 0x20
     };
     enum
     {
@@ -81,6 +87,7 @@ public:
         void*& outUserDataPtr);
     int Close();
     bool Wakeup();
+    static bool IsEdgeTriggeredSupported();
 private:
     class Impl;
     Impl& mImpl;
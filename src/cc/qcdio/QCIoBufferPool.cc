@@ -33,6 +33,39 @@
 #include <sys/mman.h>
 #include <errno.h>
 #include <unistd.h>
+#ifdef QC_OS_NAME_LINUX
+#include <sys/syscall.h>
+#endif
+
+static int
+BindToNumaNode(
+    void*  inPtr,
+    size_t inSize,
+    int    inNumaNode)
+{
+#if defined(QC_OS_NAME_LINUX) && defined(SYS_mbind)
+    // Use preferred policy, to fall back to other nodes instead of failing
+    // the allocation if the node is out of memory.
+    const int     kMpolPreferred = 1;
+    const size_t  kBitsPerLong   = sizeof(unsigned long) * 8;
+    unsigned long theMask[1024 / kBitsPerLong] = { 0 };
+    if (inNumaNode < 0 || size_t(inNumaNode) >= sizeof(theMask) * 8) {
+        return EINVAL;
+    }
+    theMask[inNumaNode / kBitsPerLong] |=
+        (unsigned long)1 << (inNumaNode % kBitsPerLong);
+    if (syscall(SYS_mbind, inPtr, (unsigned long)inSize, kMpolPreferred,
+            theMask, (unsigned long)(sizeof(theMask) * 8), 0UL) != 0) {
+        const int theRet = errno;
+        return (theRet == 0 ? -1 : theRet);
+    }
+#else
+    (void)inPtr;
+    (void)inSize;
+    (void)inNumaNode;
+#endif
+    return 0;
+}
 
 class QCIoBufferPool::Partition
 {
@@ -44,7 +77,8 @@ public:
           mFreeListPtr(0),
           mTotalCnt(0),
           mFreeCnt(0),
-          mBufSizeShift(0)
+          mBufSizeShift(0),
+          mNumaNode(-1)
         { List::Init(*this); }
 
     ~Partition()
@@ -53,7 +87,9 @@ public:
     int Create(
         int  inNumBuffers,
         int  inBufferSize,
-        bool inLockMemoryFlag)
+        bool inLockMemoryFlag,
+        int  inHugePageSize,
+        int  inNumaNode)
     {
         int theBufSizeShift = -1;
         for (int i = inBufferSize; i > 0; i >>= 1, theBufSizeShift++)
@@ -70,15 +106,52 @@ public:
         size_t const kPageSize = sysconf(_SC_PAGESIZE);
         size_t const kAlign    = kPageSize > size_t(inBufferSize) ?
             kPageSize : size_t(inBufferSize);
+        size_t const kMapPageSize = inHugePageSize > 1 ?
+            size_t(inHugePageSize) : kPageSize;
+        int          theMapFlags  = MAP_PRIVATE | MAP_ANON;
+        if (inHugePageSize > 1) {
+            int theShift = 0;
+            while ((size_t(1) << theShift) < kMapPageSize) {
+                theShift++;
+            }
+            if ((size_t(1) << theShift) != kMapPageSize ||
+                    kMapPageSize < kPageSize) {
+                return EINVAL;
+            }
+#if defined(QC_OS_NAME_LINUX) && defined(MAP_HUGETLB)
+            theMapFlags |= MAP_HUGETLB;
+#   ifdef MAP_HUGE_SHIFT
+            theMapFlags |= theShift << MAP_HUGE_SHIFT;
+#   endif
+#else
+            return EINVAL;
+#endif
+        }
         mAllocSize = size_t(inNumBuffers) * inBufferSize + kAlign;
-        mAllocSize = (mAllocSize + kPageSize - 1) / kPageSize * kPageSize;
+        mAllocSize = (mAllocSize + kMapPageSize - 1) / kMapPageSize *
+            kMapPageSize;
         mAllocPtr = mmap(0, mAllocSize,
-            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+            PROT_READ | PROT_WRITE, theMapFlags, -1, 0);
         if (mAllocPtr == MAP_FAILED) {
             const int theRet = errno;
             mAllocPtr = 0;
             return (theRet == 0 ? -1 : theRet);
         }
+#ifdef MADV_HUGEPAGE
+        if (inHugePageSize == 1) {
+            // Transparent huge pages are advisory, ignore failures.
+            madvise(mAllocPtr, mAllocSize, MADV_HUGEPAGE);
+        }
+#endif
+        // Bind before mlock, as mlock faults the pages in.
+        if (inNumaNode >= 0) {
+            const int theRet = BindToNumaNode(mAllocPtr, mAllocSize, inNumaNode);
+            if (theRet != 0) {
+                Destroy();
+                return theRet;
+            }
+            mNumaNode = inNumaNode;
+        }
         if (inLockMemoryFlag && mlock(mAllocPtr, mAllocSize) != 0) {
             const int theRet = errno;
             Destroy();
@@ -111,6 +184,7 @@ public:
         mTotalCnt     = 0;
         mFreeCnt      = 0;
         mBufSizeShift = 0;
+        mNumaNode     = -1;
     }
 
     char* Get()
@@ -156,6 +230,9 @@ public:
     bool IsFull() const
         { return (mFreeCnt >= mTotalCnt); }
 
+    int GetNumaNode() const
+        { return mNumaNode; }
+
     typedef QCDLList<Partition, 0> List;
 
 private:
@@ -170,6 +247,7 @@ private:
     int          mTotalCnt;
     int          mFreeCnt;
     int          mBufSizeShift;
+    int          mNumaNode;
     Partition*   mPrevPtr[1];
     Partition*   mNextPtr[1];
 };
@@ -192,7 +270,8 @@ QCIoBufferPool::QCIoBufferPool()
     : mMutex(),
       mBufferSize(0),
       mFreeCnt(0),
-      mTotalCnt(0)
+      mTotalCnt(0),
+      mNumaNodeCount(0)
 {
     QCIoBufferPoolClientList::Init(mClientListPtr);
     Partition::List::Init(mPartitionListPtr);
@@ -215,17 +294,25 @@ QCIoBufferPool::Create(
     int          inPartitionCount,
     int          inPartitionBufferCount,
     int          inBufferSize,
-    bool         inLockMemoryFlag)
+    bool         inLockMemoryFlag,
+    int          inHugePageSize  /* = 0 */,
+    int          inNumaNodeCount /* = 0 */)
 {
     QCStMutexLocker theLock(mMutex);
     Destroy();
-    mBufferSize = inBufferSize;
+    mBufferSize    = inBufferSize;
+    mNumaNodeCount = inNumaNodeCount > 0 ? inNumaNodeCount : 0;
     int theErr = 0;
     for (int i = 0; i < inPartitionCount; i++) {
         Partition& thePart = *(new Partition());
         Partition::List::PushBack(mPartitionListPtr, thePart);
         theErr = thePart.Create(
-            inPartitionBufferCount, inBufferSize, inLockMemoryFlag);
+            inPartitionBufferCount,
+            inBufferSize,
+            inLockMemoryFlag,
+            inHugePageSize,
+            mNumaNodeCount > 0 ? i % mNumaNodeCount : -1
+        );
         if (theErr) {
             Destroy();
             break;
@@ -244,8 +331,9 @@ QCIoBufferPool::Destroy()
     while ((thePtr = Partition::List::PopBack(mPartitionListPtr))) {
         delete thePtr;
     }
-    mBufferSize = 0;
-    mFreeCnt    = 0;
+    mBufferSize    = 0;
+    mFreeCnt       = 0;
+    mNumaNodeCount = 0;
 }
 
 char*
@@ -257,12 +345,8 @@ QCIoBufferPool::Get(
         return 0;
     }
     QCASSERT(mFreeCnt >= 1);
-    // Always start from the first partition, to try to keep next
-    // partitions full, and be able to reclaim these if needed.
-    Partition::List::Iterator theItr(mPartitionListPtr);
-    Partition* thePtr;
-    while ((thePtr = theItr.Next()) && thePtr->IsEmpty())
-        {}
+    Partition* const thePtr = GetNonEmptyPartition(
+        mNumaNodeCount > 1 ? GetCurrentNumaNode() % mNumaNodeCount : -1);
     char* const theBufPtr = thePtr ? thePtr->Get() : 0;
     QCASSERT(theBufPtr && mFreeCnt > 0);
     mFreeCnt--;
@@ -283,11 +367,10 @@ QCIoBufferPool::Get(
         return false;
     }
     QCASSERT(mFreeCnt >= inBufCnt);
-    Partition::List::Iterator theItr(mPartitionListPtr);
+    const int theNumaNode = mNumaNodeCount > 1 ?
+        GetCurrentNumaNode() % mNumaNodeCount : -1;
     for (int i = 0; i < inBufCnt; ) {
-        Partition* thePPtr;
-        while ((thePPtr = theItr.Next()) && thePPtr->IsEmpty())
-            {}
+        Partition* const thePPtr = GetNonEmptyPartition(theNumaNode);
         QCASSERT(thePPtr);
         for (char* theBPtr; i < inBufCnt && (theBPtr = thePPtr->Get()); i++) {
             mFreeCnt--;
@@ -297,6 +380,52 @@ QCIoBufferPool::Get(
     return true;
 }
 
+QCIoBufferPool::Partition*
+QCIoBufferPool::GetNonEmptyPartition(
+    int inNumaNode)
+{
+    QCASSERT(mMutex.IsOwned());
+    // Always start from the first partition, to try to keep next
+    // partitions full, and be able to reclaim these if needed.
+    // Prefer the partitions that belong to the specified numa node.
+    Partition::List::Iterator theItr(mPartitionListPtr);
+    Partition* theFirstPtr = 0;
+    Partition* thePtr;
+    while ((thePtr = theItr.Next())) {
+        if (thePtr->IsEmpty()) {
+            continue;
+        }
+        if (inNumaNode < 0 || thePtr->GetNumaNode() == inNumaNode) {
+            return thePtr;
+        }
+        if (! theFirstPtr) {
+            theFirstPtr = thePtr;
+        }
+    }
+    return theFirstPtr;
+}
+
+    /* static */ int
+QCIoBufferPool::GetCurrentNumaNode()
+{
+#if defined(QC_OS_NAME_LINUX) && defined(SYS_getcpu)
+    // The io threads are normally pinned to cpus, re-query periodically to
+    // handle migration, as getcpu() is a system call.
+    static __thread int sNumaNode = -1;
+    static __thread int sCallCnt  = 0;
+    if (sNumaNode < 0 || ++sCallCnt >= 256) {
+        unsigned int theCpu  = 0;
+        unsigned int theNode = 0;
+        sCallCnt  = 0;
+        sNumaNode = syscall(SYS_getcpu, &theCpu, &theNode, (void*)0) == 0 ?
+            int(theNode) : 0;
+    }
+    return sNumaNode;
+#else
+    return 0;
+#endif
+}
+
 void
 QCIoBufferPool::Put(
     char* inBufPtr)
@@ -99,11 +99,19 @@ public:
 
     QCIoBufferPool();
     ~QCIoBufferPool();
+    // If huge page size is greater than 1, then partitions memory is allocated
+    // with explicit huge pages of the specified size (2MB or 1GB on linux),
+    // and if it is 1 then transparent huge pages are used, if supported.
+    // If numa node count is greater than 0, then partition i memory is bound to
+    // numa node i % node count, and buffers are allocated from the partitions
+    // that belong to the calling thread's numa node first.
     int Create(
         int          inPartitionCount,
         int          inPartitionBufferCount,
         int          inBufferSize,
-        bool         inLockMemoryFlag);
+        bool         inLockMemoryFlag,
+        int          inHugePageSize  = 0,
+        int          inNumaNodeCount = 0);
     void Destroy();
     char* Get(
         RefillReqId inRefillReqId = kRefillReqIdUndefined);
@@ -125,6 +133,7 @@ public:
     int GetFreeBufferCount();
     int GetTotalBufferCount();
     int GetUsedBufferCount();
+    static int GetCurrentNumaNode();
 
 private:
     class Partition;
@@ -134,6 +143,10 @@ private:
     int        mBufferSize;
     int        mFreeCnt;
     int        mTotalCnt;
+    int        mNumaNodeCount;
+
+    Partition* GetNonEmptyPartition(
+        int inNumaNode);
 
     bool TryToRefill(
         RefillReqId inReqId,
@@ -36,8 +36,13 @@
 #ifdef QC_OS_NAME_LINUX
 #include <sys/types.h>
 #include <sys/syscall.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sched.h>
 #include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #endif
 
 class QCStartedThreadList
@@ -256,3 +261,132 @@ QCThread::SetCurrentThreadAffinity(CpuAffinity inAffinity)
 #endif
     return 0;
 }
+
+#ifdef QC_OS_NAME_LINUX
+    static bool
+ReadSysfsLine(
+    const std::string& inPath,
+    char*              inBufPtr,
+    int                inBufSize)
+{
+    FILE* const theFilePtr = fopen(inPath.c_str(), "r");
+    if (! theFilePtr) {
+        return false;
+    }
+    const bool theRet = fgets(inBufPtr, inBufSize, theFilePtr) != 0;
+    fclose(theFilePtr);
+    return theRet;
+}
+
+    static int
+GetSysfsDeviceNumaNode(
+    const std::string& inPath)
+{
+    // Walk up the sysfs device tree starting from the link target, until the
+    // first device with numa node attribute is found, usually pci device.
+    char* const thePathPtr = realpath(inPath.c_str(), 0);
+    if (! thePathPtr) {
+        return -1;
+    }
+    std::string thePath(thePathPtr);
+    free(thePathPtr);
+    const std::string kDevicesPrefix("/sys/devices/");
+    int theNode = -1;
+    while (kDevicesPrefix.length() < thePath.length() &&
+            thePath.compare(0, kDevicesPrefix.length(), kDevicesPrefix) == 0) {
+        char theBuf[64];
+        if (ReadSysfsLine(thePath + "/numa_node", theBuf, sizeof(theBuf))) {
+            theNode = (int)strtol(theBuf, 0, 10);
+            break;
+        }
+        const size_t thePos = thePath.rfind('/');
+        if (thePos == std::string::npos) {
+            break;
+        }
+        thePath.erase(thePos);
+    }
+    return (theNode < 0 ? -1 : theNode);
+}
+#endif
+
+/* static */ QCThread::CpuAffinity
+QCThread::GetNumaNodeCpuAffinity(int inNumaNode)
+{
+#ifdef QC_OS_NAME_LINUX
+    if (inNumaNode < 0) {
+        return CpuAffinity::None();
+    }
+    char theName[128];
+    snprintf(theName, sizeof(theName),
+        "/sys/devices/system/node/node%d/cpulist", inNumaNode);
+    char theBuf[4 << 10];
+    if (! ReadSysfsLine(theName, theBuf, sizeof(theBuf))) {
+        return CpuAffinity::None();
+    }
+    // Cpu list format: 0-7,16-23
+    const int   kMaxCpus = 64;
+    CpuAffinity theAffinity;
+    const char* thePtr = theBuf;
+    while (*thePtr) {
+        char*      theEndPtr = 0;
+        const long theFirst  = strtol(thePtr, &theEndPtr, 10);
+        if (theEndPtr == thePtr || theFirst < 0) {
+            break;
+        }
+        long theLast = theFirst;
+        thePtr = theEndPtr;
+        if (*thePtr == '-') {
+            thePtr++;
+            theLast = strtol(thePtr, &theEndPtr, 10);
+            if (theEndPtr == thePtr || theLast < theFirst) {
+                break;
+            }
+            thePtr = theEndPtr;
+        }
+        for (long i = theFirst; i <= theLast && i < kMaxCpus; i++) {
+            theAffinity.Set((int)i);
+        }
+        if (*thePtr != ',') {
+            break;
+        }
+        thePtr++;
+    }
+    return (theAffinity == CpuAffinity() ? CpuAffinity::None() : theAffinity);
+#else
+    (void)inNumaNode;
+    return CpuAffinity::None();
+#endif
+}
+
+/* static */ int
+QCThread::GetPathNumaNode(const char* inPathPtr)
+{
+#ifdef QC_OS_NAME_LINUX
+    struct stat theStat;
+    if (! inPathPtr || stat(inPathPtr, &theStat) != 0) {
+        return -1;
+    }
+    char theName[128];
+    snprintf(theName, sizeof(theName), "/sys/dev/block/%u:%u",
+        (unsigned int)major(theStat.st_dev),
+        (unsigned int)minor(theStat.st_dev));
+    return GetSysfsDeviceNumaNode(theName);
+#else
+    (void)inPathPtr;
+    return -1;
+#endif
+}
+
+/* static */ int
+QCThread::GetNetInterfaceNumaNode(const char* inNamePtr)
+{
+#ifdef QC_OS_NAME_LINUX
+    if (! inNamePtr || ! *inNamePtr || strchr(inNamePtr, '/')) {
+        return -1;
+    }
+    return GetSysfsDeviceNumaNode(std::string("/sys/class/net/") + inNamePtr);
+#else
+    (void)inNamePtr;
+    return -1;
+#endif
+}
@@ -137,6 +137,14 @@ public:
         int inErrorCode);
     static int GetThreadCount();
     static int SetCurrentThreadAffinity(CpuAffinity inAffinity);
+    // Numa topology helpers. The information is obtained from sysfs, and is
+    // presently available only on linux. Return -1 or CpuAffinity::None() if
+    // the numa node, or the node cpus cannot be determined.
+    static CpuAffinity GetNumaNodeCpuAffinity(int inNumaNode);
+    // Returns numa node of the block device hosting the specified path.
+    static int GetPathNumaNode(const char* inPathPtr);
+    // Returns numa node of the network interface, for example "eth0".
+    static int GetNetInterfaceNumaNode(const char* inNamePtr);
 
 private:
     bool        mStartedFlag;
@@ -28,32 +28,12 @@
 
 #include <assert.h>
 #include "rs.h"
-#include "prim.h"
+#include "rs_kernels.h"
 
-/*
- * Reed-Solomon n+3 encoder.
- * nblocks is `n' data blocks plus 3 syndrome blocks.  blocksize _must_
- * be a multiple of 16.  data contains pointers to blocks.  The first
- * n are input data blocks.  The last 3 are the P, Q, and R syndromes.
- */
 void
-rs_encode(int nblocks, int blocksize, void **idata)
+rs_encode(int nblocks, int blocksize, void **data)
 {
-    int i, j, n;
-    v16 *p, *q, *r, **data = (v16**)idata;
-
     assert(nblocks > 3);
     assert(blocksize % 16 == 0);
-    n = nblocks - 3;  // # data blocks
-    p = data[n];
-    q = data[n+1];
-    r = data[n+2];
-    for (i = 0; i < blocksize/sizeof(v16); i++) {
-        p[i] = q[i] = r[i] = data[n-1][i];
-        for (j = n-2; j >= 0; j--) {
-            p[i] ^= data[j][i];
-            q[i] = mul2(q[i]) ^ data[j][i];
-            r[i] = mul2(mul2(r[i])) ^ data[j][i];
-        }
-    }
+    rs_kernel_run(RS_KOP_ENCODE, nblocks - 3, blocksize, 0, 0, 0, data);
 }
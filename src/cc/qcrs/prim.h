@@ -59,7 +59,7 @@ mask(v16 v)
 #elif defined(__GNUC__) && \
         (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)) || \
         defined(__clang__)
-    return VEC16(128) > v;
+    return (v16)(v >= VEC16(128));
 #else
     v16 res;
     int i;
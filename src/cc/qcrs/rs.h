@@ -41,6 +41,17 @@ void rs_decode1(int nblocks, int blocksize, int x, void **data);
 void rs_decode2(int nblocks, int blocksize, int x, int y, void **data);
 void rs_decode3(int nblocks, int blocksize, int x, int y, int z, void **data);
 
+/*
+ * The vector kernel is selected at run time on the first use, based on the
+ * cpu features. The block size must be multiple of 16, and the blocks must be
+ * 16 byte aligned with all kernels.
+ */
+const char* rs_get_kernel_name(void);
+/* Returns name of the idx-th kernel supported by the cpu, or 0. */
+const char* rs_get_supported_kernel_name(int idx);
+/* Returns 0 on success, or -1 if the kernel is not supported. */
+int rs_set_kernel(const char* name);
+
 #ifdef __cplusplus
 }
 #endif
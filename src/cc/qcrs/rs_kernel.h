@@ -0,0 +1,336 @@
+/*---------------------------------------------------------- -*- Mode: C -*-----
+ * $Id$
+ *
+ * Created 2026/10/14
+ *
+ * Copyright 2026 Quantcast Corporation. All rights reserved.
+ *
+ * This file is part of Kosmos File System (KFS).
+ *
+ * Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * \file rs_kernel.h
+ * \brief Reed Solomon n+3 encoder and decoder kernel template.
+ *
+ * Included once by each rs_kernel_*.c file, after defining the vector type
+ * and primitives:
+ *   RS_KNAME            kernel name
+ *   RS_KV               vector type
+ *   RS_KMUL2(v)         multiply by 2
+ *   RS_KMUL4(v)         multiply by 4, defaults to RS_KMUL2(RS_KMUL2(v))
+ *   RS_KTAB             multiply by constant table type
+ *   RS_KTAB_INIT(t, c)  initialize table t for multiply by c
+ *   RS_KMULBY(t, v)     multiply by constant using table t
+ *   RS_KFEATURES        required cpu features
+ * The kernel operates on the blocks of size multiple of sizeof(RS_KV), and
+ * defines rs_kernel_<RS_KNAME>.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include "rs_kernels.h"
+#include "rs_table.h"
+
+#include <string.h>     /* for memset */
+
+#ifndef RS_KMUL4
+#define RS_KMUL4(v) RS_KMUL2(RS_KMUL2(v))
+#endif
+
+#define RS_KCAT_(a, b) a##b
+#define RS_KCAT(a, b) RS_KCAT_(a, b)
+#define RS_KSTR_(a) #a
+#define RS_KSTR(a) RS_KSTR_(a)
+
+#define RS_KCOUNT(blocksize) ((blocksize) / (int)sizeof(RS_KV))
+
+/* Compute P syndrome over data[?][i]. */
+static RS_KV
+P(RS_KV **data, int n, int i)
+{
+    int j;
+    RS_KV p;
+
+    p = data[n-1][i];
+    for (j = n-2; j >= 0; j--)
+        p ^= data[j][i];
+    return p;
+}
+
+/* Compute Q syndrome over data[?][i]. */
+static RS_KV
+Q(RS_KV **data, int n, int i)
+{
+    int j;
+    RS_KV q;
+
+    q = data[n-1][i];
+    for (j = n-2; j >= 0; j--)
+        q = RS_KMUL2(q) ^ data[j][i];
+    return q;
+}
+
+/* Compute R syndrome over data[?][i]. */
+static RS_KV
+R(RS_KV **data, int n, int i)
+{
+    int j;
+    RS_KV r;
+
+    r = data[n-1][i];
+    for (j = n-2; j >= 0; j--)
+        r = RS_KMUL4(r) ^ data[j][i];
+    return r;
+}
+
+static void
+rs_kencode(int n, int blocksize, int x, int y, int z, void **idata)
+{
+    int i, j;
+    RS_KV p, q, r, **data = (RS_KV**)idata;
+
+    (void)x; (void)y; (void)z;
+    for (i = 0; i < RS_KCOUNT(blocksize); i++) {
+        p = q = r = data[n-1][i];
+        for (j = n-2; j >= 0; j--) {
+            const RS_KV d = data[j][i];
+            p ^= d;
+            q = RS_KMUL2(q) ^ d;
+            r = RS_KMUL4(r) ^ d;
+        }
+        data[n][i]   = p;
+        data[n+1][i] = q;
+        data[n+2][i] = r;
+    }
+}
+
+/* Recover data block x using P syndrome. */
+static void
+rs_kdecode1p(int n, int blocksize, int x, int y, int z, void **idata)
+{
+    int i;
+    RS_KV **data = (RS_KV**)idata;
+
+    (void)y; (void)z;
+    memset(data[x], 0, blocksize);
+    for (i = 0; i < RS_KCOUNT(blocksize); i++)
+        data[x][i] = P(data, n, i) ^ data[n][i];
+}
+
+/* Recover data block x using Q syndrome. */
+static void
+rs_kdecode1q(int n, int blocksize, int x, int y, int z, void **idata)
+{
+    int i;
+    RS_KV **data = (RS_KV**)idata;
+    RS_KTAB t;
+
+    (void)y; (void)z;
+    RS_KTAB_INIT(t, rs_r1Q[x]);
+    memset(data[x], 0, blocksize);
+    for (i = 0; i < RS_KCOUNT(blocksize); i++)
+        data[x][i] = RS_KMULBY(t, Q(data, n, i) ^ data[n+1][i]);
+}
+
+/* Recover data block x using R syndrome. */
+static void
+rs_kdecode1r(int n, int blocksize, int x, int y, int z, void **idata)
+{
+    int i;
+    RS_KV **data = (RS_KV**)idata;
+    RS_KTAB t;
+
+    (void)y; (void)z;
+    RS_KTAB_INIT(t, rs_r1R[x]);
+    memset(data[x], 0, blocksize);
+    for (i = 0; i < RS_KCOUNT(blocksize); i++)
+        data[x][i] = RS_KMULBY(t, R(data, n, i) ^ data[n+2][i]);
+}
+
+/* Recover data blocks x and y using syndromes P & Q. */
+static void
+rs_kdecode2pq(int n, int blocksize, int x, int y, int z, void **idata)
+{
+    int i;
+    RS_KV pp, qq, **data = (RS_KV**)idata;
+    const uint8_t* const c = rs_r2PQ[rs_r2map[x][y]];
+    RS_KTAB t[4];
+#ifndef KFS_QCRS_DONT_INLINE
+    RS_KV** pd = data + n - 1;
+#endif
+
+    (void)z;
+    for (i = 0; i < 4; i++)
+        RS_KTAB_INIT(t[i], c[i]);
+    memset(data[x], 0, blocksize);
+    memset(data[y], 0, blocksize);
+    for (i = 0; i < RS_KCOUNT(blocksize); i++) {
+#ifndef KFS_QCRS_DONT_INLINE
+        pp = (*pd)[i];
+        qq = pp;
+        while (data <= --pd) {
+            const RS_KV d = (*pd)[i];
+            pp ^= d;
+            qq = RS_KMUL2(qq) ^ d;
+        }
+        pd = data + n + 1;
+        qq ^= (*pd--)[i];
+        pp ^= (*pd--)[i];
+#else
+        pp = P(data, n, i) ^ data[n][i];
+        qq = Q(data, n, i) ^ data[n+1][i];
+#endif
+        data[x][i] = RS_KMULBY(t[0], pp) ^ RS_KMULBY(t[1], qq);
+        data[y][i] = RS_KMULBY(t[2], pp) ^ RS_KMULBY(t[3], qq);
+    }
+}
+
+/* Recover data blocks x and y using syndromes P & R. */
+static void
+rs_kdecode2pr(int n, int blocksize, int x, int y, int z, void **idata)
+{
+    int i;
+    RS_KV pp, rr, **data = (RS_KV**)idata;
+    const uint8_t* const c = rs_r2PR[rs_r2map[x][y]];
+    RS_KTAB t[4];
+#ifndef KFS_QCRS_DONT_INLINE
+    RS_KV** pd = data + n - 1;
+#endif
+
+    (void)z;
+    for (i = 0; i < 4; i++)
+        RS_KTAB_INIT(t[i], c[i]);
+    memset(data[x], 0, blocksize);
+    memset(data[y], 0, blocksize);
+    for (i = 0; i < RS_KCOUNT(blocksize); i++) {
+#ifndef KFS_QCRS_DONT_INLINE
+        pp = (*pd)[i];
+        rr = pp;
+        while (data <= --pd) {
+            const RS_KV d = (*pd)[i];
+            pp ^= d;
+            rr = RS_KMUL4(rr) ^ d;
+        }
+        pd = data + n + 2;
+        rr ^= (*pd--)[i];
+        pd--;
+        pp ^= (*pd--)[i];
+#else
+        pp = P(data, n, i) ^ data[n][i];
+        rr = R(data, n, i) ^ data[n+2][i];
+#endif
+        data[x][i] = RS_KMULBY(t[0], pp) ^ RS_KMULBY(t[1], rr);
+        data[y][i] = RS_KMULBY(t[2], pp) ^ RS_KMULBY(t[3], rr);
+    }
+}
+
+/* Recover data blocks x and y using syndromes Q & R. */
+static void
+rs_kdecode2qr(int n, int blocksize, int x, int y, int z, void **idata)
+{
+    int i;
+    RS_KV qq, rr, **data = (RS_KV**)idata;
+    const uint8_t* const c = rs_r2QR[rs_r2map[x][y]];
+    RS_KTAB t[4];
+#ifndef KFS_QCRS_DONT_INLINE
+    RS_KV** pd = data + n - 1;
+#endif
+
+    (void)z;
+    for (i = 0; i < 4; i++)
+        RS_KTAB_INIT(t[i], c[i]);
+    memset(data[x], 0, blocksize);
+    memset(data[y], 0, blocksize);
+    for (i = 0; i < RS_KCOUNT(blocksize); i++) {
+#ifndef KFS_QCRS_DONT_INLINE
+        qq = (*pd)[i];
+        rr = qq;
+        while (data <= --pd) {
+            const RS_KV d = (*pd)[i];
+            qq = RS_KMUL2(qq) ^ d;
+            rr = RS_KMUL4(rr) ^ d;
+        }
+        pd = data + n + 2;
+        rr ^= (*pd--)[i];
+        qq ^= (*pd--)[i];
+        pd--;
+#else
+        qq = Q(data, n, i) ^ data[n+1][i];
+        rr = R(data, n, i) ^ data[n+2][i];
+#endif
+        data[x][i] = RS_KMULBY(t[0], qq) ^ RS_KMULBY(t[1], rr);
+        data[y][i] = RS_KMULBY(t[2], qq) ^ RS_KMULBY(t[3], rr);
+    }
+}
+
+/* Recover data blocks x, y, & z using syndromes P, Q & R. */
+static void
+rs_kdecode3pqr(int n, int blocksize, int x, int y, int z, void **idata)
+{
+    int i;
+    RS_KV pp, qq, rr, **data = (RS_KV**)idata;
+    const uint8_t* const c = rs_r3[rs_r3map[x][y][z]];
+    RS_KTAB t[9];
+#ifndef KFS_QCRS_DONT_INLINE
+    RS_KV** pd = data + n - 1;
+#endif
+
+    for (i = 0; i < 9; i++)
+        RS_KTAB_INIT(t[i], c[i]);
+    memset(data[x], 0, blocksize);
+    memset(data[y], 0, blocksize);
+    memset(data[z], 0, blocksize);
+    for (i = 0; i < RS_KCOUNT(blocksize); i++) {
+#ifndef KFS_QCRS_DONT_INLINE
+        pp = (*pd)[i];
+        qq = pp;
+        rr = pp;
+        while (data <= --pd) {
+            const RS_KV d = (*pd)[i];
+            pp ^= d;
+            qq = RS_KMUL2(qq) ^ d;
+            rr = RS_KMUL4(rr) ^ d;
+        }
+        pd = data + n + 2;
+        rr ^= (*pd--)[i];
+        qq ^= (*pd--)[i];
+        pp ^= (*pd--)[i];
+#else
+        pp = P(data, n, i) ^ data[n][i];
+        qq = Q(data, n, i) ^ data[n+1][i];
+        rr = R(data, n, i) ^ data[n+2][i];
+#endif
+        data[x][i] = RS_KMULBY(t[0], pp) ^ RS_KMULBY(t[1], qq) ^
+            RS_KMULBY(t[2], rr);
+        data[y][i] = RS_KMULBY(t[3], pp) ^ RS_KMULBY(t[4], qq) ^
+            RS_KMULBY(t[5], rr);
+        data[z][i] = RS_KMULBY(t[6], pp) ^ RS_KMULBY(t[7], qq) ^
+            RS_KMULBY(t[8], rr);
+    }
+}
+
+const rs_kernel RS_KCAT(rs_kernel_, RS_KNAME) = {
+    RS_KSTR(RS_KNAME),
+    (int)sizeof(RS_KV),
+    RS_KFEATURES,
+    {
+        rs_kencode,
+        rs_kdecode1p,
+        rs_kdecode1q,
+        rs_kdecode1r,
+        rs_kdecode2pq,
+        rs_kdecode2pr,
+        rs_kdecode2qr,
+        rs_kdecode3pqr
+    }
+};
@@ -0,0 +1,77 @@
+/*---------------------------------------------------------- -*- Mode: C -*-----
+ * $Id$
+ *
+ * Created 2026/10/14
+ *
+ * Copyright 2026 Quantcast Corporation. All rights reserved.
+ *
+ * This file is part of Kosmos File System (KFS).
+ *
+ * Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * \file rs_kernel_avx2.c
+ * \brief Reed Solomon AVX2 kernel, 32 byte vectors, multiply by constant
+ * with nibble table shuffles.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include <immintrin.h>
+
+#include "rs_table.h"
+
+/* Only 16 byte alignment is required for the blocks. */
+typedef long long rs_v32 __attribute__ ((vector_size (32), aligned (16),
+    may_alias));
+
+struct rs_v32tab
+{
+    rs_v32 lo;
+    rs_v32 hi;
+};
+typedef struct rs_v32tab rs_v32tab;
+
+static inline rs_v32
+rs_v32mul2(rs_v32 v)
+{
+    const __m256i m = _mm256_cmpgt_epi8(_mm256_setzero_si256(), v);
+    return _mm256_add_epi8(v, v) ^ (m & _mm256_set1_epi8(0x1d));
+}
+
+static inline void
+rs_v32tab_init(rs_v32tab* t, uint8_t x)
+{
+    t->lo = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i*)&rs_nibmul[x].lo));
+    t->hi = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i*)&rs_nibmul[x].hi));
+}
+
+static inline rs_v32
+rs_v32mulby(const rs_v32tab* t, rs_v32 v)
+{
+    const __m256i m  = _mm256_set1_epi8(0x0f);
+    const __m256i lo = _mm256_and_si256(v, m);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), m);
+    return _mm256_shuffle_epi8(t->lo, lo) ^ _mm256_shuffle_epi8(t->hi, hi);
+}
+
+#define RS_KNAME            avx2
+#define RS_KFEATURES        RS_CPU_AVX2
+#define RS_KV               rs_v32
+#define RS_KMUL2(v)         rs_v32mul2(v)
+#define RS_KTAB             rs_v32tab
+#define RS_KTAB_INIT(t, x)  rs_v32tab_init(&(t), (x))
+#define RS_KMULBY(t, v)     rs_v32mulby(&(t), (v))
+
+#include "rs_kernel.h"
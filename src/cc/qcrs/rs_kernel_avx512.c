@@ -0,0 +1,78 @@
+/*---------------------------------------------------------- -*- Mode: C -*-----
+ * $Id$
+ *
+ * Created 2026/10/14
+ *
+ * Copyright 2026 Quantcast Corporation. All rights reserved.
+ *
+ * This file is part of Kosmos File System (KFS).
+ *
+ * Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * \file rs_kernel_avx512.c
+ * \brief Reed Solomon AVX-512BW kernel, 64 byte vectors, multiply by constant
+ * with nibble table shuffles.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include <immintrin.h>
+
+#include "rs_table.h"
+
+/* Only 16 byte alignment is required for the blocks. */
+typedef long long rs_v64 __attribute__ ((vector_size (64), aligned (16),
+    may_alias));
+
+struct rs_v64tab
+{
+    rs_v64 lo;
+    rs_v64 hi;
+};
+typedef struct rs_v64tab rs_v64tab;
+
+static inline rs_v64
+rs_v64mul2(rs_v64 v)
+{
+    const __m512i vv = _mm512_add_epi8(v, v);
+    return _mm512_mask_blend_epi8(_mm512_movepi8_mask(v),
+        vv, vv ^ _mm512_set1_epi8(0x1d));
+}
+
+static inline void
+rs_v64tab_init(rs_v64tab* t, uint8_t x)
+{
+    t->lo = _mm512_broadcast_i32x4(
+        _mm_loadu_si128((const __m128i*)&rs_nibmul[x].lo));
+    t->hi = _mm512_broadcast_i32x4(
+        _mm_loadu_si128((const __m128i*)&rs_nibmul[x].hi));
+}
+
+static inline rs_v64
+rs_v64mulby(const rs_v64tab* t, rs_v64 v)
+{
+    const __m512i m  = _mm512_set1_epi8(0x0f);
+    const __m512i lo = _mm512_and_si512(v, m);
+    const __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), m);
+    return _mm512_shuffle_epi8(t->lo, lo) ^ _mm512_shuffle_epi8(t->hi, hi);
+}
+
+#define RS_KNAME            avx512
+#define RS_KFEATURES        RS_CPU_AVX512BW
+#define RS_KV               rs_v64
+#define RS_KMUL2(v)         rs_v64mul2(v)
+#define RS_KTAB             rs_v64tab
+#define RS_KTAB_INIT(t, x)  rs_v64tab_init(&(t), (x))
+#define RS_KMULBY(t, v)     rs_v64mulby(&(t), (v))
+
+#include "rs_kernel.h"
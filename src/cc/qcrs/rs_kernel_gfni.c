@@ -0,0 +1,80 @@
+/*---------------------------------------------------------- -*- Mode: C -*-----
+ * $Id$
+ *
+ * Created 2026/10/14
+ *
+ * Copyright 2026 Quantcast Corporation. All rights reserved.
+ *
+ * This file is part of Kosmos File System (KFS).
+ *
+ * Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * \file rs_kernel_gfni.c
+ * \brief Reed Solomon AVX-512 GFNI kernel, 64 byte vectors. Multiply by
+ * constant in GF(2^8) with any reduction polynomial is a linear map over
+ * GF(2), and is computed with a single affine transformation instruction.
+ * The GFNI multiply instruction is not used, as it uses AES polynomial 0x11B,
+ * instead of 0x11D.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include <immintrin.h>
+
+#include "rs_table.h"
+
+/* Only 16 byte alignment is required for the blocks. */
+typedef long long rs_v64 __attribute__ ((vector_size (64), aligned (16),
+    may_alias));
+
+/* Affine transformation matrices for multiply by 2 and 4. */
+#define RS_GFNI_MUL2 ((long long)0x8001828488102040ULL)
+#define RS_GFNI_MUL4 ((long long)0x408041C2C4881020ULL)
+
+/* Row i of the 8x8 bit matrix is stored in byte 7 - i, and bit k of the row i
+ * is bit i of x * 2^k. */
+static inline long long
+rs_gfni_matrix(uint8_t x)
+{
+    uint8_t  col[8];
+    uint64_t m = 0;
+    int      i, k;
+
+    col[0] = x;
+    for (k = 1; k < 8; k++)
+        col[k] = (uint8_t)((col[k-1] << 1) ^ ((col[k-1] & 0x80) ? 0x1d : 0));
+    for (i = 0; i < 8; i++) {
+        unsigned int row = 0;
+        for (k = 0; k < 8; k++)
+            row |= ((col[k] >> i) & 1u) << k;
+        m |= (uint64_t)row << (8 * (7 - i));
+    }
+    return (long long)m;
+}
+
+static inline rs_v64
+rs_gfni_mul(rs_v64 v, rs_v64 m)
+{
+    return _mm512_gf2p8affine_epi64_epi8(v, m, 0);
+}
+
+#define RS_KNAME            gfni
+#define RS_KFEATURES        (RS_CPU_AVX512BW | RS_CPU_GFNI)
+#define RS_KV               rs_v64
+#define RS_KMUL2(v)         rs_gfni_mul((v), _mm512_set1_epi64(RS_GFNI_MUL2))
+#define RS_KMUL4(v)         rs_gfni_mul((v), _mm512_set1_epi64(RS_GFNI_MUL4))
+#define RS_KTAB             rs_v64
+#define RS_KTAB_INIT(t, x)  ((t) = _mm512_set1_epi64(rs_gfni_matrix(x)))
+#define RS_KMULBY(t, v)     rs_gfni_mul((v), (t))
+
+#include "rs_kernel.h"
@@ -0,0 +1,38 @@
+/*---------------------------------------------------------- -*- Mode: C -*-----
+ * $Id$
+ *
+ * Created 2026/10/14
+ *
+ * Copyright 2026 Quantcast Corporation. All rights reserved.
+ *
+ * This file is part of Kosmos File System (KFS).
+ *
+ * Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * \file rs_kernel_ssse3.c
+ * \brief Reed Solomon SSSE3 kernel. Used at run time if the cpu supports
+ * SSSE3, and the build time vector mode is SSE2.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef LIBRS_USE_SSSE3
+#define LIBRS_USE_SSSE3
+#endif
+
+#include "rs_kernel_v16.h"
+
+#define RS_KNAME     ssse3
+#define RS_KFEATURES RS_CPU_SSSE3
+
+#include "rs_kernel.h"
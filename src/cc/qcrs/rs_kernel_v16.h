@@ -0,0 +1,100 @@
+/*---------------------------------------------------------- -*- Mode: C -*-----
+ * $Id$
+ *
+ * Created 2026/10/14
+ *
+ * Copyright 2026 Quantcast Corporation. All rights reserved.
+ *
+ * This file is part of Kosmos File System (KFS).
+ *
+ * Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * \file rs_kernel_v16.h
+ * \brief 16 byte vector primitives for Reed Solomon kernel template, using
+ * build time selected vector mode.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef RS_KERNEL_V16_H
+#define RS_KERNEL_V16_H
+
+#include "prim.h"
+#include "rs_table.h"
+
+#if defined(LIBRS_USE_NEON) || defined(LIBRS_USE_SSSE3)
+typedef rs_nibtab rs_v16tab;
+#define RS_V16TAB_INIT(t, x) ((t) = rs_nibmul[(x)])
+#else
+typedef uint8_t rs_v16tab;
+#define RS_V16TAB_INIT(t, x) ((t) = (x))
+#endif
+
+static inline v16
+rs_v16mulby(const rs_v16tab* t, v16 v)
+{
+#ifdef LIBRS_USE_NEON
+
+    v16 lo, hi;
+
+    lo = v & VEC16(0x0f);
+    hi = vshrq_n_u8(v, 4);
+#ifdef __aarch64__
+    return vqtbl1q_u8(t->lo, lo) ^ vqtbl1q_u8(t->hi, hi);
+#else
+
+#define uint8x16_to_8x8x2(v) ((uint8x8x2_t) { vget_low_u8(v), vget_high_u8(v) })
+
+    lo = vcombine_u8(
+            vtbl2_u8(uint8x16_to_8x8x2(t->lo), vget_low_u8(lo)),
+            vtbl2_u8(uint8x16_to_8x8x2(t->lo), vget_high_u8(lo)));
+    hi = vcombine_u8(
+            vtbl2_u8(uint8x16_to_8x8x2(t->hi), vget_low_u8(hi)),
+            vtbl2_u8(uint8x16_to_8x8x2(t->hi), vget_high_u8(hi)));
+    return lo ^ hi;
+#endif
+
+#elif defined(LIBRS_USE_SSSE3)
+
+    v16 lo, hi;
+
+    lo = v & VEC16(0x0f);
+    hi = __builtin_ia32_psrawi128(v, 4);
+    hi &= VEC16(0x0f);
+    lo = __builtin_ia32_pshufb128(t->lo, lo);
+    hi = __builtin_ia32_pshufb128(t->hi, hi);
+    return lo ^ hi;
+
+#else
+
+    uint8_t x  = *t;
+    v16     vv = VEC16(0);
+
+    while (x != 0) {
+        if (x & 1)
+            vv ^= v;
+        x >>= 1;
+        v = mul2(v);
+    }
+    return vv;
+
+#endif
+}
+
+#define RS_KV               v16
+#define RS_KMUL2(v)         mul2(v)
+#define RS_KTAB             rs_v16tab
+#define RS_KTAB_INIT(t, x)  RS_V16TAB_INIT(t, x)
+#define RS_KMULBY(t, v)     rs_v16mulby(&(t), (v))
+
+#endif /* RS_KERNEL_V16_H */
@@ -0,0 +1,170 @@
+/*---------------------------------------------------------- -*- Mode: C -*-----
+ * $Id$
+ *
+ * Created 2026/10/14
+ *
+ * Copyright 2026 Quantcast Corporation. All rights reserved.
+ *
+ * This file is part of Kosmos File System (KFS).
+ *
+ * Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * \file rs_kernels.c
+ * \brief Reed Solomon kernel run time selection, based on cpu features.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include "rs.h"
+#include "rs_kernels.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define RS_X86_CPUID
+#endif
+
+/* In the order of preference. */
+static const rs_kernel* const rs_kernels[] = {
+#ifdef LIBRS_USE_GFNI_KERNEL
+    &rs_kernel_gfni,
+#endif
+#ifdef LIBRS_USE_AVX512_KERNEL
+    &rs_kernel_avx512,
+#endif
+#ifdef LIBRS_USE_AVX2_KERNEL
+    &rs_kernel_avx2,
+#endif
+#ifdef LIBRS_USE_SSSE3_KERNEL
+    &rs_kernel_ssse3,
+#endif
+    &rs_kernel_base
+};
+
+#define RS_KERNELS_COUNT ((int)(sizeof(rs_kernels) / sizeof(rs_kernels[0])))
+
+/* The selection is idempotent, the race with concurrent first use from
+ * multiple threads is benign. */
+static const rs_kernel* rs_cur_kernel = 0;
+static unsigned int     rs_cpu_features_mask = 0;
+static int              rs_cpu_features_valid = 0;
+
+static unsigned int
+rs_cpu_features(void)
+{
+    unsigned int res = 0;
+#ifdef RS_X86_CPUID
+    unsigned int eax, ebx, ecx, edx, xcr0, xcr0hi;
+
+    if (! __get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return res;
+    if (ecx & (1u << 9))
+        res |= RS_CPU_SSSE3;
+    /* AVX state must be enabled by the os: OSXSAVE and XCR0. */
+    if (! (ecx & (1u << 27)))
+        return res;
+    __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" /* xgetbv */
+        : "=a" (xcr0), "=d" (xcr0hi) : "c" (0));
+    (void)xcr0hi;
+    if ((xcr0 & 0x6) != 0x6 || __get_cpuid_max(0, 0) < 7)
+        return res;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (ebx & (1u << 5))
+        res |= RS_CPU_AVX2;
+    if ((xcr0 & 0xe6) == 0xe6 &&
+            (ebx & (1u << 16)) != 0 && /* AVX512F */
+            (ebx & (1u << 30)) != 0)   /* AVX512BW */
+        res |= RS_CPU_AVX512BW;
+    if (ecx & (1u << 8))
+        res |= RS_CPU_GFNI;
+#endif
+    return res;
+}
+
+static int
+rs_kernel_supported(const rs_kernel* k)
+{
+    if (! rs_cpu_features_valid) {
+        rs_cpu_features_mask  = rs_cpu_features();
+        rs_cpu_features_valid = 1;
+    }
+    return ((k->features & rs_cpu_features_mask) == k->features);
+}
+
+static const rs_kernel*
+rs_get_kernel(void)
+{
+    int i;
+
+    if (rs_cur_kernel)
+        return rs_cur_kernel;
+    for (i = 0; i < RS_KERNELS_COUNT; i++) {
+        if (rs_kernel_supported(rs_kernels[i])) {
+            rs_cur_kernel = rs_kernels[i];
+            break;
+        }
+    }
+    return rs_cur_kernel;
+}
+
+void
+rs_kernel_run(int op, int n, int blocksize, int x, int y, int z, void **data)
+{
+    const rs_kernel* const k    = rs_get_kernel();
+    const int              head = blocksize / k->vecsize * k->vecsize;
+    void*                  tail[RS_LIB_MAX_DATA_BLOCKS + 3];
+    int                    i;
+
+    if (head > 0)
+        k->ops[op](n, head, x, y, z, data);
+    if (head >= blocksize)
+        return;
+    for (i = 0; i < n + 3; i++)
+        tail[i] = data[i] ? (char*)data[i] + head : 0;
+    rs_kernel_base.ops[op](n, blocksize - head, x, y, z, tail);
+}
+
+const char*
+rs_get_kernel_name(void)
+{
+    return rs_get_kernel()->name;
+}
+
+const char*
+rs_get_supported_kernel_name(int idx)
+{
+    int i, cnt = 0;
+
+    for (i = 0; i < RS_KERNELS_COUNT; i++) {
+        if (rs_kernel_supported(rs_kernels[i]) && cnt++ == idx)
+            return rs_kernels[i]->name;
+    }
+    return 0;
+}
+
+int
+rs_set_kernel(const char* name)
+{
+    int i;
+
+    for (i = 0; i < RS_KERNELS_COUNT; i++) {
+        if (strcmp(rs_kernels[i]->name, name) == 0) {
+            if (! rs_kernel_supported(rs_kernels[i]))
+                return -1;
+            rs_cur_kernel = rs_kernels[i];
+            return 0;
+        }
+    }
+    return -1;
+}
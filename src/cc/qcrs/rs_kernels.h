@@ -0,0 +1,91 @@
+/*---------------------------------------------------------- -*- Mode: C -*-----
+ * $Id$
+ *
+ * Created 2026/10/14
+ *
+ * Copyright 2026 Quantcast Corporation. All rights reserved.
+ *
+ * This file is part of Kosmos File System (KFS).
+ *
+ * Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * \file rs_kernels.h
+ * \brief Reed Solomon encoder and decoder vector kernels, and run time kernel
+ * selection.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef RS_KERNELS_H
+#define RS_KERNELS_H
+
+#include "rs.h"
+
+/* Kernel operations, all have the same signature. n is the number of data
+ * blocks, x, y, z are the missing blocks, if any. */
+enum
+{
+    RS_KOP_ENCODE,
+    RS_KOP_DECODE1P,
+    RS_KOP_DECODE1Q,
+    RS_KOP_DECODE1R,
+    RS_KOP_DECODE2PQ,
+    RS_KOP_DECODE2PR,
+    RS_KOP_DECODE2QR,
+    RS_KOP_DECODE3PQR,
+    RS_KOP_COUNT
+};
+
+/* Cpu features required by kernels. */
+enum
+{
+    RS_CPU_SSSE3    = 1 << 0,
+    RS_CPU_AVX2     = 1 << 1,
+    RS_CPU_AVX512BW = 1 << 2,
+    RS_CPU_GFNI     = 1 << 3
+};
+
+typedef void (*rs_kernel_op)(int n, int blocksize, int x, int y, int z,
+    void **data);
+
+struct rs_kernel
+{
+    const char*  name;
+    int          vecsize;  /* block size must be multiple of vecsize */
+    unsigned int features; /* required cpu features */
+    rs_kernel_op ops[RS_KOP_COUNT];
+};
+typedef struct rs_kernel rs_kernel;
+
+/* Build time vector mode kernel, used with all block sizes. */
+extern const rs_kernel rs_kernel_base;
+#ifdef LIBRS_USE_SSSE3_KERNEL
+extern const rs_kernel rs_kernel_ssse3;
+#endif
+#ifdef LIBRS_USE_AVX2_KERNEL
+extern const rs_kernel rs_kernel_avx2;
+#endif
+#ifdef LIBRS_USE_AVX512_KERNEL
+extern const rs_kernel rs_kernel_avx512;
+#endif
+#ifdef LIBRS_USE_GFNI_KERNEL
+extern const rs_kernel rs_kernel_gfni;
+#endif
+
+/* Run kernel operation with the selected kernel. The part of the block that
+ * is not multiple of the kernel vector size is processed by the base kernel.
+ */
+void rs_kernel_run(int op, int n, int blocksize, int x, int y, int z,
+    void **data);
+
+#endif /* RS_KERNELS_H */
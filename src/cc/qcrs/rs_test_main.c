@@ -61,90 +61,72 @@ mkrand(void *buf, int size)
 
 void *data[RS_LIB_MAX_DATA_BLOCKS+3];
 void *orig[RS_LIB_MAX_DATA_BLOCKS+3];
+void *check[RS_LIB_MAX_DATA_BLOCKS+3];
 
-int main(int argc, char **argv)
+static int
+perf_test(int N, int BLOCKSIZE, int n)
 {
-    if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
-        printf("Usage: %s [data blocks] [block size] [perf iterations]\n"
-               "       This tests the Reed Solomon encoder and decoder.\n"
-               "       0 < data blocks <= %d.\n"
-               "       Use perf iterations for performance test.\n"
-               "       Defaults: data blocks=%d, block size=%d\n", argv[0],
-               RS_LIB_MAX_DATA_BLOCKS, RS_LIB_MAX_DATA_BLOCKS, (64 << 10));
-        exit(0);
-    }
-
-    int i, j, k, n, m, err;
-    const int N = argc > 1 ? atoi(argv[1]) : RS_LIB_MAX_DATA_BLOCKS;
-    const int BLOCKSIZE = argc > 2 ? atoi(argv[2]) : (64 << 10);
-
-    if (N <= 0 || N > RS_LIB_MAX_DATA_BLOCKS) {
-        printf("0 < data blocks <= %d\n", RS_LIB_MAX_DATA_BLOCKS);
-        return 1;
-    }
+    int i, j, k, m;
+    clock_t clk, tclk = 0;
+    double  tbytes = 0;
 
-    for (i = 0; i < N+3; i++) {
-        if ((err = posix_memalign(data + i, 16, BLOCKSIZE)) ||
-                (err = posix_memalign(orig + i, 16, BLOCKSIZE))) {
-            printf("%s\n", strerror(err));
-            return 1;
-        }
-        memset(data[i], 0, BLOCKSIZE);
-    }
-
-    if (argc > 3) {
-        clock_t clk, tclk = 0;
-        double  tbytes = 0;
-        // Performance test.
-        n = atoi(argv[3]);
-        for (i = 0; i < N+3; i++)
-            mkrand(data[i], BLOCKSIZE);
-        clk = clock();
-        for (i = 0; i < n; i++)
-            rs_encode(N+3, BLOCKSIZE, data);
-        clk = clock() - clk;
-        printf("encode %.3e clocks %.3e sec %.3e bytes/sec\n",
-            (double)clk, (double)clk/CLOCKS_PER_SEC,
-            BLOCKSIZE * N * (double)CLOCKS_PER_SEC * n /
-                ((double)clk > 0 ? (double)clk : 1e-10));
-        for (i = N - (3 < N ? 3 : 0); i < N; i++) {
-            for (j = i + 1; j < N + 3; j++) {
-                for (k = j + 1; k < N + 3; k++) {
-                    void* const p = data[k];
-                    if (N <= k) {
-                        data[k] = 0; /* do not encode */
-                    }
-                    clk = clock();
-                    for (m = 0; m < n; m++)
-                        rs_decode3(N + 3, BLOCKSIZE, i, j, k, data);
-                    clk = clock() - clk;
-                    data[k] = p;
-                    printf("decode missing: %d,%d,%d"
-                        " %.3e clocks %.3e sec %.3e bytes/sec\n",
-                        i, j, k, (double)clk, (double)clk/CLOCKS_PER_SEC,
-                        BLOCKSIZE * N * (double)CLOCKS_PER_SEC * n /
-                            ((double)clk > 0 ? (double)clk : 1e-10));
-                    tbytes += (double)BLOCKSIZE * N * n;
-                    tclk += clk;
-                    if (k < N) {
-                        break;
-                    }
+    for (i = 0; i < N+3; i++)
+        mkrand(data[i], BLOCKSIZE);
+    clk = clock();
+    for (i = 0; i < n; i++)
+        rs_encode(N+3, BLOCKSIZE, data);
+    clk = clock() - clk;
+    printf("encode %.3e clocks %.3e sec %.3e bytes/sec\n",
+        (double)clk, (double)clk/CLOCKS_PER_SEC,
+        BLOCKSIZE * N * (double)CLOCKS_PER_SEC * n /
+            ((double)clk > 0 ? (double)clk : 1e-10));
+    for (i = N - (3 < N ? 3 : 0); i < N; i++) {
+        for (j = i + 1; j < N + 3; j++) {
+            for (k = j + 1; k < N + 3; k++) {
+                void* const p = data[k];
+                if (N <= k) {
+                    data[k] = 0; /* do not encode */
                 }
-                if (j < N) {
+                clk = clock();
+                for (m = 0; m < n; m++)
+                    rs_decode3(N + 3, BLOCKSIZE, i, j, k, data);
+                clk = clock() - clk;
+                data[k] = p;
+                printf("decode missing: %d,%d,%d"
+                    " %.3e clocks %.3e sec %.3e bytes/sec\n",
+                    i, j, k, (double)clk, (double)clk/CLOCKS_PER_SEC,
+                    BLOCKSIZE * N * (double)CLOCKS_PER_SEC * n /
+                        ((double)clk > 0 ? (double)clk : 1e-10));
+                tbytes += (double)BLOCKSIZE * N * n;
+                tclk += clk;
+                if (k < N) {
                     break;
                 }
             }
-            if (i + 3 < N) {
-                i++;
+            if (j < N) {
+                break;
             }
         }
-        printf("decode average:      "
-            " %.3e clocks %.3e sec %.3e bytes/sec\n",
-            (double)tclk, (double)tclk/CLOCKS_PER_SEC,
-            tbytes * (double)CLOCKS_PER_SEC /
-                ((double)tclk > 0 ? (double)tclk : 1e-10));
-        return 0;
+        if (i + 3 < N) {
+            i++;
+        }
     }
+    printf("decode average:      "
+        " %.3e clocks %.3e sec %.3e bytes/sec\n",
+        (double)tclk, (double)tclk/CLOCKS_PER_SEC,
+        tbytes * (double)CLOCKS_PER_SEC /
+            ((double)tclk > 0 ? (double)tclk : 1e-10));
+    return 0;
+}
+
+static int
+test(int N, int BLOCKSIZE)
+{
+    int i, j, k, n;
+    const char* const kernel = rs_get_kernel_name();
+
+    for (i = 0; i < N+3; i++)
+        memset(data[i], 0, BLOCKSIZE);
 
     for (n = 0; n < 17; n++) {
         if (n > 0) {
@@ -154,6 +136,20 @@ int main(int argc, char **argv)
 
         rs_encode(N+3, BLOCKSIZE, data);
 
+        // Compare parity with the one produced by the base kernel.
+        for (i = 0; i < N+3; i++)
+            memmove(check[i], data[i], BLOCKSIZE);
+        if (rs_set_kernel("base") != 0) {
+            printf("FAILED: no base kernel\n");
+            return 1;
+        }
+        rs_encode(N+3, BLOCKSIZE, check);
+        if (rs_set_kernel(kernel) != 0 ||
+                compare(N+3, BLOCKSIZE, data, check) != 0) {
+            printf("FAILED: %d %s encode mismatch with base\n", n, kernel);
+            return 1;
+        }
+
         for (i = 0; i < N+3; i++)
             memmove(orig[i], data[i], BLOCKSIZE);
 
@@ -197,6 +193,64 @@ int main(int argc, char **argv)
                 }
             }
     }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
+        printf("Usage: %s [data blocks] [block size] [perf iterations]"
+                " [kernel]\n"
+               "       This tests the Reed Solomon encoder and decoder.\n"
+               "       0 < data blocks <= %d.\n"
+               "       Use perf iterations for performance test.\n"
+               "       0 perf iterations runs correctness test.\n"
+               "       Defaults: data blocks=%d, block size=%d,"
+                " all supported kernels\n", argv[0],
+               RS_LIB_MAX_DATA_BLOCKS, RS_LIB_MAX_DATA_BLOCKS, (64 << 10));
+        exit(0);
+    }
+
+    int i, n, err;
+    const char* kernel;
+    const int N = argc > 1 ? atoi(argv[1]) : RS_LIB_MAX_DATA_BLOCKS;
+    const int BLOCKSIZE = argc > 2 ? atoi(argv[2]) : (64 << 10);
+    const int ITERATIONS = argc > 3 ? atoi(argv[3]) : 0;
+
+    if (N <= 0 || N > RS_LIB_MAX_DATA_BLOCKS) {
+        printf("0 < data blocks <= %d\n", RS_LIB_MAX_DATA_BLOCKS);
+        return 1;
+    }
+    if (argc > 4 && rs_set_kernel(argv[4]) != 0) {
+        printf("kernel %s is not supported; supported kernels:", argv[4]);
+        for (i = 0; (kernel = rs_get_supported_kernel_name(i)); i++)
+            printf(" %s", kernel);
+        printf("\n");
+        return 1;
+    }
+
+    for (i = 0; i < N+3; i++) {
+        if ((err = posix_memalign(data + i, 16, BLOCKSIZE)) ||
+                (err = posix_memalign(orig + i, 16, BLOCKSIZE)) ||
+                (err = posix_memalign(check + i, 16, BLOCKSIZE))) {
+            printf("%s\n", strerror(err));
+            return 1;
+        }
+    }
+
+    for (n = 0; (kernel = argc > 4 ? (n == 0 ? argv[4] : 0) :
+            rs_get_supported_kernel_name(n)); n++) {
+        if (rs_set_kernel(kernel) != 0)
+            return 1;
+        printf("kernel: %s\n", kernel);
+        if (ITERATIONS > 0) {
+            srand(1);
+            if (perf_test(N, BLOCKSIZE, ITERATIONS) != 0)
+                return 1;
+        } else if (test(N, BLOCKSIZE) != 0) {
+            return 1;
+        }
+    }
     printf("PASS\n");
     return 0;
 }
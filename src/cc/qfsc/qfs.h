@@ -23,6 +23,7 @@ extern "C" {
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 // TODO(sday): Add size checks at compile for size of off_t, size_t, ssize_t,
 // uid_t, gid_t and mode_t to ensure they match qfs. We're not going to add a
@@ -251,6 +252,83 @@ extern "C" {
   // file position.
   ssize_t qfs_pwrite(struct QFS* qfs, int fd, const void *buf, size_t len, off_t offset);
 
+  // qfs_preadv reads into the iovcnt buffers described by iov, starting at
+  // offset, without updating the current file position. The buffers are
+  // read concurrently. Returns the total number of bytes read, which is
+  // less than the total buffers size only at the end of file.
+  ssize_t qfs_preadv(struct QFS* qfs, int fd, const struct iovec* iov, int iovcnt, off_t offset);
+
+  // qfs_pwritev writes the iovcnt buffers described by iov, starting at
+  // offset, without updating the current file position. The buffers are
+  // written concurrently. Returns the total number of bytes written.
+  ssize_t qfs_pwritev(struct QFS* qfs, int fd, const struct iovec* iov, int iovcnt, off_t offset);
+
+  // qfs_cq is an opaque asynchronous io completion queue.
+  struct qfs_cq;
+
+  // qfs_completion describes a completed asynchronous io request. status is
+  // the number of bytes read or written, or a negative error code.
+  struct qfs_completion {
+    int      fd;
+    off_t    offset;
+    void*    buf;
+    ssize_t  status;
+    void*    user;
+  };
+
+  // qfs_cq_create creates a completion queue for the asynchronous io
+  // requests submitted with the given QFS handle. Returns NULL on error.
+  struct qfs_cq* qfs_cq_create(struct QFS* qfs);
+
+  // qfs_cq_release waits for all outstanding requests to complete, and
+  // releases the completion queue.
+  void qfs_cq_release(struct qfs_cq* cq);
+
+  // qfs_cq_fd returns a file descriptor that is readable while the queue has
+  // completions, for integration with poll, epoll, or other event loops. The
+  // descriptor must not be read from, or closed by the caller.
+  int qfs_cq_fd(struct qfs_cq* cq);
+
+  // qfs_cq_pending returns the number of requests submitted into the queue
+  // that were not yet retrieved with qfs_cq_poll.
+  int qfs_cq_pending(struct qfs_cq* cq);
+
+  // qfs_cq_poll retrieves up to max completions. Waits for at least one
+  // completion for up to timeout_ms milliseconds, 0 means do not wait, and
+  // negative value means wait indefinitely. Returns the number of
+  // completions retrieved.
+  int qfs_cq_poll(struct qfs_cq* cq, struct qfs_completion* completions, int max, int timeout_ms);
+
+  // qfs_aread submits asynchronous read of up to len bytes from fd at offset
+  // into buf. The file position is not used nor updated. The buffer must not
+  // be released, and the file must not be closed until the request
+  // completion is retrieved from the queue. Returns the number of bytes
+  // queued, the read is truncated to the end of file; 0 at or past the end
+  // of file, or a negative error code. No completion is queued if the
+  // return value is not positive.
+  ssize_t qfs_aread(struct QFS* qfs, struct qfs_cq* cq, int fd, void* buf, size_t len, off_t offset, void* user);
+
+  // qfs_awrite submits asynchronous write of len bytes from buf into fd at
+  // offset. The semantics are similar to that of qfs_aread. The completion
+  // reports that the data was transferred to the chunk servers.
+  ssize_t qfs_awrite(struct QFS* qfs, struct qfs_cq* cq, int fd, const void* buf, size_t len, off_t offset, void* user);
+
+  // qfs_read_files_callback is invoked by qfs_read_files once per path, from
+  // the qfs_read_files caller thread. index is the path index, buf is only
+  // valid until the callback returns, and status is the number of bytes read,
+  // or a negative error code.
+  typedef void (*qfs_read_files_callback)(void* user, size_t index,
+    const char* path, const void* buf, ssize_t status);
+
+  // qfs_read_files reads the count whole files with up to max_pending files
+  // read concurrently. The file attributes are retrieved with the batched
+  // meta server lookups. Files larger than max_file_size fail with -EFBIG.
+  // Returns 0 if all files were read successfully, or the first negative
+  // error code.
+  int qfs_read_files(struct QFS* qfs, const char** paths, size_t count,
+    int max_pending, off_t max_file_size, qfs_read_files_callback callback,
+    void* user);
+
   // qfs_set_skipholes instructs the client to skip holes when reading fd.
   void qfs_set_skipholes(struct QFS* qfs, int fd);
 
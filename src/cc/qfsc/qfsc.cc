@@ -1,16 +1,24 @@
 
 #include "libclient/KfsClient.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
 #include "qfs.h"
 
 #include <vector>
+#include <deque>
+#include <map>
 #include <algorithm>
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <fcntl.h> // Required for calls to Read
 
 using std::string;
 using std::vector;
+using std::deque;
+using std::multimap;
+using std::make_pair;
 
 using namespace KFS;
 
@@ -357,6 +365,317 @@ ssize_t qfs_pwrite(struct QFS* qfs, int fd, const void* buf, size_t len, off_t o
   return qfs->client.PWrite(fd, offset, (char*) buf, len);
 }
 
+// qfs_iov_completion waits for the completion of the asynchronous requests
+// issued by the vectored io calls, and records the status of each buffer.
+class qfs_iov_completion : public KfsClient::IoCompletion {
+public:
+  qfs_iov_completion(const struct iovec* iov, int iovcnt)
+    : KfsClient::IoCompletion(),
+      mutex(),
+      cond(),
+      iov(iov),
+      status(iovcnt, 0),
+      pending(0) {
+  }
+  void issued() {
+    QCStMutexLocker locker(mutex);
+    pending++;
+  }
+  void wait() {
+    QCStMutexLocker locker(mutex);
+    while (0 < pending) {
+      cond.Wait(mutex);
+    }
+  }
+  ssize_t& get_status(int i) {
+    return status[i];
+  }
+  virtual void Done(int fd, chunkOff_t pos, char* buf, ssize_t res) {
+    QCStMutexLocker locker(mutex);
+    for (size_t i = 0; i < status.size(); i++) {
+      if (iov[i].iov_base == buf) {
+        status[i] = res;
+        break;
+      }
+    }
+    if (--pending <= 0) {
+      cond.Notify();
+    }
+  }
+private:
+  QCMutex             mutex;
+  QCCondVar           cond;
+  const struct iovec* iov;
+  vector<ssize_t>     status;
+  int                 pending;
+};
+
+static ssize_t qfs_iov_io(struct QFS* qfs, int fd,
+  const struct iovec* iov, int iovcnt, off_t offset, bool read_flag) {
+
+  if (iovcnt < 0 || (0 < iovcnt && !iov)) {
+    return -EINVAL;
+  }
+  qfs_iov_completion completion(iov, iovcnt);
+  off_t pos = offset;
+  for (int i = 0; i < iovcnt; i++) {
+    if (iov[i].iov_len <= 0) {
+      continue;
+    }
+    completion.issued();
+    const ssize_t res = read_flag ?
+      qfs->client.ReadAsync(fd, pos, (char*)iov[i].iov_base,
+        iov[i].iov_len, completion) :
+      qfs->client.WriteAsync(fd, pos, (const char*)iov[i].iov_base,
+        iov[i].iov_len, completion);
+    if (res <= 0) {
+      // No completion for the request that was not queued.
+      // End of file, nothing more to read, or error.
+      completion.Done(fd, pos, (char*)iov[i].iov_base, res);
+      break;
+    }
+    pos += iov[i].iov_len;
+  }
+  completion.wait();
+  // Return the data up to the first error or short read.
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    const ssize_t res = completion.get_status(i);
+    if (res < 0) {
+      return (total > 0 ? total : res);
+    }
+    total += res;
+    if ((size_t)res < iov[i].iov_len) {
+      break;
+    }
+  }
+  return total;
+}
+
+ssize_t qfs_preadv(struct QFS* qfs, int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+  return qfs_iov_io(qfs, fd, iov, iovcnt, offset, true);
+}
+
+ssize_t qfs_pwritev(struct QFS* qfs, int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+  return qfs_iov_io(qfs, fd, iov, iovcnt, offset, false);
+}
+
+// qfs_cq queues the completions of the asynchronous requests, and signals
+// the completions availability with a non blocking pipe, in order to wake up
+// the caller's event loop.
+struct qfs_cq : public KfsClient::IoCompletion {
+  struct request {
+    int   fd;
+    off_t offset;
+    void* user;
+  };
+  typedef multimap<const void*, request> requests;
+
+  QCMutex                      mutex;
+  QCCondVar                    cond;
+  requests                     outstanding;
+  deque<struct qfs_completion> done;
+  int                          pipefd[2];
+
+  qfs_cq()
+    : KfsClient::IoCompletion(),
+      mutex(),
+      cond(),
+      outstanding(),
+      done() {
+    pipefd[0] = -1;
+    pipefd[1] = -1;
+  }
+  ~qfs_cq() {
+    for (int i = 0; i < 2; i++) {
+      if (0 <= pipefd[i]) {
+        close(pipefd[i]);
+      }
+    }
+  }
+  int init() {
+    if (pipe(pipefd) != 0) {
+      return -errno;
+    }
+    for (int i = 0; i < 2; i++) {
+      const int flags = fcntl(pipefd[i], F_GETFL, 0);
+      if (flags == -1 ||
+          fcntl(pipefd[i], F_SETFL, flags | O_NONBLOCK) == -1 ||
+          fcntl(pipefd[i], F_SETFD, FD_CLOEXEC) == -1) {
+        return -errno;
+      }
+    }
+    return 0;
+  }
+  void add(int fd, off_t offset, const void* buf, void* user) {
+    request req;
+    req.fd     = fd;
+    req.offset = offset;
+    req.user   = user;
+    QCStMutexLocker locker(mutex);
+    outstanding.insert(make_pair(buf, req));
+  }
+  void* remove(int fd, off_t offset, const void* buf) {
+    std::pair<requests::iterator, requests::iterator> const range =
+      outstanding.equal_range(buf);
+    for (requests::iterator it = range.first; it != range.second; ++it) {
+      if (it->second.fd == fd && it->second.offset == offset) {
+        void* const user = it->second.user;
+        outstanding.erase(it);
+        return user;
+      }
+    }
+    return 0;
+  }
+  void cancel(int fd, off_t offset, const void* buf) {
+    QCStMutexLocker locker(mutex);
+    remove(fd, offset, buf);
+    if (outstanding.empty()) {
+      cond.NotifyAll();
+    }
+  }
+  virtual void Done(int fd, chunkOff_t pos, char* buf, ssize_t status) {
+    QCStMutexLocker locker(mutex);
+    struct qfs_completion c;
+    c.fd     = fd;
+    c.offset = (off_t)pos;
+    c.buf    = buf;
+    c.status = status;
+    c.user   = remove(fd, (off_t)pos, buf);
+    if (done.empty()) {
+      const char b = 0;
+      // The pipe can only be full if the reader doesn't drain it, and
+      // therefore it is already readable.
+      if (write(pipefd[1], &b, 1) < 0) {
+        // Ignore EAGAIN.
+      }
+    }
+    done.push_back(c);
+    cond.NotifyAll();
+  }
+  void drain() {
+    char buf[64];
+    while (0 < read(pipefd[0], buf, sizeof(buf)))
+      {}
+  }
+};
+
+struct qfs_cq* qfs_cq_create(struct QFS* qfs) {
+  if (!qfs) {
+    return NULL;
+  }
+  struct qfs_cq* cq = new qfs_cq();
+  if (cq->init() != 0) {
+    delete cq;
+    return NULL;
+  }
+  return cq;
+}
+
+void qfs_cq_release(struct qfs_cq* cq) {
+  if (!cq) {
+    return;
+  }
+  {
+    QCStMutexLocker locker(cq->mutex);
+    while (!cq->outstanding.empty()) {
+      cq->cond.Wait(cq->mutex);
+    }
+  }
+  delete cq;
+}
+
+int qfs_cq_fd(struct qfs_cq* cq) {
+  return cq->pipefd[0];
+}
+
+int qfs_cq_pending(struct qfs_cq* cq) {
+  QCStMutexLocker locker(cq->mutex);
+  return (int)(cq->outstanding.size() + cq->done.size());
+}
+
+int qfs_cq_poll(struct qfs_cq* cq, struct qfs_completion* completions, int max, int timeout_ms) {
+  if (!cq || !completions || max <= 0) {
+    return -EINVAL;
+  }
+  QCStMutexLocker locker(cq->mutex);
+  if (cq->done.empty() && timeout_ms != 0 && !cq->outstanding.empty()) {
+    if (timeout_ms < 0) {
+      while (cq->done.empty() && !cq->outstanding.empty()) {
+        cq->cond.Wait(cq->mutex);
+      }
+    } else {
+      cq->cond.Wait(cq->mutex, (QCMutex::Time)timeout_ms * 1000 * 1000);
+    }
+  }
+  int n = 0;
+  while (n < max && !cq->done.empty()) {
+    completions[n++] = cq->done.front();
+    cq->done.pop_front();
+  }
+  if (cq->done.empty()) {
+    cq->drain();
+  }
+  return n;
+}
+
+ssize_t qfs_aread(struct QFS* qfs, struct qfs_cq* cq, int fd, void* buf, size_t len, off_t offset, void* user) {
+  if (!cq) {
+    return -EINVAL;
+  }
+  // Register prior to submission, as the completion might be invoked
+  // before the submission returns.
+  cq->add(fd, offset, buf, user);
+  const ssize_t res = qfs->client.ReadAsync(fd, offset, (char*)buf, len, *cq);
+  if (res <= 0) {
+    cq->cancel(fd, offset, buf);
+  }
+  return res;
+}
+
+ssize_t qfs_awrite(struct QFS* qfs, struct qfs_cq* cq, int fd, const void* buf, size_t len, off_t offset, void* user) {
+  if (!cq) {
+    return -EINVAL;
+  }
+  cq->add(fd, offset, buf, user);
+  const ssize_t res = qfs->client.WriteAsync(fd, offset, (const char*)buf, len, *cq);
+  if (res <= 0) {
+    cq->cancel(fd, offset, buf);
+  }
+  return res;
+}
+
+struct qfs_read_files_completion : public KfsClient::ReadFilesCompletion {
+  qfs_read_files_callback callback;
+  void*                   user;
+
+  qfs_read_files_completion(qfs_read_files_callback callback, void* user)
+    : KfsClient::ReadFilesCompletion(),
+      callback(callback),
+      user(user) {
+  }
+  virtual void Done(size_t index, const string& path, const char* buf,
+      ssize_t status) {
+    callback(user, index, path.c_str(), buf, status);
+  }
+};
+
+int qfs_read_files(struct QFS* qfs, const char** paths, size_t count,
+    int max_pending, off_t max_file_size, qfs_read_files_callback callback,
+    void* user) {
+  if (!callback || (0 < count && !paths)) {
+    return -EINVAL;
+  }
+  vector<string> pathnames;
+  pathnames.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    pathnames.push_back(paths[i] ? paths[i] : "");
+  }
+  qfs_read_files_completion completion(callback, user);
+  return qfs->client.ReadFiles(pathnames, completion, max_pending,
+    max_file_size);
+}
+
 void qfs_set_skipholes(struct QFS* qfs, int fd) {
   qfs->client.SkipHolesInFile(fd);
 }
@@ -301,6 +301,50 @@ static char* test_qfs_pread() {
   return 0;
 }
 
+static char* test_qfs_preadv() {
+  ssize_t chunksize = qfs_get_chunksize(qfs, "/unit-test/file");
+  ssize_t res;
+  char buf[2][4096];
+  memset(buf, 0, sizeof(buf));
+  struct iovec iov[2];
+  iov[0].iov_base = buf[0];
+  iov[0].iov_len  = 4;
+  iov[1].iov_base = buf[1];
+  iov[1].iov_len  = sizeof(buf[1]);
+  check_qfs_call(res = qfs_preadv(qfs, fd, iov, 2, chunksize*2));
+  check(res == (ssize_t)strlen(testdata),
+    "all expected data should be read: %ld != %ld",
+    (long)res, (long)strlen(testdata));
+  check(memcmp(buf[0], testdata, 4) == 0 &&
+    strcmp(buf[1], testdata + 4) == 0, "expected data should be read");
+
+  return 0;
+}
+
+static char* test_qfs_aread() {
+  ssize_t chunksize = qfs_get_chunksize(qfs, "/unit-test/file");
+  ssize_t res;
+  char buf[4096];
+  memset(buf, 0, sizeof(buf));
+  struct qfs_cq* cq = qfs_cq_create(qfs);
+  check(cq, "completion queue should be non null");
+  check(qfs_cq_fd(cq) >= 0, "completion queue fd should be valid");
+  check_qfs_call(res = qfs_aread(qfs, cq, fd, buf, sizeof(buf),
+    chunksize*2, buf));
+  check(res == (ssize_t)strlen(testdata),
+    "read should be truncated to eof: %ld", (long)res);
+  struct qfs_completion c;
+  check(qfs_cq_poll(cq, &c, 1, -1) == 1, "one completion expected");
+  check(c.user == buf && c.buf == buf && c.status == res,
+    "unexpected completion: %ld", (long)c.status);
+  check(strcmp(buf, testdata) == 0,
+    "expected data should be read: %s != %s", buf, testdata);
+  check(qfs_cq_pending(cq) == 0, "no pending requests expected");
+  qfs_cq_release(cq);
+
+  return 0;
+}
+
 static char* test_qfs_get_data_locations() {
   check_qfs_call(qfs_close(qfs, fd)); // shut it down
   struct qfs_iter* iter = NULL;
@@ -366,6 +410,8 @@ static char * all_tests() {
   run(test_qfs_close);
   run(test_qfs_open);
   run(test_qfs_pread);
+  run(test_qfs_preadv);
+  run(test_qfs_aread);
   run(test_qfs_get_data_locations);
   run(test_qfs_cleanup);
   run(test_qfs_release);
@@ -0,0 +1,524 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Object store block read cache implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "S3BlockCache.h"
+
+#include "common/MsgLogger.h"
+#include "qcdio/QCUtils.h"
+#include "qcdio/qcstutils.h"
+#include "qcdio/qcdebug.h"
+#include "kfsio/IOBuffer.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+namespace KFS
+{
+using std::min;
+using std::max;
+using std::make_pair;
+
+typedef map<string, S3BlockCache*> S3BlockCacheMap;
+
+const int kS3BlockCacheMaxIoVecCount = 256;
+
+    static QCMutex&
+GetS3BlockCacheMutex()
+{
+    static QCMutex sMutex;
+    return sMutex;
+}
+
+// Force initialization before entering main.
+static QCMutex& sS3BlockCacheMutex = GetS3BlockCacheMutex();
+
+    static S3BlockCacheMap&
+GetS3BlockCacheMap()
+{
+    static S3BlockCacheMap sMap;
+    return sMap;
+}
+
+    static bool
+S3BlockCacheRead(
+    int       inFd,
+    int64_t   inOffset,
+    int64_t   inLength,
+    IOBuffer& inBuffer)
+{
+    int64_t              theOffset = inOffset;
+    int64_t              theRem    = inLength;
+    vector<IOBufferData> theData;
+    struct iovec         theIoVec[kS3BlockCacheMaxIoVecCount];
+    theData.reserve(kS3BlockCacheMaxIoVecCount);
+    while (0 < theRem) {
+        int     theCnt  = 0;
+        int64_t theSize = 0;
+        theData.clear();
+        while (theCnt < kS3BlockCacheMaxIoVecCount && theSize < theRem) {
+            theData.push_back(IOBufferData());
+            const int theLen = (int)min(
+                int64_t(theData[theCnt].SpaceAvailable()), theRem - theSize);
+            theIoVec[theCnt].iov_base = theData[theCnt].Producer();
+            theIoVec[theCnt].iov_len  = theLen;
+            theSize += theLen;
+            theCnt++;
+        }
+        const ssize_t theNRd = preadv(inFd, theIoVec, theCnt, theOffset);
+        if (theNRd != theSize) {
+            KFS_LOG_STREAM_ERROR <<
+                "s3 block cache: read error:"
+                " pos: "    << theOffset <<
+                " size: "   << theSize <<
+                " status: " << theNRd <<
+                " "         << (theNRd < 0 ?
+                    QCUtils::SysError(errno) : string("short read")) <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        for (int i = 0; i < theCnt; i++) {
+            theData[i].Fill((int)theIoVec[i].iov_len);
+            inBuffer.Append(theData[i]);
+        }
+        theOffset += theSize;
+        theRem    -= theSize;
+    }
+    return true;
+}
+
+    static bool
+S3BlockCacheWrite(
+    int       inFd,
+    int64_t   inOffset,
+    IOBuffer& inBuffer,
+    int       inLength)
+{
+    int64_t            theOffset = inOffset;
+    int                theRem    = inLength;
+    IOBuffer::iterator theIt     = inBuffer.begin();
+    struct iovec       theIoVec[kS3BlockCacheMaxIoVecCount];
+    while (0 < theRem) {
+        int theCnt  = 0;
+        int theSize = 0;
+        while (theCnt < kS3BlockCacheMaxIoVecCount && theSize < theRem &&
+                inBuffer.end() != theIt) {
+            const int theLen = min(theIt->BytesConsumable(), theRem - theSize);
+            if (0 < theLen) {
+                theIoVec[theCnt].iov_base =
+                    const_cast<char*>(theIt->Consumer());
+                theIoVec[theCnt].iov_len  = theLen;
+                theSize += theLen;
+                theCnt++;
+            }
+            ++theIt;
+        }
+        if (theCnt <= 0) {
+            return false;
+        }
+        const ssize_t theNWr = pwritev(inFd, theIoVec, theCnt, theOffset);
+        if (theNWr != theSize) {
+            KFS_LOG_STREAM_ERROR <<
+                "s3 block cache: write error:"
+                " pos: "    << theOffset <<
+                " size: "   << theSize <<
+                " status: " << theNWr <<
+                " "         << (theNWr < 0 ?
+                    QCUtils::SysError(errno) : string("short write")) <<
+            KFS_LOG_EOM;
+            return false;
+        }
+        theOffset += theSize;
+        theRem    -= theSize;
+    }
+    inBuffer.Consume(inLength);
+    return true;
+}
+
+    /* static */ S3BlockCache*
+S3BlockCache::Acquire(
+    const string& inFileName,
+    int64_t       inMaxSize,
+    int           inSegmentSize)
+{
+    QCStMutexLocker theLock(GetS3BlockCacheMutex());
+    S3BlockCacheMap&                theMap = GetS3BlockCacheMap();
+    S3BlockCacheMap::iterator const theIt  = theMap.find(inFileName);
+    if (theMap.end() != theIt) {
+        theIt->second->mRefCount++;
+        return theIt->second;
+    }
+    S3BlockCache* const thePtr =
+        new S3BlockCache(inFileName, inMaxSize, inSegmentSize);
+    const int theErr = thePtr->Open();
+    if (0 != theErr) {
+        KFS_LOG_STREAM_ERROR <<
+            "s3 block cache: " << inFileName <<
+            ": " << QCUtils::SysError(theErr) <<
+        KFS_LOG_EOM;
+        delete thePtr;
+        return 0;
+    }
+    KFS_LOG_STREAM_INFO <<
+        "s3 block cache: " << inFileName <<
+        " size: "          << thePtr->mMaxSlotCount * thePtr->mSegmentSize <<
+        " segment size: "  << thePtr->mSegmentSize <<
+    KFS_LOG_EOM;
+    thePtr->mRefCount++;
+    theMap.insert(make_pair(inFileName, thePtr));
+    return thePtr;
+}
+
+    /* static */ void
+S3BlockCache::Release(
+    S3BlockCache* inCachePtr)
+{
+    if (! inCachePtr) {
+        return;
+    }
+    QCStMutexLocker theLock(GetS3BlockCacheMutex());
+    QCASSERT(0 < inCachePtr->mRefCount);
+    if (0 < --inCachePtr->mRefCount) {
+        return;
+    }
+    GetS3BlockCacheMap().erase(inCachePtr->mFileName);
+    delete inCachePtr;
+}
+
+    /* static */ bool
+S3BlockCache::GetTotalCounters(
+    S3BlockCache::Counters& outCounters)
+{
+    outCounters = Counters();
+    QCStMutexLocker theLock(GetS3BlockCacheMutex());
+    S3BlockCacheMap& theMap = GetS3BlockCacheMap();
+    for (S3BlockCacheMap::const_iterator theIt = theMap.begin();
+            theMap.end() != theIt;
+            ++theIt) {
+        Counters theCounters;
+        theIt->second->GetCounters(theCounters);
+        outCounters.Add(theCounters);
+    }
+    return (! theMap.empty());
+}
+
+S3BlockCache::S3BlockCache(
+    const string& inFileName,
+    int64_t       inMaxSize,
+    int           inSegmentSize)
+    : mFileName(inFileName),
+      mMaxSlotCount(max(int64_t(0), inMaxSize) / max(1, inSegmentSize)),
+      mSegmentSize((max(1, inSegmentSize) +
+            IOBufferData::GetDefaultBufferSize() - 1) /
+        IOBufferData::GetDefaultBufferSize() *
+        IOBufferData::GetDefaultBufferSize()),
+      mFd(-1),
+      mRefCount(0),
+      mMutex(),
+      mMap(),
+      mFreeSlots(),
+      mSlotCount(0),
+      mCounters()
+{
+    List::Init(mLru);
+}
+
+S3BlockCache::~S3BlockCache()
+{
+    QCASSERT(0 == mRefCount);
+    if (0 <= mFd) {
+        close(mFd);
+    }
+}
+
+    int
+S3BlockCache::Open()
+{
+    if (mMaxSlotCount <= 0) {
+        return EINVAL;
+    }
+    // The index is not persistent, truncate the file in order to release the
+    // space.
+    mFd = open(mFileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (mFd < 0) {
+        const int theErr = errno;
+        return (0 == theErr ? EIO : theErr);
+    }
+    return 0;
+}
+
+    bool
+S3BlockCache::Get(
+    const string& inKey,
+    int64_t       inPos,
+    int           inLength,
+    IOBuffer&     outBuffer)
+{
+    if (inPos < 0 || inLength <= 0) {
+        return false;
+    }
+    int64_t const   theEnd     = inPos + inLength;
+    int64_t         theDataEnd = theEnd;
+    Entries         theEntries;
+    QCStMutexLocker theLock(mMutex);
+    for (int64_t theIdx = inPos / mSegmentSize;
+            theIdx * mSegmentSize < theEnd;
+            theIdx++) {
+        Map::iterator const theIt = mMap.find(Key(inKey, theIdx));
+        if (mMap.end() == theIt || ! theIt->second.mValidFlag) {
+            mCounters.mMissCount++;
+            mCounters.mMissByteCount += inLength;
+            return false;
+        }
+        Entry& theEntry = theIt->second;
+        theEntries.push_back(&theEntry);
+        if (theEntry.mLength < mSegmentSize) {
+            theDataEnd = min(theEnd, theIdx * mSegmentSize + theEntry.mLength);
+            break;
+        }
+    }
+    for (Entries::const_iterator theIt = theEntries.begin();
+            theEntries.end() != theIt;
+            ++theIt) {
+        (*theIt)->mPinCount++;
+        List::PushBack(mLru, **theIt);
+    }
+    theLock.Unlock();
+    IOBuffer theBuf;
+    int64_t  thePos = inPos;
+    bool     theOkFlag = true;
+    for (Entries::const_iterator theIt = theEntries.begin();
+            theEntries.end() != theIt && theOkFlag;
+            ++theIt) {
+        const Entry&  theEntry    = **theIt;
+        int64_t const theSegStart = theEntry.mKey.second * mSegmentSize;
+        int64_t const theSegEnd   =
+            min(theDataEnd, theSegStart + theEntry.mLength);
+        if (thePos < theSegEnd) {
+            theOkFlag = S3BlockCacheRead(
+                mFd,
+                theEntry.mSlot * mSegmentSize + (thePos - theSegStart),
+                theSegEnd - thePos,
+                theBuf
+            );
+            thePos = theSegEnd;
+        }
+    }
+    QCStMutexLocker theUnpinLock(mMutex);
+    for (Entries::const_iterator theIt = theEntries.begin();
+            theEntries.end() != theIt;
+            ++theIt) {
+        Unpin(**theIt, theOkFlag);
+    }
+    if (! theOkFlag) {
+        mCounters.mErrorCount++;
+        mCounters.mMissCount++;
+        mCounters.mMissByteCount += inLength;
+        return false;
+    }
+    mCounters.mHitCount++;
+    mCounters.mHitByteCount += theBuf.BytesConsumable();
+    outBuffer.Move(&theBuf);
+    return true;
+}
+
+    void
+S3BlockCache::Put(
+    const string&   inKey,
+    int64_t         inPos,
+    int             inLength,
+    const IOBuffer& inBuffer)
+{
+    if (inPos < 0 || inLength <= 0 || mFd < 0) {
+        return;
+    }
+    int  const    theBufLen  = inBuffer.BytesConsumable();
+    bool const    theEofFlag = theBufLen < inLength;
+    int64_t const theDataEnd = inPos + min(theBufLen, inLength);
+    // Only the segments that are fully covered by the data, or the segment
+    // that contains the block end can be cached.
+    Entries         theEntries;
+    QCStMutexLocker theLock(mMutex);
+    for (int64_t theIdx = (inPos + mSegmentSize - 1) / mSegmentSize; ;
+            theIdx++) {
+        int64_t const theSegStart = theIdx * mSegmentSize;
+        if (theDataEnd < theSegStart ||
+                (theDataEnd == theSegStart && ! theEofFlag)) {
+            break;
+        }
+        int const theLen = (int)min(int64_t(mSegmentSize),
+            theDataEnd - theSegStart);
+        if (theLen < mSegmentSize && ! theEofFlag) {
+            break;
+        }
+        const Key     theKey(inKey, theIdx);
+        Map::iterator theIt = mMap.find(theKey);
+        if (mMap.end() == theIt) {
+            int64_t theSlot = -1;
+            if (0 < theLen && ! AllocateSlot(theSlot)) {
+                break;
+            }
+            theIt = mMap.insert(make_pair(theKey, Entry())).first;
+            Entry& theEntry = theIt->second;
+            List::Init(theEntry);
+            theEntry.mKey      = theKey;
+            theEntry.mSlot     = theSlot;
+            theEntry.mLength   = theLen;
+            theEntry.mPinCount = 1;
+            List::PushBack(mLru, theEntry);
+            theEntries.push_back(&theEntry);
+        }
+        if (theLen < mSegmentSize) {
+            break;
+        }
+    }
+    if (theEntries.empty()) {
+        return;
+    }
+    theLock.Unlock();
+    IOBuffer theBuf;
+    theBuf.Copy(&inBuffer, theBufLen);
+    int64_t thePos    = inPos;
+    bool    theOkFlag = true;
+    for (Entries::const_iterator theIt = theEntries.begin();
+            theEntries.end() != theIt && theOkFlag;
+            ++theIt) {
+        const Entry&  theEntry    = **theIt;
+        int64_t const theSegStart = theEntry.mKey.second * mSegmentSize;
+        if (thePos < theSegStart) {
+            theBuf.Consume((int)(theSegStart - thePos));
+            thePos = theSegStart;
+        }
+        if (0 < theEntry.mLength) {
+            theOkFlag = S3BlockCacheWrite(mFd, theEntry.mSlot * mSegmentSize,
+                theBuf, theEntry.mLength);
+            thePos += theEntry.mLength;
+        }
+    }
+    theBuf.Clear();
+    QCStMutexLocker theUnpinLock(mMutex);
+    for (Entries::const_iterator theIt = theEntries.begin();
+            theEntries.end() != theIt;
+            ++theIt) {
+        if (theOkFlag) {
+            mCounters.mInsertCount++;
+            mCounters.mInsertByteCount += (*theIt)->mLength;
+        }
+        Unpin(**theIt, theOkFlag);
+    }
+    if (! theOkFlag) {
+        mCounters.mErrorCount++;
+    }
+}
+
+    void
+S3BlockCache::Invalidate(
+    const string& inKey)
+{
+    QCStMutexLocker theLock(mMutex);
+    Map::iterator theIt = mMap.lower_bound(Key(inKey, 0));
+    while (mMap.end() != theIt && theIt->first.first == inKey) {
+        mCounters.mInvalidateCount++;
+        if (0 < theIt->second.mPinCount) {
+            theIt->second.mValidFlag   = false;
+            theIt->second.mInvalidFlag = true;
+            ++theIt;
+        } else {
+            Erase(theIt++);
+        }
+    }
+}
+
+    bool
+S3BlockCache::AllocateSlot(
+    int64_t& outSlot)
+{
+    if (mFreeSlots.empty()) {
+        if (mSlotCount < mMaxSlotCount) {
+            outSlot = mSlotCount++;
+            return true;
+        }
+        // Evict least recently used segments, until a slot becomes available.
+        List::Iterator theIt(mLru);
+        Entry*         thePtr;
+        while (mFreeSlots.empty() && (thePtr = theIt.Next())) {
+            if (0 < thePtr->mPinCount) {
+                continue;
+            }
+            mCounters.mEvictCount++;
+            Erase(mMap.find(thePtr->mKey));
+        }
+        if (mFreeSlots.empty()) {
+            return false;
+        }
+    }
+    outSlot = mFreeSlots.back();
+    mFreeSlots.pop_back();
+    return true;
+}
+
+    void
+S3BlockCache::Erase(
+    S3BlockCache::Map::iterator inIt)
+{
+    QCASSERT(mMap.end() != inIt && 0 == inIt->second.mPinCount);
+    List::Remove(mLru, inIt->second);
+    if (0 <= inIt->second.mSlot) {
+        mFreeSlots.push_back(inIt->second.mSlot);
+    }
+    mMap.erase(inIt);
+}
+
+    void
+S3BlockCache::Unpin(
+    S3BlockCache::Entry& inEntry,
+    bool                 inValidFlag)
+{
+    QCASSERT(0 < inEntry.mPinCount);
+    if (! inValidFlag) {
+        inEntry.mInvalidFlag = true;
+    }
+    inEntry.mValidFlag = ! inEntry.mInvalidFlag;
+    if (0 < --inEntry.mPinCount || inEntry.mValidFlag) {
+        return;
+    }
+    Erase(mMap.find(inEntry.mKey));
+}
+
+    void
+S3BlockCache::GetCounters(
+    S3BlockCache::Counters& outCounters)
+{
+    QCStMutexLocker theLock(mMutex);
+    outCounters = mCounters;
+    outCounters.mSize     =
+        (mSlotCount - (int64_t)mFreeSlots.size()) * mSegmentSize;
+    outCounters.mCapacity = mMaxSlotCount * mSegmentSize;
+}
+
+} // namespace KFS
@@ -0,0 +1,213 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// Chunk server local read cache of object store blocks. The cache is stored
+// in a single file, presumably on SSD, divided into fixed size segments.
+// Object store block keys include the block version, and the blocks are
+// immutable once written, therefore the block key and segment index are
+// sufficient to identify the cached data. Each segment contains up to the
+// segment size bytes of the block at the corresponding position. Shorter
+// segment, including empty segment, marks the block end, in order to allow
+// caching the reads that extend past the block end. The segments index is
+// kept in memory only, and the cache starts empty on every restart.
+// The least recently used segments are evicted when the cache is full. The
+// cache is thread safe, and shared by all IO method instances configured
+// with the same cache file name. The file IO is performed outside of the
+// cache mutex, the segments that are being read or written are pinned, and
+// can not be evicted.
+//
+//----------------------------------------------------------------------------
+
+#ifndef S3IO_S3_BLOCK_CACHE_H
+#define S3IO_S3_BLOCK_CACHE_H
+
+#include "common/kfstypes.h"
+#include "common/StdAllocator.h"
+#include "qcdio/QCDLList.h"
+#include "qcdio/QCMutex.h"
+
+#include <string>
+#include <map>
+#include <vector>
+#include <utility>
+
+namespace KFS
+{
+using std::string;
+using std::map;
+using std::vector;
+using std::pair;
+using std::less;
+
+class IOBuffer;
+
+class S3BlockCache
+{
+public:
+    struct Counters
+    {
+        typedef int64_t Counter;
+
+        Counters()
+            : mHitCount(0),
+              mHitByteCount(0),
+              mMissCount(0),
+              mMissByteCount(0),
+              mInsertCount(0),
+              mInsertByteCount(0),
+              mEvictCount(0),
+              mInvalidateCount(0),
+              mErrorCount(0),
+              mSize(0),
+              mCapacity(0)
+            {}
+        Counters& Add(
+            const Counters& inCounters)
+        {
+            mHitCount        += inCounters.mHitCount;
+            mHitByteCount    += inCounters.mHitByteCount;
+            mMissCount       += inCounters.mMissCount;
+            mMissByteCount   += inCounters.mMissByteCount;
+            mInsertCount     += inCounters.mInsertCount;
+            mInsertByteCount += inCounters.mInsertByteCount;
+            mEvictCount      += inCounters.mEvictCount;
+            mInvalidateCount += inCounters.mInvalidateCount;
+            mErrorCount      += inCounters.mErrorCount;
+            mSize            += inCounters.mSize;
+            mCapacity        += inCounters.mCapacity;
+            return *this;
+        }
+        Counter mHitCount;
+        Counter mHitByteCount;
+        Counter mMissCount;
+        Counter mMissByteCount;
+        Counter mInsertCount;
+        Counter mInsertByteCount;
+        Counter mEvictCount;
+        Counter mInvalidateCount;
+        Counter mErrorCount;
+        Counter mSize;
+        Counter mCapacity;
+    };
+
+    // Returns cache with the given file name, creates and opens cache if it
+    // does not exist yet. The size parameters of already existing cache are
+    // not changed. Returns 0 on failure.
+    static S3BlockCache* Acquire(
+        const string& inFileName,
+        int64_t       inMaxSize,
+        int           inSegmentSize);
+    static void Release(
+        S3BlockCache* inCachePtr);
+    // Returns false if no caches exist.
+    static bool GetTotalCounters(
+        Counters& outCounters);
+
+    // Returns true if the whole range, or the range up to the block end is in
+    // the cache, and appends the data to the buffer.
+    bool Get(
+        const string& inKey,
+        int64_t       inPos,
+        int           inLength,
+        IOBuffer&     outBuffer);
+    // Inserts the data read from the object store. The buffer shorter than
+    // the requested length means that the block ends at the buffer end.
+    void Put(
+        const string&   inKey,
+        int64_t         inPos,
+        int             inLength,
+        const IOBuffer& inBuffer);
+    void Invalidate(
+        const string& inKey);
+    const string& GetFileName() const
+        { return mFileName; }
+private:
+    typedef pair<string, int64_t> Key;
+    class Entry
+    {
+    public:
+        Entry()
+            : mKey(),
+              mSlot(-1),
+              mLength(0),
+              mPinCount(0),
+              mValidFlag(false),
+              mInvalidFlag(false)
+            { List::Init(*this); }
+        Key     mKey;
+        int64_t mSlot;
+        int     mLength;
+        int     mPinCount;
+        bool    mValidFlag;
+        bool    mInvalidFlag;
+    private:
+        Entry*  mPrevPtr[1];
+        Entry*  mNextPtr[1];
+
+        friend class QCDLListOp<Entry, 0>;
+    };
+    typedef QCDLList<Entry, 0> List;
+    typedef map<
+        Key,
+        Entry,
+        less<Key>,
+        StdFastAllocator<pair<const Key, Entry> >
+    > Map;
+    typedef vector<int64_t> Slots;
+    typedef vector<Entry*>  Entries;
+
+    string  const mFileName;
+    int64_t const mMaxSlotCount;
+    int     const mSegmentSize;
+    int           mFd;
+    int           mRefCount;
+    QCMutex       mMutex;
+    Map           mMap;
+    Slots         mFreeSlots;
+    int64_t       mSlotCount;
+    Counters      mCounters;
+    Entry*        mLru[1];
+
+    S3BlockCache(
+        const string& inFileName,
+        int64_t       inMaxSize,
+        int           inSegmentSize);
+    ~S3BlockCache();
+    int Open();
+    bool AllocateSlot(
+        int64_t& outSlot);
+    void Erase(
+        Map::iterator inIt);
+    void Unpin(
+        Entry& inEntry,
+        bool   inValidFlag);
+    void GetCounters(
+        Counters& outCounters);
+private:
+    S3BlockCache(
+        const S3BlockCache& inCache);
+    S3BlockCache& operator=(
+        const S3BlockCache& inCache);
+};
+
+} // namespace KFS
+
+#endif /* S3IO_S3_BLOCK_CACHE_H */
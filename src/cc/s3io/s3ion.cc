@@ -25,6 +25,7 @@
 //----------------------------------------------------------------------------
 
 #include "chunk/IOMethodDef.h"
+#include "S3BlockCache.h"
 
 #include "common/kfsdecls.h"
 #include "common/MsgLogger.h"
@@ -59,6 +60,7 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <algorithm>
 
 namespace KFS
@@ -66,6 +68,9 @@ namespace KFS
 
 using std::string;
 using std::vector;
+using std::deque;
+using std::pair;
+using std::make_pair;
 using std::max;
 using std::min;
 using std::lower_bound;
@@ -140,6 +145,17 @@ const S3StrToken kS3StrGetUploadsResultUploadKey(
 const S3StrToken kS3StrGetUploadsResultUploadUploadId(
     "/ListMultipartUploadsResult/Upload/UploadId");
 
+const S3StrToken kS3MDeleteStart      ("<Delete><Quiet>true</Quiet>");
+const S3StrToken kS3MDeleteEnd        ("</Delete>");
+const S3StrToken kS3MDeleteObjectStart("<Object><Key>");
+const S3StrToken kS3MDeleteObjectEnd  ("</Key></Object>");
+
+const S3StrToken kS3StrMDeleteResultErrorKey("/DeleteResult/Error/Key");
+const S3StrToken kS3StrMDeleteResultErrorCode("/DeleteResult/Error/Code");
+
+// S3 DeleteObjects request key count limit.
+const int kS3MaxDeleteBatchSize = 1000;
+
 const char* const kS3AmzSecurityTokenNamePtr        = "x-amz-security-token";
 const char* const kS3AmzServerSideEncryptionNamePtr =
     "x-amz-server-side-encryption";
@@ -193,6 +209,7 @@ public:
     {
         KFS_LOG_STREAM_DEBUG << mLogPrefix << "~S3ION" << KFS_LOG_EOM;
         S3ION::Stop();
+        S3BlockCache::Release(mCachePtr);
         delete [] mHdrBufferPtr;
         HMAC_CTX_cleanup(&mHmacCtx);
         EVP_MD_CTX_cleanup(&mMdCtx);
@@ -263,6 +280,7 @@ public:
         if (theUpdateParametersFlag) {
             SetParameters();
         }
+        StartDeleteBatches();
         QCMutex*                const kMutexPtr             = 0;
         bool                    const kWakeupAndCleanupFlag = true;
         NetManager::Dispatcher* const kDispatcherPtr        = 0;
@@ -318,6 +336,9 @@ public:
             if (0 == ++mGeneration) {
                 mGeneration++;
             }
+            if (mCachePtr && ! inReadOnlyFlag) {
+                mCachePtr->Invalidate(mFileTable[theFd].mFileName);
+            }
         }
         KFS_LOG_STREAM(0 <= theFd ?
                 MsgLogger::kLogLevelDEBUG :
@@ -449,7 +470,15 @@ public:
                     theSysErr = EINVAL;
                     break;
                 }
+                if (GetFromCache(inRequest, *theFilePtr,
+                        inStartBlockIdx, inBufferCount)) {
+                    return;
+                }
                 if (IsRunning()) {
+                    if (StartParallelGet(inRequest, inReqType, *theFilePtr,
+                            inFd, inStartBlockIdx, inBufferCount)) {
+                        return;
+                    }
                     mClient.Run(*(new S3Get(
                         *this,
                         inRequest,
@@ -813,7 +842,19 @@ public:
                     theError  = QCDiskQueue::kErrorDelete;
                     break;
                 }
-                if (IsRunning()) {
+                if (mCachePtr) {
+                    mCachePtr->Invalidate(
+                        string(inNamePtr + mFilePrefix.length()));
+                }
+                if (IsRunning() && 1 < mDeleteBatchSize) {
+                    // Batched deletes are started from ProcessAndWait(), in
+                    // order to coalesce all deletes queued by the disk queue.
+                    mPendingDeletes.push_back(make_pair(&inRequest,
+                        string(inNamePtr + mFilePrefix.length())));
+                    if ((size_t)mDeleteBatchSize <= mPendingDeletes.size()) {
+                        StartDeleteBatches();
+                    }
+                } else if (IsRunning()) {
                     mClient.Run(*(new S3Delete(
                         *this, inRequest, inReqType,
                         string(inNamePtr + mFilePrefix.length()))));
@@ -883,6 +924,10 @@ private:
         ETag     mETag;
     };
     typedef vector<MPutPart> MPutParts;
+    typedef pair<Request*, string> PendingDelete;
+    typedef vector<PendingDelete>  PendingDeletes;
+    typedef deque<PendingDelete>   PendingDeletesQueue;
+    typedef vector<string>         DeleteKeys;
 
     class File
     {
@@ -1179,7 +1224,8 @@ private:
             const char*           inQueryStringPtr             = 0,
             const char*           inUriPtr                     = 0,
             const char*           inV2QueryToSignPtr           = 0,
-            bool                  inEmitStorageClassHeaderFlag = false)
+            bool                  inEmitStorageClassHeaderFlag = false,
+            const char*           inV4ContentMd5Ptr            = 0)
         {
             if (mSentFlag) {
                 return 0;
@@ -1216,7 +1262,8 @@ private:
                     inRangeEnd,
                     inQueryStringPtr,
                     inUriPtr,
-                    inEmitStorageClassHeaderFlag
+                    inEmitStorageClassHeaderFlag,
+                    inV4ContentMd5Ptr
                 );
             }
             mOuter.mWOStream.Reset();
@@ -1365,7 +1412,8 @@ private:
             int64_t               inRangeEnd,
             const char*           inQueryStringPtr,
             const char*           inUriPtr,
-            bool                  inEmitStorageClassHeaderFlag)
+            bool                  inEmitStorageClassHeaderFlag,
+            const char*           inContentMd5Ptr)
         {
             const char* const kEmptyShaPtr    =
             "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
@@ -1515,6 +1563,9 @@ private:
             if (0 <= inContentLength) {
                 theStream << "Content-Length: " << inContentLength << "\r\n";
             }
+            if (inContentMd5Ptr && *inContentMd5Ptr) {
+                theStream << "Content-MD5: " << inContentMd5Ptr << "\r\n";
+            }
             if (inContentTypePtr && *inContentTypePtr) {
                 theStream << "Content-Type: " << inContentTypePtr << "\r\n";
             }
@@ -2128,6 +2179,207 @@ private:
             const S3Put& inPut);
     };
     friend class S3Put;
+    // S3 DeleteObjects request. Object keys that the response reports as not
+    // deleted are retried with the individual delete requests.
+    class S3MultiDelete : public S3Put
+    {
+    public:
+        S3MultiDelete(
+            Outer&          inOuter,
+            PendingDeletes& inDeletes,
+            IOBuffer&       inBody)
+            : S3Put(
+                inOuter,
+                *inDeletes.front().first,
+                QCDiskQueue::kReqTypeDelete,
+                kS3EmptyString,
+                0,
+                0,
+                -1,
+                inBody),
+              mDeletes(),
+              mFailedKeys()
+            { mDeletes.swap(inDeletes); }
+        static void WriteBody(
+            const PendingDeletes& inDeletes,
+            IOBuffer&             outBody)
+        {
+            IOBufferWriter theWriter(outBody);
+            theWriter.Write(kS3MDeleteStart);
+            for (PendingDeletes::const_iterator theIt = inDeletes.begin();
+                    inDeletes.end() != theIt;
+                    ++theIt) {
+                // Object block keys do not contain the characters that need
+                // to be escaped.
+                theWriter.Write(kS3MDeleteObjectStart);
+                theWriter.Write(theIt->second);
+                theWriter.Write(kS3MDeleteObjectEnd);
+            }
+            theWriter.Write(kS3MDeleteEnd);
+            theWriter.Close();
+        }
+        virtual ostream& Display(
+            ostream& inStream) const
+        {
+            return (inStream <<
+                reinterpret_cast<const void*>(this) <<
+                " multi delete: " << mDeletes.size() <<
+                " first: "        << (mDeletes.empty() ?
+                    kS3EmptyString : mDeletes.front().second) <<
+                " size: "         << mDataBuf.BytesConsumable()
+            );
+        }
+        virtual int Request(
+            IOBuffer&             inBuffer,
+            IOBuffer&             inResponseBuffer,
+            const ServerLocation& inServer)
+        {
+            TraceProgress(inBuffer, inResponseBuffer);
+            if (mSentFlag) {
+                return 0;
+            }
+            // Content MD5 is required by S3 DeleteObjects with both v2 and
+            // v4 authorization.
+            char        theMd5Buf[sizeof(mMdBuf)];
+            const char* theMdPtr         = GetMd5Sum();
+            const char* theContentMd5Ptr = 0;
+            if (! mOuter.mRegion.empty()) {
+                strcpy(theMd5Buf, theMdPtr);
+                theContentMd5Ptr = theMd5Buf;
+                theMdPtr         = GetSha256();
+            }
+            const char* const kContentTypePtr             = 0;
+            const char* const kContentEncodingPtr         = 0;
+            bool        const kServerSideEncryptionFlag   = false;
+            int64_t     const kRangeStart                 = -1;
+            int64_t     const kRangeEnd                   = -1;
+            bool        const kEmitStorageClassHeaderFlag = false;
+            const int theRet = SendRequest(
+                "POST",
+                inBuffer,
+                inServer,
+                theMdPtr,
+                kContentTypePtr,
+                kContentEncodingPtr,
+                kServerSideEncryptionFlag,
+                mDataBuf.BytesConsumable(),
+                kRangeStart,
+                kRangeEnd,
+                mOuter.mRegion.empty() ? "delete" : "delete=",
+                "/",
+                "delete",
+                kEmitStorageClassHeaderFlag,
+                theContentMd5Ptr
+            );
+            inBuffer.Copy(&mDataBuf, mDataBuf.BytesConsumable());
+            return theRet;
+        }
+        virtual int Response(
+            IOBuffer& inBuffer,
+            bool      inEofFlag)
+        {
+            bool      theDoneFlag = false;
+            const int theRet = ParseResponse(inBuffer, inEofFlag, theDoneFlag);
+            if (theDoneFlag) {
+                if (IsStatusOk() && ParseDeleteResponse()) {
+                    Done();
+                } else {
+                    if (IsStatusOk()) {
+                        KFS_LOG_STREAM_ERROR <<
+                            mOuter.mLogPrefix << Show(*this) <<
+                            " failed to parse delete response:" <<
+                            " at: " << mOuter.GetXmlLastParsedKey() <<
+                            " response length: " <<
+                                mIOBuffer.BytesConsumable() <<
+                            " data: " << ShowData(mIOBuffer,
+                                mOuter.mDebugTraceMaxErrorDataSize) <<
+                        KFS_LOG_EOM;
+                    }
+                    Retry();
+                }
+            }
+            return theRet;
+        }
+    private:
+        PendingDeletes mDeletes;
+        DeleteKeys     mFailedKeys;
+
+        class DeleteResponseParser
+        {
+        public:
+            DeleteResponseParser(
+                DeleteKeys& inFailedKeys)
+                : mFailedKeys(inFailedKeys)
+                {}
+            bool operator()(
+                const string& inKey,
+                const string& inValue)
+            {
+                if (kS3StrMDeleteResultErrorKey == inKey) {
+                    mFailedKeys.push_back(inValue);
+                    return (! inValue.empty());
+                }
+                if (kS3StrMDeleteResultErrorCode == inKey) {
+                    KFS_LOG_STREAM_DEBUG <<
+                        "delete error: " << inValue <<
+                        " key: " << (mFailedKeys.empty() ?
+                            kS3EmptyString : mFailedKeys.back()) <<
+                    KFS_LOG_EOM;
+                }
+                return true;
+            }
+        private:
+            DeleteKeys& mFailedKeys;
+        };
+        bool ParseDeleteResponse()
+        {
+            mFailedKeys.clear();
+            DeleteResponseParser theParser(mFailedKeys);
+            if (! mOuter.ParseXmlResponse(mIOBuffer, theParser)) {
+                mFailedKeys.clear();
+                return false;
+            }
+            return true;
+        }
+        virtual void DoneSelf(
+            int64_t        /* inIoByteCount */,
+            InputIterator* /* inInputIteratorPtr */)
+        {
+            Outer&         theOuter  = mOuter;
+            int const      theSysErr = mSysError;
+            PendingDeletes theDeletes;
+            DeleteKeys     theFailedKeys;
+            theDeletes.swap(mDeletes);
+            theFailedKeys.swap(mFailedKeys);
+            delete this;
+            theOuter.DeleteBatchDone(theDeletes, theFailedKeys, theSysErr);
+        }
+    private:
+        S3MultiDelete(
+            const S3MultiDelete& inDelete);
+        S3MultiDelete& operator=(
+            const S3MultiDelete& inDelete);
+    };
+    friend class S3MultiDelete;
+    class IOBufInputIterator : public InputIterator
+    {
+    public:
+        IOBufInputIterator(
+            IOBuffer& inIOBuffer)
+            : InputIterator(),
+              mIOBuffer()
+            { mIOBuffer.Move(&inIOBuffer); }
+        virtual char* Get()
+        {
+            const bool  kFullOrPartialLastBufferFlag = true;
+            char* const thePtr = mIOBuffer.DetachFrontBuffer(
+                kFullOrPartialLastBufferFlag);
+            QCRTASSERT(thePtr || mIOBuffer.IsEmpty());
+            return thePtr;
+        }
+    private:
+        IOBuffer mIOBuffer;
+    };
     class S3Get : public S3Req
     {
     public:
@@ -2196,35 +2448,32 @@ private:
                      // to prevent buffer detach failure.
                     inBuffer.Clear();
                     mIOBuffer.Trim((int)(mRangeEnd + 1 - mRangeStart));
-                    int const theIoByteCount = mIOBuffer.BytesConsumable();
-                    IOBufInputIterator theIterator(mIOBuffer);
-                    Done(theIoByteCount, &theIterator);
+                    mOuter.PutIntoCache(mFileName, mRangeStart,
+                        (int)(mRangeEnd + 1 - mRangeStart), mIOBuffer);
+                    GetDone();
+                } else if (kHttpStatusRangeNotSatisfiable ==
+                        mHeaders.GetStatus() && IsRangePastEofOk()) {
+                    inBuffer.Clear();
+                    mIOBuffer.Clear();
+                    GetDone();
                 } else {
                     Retry();
                 }
             }
             return theRet;
         }
-    private:
-        class IOBufInputIterator : public InputIterator
+    protected:
+        enum { kHttpStatusRangeNotSatisfiable = 416 };
+
+        virtual void GetDone()
         {
-        public:
-            IOBufInputIterator(
-                IOBuffer& inIOBuffer)
-                : InputIterator(),
-                  mIOBuffer()
-                { mIOBuffer.Move(&inIOBuffer); }
-            virtual char* Get()
-            {
-                const bool  kFullOrPartialLastBufferFlag = true;
-                char* const thePtr = mIOBuffer.DetachFrontBuffer(
-                    kFullOrPartialLastBufferFlag);
-                QCRTASSERT(thePtr || mIOBuffer.IsEmpty());
-                return thePtr;
-            }
-        private:
-            IOBuffer mIOBuffer;
-        };
+            int const theIoByteCount = mIOBuffer.BytesConsumable();
+            IOBufInputIterator theIterator(mIOBuffer);
+            Done(theIoByteCount, &theIterator);
+        }
+        virtual bool IsRangePastEofOk() const
+            { return false; }
+
         const int64_t mRangeStart;
         const int64_t mRangeEnd;
     private:
@@ -2234,6 +2483,181 @@ private:
             const S3Get& inGet);
     };
     friend class S3Get;
+    // Splits single read into the multiple concurrent ranged gets, in order
+    // to use more than one connection, and collects the ranges into a single
+    // disk queue request completion.
+    class S3ParallelGet
+    {
+    public:
+        S3ParallelGet(
+            Outer&   inOuter,
+            Request& inRequest,
+            BlockIdx inStartBlockIdx,
+            int      inBufferCount,
+            int      inPartBufferCount)
+            : mOuter(inOuter),
+              mRequest(inRequest),
+              mStartBlockIdx(inStartBlockIdx),
+              mBufferCount(inBufferCount),
+              mPartBufferCount(inPartBufferCount),
+              mPartCount((inBufferCount + inPartBufferCount - 1) /
+                inPartBufferCount),
+              mPendingCount(mPartCount),
+              mSysError(0),
+              mBuffers(new IOBuffer[mPartCount])
+            {}
+        void Start(
+            ReqType       inReqType,
+            const string& inFileName,
+            Generation    inGeneration,
+            int           inFd)
+        {
+            for (int i = 0; i < mPartCount; i++) {
+                mOuter.mClient.Run(*(new S3RangeGet(
+                    mOuter,
+                    mRequest,
+                    inReqType,
+                    inFileName,
+                    mStartBlockIdx + i * mPartBufferCount,
+                    min(mPartBufferCount, mBufferCount - i * mPartBufferCount),
+                    inGeneration,
+                    inFd,
+                    *this,
+                    i
+                )));
+            }
+        }
+        void PartDone(
+            int       inPartIdx,
+            int       inSysError,
+            IOBuffer* inBufferPtr)
+        {
+            QCASSERT(0 < mPendingCount && 0 <= inPartIdx &&
+                inPartIdx < mPartCount);
+            if (0 != inSysError) {
+                if (0 == mSysError) {
+                    mSysError = inSysError;
+                }
+            } else if (inBufferPtr) {
+                mBuffers[inPartIdx].Move(inBufferPtr);
+            }
+            if (0 < --mPendingCount) {
+                return;
+            }
+            // Concatenate the ranges, short range can only be followed by
+            // empty ranges, i.e. the ranges past the object end.
+            IOBuffer theBuf;
+            bool     theShortFlag = false;
+            for (int i = 0; i < mPartCount && 0 == mSysError; i++) {
+                int const theLen = mBuffers[i].BytesConsumable();
+                if (theShortFlag && 0 < theLen) {
+                    KFS_LOG_STREAM_ERROR << mOuter.mLogPrefix <<
+                        "parallel get: " <<
+                        reinterpret_cast<const void*>(this) <<
+                        " non empty range: " << i <<
+                        " follows short range" <<
+                        " length: "          << theLen <<
+                    KFS_LOG_EOM;
+                    mSysError = EIO;
+                    break;
+                }
+                theShortFlag = theLen < min(mPartBufferCount,
+                    mBufferCount - i * mPartBufferCount) * mOuter.mBlockSize;
+                theBuf.Move(&mBuffers[i]);
+            }
+            Outer&                   theOuter         = mOuter;
+            Request&                 theRequest       = mRequest;
+            BlockIdx           const theStartBlockIdx = mStartBlockIdx;
+            int                const theSysErr        = mSysError;
+            QCDiskQueue::Error const theError         = 0 == theSysErr ?
+                QCDiskQueue::kErrorNone : QCDiskQueue::kErrorRead;
+            delete this;
+            if (0 != theSysErr) {
+                theBuf.Clear();
+            }
+            int const          theIoByteCount = theBuf.BytesConsumable();
+            IOBufInputIterator theIterator(theBuf);
+            theOuter.mDiskQueuePtr->Done(
+                theOuter,
+                theRequest,
+                theError,
+                theSysErr,
+                theIoByteCount,
+                theStartBlockIdx,
+                QCDiskQueue::kErrorNone == theError ? &theIterator : 0
+            );
+        }
+    private:
+        Outer&         mOuter;
+        Request&       mRequest;
+        BlockIdx const mStartBlockIdx;
+        int      const mBufferCount;
+        int      const mPartBufferCount;
+        int      const mPartCount;
+        int            mPendingCount;
+        int            mSysError;
+        IOBuffer*      mBuffers;
+
+        ~S3ParallelGet()
+            { delete [] mBuffers; }
+    private:
+        S3ParallelGet(
+            const S3ParallelGet& inGet);
+        S3ParallelGet& operator=(
+            const S3ParallelGet& inGet);
+    };
+    friend class S3ParallelGet;
+    class S3RangeGet : public S3Get
+    {
+    public:
+        S3RangeGet(
+            Outer&          inOuter,
+            S3Req::Request& inRequest,
+            ReqType         inReqType,
+            const string&   inFileName,
+            BlockIdx        inStartBlockIdx,
+            int             inBufferCount,
+            Generation      inGeneration,
+            int             inFd,
+            S3ParallelGet&  inParent,
+            int             inPartIdx)
+            : S3Get(inOuter, inRequest, inReqType, inFileName,
+                inStartBlockIdx, inBufferCount, inGeneration, inFd),
+              mParent(inParent),
+              mPartIdx(inPartIdx)
+            {}
+    protected:
+        virtual void GetDone()
+        {
+            IOBuffer       theBuf;
+            theBuf.Move(&mIOBuffer);
+            S3ParallelGet& theParent  = mParent;
+            int const      thePartIdx = mPartIdx;
+            delete this;
+            theParent.PartDone(thePartIdx, 0, &theBuf);
+        }
+        virtual bool IsRangePastEofOk() const
+            { return (0 < mPartIdx); }
+        virtual void DoneSelf(
+            int64_t        /* inIoByteCount */,
+            InputIterator* /* inInputIteratorPtr */)
+        {
+            S3ParallelGet& theParent  = mParent;
+            int const      thePartIdx = mPartIdx;
+            int const      theSysErr  = 0 != mSysError ? mSysError : EIO;
+            delete this;
+            theParent.PartDone(thePartIdx, theSysErr, 0);
+        }
+    private:
+        S3ParallelGet& mParent;
+        int const      mPartIdx;
+    private:
+        S3RangeGet(
+            const S3RangeGet& inGet);
+        S3RangeGet& operator=(
+            const S3RangeGet& inGet);
+    };
+    friend class S3RangeGet;
     class DoNotDeallocate
     {
     public:
@@ -2736,6 +3160,16 @@ private:
     int                 mExponentialBackoffStartInterval;
     int                 mExponentialBackoffMaxExponent;
     int                 mMaxReadAhead;
+    int                 mMaxReadParallelism;
+    int                 mMinReadRangeSize;
+    int                 mDeleteBatchSize;
+    int                 mMaxDeleteBatchesInFlight;
+    int                 mDeleteBatchesInFlight;
+    PendingDeletesQueue mPendingDeletes;
+    string              mCacheFileName;
+    int64_t             mCacheMaxSize;
+    int                 mCacheSegmentSize;
+    S3BlockCache*       mCachePtr;
     int                 mMaxHdrLen;
     char*               mHdrBufferPtr;
     int                 mMaxResponseSize;
@@ -2838,6 +3272,16 @@ private:
           mExponentialBackoffStartInterval(3),
           mExponentialBackoffMaxExponent(5),
           mMaxReadAhead(4 << 10),
+          mMaxReadParallelism(1),
+          mMinReadRangeSize(8 << 20),
+          mDeleteBatchSize(0),
+          mMaxDeleteBatchesInFlight(4),
+          mDeleteBatchesInFlight(0),
+          mPendingDeletes(),
+          mCacheFileName(),
+          mCacheMaxSize(0),
+          mCacheSegmentSize(1 << 20),
+          mCachePtr(0),
           mMaxHdrLen(16 << 10),
           mHdrBufferPtr(new char[mMaxHdrLen + 1]),
           mMaxResponseSize((16 << 10) + (64 << 20)),
@@ -2964,6 +3408,42 @@ private:
                 "exponentialBackoffMaxExponent"),
             mExponentialBackoffMaxExponent
         );
+        mMaxReadParallelism = max(1, mParameters.getValue(
+            theName.Truncate(thePrefixSize).Append("maxReadParallelism"),
+            mMaxReadParallelism
+        ));
+        mMinReadRangeSize = max(1, mParameters.getValue(
+            theName.Truncate(thePrefixSize).Append("minReadRangeSize"),
+            mMinReadRangeSize
+        ));
+        mDeleteBatchSize = min(kS3MaxDeleteBatchSize, mParameters.getValue(
+            theName.Truncate(thePrefixSize).Append("deleteBatchSize"),
+            mDeleteBatchSize
+        ));
+        mMaxDeleteBatchesInFlight = max(1, mParameters.getValue(
+            theName.Truncate(thePrefixSize).Append("maxDeleteBatchesInFlight"),
+            mMaxDeleteBatchesInFlight
+        ));
+        mCacheFileName = mParameters.getValue(
+            theName.Truncate(thePrefixSize).Append("cache.fileName"),
+            mCacheFileName
+        );
+        mCacheMaxSize = mParameters.getValue(
+            theName.Truncate(thePrefixSize).Append("cache.maxSize"),
+            mCacheMaxSize
+        );
+        mCacheSegmentSize = mParameters.getValue(
+            theName.Truncate(thePrefixSize).Append("cache.segmentSize"),
+            mCacheSegmentSize
+        );
+        const bool theCacheFlag = ! mCacheFileName.empty() &&
+            0 < mCacheMaxSize && 0 < mCacheSegmentSize;
+        if (! mCachePtr || ! theCacheFlag ||
+                mCachePtr->GetFileName() != mCacheFileName) {
+            S3BlockCache::Release(mCachePtr);
+            mCachePtr = theCacheFlag ? S3BlockCache::Acquire(
+                mCacheFileName, mCacheMaxSize, mCacheSegmentSize) : 0;
+        }
         mDebugTraceRequestHeadersFlag = mParameters.getValue(
             theName.Truncate(thePrefixSize).Append("debugTrace.requestHeaders"),
             mDebugTraceRequestHeadersFlag ? 1 : 0
@@ -3042,6 +3522,178 @@ private:
             ! mSecretAccessKey.empty()
         );
     }
+    virtual bool GetCacheCounters(
+        CacheCounters& outCounters)
+    {
+        S3BlockCache::Counters theCounters;
+        if (! S3BlockCache::GetTotalCounters(theCounters)) {
+            return false;
+        }
+        outCounters.mHitCount        = theCounters.mHitCount;
+        outCounters.mHitByteCount    = theCounters.mHitByteCount;
+        outCounters.mMissCount       = theCounters.mMissCount;
+        outCounters.mMissByteCount   = theCounters.mMissByteCount;
+        outCounters.mInsertByteCount = theCounters.mInsertByteCount;
+        outCounters.mEvictCount      = theCounters.mEvictCount;
+        outCounters.mErrorCount      = theCounters.mErrorCount;
+        outCounters.mSize            = theCounters.mSize;
+        outCounters.mCapacity        = theCounters.mCapacity;
+        return true;
+    }
+    bool GetFromCache(
+        Request&    inRequest,
+        const File& inFile,
+        BlockIdx    inStartBlockIdx,
+        int         inBufferCount)
+    {
+        if (! mCachePtr || inBufferCount <= 0) {
+            return false;
+        }
+        IOBuffer theBuf;
+        if (! mCachePtr->Get(inFile.mFileName, inStartBlockIdx * mBlockSize,
+                inBufferCount * mBlockSize, theBuf)) {
+            return false;
+        }
+        int const          theIoByteCount = theBuf.BytesConsumable();
+        IOBufInputIterator theIterator(theBuf);
+        mDiskQueuePtr->Done(
+            *this,
+            inRequest,
+            QCDiskQueue::kErrorNone,
+            0,
+            theIoByteCount,
+            inStartBlockIdx,
+            &theIterator
+        );
+        return true;
+    }
+    void PutIntoCache(
+        const string&   inFileName,
+        int64_t         inPos,
+        int             inLength,
+        const IOBuffer& inBuffer)
+    {
+        if (mCachePtr) {
+            mCachePtr->Put(inFileName, inPos, inLength, inBuffer);
+        }
+    }
+    void StartDeleteBatches()
+    {
+        while (! mPendingDeletes.empty()) {
+            if (! IsRunning()) {
+                PendingDelete const theDelete = mPendingDeletes.front();
+                mPendingDeletes.pop_front();
+                mDiskQueuePtr->Done(
+                    *this,
+                    *theDelete.first,
+                    QCDiskQueue::kErrorDelete,
+                    EIO,
+                    0, // inIoByteCount
+                    0  // inStartBlockIdx
+                );
+                continue;
+            }
+            if (mMaxDeleteBatchesInFlight <= mDeleteBatchesInFlight) {
+                break;
+            }
+            PendingDeletes theBatch;
+            size_t const   theCnt = min(mPendingDeletes.size(),
+                (size_t)max(1, mDeleteBatchSize));
+            theBatch.reserve(theCnt);
+            theBatch.insert(theBatch.end(), mPendingDeletes.begin(),
+                mPendingDeletes.begin() + theCnt);
+            mPendingDeletes.erase(mPendingDeletes.begin(),
+                mPendingDeletes.begin() + theCnt);
+            IOBuffer theBody;
+            S3MultiDelete::WriteBody(theBatch, theBody);
+            mDeleteBatchesInFlight++;
+            KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+                "delete batch: " << theBatch.size() <<
+                " pending: "     << mPendingDeletes.size() <<
+                " in flight: "   << mDeleteBatchesInFlight <<
+            KFS_LOG_EOM;
+            mClient.Run(*(new S3MultiDelete(*this, theBatch, theBody)));
+        }
+    }
+    void DeleteBatchDone(
+        const PendingDeletes& inDeletes,
+        DeleteKeys&           inFailedKeys,
+        int                   inSysErr)
+    {
+        QCASSERT(0 < mDeleteBatchesInFlight);
+        mDeleteBatchesInFlight--;
+        sort(inFailedKeys.begin(), inFailedKeys.end());
+        KFS_LOG_STREAM(0 == inSysErr && inFailedKeys.empty() ?
+                MsgLogger::kLogLevelDEBUG :
+                MsgLogger::kLogLevelERROR) << mLogPrefix <<
+            "delete batch done: " << inDeletes.size() <<
+            " failed keys: "      << inFailedKeys.size() <<
+            " status: "           << inSysErr <<
+        KFS_LOG_EOM;
+        for (PendingDeletes::const_iterator theIt = inDeletes.begin();
+                inDeletes.end() != theIt;
+                ++theIt) {
+            if (0 == inSysErr && binary_search(
+                    inFailedKeys.begin(), inFailedKeys.end(), theIt->second) &&
+                    IsRunning()) {
+                ScheduleNext(*(new S3Delete(*this, *theIt->first,
+                    QCDiskQueue::kReqTypeDelete, theIt->second)));
+                continue;
+            }
+            mDiskQueuePtr->Done(
+                *this,
+                *theIt->first,
+                0 == inSysErr ?
+                    QCDiskQueue::kErrorNone : QCDiskQueue::kErrorDelete,
+                inSysErr,
+                0, // inIoByteCount
+                0  // inStartBlockIdx
+            );
+        }
+        // The remaining pending deletes are started by the next
+        // ProcessAndWait() invocation.
+    }
+    bool StartParallelGet(
+        Request&    inRequest,
+        ReqType     inReqType,
+        const File& inFile,
+        int         inFd,
+        BlockIdx    inStartBlockIdx,
+        int         inBufferCount)
+    {
+        if (mMaxReadParallelism <= 1 || mBlockSize <= 0) {
+            return false;
+        }
+        // Range size adapts to the request size: the request is split into
+        // at most max read parallelism ranges, each at least min read range
+        // size long.
+        int const theMinRangeBufferCount =
+            max(1, (mMinReadRangeSize + mBlockSize - 1) / mBlockSize);
+        if (inBufferCount < 2 * theMinRangeBufferCount) {
+            return false;
+        }
+        int const thePartBufferCount = max(theMinRangeBufferCount,
+            (inBufferCount + mMaxReadParallelism - 1) / mMaxReadParallelism);
+        S3ParallelGet& theGet = *(new S3ParallelGet(
+            *this,
+            inRequest,
+            inStartBlockIdx,
+            inBufferCount,
+            thePartBufferCount
+        ));
+        KFS_LOG_STREAM_DEBUG << mLogPrefix <<
+            "parallel get: " << reinterpret_cast<const void*>(&theGet) <<
+            " " << inFile.mFileName <<
+            " fd: "     << inFd <<
+            " blocks:"
+            " pos: "    << inStartBlockIdx <<
+            " count: "  << inBufferCount <<
+            " ranges: " << (inBufferCount + thePartBufferCount - 1) /
+                thePartBufferCount <<
+        KFS_LOG_EOM;
+        theGet.Start(inReqType, inFile.mFileName, inFile.mGeneration, inFd);
+        return true;
+    }
     void ScheduleNext(
         TransactionalClient::Transaction& inReq)
     {
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include "chunk/BufferManager.h"
+
+namespace KFS {
+namespace Test {
+
+/**
+ * BufferManagerTest exercises the chunk server io buffer manager request class
+ * deficit round robin scheduling without disk or network io. The buffer
+ * manager is initialized without buffer pool, and the waiting requests are
+ * scheduled by invoking the buffer manager timeout handler directly.
+ */
+class BufferManagerTest : public ::testing::Test
+{
+public:
+    typedef BufferManager::ByteCount ByteCount;
+
+    class TestClient : public BufferManager::Client
+    {
+    public:
+        TestClient()
+            : BufferManager::Client(),
+              mGrantedCount(0)
+        { }
+        virtual ~TestClient()
+        { }
+        virtual void Granted(ByteCount inByteCount)
+        {
+            mGrantedCount += inByteCount;
+        }
+
+        ByteCount mGrantedCount;
+    };
+
+    /**
+     * Queues disk io request by temporarily setting disk overloaded state, in
+     * order to have the request waiting regardless of the buffer manager's
+     * available byte count.
+     */
+    static void Queue(
+        BufferManager&              manager,
+        TestClient&                 client,
+        ByteCount                   byteCount,
+        BufferManager::RequestClass requestClass)
+    {
+        manager.SetDiskOverloaded(true);
+        ASSERT_FALSE(manager.GetForDiskIo(client, byteCount, requestClass));
+        manager.SetDiskOverloaded(false);
+        ASSERT_TRUE(client.IsWaiting());
+    }
+
+    static const ByteCount kTotal = 100 << 10;
+};
+
+const BufferManagerTest::ByteCount BufferManagerTest::kTotal;
+
+/**
+ * With more than one request class with unmet minimum reservation, neither
+ * class can be granted while the other class reservation is outstanding. The
+ * scheduler must stop after one full rotation without grants, and grant both
+ * requests once the buffers are released.
+ */
+TEST_F(BufferManagerTest, MultipleReservedClasses)
+{
+    BufferManager manager(true);
+    manager.SetClassParameters(BufferManager::kRequestClassRead, 1, 0.3);
+    manager.SetClassParameters(BufferManager::kRequestClassWrite, 1, 0.3);
+    manager.Init(0, kTotal, kTotal, 0);
+
+    TestClient holder;
+    ASSERT_TRUE(manager.Get(holder, 70 << 10));
+    ASSERT_EQ(kTotal - (70 << 10), manager.GetRemainingByteCount());
+
+    TestClient reader;
+    TestClient writer;
+    Queue(manager, reader, 10 << 10, BufferManager::kRequestClassRead);
+    Queue(manager, writer, 10 << 10, BufferManager::kRequestClassWrite);
+
+    // Each request fits into the remaining buffers, and the class deficit, but
+    // not with the other class reservation.
+    manager.Timeout();
+    EXPECT_TRUE(reader.IsWaiting());
+    EXPECT_TRUE(writer.IsWaiting());
+    EXPECT_EQ(0, reader.mGrantedCount);
+    EXPECT_EQ(0, writer.mGrantedCount);
+    EXPECT_EQ(2, manager.GetWaitingCount());
+
+    manager.Put(holder, holder.GetByteCount());
+    manager.Timeout();
+    EXPECT_FALSE(reader.IsWaiting());
+    EXPECT_FALSE(writer.IsWaiting());
+    EXPECT_EQ(10 << 10, reader.mGrantedCount);
+    EXPECT_EQ(10 << 10, writer.mGrantedCount);
+    EXPECT_EQ(0, manager.GetWaitingCount());
+    EXPECT_EQ(kTotal - (20 << 10), manager.GetRemainingByteCount());
+
+    reader.Unregister();
+    writer.Unregister();
+    EXPECT_EQ(kTotal, manager.GetRemainingByteCount());
+}
+
+/**
+ * Request larger than the class quantum requires more than one round robin
+ * rotation to accumulate sufficient deficit, and must be granted by a single
+ * scheduler invocation.
+ */
+TEST_F(BufferManagerTest, DeficitAccumulation)
+{
+    BufferManager manager(true);
+    manager.Init(0, kTotal, 16 << 10, 0);
+
+    TestClient reader;
+    TestClient writer;
+    Queue(manager, reader, 12 << 10, BufferManager::kRequestClassRead);
+    Queue(manager, writer, 4 << 10, BufferManager::kRequestClassWrite);
+
+    manager.Timeout();
+    EXPECT_FALSE(reader.IsWaiting());
+    EXPECT_FALSE(writer.IsWaiting());
+    EXPECT_EQ(12 << 10, reader.mGrantedCount);
+    EXPECT_EQ(4 << 10, writer.mGrantedCount);
+    EXPECT_EQ(0, manager.GetWaitingCount());
+}
+
+} // namespace Test
+} // namespace KFS
@@ -3,6 +3,7 @@
 #include <errno.h>
 #include <gtest/gtest.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include <boost/lexical_cast.hpp>
@@ -17,7 +18,8 @@ using namespace std;
 using boost::lexical_cast;
 
 MetaserverEnvironment::MetaserverEnvironment()
-    : mClientPort(-1)
+    : mConfigPath()
+    , mClientPort(-1)
     , mChunkserverPort(-1)
 { }
 
@@ -57,7 +59,10 @@ MetaserverEnvironment::Start()
         return true;
     }
 
-    string configPath = GenerateConfig();
+    if (mConfigPath.empty()) {
+        mConfigPath = GenerateConfig();
+    }
+    const string& configPath = mConfigPath;
     string binaryPath = "build/" + mBuildType + "/bin/metaserver";
 
     int fd = QFSTestUtils::CreateTempFile(&mLogFile);
@@ -89,5 +94,61 @@ MetaserverEnvironment::Start()
     return true;
 }
 
+bool
+MetaserverEnvironment::Restart(bool checkpointFlag)
+{
+    if (QFSTestUtils::IsProcessAlive(mPid)) {
+        QFSTestUtils::TermProcess(mPid, 0);
+    }
+    mPid = -1;
+
+    if (checkpointFlag && !RunLogCompactor()) {
+        return false;
+    }
+
+    return Start();
+}
+
+bool
+MetaserverEnvironment::RunLogCompactor()
+{
+    string binaryPath = "build/" + mBuildType + "/bin/logcompactor";
+    string logFile;
+    int fd = QFSTestUtils::CreateTempFile(&logFile);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        ADD_FAILURE() << "logcompactor: fork failed: " << strerror(errno);
+        close(fd);
+        return false;
+    }
+    else if (pid == 0) {
+        EXPECT_NE(-1, dup2(fd, fileno(stderr)));
+        close(fd);
+
+        execl(binaryPath.c_str(), binaryPath.c_str(),
+            "-l", mTransactionLogDir.c_str(),
+            "-c", mCheckpointDir.c_str(),
+            NULL);
+        ADD_FAILURE() << binaryPath << ": execl failed: " << strerror(errno);
+        abort();
+    }
+    close(fd);
+
+    cout << "running logcompactor (pid: " << pid
+        << ", logfile: " << logFile
+        << ")" << endl;
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid) {
+        ADD_FAILURE() << "logcompactor: waitpid failed: " << strerror(errno);
+        return false;
+    }
+
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        << "logcompactor failed, see " << logFile;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
 } // namespace Test
 } // namespace KFS
@@ -41,6 +41,19 @@ public:
      */
     uint16_t GetChunkserverPort() const { return mChunkserverPort; }
 
+    /**
+     * Restart stops the running metaserver, and starts it again with the same
+     * configuration, ports, checkpoint and transaction log directories. The
+     * restarted metaserver restores its state from the latest checkpoint and
+     * replays the transaction logs. The chunkservers reconnect on their own.
+     *
+     * @param checkpointFlag If true, run the log compactor after the
+     * metaserver exits, in order to have the restarted metaserver restore its
+     * state from the checkpoint created from the transaction logs.
+     * @return True if the metaserver was successfully restarted
+     */
+    bool Restart(bool checkpointFlag);
+
 protected:
     /**
      * GenerateConfig creates a configuration suitable for the metaserver to
@@ -61,7 +74,16 @@ protected:
      */
     virtual bool Start();
 
+    /**
+     * Run the log compactor in order to create a new checkpoint from the
+     * latest checkpoint and the transaction logs.
+     *
+     * @return True if the log compactor exited successfully
+     */
+    bool RunLogCompactor();
+
 private:
+    string mConfigPath;
     uint16_t mClientPort;
     uint16_t mChunkserverPort;
     string mTransactionLogDir;
@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "common/kfstypes.h"
+#include "libclient/CompressedFile.h"
+#include "libclient/KfsClient.h"
+#include "tests/environments/MetaserverEnvironment.h"
+#include "tests/integtest.h"
+
+namespace KFS {
+namespace Test {
+
+using namespace std;
+using client::CompressedFile;
+
+/**
+ * QFSCompressedFileTest writes compressed files through the client, and
+ * verifies the logical content and size with random offset reads and stat.
+ */
+class QFSCompressedFileTest : public QFSTest
+{
+public:
+    QFSCompressedFileTest()
+        : QFSTest(),
+          mClient(0)
+    { }
+
+    virtual void SetUp()
+    {
+        QFSTest::SetUp();
+        mClient = KfsClient::Connect(sMetaserver->GetHostname(),
+            sMetaserver->GetClientPort(), 0);
+        ASSERT_TRUE(mClient);
+        ASSERT_EQ(0, mClient->Mkdirs(kDir));
+        ASSERT_EQ(0, mClient->SetDefaultCompression(KFS_COMPRESSION_ZLIB));
+    }
+
+    virtual void TearDown()
+    {
+        if (mClient) {
+            mClient->RmdirsFast(kDir);
+            delete mClient;
+            mClient = 0;
+        }
+        QFSTest::TearDown();
+    }
+
+    /**
+     * Generates the file content: compressible text, with incompressible
+     * pseudo random data in the specified range.
+     */
+    static void Generate(
+        string&    data,
+        chunkOff_t size,
+        chunkOff_t randomStart,
+        chunkOff_t randomEnd)
+    {
+        data.clear();
+        data.reserve((size_t)size);
+        char line[64];
+        for (int i = 0; (chunkOff_t)data.size() < size; i++) {
+            const int len = snprintf(line, sizeof(line),
+                "compressed file test line %d\n", i);
+            data.append(line, min((chunkOff_t)len,
+                size - (chunkOff_t)data.size()));
+        }
+        unsigned int seed = 12345;
+        for (chunkOff_t i = randomStart; i < randomEnd && i < size; i++) {
+            data[(size_t)i] = (char)(rand_r(&seed) >> 4);
+        }
+    }
+
+    void Write(
+        const char*   path,
+        const string& data,
+        size_t        writeSize)
+    {
+        const int numReplicas = 1;
+        const int fd          = mClient->Create(path, numReplicas);
+        ASSERT_LE(0, fd) << path << ": " << ErrorCodeToStr(fd);
+        for (size_t pos = 0; pos < data.size(); ) {
+            const size_t  len = min(writeSize, data.size() - pos);
+            const ssize_t ret = mClient->Write(fd, data.data() + pos, len);
+            ASSERT_EQ((ssize_t)len, ret) << path << ": " <<
+                ErrorCodeToStr((int)ret);
+            pos += len;
+        }
+        ASSERT_EQ(0, mClient->Close(fd));
+    }
+
+    void VerifyRandomReads(
+        const char*   path,
+        const string& data,
+        int           count)
+    {
+        const int fd = mClient->Open(path, O_RDONLY);
+        ASSERT_LE(0, fd) << path << ": " << ErrorCodeToStr(fd);
+        KfsFileAttr attr;
+        ASSERT_EQ(0, mClient->Stat(fd, attr));
+        EXPECT_EQ((chunkOff_t)data.size(), attr.fileSize);
+
+        unsigned int seed = 54321;
+        vector<char> buf;
+        for (int i = 0; i < count; i++) {
+            // Include reads that cross block and chunk boundaries, and reads
+            // past the end of file.
+            const int64_t    rnd = ((int64_t)rand_r(&seed) << 16) ^
+                rand_r(&seed);
+            const chunkOff_t pos = (chunkOff_t)(
+                rnd % (int64_t)(data.size() + (64 << 10)));
+            const size_t     len = (size_t)(rand_r(&seed) % (256 << 10)) + 1;
+            buf.resize(len);
+            const ssize_t ret = mClient->PRead(fd, pos, &buf[0], len);
+            const ssize_t exp = pos < (chunkOff_t)data.size() ?
+                (ssize_t)min(len, data.size() - (size_t)pos) : 0;
+            ASSERT_EQ(exp, ret) << path << " pos: " << pos << " len: " << len;
+            if (0 < exp) {
+                ASSERT_TRUE(data.compare((size_t)pos, (size_t)exp,
+                    &buf[0], (size_t)exp) == 0) <<
+                    path << " pos: " << pos << " len: " << len;
+            }
+        }
+
+        // Sequential read from a seek position.
+        const chunkOff_t pos = (chunkOff_t)data.size() / 3;
+        ASSERT_EQ(pos, mClient->Seek(fd, pos));
+        buf.resize(100 << 10);
+        const size_t  len = min(buf.size(), data.size() - (size_t)pos);
+        ASSERT_EQ((ssize_t)len, mClient->Read(fd, &buf[0], len));
+        EXPECT_TRUE(data.compare((size_t)pos, len, &buf[0], len) == 0);
+        EXPECT_EQ(pos + (chunkOff_t)len, mClient->Tell(fd));
+
+        EXPECT_EQ(0, mClient->Close(fd));
+    }
+
+    static const char* const kDir;
+
+    KfsClient* mClient;
+};
+
+const char* const QFSCompressedFileTest::kDir = "/compressedfiletest";
+
+/**
+ * The file spans two chunks, and contains an incompressible range that
+ * crosses the chunk boundary, in order to exercise both the compressed and
+ * the raw blocks.
+ */
+TEST_F(QFSCompressedFileTest, RandomReads)
+{
+    const char* const path     = "/compressedfiletest/file";
+    const chunkOff_t  boundary = CompressedFile::kChunkLogicalSize;
+    const chunkOff_t  size     = boundary + 3 * CompressedFile::kBlockSize +
+        12345;
+    string data;
+    Generate(data, size, boundary - (200 << 10), boundary + (100 << 10));
+    Write(path, data, 100001);
+    VerifyRandomReads(path, data, 300);
+
+    KfsFileAttr attr;
+    ASSERT_EQ(0, mClient->Stat(path, attr));
+    EXPECT_EQ(KFS_COMPRESSION_ZLIB, attr.compression);
+    EXPECT_EQ(size, attr.fileSize);
+    // The second chunk physical data starts at the chunk boundary.
+    EXPECT_LT((chunkOff_t)CHUNKSIZE, attr.physicalSize);
+    EXPECT_GT((chunkOff_t)CHUNKSIZE + size - boundary, attr.physicalSize);
+}
+
+/**
+ * Small file with the partial last block, and incompressible file, where
+ * the physical size includes the chunk header.
+ */
+TEST_F(QFSCompressedFileTest, LogicalAndPhysicalSize)
+{
+    const char* const small = "/compressedfiletest/small";
+    string data;
+    Generate(data, 5 * CompressedFile::kBlockSize + 777, 0, 0);
+    Write(small, data, 4096);
+    VerifyRandomReads(small, data, 50);
+
+    KfsFileAttr attr;
+    ASSERT_EQ(0, mClient->Stat(small, attr));
+    EXPECT_EQ(KFS_COMPRESSION_ZLIB, attr.compression);
+    EXPECT_EQ((chunkOff_t)data.size(), attr.fileSize);
+    EXPECT_LT((chunkOff_t)CompressedFile::kHeaderSize, attr.physicalSize);
+    EXPECT_GT((chunkOff_t)data.size(), attr.physicalSize);
+
+    const char* const random = "/compressedfiletest/random";
+    const chunkOff_t  size   = 4 * CompressedFile::kBlockSize + 1;
+    Generate(data, size, 0, size);
+    Write(random, data, 65537);
+    VerifyRandomReads(random, data, 50);
+
+    ASSERT_EQ(0, mClient->Stat(random, attr));
+    EXPECT_EQ(size, attr.fileSize);
+    EXPECT_EQ(CompressedFile::kHeaderSize + size, attr.physicalSize);
+
+    // Files created with no default compression are not compressed.
+    ASSERT_EQ(0, mClient->SetDefaultCompression(KFS_COMPRESSION_NONE));
+    const char* const plain = "/compressedfiletest/plain";
+    Write(plain, data, 65537);
+    ASSERT_EQ(0, mClient->Stat(plain, attr));
+    EXPECT_EQ(KFS_COMPRESSION_NONE, attr.compression);
+    EXPECT_EQ(size, attr.fileSize);
+}
+
+} // namespace Test
+} // namespace KFS
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/Properties.h"
+#include "libclient/KfsClient.h"
+#include "libclient/MountTable.h"
+#include "tests/environments/MetaserverEnvironment.h"
+#include "tests/integtest.h"
+
+namespace KFS {
+namespace Test {
+
+using namespace std;
+using client::MountTable;
+
+/**
+ * Mount table specification parsing, and prefix match at the path component
+ * boundary.
+ */
+TEST(MountTableTest, Parse)
+{
+    MountTable table;
+    string     errMsg;
+    ASSERT_EQ(0, table.Parse(
+        " /user=meta1:20000,/warehouse/=meta2:20001 /a/../data=meta3:1",
+        errMsg)) << errMsg;
+    ASSERT_EQ(3u, table.GetSize());
+    EXPECT_EQ("/user", table.Get(0).mPrefix);
+    EXPECT_EQ("meta1", table.Get(0).mLocation.hostname);
+    EXPECT_EQ(20000, table.Get(0).mLocation.port);
+    EXPECT_EQ("/warehouse", table.Get(1).mPrefix);
+    EXPECT_EQ("meta2", table.Get(1).mLocation.hostname);
+    EXPECT_EQ(20001, table.Get(1).mLocation.port);
+    EXPECT_EQ("/data", table.Get(2).mPrefix);
+    EXPECT_EQ(1, table.Get(2).mLocation.port);
+
+    EXPECT_EQ(0, table.Parse(0, errMsg));
+    EXPECT_TRUE(table.IsEmpty());
+    EXPECT_EQ(0, table.Parse(" , ", errMsg));
+    EXPECT_TRUE(table.IsEmpty());
+
+    const char* const kInvalid[] = {
+        "/user",
+        "/user=meta1",
+        "/user=meta1:",
+        "/user=meta1:0",
+        "/user=meta1:65536",
+        "/user=meta1:2000x",
+        "/user=:20000",
+        "user=meta1:20000",
+        "=meta1:20000",
+        "/=meta1:20000",
+        "/user=meta1:20000,/user/=meta2:20000",
+        "/user=meta1:20000 bogus",
+        0
+    };
+    for (const char* const* spec = kInvalid; *spec; ++spec) {
+        errMsg.clear();
+        EXPECT_EQ(-EINVAL, table.Parse(*spec, errMsg)) << *spec;
+        EXPECT_FALSE(errMsg.empty()) << *spec;
+        EXPECT_TRUE(table.IsEmpty()) << *spec;
+    }
+}
+
+TEST(MountTableTest, Find)
+{
+    MountTable table;
+    string     errMsg;
+    ASSERT_EQ(0, table.Parse(
+        "/user=meta1:20000 /user/shared=meta2:20000 /warehouse=meta3:20000",
+        errMsg)) << errMsg;
+
+    EXPECT_EQ(-1, table.Find("/"));
+    EXPECT_EQ(-1, table.Find("/tmp/user"));
+    EXPECT_EQ(-1, table.Find("/us"));
+    EXPECT_EQ(-1, table.Find("/username"));
+    EXPECT_EQ(0,  table.Find("/user"));
+    EXPECT_EQ(0,  table.Find("/user/a/b"));
+    EXPECT_EQ(0,  table.Find("/user/sharedx"));
+    EXPECT_EQ(1,  table.Find("/user/shared"));
+    EXPECT_EQ(1,  table.Find("/user/shared/a"));
+    EXPECT_EQ(2,  table.Find("/warehouse/t"));
+}
+
+/**
+ * QFSMountTest mounts a sub tree of the test meta server name space as a
+ * separate meta server, in order to test the client routing. The mount and
+ * the default meta server are the same meta server, therefore cross mount
+ * failures are the client side routing decisions.
+ */
+class QFSMountTest : public QFSTest
+{
+public:
+    QFSMountTest()
+        : QFSTest(),
+          mClient()
+    { }
+
+    virtual void SetUp()
+    {
+        QFSTest::SetUp();
+        ostringstream os;
+        os << "/mnt=" << sMetaserver->GetHostname() << ":" <<
+            sMetaserver->GetClientPort();
+        Properties props;
+        props.setValue("client.mountTable", os.str());
+        ASSERT_EQ(0, mClient.Init(sMetaserver->GetHostname(),
+            sMetaserver->GetClientPort(), &props));
+        ASSERT_TRUE(mClient.IsInitialized());
+        ASSERT_EQ(0, mClient.Mkdirs(kLocal));
+        ASSERT_EQ(0, mClient.Mkdirs(kMounted));
+    }
+
+    virtual void TearDown()
+    {
+        mClient.RmdirsFast(kLocal);
+        mClient.RmdirsFast(kMounted);
+        QFSTest::TearDown();
+    }
+
+    void CreateFile(const char* path)
+    {
+        const int fd = mClient.Create(path);
+        ASSERT_LE(0, fd) << path << ": " << ErrorCodeToStr(fd);
+        EXPECT_EQ(0, mClient.Close(fd));
+    }
+
+    static const char* const kLocal;
+    static const char* const kMounted;
+
+    KfsClient mClient;
+};
+
+const char* const QFSMountTest::kLocal   = "/mnttest";
+const char* const QFSMountTest::kMounted = "/mnt/mnttest";
+
+TEST_F(QFSMountTest, RenameAcrossMounts)
+{
+    CreateFile("/mnttest/a");
+    CreateFile("/mnt/mnttest/b");
+
+    EXPECT_EQ(-EXDEV, mClient.Rename("/mnttest/a", "/mnt/mnttest/a"));
+    EXPECT_EQ(-EXDEV, mClient.Rename("/mnt/mnttest/b", "/mnttest/b"));
+    // Relative paths are resolved against the default client current
+    // directory before the mount table lookup.
+    ASSERT_EQ(0, mClient.Cd(kLocal));
+    EXPECT_EQ(-EXDEV, mClient.Rename("a", "../mnt/mnttest/a"));
+    ASSERT_EQ(0, mClient.Cd("/"));
+
+    vector<string> oldPaths;
+    vector<string> newPaths;
+    vector<int>    status;
+    oldPaths.push_back("/mnttest/a");
+    newPaths.push_back("/mnt/mnttest/a");
+    oldPaths.push_back("/mnt/mnttest/b");
+    newPaths.push_back("/mnt/mnttest/c");
+    EXPECT_EQ(-EXDEV, mClient.Rename(oldPaths, newPaths, status));
+    ASSERT_EQ(2u, status.size());
+    EXPECT_EQ(-EXDEV, status[0]);
+    EXPECT_EQ(0, status[1]);
+
+    KfsFileAttr attr;
+    EXPECT_EQ(0, mClient.Stat("/mnttest/a", attr));
+    EXPECT_EQ(0, mClient.Stat("/mnt/mnttest/c", attr));
+    EXPECT_EQ(-ENOENT, mClient.Stat("/mnt/mnttest/b", attr));
+
+    EXPECT_EQ(0, mClient.Rename("/mnttest/a", "/mnttest/d"));
+    EXPECT_EQ(0, mClient.Rename("/mnt/mnttest/c", "/mnt/mnttest/e"));
+    EXPECT_EQ(0, mClient.Stat("/mnttest/d", attr));
+    EXPECT_EQ(0, mClient.Stat("/mnt/mnttest/e", attr));
+}
+
+} // namespace Test
+} // namespace KFS
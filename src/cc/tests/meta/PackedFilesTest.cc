@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "libclient/KfsClient.h"
+#include "tests/environments/MetaserverEnvironment.h"
+#include "tests/integtest.h"
+
+namespace KFS {
+namespace Test {
+
+using namespace std;
+
+/**
+ * QFSPackedFilesTest packs small files into a container file, and verifies
+ * that the packed files and the container references survive the metaserver
+ * restart with transaction log replay, and with checkpoint restore, and that
+ * the compaction moves the files into a new container and removes the old
+ * one, and survives the restart as well.
+ */
+class QFSPackedFilesTest : public QFSTest
+{
+public:
+    QFSPackedFilesTest()
+        : QFSTest(),
+          mClient(0),
+          mPaths(),
+          mData()
+    { }
+
+    virtual void SetUp()
+    {
+        QFSTest::SetUp();
+        mClient = KfsClient::Connect(sMetaserver->GetHostname(),
+            sMetaserver->GetClientPort(), 0);
+        ASSERT_TRUE(mClient);
+        ASSERT_EQ(0, mClient->Mkdirs(kFilesDir));
+        ASSERT_EQ(0, mClient->Mkdirs(kContainersDir));
+    }
+
+    virtual void TearDown()
+    {
+        if (mClient) {
+            mClient->RmdirsFast(kFilesDir);
+            mClient->RmdirsFast(kContainersDir);
+            mClient->Rmdir(kTestDir);
+            delete mClient;
+            mClient = 0;
+        }
+        QFSTest::TearDown();
+    }
+
+    void CreateFiles(int count)
+    {
+        for (int i = 0; i < count; i++) {
+            ostringstream os;
+            os << kFilesDir << "/f" << i;
+            mPaths.push_back(os.str());
+            string data;
+            // Sizes from 1 byte to about 40KB, not block aligned.
+            const size_t size = 1 + (size_t)i * 2003;
+            for (size_t k = 0; data.size() < size; k++) {
+                data += (char)('a' + (i + k) % 26);
+            }
+            data.resize(size);
+            mData.push_back(data);
+
+            const int numReplicas = 1;
+            const int fd          = mClient->Create(os.str().c_str(),
+                numReplicas);
+            ASSERT_LE(0, fd) << os.str() << ": " << ErrorCodeToStr(fd);
+            ASSERT_EQ((ssize_t)size,
+                mClient->Write(fd, data.data(), data.size()));
+            ASSERT_EQ(0, mClient->Close(fd));
+        }
+    }
+
+    int ReadFile(const string& path, string& data)
+    {
+        data.clear();
+        const int fd = mClient->Open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return fd;
+        }
+        char buf[16 << 10];
+        ssize_t ret;
+        while (0 < (ret = mClient->Read(fd, buf, sizeof(buf)))) {
+            data.append(buf, (size_t)ret);
+        }
+        mClient->Close(fd);
+        return (ret < 0 ? (int)ret : 0);
+    }
+
+    /**
+     * Waits for the restarted metaserver to accept requests, and for the
+     * chunkservers to reconnect and report their chunks, by reading a packed
+     * file until the read succeeds.
+     */
+    void WaitForRestart()
+    {
+        const int kMaxWaitSec = 120;
+        string    data;
+        int       status = -1;
+        for (int i = 0; i < kMaxWaitSec; i++) {
+            if ((status = ReadFile(mPaths.back(), data)) == 0 &&
+                    data == mData.back()) {
+                return;
+            }
+            sleep(1);
+        }
+        FAIL() << mPaths.back() << ": read after restart failure: " <<
+            ErrorCodeToStr(status);
+    }
+
+    /**
+     * Verifies the packed file content, and the container reference.
+     */
+    void Verify(size_t start, kfsFileId_t containerId)
+    {
+        for (size_t i = start; i < mPaths.size(); i++) {
+            KfsFileAttr attr;
+            ASSERT_EQ(0, mClient->Stat(mPaths[i].c_str(), attr)) << mPaths[i];
+            EXPECT_TRUE(attr.IsPacked()) << mPaths[i];
+            EXPECT_EQ(containerId, attr.packedContainer) << mPaths[i];
+            EXPECT_EQ((chunkOff_t)mData[i].size(), attr.fileSize) << mPaths[i];
+            string data;
+            ASSERT_EQ(0, ReadFile(mPaths[i], data)) << mPaths[i];
+            EXPECT_TRUE(mData[i] == data) << mPaths[i];
+        }
+    }
+
+    kfsFileId_t GetFileId(const char* path)
+    {
+        KfsFileAttr attr;
+        const int   status = mClient->Stat(path, attr);
+        EXPECT_EQ(0, status) << path;
+        return (status == 0 ? attr.fileId : kfsFileId_t(-1));
+    }
+
+    static const char* const kTestDir;
+    static const char* const kFilesDir;
+    static const char* const kContainersDir;
+
+    KfsClient*     mClient;
+    vector<string> mPaths;
+    vector<string> mData;
+};
+
+const char* const QFSPackedFilesTest::kTestDir       = "/packedfilestest";
+const char* const QFSPackedFilesTest::kFilesDir      =
+    "/packedfilestest/files";
+const char* const QFSPackedFilesTest::kContainersDir =
+    "/packedfilestest/containers";
+
+TEST_F(QFSPackedFilesTest, PackRestartCompact)
+{
+    const int         kFileCount  = 20;
+    const int         kLiveCount  = 5;
+    const char* const container   = "/packedfilestest/containers/c1";
+    const char* const compacted   = "/packedfilestest/containers/c2";
+
+    CreateFiles(kFileCount);
+    vector<int> status;
+    ASSERT_EQ(0, mClient->PackFiles(container, mPaths, status));
+    ASSERT_EQ((size_t)kFileCount, status.size());
+    EXPECT_EQ(kFileCount, (int)count(status.begin(), status.end(), 0));
+    const kfsFileId_t containerId = GetFileId(container);
+    Verify(0, containerId);
+    // The container can not be removed while referenced.
+    EXPECT_EQ(-EBUSY, mClient->Remove(container));
+
+    // Restore from the checkpoint, and the transaction log replay.
+    ASSERT_TRUE(sMetaserver->Restart(false));
+    WaitForRestart();
+    Verify(0, containerId);
+    EXPECT_EQ(-EBUSY, mClient->Remove(container));
+
+    // Restore from the checkpoint written by the log compactor.
+    ASSERT_TRUE(sMetaserver->Restart(true));
+    WaitForRestart();
+    Verify(0, containerId);
+    EXPECT_EQ(-EBUSY, mClient->Remove(container));
+
+    // Remove all but the largest files, leaving the container live bytes
+    // less than a half of the container size.
+    const int kRemovedCount = kFileCount - kLiveCount;
+    for (int i = 0; i < kRemovedCount; i++) {
+        const size_t idx = mPaths.size() - 1 - kLiveCount;
+        ASSERT_EQ(0, mClient->Remove(mPaths[idx].c_str())) << mPaths[idx];
+        mPaths.erase(mPaths.begin() + idx);
+        mData.erase(mData.begin() + idx);
+    }
+    ASSERT_EQ((size_t)kLiveCount, mPaths.size());
+
+    EXPECT_EQ(kLiveCount,
+        mClient->CompactPackedFiles(kFilesDir, compacted, 0.5));
+    const kfsFileId_t compactedId = GetFileId(compacted);
+    Verify(0, compactedId);
+    KfsFileAttr attr;
+    EXPECT_EQ(-ENOENT, mClient->Stat(container, attr));
+    // Nothing to compact.
+    EXPECT_EQ(0, mClient->CompactPackedFiles(kFilesDir,
+        "/packedfilestest/containers/c3", 0.5));
+
+    // The compaction moves must be replayed from the transaction log, and
+    // restored from the checkpoint.
+    ASSERT_TRUE(sMetaserver->Restart(false));
+    WaitForRestart();
+    Verify(0, compactedId);
+    EXPECT_EQ(-ENOENT, mClient->Stat(container, attr));
+    EXPECT_EQ(-EBUSY, mClient->Remove(compacted));
+
+    ASSERT_TRUE(sMetaserver->Restart(true));
+    WaitForRestart();
+    Verify(0, compactedId);
+    EXPECT_EQ(-ENOENT, mClient->Stat(container, attr));
+
+    // The container is removable once no longer referenced.
+    for (size_t i = 0; i < mPaths.size(); i++) {
+        EXPECT_EQ(0, mClient->Remove(mPaths[i].c_str())) << mPaths[i];
+    }
+    EXPECT_EQ(0, mClient->Remove(compacted));
+}
+
+} // namespace Test
+} // namespace KFS
@@ -0,0 +1,609 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/LatencyHistogram.h"
+#include "common/MsgLogger.h"
+#include "common/time.h"
+#include "libclient/KfsClient.h"
+#include "libclient/RSStriper.h"
+#include "tests/environments/MetaserverEnvironment.h"
+#include "tests/integtest.h"
+
+namespace KFS {
+namespace Test {
+
+using namespace std;
+
+/**
+ * QFSPerfTest runs a fixed set of throughput and latency scenarios against the
+ * metaserver and chunkservers started by the integration test environments:
+ * metadata operations, sequential and random reads and writes, record
+ * appends, and Reed-Solomon reads with and without data stripe failures. The
+ * perf tests are skipped unless QFS_PERF_TEST environment variable is set,
+ * e.g. with make gtest-perf. The following environment variables control the
+ * perf mode:
+ *
+ * QFS_PERF_RESULTS   -- results json file path,
+ *                       default is qfs-perf-results.json
+ * QFS_PERF_BASELINE  -- baseline json file path, i.e. the results file of a
+ *                       previous run. If set, the scenario fails if its
+ *                       throughput is lower than the baseline by more than
+ *                       the threshold, or its 99th latency percentile is
+ *                       greater than the baseline by more than the latency
+ *                       threshold.
+ * QFS_PERF_THRESHOLD -- throughput regression threshold, in percent,
+ *                       default is 10. The baseline scenario
+ *                       "threshold_pct" value, if present, takes precedence.
+ * QFS_PERF_LATENCY_THRESHOLD -- p99 latency regression threshold in percent,
+ *                       default is 50, 0 or negative disables latency check.
+ *                       The baseline scenario "latency_threshold_pct" value,
+ *                       if present, takes precedence.
+ * QFS_PERF_FILE_SIZE_MB -- data scenarios file size, default is 64.
+ * QFS_PERF_META_OPS  -- number of metadata operations per scenario, default
+ *                       is 2000.
+ */
+class QFSPerfTest : public QFSTest
+{
+public:
+    struct Result
+    {
+        Result()
+            : name(),
+              ops(0),
+              bytes(0),
+              errors(0),
+              elapsedUsec(0),
+              latency()
+        { }
+
+        string           name;
+        int64_t          ops;
+        int64_t          bytes;
+        int64_t          errors;
+        int64_t          elapsedUsec;
+        LatencyHistogram latency;
+
+        double Seconds() const { return elapsedUsec * 1e-6; }
+        double OpsPerSec() const {
+            return elapsedUsec <= 0 ? 0. : ops / Seconds();
+        }
+        double MBPerSec() const {
+            return elapsedUsec <= 0 ? 0. : bytes / (Seconds() * (1 << 20));
+        }
+        // Data scenarios are compared by MB/sec, metadata by ops/sec.
+        double Throughput() const {
+            return bytes > 0 ? MBPerSec() : OpsPerSec();
+        }
+    };
+
+    static void SetUpTestCase();
+    static void TearDownTestCase();
+
+    virtual void SetUp();
+    virtual void TearDown();
+
+protected:
+    static bool IsEnabled() { return sEnabledFlag; }
+    static int64_t GetEnvInt(const char* name, int64_t defaultValue);
+    static void WaitForChunkservers();
+
+    /**
+     * Begin starts timing of a new scenario, End stops the timing, records the
+     * scenario result, and compares it against the baseline, if any.
+     */
+    Result& Begin(const string& name);
+    void End(Result& result);
+    /**
+     * Times a single operation and adds its latency to the result.
+     */
+    void AddOp(Result& result, int64_t startUsec, int64_t bytes, bool ok);
+
+    void Fill(int64_t pos, char* buf, size_t size) const;
+    void WriteFile(const string& name, const string& path, int numStripes,
+            int numRecoveryStripes, int stripedType);
+    void ReadFile(const string& name, const string& path);
+
+    static KfsClient*     sClient;
+    static vector<Result> sResults;
+    static string         sBaseline;
+    static string         sTestDir;
+    static bool           sEnabledFlag;
+    static int64_t        sFileSize;
+    static int64_t        sMetaOps;
+    static double         sThresholdPct;
+    static double         sLatencyThresholdPct;
+
+    vector<char> mBuf;
+
+private:
+    static void WriteResults();
+    static bool GetBaselineValue(const string& scenario, const char* key,
+            double& value);
+    void CompareBaseline(const Result& result);
+};
+
+static const int kIoSize         = 1 << 20;
+static const int kRandomIoSize   = 64 << 10;
+static const int kRandomIoCount  = 512;
+static const int kAppendSize     = 64 << 10;
+static const int kRSStripes      = 6;
+static const int kRSRecovery     = 3;
+static const int kRSStripeSize   = 64 << 10;
+
+KfsClient*                  QFSPerfTest::sClient = 0;
+vector<QFSPerfTest::Result> QFSPerfTest::sResults;
+string                      QFSPerfTest::sBaseline;
+string                      QFSPerfTest::sTestDir = "/qfsperftest";
+bool                        QFSPerfTest::sEnabledFlag = false;
+int64_t                     QFSPerfTest::sFileSize = 0;
+int64_t                     QFSPerfTest::sMetaOps = 0;
+double                      QFSPerfTest::sThresholdPct = 0;
+double                      QFSPerfTest::sLatencyThresholdPct = 0;
+
+int64_t
+QFSPerfTest::GetEnvInt(const char* name, int64_t defaultValue)
+{
+    const char* const value = getenv(name);
+    if (value == NULL || *value == 0) {
+        return defaultValue;
+    }
+    return strtoll(value, NULL, 0);
+}
+
+void
+QFSPerfTest::SetUpTestCase()
+{
+    sEnabledFlag = getenv("QFS_PERF_TEST") != NULL;
+    if (!sEnabledFlag) {
+        cout << "QFS_PERF_TEST is not set, skipping perf tests" << endl;
+        return;
+    }
+    sFileSize = max(int64_t(1), GetEnvInt("QFS_PERF_FILE_SIZE_MB", 64)) << 20;
+    sMetaOps = max(int64_t(1), GetEnvInt("QFS_PERF_META_OPS", 2000));
+    sThresholdPct = (double)GetEnvInt("QFS_PERF_THRESHOLD", 10);
+    sLatencyThresholdPct =
+        (double)GetEnvInt("QFS_PERF_LATENCY_THRESHOLD", 50);
+
+    const char* const baseline = getenv("QFS_PERF_BASELINE");
+    if (baseline != NULL && *baseline != 0) {
+        ifstream in(baseline);
+        EXPECT_TRUE(in.good()) << "cannot open baseline: " << baseline;
+        ostringstream os;
+        os << in.rdbuf();
+        sBaseline = os.str();
+    }
+
+    MsgLogger::Init(0, MsgLogger::kLogLevelWARN);
+    sClient = KfsClient::Connect(sMetaserver->GetHostname(),
+            sMetaserver->GetClientPort(), 0);
+    ASSERT_TRUE(sClient != NULL) << "failed to connect to metaserver";
+    sClient->RmdirsFast(sTestDir.c_str());
+    ASSERT_EQ(0, sClient->Mkdirs(sTestDir.c_str()));
+    WaitForChunkservers();
+}
+
+void
+QFSPerfTest::WaitForChunkservers()
+{
+    // The environments do not wait for the chunkservers to connect to the
+    // metaserver. Wait until the data can be written, in order not to time
+    // the chunkservers connect with the first scenario.
+    const string path = sTestDir + "/ready";
+    const char data[] = "ready";
+    const int kMaxWaitSec = 60;
+    for (int i = 0; i < kMaxWaitSec; i++) {
+        const int fd = sClient->Create(path.c_str());
+        ASSERT_LE(0, fd) << path << ": " << ErrorCodeToStr(fd);
+        const bool ok = sClient->Write(fd, data, sizeof(data)) ==
+            (ssize_t)sizeof(data);
+        if (sClient->Close(fd) == 0 && ok) {
+            sClient->Remove(path.c_str());
+            return;
+        }
+        sleep(1);
+    }
+    FAIL() << "chunkservers are not available";
+}
+
+void
+QFSPerfTest::TearDownTestCase()
+{
+    if (!sEnabledFlag) {
+        return;
+    }
+    WriteResults();
+    if (sClient != NULL) {
+        sClient->RmdirsFast(sTestDir.c_str());
+        delete sClient;
+        sClient = 0;
+    }
+    sResults.clear();
+    sBaseline.clear();
+}
+
+void
+QFSPerfTest::SetUp()
+{
+    QFSTest::SetUp();
+    if (IsEnabled()) {
+        ASSERT_TRUE(sClient != NULL);
+        mBuf.resize(kIoSize);
+    }
+}
+
+void
+QFSPerfTest::TearDown()
+{
+    vector<char>().swap(mBuf);
+    client::RSStriperSetReadFailureInjection(0);
+    QFSTest::TearDown();
+}
+
+QFSPerfTest::Result&
+QFSPerfTest::Begin(const string& name)
+{
+    sResults.push_back(Result());
+    Result& result = sResults.back();
+    result.name = name;
+    result.elapsedUsec = -microseconds();
+    return result;
+}
+
+void
+QFSPerfTest::End(Result& result)
+{
+    result.elapsedUsec += microseconds();
+    cout << "perf: " << result.name
+        << " ops: " << result.ops
+        << " bytes: " << result.bytes
+        << " errors: " << result.errors
+        << " sec: " << result.Seconds()
+        << " ops/sec: " << result.OpsPerSec()
+        << " MB/sec: " << result.MBPerSec()
+        << " p50 usec: " << result.latency.GetPercentile(500)
+        << " p99 usec: " << result.latency.GetPercentile(990)
+        << endl;
+    EXPECT_EQ(0, result.errors) << result.name << ": errors";
+    CompareBaseline(result);
+}
+
+void
+QFSPerfTest::AddOp(Result& result, int64_t startUsec, int64_t bytes, bool ok)
+{
+    result.latency.Add(microseconds() - startUsec);
+    result.ops++;
+    if (ok) {
+        result.bytes += bytes;
+    } else {
+        result.errors++;
+    }
+}
+
+void
+QFSPerfTest::Fill(int64_t pos, char* buf, size_t size) const
+{
+    // Position dependent pattern, in order to catch misplaced data with no
+    // per byte cost other than the write.
+    uint64_t* const ptr = reinterpret_cast<uint64_t*>(buf);
+    const uint64_t base = (uint64_t)pos / sizeof(uint64_t);
+    for (size_t i = 0; i < size / sizeof(uint64_t); i++) {
+        ptr[i] = (base + i) * 0x9E3779B97F4A7C15ull;
+    }
+}
+
+void
+QFSPerfTest::WriteFile(const string& name, const string& path,
+        int numStripes, int numRecoveryStripes, int stripedType)
+{
+    const int fd = sClient->Create(path.c_str(),
+            numStripes > 0 ? 1 : 3, false, numStripes, numRecoveryStripes,
+            numStripes > 0 ? kRSStripeSize : 0, stripedType);
+    ASSERT_LE(0, fd) << path << ": " << ErrorCodeToStr(fd);
+    Result& result = Begin(name);
+    for (int64_t pos = 0; pos < sFileSize; pos += kIoSize) {
+        const int size = (int)min(int64_t(kIoSize), sFileSize - pos);
+        Fill(pos, &mBuf[0], size);
+        const int64_t start = microseconds();
+        const ssize_t ret = sClient->Write(fd, &mBuf[0], size);
+        AddOp(result, start, size, ret == size);
+    }
+    const int64_t start = microseconds();
+    const int status = sClient->Close(fd);
+    EXPECT_EQ(0, status) << path << ": close: " << ErrorCodeToStr(status);
+    result.latency.Add(microseconds() - start);
+    End(result);
+}
+
+void
+QFSPerfTest::ReadFile(const string& name, const string& path)
+{
+    const int fd = sClient->Open(path.c_str(), O_RDONLY);
+    ASSERT_LE(0, fd) << path << ": " << ErrorCodeToStr(fd);
+    Result& result = Begin(name);
+    for (int64_t pos = 0; pos < sFileSize; pos += kIoSize) {
+        const int size = (int)min(int64_t(kIoSize), sFileSize - pos);
+        const int64_t start = microseconds();
+        const ssize_t ret = sClient->Read(fd, &mBuf[0], size);
+        AddOp(result, start, size, ret == size);
+    }
+    sClient->Close(fd);
+    End(result);
+}
+
+void
+QFSPerfTest::WriteResults()
+{
+    const char* const path = getenv("QFS_PERF_RESULTS");
+    const string fileName = (path != NULL && *path != 0) ?
+        path : "qfs-perf-results.json";
+    ofstream out(fileName.c_str());
+    if (!out) {
+        ADD_FAILURE() << "cannot create perf results: " << fileName;
+        return;
+    }
+    // One scenario object per line with no nested objects, in order to keep
+    // the baseline parsing trivial.
+    out << fixed << setprecision(3);
+    out << "{\n"
+        "\"build_type\": \"" <<
+            (getenv("BUILD_TYPE") ? getenv("BUILD_TYPE") : "release") << "\",\n"
+        "\"file_size\": " << sFileSize << ",\n"
+        "\"meta_ops\": " << sMetaOps << ",\n"
+        "\"scenarios\": [\n";
+    for (size_t i = 0; i < sResults.size(); i++) {
+        const Result& r = sResults[i];
+        double baseline = 0;
+        const bool hasBaseline =
+            GetBaselineValue(r.name, "throughput", baseline) && baseline > 0;
+        out << "{"
+            "\"name\": \"" << r.name << "\", "
+            "\"ops\": " << r.ops << ", "
+            "\"bytes\": " << r.bytes << ", "
+            "\"errors\": " << r.errors << ", "
+            "\"seconds\": " << r.Seconds() << ", "
+            "\"ops_per_sec\": " << r.OpsPerSec() << ", "
+            "\"mb_per_sec\": " << r.MBPerSec() << ", "
+            "\"throughput\": " << r.Throughput() << ", "
+            "\"latency_usec_mean\": " << (r.latency.GetCount() <= 0 ? 0. :
+                (double)r.latency.GetTotal() / r.latency.GetCount()) << ", "
+            "\"latency_usec_p50\": " << r.latency.GetPercentile(500) << ", "
+            "\"latency_usec_p90\": " << r.latency.GetPercentile(900) << ", "
+            "\"latency_usec_p99\": " << r.latency.GetPercentile(990) << ", "
+            "\"latency_usec_max\": " << r.latency.GetMax();
+        if (hasBaseline) {
+            out << ", "
+                "\"baseline_throughput\": " << baseline << ", "
+                "\"change_pct\": " <<
+                    (r.Throughput() - baseline) * 100. / baseline;
+        }
+        out << "}" << (i + 1 < sResults.size() ? "," : "") << "\n";
+    }
+    out << "]\n}\n";
+    cout << "perf results: " << fileName << endl;
+}
+
+bool
+QFSPerfTest::GetBaselineValue(const string& scenario, const char* key,
+        double& value)
+{
+    if (sBaseline.empty()) {
+        return false;
+    }
+    const string name = "\"name\": \"" + scenario + "\"";
+    const size_t start = sBaseline.find(name);
+    if (start == string::npos) {
+        return false;
+    }
+    const size_t end = sBaseline.find('}', start);
+    const string field = string("\"") + key + "\":";
+    const size_t pos = sBaseline.find(field, start);
+    if (pos == string::npos || end <= pos) {
+        return false;
+    }
+    const char* const ptr = sBaseline.c_str() + pos + field.size();
+    char* endPtr = 0;
+    value = strtod(ptr, &endPtr);
+    return endPtr != ptr;
+}
+
+void
+QFSPerfTest::CompareBaseline(const Result& result)
+{
+    double baseline = 0;
+    if (!GetBaselineValue(result.name, "throughput", baseline) ||
+            baseline <= 0) {
+        return;
+    }
+    double threshold = sThresholdPct;
+    GetBaselineValue(result.name, "threshold_pct", threshold);
+    const double throughput = result.Throughput();
+    EXPECT_GE(throughput, baseline * (1. - threshold / 100.))
+        << result.name << ": throughput regression:"
+        << " baseline: " << baseline
+        << " current: " << throughput
+        << " threshold: " << threshold << "%";
+
+    double latencyThreshold = sLatencyThresholdPct;
+    GetBaselineValue(result.name, "latency_threshold_pct", latencyThreshold);
+    double latency = 0;
+    if (latencyThreshold <= 0 ||
+            !GetBaselineValue(result.name, "latency_usec_p99", latency) ||
+            latency <= 0) {
+        return;
+    }
+    const double p99 = (double)result.latency.GetPercentile(990);
+    EXPECT_LE(p99, latency * (1. + latencyThreshold / 100.))
+        << result.name << ": p99 latency regression:"
+        << " baseline: " << latency
+        << " current: " << p99
+        << " threshold: " << latencyThreshold << "%";
+}
+
+TEST_F(QFSPerfTest, MetaOps)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    const string dir = sTestDir + "/meta";
+    ASSERT_EQ(0, sClient->Mkdirs(dir.c_str()));
+    vector<string> paths;
+    for (int64_t i = 0; i < sMetaOps; i++) {
+        ostringstream os;
+        os << dir << "/f" << i;
+        paths.push_back(os.str());
+    }
+
+    Result& create = Begin("meta_create");
+    for (size_t i = 0; i < paths.size(); i++) {
+        const int64_t start = microseconds();
+        const int fd = sClient->Create(paths[i].c_str());
+        const bool ok = fd >= 0 && sClient->Close(fd) == 0;
+        AddOp(create, start, 0, ok);
+    }
+    End(create);
+
+    Result& stat = Begin("meta_stat");
+    for (size_t i = 0; i < paths.size(); i++) {
+        KfsFileAttr attr;
+        const int64_t start = microseconds();
+        AddOp(stat, start, 0, sClient->Stat(paths[i].c_str(), attr) == 0);
+    }
+    End(stat);
+
+    Result& readdir = Begin("meta_readdir");
+    for (int i = 0; i < 16; i++) {
+        vector<string> entries;
+        const int64_t start = microseconds();
+        const bool ok = sClient->Readdir(dir.c_str(), entries) == 0 &&
+            (int64_t)entries.size() >= sMetaOps;
+        AddOp(readdir, start, 0, ok);
+    }
+    End(readdir);
+
+    Result& rename = Begin("meta_rename");
+    for (size_t i = 0; i < paths.size(); i++) {
+        const string target = paths[i] + ".r";
+        const int64_t start = microseconds();
+        const bool ok = sClient->Rename(paths[i].c_str(), target.c_str()) == 0;
+        AddOp(rename, start, 0, ok);
+        paths[i] = target;
+    }
+    End(rename);
+
+    Result& remove = Begin("meta_remove");
+    for (size_t i = 0; i < paths.size(); i++) {
+        const int64_t start = microseconds();
+        AddOp(remove, start, 0, sClient->Remove(paths[i].c_str()) == 0);
+    }
+    End(remove);
+}
+
+TEST_F(QFSPerfTest, SequentialReadWrite)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    const string path = sTestDir + "/seq";
+    WriteFile("seq_write", path, 0, 0, KFS_STRIPED_FILE_TYPE_NONE);
+    ReadFile("seq_read", path);
+}
+
+TEST_F(QFSPerfTest, RandomReadWrite)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    const string path = sTestDir + "/random";
+    WriteFile("random_init_write", path, 0, 0, KFS_STRIPED_FILE_TYPE_NONE);
+    const int64_t blocks = max(int64_t(1), sFileSize / kRandomIoSize);
+    unsigned int seed = 12345; // Same io sequence with each run.
+
+    int fd = sClient->Open(path.c_str(), O_RDWR);
+    ASSERT_LE(0, fd) << path << ": " << ErrorCodeToStr(fd);
+    Result& write = Begin("random_write");
+    for (int i = 0; i < kRandomIoCount; i++) {
+        const int64_t pos = (rand_r(&seed) % blocks) * kRandomIoSize;
+        Fill(pos, &mBuf[0], kRandomIoSize);
+        const int64_t start = microseconds();
+        const bool ok = sClient->Seek(fd, pos) == pos &&
+            sClient->Write(fd, &mBuf[0], kRandomIoSize) == kRandomIoSize;
+        AddOp(write, start, kRandomIoSize, ok);
+    }
+    const int64_t start = microseconds();
+    EXPECT_EQ(0, sClient->Close(fd));
+    write.latency.Add(microseconds() - start);
+    End(write);
+
+    fd = sClient->Open(path.c_str(), O_RDONLY);
+    ASSERT_LE(0, fd) << path << ": " << ErrorCodeToStr(fd);
+    sClient->SetReadAheadSize(fd, 0);
+    Result& read = Begin("random_read");
+    for (int i = 0; i < kRandomIoCount; i++) {
+        const int64_t pos = (rand_r(&seed) % blocks) * kRandomIoSize;
+        const int64_t start = microseconds();
+        const bool ok = sClient->PRead(fd, pos, &mBuf[0], kRandomIoSize) ==
+            kRandomIoSize;
+        AddOp(read, start, kRandomIoSize, ok);
+    }
+    sClient->Close(fd);
+    End(read);
+}
+
+TEST_F(QFSPerfTest, RecordAppend)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    const string path = sTestDir + "/append";
+    const int fd = sClient->Open(path.c_str(),
+            O_CREAT | O_WRONLY | O_APPEND, 3);
+    ASSERT_LE(0, fd) << path << ": " << ErrorCodeToStr(fd);
+    Result& result = Begin("append");
+    for (int64_t pos = 0; pos < sFileSize; pos += kAppendSize) {
+        Fill(pos, &mBuf[0], kAppendSize);
+        const int64_t start = microseconds();
+        const bool ok = sClient->AtomicRecordAppend(
+                fd, &mBuf[0], kAppendSize) == kAppendSize;
+        AddOp(result, start, kAppendSize, ok);
+    }
+    const int64_t start = microseconds();
+    EXPECT_EQ(0, sClient->Close(fd));
+    result.latency.Add(microseconds() - start);
+    End(result);
+}
+
+TEST_F(QFSPerfTest, ReedSolomon)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    const string path = sTestDir + "/rs";
+    WriteFile("rs_write", path, kRSStripes, kRSRecovery,
+            KFS_STRIPED_FILE_TYPE_RS);
+    ReadFile("rs_read", path);
+    // Client side data stripe read failure injection: no chunk reads are
+    // issued for the failed stripes, the data is reconstructed by the RS
+    // recovery.
+    client::RSStriperSetReadFailureInjection(1);
+    ReadFile("rs_degraded_read", path);
+    client::RSStriperSetReadFailureInjection((uint64_t(1) << kRSRecovery) - 1);
+    ReadFile("rs_degraded_read_max", path);
+    client::RSStriperSetReadFailureInjection(0);
+}
+
+} // namespace Test
+} // namespace KFS
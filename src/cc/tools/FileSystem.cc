@@ -579,6 +579,12 @@ public:
     {
         return Errno(rename(inSrcName.c_str(), inDstName.c_str()));
     }
+    virtual int CopyFileChunks(
+        const string& /* inSrcName */,
+        const string& /* inDstName */)
+    {
+        return -ENOTSUP;
+    }
     virtual int SetUMask(
         mode_t inUMask)
     {
@@ -1177,6 +1183,12 @@ public:
         return KfsClient::Rename(inSrcName.c_str(), inDstName.c_str(),
             kOverwriteFlag);
     }
+    virtual int CopyFileChunks(
+        const string& inSrcName,
+        const string& inDstName)
+    {
+        return KfsClient::CopyFileChunks(inSrcName.c_str(), inDstName.c_str());
+    }
     virtual int SetUMask(
         mode_t inUMask)
     {
@@ -172,6 +172,11 @@ public:
     virtual int Rename(
         const string& inSrcName,
         const string& inDstName) = 0;
+    // Copy file data into an existing empty file without transferring the
+    // data through the client, if supported by the file system.
+    virtual int CopyFileChunks(
+        const string& inSrcName,
+        const string& inDstName) = 0;
     virtual int SetUMask(
         mode_t inUMask) = 0;
     virtual int GetUMask(
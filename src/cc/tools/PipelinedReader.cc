@@ -0,0 +1,199 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Pipelined sequential file reader implementation.
+//
+//----------------------------------------------------------------------------
+
+#include "PipelinedReader.h"
+
+#include "qcdio/qcstutils.h"
+
+#include <algorithm>
+
+namespace KFS
+{
+namespace tools
+{
+using std::max;
+using std::min;
+
+PipelinedReader::PipelinedReader(
+    KfsClient& inClient,
+    int        inDepth,
+    size_t     inBufSize)
+    : KfsClient::IoCompletion(),
+      mClient(inClient),
+      mDepth(max(1, inDepth)),
+      mBufSize(max(size_t(1), inBufSize)),
+      mStoragePtr(new char[mDepth * mBufSize]),
+      mBuffers(new Buffer[mDepth]),
+      mMutex(),
+      mCond(),
+      mFd(-1),
+      mNextPos(0),
+      mEnd(-1),
+      mHead(0),
+      mReleaseIdx(-1),
+      mRestartPos(-1),
+      mInFlightCount(0),
+      mEofFlag(true)
+{
+    for (int i = 0; i < mDepth; i++) {
+        mBuffers[i].mBufPtr = mStoragePtr + i * mBufSize;
+    }
+}
+
+PipelinedReader::~PipelinedReader()
+{
+    PipelinedReader::Stop();
+    delete [] mBuffers;
+    delete [] mStoragePtr;
+}
+
+void
+PipelinedReader::Start(
+    int        inFd,
+    chunkOff_t inPos,
+    chunkOff_t inEnd)
+{
+    mEofFlag = true;
+    Stop();
+    mFd  = inFd;
+    mEnd = inEnd;
+    Restart(inPos);
+}
+
+void
+PipelinedReader::Restart(
+    chunkOff_t inPos)
+{
+    mNextPos    = inPos;
+    mHead       = 0;
+    mReleaseIdx = -1;
+    mRestartPos = -1;
+    mEofFlag    = false;
+    for (int i = 0; i < mDepth; i++) {
+        Issue(mBuffers[i]);
+    }
+}
+
+void
+PipelinedReader::Issue(
+    Buffer& inBuffer)
+{
+    inBuffer.mPos    = mNextPos;
+    inBuffer.mSize   = 0;
+    inBuffer.mStatus = 0;
+    if (mEofFlag || mFd < 0 || (0 <= mEnd && mEnd <= mNextPos)) {
+        inBuffer.mDoneFlag = true;
+        mEofFlag           = true;
+        return;
+    }
+    const size_t theSize = 0 <= mEnd ?
+        (size_t)min(chunkOff_t(mBufSize), mEnd - mNextPos) : mBufSize;
+    {
+        QCStMutexLocker theLocker(mMutex);
+        inBuffer.mDoneFlag = false;
+        mInFlightCount++;
+    }
+    // Do not hold the mutex, as the completion can be invoked by the client
+    // protocol worker thread before the read returns.
+    const ssize_t theRet = mClient.ReadAsync(
+        mFd, mNextPos, inBuffer.mBufPtr, theSize, *this);
+    if (theRet <= 0) {
+        QCStMutexLocker theLocker(mMutex);
+        inBuffer.mStatus   = theRet;
+        inBuffer.mDoneFlag = true;
+        mInFlightCount--;
+        mEofFlag = true;
+        return;
+    }
+    // The read is truncated to the end of file.
+    inBuffer.mSize = theRet;
+    mNextPos += theRet;
+    if ((size_t)theRet < theSize) {
+        mEofFlag = true;
+    }
+}
+
+ssize_t
+PipelinedReader::Next(
+    const char*& outBufPtr)
+{
+    outBufPtr = 0;
+    if (0 <= mRestartPos) {
+        // Discard the reads past the short read, and restart the pipeline.
+        const chunkOff_t thePos = mRestartPos;
+        mRestartPos = -1;
+        mEofFlag    = true;
+        Stop();
+        Restart(thePos);
+    } else if (0 <= mReleaseIdx) {
+        Issue(mBuffers[mReleaseIdx]);
+        mReleaseIdx = -1;
+    }
+    Buffer& theBuf = mBuffers[mHead];
+    {
+        QCStMutexLocker theLocker(mMutex);
+        while (! theBuf.mDoneFlag) {
+            mCond.Wait(mMutex);
+        }
+    }
+    if (theBuf.mStatus <= 0) {
+        return theBuf.mStatus;
+    }
+    outBufPtr = theBuf.mBufPtr;
+    if (theBuf.mStatus < theBuf.mSize) {
+        mRestartPos = theBuf.mPos + theBuf.mStatus;
+        return theBuf.mStatus;
+    }
+    mReleaseIdx = mHead;
+    mHead       = (mHead + 1) % mDepth;
+    return theBuf.mStatus;
+}
+
+void
+PipelinedReader::Stop()
+{
+    QCStMutexLocker theLocker(mMutex);
+    while (0 < mInFlightCount) {
+        mCond.Wait(mMutex);
+    }
+}
+
+void
+PipelinedReader::Done(
+    int        /* inFd */,
+    chunkOff_t /* inPos */,
+    char*      inBufPtr,
+    ssize_t    inStatus)
+{
+    QCStMutexLocker theLocker(mMutex);
+    Buffer& theBuf = mBuffers[(inBufPtr - mStoragePtr) / mBufSize];
+    theBuf.mStatus   = inStatus;
+    theBuf.mDoneFlag = true;
+    mInFlightCount--;
+    mCond.Notify();
+}
+
+}
+}
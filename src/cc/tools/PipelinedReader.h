@@ -0,0 +1,117 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Pipelined sequential file reader. Keeps up to the configured number
+// of asynchronous positional reads in flight, with the reads spanning
+// multiple chunks fetched in parallel, and returns the data in the file
+// order.
+//
+//----------------------------------------------------------------------------
+
+#ifndef TOOLS_PIPELINED_READER_H
+#define TOOLS_PIPELINED_READER_H
+
+#include "libclient/KfsClient.h"
+#include "qcdio/QCMutex.h"
+
+#include <sys/types.h>
+
+namespace KFS
+{
+namespace tools
+{
+
+class PipelinedReader : public KfsClient::IoCompletion
+{
+public:
+    PipelinedReader(
+        KfsClient& inClient,
+        int        inDepth,
+        size_t     inBufSize);
+    virtual ~PipelinedReader();
+    // Start reading the file from the position, up to the end position, or
+    // end of file, if the end position is negative.
+    void Start(
+        int        inFd,
+        chunkOff_t inPos,
+        chunkOff_t inEnd);
+    // Returns the next buffer in the file order. The buffer remains valid
+    // until the next call. Returns the buffer size, 0 at the end of file, or
+    // negative error code.
+    ssize_t Next(
+        const char*& outBufPtr);
+    // Wait for all outstanding reads to complete. Must be invoked prior to
+    // closing the file.
+    void Stop();
+    virtual void Done(
+        int        inFd,
+        chunkOff_t inPos,
+        char*      inBufPtr,
+        ssize_t    inStatus);
+private:
+    class Buffer
+    {
+    public:
+        Buffer()
+            : mBufPtr(0),
+              mPos(-1),
+              mSize(0),
+              mStatus(0),
+              mDoneFlag(true)
+            {}
+        char*      mBufPtr;
+        chunkOff_t mPos;
+        ssize_t    mSize;
+        ssize_t    mStatus;
+        bool       mDoneFlag;
+    };
+
+    KfsClient&   mClient;
+    const int    mDepth;
+    const size_t mBufSize;
+    char* const  mStoragePtr;
+    Buffer*      mBuffers;
+    QCMutex      mMutex;
+    QCCondVar    mCond;
+    int          mFd;
+    chunkOff_t   mNextPos;
+    chunkOff_t   mEnd;
+    int          mHead;
+    int          mReleaseIdx;
+    chunkOff_t   mRestartPos;
+    int          mInFlightCount;
+    bool         mEofFlag;
+
+    void Issue(
+        Buffer& inBuffer);
+    void Restart(
+        chunkOff_t inPos);
+private:
+    PipelinedReader(
+        const PipelinedReader& inReader);
+    PipelinedReader& operator=(
+        const PipelinedReader& inReader);
+};
+
+}
+}
+
+#endif /* TOOLS_PIPELINED_READER_H */
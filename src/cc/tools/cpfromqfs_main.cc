@@ -30,6 +30,7 @@
 
 #include "libclient/KfsClient.h"
 #include "common/MsgLogger.h"
+#include "PipelinedReader.h"
 
 #include <unistd.h>
 #include <string.h>
@@ -52,6 +53,7 @@ using std::vector;
 using std::min;
 using std::max;
 using std::numeric_limits;
+using tools::PipelinedReader;
 
 class CpFromKfs
 {
@@ -67,10 +69,13 @@ public:
           mBufSize(0),
           mAllocBufSize(0),
           mReadExitCount(-1),
-          mKfsBuf(0)
+          mPipelineDepth(0),
+          mKfsBuf(0),
+          mReader(0)
         {}
     ~CpFromKfs()
     {
+        delete mReader;
         delete mKfsClient;
         delete [] mKfsBuf;
     }
@@ -88,7 +93,9 @@ private:
     int        mBufSize;
     int        mAllocBufSize;
     int        mReadExitCount;
+    int        mPipelineDepth;
     char*      mKfsBuf;
+    PipelinedReader* mReader;
 
     // Given a kfsdirname, restore it to dirname.  Dirname will be created
     // if it doesn't exist.
@@ -125,7 +132,7 @@ CpFromKfs::Run(int argc, char **argv)
     const char*         config     = 0;
     int                 optchar;
 
-    while ((optchar = getopt(argc, argv, "d:hp:s:k:a:b:w:r:R:D:T:X:F:Svf:M:")) != -1) {
+    while ((optchar = getopt(argc, argv, "d:hp:s:k:a:b:w:r:R:D:T:X:F:Svf:M:P:")) != -1) {
         switch (optchar) {
             case 'd':
                 localPath = optarg;
@@ -157,6 +164,9 @@ CpFromKfs::Run(int argc, char **argv)
             case 'M':
                 mMaxRead = (chunkOff_t)atof(optarg);
                 break;
+            case 'P':
+                mPipelineDepth = atoi(optarg);
+                break;
             case 'w':
                 mBufSize = (int)atof(optarg);
                 break;
@@ -213,6 +223,10 @@ CpFromKfs::Run(int argc, char **argv)
             " [-X n]     -- debugging: call exit(1) after n read calls\n"
             " [-f file]  -- configuration file name\n"
             " [-M ]      -- maximum number of bytes to read per file\n"
+            " [-P n]     -- keep up to n asynchronous reads of write buffer"
+                            " size in flight, in order to fetch multiple"
+                            " chunks in parallel; not used with -S;"
+                            " default 0 -- synchronous reads\n"
         ;
         return (1);
     }
@@ -354,7 +368,15 @@ CpFromKfs::RestoreFile2(string kfsfilename, string localfilename)
     if (theSize <= 0) {
         theSize = 1 << 20;
     }
-    if (theSize != mAllocBufSize || ! mKfsBuf) {
+    const bool pipelineFlag = 0 < mPipelineDepth && ! mSkipHolesFlag;
+    if (pipelineFlag) {
+        if (theSize != mAllocBufSize || ! mReader) {
+            delete mReader;
+            mReader = new PipelinedReader(
+                *mKfsClient, mPipelineDepth, (size_t)theSize);
+            mAllocBufSize = theSize;
+        }
+    } else if (theSize != mAllocBufSize || ! mKfsBuf) {
         delete [] mKfsBuf;
         mKfsBuf = new char[theSize];
         mAllocBufSize = theSize;
@@ -379,9 +401,26 @@ CpFromKfs::RestoreFile2(string kfsfilename, string localfilename)
 
     chunkOff_t rem = mMaxRead;
     int        err = 0;
+    if (pipelineFlag) {
+        chunkOff_t end = -1;
+        if (mMaxRead < numeric_limits<chunkOff_t>::max() - pos) {
+            end = pos + mMaxRead;
+        }
+        if (0 <= mStop && (end < 0 || mStop < end)) {
+            end = mStop;
+        }
+        mReader->Start(kfsfd, pos, end);
+    }
     while (0 < rem) {
-        const int nRead = mKfsClient->Read(kfsfd, mKfsBuf,
-            (size_t)min(rem, (chunkOff_t)mAllocBufSize));
+        const char* buf;
+        int         nRead;
+        if (pipelineFlag) {
+            nRead = (int)mReader->Next(buf);
+        } else {
+            buf   = mKfsBuf;
+            nRead = mKfsClient->Read(kfsfd, mKfsBuf,
+                (size_t)min(rem, (chunkOff_t)mAllocBufSize));
+        }
         if (nRead <= 0) {
             if (nRead < 0) {
                 err = nRead;
@@ -397,7 +436,7 @@ CpFromKfs::RestoreFile2(string kfsfilename, string localfilename)
         }
         pos += nRead;
         rem -= nRead;
-        for (const char* p = mKfsBuf, * const e = p + nRead; p < e; ) {
+        for (const char* p = buf, * const e = p + nRead; p < e; ) {
             const ssize_t n = write(localFd, p, e - p);
             if (n < 0) {
                 if (errno != EINTR && errno != EAGAIN) {
@@ -424,6 +463,10 @@ CpFromKfs::RestoreFile2(string kfsfilename, string localfilename)
             "stopping: max read: " << mMaxRead <<
         KFS_LOG_EOM;
     }
+    if (pipelineFlag) {
+        // Wait for the outstanding reads prior to closing the file.
+        mReader->Stop();
+    }
 
     mKfsClient->Close(kfsfd);
     close(localFd);
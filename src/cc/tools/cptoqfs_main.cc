@@ -30,6 +30,9 @@
 
 #include "libclient/KfsClient.h"
 #include "common/MsgLogger.h"
+#include "qcdio/QCThread.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -40,12 +43,20 @@
 #include <dirent.h>
 
 #include <iostream>
+#include <algorithm>
 #include <cerrno>
+#include <string>
+#include <vector>
+#include <utility>
 
 namespace KFS
 {
 using std::cout;
 using std::string;
+using std::vector;
+using std::pair;
+using std::make_pair;
+using std::min;
 
 class CpToKfs
 {
@@ -69,7 +80,16 @@ public:
           mNumRecoveryStripes(0),
           mMinSTier(kKfsSTierMax),
           mMaxSTier(kKfsSTierMax),
-          mStartPos(0)
+          mStartPos(0),
+          mParallelCount(1),
+          mMutex(),
+          mStatus(0),
+          mFiles(),
+          mNextFileIdx(0),
+          mSrcFd(-1),
+          mRangeSize(0),
+          mNextRangePos(0),
+          mEndPos(0)
     {}
     ~CpToKfs()
     {
@@ -99,6 +119,48 @@ private:
     kfsSTier_t mMinSTier;
     kfsSTier_t mMaxSTier;
     int64_t    mStartPos;
+    int        mParallelCount;
+
+    class CopyThread;
+    typedef int (CpToKfs::*CopyFunc)(CopyThread& thread);
+    class CopyThread : public QCRunnable
+    {
+    public:
+        CopyThread()
+            : mOuterPtr(0),
+              mFunc(0),
+              mThread(),
+              mReadBuf(0),
+              mKfsFd(-1),
+              mStatus(0)
+            {}
+        ~CopyThread()
+            { delete [] mReadBuf; }
+        virtual void Run()
+            { mStatus = (mOuterPtr->*mFunc)(*this); }
+        CpToKfs* mOuterPtr;
+        CopyFunc mFunc;
+        QCThread mThread;
+        char*    mReadBuf;
+        int      mKfsFd;
+        int      mStatus;
+    private:
+        CopyThread(const CopyThread&);
+        CopyThread& operator=(const CopyThread&);
+    };
+    typedef vector<pair<string, string> > Files;
+
+    // Parallel copy state, protected by mMutex.
+    QCMutex    mMutex;
+    int        mStatus;
+    Files      mFiles;
+    size_t     mNextFileIdx;
+    int        mSrcFd;
+    string     mSrcFileName;
+    string     mKfsFileName;
+    int64_t    mRangeSize;
+    int64_t    mNextRangePos;
+    int64_t    mEndPos;
 
     bool Mkdirs(string path);
 
@@ -119,10 +181,30 @@ private:
     int BackupDir(string dirname, string kfsdirname);
 
     // Guts of the work
-    int BackupFile2(string srcfilename, string kfsfilename);
+    int BackupFile2(string srcfilename, string kfsfilename, char* readBuf,
+        bool parallelFlag = false);
+
+    // Run mParallelCount threads, and return the first thread error.
+    int RunCopyThreads(CopyThread* threads, CopyFunc func);
+    // Copy the files collected by BackupDir, one file per thread at a time.
+    int CopyFiles(CopyThread& thread);
+    // Copy single file in chunk (stripe group) aligned ranges, with each
+    // thread writing its ranges through its own file descriptor.
+    int CopyRanges(CopyThread& thread);
+    int ParallelCopy(int srcFd, string srcfilename, string kfsfilename,
+        int kfsfd, int64_t size);
+    bool SetStatus(int status)
+    {
+        QCStMutexLocker locker(mMutex);
+        if (mStatus == 0) {
+            mStatus = status;
+        }
+        return (mStatus == 0);
+    }
 
     void ReportError(const char* what, string fname, int err)
     {
+        QCStMutexLocker locker(mMutex);
         cout <<
             (what ? what : "") <<
             " " << fname <<
@@ -146,7 +228,7 @@ CpToKfs::Run(int argc, char **argv)
     int                 optchar;
 
     while ((optchar = getopt(argc, argv,
-            "d:hk:p:s:W:r:vniatxXb:w:u:y:z:R:D:T:Sm:l:B:f:F:")) != -1) {
+            "d:hk:p:s:W:r:vniatxXb:w:u:y:z:R:D:T:Sm:l:B:f:F:j:")) != -1) {
         switch (optchar) {
             case 'd':
                 sourcePath = optarg;
@@ -235,6 +317,9 @@ CpToKfs::Run(int argc, char **argv)
             case 'f':
                 config = optarg;
                 break;
+            case 'j':
+                mParallelCount = atoi(optarg);
+                break;
             default:
                 help = true;
                 break;
@@ -242,7 +327,7 @@ CpToKfs::Run(int argc, char **argv)
     }
 
     if (help || sourcePath.empty() || kfsPath.empty() || serverHost.empty() ||
-            port <= 0 || mBufSize < 1 ||
+            port <= 0 || mBufSize < 1 || mParallelCount < 1 ||
                 (mAppendMode && mBufSize > (64 << 20))) {
         cout << "Usage: " << argv[0] << "\n"
             " -s   -- meta server name or ip\n"
@@ -272,6 +357,9 @@ CpToKfs::Run(int argc, char **argv)
             " [-B] -- write from this position\n"
             " [-f] -- configuration file name\n"
             " [-F] -- file type -- default 1 or 2 if stripe count not 0\n"
+            " [-j] -- number of parallel copy threads; default 1\n"
+            "         copy directories files by multiple threads, or write\n"
+            "         a single large file in chunk aligned ranges\n"
         ;
         return(-1);
     }
@@ -331,7 +419,17 @@ CpToKfs::Run(int argc, char **argv)
     // when doing cp -r a/b kfs://c, we need to create c/b in KFS.
     const bool ok = MakeKfsLeafDir(sourcePath, kfsPath);
     closedir(dirp);
-    return (ok ? BackupDir(sourcePath, kfsPath) : -1);
+    if (! ok) {
+        return -1;
+    }
+    const int ret = BackupDir(sourcePath, kfsPath);
+    if (ret != 0 || mParallelCount <= 1 || mFiles.empty()) {
+        return ret;
+    }
+    CopyThread* const threads = new CopyThread[mParallelCount];
+    const int status = RunCopyThreads(threads, &CpToKfs::CopyFiles);
+    delete [] threads;
+    return status;
 }
 
 bool
@@ -375,12 +473,13 @@ CpToKfs::BackupFile(string sourcePath, string kfsPath)
         if (dst[kfsPath.size() - 1] != '/') {
             dst += "/";
         }
-        return BackupFile2(sourcePath, dst + filename);
+        return BackupFile2(sourcePath, dst + filename, mReadBuf,
+            1 < mParallelCount);
     }
 
     // kfsPath is the filename that is being specified for the cp
     // target.  try to copy to there...
-    return BackupFile2(sourcePath, kfsPath);
+    return BackupFile2(sourcePath, kfsPath, mReadBuf, 1 < mParallelCount);
 }
 
 int
@@ -422,7 +521,15 @@ CpToKfs::BackupDir(string dirname, string kfsdirname)
             kfssubdir = kfsdirname + "/" + fileInfo->d_name;
             BackupDir(subdir, kfssubdir);
         } else if (S_ISREG(buf.st_mode)) {
-            ret = BackupFile2(dirname + "/" + fileInfo->d_name, kfsdirname + "/" + fileInfo->d_name);
+            if (1 < mParallelCount) {
+                // Copy after the directory tree is created.
+                mFiles.push_back(make_pair(
+                    dirname + "/" + fileInfo->d_name,
+                    kfsdirname + "/" + fileInfo->d_name
+                ));
+                continue;
+            }
+            ret = BackupFile2(dirname + "/" + fileInfo->d_name, kfsdirname + "/" + fileInfo->d_name, mReadBuf);
             if (ret) {
                 break;
             }
@@ -436,7 +543,8 @@ CpToKfs::BackupDir(string dirname, string kfsdirname)
 // Guts of the work to copy the file.
 //
 int
-CpToKfs::BackupFile2(string srcfilename, string kfsfilename)
+CpToKfs::BackupFile2(string srcfilename, string kfsfilename, char* readBuf,
+    bool parallelFlag)
 {
     const int srcFd = srcfilename == "-" ?
         dup(0) : open(srcfilename.c_str(), O_RDONLY);
@@ -500,6 +608,14 @@ CpToKfs::BackupFile2(string srcfilename, string kfsfilename)
         " => " << mKfsClient->GetIoBufferSize(kfsfd) <<
     KFS_LOG_EOM;
 
+    struct stat srcStat;
+    if (parallelFlag && ! mAppendMode && mTestNumReWrites <= 0 &&
+            fstat(srcFd, &srcStat) == 0 && S_ISREG(srcStat.st_mode) &&
+            (int64_t)CHUNKSIZE < srcStat.st_size) {
+        return ParallelCopy(srcFd, srcfilename, kfsfilename, kfsfd,
+            srcStat.st_size);
+    }
+
     if (0 < mStartPos) {
         const int64_t pos = mKfsClient->Seek(kfsfd, mStartPos);
         if (pos != mStartPos) {
@@ -510,8 +626,8 @@ CpToKfs::BackupFile2(string srcfilename, string kfsfilename)
     }
 
     ssize_t nRead;
-    while ((nRead = read(srcFd, mReadBuf, mBufSize)) > 0) {
-        for (char* p = mReadBuf, * const e = p + nRead; p < e; ) {
+    while ((nRead = read(srcFd, readBuf, mBufSize)) > 0) {
+        for (char* p = readBuf, * const e = p + nRead; p < e; ) {
             for (int i = 0; ;) {
                 const int res = mKfsClient->Write(kfsfd, p, e - p);
                 if (res <= 0 || (mAppendMode && p + res != e)) {
@@ -547,6 +663,167 @@ CpToKfs::BackupFile2(string srcfilename, string kfsfilename)
     return (nRead < 0 ? -1 : 0);
 }
 
+int
+CpToKfs::ParallelCopy(int srcFd, string srcfilename, string kfsfilename,
+    int kfsfd, int64_t size)
+{
+    // Align the ranges to the chunk, or striped file chunk block, in order
+    // to have one writer per chunk.
+    KfsFileAttr attr;
+    int         res = mKfsClient->Stat(kfsfd, attr);
+    if (res < 0) {
+        ReportError("stat", kfsfilename, res);
+        close(srcFd);
+        mKfsClient->Close(kfsfd);
+        return(-1);
+    }
+    const int64_t rangeSize = (int64_t)CHUNKSIZE *
+        (attr.striperType != KFS_STRIPED_FILE_TYPE_NONE &&
+            0 < attr.numStripes ? attr.numStripes : 1);
+    if (mStartPos % rangeSize != 0) {
+        ReportError("parallel copy: start position is not chunk aligned",
+            kfsfilename, -EINVAL);
+        close(srcFd);
+        mKfsClient->Close(kfsfd);
+        return(-1);
+    }
+    const int threadCount = (int)min(int64_t(mParallelCount),
+        (size + rangeSize - 1) / rangeSize);
+    CopyThread* const threads = new CopyThread[threadCount];
+    threads[0].mKfsFd = kfsfd;
+    int status = 0;
+    // Open all descriptors before starting the writes, in order to have
+    // the same initial file size with all writers.
+    for (int i = 1; i < threadCount; i++) {
+        threads[i].mKfsFd = mKfsClient->Open(kfsfilename.c_str(), O_WRONLY);
+        if (threads[i].mKfsFd < 0) {
+            ReportError("open", kfsfilename, threads[i].mKfsFd);
+            status = -1;
+            break;
+        }
+    }
+    if (status == 0) {
+        mSrcFd        = srcFd;
+        mSrcFileName  = srcfilename;
+        mKfsFileName  = kfsfilename;
+        mRangeSize    = rangeSize;
+        mNextRangePos = 0;
+        mEndPos       = size;
+        const int saved = mParallelCount;
+        mParallelCount = threadCount;
+        status = RunCopyThreads(threads, &CpToKfs::CopyRanges);
+        mParallelCount = saved;
+        mSrcFd = -1;
+    }
+    close(srcFd);
+    for (int i = 0; i < threadCount; i++) {
+        if (threads[i].mKfsFd < 0) {
+            continue;
+        }
+        if ((res = mKfsClient->Close(threads[i].mKfsFd)) != 0) {
+            ReportError("close", kfsfilename, res);
+            status = -1;
+        }
+    }
+    delete [] threads;
+    return status;
+}
+
+int
+CpToKfs::RunCopyThreads(CopyThread* threads, CopyFunc func)
+{
+    mStatus = 0;
+    const int kStackSize = 256 << 10;
+    for (int i = 0; i < mParallelCount; i++) {
+        threads[i].mOuterPtr = this;
+        threads[i].mFunc     = func;
+        if (! threads[i].mReadBuf) {
+            threads[i].mReadBuf = new char[mBufSize];
+        }
+        threads[i].mThread.Start(&threads[i], kStackSize, "CopyThread");
+    }
+    int status = 0;
+    for (int i = 0; i < mParallelCount; i++) {
+        threads[i].mThread.Join();
+        if (status == 0) {
+            status = threads[i].mStatus;
+        }
+    }
+    return status;
+}
+
+int
+CpToKfs::CopyFiles(CopyThread& thread)
+{
+    for (; ;) {
+        size_t idx;
+        {
+            QCStMutexLocker locker(mMutex);
+            if (mStatus != 0 || mFiles.size() <= mNextFileIdx) {
+                break;
+            }
+            idx = mNextFileIdx++;
+        }
+        const int ret = BackupFile2(
+            mFiles[idx].first, mFiles[idx].second, thread.mReadBuf);
+        if (ret != 0) {
+            SetStatus(ret);
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int
+CpToKfs::CopyRanges(CopyThread& thread)
+{
+    for (; ;) {
+        int64_t pos;
+        int64_t end;
+        {
+            QCStMutexLocker locker(mMutex);
+            if (mStatus != 0 || mEndPos <= mNextRangePos) {
+                break;
+            }
+            pos = mNextRangePos;
+            end = min(mEndPos, pos + mRangeSize);
+            mNextRangePos = end;
+        }
+        const chunkOff_t dstPos = mKfsClient->Seek(
+            thread.mKfsFd, mStartPos + pos);
+        if (dstPos != mStartPos + pos) {
+            ReportError("seek", mKfsFileName, (int)dstPos);
+            SetStatus(-1);
+            return -1;
+        }
+        while (pos < end) {
+            const ssize_t nRead = pread(mSrcFd, thread.mReadBuf,
+                (size_t)min(int64_t(mBufSize), end - pos), (off_t)pos);
+            if (nRead <= 0) {
+                const int err = nRead < 0 ? -errno : -EIO;
+                ReportError("read", mSrcFileName, err);
+                if (mIgnoreSrcErrorsFlag) {
+                    return 0;
+                }
+                SetStatus(-1);
+                return -1;
+            }
+            for (const char* p = thread.mReadBuf, * const e = p + nRead;
+                    p < e; ) {
+                const int res = mKfsClient->Write(thread.mKfsFd, p, e - p);
+                if (res <= 0) {
+                    ReportError("write", mKfsFileName, res);
+                    SetStatus(-1);
+                    return -1;
+                }
+                p += res;
+            }
+            pos += nRead;
+        }
+    }
+    return 0;
+}
+
 bool
 CpToKfs::Mkdirs(string path)
 {
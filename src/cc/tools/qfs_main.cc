@@ -2708,14 +2708,23 @@ private:
             } else {
                 mCreateParams = mDefaultCreateParams;
             }
-            const int theDstFd = mDstFs.Open(
+            // Let the chunk servers copy the data of non striped replicated
+            // file within the same file system, and fall back to copy through
+            // the client if chunk copy is not supported or fails.
+            const bool theChunkCopyFlag =
+                mSrcFs == mDstFs &&
+                S_ISREG(inSrcStat.st_mode) &&
+                0 < inSrcStat.mNumReplicas &&
+                inSrcStat.mNumStripes <= 0 &&
+                CopyFileChunks(inSrcPath, inDstPath, inSrcStat);
+            const int theDstFd = theChunkCopyFlag ? -1 : mDstFs.Open(
                 inDstPath,
                 O_WRONLY | O_CREAT |
                     (mOverwriteFlag ? O_TRUNC : O_EXCL),
                 inSrcStat.st_mode & (0777 | S_ISVTX),
                 &mCreateParams
             );
-            if (theDstFd < 0) {
+            if (! theChunkCopyFlag && theDstFd < 0) {
                 mSrcFs.Close(theSrcFd);
                 return mDstErrorReporter(inDstPath, theDstFd);
             }
@@ -2726,7 +2735,7 @@ private:
             // For sparse file support the write positioning limitations can
             // be expressed by extending FileSystem interface in the future.
             int theStatus = 0;
-            for (ssize_t theTotal = 0; ;) {
+            for (ssize_t theTotal = 0; ! theChunkCopyFlag; ) {
                 const ssize_t theNRd = mSrcFs.Read(
                     theSrcFd, mBufferPtr, mBufferSize);
                 if (theNRd == 0) {
@@ -2759,7 +2768,8 @@ private:
                     break;
                 }
             }
-            const int theCloseDstStatus = mDstFs.Close(theDstFd);
+            const int theCloseDstStatus =
+                theChunkCopyFlag ? 0 : mDstFs.Close(theDstFd);
             if (theCloseDstStatus < 0 && theStatus == 0) {
                 theStatus = mDstErrorReporter(inDstPath, theCloseDstStatus);
             }
@@ -2781,6 +2791,31 @@ private:
             }
             return theStatus;
         }
+        bool CopyFileChunks(
+            const string&              inSrcPath,
+            const string&              inDstPath,
+            const FileSystem::StatBuf& inSrcStat)
+        {
+            const int theDstFd = mDstFs.Open(
+                inDstPath,
+                O_WRONLY | O_CREAT |
+                    (mOverwriteFlag ? O_TRUNC : O_EXCL),
+                inSrcStat.st_mode & (0777 | S_ISVTX),
+                &mCreateParams
+            );
+            if (theDstFd < 0) {
+                return false;
+            }
+            if (mDstFs.Close(theDstFd) == 0 &&
+                    mDstFs.CopyFileChunks(inSrcPath, inDstPath) == 0) {
+                return true;
+            }
+            // Remove the partial copy, the file is re-created by the copy
+            // through the client.
+            const bool kRecursiveFlag = false;
+            mDstFs.Remove(inDstPath, kRecursiveFlag, 0);
+            return false;
+        }
     private:
         // 5 comma separated 64 bit integers.
         enum { kTmpBufSize = (64 * 3 / 10 + 3) * 5 + 1 };
@@ -83,7 +83,11 @@ using std::istringstream;
                                         " [Host=<chunk server ip>]" \
                                         " [Port=<chunk server port>]" \
     ) \
-    f(UPSERVERS,                        "debug: show connected chunk servers")
+    f(UPSERVERS,                        "debug: show connected chunk servers") \
+    f(HEAP_PROFILE,                     "debug: dump heap profile" \
+                                        " [Reset=1]" \
+                                        " [Sample-interval=<bytes>]" \
+    )
 
     static string
 ToLower(
@@ -0,0 +1,645 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Meta server workload replay benchmark. Reads text audit log files
+// (metaServer.auditLogWriter.*), and re-issues the logged request headers
+// against a test meta server, with the original timing, the timing scaled by
+// the given factor, or as fast as possible. The records of each original
+// client ip are replayed in order by the same session, the records are
+// distributed among the sessions by the client ip hash. Each session has one
+// request in flight. Reports per op latency percentiles, the number of
+// replay status mismatches relative to the logged status, the schedule lag,
+// and throughput.
+// The test meta server is expected to be started from the checkpoint and
+// transaction log that match the audit log start, with client authentication
+// turned off. The requests with content, and the requests that refer to the
+// state that cannot be reproduced (leases, chunk server ops) are replayed as
+// logged, and are accounted as status mismatches if they fail.
+// The binary audit log records have no request headers, and cannot be
+// replayed.
+//
+//----------------------------------------------------------------------------
+
+#include "common/MsgLogger.h"
+#include "common/LatencyHistogram.h"
+#include "common/kfsdecls.h"
+#include "common/time.h"
+#include "kfsio/TcpSocket.h"
+#include "kfsio/Globals.h"
+#include "qcdio/QCThread.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/QCUtils.h"
+#include "qcdio/qcstutils.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace KFS
+{
+using std::cout;
+using std::cerr;
+using std::string;
+using std::vector;
+using std::deque;
+using std::map;
+using std::ostream;
+using std::ifstream;
+using std::ostringstream;
+using std::min;
+using std::max;
+
+class AuditReplay
+{
+public:
+    AuditReplay()
+        : mMetaHost(),
+          mMetaPort(-1),
+          mSessionCount(16),
+          mSpeed(1.),
+          mMaxQueueSize(1 << 10),
+          mTimeStampFormat("%m-%d-%Y %H:%M:%S"),
+          mStartTime(0),
+          mFirstRecordTime(-1),
+          mSkippedCount(0)
+        {}
+    int Run(
+        int    inArgCount,
+        char** inArgsPtr);
+private:
+    struct Record
+    {
+        Record()
+            : mTime(-1),
+              mStatus(0),
+              mOpName(),
+              mHeader()
+            {}
+        int64_t mTime;   // Record time in microseconds, or -1 if not known.
+        int     mStatus; // Logged status.
+        string  mOpName;
+        string  mHeader;
+    };
+    class OpStats
+    {
+    public:
+        OpStats()
+            : mHist(),
+              mErrorCount(0),
+              mMismatchCount(0)
+            {}
+        void Add(
+            const OpStats& inStats)
+        {
+            mHist.Add(inStats.mHist);
+            mErrorCount    += inStats.mErrorCount;
+            mMismatchCount += inStats.mMismatchCount;
+        }
+        LatencyHistogram mHist;
+        int64_t          mErrorCount;
+        int64_t          mMismatchCount;
+    };
+    typedef map<string, OpStats> Stats;
+    class Session : public QCRunnable
+    {
+    public:
+        Session()
+            : mReplayPtr(0),
+              mIdx(0),
+              mMutex(),
+              mCond(),
+              mQueue(),
+              mDoneFlag(false),
+              mSocket(),
+              mSeq(0),
+              mRecvBuf(),
+              mStats(),
+              mLag(),
+              mConnectErrorCount(0),
+              mThread()
+            {}
+        void Start(
+            AuditReplay& inReplay,
+            int          inIdx)
+        {
+            mReplayPtr = &inReplay;
+            mIdx       = inIdx;
+            mSeq       = (int64_t(inIdx) + 1) << 32;
+            mThread.Start(this, 256 << 10, "AuditReplaySession");
+        }
+        void Enqueue(
+            const Record& inRecord);
+        void Done()
+        {
+            QCStMutexLocker theLocker(mMutex);
+            mDoneFlag = true;
+            mCond.NotifyAll();
+        }
+        void Join()
+            { mThread.Join(); }
+        virtual void Run();
+        const Stats& GetStats() const
+            { return mStats; }
+        const LatencyHistogram& GetLag() const
+            { return mLag; }
+        int64_t GetConnectErrorCount() const
+            { return mConnectErrorCount; }
+    private:
+        AuditReplay*     mReplayPtr;
+        int              mIdx;
+        QCMutex          mMutex;
+        QCCondVar        mCond;
+        deque<Record>    mQueue;
+        bool             mDoneFlag;
+        TcpSocket        mSocket;
+        int64_t          mSeq;
+        string           mRecvBuf;
+        Stats            mStats;
+        LatencyHistogram mLag;
+        int64_t          mConnectErrorCount;
+        QCThread         mThread;
+
+        int Execute(
+            const Record& inRecord,
+            int&          outStatus);
+        int ReadResponse(
+            int64_t inSeq,
+            int&    outStatus);
+    private:
+        Session(
+            const Session& inSession);
+        Session& operator=(
+            const Session& inSession);
+    };
+
+    string      mMetaHost;
+    int         mMetaPort;
+    int         mSessionCount;
+    double      mSpeed;
+    size_t      mMaxQueueSize;
+    string      mTimeStampFormat;
+    int64_t     mStartTime;
+    int64_t     mFirstRecordTime;
+    int64_t     mSkippedCount;
+
+    bool Parse(
+        const string& inRec,
+        Record&       outRecord) const;
+    int64_t ParseTime(
+        const string& inRec,
+        size_t        inEnd) const;
+    static int64_t GetHeaderInt(
+        const string& inHeader,
+        const char*   inNamePtr,
+        int64_t       inDefault);
+    static size_t ClientIpHash(
+        const string& inRec);
+    void Report(
+        const Stats&            inStats,
+        const LatencyHistogram& inLag,
+        int64_t                 inConnectErrorCount,
+        int64_t                 inElapsedUsec,
+        ostream&                inStream);
+private:
+    AuditReplay(
+        const AuditReplay& inReplay);
+    AuditReplay& operator=(
+        const AuditReplay& inReplay);
+};
+
+    /* static */ int64_t
+AuditReplay::GetHeaderInt(
+    const string& inHeader,
+    const char*   inNamePtr,
+    int64_t       inDefault)
+{
+    const string theName = string("\r\n") + inNamePtr + ":";
+    const size_t thePos  = inHeader.find(theName);
+    if (thePos == string::npos) {
+        return inDefault;
+    }
+    return (int64_t)strtoll(inHeader.c_str() + thePos + theName.size(), 0, 10);
+}
+
+    /* static */ size_t
+AuditReplay::ClientIpHash(
+    const string& inRec)
+{
+    const size_t thePos = inRec.find("\r\nClient-ip:");
+    if (thePos == string::npos) {
+        return 0;
+    }
+    // FNV-1a
+    size_t theHash = 2166136261u;
+    for (const char* thePtr = inRec.c_str() + thePos + 13;
+            *thePtr != 0 && *thePtr != '\r';
+            ++thePtr) {
+        theHash = (theHash ^ (*thePtr & 0xFF)) * 16777619u;
+    }
+    return theHash;
+}
+
+    int64_t
+AuditReplay::ParseTime(
+    const string& inRec,
+    size_t        inEnd) const
+{
+    // The record prefix: <time stamp format>.<milliseconds> <level> - "
+    const string theTime   = inRec.substr(0, inEnd);
+    const size_t theDotPos = theTime.rfind('.');
+    if (theDotPos == string::npos) {
+        return -1;
+    }
+    struct tm theTm;
+    memset(&theTm, 0, sizeof(theTm));
+    const char* const thePtr = strptime(
+        theTime.substr(0, theDotPos).c_str(), mTimeStampFormat.c_str(), &theTm);
+    if (! thePtr || *thePtr != 0) {
+        return -1;
+    }
+    theTm.tm_isdst = -1;
+    const time_t theSec = mktime(&theTm);
+    if (theSec == time_t(-1)) {
+        return -1;
+    }
+    return (int64_t(theSec) * 1000 * 1000 +
+        int64_t(atoi(theTime.c_str() + theDotPos + 1)) * 1000);
+}
+
+    bool
+AuditReplay::Parse(
+    const string& inRec,
+    AuditReplay::Record& outRecord) const
+{
+    const size_t thePrefEnd = inRec.find(" - ");
+    if (thePrefEnd == string::npos) {
+        return false;
+    }
+    size_t const theLevelPos = inRec.rfind(' ', thePrefEnd - 1);
+    if (theLevelPos == string::npos) {
+        return false;
+    }
+    const size_t theStart  = thePrefEnd + 3;
+    const size_t theHdrEnd = inRec.find("\r\n\r\n", theStart);
+    if (theHdrEnd == string::npos) {
+        return false;
+    }
+    outRecord.mTime   = ParseTime(inRec, theLevelPos);
+    outRecord.mHeader = inRec.substr(theStart, theHdrEnd + 4 - theStart);
+    const size_t theOpEnd = outRecord.mHeader.find_first_of(" \r");
+    outRecord.mOpName = outRecord.mHeader.substr(0, theOpEnd);
+    // The client ip, auth uid, and status follow the request headers.
+    const string theTrailer = "\r\n" + inRec.substr(theHdrEnd + 4);
+    outRecord.mStatus = (int)GetHeaderInt(theTrailer, "Status", 0);
+    return (! outRecord.mOpName.empty());
+}
+
+    void
+AuditReplay::Session::Enqueue(
+    const AuditReplay::Record& inRecord)
+{
+    QCStMutexLocker theLocker(mMutex);
+    while (mReplayPtr->mMaxQueueSize <= mQueue.size()) {
+        mCond.Wait(mMutex);
+    }
+    mQueue.push_back(inRecord);
+    mCond.NotifyAll();
+}
+
+    int
+AuditReplay::Session::ReadResponse(
+    int64_t inSeq,
+    int&    outStatus)
+{
+    const int kBufSize = 64 << 10;
+    char      theBuf[kBufSize];
+    for (; ;) {
+        const size_t theEnd = mRecvBuf.find("\r\n\r\n");
+        if (theEnd != string::npos) {
+            const string theHeader = "\r\n" + mRecvBuf.substr(0, theEnd + 2);
+            const size_t theLen    = (size_t)max(int64_t(0),
+                GetHeaderInt(theHeader, "Content-length", 0));
+            if (theEnd + 4 + theLen <= mRecvBuf.size()) {
+                mRecvBuf.erase(0, theEnd + 4 + theLen);
+                if (GetHeaderInt(theHeader, "Cseq", -1) != inSeq) {
+                    continue; // Not a response to this request.
+                }
+                outStatus = (int)GetHeaderInt(theHeader, "Status", -EIO);
+                return 0;
+            }
+        }
+        const int theNRd = mSocket.Recv(theBuf, kBufSize);
+        if (theNRd <= 0) {
+            if (theNRd < 0 && errno == EINTR) {
+                continue;
+            }
+            return (theNRd < 0 && errno > 0 ? -errno : -EIO);
+        }
+        mRecvBuf.append(theBuf, theNRd);
+    }
+}
+
+    int
+AuditReplay::Session::Execute(
+    const AuditReplay::Record& inRecord,
+    int&                       outStatus)
+{
+    if (! mSocket.IsGood()) {
+        mRecvBuf.clear();
+        const int theStatus = mSocket.Connect(ServerLocation(
+            mReplayPtr->mMetaHost, mReplayPtr->mMetaPort), false);
+        if (theStatus < 0) {
+            mConnectErrorCount++;
+            mSocket.Close();
+            return theStatus;
+        }
+    }
+    // Replace the logged sequence number with the session sequence number.
+    const int64_t theSeq  = ++mSeq;
+    const string& theHdr  = inRecord.mHeader;
+    size_t        thePos  = theHdr.find("\r\nCseq:");
+    size_t        theNext = thePos;
+    if (thePos == string::npos) {
+        thePos = theNext = theHdr.find("\r\n");
+    } else {
+        theNext = theHdr.find("\r\n", thePos + 2);
+    }
+    ostringstream theStream;
+    theStream <<
+        theHdr.substr(0, thePos) <<
+        "\r\nCseq: " << theSeq <<
+        theHdr.substr(theNext);
+    const string theReq = theStream.str();
+    const char*  thePtr = theReq.data();
+    const char*  theEnd = thePtr + theReq.size();
+    while (thePtr < theEnd) {
+        const int theNWr = mSocket.Send(thePtr, (int)(theEnd - thePtr));
+        if (theNWr <= 0) {
+            if (theNWr < 0 && errno == EINTR) {
+                continue;
+            }
+            mSocket.Close();
+            return (theNWr < 0 && errno > 0 ? -errno : -EIO);
+        }
+        thePtr += theNWr;
+    }
+    const int theStatus = ReadResponse(theSeq, outStatus);
+    if (theStatus < 0) {
+        mSocket.Close();
+    }
+    return theStatus;
+}
+
+    void
+AuditReplay::Session::Run()
+{
+    for (; ;) {
+        QCStMutexLocker theLocker(mMutex);
+        while (mQueue.empty() && ! mDoneFlag) {
+            mCond.Wait(mMutex);
+        }
+        if (mQueue.empty()) {
+            break;
+        }
+        const Record theRecord = mQueue.front();
+        mQueue.pop_front();
+        mCond.NotifyAll();
+        theLocker.Unlock();
+        if (0 < mReplayPtr->mSpeed && 0 <= theRecord.mTime &&
+                0 <= mReplayPtr->mFirstRecordTime) {
+            const int64_t theSchedule = mReplayPtr->mStartTime + (int64_t)(
+                (theRecord.mTime - mReplayPtr->mFirstRecordTime) /
+                mReplayPtr->mSpeed);
+            int64_t theNow = microseconds();
+            if (theNow < theSchedule) {
+                while (theNow < theSchedule) {
+                    usleep((useconds_t)min(
+                        theSchedule - theNow, int64_t(500) * 1000));
+                    theNow = microseconds();
+                }
+            } else {
+                mLag.Add(theNow - theSchedule);
+            }
+        }
+        OpStats&      theStats  = mStats[theRecord.mOpName];
+        int           theStatus = 0;
+        const int64_t theStart  = microseconds();
+        if (Execute(theRecord, theStatus) < 0) {
+            theStats.mErrorCount++;
+            continue;
+        }
+        theStats.mHist.Add(microseconds() - theStart);
+        if (theStatus != theRecord.mStatus) {
+            theStats.mMismatchCount++;
+        }
+    }
+    mSocket.Close();
+}
+
+    void
+AuditReplay::Report(
+    const AuditReplay::Stats& inStats,
+    const LatencyHistogram&   inLag,
+    int64_t                   inConnectErrorCount,
+    int64_t                   inElapsedUsec,
+    ostream&                  inStream)
+{
+    const double theSec   = inElapsedUsec > 0 ? inElapsedUsec * 1e-6 : 1.;
+    int64_t      theCount = 0;
+    int64_t      theErrs  = 0;
+    int64_t      theMisms = 0;
+    for (Stats::const_iterator theIt = inStats.begin();
+            theIt != inStats.end();
+            ++theIt) {
+        const LatencyHistogram& theHist = theIt->second.mHist;
+        theCount += theHist.GetCount();
+        theErrs  += theIt->second.mErrorCount;
+        theMisms += theIt->second.mMismatchCount;
+        if (theHist.GetCount() <= 0) {
+            continue;
+        }
+        inStream <<
+            "latency: op="   << theIt->first <<
+            " count="        << theHist.GetCount() <<
+            " errors="       << theIt->second.mErrorCount <<
+            " status_mismatches=" << theIt->second.mMismatchCount <<
+            " ops_per_sec="  << theHist.GetCount() / theSec <<
+            " avg_usec="     << theHist.GetTotal() / theHist.GetCount() <<
+            " p50_usec="     << theHist.GetPercentile(500) <<
+            " p90_usec="     << theHist.GetPercentile(900) <<
+            " p99_usec="     << theHist.GetPercentile(990) <<
+            " p999_usec="    << theHist.GetPercentile(999) <<
+            " max_usec="     << theHist.GetMax() <<
+        "\n";
+    }
+    inStream <<
+        "summary: sessions=" << mSessionCount <<
+        " speed="            << mSpeed <<
+        " elapsed_usec="     << inElapsedUsec <<
+        " ops="              << theCount <<
+        " ops_per_sec="      << theCount / theSec <<
+        " errors="           << theErrs <<
+        " connect_errors="   << inConnectErrorCount <<
+        " status_mismatches=" << theMisms <<
+        " skipped="          << mSkippedCount <<
+        " late="             << inLag.GetCount() <<
+        " lag_p99_usec="     << inLag.GetPercentile(990) <<
+        " lag_max_usec="     << inLag.GetMax() <<
+    "\n";
+}
+
+    int
+AuditReplay::Run(
+    int    inArgCount,
+    char** inArgsPtr)
+{
+    int  theOpt;
+    bool theHelpFlag    = false;
+    bool theVerboseFlag = false;
+    while ((theOpt = getopt(inArgCount, inArgsPtr, "s:p:c:x:q:T:vh")) != -1) {
+        switch (theOpt) {
+            case 's': mMetaHost        = optarg;                 break;
+            case 'p': mMetaPort        = atoi(optarg);           break;
+            case 'c': mSessionCount    = atoi(optarg);           break;
+            case 'x': mSpeed           = atof(optarg);           break;
+            case 'q': mMaxQueueSize    = (size_t)atoi(optarg);   break;
+            case 'T': mTimeStampFormat = optarg;                 break;
+            case 'v': theVerboseFlag   = true;                   break;
+            default:  theHelpFlag      = true;                   break;
+        }
+    }
+    if (theHelpFlag || mMetaHost.empty() || mMetaPort <= 0 ||
+            mSessionCount <= 0 || mSpeed < 0 || mMaxQueueSize <= 0 ||
+            inArgCount <= optind) {
+        cerr << "Usage: " <<
+            (inArgCount > 0 ? inArgsPtr[0] : "qfsauditreplay") <<
+            " -s <meta server> -p <port> [options] <audit log> ...\n"
+            " [-c <sessions>]              default: 16\n"
+            " [-x <speed>]                 time scale, 2 replays twice as"
+            " fast as logged,\n"
+            "                              0 as fast as possible,"
+            " default: 1\n"
+            " [-q <queue size>]            per session queue size,"
+            " default: 1024\n"
+            " [-T <format>]                audit log time stamp format,"
+            " default:\n"
+            "                              %m-%d-%Y %H:%M:%S\n"
+            " [-v]                         verbose\n"
+            "Replays text audit log files in the given order against the"
+            " meta server\n"
+            "started from the matching checkpoint, and reports per op"
+            " latency\n"
+            "and throughput as key=value lines.\n"
+        ;
+        return 1;
+    }
+    MsgLogger::Init(0, theVerboseFlag ?
+        MsgLogger::kLogLevelDEBUG : MsgLogger::kLogLevelINFO);
+    libkfsio::InitGlobals();
+    Session* const theSessions = new Session[mSessionCount];
+    for (int i = 0; i < mSessionCount; i++) {
+        theSessions[i].Start(*this, i);
+    }
+    int     theStatus = 0;
+    int64_t theStart  = -1;
+    for (int i = optind; i < inArgCount; i++) {
+        ifstream theFile(inArgsPtr[i]);
+        if (! theFile) {
+            const int theErr = errno;
+            KFS_LOG_STREAM_ERROR << inArgsPtr[i] << ": " <<
+                QCUtils::SysError(theErr) <<
+            KFS_LOG_EOM;
+            theStatus = 1;
+            break;
+        }
+        // Text audit log records are null terminated, and followed by the
+        // new line.
+        string theRec;
+        Record theRecord;
+        while (getline(theFile, theRec, '\0')) {
+            const size_t thePos = theRec.find_first_not_of('\n');
+            if (thePos != 0) {
+                theRec.erase(0, thePos);
+            }
+            if (theRec.empty()) {
+                continue;
+            }
+            if (! Parse(theRec, theRecord)) {
+                mSkippedCount++;
+                KFS_LOG_STREAM_DEBUG <<
+                    "skipping invalid record: " << theRec.substr(0, 64) <<
+                KFS_LOG_EOM;
+                continue;
+            }
+            if (theStart < 0) {
+                // The sessions read the start times after the first dequeue,
+                // the enqueue and dequeue are serialized by the session mutex.
+                mFirstRecordTime = theRecord.mTime;
+                mStartTime       = microseconds();
+                theStart         = mStartTime;
+            }
+            theSessions[ClientIpHash(theRec) % mSessionCount].Enqueue(
+                theRecord);
+        }
+    }
+    for (int i = 0; i < mSessionCount; i++) {
+        theSessions[i].Done();
+    }
+    Stats            theStats;
+    LatencyHistogram theLag;
+    int64_t          theConnectErrorCount = 0;
+    for (int i = 0; i < mSessionCount; i++) {
+        theSessions[i].Join();
+        const Stats& theSStats = theSessions[i].GetStats();
+        for (Stats::const_iterator theIt = theSStats.begin();
+                theIt != theSStats.end();
+                ++theIt) {
+            theStats[theIt->first].Add(theIt->second);
+        }
+        theLag.Add(theSessions[i].GetLag());
+        theConnectErrorCount += theSessions[i].GetConnectErrorCount();
+    }
+    delete [] theSessions;
+    Report(theStats, theLag, theConnectErrorCount,
+        theStart < 0 ? int64_t(0) : microseconds() - theStart, cout);
+    cout.flush();
+    return theStatus;
+}
+
+} // namespace KFS
+
+int
+main(int argc, char** argv)
+{
+    KFS::AuditReplay theReplay;
+    return theReplay.Run(argc, argv);
+}
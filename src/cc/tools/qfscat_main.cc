@@ -29,6 +29,7 @@
 
 #include "libclient/KfsClient.h"
 #include "common/MsgLogger.h"
+#include "PipelinedReader.h"
 
 #include <iostream>
 #include <unistd.h>
@@ -42,8 +43,11 @@
 using std::cerr;
 using std::string;
 using namespace KFS;
+using KFS::tools::PipelinedReader;
 
-static ssize_t DoCat(KfsClient *kfsClient, const char *pahtname);
+static ssize_t DoCat(KfsClient *kfsClient, const char *pahtname,
+    PipelinedReader* reader);
+static int WriteOut(const char* buf, ssize_t len);
 
 int
 main(int argc, char **argv)
@@ -53,9 +57,10 @@ main(int argc, char **argv)
     bool        help           = false;
     bool        verboseLogging = false;
     const char* config         = 0;
+    int         depth          = 0;
     int         optchar;
 
-    while ((optchar = getopt(argc, argv, "hs:p:vf:")) != -1) {
+    while ((optchar = getopt(argc, argv, "hs:p:vf:P:")) != -1) {
         switch (optchar) {
             case 'h':
                 help = true;
@@ -72,6 +77,9 @@ main(int argc, char **argv)
             case 'f':
                 config = optarg;
                 break;
+            case 'P':
+                depth = atoi(optarg);
+                break;
             default:
                 help = true;
                 break;
@@ -82,9 +90,13 @@ main(int argc, char **argv)
         cerr <<
             "Usage: " << argv[0] << " -s <meta server name> -p <port>"
             " [-f <config file>]"
+            " [-P <read pipeline depth>]"
             " [filename1 filename2 ...]\n"
             "This tool outputs the files in the order of appearance to"
-            " stdout.\n";
+            " stdout.\n"
+            "-P <n> -- keep up to n 4MB asynchronous reads in flight, in order"
+            " to fetch multiple chunks in parallel; 0 -- synchronous reads,"
+            " default 0\n";
         return 1;
     }
 
@@ -97,18 +109,37 @@ main(int argc, char **argv)
         return 1;
     }
 
+    PipelinedReader* const reader = 0 < depth ?
+        new PipelinedReader(*kfsClient, depth, 4 << 20) : 0;
     for (int i = optind; i < argc; ++i) {
-        const int res = DoCat(kfsClient, argv[i]);
+        const int res = DoCat(kfsClient, argv[i], reader);
         if (res != 0) {
             cerr << argv[i] << ": " << ErrorCodeToStr(res) << "\n";
         }
     }
+    delete reader;
     delete kfsClient;
     return 0;
 }
 
+int
+WriteOut(const char* buf, ssize_t len)
+{
+    for (const char* p = buf, * const e = p + len; p < e; ) {
+        const ssize_t n = write(1, p, e - p);
+        if (n < 0) {
+            if (errno != EINTR && errno != EAGAIN) {
+                return -errno;
+            }
+            continue;
+        }
+        p += n;
+    }
+    return 0;
+}
+
 ssize_t
-DoCat(KfsClient *kfsClient, const char *pathname)
+DoCat(KfsClient *kfsClient, const char *pathname, PipelinedReader* reader)
 {
     const int bufSize = 4 << 20;
     static char dataBuf[bufSize];
@@ -118,23 +149,21 @@ DoCat(KfsClient *kfsClient, const char *pathname)
         return fd;
     }
 
-    int res;
-    for (; ;) {
-        res = kfsClient->Read(fd, dataBuf, bufSize);
-        if (res <= 0)
-            break;
-        for (const char* p = dataBuf, * const e = p + res; p < e; ) {
-            const ssize_t n = write(1, p, e - p);
-            if (n < 0) {
-                if (errno != EINTR && errno != EAGAIN) {
-                    res = errno;
-                    break;
-                }
+    ssize_t res;
+    if (reader) {
+        reader->Start(fd, 0, -1);
+        const char* buf;
+        while (0 < (res = reader->Next(buf)) &&
+                (res = WriteOut(buf, res)) == 0)
+            {}
+        // Wait for the outstanding reads prior to closing the file.
+        reader->Stop();
+    } else {
+        for (; ;) {
+            res = kfsClient->Read(fd, dataBuf, bufSize);
+            if (res <= 0 || (res = WriteOut(dataBuf, res)) != 0) {
+                break;
             }
-            p += n;
-        }
-        if (res < 0) {
-            break;
         }
     }
     kfsClient->Close(fd);
@@ -92,7 +92,9 @@ main(int argc, char **argv)
         cout << "Usage: " << argv[0] <<
             " -s <metaserver> -p <port> -k <QFSfile> [-c|-d] [-v]"
             " [-f <config file name>]\n"
-            " -c: compare checksums on the replicas.\n"
+            " -c: compare checksums on the replicas; the checksums are\n"
+            "     computed by the chunk servers, and only the blocks with\n"
+            "     mismatched checksums are read and compared.\n"
             " -d: compare the chunks and return md5 of the file.\n";
         return -1;
     }
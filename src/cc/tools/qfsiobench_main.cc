@@ -0,0 +1,876 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief End to end chunk server io benchmark. Drives the chunk servers through
+// the qfs client library, i.e. through the complete chunk server stack:
+// client state machine, chunk manager, disk io, checksums, and buffer manager,
+// with synthetic write, read, and record append mixes, for each combination of
+// the given block sizes and concurrency levels. Reports the client side
+// throughput and per phase (open, write, sync, close, read, append) latency
+// percentiles. If the chunk server locations are given, fetches the chunk
+// server stats before and after each run, and reports the server side per op
+// per phase latency percentiles for the run: buffer wait, disk queue wait,
+// disk io, checksum, and total.
+// The storage under test (tmpfs, ssd, hdd) is defined by the chunk server
+// chunk directories used, and the number of replicas.
+//
+//----------------------------------------------------------------------------
+
+#include "MonClient.h"
+#include "common/MsgLogger.h"
+#include "common/LatencyHistogram.h"
+#include "common/time.h"
+#include "libclient/KfsClient.h"
+#include "libclient/KfsOps.h"
+#include "qcdio/QCThread.h"
+#include "qcdio/QCMutex.h"
+#include "qcdio/qcstutils.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+namespace KFS
+{
+using std::cout;
+using std::cerr;
+using std::string;
+using std::vector;
+using std::map;
+using std::ostream;
+using std::ostringstream;
+using std::istringstream;
+using KFS_MON::MonClient;
+using client::ChunkStatsOp;
+
+class IoBench
+{
+public:
+    enum Op
+    {
+        kOpWrite,
+        kOpRead,
+        kOpAppend,
+        kOpCount
+    };
+    enum Phase
+    {
+        kPhaseOpen,
+        kPhaseWrite,
+        kPhaseSync,
+        kPhaseClose,
+        kPhaseRead,
+        kPhaseAppend,
+        kPhaseCount
+    };
+
+    IoBench()
+        : mMetaHost(),
+          mMetaPort(-1),
+          mConfigFileNamePtr(0),
+          mBaseDir("/qfsiobench"),
+          mBlockSizes(),
+          mConcurrency(),
+          mFileSize(int64_t(64) << 20),
+          mDurationSec(30),
+          mNumReplicas(1),
+          mSyncFlag(true),
+          mKeepFilesFlag(false),
+          mChunkServers(),
+          mMonClient(),
+          mRunIdx(0)
+    {
+        for (int i = 0; i < kOpCount; i++) {
+            mMix[i] = 0;
+        }
+    }
+    int Run(
+        int    inArgCount,
+        char** inArgsPtr);
+private:
+    class Stats
+    {
+    public:
+        Stats()
+            : mErrorCount(0),
+              mPrepareBytes(0)
+        {
+            for (int i = 0; i < kOpCount; i++) {
+                mBytes[i] = 0;
+            }
+        }
+        void Add(
+            const Stats& inStats)
+        {
+            for (int i = 0; i < kPhaseCount; i++) {
+                mHist[i].Add(inStats.mHist[i]);
+            }
+            for (int i = 0; i < kOpCount; i++) {
+                mBytes[i] += inStats.mBytes[i];
+            }
+            mErrorCount   += inStats.mErrorCount;
+            mPrepareBytes += inStats.mPrepareBytes;
+        }
+        LatencyHistogram mHist[kPhaseCount];
+        int64_t          mBytes[kOpCount];
+        int64_t          mErrorCount;
+        int64_t          mPrepareBytes;
+    };
+    class Worker : public QCRunnable
+    {
+    public:
+        Worker()
+            : mBenchPtr(0),
+              mIdx(0),
+              mBlockSize(0),
+              mEndTime(0),
+              mDir(),
+              mStats(),
+              mStatus(0),
+              mSeed(0),
+              mThread()
+            {}
+        void Start(
+            IoBench& inBench,
+            int      inIdx,
+            int      inBlockSize,
+            int64_t  inEndTime,
+            const string& inDir)
+        {
+            mBenchPtr  = &inBench;
+            mIdx       = inIdx;
+            mBlockSize = inBlockSize;
+            mEndTime   = inEndTime;
+            mDir       = inDir;
+            mSeed      = (unsigned int)(microseconds() + inIdx * 7919);
+            mThread.Start(this, 256 << 10, "IoBenchWorker");
+        }
+        void Join()
+            { mThread.Join(); }
+        virtual void Run();
+        const Stats& GetStats() const
+            { return mStats; }
+        int GetStatus() const
+            { return mStatus; }
+    private:
+        IoBench*     mBenchPtr;
+        int          mIdx;
+        int          mBlockSize;
+        int64_t      mEndTime;
+        string       mDir;
+        Stats        mStats;
+        int          mStatus;
+        unsigned int mSeed;
+        QCThread     mThread;
+
+        int64_t Record(
+            Phase   inPhase,
+            int64_t inStart)
+        {
+            const int64_t theNow = microseconds();
+            mStats.mHist[inPhase].Add(theNow - inStart);
+            return theNow;
+        }
+        bool Error(
+            const char*   inOpNamePtr,
+            const string& inPath,
+            int64_t       inStatus)
+        {
+            if (mStats.mErrorCount++ < 10) {
+                KFS_LOG_STREAM_ERROR <<
+                    inOpNamePtr << ": " << inPath << ": " <<
+                    ErrorCodeToStr((int)inStatus) <<
+                KFS_LOG_EOM;
+            }
+            return false;
+        }
+        bool Prepare(
+            KfsClient& inClient,
+            const string& inPath,
+            const char*   inBufPtr);
+        Op PickOp();
+    private:
+        Worker(
+            const Worker& inWorker);
+        Worker& operator=(
+            const Worker& inWorker);
+    };
+    typedef vector<LatencyHistogram::Counter> ServerHistogram;
+    typedef map<string, ServerHistogram>      ServerStats;
+
+    string           mMetaHost;
+    int              mMetaPort;
+    const char*      mConfigFileNamePtr;
+    string           mBaseDir;
+    vector<int>      mBlockSizes;
+    vector<int>      mConcurrency;
+    int64_t          mFileSize;
+    int              mDurationSec;
+    int              mNumReplicas;
+    bool             mSyncFlag;
+    bool             mKeepFilesFlag;
+    int              mMix[kOpCount];
+    vector<ServerLocation> mChunkServers;
+    MonClient        mMonClient;
+    int              mRunIdx;
+
+    static const char* const kOpNames[kOpCount];
+    static const char* const kPhaseNames[kPhaseCount];
+
+    static int64_t ParseSize(
+        const string& inStr);
+    static bool ParseList(
+        const char*  inStrPtr,
+        vector<int>& outList,
+        bool         inSizeFlag);
+    bool ParseMix(
+        const char* inStrPtr);
+    bool ParseChunkServers(
+        const char* inStrPtr);
+    int RunOne(
+        int inBlockSize,
+        int inConcurrency);
+    void GetServerStats(
+        ServerStats& outStats);
+    void ReportServerStats(
+        const ServerStats& inBefore,
+        const ServerStats& inAfter,
+        ostream&           inStream);
+    void Report(
+        int          inBlockSize,
+        int          inConcurrency,
+        const Stats& inStats,
+        int64_t      inElapsedUsec,
+        ostream&     inStream);
+private:
+    IoBench(
+        const IoBench& inBench);
+    IoBench& operator=(
+        const IoBench& inBench);
+};
+
+const char* const IoBench::kOpNames[IoBench::kOpCount] = {
+    "write",
+    "read",
+    "append"
+};
+
+const char* const IoBench::kPhaseNames[IoBench::kPhaseCount] = {
+    "open",
+    "write",
+    "sync",
+    "close",
+    "read",
+    "append"
+};
+
+    /* static */ int64_t
+IoBench::ParseSize(
+    const string& inStr)
+{
+    char*         theEndPtr = 0;
+    const int64_t theRet    = (int64_t)strtoll(inStr.c_str(), &theEndPtr, 0);
+    switch (theEndPtr ? (*theEndPtr & 0xFF) : 0) {
+        case 'k': case 'K': return (theRet << 10);
+        case 'm': case 'M': return (theRet << 20);
+        case 'g': case 'G': return (theRet << 30);
+        default: break;
+    }
+    return theRet;
+}
+
+    /* static */ bool
+IoBench::ParseList(
+    const char*  inStrPtr,
+    vector<int>& outList,
+    bool         inSizeFlag)
+{
+    outList.clear();
+    istringstream theStream(inStrPtr);
+    string        theToken;
+    while (getline(theStream, theToken, ',')) {
+        const int64_t theVal = inSizeFlag ?
+            ParseSize(theToken) : (int64_t)atoi(theToken.c_str());
+        if (theVal <= 0 || (int64_t(1) << 30) < theVal) {
+            cerr << "invalid value: " << theToken << "\n";
+            return false;
+        }
+        outList.push_back((int)theVal);
+    }
+    return (! outList.empty());
+}
+
+    bool
+IoBench::ParseMix(
+    const char* inStrPtr)
+{
+    istringstream theStream(inStrPtr);
+    string        theToken;
+    int           theTotal = 0;
+    for (int i = 0; i < kOpCount; i++) {
+        mMix[i] = 0;
+    }
+    while (getline(theStream, theToken, ',')) {
+        const size_t thePos    = theToken.find(':');
+        const string theName   = theToken.substr(0, thePos);
+        const int    theWeight = thePos == string::npos ?
+            1 : atoi(theToken.substr(thePos + 1).c_str());
+        int i = 0;
+        while (i < kOpCount && theName != kOpNames[i]) {
+            i++;
+        }
+        if (kOpCount <= i || theWeight < 0) {
+            cerr << "invalid op mix entry: " << theToken << "\n";
+            return false;
+        }
+        mMix[i]  += theWeight;
+        theTotal += theWeight;
+    }
+    return (0 < theTotal);
+}
+
+    bool
+IoBench::ParseChunkServers(
+    const char* inStrPtr)
+{
+    istringstream theStream(inStrPtr);
+    string        theToken;
+    while (getline(theStream, theToken, ',')) {
+        const size_t thePos = theToken.rfind(':');
+        if (thePos == string::npos) {
+            cerr << "invalid chunk server location: " << theToken << "\n";
+            return false;
+        }
+        const ServerLocation theLoc(theToken.substr(0, thePos),
+            atoi(theToken.substr(thePos + 1).c_str()));
+        if (! theLoc.IsValid()) {
+            cerr << "invalid chunk server location: " << theToken << "\n";
+            return false;
+        }
+        mChunkServers.push_back(theLoc);
+    }
+    return true;
+}
+
+    IoBench::Op
+IoBench::Worker::PickOp()
+{
+    int theTotal = 0;
+    for (int i = 0; i < kOpCount; i++) {
+        theTotal += mBenchPtr->mMix[i];
+    }
+    int theVal = rand_r(&mSeed) % theTotal;
+    for (int i = 0; i < kOpCount; i++) {
+        if (theVal < mBenchPtr->mMix[i]) {
+            return (Op)i;
+        }
+        theVal -= mBenchPtr->mMix[i];
+    }
+    return kOpWrite;
+}
+
+    bool
+IoBench::Worker::Prepare(
+    KfsClient&    inClient,
+    const string& inPath,
+    const char*   inBufPtr)
+{
+    // Create the file to read from, the write times are not recorded, as the
+    // write behind is used.
+    const int theFd = inClient.Open(inPath.c_str(),
+        O_CREAT | O_TRUNC | O_WRONLY, mBenchPtr->mNumReplicas);
+    if (theFd < 0) {
+        return Error("create", inPath, theFd);
+    }
+    int64_t thePos = 0;
+    while (thePos < mBenchPtr->mFileSize) {
+        const ssize_t theRet = inClient.Write(theFd, inBufPtr, mBlockSize);
+        if (theRet != mBlockSize) {
+            inClient.Close(theFd);
+            return Error("write", inPath, theRet < 0 ? theRet : -EIO);
+        }
+        thePos += theRet;
+    }
+    const int theRet = inClient.Close(theFd);
+    if (theRet < 0) {
+        return Error("close", inPath, theRet);
+    }
+    mStats.mPrepareBytes += thePos;
+    return true;
+}
+
+    void
+IoBench::Worker::Run()
+{
+    IoBench&         theBench  = *mBenchPtr;
+    KfsClient* const theClient = KfsClient::Connect(
+        theBench.mMetaHost, theBench.mMetaPort, theBench.mConfigFileNamePtr);
+    if (! theClient) {
+        mStatus = -EHOSTUNREACH;
+        return;
+    }
+    ostringstream theStream;
+    theStream << mDir << "/t" << mIdx;
+    const string theDir = theStream.str();
+    int          theRet;
+    if ((theRet = theClient->Mkdirs(theDir.c_str())) < 0 && theRet != -EEXIST) {
+        Error("mkdirs", theDir, theRet);
+        mStatus = theRet;
+        delete theClient;
+        return;
+    }
+    vector<char> theBuf(mBlockSize);
+    for (size_t i = 0; i < theBuf.size(); i++) {
+        theBuf[i] = (char)rand_r(&mSeed);
+    }
+    char* const  theBufPtr   = &theBuf[0];
+    const string theReadPath = theDir + "/read";
+    int          theReadFd   = -1;
+    int64_t      theReadSize = 0;
+    if (0 < theBench.mMix[kOpRead]) {
+        if (Prepare(*theClient, theReadPath, theBufPtr) &&
+                (theReadFd = theClient->Open(
+                    theReadPath.c_str(), O_RDONLY)) < 0) {
+            Error("open", theReadPath, theReadFd);
+        }
+        if (theReadFd < 0) {
+            mStatus = -EIO;
+            theClient->RmdirsFast(theDir.c_str());
+            delete theClient;
+            return;
+        }
+        // Disable read ahead, in order to measure each block read.
+        theClient->SetReadAheadSize(theReadFd, 0);
+        theReadSize = theBench.mFileSize / mBlockSize * mBlockSize;
+    }
+    int     theWriteFd     = -1;
+    int64_t theWritePos    = 0;
+    int     theAppendFd    = -1;
+    int64_t theAppendPos   = 0;
+    int     theFileSeq     = 0;
+    string  theWritePath;
+    string  theAppendPath;
+    int64_t theNow;
+    while ((theNow = microseconds()) < mEndTime) {
+        switch (PickOp()) {
+            case kOpWrite:
+                if (theWriteFd < 0) {
+                    ostringstream theName;
+                    theName << theDir << "/w" << theFileSeq++;
+                    theWritePath = theName.str();
+                    theWriteFd   = theClient->Open(theWritePath.c_str(),
+                        O_CREAT | O_TRUNC | O_WRONLY, theBench.mNumReplicas);
+                    theNow = Record(kPhaseOpen, theNow);
+                    if (theWriteFd < 0) {
+                        Error("create", theWritePath, theWriteFd);
+                        break;
+                    }
+                    theWritePos = 0;
+                }
+                if ((theRet = (int)theClient->Write(
+                        theWriteFd, theBufPtr, mBlockSize)) != mBlockSize) {
+                    Error("write", theWritePath, theRet < 0 ? theRet : -EIO);
+                } else {
+                    theWritePos += mBlockSize;
+                    mStats.mBytes[kOpWrite] += mBlockSize;
+                }
+                theNow = Record(kPhaseWrite, theNow);
+                if (theBench.mSyncFlag) {
+                    if ((theRet = theClient->Sync(theWriteFd)) < 0) {
+                        Error("sync", theWritePath, theRet);
+                    }
+                    theNow = Record(kPhaseSync, theNow);
+                }
+                if (theBench.mFileSize <= theWritePos) {
+                    if ((theRet = theClient->Close(theWriteFd)) < 0) {
+                        Error("close", theWritePath, theRet);
+                    }
+                    Record(kPhaseClose, theNow);
+                    theWriteFd = -1;
+                    if (! theBench.mKeepFilesFlag) {
+                        theClient->Remove(theWritePath.c_str());
+                    }
+                }
+                break;
+            case kOpRead:
+                if (theReadFd < 0 || theReadSize < mBlockSize) {
+                    break;
+                }
+                if ((theRet = (int)theClient->PRead(theReadFd,
+                        (chunkOff_t)(rand_r(&mSeed) %
+                            (theReadSize / mBlockSize)) * mBlockSize,
+                        theBufPtr, mBlockSize)) != mBlockSize) {
+                    Error("read", theReadPath, theRet < 0 ? theRet : -EIO);
+                } else {
+                    mStats.mBytes[kOpRead] += mBlockSize;
+                }
+                Record(kPhaseRead, theNow);
+                break;
+            case kOpAppend:
+                if (theAppendFd < 0) {
+                    ostringstream theName;
+                    theName << theDir << "/a" << theFileSeq++;
+                    theAppendPath = theName.str();
+                    theAppendFd   = theClient->Open(theAppendPath.c_str(),
+                        O_CREAT | O_APPEND | O_WRONLY, theBench.mNumReplicas);
+                    theNow = Record(kPhaseOpen, theNow);
+                    if (theAppendFd < 0) {
+                        Error("create", theAppendPath, theAppendFd);
+                        break;
+                    }
+                    theAppendPos = 0;
+                }
+                // Sync after each record, in order to measure the append
+                // round trip.
+                if ((theRet = (int)theClient->Write(
+                        theAppendFd, theBufPtr, mBlockSize)) != mBlockSize ||
+                        (theRet = theClient->Sync(theAppendFd)) < 0) {
+                    Error("append", theAppendPath, theRet < 0 ? theRet : -EIO);
+                } else {
+                    theAppendPos += mBlockSize;
+                    mStats.mBytes[kOpAppend] += mBlockSize;
+                }
+                theNow = Record(kPhaseAppend, theNow);
+                if (theBench.mFileSize <= theAppendPos) {
+                    if ((theRet = theClient->Close(theAppendFd)) < 0) {
+                        Error("close", theAppendPath, theRet);
+                    }
+                    Record(kPhaseClose, theNow);
+                    theAppendFd = -1;
+                    if (! theBench.mKeepFilesFlag) {
+                        theClient->Remove(theAppendPath.c_str());
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (0 <= theWriteFd) {
+        theClient->Close(theWriteFd);
+    }
+    if (0 <= theAppendFd) {
+        theClient->Close(theAppendFd);
+    }
+    if (0 <= theReadFd) {
+        theClient->Close(theReadFd);
+    }
+    if (! theBench.mKeepFilesFlag) {
+        theClient->RmdirsFast(theDir.c_str());
+    }
+    delete theClient;
+}
+
+    void
+IoBench::GetServerStats(
+    IoBench::ServerStats& outStats)
+{
+    // Op-latency-<op>-<phase>: count,total-usec,bucket-0,...,bucket-N
+    static const char* const kPrefix    = "Op-latency-";
+    static const size_t      kPrefixLen = strlen(kPrefix);
+    outStats.clear();
+    for (vector<ServerLocation>::const_iterator theIt = mChunkServers.begin();
+            theIt != mChunkServers.end();
+            ++theIt) {
+        ChunkStatsOp theOp(0);
+        const int    theRet = mMonClient.Execute(*theIt, theOp);
+        if (theRet < 0) {
+            KFS_LOG_STREAM_ERROR << *theIt << ": " << theOp.statusMsg <<
+                " " << ErrorCodeToStr(theRet) <<
+            KFS_LOG_EOM;
+            continue;
+        }
+        for (Properties::iterator thePIt = theOp.stats.begin();
+                thePIt != theOp.stats.end();
+                ++thePIt) {
+            const string theKey(thePIt->first.GetPtr(),
+                thePIt->first.GetSize());
+            if (theKey.compare(0, kPrefixLen, kPrefix) != 0) {
+                continue;
+            }
+            ServerHistogram&  theHist = outStats[theKey.substr(kPrefixLen)];
+            const char*       thePtr  = thePIt->second.GetPtr();
+            const char* const theEndPtr = thePtr + thePIt->second.GetSize();
+            size_t            theIdx  = 0;
+            while (thePtr < theEndPtr) {
+                char* theNextPtr = 0;
+                const LatencyHistogram::Counter theVal =
+                    (LatencyHistogram::Counter)strtoll(thePtr, &theNextPtr, 10);
+                if (! theNextPtr || theNextPtr == thePtr) {
+                    break;
+                }
+                if (theHist.size() <= theIdx) {
+                    theHist.resize(theIdx + 1, 0);
+                }
+                theHist[theIdx++] += theVal;
+                if (theEndPtr <= theNextPtr || *theNextPtr != ',') {
+                    break;
+                }
+                thePtr = theNextPtr + 1;
+            }
+        }
+    }
+}
+
+    void
+IoBench::ReportServerStats(
+    const IoBench::ServerStats& inBefore,
+    const IoBench::ServerStats& inAfter,
+    ostream&                    inStream)
+{
+    // Bucket i counts times less than 2^i usec, percentile is reported as the
+    // bucket upper bound.
+    static const int kPercentiles[] = { 500, 900, 990, 999 };
+    for (ServerStats::const_iterator theIt = inAfter.begin();
+            theIt != inAfter.end();
+            ++theIt) {
+        ServerHistogram theHist = theIt->second;
+        ServerStats::const_iterator const theBIt =
+            inBefore.find(theIt->first);
+        if (theBIt != inBefore.end()) {
+            for (size_t i = 0;
+                    i < theHist.size() && i < theBIt->second.size();
+                    i++) {
+                theHist[i] -= theBIt->second[i];
+            }
+        }
+        if (theHist.size() < 3 || theHist[0] <= 0) {
+            continue;
+        }
+        const LatencyHistogram::Counter theCount = theHist[0];
+        inStream <<
+            "server: run=" << mRunIdx <<
+            " op="         << theIt->first <<
+            " count="      << theCount <<
+            " avg_usec="   << theHist[1] / theCount;
+        for (size_t p = 0;
+                p < sizeof(kPercentiles) / sizeof(kPercentiles[0]);
+                p++) {
+            const LatencyHistogram::Counter theRank =
+                (theCount * kPercentiles[p] + 999) / 1000;
+            LatencyHistogram::Counter theSum = 0;
+            size_t                    k      = 2;
+            while (k + 1 < theHist.size() && (theSum += theHist[k]) < theRank) {
+                k++;
+            }
+            inStream << " p" << kPercentiles[p] / 10 <<
+                (kPercentiles[p] % 10 ? "9" : "") <<
+                "_usec=" << (int64_t(1) << (k - 2));
+        }
+        inStream << "\n";
+    }
+}
+
+    void
+IoBench::Report(
+    int                   inBlockSize,
+    int                   inConcurrency,
+    const IoBench::Stats& inStats,
+    int64_t               inElapsedUsec,
+    ostream&              inStream)
+{
+    const double theSec = inElapsedUsec > 0 ? inElapsedUsec * 1e-6 : 1.;
+    for (int i = 0; i < kOpCount; i++) {
+        if (inStats.mBytes[i] <= 0) {
+            continue;
+        }
+        inStream <<
+            "throughput: run=" << mRunIdx <<
+            " block_size="     << inBlockSize <<
+            " threads="        << inConcurrency <<
+            " op="             << kOpNames[i] <<
+            " bytes="          << inStats.mBytes[i] <<
+            " mb_per_sec="     << inStats.mBytes[i] / theSec / (1 << 20) <<
+            " ops_per_sec="    << inStats.mBytes[i] / inBlockSize / theSec <<
+        "\n";
+    }
+    for (int i = 0; i < kPhaseCount; i++) {
+        const LatencyHistogram& theHist = inStats.mHist[i];
+        if (theHist.GetCount() <= 0) {
+            continue;
+        }
+        inStream <<
+            "latency: run="  << mRunIdx <<
+            " block_size="   << inBlockSize <<
+            " threads="      << inConcurrency <<
+            " phase="        << kPhaseNames[i] <<
+            " count="        << theHist.GetCount() <<
+            " avg_usec="     << theHist.GetTotal() / theHist.GetCount() <<
+            " p50_usec="     << theHist.GetPercentile(500) <<
+            " p90_usec="     << theHist.GetPercentile(900) <<
+            " p99_usec="     << theHist.GetPercentile(990) <<
+            " p999_usec="    << theHist.GetPercentile(999) <<
+            " max_usec="     << theHist.GetMax() <<
+        "\n";
+    }
+    inStream <<
+        "summary: run="    << mRunIdx <<
+        " block_size="     << inBlockSize <<
+        " threads="        << inConcurrency <<
+        " elapsed_usec="   << inElapsedUsec <<
+        " prepare_bytes="  << inStats.mPrepareBytes <<
+        " errors="         << inStats.mErrorCount <<
+    "\n";
+}
+
+    int
+IoBench::RunOne(
+    int inBlockSize,
+    int inConcurrency)
+{
+    ostringstream theStream;
+    theStream << mBaseDir << "/" << getpid() << "_" << mRunIdx;
+    const string theDir = theStream.str();
+    ServerStats  theBefore;
+    ServerStats  theAfter;
+    GetServerStats(theBefore);
+    Worker* const  theWorkers = new Worker[inConcurrency];
+    const int64_t  theStart = microseconds();
+    const int64_t  theEnd   = theStart + int64_t(mDurationSec) * 1000 * 1000;
+    for (int i = 0; i < inConcurrency; i++) {
+        theWorkers[i].Start(*this, i, inBlockSize, theEnd, theDir);
+    }
+    Stats theStats;
+    int   theStatus = 0;
+    for (int i = 0; i < inConcurrency; i++) {
+        theWorkers[i].Join();
+        theStats.Add(theWorkers[i].GetStats());
+        if (theWorkers[i].GetStatus() != 0) {
+            theStatus = theWorkers[i].GetStatus();
+        }
+    }
+    delete [] theWorkers;
+    const int64_t theElapsed = microseconds() - theStart;
+    GetServerStats(theAfter);
+    Report(inBlockSize, inConcurrency, theStats, theElapsed, cout);
+    ReportServerStats(theBefore, theAfter, cout);
+    cout.flush();
+    mRunIdx++;
+    return theStatus;
+}
+
+    int
+IoBench::Run(
+    int    inArgCount,
+    char** inArgsPtr)
+{
+    int         theOpt;
+    bool        theHelpFlag    = false;
+    bool        theVerboseFlag = false;
+    const char* theMixPtr      = "write:1";
+    const char* theSizesPtr    = "64k,1m";
+    const char* theThreadsPtr  = "1,4,16";
+    const char* theServersPtr  = 0;
+    while ((theOpt = getopt(inArgCount, inArgsPtr,
+            "s:p:f:d:m:b:c:S:t:r:C:ykvh")) != -1) {
+        switch (theOpt) {
+            case 's': mMetaHost          = optarg;               break;
+            case 'p': mMetaPort          = atoi(optarg);         break;
+            case 'f': mConfigFileNamePtr = optarg;               break;
+            case 'd': mBaseDir           = optarg;               break;
+            case 'm': theMixPtr          = optarg;               break;
+            case 'b': theSizesPtr        = optarg;               break;
+            case 'c': theThreadsPtr      = optarg;               break;
+            case 'S': mFileSize          = ParseSize(optarg);    break;
+            case 't': mDurationSec       = atoi(optarg);         break;
+            case 'r': mNumReplicas       = atoi(optarg);         break;
+            case 'C': theServersPtr      = optarg;               break;
+            case 'y': mSyncFlag          = false;                break;
+            case 'k': mKeepFilesFlag     = true;                 break;
+            case 'v': theVerboseFlag     = true;                 break;
+            default:  theHelpFlag        = true;                 break;
+        }
+    }
+    if (theHelpFlag || mMetaHost.empty() || mMetaPort <= 0 ||
+            mFileSize <= 0 || mDurationSec <= 0 || mNumReplicas <= 0 ||
+            ! ParseMix(theMixPtr) ||
+            ! ParseList(theSizesPtr, mBlockSizes, true) ||
+            ! ParseList(theThreadsPtr, mConcurrency, false) ||
+            (theServersPtr && ! ParseChunkServers(theServersPtr))) {
+        cerr << "Usage: " << (inArgCount > 0 ? inArgsPtr[0] : "qfsiobench") <<
+            " -s <meta server> -p <port>\n"
+            " [-f <client config file>]\n"
+            " [-d <base directory>]        default: /qfsiobench\n"
+            " [-m <op:weight,...>]         op mix, ops: write read append,"
+            " default: write:1\n"
+            " [-b <size,...>]              block sizes, default: 64k,1m\n"
+            " [-c <threads,...>]           concurrency levels, default:"
+            " 1,4,16\n"
+            " [-S <size>]                  file size, default: 64m\n"
+            " [-t <sec>]                   duration of each run, default:"
+            " 30\n"
+            " [-r <replicas>]              default: 1\n"
+            " [-C <host:port,...>]         chunk servers to report server"
+            " side\n"
+            "                              per phase latencies for\n"
+            " [-y]                         do not sync after each write\n"
+            " [-k]                         keep files\n"
+            " [-v]                         verbose\n"
+            "Runs each combination of block size and concurrency, and reports"
+            " throughput\n"
+            "and latency percentiles as key=value lines. Each thread uses its"
+            " own client,\n"
+            "writes / appends to its own files, and reads random blocks"
+            " of its own file.\n"
+            "Run against chunk servers with chunk directories on tmpfs,"
+            " ssd, or hdd\n"
+            "to benchmark the respective storage.\n"
+        ;
+        return 1;
+    }
+    MsgLogger::Init(0, theVerboseFlag ?
+        MsgLogger::kLogLevelDEBUG : MsgLogger::kLogLevelINFO);
+    if (! mChunkServers.empty()) {
+        if (mMonClient.SetParameters(ServerLocation(mMetaHost, mMetaPort),
+                mConfigFileNamePtr) < 0) {
+            return 1;
+        }
+        mMonClient.SetMaxContentLength(128 << 20);
+    }
+    int theStatus = 0;
+    for (vector<int>::const_iterator theBIt = mBlockSizes.begin();
+            theBIt != mBlockSizes.end() && theStatus == 0;
+            ++theBIt) {
+        for (vector<int>::const_iterator theCIt = mConcurrency.begin();
+                theCIt != mConcurrency.end() && theStatus == 0;
+                ++theCIt) {
+            theStatus = RunOne(*theBIt, *theCIt);
+        }
+    }
+    return (theStatus == 0 ? 0 : 1);
+}
+
+} // namespace KFS
+
+int
+main(int argc, char** argv)
+{
+    KFS::IoBench theBench;
+    return theBench.Run(argc, argv);
+}
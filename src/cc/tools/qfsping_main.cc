@@ -21,17 +21,33 @@
 // implied. See the License for the specific language governing
 // permissions and limitations under the License.
 //
-// \brief Meta and chunk server status report.
+// \brief Meta and chunk server status report, and rpc round trip benchmark.
+//
+// The benchmark mode issues no op, or ping rpcs back to back over one or more
+// connections, each connection with its own thread and MonClient, and reports
+// the throughput and round trip time percentiles. No op requests have no
+// server side work beyond request parsing, dispatch, and response
+// formatting, therefore no op round trip time is the network, framing, and
+// authentication / ssl overhead of KfsNetClient and NetConnection, and the
+// difference with the ping round trip time is the server side work. The
+// authentication and ssl parameters are set with the configuration file, the
+// same way as for the status report.
 //----------------------------------------------------------------------------
 
 #include "MonClient.h"
 #include "common/MsgLogger.h"
+#include "common/LatencyHistogram.h"
+#include "common/time.h"
 #include "libclient/KfsClient.h"
 #include "libclient/KfsOps.h"
+#include "qcdio/QCThread.h"
 
 #include <iostream>
 #include <string>
+#include <vector>
 #include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
 
 using std::string;
 using std::cout;
@@ -90,6 +106,181 @@ PingChunkServer(MonClient& client, const ServerLocation& location)
     return 0;
 }
 
+class PingBench
+{
+public:
+    PingBench(
+        const ServerLocation& inLocation,
+        const char*           inConfigFileNamePtr,
+        bool                  inMetaFlag,
+        bool                  inNoopFlag,
+        int                   inConnectionCount,
+        int                   inDurationSec,
+        int64_t               inOpsPerConnection,
+        int                   inWarmupOpCount)
+        : mLocation(inLocation),
+          mConfigFileNamePtr(inConfigFileNamePtr),
+          mMetaFlag(inMetaFlag),
+          mNoopFlag(inNoopFlag),
+          mConnectionCount(inConnectionCount),
+          mDurationSec(inDurationSec),
+          mOpsPerConnection(inOpsPerConnection),
+          mWarmupOpCount(inWarmupOpCount)
+        {}
+    int Run()
+    {
+        Worker* const theWorkers = new Worker[mConnectionCount];
+        for (int i = 0; i < mConnectionCount; i++) {
+            theWorkers[i].Start(*this);
+        }
+        LatencyHistogram theHist;
+        int64_t          theErrors = 0;
+        int64_t          theTime   = 0;
+        int              theStatus = 0;
+        for (int i = 0; i < mConnectionCount; i++) {
+            theWorkers[i].Join();
+            theHist.Add(theWorkers[i].mHist);
+            theErrors += theWorkers[i].mErrorCount;
+            if (theTime < theWorkers[i].mTime) {
+                theTime = theWorkers[i].mTime;
+            }
+            if (theWorkers[i].mStatus != 0) {
+                theStatus = theWorkers[i].mStatus;
+            }
+        }
+        delete [] theWorkers;
+        const int64_t theOps = theHist.GetCount();
+        cout <<
+            "op="          << (mNoopFlag ? "noop" : "ping") <<
+            " server="     << (mMetaFlag ? "meta" : "chunk") <<
+            " connections=" << mConnectionCount <<
+            " ops="        << theOps <<
+            " errors="     << theErrors <<
+            " sec="        << theTime * 1e-6 <<
+            " ops-per-sec=" << (theTime <= 0 ? 0. :
+                theOps * 1e6 / theTime) <<
+            " rtt-usec-mean=" << (theOps <= 0 ? 0. :
+                (double)theHist.GetTotal() / theOps) <<
+            " rtt-usec-p50="  << theHist.GetPercentile(500) <<
+            " rtt-usec-p90="  << theHist.GetPercentile(900) <<
+            " rtt-usec-p99="  << theHist.GetPercentile(990) <<
+            " rtt-usec-p999=" << theHist.GetPercentile(999) <<
+            " rtt-usec-max="  << theHist.GetMax() <<
+        "\n";
+        return (theStatus == 0 && theErrors == 0 ? 0 : 1);
+    }
+private:
+    class Worker : public QCRunnable
+    {
+    public:
+        Worker()
+            : mHist(),
+              mErrorCount(0),
+              mTime(0),
+              mStatus(0),
+              mBenchPtr(0),
+              mThread()
+            {}
+        void Start(
+            PingBench& inBench)
+        {
+            mBenchPtr = &inBench;
+            mThread.Start(this, 256 << 10, "PingBenchWorker");
+        }
+        void Join()
+            { mThread.Join(); }
+        virtual void Run()
+        {
+            const PingBench& theBench = *mBenchPtr;
+            MonClient        theClient;
+            if ((mStatus = theClient.SetParameters(
+                    theBench.mLocation, theBench.mConfigFileNamePtr)) < 0) {
+                return;
+            }
+            theClient.SetMaxRpcHeaderLength(32 << 20);
+            kfsSeq_t theSeq = 1;
+            // Warm up: connect, and authenticate if configured.
+            for (int i = 0; i < theBench.mWarmupOpCount; i++) {
+                if (Execute(theClient, theSeq++) < 0) {
+                    mErrorCount++;
+                    mStatus = -1;
+                    return;
+                }
+            }
+            const int64_t theStart = microseconds();
+            const int64_t theEnd   = 0 < theBench.mDurationSec ?
+                theStart + (int64_t)theBench.mDurationSec * 1000 * 1000 : -1;
+            int64_t theNow = theStart;
+            for (int64_t i = 0;
+                    (theBench.mOpsPerConnection <= 0 ||
+                        i < theBench.mOpsPerConnection) &&
+                    (theEnd < 0 || theNow < theEnd);
+                    i++) {
+                const int64_t theOpStart = theNow;
+                const int     theRet     = Execute(theClient, theSeq++);
+                theNow = microseconds();
+                if (theRet < 0) {
+                    if (mErrorCount++ < 10) {
+                        KFS_LOG_STREAM_ERROR <<
+                            theBench.mLocation <<
+                            " error: " << ErrorCodeToStr(theRet) <<
+                        KFS_LOG_EOM;
+                    }
+                    continue;
+                }
+                mHist.Add(theNow - theOpStart);
+            }
+            mTime = theNow - theStart;
+        }
+        LatencyHistogram mHist;
+        int64_t          mErrorCount;
+        int64_t          mTime;
+        int              mStatus;
+    private:
+        PingBench* mBenchPtr;
+        QCThread   mThread;
+
+        int Execute(
+            MonClient& inClient,
+            kfsSeq_t   inSeq)
+        {
+            const PingBench& theBench = *mBenchPtr;
+            if (theBench.mNoopFlag) {
+                NoopOp theOp(inSeq);
+                const int theRet = inClient.Execute(theBench.mLocation, theOp);
+                return (theRet < 0 ? theRet : theOp.status);
+            }
+            if (theBench.mMetaFlag) {
+                MetaPingOp theOp(inSeq);
+                const int theRet = inClient.Execute(theBench.mLocation, theOp);
+                return (theRet < 0 ? theRet : theOp.status);
+            }
+            ChunkPingOp theOp(inSeq);
+            const int theRet = inClient.Execute(theBench.mLocation, theOp);
+            return (theRet < 0 ? theRet : theOp.status);
+        }
+    private:
+        Worker(
+            const Worker& inWorker);
+        Worker& operator=(
+            const Worker& inWorker);
+    };
+
+    const ServerLocation mLocation;
+    const char* const    mConfigFileNamePtr;
+    const bool           mMetaFlag;
+    const bool           mNoopFlag;
+    const int            mConnectionCount;
+    const int            mDurationSec;
+    const int64_t        mOpsPerConnection;
+    const int            mWarmupOpCount;
+private:
+    PingBench(
+        const PingBench& inBench);
+    PingBench& operator=(
+        const PingBench& inBench);
+};
+
 int main(int argc, char** argv)
 {
     int         optchar;
@@ -100,8 +291,14 @@ int main(int argc, char** argv)
     const char* configFileName = 0;
     int         port           = -1;
     bool        verboseLogging = false;
+    bool        bench          = false;
+    bool        benchNoop      = true;
+    int         connections    = 1;
+    int         durationSec    = 10;
+    int64_t     opsPerConn     = 0;
+    int         warmupOps      = 10;
 
-    while ((optchar = getopt(argc, argv, "hmcs:p:vf:")) != -1) {
+    while ((optchar = getopt(argc, argv, "hmcs:p:vf:bo:n:d:N:w:")) != -1) {
         switch (optchar) {
             case 'm':
                 meta = true;
@@ -124,21 +321,55 @@ int main(int argc, char** argv)
             case 'f':
                 configFileName = optarg;
                 break;
+            case 'b':
+                bench = true;
+                break;
+            case 'o':
+                if (strcmp(optarg, "noop") == 0) {
+                    benchNoop = true;
+                } else if (strcmp(optarg, "ping") == 0) {
+                    benchNoop = false;
+                } else {
+                    help = true;
+                }
+                break;
+            case 'n':
+                connections = atoi(optarg);
+                break;
+            case 'd':
+                durationSec = atoi(optarg);
+                break;
+            case 'N':
+                opsPerConn = (int64_t)atoll(optarg);
+                break;
+            case 'w':
+                warmupOps = atoi(optarg);
+                break;
             default:
                 help = true;
                 break;
         }
     }
 
-    help = help || (! meta && ! chunk);
+    help = help || (! meta && ! chunk) || connections <= 0 ||
+        (bench && durationSec <= 0 && opsPerConn <= 0) || warmupOps < 0;
     if (help || ! server || port < 0) {
         cout << "Usage: " << argv[0] <<
-            " [-m|-c] -s <server name> -p <port> [-v]\n"
+            " [-m|-c] -s <server name> -p <port> [-v] [-f <config file>]\n"
+            " [-b [-o {noop|ping}] [-n <connections>] [-d <seconds>]"
+            " [-N <ops per connection>] [-w <warm up ops>]]\n"
             "Deprecated. Please use qfsadmin instead.\n"
             "   -c : ping chunkserver. Deprecated."
                     " Chunk server ping is not supported"
                     " with QFS authentication.\n"
             "   -m : ping metaserver.\n"
+            "   -b : rpc round trip benchmark.\n"
+            "   -o : benchmark op: noop or ping, default noop.\n"
+            "   -n : number of connections, default 1.\n"
+            "   -d : benchmark duration in seconds, default 10.\n"
+            "   -N : max number of ops per connection, default no limit.\n"
+            "   -w : warm up ops per connection, excluded from the stats,"
+                " default 10.\n"
         ;
 
         return 1;
@@ -148,6 +379,24 @@ int main(int argc, char** argv)
         MsgLogger::kLogLevelDEBUG : MsgLogger::kLogLevelINFO);
 
     const ServerLocation loc(server, port);
+    if (bench) {
+        if (! meta) {
+            MonClient client;
+            if (client.SetParameters(loc, configFileName) < 0) {
+                return 1;
+            }
+            if (client.IsAuthEnabled()) {
+                KFS_LOG_STREAM_ERROR <<
+                    "Chunk sever benchmark is not supported with QFS"
+                    " authentication." <<
+                KFS_LOG_EOM;
+                return 1;
+            }
+        }
+        PingBench pingBench(loc, configFileName, meta, benchNoop,
+            connections, durationSec, opsPerConn, warmupOps);
+        return pingBench.Run();
+    }
     MonClient client;
     if (client.SetParameters(loc, configFileName) < 0) {
         return 1;
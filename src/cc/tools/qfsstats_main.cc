@@ -27,11 +27,17 @@
 
 #include "MonClient.h"
 #include "common/MsgLogger.h"
+#include "common/time.h"
+#include "kfsio/CryptoKeys.h"
 #include "libclient/KfsClient.h"
 #include "libclient/KfsOps.h"
 
 #include <iostream>
 #include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
 
 
 using namespace KFS;
@@ -40,36 +46,112 @@ using namespace KFS::client;
 
 using std::string;
 using std::cout;
+using std::vector;
+
+// Polls the server stats. With delta subscription the server sends only the
+// stats changed since the previous poll over the same connection. With rate
+// view the counters are reported as per second rates, and the latency
+// percentiles are computed over the poll interval.
+class StatsSampler
+{
+public:
+    StatsSampler(bool deltaFlag, bool rateFlag)
+        : mDeltaId(0),
+          mDeltaGen(0),
+          mRateFlag(rateFlag),
+          mHasPrevFlag(false),
+          mTime(0),
+          mElapsed(0),
+          mStats(),
+          mPrev()
+    {
+        if (deltaFlag) {
+            while (mDeltaId <= 0) {
+                CryptoKeys::PseudoRand(&mDeltaId, sizeof(mDeltaId));
+                mDeltaId = (mDeltaId < 0 ? -mDeltaId : mDeltaId) >> 1;
+            }
+        }
+    }
+    template<typename T>
+    int Sample(MonClient& client, const ServerLocation& loc, T* /* type */)
+    {
+        T op(0, mDeltaId);
+        op.stats    = mStats;
+        op.deltaGen = mDeltaGen;
+        const int ret = client.Execute(loc, op);
+        if (ret < 0) {
+            KFS_LOG_STREAM_ERROR << op.statusMsg <<
+                " " << ErrorCodeToStr(ret) <<
+            KFS_LOG_EOM;
+            return ret;
+        }
+        const int64_t now = microseconds();
+        mHasPrevFlag = mRateFlag && 0 < mTime && mTime < now;
+        mElapsed     = mHasPrevFlag ? (now - mTime) * 1e-6 : 0;
+        mTime        = now;
+        mDeltaGen    = op.deltaGen;
+        mPrev.swap(mStats);
+        mStats.swap(op.stats);
+        return 0;
+    }
+    const Properties& GetStats() const
+        { return mStats; }
+    const Properties* GetPrev() const
+        { return (mHasPrevFlag ? &mPrev : 0); }
+    // Counter value, or its per second rate with rate view.
+    long long GetCounter(const char* name) const
+    {
+        const long long val = mStats.getValue(name, (long long)0);
+        if (! mHasPrevFlag) {
+            return val;
+        }
+        return (long long)((val - mPrev.getValue(name, (long long)0)) /
+            mElapsed);
+    }
+    long long GetValue(const char* name) const
+        { return mStats.getValue(name, (long long)0); }
+    bool IsRate() const
+        { return mRateFlag; }
+private:
+    int64_t    mDeltaId;
+    int64_t    mDeltaGen;
+    const bool mRateFlag;
+    bool       mHasPrevFlag;
+    int64_t    mTime;
+    double     mElapsed;
+    Properties mStats;
+    Properties mPrev;
+};
 
 static int
 StatsMetaServer(MonClient& client, const ServerLocation &location,
-    bool rpcStats, int numSecs);
+    bool rpcStats, int numSecs, StatsSampler& sampler);
 
 static int
 BasicStatsMetaServer(MonClient& client, const ServerLocation &location,
-    int numSecs);
+    int numSecs, StatsSampler& sampler);
 
 static int
 RpcStatsMetaServer(MonClient& client, const ServerLocation &location,
-    int numSecs);
+    int numSecs, StatsSampler& sampler);
 
 static int
 StatsChunkServer(MonClient& client, const ServerLocation &location,
-    bool rpcStats, int numSecs);
+    bool rpcStats, int numSecs, StatsSampler& sampler);
 
 static int
 BasicStatsChunkServer(MonClient& client, const ServerLocation &location,
-    int numSecs);
+    int numSecs, StatsSampler& sampler);
 
 static int
 RpcStatsChunkServer(MonClient& client, const ServerLocation &location,
-    int numSecs);
+    int numSecs, StatsSampler& sampler);
 
 static void
-PrintChunkBasicStatsHeader();
+PrintChunkBasicStatsHeader(bool rateFlag);
 
 static void
-PrintMetaBasicStatsHeader();
+PrintMetaBasicStatsHeader(bool rateFlag);
 
 
 int
@@ -81,12 +163,14 @@ main(int argc, char **argv)
     bool        chunk          = false;
     bool        rpcStats       = false;
     bool        verboseLogging = false;
+    bool        delta          = false;
+    bool        rate           = false;
     const char* server         = 0;
     const char* configFileName = 0;
     int         port           = -1;
     int         numSecs        = 10;
 
-    while ((optchar = getopt(argc, argv, "hcmn:p:s:tvf:")) != -1) {
+    while ((optchar = getopt(argc, argv, "hcmn:p:s:tvf:dr")) != -1) {
         switch (optchar) {
             case 'm':
                 meta = true;
@@ -115,6 +199,12 @@ main(int argc, char **argv)
             case 'f':
                 configFileName = optarg;
                 break;
+            case 'd':
+                delta = true;
+                break;
+            case 'r':
+                rate = true;
+                break;
             default:
                 help = true;
                 break;
@@ -126,12 +216,16 @@ main(int argc, char **argv)
     if (help || (server == NULL) || (port < 0)) {
         cout << "Usage: " << argv[0] <<
              " [-m|-c] -s <server name> -p <port> [-n <secs>] [-t] [-v]"
-             " [-f <config file>]\n"
+             " [-f <config file>] [-d] [-r]\n"
              "Deprecated. Please use qfsadmin instead.\n"
              "Gets the stats from meta/chunk servers at given intervals.\n"
              "        Use -m for metaserver, -c for chunk server.\n"
              "        Use -t for RPC stats.\n"
-             "        Use -n <seconds> to specify interval (default 10s)."
+             "        Use -n <seconds> to specify interval (default 10s).\n"
+             "        Use -d to request only the stats changed since the\n"
+             "           previous interval.\n"
+             "        Use -r to report counters as per second rates, and\n"
+             "           latency percentiles over the interval."
              "\n";
         return -1;
     }
@@ -145,74 +239,145 @@ main(int argc, char **argv)
         return 1;
     }
     client.SetMaxContentLength(128 << 20);
+    StatsSampler sampler(delta, rate);
     if (meta) {
-        return StatsMetaServer(client, location, rpcStats, numSecs);
+        return StatsMetaServer(client, location, rpcStats, numSecs, sampler);
     }
     if (chunk) {
-        return StatsChunkServer(client, location, rpcStats, numSecs);
+        return StatsChunkServer(client, location, rpcStats, numSecs, sampler);
     }
     return 0;
 }
 
 static void
-PrintRpcStat(const string &statName, Properties &prop)
+PrintRpcStat(const char* statName, const StatsSampler& sampler)
 {
     // cout << statName << " = " << prop.getValue(statName, (long
     // long) 0) << "\n";
-    cout << statName << " = " << prop.getValue(statName, "0") << "\n";
+    cout << statName << " = " << sampler.GetStats().getValue(statName, "0");
+    if (sampler.GetPrev()) {
+        cout << " rate: " << sampler.GetCounter(statName) << "/s";
+    }
+    cout << "\n";
 }
 
+static void
+ParseHistogram(const char* ptr, const char* end, vector<long long>& vals)
+{
+    vals.clear();
+    while (ptr < end) {
+        char* next = 0;
+        vals.push_back(strtoll(ptr, &next, 10));
+        if (! next || next == ptr || end <= next || *next != ',') {
+            break;
+        }
+        ptr = next + 1;
+    }
+}
+
+// Print percentiles of the op latency histograms:
+// <prefix><op>-<phase>: count,total-usec,bucket-0,...,bucket-N
+// where bucket i counts times less than 2^i usec. Percentile is reported as
+// the upper bound of the bucket where it falls. With the previous stats the
+// percentiles are computed over the interval between the two.
+static void
+PrintOpLatencyStats(const Properties& prop, const char* prefix,
+    const Properties* prev)
+{
+    const size_t        prefixLen      = strlen(prefix);
+    static const double kPercentiles[] = { 50, 90, 99, 99.9 };
+    const size_t        kPercentilesCnt =
+        sizeof(kPercentiles) / sizeof(kPercentiles[0]);
+    vector<long long>   vals;
+    vector<long long>   prevVals;
+    for (Properties::iterator it = prop.begin(); it != prop.end(); ++it) {
+        const string key(it->first.GetPtr(), it->first.GetSize());
+        if (key.compare(0, prefixLen, prefix) != 0) {
+            continue;
+        }
+        ParseHistogram(it->second.GetPtr(),
+            it->second.GetPtr() + it->second.GetSize(), vals);
+        const char* const pval = prev ?
+            prev->getValue(it->first, (const char*)0) : 0;
+        if (pval) {
+            ParseHistogram(pval, pval + strlen(pval), prevVals);
+            for (size_t i = 0; i < vals.size() && i < prevVals.size(); i++) {
+                vals[i] -= prevVals[i];
+            }
+        }
+        if (vals.size() < 3 || vals[0] <= 0) {
+            continue;
+        }
+        const long long count = vals[0];
+        cout << key.substr(prefixLen) <<
+            " count: " << count <<
+            " avg: "   << vals[1] / count;
+        for (size_t i = 0; i < kPercentilesCnt; i++) {
+            const double thresh = count * kPercentiles[i] / 100;
+            long long    sum    = 0;
+            size_t       k      = 2;
+            for (; k < vals.size(); k++) {
+                sum += vals[k];
+                if (thresh <= sum) {
+                    break;
+                }
+            }
+            cout << " p" << kPercentiles[i] << ": <" <<
+                (1LL << (k < vals.size() ? k - 2 : vals.size() - 3));
+        }
+        cout << " usec\n";
+    }
+}
 
 int
-StatsMetaServer(MonClient& client, const ServerLocation& loc, bool rpcStats, int numSecs)
+StatsMetaServer(MonClient& client, const ServerLocation& loc, bool rpcStats,
+    int numSecs, StatsSampler& sampler)
 {
     if (rpcStats) {
-        return RpcStatsMetaServer(client, loc, numSecs);
+        return RpcStatsMetaServer(client, loc, numSecs, sampler);
     } else {
-        return BasicStatsMetaServer(client, loc, numSecs);
+        return BasicStatsMetaServer(client, loc, numSecs, sampler);
     }
 }
 
 int
-RpcStatsMetaServer(MonClient& client, const ServerLocation& loc, int numSecs)
+RpcStatsMetaServer(MonClient& client, const ServerLocation& loc, int numSecs,
+    StatsSampler& sampler)
 {
     for (; ;) {
-        MetaStatsOp op(0);
-        const int ret = client.Execute(loc, op);
-        if (ret < 0) {
-            KFS_LOG_STREAM_ERROR << op.statusMsg <<
-                " " << ErrorCodeToStr(ret) <<
-            KFS_LOG_EOM;
+        if (sampler.Sample(client, loc, (MetaStatsOp*)0) < 0) {
             return 1;
         }
 
-        PrintRpcStat("Get alloc", op.stats);
-        PrintRpcStat("Get layout", op.stats);
-        PrintRpcStat("Lookup", op.stats);
-        PrintRpcStat("Lookup Path", op.stats);
-        PrintRpcStat("Allocate", op.stats);
-        PrintRpcStat("Truncate", op.stats);
-        PrintRpcStat("Create", op.stats);
-        PrintRpcStat("Remove", op.stats);
-        PrintRpcStat("Rename", op.stats);
-        PrintRpcStat("Mkdir", op.stats);
-        PrintRpcStat("Rmdir", op.stats);
-        PrintRpcStat("Lease Acquire", op.stats);
-        PrintRpcStat("Lease Renew", op.stats);
-        PrintRpcStat("Lease Cleanup", op.stats);
-        PrintRpcStat("Chunkserver Hello", op.stats);
-        PrintRpcStat("Chunkserver Bye", op.stats);
-        PrintRpcStat("Replication Checker", op.stats);
-        PrintRpcStat("Num Replications Todo", op.stats);
-        PrintRpcStat("Num Ongoing Replications", op.stats);
-        PrintRpcStat("Num Failed Replications", op.stats);
-        PrintRpcStat("Total Num Replications", op.stats);
-        PrintRpcStat("Num Stale Chunks", op.stats);
-        PrintRpcStat("Number of Directories", op.stats);
-        PrintRpcStat("Number of Files", op.stats);
-        PrintRpcStat("Number of Chunks", op.stats);
-        PrintRpcStat("Number of Hits in Path->Fid Cache", op.stats);
-        PrintRpcStat("Number of Misses in Path->Fid Cache", op.stats);
+        PrintRpcStat("Get alloc", sampler);
+        PrintRpcStat("Get layout", sampler);
+        PrintRpcStat("Lookup", sampler);
+        PrintRpcStat("Lookup Path", sampler);
+        PrintRpcStat("Allocate", sampler);
+        PrintRpcStat("Truncate", sampler);
+        PrintRpcStat("Create", sampler);
+        PrintRpcStat("Remove", sampler);
+        PrintRpcStat("Rename", sampler);
+        PrintRpcStat("Mkdir", sampler);
+        PrintRpcStat("Rmdir", sampler);
+        PrintRpcStat("Lease Acquire", sampler);
+        PrintRpcStat("Lease Renew", sampler);
+        PrintRpcStat("Lease Cleanup", sampler);
+        PrintRpcStat("Chunkserver Hello", sampler);
+        PrintRpcStat("Chunkserver Bye", sampler);
+        PrintRpcStat("Replication Checker", sampler);
+        PrintRpcStat("Num Replications Todo", sampler);
+        PrintRpcStat("Num Ongoing Replications", sampler);
+        PrintRpcStat("Num Failed Replications", sampler);
+        PrintRpcStat("Total Num Replications", sampler);
+        PrintRpcStat("Num Stale Chunks", sampler);
+        PrintRpcStat("Number of Directories", sampler);
+        PrintRpcStat("Number of Files", sampler);
+        PrintRpcStat("Number of Chunks", sampler);
+        PrintRpcStat("Number of Hits in Path->Fid Cache", sampler);
+        PrintRpcStat("Number of Misses in Path->Fid Cache", sampler);
+        PrintOpLatencyStats(sampler.GetStats(), "Request-phase-",
+            sampler.GetPrev());
 
         cout << "----------------------------------" << "\n";
         if (numSecs == 0) {
@@ -224,25 +389,21 @@ RpcStatsMetaServer(MonClient& client, const ServerLocation& loc, int numSecs)
 }
 
 int
-BasicStatsMetaServer(MonClient& client, const ServerLocation& loc, int numSecs)
+BasicStatsMetaServer(MonClient& client, const ServerLocation& loc, int numSecs,
+    StatsSampler& sampler)
 {
-    PrintMetaBasicStatsHeader();
+    PrintMetaBasicStatsHeader(sampler.IsRate());
     for (int i = 1; ; i++) {
-        MetaStatsOp op(0);
-        const int ret = client.Execute(loc, op);
-        if (ret < 0) {
-            KFS_LOG_STREAM_ERROR << op.statusMsg <<
-                " " << ErrorCodeToStr(ret) <<
-            KFS_LOG_EOM;
+        if (sampler.Sample(client, loc, (MetaStatsOp*)0) < 0) {
             return 1;
         }
         // useful things to have: # of connections handled
         if (i % 10 == 0) {
-            PrintMetaBasicStatsHeader();
+            PrintMetaBasicStatsHeader(sampler.IsRate());
         }
-        cout << op.stats.getValue("Open network fds", (long long) 0) << '\t';
-        cout << op.stats.getValue("Bytes read from network", (long long) 0) << '\t';
-        cout << op.stats.getValue("Bytes written to network", (long long) 0) << "\n";
+        cout << sampler.GetValue("Open network fds") << '\t';
+        cout << sampler.GetCounter("Bytes read from network") << '\t';
+        cout << sampler.GetCounter("Bytes written to network") << "\n";
 
         if (numSecs == 0) {
             break;
@@ -253,14 +414,16 @@ BasicStatsMetaServer(MonClient& client, const ServerLocation& loc, int numSecs)
 }
 
 static void
-PrintMetaBasicStatsHeader()
+PrintMetaBasicStatsHeader(bool rateFlag)
 {
-    cout << "Net Fds" << '\t' << "N/w Bytes In" << '\t'
-         << "N/w Bytes Out" << "\n";
+    const char* const rate = rateFlag ? "/s" : "";
+    cout << "Net Fds" << '\t' << "N/w Bytes In" << rate << '\t'
+         << "N/w Bytes Out" << rate << "\n";
 }
 
 int
-StatsChunkServer(MonClient& client, const ServerLocation& loc, bool rpcStats, int numSecs)
+StatsChunkServer(MonClient& client, const ServerLocation& loc, bool rpcStats,
+    int numSecs, StatsSampler& sampler)
 {
     if (client.GetAuthContext() && client.GetAuthContext()->IsEnabled()) {
         KFS_LOG_STREAM_WARN <<
@@ -269,39 +432,37 @@ StatsChunkServer(MonClient& client, const ServerLocation& loc, bool rpcStats, in
         KFS_LOG_EOM;
     }
     if (rpcStats) {
-        return RpcStatsChunkServer(client, loc, numSecs);
+        return RpcStatsChunkServer(client, loc, numSecs, sampler);
     } else {
-        return BasicStatsChunkServer(client, loc, numSecs);
+        return BasicStatsChunkServer(client, loc, numSecs, sampler);
     }
 }
 
 int
-RpcStatsChunkServer(MonClient& client, const ServerLocation& loc, int numSecs)
+RpcStatsChunkServer(MonClient& client, const ServerLocation& loc, int numSecs,
+    StatsSampler& sampler)
 {
     for (; ;) {
-        ChunkStatsOp op(0);
-        const int ret = client.Execute(loc, op);
-        if (ret < 0) {
-            KFS_LOG_STREAM_ERROR << op.statusMsg <<
-                " " << ErrorCodeToStr(ret) <<
-            KFS_LOG_EOM;
+        if (sampler.Sample(client, loc, (ChunkStatsOp*)0) < 0) {
             return 1;
         }
 
-        PrintRpcStat("Alloc", op.stats);
-        PrintRpcStat("Size", op.stats);
-        PrintRpcStat("Open", op.stats);
-        PrintRpcStat("Read", op.stats);
-        PrintRpcStat("Write", op.stats);
-        PrintRpcStat("Write Prepare", op.stats);
-        PrintRpcStat("Write Sync", op.stats);
-        PrintRpcStat("Write Duration", op.stats);
-        PrintRpcStat("Write Master", op.stats);
-        PrintRpcStat("Delete", op.stats);
-        PrintRpcStat("Truncate", op.stats);
-        PrintRpcStat("Heartbeat", op.stats);
-        PrintRpcStat("Change Chunk Vers", op.stats);
-        PrintRpcStat("Num ops", op.stats);
+        PrintRpcStat("Alloc", sampler);
+        PrintRpcStat("Size", sampler);
+        PrintRpcStat("Open", sampler);
+        PrintRpcStat("Read", sampler);
+        PrintRpcStat("Write", sampler);
+        PrintRpcStat("Write Prepare", sampler);
+        PrintRpcStat("Write Sync", sampler);
+        PrintRpcStat("Write Duration", sampler);
+        PrintRpcStat("Write Master", sampler);
+        PrintRpcStat("Delete", sampler);
+        PrintRpcStat("Truncate", sampler);
+        PrintRpcStat("Heartbeat", sampler);
+        PrintRpcStat("Change Chunk Vers", sampler);
+        PrintRpcStat("Num ops", sampler);
+        PrintOpLatencyStats(sampler.GetStats(), "Op-latency-",
+            sampler.GetPrev());
         cout << "----------------------------------" << "\n";
         if (numSecs == 0) {
             break;
@@ -312,28 +473,24 @@ RpcStatsChunkServer(MonClient& client, const ServerLocation& loc, int numSecs)
 }
 
 int
-BasicStatsChunkServer(MonClient& client, const ServerLocation& loc, int numSecs)
+BasicStatsChunkServer(MonClient& client, const ServerLocation& loc,
+    int numSecs, StatsSampler& sampler)
 {
-    PrintChunkBasicStatsHeader();
+    PrintChunkBasicStatsHeader(sampler.IsRate());
     for (int i = 0; ; i++) {
-        ChunkStatsOp op(0);
-        const int ret = client.Execute(loc, op);
-        if (ret < 0) {
-            KFS_LOG_STREAM_ERROR << op.statusMsg <<
-                " error: " << ErrorCodeToStr(ret) <<
-            KFS_LOG_EOM;
+        if (sampler.Sample(client, loc, (ChunkStatsOp*)0) < 0) {
             return 1;
         }
 
         if (i % 10 == 0) {
-            PrintChunkBasicStatsHeader();
+            PrintChunkBasicStatsHeader(sampler.IsRate());
         }
-        cout << op.stats.getValue("Open network fds", (long long) 0) << '\t';
-        cout << op.stats.getValue("Bytes read from network", (long long) 0) << '\t';
-        cout << op.stats.getValue("Bytes written to network", (long long) 0) << '\t';
-        cout << op.stats.getValue("Open disk fds", (long long) 0) << '\t';
-        cout << op.stats.getValue("Bytes read from disk", (long long) 0) << '\t';
-        cout << op.stats.getValue("Bytes written to disk", (long long) 0) << "\n";
+        cout << sampler.GetValue("Open network fds") << '\t';
+        cout << sampler.GetCounter("Bytes read from network") << '\t';
+        cout << sampler.GetCounter("Bytes written to network") << '\t';
+        cout << sampler.GetValue("Open disk fds") << '\t';
+        cout << sampler.GetCounter("Bytes read from disk") << '\t';
+        cout << sampler.GetCounter("Bytes written to disk") << "\n";
 
         if (numSecs == 0) {
             break;
@@ -344,10 +501,11 @@ BasicStatsChunkServer(MonClient& client, const ServerLocation& loc, int numSecs)
 }
 
 static void
-PrintChunkBasicStatsHeader()
+PrintChunkBasicStatsHeader(bool rateFlag)
 {
-    cout << "Net Fds" << '\t' << "N/w Bytes In" << '\t'
-         << "N/w Bytes Out" << '\t'
-         << "Disk Fds" << '\t' << "Disk Bytes In" << '\t'
-         << "Disk Bytes Out" << "\n";
+    const char* const rate = rateFlag ? "/s" : "";
+    cout << "Net Fds" << '\t' << "N/w Bytes In" << rate << '\t'
+         << "N/w Bytes Out" << rate << '\t'
+         << "Disk Fds" << '\t' << "Disk Bytes In" << rate << '\t'
+         << "Disk Bytes Out" << rate << "\n";
 }
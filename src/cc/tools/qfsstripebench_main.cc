@@ -0,0 +1,609 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// $Id$
+//
+// Created 2026/10/14
+//
+// Copyright 2026 Quantcast Corporation. All rights reserved.
+//
+// This file is part of Kosmos File System (KFS).
+//
+// Licensed under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the License.
+//
+// \brief Striped and replicated file layouts throughput benchmark. For each
+// combination of file layout and io size writes and then sequentially reads
+// a file through the client library Writer / Reader, and for Reed-Solomon
+// layouts with recovery stripes it also reads the file with 1 up to the number
+// of recovery stripes data stripe reads failed, in order to measure the
+// degraded read performance. The data stripe read failures are injected
+// on the client side, no chunk reads are issued for the failed stripes, and
+// the reads are served by the RS recovery. Reports MB/sec, client cpu time
+// per byte, per io call latency percentiles, and the client retry and error
+// counters deltas as key=value lines. The client io and meta operation
+// timeouts, the retry delay and the max retry count can be set from the
+// command line, in order to measure their effect on the throughput and tail
+// latency with chunk servers network error simulator enabled, see
+// test-scripts/netfaultperf.sh
+//
+//----------------------------------------------------------------------------
+
+#include "common/MsgLogger.h"
+#include "common/LatencyHistogram.h"
+#include "common/time.h"
+#include "common/Properties.h"
+#include "libclient/KfsClient.h"
+#include "libclient/RSStriper.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+namespace KFS
+{
+using std::cout;
+using std::cerr;
+using std::string;
+using std::vector;
+using std::ostringstream;
+using std::istringstream;
+using client::RSStriperSetReadFailureInjection;
+
+class StripeBench
+{
+public:
+    StripeBench()
+        : mMetaHost(),
+          mMetaPort(-1),
+          mConfigFileNamePtr(0),
+          mBaseDir("/qfsstripebench"),
+          mLayouts(),
+          mIoSizes(),
+          mFileSize(int64_t(1) << 30),
+          mClientBufferSize(0),
+          mMaxFailures(-1),
+          mIoTimeoutSec(-1),
+          mMetaOpTimeoutSec(-1),
+          mRetryDelaySec(-1),
+          mMaxRetryCount(-1),
+          mVerifyFlag(true),
+          mKeepFilesFlag(false),
+          mClientPtr(0),
+          mBuf(),
+          mReadBuf(),
+          mCounterNames()
+        {}
+    ~StripeBench()
+        { delete mClientPtr; }
+    int Run(
+        int    inArgCount,
+        char** inArgsPtr);
+private:
+    typedef vector<int64_t> Counters;
+    class Stats
+    {
+    public:
+        Stats(
+            const Counters& inCounters)
+            : mCounters(inCounters),
+              mHist(),
+              mBytes(0),
+              mErrorCount(0),
+              mMismatchCount(0),
+              mStartUsec(microseconds()),
+              mStartCpuUsec(GetCpuUsec()),
+              mElapsedUsec(0),
+              mCpuUsec(0)
+            {}
+        void Stop()
+        {
+            mElapsedUsec = microseconds() - mStartUsec;
+            mCpuUsec     = GetCpuUsec() - mStartCpuUsec;
+        }
+        Counters         mCounters;
+        LatencyHistogram mHist;
+        int64_t          mBytes;
+        int64_t          mErrorCount;
+        int64_t          mMismatchCount;
+        int64_t          mStartUsec;
+        int64_t          mStartCpuUsec;
+        int64_t          mElapsedUsec;
+        int64_t          mCpuUsec;
+    };
+
+    string         mMetaHost;
+    int            mMetaPort;
+    const char*    mConfigFileNamePtr;
+    string         mBaseDir;
+    vector<string> mLayouts;
+    vector<int>    mIoSizes;
+    int64_t        mFileSize;
+    int            mClientBufferSize;
+    int            mMaxFailures;
+    int            mIoTimeoutSec;
+    int            mMetaOpTimeoutSec;
+    int            mRetryDelaySec;
+    int            mMaxRetryCount;
+    bool           mVerifyFlag;
+    bool           mKeepFilesFlag;
+    KfsClient*     mClientPtr;
+    vector<char>   mBuf;
+    vector<char>   mReadBuf;
+    vector<string> mCounterNames;
+
+    static int64_t GetCpuUsec()
+    {
+        // Process cpu time, includes the client protocol worker thread.
+        struct rusage theUsage;
+        if (getrusage(RUSAGE_SELF, &theUsage)) {
+            return 0;
+        }
+        return (
+            ((int64_t)theUsage.ru_utime.tv_sec +
+                theUsage.ru_stime.tv_sec) * 1000 * 1000 +
+            theUsage.ru_utime.tv_usec + theUsage.ru_stime.tv_usec
+        );
+    }
+    static int64_t ParseSize(
+        const string& inStr)
+    {
+        char*         theEndPtr = 0;
+        const int64_t theRet    = (int64_t)strtoll(
+            inStr.c_str(), &theEndPtr, 0);
+        switch (theEndPtr ? (*theEndPtr & 0xFF) : 0) {
+            case 'k': case 'K': return (theRet << 10);
+            case 'm': case 'M': return (theRet << 20);
+            case 'g': case 'G': return (theRet << 30);
+            default: break;
+        }
+        return theRet;
+    }
+    static void ParseNames(
+        const char*     inStrPtr,
+        vector<string>& outList)
+    {
+        outList.clear();
+        istringstream theStream(inStrPtr);
+        string        theToken;
+        while (getline(theStream, theToken, ',')) {
+            if (! theToken.empty()) {
+                outList.push_back(theToken);
+            }
+        }
+    }
+    void GetCounters(
+        Counters& outCounters)
+    {
+        outCounters.clear();
+        if (mCounterNames.empty()) {
+            return;
+        }
+        Properties* const theStatsPtr = mClientPtr->GetStats();
+        for (vector<string>::const_iterator theIt = mCounterNames.begin();
+                theIt != mCounterNames.end();
+                ++theIt) {
+            outCounters.push_back(theStatsPtr ?
+                theStatsPtr->getValue(*theIt, int64_t(0)) : int64_t(0));
+        }
+        KfsClient::DisposeProperties(theStatsPtr);
+    }
+    Counters GetCounters()
+    {
+        Counters theRet;
+        GetCounters(theRet);
+        return theRet;
+    }
+    void StopCounters(
+        Stats& inStats)
+    {
+        Counters theCounters;
+        GetCounters(theCounters);
+        for (size_t i = 0;
+                i < theCounters.size() && i < inStats.mCounters.size();
+                i++) {
+            inStats.mCounters[i] = theCounters[i] - inStats.mCounters[i];
+        }
+    }
+    static bool ParseSizes(
+        const char*  inStrPtr,
+        vector<int>& outList)
+    {
+        outList.clear();
+        istringstream theStream(inStrPtr);
+        string        theToken;
+        while (getline(theStream, theToken, ',')) {
+            const int64_t theVal = ParseSize(theToken);
+            if (theVal <= 0 || (int64_t(1) << 30) < theVal) {
+                cerr << "invalid size: " << theToken << "\n";
+                return false;
+            }
+            outList.push_back((int)theVal);
+        }
+        return (! outList.empty());
+    }
+    static bool ParseLayouts(
+        const char*     inStrPtr,
+        vector<string>& outList)
+    {
+        // Space or semicolon separated list of create parameters, in
+        // KfsClient::ParseCreateParams() format.
+        outList.clear();
+        string theStr(inStrPtr);
+        for (size_t i = 0; i < theStr.size(); i++) {
+            if (theStr[i] == ';') {
+                theStr[i] = ' ';
+            }
+        }
+        istringstream theStream(theStr);
+        string        theToken;
+        while (theStream >> theToken) {
+            int numReplicas        = 0;
+            int numStripes         = 0;
+            int numRecoveryStripes = 0;
+            int stripeSize         = 0;
+            int stripedType        = 0;
+            if (KfsClient::ParseCreateParams(theToken.c_str(), numReplicas,
+                    numStripes, numRecoveryStripes, stripeSize,
+                    stripedType) != 0) {
+                cerr << "invalid layout: " << theToken << "\n";
+                return false;
+            }
+            outList.push_back(theToken);
+        }
+        return (! outList.empty());
+    }
+    void Report(
+        const string& inLayout,
+        int           inIoSize,
+        const char*   inPhasePtr,
+        int           inFailedStripes,
+        const Stats&  inStats)
+    {
+        const double theSec = inStats.mElapsedUsec * 1e-6;
+        cout <<
+            "layout="           << inLayout <<
+            " io-size="         << inIoSize <<
+            " phase="           << inPhasePtr <<
+            " failed-stripes="  << inFailedStripes <<
+            " bytes="           << inStats.mBytes <<
+            " sec="             << theSec <<
+            " mb-per-sec="      << (theSec <= 0 ? 0. :
+                inStats.mBytes / theSec / (1 << 20)) <<
+            " cpu-sec="         << inStats.mCpuUsec * 1e-6 <<
+            " cpu-ns-per-byte=" << (inStats.mBytes <= 0 ? 0. :
+                inStats.mCpuUsec * 1e3 / inStats.mBytes) <<
+            " io-count="        << inStats.mHist.GetCount() <<
+            " io-usec-mean="    << (inStats.mHist.GetCount() <= 0 ? 0. :
+                (double)inStats.mHist.GetTotal() / inStats.mHist.GetCount()) <<
+            " io-usec-p50="     << inStats.mHist.GetPercentile(500) <<
+            " io-usec-p99="     << inStats.mHist.GetPercentile(990) <<
+            " io-usec-p999="    << inStats.mHist.GetPercentile(999) <<
+            " io-usec-max="     << inStats.mHist.GetMax() <<
+            " errors="          << inStats.mErrorCount <<
+            " mismatches="      << inStats.mMismatchCount;
+        for (size_t i = 0;
+                i < mCounterNames.size() && i < inStats.mCounters.size();
+                i++) {
+            cout << " " << mCounterNames[i] << "=" << inStats.mCounters[i];
+        }
+        cout << "\n";
+        cout.flush();
+    }
+    bool Error(
+        Stats&        inStats,
+        const char*   inOpNamePtr,
+        const string& inPath,
+        int64_t       inStatus)
+    {
+        inStats.Stop();
+        if (inStats.mErrorCount++ < 10) {
+            KFS_LOG_STREAM_ERROR <<
+                inOpNamePtr << ": " << inPath << ": " <<
+                ErrorCodeToStr((int)inStatus) <<
+            KFS_LOG_EOM;
+        }
+        return false;
+    }
+    bool Write(
+        const string& inPath,
+        const string& inLayout,
+        int           inIoSize,
+        Stats&        inStats)
+    {
+        const int theFd = mClientPtr->Create(
+            inPath.c_str(), false, inLayout.c_str());
+        if (theFd < 0) {
+            return Error(inStats, "create", inPath, theFd);
+        }
+        if (0 < mClientBufferSize) {
+            mClientPtr->SetIoBufferSize(theFd, mClientBufferSize);
+        }
+        const char* const thePtr = &mBuf[0];
+        while (inStats.mBytes < mFileSize) {
+            const int theSize = (int)std::min(
+                int64_t(inIoSize), mFileSize - inStats.mBytes);
+            const int64_t theStart = microseconds();
+            const ssize_t theRet   = mClientPtr->Write(theFd, thePtr, theSize);
+            inStats.mHist.Add(microseconds() - theStart);
+            if (theRet != theSize) {
+                mClientPtr->Close(theFd);
+                return Error(inStats, "write", inPath,
+                    theRet < 0 ? theRet : -EIO);
+            }
+            inStats.mBytes += theRet;
+        }
+        // Close flushes the write behind, and waits for completion.
+        const int theRet = mClientPtr->Close(theFd);
+        inStats.Stop();
+        if (theRet < 0) {
+            return Error(inStats, "close", inPath, theRet);
+        }
+        return true;
+    }
+    bool Read(
+        const string& inPath,
+        int           inIoSize,
+        Stats&        inStats)
+    {
+        const int theFd = mClientPtr->Open(inPath.c_str(), O_RDONLY);
+        if (theFd < 0) {
+            return Error(inStats, "open", inPath, theFd);
+        }
+        if (0 < mClientBufferSize) {
+            mClientPtr->SetIoBufferSize(theFd, mClientBufferSize);
+        }
+        char* const thePtr = &mReadBuf[0];
+        while (inStats.mBytes < mFileSize) {
+            const int theSize = (int)std::min(
+                int64_t(inIoSize), mFileSize - inStats.mBytes);
+            const int64_t theStart = microseconds();
+            const ssize_t theRet   = mClientPtr->Read(theFd, thePtr, theSize);
+            inStats.mHist.Add(microseconds() - theStart);
+            if (theRet != theSize) {
+                mClientPtr->Close(theFd);
+                return Error(inStats, "read", inPath,
+                    theRet < 0 ? theRet : -EIO);
+            }
+            // Each io size block is written from the same buffer.
+            if (mVerifyFlag && memcmp(thePtr, &mBuf[0], theSize) != 0) {
+                if (inStats.mMismatchCount++ < 10) {
+                    KFS_LOG_STREAM_ERROR <<
+                        inPath << ": data mismatch at: " << inStats.mBytes <<
+                    KFS_LOG_EOM;
+                }
+            }
+            inStats.mBytes += theRet;
+        }
+        mClientPtr->Close(theFd);
+        inStats.Stop();
+        return true;
+    }
+    int RunOne(
+        const string& inLayout,
+        int           inIoSize);
+private:
+    StripeBench(
+        const StripeBench& inBench);
+    StripeBench& operator=(
+        const StripeBench& inBench);
+};
+
+    int
+StripeBench::RunOne(
+    const string& inLayout,
+    int           inIoSize)
+{
+    int numReplicas        = 0;
+    int numStripes         = 0;
+    int numRecoveryStripes = 0;
+    int stripeSize         = 0;
+    int stripedType        = 0;
+    KfsClient::ParseCreateParams(inLayout.c_str(), numReplicas,
+        numStripes, numRecoveryStripes, stripeSize, stripedType);
+    ostringstream theStream;
+    theStream << mBaseDir << "/l" << numReplicas << "-" << numStripes <<
+        "-" << numRecoveryStripes << "-" << stripeSize << "-" <<
+        stripedType << "-io" << inIoSize;
+    const string thePath = theStream.str();
+    mBuf.resize(inIoSize);
+    mReadBuf.resize(inIoSize);
+    unsigned int theSeed = (unsigned int)inIoSize;
+    for (size_t i = 0; i < mBuf.size(); i++) {
+        mBuf[i] = (char)rand_r(&theSeed);
+    }
+    Stats theWriteStats(GetCounters());
+    const bool theWriteOkFlag =
+        Write(thePath, inLayout, inIoSize, theWriteStats);
+    StopCounters(theWriteStats);
+    if (! theWriteOkFlag) {
+        Report(inLayout, inIoSize, "write", 0, theWriteStats);
+        mClientPtr->Remove(thePath.c_str());
+        return -EIO;
+    }
+    Report(inLayout, inIoSize, "write", 0, theWriteStats);
+    int theStatus = 0;
+    const int theMaxFailures =
+        (stripedType == KFS_STRIPED_FILE_TYPE_NONE || numStripes <= 1) ? 0 :
+        (mMaxFailures < 0 ? numRecoveryStripes :
+            std::min(mMaxFailures, numRecoveryStripes));
+    for (int k = 0; k <= theMaxFailures && theStatus == 0; k++) {
+        // Fail the first k data stripes, the data has to be recovered from
+        // the remaining data stripes and k recovery stripes.
+        RSStriperSetReadFailureInjection(k <= 0 ? uint64_t(0) :
+            (uint64_t(1) << std::min(k, numStripes)) - 1);
+        Stats theReadStats(GetCounters());
+        if (! Read(thePath, inIoSize, theReadStats) ||
+                0 < theReadStats.mMismatchCount) {
+            theStatus = -EIO;
+        }
+        StopCounters(theReadStats);
+        Report(inLayout, inIoSize, k <= 0 ? "read" : "read-degraded", k,
+            theReadStats);
+    }
+    RSStriperSetReadFailureInjection(0);
+    if (! mKeepFilesFlag) {
+        mClientPtr->Remove(thePath.c_str());
+    }
+    return theStatus;
+}
+
+    int
+StripeBench::Run(
+    int    inArgCount,
+    char** inArgsPtr)
+{
+    int         theOpt;
+    bool        theHelpFlag    = false;
+    bool        theVerboseFlag = false;
+    const char* theLayoutsPtr  =
+        "1,0,0,0,1 2,0,0,0,1 3,0,0,0,1"
+        " 1,6,3,65536,2 1,6,3,1048576,2"
+        " 1,10,4,65536,3 1,10,4,1048576,3";
+    const char* theSizesPtr    = "64k,1m,8m";
+    const char* theCountersPtr =
+        "Read.Retries,Read.ReadErrors,Read.ReadRecoveries,Read.HedgedReads,"
+        "Read.SleepTimeSec,Write.Retries,Write.AllocRetries,"
+        "Write.SleepTimeSec";
+    while ((theOpt = getopt(inArgCount, inArgsPtr,
+            "s:p:f:d:l:b:S:B:F:T:M:D:R:C:nkvh")) != -1) {
+        switch (theOpt) {
+            case 's': mMetaHost          = optarg;                   break;
+            case 'p': mMetaPort          = atoi(optarg);             break;
+            case 'f': mConfigFileNamePtr = optarg;                   break;
+            case 'd': mBaseDir           = optarg;                   break;
+            case 'l': theLayoutsPtr      = optarg;                   break;
+            case 'b': theSizesPtr        = optarg;                   break;
+            case 'S': mFileSize          = ParseSize(optarg);        break;
+            case 'B': mClientBufferSize  = (int)ParseSize(optarg);   break;
+            case 'F': mMaxFailures       = atoi(optarg);             break;
+            case 'T': mIoTimeoutSec      = atoi(optarg);             break;
+            case 'M': mMetaOpTimeoutSec  = atoi(optarg);             break;
+            case 'D': mRetryDelaySec     = atoi(optarg);             break;
+            case 'R': mMaxRetryCount     = atoi(optarg);             break;
+            case 'C': theCountersPtr     = optarg;                   break;
+            case 'n': mVerifyFlag        = false;                    break;
+            case 'k': mKeepFilesFlag     = true;                     break;
+            case 'v': theVerboseFlag     = true;                     break;
+            default:  theHelpFlag        = true;                     break;
+        }
+    }
+    if (theHelpFlag || mMetaHost.empty() || mMetaPort <= 0 ||
+            mFileSize <= 0 || mClientBufferSize < 0 ||
+            ! ParseLayouts(theLayoutsPtr, mLayouts) ||
+            ! ParseSizes(theSizesPtr, mIoSizes)) {
+        cerr << "Usage: " <<
+            (inArgCount > 0 ? inArgsPtr[0] : "qfsstripebench") <<
+            " -s <meta server> -p <port>\n"
+            " [-f <client config file>]\n"
+            " [-d <base directory>]        default: /qfsstripebench\n"
+            " [-l <layout ...>]            space separated create"
+            " parameters:\n"
+            "                              <replicas>,<data stripes>,"
+            "<recovery stripes>,\n"
+            "                              <stripe size>,<type>\n"
+            "                              type: 1 replication, 2 RS,"
+            " 3 RS jerasure\n"
+            "                              default: 1,0,0,0,1 2,0,0,0,1"
+            " 3,0,0,0,1\n"
+            "                              1,6,3,65536,2 1,6,3,1048576,2\n"
+            "                              1,10,4,65536,3 1,10,4,1048576,3\n"
+            " [-b <size,...>]              io sizes, default: 64k,1m,8m\n"
+            " [-S <size>]                  file size, default: 1g\n"
+            " [-B <size>]                  client io buffer size, default:"
+            " client default\n"
+            " [-F <count>]                 max failed stripes for degraded"
+            " reads,\n"
+            "                              default: recovery stripe count\n"
+            " [-T <sec>]                   client io timeout\n"
+            " [-M <sec>]                   client meta server op timeout\n"
+            " [-D <sec>]                   client retry delay\n"
+            " [-R <count>]                 client max retry count per op\n"
+            " [-C <name,...>]              client counters to report,"
+            " default:\n"
+            "                              " << theCountersPtr << "\n"
+            " [-n]                         do not verify data read\n"
+            " [-k]                         keep files\n"
+            " [-v]                         verbose\n"
+            "Use file size that is multiple of the chunk block size, i.e."
+            " data stripe\n"
+            "count times 64MB, in order to avoid the partial last chunk"
+            " block.\n"
+        ;
+        return 1;
+    }
+    MsgLogger::Init(0, theVerboseFlag ?
+        MsgLogger::kLogLevelDEBUG : MsgLogger::kLogLevelINFO);
+    mClientPtr = KfsClient::Connect(mMetaHost, mMetaPort, mConfigFileNamePtr);
+    if (! mClientPtr) {
+        cerr << mMetaHost << ":" << mMetaPort << ": connect failure\n";
+        return 1;
+    }
+    if (0 < mIoTimeoutSec) {
+        mClientPtr->SetDefaultIOTimeout(mIoTimeoutSec);
+    }
+    if (0 < mMetaOpTimeoutSec) {
+        mClientPtr->SetDefaultMetaOpTimeout(mMetaOpTimeoutSec);
+    }
+    if (0 <= mRetryDelaySec) {
+        mClientPtr->SetRetryDelay(mRetryDelaySec);
+    }
+    if (0 <= mMaxRetryCount) {
+        mClientPtr->SetMaxRetryPerOp(mMaxRetryCount);
+    }
+    ParseNames(theCountersPtr, mCounterNames);
+    cout <<
+        "io-timeout="       << mClientPtr->GetDefaultIOTimeout() <<
+        " meta-op-timeout=" << mClientPtr->GetDefaultMetaOpTimeout() <<
+        " retry-delay="     << mClientPtr->GetRetryDelay() <<
+        " max-retry="       << mClientPtr->GetMaxRetryPerOp() <<
+    "\n";
+    int theStatus = mClientPtr->Mkdirs(mBaseDir.c_str());
+    if (theStatus < 0 && theStatus != -EEXIST) {
+        cerr << mBaseDir << ": " << ErrorCodeToStr(theStatus) << "\n";
+        return 1;
+    }
+    theStatus = 0;
+    for (vector<string>::const_iterator theLIt = mLayouts.begin();
+            theLIt != mLayouts.end();
+            ++theLIt) {
+        for (vector<int>::const_iterator theBIt = mIoSizes.begin();
+                theBIt != mIoSizes.end();
+                ++theBIt) {
+            // Continue with the remaining layouts, for example the
+            // jerasure layouts fail if it is not available.
+            if (RunOne(*theLIt, *theBIt) != 0) {
+                theStatus = 1;
+            }
+        }
+    }
+    if (! mKeepFilesFlag) {
+        mClientPtr->Rmdir(mBaseDir.c_str());
+    }
+    return theStatus;
+}
+
+} // namespace KFS
+
+int
+main(int argc, char** argv)
+{
+    KFS::StripeBench theBench;
+    return theBench.Run(argc, argv);
+}
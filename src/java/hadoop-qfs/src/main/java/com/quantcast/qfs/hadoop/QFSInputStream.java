@@ -90,6 +90,58 @@ class QFSInputStream extends FSInputStream {
     return res;
   }
 
+  // Positional reads do not change the stream position, and use the qfs
+  // client positional read, instead of the default FSInputStream
+  // synchronized seek, read, and seek back sequence.
+  @Override
+  public int read(long position, byte[] buffer, int offset, int length)
+    throws IOException {
+    if (length == 0) {
+      return 0;
+    }
+    final int res = kfsChannel.read(position,
+        ByteBuffer.wrap(buffer, offset, length));
+    if (res > 0 && statistics != null) {
+      statistics.incrementBytesRead(res);
+    }
+    return res;
+  }
+
+  @Override
+  public void readFully(long position, byte[] buffer, int offset, int length)
+    throws IOException {
+    final int res = length == 0 ? 0 : kfsChannel.read(position,
+        ByteBuffer.wrap(buffer, offset, length));
+    if (res > 0 && statistics != null) {
+      statistics.incrementBytesRead(res);
+    }
+    if (res < length) {
+      throw new EOFException("End of file reached before reading fully.");
+    }
+  }
+
+  @Override
+  public void readFully(long position, byte[] buffer) throws IOException {
+    readFully(position, buffer, 0, buffer.length);
+  }
+
+  // Reads the ranges concurrently, see KfsInputChannel.readv().
+  public void readVectored(long[] positions, ByteBuffer[] buffers)
+    throws IOException {
+    long requested = 0;
+    for (int i = 0; i < buffers.length; i++) {
+      requested += buffers[i].remaining();
+    }
+    kfsChannel.readv(positions, buffers);
+    long remaining = 0;
+    for (int i = 0; i < buffers.length; i++) {
+      remaining += buffers[i].remaining();
+    }
+    if (statistics != null) {
+      statistics.incrementBytesRead(requested - remaining);
+    }
+  }
+
   public synchronized void close() throws IOException {
     kfsChannel.close();
   }
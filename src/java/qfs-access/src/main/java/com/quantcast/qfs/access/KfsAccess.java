@@ -79,6 +79,10 @@ final public class KfsAccess
     private final static native
     String[] readdir(long ptr, String path, boolean prefetchAttr);
 
+    private final static native
+    int readFiles(long ptr, String[] paths, int maxPendingFiles,
+        long maxFileSize, byte[][] result, int[] status);
+
     private final static native
     String[][] getDataLocation(long ptr, String path, long start, long len);
 
@@ -300,6 +304,18 @@ final public class KfsAccess
         return readdir(cPtr, path, prefetchAttr);
     }
 
+    // Read many small files with up to maxPendingFiles files read
+    // concurrently. On return result[i] has the content of paths[i], or null
+    // on error, and status[i] the number of bytes read, or negative error
+    // code. Files larger than maxFileSize fail with -EFBIG. Returns 0 if all
+    // files were read successfully, otherwise the first negative status.
+    public int kfs_readFiles(String[] paths, int maxPendingFiles,
+        long maxFileSize, byte[][] result, int[] status)
+    {
+        return readFiles(cPtr, paths, maxPendingFiles, maxFileSize,
+            result, status);
+    }
+
     final public class DirectoryIterator
     {
         public long    modificationTime;
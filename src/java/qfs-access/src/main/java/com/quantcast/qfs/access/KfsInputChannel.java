@@ -45,6 +45,11 @@ final public class KfsInputChannel implements ReadableByteChannel, Positionable
 
     private final static native
     int read(long cPtr, int fd, ByteBuffer buf, int begin, int end);
+    private final static native
+    int pread(long cPtr, int fd, long pos, ByteBuffer buf, int begin, int end);
+    private final static native
+    int preadv(long cPtr, int fd, long[] positions, ByteBuffer[] bufs,
+        int[] begins, int[] ends, int[] results);
 
     KfsInputChannel(KfsAccess ka, int fd) 
     {
@@ -133,6 +138,113 @@ final public class KfsInputChannel implements ReadableByteChannel, Positionable
         buf.position(pos + sz);
     }
 
+    // Positional read: reads up to dst.remaining() bytes starting at the
+    // file position, without changing the channel position, and without
+    // the channel's read buffer. Returns the number of bytes read, or -1 if
+    // the position is at or past the end of file.
+    public int read(long position, ByteBuffer dst) throws IOException
+    {
+        final KfsAccess ka = kfsAccess;
+        final int       fd = kfsFd;
+        if (fd < 0 || ka == null) {
+            throw new IOException("File closed");
+        }
+        if (position < 0) {
+            throw new IllegalArgumentException(
+                "read(" + fd + "," + position + ")");
+        }
+        final int r0 = dst.remaining();
+        if (dst.isDirect()) {
+            while (dst.hasRemaining()) {
+                final int pos = dst.position();
+                final int sz  = pread(ka.getCPtr(), fd, position, dst,
+                    pos, dst.limit());
+                ka.kfs_retToIOException(sz);
+                if (sz <= 0) {
+                    break;
+                }
+                dst.position(pos + sz);
+                position += sz;
+            }
+        } else {
+            final ByteBuffer buf = BufferPool.getInstance().getBuffer();
+            try {
+                while (dst.hasRemaining()) {
+                    buf.clear();
+                    final int sz = pread(ka.getCPtr(), fd, position, buf,
+                        0, Math.min(buf.capacity(), dst.remaining()));
+                    ka.kfs_retToIOException(sz);
+                    if (sz <= 0) {
+                        break;
+                    }
+                    buf.limit(sz);
+                    dst.put(buf);
+                    position += sz;
+                }
+            } finally {
+                BufferPool.getInstance().releaseBuffer(buf);
+            }
+        }
+        final int r1 = dst.remaining();
+        if (r1 < r0 || r0 == 0) {
+            return r0 - r1;
+        }
+        return -1;
+    }
+
+    // Vectored positional read: reads the ranges concurrently, each range
+    // starts at the corresponding file position, and fills the buffer
+    // from its position to its limit, or up to the end of file. The buffers
+    // must be direct, and must not overlap. The buffer positions are
+    // advanced by the number of bytes read. Does not change the channel
+    // position.
+    public void readv(long[] positions, ByteBuffer[] dsts) throws IOException
+    {
+        final KfsAccess ka = kfsAccess;
+        final int       fd = kfsFd;
+        if (fd < 0 || ka == null) {
+            throw new IOException("File closed");
+        }
+        if (positions.length != dsts.length) {
+            throw new IllegalArgumentException("readv: " +
+                positions.length + " positions " + dsts.length + " buffers");
+        }
+        final int    cnt     = positions.length;
+        final long[] pos     = positions.clone();
+        final int[]  begins  = new int[cnt];
+        final int[]  ends    = new int[cnt];
+        final int[]  results = new int[cnt];
+        for (int i = 0; i < cnt; i++) {
+            if (!dsts[i].isDirect()) {
+                throw new IllegalArgumentException("need direct buffer");
+            }
+            begins[i] = dsts[i].position();
+            ends[i]   = dsts[i].limit();
+        }
+        // Re-issue short reads, if any, until all ranges are filled, or
+        // the end of file is reached.
+        for (boolean more = cnt > 0; more; ) {
+            ka.kfs_retToIOException(
+                preadv(ka.getCPtr(), fd, pos, dsts, begins, ends, results));
+            more = false;
+            for (int i = 0; i < cnt; i++) {
+                if (begins[i] >= ends[i]) {
+                    continue;
+                }
+                final int sz = results[i];
+                ka.kfs_retToIOException(sz);
+                if (sz <= 0) {
+                    ends[i] = begins[i];
+                    continue;
+                }
+                begins[i] += sz;
+                pos[i]    += sz;
+                dsts[i].position(begins[i]);
+                more = more || begins[i] < ends[i];
+            }
+        }
+    }
+
     // is modeled after the seek of Java's RandomAccessFile; offset is
     // the offset from the beginning of the file.
     public synchronized long seek(long offset) throws IOException
@@ -0,0 +1,256 @@
+#!/bin/sh
+#
+# $Id$
+#
+# Created 2026/10/14
+#
+# Copyright 2026 Quantcast Corporation. All rights reserved.
+#
+# This file is part of Kosmos File System (KFS).
+#
+# Licensed under the Apache License, Version 2.0
+# (the "License"); you may not use this file except in compliance with
+# the License. You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+# implied. See the License for the specific language governing
+# permissions and limitations under the License.
+#
+# Misbehaving network performance suite. For each scenario restarts the
+# selected chunk servers with the network error simulator configured to
+# inject latency, stalls, or connection resets on the chunk server client
+# connections, and runs qfsstripebench with each client io timeout / retry
+# setting. The qfsstripebench output lines are prefixed with the scenario
+# name and the client parameters, and written into the results file, in order
+# to compare throughput, tail latency, retry and error counts across client
+# timeout settings.
+#
+# Scenario format, one per line:
+# <name> <chunk server index list: 0,1... | all | none> <simulator spec>
+# The string PORT in the simulator spec is replaced with the chunk server
+# client port. See kfsio/NetErrorSimulator.h for the spec syntax.
+# Client settings format, one per line:
+# <io timeout sec> <retry delay sec> <max retry count>
+#
+# Uses the test directory created by qfstest.sh, run qfstest.sh first.
+
+ulimit -c unlimited || exit
+
+builddir=`pwd`
+toolsdir=${toolsdir-"$builddir"/src/cc/tools}
+metadir=${metadir-"$builddir"/src/cc/meta}
+chunkdir=${chunkdir-"$builddir"/src/cc/chunk}
+qfstestdir=${qfstestdir-"$builddir"/qfstest}
+clicfg=${clicfg-"$qfstestdir"/client.prp}
+clirootcfg=${clirootcfg-"$qfstestdir"/clientroot.prp}
+metaport=${metaport-20200}
+metahost=${metahost-127.0.0.1}
+csstartport=${csstartport-20400}
+csendport=${csendport-`expr $csstartport + 2`}
+benchlayouts=${benchlayouts-'2,0,0,0,1 3,0,0,0,1 1,6,3,65536,2'}
+benchiosizes=${benchiosizes-'1m'}
+benchfilesize=${benchfilesize-`expr 64 \* 1024 \* 1024`}
+benchargs=${benchargs-''}
+resultsfile=${resultsfile-"$qfstestdir"/netfaultperf-results.txt}
+scenariosfile=${scenariosfile-''}
+clientsettingsfile=${clientsettingsfile-''}
+
+scenarios()
+{
+    if [ x != x"$scenariosfile" ]; then
+        cat "$scenariosfile"
+        return
+    fi
+    cat << EOF
+baseline       none -
+slow-peer      0    sn=^[^:]*:PORT\$,a=rand,int=32,rsleep=0.05
+slow-peers     all  sn=^[^:]*:PORT\$,a=rand,int=64,rsleep=0.02
+stall          0    sn=^[^:]*:PORT\$,a=rn+rand+log,int=4096
+reset          0    sn=^[^:]*:PORT\$,a=rst+rand+log,int=2048
+read-error     1    sn=^[^:]*:PORT\$,a=erd+rand+log,int=2048
+EOF
+}
+
+clientsettings()
+{
+    if [ x != x"$clientsettingsfile" ]; then
+        cat "$clientsettingsfile"
+        return
+    fi
+    cat << EOF
+5  1 6
+15 1 6
+30 5 6
+EOF
+}
+
+wait_shutdown_complete()
+{
+    pid=$1
+    maxtry=${2-100}
+    k=0
+    while kill -0 $pid 2>/dev/null; do
+        sleep 1
+        k=`expr $k + 1`
+        if [ $k -gt $maxtry ]; then
+            echo "server $pid shutdown failure" 1>&2
+            kill -ABRT $pid
+            sleep 3
+            kill -KILL $pid 2>/dev/null
+            return 1
+        fi
+    done
+    return 0
+}
+
+stop_chunk_server()
+{
+    cd "$qfstestdir"/chunk/$1 || return 1
+    if [ -f chunkserver.pid ]; then
+        pid=`cat chunkserver.pid`
+        kill -QUIT $pid 2>/dev/null && wait_shutdown_complete $pid
+    fi
+    cd "$builddir"
+}
+
+# start_chunk_server <port> <simulator spec>
+start_chunk_server()
+{
+    cd "$qfstestdir"/chunk/$1 || return 1
+    rm -f chunkserver-netfaultperf.log
+    sed -e 's/^\(chunkServer.diskIo.crashOnError.*\)$/# \1/' \
+        -e 's/^\(chunkServer.netErrorSimulator.*\)$/# \1/' \
+        -e 's/^\(chunkServer.msgLogWriter.logLevel.*\)$/# \1/' \
+        ChunkServer.prp > ChunkServer-netfaultperf.prp
+    {
+        echo "chunkServer.msgLogWriter.logLevel = INFO"
+        if [ x"$2" != x ]; then
+            echo "chunkServer.netErrorSimulator = $2"
+        fi
+    } >> ChunkServer-netfaultperf.prp
+    "$chunkdir"/chunkserver ChunkServer-netfaultperf.prp \
+        > chunkserver-netfaultperf.log 2>&1 &
+    echo $! > chunkserver.pid
+    cd "$builddir"
+}
+
+stop_chunk_servers()
+{
+    sstatus=0
+    i=$csstartport
+    while [ $i -le $csendport ]; do
+        stop_chunk_server $i || sstatus=1
+        i=`expr $i + 1`
+    done
+    return $sstatus
+}
+
+wait_chunk_servers()
+{
+    csnum=`expr $csendport - $csstartport + 1`
+    t=0
+    until "$toolsdir"/qfsadmin -s "$metahost" -p "$metaport" \
+                -f "$clirootcfg" upservers 2>/dev/null \
+            | awk -v n=$csnum 'BEGIN{c=0;}{c++;}END{exit(c<n?1:0);}'; do
+        t=`expr $t + 1`
+        if [ $t -gt 60 ]; then
+            echo "wait for chunk servers to connect timed out"
+            return 1
+        fi
+        sleep 1
+    done
+    return 0
+}
+
+shutdown()
+{
+    stop_chunk_servers
+    sstatus=$?
+    cd "$qfstestdir"/meta || return 1
+    pid=`cat metaserver.pid`
+    kill -QUIT $pid
+    wait_shutdown_complete $pid || sstatus=1
+    cd "$builddir"
+    return $sstatus
+}
+
+if [ -d "$qfstestdir" ]; then
+    true
+else
+    echo "Directory $qfstestdir does not exist, execute qfstest.sh first."
+    exit 1
+fi
+[ -f "$clicfg"     ] || clicfg=/dev/null
+[ -f "$clirootcfg" ] || clirootcfg=/dev/null
+
+cd "$qfstestdir"/meta || exit
+kill -KILL `cat metaserver.pid` 2>/dev/null
+rm -f kfscp/* kfslog/*
+"$metadir"/metaserver -c MetaServer.prp > metaserver-netfaultperf.log 2>&1 || {
+    status=$?
+    cat metaserver-netfaultperf.log
+    exit $status
+}
+"$metadir"/metaserver MetaServer.prp > metaserver-netfaultperf.log 2>&1 &
+echo $! > metaserver.pid
+cd "$builddir"
+trap shutdown EXIT
+
+rm -f "$resultsfile"
+scenariostmp="$qfstestdir"/netfaultperf-scenarios.txt
+clientsettingstmp="$qfstestdir"/netfaultperf-client.txt
+scenarios      > "$scenariostmp"      || exit
+clientsettings > "$clientsettingstmp" || exit
+status=0
+while read name servers spec; do
+    [ x = x"$name" ] && continue
+    case "$name" in \#*) continue;; esac
+    echo "============== scenario: $name servers: $servers =============="
+    stop_chunk_servers
+    n=0
+    i=$csstartport
+    while [ $i -le $csendport ]; do
+        cspec=''
+        if [ x"$servers" = x'all' ] || \
+                echo ",$servers," | grep ",$n," > /dev/null; then
+            cspec=`echo "$spec" | sed -e "s/PORT/$i/g"`
+        fi
+        start_chunk_server $i "$cspec" || {
+            status=1
+            break
+        }
+        i=`expr $i + 1`
+        n=`expr $n + 1`
+    done
+    [ $status -eq 0 ] || break
+    wait_chunk_servers || {
+        status=1
+        break
+    }
+    while read iotimeout retrydelay maxretry; do
+        [ x = x"$iotimeout" ] && continue
+        prefix="scenario=$name servers=$servers"
+        prefix="$prefix client-io-timeout=$iotimeout"
+        prefix="$prefix client-retry-delay=$retrydelay"
+        prefix="$prefix client-max-retry=$maxretry"
+        echo "$prefix"
+        "$toolsdir"/qfsstripebench \
+            -s "$metahost" -p "$metaport" -f "$clicfg" \
+            -d /netfaultperf \
+            -l "$benchlayouts" \
+            -b "$benchiosizes" \
+            -S "$benchfilesize" \
+            -T "$iotimeout" -D "$retrydelay" -R "$maxretry" \
+            $benchargs \
+        > "$qfstestdir"/netfaultperf-bench.txt || status=1
+        sed -e "s/^/$prefix /" "$qfstestdir"/netfaultperf-bench.txt \
+            | tee -a "$resultsfile"
+    done < "$clientsettingstmp"
+done < "$scenariostmp"
+
+echo "Results: $resultsfile"
+exit $status